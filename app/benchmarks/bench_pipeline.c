@@ -0,0 +1,579 @@
+#include "common.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+
+#include "control_msg.h"
+#include "decoder.h"
+#include "demuxer.h"
+#include "device_msg.h"
+#include "frame_buffer.h"
+#include "packet_merger.h"
+#include "startup_timeline.h"
+#include "stream_dump.h"
+#include "trait/frame_sink.h"
+#include "trait/packet_sink.h"
+#include "util/audiobuf.h"
+#include "util/binary.h"
+#include "util/log.h"
+#include "util/memory.h"
+#include "util/tick.h"
+
+/**
+ * Micro-benchmarks of the client pipeline (and an end-to-end replay).
+ *
+ * The iteration counts are fixed and the benchmarks always run in the same
+ * order, so that the JSON document written to stdout can be compared between
+ * builds to track regressions. Build in release mode:
+ *
+ *     meson setup x --buildtype=release -Dbenchmarks=true
+ *     ninja -Cx benchmarks
+ *
+ * The end-to-end replay decodes a stream dumped by --dump-streams, its
+ * directory is passed as argument (otherwise this benchmark is skipped).
+ */
+
+#define BENCH_DUMP_DIR "."
+#define BENCH_DUMP_NAME "bench-demuxer"
+
+// Same format as in demuxer.c
+#define BENCH_PACKET_HEADER_SIZE 12
+#define BENCH_PACKET_FLAG_CONFIG    (UINT64_C(1) << 63)
+#define BENCH_PACKET_FLAG_KEY_FRAME (UINT64_C(1) << 62)
+
+struct bench_result {
+    const char *name;
+    uint64_t iterations;
+    sc_tick duration;
+    bool skipped;
+    bool failed;
+};
+
+static bool first_result = true;
+
+static void
+bench_report(const struct bench_result *result) {
+    printf("%s\n    {\"name\": \"%s\", ", first_result ? "" : ",",
+           result->name);
+    first_result = false;
+
+    if (result->skipped || result->failed) {
+        printf("\"%s\": true}", result->failed ? "failed" : "skipped");
+        return;
+    }
+
+    uint64_t total_ns = SC_TICK_TO_US(result->duration) * 1000;
+    uint64_t ns_per_op = result->iterations ? total_ns / result->iterations
+                                            : 0;
+    printf("\"iterations\": %" PRIu64_ ", \"total_ns\": %" PRIu64_ ", "
+           "\"ns_per_op\": %" PRIu64_ "}",
+           result->iterations, total_ns, ns_per_op);
+}
+
+static inline void
+bench_do_not_optimize(const void *p) {
+    // Prevent the compiler from discarding the benchmarked computation
+    __asm__ volatile("" : : "g"(p) : "memory");
+}
+
+static bool
+bench_packet_merger(struct bench_result *result) {
+    const uint64_t iterations = 1000000;
+
+    AVPacket *config = av_packet_alloc();
+    AVPacket *media = av_packet_alloc();
+    AVPacket *packet = av_packet_alloc();
+    if (!config || !media || !packet) {
+        LOG_OOM();
+        goto error;
+    }
+
+    if (av_new_packet(config, 32) || av_new_packet(media, 16384)) {
+        LOG_OOM();
+        goto error;
+    }
+    memset(config->data, 0x42, config->size);
+    memset(media->data, 0x43, media->size);
+    config->pts = AV_NOPTS_VALUE;
+    media->pts = 0;
+
+    struct sc_packet_merger merger;
+    sc_packet_merger_init(&merger);
+
+    sc_tick start = sc_tick_now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        // A config packet followed by the media packet it is merged into
+        bool ok = !av_packet_ref(packet, config)
+               && sc_packet_merger_merge(&merger, packet);
+        av_packet_unref(packet);
+        ok = ok && !av_packet_ref(packet, media)
+                && sc_packet_merger_merge(&merger, packet);
+        av_packet_unref(packet);
+        if (!ok) {
+            sc_packet_merger_destroy(&merger);
+            goto error;
+        }
+    }
+    result->duration = sc_tick_now() - start;
+    result->iterations = iterations;
+
+    sc_packet_merger_destroy(&merger);
+    av_packet_free(&packet);
+    av_packet_free(&media);
+    av_packet_free(&config);
+    return true;
+
+error:
+    av_packet_free(&packet);
+    av_packet_free(&media);
+    av_packet_free(&config);
+    return false;
+}
+
+static bool
+bench_frame_buffer(struct bench_result *result) {
+    const uint64_t iterations = 1000000;
+
+    AVFrame *frame = av_frame_alloc();
+    AVFrame *dst = av_frame_alloc();
+    if (!frame || !dst) {
+        LOG_OOM();
+        goto error;
+    }
+
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = 1920;
+    frame->height = 1080;
+    if (av_frame_get_buffer(frame, 0)) {
+        LOG_OOM();
+        goto error;
+    }
+
+    struct sc_frame_buffer fb;
+    if (!sc_frame_buffer_init(&fb)) {
+        goto error;
+    }
+
+    sc_tick start = sc_tick_now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        bool skipped;
+        if (!sc_frame_buffer_push(&fb, frame, &skipped)) {
+            sc_frame_buffer_destroy(&fb);
+            goto error;
+        }
+        sc_frame_buffer_consume(&fb, dst);
+        av_frame_unref(dst);
+    }
+    result->duration = sc_tick_now() - start;
+    result->iterations = iterations;
+
+    sc_frame_buffer_destroy(&fb);
+    av_frame_free(&dst);
+    av_frame_free(&frame);
+    return true;
+
+error:
+    av_frame_free(&dst);
+    av_frame_free(&frame);
+    return false;
+}
+
+static bool
+bench_audiobuf(struct bench_result *result) {
+    const uint64_t iterations = 1000000;
+    // 10 ms of 48 kHz stereo float samples
+    const uint32_t samples = 480;
+    const size_t sample_size = 2 * sizeof(float);
+
+    struct sc_audiobuf buf;
+    if (!sc_audiobuf_init(&buf, sample_size, 48000)) {
+        return false;
+    }
+
+    float *data = calloc(samples, sample_size);
+    if (!data) {
+        LOG_OOM();
+        sc_audiobuf_destroy(&buf);
+        return false;
+    }
+
+    sc_tick start = sc_tick_now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        uint32_t w = sc_audiobuf_write(&buf, data, samples);
+        uint32_t r = sc_audiobuf_read(&buf, data, samples);
+        if (w != samples || r != samples) {
+            LOGE("Unexpected audiobuf write/read: %" PRIu32 "/%" PRIu32, w, r);
+            free(data);
+            sc_audiobuf_destroy(&buf);
+            return false;
+        }
+        bench_do_not_optimize(data);
+    }
+    result->duration = sc_tick_now() - start;
+    result->iterations = iterations;
+
+    free(data);
+    sc_audiobuf_destroy(&buf);
+    return true;
+}
+
+static bool
+bench_control_msg_serialize(struct bench_result *result) {
+    const uint64_t iterations = 10000000;
+
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT,
+        .inject_touch_event = {
+            .action = AMOTION_EVENT_ACTION_MOVE,
+            .pointer_id = POINTER_ID_MOUSE,
+            .position = {
+                .point = {
+                    .x = 100,
+                    .y = 200,
+                },
+                .screen_size = {
+                    .width = 1080,
+                    .height = 1920,
+                },
+            },
+            .pressure = 1.0f,
+            .action_button = 0,
+            .buttons = AMOTION_EVENT_BUTTON_PRIMARY,
+        },
+    };
+
+    uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+
+    sc_tick start = sc_tick_now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        msg.inject_touch_event.position.point.x = i & 0x3ff;
+        size_t size = sc_control_msg_serialize(&msg, buf);
+        if (!size) {
+            return false;
+        }
+        bench_do_not_optimize(buf);
+    }
+    result->duration = sc_tick_now() - start;
+    result->iterations = iterations;
+
+    return true;
+}
+
+static bool
+bench_device_msg_deserialize(struct bench_result *result) {
+    const uint64_t iterations = 1000000;
+
+    // A clipboard message containing 1 KB of text
+    uint8_t input[5 + 1024];
+    input[0] = DEVICE_MSG_TYPE_CLIPBOARD;
+    sc_write32be(&input[1], 1024);
+    memset(&input[5], 'a', 1024);
+
+    struct sc_arena arena;
+    sc_arena_init(&arena, 4096);
+
+    sc_tick start = sc_tick_now();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        struct sc_device_msg msg;
+        ssize_t r =
+            sc_device_msg_deserialize(input, sizeof(input), &arena, &msg);
+        if (r != (ssize_t) sizeof(input)) {
+            sc_arena_destroy(&arena);
+            return false;
+        }
+        bench_do_not_optimize(msg.clipboard.text);
+        sc_arena_reset(&arena);
+    }
+    result->duration = sc_tick_now() - start;
+    result->iterations = iterations;
+
+    sc_arena_destroy(&arena);
+    return true;
+}
+
+struct bench_packet_counter {
+    struct sc_packet_sink packet_sink; // packet sink trait
+    uint64_t packets;
+};
+
+static bool
+bench_packet_counter_open(struct sc_packet_sink *sink, AVCodecContext *ctx) {
+    (void) sink;
+    (void) ctx;
+    return true;
+}
+
+static void
+bench_packet_counter_close(struct sc_packet_sink *sink) {
+    (void) sink;
+}
+
+static bool
+bench_packet_counter_push(struct sc_packet_sink *sink,
+                          const AVPacket *packet) {
+    (void) packet;
+    struct bench_packet_counter *counter =
+        container_of(sink, struct bench_packet_counter, packet_sink);
+    ++counter->packets;
+    return true;
+}
+
+struct bench_frame_counter {
+    struct sc_frame_sink frame_sink; // frame sink trait
+    uint64_t frames;
+};
+
+static bool
+bench_frame_counter_open(struct sc_frame_sink *sink,
+                         const AVCodecContext *ctx) {
+    (void) sink;
+    (void) ctx;
+    return true;
+}
+
+static void
+bench_frame_counter_close(struct sc_frame_sink *sink) {
+    (void) sink;
+}
+
+static bool
+bench_frame_counter_push(struct sc_frame_sink *sink, const AVFrame *frame) {
+    (void) frame;
+    struct bench_frame_counter *counter =
+        container_of(sink, struct bench_frame_counter, frame_sink);
+    ++counter->frames;
+    return true;
+}
+
+static void
+bench_on_demuxer_ended(struct sc_demuxer *demuxer,
+                       enum sc_demuxer_status status, void *userdata) {
+    (void) demuxer;
+    enum sc_demuxer_status *result = userdata;
+    *result = status;
+}
+
+// Write a synthetic H.264 stream, exactly as the demuxer would have received
+// it from the socket
+static bool
+bench_write_stream(uint64_t packets) {
+    struct sc_stream_dumper dumper;
+    if (!sc_stream_dumper_init(&dumper, BENCH_DUMP_DIR, BENCH_DUMP_NAME)) {
+        return false;
+    }
+
+    uint8_t data[BENCH_PACKET_HEADER_SIZE + 16384];
+    memset(data, 0x42, sizeof(data));
+
+    sc_write32be(data, UINT32_C(0x68323634)); // "h264"
+    sc_stream_dumper_write(&dumper, data, 4);
+    sc_write32be(data, 1920);
+    sc_write32be(&data[4], 1080);
+    sc_stream_dumper_write(&dumper, data, 8);
+
+    for (uint64_t i = 0; i <= packets; ++i) {
+        uint64_t pts_flags;
+        uint32_t len;
+        if (!i) {
+            pts_flags = BENCH_PACKET_FLAG_CONFIG;
+            len = 32;
+        } else {
+            pts_flags = i * 16666;
+            if (i % 60 == 1) {
+                pts_flags |= BENCH_PACKET_FLAG_KEY_FRAME;
+            }
+            // Deterministic sizes, from 4 KB to 16 KB
+            len = 4096 + (i * 7919) % 12288;
+        }
+
+        sc_write64be(data, pts_flags);
+        sc_write32be(&data[8], len);
+        // Like the demuxer, which reads the header then the payload
+        sc_stream_dumper_write(&dumper, data, BENCH_PACKET_HEADER_SIZE);
+        sc_stream_dumper_write(&dumper, &data[BENCH_PACKET_HEADER_SIZE], len);
+    }
+
+    bool ok = !dumper.failed;
+    sc_stream_dumper_destroy(&dumper);
+    return ok;
+}
+
+static bool
+bench_demuxer(struct bench_result *result) {
+    const uint64_t packets = 5000;
+
+    if (!bench_write_stream(packets)) {
+        return false;
+    }
+
+    bool ret = false;
+
+    struct sc_stream_replayer replayer;
+    if (!sc_stream_replayer_init(&replayer, BENCH_DUMP_DIR, BENCH_DUMP_NAME,
+                                 true)) {
+        goto end;
+    }
+
+    static const struct sc_demuxer_callbacks cbs = {
+        .on_ended = bench_on_demuxer_ended,
+    };
+    enum sc_demuxer_status status = SC_DEMUXER_STATUS_ERROR;
+
+    struct sc_demuxer demuxer;
+    if (!sc_demuxer_init_replay(&demuxer, "bench", &replayer, 0, NULL, &cbs,
+                                &status)) {
+        goto end_destroy_replayer;
+    }
+
+    static const struct sc_packet_sink_ops ops = {
+        .open = bench_packet_counter_open,
+        .close = bench_packet_counter_close,
+        .push = bench_packet_counter_push,
+    };
+    struct bench_packet_counter counter = {
+        .packet_sink.ops = &ops,
+        .packets = 0,
+    };
+    if (!sc_packet_source_add_sink(&demuxer.packet_source,
+                                   &counter.packet_sink)) {
+        goto end_destroy_demuxer;
+    }
+
+    sc_tick start = sc_tick_now();
+    if (!sc_demuxer_start(&demuxer)) {
+        goto end_destroy_demuxer;
+    }
+    sc_demuxer_join(&demuxer);
+    result->duration = sc_tick_now() - start;
+    result->iterations = counter.packets;
+
+    // The config packet is merged into the first media packet
+    ret = status == SC_DEMUXER_STATUS_EOS && counter.packets == packets + 1;
+    if (!ret) {
+        LOGE("Unexpected demuxer result: %" PRIu64_ " packets",
+             counter.packets);
+    }
+
+end_destroy_demuxer:
+    sc_demuxer_destroy(&demuxer);
+end_destroy_replayer:
+    sc_stream_replayer_destroy(&replayer);
+end:
+    remove(BENCH_DUMP_DIR "/" BENCH_DUMP_NAME ".stream");
+    return ret;
+}
+
+static bool
+bench_replay(struct bench_result *result, const char *dump_dir) {
+    bool ret = false;
+
+    struct sc_stream_replayer replayer;
+    if (!sc_stream_replayer_init(&replayer, dump_dir, "video", true)) {
+        return false;
+    }
+
+    static const struct sc_demuxer_callbacks cbs = {
+        .on_ended = bench_on_demuxer_ended,
+    };
+    enum sc_demuxer_status status = SC_DEMUXER_STATUS_ERROR;
+
+    struct sc_demuxer demuxer;
+    if (!sc_demuxer_init_replay(&demuxer, "video", &replayer, 0, NULL, &cbs,
+                                &status)) {
+        goto end_destroy_replayer;
+    }
+
+    struct sc_decoder decoder;
+    if (!sc_decoder_init(&decoder, "video", NULL)) {
+        goto end_destroy_demuxer;
+    }
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = bench_frame_counter_open,
+        .close = bench_frame_counter_close,
+        .push = bench_frame_counter_push,
+    };
+    struct bench_frame_counter counter = {
+        .frame_sink.ops = &ops,
+        .frames = 0,
+    };
+    if (!sc_frame_source_add_sink(&decoder.frame_source, &counter.frame_sink)
+            || !sc_packet_source_add_sink(&demuxer.packet_source,
+                                          &decoder.packet_sink)) {
+        goto end_destroy_decoder;
+    }
+
+    sc_tick start = sc_tick_now();
+    if (!sc_demuxer_start(&demuxer)) {
+        goto end_destroy_decoder;
+    }
+    sc_demuxer_join(&demuxer);
+    result->duration = sc_tick_now() - start;
+    result->iterations = counter.frames;
+
+    ret = status == SC_DEMUXER_STATUS_EOS;
+
+end_destroy_decoder:
+    sc_decoder_destroy(&decoder);
+end_destroy_demuxer:
+    sc_demuxer_destroy(&demuxer);
+end_destroy_replayer:
+    sc_stream_replayer_destroy(&replayer);
+    return ret;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [<stream dump dir>]\n", argv[0]);
+        return 1;
+    }
+    const char *dump_dir = argc == 2 ? argv[1] : NULL;
+
+    sc_set_log_level(SC_LOG_LEVEL_WARN);
+    sc_startup_timeline_init();
+
+    static const struct {
+        const char *name;
+        bool (*run)(struct bench_result *result);
+    } benchmarks[] = {
+        {"packet_merger_merge", bench_packet_merger},
+        {"frame_buffer_push_consume", bench_frame_buffer},
+        {"audiobuf_write_read", bench_audiobuf},
+        {"control_msg_serialize", bench_control_msg_serialize},
+        {"device_msg_deserialize", bench_device_msg_deserialize},
+        {"demuxer_recv_packet", bench_demuxer},
+    };
+
+    bool ok = true;
+
+    printf("{\n  \"version\": 1,\n  \"benchmarks\": [");
+    for (size_t i = 0; i < ARRAY_LEN(benchmarks); ++i) {
+        struct bench_result result = {.name = benchmarks[i].name};
+        if (!benchmarks[i].run(&result)) {
+            LOGE("Benchmark '%s' failed", result.name);
+            ok = false;
+            result.failed = true;
+        }
+        bench_report(&result);
+    }
+
+    struct bench_result result = {.name = "replay_video_decode"};
+    if (dump_dir) {
+        if (!bench_replay(&result, dump_dir)) {
+            LOGE("Benchmark '%s' failed", result.name);
+            ok = false;
+            result.failed = true;
+        }
+    } else {
+        result.skipped = true;
+    }
+    bench_report(&result);
+
+    printf("\n  ]\n}\n");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+#ifndef SC_FUZZ_H
+#define SC_FUZZ_H
+
+#include "common.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Fuzz targets, using the libFuzzer interface
+ *
+ * With clang, they are linked to libFuzzer (-fsanitize=fuzzer). Otherwise,
+ * they are linked to a standalone driver (fuzz_main.c), which only replays and
+ * times the given inputs.
+ */
+
+// Called once before the first input (optional for libFuzzer)
+int
+LLVMFuzzerInitialize(int *argc, char ***argv);
+
+// Must not keep any state between calls
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+#endif
@@ -0,0 +1,85 @@
+#include "fuzz.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_log.h>
+
+#include "control_msg.h"
+
+static uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+
+int
+LLVMFuzzerInitialize(int *argc, char ***argv) {
+    (void) argc;
+    (void) argv;
+    // Invalid inputs are expected, do not flood the output
+    SDL_LogSetAllPriority(SDL_LOG_PRIORITY_CRITICAL);
+    return 0;
+}
+
+static void
+serialize_text(enum sc_control_msg_type type, const uint8_t *data,
+               size_t size) {
+    // The input as a (possibly invalid or too long) UTF-8 string
+    char *text = malloc(size + 1);
+    if (!text) {
+        return;
+    }
+    memcpy(text, data, size);
+    text[size] = '\0';
+
+    struct sc_control_msg msg;
+    msg.type = type;
+    if (type == SC_CONTROL_MSG_TYPE_INJECT_TEXT) {
+        msg.inject_text.text = text;
+    } else {
+        assert(type == SC_CONTROL_MSG_TYPE_SET_CLIPBOARD);
+        msg.set_clipboard.sequence = 0;
+        msg.set_clipboard.text = text;
+        msg.set_clipboard.paste = false;
+    }
+
+    size_t len = sc_control_msg_serialize(&msg, buf);
+    assert(len <= SC_CONTROL_MSG_MAX_SIZE);
+    (void) len;
+
+    free(text);
+}
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    // The input is a stream of messages, deserialized as the recorded input
+    // events are replayed, then serialized back
+    const uint8_t *p = data;
+    size_t remaining = size;
+    for (;;) {
+        struct sc_control_msg msg;
+        ssize_t r = sc_control_msg_deserialize(p, remaining, &msg);
+        if (r <= 0) {
+            break;
+        }
+        assert((size_t) r <= remaining);
+
+        // The text is truncated at the first '\0' on serialization
+        bool exact = msg.type != SC_CONTROL_MSG_TYPE_INJECT_TEXT
+                  || (size_t) r == 5 + strlen(msg.inject_text.text);
+
+        size_t len = sc_control_msg_serialize(&msg, buf);
+        if (exact) {
+            // deserialize() is the inverse of serialize()
+            assert(len == (size_t) r);
+            assert(!memcmp(buf, p, len));
+        }
+        (void) len;
+
+        sc_control_msg_destroy(&msg);
+        p += r;
+        remaining -= r;
+    }
+
+    serialize_text(SC_CONTROL_MSG_TYPE_INJECT_TEXT, data, size);
+    serialize_text(SC_CONTROL_MSG_TYPE_SET_CLIPBOARD, data, size);
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+#include "fuzz.h"
+
+#include <assert.h>
+#include <SDL2/SDL_log.h>
+
+#include "device_msg.h"
+#include "util/memory.h"
+
+// Reset (not reallocated) between inputs, like the receiver does
+static struct sc_arena arena;
+
+int
+LLVMFuzzerInitialize(int *argc, char ***argv) {
+    (void) argc;
+    (void) argv;
+    // Invalid inputs are expected, do not flood the output
+    SDL_LogSetAllPriority(SDL_LOG_PRIORITY_CRITICAL);
+    sc_arena_init(&arena, 4096);
+    return 0;
+}
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    // The input is a stream of messages, as received from the device socket
+    const uint8_t *p = data;
+    size_t remaining = size;
+    for (;;) {
+        struct sc_device_msg msg;
+        ssize_t r = sc_device_msg_deserialize(p, remaining, &arena, &msg);
+        if (r <= 0) {
+            break;
+        }
+        assert((size_t) r <= remaining);
+        p += r;
+        remaining -= r;
+    }
+
+    sc_arena_reset(&arena);
+    return 0;
+}
@@ -0,0 +1,159 @@
+// Standalone driver for the fuzz targets, when libFuzzer is not available
+//
+// It does not generate any input: it replays the given files (or the files in
+// the given directories, e.g. a corpus produced by libFuzzer) and reports the
+// throughput and the slowest input, to catch performance regressions of the
+// codecs.
+//
+// Usage: fuzz_xxx [-runs=<n>] <file or directory>...
+
+#include "fuzz.h"
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+static struct {
+    unsigned runs; // per input
+    unsigned inputs;
+    uint64_t total_ns;
+    uint64_t slowest_ns; // per run
+    char slowest_path[1024];
+    size_t slowest_size;
+} stats;
+
+static uint64_t
+now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static bool
+run_file(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return false;
+    }
+
+    uint8_t *data = NULL;
+    size_t size = 0;
+    size_t cap = 0;
+    for (;;) {
+        if (size == cap) {
+            cap = cap ? cap * 2 : 4096;
+            uint8_t *p = realloc(data, cap);
+            if (!p) {
+                fprintf(stderr, "Out of memory\n");
+                free(data);
+                fclose(file);
+                return false;
+            }
+            data = p;
+        }
+        size_t r = fread(data + size, 1, cap - size, file);
+        if (!r) {
+            break;
+        }
+        size += r;
+    }
+    fclose(file);
+
+    uint64_t start = now_ns();
+    for (unsigned i = 0; i < stats.runs; ++i) {
+        LLVMFuzzerTestOneInput(data, size);
+    }
+    uint64_t duration = now_ns() - start;
+
+    uint64_t per_run = duration / stats.runs;
+    if (!stats.inputs || per_run > stats.slowest_ns) {
+        stats.slowest_ns = per_run;
+        snprintf(stats.slowest_path, sizeof(stats.slowest_path), "%s", path);
+        stats.slowest_size = size;
+    }
+    stats.total_ns += duration;
+    ++stats.inputs;
+
+    free(data);
+    return true;
+}
+
+static bool
+run_path(const char *path) {
+    struct stat st;
+    if (stat(path, &st)) {
+        fprintf(stderr, "Could not stat %s\n", path);
+        return false;
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+        return run_file(path);
+    }
+
+    DIR *dir = opendir(path);
+    if (!dir) {
+        fprintf(stderr, "Could not open directory %s\n", path);
+        return false;
+    }
+
+    bool ok = true;
+    struct dirent *entry;
+    while (ok && (entry = readdir(dir))) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        char child[1024];
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        ok = run_path(child);
+    }
+
+    closedir(dir);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    LLVMFuzzerInitialize(&argc, &argv);
+
+    stats.runs = 1000;
+
+    int i = 1;
+    if (i < argc && !strncmp(argv[i], "-runs=", 6)) {
+        stats.runs = strtoul(argv[i] + 6, NULL, 10);
+        if (!stats.runs) {
+            fprintf(stderr, "Invalid number of runs: %s\n", argv[i] + 6);
+            return 1;
+        }
+        ++i;
+    }
+
+    if (i == argc) {
+        fprintf(stderr, "Usage: %s [-runs=<n>] <file or directory>...\n",
+                argv[0]);
+        return 1;
+    }
+
+    for (; i < argc; ++i) {
+        if (!run_path(argv[i])) {
+            return 1;
+        }
+    }
+
+    if (!stats.inputs) {
+        fprintf(stderr, "No input\n");
+        return 1;
+    }
+
+    uint64_t execs = (uint64_t) stats.inputs * stats.runs;
+    printf("%u inputs, %" PRIu64 " execs in %" PRIu64 " ms (%" PRIu64
+           " exec/s)\n", stats.inputs, execs, stats.total_ns / 1000000,
+           execs * 1000000000 / (stats.total_ns ? stats.total_ns : 1));
+    printf("slowest: %s (%zu bytes, %" PRIu64 " ns/exec)\n",
+           stats.slowest_path, stats.slowest_size, stats.slowest_ns);
+    return 0;
+}
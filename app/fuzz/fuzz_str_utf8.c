@@ -0,0 +1,48 @@
+#include "fuzz.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/str.h"
+
+int
+LLVMFuzzerInitialize(int *argc, char ***argv) {
+    (void) argc;
+    (void) argv;
+    return 0;
+}
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    if (size < 2) {
+        return 0;
+    }
+
+    // The first 2 bytes are the max length, the remaining ones the string
+    size_t max_len = (data[0] << 8) | data[1];
+    data += 2;
+    size -= 2;
+
+    char *s = malloc(size + 1);
+    if (!s) {
+        return 0;
+    }
+    memcpy(s, data, size);
+    s[size] = '\0';
+
+    size_t len = sc_str_utf8_truncation_index(s, max_len);
+    size_t full_len = strlen(s);
+    assert(len <= max_len);
+    assert(len <= full_len);
+    if (full_len <= max_len) {
+        assert(len == full_len);
+    } else {
+        // Never cut before a continuation byte (unless there is no start byte
+        // at all, in which case the result is empty)
+        assert(!len || (s[len] & 0xc0) != 0x80);
+    }
+
+    free(s);
+    return 0;
+}
@@ -6,6 +6,8 @@
 #include <string.h>
 
 #include "adb_device.h"
+#include "adb_devices_cache.h"
+#include "adb_host.h"
 #include "adb_parser.h"
 #include "util/file.h"
 #include "util/log.h"
@@ -169,7 +171,7 @@ process_check_success_intr(struct sc_intr *intr, sc_pid pid, const char *name,
     return ret;
 }
 
-static sc_pid
+sc_pid
 sc_adb_execute_p(const char *const argv[], unsigned flags, sc_pipe *pout) {
     unsigned process_flags = 0;
     if (flags & SC_ADB_NO_STDOUT) {
@@ -199,6 +201,11 @@ sc_adb_execute(const char *const argv[], unsigned flags) {
 
 bool
 sc_adb_start_server(struct sc_intr *intr, unsigned flags) {
+    if (sc_adb_host_is_available(intr)) {
+        // Already started
+        return true;
+    }
+
     const char *const argv[] = SC_ADB_COMMAND("start-server");
 
     sc_pid pid = sc_adb_execute(argv, flags);
@@ -230,6 +237,18 @@ sc_adb_forward(struct sc_intr *intr, const char *serial, uint16_t local_port,
     }
 
     assert(serial);
+
+    char request[256];
+    r = snprintf(request, sizeof(request), "host-serial:%s:forward:%s;%s",
+                 serial, local, remote);
+    if (r >= 0 && (size_t) r < sizeof(request)) {
+        enum sc_adb_host_result res =
+            sc_adb_host_command(intr, request, !(flags & SC_ADB_NO_LOGERR));
+        if (res != SC_ADB_HOST_UNAVAILABLE) {
+            return res == SC_ADB_HOST_OK;
+        }
+    }
+
     const char *const argv[] =
         SC_ADB_COMMAND("-s", serial, "forward", local, remote);
 
@@ -243,9 +262,20 @@ sc_adb_forward_remove(struct sc_intr *intr, const char *serial,
     char local[4 + 5 + 1]; // tcp:PORT
     int r = snprintf(local, sizeof(local), "tcp:%" PRIu16, local_port);
     assert(r >= 0 && (size_t) r < sizeof(local));
-    (void) r;
 
     assert(serial);
+
+    char request[256];
+    r = snprintf(request, sizeof(request), "host-serial:%s:killforward:%s",
+                 serial, local);
+    if (r >= 0 && (size_t) r < sizeof(request)) {
+        enum sc_adb_host_result res =
+            sc_adb_host_command(intr, request, !(flags & SC_ADB_NO_LOGERR));
+        if (res != SC_ADB_HOST_UNAVAILABLE) {
+            return res == SC_ADB_HOST_OK;
+        }
+    }
+
     const char *const argv[] =
         SC_ADB_COMMAND("-s", serial, "forward", "--remove", local);
 
@@ -270,6 +300,19 @@ sc_adb_reverse(struct sc_intr *intr, const char *serial,
     }
 
     assert(serial);
+
+    char request[256];
+    r = snprintf(request, sizeof(request), "reverse:forward:%s;%s", remote,
+                 local);
+    if (r >= 0 && (size_t) r < sizeof(request)) {
+        enum sc_adb_host_result res =
+            sc_adb_host_device_command(intr, serial, request,
+                                       !(flags & SC_ADB_NO_LOGERR));
+        if (res != SC_ADB_HOST_UNAVAILABLE) {
+            return res == SC_ADB_HOST_OK;
+        }
+    }
+
     const char *const argv[] =
         SC_ADB_COMMAND("-s", serial, "reverse", remote, local);
 
@@ -289,6 +332,18 @@ sc_adb_reverse_remove(struct sc_intr *intr, const char *serial,
     }
 
     assert(serial);
+
+    char request[256];
+    r = snprintf(request, sizeof(request), "reverse:killforward:%s", remote);
+    if (r >= 0 && (size_t) r < sizeof(request)) {
+        enum sc_adb_host_result res =
+            sc_adb_host_device_command(intr, serial, request,
+                                       !(flags & SC_ADB_NO_LOGERR));
+        if (res != SC_ADB_HOST_UNAVAILABLE) {
+            return res == SC_ADB_HOST_OK;
+        }
+    }
+
     const char *const argv[] =
         SC_ADB_COMMAND("-s", serial, "reverse", "--remove", remote);
 
@@ -296,6 +351,37 @@ sc_adb_reverse_remove(struct sc_intr *intr, const char *serial,
     return process_check_success_intr(intr, pid, "adb reverse --remove", flags);
 }
 
+bool
+sc_adb_has_reverse(struct sc_intr *intr, const char *serial,
+                   const char *device_socket_name, uint16_t local_port,
+                   unsigned flags) {
+    char local[4 + 5 + 1]; // tcp:PORT
+    char remote[108 + 14 + 1]; // localabstract:NAME
+    int r = snprintf(local, sizeof(local), "tcp:%" PRIu16, local_port);
+    assert(r >= 0 && (size_t) r < sizeof(local));
+
+    r = snprintf(remote, sizeof(remote), "localabstract:%s",
+                 device_socket_name);
+    if (r < 0 || (size_t) r >= sizeof(remote)) {
+        LOGE("Device socket name too long");
+        return false;
+    }
+
+    assert(serial);
+
+    // On the device side, the "local" part of a reverse tunnel is the device
+    // socket
+    char list[4096];
+    enum sc_adb_host_result res =
+        sc_adb_host_device_query(intr, serial, "reverse:list-forward", list,
+                                 sizeof(list), !(flags & SC_ADB_NO_LOGERR));
+    if (res != SC_ADB_HOST_OK) {
+        return false;
+    }
+
+    return sc_adb_parse_has_tunnel(list, remote, local);
+}
+
 bool
 sc_adb_push(struct sc_intr *intr, const char *serial, const char *local,
             const char *remote, unsigned flags) {
@@ -327,6 +413,58 @@ sc_adb_push(struct sc_intr *intr, const char *serial, const char *local,
     return process_check_success_intr(intr, pid, "adb push", flags);
 }
 
+bool
+sc_adb_push_files(struct sc_intr *intr, const char *serial,
+                  const char *const *locals, size_t count, const char *remote,
+                  unsigned flags) {
+    assert(serial);
+    assert(count);
+
+    // adb -s <serial> push <locals...> <remote> NULL
+    size_t argc = 4 + count + 1;
+    const char **argv = malloc((argc + 1) * sizeof(*argv));
+    if (!argv) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = false;
+
+    argv[0] = sc_adb_get_executable();
+    argv[1] = "-s";
+    argv[2] = serial;
+    argv[3] = "push";
+#ifdef __WINDOWS__
+    // Windows will parse the string, so the paths must be quoted
+    // (see sys/win/command.c)
+    size_t quoted = 0;
+    for (; quoted < count + 1; ++quoted) {
+        const char *path = quoted < count ? locals[quoted] : remote;
+        argv[4 + quoted] = sc_str_quote(path);
+        if (!argv[4 + quoted]) {
+            goto end;
+        }
+    }
+#else
+    memcpy(&argv[4], locals, count * sizeof(*argv));
+    argv[4 + count] = remote;
+#endif
+    argv[argc] = NULL;
+
+    sc_pid pid = sc_adb_execute(argv, flags);
+    ok = process_check_success_intr(intr, pid, "adb push", flags);
+
+#ifdef __WINDOWS__
+end:
+    for (size_t i = 0; i < quoted; ++i) {
+        free((void *) argv[4 + i]);
+    }
+#endif
+    free(argv);
+
+    return ok;
+}
+
 bool
 sc_adb_install(struct sc_intr *intr, const char *serial, const char *local,
                unsigned flags) {
@@ -430,45 +568,55 @@ sc_adb_list_devices(struct sc_intr *intr, unsigned flags,
         return false;
     }
 
+    // The reply of the adb server does not contain the header printed by
+    // "adb devices -l", expected by the parser
+#define DEVICES_HEADER "List of devices attached\n"
+#define DEVICES_HEADER_LEN (sizeof(DEVICES_HEADER) - 1)
+    memcpy(buf, DEVICES_HEADER, DEVICES_HEADER_LEN);
+    enum sc_adb_host_result res =
+        sc_adb_host_query(intr, "host:devices-l", &buf[DEVICES_HEADER_LEN],
+                          BUFSIZE - DEVICES_HEADER_LEN,
+                          !(flags & SC_ADB_NO_LOGERR));
+    if (res != SC_ADB_HOST_UNAVAILABLE) {
+        bool ok = res == SC_ADB_HOST_OK && sc_adb_parse_devices(buf, out_vec);
+        free(buf);
+        return ok;
+    }
+
+    // The reply of the adb server is bounded (its length is prefixed by 4 hex
+    // digits), but the output of "adb devices -l" is not: parse it while it
+    // is read, whatever the number of devices
+    free(buf);
+
     sc_pipe pout;
     sc_pid pid = sc_adb_execute_p(argv, flags, &pout);
     if (pid == SC_PROCESS_NONE) {
         LOGE("Could not execute \"adb devices -l\"");
-        free(buf);
         return false;
     }
 
-    ssize_t r = sc_pipe_read_all_intr(intr, pid, pout, buf, BUFSIZE - 1);
-    sc_pipe_close(pout);
+    // List all devices to the output list directly
+    struct sc_adb_devices_parser parser;
+    sc_adb_devices_parser_init(&parser, out_vec);
 
-    bool ok = process_check_success_intr(intr, pid, "adb devices -l", flags);
-    if (!ok) {
-        free(buf);
-        return false;
-    }
-
-    if (r == -1) {
-        free(buf);
-        return false;
+    char chunk[4096];
+    ssize_t r;
+    while ((r = sc_pipe_read_intr(intr, pid, pout, chunk, sizeof(chunk))) > 0) {
+        sc_adb_devices_parser_push(&parser, chunk, r);
     }
+    sc_pipe_close(pout);
 
-    assert((size_t) r < BUFSIZE);
-    if (r == BUFSIZE - 1)  {
-        // The implementation assumes that the output of "adb devices -l" fits
-        // in the buffer in a single pass
-        LOGW("Result of \"adb devices -l\" does not fit in 64Kb. "
-             "Please report an issue.");
-        free(buf);
+    bool ok = process_check_success_intr(intr, pid, "adb devices -l", flags)
+           && r != -1
+           && sc_adb_devices_parser_finish(&parser);
+    if (!ok) {
+        // Do not return a partial list
+        sc_adb_devices_destroy(out_vec);
+        *out_vec = (struct sc_vec_adb_devices) SC_VECTOR_INITIALIZER;
         return false;
     }
 
-    // It is parsed as a NUL-terminated string
-    buf[r] = '\0';
-
-    // List all devices to the output list directly
-    ok = sc_adb_parse_devices(buf, out_vec);
-    free(buf);
-    return ok;
+    return true;
 }
 
 static bool
@@ -573,12 +721,25 @@ sc_adb_device_check_state(struct sc_adb_device *device,
 bool
 sc_adb_select_device(struct sc_intr *intr,
                      const struct sc_adb_device_selector *selector,
-                     unsigned flags, struct sc_adb_device *out_device) {
+                     const char *devices_cache, unsigned flags,
+                     struct sc_adb_device *out_device) {
     struct sc_vec_adb_devices vec = SC_VECTOR_INITIALIZER;
-    bool ok = sc_adb_list_devices(intr, flags, &vec);
-    if (!ok) {
-        LOGE("Could not list ADB devices");
-        return false;
+    bool ok = devices_cache
+           && sc_adb_devices_cache_load(devices_cache,
+                                        SC_ADB_DEVICES_CACHE_TTL, &vec);
+    if (ok) {
+        LOGD("Using the cached list of devices: %s", devices_cache);
+    } else {
+        ok = sc_adb_list_devices(intr, flags, &vec);
+        if (!ok) {
+            LOGE("Could not list ADB devices");
+            return false;
+        }
+
+        if (devices_cache) {
+            // Ignore failures, the cache is just an optimization
+            sc_adb_devices_cache_save(devices_cache, vec.data, vec.size);
+        }
     }
 
     if (vec.size == 0) {
@@ -663,10 +824,35 @@ sc_adb_select_device(struct sc_intr *intr,
     return true;
 }
 
+static char *
+getprop_value(char *output) {
+    size_t len = strcspn(output, " \r\n");
+    output[len] = '\0';
+
+    return strdup(output);
+}
+
 char *
 sc_adb_getprop(struct sc_intr *intr, const char *serial, const char *prop,
                unsigned flags) {
     assert(serial);
+
+    char buf[128];
+
+    char command[128];
+    int ret = snprintf(command, sizeof(command), "getprop %s", prop);
+    if (ret >= 0 && (size_t) ret < sizeof(command)) {
+        enum sc_adb_host_result res =
+            sc_adb_host_shell(intr, serial, command, buf, sizeof(buf),
+                              !(flags & SC_ADB_NO_LOGERR));
+        if (res == SC_ADB_HOST_FAIL) {
+            return NULL;
+        }
+        if (res == SC_ADB_HOST_OK) {
+            return getprop_value(buf);
+        }
+    }
+
     const char *const argv[] =
         SC_ADB_COMMAND("-s", serial, "shell", "getprop", prop);
 
@@ -677,7 +863,6 @@ sc_adb_getprop(struct sc_intr *intr, const char *serial, const char *prop,
         return NULL;
     }
 
-    char buf[128];
     ssize_t r = sc_pipe_read_all_intr(intr, pid, pout, buf, sizeof(buf) - 1);
     sc_pipe_close(pout);
 
@@ -692,8 +877,39 @@ sc_adb_getprop(struct sc_intr *intr, const char *serial, const char *prop,
 
     assert((size_t) r < sizeof(buf));
     buf[r] = '\0';
-    size_t len = strcspn(buf, " \r\n");
-    buf[len] = '\0';
+
+    return getprop_value(buf);
+}
+
+char *
+sc_adb_shell(struct sc_intr *intr, const char *serial, const char *command,
+             unsigned flags) {
+    assert(serial);
+    const char *const argv[] =
+        SC_ADB_COMMAND("-s", serial, "shell", command);
+
+    sc_pipe pout;
+    sc_pid pid = sc_adb_execute_p(argv, flags, &pout);
+    if (pid == SC_PROCESS_NONE) {
+        LOGE("Could not execute \"adb shell\"");
+        return NULL;
+    }
+
+    char buf[1024];
+    ssize_t r = sc_pipe_read_all_intr(intr, pid, pout, buf, sizeof(buf) - 1);
+    sc_pipe_close(pout);
+
+    bool ok = process_check_success_intr(intr, pid, "adb shell", flags);
+    if (!ok) {
+        return NULL;
+    }
+
+    if (r == -1) {
+        return NULL;
+    }
+
+    assert((size_t) r < sizeof(buf));
+    buf[r] = '\0';
 
     return strdup(buf);
 }
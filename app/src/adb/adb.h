@@ -33,6 +33,12 @@ struct sc_adb_device_selector {
 sc_pid
 sc_adb_execute(const char *const argv[], unsigned flags);
 
+/**
+ * Execute an adb command, with its stdout redirected to `pout` (if not NULL)
+ */
+sc_pid
+sc_adb_execute_p(const char *const argv[], unsigned flags, sc_pipe *pout);
+
 bool
 sc_adb_start_server(struct sc_intr *intr, unsigned flags);
 
@@ -56,10 +62,33 @@ bool
 sc_adb_reverse_remove(struct sc_intr *intr, const char *serial,
                       const char *device_socket_name, unsigned flags);
 
+/**
+ * Indicate if an "adb reverse" tunnel from the device socket to the local port
+ * is enabled
+ *
+ * It only queries the adb server directly: if it is not reachable, it returns
+ * false (executing `adb reverse --list` would cost as much as enabling the
+ * tunnel again).
+ */
+bool
+sc_adb_has_reverse(struct sc_intr *intr, const char *serial,
+                   const char *device_socket_name, uint16_t local_port,
+                   unsigned flags);
+
 bool
 sc_adb_push(struct sc_intr *intr, const char *serial, const char *local,
             const char *remote, unsigned flags);
 
+/**
+ * Execute `adb push <local1> <local2>... <remote>`
+ *
+ * All the files are transferred by a single adb process (and sync session).
+ */
+bool
+sc_adb_push_files(struct sc_intr *intr, const char *serial,
+                  const char *const *locals, size_t count, const char *remote,
+                  unsigned flags);
+
 bool
 sc_adb_install(struct sc_intr *intr, const char *serial, const char *local,
                unsigned flags);
@@ -91,12 +120,16 @@ sc_adb_disconnect(struct sc_intr *intr, const char *ip_port, unsigned flags);
 /**
  * Execute `adb devices` and parse the result to select a device
  *
+ * If `devices_cache` is not NULL, the list of devices is read from this file
+ * if it is recent enough, and written to it otherwise.
+ *
  * Return true if a single matching device is found, and write it to out_device.
  */
 bool
 sc_adb_select_device(struct sc_intr *intr,
                      const struct sc_adb_device_selector *selector,
-                     unsigned flags, struct sc_adb_device *out_device);
+                     const char *devices_cache, unsigned flags,
+                     struct sc_adb_device *out_device);
 
 /**
  * Execute `adb getprop <prop>`
@@ -105,6 +138,19 @@ char *
 sc_adb_getprop(struct sc_intr *intr, const char *serial, const char *prop,
                unsigned flags);
 
+/**
+ * Execute `adb shell <command>` and return its output
+ *
+ * The command is interpreted by the device shell. It must not contain quotes
+ * (the arguments are not escaped on Windows).
+ *
+ * Return the output (truncated to 1023 bytes) as a string to be freed by the
+ * caller, or NULL on error or if the command failed.
+ */
+char *
+sc_adb_shell(struct sc_intr *intr, const char *serial, const char *command,
+             unsigned flags);
+
 /**
  * Attempt to retrieve the device IP
  *
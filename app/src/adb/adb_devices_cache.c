@@ -0,0 +1,143 @@
+#include "adb_devices_cache.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adb_parser.h"
+#include "util/log.h"
+#include "util/rand.h"
+
+// The first line contains the timestamp (sc_tick) of the list, the following
+// lines use the format of "adb devices -l" (so that they are parsed by the
+// same parser)
+#define SC_ADB_DEVICES_CACHE_MAGIC "scrcpy-devices-cache "
+
+static bool
+sc_adb_devices_cache_read_timestamp(FILE *file, sc_tick *timestamp) {
+    char line[64];
+    if (!fgets(line, sizeof(line), file)) {
+        return false;
+    }
+
+#define MAGIC_LEN (sizeof(SC_ADB_DEVICES_CACHE_MAGIC) - 1)
+    if (strncmp(line, SC_ADB_DEVICES_CACHE_MAGIC, MAGIC_LEN)) {
+        return false;
+    }
+
+    char *endptr;
+    long long value = strtoll(&line[MAGIC_LEN], &endptr, 10);
+    if (endptr == &line[MAGIC_LEN] || *endptr != '\n') {
+        return false;
+    }
+
+    *timestamp = value;
+    return true;
+}
+
+bool
+sc_adb_devices_cache_load(const char *path, sc_tick ttl,
+                          struct sc_vec_adb_devices *out_vec) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        // Not an error, the cache may not exist yet
+        return false;
+    }
+
+    sc_tick timestamp;
+    bool ok = sc_adb_devices_cache_read_timestamp(file, &timestamp);
+    if (!ok) {
+        LOGW("Invalid devices cache: %s", path);
+        fclose(file);
+        return false;
+    }
+
+    sc_tick now = sc_tick_now();
+    if (timestamp > now || now - timestamp >= ttl) {
+        // Expired (or written before a reboot)
+        fclose(file);
+        return false;
+    }
+
+    struct sc_adb_devices_parser parser;
+    sc_adb_devices_parser_init(&parser, out_vec);
+
+    char chunk[4096];
+    size_t r;
+    while ((r = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        sc_adb_devices_parser_push(&parser, chunk, r);
+    }
+
+    ok = !ferror(file) && sc_adb_devices_parser_finish(&parser);
+    fclose(file);
+
+    if (!ok) {
+        LOGW("Invalid devices cache: %s", path);
+        sc_adb_devices_destroy(out_vec);
+        *out_vec = (struct sc_vec_adb_devices) SC_VECTOR_INITIALIZER;
+        return false;
+    }
+
+    return true;
+}
+
+bool
+sc_adb_devices_cache_save(const char *path,
+                          const struct sc_adb_device *devices, size_t count) {
+    // Several instances may write the cache concurrently, so the temporary
+    // file must be unique
+    struct sc_rand rand;
+    sc_rand_init(&rand);
+
+    char *tmp_path;
+    int r = asprintf(&tmp_path, "%s.%08" PRIx32 ".tmp", path,
+                     sc_rand_u32(&rand));
+    if (r == -1) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = false;
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file) {
+        LOGW("Could not open devices cache: %s", tmp_path);
+        goto end;
+    }
+
+    bool written = fprintf(file, SC_ADB_DEVICES_CACHE_MAGIC "%" PRItick "\n"
+                                 "List of devices attached\n",
+                           sc_tick_now()) > 0;
+    for (size_t i = 0; written && i < count; ++i) {
+        const struct sc_adb_device *device = &devices[i];
+        if (device->model) {
+            written = fprintf(file, "%s\t%s model:%s\n", device->serial,
+                              device->state, device->model) > 0;
+        } else {
+            written = fprintf(file, "%s\t%s\n", device->serial,
+                              device->state) > 0;
+        }
+    }
+
+    if (fclose(file) || !written) {
+        LOGW("Could not write devices cache: %s", tmp_path);
+        remove(tmp_path);
+        goto end;
+    }
+
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows
+    remove(path);
+#endif
+    if (rename(tmp_path, path)) {
+        LOGW("Could not rename devices cache to %s", path);
+        remove(tmp_path);
+        goto end;
+    }
+
+    ok = true;
+
+end:
+    free(tmp_path);
+    return ok;
+}
@@ -0,0 +1,39 @@
+#ifndef SC_ADB_DEVICES_CACHE_H
+#define SC_ADB_DEVICES_CACHE_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "adb_device.h"
+#include "util/tick.h"
+
+// The devices may be plugged or unplugged at any time, so the cache must be
+// short-lived: it only avoids to execute "adb devices" for every scrcpy
+// instance started at the same time
+#define SC_ADB_DEVICES_CACHE_TTL SC_TICK_FROM_SEC(2)
+
+/**
+ * Load the list of devices from a cache file
+ *
+ * Return false if the file does not exist, is invalid, or is older than `ttl`.
+ *
+ * The cache may be shared by several scrcpy instances running in parallel (on
+ * the same computer, since the timestamps are monotonic).
+ */
+bool
+sc_adb_devices_cache_load(const char *path, sc_tick ttl,
+                          struct sc_vec_adb_devices *out_vec);
+
+/**
+ * Write the list of devices to a cache file
+ *
+ * The file is replaced atomically, so that concurrent readers never read a
+ * partial list.
+ */
+bool
+sc_adb_devices_cache_save(const char *path,
+                          const struct sc_adb_device *devices, size_t count);
+
+#endif
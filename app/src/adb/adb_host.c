@@ -0,0 +1,356 @@
+#include "adb_host.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+#include "util/net_intr.h"
+
+#define SC_ADB_HOST_DEFAULT_PORT 5037
+#define SC_ADB_HOST_REQUEST_MAX_LENGTH 1024
+
+static bool
+sc_adb_host_get_port(uint16_t *port) {
+    // A custom adb executable or server socket may not be compatible with a
+    // direct connection, always execute the adb commands in that case
+    if (getenv("ADB") || getenv("ADB_SERVER_SOCKET")
+            || getenv("ANDROID_ADB_SERVER_ADDRESS")) {
+        return false;
+    }
+
+    const char *env = getenv("ANDROID_ADB_SERVER_PORT");
+    if (!env) {
+        *port = SC_ADB_HOST_DEFAULT_PORT;
+        return true;
+    }
+
+    char *endptr;
+    long value = strtol(env, &endptr, 10);
+    if (*env == '\0' || *endptr != '\0' || value <= 0 || value > 0xFFFF) {
+        return false;
+    }
+
+    *port = value;
+    return true;
+}
+
+static sc_socket
+sc_adb_host_connect(struct sc_intr *intr) {
+    uint16_t port;
+    if (!sc_adb_host_get_port(&port)) {
+        return SC_SOCKET_NONE;
+    }
+
+    sc_socket socket = net_socket();
+    if (socket == SC_SOCKET_NONE) {
+        return SC_SOCKET_NONE;
+    }
+
+    if (!net_connect_intr(intr, socket, IPV4_LOCALHOST, port)) {
+        net_close(socket);
+        return SC_SOCKET_NONE;
+    }
+
+    return socket;
+}
+
+static bool
+sc_adb_host_parse_hex4(const char *buf, size_t *value) {
+    size_t v = 0;
+    for (int i = 0; i < 4; ++i) {
+        char c = buf[i];
+        unsigned digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            return false;
+        }
+        v = (v << 4) | digit;
+    }
+
+    *value = v;
+    return true;
+}
+
+static bool
+sc_adb_host_send_request(struct sc_intr *intr, sc_socket socket,
+                         const char *request) {
+    char buf[4 + SC_ADB_HOST_REQUEST_MAX_LENGTH + 1];
+    size_t len = strlen(request);
+    if (len > SC_ADB_HOST_REQUEST_MAX_LENGTH) {
+        LOGE("adb request too long: %s", request);
+        return false;
+    }
+
+    int r = snprintf(buf, sizeof(buf), "%04x%s", (unsigned) len, request);
+    assert(r >= 0 && (size_t) r == 4 + len);
+    (void) r;
+
+    return net_send_all_intr(intr, socket, buf, 4 + len) == (ssize_t) (4 + len);
+}
+
+// Read a length-prefixed string into buf (NUL-terminated)
+static bool
+sc_adb_host_read_string(struct sc_intr *intr, sc_socket socket, char *buf,
+                        size_t len) {
+    assert(len);
+
+    char hex[4];
+    if (net_recv_all_intr(intr, socket, hex, 4) != 4) {
+        return false;
+    }
+
+    size_t size;
+    if (!sc_adb_host_parse_hex4(hex, &size) || size >= len) {
+        return false;
+    }
+
+    if (size && net_recv_all_intr(intr, socket, buf, size) != (ssize_t) size) {
+        return false;
+    }
+
+    buf[size] = '\0';
+    return true;
+}
+
+static void
+sc_adb_host_log_failure(struct sc_intr *intr, sc_socket socket,
+                        const char *request, bool log_errors) {
+    char msg[256];
+    if (!sc_adb_host_read_string(intr, socket, msg, sizeof(msg))) {
+        strcpy(msg, "(unknown error)");
+    }
+
+    if (log_errors) {
+        LOGE("adb request \"%s\" failed: %s", request, msg);
+    } else {
+        LOGD("adb request \"%s\" failed: %s", request, msg);
+    }
+}
+
+// Read a status ("OKAY" or "FAIL"), on failure the error message is logged
+static enum sc_adb_host_result
+sc_adb_host_read_status(struct sc_intr *intr, sc_socket socket,
+                        const char *request, bool allow_eof,
+                        bool log_errors) {
+    char status[4];
+    ssize_t r = net_recv_all_intr(intr, socket, status, 4);
+    if (r == 0 && allow_eof) {
+        // No more status (the connection is closed by the adb server)
+        return SC_ADB_HOST_OK;
+    }
+    if (r != 4) {
+        return SC_ADB_HOST_UNAVAILABLE;
+    }
+
+    if (!memcmp(status, "OKAY", 4)) {
+        return SC_ADB_HOST_OK;
+    }
+
+    if (!memcmp(status, "FAIL", 4)) {
+        sc_adb_host_log_failure(intr, socket, request, log_errors);
+        return SC_ADB_HOST_FAIL;
+    }
+
+    LOGD("Unexpected adb status for \"%s\"", request);
+    return SC_ADB_HOST_UNAVAILABLE;
+}
+
+// Do not fall back to executing the adb command if interrupted
+static enum sc_adb_host_result
+sc_adb_host_result(struct sc_intr *intr, enum sc_adb_host_result result) {
+    if (result == SC_ADB_HOST_UNAVAILABLE && sc_intr_is_interrupted(intr)) {
+        return SC_ADB_HOST_FAIL;
+    }
+    return result;
+}
+
+// Connect to the adb server and send a request, then read its first status
+static enum sc_adb_host_result
+sc_adb_host_open(struct sc_intr *intr, const char *request, bool log_errors,
+                 sc_socket *out_socket) {
+    sc_socket socket = sc_adb_host_connect(intr);
+    if (socket == SC_SOCKET_NONE) {
+        return sc_adb_host_result(intr, SC_ADB_HOST_UNAVAILABLE);
+    }
+
+    enum sc_adb_host_result result = SC_ADB_HOST_UNAVAILABLE;
+    if (sc_adb_host_send_request(intr, socket, request)) {
+        result = sc_adb_host_read_status(intr, socket, request, false,
+                                         log_errors);
+    }
+
+    if (result != SC_ADB_HOST_OK) {
+        net_close(socket);
+        return sc_adb_host_result(intr, result);
+    }
+
+    *out_socket = socket;
+    return SC_ADB_HOST_OK;
+}
+
+// Connect to the adb daemon of the device and send a request
+static enum sc_adb_host_result
+sc_adb_host_open_device(struct sc_intr *intr, const char *serial,
+                        const char *request, bool log_errors,
+                        sc_socket *out_socket) {
+    char transport[SC_ADB_HOST_REQUEST_MAX_LENGTH];
+    int r = snprintf(transport, sizeof(transport), "host:transport:%s",
+                     serial);
+    if (r < 0 || (size_t) r >= sizeof(transport)) {
+        return SC_ADB_HOST_UNAVAILABLE;
+    }
+
+    sc_socket socket;
+    enum sc_adb_host_result result =
+        sc_adb_host_open(intr, transport, log_errors, &socket);
+    if (result != SC_ADB_HOST_OK) {
+        return result;
+    }
+
+    // The socket is now connected to the device
+    result = SC_ADB_HOST_UNAVAILABLE;
+    if (sc_adb_host_send_request(intr, socket, request)) {
+        result = sc_adb_host_read_status(intr, socket, request, false,
+                                         log_errors);
+    }
+
+    if (result != SC_ADB_HOST_OK) {
+        net_close(socket);
+        return sc_adb_host_result(intr, result);
+    }
+
+    *out_socket = socket;
+    return SC_ADB_HOST_OK;
+}
+
+bool
+sc_adb_host_is_available(struct sc_intr *intr) {
+    sc_socket socket = sc_adb_host_connect(intr);
+    if (socket == SC_SOCKET_NONE) {
+        return false;
+    }
+
+    net_close(socket);
+    return true;
+}
+
+enum sc_adb_host_result
+sc_adb_host_query(struct sc_intr *intr, const char *request, char *buf,
+                  size_t len, bool log_errors) {
+    sc_socket socket;
+    enum sc_adb_host_result result =
+        sc_adb_host_open(intr, request, log_errors, &socket);
+    if (result != SC_ADB_HOST_OK) {
+        return result;
+    }
+
+    bool ok = sc_adb_host_read_string(intr, socket, buf, len);
+    net_close(socket);
+
+    return ok ? SC_ADB_HOST_OK
+              : sc_adb_host_result(intr, SC_ADB_HOST_UNAVAILABLE);
+}
+
+enum sc_adb_host_result
+sc_adb_host_command(struct sc_intr *intr, const char *request,
+                    bool log_errors) {
+    sc_socket socket;
+    enum sc_adb_host_result result =
+        sc_adb_host_open(intr, request, log_errors, &socket);
+    if (result != SC_ADB_HOST_OK) {
+        return result;
+    }
+
+    // The first status acknowledges the request, the second one (if any) is
+    // the result
+    result = sc_adb_host_read_status(intr, socket, request, true, log_errors);
+    net_close(socket);
+
+    return sc_adb_host_result(intr, result);
+}
+
+enum sc_adb_host_result
+sc_adb_host_device_command(struct sc_intr *intr, const char *serial,
+                           const char *request, bool log_errors) {
+    sc_socket socket;
+    enum sc_adb_host_result result =
+        sc_adb_host_open_device(intr, serial, request, log_errors, &socket);
+    if (result != SC_ADB_HOST_OK) {
+        return result;
+    }
+
+    // Same as sc_adb_host_command()
+    result = sc_adb_host_read_status(intr, socket, request, true, log_errors);
+    net_close(socket);
+
+    return sc_adb_host_result(intr, result);
+}
+
+enum sc_adb_host_result
+sc_adb_host_device_query(struct sc_intr *intr, const char *serial,
+                         const char *request, char *buf, size_t len,
+                         bool log_errors) {
+    sc_socket socket;
+    enum sc_adb_host_result result =
+        sc_adb_host_open_device(intr, serial, request, log_errors, &socket);
+    if (result != SC_ADB_HOST_OK) {
+        return result;
+    }
+
+    bool ok = sc_adb_host_read_string(intr, socket, buf, len);
+    net_close(socket);
+
+    return ok ? SC_ADB_HOST_OK
+              : sc_adb_host_result(intr, SC_ADB_HOST_UNAVAILABLE);
+}
+
+enum sc_adb_host_result
+sc_adb_host_shell(struct sc_intr *intr, const char *serial,
+                  const char *command, char *buf, size_t len,
+                  bool log_errors) {
+    assert(len);
+
+    char request[SC_ADB_HOST_REQUEST_MAX_LENGTH];
+    int r = snprintf(request, sizeof(request), "shell:%s", command);
+    if (r < 0 || (size_t) r >= sizeof(request)) {
+        return SC_ADB_HOST_UNAVAILABLE;
+    }
+
+    sc_socket socket;
+    enum sc_adb_host_result result =
+        sc_adb_host_open_device(intr, serial, request, log_errors, &socket);
+    if (result != SC_ADB_HOST_OK) {
+        return result;
+    }
+
+    // The raw output is sent until the end of the stream
+    size_t size = 0;
+    for (;;) {
+        if (size == len - 1) {
+            // Truncated
+            break;
+        }
+
+        ssize_t n = net_recv_intr(intr, socket, &buf[size], len - 1 - size);
+        if (n < 0) {
+            net_close(socket);
+            return sc_adb_host_result(intr, SC_ADB_HOST_UNAVAILABLE);
+        }
+        if (n == 0) {
+            break;
+        }
+        size += n;
+    }
+
+    net_close(socket);
+
+    buf[size] = '\0';
+    return SC_ADB_HOST_OK;
+}
@@ -0,0 +1,92 @@
+#ifndef SC_ADB_HOST_H
+#define SC_ADB_HOST_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "util/intr.h"
+
+/**
+ * Minimal client of the adb server "host" protocol
+ *
+ * The adb server (started by `adb start-server`) listens on a local TCP port
+ * (5037 by default). Sending the requests to it directly avoids to spawn one
+ * adb process (and its own handshake with the adb server) for each command.
+ *
+ * If the adb server is not reachable, the functions return
+ * SC_ADB_HOST_UNAVAILABLE, so that the caller can fall back to executing the
+ * adb command.
+ */
+
+enum sc_adb_host_result {
+    SC_ADB_HOST_OK,
+    // The request was rejected by adb (the error is logged)
+    SC_ADB_HOST_FAIL,
+    // The adb server could not be used, execute the adb command instead
+    SC_ADB_HOST_UNAVAILABLE,
+};
+
+/**
+ * Indicate if the adb server is running (and may be used)
+ */
+bool
+sc_adb_host_is_available(struct sc_intr *intr);
+
+/**
+ * Execute a request for the adb server, expecting a (length-prefixed) reply
+ *
+ * For example "host:devices-l".
+ *
+ * The reply is written to `buf` (NUL-terminated). It fails if it does not fit.
+ */
+enum sc_adb_host_result
+sc_adb_host_query(struct sc_intr *intr, const char *request, char *buf,
+                  size_t len, bool log_errors);
+
+/**
+ * Execute a request for the adb server, expecting a status reply
+ *
+ * For example "host-serial:<serial>:forward:<local>;<remote>".
+ */
+enum sc_adb_host_result
+sc_adb_host_command(struct sc_intr *intr, const char *request,
+                    bool log_errors);
+
+/**
+ * Execute a request for the adb daemon on the device, expecting a status reply
+ *
+ * For example "reverse:forward:<remote>;<local>".
+ */
+enum sc_adb_host_result
+sc_adb_host_device_command(struct sc_intr *intr, const char *serial,
+                           const char *request, bool log_errors);
+
+/**
+ * Execute a request for the adb daemon on the device, expecting a
+ * (length-prefixed) reply
+ *
+ * For example "reverse:list-forward".
+ *
+ * The reply is written to `buf` (NUL-terminated). It fails if it does not fit.
+ */
+enum sc_adb_host_result
+sc_adb_host_device_query(struct sc_intr *intr, const char *serial,
+                         const char *request, char *buf, size_t len,
+                         bool log_errors);
+
+/**
+ * Execute a shell command on the device and read its output
+ *
+ * The exit status of the command is not available.
+ *
+ * The output is written to `buf` (NUL-terminated), truncated to `len - 1`
+ * bytes.
+ */
+enum sc_adb_host_result
+sc_adb_host_shell(struct sc_intr *intr, const char *serial,
+                  const char *command, char *buf, size_t len, bool log_errors);
+
+#endif
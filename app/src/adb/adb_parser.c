@@ -109,11 +109,108 @@ sc_adb_parse_device(char *line, struct sc_adb_device *device) {
     return true;
 }
 
-bool
-sc_adb_parse_devices(char *str, struct sc_vec_adb_devices *out_vec) {
+void
+sc_adb_devices_parser_init(struct sc_adb_devices_parser *parser,
+                           struct sc_vec_adb_devices *out_vec) {
+    parser->out_vec = out_vec;
+    parser->header_found = false;
+    parser->line_len = 0;
+    parser->line_too_long = false;
+}
+
+// The line (without '\n') must be NUL-terminated, it may be modified
+static void
+sc_adb_devices_parser_process_line(struct sc_adb_devices_parser *parser,
+                                   char *line, size_t len) {
 #define HEADER "List of devices attached"
 #define HEADER_LEN (sizeof(HEADER) - 1)
-    bool header_found = false;
+    if (!parser->header_found) {
+        if (!strncmp(line, HEADER, HEADER_LEN)) {
+            parser->header_found = true;
+        }
+        // Skip everything until the header, there might be garbage lines
+        // related to daemon starting before
+        return;
+    }
+
+    // The line, but without any trailing '\r'
+    size_t line_len = sc_str_remove_trailing_cr(line, len);
+    line[line_len] = '\0';
+
+    struct sc_adb_device device;
+    bool ok = sc_adb_parse_device(line, &device);
+    if (!ok) {
+        return;
+    }
+
+    ok = sc_vector_push(parser->out_vec, device);
+    if (!ok) {
+        LOG_OOM();
+        LOGE("Could not push adb_device to vector");
+        sc_adb_device_destroy(&device);
+        // continue anyway
+    }
+}
+
+static void
+sc_adb_devices_parser_end_line(struct sc_adb_devices_parser *parser) {
+    if (parser->line_too_long) {
+        LOGW("Ignoring too long line in adb devices output");
+        parser->line_too_long = false;
+    } else {
+        assert(parser->line_len < sizeof(parser->line));
+        parser->line[parser->line_len] = '\0';
+        sc_adb_devices_parser_process_line(parser, parser->line,
+                                           parser->line_len);
+    }
+    parser->line_len = 0;
+}
+
+void
+sc_adb_devices_parser_push(struct sc_adb_devices_parser *parser,
+                           const char *data, size_t len) {
+    while (len) {
+        const char *eol = memchr(data, '\n', len);
+        size_t chunk_len = eol ? (size_t) (eol - data) : len;
+
+        if (!parser->line_too_long) {
+            // Keep room for the NUL terminator
+            if (parser->line_len + chunk_len < sizeof(parser->line)) {
+                memcpy(&parser->line[parser->line_len], data, chunk_len);
+                parser->line_len += chunk_len;
+            } else {
+                parser->line_too_long = true;
+            }
+        }
+
+        if (!eol) {
+            // Incomplete line, wait for the next chunk
+            return;
+        }
+
+        sc_adb_devices_parser_end_line(parser);
+
+        // Skip the '\n'
+        data += chunk_len + 1;
+        len -= chunk_len + 1;
+    }
+}
+
+bool
+sc_adb_devices_parser_finish(struct sc_adb_devices_parser *parser) {
+    if (parser->line_len || parser->line_too_long) {
+        sc_adb_devices_parser_end_line(parser);
+    }
+
+    assert(parser->header_found || parser->out_vec->size == 0);
+    return parser->header_found;
+}
+
+bool
+sc_adb_parse_devices(char *str, struct sc_vec_adb_devices *out_vec) {
+    // The whole output is available, parse the lines in place
+    struct sc_adb_devices_parser parser;
+    sc_adb_devices_parser_init(&parser, out_vec);
 
     size_t idx_line = 0;
     while (str[idx_line] != '\0') {
@@ -128,37 +225,12 @@ sc_adb_parse_devices(char *str, struct sc_vec_adb_devices *out_vec) {
             ++idx_line;
         }
 
-        if (!header_found) {
-            if (!strncmp(line, HEADER, HEADER_LEN)) {
-                header_found = true;
-            }
-            // Skip everything until the header, there might be garbage lines
-            // related to daemon starting before
-            continue;
-        }
-
-        // The line, but without any trailing '\r'
-        size_t line_len = sc_str_remove_trailing_cr(line, len);
-        line[line_len] = '\0';
-
-        struct sc_adb_device device;
-        bool ok = sc_adb_parse_device(line, &device);
-        if (!ok) {
-            continue;
-        }
-
-        ok = sc_vector_push(out_vec, device);
-        if (!ok) {
-            LOG_OOM();
-            LOGE("Could not push adb_device to vector");
-            sc_adb_device_destroy(&device);
-            // continue anyway
-            continue;
-        }
+        line[len] = '\0';
+        sc_adb_devices_parser_process_line(&parser, line, len);
     }
 
-    assert(header_found || out_vec->size == 0);
-    return header_found;
+    assert(parser.header_found || out_vec->size == 0);
+    return parser.header_found;
 }
 
 static char *
@@ -226,3 +298,46 @@ sc_adb_parse_device_ip(char *str) {
 
     return NULL;
 }
+
+static bool
+sc_adb_parse_tunnel_line_matches(const char *line, size_t len,
+                                 const char *local, const char *remote) {
+    // Skip the serial
+    size_t serial_len = strcspn(line, " ");
+    if (serial_len >= len) {
+        return false;
+    }
+    line += serial_len + 1;
+    len -= serial_len + 1;
+
+    size_t local_len = strlen(local);
+    size_t remote_len = strlen(remote);
+    return len == local_len + 1 + remote_len
+        && !strncmp(line, local, local_len)
+        && line[local_len] == ' '
+        && !strncmp(&line[local_len + 1], remote, remote_len);
+}
+
+bool
+sc_adb_parse_has_tunnel(const char *str, const char *local,
+                        const char *remote) {
+    for (;;) {
+        size_t len = strcspn(str, "\n");
+        // Ignore any trailing '\r'
+        size_t line_len = len;
+        if (line_len && str[line_len - 1] == '\r') {
+            --line_len;
+        }
+
+        if (sc_adb_parse_tunnel_line_matches(str, line_len, local, remote)) {
+            return true;
+        }
+
+        if (str[len] == '\0') {
+            return false;
+        }
+
+        // The next line starts after the '\n'
+        str += len + 1;
+    }
+}
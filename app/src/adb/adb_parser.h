@@ -3,10 +3,51 @@
 
 #include "common.h"
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "adb_device.h"
 
+// Longer lines are ignored (a device line is typically ~100 bytes)
+#define SC_ADB_DEVICES_PARSER_LINE_MAX 1024
+
+/**
+ * Parser of the output of `adb devices`, fed incrementally
+ *
+ * It allows to parse the output while it is being read, using a bounded
+ * amount of memory whatever the number of devices.
+ */
+struct sc_adb_devices_parser {
+    struct sc_vec_adb_devices *out_vec;
+    bool header_found;
+
+    // The current (incomplete) line
+    char line[SC_ADB_DEVICES_PARSER_LINE_MAX];
+    size_t line_len;
+    bool line_too_long; // if set, the current line is skipped
+};
+
+void
+sc_adb_devices_parser_init(struct sc_adb_devices_parser *parser,
+                           struct sc_vec_adb_devices *out_vec);
+
+/**
+ * Parse the next chunk of the output
+ *
+ * The chunk may start or end anywhere, even in the middle of a line.
+ */
+void
+sc_adb_devices_parser_push(struct sc_adb_devices_parser *parser,
+                           const char *data, size_t len);
+
+/**
+ * Parse the last line (if not terminated by '\n')
+ *
+ * Return true if the output was valid (i.e. if the header was found).
+ */
+bool
+sc_adb_devices_parser_finish(struct sc_adb_devices_parser *parser);
+
 /**
  * Parse the available devices from the output of `adb devices`
  *
@@ -27,4 +68,16 @@ sc_adb_parse_devices(char *str, struct sc_vec_adb_devices *out_vec);
 char *
 sc_adb_parse_device_ip(char *str);
 
+/**
+ * Indicate if the output of `adb forward --list` or `adb reverse --list`
+ * contains the given tunnel
+ *
+ * Each line is "<serial> <local> <remote>".
+ *
+ * The parameter must be a NUL-terminated string.
+ */
+bool
+sc_adb_parse_has_tunnel(const char *str, const char *local,
+                        const char *remote);
+
 #endif
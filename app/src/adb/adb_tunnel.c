@@ -1,6 +1,7 @@
 #include "adb_tunnel.h"
 
 #include <assert.h>
+#include <stdio.h>
 
 #include "adb.h"
 #include "util/log.h"
@@ -113,10 +114,29 @@ enable_tunnel_forward_any_port(struct sc_adb_tunnel *tunnel,
     }
 }
 
+static bool
+enable_tunnel_reverse_persistent(struct sc_adb_tunnel *tunnel,
+                                 struct sc_intr *intr, const char *serial,
+                                 const char *device_socket_name, uint16_t port) {
+    if (sc_adb_has_reverse(intr, serial, device_socket_name, port,
+                           SC_ADB_SILENT)) {
+        LOGD("Reusing the persistent reverse tunnel on port %" PRIu16, port);
+    } else if (!sc_adb_reverse(intr, serial, device_socket_name, port,
+                               SC_ADB_NO_STDOUT)) {
+        return false;
+    }
+
+    tunnel->local_port = port;
+    tunnel->persistent = true;
+    tunnel->enabled = true;
+    return true;
+}
+
 void
 sc_adb_tunnel_init(struct sc_adb_tunnel *tunnel) {
     tunnel->enabled = false;
     tunnel->forward = false;
+    tunnel->persistent = false;
     tunnel->server_socket = SC_SOCKET_NONE;
     tunnel->local_port = 0;
 }
@@ -144,6 +164,68 @@ sc_adb_tunnel_open(struct sc_adb_tunnel *tunnel, struct sc_intr *intr,
                                           device_socket_name, port_range);
 }
 
+bool
+sc_adb_tunnel_open_persistent(struct sc_adb_tunnel *tunnel,
+                              struct sc_intr *intr, const char *serial,
+                              const char *device_socket_name_prefix,
+                              struct sc_port_range port_range, uint32_t *scid) {
+    assert(!tunnel->enabled);
+
+    uint16_t port = port_range.first;
+    for (;;) {
+        sc_socket server_socket = net_socket();
+        if (server_socket == SC_SOCKET_NONE) {
+            return false;
+        }
+
+        // Listen before touching the tunnel: the port may be listened by
+        // another instance reusing the same tunnel
+        if (listen_on_port(intr, server_socket, port)) {
+            uint32_t port_scid = SC_ADB_TUNNEL_PERSISTENT_SCID(port);
+
+            char name[108 + 1];
+            int r = snprintf(name, sizeof(name), "%s%08x",
+                             device_socket_name_prefix, port_scid);
+            assert(r >= 0 && (size_t) r < sizeof(name));
+            (void) r;
+
+            if (enable_tunnel_reverse_persistent(tunnel, intr, serial, name,
+                                                 port)) {
+                tunnel->server_socket = server_socket;
+                *scid = port_scid;
+                return true;
+            }
+
+            // The command itself failed, it will fail on any port
+            net_close(server_socket);
+            return false;
+        }
+
+        net_close(server_socket);
+
+        if (sc_intr_is_interrupted(intr)) {
+            // Stop immediately
+            return false;
+        }
+
+        // check before incrementing to avoid overflow on port 65535
+        if (port < port_range.last) {
+            LOGD("Could not listen on port %" PRIu16", retrying on %" PRIu16,
+                 port, (uint16_t) (port + 1));
+            port++;
+            continue;
+        }
+
+        if (port_range.first == port_range.last) {
+            LOGE("Could not listen on port %" PRIu16, port_range.first);
+        } else {
+            LOGE("Could not listen on any port in range %" PRIu16 ":%" PRIu16,
+                 port_range.first, port_range.last);
+        }
+        return false;
+    }
+}
+
 bool
 sc_adb_tunnel_close(struct sc_adb_tunnel *tunnel, struct sc_intr *intr,
                     const char *serial, const char *device_socket_name) {
@@ -154,7 +236,9 @@ sc_adb_tunnel_close(struct sc_adb_tunnel *tunnel, struct sc_intr *intr,
         ret = sc_adb_forward_remove(intr, serial, tunnel->local_port,
                                     SC_ADB_NO_STDOUT);
     } else {
-        ret = sc_adb_reverse_remove(intr, serial, device_socket_name,
+        // A persistent tunnel is reused by the next instances
+        ret = tunnel->persistent
+           || sc_adb_reverse_remove(intr, serial, device_socket_name,
                                     SC_ADB_NO_STDOUT);
 
         assert(tunnel->server_socket != SC_SOCKET_NONE);
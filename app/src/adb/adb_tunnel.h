@@ -10,9 +10,14 @@
 #include "util/intr.h"
 #include "util/net.h"
 
+// The scid of a persistent tunnel is derived from its local port, so that its
+// device socket name is known without querying adb
+#define SC_ADB_TUNNEL_PERSISTENT_SCID(PORT) (UINT32_C(0x7ffe0000) | (PORT))
+
 struct sc_adb_tunnel {
     bool enabled;
     bool forward; // use "adb forward" instead of "adb reverse"
+    bool persistent; // the "adb reverse" is kept on close
     sc_socket server_socket; // only used if !forward
     uint16_t local_port;
 };
@@ -37,8 +42,29 @@ sc_adb_tunnel_open(struct sc_adb_tunnel *tunnel, struct sc_intr *intr,
                    const char *serial, const char *device_socket_name,
                    struct sc_port_range port_range, bool force_adb_forward);
 
+/**
+ * Open a persistent "adb reverse" tunnel
+ *
+ * The tunnel is not removed on close, so that the next instances for the same
+ * device reuse it: for each port of the range, the local port is listened
+ * first (a port used by another instance is skipped without any adb command),
+ * then the tunnel is only enabled if it does not already exist.
+ *
+ * The device socket name is `device_socket_name_prefix` followed by the scid
+ * (in hexadecimal), derived from the local port (written to `scid`).
+ *
+ * It never falls back to "adb forward".
+ */
+bool
+sc_adb_tunnel_open_persistent(struct sc_adb_tunnel *tunnel,
+                              struct sc_intr *intr, const char *serial,
+                              const char *device_socket_name_prefix,
+                              struct sc_port_range port_range, uint32_t *scid);
+
 /**
  * Close the tunnel
+ *
+ * A persistent tunnel is only disabled locally (the adb reverse is kept).
  */
 bool
 sc_adb_tunnel_close(struct sc_adb_tunnel *tunnel, struct sc_intr *intr,
@@ -0,0 +1,221 @@
+#include "audio_mixer.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/gain.h"
+#include "util/log.h"
+
+/** Downcast audio_output to sc_audio_mixer_input */
+#define DOWNCAST(OUTPUT) \
+    container_of(OUTPUT, struct sc_audio_mixer_input, audio_output)
+
+static void
+sc_audio_mixer_fill(void *userdata, uint8_t *stream, size_t len) {
+    struct sc_audio_mixer *mixer = userdata;
+
+    // This callback is called from the audio output thread. The mutex is only
+    // contended on input changes (very rare), never by the audio sources.
+
+    float *out = (float *) stream;
+    size_t count = len / sizeof(float);
+    memset(stream, 0, len);
+
+    sc_mutex_lock(&mixer->mutex);
+
+    bool solo = false;
+    for (size_t i = 0; i < mixer->inputs.size; ++i) {
+        solo |= mixer->inputs.data[i]->solo;
+    }
+
+    for (size_t i = 0; i < mixer->inputs.size; ++i) {
+        struct sc_audio_mixer_input *input = mixer->inputs.data[i];
+        if (!input->started) {
+            continue;
+        }
+
+        // The samples of a silent input are still pulled (and discarded), so
+        // that its buffering is not affected
+        bool silent = input->muted || (solo && !input->solo);
+
+        // The scratch buffer may be smaller than the requested length
+        size_t offset = 0;
+        while (offset < count) {
+            size_t n = MIN(count - offset, mixer->scratch_samples);
+            input->fill(input->fill_userdata, (uint8_t *) mixer->scratch,
+                        n * sizeof(float));
+            if (!silent) {
+                sc_gain_mix(out + offset, mixer->scratch, n, input->gain);
+            }
+            offset += n;
+        }
+    }
+
+    sc_mutex_unlock(&mixer->mutex);
+}
+
+static bool
+sc_audio_mixer_input_open(struct sc_audio_output *output,
+                          const struct sc_audio_output_spec *spec,
+                          sc_audio_output_fill_fn *fill, void *userdata) {
+    struct sc_audio_mixer_input *input = DOWNCAST(output);
+    struct sc_audio_mixer *mixer = input->mixer;
+
+    input->fill = fill;
+    input->fill_userdata = userdata;
+
+    sc_mutex_lock(&mixer->mutex);
+
+    if (!mixer->output_open) {
+        // A few output buffers, the mixer pulls the samples by chunks anyway
+        size_t scratch_samples = (size_t) spec->buffer_samples
+                               * spec->nb_channels * 4;
+        float *scratch = malloc(scratch_samples * sizeof(float));
+        if (!scratch) {
+            sc_mutex_unlock(&mixer->mutex);
+            LOG_OOM();
+            return false;
+        }
+
+        // The fill callback is not called before start(), so it is safe to
+        // open the output with the mutex locked
+        bool ok = mixer->output->ops->open(mixer->output, spec,
+                                           sc_audio_mixer_fill, mixer);
+        if (!ok) {
+            sc_mutex_unlock(&mixer->mutex);
+            free(scratch);
+            return false;
+        }
+
+        mixer->scratch = scratch;
+        mixer->scratch_samples = scratch_samples;
+        mixer->spec = *spec;
+        mixer->output_open = true;
+    } else if (spec->sample_rate != mixer->spec.sample_rate
+            || spec->nb_channels != mixer->spec.nb_channels) {
+        sc_mutex_unlock(&mixer->mutex);
+        LOGE("Audio mixer: incompatible input (%u Hz, %u channels), expected "
+             "%u Hz, %u channels", spec->sample_rate, spec->nb_channels,
+             mixer->spec.sample_rate, mixer->spec.nb_channels);
+        return false;
+    }
+
+    input->started = false;
+    bool ok = sc_vector_push(&mixer->inputs, input);
+
+    sc_mutex_unlock(&mixer->mutex);
+
+    if (!ok) {
+        LOG_OOM();
+        return false;
+    }
+
+    return true;
+}
+
+static void
+sc_audio_mixer_input_start(struct sc_audio_output *output) {
+    struct sc_audio_mixer_input *input = DOWNCAST(output);
+    struct sc_audio_mixer *mixer = input->mixer;
+
+    sc_mutex_lock(&mixer->mutex);
+    input->started = true;
+    bool start_output = !mixer->output_started;
+    mixer->output_started = true;
+    sc_mutex_unlock(&mixer->mutex);
+
+    if (start_output) {
+        mixer->output->ops->start(mixer->output);
+    }
+}
+
+static void
+sc_audio_mixer_input_close(struct sc_audio_output *output) {
+    struct sc_audio_mixer_input *input = DOWNCAST(output);
+    struct sc_audio_mixer *mixer = input->mixer;
+
+    // Once removed (with the mutex locked), the input fill callback is never
+    // called anymore. The output itself is kept open for the other inputs.
+    sc_mutex_lock(&mixer->mutex);
+    ssize_t index = sc_vector_index_of(&mixer->inputs, input);
+    assert(index != -1);
+    sc_vector_remove(&mixer->inputs, index);
+    sc_mutex_unlock(&mixer->mutex);
+}
+
+bool
+sc_audio_mixer_init(struct sc_audio_mixer *mixer,
+                    struct sc_audio_output *output) {
+    bool ok = sc_mutex_init(&mixer->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    mixer->output = output;
+    sc_vector_init(&mixer->inputs);
+    mixer->output_open = false;
+    mixer->output_started = false;
+    mixer->scratch = NULL;
+    mixer->scratch_samples = 0;
+
+    return true;
+}
+
+void
+sc_audio_mixer_destroy(struct sc_audio_mixer *mixer) {
+    // The inputs must be closed
+    assert(!mixer->inputs.size);
+
+    if (mixer->output_open) {
+        // The mutex must not be locked: closing the output waits for the fill
+        // callback to return
+        mixer->output->ops->close(mixer->output);
+    }
+
+    free(mixer->scratch);
+    sc_vector_destroy(&mixer->inputs);
+    sc_mutex_destroy(&mixer->mutex);
+}
+
+void
+sc_audio_mixer_input_init(struct sc_audio_mixer_input *input,
+                          struct sc_audio_mixer *mixer) {
+    input->mixer = mixer;
+    input->fill = NULL;
+    input->fill_userdata = NULL;
+    input->started = false;
+    input->gain = 1;
+    input->muted = false;
+    input->solo = false;
+
+    static const struct sc_audio_output_ops ops = {
+        .open = sc_audio_mixer_input_open,
+        .start = sc_audio_mixer_input_start,
+        .close = sc_audio_mixer_input_close,
+    };
+
+    input->audio_output.ops = &ops;
+}
+
+void
+sc_audio_mixer_input_set_gain(struct sc_audio_mixer_input *input, float gain) {
+    sc_mutex_lock(&input->mixer->mutex);
+    input->gain = gain;
+    sc_mutex_unlock(&input->mixer->mutex);
+}
+
+void
+sc_audio_mixer_input_set_muted(struct sc_audio_mixer_input *input,
+                               bool muted) {
+    sc_mutex_lock(&input->mixer->mutex);
+    input->muted = muted;
+    sc_mutex_unlock(&input->mixer->mutex);
+}
+
+void
+sc_audio_mixer_input_set_solo(struct sc_audio_mixer_input *input, bool solo) {
+    sc_mutex_lock(&input->mixer->mutex);
+    input->solo = solo;
+    sc_mutex_unlock(&input->mixer->mutex);
+}
@@ -0,0 +1,81 @@
+#ifndef SC_AUDIO_MIXER_H
+#define SC_AUDIO_MIXER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "trait/audio_output.h"
+#include "util/thread.h"
+#include "util/vector.h"
+
+struct sc_audio_mixer;
+
+/**
+ * Mixer input, to be used as the audio output of an audio source (typically
+ * an audio player)
+ */
+struct sc_audio_mixer_input {
+    struct sc_audio_output audio_output; // audio output trait
+
+    struct sc_audio_mixer *mixer;
+
+    sc_audio_output_fill_fn *fill;
+    void *fill_userdata;
+
+    // All the fields below are protected by the mixer mutex
+    bool started;
+    float gain;
+    bool muted;
+    bool solo;
+};
+
+/**
+ * Mix several audio sources into a single audio output (a single audio device
+ * and a single audio thread)
+ *
+ * All the inputs must use the same sample rate and number of channels. The
+ * output is opened by the first input opened, and closed on destroy.
+ */
+struct sc_audio_mixer {
+    struct sc_audio_output *output;
+
+    sc_mutex mutex;
+    // The open inputs
+    struct SC_VECTOR(struct sc_audio_mixer_input *) inputs;
+
+    bool output_open;
+    bool output_started;
+    struct sc_audio_output_spec spec;
+
+    // Buffer to pull the samples of each input (only used by the audio output
+    // thread once the output is open)
+    float *scratch;
+    size_t scratch_samples;
+};
+
+bool
+sc_audio_mixer_init(struct sc_audio_mixer *mixer,
+                    struct sc_audio_output *output);
+
+void
+sc_audio_mixer_destroy(struct sc_audio_mixer *mixer);
+
+void
+sc_audio_mixer_input_init(struct sc_audio_mixer_input *input,
+                          struct sc_audio_mixer *mixer);
+
+void
+sc_audio_mixer_input_set_gain(struct sc_audio_mixer_input *input, float gain);
+
+void
+sc_audio_mixer_input_set_muted(struct sc_audio_mixer_input *input, bool muted);
+
+/**
+ * If at least one input is solo, only the solo inputs are heard
+ */
+void
+sc_audio_mixer_input_set_solo(struct sc_audio_mixer_input *input, bool solo);
+
+#endif
@@ -0,0 +1,81 @@
+#include "audio_output_sdl.h"
+
+#include "util/log.h"
+#include "util/thread.h"
+#include "util/trace.h"
+
+/** Downcast audio_output to sc_audio_output_sdl */
+#define DOWNCAST(OUTPUT) \
+    container_of(OUTPUT, struct sc_audio_output_sdl, audio_output)
+
+static void SDLCALL
+sc_audio_output_sdl_callback(void *userdata, uint8_t *stream, int len) {
+    struct sc_audio_output_sdl *aos = userdata;
+
+    // This callback is called with the lock used by SDL_LockAudioDevice()
+
+    if (!aos->thread_configured) {
+        // The audio thread is created by SDL
+        sc_thread_apply_role(SC_THREAD_ROLE_AUDIO_OUTPUT);
+        sc_trace_thread_name("audio-output");
+        aos->thread_configured = true;
+    }
+
+    assert(len > 0);
+    sc_trace_begin("audio-callback");
+    aos->fill(aos->fill_userdata, stream, len);
+    sc_trace_end();
+}
+
+static bool
+sc_audio_output_sdl_open(struct sc_audio_output *output,
+                         const struct sc_audio_output_spec *spec,
+                         sc_audio_output_fill_fn *fill, void *userdata) {
+    struct sc_audio_output_sdl *aos = DOWNCAST(output);
+
+    aos->fill = fill;
+    aos->fill_userdata = userdata;
+    aos->thread_configured = false;
+
+    SDL_AudioSpec desired = {
+        .freq = spec->sample_rate,
+        .format = AUDIO_F32,
+        .channels = spec->nb_channels,
+        .samples = spec->buffer_samples,
+        .callback = sc_audio_output_sdl_callback,
+        .userdata = aos,
+    };
+    SDL_AudioSpec obtained;
+
+    aos->device = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained, 0);
+    if (!aos->device) {
+        LOGE("Could not open audio device: %s", SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+static void
+sc_audio_output_sdl_start(struct sc_audio_output *output) {
+    struct sc_audio_output_sdl *aos = DOWNCAST(output);
+    SDL_PauseAudioDevice(aos->device, 0);
+}
+
+static void
+sc_audio_output_sdl_close(struct sc_audio_output *output) {
+    struct sc_audio_output_sdl *aos = DOWNCAST(output);
+    SDL_PauseAudioDevice(aos->device, 1);
+    SDL_CloseAudioDevice(aos->device);
+}
+
+void
+sc_audio_output_sdl_init(struct sc_audio_output_sdl *aos) {
+    static const struct sc_audio_output_ops ops = {
+        .open = sc_audio_output_sdl_open,
+        .start = sc_audio_output_sdl_start,
+        .close = sc_audio_output_sdl_close,
+    };
+
+    aos->audio_output.ops = &ops;
+}
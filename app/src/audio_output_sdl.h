@@ -0,0 +1,28 @@
+#ifndef SC_AUDIO_OUTPUT_SDL_H
+#define SC_AUDIO_OUTPUT_SDL_H
+
+#include "common.h"
+
+#include <SDL2/SDL.h>
+
+#include "trait/audio_output.h"
+
+/**
+ * Audio output playing the samples via SDL
+ */
+struct sc_audio_output_sdl {
+    struct sc_audio_output audio_output; // audio output trait
+
+    SDL_AudioDeviceID device;
+
+    sc_audio_output_fill_fn *fill;
+    void *fill_userdata;
+
+    // Only accessed from the audio callback
+    bool thread_configured;
+};
+
+void
+sc_audio_output_sdl_init(struct sc_audio_output_sdl *aos);
+
+#endif
@@ -11,7 +11,7 @@
  * Real-time audio player with configurable latency
  *
  * As input, the player regularly receives AVFrames of decoded audio samples.
- * As output, an SDL callback regularly requests audio samples to be played.
+ * As output, an audio output callback regularly requests audio samples to be played.
  * In the middle, an audio buffer stores the samples produced but not consumed
  * yet.
  *
@@ -26,6 +26,10 @@
  * occur frequently. If it is too high, then latency will become unacceptable.
  * This target value is configured using the scrcpy option --audio-buffer.
  *
+ * A fixed delay (--audio-delay) may be added to the target buffering. It is
+ * neither adapted nor reported as a compensation error: the delayed samples
+ * just stay in the audio buffer.
+ *
  * The player cannot adjust the sample input rate (it receives samples produced
  * in real-time) or the sample output rate (it must provide samples as
  * requested by the audio output callback). Therefore, it may only apply
@@ -43,7 +47,8 @@
  * smoothed.
  *
  * Buffer underflow events can occur when packets arrive too late. In that case,
- * the player inserts silence. Once the packets finally arrive (late), one
+ * the player conceals the missing samples: it plays the last samples backwards
+ * while fading them out, then inserts silence. Once the packets finally arrive (late), one
  * strategy could be to drop the samples that were replaced by silence, in
  * order to keep a minimal latency. However, dropping samples in case of buffer
  * underflow is inadvisable, as it would temporarily increase the underflow
@@ -56,32 +61,56 @@
 /** Downcast frame_sink to sc_audio_player */
 #define DOWNCAST(SINK) container_of(SINK, struct sc_audio_player, frame_sink)
 
+// The format of the samples expected by the audio output
 #define SC_AV_SAMPLE_FMT AV_SAMPLE_FMT_FLT
-#define SC_SDL_SAMPLE_FMT AUDIO_F32
 
 #define TO_BYTES(SAMPLES) sc_audiobuf_to_bytes(&ap->buf, (SAMPLES))
 #define TO_SAMPLES(BYTES) sc_audiobuf_to_samples(&ap->buf, (BYTES))
 
-static void SDLCALL
-sc_audio_player_sdl_callback(void *userdata, uint8_t *stream, int len_int) {
+// Conceal the missing samples over 5ms on underflow
+#define SC_AUDIO_PLAYER_CONCEAL_MS 5
+
+static void
+sc_audio_player_keep_history(struct sc_audio_player *ap, const float *samples,
+                             uint32_t count) {
+    unsigned channels = ap->nb_channels;
+    uint32_t capacity = ap->history_capacity;
+
+    if (count >= capacity) {
+        memcpy(ap->history, samples + (size_t) (count - capacity) * channels,
+               TO_BYTES(capacity));
+        ap->history_len = capacity;
+        return;
+    }
+
+    // Keep the most recent samples already in the history
+    uint32_t keep = MIN(ap->history_len, capacity - count);
+    memmove(ap->history,
+            ap->history + (size_t) (ap->history_len - keep) * channels,
+            TO_BYTES(keep));
+    memcpy(ap->history + (size_t) keep * channels, samples, TO_BYTES(count));
+    ap->history_len = keep + count;
+}
+
+static void
+sc_audio_player_fill(void *userdata, uint8_t *stream, size_t len) {
     struct sc_audio_player *ap = userdata;
 
-    // This callback is called with the lock used by SDL_LockAudioDevice()
+    // This callback is called from the audio output thread
 
-    assert(len_int > 0);
-    size_t len = len_int;
+    assert(len > 0);
     uint32_t count = TO_SAMPLES(len);
 
 #ifndef SC_AUDIO_PLAYER_NDEBUG
-    LOGD("[Audio] SDL callback requests %" PRIu32 " samples", count);
+    LOGD("[Audio] Audio output requests %" PRIu32 " samples", count);
 #endif
 
     bool played = atomic_load_explicit(&ap->played, memory_order_relaxed);
     if (!played) {
         uint32_t buffered_samples = sc_audiobuf_can_read(&ap->buf);
         // Wait until the buffer is filled up to at least target_buffering
-        // before playing
-        if (buffered_samples < ap->target_buffering) {
+        // (plus the fixed delay) before playing
+        if (buffered_samples < ap->target_buffering + ap->delay) {
             LOGV("[Audio] Inserting initial buffering silence: %" PRIu32
                  " samples", count);
             // Delay playback starting to reach the target buffering. Fill the
@@ -94,16 +123,32 @@ sc_audio_player_sdl_callback(void *userdata, uint8_t *stream, int len_int) {
 
     uint32_t read = sc_audiobuf_read(&ap->buf, stream, count);
 
+    if (read && (ap->gain != 1 || ap->fade < 1)) {
+        // The output buffer contains interleaved float samples
+        ap->fade = sc_gain_apply_fade_in((float *) stream, read,
+                                         ap->nb_channels, ap->gain, ap->fade,
+                                         ap->fade_step);
+    }
+
+    if (read) {
+        sc_audio_player_keep_history(ap, (const float *) stream, read);
+        ap->concealed = 0;
+    }
+
     if (read < count) {
         uint32_t silence = count - read;
-        // Insert silence. In theory, the inserted silent samples replace the
-        // missing real samples, which will arrive later, so they should be
+        // Conceal the missing samples. In theory, the inserted samples replace
+        // the missing real samples, which will arrive later, so they should be
         // dropped to keep the latency minimal. However, this would cause very
         // audible glitches, so let the clock compensation restore the target
         // latency.
-        LOGD("[Audio] Buffer underflow, inserting silence: %" PRIu32 " samples",
+        LOGD("[Audio] Buffer underflow, concealing: %" PRIu32 " samples",
              silence);
-        memset(stream + TO_BYTES(read), 0, TO_BYTES(silence));
+        ap->concealed = sc_gain_conceal((float *) (stream + TO_BYTES(read)),
+                                        silence, ap->nb_channels, ap->history,
+                                        ap->history_len, ap->concealed);
+        // Fade in the next samples, rather than resuming at full volume
+        ap->fade = 0;
 
         bool received = atomic_load_explicit(&ap->received,
                                              memory_order_relaxed);
@@ -128,6 +173,8 @@ sc_audio_player_get_swr_buf(struct sc_audio_player *ap, uint32_t min_samples) {
             // Could not realloc to the requested size
             return NULL;
         }
+        sc_stats_add(ap->stats, SC_STAT_MEM_SWR_BYTES,
+                     (int64_t) new_size - ap->swr_buf_alloc_size);
         ap->swr_buf = buf;
         ap->swr_buf_alloc_size = new_size;
     }
@@ -135,6 +182,76 @@ sc_audio_player_get_swr_buf(struct sc_audio_player *ap, uint32_t min_samples) {
     return ap->swr_buf;
 }
 
+static inline bool
+sc_audio_player_is_adaptive(struct sc_audio_player *ap) {
+    return ap->max_target_buffering;
+}
+
+// The number of buffered samples to maintain, including the fixed delay
+static inline uint32_t
+sc_audio_player_get_target(struct sc_audio_player *ap) {
+    return ap->target_buffering + ap->delay;
+}
+
+static void
+sc_audio_player_update_jitter(struct sc_audio_player *ap,
+                              const AVFrame *frame) {
+    if (frame->nb_samples > 0
+            && (uint32_t) frame->nb_samples > ap->adaptive.max_frame_samples) {
+        ap->adaptive.max_frame_samples = frame->nb_samples;
+    }
+
+    if (frame->pts == AV_NOPTS_VALUE) {
+        return;
+    }
+
+    sc_tick now = sc_tick_now();
+    if (ap->adaptive.last_pts != AV_NOPTS_VALUE) {
+        // Same formula as the RTP interarrival jitter (RFC 3550 section 6.4.1)
+        // PTS (written by the server) are expressed in microseconds
+        sc_tick d = (now - ap->adaptive.last_arrival)
+                  - SC_TICK_FROM_US(frame->pts - ap->adaptive.last_pts);
+        float d_samples = (float) (d < 0 ? -d : d) * ap->sample_rate
+                        / SC_TICK_FREQ;
+        ap->adaptive.jitter += (d_samples - ap->adaptive.jitter) / 16;
+    }
+
+    ap->adaptive.last_arrival = now;
+    ap->adaptive.last_pts = frame->pts;
+}
+
+// Called every second
+static void
+sc_audio_player_adapt_target(struct sc_audio_player *ap) {
+    // The smallest safe buffering for the link: a whole block plus a margin
+    // for the arrival jitter
+    uint32_t safe = ap->adaptive.max_frame_samples
+                  + (uint32_t) (4 * ap->adaptive.jitter);
+
+    uint32_t target = ap->target_buffering;
+    if (ap->adaptive.underflow) {
+        // Increase quickly on underflow (by 10ms), at least up to the safe
+        // value
+        target = MAX(target + ap->sample_rate / 100, safe);
+        ap->adaptive.stable_periods = 0;
+    } else if (++ap->adaptive.stable_periods >= 10 && target > safe) {
+        // Decrease slowly (by 1ms per second) once stable for 10 seconds,
+        // to converge to the smallest safe value
+        target = MAX(target - ap->sample_rate / 1000, safe);
+    }
+    ap->adaptive.underflow = 0;
+
+    target = CLAMP(target, ap->min_target_buffering, ap->max_target_buffering);
+    if (target != ap->target_buffering) {
+        LOGD("[Audio] Target buffering: %" PRIu32 " -> %" PRIu32
+             " samples (jitter=%f)", ap->target_buffering, target,
+             ap->adaptive.jitter);
+        ap->target_buffering = target;
+        sc_stats_set(ap->stats, SC_STAT_AUDIO_TARGET_BUFFERING_SAMPLES,
+                     sc_audio_player_get_target(ap));
+    }
+}
+
 static bool
 sc_audio_player_frame_sink_push(struct sc_frame_sink *sink,
                                 const AVFrame *frame) {
@@ -142,26 +259,42 @@ sc_audio_player_frame_sink_push(struct sc_frame_sink *sink,
 
     SwrContext *swr_ctx = ap->swr_ctx;
 
+    if (sc_audio_player_is_adaptive(ap)) {
+        sc_audio_player_update_jitter(ap, frame);
+    }
+
     int64_t swr_delay = swr_get_delay(swr_ctx, ap->sample_rate);
-    // No need to av_rescale_rnd(), input and output sample rates are the same.
-    // Add more space (256) for clock compensation.
-    int dst_nb_samples = swr_delay + frame->nb_samples + 256;
 
-    uint8_t *swr_buf = sc_audio_player_get_swr_buf(ap, dst_nb_samples);
-    if (!swr_buf) {
-        return false;
-    }
+    const uint8_t *swr_buf;
+    uint32_t samples;
+    if (ap->passthrough && !ap->compensation && !swr_delay) {
+        // The decoded samples are already in the output format, and there is
+        // nothing to compensate: write them as is
+        swr_buf = frame->data[0];
+        samples = frame->nb_samples;
+    } else {
+        // No need to av_rescale_rnd(), input and output sample rates are the
+        // same. Add more space (256) for clock compensation.
+        int dst_nb_samples = swr_delay + frame->nb_samples + 256;
 
-    int ret = swr_convert(swr_ctx, &swr_buf, dst_nb_samples,
-                          (const uint8_t **) frame->data, frame->nb_samples);
-    if (ret < 0) {
-        LOGE("Resampling failed: %d", ret);
-        return false;
-    }
+        uint8_t *dst = sc_audio_player_get_swr_buf(ap, dst_nb_samples);
+        if (!dst) {
+            return false;
+        }
+
+        int ret = swr_convert(swr_ctx, &dst, dst_nb_samples,
+                              (const uint8_t **) frame->data,
+                              frame->nb_samples);
+        if (ret < 0) {
+            LOGE("Resampling failed: %d", ret);
+            return false;
+        }
 
-    // swr_convert() returns the number of samples which would have been
-    // written if the buffer was big enough.
-    uint32_t samples = MIN(ret, dst_nb_samples);
+        swr_buf = dst;
+        // swr_convert() returns the number of samples which would have been
+        // written if the buffer was big enough.
+        samples = MIN(ret, dst_nb_samples);
+    }
 #ifndef SC_AUDIO_PLAYER_NDEBUG
     LOGD("[Audio] %" PRIu32 " samples written to buffer", samples);
 #endif
@@ -178,86 +311,71 @@ sc_audio_player_frame_sink_push(struct sc_frame_sink *sink,
     uint32_t skipped_samples = 0;
 
     uint32_t written = sc_audiobuf_write(&ap->buf, swr_buf, samples);
-    if (written < samples) {
-        uint32_t remaining = samples - written;
-
-        // All samples that could be written without locking have been written,
-        // now we need to lock to drop/consume old samples
-        SDL_LockAudioDevice(ap->device);
-
-        // Retry with the lock
-        written += sc_audiobuf_write(&ap->buf,
-                                     swr_buf + TO_BYTES(written),
-                                     remaining);
-        if (written < samples) {
-            remaining = samples - written;
-            // Still insufficient, drop old samples to make space
-            skipped_samples = sc_audiobuf_read(&ap->buf, NULL, remaining);
-            assert(skipped_samples == remaining);
-
-            // Now there is enough space
-            uint32_t w = sc_audiobuf_write(&ap->buf,
-                                           swr_buf + TO_BYTES(written),
-                                           remaining);
-            assert(w == remaining);
-            (void) w;
-        }
-
-        SDL_UnlockAudioDevice(ap->device);
+    // Samples which could not be written because the buffer is full
+    uint32_t overflow = samples - written;
+    if (overflow) {
+        // Very unlikely: the buffer is 1 second larger than the target
+        // buffering, so the consumer is stalled. Never wait for it (the audio
+        // callback must not contend with this thread): drop the samples which
+        // do not fit, the buffering threshold below makes the consumer drop
+        // the old ones.
+        LOGD("[Audio] Buffer overflow, dropping %" PRIu32 " samples",
+             overflow);
     }
 
     uint32_t underflow = 0;
+    uint32_t target = sc_audio_player_get_target(ap);
     uint32_t max_buffered_samples;
     bool played = atomic_load_explicit(&ap->played, memory_order_relaxed);
     if (played) {
         underflow = atomic_exchange_explicit(&ap->underflow, 0,
                                              memory_order_relaxed);
 
-        max_buffered_samples = ap->target_buffering
+        max_buffered_samples = target
                                + 12 * ap->output_buffer
-                               + ap->target_buffering / 10;
+                               + target / 10;
     } else {
-        // SDL playback not started yet, do not accumulate more than
+        // Playback not started yet, do not accumulate more than
         // max_initial_buffering samples, this would cause unnecessary delay
         // (and glitches to compensate) on start.
-        max_buffered_samples = ap->target_buffering + 2 * ap->output_buffer;
+        max_buffered_samples = target + 2 * ap->output_buffer;
     }
 
     uint32_t can_read = sc_audiobuf_can_read(&ap->buf);
     if (can_read > max_buffered_samples) {
-        uint32_t skip_samples = 0;
-
-        SDL_LockAudioDevice(ap->device);
-        can_read = sc_audiobuf_can_read(&ap->buf);
-        if (can_read > max_buffered_samples) {
-            skip_samples = can_read - max_buffered_samples;
-            uint32_t r = sc_audiobuf_read(&ap->buf, NULL, skip_samples);
-            assert(r == skip_samples);
-            (void) r;
-            skipped_samples += skip_samples;
-        }
-        SDL_UnlockAudioDevice(ap->device);
-
-        if (skip_samples) {
-            if (played) {
-                LOGD("[Audio] Buffering threshold exceeded, skipping %" PRIu32
-                     " samples", skip_samples);
+        // Drop the oldest samples. They are actually dropped by the audio
+        // callback on its next read, so this never blocks.
+        skipped_samples = can_read - max_buffered_samples;
+        sc_audiobuf_skip(&ap->buf, skipped_samples);
+
+        if (played) {
+            LOGD("[Audio] Buffering threshold exceeded, skipping %" PRIu32
+                 " samples", skipped_samples);
 #ifndef SC_AUDIO_PLAYER_NDEBUG
-            } else {
-                LOGD("[Audio] Playback not started, skipping %" PRIu32
-                     " samples", skip_samples);
+        } else {
+            LOGD("[Audio] Playback not started, skipping %" PRIu32
+                 " samples", skipped_samples);
 #endif
-            }
         }
     }
 
+    if (underflow) {
+        sc_stats_add(ap->stats, SC_STAT_AUDIO_UNDERFLOW_SAMPLES, underflow);
+        ap->adaptive.underflow += underflow;
+    }
+    if (skipped_samples || overflow) {
+        sc_stats_add(ap->stats, SC_STAT_AUDIO_DROPPED_SAMPLES,
+                     skipped_samples + overflow);
+    }
+
     atomic_store_explicit(&ap->received, true, memory_order_relaxed);
     if (!played) {
         // Nothing more to do
         return true;
     }
 
-    // Number of samples added (or removed, if negative) for compensation
+    // Number of samples added (or removed, if negative) for compensation (or
+    // dropped on overflow)
     int32_t instant_compensation = (int32_t) written - frame->nb_samples;
     // Inserting silence instantly increases buffering
     int32_t inserted_silence = (int32_t) underflow;
@@ -279,19 +397,42 @@ sc_audio_player_frame_sink_push(struct sc_frame_sink *sink,
 
     // However, the buffering level must be smoothed
     sc_average_push(&ap->avg_buffering, can_read);
+    sc_stats_set(ap->stats, SC_STAT_AUDIO_BUFFERING_SAMPLES,
+                 sc_average_get(&ap->avg_buffering));
 
 #ifndef SC_AUDIO_PLAYER_NDEBUG
     LOGD("[Audio] can_read=%" PRIu32 " avg_buffering=%f",
          can_read, sc_average_get(&ap->avg_buffering));
 #endif
 
+    if (ap->av_sync && frame->pts != AV_NOPTS_VALUE) {
+        // The samples written are played after the buffered samples and the
+        // audio output buffer. Use the average buffering, the instant value
+        // is too noisy (samples are produced and consumed by blocks).
+        float buffered = sc_average_get(&ap->avg_buffering)
+                       + ap->output_buffer;
+        sc_tick latency = buffered * SC_TICK_FREQ / ap->sample_rate;
+        // PTS (written by the server) are expressed in microseconds
+        sc_tick end_pts = SC_TICK_FROM_US(frame->pts)
+                        + (sc_tick) frame->nb_samples * SC_TICK_FREQ
+                            / ap->sample_rate;
+        sc_av_sync_set_audio(ap->av_sync, end_pts - latency, sc_tick_now(),
+                             latency);
+    }
+
     ap->samples_since_resync += written;
     if (ap->samples_since_resync >= ap->sample_rate) {
         // Recompute compensation every second
         ap->samples_since_resync = 0;
 
+        if (sc_audio_player_is_adaptive(ap)) {
+            sc_audio_player_adapt_target(ap);
+        }
+
+        // The target may have been adapted
+        target = sc_audio_player_get_target(ap);
         float avg = sc_average_get(&ap->avg_buffering);
-        int diff = ap->target_buffering - avg;
+        int diff = target - avg;
 
         // Enable compensation when the difference exceeds +/- 4ms.
         // Disable compensation when the difference is lower than +/- 1ms.
@@ -302,7 +443,7 @@ sc_audio_player_frame_sink_push(struct sc_frame_sink *sink,
         if (abs(diff) < threshold) {
             // Do not compensate for small values, the error is just noise
             diff = 0;
-        } else if (diff < 0 && can_read < ap->target_buffering) {
+        } else if (diff < 0 && can_read < target) {
             // Do not accelerate if the instant buffering level is below the
             // target, this would increase underflow
             diff = 0;
@@ -314,7 +455,7 @@ sc_audio_player_frame_sink_push(struct sc_frame_sink *sink,
         int abs_max_diff = distance / 50;
         diff = CLAMP(diff, -abs_max_diff, abs_max_diff);
         LOGV("[Audio] Buffering: target=%" PRIu32 " avg=%f cur=%" PRIu32
-             " compensation=%d", ap->target_buffering, avg, can_read, diff);
+             " compensation=%d", target, avg, can_read, diff);
 
         if (diff != ap->compensation) {
             int ret = swr_set_compensation(swr_ctx, diff, distance);
@@ -323,6 +464,7 @@ sc_audio_player_frame_sink_push(struct sc_frame_sink *sink,
                 // not fatal
             } else {
                 ap->compensation = diff;
+                sc_stats_set(ap->stats, SC_STAT_AUDIO_COMPENSATION, diff);
             }
         }
     }
@@ -354,32 +496,34 @@ sc_audio_player_frame_sink_open(struct sc_frame_sink *sink,
 
     ap->target_buffering = ap->target_buffering_delay * ap->sample_rate
                                                       / SC_TICK_FREQ;
+    ap->min_target_buffering = ap->min_target_buffering_delay
+                             * ap->sample_rate / SC_TICK_FREQ;
+    ap->max_target_buffering = ap->max_target_buffering_delay
+                             * ap->sample_rate / SC_TICK_FREQ;
+    ap->delay = ap->delay_duration * ap->sample_rate / SC_TICK_FREQ;
+    sc_stats_set(ap->stats, SC_STAT_AUDIO_TARGET_BUFFERING_SAMPLES,
+                 sc_audio_player_get_target(ap));
 
     uint64_t aout_samples = ap->output_buffer_duration * ap->sample_rate
                                                        / SC_TICK_FREQ;
     assert(aout_samples <= 0xFFFF);
     ap->output_buffer = (uint16_t) aout_samples;
 
-    SDL_AudioSpec desired = {
-        .freq = ctx->sample_rate,
-        .format = SC_SDL_SAMPLE_FMT,
-        .channels = nb_channels,
-        .samples = aout_samples,
-        .callback = sc_audio_player_sdl_callback,
-        .userdata = ap,
+    struct sc_audio_output_spec spec = {
+        .sample_rate = ctx->sample_rate,
+        .nb_channels = nb_channels,
+        .buffer_samples = ap->output_buffer,
     };
-    SDL_AudioSpec obtained;
 
-    ap->device = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained, 0);
-    if (!ap->device) {
-        LOGE("Could not open audio device: %s", SDL_GetError());
+    struct sc_audio_output *output = ap->output;
+    if (!output->ops->open(output, &spec, sc_audio_player_fill, ap)) {
         return false;
     }
 
     SwrContext *swr_ctx = swr_alloc();
     if (!swr_ctx) {
         LOG_OOM();
-        goto error_close_audio_device;
+        goto error_close_audio_output;
     }
     ap->swr_ctx = swr_ctx;
 
@@ -399,17 +543,25 @@ sc_audio_player_frame_sink_open(struct sc_frame_sink *sink,
     av_opt_set_sample_fmt(swr_ctx, "in_sample_fmt", ctx->sample_fmt, 0);
     av_opt_set_sample_fmt(swr_ctx, "out_sample_fmt", SC_AV_SAMPLE_FMT, 0);
 
+    // The resampler is still needed for clock compensation
+    ap->passthrough = ctx->sample_fmt == SC_AV_SAMPLE_FMT;
+    if (ap->passthrough) {
+        LOGD("[Audio] Decoded samples are played without conversion");
+    }
+
     int ret = swr_init(swr_ctx);
     if (ret) {
         LOGE("Failed to initialize the resampling context");
         goto error_free_swr_ctx;
     }
 
-    // Use a ring-buffer of the target buffering size plus 1 second between the
-    // producer and the consumer. It's too big on purpose, to guarantee that
-    // the producer and the consumer will be able to access it in parallel
-    // without locking.
-    uint32_t audiobuf_samples = ap->target_buffering + ap->sample_rate;
+    // Use a ring-buffer of the (maximum) target buffering size plus the fixed
+    // delay plus 1 second between the producer and the consumer. It's too big
+    // on purpose, to guarantee that the producer and the consumer will be able
+    // to access it in parallel without locking.
+    uint32_t audiobuf_samples = MAX(ap->target_buffering,
+                                    ap->max_target_buffering)
+                              + ap->delay + ap->sample_rate;
 
     size_t sample_size = ap->nb_channels * ap->out_bytes_per_sample;
     bool ok = sc_audiobuf_init(&ap->buf, sample_size, audiobuf_samples);
@@ -417,13 +569,23 @@ sc_audio_player_frame_sink_open(struct sc_frame_sink *sink,
         goto error_free_swr_ctx;
     }
 
+    ap->history_capacity = ap->sample_rate * SC_AUDIO_PLAYER_CONCEAL_MS / 1000;
+    ap->history = malloc(TO_BYTES(ap->history_capacity));
+    if (!ap->history) {
+        LOG_OOM();
+        goto error_destroy_audiobuf;
+    }
+    ap->history_len = 0;
+    ap->concealed = 0;
+
     size_t initial_swr_buf_size = TO_BYTES(4096);
     ap->swr_buf = malloc(initial_swr_buf_size);
     if (!ap->swr_buf) {
         LOG_OOM();
-        goto error_destroy_audiobuf;
+        goto error_free_history;
     }
     ap->swr_buf_alloc_size = initial_swr_buf_size;
+    sc_stats_add(ap->stats, SC_STAT_MEM_SWR_BYTES, initial_swr_buf_size);
 
     // Samples are produced and consumed by blocks, so the buffering must be
     // smoothed to get a relatively stable value.
@@ -436,24 +598,37 @@ sc_audio_player_frame_sink_open(struct sc_frame_sink *sink,
     atomic_init(&ap->underflow, 0);
     ap->compensation = 0;
 
+    // Fade in over 5ms, on start and after each underflow
+    ap->fade = 0;
+    ap->fade_step = 1000.f / (5 * ap->sample_rate);
+
+    ap->adaptive.jitter = 0;
+    ap->adaptive.last_arrival = 0;
+    ap->adaptive.last_pts = AV_NOPTS_VALUE;
+    ap->adaptive.max_frame_samples = 0;
+    ap->adaptive.underflow = 0;
+    ap->adaptive.stable_periods = 0;
+
     // The thread calling open() is the thread calling push(), which fills the
-    // audio buffer consumed by the SDL audio thread.
+    // audio buffer consumed by the audio output thread.
     ok = sc_thread_set_priority(SC_THREAD_PRIORITY_TIME_CRITICAL);
     if (!ok) {
         ok = sc_thread_set_priority(SC_THREAD_PRIORITY_HIGH);
         (void) ok; // We don't care if it worked, at least we tried
     }
 
-    SDL_PauseAudioDevice(ap->device, 0);
+    output->ops->start(output);
 
     return true;
 
+error_free_history:
+    free(ap->history);
 error_destroy_audiobuf:
     sc_audiobuf_destroy(&ap->buf);
 error_free_swr_ctx:
     swr_free(&ap->swr_ctx);
-error_close_audio_device:
-    SDL_CloseAudioDevice(ap->device);
+error_close_audio_output:
+    output->ops->close(output);
 
     return false;
 }
@@ -462,20 +637,28 @@ static void
 sc_audio_player_frame_sink_close(struct sc_frame_sink *sink) {
     struct sc_audio_player *ap = DOWNCAST(sink);
 
-    assert(ap->device);
-    SDL_PauseAudioDevice(ap->device, 1);
-    SDL_CloseAudioDevice(ap->device);
+    ap->output->ops->close(ap->output);
 
     free(ap->swr_buf);
+    sc_stats_add(ap->stats, SC_STAT_MEM_SWR_BYTES,
+                 -(int64_t) ap->swr_buf_alloc_size);
+    free(ap->history);
     sc_audiobuf_destroy(&ap->buf);
     swr_free(&ap->swr_ctx);
 }
 
 void
-sc_audio_player_init(struct sc_audio_player *ap, sc_tick target_buffering,
-                     sc_tick output_buffer_duration) {
-    ap->target_buffering_delay = target_buffering;
-    ap->output_buffer_duration = output_buffer_duration;
+sc_audio_player_init(struct sc_audio_player *ap,
+                     const struct sc_audio_player_params *params) {
+    ap->output = params->output;
+    ap->av_sync = params->av_sync;
+    ap->target_buffering_delay = params->target_buffering;
+    ap->min_target_buffering_delay = params->min_target_buffering;
+    ap->max_target_buffering_delay = params->max_target_buffering;
+    ap->delay_duration = params->delay;
+    ap->output_buffer_duration = params->output_buffer;
+    ap->gain = params->gain;
+    ap->stats = params->stats;
 
     static const struct sc_frame_sink_ops ops = {
         .open = sc_audio_player_frame_sink_open,
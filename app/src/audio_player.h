@@ -7,18 +7,21 @@
 #include <stdbool.h>
 #include <libavformat/avformat.h>
 #include <libswresample/swresample.h>
-#include <SDL2/SDL.h>
 
+#include "av_sync.h"
+#include "stats.h"
+#include "trait/audio_output.h"
 #include "trait/frame_sink.h"
 #include "util/audiobuf.h"
 #include "util/average.h"
+#include "util/gain.h"
 #include "util/thread.h"
 #include "util/tick.h"
 
 struct sc_audio_player {
     struct sc_frame_sink frame_sink;
 
-    SDL_AudioDeviceID device;
+    struct sc_audio_output *output;
 
     // The target buffering between the producer and the consumer. This value
     // is directly use for compensation.
@@ -28,16 +31,32 @@ struct sc_audio_player {
     sc_tick target_buffering_delay;
     uint32_t target_buffering; // in samples
 
-    // SDL audio output buffer size.
+    // Bounds of the target buffering, if it adapts to the observed jitter and
+    // underflows (both 0 if the target buffering is fixed)
+    sc_tick min_target_buffering_delay;
+    sc_tick max_target_buffering_delay;
+    uint32_t min_target_buffering; // in samples
+    uint32_t max_target_buffering; // in samples
+
+    // Fixed delay added to the target buffering (not adapted). The delayed
+    // samples are kept in the audio buffer, so the delay is sample-accurate
+    // and costs no allocation.
+    sc_tick delay_duration;
+    uint32_t delay; // in samples
+
+    // Audio output buffer size.
     sc_tick output_buffer_duration;
     uint16_t output_buffer;
 
-    // Audio buffer to communicate between the receiver and the SDL audio
+    // Audio buffer to communicate between the receiver and the audio output
     // callback
     struct sc_audiobuf buf;
 
     // Resampler (only used from the receiver thread)
     struct SwrContext *swr_ctx;
+    // Set if the decoded samples are already in the output format, so that
+    // the resampler is only needed while compensation is active
+    bool passthrough;
 
     // The sample rate is the same for input and output
     unsigned sample_rate;
@@ -60,15 +79,51 @@ struct sc_audio_player {
     // Number of silence samples inserted since the last received packet
     atomic_uint_least32_t underflow;
 
+    // State of the target buffering adaptation (only used by the receiver
+    // thread)
+    struct {
+        // Mean deviation of the frames inter-arrival times from their PTS
+        // differences (in samples)
+        float jitter;
+        sc_tick last_arrival;
+        int64_t last_pts;
+        // Largest frame received (the buffering must absorb a whole block)
+        uint32_t max_frame_samples;
+        // Silence samples inserted since the last adaptation
+        uint32_t underflow;
+        // Number of consecutive adaptation periods without underflow
+        unsigned stable_periods;
+    } adaptive;
+
     // Current applied compensation value (only used by the receiver thread)
     int compensation;
 
     // Set to true the first time a sample is received
     atomic_bool received;
 
-    // Set to true the first time the SDL callback is called
+    // Set to true the first time the audio output callback is called
     atomic_bool played;
 
+    // Gain applied to the samples played
+    float gain;
+    // Fade-in factor, reset to 0 on underflow (only used by the audio output
+    // thread), so that playback resumes smoothly instead of abruptly
+    float fade;
+    // Fade-in factor increment per sample
+    float fade_step;
+
+    // Last samples played, to conceal the missing samples on underflow (only
+    // used by the audio output thread)
+    float *history;
+    uint32_t history_capacity; // in samples
+    uint32_t history_len; // in samples
+    // Number of history samples already played back to conceal the current
+    // underflow
+    uint32_t concealed;
+
+    struct sc_av_sync *av_sync; // may be NULL
+    struct sc_stats *stats; // may be NULL
+
     const struct sc_audio_player_callbacks *cbs;
     void *cbs_userdata;
 };
@@ -77,8 +132,25 @@ struct sc_audio_player_callbacks {
     void (*on_ended)(struct sc_audio_player *ap, bool success, void *userdata);
 };
 
+struct sc_audio_player_params {
+    sc_tick target_buffering;
+    // If max_target_buffering is not 0, the target buffering starts at
+    // target_buffering and adapts to the link in the range
+    // [min_target_buffering, max_target_buffering]
+    sc_tick min_target_buffering;
+    sc_tick max_target_buffering;
+    // Additional fixed playback delay (0 for none)
+    sc_tick delay;
+    sc_tick output_buffer;
+    // Gain applied to the samples played (1 to play them as is)
+    float gain;
+    struct sc_audio_output *output;
+    struct sc_av_sync *av_sync; // may be NULL
+    struct sc_stats *stats; // may be NULL
+};
+
 void
-sc_audio_player_init(struct sc_audio_player *ap, sc_tick target_buffering,
-                     sc_tick audio_output_buffer);
+sc_audio_player_init(struct sc_audio_player *ap,
+                     const struct sc_audio_player_params *params);
 
 #endif
@@ -0,0 +1,40 @@
+#include "av_sync.h"
+
+void
+sc_av_sync_init(struct sc_av_sync *sync, struct sc_stats *stats) {
+    atomic_init(&sync->audio_offset, SC_AV_SYNC_UNKNOWN);
+    atomic_init(&sync->audio_latency, 0);
+    sync->stats = stats;
+}
+
+void
+sc_av_sync_set_audio(struct sc_av_sync *sync, sc_tick pts, sc_tick now,
+                     sc_tick latency) {
+    // A single value is enough to retrieve the audio PTS at any system time,
+    // so that the reader never sees an inconsistent (pts, date) pair
+    atomic_store_explicit(&sync->audio_offset, pts - now,
+                          memory_order_relaxed);
+    atomic_store_explicit(&sync->audio_latency, latency, memory_order_relaxed);
+    sc_stats_set(sync->stats, SC_STAT_AUDIO_LATENCY_MS,
+                 SC_TICK_TO_MS(latency));
+}
+
+sc_tick
+sc_av_sync_get_audio_latency(struct sc_av_sync *sync) {
+    return atomic_load_explicit(&sync->audio_latency, memory_order_relaxed);
+}
+
+void
+sc_av_sync_on_video_presented(struct sc_av_sync *sync, int64_t pts) {
+    int64_t audio_offset =
+        atomic_load_explicit(&sync->audio_offset, memory_order_relaxed);
+    if (audio_offset == SC_AV_SYNC_UNKNOWN) {
+        // Audio not played yet
+        return;
+    }
+
+    // PTS (written by the server) are expressed in microseconds
+    sc_tick audio_pts = sc_tick_now() + audio_offset;
+    sc_tick offset = SC_TICK_FROM_US(pts) - audio_pts;
+    sc_stats_set(sync->stats, SC_STAT_AV_OFFSET_MS, SC_TICK_TO_MS(offset));
+}
@@ -0,0 +1,65 @@
+#ifndef SC_AV_SYNC_H
+#define SC_AV_SYNC_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stats.h"
+#include "util/tick.h"
+
+/**
+ * Audio/video synchronization
+ *
+ * The audio player publishes the device PTS of the samples currently played,
+ * expressed as an offset from the system time, and its output latency (the
+ * delay between the reception of a sample and its playback).
+ *
+ * In sync mode, the display buffer delays the video frames by this latency,
+ * so that the audio and the video are presented at the same time. In any
+ * case, the screen measures the resulting A/V offset on each frame presented.
+ *
+ * All the values are accessed via lock-free atomic operations, since they are
+ * written and read from different threads.
+ */
+struct sc_av_sync {
+    // Device PTS of the audio played at system time t, minus t
+    // (SC_AV_SYNC_UNKNOWN until the audio playback has started)
+    atomic_int_least64_t audio_offset;
+    // Estimated audio output latency (0 until the audio playback has started)
+    atomic_int_least64_t audio_latency;
+
+    struct sc_stats *stats; // may be NULL
+};
+
+#define SC_AV_SYNC_UNKNOWN INT64_MIN
+
+void
+sc_av_sync_init(struct sc_av_sync *sync, struct sc_stats *stats);
+
+/**
+ * Called by the audio player after writing a frame
+ *
+ * \param pts the device PTS of the samples being played at system time `now`
+ * \param latency the estimated delay between the reception and the playback
+ *                of a sample
+ */
+void
+sc_av_sync_set_audio(struct sc_av_sync *sync, sc_tick pts, sc_tick now,
+                     sc_tick latency);
+
+/**
+ * Return the current audio latency, or 0 if it is not known yet
+ */
+sc_tick
+sc_av_sync_get_audio_latency(struct sc_av_sync *sync);
+
+/**
+ * Called by the screen when a video frame is presented
+ */
+void
+sc_av_sync_on_video_presented(struct sc_av_sync *sync, int64_t pts);
+
+#endif
@@ -0,0 +1,316 @@
+#include "avio_writer.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavutil/mem.h>
+
+#include "util/log.h"
+
+#define SC_AVIO_WRITER_MIN_CHUNKS 2
+
+static void
+sc_avio_writer_free_buffers(struct sc_avio_writer *writer) {
+    while (!sc_vecdeque_is_empty(&writer->queue)) {
+        struct sc_avio_writer_chunk chunk = sc_vecdeque_pop(&writer->queue);
+        free(chunk.data);
+    }
+    while (!sc_vecdeque_is_empty(&writer->spare_buffers)) {
+        free(sc_vecdeque_pop(&writer->spare_buffers));
+    }
+    free(writer->chunk.data);
+}
+
+// Queue the current chunk (if not empty), and prepare a new one at the current
+// position (if `next` is set)
+//
+// Called from the muxer thread.
+static bool
+sc_avio_writer_submit(struct sc_avio_writer *writer, bool next) {
+    struct sc_avio_writer_chunk *chunk = &writer->chunk;
+
+    sc_mutex_lock(&writer->mutex);
+
+    if (chunk->len) {
+        // Block the muxer only if the whole buffer is pending
+        while (!writer->failed
+                && sc_vecdeque_size(&writer->queue) >= writer->max_chunks) {
+            sc_cond_wait(&writer->cond, &writer->mutex);
+        }
+
+        if (writer->failed) {
+            sc_mutex_unlock(&writer->mutex);
+            return false;
+        }
+
+        sc_vecdeque_push_noresize(&writer->queue, *chunk);
+        sc_cond_signal(&writer->cond);
+
+        chunk->data = NULL;
+    } else if (writer->failed) {
+        sc_mutex_unlock(&writer->mutex);
+        return false;
+    }
+
+    if (next && !chunk->data && !sc_vecdeque_is_empty(&writer->spare_buffers)) {
+        chunk->data = sc_vecdeque_pop(&writer->spare_buffers);
+    }
+
+    sc_mutex_unlock(&writer->mutex);
+
+    if (next && !chunk->data) {
+        chunk->data = malloc(writer->chunk_size);
+        if (!chunk->data) {
+            LOG_OOM();
+            return false;
+        }
+    }
+
+    chunk->offset = writer->pos;
+    chunk->len = 0;
+    return true;
+}
+
+#ifdef SCRCPY_LAVF_HAS_AVIO_WRITE_CONST
+static int
+sc_avio_writer_write_packet(void *opaque, const uint8_t *buf, int buf_size) {
+#else
+static int
+sc_avio_writer_write_packet(void *opaque, uint8_t *buf, int buf_size) {
+#endif
+    struct sc_avio_writer *writer = opaque;
+    struct sc_avio_writer_chunk *chunk = &writer->chunk;
+
+    assert(buf_size >= 0);
+    size_t remaining = buf_size;
+    while (remaining) {
+        if (!chunk->data || chunk->len == writer->chunk_size
+                || chunk->offset + (int64_t) chunk->len != writer->pos) {
+            if (!sc_avio_writer_submit(writer, true)) {
+                return AVERROR(EIO);
+            }
+        }
+
+        size_t len = MIN(remaining, writer->chunk_size - chunk->len);
+        memcpy(&chunk->data[chunk->len], buf, len);
+        chunk->len += len;
+        writer->pos += len;
+        buf += len;
+        remaining -= len;
+    }
+
+    if (writer->pos > writer->size) {
+        writer->size = writer->pos;
+    }
+
+    return buf_size;
+}
+
+static int64_t
+sc_avio_writer_seek(void *opaque, int64_t offset, int whence) {
+    struct sc_avio_writer *writer = opaque;
+
+    // The data is only written on the next write_packet(), at its own
+    // position
+    switch (whence & ~AVSEEK_FORCE) {
+        case AVSEEK_SIZE:
+            return writer->size;
+        case SEEK_SET:
+            writer->pos = offset;
+            break;
+        case SEEK_CUR:
+            writer->pos += offset;
+            break;
+        case SEEK_END:
+            writer->pos = writer->size + offset;
+            break;
+        default:
+            return AVERROR(EINVAL);
+    }
+
+    return writer->pos;
+}
+
+static bool
+sc_avio_writer_write_chunk(struct sc_avio_writer *writer,
+                           const struct sc_avio_writer_chunk *chunk) {
+    AVIOContext *out = writer->out;
+    if (avio_tell(out) != chunk->offset
+            && avio_seek(out, chunk->offset, SEEK_SET) < 0) {
+        LOGE("Could not seek in the output file");
+        return false;
+    }
+
+    // The output is unbuffered (AVIO_FLAG_DIRECT), so this is a single write
+    avio_write(out, chunk->data, chunk->len);
+    if (out->error) {
+        LOGE("Could not write to the output file: %d", out->error);
+        return false;
+    }
+
+    return true;
+}
+
+static int
+run_avio_writer(void *data) {
+    struct sc_avio_writer *writer = data;
+
+    for (;;) {
+        sc_mutex_lock(&writer->mutex);
+        while (!writer->stopped && sc_vecdeque_is_empty(&writer->queue)) {
+            sc_cond_wait(&writer->cond, &writer->mutex);
+        }
+
+        if (sc_vecdeque_is_empty(&writer->queue)) {
+            // Stopped, and all the chunks have been written
+            assert(writer->stopped);
+            sc_mutex_unlock(&writer->mutex);
+            break;
+        }
+
+        // Keep the chunk in the queue while it is written, so that the muxer
+        // blocks only when max_chunks are pending
+        struct sc_avio_writer_chunk chunk = *sc_vecdeque_peek(&writer->queue);
+        bool failed = writer->failed;
+        sc_mutex_unlock(&writer->mutex);
+
+        bool ok = failed || sc_avio_writer_write_chunk(writer, &chunk);
+
+        sc_mutex_lock(&writer->mutex);
+        (void) sc_vecdeque_popref(&writer->queue); // the chunk is copied
+        // The spare buffers are reserved for max_chunks + 1 items
+        sc_vecdeque_push_noresize(&writer->spare_buffers, chunk.data);
+        if (!ok) {
+            writer->failed = true;
+        }
+        sc_cond_signal(&writer->cond);
+        sc_mutex_unlock(&writer->mutex);
+    }
+
+    return 0;
+}
+
+struct sc_avio_writer *
+sc_avio_writer_open(const char *filename, size_t buffer_size) {
+    struct sc_avio_writer *writer = malloc(sizeof(*writer));
+    if (!writer) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    writer->chunk_size = MIN(SC_AVIO_WRITER_MAX_CHUNK_SIZE,
+                             buffer_size / SC_AVIO_WRITER_MIN_CHUNKS);
+    assert(writer->chunk_size);
+    writer->max_chunks = buffer_size / writer->chunk_size;
+
+    writer->chunk.data = NULL;
+    writer->chunk.offset = 0;
+    writer->chunk.len = 0;
+    writer->pos = 0;
+    writer->size = 0;
+    writer->stopped = false;
+    writer->failed = false;
+
+    sc_vecdeque_init(&writer->queue);
+    sc_vecdeque_init(&writer->spare_buffers);
+
+    // Reserve the queues once, so that pushing never fails
+    if (!sc_vecdeque_reserve(&writer->queue, writer->max_chunks)
+            || !sc_vecdeque_reserve(&writer->spare_buffers,
+                                    writer->max_chunks + 1)) {
+        LOG_OOM();
+        goto error_destroy_queues;
+    }
+
+    // Every write is large, bypass the AVIO buffer of the output
+    int r = avio_open(&writer->out, filename,
+                      AVIO_FLAG_WRITE | AVIO_FLAG_DIRECT);
+    if (r < 0) {
+        LOGE("Failed to open output file: %s", filename);
+        goto error_destroy_queues;
+    }
+
+    uint8_t *buffer = av_malloc(SC_AVIO_WRITER_AVIO_BUFFER_SIZE);
+    if (!buffer) {
+        LOG_OOM();
+        goto error_close_output;
+    }
+
+    writer->pb = avio_alloc_context(buffer, SC_AVIO_WRITER_AVIO_BUFFER_SIZE, 1,
+                                    writer, NULL, sc_avio_writer_write_packet,
+                                    sc_avio_writer_seek);
+    if (!writer->pb) {
+        LOG_OOM();
+        av_free(buffer);
+        goto error_close_output;
+    }
+
+    bool ok = sc_mutex_init(&writer->mutex);
+    if (!ok) {
+        goto error_free_pb;
+    }
+
+    ok = sc_cond_init(&writer->cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    LOGD("Starting avio writer thread");
+    ok = sc_thread_create(&writer->thread, run_avio_writer, "scrcpy-rec-io",
+                          writer);
+    if (!ok) {
+        LOGE("Could not start avio writer thread");
+        goto error_destroy_cond;
+    }
+
+    return writer;
+
+error_destroy_cond:
+    sc_cond_destroy(&writer->cond);
+error_destroy_mutex:
+    sc_mutex_destroy(&writer->mutex);
+error_free_pb:
+    av_freep(&writer->pb->buffer);
+    avio_context_free(&writer->pb);
+error_close_output:
+    avio_closep(&writer->out);
+error_destroy_queues:
+    sc_vecdeque_destroy(&writer->spare_buffers);
+    sc_vecdeque_destroy(&writer->queue);
+    free(writer);
+
+    return NULL;
+}
+
+bool
+sc_avio_writer_close(struct sc_avio_writer *writer) {
+    // Push the content of the AVIO buffer, then the last chunk
+    avio_flush(writer->pb);
+    bool ok = !writer->pb->error && sc_avio_writer_submit(writer, false);
+
+    sc_mutex_lock(&writer->mutex);
+    writer->stopped = true;
+    sc_cond_signal(&writer->cond);
+    sc_mutex_unlock(&writer->mutex);
+
+    sc_thread_join(&writer->thread, NULL);
+
+    if (writer->failed) {
+        ok = false;
+    }
+
+    if (avio_closep(&writer->out) < 0) {
+        ok = false;
+    }
+
+    sc_avio_writer_free_buffers(writer);
+    sc_vecdeque_destroy(&writer->spare_buffers);
+    sc_vecdeque_destroy(&writer->queue);
+    sc_cond_destroy(&writer->cond);
+    sc_mutex_destroy(&writer->mutex);
+    av_freep(&writer->pb->buffer);
+    avio_context_free(&writer->pb);
+    free(writer);
+
+    return ok;
+}
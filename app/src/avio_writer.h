@@ -0,0 +1,81 @@
+#ifndef SC_AVIO_WRITER_H
+#define SC_AVIO_WRITER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavformat/avio.h>
+
+#include "util/thread.h"
+#include "util/vecdeque.h"
+
+// Size of the buffer of the AVIO context filled by the muxer
+#define SC_AVIO_WRITER_AVIO_BUFFER_SIZE (64 * 1024)
+// Maximum size of each write to the output
+#define SC_AVIO_WRITER_MAX_CHUNK_SIZE (1024 * 1024)
+
+struct sc_avio_writer_chunk {
+    int64_t offset; // position in the output
+    size_t len;
+    uint8_t *data; // capacity: chunk_size
+};
+
+struct sc_avio_writer_queue SC_VECDEQUE(struct sc_avio_writer_chunk);
+struct sc_avio_writer_buffers SC_VECDEQUE(uint8_t *);
+
+/**
+ * Write to a file from a dedicated thread, through a large memory buffer
+ *
+ * The muxer writes to a custom AVIO context (`pb`), whose content is
+ * accumulated into large chunks, written to the actual output by the writer
+ * thread. This decouples the muxing (and the packet queue of the recorder)
+ * from the disk latency: the muxer only blocks once the whole buffer is full.
+ *
+ * Seeking is supported (the muxers update the headers on finalization): each
+ * chunk is written at its own position, in order.
+ */
+struct sc_avio_writer {
+    // The context to write to (owned by the writer)
+    AVIOContext *pb;
+
+    // The actual output (only accessed from the writer thread once started)
+    AVIOContext *out;
+
+    size_t chunk_size;
+    size_t max_chunks; // queued before the muxer blocks
+
+    // Only accessed from the muxer thread
+    struct sc_avio_writer_chunk chunk; // being filled
+    int64_t pos; // current position
+    int64_t size; // current size of the output
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond; // signaled when a chunk is queued or written, or on stop
+    bool stopped;
+    bool failed;
+    struct sc_avio_writer_queue queue;
+    struct sc_avio_writer_buffers spare_buffers; // to avoid reallocations
+};
+
+/**
+ * Open the output file and start the writer thread
+ *
+ * The buffer size is the total size of the data which may be pending.
+ *
+ * Return NULL on error.
+ */
+struct sc_avio_writer *
+sc_avio_writer_open(const char *filename, size_t buffer_size);
+
+/**
+ * Write all the pending data, close the output file and free the writer
+ *
+ * Return false if any write failed.
+ */
+bool
+sc_avio_writer_close(struct sc_avio_writer *writer);
+
+#endif
@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "options.h"
@@ -97,6 +98,89 @@ enum {
     OPT_MOUSE,
     OPT_HID_KEYBOARD_DEPRECATED,
     OPT_HID_MOUSE_DEPRECATED,
+    OPT_VIDEO_HWACCEL,
+    OPT_DISPLAY_PACING,
+    OPT_PRINT_LATENCY,
+    OPT_STATS_FILE,
+    OPT_STATS_FORMAT,
+    OPT_ADAPTIVE_BIT_RATE,
+    OPT_VIDEO_REPEAT_DELAY,
+    OPT_RECORD_VIDEO_BIT_RATE,
+    OPT_VIDEO_LATENCY_PROFILE,
+    OPT_VIDEO_INTRA_REFRESH,
+    OPT_RECORD_QUEUE_LIMIT,
+    OPT_RECORD_SEGMENT,
+    OPT_RECORD_SEGMENT_COUNT,
+    OPT_RECORD_FRAGMENTED,
+    OPT_REPLAY_BUFFER,
+    OPT_REPLAY_FILE,
+    OPT_V4L2_FORMAT,
+    OPT_V4L2_MAX_SIZE,
+    OPT_AV_SYNC,
+    OPT_ADAPTIVE_AUDIO_BUFFER,
+    OPT_AUDIO_SAMPLE_RATE,
+    OPT_AUDIO_READ_SIZE,
+    OPT_AUDIO_VOLUME,
+    OPT_INPUT_RECORD,
+    OPT_INPUT_REPLAY,
+    OPT_MOUSE_REPORT_INTERVAL,
+    OPT_INPUT_OVERLAY,
+    OPT_SERVER_IDLE_TIMEOUT,
+    OPT_SOCKET_BUFFER_SIZE,
+    OPT_MULTIPLEX,
+    OPT_DIRECT_PORT,
+    OPT_DIRECT_UDP,
+    OPT_BENCHMARK_STARTUP,
+    OPT_THUMBNAIL_DECODING,
+    OPT_WALL,
+    OPT_VIDEO_DECODER_THREADING,
+    OPT_VIDEO_DECODER_THREADS,
+    OPT_VIDEO_HDR,
+    OPT_NEW_DISPLAY,
+    OPT_REALTIME_THREADS,
+    OPT_CPU_AFFINITY,
+    OPT_OTG_RECONNECT,
+    OPT_GAMEPAD,
+    OPT_SHUTDOWN_TIMEOUT,
+    OPT_DEVICES_CACHE,
+    OPT_SCREENSHOT_FILE,
+    OPT_SQUARE_VIDEO,
+    OPT_GPU_DOWNSCALE,
+    OPT_VIDEO_MASK,
+    OPT_ADAPTIVE_FPS,
+    OPT_CAMERA_LOW_LATENCY,
+    OPT_CAMERA_LOCK_AE_AF,
+    OPT_DUMP_STREAMS,
+    OPT_REPLAY_STREAMS,
+    OPT_REPLAY_STREAMS_MAX_SPEED,
+    OPT_PATTERN_SIZE,
+    OPT_PATTERN_FPS,
+    OPT_PERF_OVERLAY,
+    OPT_RESTREAM,
+    OPT_FRAME_SHARE,
+    OPT_CONTROL_PORT,
+    OPT_ADAPTIVE_SIZE,
+    OPT_COMPRESS_CONTROL,
+    OPT_VIDEO_RECONNECT,
+    OPT_VIDEO_PACING,
+    OPT_RECORD_LOW_LATENCY,
+    OPT_RECORD_UPLOAD,
+    OPT_RESTREAM_VIDEO_ENCODER,
+    OPT_LIST_CACHE,
+    OPT_CONTROL_IO_LOOP,
+    OPT_SCREEN_STABILITY,
+    OPT_FRAME_HASH_FILE,
+    OPT_FRAME_HASH_INTERVAL,
+    OPT_UPSCALE_FILTER,
+    OPT_THERMAL_GOVERNOR,
+    OPT_WALL_PREVIEW_INTERVAL,
+    OPT_WALL_BACKGROUND_FPS,
+    OPT_RECORD_WRITE_BUFFER,
+    OPT_PERSISTENT_TUNNEL,
+    OPT_RECORD_THUMBNAILS,
+    OPT_AUDIO_CHANNELS,
+    OPT_AUDIO_DELAY,
+    OPT_RECORD_VIDEO_SOURCE,
 };
 
 struct sc_option {
@@ -133,6 +217,53 @@ struct sc_getopt_adapter {
 };
 
 static const struct sc_option options[] = {
+    {
+        .longopt_id = OPT_ADAPTIVE_AUDIO_BUFFER,
+        .longopt = "adaptive-audio-buffer",
+        .argdesc = "min:max",
+        .text = "Adapt the audio buffering to the observed packet jitter and "
+                "buffer underflows, within the given bounds (in "
+                "milliseconds). It increases quickly on underflow, and slowly "
+                "decreases to the smallest safe value for the link.\n"
+                "The initial value is given by --audio-buffer.",
+    },
+    {
+        .longopt_id = OPT_ADAPTIVE_BIT_RATE,
+        .longopt = "adaptive-bit-rate",
+        .text = "Adapt the video bit rate to the network conditions: the "
+                "client reports the measured queuing delay and jitter to the "
+                "device, which lowers the encoder bit rate on congestion and "
+                "raises it back (up to --video-bit-rate) once the network "
+                "recovers.\n"
+                "It requires control, so it is incompatible with --no-control "
+                "and camera mirroring.",
+    },
+    {
+        .longopt_id = OPT_ADAPTIVE_FPS,
+        .longopt = "adaptive-fps",
+        .text = "Skip the captured frames which do not change the content "
+                "noticeably (compared on the device GPU at a low resolution), "
+                "so that static or almost static content is encoded at a low "
+                "frame rate (10 fps), while motion goes through at the full "
+                "frame rate (see --max-fps).\n"
+                "It saves bandwidth and device power.",
+    },
+    {
+        .longopt_id = OPT_ADAPTIVE_SIZE,
+        .longopt = "adaptive-size",
+        .text = "Adapt the video size and frame rate to the network "
+                "conditions, typically over a wireless connection: on "
+                "sustained congestion (measured by the queuing delay of the "
+                "received video packets), the limits are lowered step by step "
+                "(1920, 1600, 1280, then 1024, 800 and 640 at a reduced frame "
+                "rate), and raised back up to the initial limits (see "
+                "--max-size and --max-fps) once the network has been clear for "
+                "a while.\n"
+                "Each change restarts the encoder. It may be combined with "
+                "--adaptive-bit-rate, which reacts faster.\n"
+                "It requires control, so it is incompatible with --no-control "
+                "and camera mirroring.",
+    },
     {
         .longopt_id = OPT_ALWAYS_ON_TOP,
         .longopt = "always-on-top",
@@ -155,6 +286,17 @@ static const struct sc_option options[] = {
                 "likelyhood of buffer underrun (causing audio glitches).\n"
                 "Default is 50.",
     },
+    {
+        .longopt_id = OPT_AUDIO_CHANNELS,
+        .longopt = "audio-channels",
+        .argdesc = "n",
+        .text = "Capture and encode the audio with the given number of "
+                "channels: 1 (mono) or 2 (stereo).\n"
+                "For monitoring, mono audio at a lower sample rate (see "
+                "--audio-sample-rate) and bit rate reduces the bandwidth and "
+                "the CPU usage.\n"
+                "Default is 2.",
+    },
     {
         .longopt_id = OPT_AUDIO_CODEC,
         .longopt = "audio-codec",
@@ -174,6 +316,17 @@ static const struct sc_option options[] = {
                 "Android documentation: "
                 "<https://d.android.com/reference/android/media/MediaFormat>",
     },
+    {
+        .longopt_id = OPT_AUDIO_DELAY,
+        .longopt = "audio-delay",
+        .argdesc = "ms",
+        .text = "Delay the audio playback by the given amount of time (in "
+                "milliseconds), in addition to the audio buffering, for "
+                "example to keep it in sync with a video delayed by "
+                "--display-buffer.\n"
+                "It is incompatible with --av-sync.\n"
+                "Default is 0 (no delay).",
+    },
     {
         .longopt_id = OPT_AUDIO_ENCODER,
         .longopt = "audio-encoder",
@@ -182,6 +335,27 @@ static const struct sc_option options[] = {
                 "codec provided by --audio-codec).\n"
                 "The available encoders can be listed by --list-encoders.",
     },
+    {
+        .longopt_id = OPT_AUDIO_READ_SIZE,
+        .longopt = "audio-read-size",
+        .argdesc = "samples",
+        .text = "Set the number of audio samples read at once from the capture "
+                "on the device.\n"
+                "Most devices capture audio by blocks of 1024 samples, so a "
+                "lower value is useless, but on devices capturing smaller "
+                "blocks, a lower value (for example 480 or 240, matching the "
+                "Opus 10ms and 5ms frames at 48kHz) reduces the latency.\n"
+                "Default is 1024.",
+    },
+    {
+        .longopt_id = OPT_AUDIO_SAMPLE_RATE,
+        .longopt = "audio-sample-rate",
+        .argdesc = "value",
+        .text = "Capture and encode the audio at the given sample rate (in "
+                "Hz). It must be supported by the device and the audio "
+                "codec.\n"
+                "Default is 48000.",
+    },
     {
         .longopt_id = OPT_AUDIO_SOURCE,
         .longopt = "audio-source",
@@ -189,6 +363,14 @@ static const struct sc_option options[] = {
         .text = "Select the audio source (output or mic).\n"
                 "Default is output.",
     },
+    {
+        .longopt_id = OPT_AUDIO_VOLUME,
+        .longopt = "audio-volume",
+        .argdesc = "percent",
+        .text = "Set the volume of the audio playback, as a percentage of the "
+                "captured volume (between 0 and 400).\n"
+                "Default is 100.",
+    },
     {
         .longopt_id = OPT_AUDIO_OUTPUT_BUFFER,
         .longopt = "audio-output-buffer",
@@ -199,6 +381,15 @@ static const struct sc_option options[] = {
                 "a higher value (10). Do not change this setting otherwise.\n"
                 "Default is 5.",
     },
+    {
+        .longopt_id = OPT_AV_SYNC,
+        .longopt = "av-sync",
+        .text = "Delay the video by the audio playback latency, so that the "
+                "video is presented in sync with the audio.\n"
+                "The delay follows the audio buffering over time (see "
+                "--audio-buffer). It is incompatible with --display-buffer "
+                "and --display-pacing.",
+    },
     {
         .shortopt = 'b',
         .longopt = "video-bit-rate",
@@ -213,6 +404,15 @@ static const struct sc_option options[] = {
         .longopt = "bit-rate",
         .argdesc = "value",
     },
+    {
+        .longopt_id = OPT_BENCHMARK_STARTUP,
+        .longopt = "benchmark-startup",
+        .text = "Measure the startup time: exit once the first frame is "
+                "presented, and print the time of each startup step (in "
+                "milliseconds since the start of scrcpy) as JSON to the "
+                "standard output.\n"
+                "It requires video playback.",
+    },
     {
         .longopt_id = OPT_CAMERA_AR,
         .longopt = "camera-ar",
@@ -244,6 +444,22 @@ static const struct sc_option options[] = {
                 "This mode is restricted to specific resolutions and frame "
                 "rates, listed by --list-camera-sizes.",
     },
+    {
+        .longopt_id = OPT_CAMERA_LOCK_AE_AF,
+        .longopt = "camera-lock-ae-af",
+        .text = "Lock the camera exposure and focus once they have "
+                "converged, so that they do not change during the capture "
+                "(e.g. for latency measurements).\n"
+                "It is not available with --camera-high-speed.",
+    },
+    {
+        .longopt_id = OPT_CAMERA_LOW_LATENCY,
+        .longopt = "camera-low-latency",
+        .text = "Configure the camera for latency rather than for video "
+                "quality: use a preview request and disable the video "
+                "stabilization and the noise reduction (which delay the "
+                "frames).",
+    },
     {
         .longopt_id = OPT_CAMERA_SIZE,
         .longopt = "camera-size",
@@ -273,6 +489,44 @@ static const struct sc_option options[] = {
         .longopt = "codec-options",
         .argdesc = "key[:type]=value[,...]",
     },
+    {
+        .longopt_id = OPT_COMPRESS_CONTROL,
+        .longopt = "compress-control",
+        .text = "Compress the large control messages and device messages "
+                "(clipboard, text injection, file push chunks), to reduce "
+                "their transfer time on slow links (e.g. adb tunneled over "
+                "SSH). Small messages (input events) are always sent "
+                "uncompressed.",
+    },
+    {
+        .longopt_id = OPT_CONTROL_IO_LOOP,
+        .longopt = "control-io-loop",
+        .text = "Send the control messages and receive the device messages "
+                "from a single thread waiting on the control socket, instead "
+                "of one thread for each direction (this saves one thread per "
+                "device, and a thread wake-up on each device message).",
+    },
+    {
+        .longopt_id = OPT_CONTROL_PORT,
+        .longopt = "control-port",
+        .argdesc = "port",
+        .text = "Listen on localhost:<port> for control messages sent by "
+                "automation scripts (touch, key, text, clipboard, rotation, "
+                "keyframe request, etc.), serialized as they are sent to the "
+                "device. They are forwarded directly to the device, without "
+                "going through the window.\n"
+                "See doc/control.md for the format.",
+    },
+    {
+        .longopt_id = OPT_CPU_AFFINITY,
+        .longopt = "cpu-affinity",
+        .argdesc = "cpu[,...]",
+        .text = "Run the demuxer, controller and audio output threads only on "
+                "the given CPUs (indexes starting at 0, lower than 64).\n"
+                "For example, to run several instances on the same host "
+                "without competing for the same CPUs: --cpu-affinity=2,3\n"
+                "Not supported on macOS.",
+    },
     {
         .longopt_id = OPT_CROP,
         .longopt = "crop",
@@ -288,6 +542,40 @@ static const struct sc_option options[] = {
         .text = "Use USB device (if there is exactly one, like adb -d).\n"
                 "Also see -e (--select-tcpip).",
     },
+    {
+        .longopt_id = OPT_DEVICES_CACHE,
+        .longopt = "devices-cache",
+        .argdesc = "file",
+        .text = "Share the list of connected devices (the result of \"adb "
+                "devices -l\") between the scrcpy instances started within 2 "
+                "seconds, using the given cache file.\n"
+                "This avoids to query adb for each instance when many "
+                "instances are started in parallel.",
+    },
+    {
+        .longopt_id = OPT_DIRECT_PORT,
+        .longopt = "direct-port",
+        .argdesc = "port",
+        .text = "Transmit the streams over a direct TCP connection to the "
+                "given port of the device, instead of through adb.\n"
+                "The device must be connected via TCP/IP (see --tcpip). adb "
+                "is still used to start the server, which only accepts the "
+                "connections authenticated by a random token generated by "
+                "the client.\n"
+                "The streams are not encrypted: only use it on a trusted "
+                "network.",
+    },
+    {
+        .longopt_id = OPT_DIRECT_UDP,
+        .longopt = "direct-udp",
+        .text = "Transmit the video packets over UDP (with --direct-port), "
+                "so that a lost datagram does not delay the following "
+                "frames.\n"
+                "The lost fragments are rebuilt from parity data or "
+                "requested again. If a frame is still incomplete after a "
+                "short delay, it is skipped and a new keyframe is "
+                "requested, instead of stalling the video.",
+    },
     {
         .longopt_id = OPT_DISABLE_SCREENSAVER,
         .longopt = "disable-screensaver",
@@ -327,6 +615,27 @@ static const struct sc_option options[] = {
                 "before the rotation.\n"
                 "Default is 0.",
     },
+    {
+        .longopt_id = OPT_DISPLAY_PACING,
+        .longopt = "display-pacing",
+        .argdesc = "ms",
+        .text = "Present the frames at a regular rate (aligned to the display "
+                "refresh rate) to reduce judder caused by network jitter. "
+                "The value is the maximum latency (in milliseconds) added to "
+                "a frame.\n"
+                "Unlike --display-buffer, the latency only increases when a "
+                "frame arrives too early.\n"
+                "Default is 0 (disabled).",
+    },
+    {
+        .longopt_id = OPT_DUMP_STREAMS,
+        .longopt = "dump-streams",
+        .argdesc = "dir",
+        .text = "Dump the raw video and audio streams received from the "
+                "device, with their arrival time, to files in the given "
+                "(existing) directory, to replay them later with "
+                "--replay-streams.",
+    },
     {
         .shortopt = 'e',
         .longopt = "select-tcpip",
@@ -357,11 +666,92 @@ static const struct sc_option options[] = {
                 "middle-click triggers HOME. This option disables these "
                 "shortcuts and forwards the clicks to the device instead.",
     },
+    {
+        .longopt_id = OPT_FRAME_HASH_FILE,
+        .longopt = "frame-hash-file",
+        .argdesc = "file",
+        .text = "Write a perceptual hash of the decoded video frames to the "
+                "given file, one line \"<pts> <hash>\" per frame (the PTS in "
+                "microseconds, the 64-bit hash in hexadecimal).\n"
+                "Similar frames have hashes differing by a few bits, so that "
+                "visual changes and freezes may be detected without storing "
+                "the video.\n"
+                "See --frame-hash-interval.",
+    },
+    {
+        .longopt_id = OPT_FRAME_HASH_INTERVAL,
+        .longopt = "frame-hash-interval",
+        .argdesc = "n",
+        .text = "Hash only one decoded frame out of <n> (see "
+                "--frame-hash-file).\n"
+                "Default is 1 (hash every frame).",
+    },
+    {
+        .longopt_id = OPT_FRAME_SHARE,
+        .longopt = "frame-share",
+        .argdesc = "name",
+        .text = "Publish the decoded video frames to the POSIX shared memory "
+                "object <name> (in /dev/shm on Linux), so that other local "
+                "processes may read them at full rate.\n"
+                "The layout is described in doc/video.md.\n"
+                "This feature is not available on Windows.",
+    },
+    {
+        .shortopt = 'G',
+        .text = "Same as --gamepad=uhid.",
+    },
+    {
+        .longopt_id = OPT_GAMEPAD,
+        .longopt = "gamepad",
+        .argdesc = "mode",
+        .text = "Select how to send gamepad inputs to the device.\n"
+                "Possible values are \"disabled\" and \"uhid\".\n"
+                "\"disabled\" does not send gamepad inputs to the device.\n"
+                "\"uhid\" simulates physical HID gamepads using the Linux UHID "
+                "kernel module on the device.\n"
+                "Default is \"disabled\".",
+    },
+    {
+        .longopt_id = OPT_GPU_DOWNSCALE,
+        .longopt = "gpu-downscale",
+        .text = "Render the device screen at a higher resolution, and "
+                "downscale it to the video size on the device GPU with a "
+                "better filter than the display compositor (sharper text, less "
+                "aliasing, so a lower bit rate for the same quality).\n"
+                "It only has an effect if the video is smaller than the "
+                "device screen (see --max-size).",
+    },
     {
         .shortopt = 'h',
         .longopt = "help",
         .text = "Print this help.",
     },
+    {
+        .longopt_id = OPT_INPUT_OVERLAY,
+        .longopt = "input-overlay",
+        .text = "Draw the position of the pressed pointers (mouse drag or "
+                "fingers) and a short trail over the video as soon as the "
+                "input events are received, without waiting for the device to "
+                "render them.",
+    },
+    {
+        .longopt_id = OPT_INPUT_RECORD,
+        .longopt = "input-record",
+        .argdesc = "file",
+        .text = "Record the input events (key, text, touch and scroll events) "
+                "with their timing to a file, to replay them later with "
+                "--input-replay.",
+    },
+    {
+        .longopt_id = OPT_INPUT_REPLAY,
+        .longopt = "input-replay",
+        .argdesc = "file",
+        .text = "Replay the input events recorded with --input-record, with "
+                "the same timing, once the session is started.\n"
+                "The positions are expressed relative to the video size of the "
+                "recording: the events are ignored by the device if its size "
+                "changed.",
+    },
     {
         .shortopt = 'K',
         .text = "Same as --keyboard=uhid.",
@@ -409,6 +799,19 @@ static const struct sc_option options[] = {
                 "This is a workaround for some devices not behaving as "
                 "expected when setting the device clipboard programmatically.",
     },
+    {
+        .longopt_id = OPT_LIST_CACHE,
+        .longopt = "list-cache",
+        .argdesc = "dir",
+        .text = "Cache the results of --list-encoders, --list-displays, "
+                "--list-cameras and --list-camera-sizes in the given "
+                "directory, by device build fingerprint, so that repeated "
+                "queries return immediately, without starting the server on "
+                "the device.\n"
+                "The cached results are not updated until the device system "
+                "is updated (or the cache files are removed), so the "
+                "displays connected later are not listed.",
+    },
     {
         .longopt_id = OPT_LIST_CAMERAS,
         .longopt = "list-cameras",
@@ -489,6 +892,38 @@ static const struct sc_option options[] = {
                 "control of the mouse back to the computer.\n"
                 "Also see --keyboard.",
     },
+    {
+        .longopt_id = OPT_MOUSE_REPORT_INTERVAL,
+        .longopt = "mouse-report-interval",
+        .argdesc = "ms",
+        .text = "Set the minimal interval between two mouse motion reports "
+                "in \"uhid\" and \"aoa\" mouse modes. The motion events "
+                "received meanwhile are aggregated, so that a high-rate mouse "
+                "does not flood the link to the device.\n"
+                "0 reports every motion event immediately.\n"
+                "Default is 4.",
+    },
+    {
+        .longopt_id = OPT_MULTIPLEX,
+        .longopt = "multiplex",
+        .text = "Transmit all the streams (video, audio and control) over a "
+                "single connection, instead of one connection per stream.\n"
+                "This reduces the connection time, and the device sends the "
+                "control and audio data before the video data when the link "
+                "is congested.",
+    },
+    {
+        .longopt_id = OPT_NEW_DISPLAY,
+        .longopt = "new-display",
+        .argdesc = "[<width>x<height>][/<dpi>]",
+        .optional_arg = true,
+        .text = "Create a new virtual display on the device, and mirror it "
+                "instead of an existing display.\n"
+                "The size and density default to those of the main display. "
+                "The size is limited by -m/--max-size.\n"
+                "Examples: --new-display=1920x1080/420, --new-display=/240, "
+                "--new-display",
+    },
     {
         .shortopt = 'n',
         .longopt = "no-control",
@@ -588,6 +1023,13 @@ static const struct sc_option options[] = {
                 "It may only work over USB.\n"
                 "See --keyboard and --mouse.",
     },
+    {
+        .longopt_id = OPT_OTG_RECONNECT,
+        .longopt = "otg-reconnect",
+        .text = "In OTG mode, do not exit when the device is disconnected: "
+                "wait for it to be connected again (for example after a "
+                "reboot), and resume the session in the same window.",
+    },
     {
         .shortopt = 'p',
         .longopt = "port",
@@ -596,6 +1038,22 @@ static const struct sc_option options[] = {
                 "Default is " STR(DEFAULT_LOCAL_PORT_RANGE_FIRST) ":"
                               STR(DEFAULT_LOCAL_PORT_RANGE_LAST) ".",
     },
+    {
+        .longopt_id = OPT_PATTERN_FPS,
+        .longopt = "pattern-fps",
+        .argdesc = "value",
+        .text = "Specify the frame rate of the synthetic pattern (see "
+                "--video-source=pattern).\n"
+                "Default is 60.",
+    },
+    {
+        .longopt_id = OPT_PATTERN_SIZE,
+        .longopt = "pattern-size",
+        .argdesc = "<width>x<height>",
+        .text = "Specify the size of the synthetic pattern (see "
+                "--video-source=pattern).\n"
+                "Default is 1920x1080.",
+    },
     {
         .longopt_id = OPT_PAUSE_ON_EXIT,
         .longopt = "pause-on-exit",
@@ -610,6 +1068,23 @@ static const struct sc_option options[] = {
                 "Passing the option without argument is equivalent to passing "
                 "\"true\".",
     },
+    {
+        .longopt_id = OPT_PERF_OVERLAY,
+        .longopt = "perf-overlay",
+        .text = "Draw a live performance summary over the video: the "
+                "histogram of the intervals between the presented frames "
+                "(in milliseconds), the frame rate, the dropped frames, the "
+                "average decoding time, the video bitrate and the queue "
+                "depths, updated every second.",
+    },
+    {
+        .longopt_id = OPT_PERSISTENT_TUNNEL,
+        .longopt = "persistent-tunnel",
+        .text = "Keep the \"adb reverse\" tunnel enabled on exit, so that the "
+                "next sessions for the same device reuse it instead of "
+                "enabling it again (and do not remove it on exit).\n"
+                "It is incompatible with --force-adb-forward.",
+    },
     {
         .longopt_id = OPT_POWER_OFF_ON_CLOSE,
         .longopt = "power-off-on-close",
@@ -630,6 +1105,14 @@ static const struct sc_option options[] = {
         .text = "Start FPS counter, to print framerate logs to the console. "
                 "It can be started or stopped at any time with MOD+i.",
     },
+    {
+        .longopt_id = OPT_PRINT_LATENCY,
+        .longopt = "print-latency",
+        .text = "Periodically print the latency percentiles (p50, p95, p99) "
+                "of each video pipeline stage, on the device (encoding and "
+                "socket write) and on the computer (decoding, consumption "
+                "by the screen and present), and print a summary on exit.",
+    },
     {
         .longopt_id = OPT_PUSH_TARGET,
         .longopt = "push-target",
@@ -651,6 +1134,16 @@ static const struct sc_option options[] = {
         .longopt = "raw-key-events",
         .text = "Inject key events for all input keys, and ignore text events."
     },
+    {
+        .longopt_id = OPT_REALTIME_THREADS,
+        .longopt = "realtime-threads",
+        .text = "Use the real-time scheduling of the platform for the "
+                "demuxer, controller and audio output threads (SCHED_RR on "
+                "Linux, MMCSS on Windows, QoS classes on macOS).\n"
+                "On Linux, this requires CAP_SYS_NICE or a non-zero "
+                "RLIMIT_RTPRIO (otherwise, the threads fall back to a high "
+                "priority).",
+    },
     {
         .longopt_id = OPT_RECORD_FORMAT,
         .longopt = "record-format",
@@ -658,6 +1151,22 @@ static const struct sc_option options[] = {
         .text = "Force recording format (mp4, mkv, m4a, mka, opus, aac, flac "
                 "or wav).",
     },
+    {
+        .longopt_id = OPT_RECORD_FRAGMENTED,
+        .longopt = "record-fragmented",
+        .text = "Record a fragmented MP4 file, which is playable while it is "
+                "being written, remains valid if scrcpy is killed, and is "
+                "finalized immediately.\n"
+                "This requires an MP4 recording format (mp4, m4a or aac).",
+    },
+    {
+        .longopt_id = OPT_RECORD_LOW_LATENCY,
+        .longopt = "record-low-latency",
+        .text = "Write each video packet as soon as it is received, with an "
+                "estimated duration, instead of waiting for the next one "
+                "(which delays the recording by one frame).\n"
+                "This requires --record-fragmented or --record-segment.",
+    },
     {
         .longopt_id = OPT_RECORD_ORIENTATION,
         .longopt = "record-orientation",
@@ -667,6 +1176,88 @@ static const struct sc_option options[] = {
                 "the clockwise rotation in degrees.\n"
                 "Default is 0.",
     },
+    {
+        .longopt_id = OPT_RECORD_QUEUE_LIMIT,
+        .longopt = "record-queue-limit",
+        .argdesc = "size",
+        .text = "Limit the memory used to queue the packets to record (in "
+                "bytes). If the recording falls behind (for example if the "
+                "disk is slow), the next packets are spilled to a temporary "
+                "file until it catches up.\n"
+                "Supports suffix 'K' (x1000) and 'M' (x1000000).\n"
+                "Default is 0 (unlimited).",
+    },
+    {
+        .longopt_id = OPT_RECORD_SEGMENT,
+        .longopt = "record-segment",
+        .argdesc = "seconds",
+        .text = "Split the recording into numbered files (for example "
+                "file-0000.mp4, file-0001.mp4, etc.) of at least the given "
+                "duration, cut on video keyframes.",
+    },
+    {
+        .longopt_id = OPT_RECORD_SEGMENT_COUNT,
+        .longopt = "record-segment-count",
+        .argdesc = "n",
+        .text = "Only keep the n most recent recording segments (the older "
+                "ones are removed). This requires --record-segment.\n"
+                "Default is 0 (keep all the segments).",
+    },
+    {
+        .longopt_id = OPT_RECORD_THUMBNAILS,
+        .longopt = "record-thumbnails",
+        .argdesc = "file.vtt",
+        .text = "Generate thumbnails of the recorded video from its "
+                "keyframes, packed into PNG sprite sheets next to the given "
+                "WebVTT index (for example file-0000.png, file-0001.png, "
+                "etc.), to seek visually in the recording.",
+    },
+    {
+        .longopt_id = OPT_RECORD_UPLOAD,
+        .longopt = "record-upload",
+        .argdesc = "url",
+        .text = "Upload each completed recording file (each segment once it "
+                "is finished) in the background, by HTTP PUT to "
+                "<url>/<file name>.\n"
+                "Its SHA-256 checksum is computed during the upload, written "
+                "to <file>.sha256 and uploaded too.",
+    },
+    {
+        .longopt_id = OPT_RECORD_VIDEO_BIT_RATE,
+        .longopt = "record-video-bit-rate",
+        .argdesc = "value",
+        .text = "Record a separate video stream, encoded by the device at the "
+                "given bit rate, independently of the mirrored video stream "
+                "(configured by --video-bit-rate).\n"
+                "Supports suffix 'K' (x1000) and 'M' (x1000000).\n"
+                "The recorded stream is not decoded by the client.\n"
+                "This requires a display video source.\n"
+                "By default, the mirrored video stream is recorded.",
+    },
+    {
+        .longopt_id = OPT_RECORD_VIDEO_SOURCE,
+        .longopt = "record-video-source",
+        .argdesc = "source",
+        .text = "Select the source of the separate record video stream "
+                "(display or camera), captured by the same server as the "
+                "mirrored display.\n"
+                "With camera, the device camera is recorded while its display "
+                "is mirrored. The camera options (--camera-id, "
+                "--camera-size…) apply to the recorded stream.\n"
+                "This requires --record-video-bit-rate.\n"
+                "Default is display.",
+    },
+    {
+        .longopt_id = OPT_RECORD_WRITE_BUFFER,
+        .longopt = "record-write-buffer",
+        .argdesc = "size",
+        .text = "Write the recording file from a separate thread, through a "
+                "memory buffer of the given size (in bytes), so that a disk "
+                "stall does not delay the muxing until the buffer is full.\n"
+                "Supports suffix 'K' (x1000) and 'M' (x1000000).\n"
+                "The size must be at least 128K.\n"
+                "Default is 0 (write directly from the recorder thread).",
+    },
     {
         .longopt_id = OPT_RENDER_DRIVER,
         .longopt = "render-driver",
@@ -677,6 +1268,41 @@ static const struct sc_option options[] = {
                 "\"opengles2\", \"opengles\", \"metal\" and \"software\".\n"
                 "<https://wiki.libsdl.org/SDL_HINT_RENDER_DRIVER>",
     },
+    {
+        .longopt_id = OPT_REPLAY_BUFFER,
+        .longopt = "replay-buffer",
+        .argdesc = "seconds",
+        .text = "Keep (at least) the last given seconds of video and audio in "
+                "memory, to save them on demand to a numbered file (see "
+                "--replay-file) with MOD+Shift+r (instant replay).",
+    },
+    {
+        .longopt_id = OPT_REPLAY_FILE,
+        .longopt = "replay-file",
+        .argdesc = "file.mp4",
+        .text = "Set the file to save the instant replays to (for example "
+                "file-0000.mp4, file-0001.mp4, etc.). The format is "
+                "determined by the file extension.\n"
+                "This requires --replay-buffer.",
+    },
+    {
+        .longopt_id = OPT_REPLAY_STREAMS,
+        .longopt = "replay-streams",
+        .argdesc = "dir",
+        .text = "Replay the streams dumped by --dump-streams instead of "
+                "connecting to a device, with the same timing, to benchmark "
+                "the decoding, the rendering or the recording on any "
+                "machine.\n"
+                "The video and audio options must match the dump (e.g. "
+                "--no-audio if the audio was not captured). Control is "
+                "disabled.",
+    },
+    {
+        .longopt_id = OPT_REPLAY_STREAMS_MAX_SPEED,
+        .longopt = "replay-streams-max-speed",
+        .text = "Replay the streams (see --replay-streams) as fast as "
+                "possible, instead of with the original timing.",
+    },
     {
         .longopt_id = OPT_REQUIRE_AUDIO,
         .longopt = "require-audio",
@@ -684,12 +1310,61 @@ static const struct sc_option options[] = {
                 "fails on the device. This option makes scrcpy fail if audio "
                 "is enabled but does not work."
     },
+    {
+        .longopt_id = OPT_RESTREAM,
+        .longopt = "restream",
+        .argdesc = "url",
+        .text = "Forward the video and audio streams, as encoded by the "
+                "device (without re-encoding), to remote viewers.\n"
+                "The URL may be \"srt://host:port\" or \"udp://host:port\" "
+                "(MPEG-TS), or \"rtsp://host:port/path\" to publish the "
+                "streams to an RTSP server.\n"
+                "With \"tcp://addr:port\", a TCP server is opened, and each "
+                "connected viewer receives the streams (MPEG-TS), starting "
+                "on the last keyframe.\n"
+                "The video codec must be H.264 or H.265 (unless "
+                "--restream-video-encoder is set), and the audio codec Opus "
+                "or AAC.",
+    },
+    {
+        .longopt_id = OPT_RESTREAM_VIDEO_ENCODER,
+        .longopt = "restream-video-encoder",
+        .argdesc = "name",
+        .text = "Re-encode the restreamed video with the given FFmpeg H.264 "
+                "or H.265 encoder (for example h264_vaapi, h264_nvenc, "
+                "h264_qsv or libx264), at the bit rate set by "
+                "--video-bit-rate (8M by default).\n"
+                "The decoded frames are passed to hardware encoders without "
+                "being downloaded from the GPU when possible (with "
+                "--video-hwaccel).\n"
+                "Requires --restream.",
+    },
     {
         // deprecated
         .longopt_id = OPT_ROTATION,
         .longopt = "rotation",
         .argdesc = "value",
     },
+    {
+        .longopt_id = OPT_SCREEN_STABILITY,
+        .longopt = "screen-stability",
+        .argdesc = "ms",
+        .text = "Send events to the control server client (see "
+                "--control-port): the ratio of the screen changed by each "
+                "frame, and an event once the screen has not changed for the "
+                "given delay (in milliseconds), for example to wait for the "
+                "end of the animations in UI tests.\n"
+                "This requires --control-port.",
+    },
+    {
+        .longopt_id = OPT_SCREENSHOT_FILE,
+        .longopt = "screenshot-file",
+        .argdesc = "file.png",
+        .text = "Enable MOD+Shift+s to save the last decoded frame, at the "
+                "full video resolution, to a numbered PNG file (for example "
+                "file-0000.png, file-0001.png, etc.).\n"
+                "This requires video playback.",
+    },
     {
         .shortopt = 's',
         .longopt = "serial",
@@ -697,6 +1372,17 @@ static const struct sc_option options[] = {
         .text = "The device serial number. Mandatory only if several devices "
                 "are connected to adb.",
     },
+    {
+        .longopt_id = OPT_SERVER_IDLE_TIMEOUT,
+        .longopt = "server-idle-timeout",
+        .argdesc = "seconds",
+        .text = "Keep the server running on the device after the client "
+                "disconnects, so that the next scrcpy session with the same "
+                "options starts faster. The server exits after it has been "
+                "idle (without client) for the given number of seconds.\n"
+                "This implies --force-adb-forward.\n"
+                "Default is 0 (the server stops with the client).",
+    },
     {
         .shortopt = 'S',
         .longopt = "turn-screen-off",
@@ -722,6 +1408,56 @@ static const struct sc_option options[] = {
                 "on exit.\n"
                 "It only shows physical touches (not clicks from scrcpy).",
     },
+    {
+        .longopt_id = OPT_SHUTDOWN_TIMEOUT,
+        .longopt = "shutdown-timeout",
+        .argdesc = "ms",
+        .text = "Set the delay for the server to terminate properly on exit, "
+                "after which it is killed.\n"
+                "The delay starts as soon as the client stops, and the other "
+                "cleanup steps run meanwhile.\n"
+                "0 kills the server immediately.\n"
+                "Default is 1000.",
+    },
+    {
+        .longopt_id = OPT_SOCKET_BUFFER_SIZE,
+        .longopt = "socket-buffer-size",
+        .argdesc = "bytes",
+        .text = "Set the size of the socket buffers of the video streams "
+                "(the receive buffer on the computer, the send buffer on the "
+                "device), so that a burst of packets (typically a keyframe at "
+                "a high bit rate) does not stall the stream.\n"
+                "Unit suffixes are supported: 'K' (x1000) and 'M' (x1000000).\n"
+                "Default is 0 (use the system defaults).",
+    },
+    {
+        .longopt_id = OPT_SQUARE_VIDEO,
+        .longopt = "square-video",
+        .text = "Letterbox the device screen in a square video, so that the "
+                "video size does not change when the device is rotated. The "
+                "rotation is then applied without restarting the encoder, "
+                "avoiding a short freeze.",
+    },
+    {
+        .longopt_id = OPT_STATS_FILE,
+        .longopt = "stats-file",
+        .argdesc = "file",
+        .text = "Write pipeline metrics (received packets and bitrate, "
+                "rendered and skipped frames, audio buffering, underflow and "
+                "compensation, recorder and controller queue sizes) to the "
+                "given file every second.\n"
+                "See --stats-format.",
+    },
+    {
+        .longopt_id = OPT_STATS_FORMAT,
+        .longopt = "stats-format",
+        .argdesc = "format",
+        .text = "Select the format of the stats file (json or prometheus).\n"
+                "With json, one JSON object is appended per line. With "
+                "prometheus, the file is replaced by the current values in "
+                "Prometheus text exposition format.\n"
+                "Default is json.",
+    },
     {
         .longopt_id = OPT_TCPIP,
         .longopt = "tcpip",
@@ -736,6 +1472,25 @@ static const struct sc_option options[] = {
                 "connected over USB), enables TCP/IP mode, then connects to "
                 "this address before starting.",
     },
+    {
+        .longopt_id = OPT_THERMAL_GOVERNOR,
+        .longopt = "thermal-governor",
+        .text = "Monitor the thermal status and the battery level of the "
+                "device, and lower the video bit rate, frame rate and size "
+                "before the device throttles (and raise them back once it "
+                "has cooled down), to avoid latency spikes during long "
+                "sessions.\n"
+                "The thermal status requires Android 10+.",
+    },
+    {
+        .longopt_id = OPT_THUMBNAIL_DECODING,
+        .longopt = "thumbnail-decoding",
+        .text = "Decode faster while the window shows the video at less than "
+                "a third of its size (for example in a wall of thumbnails): "
+                "the software decoder skips the deblocking filter, whose "
+                "effect is not visible at that scale.\n"
+                "A keyframe is requested when the window gets larger again.",
+    },
     {
         .longopt_id = OPT_TIME_LIMIT,
         .longopt = "time-limit",
@@ -761,6 +1516,18 @@ static const struct sc_option options[] = {
                 "Default is 0 (not forced): the local port used for "
                 "establishing the tunnel will be used.",
     },
+    {
+        .longopt_id = OPT_UPSCALE_FILTER,
+        .longopt = "upscale-filter",
+        .argdesc = "filter",
+        .text = "Select the filter applied when the video is displayed larger "
+                "than its size (linear or lanczos).\n"
+                "\"lanczos\" renders the frames with a sharper Lanczos "
+                "shader preserving the edges, so that text remains crisp with "
+                "a small video size (see --max-size). It requires the OpenGL "
+                "renderer with shaders (OpenGL 2.0+).\n"
+                "Default is linear.",
+    },
     {
         .shortopt = 'v',
         .longopt = "version",
@@ -797,11 +1564,34 @@ static const struct sc_option options[] = {
                 "Default is 0 (no buffering).\n"
                 "This option is only available on Linux.",
     },
+    {
+        .longopt_id = OPT_V4L2_FORMAT,
+        .longopt = "v4l2-format",
+        .argdesc = "format",
+        .text = "Select the pixel format of the V4L2 sink (yuv420p, nv12 or "
+                "yuyv).\n"
+                "Default is yuv420p (no conversion).\n"
+                "This option is only available on Linux.",
+    },
+    {
+        .longopt_id = OPT_V4L2_MAX_SIZE,
+        .longopt = "v4l2-max-size",
+        .argdesc = "value",
+        .text = "Downscale the frames pushed to the V4L2 sink so that both "
+                "their width and height are less than or equal to the given "
+                "value, preserving the aspect ratio (independently of the "
+                "size of the mirrored video).\n"
+                "Default is 0 (unlimited).\n"
+                "This option is only available on Linux.",
+    },
     {
         .longopt_id = OPT_VIDEO_CODEC,
         .longopt = "video-codec",
         .argdesc = "name",
-        .text = "Select a video codec (h264, h265 or av1).\n"
+        .text = "Select a video codec (h264, h265, av1 or auto).\n"
+                "With \"auto\", the device selects the hardware encoder "
+                "achieving the highest frame rate at the video size (the "
+                "result is cached on the device).\n"
                 "Default is h264.",
     },
     {
@@ -816,6 +1606,29 @@ static const struct sc_option options[] = {
                 "Android documentation: "
                 "<https://d.android.com/reference/android/media/MediaFormat>",
     },
+    {
+        .longopt_id = OPT_VIDEO_DECODER_THREADING,
+        .longopt = "video-decoder-threading",
+        .argdesc = "mode",
+        .text = "Select how the software video decoder uses several threads "
+                "(see --video-decoder-threads):\n"
+                "  slice: split each frame between the threads, without "
+                "additional latency (only effective if the device encoder "
+                "produces several slices, tiles or WPP rows)\n"
+                "  frame: decode several frames in parallel, which adds one "
+                "frame of latency per additional thread\n"
+                "Default is slice.",
+    },
+    {
+        .longopt_id = OPT_VIDEO_DECODER_THREADS,
+        .longopt = "video-decoder-threads",
+        .argdesc = "value",
+        .text = "Set the number of threads of the software video decoder, or "
+                "0 to use as many threads as CPU cores.\n"
+                "With --wall, this is the total number of threads, shared "
+                "between all the devices.\n"
+                "Default is 1.",
+    },
     {
         .longopt_id = OPT_VIDEO_ENCODER,
         .longopt = "video-encoder",
@@ -824,12 +1637,105 @@ static const struct sc_option options[] = {
                 "codec provided by --video-codec).\n"
                 "The available encoders can be listed by --list-encoders.",
     },
+    {
+        .longopt_id = OPT_VIDEO_HDR,
+        .longopt = "video-hdr",
+        .text = "Request a 10-bit H.265 stream (Main10 profile). With "
+                "--video-source=camera, the camera captures in HDR10 if "
+                "supported (Android 13+).\n"
+                "The 10-bit frames are converted (and tone mapped if HDR) by "
+                "a shader on the computer, which requires the OpenGL "
+                "renderer.\n"
+                "This option requires --video-codec=h265.",
+    },
+    {
+        .longopt_id = OPT_VIDEO_HWACCEL,
+        .longopt = "video-hwaccel",
+        .argdesc = "type",
+        .text = "Decode the video using a hardware device of the given type "
+                "(e.g. vaapi, d3d11va, videotoolbox, cuda), or \"auto\" to "
+                "use the first available one.\n"
+                "If hardware decoding is unavailable, scrcpy falls back to "
+                "software decoding.\n"
+                "Default is disabled (software decoding).",
+    },
+    {
+        .longopt_id = OPT_VIDEO_INTRA_REFRESH,
+        .longopt = "video-intra-refresh",
+        .text = "Request the device encoder to refresh the picture "
+                "progressively (intra refresh), instead of producing a full "
+                "keyframe every 10 seconds (which causes a bit rate and "
+                "latency spike).\n"
+                "When recording, keyframes are still requested every 10 "
+                "seconds to keep the file seekable (if control is enabled).\n"
+                "This is implied by --video-latency-profile=low.",
+    },
+    {
+        .longopt_id = OPT_VIDEO_LATENCY_PROFILE,
+        .longopt = "video-latency-profile",
+        .argdesc = "profile",
+        .text = "Select the device video encoder configuration profile "
+                "(default or low).\n"
+                "The \"low\" profile requests the encoder to favor latency: "
+                "realtime priority, low-latency mode, no B-frames, and "
+                "gradual intra refresh instead of periodic keyframes "
+                "(so that there is no bit rate spike). The configuration "
+                "keys actually accepted by the encoder are logged.\n"
+                "Default is default.",
+    },
+    {
+        .longopt_id = OPT_VIDEO_MASK,
+        .longopt = "video-mask",
+        .argdesc = "width:height:x:y[,...]",
+        .text = "Fill regions of the video with black on the device GPU "
+                "before encoding (they are never transmitted).\n"
+                "The values are expressed in percent of the video frame. Up "
+                "to 8 regions may be specified, separated by commas.\n"
+                "For example, \"100:5:0:0\" masks the top 5% of the video.",
+    },
+    {
+        .longopt_id = OPT_VIDEO_PACING,
+        .longopt = "video-pacing",
+        .text = "Split the large video packets (typically keyframes) into "
+                "chunks written by the device at a rate derived from the "
+                "video bit rate, instead of writing them in a single burst.\n"
+                "On a wireless connection, it avoids overflowing the network "
+                "queues and delaying the audio packets, at the cost of a "
+                "slightly higher latency for the keyframes.",
+    },
+    {
+        .longopt_id = OPT_VIDEO_RECONNECT,
+        .longopt = "video-reconnect",
+        .text = "If the video connection is lost (e.g. the socket is reset "
+                "while the device is still connected), reopen the adb tunnel "
+                "and reconnect the video stream instead of ending the "
+                "session.\n"
+                "The device restarts the encoding with a new keyframe, the "
+                "recording continues with a gap.\n"
+                "It is incompatible with --multiplex, --direct-port, "
+                "--record-video-bit-rate and --server-idle-timeout.",
+    },
+    {
+        .longopt_id = OPT_VIDEO_REPEAT_DELAY,
+        .longopt = "video-repeat-delay",
+        .argdesc = "ms",
+        .text = "When the device screen content does not change, the encoder "
+                "repeats the last frame after this delay (to improve its "
+                "quality).\n"
+                "Set 0 to never repeat frames, so that nothing is encoded "
+                "nor sent while the content is static (the client keeps "
+                "displaying the last frame).\n"
+                "Default is 100.",
+    },
     {
         .longopt_id = OPT_VIDEO_SOURCE,
         .longopt = "video-source",
         .argdesc = "source",
-        .text = "Select the video source (display or camera).\n"
+        .text = "Select the video source (display, camera or pattern).\n"
                 "Camera mirroring requires Android 12+.\n"
+                "The \"pattern\" source is a synthetic moving test pattern "
+                "(independent of the device screen, control is disabled), to "
+                "load-test the client with many sessions (Android 6+).\n"
                 "Default is display.",
     },
     {
@@ -838,6 +1744,52 @@ static const struct sc_option options[] = {
         .text = "Keep the device on while scrcpy is running, when the device "
                 "is plugged in.",
     },
+    {
+        .longopt_id = OPT_WALL,
+        .longopt = "wall",
+        .argdesc = "serial1,serial2,...",
+        .text = "Mirror several devices, identified by their serial numbers, "
+                "in a grid in a single window.\n"
+                "The serials may also be read from a file, one per line, "
+                "using \"@filename\".\n"
+                "Each device is mirrored without audio and without control. "
+                "The video options (--max-size, --video-bit-rate, "
+                "--max-fps...) apply to all the devices.\n"
+                "With --record, each device is recorded to its own file, "
+                "named after the record filename suffixed by the device "
+                "serial (e.g. \"file-serial.mp4\").\n"
+                "With --no-video-playback, the devices are only recorded, "
+                "without any window.",
+    },
+    {
+        .longopt_id = OPT_WALL_BACKGROUND_FPS,
+        .longopt = "wall-background-fps",
+        .argdesc = "value",
+        .text = "In --wall mode, limit the frame rate of the devices which "
+                "are not focused (live, by restarting their encoder). Click "
+                "on a device to focus it: it is then mirrored at the full "
+                "frame rate, its decoding thread is prioritized, and its "
+                "frames are uploaded first.\n"
+                "The devices not focused are also decoded faster (see "
+                "--thumbnail-decoding).\n"
+                "Control is then enabled on the devices, only to request "
+                "the video limits.\n"
+                "Default is 0 (disabled: all the devices are mirrored at the "
+                "same frame rate).",
+    },
+    {
+        .longopt_id = OPT_WALL_PREVIEW_INTERVAL,
+        .longopt = "wall-preview-interval",
+        .argdesc = "ms",
+        .text = "In --wall mode, decode only the keyframes of the devices "
+                "which are not focused, and request a keyframe from each of "
+                "them every <ms> milliseconds to refresh their preview.\n"
+                "Click on a device to focus it: it is then fully decoded, "
+                "until another device is clicked (or it is clicked again).\n"
+                "Control is then enabled on the devices, only to request the "
+                "keyframes.\n"
+                "Default is 0 (disabled: all the devices are fully decoded).",
+    },
     {
         .longopt_id = OPT_WINDOW_BORDERLESS,
         .longopt = "window-borderless",
@@ -985,10 +1937,27 @@ static const struct sc_shortcut shortcuts[] = {
         .shortcuts = { "MOD+k" },
         .text = "Open keyboard settings on the device (for HID keyboard only)",
     },
+    {
+        .shortcuts = { "MOD+z" },
+        .text = "Crop the device screen to the quarter around the mouse "
+                "pointer (it can be repeated to zoom further)",
+    },
+    {
+        .shortcuts = { "MOD+Shift+z" },
+        .text = "Restore the initial crop",
+    },
     {
         .shortcuts = { "MOD+i" },
         .text = "Enable/disable FPS counter (print frames/second in logs)",
     },
+    {
+        .shortcuts = { "MOD+Shift+r" },
+        .text = "Save the instant replay (see --replay-buffer)",
+    },
+    {
+        .shortcuts = { "MOD+Shift+s" },
+        .text = "Save a screenshot (see --screenshot-file)",
+    },
     {
         .shortcuts = { "Ctrl+click-and-move" },
         .text = "Pinch-to-zoom and rotate from the center of the screen",
@@ -1403,95 +2372,283 @@ parse_bit_rate(const char *s, uint32_t *bit_rate) {
 }
 
 static bool
-parse_max_size(const char *s, uint16_t *max_size) {
+parse_record_queue_limit(const char *s, uint32_t *limit) {
     long value;
-    bool ok = parse_integer_arg(s, &value, false, 0, 0xFFFF, "max size");
+    bool ok = parse_integer_arg(s, &value, true, 0, 0x7FFFFFFF,
+                                "record queue limit");
     if (!ok) {
         return false;
     }
 
-    *max_size = (uint16_t) value;
+    *limit = (uint32_t) value;
     return true;
 }
 
 static bool
-parse_max_fps(const char *s, uint16_t *max_fps) {
+parse_record_write_buffer(const char *s, uint32_t *size) {
     long value;
-    bool ok = parse_integer_arg(s, &value, false, 0, 0xFFFF, "max fps");
+    bool ok = parse_integer_arg(s, &value, true, 0, 0x7FFFFFFF,
+                                "record write buffer");
     if (!ok) {
         return false;
     }
 
-    *max_fps = (uint16_t) value;
+    // At least two chunks of the AVIO buffer size (64 KiB) of the writer
+    if (value && value < 128000) {
+        LOGE("Record write buffer must be at least 128K: %s", s);
+        return false;
+    }
+
+    *size = (uint32_t) value;
     return true;
 }
 
 static bool
-parse_buffering_time(const char *s, sc_tick *tick) {
+parse_record_segment(const char *s, sc_tick *duration) {
     long value;
-    // In practice, buffering time should not exceed a few seconds.
-    // Limit it to some arbitrary value (1 hour) to prevent 32-bit overflow
-    // when multiplied by the audio sample size and the number of samples per
-    // millisecond.
-    bool ok = parse_integer_arg(s, &value, false, 0, 60 * 60 * 1000,
-                                "buffering time");
+    bool ok = parse_integer_arg(s, &value, false, 1, 0x7FFFFFFF,
+                                "record segment");
     if (!ok) {
         return false;
     }
 
-    *tick = SC_TICK_FROM_MS(value);
+    *duration = SC_TICK_FROM_SEC(value);
     return true;
 }
 
 static bool
-parse_audio_output_buffer(const char *s, sc_tick *tick) {
+parse_replay_buffer(const char *s, sc_tick *duration) {
     long value;
-    bool ok = parse_integer_arg(s, &value, false, 0, 1000,
-                                "audio output buffer");
+    bool ok = parse_integer_arg(s, &value, false, 1, 0x7FFFFFFF,
+                                "replay buffer");
     if (!ok) {
         return false;
     }
 
-    *tick = SC_TICK_FROM_MS(value);
+    *duration = SC_TICK_FROM_SEC(value);
     return true;
 }
 
 static bool
-parse_lock_video_orientation(const char *s,
-                             enum sc_lock_video_orientation *lock_mode) {
-    if (!s || !strcmp(s, "initial")) {
-        // Without argument, lock the initial orientation
-        *lock_mode = SC_LOCK_VIDEO_ORIENTATION_INITIAL;
-        return true;
+parse_record_segment_count(const char *s, uint16_t *count) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 0xFFFF,
+                                "record segment count");
+    if (!ok) {
+        return false;
     }
 
-    if (!strcmp(s, "unlocked")) {
-        *lock_mode = SC_LOCK_VIDEO_ORIENTATION_UNLOCKED;
-        return true;
+    *count = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_max_size(const char *s, uint16_t *max_size) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 0xFFFF, "max size");
+    if (!ok) {
+        return false;
     }
 
-    if (!strcmp(s, "0")) {
-        *lock_mode = SC_LOCK_VIDEO_ORIENTATION_0;
-        return true;
+    *max_size = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_max_fps(const char *s, uint16_t *max_fps) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 0xFFFF, "max fps");
+    if (!ok) {
+        return false;
     }
 
-    if (!strcmp(s, "90")) {
-        *lock_mode = SC_LOCK_VIDEO_ORIENTATION_90;
-        return true;
+    *max_fps = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_video_decoder_threads(const char *s, uint16_t *threads) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 256,
+                                "video decoder threads");
+    if (!ok) {
+        return false;
     }
 
-    if (!strcmp(s, "180")) {
-        *lock_mode = SC_LOCK_VIDEO_ORIENTATION_180;
-        return true;
+    *threads = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_cpu_affinity(const char *s, uint64_t *cpu_mask) {
+    long values[64];
+    size_t count = parse_integers_arg(s, ',', ARRAY_LEN(values), values, 0, 63,
+                                      "CPU affinity");
+    if (!count) {
+        return false;
     }
 
-    if (!strcmp(s, "270")) {
-        *lock_mode = SC_LOCK_VIDEO_ORIENTATION_270;
-        return true;
+    uint64_t mask = 0;
+    for (size_t i = 0; i < count; ++i) {
+        mask |= UINT64_C(1) << values[i];
     }
 
-    if (!strcmp(s, "1")) {
-        LOGW("--lock-video-orientation=1 is deprecated, use "
+    *cpu_mask = mask;
+    return true;
+}
+
+static bool
+parse_video_repeat_delay(const char *s, sc_tick *tick) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 10000,
+                                "video repeat delay");
+    if (!ok) {
+        return false;
+    }
+
+    *tick = SC_TICK_FROM_MS(value);
+    return true;
+}
+
+static bool
+parse_buffering_time(const char *s, sc_tick *tick) {
+    long value;
+    // In practice, buffering time should not exceed a few seconds.
+    // Limit it to some arbitrary value (1 hour) to prevent 32-bit overflow
+    // when multiplied by the audio sample size and the number of samples per
+    // millisecond.
+    bool ok = parse_integer_arg(s, &value, false, 0, 60 * 60 * 1000,
+                                "buffering time");
+    if (!ok) {
+        return false;
+    }
+
+    *tick = SC_TICK_FROM_MS(value);
+    return true;
+}
+
+static bool
+parse_audio_sample_rate(const char *s, uint32_t *sample_rate) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 8000, 192000,
+                                "audio sample rate");
+    if (!ok) {
+        return false;
+    }
+
+    *sample_rate = (uint32_t) value;
+    return true;
+}
+
+static bool
+parse_audio_channels(const char *s, uint8_t *channels) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 1, 2, "audio channels");
+    if (!ok) {
+        return false;
+    }
+
+    *channels = (uint8_t) value;
+    return true;
+}
+
+static bool
+parse_audio_volume(const char *s, uint16_t *volume) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 400, "audio volume");
+    if (!ok) {
+        return false;
+    }
+
+    *volume = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_audio_read_size(const char *s, uint16_t *read_size) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 1, 8192, "audio read size");
+    if (!ok) {
+        return false;
+    }
+
+    *read_size = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_adaptive_audio_buffer(const char *s, sc_tick *min, sc_tick *max) {
+    long values[2];
+    size_t count = parse_integers_arg(s, ':', 2, values, 1, 10000,
+                                      "adaptive audio buffer");
+    if (!count) {
+        return false;
+    }
+
+    if (count != 2) {
+        LOGE("Invalid adaptive audio buffer (expected min:max): %s", s);
+        return false;
+    }
+
+    if (values[0] > values[1]) {
+        LOGE("Invalid adaptive audio buffer (min > max): %s", s);
+        return false;
+    }
+
+    *min = SC_TICK_FROM_MS(values[0]);
+    *max = SC_TICK_FROM_MS(values[1]);
+    return true;
+}
+
+static bool
+parse_audio_output_buffer(const char *s, sc_tick *tick) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 1000,
+                                "audio output buffer");
+    if (!ok) {
+        return false;
+    }
+
+    *tick = SC_TICK_FROM_MS(value);
+    return true;
+}
+
+static bool
+parse_lock_video_orientation(const char *s,
+                             enum sc_lock_video_orientation *lock_mode) {
+    if (!s || !strcmp(s, "initial")) {
+        // Without argument, lock the initial orientation
+        *lock_mode = SC_LOCK_VIDEO_ORIENTATION_INITIAL;
+        return true;
+    }
+
+    if (!strcmp(s, "unlocked")) {
+        *lock_mode = SC_LOCK_VIDEO_ORIENTATION_UNLOCKED;
+        return true;
+    }
+
+    if (!strcmp(s, "0")) {
+        *lock_mode = SC_LOCK_VIDEO_ORIENTATION_0;
+        return true;
+    }
+
+    if (!strcmp(s, "90")) {
+        *lock_mode = SC_LOCK_VIDEO_ORIENTATION_90;
+        return true;
+    }
+
+    if (!strcmp(s, "180")) {
+        *lock_mode = SC_LOCK_VIDEO_ORIENTATION_180;
+        return true;
+    }
+
+    if (!strcmp(s, "270")) {
+        *lock_mode = SC_LOCK_VIDEO_ORIENTATION_270;
+        return true;
+    }
+
+    if (!strcmp(s, "1")) {
+        LOGW("--lock-video-orientation=1 is deprecated, use "
              "--lock-video-orientation=270 instead.");
         *lock_mode = SC_LOCK_VIDEO_ORIENTATION_270;
         return true;
@@ -1629,6 +2786,52 @@ parse_port_range(const char *s, struct sc_port_range *port_range) {
     return true;
 }
 
+static bool
+parse_video_masks(const char *s) {
+    // The server applies at most 8 masks
+    unsigned count = 0;
+    const char *item = s;
+    for (;;) {
+        size_t len = strcspn(item, ",");
+        char buf[64];
+        if (len >= sizeof(buf)) {
+            LOGE("Invalid video mask: %s", s);
+            return false;
+        }
+        memcpy(buf, item, len);
+        buf[len] = '\0';
+
+        long values[4];
+        size_t n = parse_integers_arg(buf, ':', 4, values, 0, 100,
+                                      "video mask");
+        if (!n) {
+            return false;
+        }
+
+        if (n != 4) {
+            LOGE("Invalid video mask (expected width:height:x:y): %s", buf);
+            return false;
+        }
+
+        if (!values[0] || !values[1] || values[0] + values[2] > 100
+                || values[1] + values[3] > 100) {
+            LOGE("Invalid video mask (must be inside the video frame, in "
+                 "percent): %s", buf);
+            return false;
+        }
+
+        if (++count > 8) {
+            LOGE("Too many video masks (at most 8): %s", s);
+            return false;
+        }
+
+        if (item[len] == '\0') {
+            return true;
+        }
+        item += len + 1;
+    }
+}
+
 static bool
 parse_display_id(const char *s, uint32_t *display_id) {
     long value;
@@ -1837,6 +3040,37 @@ guess_record_format(const char *filename) {
     return get_record_format(ext);
 }
 
+static bool
+parse_restream_url(const char *url, enum sc_restream_format *format) {
+    if (!strncmp(url, "srt://", 6) || !strncmp(url, "udp://", 6)
+            || !strncmp(url, "tcp://", 6)) {
+        *format = SC_RESTREAM_FORMAT_MPEGTS;
+        return true;
+    }
+    if (!strncmp(url, "rtsp://", 7)) {
+        *format = SC_RESTREAM_FORMAT_RTSP;
+        return true;
+    }
+
+    LOGE("Unsupported restream URL (expected srt://, udp://, tcp:// or "
+         "rtsp://): %s", url);
+    return false;
+}
+
+#ifdef HAVE_FRAME_SHARE
+static bool
+parse_frame_share_name(const char *name) {
+    // A POSIX shared memory object name may only contain a leading '/'
+    const char *s = name[0] == '/' ? name + 1 : name;
+    if (!*s || strchr(s, '/') || strlen(s) > 250) {
+        LOGE("Invalid frame share name: %s", name);
+        return false;
+    }
+
+    return true;
+}
+#endif
+
 static bool
 parse_video_codec(const char *optarg, enum sc_codec *codec) {
     if (!strcmp(optarg, "h264")) {
@@ -1851,7 +3085,12 @@ parse_video_codec(const char *optarg, enum sc_codec *codec) {
         *codec = SC_CODEC_AV1;
         return true;
     }
-    LOGE("Unsupported video codec: %s (expected h264, h265 or av1)", optarg);
+    if (!strcmp(optarg, "auto")) {
+        *codec = SC_CODEC_AUTO;
+        return true;
+    }
+    LOGE("Unsupported video codec: %s (expected h264, h265, av1 or auto)",
+         optarg);
     return false;
 }
 
@@ -1890,7 +3129,30 @@ parse_video_source(const char *optarg, enum sc_video_source *source) {
         return true;
     }
 
-    LOGE("Unsupported video source: %s (expected display or camera)", optarg);
+    if (!strcmp(optarg, "pattern")) {
+        *source = SC_VIDEO_SOURCE_PATTERN;
+        return true;
+    }
+
+    LOGE("Unsupported video source: %s (expected display, camera or pattern)",
+         optarg);
+    return false;
+}
+
+static bool
+parse_record_video_source(const char *optarg, enum sc_video_source *source) {
+    if (!strcmp(optarg, "display")) {
+        *source = SC_VIDEO_SOURCE_DISPLAY;
+        return true;
+    }
+
+    if (!strcmp(optarg, "camera")) {
+        *source = SC_VIDEO_SOURCE_CAMERA;
+        return true;
+    }
+
+    LOGE("Unsupported record video source: %s (expected display or camera)",
+         optarg);
     return false;
 }
 
@@ -1911,90 +3173,196 @@ parse_audio_source(const char *optarg, enum sc_audio_source *source) {
 }
 
 static bool
-parse_camera_facing(const char *optarg, enum sc_camera_facing *facing) {
-    if (!strcmp(optarg, "front")) {
-        *facing = SC_CAMERA_FACING_FRONT;
+parse_stats_format(const char *optarg, enum sc_stats_format *format) {
+    if (!strcmp(optarg, "json")) {
+        *format = SC_STATS_FORMAT_JSON;
         return true;
     }
 
-    if (!strcmp(optarg, "back")) {
-        *facing = SC_CAMERA_FACING_BACK;
+    if (!strcmp(optarg, "prometheus")) {
+        *format = SC_STATS_FORMAT_PROMETHEUS;
         return true;
     }
 
-    if (!strcmp(optarg, "external")) {
-        *facing = SC_CAMERA_FACING_EXTERNAL;
+    LOGE("Unsupported stats format: %s (expected json or prometheus)",
+         optarg);
+    return false;
+}
+
+static bool
+parse_upscale_filter(const char *optarg, enum sc_upscale_filter *filter) {
+    if (!strcmp(optarg, "linear")) {
+        *filter = SC_UPSCALE_FILTER_LINEAR;
         return true;
     }
 
-    if (*optarg == '\0') {
-        // Empty string is a valid value (equivalent to not passing the option)
-        *facing = SC_CAMERA_FACING_ANY;
+    if (!strcmp(optarg, "lanczos")) {
+        *filter = SC_UPSCALE_FILTER_LANCZOS;
         return true;
     }
 
-    LOGE("Unsupported camera facing: %s (expected front, back or external)",
+    LOGE("Unsupported upscale filter: %s (expected linear or lanczos)",
          optarg);
     return false;
 }
 
 static bool
-parse_camera_fps(const char *s, uint16_t *camera_fps) {
-    long value;
-    bool ok = parse_integer_arg(s, &value, false, 0, 0xFFFF, "camera fps");
-    if (!ok) {
-        return false;
+parse_video_latency_profile(const char *optarg,
+                            enum sc_video_latency_profile *profile) {
+    if (!strcmp(optarg, "default")) {
+        *profile = SC_VIDEO_LATENCY_PROFILE_DEFAULT;
+        return true;
     }
 
-    *camera_fps = (uint16_t) value;
-    return true;
+    if (!strcmp(optarg, "low")) {
+        *profile = SC_VIDEO_LATENCY_PROFILE_LOW;
+        return true;
+    }
+
+    LOGE("Unsupported video latency profile: %s (expected default or low)",
+         optarg);
+    return false;
 }
 
 static bool
-parse_keyboard(const char *optarg, enum sc_keyboard_input_mode *mode) {
-    if (!strcmp(optarg, "disabled")) {
-        *mode = SC_KEYBOARD_INPUT_MODE_DISABLED;
+parse_video_decoder_threading(const char *optarg,
+                              enum sc_video_decoder_threading *threading) {
+    if (!strcmp(optarg, "slice")) {
+        *threading = SC_VIDEO_DECODER_THREADING_SLICE;
         return true;
     }
 
-    if (!strcmp(optarg, "sdk")) {
-        *mode = SC_KEYBOARD_INPUT_MODE_SDK;
+    if (!strcmp(optarg, "frame")) {
+        *threading = SC_VIDEO_DECODER_THREADING_FRAME;
         return true;
     }
 
-    if (!strcmp(optarg, "uhid")) {
-        *mode = SC_KEYBOARD_INPUT_MODE_UHID;
+    LOGE("Unsupported video decoder threading: %s (expected slice or frame)",
+         optarg);
+    return false;
+}
+
+#ifdef HAVE_V4L2
+static bool
+parse_v4l2_format(const char *optarg, enum sc_v4l2_format *format) {
+    if (!strcmp(optarg, "yuv420p")) {
+        *format = SC_V4L2_FORMAT_YUV420P;
         return true;
     }
 
-    if (!strcmp(optarg, "aoa")) {
-#ifdef HAVE_USB
-        *mode = SC_KEYBOARD_INPUT_MODE_AOA;
+    if (!strcmp(optarg, "nv12")) {
+        *format = SC_V4L2_FORMAT_NV12;
         return true;
-#else
-        LOGE("--keyboard=aoa is disabled.");
-        return false;
-#endif
     }
 
-    LOGE("Unsupported keyboard: %s (expected disabled, sdk, uhid and aoa)",
+    if (!strcmp(optarg, "yuyv")) {
+        *format = SC_V4L2_FORMAT_YUYV;
+        return true;
+    }
+
+    LOGE("Unsupported v4l2 format: %s (expected yuv420p, nv12 or yuyv)",
          optarg);
     return false;
 }
+#endif
 
 static bool
-parse_mouse(const char *optarg, enum sc_mouse_input_mode *mode) {
-    if (!strcmp(optarg, "disabled")) {
-        *mode = SC_MOUSE_INPUT_MODE_DISABLED;
+parse_camera_facing(const char *optarg, enum sc_camera_facing *facing) {
+    if (!strcmp(optarg, "front")) {
+        *facing = SC_CAMERA_FACING_FRONT;
         return true;
     }
 
-    if (!strcmp(optarg, "sdk")) {
-        *mode = SC_MOUSE_INPUT_MODE_SDK;
+    if (!strcmp(optarg, "back")) {
+        *facing = SC_CAMERA_FACING_BACK;
         return true;
     }
 
-    if (!strcmp(optarg, "uhid")) {
+    if (!strcmp(optarg, "external")) {
+        *facing = SC_CAMERA_FACING_EXTERNAL;
+        return true;
+    }
+
+    if (*optarg == '\0') {
+        // Empty string is a valid value (equivalent to not passing the option)
+        *facing = SC_CAMERA_FACING_ANY;
+        return true;
+    }
+
+    LOGE("Unsupported camera facing: %s (expected front, back or external)",
+         optarg);
+    return false;
+}
+
+static bool
+parse_camera_fps(const char *s, uint16_t *camera_fps) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 0xFFFF, "camera fps");
+    if (!ok) {
+        return false;
+    }
+
+    *camera_fps = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_pattern_fps(const char *s, uint16_t *pattern_fps) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 1, 0xFFFF, "pattern fps");
+    if (!ok) {
+        return false;
+    }
+
+    *pattern_fps = (uint16_t) value;
+    return true;
+}
+
+static bool
+parse_keyboard(const char *optarg, enum sc_keyboard_input_mode *mode) {
+    if (!strcmp(optarg, "disabled")) {
+        *mode = SC_KEYBOARD_INPUT_MODE_DISABLED;
+        return true;
+    }
+
+    if (!strcmp(optarg, "sdk")) {
+        *mode = SC_KEYBOARD_INPUT_MODE_SDK;
+        return true;
+    }
+
+    if (!strcmp(optarg, "uhid")) {
+        *mode = SC_KEYBOARD_INPUT_MODE_UHID;
+        return true;
+    }
+
+    if (!strcmp(optarg, "aoa")) {
+#ifdef HAVE_USB
+        *mode = SC_KEYBOARD_INPUT_MODE_AOA;
+        return true;
+#else
+        LOGE("--keyboard=aoa is disabled.");
+        return false;
+#endif
+    }
+
+    LOGE("Unsupported keyboard: %s (expected disabled, sdk, uhid and aoa)",
+         optarg);
+    return false;
+}
+
+static bool
+parse_mouse(const char *optarg, enum sc_mouse_input_mode *mode) {
+    if (!strcmp(optarg, "disabled")) {
+        *mode = SC_MOUSE_INPUT_MODE_DISABLED;
+        return true;
+    }
+
+    if (!strcmp(optarg, "sdk")) {
+        *mode = SC_MOUSE_INPUT_MODE_SDK;
+        return true;
+    }
+
+    if (!strcmp(optarg, "uhid")) {
         *mode = SC_MOUSE_INPUT_MODE_UHID;
         return true;
     }
@@ -2013,6 +3381,35 @@ parse_mouse(const char *optarg, enum sc_mouse_input_mode *mode) {
     return false;
 }
 
+static bool
+parse_gamepad(const char *optarg, enum sc_gamepad_input_mode *mode) {
+    if (!strcmp(optarg, "disabled")) {
+        *mode = SC_GAMEPAD_INPUT_MODE_DISABLED;
+        return true;
+    }
+
+    if (!strcmp(optarg, "uhid")) {
+        *mode = SC_GAMEPAD_INPUT_MODE_UHID;
+        return true;
+    }
+
+    LOGE("Unsupported gamepad: %s (expected disabled or uhid)", optarg);
+    return false;
+}
+
+static bool
+parse_mouse_report_interval(const char *s, sc_tick *tick) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 1000,
+                                "mouse report interval");
+    if (!ok) {
+        return false;
+    }
+
+    *tick = SC_TICK_FROM_MS(value);
+    return true;
+}
+
 static bool
 parse_time_limit(const char *s, sc_tick *tick) {
     long value;
@@ -2025,6 +3422,84 @@ parse_time_limit(const char *s, sc_tick *tick) {
     return true;
 }
 
+static bool
+parse_server_idle_timeout(const char *s, sc_tick *tick) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 0x7FFFFFFF,
+                                "server idle timeout");
+    if (!ok) {
+        return false;
+    }
+
+    *tick = SC_TICK_FROM_SEC(value);
+    return true;
+}
+
+static bool
+parse_shutdown_timeout(const char *s, sc_tick *tick) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 60000,
+                                "shutdown timeout");
+    if (!ok) {
+        return false;
+    }
+
+    *tick = SC_TICK_FROM_MS(value);
+    return true;
+}
+
+static bool
+parse_wall_preview_interval(const char *s, sc_tick *tick) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 0, 600000,
+                                "wall preview interval");
+    if (!ok) {
+        return false;
+    }
+
+    *tick = SC_TICK_FROM_MS(value);
+    return true;
+}
+
+static bool
+parse_screen_stability(const char *s, sc_tick *tick) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 1, 0x7FFFFFFF,
+                                "screen stability delay");
+    if (!ok) {
+        return false;
+    }
+
+    *tick = SC_TICK_FROM_MS(value);
+    return true;
+}
+
+static bool
+parse_frame_hash_interval(const char *s, uint32_t *interval) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, false, 1, 0x7FFFFFFF,
+                                "frame hash interval");
+    if (!ok) {
+        return false;
+    }
+
+    *interval = (uint32_t) value;
+    return true;
+}
+
+static bool
+parse_socket_buffer_size(const char *s, uint32_t *size) {
+    long value;
+    bool ok = parse_integer_arg(s, &value, true, 0, 0x7FFFFFFF,
+                                "socket buffer size");
+    if (!ok) {
+        return false;
+    }
+
+    *size = (uint32_t) value;
+    return true;
+}
+
 static bool
 parse_pause_on_exit(const char *s, enum sc_pause_on_exit *pause_on_exit) {
     if (!s || !strcmp(s, "true")) {
@@ -2067,6 +3542,80 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
                     return false;
                 }
                 break;
+            case OPT_RECORD_VIDEO_BIT_RATE:
+                if (!parse_bit_rate(optarg, &opts->record_video_bit_rate)) {
+                    return false;
+                }
+                break;
+            case OPT_RECORD_VIDEO_SOURCE:
+                if (!parse_record_video_source(optarg,
+                                               &opts->record_video_source)) {
+                    return false;
+                }
+                break;
+            case OPT_RECORD_FRAGMENTED:
+                opts->record_fragmented = true;
+                break;
+            case OPT_RECORD_LOW_LATENCY:
+                opts->record_low_latency = true;
+                break;
+            case OPT_RECORD_UPLOAD:
+                opts->record_upload_url = optarg;
+                break;
+            case OPT_RECORD_SEGMENT:
+                if (!parse_record_segment(optarg,
+                                          &opts->record_segment_duration)) {
+                    return false;
+                }
+                break;
+            case OPT_RECORD_SEGMENT_COUNT:
+                if (!parse_record_segment_count(optarg,
+                                                &opts->record_segment_count)) {
+                    return false;
+                }
+                break;
+            case OPT_RECORD_THUMBNAILS:
+                opts->record_thumbnails_filename = optarg;
+                break;
+            case OPT_REPLAY_BUFFER:
+                if (!parse_replay_buffer(optarg,
+                                         &opts->replay_buffer_duration)) {
+                    return false;
+                }
+                break;
+            case OPT_REPLAY_FILE:
+                opts->replay_filename = optarg;
+                break;
+            case OPT_DUMP_STREAMS:
+                opts->dump_streams_dir = optarg;
+                break;
+            case OPT_REPLAY_STREAMS:
+                opts->replay_streams_dir = optarg;
+                break;
+            case OPT_REPLAY_STREAMS_MAX_SPEED:
+                opts->replay_streams_max_speed = true;
+                break;
+            case OPT_SCREENSHOT_FILE:
+                opts->screenshot_filename = optarg;
+                break;
+            case OPT_SCREEN_STABILITY:
+                if (!parse_screen_stability(optarg,
+                                            &opts->screen_stability_delay)) {
+                    return false;
+                }
+                break;
+            case OPT_RECORD_QUEUE_LIMIT:
+                if (!parse_record_queue_limit(optarg,
+                                              &opts->record_queue_limit)) {
+                    return false;
+                }
+                break;
+            case OPT_RECORD_WRITE_BUFFER:
+                if (!parse_record_write_buffer(optarg,
+                                               &opts->record_write_buffer)) {
+                    return false;
+                }
+                break;
             case OPT_AUDIO_BIT_RATE:
                 if (!parse_bit_rate(optarg, &opts->audio_bit_rate)) {
                     return false;
@@ -2130,6 +3679,20 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
                     return false;
                 }
                 break;
+            case 'G':
+                opts->gamepad_input_mode = SC_GAMEPAD_INPUT_MODE_UHID;
+                break;
+            case OPT_GAMEPAD:
+                if (!parse_gamepad(optarg, &opts->gamepad_input_mode)) {
+                    return false;
+                }
+                break;
+            case OPT_MOUSE_REPORT_INTERVAL:
+                if (!parse_mouse_report_interval(optarg,
+                                                 &opts->mouse_report_interval)) {
+                    return false;
+                }
+                break;
             case OPT_HID_MOUSE_DEPRECATED:
                 LOGE("--hid-mouse has been removed, use --mouse=aoa or "
                      "--mouse=uhid instead.");
@@ -2289,9 +3852,23 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             case OPT_RENDER_DRIVER:
                 opts->render_driver = optarg;
                 break;
+            case OPT_VIDEO_HWACCEL:
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+                opts->video_hwaccel = optarg;
+                break;
+#else
+                LOGE("Hardware decoding (--video-hwaccel) is not supported by "
+                     "this FFmpeg version.");
+                return false;
+#endif
             case OPT_NO_MIPMAPS:
                 opts->mipmaps = false;
                 break;
+            case OPT_UPSCALE_FILTER:
+                if (!parse_upscale_filter(optarg, &opts->upscale_filter)) {
+                    return false;
+                }
+                break;
             case OPT_NO_KEY_REPEAT:
                 opts->forward_key_repeat = false;
                 break;
@@ -2312,12 +3889,72 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             case OPT_VIDEO_ENCODER:
                 opts->video_encoder = optarg;
                 break;
+            case OPT_VIDEO_HDR:
+                opts->video_hdr = true;
+                break;
+            case OPT_REALTIME_THREADS:
+                opts->realtime_threads = true;
+                break;
+            case OPT_CPU_AFFINITY:
+                if (!parse_cpu_affinity(optarg, &opts->cpu_affinity)) {
+                    return false;
+                }
+                break;
+            case OPT_NEW_DISPLAY:
+                // An empty value means the default size and density
+                opts->new_display = optarg ? optarg : "";
+                break;
+            case OPT_VIDEO_INTRA_REFRESH:
+                opts->video_intra_refresh = true;
+                break;
+            case OPT_SQUARE_VIDEO:
+                opts->square_video = true;
+                break;
+            case OPT_ADAPTIVE_FPS:
+                opts->adaptive_fps = true;
+                break;
+            case OPT_GPU_DOWNSCALE:
+                opts->gpu_downscale = true;
+                break;
+            case OPT_VIDEO_MASK:
+                if (!parse_video_masks(optarg)) {
+                    return false;
+                }
+                opts->video_masks = optarg;
+                break;
+            case OPT_VIDEO_LATENCY_PROFILE:
+                if (!parse_video_latency_profile(optarg,
+                                                 &opts->video_latency_profile)) {
+                    return false;
+                }
+                break;
+            case OPT_VIDEO_DECODER_THREADING:
+                if (!parse_video_decoder_threading(
+                        optarg, &opts->video_decoder_threading)) {
+                    return false;
+                }
+                break;
+            case OPT_VIDEO_DECODER_THREADS:
+                if (!parse_video_decoder_threads(optarg,
+                                                 &opts->video_decoder_threads)) {
+                    return false;
+                }
+                break;
+            case OPT_VIDEO_REPEAT_DELAY:
+                if (!parse_video_repeat_delay(optarg,
+                                              &opts->video_repeat_delay)) {
+                    return false;
+                }
+                break;
             case OPT_AUDIO_ENCODER:
                 opts->audio_encoder = optarg;
                 break;
             case OPT_FORCE_ADB_FORWARD:
                 opts->force_adb_forward = true;
                 break;
+            case OPT_PERSISTENT_TUNNEL:
+                opts->persistent_tunnel = true;
+                break;
             case OPT_DISABLE_SCREENSAVER:
                 opts->disable_screensaver = true;
                 break;
@@ -2335,6 +3972,11 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             case OPT_POWER_OFF_ON_CLOSE:
                 opts->power_off_on_close = true;
                 break;
+            case OPT_DISPLAY_PACING:
+                if (!parse_buffering_time(optarg, &opts->display_pacing)) {
+                    return false;
+                }
+                break;
             case OPT_DISPLAY_BUFFER:
                 if (!parse_buffering_time(optarg, &opts->display_buffer)) {
                     return false;
@@ -2365,27 +4007,176 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             case OPT_PRINT_FPS:
                 opts->start_fps_counter = true;
                 break;
-            case OPT_CODEC:
-                LOGE("--codec has been removed, "
-                     "use --video-codec or --audio-codec.");
-                return false;
-            case OPT_VIDEO_CODEC:
-                if (!parse_video_codec(optarg, &opts->video_codec)) {
+            case OPT_PRINT_LATENCY:
+                opts->print_latency = true;
+                break;
+            case OPT_AUDIO_SAMPLE_RATE:
+                if (!parse_audio_sample_rate(optarg,
+                                             &opts->audio_sample_rate)) {
                     return false;
                 }
                 break;
-            case OPT_AUDIO_CODEC:
-                if (!parse_audio_codec(optarg, &opts->audio_codec)) {
+            case OPT_AUDIO_CHANNELS:
+                if (!parse_audio_channels(optarg, &opts->audio_channels)) {
                     return false;
                 }
                 break;
-            case OPT_OTG:
-#ifdef HAVE_USB
-                opts->otg = true;
+            case OPT_AUDIO_VOLUME:
+                if (!parse_audio_volume(optarg, &opts->audio_volume)) {
+                    return false;
+                }
                 break;
-#else
-                LOGE("OTG mode (--otg) is disabled.");
-                return false;
+            case OPT_AUDIO_READ_SIZE:
+                if (!parse_audio_read_size(optarg, &opts->audio_read_size)) {
+                    return false;
+                }
+                break;
+            case OPT_ADAPTIVE_AUDIO_BUFFER:
+                if (!parse_adaptive_audio_buffer(optarg, &opts->audio_buffer_min,
+                                                 &opts->audio_buffer_max)) {
+                    return false;
+                }
+                break;
+            case OPT_ADAPTIVE_BIT_RATE:
+                opts->adaptive_bit_rate = true;
+                break;
+            case OPT_ADAPTIVE_SIZE:
+                opts->adaptive_size = true;
+                break;
+            case OPT_INPUT_OVERLAY:
+                opts->input_overlay = true;
+                break;
+            case OPT_PERF_OVERLAY:
+                opts->perf_overlay = true;
+                break;
+            case OPT_RESTREAM:
+                opts->restream_url = optarg;
+                break;
+            case OPT_RESTREAM_VIDEO_ENCODER:
+                opts->restream_video_encoder = optarg;
+                break;
+            case OPT_FRAME_SHARE:
+#ifdef HAVE_FRAME_SHARE
+                if (!parse_frame_share_name(optarg)) {
+                    return false;
+                }
+                opts->frame_share = optarg;
+                break;
+#else
+                LOGE("Frame sharing (--frame-share) is not supported on this "
+                     "platform.");
+                return false;
+#endif
+            case OPT_SERVER_IDLE_TIMEOUT:
+                if (!parse_server_idle_timeout(optarg,
+                                               &opts->server_idle_timeout)) {
+                    return false;
+                }
+                break;
+            case OPT_SHUTDOWN_TIMEOUT:
+                if (!parse_shutdown_timeout(optarg, &opts->shutdown_timeout)) {
+                    return false;
+                }
+                break;
+            case OPT_DEVICES_CACHE:
+                opts->devices_cache = optarg;
+                break;
+            case OPT_DIRECT_PORT:
+                if (!parse_port(optarg, &opts->direct_port)) {
+                    return false;
+                }
+                break;
+            case OPT_MULTIPLEX:
+                opts->multiplex = true;
+                break;
+            case OPT_DIRECT_UDP:
+                opts->direct_udp = true;
+                break;
+            case OPT_VIDEO_RECONNECT:
+                opts->video_reconnect = true;
+                break;
+            case OPT_VIDEO_PACING:
+                opts->video_pacing = true;
+                break;
+            case OPT_SOCKET_BUFFER_SIZE:
+                if (!parse_socket_buffer_size(optarg,
+                                              &opts->socket_buffer_size)) {
+                    return false;
+                }
+                break;
+            case OPT_INPUT_RECORD:
+                opts->input_record_filename = optarg;
+                break;
+            case OPT_INPUT_REPLAY:
+                opts->input_replay_filename = optarg;
+                break;
+            case OPT_COMPRESS_CONTROL:
+#ifdef HAVE_CONTROL_COMPRESSION
+                opts->control_compression = true;
+                break;
+#else
+                LOGE("Control compression (--compress-control) is not "
+                     "supported (scrcpy was built without zlib).");
+                return false;
+#endif
+            case OPT_CONTROL_IO_LOOP:
+                opts->control_io_loop = true;
+                break;
+            case OPT_CONTROL_PORT:
+                if (!parse_port(optarg, &opts->control_port)) {
+                    return false;
+                }
+                if (!opts->control_port) {
+                    LOGE("Invalid control port: 0");
+                    return false;
+                }
+                break;
+            case OPT_STATS_FILE:
+                opts->stats_file = optarg;
+                break;
+            case OPT_FRAME_HASH_FILE:
+                opts->frame_hash_filename = optarg;
+                break;
+            case OPT_FRAME_HASH_INTERVAL:
+                if (!parse_frame_hash_interval(optarg,
+                                               &opts->frame_hash_interval)) {
+                    return false;
+                }
+                break;
+            case OPT_STATS_FORMAT:
+                if (!parse_stats_format(optarg, &opts->stats_format)) {
+                    return false;
+                }
+                break;
+            case OPT_CODEC:
+                LOGE("--codec has been removed, "
+                     "use --video-codec or --audio-codec.");
+                return false;
+            case OPT_VIDEO_CODEC:
+                if (!parse_video_codec(optarg, &opts->video_codec)) {
+                    return false;
+                }
+                break;
+            case OPT_AUDIO_CODEC:
+                if (!parse_audio_codec(optarg, &opts->audio_codec)) {
+                    return false;
+                }
+                break;
+            case OPT_OTG:
+#ifdef HAVE_USB
+                opts->otg = true;
+                break;
+#else
+                LOGE("OTG mode (--otg) is disabled.");
+                return false;
+#endif
+            case OPT_OTG_RECONNECT:
+#ifdef HAVE_USB
+                opts->otg_reconnect = true;
+                break;
+#else
+                LOGE("OTG mode (--otg-reconnect) is disabled.");
+                return false;
 #endif
             case OPT_V4L2_SINK:
 #ifdef HAVE_V4L2
@@ -2406,6 +4197,28 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
                 LOGE("V4L2 (--v4l2-buffer) is disabled (or unsupported on this "
                      "platform).");
                 return false;
+#endif
+            case OPT_V4L2_FORMAT:
+#ifdef HAVE_V4L2
+                if (!parse_v4l2_format(optarg, &opts->v4l2_format)) {
+                    return false;
+                }
+                break;
+#else
+                LOGE("V4L2 (--v4l2-format) is disabled (or unsupported on this "
+                     "platform).");
+                return false;
+#endif
+            case OPT_V4L2_MAX_SIZE:
+#ifdef HAVE_V4L2
+                if (!parse_max_size(optarg, &opts->v4l2_max_size)) {
+                    return false;
+                }
+                break;
+#else
+                LOGE("V4L2 (--v4l2-max-size) is disabled (or unsupported on "
+                     "this platform).");
+                return false;
 #endif
             case OPT_LIST_ENCODERS:
                 opts->list |= SC_OPTION_LIST_ENCODERS;
@@ -2419,6 +4232,9 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             case OPT_LIST_CAMERA_SIZES:
                 opts->list |= SC_OPTION_LIST_CAMERA_SIZES;
                 break;
+            case OPT_LIST_CACHE:
+                opts->list_cache = optarg;
+                break;
             case OPT_REQUIRE_AUDIO:
                 opts->require_audio = true;
                 break;
@@ -2427,6 +4243,17 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
                     return false;
                 }
                 break;
+            case OPT_AUDIO_DELAY:
+                if (!parse_buffering_time(optarg, &opts->audio_delay)) {
+                    return false;
+                }
+                break;
+            case OPT_AV_SYNC:
+                opts->av_sync = true;
+                break;
+            case OPT_BENCHMARK_STARTUP:
+                opts->benchmark_startup = true;
+                break;
             case OPT_AUDIO_OUTPUT_BUFFER:
                 if (!parse_audio_output_buffer(optarg,
                                                &opts->audio_output_buffer)) {
@@ -2451,6 +4278,26 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
                     return false;
                 }
                 break;
+            case OPT_THUMBNAIL_DECODING:
+                opts->thumbnail_decoding = true;
+                break;
+            case OPT_THERMAL_GOVERNOR:
+                opts->thermal_governor = true;
+                break;
+            case OPT_WALL:
+                opts->wall = optarg;
+                break;
+            case OPT_WALL_BACKGROUND_FPS:
+                if (!parse_max_fps(optarg, &opts->wall_background_fps)) {
+                    return false;
+                }
+                break;
+            case OPT_WALL_PREVIEW_INTERVAL:
+                if (!parse_wall_preview_interval(optarg,
+                                                 &opts->wall_preview_interval)) {
+                    return false;
+                }
+                break;
             case OPT_PAUSE_ON_EXIT:
                 if (!parse_pause_on_exit(optarg, &args->pause_on_exit)) {
                     return false;
@@ -2478,6 +4325,20 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             case OPT_CAMERA_HIGH_SPEED:
                 opts->camera_high_speed = true;
                 break;
+            case OPT_CAMERA_LOW_LATENCY:
+                opts->camera_low_latency = true;
+                break;
+            case OPT_CAMERA_LOCK_AE_AF:
+                opts->camera_lock_ae_af = true;
+                break;
+            case OPT_PATTERN_SIZE:
+                opts->pattern_size = optarg;
+                break;
+            case OPT_PATTERN_FPS:
+                if (!parse_pattern_fps(optarg, &opts->pattern_fps)) {
+                    return false;
+                }
+                break;
             default:
                 // getopt prints the error message on stderr
                 return false;
@@ -2508,12 +4369,16 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
 
     bool otg = false;
     bool v4l2 = false;
+    bool frame_share = false;
 #ifdef HAVE_USB
     otg = opts->otg;
 #endif
 #ifdef HAVE_V4L2
     v4l2 = !!opts->v4l2_device;
 #endif
+#ifdef HAVE_FRAME_SHARE
+    frame_share = !!opts->frame_share;
+#endif
 
     if (!opts->video) {
         opts->video_playback = false;
@@ -2526,16 +4391,25 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
     }
 
     if (opts->video && !opts->video_playback && !opts->record_filename
-            && !v4l2) {
+            && !v4l2 && !opts->restream_url && !frame_share
+            && !opts->frame_hash_filename) {
         LOGI("No video playback, no recording, no V4L2 sink: video disabled");
         opts->video = false;
     }
 
-    if (opts->audio && !opts->audio_playback && !opts->record_filename) {
+    if (opts->audio && !opts->audio_playback && !opts->record_filename
+            && !opts->replay_buffer_duration && !opts->restream_url) {
         LOGI("No audio playback, no recording: audio disabled");
         opts->audio = false;
     }
 
+#ifdef HAVE_USB
+    if (opts->otg_reconnect && !otg) {
+        LOGE("--otg-reconnect requires --otg");
+        return false;
+    }
+#endif
+
     if (!opts->video && !opts->audio && !otg) {
         LOGE("No video, no audio, no OTG: nothing to do");
         return false;
@@ -2546,6 +4420,109 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         opts->require_audio = true;
     }
 
+    if (opts->benchmark_startup && (!opts->video || !opts->video_playback)) {
+        LOGE("--benchmark-startup requires video playback");
+        return false;
+    }
+
+    if (opts->thumbnail_decoding && (!opts->video || !opts->video_playback)) {
+        LOGE("--thumbnail-decoding requires video playback");
+        return false;
+    }
+
+    if (opts->perf_overlay && (!opts->video || !opts->video_playback)) {
+        LOGE("--perf-overlay requires video playback");
+        return false;
+    }
+
+    if (opts->wall) {
+        if (selectors) {
+            LOGE("--wall is incompatible with the device selector options");
+            return false;
+        }
+
+        if (otg) {
+            LOGE("--wall is incompatible with --otg");
+            return false;
+        }
+
+        if (!opts->video) {
+            LOGE("--wall requires video");
+            return false;
+        }
+
+        if (!opts->video_playback && !opts->record_filename) {
+            LOGE("--wall requires video playback or recording");
+            return false;
+        }
+
+        if (opts->record_video_bit_rate) {
+            LOGE("--wall is incompatible with --record-video-bit-rate");
+            return false;
+        }
+
+        if (opts->record_thumbnails_filename) {
+            LOGE("--wall is incompatible with --record-thumbnails");
+            return false;
+        }
+
+        if (opts->restream_url) {
+            LOGE("--wall is incompatible with --restream");
+            return false;
+        }
+
+        if (opts->perf_overlay) {
+            LOGE("--wall is incompatible with --perf-overlay");
+            return false;
+        }
+
+        if (opts->wall_preview_interval && !opts->video_playback) {
+            LOGE("--wall-preview-interval requires video playback");
+            return false;
+        }
+
+        if (opts->wall_background_fps && !opts->video_playback) {
+            LOGE("--wall-background-fps requires video playback");
+            return false;
+        }
+    } else if (opts->wall_preview_interval) {
+        LOGE("--wall-preview-interval requires --wall");
+        return false;
+    } else if (opts->wall_background_fps) {
+        LOGE("--wall-background-fps requires --wall");
+        return false;
+    }
+
+    if (opts->replay_streams_dir) {
+        if (opts->dump_streams_dir) {
+            LOGE("--replay-streams is incompatible with --dump-streams");
+            return false;
+        }
+
+        if (selectors || otg || opts->wall || opts->list) {
+            LOGE("--replay-streams does not connect to any device");
+            return false;
+        }
+
+        if (opts->control) {
+            LOGI("Stream replay: control disabled");
+            opts->control = false;
+        }
+    } else if (opts->replay_streams_max_speed) {
+        LOGE("--replay-streams-max-speed requires --replay-streams");
+        return false;
+    }
+
+    if (opts->dump_streams_dir && opts->wall) {
+        LOGE("--dump-streams is incompatible with --wall");
+        return false;
+    }
+
+    if (opts->display_pacing && opts->display_buffer) {
+        LOGE("--display-pacing is incompatible with --display-buffer");
+        return false;
+    }
+
     if (opts->audio_playback && opts->audio_buffer == -1) {
         if (opts->audio_codec == SC_CODEC_FLAC) {
             // Use 50 ms audio buffer by default, but use a higher value for FLAC,
@@ -2559,6 +4536,42 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         }
     }
 
+    if (opts->audio_buffer_max) {
+        if (!opts->audio_playback) {
+            LOGE("--adaptive-audio-buffer requires audio playback");
+            return false;
+        }
+
+        // Start within the bounds
+        opts->audio_buffer = CLAMP(opts->audio_buffer, opts->audio_buffer_min,
+                                   opts->audio_buffer_max);
+    }
+
+    if (opts->audio_delay && !opts->audio_playback) {
+        LOGE("--audio-delay requires audio playback");
+        return false;
+    }
+
+    if (opts->av_sync) {
+        if (!opts->video_playback || !opts->audio_playback) {
+            LOGE("--av-sync requires both video and audio playback");
+            return false;
+        }
+
+        if (opts->display_buffer || opts->display_pacing) {
+            LOGE("--av-sync is incompatible with --display-buffer and "
+                 "--display-pacing");
+            return false;
+        }
+
+        if (opts->audio_delay) {
+            // The video would be delayed by the audio latency, including
+            // the audio delay
+            LOGE("--av-sync is incompatible with --audio-delay");
+            return false;
+        }
+    }
+
 #ifdef HAVE_V4L2
     if (v4l2) {
         if (opts->lock_video_orientation ==
@@ -2578,6 +4591,12 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         LOGE("V4L2 buffer value without V4L2 sink\n");
         return false;
     }
+
+    if ((opts->v4l2_format != SC_V4L2_FORMAT_YUV420P || opts->v4l2_max_size)
+            && !opts->v4l2_device) {
+        LOGE("V4L2 format or max size without V4L2 sink");
+        return false;
+    }
 #endif
 
     if (opts->keyboard_input_mode == SC_KEYBOARD_INPUT_MODE_AUTO) {
@@ -2628,14 +4647,107 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         }
     }
 
+    if (opts->direct_port) {
+        if (opts->tunnel_host || opts->tunnel_port) {
+            LOGE("--tunnel-host and --tunnel-port are incompatible with "
+                 "--direct-port");
+            return false;
+        }
+
+        if (opts->server_idle_timeout) {
+            LOGE("--server-idle-timeout is incompatible with --direct-port");
+            return false;
+        }
+
+        if (opts->multiplex) {
+            LOGE("--multiplex is incompatible with --direct-port");
+            return false;
+        }
+    } else if (opts->direct_udp) {
+        LOGE("--direct-udp requires --direct-port");
+        return false;
+    }
+
+    if (opts->video_pacing && !opts->video) {
+        LOGE("--video-pacing requires video");
+        return false;
+    }
+
+    if (opts->video_reconnect) {
+        if (!opts->video) {
+            LOGE("--video-reconnect requires video");
+            return false;
+        }
+
+        if (opts->replay_streams_dir) {
+            LOGE("--video-reconnect is incompatible with --replay-streams");
+            return false;
+        }
+
+        if (opts->record_video_bit_rate) {
+            // Only the mirrored video stream is reconnected
+            LOGE("--video-reconnect is incompatible with "
+                 "--record-video-bit-rate");
+            return false;
+        }
+
+        if (opts->multiplex) {
+            LOGE("--video-reconnect is incompatible with --multiplex");
+            return false;
+        }
+
+        if (opts->direct_port) {
+            LOGE("--video-reconnect is incompatible with --direct-port");
+            return false;
+        }
+
+        if (opts->server_idle_timeout) {
+            // The server socket accepts the connections of the next clients
+            LOGE("--video-reconnect is incompatible with "
+                 "--server-idle-timeout");
+            return false;
+        }
+    }
+
     if ((opts->tunnel_host || opts->tunnel_port) && !opts->force_adb_forward) {
         LOGI("Tunnel host/port is set, "
              "--force-adb-forward automatically enabled.");
         opts->force_adb_forward = true;
     }
 
-    if (opts->video_source == SC_VIDEO_SOURCE_CAMERA) {
-        if (opts->display_id) {
+    if (opts->server_idle_timeout && !opts->force_adb_forward) {
+        LOGI("Server idle timeout is set, "
+             "--force-adb-forward automatically enabled.");
+        opts->force_adb_forward = true;
+    }
+
+    if (opts->persistent_tunnel) {
+        if (opts->direct_port) {
+            LOGE("--persistent-tunnel is incompatible with --direct-port");
+            return false;
+        }
+
+        if (opts->force_adb_forward) {
+            // Also if enabled by --tunnel-host, --tunnel-port or
+            // --server-idle-timeout
+            LOGE("--persistent-tunnel is incompatible with "
+                 "--force-adb-forward");
+            return false;
+        }
+    }
+
+    if (opts->record_video_source == SC_VIDEO_SOURCE_CAMERA
+            && !opts->record_video_bit_rate) {
+        LOGE("--record-video-source requires --record-video-bit-rate");
+        return false;
+    }
+
+    // The camera may be mirrored, or recorded as a separate stream while the
+    // display is mirrored
+    bool camera = opts->video_source == SC_VIDEO_SOURCE_CAMERA
+               || opts->record_video_source == SC_VIDEO_SOURCE_CAMERA;
+    if (camera) {
+        if (opts->video_source == SC_VIDEO_SOURCE_CAMERA && opts->display_id) {
             LOGE("--display-id is only available with --video-source=display");
             return false;
         }
@@ -2662,7 +4774,13 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             return false;
         }
 
-        if (opts->control) {
+        if (opts->camera_high_speed && opts->camera_lock_ae_af) {
+            LOGE("Could not specify both --camera-high-speed and "
+                 "--camera-lock-ae-af");
+            return false;
+        }
+
+        if (opts->video_source == SC_VIDEO_SOURCE_CAMERA && opts->control) {
             LOGI("Camera video source: control disabled");
             opts->control = false;
         }
@@ -2671,18 +4789,155 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             || opts->camera_facing != SC_CAMERA_FACING_ANY
             || opts->camera_fps
             || opts->camera_high_speed
+            || opts->camera_low_latency
+            || opts->camera_lock_ae_af
             || opts->camera_size) {
-        LOGE("Camera options are only available with --video-source=camera");
+        LOGE("Camera options are only available with --video-source=camera "
+             "or --record-video-source=camera");
+        return false;
+    }
+
+    if (opts->video_source == SC_VIDEO_SOURCE_PATTERN) {
+        if (opts->display_id) {
+            LOGE("--display-id is only available with --video-source=display");
+            return false;
+        }
+
+        if (opts->control) {
+            LOGI("Pattern video source: control disabled");
+            opts->control = false;
+        }
+    } else if (opts->pattern_size || opts->pattern_fps) {
+        LOGE("--pattern-size and --pattern-fps are only available with "
+             "--video-source=pattern");
         return false;
     }
 
+    if (opts->new_display) {
+        if (opts->video_source != SC_VIDEO_SOURCE_DISPLAY) {
+            LOGE("--new-display is only available with "
+                 "--video-source=display");
+            return false;
+        }
+
+        if (opts->display_id) {
+            LOGE("Could not specify both --new-display and --display-id");
+            return false;
+        }
+
+        if (opts->crop) {
+            // The new display renders directly to the encoder surface
+            LOGE("--crop is not supported with --new-display");
+            return false;
+        }
+
+        if (opts->lock_video_orientation
+                != SC_LOCK_VIDEO_ORIENTATION_UNLOCKED) {
+            LOGE("--lock-video-orientation is not supported with "
+                 "--new-display");
+            return false;
+        }
+
+        if (opts->square_video) {
+            LOGE("--square-video is not supported with --new-display");
+            return false;
+        }
+
+        if (opts->gpu_downscale || opts->video_masks || opts->adaptive_fps) {
+            LOGE("--gpu-downscale, --video-mask and --adaptive-fps are not "
+                 "supported with --new-display");
+            return false;
+        }
+    }
+
+    if (opts->square_video && opts->video_source != SC_VIDEO_SOURCE_DISPLAY) {
+        LOGE("--square-video is only available with --video-source=display");
+        return false;
+    }
+
+    if ((opts->gpu_downscale || opts->video_masks || opts->adaptive_fps)
+            && opts->video_source != SC_VIDEO_SOURCE_DISPLAY) {
+        LOGE("--gpu-downscale, --video-mask and --adaptive-fps are only "
+             "available with --video-source=display");
+        return false;
+    }
+
+    if (opts->video_codec == SC_CODEC_AUTO && opts->video_encoder) {
+        LOGE("--video-encoder requires an explicit --video-codec");
+        return false;
+    }
+
+    if (opts->video_hdr) {
+        if (opts->video_codec != SC_CODEC_H265) {
+            LOGE("--video-hdr requires --video-codec=h265");
+            return false;
+        }
+
+        if (v4l2) {
+            LOGE("--video-hdr is incompatible with --v4l2-sink");
+            return false;
+        }
+
+        if (frame_share) {
+            LOGE("--video-hdr is incompatible with --frame-share");
+            return false;
+        }
+    }
+
+    if (opts->adaptive_bit_rate) {
+        if (!opts->video) {
+            LOGE("--adaptive-bit-rate requires video");
+            return false;
+        }
+        if (!opts->control) {
+            // Control may also have been disabled for camera mirroring
+            LOGE("--adaptive-bit-rate requires control");
+            return false;
+        }
+    }
+
+    if (opts->adaptive_size) {
+        if (!opts->video) {
+            LOGE("--adaptive-size requires video");
+            return false;
+        }
+        if (!opts->control) {
+            // Control may also have been disabled for camera mirroring
+            LOGE("--adaptive-size requires control");
+            return false;
+        }
+    }
+
+    if (!opts->control) {
+        if (opts->input_record_filename) {
+            LOGE("--input-record requires control");
+            return false;
+        }
+        if (opts->input_replay_filename) {
+            LOGE("--input-replay requires control");
+            return false;
+        }
+        if (opts->control_port) {
+            LOGE("--control-port requires control");
+            return false;
+        }
+        if (opts->control_compression) {
+            LOGE("--compress-control requires control");
+            return false;
+        }
+        if (opts->control_io_loop) {
+            LOGE("--control-io-loop requires control");
+            return false;
+        }
+    }
+
     if (opts->audio && opts->audio_source == SC_AUDIO_SOURCE_AUTO) {
         // Select the audio source according to the video source
-        if (opts->video_source == SC_VIDEO_SOURCE_DISPLAY) {
-            opts->audio_source = SC_AUDIO_SOURCE_OUTPUT;
-        } else {
+        if (opts->video_source == SC_VIDEO_SOURCE_CAMERA) {
             opts->audio_source = SC_AUDIO_SOURCE_MIC;
             LOGI("Camera video source: microphone audio source selected");
+        } else {
+            opts->audio_source = SC_AUDIO_SOURCE_OUTPUT;
         }
     }
 
@@ -2691,6 +4946,168 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         return false;
     }
 
+    if (opts->record_segment_count && !opts->record_segment_duration) {
+        LOGE("--record-segment-count requires --record-segment");
+        return false;
+    }
+
+    if (opts->record_segment_duration
+            && (!opts->record_filename || !opts->video)) {
+        // Segments are cut on video keyframes
+        LOGE("--record-segment requires video recording");
+        return false;
+    }
+
+    if (opts->record_thumbnails_filename
+            && (!opts->record_filename || !opts->video)) {
+        // The thumbnails are generated from the recorded video packets
+        LOGE("--record-thumbnails requires video recording");
+        return false;
+    }
+
+    if (opts->record_fragmented && !opts->record_filename) {
+        LOGE("--record-fragmented requires recording");
+        return false;
+    }
+
+    if (opts->record_low_latency && !opts->record_fragmented
+            && !opts->record_segment_duration) {
+        // The packets are only consumed live from fragments or segments
+        LOGE("--record-low-latency requires --record-fragmented or "
+             "--record-segment");
+        return false;
+    }
+
+    if (opts->list_cache && !opts->list) {
+        LOGE("--list-cache requires a --list-* option");
+        return false;
+    }
+
+    if (opts->record_upload_url && !opts->record_filename) {
+        LOGE("--record-upload requires recording");
+        return false;
+    }
+
+    if (opts->record_queue_limit && !opts->record_filename) {
+        LOGE("--record-queue-limit requires recording");
+        return false;
+    }
+
+    if (opts->record_write_buffer && !opts->record_filename) {
+        LOGE("--record-write-buffer requires recording");
+        return false;
+    }
+
+    if (opts->screenshot_filename
+            && (!opts->video || !opts->video_playback)) {
+        // The screenshots are saved by a shortcut, from the decoded frames
+        LOGE("--screenshot-file requires video playback");
+        return false;
+    }
+
+    if (opts->screen_stability_delay && !opts->control_port) {
+        // The events are sent to the control server client
+        LOGE("--screen-stability requires --control-port");
+        return false;
+    }
+
+    if (opts->screen_stability_delay && !opts->video) {
+        LOGE("--screen-stability requires video");
+        return false;
+    }
+
+    if (opts->frame_hash_interval != 1 && !opts->frame_hash_filename) {
+        LOGE("--frame-hash-interval requires --frame-hash-file");
+        return false;
+    }
+
+    if (opts->thermal_governor && !opts->video) {
+        LOGE("--thermal-governor requires video");
+        return false;
+    }
+
+    if (opts->frame_hash_filename && !opts->video) {
+        LOGE("--frame-hash-file requires video");
+        return false;
+    }
+
+    if (opts->replay_filename && !opts->replay_buffer_duration) {
+        LOGE("--replay-file requires --replay-buffer");
+        return false;
+    }
+
+    if (opts->replay_buffer_duration) {
+        if (!opts->video_playback) {
+            // The replays are saved by a shortcut
+            LOGE("--replay-buffer requires video playback");
+            return false;
+        }
+
+        if (!opts->replay_filename) {
+            LOGE("--replay-buffer requires --replay-file");
+            return false;
+        }
+
+        opts->replay_format = guess_record_format(opts->replay_filename);
+        if (!opts->replay_format) {
+            LOGE("No format found for \"%s\" (try with a .mkv extension)",
+                 opts->replay_filename);
+            return false;
+        }
+
+        if (sc_record_format_is_audio_only(opts->replay_format)) {
+            LOGE("Replay format does not support video stream");
+            return false;
+        }
+
+        if (opts->replay_format == SC_RECORD_FORMAT_MP4
+                && opts->audio && opts->audio_codec == SC_CODEC_RAW) {
+            LOGE("Replay to MP4 container does not support RAW audio");
+            return false;
+        }
+    }
+
+    if (opts->restream_video_encoder
+            && (!opts->restream_url || !opts->video)) {
+        LOGE("--restream-video-encoder requires --restream (with video)");
+        return false;
+    }
+
+    if (opts->restream_url) {
+        if (!parse_restream_url(opts->restream_url, &opts->restream_format)) {
+            return false;
+        }
+
+        // Once re-encoded, the restreamed video codec does not depend on the
+        // device
+        if (opts->video && !opts->restream_video_encoder
+                && opts->video_codec != SC_CODEC_H264
+                && opts->video_codec != SC_CODEC_H265) {
+            LOGE("--restream requires --video-codec=h264 or h265 (or "
+                 "--restream-video-encoder)");
+            return false;
+        }
+
+        if (opts->audio && opts->audio_codec != SC_CODEC_OPUS
+                && opts->audio_codec != SC_CODEC_AAC) {
+            LOGE("--restream requires --audio-codec=opus or aac (or "
+                 "--no-audio)");
+            return false;
+        }
+    }
+
+    if (opts->record_video_bit_rate) {
+        if (!opts->record_filename || !opts->video) {
+            LOGE("--record-video-bit-rate requires video recording");
+            return false;
+        }
+
+        if (opts->video_source != SC_VIDEO_SOURCE_DISPLAY) {
+            LOGE("--record-video-bit-rate requires a display video source");
+            return false;
+        }
+    }
+
     if (opts->record_filename) {
         if (!opts->record_format) {
             opts->record_format = guess_record_format(opts->record_filename);
@@ -2711,6 +5128,14 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             }
         }
 
+        if (opts->record_fragmented
+                && opts->record_format != SC_RECORD_FORMAT_MP4
+                && opts->record_format != SC_RECORD_FORMAT_M4A
+                && opts->record_format != SC_RECORD_FORMAT_AAC) {
+            LOGE("--record-fragmented requires an MP4 recording format");
+            return false;
+        }
+
         if (opts->video
                 && sc_record_format_is_audio_only(opts->record_format)) {
             LOGE("Audio container does not support video stream");
@@ -2785,6 +5210,10 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             LOGE("Could not request power off on close if control is disabled");
             return false;
         }
+        if (opts->gamepad_input_mode != SC_GAMEPAD_INPUT_MODE_DISABLED) {
+            LOGE("Could not forward gamepads if control is disabled");
+            return false;
+        }
     }
 
 # ifdef _WIN32
@@ -2805,6 +5234,30 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             LOGE("OTG mode: could not record");
             return false;
         }
+        if (opts->restream_url) {
+            LOGE("OTG mode: could not restream");
+            return false;
+        }
+        if (opts->control_port) {
+            LOGE("OTG mode: could not listen for control messages");
+            return false;
+        }
+        if (opts->control_compression) {
+            LOGE("OTG mode: could not compress control messages");
+            return false;
+        }
+        if (opts->control_io_loop) {
+            LOGE("OTG mode: could not use a control I/O loop");
+            return false;
+        }
+        if (opts->video_reconnect) {
+            LOGE("OTG mode: could not reconnect video");
+            return false;
+        }
+        if (opts->video_pacing) {
+            LOGE("OTG mode: could not pace video");
+            return false;
+        }
         if (opts->turn_screen_off) {
             LOGE("OTG mode: could not turn screen off");
             return false;
@@ -2829,6 +5282,14 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             LOGE("OTG mode: could not sink to V4L2 device");
             return false;
         }
+        if (frame_share) {
+            LOGE("OTG mode: could not share frames");
+            return false;
+        }
+        if (opts->gamepad_input_mode != SC_GAMEPAD_INPUT_MODE_DISABLED) {
+            LOGE("OTG mode: could not forward gamepads");
+            return false;
+        }
     }
 
     return true;
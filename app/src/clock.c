@@ -6,31 +6,161 @@
 
 #define SC_CLOCK_NDEBUG // comment to debug
 
+// Number of points to average the jitter
 #define SC_CLOCK_RANGE 32
+// Duration of each minimum-delay window, in stream time
+#define SC_CLOCK_WINDOW_DURATION SC_TICK_FROM_SEC(1)
+// Minimum number of windows to estimate the skew
+#define SC_CLOCK_SKEW_MIN_WINDOWS 10
+// More than any real clock drift
+#define SC_CLOCK_MAX_SKEW 0.001 // 1000 ppm
 
 void
 sc_clock_init(struct sc_clock *clock) {
-    clock->range = 0;
+    clock->window_count = 0;
+    clock->window_head = 0;
+    clock->has_current = false;
+    clock->ref = 0;
     clock->offset = 0;
+    clock->skew = 0;
+    clock->range = 0;
+    clock->jitter = 0;
+}
+
+static inline sc_tick
+sc_clock_point_offset(const struct sc_clock_point *point) {
+    return point->system - point->stream;
+}
+
+static sc_tick
+sc_clock_line_offset(struct sc_clock *clock, sc_tick stream) {
+    return clock->offset + (sc_tick) (clock->skew * (stream - clock->ref));
+}
+
+static void
+sc_clock_estimate_line(struct sc_clock *clock) {
+    assert(clock->has_current);
+
+    // The current window, even incomplete, bounds the offset
+    const struct sc_clock_point *last = &clock->current;
+
+    unsigned n = clock->window_count;
+    if (n < SC_CLOCK_SKEW_MIN_WINDOWS) {
+        // Not enough points: assume that the skew is 0, and use the minimum
+        // offset
+        sc_tick min_offset = sc_clock_point_offset(last);
+        for (unsigned i = 0; i < n; ++i) {
+            sc_tick offset = sc_clock_point_offset(&clock->windows[i]);
+            if (offset < min_offset) {
+                min_offset = offset;
+            }
+        }
+        clock->ref = last->stream;
+        clock->offset = min_offset;
+        clock->skew = 0;
+        return;
+    }
+
+    // Least squares regression of the offsets over the complete windows,
+    // relative to the last window (to keep small values)
+    unsigned last_index = (clock->window_head + SC_CLOCK_WINDOWS - 1)
+                        % SC_CLOCK_WINDOWS;
+    sc_tick ref = clock->windows[last_index].stream;
+    sc_tick ref_offset = sc_clock_point_offset(&clock->windows[last_index]);
+
+    double sum_x = 0;
+    double sum_y = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        const struct sc_clock_point *point = &clock->windows[i];
+        sum_x += point->stream - ref;
+        sum_y += sc_clock_point_offset(point) - ref_offset;
+    }
+    double mean_x = sum_x / n;
+    double mean_y = sum_y / n;
+
+    double sxx = 0;
+    double sxy = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        const struct sc_clock_point *point = &clock->windows[i];
+        double dx = point->stream - ref - mean_x;
+        double dy = sc_clock_point_offset(point) - ref_offset - mean_y;
+        sxx += dx * dx;
+        sxy += dx * dy;
+    }
+
+    double skew = sxx > 0 ? sxy / sxx : 0;
+    if (skew > SC_CLOCK_MAX_SKEW) {
+        skew = SC_CLOCK_MAX_SKEW;
+    } else if (skew < -SC_CLOCK_MAX_SKEW) {
+        skew = -SC_CLOCK_MAX_SKEW;
+    }
+
+    clock->ref = ref;
+    clock->offset = ref_offset + (sc_tick) (mean_y - skew * mean_x);
+    clock->skew = skew;
+
+    // A minimum below the line (e.g. after a route change) must lower it
+    sc_tick current_offset = sc_clock_point_offset(last);
+    sc_tick line_offset = sc_clock_line_offset(clock, last->stream);
+    if (current_offset < line_offset) {
+        clock->offset -= line_offset - current_offset;
+    }
+}
+
+static void
+sc_clock_push_point(struct sc_clock *clock, sc_tick system, sc_tick stream) {
+    sc_tick offset = system - stream;
+
+    if (clock->has_current
+            && (stream - clock->current_start >= SC_CLOCK_WINDOW_DURATION
+                || stream < clock->current_start)) {
+        // The current window is complete
+        clock->windows[clock->window_head] = clock->current;
+        clock->window_head = (clock->window_head + 1) % SC_CLOCK_WINDOWS;
+        if (clock->window_count < SC_CLOCK_WINDOWS) {
+            ++clock->window_count;
+        }
+        clock->has_current = false;
+    }
+
+    if (!clock->has_current) {
+        clock->current.system = system;
+        clock->current.stream = stream;
+        clock->current_start = stream;
+        clock->has_current = true;
+    } else if (offset < sc_clock_point_offset(&clock->current)) {
+        clock->current.system = system;
+        clock->current.stream = stream;
+    }
 }
 
 void
 sc_clock_update(struct sc_clock *clock, sc_tick system, sc_tick stream) {
+    sc_clock_push_point(clock, system, stream);
+    sc_clock_estimate_line(clock);
+
     if (clock->range < SC_CLOCK_RANGE) {
         ++clock->range;
     }
 
-    sc_tick offset = system - stream;
-    clock->offset = ((clock->range - 1) * clock->offset + offset)
+    sc_tick residual = system - stream - sc_clock_line_offset(clock, stream);
+    clock->jitter = ((clock->range - 1) * clock->jitter + residual)
                   / clock->range;
 
 #ifndef SC_CLOCK_NDEBUG
-    LOGD("Clock estimation: pts + %" PRItick, clock->offset);
+    LOGD("Clock estimation: pts + %" PRItick " (skew %.1f ppm, jitter %"
+         PRItick ")", sc_clock_line_offset(clock, stream) + clock->jitter,
+         clock->skew * 1e6, clock->jitter);
 #endif
 }
 
 sc_tick
 sc_clock_to_system_time(struct sc_clock *clock, sc_tick stream) {
     assert(clock->range); // sc_clock_update() must have been called
-    return stream + clock->offset;
+    return stream + sc_clock_line_offset(clock, stream) + clock->jitter;
+}
+
+double
+sc_clock_get_skew_ppm(struct sc_clock *clock) {
+    return clock->skew * 1e6;
 }
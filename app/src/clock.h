@@ -3,8 +3,13 @@
 
 #include "common.h"
 
+#include <stdbool.h>
+
 #include "util/tick.h"
 
+// Number of minimum-delay points used to estimate the skew
+#define SC_CLOCK_WINDOWS 60
+
 struct sc_clock_point {
     sc_tick system;
     sc_tick stream;
@@ -14,21 +19,41 @@ struct sc_clock_point {
  * The clock aims to estimate the affine relation between the stream (device)
  * time and the system time:
  *
- *     f(stream) = slope * stream + offset
- *
- * Theoretically, the slope encodes the drift between the device clock and the
- * computer clock. It is expected to be very close to 1.
+ *     f(stream) = stream + offset + skew * (stream - ref) + jitter
  *
- * Since the clock is used to estimate very close points in the future (which
- * are reestimated on every clock update, see delay_buffer), the error caused
- * by clock drift is totally negligible, so it is better to assume that the
- * slope is 1 than to estimate it (the estimation error would be larger).
+ * The measured offsets (system - stream) include the transmission delay of
+ * each point, which only adds to the true offset. Therefore, the lower
+ * envelope of the offsets isolates the clock relation from the network jitter:
+ * the clock keeps the point having the minimum offset over each window of
+ * stream time (SC_CLOCK_WINDOW_DURATION), and estimates the skew (the drift
+ * between the device clock and the computer clock, very close to 0) by a
+ * linear regression over the last SC_CLOCK_WINDOWS minimum points. The skew is
+ * only estimated once enough windows are available, and is bounded, so that
+ * an estimation error may not be larger than the drift itself.
  *
- * Therefore, only the offset is estimated.
+ * The consumers (delay_buffer, frame_pacer) schedule the frames relative to
+ * the typical delay rather than the minimum delay, so the average residual
+ * over the last points (the jitter) is added to the estimation.
  */
 struct sc_clock {
+    // Minimum-delay points of the last complete windows (ring buffer)
+    struct sc_clock_point windows[SC_CLOCK_WINDOWS];
+    unsigned window_count;
+    unsigned window_head; // index of the next window to write
+
+    // Minimum-delay point of the current window
+    struct sc_clock_point current;
+    sc_tick current_start; // stream time
+    bool has_current;
+
+    // Estimated line over the minimum-delay points
+    sc_tick ref; // stream time
+    sc_tick offset; // at ref
+    double skew;
+
+    // Average residual (the offset above the line) over the last points
     unsigned range;
-    sc_tick offset;
+    sc_tick jitter;
 };
 
 void
@@ -40,4 +65,11 @@ sc_clock_update(struct sc_clock *clock, sc_tick system, sc_tick stream);
 sc_tick
 sc_clock_to_system_time(struct sc_clock *clock, sc_tick stream);
 
+/**
+ * Return the estimated drift of the device clock relative to the system clock,
+ * in parts per million
+ */
+double
+sc_clock_get_skew_ppm(struct sc_clock *clock);
+
 #endif
@@ -0,0 +1,77 @@
+#include "clock_sync.h"
+
+#include <assert.h>
+#include <inttypes.h>
+
+#include "util/log.h"
+
+bool
+sc_clock_sync_init(struct sc_clock_sync *sync) {
+    bool ok = sc_mutex_init(&sync->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    sync->count = 0;
+    sync->head = 0;
+
+    return true;
+}
+
+void
+sc_clock_sync_destroy(struct sc_clock_sync *sync) {
+    sc_mutex_destroy(&sync->mutex);
+}
+
+void
+sc_clock_sync_push(struct sc_clock_sync *sync, sc_tick sent, sc_tick device,
+                   sc_tick received) {
+    if (received < sent) {
+        // Should never happen with a monotonic clock
+        LOGW("Invalid clock sync exchange");
+        return;
+    }
+
+    struct sc_clock_sync_sample sample = {
+        .offset = device - (sent + received) / 2,
+        .rtt = received - sent,
+    };
+
+    sc_mutex_lock(&sync->mutex);
+
+    sync->samples[sync->head] = sample;
+    sync->head = (sync->head + 1) % SC_CLOCK_SYNC_SAMPLES;
+    if (sync->count < SC_CLOCK_SYNC_SAMPLES) {
+        ++sync->count;
+    }
+
+    // Select the exchange having the smallest round-trip time (the most recent
+    // one on equality)
+    unsigned best = (sync->head + SC_CLOCK_SYNC_SAMPLES - 1)
+                  % SC_CLOCK_SYNC_SAMPLES;
+    for (unsigned i = 0; i < sync->count; ++i) {
+        if (sync->samples[i].rtt < sync->samples[best].rtt) {
+            best = i;
+        }
+    }
+    sync->best = sync->samples[best];
+    struct sc_clock_sync_sample selected = sync->best;
+
+    sc_mutex_unlock(&sync->mutex);
+
+    LOGD("Clock sync: offset=%" PRItick "us rtt=%" PRItick "us (best: offset=%"
+         PRItick "us rtt=%" PRItick "us)", sample.offset, sample.rtt,
+         selected.offset, selected.rtt);
+}
+
+bool
+sc_clock_sync_get(struct sc_clock_sync *sync, sc_tick *offset, sc_tick *error) {
+    sc_mutex_lock(&sync->mutex);
+    bool valid = sync->count;
+    if (valid) {
+        *offset = sync->best.offset;
+        *error = sync->best.rtt / 2;
+    }
+    sc_mutex_unlock(&sync->mutex);
+    return valid;
+}
@@ -0,0 +1,72 @@
+#ifndef SC_CLOCK_SYNC_H
+#define SC_CLOCK_SYNC_H
+
+#include "common.h"
+
+#include <stdbool.h>
+
+#include "util/thread.h"
+#include "util/tick.h"
+
+// Interval between two CLOCK_PING messages
+#define SC_CLOCK_SYNC_PING_INTERVAL SC_TICK_FROM_SEC(2)
+// Number of recent exchanges to select the best one from
+#define SC_CLOCK_SYNC_SAMPLES 8
+
+struct sc_clock_sync_sample {
+    sc_tick offset; // device time - client time
+    sc_tick rtt;
+};
+
+/**
+ * Mapping between the device monotonic clock (in which the video PTS are
+ * expressed) and the client clock, measured by NTP-like ping exchanges over
+ * the control channel.
+ *
+ * The client sends its time (t0) in a CLOCK_PING message, the device replies
+ * immediately with the received t0 and its own time (t1) in a CLOCK_PONG
+ * message, and the client receives it at t2. Assuming that both directions
+ * take the same time:
+ *
+ *     offset = t1 - (t0 + t2) / 2
+ *
+ * with an error bounded by rtt / 2 (rtt = t2 - t0), whatever the asymmetry.
+ * Like NTP, the exchange having the smallest round-trip time among the recent
+ * ones is selected, since it has the tightest bound.
+ */
+struct sc_clock_sync {
+    sc_mutex mutex;
+
+    struct sc_clock_sync_sample samples[SC_CLOCK_SYNC_SAMPLES];
+    unsigned count;
+    unsigned head; // index of the next sample to write
+
+    // Best sample among the recent ones (only valid if count > 0)
+    struct sc_clock_sync_sample best;
+};
+
+bool
+sc_clock_sync_init(struct sc_clock_sync *sync);
+
+void
+sc_clock_sync_destroy(struct sc_clock_sync *sync);
+
+/**
+ * Push the result of a ping exchange
+ *
+ * `sent` and `received` are client times, `device` is the device time.
+ */
+void
+sc_clock_sync_push(struct sc_clock_sync *sync, sc_tick sent, sc_tick device,
+                   sc_tick received);
+
+/**
+ * Get the current estimation (device time = client time + offset), with its
+ * error bound
+ *
+ * Return false if no exchange has completed yet.
+ */
+bool
+sc_clock_sync_get(struct sc_clock_sync *sync, sc_tick *offset, sc_tick *error);
+
+#endif
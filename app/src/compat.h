@@ -61,6 +61,39 @@
 # define SCRCPY_LAVC_HAS_CODECPAR_CODEC_SIDEDATA
 #endif
 
+// The hardware decoding API used by scrcpy (AVCodecHWConfig,
+// avcodec_get_hw_config(), AVCodecContext.extra_hw_frames and
+// av_hwdevice_find_type_by_name()) is complete since FFmpeg 4.0.
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 18, 100) \
+        && LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(56, 14, 100)
+# define SCRCPY_LAVC_HAS_HWACCEL
+#endif
+
+// In ffmpeg/doc/APIchanges:
+// 2021-03-10 - lavu 56.69.100 - buffer.h
+//   Change some functions/fields from int to size_t.
+// (effective at the major bump, in lavu 57)
+#if LIBAVUTIL_VERSION_MAJOR >= 57
+# define SCRCPY_LAVU_HAS_BUFFER_SIZE_T
+#endif
+
+// In ffmpeg/doc/APIchanges:
+// 2021-03-10 - lavc 58.134.100 - packet.h
+//   Change av_packet_get_side_data() size parameter to size_t.
+// (effective at the major bump, in lavc 59)
+#if LIBAVCODEC_VERSION_MAJOR >= 59
+# define SCRCPY_LAVC_HAS_SIDE_DATA_SIZE_T
+#endif
+
+// In ffmpeg/doc/APIchanges:
+// lavf 60.4.100 - avio.h
+//   Add const to the buffer argument of the write_packet() callback of
+//   avio_alloc_context() (FF_API_AVIO_WRITE_NONCONST).
+// (effective at the major bump, in lavf 61)
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+# define SCRCPY_LAVF_HAS_AVIO_WRITE_CONST
+#endif
+
 #if SDL_VERSION_ATLEAST(2, 0, 6)
 // <https://github.com/libsdl-org/SDL/commit/d7a318de563125e5bb465b1000d6bc9576fbc6fc>
 # define SCRCPY_SDL_HAS_HINT_TOUCH_MOUSE_EVENTS
@@ -71,8 +104,14 @@
 # define SCRCPY_SDL_HAS_HINT_VIDEO_X11_NET_WM_BYPASS_COMPOSITOR
 #endif
 
+#if SDL_VERSION_ATLEAST(2, 0, 10)
+// Required to mix the SDL render API with direct OpenGL calls
+# define SCRCPY_SDL_HAS_RENDER_FLUSH
+#endif
+
 #if SDL_VERSION_ATLEAST(2, 0, 16)
 # define SCRCPY_SDL_HAS_THREAD_PRIORITY_TIME_CRITICAL
+# define SCRCPY_SDL_HAS_UPDATE_NV_TEXTURE
 #endif
 
 #ifndef HAVE_STRDUP
@@ -0,0 +1,25 @@
+#include "compression.h"
+
+#include <assert.h>
+#include <zlib.h>
+
+size_t
+sc_compress(const uint8_t *in, size_t len, uint8_t *out, size_t out_size) {
+    uLongf out_len = out_size;
+    // The messages are compressed on the controller thread, between input
+    // events: favor speed
+    int r = compress2(out, &out_len, in, len, Z_BEST_SPEED);
+    if (r != Z_OK) {
+        // Z_BUF_ERROR if the compressed data does not fit
+        return 0;
+    }
+
+    return out_len;
+}
+
+bool
+sc_decompress(const uint8_t *in, size_t len, uint8_t *out, size_t out_size) {
+    uLongf out_len = out_size;
+    int r = uncompress(out, &out_len, in, len);
+    return r == Z_OK && out_len == out_size;
+}
@@ -0,0 +1,35 @@
+#ifndef SC_COMPRESSION_H
+#define SC_COMPRESSION_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The smaller messages are always sent uncompressed (input events are small
+// and must not be delayed)
+#define SC_COMPRESSION_THRESHOLD 512
+
+// Header of a compressed message, which wraps a single serialized message:
+// type: 1 byte; uncompressed length: 4 bytes; length: 4 bytes
+#define SC_COMPRESSION_HEADER_SIZE 9
+
+/**
+ * Compress a serialized message (zlib format) into `out`
+ *
+ * Return the compressed size, or 0 if it would not fit in `out_size` bytes
+ * (i.e. the compression is not worth it) or on error.
+ */
+size_t
+sc_compress(const uint8_t *in, size_t len, uint8_t *out, size_t out_size);
+
+/**
+ * Decompress data compressed by sc_compress() (or by the device) into `out`
+ *
+ * Return true if the decompressed data has exactly `out_size` bytes.
+ */
+bool
+sc_decompress(const uint8_t *in, size_t len, uint8_t *out, size_t out_size);
+
+#endif
@@ -119,7 +119,25 @@ sc_control_msg_serialize(const struct sc_control_msg *msg, uint8_t *buf) {
             sc_write16be(&buf[22], pressure);
             sc_write32be(&buf[24], msg->inject_touch_event.action_button);
             sc_write32be(&buf[28], msg->inject_touch_event.buttons);
-            return 32;
+            sc_write32be(&buf[32], msg->inject_touch_event.timestamp);
+            return 36;
+        case SC_CONTROL_MSG_TYPE_INJECT_MULTI_TOUCH_EVENT: {
+            uint8_t count = msg->inject_multi_touch_event.pointer_count;
+            assert(count <= SC_CONTROL_MSG_MULTI_TOUCH_MAX_POINTERS);
+            buf[1] = count;
+            sc_write32be(&buf[2], msg->inject_multi_touch_event.timestamp);
+            size_t len = 6;
+            for (uint8_t i = 0; i < count; ++i) {
+                const struct sc_control_msg_pointer *pointer =
+                    &msg->inject_multi_touch_event.pointers[i];
+                sc_write64be(&buf[len], pointer->pointer_id);
+                write_position(&buf[len + 8], &pointer->position);
+                uint16_t pressure = sc_float_to_u16fp(pointer->pressure);
+                sc_write16be(&buf[len + 20], pressure);
+                len += 22;
+            }
+            return len;
+        }
         case SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT:
             write_position(&buf[1], &msg->inject_scroll_event.position);
             int16_t hscroll =
@@ -143,6 +161,13 @@ sc_control_msg_serialize(const struct sc_control_msg *msg, uint8_t *buf) {
                                       SC_CONTROL_MSG_CLIPBOARD_TEXT_MAX_LENGTH,
                                       &buf[10]);
             return 10 + len;
+        case SC_CONTROL_MSG_TYPE_SET_CLIPBOARD_CHUNK: {
+            size_t chunk_len =
+                write_string(msg->set_clipboard_chunk.text,
+                             SC_CONTROL_MSG_CLIPBOARD_CHUNK_MAX_LENGTH,
+                             &buf[1]);
+            return 1 + chunk_len;
+        }
         case SC_CONTROL_MSG_TYPE_SET_SCREEN_POWER_MODE:
             buf[1] = msg->set_screen_power_mode.mode;
             return 2;
@@ -157,11 +182,65 @@ sc_control_msg_serialize(const struct sc_control_msg *msg, uint8_t *buf) {
             sc_write16be(&buf[3], msg->uhid_input.size);
             memcpy(&buf[5], msg->uhid_input.data, msg->uhid_input.size);
             return 5 + msg->uhid_input.size;
+        case SC_CONTROL_MSG_TYPE_UHID_INPUT_BATCH: {
+            uint8_t count = msg->uhid_input_batch.count;
+            assert(count <= SC_CONTROL_MSG_UHID_INPUT_BATCH_MAX_REPORTS);
+            sc_write16be(&buf[1], msg->uhid_input_batch.id);
+            buf[3] = count;
+            size_t len = 4;
+            for (uint8_t i = 0; i < count; ++i) {
+                const struct sc_control_msg_uhid_report *report =
+                    &msg->uhid_input_batch.reports[i];
+                sc_write16be(&buf[len], report->size);
+                memcpy(&buf[len + 2], report->data, report->size);
+                len += 2 + report->size;
+            }
+            return len;
+        }
+        case SC_CONTROL_MSG_TYPE_VIDEO_FEEDBACK:
+            sc_write32be(&buf[1], msg->video_feedback.queuing_delay);
+            sc_write32be(&buf[5], msg->video_feedback.jitter);
+            return 9;
+        case SC_CONTROL_MSG_TYPE_SET_VIDEO_LIMITS:
+            sc_write16be(&buf[1], msg->set_video_limits.max_size);
+            sc_write16be(&buf[3], msg->set_video_limits.max_fps);
+            return 5;
+        case SC_CONTROL_MSG_TYPE_SET_CROP:
+            write_position(&buf[1], &msg->set_crop.position);
+            sc_write16be(&buf[13], msg->set_crop.size.width);
+            sc_write16be(&buf[15], msg->set_crop.size.height);
+            return 17;
+        case SC_CONTROL_MSG_TYPE_PUSH_FILE: {
+            sc_write64be(&buf[1], msg->push_file.size);
+            size_t target_len =
+                write_string(msg->push_file.target,
+                             SC_CONTROL_MSG_PUSH_FILE_PATH_MAX_LENGTH,
+                             &buf[9]);
+            size_t name_len =
+                write_string(msg->push_file.name,
+                             SC_CONTROL_MSG_PUSH_FILE_PATH_MAX_LENGTH,
+                             &buf[9 + target_len]);
+            return 9 + target_len + name_len;
+        }
+        case SC_CONTROL_MSG_TYPE_PUSH_FILE_CHUNK:
+            assert(msg->push_file_chunk.length
+                    <= SC_CONTROL_MSG_PUSH_FILE_CHUNK_MAX_LENGTH);
+            sc_write16be(&buf[1], msg->push_file_chunk.length);
+            memcpy(&buf[3], msg->push_file_chunk.data,
+                   msg->push_file_chunk.length);
+            return 3 + msg->push_file_chunk.length;
+        case SC_CONTROL_MSG_TYPE_UHID_DESTROY:
+            sc_write16be(&buf[1], msg->uhid_destroy.id);
+            return 3;
+        case SC_CONTROL_MSG_TYPE_CLOCK_PING:
+            sc_write64be(&buf[1], msg->clock_ping.client_time);
+            return 9;
         case SC_CONTROL_MSG_TYPE_EXPAND_NOTIFICATION_PANEL:
         case SC_CONTROL_MSG_TYPE_EXPAND_SETTINGS_PANEL:
         case SC_CONTROL_MSG_TYPE_COLLAPSE_PANELS:
         case SC_CONTROL_MSG_TYPE_ROTATE_DEVICE:
         case SC_CONTROL_MSG_TYPE_OPEN_HARD_KEYBOARD_SETTINGS:
+        case SC_CONTROL_MSG_TYPE_REQUEST_KEYFRAME:
             // no additional data
             return 1;
         default:
@@ -170,6 +249,159 @@ sc_control_msg_serialize(const struct sc_control_msg *msg, uint8_t *buf) {
     }
 }
 
+static void
+read_position(const uint8_t *buf, struct sc_position *position) {
+    position->point.x = (int32_t) sc_read32be(&buf[0]);
+    position->point.y = (int32_t) sc_read32be(&buf[4]);
+    position->screen_size.width = sc_read16be(&buf[8]);
+    position->screen_size.height = sc_read16be(&buf[10]);
+}
+
+ssize_t
+sc_control_msg_deserialize(const uint8_t *buf, size_t len,
+                           struct sc_control_msg *msg) {
+    if (!len) {
+        return 0; // no message
+    }
+
+    msg->type = buf[0];
+    switch (msg->type) {
+        case SC_CONTROL_MSG_TYPE_INJECT_KEYCODE:
+            if (len < 14) {
+                return 0; // no complete message
+            }
+            msg->inject_keycode.action = buf[1];
+            msg->inject_keycode.keycode = sc_read32be(&buf[2]);
+            msg->inject_keycode.repeat = sc_read32be(&buf[6]);
+            msg->inject_keycode.metastate = sc_read32be(&buf[10]);
+            return 14;
+        case SC_CONTROL_MSG_TYPE_INJECT_TEXT: {
+            if (len < 5) {
+                return 0; // no complete message
+            }
+            size_t text_len = sc_read32be(&buf[1]);
+            if (text_len > SC_CONTROL_MSG_INJECT_TEXT_MAX_LENGTH) {
+                LOGW("Text too long: %" SC_PRIsizet, text_len);
+                return -1;
+            }
+            if (len < 5 + text_len) {
+                return 0; // no complete message
+            }
+            char *text = malloc(text_len + 1);
+            if (!text) {
+                LOG_OOM();
+                return -1;
+            }
+            memcpy(text, &buf[5], text_len);
+            text[text_len] = '\0';
+            msg->inject_text.text = text;
+            return 5 + text_len;
+        }
+        case SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT:
+            if (len < 36) {
+                return 0; // no complete message
+            }
+            msg->inject_touch_event.action = buf[1];
+            msg->inject_touch_event.pointer_id = sc_read64be(&buf[2]);
+            read_position(&buf[10], &msg->inject_touch_event.position);
+            msg->inject_touch_event.pressure =
+                sc_u16fp_to_float(sc_read16be(&buf[22]));
+            msg->inject_touch_event.action_button = sc_read32be(&buf[24]);
+            msg->inject_touch_event.buttons = sc_read32be(&buf[28]);
+            msg->inject_touch_event.timestamp = sc_read32be(&buf[32]);
+            return 36;
+        case SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT:
+            if (len < 21) {
+                return 0; // no complete message
+            }
+            read_position(&buf[1], &msg->inject_scroll_event.position);
+            msg->inject_scroll_event.hscroll =
+                sc_i16fp_to_float((int16_t) sc_read16be(&buf[13]));
+            msg->inject_scroll_event.vscroll =
+                sc_i16fp_to_float((int16_t) sc_read16be(&buf[15]));
+            msg->inject_scroll_event.buttons = sc_read32be(&buf[17]);
+            return 21;
+        case SC_CONTROL_MSG_TYPE_INJECT_MULTI_TOUCH_EVENT: {
+            if (len < 6) {
+                return 0; // no complete message
+            }
+            uint8_t count = buf[1];
+            if (count > SC_CONTROL_MSG_MULTI_TOUCH_MAX_POINTERS) {
+                LOGW("Too many pointers: %u", (unsigned) count);
+                return -1;
+            }
+            size_t size = 6 + (size_t) count * 22;
+            if (len < size) {
+                return 0; // no complete message
+            }
+            msg->inject_multi_touch_event.pointer_count = count;
+            msg->inject_multi_touch_event.timestamp = sc_read32be(&buf[2]);
+            for (uint8_t i = 0; i < count; ++i) {
+                const uint8_t *p = &buf[6 + i * 22];
+                struct sc_control_msg_pointer *pointer =
+                    &msg->inject_multi_touch_event.pointers[i];
+                pointer->pointer_id = sc_read64be(p);
+                read_position(&p[8], &pointer->position);
+                pointer->pressure = sc_u16fp_to_float(sc_read16be(&p[20]));
+            }
+            return size;
+        }
+        case SC_CONTROL_MSG_TYPE_BACK_OR_SCREEN_ON:
+            if (len < 2) {
+                return 0; // no complete message
+            }
+            msg->back_or_screen_on.action = buf[1];
+            return 2;
+        case SC_CONTROL_MSG_TYPE_GET_CLIPBOARD:
+            if (len < 2) {
+                return 0; // no complete message
+            }
+            msg->get_clipboard.copy_key = buf[1];
+            return 2;
+        case SC_CONTROL_MSG_TYPE_SET_CLIPBOARD: {
+            if (len < 14) {
+                return 0; // no complete message
+            }
+            size_t text_len = sc_read32be(&buf[10]);
+            if (text_len > SC_CONTROL_MSG_CLIPBOARD_TEXT_MAX_LENGTH) {
+                LOGW("Clipboard text too long: %" SC_PRIsizet, text_len);
+                return -1;
+            }
+            if (len < 14 + text_len) {
+                return 0; // no complete message
+            }
+            char *text = malloc(text_len + 1);
+            if (!text) {
+                LOG_OOM();
+                return -1;
+            }
+            memcpy(text, &buf[14], text_len);
+            text[text_len] = '\0';
+            msg->set_clipboard.sequence = sc_read64be(&buf[1]);
+            msg->set_clipboard.paste = !!buf[9];
+            msg->set_clipboard.text = text;
+            return 14 + text_len;
+        }
+        case SC_CONTROL_MSG_TYPE_SET_SCREEN_POWER_MODE:
+            if (len < 2) {
+                return 0; // no complete message
+            }
+            msg->set_screen_power_mode.mode = buf[1];
+            return 2;
+        case SC_CONTROL_MSG_TYPE_EXPAND_NOTIFICATION_PANEL:
+        case SC_CONTROL_MSG_TYPE_EXPAND_SETTINGS_PANEL:
+        case SC_CONTROL_MSG_TYPE_COLLAPSE_PANELS:
+        case SC_CONTROL_MSG_TYPE_ROTATE_DEVICE:
+        case SC_CONTROL_MSG_TYPE_OPEN_HARD_KEYBOARD_SETTINGS:
+        case SC_CONTROL_MSG_TYPE_REQUEST_KEYFRAME:
+            // no additional data
+            return 1;
+        default:
+            LOGW("Unsupported message type: %u", (unsigned) msg->type);
+            return -1;
+    }
+}
+
 void
 sc_control_msg_log(const struct sc_control_msg *msg) {
 #define LOG_CMSG(fmt, ...) LOGV("input: " fmt, ## __VA_ARGS__)
@@ -238,6 +470,9 @@ sc_control_msg_log(const struct sc_control_msg *msg) {
                      msg->set_clipboard.paste ? "paste" : "nopaste",
                      msg->set_clipboard.text);
             break;
+        case SC_CONTROL_MSG_TYPE_SET_CLIPBOARD_CHUNK:
+            LOG_CMSG("clipboard chunk");
+            break;
         case SC_CONTROL_MSG_TYPE_SET_SCREEN_POWER_MODE:
             LOG_CMSG("power mode %s",
                      SCREEN_POWER_MODE_LABEL(msg->set_screen_power_mode.mode));
@@ -271,9 +506,52 @@ sc_control_msg_log(const struct sc_control_msg *msg) {
             }
             break;
         }
+        case SC_CONTROL_MSG_TYPE_UHID_INPUT_BATCH:
+            LOG_CMSG("UHID input batch [%" PRIu16 "] count=%u",
+                     msg->uhid_input_batch.id,
+                     (unsigned) msg->uhid_input_batch.count);
+            break;
         case SC_CONTROL_MSG_TYPE_OPEN_HARD_KEYBOARD_SETTINGS:
             LOG_CMSG("open hard keyboard settings");
             break;
+        case SC_CONTROL_MSG_TYPE_VIDEO_FEEDBACK:
+            LOG_CMSG("video feedback queuing_delay=%" PRIu32 "us jitter=%"
+                     PRIu32 "us", msg->video_feedback.queuing_delay,
+                     msg->video_feedback.jitter);
+            break;
+        case SC_CONTROL_MSG_TYPE_REQUEST_KEYFRAME:
+            LOG_CMSG("request keyframe");
+            break;
+        case SC_CONTROL_MSG_TYPE_INJECT_MULTI_TOUCH_EVENT:
+            LOG_CMSG("multi-touch move pointers=%u",
+                     (unsigned) msg->inject_multi_touch_event.pointer_count);
+            break;
+        case SC_CONTROL_MSG_TYPE_SET_VIDEO_LIMITS:
+            LOG_CMSG("set video limits max_size=%" PRIu16 " max_fps=%" PRIu16,
+                     msg->set_video_limits.max_size,
+                     msg->set_video_limits.max_fps);
+            break;
+        case SC_CONTROL_MSG_TYPE_SET_CROP:
+            LOG_CMSG("set crop %" PRIu16 "x%" PRIu16 " at %" PRIi32 ",%" PRIi32,
+                     msg->set_crop.size.width, msg->set_crop.size.height,
+                     msg->set_crop.position.point.x,
+                     msg->set_crop.position.point.y);
+            break;
+        case SC_CONTROL_MSG_TYPE_PUSH_FILE:
+            LOG_CMSG("push file \"%s\" (%" PRIu64_ " bytes) to %s",
+                     msg->push_file.name, msg->push_file.size,
+                     msg->push_file.target);
+            break;
+        case SC_CONTROL_MSG_TYPE_PUSH_FILE_CHUNK:
+            LOG_CMSG("push file chunk length=%" PRIu16,
+                     msg->push_file_chunk.length);
+            break;
+        case SC_CONTROL_MSG_TYPE_UHID_DESTROY:
+            LOG_CMSG("UHID destroy [%" PRIu16 "]", msg->uhid_destroy.id);
+            break;
+        case SC_CONTROL_MSG_TYPE_CLOCK_PING:
+            LOG_CMSG("clock ping time=%" PRIu64, msg->clock_ping.client_time);
+            break;
         default:
             LOG_CMSG("unknown type: %u", (unsigned) msg->type);
             break;
@@ -289,6 +567,11 @@ sc_control_msg_destroy(struct sc_control_msg *msg) {
         case SC_CONTROL_MSG_TYPE_SET_CLIPBOARD:
             free(msg->set_clipboard.text);
             break;
+        case SC_CONTROL_MSG_TYPE_PUSH_FILE:
+            free(msg->push_file.target);
+            free(msg->push_file.name);
+            free(msg->push_file.local);
+            break;
         default:
             // do nothing
             break;
@@ -6,6 +6,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <unistd.h>
 
 #include "android/input.h"
 #include "android/keycodes.h"
@@ -14,9 +15,20 @@
 
 #define SC_CONTROL_MSG_MAX_SIZE (1 << 18) // 256k
 
-#define SC_CONTROL_MSG_INJECT_TEXT_MAX_LENGTH 300
+#define SC_CONTROL_MSG_INJECT_TEXT_MAX_LENGTH 4096
 // type: 1 byte; sequence: 8 bytes; paste flag: 1 byte; length: 4 bytes
 #define SC_CONTROL_MSG_CLIPBOARD_TEXT_MAX_LENGTH (SC_CONTROL_MSG_MAX_SIZE - 14)
+// A larger clipboard text is sent in several chunks, so that the input events
+// are not delayed by the whole transfer
+#define SC_CONTROL_MSG_CLIPBOARD_CHUNK_MAX_LENGTH (1 << 14) // 16k
+#define SC_CONTROL_MSG_PUSH_FILE_PATH_MAX_LENGTH 4096
+// A file is sent in chunks, interleaved with the input events
+#define SC_CONTROL_MSG_PUSH_FILE_CHUNK_MAX_LENGTH (1 << 14) // 16k
+
+// Must not exceed PointersState.MAX_POINTERS on the device
+#define SC_CONTROL_MSG_MULTI_TOUCH_MAX_POINTERS 10
+
+#define SC_CONTROL_MSG_UHID_INPUT_BATCH_MAX_REPORTS 16
 
 #define POINTER_ID_MOUSE UINT64_C(-1)
 #define POINTER_ID_GENERIC_FINGER UINT64_C(-2)
@@ -41,6 +53,20 @@ enum sc_control_msg_type {
     SC_CONTROL_MSG_TYPE_UHID_CREATE,
     SC_CONTROL_MSG_TYPE_UHID_INPUT,
     SC_CONTROL_MSG_TYPE_OPEN_HARD_KEYBOARD_SETTINGS,
+    SC_CONTROL_MSG_TYPE_VIDEO_FEEDBACK,
+    SC_CONTROL_MSG_TYPE_REQUEST_KEYFRAME,
+    SC_CONTROL_MSG_TYPE_SET_VIDEO_LIMITS,
+    SC_CONTROL_MSG_TYPE_INJECT_MULTI_TOUCH_EVENT,
+    SC_CONTROL_MSG_TYPE_SET_CLIPBOARD_CHUNK,
+    SC_CONTROL_MSG_TYPE_SET_CROP,
+    SC_CONTROL_MSG_TYPE_PUSH_FILE,
+    SC_CONTROL_MSG_TYPE_PUSH_FILE_CHUNK,
+    SC_CONTROL_MSG_TYPE_UHID_DESTROY,
+    // Not a message: wraps a large serialized message (only written by the
+    // controller, if compression is enabled)
+    SC_CONTROL_MSG_TYPE_COMPRESSED,
+    SC_CONTROL_MSG_TYPE_CLOCK_PING,
+    SC_CONTROL_MSG_TYPE_UHID_INPUT_BATCH,
 };
 
 enum sc_screen_power_mode {
@@ -55,6 +81,12 @@ enum sc_copy_key {
     SC_COPY_KEY_CUT,
 };
 
+struct sc_control_msg_pointer {
+    uint64_t pointer_id;
+    struct sc_position position;
+    float pressure;
+};
+
 struct sc_control_msg {
     enum sc_control_msg_type type;
     union {
@@ -74,7 +106,18 @@ struct sc_control_msg {
             uint64_t pointer_id;
             struct sc_position position;
             float pressure;
+            // client event time in milliseconds (0 if unknown), to preserve
+            // the timing of the gestures regardless of the transport latency
+            uint32_t timestamp;
         } inject_touch_event;
+        struct {
+            // The positions of several touch pointers moved at the same time,
+            // injected as a single ACTION_MOVE event
+            uint8_t pointer_count;
+            uint32_t timestamp; // same as inject_touch_event.timestamp
+            struct sc_control_msg_pointer
+                pointers[SC_CONTROL_MSG_MULTI_TOUCH_MAX_POINTERS];
+        } inject_multi_touch_event;
         struct {
             struct sc_position position;
             float hscroll;
@@ -93,6 +136,11 @@ struct sc_control_msg {
             char *text; // owned, to be freed by free()
             bool paste;
         } set_clipboard;
+        struct {
+            // The beginning of a clipboard text, the device appends it to the
+            // text of the next SET_CLIPBOARD message
+            char *text; // not owned (points into a set_clipboard text)
+        } set_clipboard_chunk;
         struct {
             enum sc_screen_power_mode mode;
         } set_screen_power_mode;
@@ -106,6 +154,55 @@ struct sc_control_msg {
             uint16_t size;
             uint8_t data[SC_HID_MAX_SIZE];
         } uhid_input;
+        struct {
+            // Several input reports of the same device, in order, written to
+            // the device at once
+            uint16_t id;
+            uint8_t count;
+            struct sc_control_msg_uhid_report {
+                uint16_t size;
+                uint8_t data[SC_HID_MAX_SIZE];
+            } reports[SC_CONTROL_MSG_UHID_INPUT_BATCH_MAX_REPORTS];
+        } uhid_input_batch;
+        struct {
+            uint16_t id;
+        } uhid_destroy;
+        struct {
+            // estimated queuing delay of the video stream, in microseconds
+            uint32_t queuing_delay;
+            // inter-arrival jitter of the video packets, in microseconds
+            uint32_t jitter;
+        } video_feedback;
+        struct {
+            uint16_t max_size; // 0 for no limit
+            uint16_t max_fps; // 0 for no limit
+        } set_video_limits;
+        struct {
+            // top-left corner of the region, relative to the current frame
+            struct sc_position position;
+            // an empty size restores the initial crop
+            struct sc_size size;
+        } set_crop;
+        struct {
+            // The device writes the file to the target, or into the target
+            // directory (if it ends with '/' or is a directory)
+            char *target; // owned, to be freed by free()
+            char *name; // owned, to be freed by free()
+            uint64_t size;
+            // Not serialized: the file to read the content from
+            char *local; // owned, to be freed by free()
+        } push_file;
+        struct {
+            // The next bytes of the file announced by the last PUSH_FILE
+            // message, an empty chunk aborts the transfer
+            const uint8_t *data; // not owned
+            uint16_t length;
+        } push_file_chunk;
+        struct {
+            // client time when the ping is sent, in microseconds, echoed by
+            // the device with its own clock (see sc_clock_sync)
+            uint64_t client_time;
+        } clock_ping;
     };
 };
 
@@ -114,6 +211,17 @@ struct sc_control_msg {
 size_t
 sc_control_msg_serialize(const struct sc_control_msg *msg, uint8_t *buf);
 
+// Deserialize a message serialized by sc_control_msg_serialize(), to replay
+// recorded input events or to receive messages from the control server (only
+// the input events and the device commands are supported, not the messages
+// generated by scrcpy itself: UHID, clipboard chunks, file push, video
+// feedback, limits and crop)
+//
+// return the number of bytes consumed (0 for no complete msg, -1 on error)
+ssize_t
+sc_control_msg_deserialize(const uint8_t *buf, size_t len,
+                           struct sc_control_msg *msg);
+
 void
 sc_control_msg_log(const struct sc_control_msg *msg);
 
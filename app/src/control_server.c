@@ -0,0 +1,215 @@
+#include "control_server.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "control_msg.h"
+#include "controller.h"
+#include "util/acksync.h"
+#include "util/log.h"
+#include "util/net_intr.h"
+
+bool
+sc_control_server_init(struct sc_control_server *server, uint16_t port,
+                       struct sc_controller *controller) {
+    // A buffer large enough for any message (e.g. a long clipboard text)
+    server->buf = malloc(SC_CONTROL_MSG_MAX_SIZE);
+    if (!server->buf) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = sc_intr_init(&server->intr);
+    if (!ok) {
+        free(server->buf);
+        return false;
+    }
+
+    ok = sc_mutex_init(&server->mutex);
+    if (!ok) {
+        sc_intr_destroy(&server->intr);
+        free(server->buf);
+        return false;
+    }
+
+    server->controller = controller;
+    server->port = port;
+    server->server_socket = SC_SOCKET_NONE;
+    server->client = SC_SOCKET_NONE;
+
+    return true;
+}
+
+void
+sc_control_server_destroy(struct sc_control_server *server) {
+    if (server->server_socket != SC_SOCKET_NONE) {
+        net_close(server->server_socket);
+    }
+    sc_mutex_destroy(&server->mutex);
+    sc_intr_destroy(&server->intr);
+    free(server->buf);
+}
+
+// Return the number of bytes consumed, or -1 on invalid message
+static ssize_t
+sc_control_server_process(struct sc_control_server *server, size_t len,
+                          unsigned *count) {
+    size_t head = 0;
+    while (head < len) {
+        struct sc_control_msg msg;
+        ssize_t r = sc_control_msg_deserialize(&server->buf[head], len - head,
+                                               &msg);
+        if (r == -1) {
+            return -1;
+        }
+        if (!r) {
+            // Incomplete message
+            break;
+        }
+
+        head += r;
+
+        if (msg.type == SC_CONTROL_MSG_TYPE_SET_CLIPBOARD) {
+            // The acknowledgements are only expected by the window
+            msg.set_clipboard.sequence = SC_SEQUENCE_INVALID;
+        }
+
+        if (!sc_controller_push_msg(server->controller, &msg)) {
+            sc_control_msg_destroy(&msg);
+            LOGW("Control server: could not push message");
+            continue;
+        }
+
+        ++*count;
+    }
+
+    return head;
+}
+
+static void
+sc_control_server_serve(struct sc_control_server *server, sc_socket client) {
+    unsigned count = 0;
+    size_t len = 0;
+
+    for (;;) {
+        assert(len < SC_CONTROL_MSG_MAX_SIZE);
+        ssize_t r = net_recv_intr(&server->intr, client, &server->buf[len],
+                                  SC_CONTROL_MSG_MAX_SIZE - len);
+        if (r <= 0) {
+            // Disconnected or interrupted
+            break;
+        }
+
+        len += r;
+
+        // Forward all the complete messages received at once (the controller
+        // sends them to the device together)
+        ssize_t consumed = sc_control_server_process(server, len, &count);
+        if (consumed == -1) {
+            LOGE("Control server: invalid message, client disconnected");
+            break;
+        }
+
+        // Keep the beginning of the next message
+        len -= consumed;
+        memmove(server->buf, &server->buf[consumed], len);
+    }
+
+    LOGI("Control client disconnected (%u messages)", count);
+}
+
+static int
+run_control_server(void *data) {
+    struct sc_control_server *server = data;
+
+    for (;;) {
+        sc_socket client = net_accept_intr(&server->intr,
+                                           server->server_socket);
+        if (client == SC_SOCKET_NONE) {
+            // Interrupted (or error)
+            break;
+        }
+
+        LOGI("Control client connected");
+        sc_mutex_lock(&server->mutex);
+        server->client = client;
+        sc_mutex_unlock(&server->mutex);
+
+        sc_control_server_serve(server, client);
+
+        // Unblock any event being sent before closing the socket
+        net_interrupt(client);
+        sc_mutex_lock(&server->mutex);
+        server->client = SC_SOCKET_NONE;
+        sc_mutex_unlock(&server->mutex);
+        net_close(client);
+    }
+
+    LOGD("Control server thread ended");
+
+    return 0;
+}
+
+bool
+sc_control_server_start(struct sc_control_server *server) {
+#ifndef _WIN32
+    // A client may disconnect while an event is written to its socket
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    server->server_socket = net_socket();
+    if (server->server_socket == SC_SOCKET_NONE) {
+        LOGE("Could not create control server socket");
+        return false;
+    }
+
+    bool ok = net_listen(server->server_socket, IPV4_LOCALHOST, server->port,
+                         1);
+    if (!ok) {
+        LOGE("Could not listen on port %" PRIu16 " for control",
+             server->port);
+        goto error_close_socket;
+    }
+
+    LOGD("Starting control server thread");
+    ok = sc_thread_create(&server->thread, run_control_server,
+                          "scrcpy-ctl-srv", server);
+    if (!ok) {
+        LOGE("Could not start control server thread");
+        goto error_close_socket;
+    }
+
+    LOGI("Control server listening on localhost:%" PRIu16, server->port);
+
+    return true;
+
+error_close_socket:
+    net_close(server->server_socket);
+    server->server_socket = SC_SOCKET_NONE;
+    return false;
+}
+
+void
+sc_control_server_stop(struct sc_control_server *server) {
+    sc_intr_interrupt(&server->intr);
+}
+
+void
+sc_control_server_join(struct sc_control_server *server) {
+    sc_thread_join(&server->thread, NULL);
+}
+
+void
+sc_control_server_send_event(struct sc_control_server *server,
+                             const char *event) {
+    sc_mutex_lock(&server->mutex);
+    if (server->client != SC_SOCKET_NONE) {
+        size_t len = strlen(event);
+        // On error, the client is disconnected by the server thread
+        net_send_all(server->client, event, len);
+    }
+    sc_mutex_unlock(&server->mutex);
+}
@@ -0,0 +1,69 @@
+#ifndef SC_CONTROL_SERVER_H
+#define SC_CONTROL_SERVER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util/intr.h"
+#include "util/net.h"
+#include "util/thread.h"
+
+struct sc_controller;
+
+/**
+ * Local TCP server receiving control messages from automation scripts
+ *
+ * The messages are serialized exactly as they are sent to the device (see
+ * sc_control_msg_deserialize() for the supported types), and are pushed
+ * directly to the controller: several messages may be sent at once (in a
+ * single write), they are forwarded together.
+ *
+ * The server only listens on localhost, and serves one client at a time.
+ *
+ * Events (text lines) may be sent to the connected client, for example to
+ * report that the screen is stable.
+ */
+struct sc_control_server {
+    struct sc_controller *controller;
+    uint16_t port;
+
+    sc_socket server_socket;
+    struct sc_intr intr;
+    sc_thread thread;
+
+    sc_mutex mutex;
+    sc_socket client; // SC_SOCKET_NONE if no client is connected
+
+    uint8_t *buf; // SC_CONTROL_MSG_MAX_SIZE bytes
+};
+
+bool
+sc_control_server_init(struct sc_control_server *server, uint16_t port,
+                       struct sc_controller *controller);
+
+void
+sc_control_server_destroy(struct sc_control_server *server);
+
+bool
+sc_control_server_start(struct sc_control_server *server);
+
+void
+sc_control_server_stop(struct sc_control_server *server);
+
+void
+sc_control_server_join(struct sc_control_server *server);
+
+/**
+ * Send an event line (including the final '\n') to the connected client, if
+ * any
+ *
+ * It may be called from any thread. It blocks while the client does not read
+ * the events.
+ */
+void
+sc_control_server_send_event(struct sc_control_server *server,
+                             const char *event);
+
+#endif
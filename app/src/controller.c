@@ -1,43 +1,81 @@
 #include "controller.h"
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
+#ifdef HAVE_CONTROL_COMPRESSION
+# include "compression.h"
+#endif
+#include "util/binary.h"
 #include "util/log.h"
+#include "util/str.h"
+#include "util/trace.h"
 
-#define SC_CONTROL_MSG_QUEUE_MAX 64
+// The serialized messages are sent once they exceed this size (or once all the
+// queued messages are serialized)
+#define SC_CONTROLLER_BATCH_SIZE 4096
+#define SC_CONTROLLER_BUFFER_SIZE \
+    (SC_CONTROLLER_BATCH_SIZE + SC_CONTROL_MSG_MAX_SIZE)
 
 bool
-sc_controller_init(struct sc_controller *controller, sc_socket control_socket) {
-    sc_vecdeque_init(&controller->queue);
+sc_controller_init(struct sc_controller *controller, sc_socket control_socket,
+                   struct sc_stats *stats,
+                   const struct sc_controller_callbacks *cbs,
+                   void *cbs_userdata) {
+    // The queue is stored inline up to SC_CONTROL_MSG_QUEUE_MAX messages, it
+    // never allocates in the common case
+    sc_vecdeque_init_inline(&controller->queue);
 
-    bool ok = sc_vecdeque_reserve(&controller->queue, SC_CONTROL_MSG_QUEUE_MAX);
+    bool ok = sc_receiver_init(&controller->receiver, control_socket, stats);
     if (!ok) {
+        sc_vecdeque_destroy(&controller->queue);
         return false;
     }
 
-    ok = sc_receiver_init(&controller->receiver, control_socket);
+    ok = sc_mutex_init(&controller->mutex);
     if (!ok) {
+        sc_receiver_destroy(&controller->receiver);
         sc_vecdeque_destroy(&controller->queue);
         return false;
     }
 
-    ok = sc_mutex_init(&controller->mutex);
+    ok = sc_cond_init(&controller->msg_cond);
     if (!ok) {
         sc_receiver_destroy(&controller->receiver);
+        sc_mutex_destroy(&controller->mutex);
         sc_vecdeque_destroy(&controller->queue);
         return false;
     }
 
-    ok = sc_cond_init(&controller->msg_cond);
-    if (!ok) {
+    controller->buffer = malloc(SC_CONTROLLER_BUFFER_SIZE);
+    if (!controller->buffer) {
+        LOG_OOM();
+        sc_cond_destroy(&controller->msg_cond);
         sc_receiver_destroy(&controller->receiver);
         sc_mutex_destroy(&controller->mutex);
         sc_vecdeque_destroy(&controller->queue);
         return false;
     }
 
+    // Control messages are small, and must be sent without delay
+    if (!net_set_tcp_nodelay(control_socket, true)) {
+        LOGW("Could not set TCP_NODELAY on the control socket");
+        // not fatal
+    }
+
+    controller->compression_buffer = NULL;
     controller->control_socket = control_socket;
     controller->stopped = false;
+    controller->stats = stats;
+    controller->input_recorder = NULL;
+    controller->clock_sync = NULL;
+    controller->wake_sockets[0] = SC_SOCKET_NONE;
+    controller->wake_sockets[1] = SC_SOCKET_NONE;
+    controller->clipboard_transfer_pending = false;
+    controller->file_transfer_pending = false;
+    controller->cbs = cbs;
+    controller->cbs_userdata = cbs_userdata;
 
     return true;
 }
@@ -45,9 +83,11 @@ sc_controller_init(struct sc_controller *controller, sc_socket control_socket) {
 void
 sc_controller_configure(struct sc_controller *controller,
                         struct sc_acksync *acksync,
-                        struct sc_uhid_devices *uhid_devices) {
+                        struct sc_uhid_devices *uhid_devices,
+                        struct sc_input_recorder *input_recorder) {
     controller->receiver.acksync = acksync;
     controller->receiver.uhid_devices = uhid_devices;
+    controller->input_recorder = input_recorder;
 }
 
 void
@@ -62,9 +102,183 @@ sc_controller_destroy(struct sc_controller *controller) {
     }
     sc_vecdeque_destroy(&controller->queue);
 
+    if (controller->clipboard_transfer_pending) {
+        sc_control_msg_destroy(&controller->clipboard_transfer);
+    }
+
+    if (controller->file_transfer_pending) {
+        if (controller->file_transfer_file) {
+            fclose(controller->file_transfer_file);
+        }
+        sc_control_msg_destroy(&controller->file_transfer);
+    }
+
+    if (controller->wake_sockets[0] != SC_SOCKET_NONE) {
+        net_close(controller->wake_sockets[0]);
+        net_close(controller->wake_sockets[1]);
+    }
+
+    free(controller->compression_buffer);
+    free(controller->buffer);
     sc_receiver_destroy(&controller->receiver);
 }
 
+#ifdef HAVE_CONTROL_COMPRESSION
+bool
+sc_controller_enable_compression(struct sc_controller *controller) {
+    assert(!controller->compression_buffer);
+    controller->compression_buffer = malloc(SC_CONTROL_MSG_MAX_SIZE);
+    if (!controller->compression_buffer) {
+        LOG_OOM();
+        return false;
+    }
+
+    return true;
+}
+#endif
+
+void
+sc_controller_enable_clock_sync(struct sc_controller *controller,
+                                struct sc_clock_sync *clock_sync) {
+    controller->clock_sync = clock_sync;
+    controller->receiver.clock_sync = clock_sync;
+    // The first ping is sent immediately
+    controller->next_clock_ping = 0;
+}
+
+bool
+sc_controller_enable_io_loop(struct sc_controller *controller) {
+    assert(controller->wake_sockets[0] == SC_SOCKET_NONE);
+    if (!net_socketpair(controller->wake_sockets)) {
+        LOGE("Could not create controller wake-up sockets");
+        return false;
+    }
+
+    return true;
+}
+
+static inline bool
+is_io_loop(struct sc_controller *controller) {
+    return controller->wake_sockets[0] != SC_SOCKET_NONE;
+}
+
+// Wake up the controller thread waiting in the I/O loop
+static void
+wake_io_loop(struct sc_controller *controller) {
+    char byte = 0;
+    if (net_send(controller->wake_sockets[1], &byte, 1) != 1) {
+        LOGW("Could not wake up controller");
+    }
+}
+
+static bool
+is_touch_move(const struct sc_control_msg *msg) {
+    return msg->type == SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT
+        && msg->inject_touch_event.action == AMOTION_EVENT_ACTION_MOVE;
+}
+
+// Only the intermediate positions of a motion may be lost: a DOWN, UP or any
+// other message must always be delivered
+static bool
+is_droppable(const struct sc_control_msg *msg) {
+    return is_touch_move(msg)
+        || msg->type == SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT;
+}
+
+// must be called with mutex locked
+static bool
+coalesce_touch_move(struct sc_controller *controller,
+                    const struct sc_control_msg *msg) {
+    assert(is_touch_move(msg));
+
+    // Search the last queued MOVE of the same pointer. Only other MOVE events
+    // may be skipped, so that the move is never reordered with respect to any
+    // DOWN or UP event (of any pointer) or any other message.
+    size_t i = controller->queue.size;
+    while (i) {
+        struct sc_control_msg *queued =
+            sc_vecdeque_get(&controller->queue, --i);
+        if (!is_touch_move(queued)) {
+            return false;
+        }
+
+        if (queued->inject_touch_event.pointer_id
+                == msg->inject_touch_event.pointer_id) {
+            if (queued->inject_touch_event.buttons
+                    != msg->inject_touch_event.buttons) {
+                return false;
+            }
+
+            // Only the most recent position matters
+            queued->inject_touch_event.position =
+                msg->inject_touch_event.position;
+            queued->inject_touch_event.pressure =
+                msg->inject_touch_event.pressure;
+            queued->inject_touch_event.timestamp =
+                msg->inject_touch_event.timestamp;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool
+position_equals(const struct sc_position *a, const struct sc_position *b) {
+    return a->point.x == b->point.x && a->point.y == b->point.y
+        && a->screen_size.width == b->screen_size.width
+        && a->screen_size.height == b->screen_size.height;
+}
+
+// must be called with mutex locked
+static bool
+coalesce_scroll(struct sc_controller *controller,
+                const struct sc_control_msg *msg) {
+    assert(msg->type == SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT);
+
+    if (sc_vecdeque_is_empty(&controller->queue)) {
+        return false;
+    }
+
+    struct sc_control_msg *last =
+        sc_vecdeque_get(&controller->queue, controller->queue.size - 1);
+    if (last->type != SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT
+            || last->inject_scroll_event.buttons
+                != msg->inject_scroll_event.buttons
+            || !position_equals(&last->inject_scroll_event.position,
+                                &msg->inject_scroll_event.position)) {
+        return false;
+    }
+
+    float hscroll = last->inject_scroll_event.hscroll
+                  + msg->inject_scroll_event.hscroll;
+    float vscroll = last->inject_scroll_event.vscroll
+                  + msg->inject_scroll_event.vscroll;
+    if (hscroll < -1.0f || hscroll > 1.0f
+            || vscroll < -1.0f || vscroll > 1.0f) {
+        // The accumulated scroll could not be serialized
+        return false;
+    }
+
+    last->inject_scroll_event.hscroll = hscroll;
+    last->inject_scroll_event.vscroll = vscroll;
+    return true;
+}
+
+// must be called with mutex locked
+static bool
+coalesce(struct sc_controller *controller, const struct sc_control_msg *msg) {
+    if (is_touch_move(msg)) {
+        return coalesce_touch_move(controller, msg);
+    }
+
+    if (msg->type == SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT) {
+        return coalesce_scroll(controller, msg);
+    }
+
+    return false;
+}
+
 bool
 sc_controller_push_msg(struct sc_controller *controller,
                        const struct sc_control_msg *msg) {
@@ -72,61 +286,616 @@ sc_controller_push_msg(struct sc_controller *controller,
         sc_control_msg_log(msg);
     }
 
+    // Once the message is pushed, it is owned by the controller thread, so the
+    // text must be hashed before
+    bool set_clipboard = msg->type == SC_CONTROL_MSG_TYPE_SET_CLIPBOARD;
+    uint64_t clipboard_hash =
+        set_clipboard ? sc_str_hash(msg->set_clipboard.text) : 0;
+
     sc_mutex_lock(&controller->mutex);
-    bool full = sc_vecdeque_is_full(&controller->queue);
-    if (!full) {
-        bool was_empty = sc_vecdeque_is_empty(&controller->queue);
+
+    if (controller->input_recorder) {
+        // Record all the messages, even those coalesced or dropped
+        sc_input_recorder_record(controller->input_recorder, msg);
+    }
+
+    if (coalesce(controller, msg)) {
+        // Merged into a message not sent yet
+        sc_stats_add(controller->stats, SC_STAT_CONTROL_MSGS_COALESCED, 1);
+        sc_mutex_unlock(&controller->mutex);
+        return true;
+    }
+
+    bool was_empty = sc_vecdeque_is_empty(&controller->queue);
+    bool ok;
+    if (controller->queue.size < SC_CONTROL_MSG_QUEUE_MAX) {
         sc_vecdeque_push_noresize(&controller->queue, *msg);
+        ok = true;
+    } else if (is_droppable(msg)) {
+        // The queue is full, the msg is discarded
+        ok = false;
+    } else {
+        // The queue is full, but the msg must not be lost
+        ok = sc_vecdeque_push(&controller->queue, *msg);
+        if (!ok) {
+            LOG_OOM();
+        }
+    }
+
+    if (ok) {
+        sc_stats_set(controller->stats, SC_STAT_CONTROLLER_QUEUE,
+                     controller->queue.size);
         if (was_empty) {
             sc_cond_signal(&controller->msg_cond);
+            if (is_io_loop(controller)) {
+                wake_io_loop(controller);
+            }
         }
     }
-    // Otherwise (if the queue is full), the msg is discarded
 
     sc_mutex_unlock(&controller->mutex);
 
-    return !full;
+    if (ok && set_clipboard) {
+        // The device clipboard will contain this text
+        atomic_store_explicit(&controller->receiver.device_clipboard_hash,
+                              clipboard_hash, memory_order_relaxed);
+    }
+
+    return ok;
+}
+
+// Replace a large serialized message by its compressed form (if compression is
+// enabled and it is worth it), return the new length
+static size_t
+compress_msg(struct sc_controller *controller, uint8_t *buf, size_t len) {
+#ifdef HAVE_CONTROL_COMPRESSION
+    if (!controller->compression_buffer || len < SC_COMPRESSION_THRESHOLD) {
+        return len;
+    }
+
+    // Only compress if it saves at least 1 byte, including the header
+    size_t max = len - SC_COMPRESSION_HEADER_SIZE - 1;
+    size_t compressed_len = sc_compress(buf, len,
+                                        controller->compression_buffer, max);
+    if (!compressed_len) {
+        return len;
+    }
+
+    buf[0] = SC_CONTROL_MSG_TYPE_COMPRESSED;
+    sc_write32be(&buf[1], len);
+    sc_write32be(&buf[5], compressed_len);
+    memcpy(&buf[SC_COMPRESSION_HEADER_SIZE], controller->compression_buffer,
+           compressed_len);
+    size_t total = SC_COMPRESSION_HEADER_SIZE + compressed_len;
+    sc_stats_add(controller->stats, SC_STAT_CONTROL_COMPRESSION_SAVED_BYTES,
+                 len - total);
+    return total;
+#else
+    (void) controller;
+    (void) buf;
+    return len;
+#endif
+}
+
+// Serialize a message, compressed if it is large
+static size_t
+serialize_msg(struct sc_controller *controller,
+              const struct sc_control_msg *msg, uint8_t *buf) {
+    size_t len = sc_control_msg_serialize(msg, buf);
+    if (!len) {
+        return 0;
+    }
+    return compress_msg(controller, buf, len);
 }
 
 static bool
-process_msg(struct sc_controller *controller,
-            const struct sc_control_msg *msg) {
-    static uint8_t serialized_msg[SC_CONTROL_MSG_MAX_SIZE];
-    size_t length = sc_control_msg_serialize(msg, serialized_msg);
-    if (!length) {
+send_buffer(struct sc_controller *controller, size_t length) {
+    ssize_t w = net_send_all(controller->control_socket, controller->buffer,
+                             length);
+    return (size_t) w == length;
+}
+
+static bool
+is_finger_move(const struct sc_control_msg *msg) {
+    if (!is_touch_move(msg)) {
         return false;
     }
-    ssize_t w =
-        net_send_all(controller->control_socket, serialized_msg, length);
-    return (size_t) w == length;
+    uint64_t id = msg->inject_touch_event.pointer_id;
+    // Mouse pointers are injected with their buttons on the device
+    return id != POINTER_ID_MOUSE && id != POINTER_ID_VIRTUAL_MOUSE;
+}
+
+// Return the number of consecutive finger MOVE events of distinct pointers
+// starting at msgs[0]
+static size_t
+count_multi_touch_moves(const struct sc_control_msg *msgs, size_t count) {
+    size_t n = 0;
+    while (n < count && n < SC_CONTROL_MSG_MULTI_TOUCH_MAX_POINTERS
+            && is_finger_move(&msgs[n])) {
+        for (size_t i = 0; i < n; ++i) {
+            if (msgs[i].inject_touch_event.pointer_id
+                    == msgs[n].inject_touch_event.pointer_id) {
+                // Two positions of the same pointer
+                return n;
+            }
+        }
+        ++n;
+    }
+    return n;
+}
+
+static void
+init_multi_touch_msg(struct sc_control_msg *multi,
+                     const struct sc_control_msg *msgs, size_t count) {
+    assert(count <= SC_CONTROL_MSG_MULTI_TOUCH_MAX_POINTERS);
+    multi->type = SC_CONTROL_MSG_TYPE_INJECT_MULTI_TOUCH_EVENT;
+    multi->inject_multi_touch_event.pointer_count = count;
+    // The moves are injected at the time of the most recent one
+    uint32_t timestamp = 0;
+    for (size_t i = 0; i < count; ++i) {
+        timestamp = MAX(timestamp, msgs[i].inject_touch_event.timestamp);
+        struct sc_control_msg_pointer *pointer =
+            &multi->inject_multi_touch_event.pointers[i];
+        pointer->pointer_id = msgs[i].inject_touch_event.pointer_id;
+        pointer->position = msgs[i].inject_touch_event.position;
+        pointer->pressure = msgs[i].inject_touch_event.pressure;
+    }
+    multi->inject_multi_touch_event.timestamp = timestamp;
+}
+
+// Return the number of consecutive UHID input reports of the same device
+// starting at msgs[0]
+static size_t
+count_uhid_inputs(const struct sc_control_msg *msgs, size_t count) {
+    if (msgs[0].type != SC_CONTROL_MSG_TYPE_UHID_INPUT) {
+        return 0;
+    }
+
+    uint16_t id = msgs[0].uhid_input.id;
+    size_t n = 1;
+    while (n < count && n < SC_CONTROL_MSG_UHID_INPUT_BATCH_MAX_REPORTS
+            && msgs[n].type == SC_CONTROL_MSG_TYPE_UHID_INPUT
+            && msgs[n].uhid_input.id == id) {
+        ++n;
+    }
+    return n;
+}
+
+static void
+init_uhid_input_batch_msg(struct sc_control_msg *batch,
+                          const struct sc_control_msg *msgs, size_t count) {
+    assert(count <= SC_CONTROL_MSG_UHID_INPUT_BATCH_MAX_REPORTS);
+    batch->type = SC_CONTROL_MSG_TYPE_UHID_INPUT_BATCH;
+    batch->uhid_input_batch.id = msgs[0].uhid_input.id;
+    batch->uhid_input_batch.count = count;
+    for (size_t i = 0; i < count; ++i) {
+        struct sc_control_msg_uhid_report *report =
+            &batch->uhid_input_batch.reports[i];
+        report->size = msgs[i].uhid_input.size;
+        memcpy(report->data, msgs[i].uhid_input.data, report->size);
+    }
+}
+
+static bool
+process_msgs(struct sc_controller *controller,
+             const struct sc_control_msg *msgs, size_t count) {
+    // Serialize the messages in a single buffer, to send them at once
+    size_t length = 0;
+    size_t i = 0;
+    while (i < count) {
+        if (length > SC_CONTROLLER_BATCH_SIZE) {
+            if (!send_buffer(controller, length)) {
+                return false;
+            }
+            length = 0;
+        }
+
+        // The moves of several fingers (e.g. during a pinch) are sent in a
+        // single message, to be injected as a single MotionEvent
+        struct sc_control_msg merged;
+        const struct sc_control_msg *msg = &msgs[i];
+        size_t moves = count_multi_touch_moves(&msgs[i], count - i);
+        size_t reports = count_uhid_inputs(&msgs[i], count - i);
+        if (moves > 1) {
+            init_multi_touch_msg(&merged, &msgs[i], moves);
+            msg = &merged;
+            i += moves;
+        } else if (reports > 1) {
+            // The reports of a UHID device are written to the device at once
+            init_uhid_input_batch_msg(&merged, &msgs[i], reports);
+            msg = &merged;
+            i += reports;
+        } else {
+            ++i;
+        }
+
+        // There is always enough space for a message of the maximum size
+        assert(SC_CONTROLLER_BUFFER_SIZE - length >= SC_CONTROL_MSG_MAX_SIZE);
+        size_t len = serialize_msg(controller, msg,
+                                   controller->buffer + length);
+        if (!len) {
+            return false;
+        }
+        length += len;
+    }
+
+    return !length || send_buffer(controller, length);
+}
+
+static bool
+is_clipboard_bulk(const struct sc_control_msg *msg) {
+    return msg->type == SC_CONTROL_MSG_TYPE_SET_CLIPBOARD
+        && strlen(msg->set_clipboard.text)
+            > SC_CONTROL_MSG_CLIPBOARD_CHUNK_MAX_LENGTH;
+}
+
+// The motion events are sent between the chunks of a clipboard transfer. Any
+// other message (e.g. a key event, which may be Ctrl+v) must wait for the end
+// of the transfer, to be processed after the clipboard is set.
+static bool
+is_high_priority(const struct sc_control_msg *msg) {
+    return msg->type == SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT
+        || msg->type == SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT;
+}
+
+static void
+start_clipboard_transfer(struct sc_controller *controller,
+                         const struct sc_control_msg *msg) {
+    assert(!controller->clipboard_transfer_pending);
+    assert(is_clipboard_bulk(msg));
+
+    controller->clipboard_transfer = *msg;
+    char *text = controller->clipboard_transfer.set_clipboard.text;
+    // Truncate the whole text as if it was sent in a single message
+    size_t len = sc_str_utf8_truncation_index(
+                        text, SC_CONTROL_MSG_CLIPBOARD_TEXT_MAX_LENGTH);
+    text[len] = '\0';
+
+    controller->clipboard_transfer_offset = 0;
+    controller->clipboard_transfer_length = len;
+    controller->clipboard_transfer_pending = true;
+}
+
+static bool
+send_clipboard_chunk(struct sc_controller *controller) {
+    assert(controller->clipboard_transfer_pending);
+
+    struct sc_control_msg *transfer = &controller->clipboard_transfer;
+    size_t offset = controller->clipboard_transfer_offset;
+    size_t remaining = controller->clipboard_transfer_length - offset;
+    char *text = transfer->set_clipboard.text + offset;
+
+    struct sc_control_msg msg;
+    size_t len;
+    if (remaining > SC_CONTROL_MSG_CLIPBOARD_CHUNK_MAX_LENGTH) {
+        msg.type = SC_CONTROL_MSG_TYPE_SET_CLIPBOARD_CHUNK;
+        msg.set_clipboard_chunk.text = text;
+        len = sc_control_msg_serialize(&msg, controller->buffer);
+        // type: 1 byte; length: 4 bytes
+        size_t chunk_len = len - 5;
+        if (chunk_len) {
+            controller->clipboard_transfer_offset += chunk_len;
+            len = compress_msg(controller, controller->buffer, len);
+            return send_buffer(controller, len);
+        }
+        // Invalid UTF-8, send the remaining text in a single message
+    }
+
+    // The remaining text is sent in the final SET_CLIPBOARD message
+    msg = *transfer;
+    msg.set_clipboard.text = text;
+    len = serialize_msg(controller, &msg, controller->buffer);
+    bool ok = send_buffer(controller, len);
+
+    sc_control_msg_destroy(transfer);
+    controller->clipboard_transfer_pending = false;
+
+    return ok;
+}
+
+static void
+start_file_transfer(struct sc_controller *controller,
+                    const struct sc_control_msg *msg) {
+    assert(!controller->file_transfer_pending);
+    assert(msg->type == SC_CONTROL_MSG_TYPE_PUSH_FILE);
+
+    // The file is opened by send_file_chunk(), out of the mutex
+    controller->file_transfer = *msg;
+    controller->file_transfer_file = NULL;
+    controller->file_transfer_remaining = msg->push_file.size;
+    controller->file_transfer_pending = true;
+}
+
+static void
+end_file_transfer(struct sc_controller *controller, bool success) {
+    assert(controller->file_transfer_pending);
+
+    if (controller->file_transfer_file) {
+        fclose(controller->file_transfer_file);
+    }
+
+    struct sc_control_msg *transfer = &controller->file_transfer;
+    if (success) {
+        LOGI("%s successfully pushed to %s", transfer->push_file.local,
+                                             transfer->push_file.target);
+    } else {
+        LOGE("Failed to push %s to %s", transfer->push_file.local,
+                                        transfer->push_file.target);
+    }
+
+    sc_control_msg_destroy(transfer);
+    controller->file_transfer_pending = false;
+
+    if (controller->cbs && controller->cbs->on_file_pushed) {
+        controller->cbs->on_file_pushed(controller, success,
+                                        controller->cbs_userdata);
+    }
+}
+
+// Send the PUSH_FILE message on the first call, then one chunk per call
+static bool
+send_file_chunk(struct sc_controller *controller) {
+    assert(controller->file_transfer_pending);
+
+    struct sc_control_msg *transfer = &controller->file_transfer;
+    size_t len;
+
+    if (!controller->file_transfer_file) {
+        FILE *file = fopen(transfer->push_file.local, "rb");
+        if (!file) {
+            LOGE("Could not open %s", transfer->push_file.local);
+            // Nothing has been sent to the device
+            end_file_transfer(controller, false);
+            return true;
+        }
+        controller->file_transfer_file = file;
+
+        len = serialize_msg(controller, transfer, controller->buffer);
+        if (!send_buffer(controller, len)) {
+            end_file_transfer(controller, false);
+            return false;
+        }
+
+        if (!controller->file_transfer_remaining) {
+            end_file_transfer(controller, true);
+        }
+        return true;
+    }
+
+    size_t chunk_len = MIN(controller->file_transfer_remaining,
+                           sizeof(controller->file_chunk));
+    size_t r = fread(controller->file_chunk, 1, chunk_len,
+                     controller->file_transfer_file);
+
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_PUSH_FILE_CHUNK;
+    msg.push_file_chunk.data = controller->file_chunk;
+    msg.push_file_chunk.length = r;
+    len = serialize_msg(controller, &msg, controller->buffer);
+    bool ok = send_buffer(controller, len);
+
+    if (!r) {
+        // The file is shorter than announced (or could not be read), the
+        // empty chunk aborts the transfer on the device
+        LOGE("Could not read %s", transfer->push_file.local);
+        end_file_transfer(controller, false);
+        return ok;
+    }
+
+    controller->file_transfer_remaining -= r;
+    if (!ok || !controller->file_transfer_remaining) {
+        end_file_transfer(controller, ok);
+    }
+
+    return ok;
+}
+
+static bool
+send_clock_ping(struct sc_controller *controller) {
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_CLOCK_PING;
+    // Measured as late as possible, just before sending
+    msg.clock_ping.client_time = sc_tick_now();
+    size_t len = sc_control_msg_serialize(&msg, controller->buffer);
+    return send_buffer(controller, len);
+}
+
+static bool
+is_transfer(const struct sc_control_msg *msg) {
+    return is_clipboard_bulk(msg) || msg->type == SC_CONTROL_MSG_TYPE_PUSH_FILE;
+}
+
+// Pop the messages up to the next transfer. If start_transfer is set, the
+// transfer is popped and started, otherwise it is kept in the queue.
+// must be called with mutex locked
+static size_t
+pop_msgs(struct sc_controller *controller, struct sc_control_msg *msgs,
+         size_t max, bool start_transfer) {
+    size_t count = 0;
+    while (!sc_vecdeque_is_empty(&controller->queue) && count < max) {
+        struct sc_control_msg *next =
+            sc_vecdeque_get(&controller->queue, 0);
+        if (is_transfer(next)) {
+            if (!start_transfer) {
+                break;
+            }
+            // The messages queued after it are popped during the transfer
+            struct sc_control_msg msg = sc_vecdeque_pop(&controller->queue);
+            if (msg.type == SC_CONTROL_MSG_TYPE_PUSH_FILE) {
+                start_file_transfer(controller, &msg);
+            } else {
+                start_clipboard_transfer(controller, &msg);
+            }
+            break;
+        }
+        msgs[count++] = sc_vecdeque_pop(&controller->queue);
+    }
+    return count;
+}
+
+// Pop only the high priority messages, keeping the others in order
+// must be called with mutex locked
+static size_t
+pop_high_priority_msgs(struct sc_controller *controller,
+                       struct sc_control_msg *msgs, size_t max) {
+    size_t count = 0;
+    size_t size = controller->queue.size;
+    for (size_t i = 0; i < size; ++i) {
+        struct sc_control_msg msg = sc_vecdeque_pop(&controller->queue);
+        if (count < max && is_high_priority(&msg)) {
+            msgs[count++] = msg;
+        } else {
+            // Push it back at the end (there is room since it has just been
+            // popped)
+            sc_vecdeque_push_noresize(&controller->queue, msg);
+        }
+    }
+    return count;
+}
+
+// Process the device messages received and the wake-ups, return 1 if any,
+// 0 on timeout, or -1 if the control socket is closed (or on error)
+static int
+poll_io(struct sc_controller *controller, sc_tick timeout) {
+    sc_socket sockets[] = {
+        controller->control_socket,
+        controller->wake_sockets[0],
+    };
+    bool readable[ARRAY_LEN(sockets)];
+    int r = net_poll_readable(sockets, readable, ARRAY_LEN(sockets), timeout);
+    if (r <= 0) {
+        return r;
+    }
+
+    if (readable[0] && !sc_receiver_recv(&controller->receiver)) {
+        return -1;
+    }
+
+    if (readable[1]) {
+        // Consume the wake-ups (if there are more, they will just cause a
+        // spurious wake-up)
+        char buf[64];
+        if (net_recv(controller->wake_sockets[0], buf, sizeof(buf)) <= 0) {
+            return -1;
+        }
+    }
+
+    return 1;
+}
+
+// Wait until a message is pushed, while processing the device messages
+// received meanwhile, up to the next clock ping. Same return values as
+// poll_io().
+// must be called with mutex locked (it is released during the wait)
+static int
+wait_io(struct sc_controller *controller) {
+    sc_tick timeout = -1;
+    if (controller->clock_sync) {
+        sc_tick now = sc_tick_now();
+        timeout = controller->next_clock_ping > now
+                ? controller->next_clock_ping - now : 0;
+    }
+
+    sc_mutex_unlock(&controller->mutex);
+    int r = poll_io(controller, timeout);
+    sc_mutex_lock(&controller->mutex);
+    return r;
 }
 
 static int
 run_controller(void *data) {
     struct sc_controller *controller = data;
 
+    sc_thread_apply_role(SC_THREAD_ROLE_CONTROLLER);
+    sc_trace_thread_name("controller");
+
+    // The messages popped at once
+    struct sc_control_msg msgs[SC_CONTROL_MSG_QUEUE_MAX];
+
     for (;;) {
         sc_mutex_lock(&controller->mutex);
-        while (!controller->stopped
+        // Only the controller thread writes the transfer_pending flags
+        bool clipboard_transfer = controller->clipboard_transfer_pending;
+        bool file_transfer = controller->file_transfer_pending;
+        bool ping = false;
+        bool io_error = false;
+        while (!controller->stopped && !clipboard_transfer && !file_transfer
                 && sc_vecdeque_is_empty(&controller->queue)) {
-            sc_cond_wait(&controller->msg_cond, &controller->mutex);
+            if (is_io_loop(controller)) {
+                int r = wait_io(controller);
+                if (r == -1) {
+                    io_error = true;
+                    break;
+                }
+                if (!r) {
+                    // timeout
+                    break;
+                }
+            } else if (!controller->clock_sync) {
+                sc_cond_wait(&controller->msg_cond, &controller->mutex);
+            } else if (!sc_cond_timedwait(&controller->msg_cond,
+                                          &controller->mutex,
+                                          controller->next_clock_ping)) {
+                // timeout
+                break;
+            }
+        }
+        if (controller->clock_sync) {
+            sc_tick now = sc_tick_now();
+            if (now >= controller->next_clock_ping) {
+                ping = true;
+                controller->next_clock_ping =
+                    now + SC_CLOCK_SYNC_PING_INTERVAL;
+            }
         }
-        if (controller->stopped) {
+        if (controller->stopped || io_error) {
             // stop immediately, do not process further msgs
             sc_mutex_unlock(&controller->mutex);
             break;
         }
 
-        assert(!sc_vecdeque_is_empty(&controller->queue));
-        struct sc_control_msg msg = sc_vecdeque_pop(&controller->queue);
+        // Drain the queue (it may exceed SC_CONTROL_MSG_QUEUE_MAX if non-
+        // droppable messages were pushed while it was full, in that case the
+        // remaining messages are processed on the next iteration). During a
+        // clipboard transfer, only the high priority messages are popped.
+        // During a file transfer, all the messages are popped up to the next
+        // transfer.
+        size_t count;
+        if (clipboard_transfer) {
+            count = pop_high_priority_msgs(controller, msgs, ARRAY_LEN(msgs));
+        } else {
+            count = pop_msgs(controller, msgs, ARRAY_LEN(msgs),
+                             !file_transfer);
+        }
+        sc_stats_set(controller->stats, SC_STAT_CONTROLLER_QUEUE,
+                     controller->queue.size);
         sc_mutex_unlock(&controller->mutex);
 
-        bool ok = process_msg(controller, &msg);
-        sc_control_msg_destroy(&msg);
+        sc_trace_begin("send");
+        bool ok = process_msgs(controller, msgs, count);
+        sc_trace_end();
+        for (size_t i = 0; i < count; ++i) {
+            sc_control_msg_destroy(&msgs[i]);
+        }
+        if (ok && ping) {
+            ok = send_clock_ping(controller);
+        }
+        // Send one chunk, then process the input events received meanwhile
+        if (ok && controller->clipboard_transfer_pending) {
+            ok = send_clipboard_chunk(controller);
+        } else if (ok && controller->file_transfer_pending) {
+            ok = send_file_chunk(controller);
+        }
         if (!ok) {
             LOGD("Could not write msg to socket");
             break;
         }
+
+        if (is_io_loop(controller) && poll_io(controller, 0) == -1) {
+            // Never starve the device messages while sending continuously
+            // (e.g. during a transfer)
+            break;
+        }
     }
     return 0;
 }
@@ -142,6 +911,11 @@ sc_controller_start(struct sc_controller *controller) {
         return false;
     }
 
+    if (is_io_loop(controller)) {
+        // The device messages are received by the controller thread
+        return true;
+    }
+
     if (!sc_receiver_start(&controller->receiver)) {
         sc_controller_stop(controller);
         sc_thread_join(&controller->thread, NULL);
@@ -156,11 +930,22 @@ sc_controller_stop(struct sc_controller *controller) {
     sc_mutex_lock(&controller->mutex);
     controller->stopped = true;
     sc_cond_signal(&controller->msg_cond);
+    if (is_io_loop(controller)) {
+        wake_io_loop(controller);
+    }
     sc_mutex_unlock(&controller->mutex);
 }
 
 void
 sc_controller_join(struct sc_controller *controller) {
     sc_thread_join(&controller->thread, NULL);
-    sc_receiver_join(&controller->receiver);
+    if (!is_io_loop(controller)) {
+        sc_receiver_join(&controller->receiver);
+    }
+}
+
+uint64_t
+sc_controller_get_device_clipboard_hash(struct sc_controller *controller) {
+    return atomic_load_explicit(&controller->receiver.device_clipboard_hash,
+                                memory_order_relaxed);
 }
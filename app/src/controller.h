@@ -4,15 +4,31 @@
 #include "common.h"
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 
 #include "control_msg.h"
+#include "input_replay.h"
 #include "receiver.h"
+#include "stats.h"
 #include "util/acksync.h"
 #include "util/net.h"
 #include "util/thread.h"
 #include "util/vecdeque.h"
 
-struct sc_control_msg_queue SC_VECDEQUE(struct sc_control_msg);
+#define SC_CONTROL_MSG_QUEUE_MAX 64
+
+struct sc_control_msg_queue
+    SC_VECDEQUE_INLINE(struct sc_control_msg, SC_CONTROL_MSG_QUEUE_MAX);
+
+struct sc_controller;
+
+struct sc_controller_callbacks {
+    // Called from the controller thread once the content of a PUSH_FILE
+    // message has been sent (or could not be sent)
+    void (*on_file_pushed)(struct sc_controller *controller, bool success,
+                           void *userdata);
+};
 
 struct sc_controller {
     sc_socket control_socket;
@@ -21,20 +37,87 @@ struct sc_controller {
     sc_cond msg_cond;
     bool stopped;
     struct sc_control_msg_queue queue;
+    // Buffer to serialize the queued messages, to send them at once (only
+    // used by the controller thread)
+    uint8_t *buffer;
+    // Buffer to compress a large message into, NULL if compression is
+    // disabled (only used by the controller thread)
+    uint8_t *compression_buffer;
+    // Large clipboard text being sent in chunks (only used by the controller
+    // thread)
+    struct sc_control_msg clipboard_transfer;
+    size_t clipboard_transfer_offset;
+    size_t clipboard_transfer_length;
+    bool clipboard_transfer_pending;
+    // File being sent in chunks (only used by the controller thread)
+    struct sc_control_msg file_transfer;
+    FILE *file_transfer_file; // NULL until the transfer is started
+    uint64_t file_transfer_remaining;
+    bool file_transfer_pending;
+    uint8_t file_chunk[SC_CONTROL_MSG_PUSH_FILE_CHUNK_MAX_LENGTH];
     struct sc_receiver receiver;
+    struct sc_stats *stats; // may be NULL
+    struct sc_input_recorder *input_recorder; // may be NULL
+    // Send CLOCK_PING messages periodically if not NULL
+    struct sc_clock_sync *clock_sync;
+    sc_tick next_clock_ping; // only used by the controller thread
+    // In I/O loop mode, the connected sockets used to wake up the controller
+    // thread when a message is pushed (SC_SOCKET_NONE otherwise)
+    sc_socket wake_sockets[2];
+
+    const struct sc_controller_callbacks *cbs;
+    void *cbs_userdata;
 };
 
 bool
-sc_controller_init(struct sc_controller *controller, sc_socket control_socket);
+sc_controller_init(struct sc_controller *controller, sc_socket control_socket,
+                   struct sc_stats *stats,
+                   const struct sc_controller_callbacks *cbs,
+                   void *cbs_userdata);
 
 void
 sc_controller_configure(struct sc_controller *controller,
                         struct sc_acksync *acksync,
-                        struct sc_uhid_devices *uhid_devices);
+                        struct sc_uhid_devices *uhid_devices,
+                        struct sc_input_recorder *input_recorder);
 
 void
 sc_controller_destroy(struct sc_controller *controller);
 
+#ifdef HAVE_CONTROL_COMPRESSION
+/**
+ * Compress the large messages (the device must have been started with
+ * compression enabled)
+ *
+ * Must be called before sc_controller_start().
+ */
+bool
+sc_controller_enable_compression(struct sc_controller *controller);
+#endif
+
+/**
+ * Measure the device clock periodically (the replies are pushed to
+ * `clock_sync` by the receiver)
+ *
+ * Must be called before sc_controller_start().
+ */
+void
+sc_controller_enable_clock_sync(struct sc_controller *controller,
+                                struct sc_clock_sync *clock_sync);
+
+/**
+ * Receive the device messages from the controller thread, instead of a
+ * separate receiver thread
+ *
+ * The controller thread then waits until either the control socket is
+ * readable or a message is pushed, so that a single thread handles both
+ * directions of the control socket.
+ *
+ * Must be called before sc_controller_start().
+ */
+bool
+sc_controller_enable_io_loop(struct sc_controller *controller);
+
 bool
 sc_controller_start(struct sc_controller *controller);
 
@@ -48,4 +131,12 @@ bool
 sc_controller_push_msg(struct sc_controller *controller,
                        const struct sc_control_msg *msg);
 
+/**
+ * Return the hash (see sc_str_hash()) of the text in the device clipboard, as
+ * far as it is known (either set by a SET_CLIPBOARD message or received from
+ * the device), or 0 if it is unknown
+ */
+uint64_t
+sc_controller_get_device_clipboard_hash(struct sc_controller *controller);
+
 #endif
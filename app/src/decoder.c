@@ -1,38 +1,338 @@
 #include "decoder.h"
 
+#include <string.h>
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libavutil/channel_layout.h>
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+# include <libavutil/hwcontext.h>
+#endif
 
 #include "events.h"
+#include "hwframe.h"
+#include "startup_timeline.h"
 #include "trait/frame_sink.h"
 #include "util/log.h"
+#include "util/tick.h"
+#include "util/trace.h"
 
 /** Downcast packet_sink to decoder */
 #define DOWNCAST(SINK) container_of(SINK, struct sc_decoder, packet_sink)
 
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+static enum AVPixelFormat
+sc_decoder_get_format(AVCodecContext *ctx, const enum AVPixelFormat *fmts) {
+    struct sc_decoder *decoder = ctx->opaque;
+
+    for (const enum AVPixelFormat *p = fmts; *p != AV_PIX_FMT_NONE; ++p) {
+        if (*p == decoder->hw_pix_fmt) {
+            return *p;
+        }
+    }
+
+    LOGW("Decoder '%s': hardware format not available, "
+         "fallback to software decoding", decoder->name);
+    return avcodec_default_get_format(ctx, fmts);
+}
+
+static AVBufferRef *
+sc_decoder_create_hw_device(struct sc_decoder *decoder, const AVCodec *codec,
+                            enum AVPixelFormat *hw_pix_fmt) {
+    // AV_HWDEVICE_TYPE_NONE means "any"
+    enum AVHWDeviceType type = AV_HWDEVICE_TYPE_NONE;
+    if (strcmp(decoder->hwaccel, "auto")) {
+        type = av_hwdevice_find_type_by_name(decoder->hwaccel);
+        if (type == AV_HWDEVICE_TYPE_NONE) {
+            LOGW("Decoder '%s': unknown hardware device type: %s",
+                 decoder->name, decoder->hwaccel);
+            return NULL;
+        }
+    }
+
+    for (int i = 0;; ++i) {
+        const AVCodecHWConfig *config = avcodec_get_hw_config(codec, i);
+        if (!config) {
+            break;
+        }
+
+        if (!(config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX)) {
+            continue;
+        }
+
+        if (type != AV_HWDEVICE_TYPE_NONE && config->device_type != type) {
+            continue;
+        }
+
+        const char *type_name = av_hwdevice_get_type_name(config->device_type);
+
+        AVBufferRef *device = NULL;
+        int r = av_hwdevice_ctx_create(&device, config->device_type, NULL,
+                                       NULL, 0);
+        if (r < 0) {
+            LOGD("Decoder '%s': could not create %s device: %d",
+                 decoder->name, type_name, r);
+            continue;
+        }
+
+        LOGI("Decoder '%s': using hardware decoding (%s)", decoder->name,
+             type_name);
+        *hw_pix_fmt = config->pix_fmt;
+        return device;
+    }
+
+    LOGW("Decoder '%s': no hardware device available for %s",
+         decoder->name, codec->name);
+    return NULL;
+}
+
+static bool
+sc_decoder_open_hw(struct sc_decoder *decoder, const AVCodecContext *ctx) {
+    const AVCodec *codec = ctx->codec;
+
+    AVBufferRef *device =
+        sc_decoder_create_hw_device(decoder, codec, &decoder->hw_pix_fmt);
+    if (!device) {
+        return false;
+    }
+
+    AVCodecContext *hw_ctx = avcodec_alloc_context3(codec);
+    if (!hw_ctx) {
+        LOG_OOM();
+        goto error_unref_device;
+    }
+
+    hw_ctx->flags = ctx->flags;
+    hw_ctx->width = ctx->width;
+    hw_ctx->height = ctx->height;
+    hw_ctx->pix_fmt = ctx->pix_fmt;
+    hw_ctx->opaque = decoder;
+    hw_ctx->get_format = sc_decoder_get_format;
+    if (decoder->hw_frames) {
+        // The frames are kept by the sinks (e.g. the screen frame buffer)
+        // without being downloaded, so the surface pool must be larger
+        hw_ctx->extra_hw_frames = 2;
+    }
+    hw_ctx->hw_device_ctx = av_buffer_ref(device);
+    if (!hw_ctx->hw_device_ctx) {
+        LOG_OOM();
+        goto error_free_context;
+    }
+
+    if (avcodec_open2(hw_ctx, codec, NULL) < 0) {
+        LOGW("Decoder '%s': could not open hardware codec", decoder->name);
+        goto error_free_context;
+    }
+
+    if (!decoder->hw_frames) {
+        decoder->sw_frame = av_frame_alloc();
+        if (!decoder->sw_frame) {
+            LOG_OOM();
+            goto error_free_context;
+        }
+
+        if (!sc_hwframe_downloader_init(&decoder->downloader, false)) {
+            goto error_free_sw_frame;
+        }
+    }
+
+    // The hw_ctx keeps its own reference
+    av_buffer_unref(&device);
+
+    decoder->hw_ctx = hw_ctx;
+
+    return true;
+
+error_free_sw_frame:
+    av_frame_free(&decoder->sw_frame);
+error_free_context:
+    avcodec_free_context(&hw_ctx);
+error_unref_device:
+    av_buffer_unref(&device);
+
+    return false;
+}
+
+static void
+sc_decoder_close_hw(struct sc_decoder *decoder) {
+    if (decoder->hw_ctx) {
+        if (!decoder->hw_frames) {
+            sc_hwframe_downloader_destroy(&decoder->downloader);
+            av_frame_free(&decoder->sw_frame);
+        }
+        avcodec_free_context(&decoder->hw_ctx);
+    }
+}
+
+#endif
+
+static bool
+sc_decoder_needs_threaded_ctx(struct sc_decoder *decoder,
+                              const AVCodecContext *ctx) {
+    if (ctx->codec_type != AVMEDIA_TYPE_VIDEO) {
+        return false;
+    }
+
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    if (decoder->hw_ctx) {
+        // Threading is not used by hardware decoders
+        return false;
+    }
+#endif
+
+    return decoder->thread_count != 1
+        || decoder->threading == SC_VIDEO_DECODER_THREADING_FRAME;
+}
+
+static bool
+sc_decoder_open_threaded(struct sc_decoder *decoder,
+                         const AVCodecContext *ctx) {
+    const AVCodec *codec = ctx->codec;
+
+    AVCodecContext *threaded_ctx = avcodec_alloc_context3(codec);
+    if (!threaded_ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    threaded_ctx->flags = ctx->flags;
+    threaded_ctx->width = ctx->width;
+    threaded_ctx->height = ctx->height;
+    threaded_ctx->pix_fmt = ctx->pix_fmt;
+    threaded_ctx->thread_count = decoder->thread_count;
+    if (decoder->threading == SC_VIDEO_DECODER_THREADING_FRAME) {
+        threaded_ctx->thread_type = FF_THREAD_FRAME;
+        // Frame threading is disabled by FFmpeg in low delay mode
+        threaded_ctx->flags &= ~AV_CODEC_FLAG_LOW_DELAY;
+    } else {
+        threaded_ctx->thread_type = FF_THREAD_SLICE;
+    }
+
+    if (avcodec_open2(threaded_ctx, codec, NULL) < 0) {
+        LOGE("Decoder '%s': could not open threaded codec", decoder->name);
+        avcodec_free_context(&threaded_ctx);
+        return false;
+    }
+
+    const char *type = threaded_ctx->active_thread_type == FF_THREAD_FRAME
+                     ? "frame"
+                     : threaded_ctx->active_thread_type == FF_THREAD_SLICE
+                     ? "slice"
+                     : "no";
+    LOGI("Decoder '%s': %d thread(s), %s threading", decoder->name,
+         threaded_ctx->thread_count, type);
+    if (decoder->threading == SC_VIDEO_DECODER_THREADING_FRAME
+            && threaded_ctx->active_thread_type == FF_THREAD_FRAME) {
+        LOGW("Decoder '%s': frame threading adds %d frame(s) of latency",
+             decoder->name, threaded_ctx->thread_count - 1);
+    }
+
+    decoder->threaded_ctx = threaded_ctx;
+    return true;
+}
+
 static bool
 sc_decoder_open(struct sc_decoder *decoder, AVCodecContext *ctx) {
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    decoder->hw_ctx = NULL;
+    if (decoder->hwaccel && ctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+        if (!sc_decoder_open_hw(decoder, ctx)) {
+            LOGW("Decoder '%s': hardware decoding unavailable, "
+                 "fallback to software decoding", decoder->name);
+        }
+    }
+#endif
+
+    decoder->threaded_ctx = NULL;
+    if (sc_decoder_needs_threaded_ctx(decoder, ctx)
+            && !sc_decoder_open_threaded(decoder, ctx)) {
+        goto error_close_hw;
+    }
+
     decoder->frame = av_frame_alloc();
     if (!decoder->frame) {
         LOG_OOM();
-        return false;
+        goto error_free_threaded_ctx;
     }
 
+    // The sinks always receive the software codec context (the frames pushed
+    // are in system memory unless hw_frames is set)
     if (!sc_frame_source_sinks_open(&decoder->frame_source, ctx)) {
-        av_frame_free(&decoder->frame);
-        return false;
+        goto error_free_frame;
     }
 
     decoder->ctx = ctx;
+    decoder->wait_keyframe = false;
+    decoder->fast_decoding_applied = false;
+    decoder->keyframes_only_applied = false;
 
     return true;
+
+error_free_frame:
+    av_frame_free(&decoder->frame);
+error_free_threaded_ctx:
+    avcodec_free_context(&decoder->threaded_ctx);
+error_close_hw:
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    sc_decoder_close_hw(decoder);
+#endif
+
+    return false;
 }
 
 static void
 sc_decoder_close(struct sc_decoder *decoder) {
     sc_frame_source_sinks_close(&decoder->frame_source);
     av_frame_free(&decoder->frame);
+    avcodec_free_context(&decoder->threaded_ctx);
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    sc_decoder_close_hw(decoder);
+#endif
+}
+
+static bool
+sc_decoder_send_keyframe_request(struct sc_decoder *decoder) {
+    if (!decoder->controller) {
+        return false;
+    }
+
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_REQUEST_KEYFRAME;
+
+    if (!sc_controller_push_msg(decoder->controller, &msg)) {
+        LOGW("Decoder '%s': could not request keyframe", decoder->name);
+        return false;
+    }
+
+    return true;
+}
+
+// Recover from a decoding error (typically a corrupted packet) rather than
+// stopping the stream: video packets are dropped until the keyframe requested
+// to the device, audio packets are independent, so only the current one is
+// lost
+static bool
+sc_decoder_recover(struct sc_decoder *decoder, AVCodecContext *ctx, int err) {
+    if (err == AVERROR(ENOMEM)) {
+        return false;
+    }
+
+    bool video = ctx->codec_type == AVMEDIA_TYPE_VIDEO;
+    if (video) {
+        if (!sc_decoder_send_keyframe_request(decoder)) {
+            return false;
+        }
+
+        LOGW("Decoder '%s': decoding error (%d), waiting for a keyframe",
+             decoder->name, err);
+        decoder->wait_keyframe = true;
+    } else {
+        LOGW("Decoder '%s': decoding error (%d), packet dropped",
+             decoder->name, err);
+    }
+
+    avcodec_flush_buffers(ctx);
+    sc_stats_add(decoder->stats, SC_STAT_DECODE_ERRORS, 1);
+    return true;
 }
 
 static bool
@@ -43,33 +343,147 @@ sc_decoder_push(struct sc_decoder *decoder, const AVPacket *packet) {
         return true;
     }
 
-    int ret = avcodec_send_packet(decoder->ctx, packet);
+    bool keyframes_only = atomic_load_explicit(&decoder->keyframes_only,
+                                               memory_order_relaxed);
+    if (keyframes_only != decoder->keyframes_only_applied) {
+        decoder->keyframes_only_applied = keyframes_only;
+        LOGD("Decoder '%s': %s keyframes only", decoder->name,
+             keyframes_only ? "enable" : "disable");
+        if (!keyframes_only && !(packet->flags & AV_PKT_FLAG_KEY)) {
+            // The next packets reference frames which have not been decoded
+            sc_decoder_send_keyframe_request(decoder);
+            decoder->wait_keyframe = true;
+        }
+    }
+
+    if (keyframes_only && !(packet->flags & AV_PKT_FLAG_KEY)) {
+        // Dropped before the decoder rather than skipped by it (skip_frame),
+        // so that the packet is not even parsed, and hardware decoders (which
+        // ignore skip_frame) benefit too
+        return true;
+    }
+
+    if (decoder->wait_keyframe) {
+        if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+            // Drop the packet, it could not be decoded correctly anyway
+            sc_stats_add(decoder->stats, SC_STAT_VIDEO_PACKETS_DROPPED, 1);
+            return true;
+        }
+
+        LOGI("Decoder '%s': keyframe received, decoding resumed",
+             decoder->name);
+
+        decoder->wait_keyframe = false;
+    }
+
+    if (decoder->latency_tracker) {
+        sc_latency_tracker_on_received(decoder->latency_tracker, packet->pts);
+    }
+
+    AVCodecContext *ctx = decoder->threaded_ctx ? decoder->threaded_ctx
+                                                : decoder->ctx;
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    if (decoder->hw_ctx) {
+        ctx = decoder->hw_ctx;
+    }
+#endif
+
+    bool fast = atomic_load_explicit(&decoder->fast_decoding,
+                                     memory_order_relaxed);
+    if (fast != decoder->fast_decoding_applied) {
+        // Read by the decoder for each frame (ignored by hardware decoders)
+        ctx->skip_loop_filter = fast ? AVDISCARD_ALL : AVDISCARD_DEFAULT;
+        decoder->fast_decoding_applied = fast;
+        LOGD("Decoder '%s': %s fast decoding", decoder->name,
+             fast ? "enable" : "disable");
+        if (!fast) {
+            // The reference frames decoded without the filters are degraded,
+            // do not wait for the next periodic keyframe to get rid of them
+            sc_decoder_send_keyframe_request(decoder);
+        }
+    }
+
+    // Time spent in the decoder (including the hardware frames download, but
+    // excluding the frame sinks)
+    sc_tick decode_time = 0;
+    sc_tick decode_start = sc_tick_now();
+
+    sc_trace_begin_pts("decode", packet->pts);
+    int ret = avcodec_send_packet(ctx, packet);
+    sc_trace_end();
     if (ret < 0 && ret != AVERROR(EAGAIN)) {
+        if (sc_decoder_recover(decoder, ctx, ret)) {
+            return true;
+        }
         LOGE("Decoder '%s': could not send video packet: %d",
              decoder->name, ret);
         return false;
     }
 
     for (;;) {
-        ret = avcodec_receive_frame(decoder->ctx, decoder->frame);
+        sc_trace_begin("receive-frame");
+        ret = avcodec_receive_frame(ctx, decoder->frame);
+        sc_trace_end();
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
             break;
         }
 
         if (ret) {
+            if (sc_decoder_recover(decoder, ctx, ret)) {
+                return true;
+            }
             LOGE("Decoder '%s', could not receive video frame: %d",
                  decoder->name, ret);
             return false;
         }
 
         // a frame was received
-        bool ok = sc_frame_source_sinks_push(&decoder->frame_source,
-                                             decoder->frame);
-        av_frame_unref(decoder->frame);
+        AVFrame *frame = decoder->frame;
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+        if (decoder->hw_ctx && !decoder->hw_frames
+                && frame->format == decoder->hw_pix_fmt) {
+            // Download to system memory
+            bool ok = sc_hwframe_downloader_download(&decoder->downloader,
+                                                     decoder->sw_frame, frame);
+            av_frame_unref(decoder->frame);
+            if (!ok) {
+                // Error already logged
+                return false;
+            }
+            frame = decoder->sw_frame;
+        }
+#endif
+
+        if (decoder->latency_tracker) {
+            sc_latency_tracker_on_stage(decoder->latency_tracker,
+                                        SC_LATENCY_STAGE_DECODED, frame->pts);
+        }
+
+        if (ctx->codec_type == AVMEDIA_TYPE_VIDEO) {
+            sc_startup_timeline_mark(SC_STARTUP_FIRST_DECODED_FRAME);
+        }
+
+        decode_time += sc_tick_now() - decode_start;
+
+        sc_trace_begin_pts("push-frame", frame->pts);
+        bool ok = sc_frame_source_sinks_push(&decoder->frame_source, frame);
+        sc_trace_end();
+        av_frame_unref(frame);
         if (!ok) {
             // Error already logged
             return false;
         }
+
+        decode_start = sc_tick_now();
+    }
+
+    decode_time += sc_tick_now() - decode_start;
+    sc_stats_add(decoder->stats, SC_STAT_VIDEO_PACKETS_DECODED, 1);
+    sc_stats_add(decoder->stats, SC_STAT_VIDEO_DECODE_TIME_US,
+                 SC_TICK_TO_US(decode_time));
+    if (decoder->fps_counter) {
+        sc_fps_counter_add_duration(decoder->fps_counter,
+                                    SC_FPS_COUNTER_TIMING_DECODE, decode_time);
     }
 
     return true;
@@ -94,10 +508,35 @@ sc_decoder_packet_sink_push(struct sc_packet_sink *sink,
     return sc_decoder_push(decoder, packet);
 }
 
-void
-sc_decoder_init(struct sc_decoder *decoder, const char *name) {
+bool
+sc_decoder_init(struct sc_decoder *decoder, const char *name,
+                const struct sc_decoder_params *params) {
+    if (!sc_frame_source_init(&decoder->frame_source)) {
+        return false;
+    }
+
     decoder->name = name; // statically allocated
-    sc_frame_source_init(&decoder->frame_source);
+    atomic_init(&decoder->fast_decoding, false);
+    atomic_init(&decoder->keyframes_only, false);
+    if (params) {
+        decoder->hwaccel = params->hwaccel;
+        decoder->hw_frames = params->hw_frames;
+        decoder->latency_tracker = params->latency_tracker;
+        decoder->controller = params->controller;
+        decoder->stats = params->stats;
+        decoder->fps_counter = params->fps_counter;
+        decoder->threading = params->threading;
+        decoder->thread_count = params->thread_count;
+    } else {
+        decoder->hwaccel = NULL;
+        decoder->hw_frames = false;
+        decoder->latency_tracker = NULL;
+        decoder->controller = NULL;
+        decoder->stats = NULL;
+        decoder->fps_counter = NULL;
+        decoder->threading = SC_VIDEO_DECODER_THREADING_SLICE;
+        decoder->thread_count = 1;
+    }
 
     static const struct sc_packet_sink_ops ops = {
         .open = sc_decoder_packet_sink_open,
@@ -106,4 +545,23 @@ sc_decoder_init(struct sc_decoder *decoder, const char *name) {
     };
 
     decoder->packet_sink.ops = &ops;
+
+    return true;
+}
+
+void
+sc_decoder_set_fast_decoding(struct sc_decoder *decoder, bool enabled) {
+    atomic_store_explicit(&decoder->fast_decoding, enabled,
+                          memory_order_relaxed);
+}
+
+void
+sc_decoder_set_keyframes_only(struct sc_decoder *decoder, bool enabled) {
+    atomic_store_explicit(&decoder->keyframes_only, enabled,
+                          memory_order_relaxed);
+}
+
+void
+sc_decoder_destroy(struct sc_decoder *decoder) {
+    sc_frame_source_destroy(&decoder->frame_source);
 }
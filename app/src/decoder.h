@@ -3,9 +3,16 @@
 
 #include "common.h"
 
+#include "controller.h"
+#include "fps_counter.h"
+#include "hwframe.h"
+#include "latency_tracker.h"
+#include "options.h"
+#include "stats.h"
 #include "trait/frame_source.h"
 #include "trait/packet_sink.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
@@ -16,12 +23,89 @@ struct sc_decoder {
 
     const char *name; // must be statically allocated (e.g. a string literal)
 
+    // Hardware device type name ("auto" to select the first working one), or
+    // NULL to disable hardware decoding
+    const char *hwaccel;
+    // If set, push the frames stored in hardware surfaces as is, without
+    // downloading them (the sinks must support them)
+    bool hw_frames;
+    // May be NULL
+    struct sc_latency_tracker *latency_tracker;
+    // May be NULL
+    struct sc_controller *controller;
+    // May be NULL
+    struct sc_stats *stats;
+    // May be NULL
+    struct sc_fps_counter *fps_counter;
+    // Threading of the software video decoder
+    enum sc_video_decoder_threading threading;
+    unsigned thread_count; // 0 for auto
+
+    // After a decoding error, drop the packets until the next keyframe
+    bool wait_keyframe;
+
+    // Requested by the screen when the video is strongly downscaled: skip the
+    // in-loop filters, whose effect is not visible anyway
+    atomic_bool fast_decoding;
+    bool fast_decoding_applied; // only accessed from the decoder thread
+
+    // Requested when the video is only previewed (e.g. not focused in a
+    // wall): drop all the packets but the keyframes before decoding
+    atomic_bool keyframes_only;
+    bool keyframes_only_applied; // only accessed from the decoder thread
+
     AVCodecContext *ctx;
+    // Software video codec context opened with the requested threading
+    // (owned by the decoder), or NULL if the context provided by the demuxer
+    // is used as is (single-threaded)
+    AVCodecContext *threaded_ctx;
     AVFrame *frame;
+
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    // Codec context used for hardware decoding (owned by the decoder), or
+    // NULL if the software codec context (ctx) is used
+    AVCodecContext *hw_ctx;
+    enum AVPixelFormat hw_pix_fmt;
+    // Only used if !hw_frames
+    struct sc_hwframe_downloader downloader;
+    AVFrame *sw_frame;
+#endif
+};
+
+struct sc_decoder_params {
+    const char *hwaccel; // may be NULL, must outlive the decoder
+    bool hw_frames;
+    struct sc_latency_tracker *latency_tracker; // may be NULL
+    // If set, request a keyframe to recover from decoding errors (instead of
+    // stopping); it may be initialized later, but before the first packet
+    struct sc_controller *controller;
+    struct sc_stats *stats; // may be NULL
+    // If set, report the decoding durations; it may be initialized later, but
+    // before the first packet
+    struct sc_fps_counter *fps_counter;
+    enum sc_video_decoder_threading threading;
+    unsigned thread_count; // 0 for auto, 1 to disable threading
 };
 
 // The name must be statically allocated (e.g. a string literal)
+//
+// The params may be NULL to use the defaults (software decoding).
+bool
+sc_decoder_init(struct sc_decoder *decoder, const char *name,
+                const struct sc_decoder_params *params);
+
+void
+sc_decoder_destroy(struct sc_decoder *decoder);
+
+// May be called from any thread, applied from the next packet
+void
+sc_decoder_set_fast_decoding(struct sc_decoder *decoder, bool enabled);
+
+// May be called from any thread, applied from the next packet
+//
+// On disabling, a keyframe is requested (if there is a controller), and the
+// packets are dropped until the next keyframe.
 void
-sc_decoder_init(struct sc_decoder *decoder, const char *name);
+sc_decoder_set_keyframes_only(struct sc_decoder *decoder, bool enabled);
 
 #endif
@@ -6,6 +6,7 @@
 #include <libavutil/avutil.h>
 #include <libavformat/avformat.h>
 
+#include "frame_size.h"
 #include "util/log.h"
 
 #define SC_BUFFERING_NDEBUG // comment to debug
@@ -13,9 +14,37 @@
 /** Downcast frame_sink to sc_delay_buffer */
 #define DOWNCAST(SINK) container_of(SINK, struct sc_delay_buffer, frame_sink)
 
+// Frame rate assumed to pre-size the queue from the delay
+#define SC_DELAY_BUFFER_EXPECTED_FPS 60
+// Do not reserve more than this number of frames upfront
+#define SC_DELAY_BUFFER_MAX_RESERVED_FRAMES 1024
+
+// must be called with mutex locked
+static AVFrame *
+sc_delay_buffer_take_frame(struct sc_delay_buffer *db) {
+    if (db->frame_pool.size) {
+        return db->frame_pool.data[--db->frame_pool.size];
+    }
+
+    return av_frame_alloc();
+}
+
+// must be called with mutex locked
+static void
+sc_delay_buffer_release_frame(struct sc_delay_buffer *db, AVFrame *frame) {
+    av_frame_unref(frame);
+
+    // Keep the frame for reuse
+    if (!sc_vector_push(&db->frame_pool, frame)) {
+        av_frame_free(&frame);
+    }
+}
+
+// must be called with mutex locked
 static bool
-sc_delayed_frame_init(struct sc_delayed_frame *dframe, const AVFrame *frame) {
-    dframe->frame = av_frame_alloc();
+sc_delayed_frame_init(struct sc_delay_buffer *db,
+                      struct sc_delayed_frame *dframe, const AVFrame *frame) {
+    dframe->frame = sc_delay_buffer_take_frame(db);
     if (!dframe->frame) {
         LOG_OOM();
         return false;
@@ -23,17 +52,30 @@ sc_delayed_frame_init(struct sc_delayed_frame *dframe, const AVFrame *frame) {
 
     if (av_frame_ref(dframe->frame, frame)) {
         LOG_OOM();
-        av_frame_free(&dframe->frame);
+        sc_delay_buffer_release_frame(db, dframe->frame);
         return false;
     }
 
     return true;
 }
 
+// must be called with mutex locked
 static void
-sc_delayed_frame_destroy(struct sc_delayed_frame *dframe) {
-    av_frame_unref(dframe->frame);
-    av_frame_free(&dframe->frame);
+sc_delayed_frame_destroy(struct sc_delay_buffer *db,
+                         struct sc_delayed_frame *dframe) {
+    sc_delay_buffer_release_frame(db, dframe->frame);
+}
+
+static sc_tick
+sc_delay_buffer_get_delay(struct sc_delay_buffer *db) {
+    if (db->av_sync) {
+        sc_tick latency = sc_av_sync_get_audio_latency(db->av_sync);
+        if (latency > 0) {
+            return latency;
+        }
+    }
+
+    return db->delay;
 }
 
 static int
@@ -55,15 +97,20 @@ run_buffering(void *data) {
         }
 
         struct sc_delayed_frame dframe = sc_vecdeque_pop(&db->queue);
+        sc_stats_set(db->stats, db->queue_stat, db->queue.size);
+        sc_stats_add(db->stats, SC_STAT_MEM_DELAY_BUFFER_BYTES,
+                     -(int64_t) sc_frame_get_size(dframe.frame));
 
-        sc_tick max_deadline = sc_tick_now() + db->delay;
+        // The audio latency may change over time (read once per frame)
+        sc_tick delay = sc_delay_buffer_get_delay(db);
+        sc_tick max_deadline = sc_tick_now() + delay;
         // PTS (written by the server) are expressed in microseconds
         sc_tick pts = SC_TICK_FROM_US(dframe.frame->pts);
 
         bool timed_out = false;
         while (!db->stopped && !timed_out) {
             sc_tick deadline = sc_clock_to_system_time(&db->clock, pts)
-                             + db->delay;
+                             + delay;
             if (deadline > max_deadline) {
                 deadline = max_deadline;
             }
@@ -73,38 +120,46 @@ run_buffering(void *data) {
         }
 
         bool stopped = db->stopped;
-        sc_mutex_unlock(&db->mutex);
-
         if (stopped) {
-            sc_delayed_frame_destroy(&dframe);
+            sc_delayed_frame_destroy(db, &dframe);
+            sc_mutex_unlock(&db->mutex);
             goto stopped;
         }
 
+        sc_mutex_unlock(&db->mutex);
+
 #ifndef SC_BUFFERING_NDEBUG
         LOGD("Buffering: %" PRItick ";%" PRItick ";%" PRItick,
              pts, dframe.push_date, sc_tick_now());
 #endif
 
         bool ok = sc_frame_source_sinks_push(&db->frame_source, dframe.frame);
-        sc_delayed_frame_destroy(&dframe);
+
+        sc_mutex_lock(&db->mutex);
+        sc_delayed_frame_destroy(db, &dframe);
         if (!ok) {
             LOGE("Delayed frame could not be pushed, stopping");
-            sc_mutex_lock(&db->mutex);
             // Prevent to push any new frame
             db->stopped = true;
             sc_mutex_unlock(&db->mutex);
             goto stopped;
         }
+        sc_mutex_unlock(&db->mutex);
     }
 
 stopped:
     assert(db->stopped);
 
     // Flush queue
+    sc_mutex_lock(&db->mutex);
     while (!sc_vecdeque_is_empty(&db->queue)) {
         struct sc_delayed_frame *dframe = sc_vecdeque_popref(&db->queue);
-        sc_delayed_frame_destroy(dframe);
+        sc_stats_add(db->stats, SC_STAT_MEM_DELAY_BUFFER_BYTES,
+                     -(int64_t) sc_frame_get_size(dframe->frame));
+        sc_delayed_frame_destroy(db, dframe);
     }
+    sc_stats_set(db->stats, db->queue_stat, 0);
+    sc_mutex_unlock(&db->mutex);
 
     LOGD("Buffering thread ended");
 
@@ -134,9 +189,22 @@ sc_delay_buffer_frame_sink_open(struct sc_frame_sink *sink,
 
     sc_clock_init(&db->clock);
     sc_vecdeque_init(&db->queue);
+    sc_vector_init(&db->frame_pool);
+    db->stopped = false;
+
+    // Pre-size the queue and the frame pool for the number of frames expected
+    // within the delay, so that no allocation is needed in steady state
+    uint64_t expected = (uint64_t) SC_TICK_TO_MS(db->delay)
+                      * SC_DELAY_BUFFER_EXPECTED_FPS / 1000 + 1;
+    size_t reserved = MIN(expected, SC_DELAY_BUFFER_MAX_RESERVED_FRAMES);
+    if (!sc_vecdeque_reserve(&db->queue, reserved)
+            || !sc_vector_reserve(&db->frame_pool, reserved)) {
+        LOG_OOM();
+        goto error_destroy_queue;
+    }
 
     if (!sc_frame_source_sinks_open(&db->frame_source, ctx)) {
-        goto error_destroy_wait_cond;
+        goto error_destroy_queue;
     }
 
     ok = sc_thread_create(&db->thread, run_buffering, "scrcpy-dbuf", db);
@@ -149,7 +217,9 @@ sc_delay_buffer_frame_sink_open(struct sc_frame_sink *sink,
 
 error_close_sinks:
     sc_frame_source_sinks_close(&db->frame_source);
-error_destroy_wait_cond:
+error_destroy_queue:
+    sc_vector_destroy(&db->frame_pool);
+    sc_vecdeque_destroy(&db->queue);
     sc_cond_destroy(&db->wait_cond);
 error_destroy_queue_cond:
     sc_cond_destroy(&db->queue_cond);
@@ -173,6 +243,12 @@ sc_delay_buffer_frame_sink_close(struct sc_frame_sink *sink) {
 
     sc_frame_source_sinks_close(&db->frame_source);
 
+    for (size_t i = 0; i < db->frame_pool.size; ++i) {
+        av_frame_free(&db->frame_pool.data[i]);
+    }
+    sc_vector_destroy(&db->frame_pool);
+    sc_vecdeque_destroy(&db->queue);
+
     sc_cond_destroy(&db->wait_cond);
     sc_cond_destroy(&db->queue_cond);
     sc_mutex_destroy(&db->mutex);
@@ -200,7 +276,7 @@ sc_delay_buffer_frame_sink_push(struct sc_frame_sink *sink,
     }
 
     struct sc_delayed_frame dframe;
-    bool ok = sc_delayed_frame_init(&dframe, frame);
+    bool ok = sc_delayed_frame_init(db, &dframe, frame);
     if (!ok) {
         sc_mutex_unlock(&db->mutex);
         return false;
@@ -212,11 +288,15 @@ sc_delay_buffer_frame_sink_push(struct sc_frame_sink *sink,
 
     ok = sc_vecdeque_push(&db->queue, dframe);
     if (!ok) {
+        sc_delayed_frame_destroy(db, &dframe);
         sc_mutex_unlock(&db->mutex);
         LOG_OOM();
         return false;
     }
 
+    sc_stats_set(db->stats, db->queue_stat, db->queue.size);
+    sc_stats_add(db->stats, SC_STAT_MEM_DELAY_BUFFER_BYTES,
+                 sc_frame_get_size(dframe.frame));
     sc_cond_signal(&db->queue_cond);
 
     sc_mutex_unlock(&db->mutex);
@@ -224,15 +304,21 @@ sc_delay_buffer_frame_sink_push(struct sc_frame_sink *sink,
     return true;
 }
 
-void
+bool
 sc_delay_buffer_init(struct sc_delay_buffer *db, sc_tick delay,
-                     bool first_frame_asap) {
+                     bool first_frame_asap, struct sc_av_sync *av_sync,
+                     struct sc_stats *stats, enum sc_stat queue_stat) {
     assert(delay > 0);
 
+    if (!sc_frame_source_init(&db->frame_source)) {
+        return false;
+    }
+
     db->delay = delay;
     db->first_frame_asap = first_frame_asap;
-
-    sc_frame_source_init(&db->frame_source);
+    db->av_sync = av_sync;
+    db->stats = stats;
+    db->queue_stat = queue_stat;
 
     static const struct sc_frame_sink_ops ops = {
         .open = sc_delay_buffer_frame_sink_open,
@@ -241,4 +327,11 @@ sc_delay_buffer_init(struct sc_delay_buffer *db, sc_tick delay,
     };
 
     db->frame_sink.ops = &ops;
+
+    return true;
+}
+
+void
+sc_delay_buffer_destroy(struct sc_delay_buffer *db) {
+    sc_frame_source_destroy(&db->frame_source);
 }
@@ -5,12 +5,15 @@
 
 #include <stdbool.h>
 
+#include "av_sync.h"
 #include "clock.h"
+#include "stats.h"
 #include "trait/frame_source.h"
 #include "trait/frame_sink.h"
 #include "util/thread.h"
 #include "util/tick.h"
 #include "util/vecdeque.h"
+#include "util/vector.h"
 
 // forward declarations
 typedef struct AVFrame AVFrame;
@@ -30,6 +33,8 @@ struct sc_delay_buffer {
 
     sc_tick delay;
     bool first_frame_asap;
+    // If set, delay the frames by the audio latency instead (once known)
+    struct sc_av_sync *av_sync; // may be NULL
 
     sc_thread thread;
     sc_mutex mutex;
@@ -38,7 +43,13 @@ struct sc_delay_buffer {
 
     struct sc_clock clock;
     struct sc_delayed_frame_queue queue;
+    // Unreferenced AVFrames, reused to avoid an allocation per frame
+    struct SC_VECTOR(AVFrame *) frame_pool;
     bool stopped;
+
+    struct sc_stats *stats; // may be NULL
+    // The stat gauge to update with the queue length
+    enum sc_stat queue_stat;
 };
 
 struct sc_delay_buffer_callbacks {
@@ -52,9 +63,18 @@ struct sc_delay_buffer_callbacks {
  * \param delay a (strictly) positive delay
  * \param first_frame_asap if true, do not delay the first frame (useful for
                            a video stream).
+ * \param av_sync if not NULL, follow the audio latency to present the frames
+ *                in sync with the audio (the delay is then only used until
+ *                the audio latency is known)
+ * \param stats the stats to report the queue length to (may be NULL)
+ * \param queue_stat the gauge to report the queue length to
  */
-void
+bool
 sc_delay_buffer_init(struct sc_delay_buffer *db, sc_tick delay,
-                     bool first_frame_asap);
+                     bool first_frame_asap, struct sc_av_sync *av_sync,
+                     struct sc_stats *stats, enum sc_stat queue_stat);
+
+void
+sc_delay_buffer_destroy(struct sc_delay_buffer *db);
 
 #endif
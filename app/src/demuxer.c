@@ -8,12 +8,20 @@
 #include "decoder.h"
 #include "events.h"
 #include "packet_merger.h"
+#include "packet_telemetry.h"
 #include "recorder.h"
+#include "startup_timeline.h"
 #include "util/binary.h"
 #include "util/log.h"
+#include "util/tick.h"
+#include "util/trace.h"
 
 #define SC_PACKET_HEADER_SIZE 12
 
+// Read the stream by chunks of this size (packets bigger than this are read
+// directly into the packet buffer)
+#define SC_DEMUXER_READ_BUFFER_SIZE 0x10000
+
 #define SC_PACKET_FLAG_CONFIG    (UINT64_C(1) << 63)
 #define SC_PACKET_FLAG_KEY_FRAME (UINT64_C(1) << 62)
 
@@ -54,10 +62,23 @@ sc_demuxer_to_avcodec_id(uint32_t codec_id) {
     }
 }
 
+static ssize_t
+sc_demuxer_recv_all(struct sc_demuxer *demuxer, void *buf, size_t len) {
+    if (demuxer->replayer) {
+        return sc_stream_replayer_read_all(demuxer->replayer, buf, len);
+    }
+
+    ssize_t r = sc_net_reader_recv_all(&demuxer->reader, buf, len);
+    if (demuxer->dumper && r > 0) {
+        sc_stream_dumper_write(demuxer->dumper, buf, r);
+    }
+    return r;
+}
+
 static bool
 sc_demuxer_recv_codec_id(struct sc_demuxer *demuxer, uint32_t *codec_id) {
     uint8_t data[4];
-    ssize_t r = net_recv_all(demuxer->socket, data, 4);
+    ssize_t r = sc_demuxer_recv_all(demuxer, data, 4);
     if (r < 4) {
         return false;
     }
@@ -70,7 +91,7 @@ static bool
 sc_demuxer_recv_video_size(struct sc_demuxer *demuxer, uint32_t *width,
                            uint32_t *height) {
     uint8_t data[8];
-    ssize_t r = net_recv_all(demuxer->socket, data, 8);
+    ssize_t r = sc_demuxer_recv_all(demuxer, data, 8);
     if (r < 8) {
         return false;
     }
@@ -103,7 +124,7 @@ sc_demuxer_recv_packet(struct sc_demuxer *demuxer, AVPacket *packet) {
     //  `-- config packet
 
     uint8_t header[SC_PACKET_HEADER_SIZE];
-    ssize_t r = net_recv_all(demuxer->socket, header, SC_PACKET_HEADER_SIZE);
+    ssize_t r = sc_demuxer_recv_all(demuxer, header, SC_PACKET_HEADER_SIZE);
     if (r < SC_PACKET_HEADER_SIZE) {
         return false;
     }
@@ -112,12 +133,12 @@ sc_demuxer_recv_packet(struct sc_demuxer *demuxer, AVPacket *packet) {
     uint32_t len = sc_read32be(&header[8]);
     assert(len);
 
-    if (av_new_packet(packet, len)) {
-        LOG_OOM();
+    if (!sc_packet_pool_new_packet(&demuxer->packet_pool, packet, len)) {
+        // Error already logged
         return false;
     }
 
-    r = net_recv_all(demuxer->socket, packet->data, len);
+    r = sc_demuxer_recv_all(demuxer, packet->data, len);
     if (r < 0 || ((uint32_t) r) < len) {
         av_packet_unref(packet);
         return false;
@@ -137,19 +158,56 @@ sc_demuxer_recv_packet(struct sc_demuxer *demuxer, AVPacket *packet) {
     return true;
 }
 
+// Called when a packet could not be received
+static bool
+sc_demuxer_reconnect(struct sc_demuxer *demuxer) {
+    if (demuxer->replayer || !demuxer->cbs->on_reconnect) {
+        return false;
+    }
+
+    LOGW("Demuxer '%s': connection lost, reconnecting...", demuxer->name);
+
+    sc_socket socket =
+        demuxer->cbs->on_reconnect(demuxer, demuxer->cbs_userdata);
+    if (socket == SC_SOCKET_NONE) {
+        LOGE("Demuxer '%s': could not reconnect", demuxer->name);
+        return false;
+    }
+
+    // The previous socket is closed by the callback
+    demuxer->socket = socket;
+    sc_net_reader_reset(&demuxer->reader, socket);
+    sc_stats_add(demuxer->stats, SC_STAT_VIDEO_RECONNECTIONS, 1);
+
+    LOGI("Demuxer '%s': reconnected", demuxer->name);
+    return true;
+}
+
 static int
 run_demuxer(void *data) {
     struct sc_demuxer *demuxer = data;
 
+    sc_thread_apply_role(SC_THREAD_ROLE_DEMUXER);
+    sc_trace_thread_name(demuxer->name);
+
     // Flag to report end-of-stream (i.e. device disconnected)
     enum sc_demuxer_status status = SC_DEMUXER_STATUS_ERROR;
 
+    bool replay = !!demuxer->replayer;
+    if (!replay) {
+        bool ok = sc_net_reader_init(&demuxer->reader, demuxer->socket,
+                                     SC_DEMUXER_READ_BUFFER_SIZE);
+        if (!ok) {
+            goto end;
+        }
+    }
+
     uint32_t raw_codec_id;
     bool ok = sc_demuxer_recv_codec_id(demuxer, &raw_codec_id);
     if (!ok) {
         LOGE("Demuxer '%s': stream disabled due to connection error",
              demuxer->name);
-        goto end;
+        goto finally_destroy_reader;
     }
 
     if (raw_codec_id == 0) {
@@ -157,13 +215,13 @@ run_demuxer(void *data) {
              demuxer->name);
         sc_packet_source_sinks_disable(&demuxer->packet_source);
         status = SC_DEMUXER_STATUS_DISABLED;
-        goto end;
+        goto finally_destroy_reader;
     }
 
     if (raw_codec_id == 1) {
         LOGE("Demuxer '%s': stream configuration error on the device",
              demuxer->name);
-        goto end;
+        goto finally_destroy_reader;
     }
 
     enum AVCodecID codec_id = sc_demuxer_to_avcodec_id(raw_codec_id);
@@ -171,7 +229,7 @@ run_demuxer(void *data) {
         LOGE("Demuxer '%s': stream disabled due to unsupported codec",
              demuxer->name);
         sc_packet_source_sinks_disable(&demuxer->packet_source);
-        goto end;
+        goto finally_destroy_reader;
     }
 
     const AVCodec *codec = avcodec_find_decoder(codec_id);
@@ -179,13 +237,13 @@ run_demuxer(void *data) {
         LOGE("Demuxer '%s': stream disabled due to missing decoder",
              demuxer->name);
         sc_packet_source_sinks_disable(&demuxer->packet_source);
-        goto end;
+        goto finally_destroy_reader;
     }
 
     AVCodecContext *codec_ctx = avcodec_alloc_context3(codec);
     if (!codec_ctx) {
         LOG_OOM();
-        goto end;
+        goto finally_destroy_reader;
     }
 
     codec_ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
@@ -204,12 +262,13 @@ run_demuxer(void *data) {
     } else {
         // Hardcoded audio properties
 #ifdef SCRCPY_LAVU_HAS_CHLAYOUT
-        codec_ctx->ch_layout = (AVChannelLayout) AV_CHANNEL_LAYOUT_STEREO;
+        av_channel_layout_default(&codec_ctx->ch_layout, demuxer->channels);
 #else
-        codec_ctx->channel_layout = AV_CH_LAYOUT_STEREO;
-        codec_ctx->channels = 2;
+        codec_ctx->channel_layout =
+            av_get_default_channel_layout(demuxer->channels);
+        codec_ctx->channels = demuxer->channels;
 #endif
-        codec_ctx->sample_rate = 48000;
+        codec_ctx->sample_rate = demuxer->sample_rate;
 
         if (raw_codec_id == SC_CODEC_ID_FLAC) {
             // The sample_fmt is not set by the FLAC decoder
@@ -234,7 +293,7 @@ run_demuxer(void *data) {
     struct sc_packet_merger merger;
 
     if (must_merge_config_packet) {
-        sc_packet_merger_init(&merger);
+        sc_packet_merger_init(&merger, demuxer->stats);
     }
 
     AVPacket *packet = av_packet_alloc();
@@ -243,14 +302,74 @@ run_demuxer(void *data) {
         goto finally_close_sinks;
     }
 
+    bool is_video = codec->type == AVMEDIA_TYPE_VIDEO;
+    enum sc_stat stat_packets = is_video ? SC_STAT_VIDEO_PACKETS
+                                         : SC_STAT_AUDIO_PACKETS;
+    enum sc_stat stat_bytes = is_video ? SC_STAT_VIDEO_BYTES
+                                       : SC_STAT_AUDIO_BYTES;
+    enum sc_stat stat_config_packets = is_video ? SC_STAT_VIDEO_CONFIG_PACKETS
+                                                : SC_STAT_AUDIO_CONFIG_PACKETS;
+    enum sc_stat stat_bitrate = is_video ? SC_STAT_VIDEO_ENCODED_BITRATE
+                                         : SC_STAT_AUDIO_ENCODED_BITRATE;
+    enum sc_stat stat_jitter = is_video ? SC_STAT_VIDEO_JITTER_US
+                                        : SC_STAT_AUDIO_JITTER_US;
+
+    // Only used if stats are enabled
+    struct sc_packet_telemetry telemetry;
+    sc_packet_telemetry_init(&telemetry);
+    int max_keyframe_size = 0;
+
     for (;;) {
+        sc_trace_begin("recv");
         bool ok = sc_demuxer_recv_packet(demuxer, packet);
+        sc_trace_end();
+        if (!ok && sc_demuxer_reconnect(demuxer)) {
+            // The stream resumes on the new connection (the device restarted
+            // the encoding, the next packets refer to a new config packet)
+            continue;
+        }
         if (!ok) {
             // end of stream
             status = SC_DEMUXER_STATUS_EOS;
             break;
         }
 
+        sc_stats_add(demuxer->stats, stat_packets, 1);
+        sc_stats_add(demuxer->stats, stat_bytes, packet->size);
+
+        if (demuxer->stats) {
+            if (packet->pts == AV_NOPTS_VALUE) {
+                sc_stats_add(demuxer->stats, stat_config_packets, 1);
+            } else {
+                sc_packet_telemetry_push(&telemetry, packet->pts,
+                                         packet->size, sc_tick_now());
+                sc_stats_set(demuxer->stats, stat_bitrate,
+                             sc_packet_telemetry_get_bitrate(&telemetry));
+                sc_stats_set(demuxer->stats, stat_jitter,
+                             SC_TICK_TO_US(
+                                sc_packet_telemetry_get_jitter(&telemetry)));
+
+                if (is_video && (packet->flags & AV_PKT_FLAG_KEY)) {
+                    sc_stats_add(demuxer->stats, SC_STAT_VIDEO_KEYFRAMES, 1);
+                    sc_stats_add(demuxer->stats, SC_STAT_VIDEO_KEYFRAME_BYTES,
+                                 packet->size);
+                    sc_stats_set(demuxer->stats,
+                                 SC_STAT_VIDEO_KEYFRAME_LAST_BYTES,
+                                 packet->size);
+                    if (packet->size > max_keyframe_size) {
+                        max_keyframe_size = packet->size;
+                        sc_stats_set(demuxer->stats,
+                                     SC_STAT_VIDEO_KEYFRAME_MAX_BYTES,
+                                     max_keyframe_size);
+                    }
+                }
+            }
+        }
+
+        if (is_video && packet->pts == AV_NOPTS_VALUE) {
+            sc_startup_timeline_mark(SC_STARTUP_FIRST_CONFIG_PACKET);
+        }
+
         if (must_merge_config_packet) {
             // Prepend any config packet to the next media packet
             ok = sc_packet_merger_merge(&merger, packet);
@@ -260,7 +379,9 @@ run_demuxer(void *data) {
             }
         }
 
+        sc_trace_begin_pts("push", packet->pts);
         ok = sc_packet_source_sinks_push(&demuxer->packet_source, packet);
+        sc_trace_end();
         av_packet_unref(packet);
         if (!ok) {
             // The sink already logged its concrete error
@@ -269,36 +390,86 @@ run_demuxer(void *data) {
     }
 
     LOGD("Demuxer '%s': end of frames", demuxer->name);
+    LOGD("Demuxer '%s': packet pool: %" PRIu64_ " hits, %" PRIu64_ " misses",
+         demuxer->name, demuxer->packet_pool.hits,
+         demuxer->packet_pool.misses);
 
     if (must_merge_config_packet) {
         sc_packet_merger_destroy(&merger);
     }
 
     av_packet_free(&packet);
+    sc_packet_pool_destroy(&demuxer->packet_pool);
 finally_close_sinks:
     sc_packet_source_sinks_close(&demuxer->packet_source);
 finally_free_context:
     // This also calls avcodec_close() internally
     avcodec_free_context(&codec_ctx);
+finally_destroy_reader:
+    if (!replay) {
+        sc_net_reader_destroy(&demuxer->reader);
+    }
 end:
     demuxer->cbs->on_ended(demuxer, status, demuxer->cbs_userdata);
 
     return 0;
 }
 
-void
-sc_demuxer_init(struct sc_demuxer *demuxer, const char *name, sc_socket socket,
-                const struct sc_demuxer_callbacks *cbs, void *cbs_userdata) {
-    assert(socket != SC_SOCKET_NONE);
+static bool
+sc_demuxer_init_common(struct sc_demuxer *demuxer, const char *name,
+                       sc_socket socket, struct sc_stream_replayer *replayer,
+                       uint32_t sample_rate, uint8_t channels,
+                       struct sc_stats *stats,
+                       const struct sc_demuxer_callbacks *cbs,
+                       void *cbs_userdata) {
+    if (!sc_packet_source_init(&demuxer->packet_source)) {
+        return false;
+    }
 
     demuxer->name = name; // statically allocated
     demuxer->socket = socket;
-    sc_packet_source_init(&demuxer->packet_source);
+    demuxer->replayer = replayer;
+    demuxer->dumper = NULL;
+    demuxer->sample_rate = sample_rate;
+    demuxer->channels = channels;
+    demuxer->stats = stats;
+    sc_packet_pool_init(&demuxer->packet_pool, stats);
 
     assert(cbs && cbs->on_ended);
 
     demuxer->cbs = cbs;
     demuxer->cbs_userdata = cbs_userdata;
+
+    return true;
+}
+
+bool
+sc_demuxer_init(struct sc_demuxer *demuxer, const char *name, sc_socket socket,
+                uint32_t sample_rate, uint8_t channels, struct sc_stats *stats,
+                const struct sc_demuxer_callbacks *cbs, void *cbs_userdata) {
+    assert(socket != SC_SOCKET_NONE);
+    return sc_demuxer_init_common(demuxer, name, socket, NULL, sample_rate,
+                                  channels, stats, cbs, cbs_userdata);
+}
+
+bool
+sc_demuxer_init_replay(struct sc_demuxer *demuxer, const char *name,
+                       struct sc_stream_replayer *replayer,
+                       uint32_t sample_rate, uint8_t channels,
+                       struct sc_stats *stats,
+                       const struct sc_demuxer_callbacks *cbs,
+                       void *cbs_userdata) {
+    assert(replayer);
+    return sc_demuxer_init_common(demuxer, name, SC_SOCKET_NONE, replayer,
+                                  sample_rate, channels, stats, cbs,
+                                  cbs_userdata);
+}
+
+void
+sc_demuxer_set_dumper(struct sc_demuxer *demuxer,
+                      struct sc_stream_dumper *dumper) {
+    assert(!demuxer->replayer);
+    demuxer->dumper = dumper;
 }
 
 bool
@@ -318,3 +489,8 @@ void
 sc_demuxer_join(struct sc_demuxer *demuxer) {
     sc_thread_join(&demuxer->thread, NULL);
 }
+
+void
+sc_demuxer_destroy(struct sc_demuxer *demuxer) {
+    sc_packet_source_destroy(&demuxer->packet_source);
+}
@@ -8,6 +8,9 @@
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 
+#include "packet_pool.h"
+#include "stats.h"
+#include "stream_dump.h"
 #include "trait/packet_source.h"
 #include "trait/packet_sink.h"
 #include "util/net.h"
@@ -18,9 +21,27 @@ struct sc_demuxer {
 
     const char *name; // must be statically allocated (e.g. a string literal)
 
-    sc_socket socket;
+    sc_socket socket; // SC_SOCKET_NONE if the stream is replayed
     sc_thread thread;
 
+    struct sc_stream_dumper *dumper; // may be NULL
+    // If not NULL, the stream is read from a dump instead of the socket
+    struct sc_stream_replayer *replayer;
+
+    // Only accessed from the demuxer thread
+    struct sc_net_reader reader;
+
+    // Only accessed from the demuxer thread (the counters may be read once
+    // the demuxer is joined)
+    struct sc_packet_pool packet_pool;
+
+    // The audio sample rate and number of channels (unused for a video
+    // stream)
+    uint32_t sample_rate;
+    uint8_t channels;
+
+    struct sc_stats *stats; // may be NULL
+
     const struct sc_demuxer_callbacks *cbs;
     void *cbs_userdata;
 };
@@ -34,17 +55,48 @@ enum sc_demuxer_status {
 struct sc_demuxer_callbacks {
     void (*on_ended)(struct sc_demuxer *demuxer, enum sc_demuxer_status,
                      void *userdata);
+
+    /**
+     * Called from the demuxer thread when the connection is lost, to get a
+     * new socket resuming the stream (or SC_SOCKET_NONE to end the stream)
+     *
+     * The resumed stream has no header, and starts with a config packet and
+     * a keyframe. May be NULL (the stream ends).
+     */
+    sc_socket (*on_reconnect)(struct sc_demuxer *demuxer, void *userdata);
 };
 
 // The name must be statically allocated (e.g. a string literal)
-void
+//
+// The sample rate and the channels are only used for an audio stream. The
+// stats may be NULL.
+bool
 sc_demuxer_init(struct sc_demuxer *demuxer, const char *name, sc_socket socket,
+                uint32_t sample_rate, uint8_t channels, struct sc_stats *stats,
                 const struct sc_demuxer_callbacks *cbs, void *cbs_userdata);
 
+// Read the stream from a dump (see sc_stream_dumper) instead of a socket
+bool
+sc_demuxer_init_replay(struct sc_demuxer *demuxer, const char *name,
+                       struct sc_stream_replayer *replayer,
+                       uint32_t sample_rate, uint8_t channels,
+                       struct sc_stats *stats,
+                       const struct sc_demuxer_callbacks *cbs,
+                       void *cbs_userdata);
+
+// Dump the data received from the socket (must be called before
+// sc_demuxer_start())
+void
+sc_demuxer_set_dumper(struct sc_demuxer *demuxer,
+                      struct sc_stream_dumper *dumper);
+
 bool
 sc_demuxer_start(struct sc_demuxer *demuxer);
 
 void
 sc_demuxer_join(struct sc_demuxer *demuxer);
 
+void
+sc_demuxer_destroy(struct sc_demuxer *demuxer);
+
 #endif
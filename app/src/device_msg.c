@@ -1,7 +1,6 @@
 #include "device_msg.h"
 
 #include <stdint.h>
-#include <stdlib.h>
 #include <string.h>
 
 #include "util/binary.h"
@@ -9,14 +8,15 @@
 
 ssize_t
 sc_device_msg_deserialize(const uint8_t *buf, size_t len,
-                          struct sc_device_msg *msg) {
+                          struct sc_arena *arena, struct sc_device_msg *msg) {
     if (!len) {
         return 0; // no message
     }
 
     msg->type = buf[0];
     switch (msg->type) {
-        case DEVICE_MSG_TYPE_CLIPBOARD: {
+        case DEVICE_MSG_TYPE_CLIPBOARD:
+        case DEVICE_MSG_TYPE_CLIPBOARD_CHUNK: {
             if (len < 5) {
                 // at least type + empty string length
                 return 0; // no complete message
@@ -25,7 +25,7 @@ sc_device_msg_deserialize(const uint8_t *buf, size_t len,
             if (clipboard_len > len - 5) {
                 return 0; // no complete message
             }
-            char *text = malloc(clipboard_len + 1);
+            char *text = sc_arena_alloc(arena, clipboard_len + 1);
             if (!text) {
                 LOG_OOM();
                 return -1;
@@ -35,7 +35,11 @@ sc_device_msg_deserialize(const uint8_t *buf, size_t len,
             }
             text[clipboard_len] = '\0';
 
-            msg->clipboard.text = text;
+            if (msg->type == DEVICE_MSG_TYPE_CLIPBOARD) {
+                msg->clipboard.text = text;
+            } else {
+                msg->clipboard_chunk.text = text;
+            }
             return 5 + clipboard_len;
         }
         case DEVICE_MSG_TYPE_ACK_CLIPBOARD: {
@@ -53,10 +57,10 @@ sc_device_msg_deserialize(const uint8_t *buf, size_t len,
             }
             uint16_t id = sc_read16be(&buf[1]);
             size_t size = sc_read16be(&buf[3]);
-            if (size < len - 5) {
+            if (size > len - 5) {
                 return 0; // not available
             }
-            uint8_t *data = malloc(size);
+            uint8_t *data = sc_arena_alloc(arena, size);
             if (!data) {
                 LOG_OOM();
                 return -1;
@@ -71,23 +75,50 @@ sc_device_msg_deserialize(const uint8_t *buf, size_t len,
 
             return 5 + size;
         }
+        case DEVICE_MSG_TYPE_VIDEO_DROPPED: {
+            if (len < 5) {
+                return 0; // no complete message
+            }
+            msg->video_dropped.total = sc_read32be(&buf[1]);
+            return 5;
+        }
+        case DEVICE_MSG_TYPE_INJECTION_LATENCY: {
+            if (len < 9) {
+                return 0; // no complete message
+            }
+            msg->injection_latency.p50 = sc_read32be(&buf[1]);
+            msg->injection_latency.p99 = sc_read32be(&buf[5]);
+            return 9;
+        }
+        case DEVICE_MSG_TYPE_ENCODER_STATS: {
+            if (len < 17) {
+                return 0; // no complete message
+            }
+            msg->encoder_stats.encode_p50 = sc_read32be(&buf[1]);
+            msg->encoder_stats.encode_p99 = sc_read32be(&buf[5]);
+            msg->encoder_stats.write_block_p50 = sc_read32be(&buf[9]);
+            msg->encoder_stats.write_block_p99 = sc_read32be(&buf[13]);
+            return 17;
+        }
+        case DEVICE_MSG_TYPE_CLOCK_PONG: {
+            if (len < 17) {
+                return 0; // no complete message
+            }
+            msg->clock_pong.client_time = sc_read64be(&buf[1]);
+            msg->clock_pong.device_time = sc_read64be(&buf[9]);
+            return 17;
+        }
+        case DEVICE_MSG_TYPE_THERMAL_STATE: {
+            if (len < 4) {
+                return 0; // no complete message
+            }
+            msg->thermal_state.status = (int8_t) buf[1];
+            msg->thermal_state.battery_level = (int8_t) buf[2];
+            msg->thermal_state.level = buf[3];
+            return 4;
+        }
         default:
             LOGW("Unknown device message type: %d", (int) msg->type);
             return -1; // error, we cannot recover
     }
 }
-
-void
-sc_device_msg_destroy(struct sc_device_msg *msg) {
-    switch (msg->type) {
-        case DEVICE_MSG_TYPE_CLIPBOARD:
-            free(msg->clipboard.text);
-            break;
-        case DEVICE_MSG_TYPE_UHID_OUTPUT:
-            free(msg->uhid_output.data);
-            break;
-        default:
-            // nothing to do
-            break;
-    }
-}
@@ -7,39 +7,92 @@
 #include <stdint.h>
 #include <unistd.h>
 
+#include "util/memory.h"
+
 #define DEVICE_MSG_MAX_SIZE (1 << 18) // 256k
 // type: 1 byte; length: 4 bytes
 #define DEVICE_MSG_TEXT_MAX_LENGTH (DEVICE_MSG_MAX_SIZE - 5)
+// A larger clipboard text is received as several CLIPBOARD_CHUNK messages,
+// followed by a final CLIPBOARD message
+#define DEVICE_MSG_CLIPBOARD_MAX_LENGTH (1 << 24) // 16M
 
 enum sc_device_msg_type {
     DEVICE_MSG_TYPE_CLIPBOARD,
     DEVICE_MSG_TYPE_ACK_CLIPBOARD,
     DEVICE_MSG_TYPE_UHID_OUTPUT,
+    DEVICE_MSG_TYPE_VIDEO_DROPPED,
+    DEVICE_MSG_TYPE_INJECTION_LATENCY,
+    DEVICE_MSG_TYPE_CLIPBOARD_CHUNK,
+    DEVICE_MSG_TYPE_ENCODER_STATS,
+    // Not a message: wraps a large serialized message (only written by the
+    // device if compression is enabled, unwrapped by the receiver)
+    DEVICE_MSG_TYPE_COMPRESSED,
+    DEVICE_MSG_TYPE_CLOCK_PONG,
+    DEVICE_MSG_TYPE_THERMAL_STATE,
 };
 
 struct sc_device_msg {
     enum sc_device_msg_type type;
     union {
         struct {
-            char *text; // owned, to be freed by free()
+            char *text; // allocated from the arena
         } clipboard;
+        struct {
+            // raw bytes, may split a UTF-8 sequence (allocated from the arena)
+            char *text;
+        } clipboard_chunk;
         struct {
             uint64_t sequence;
         } ack_clipboard;
         struct {
             uint16_t id;
             uint16_t size;
-            uint8_t *data; // owned, to be freed by free()
+            uint8_t *data; // allocated from the arena
         } uhid_output;
+        struct {
+            // total number of frames dropped by the device due to congestion
+            uint32_t total;
+        } video_dropped;
+        struct {
+            // percentiles of the delay between the reception of an input
+            // event by the device and its injection, in microseconds
+            uint32_t p50;
+            uint32_t p99;
+        } injection_latency;
+        struct {
+            // percentiles of the delay between the capture of a video frame
+            // and the encoder output, in microseconds
+            uint32_t encode_p50;
+            uint32_t encode_p99;
+            // percentiles of the time spent writing a video packet to the
+            // socket (i.e. blocked on the network), in microseconds
+            uint32_t write_block_p50;
+            uint32_t write_block_p99;
+        } encoder_stats;
+        struct {
+            // client time of the CLOCK_PING message, in microseconds
+            uint64_t client_time;
+            // device monotonic time (the clock of the video PTS) when the
+            // ping was received, in microseconds
+            uint64_t device_time;
+        } clock_pong;
+        struct {
+            // android.os.PowerManager.THERMAL_STATUS_* (-1 if unknown)
+            int8_t status;
+            // in percent (-1 if unknown)
+            int8_t battery_level;
+            // level applied by the thermal governor (0 for no limit)
+            uint8_t level;
+        } thermal_state;
     };
 };
 
 // return the number of bytes consumed (0 for no msg available, -1 on error)
+//
+// The message payload (if any) is allocated from the arena, so it is valid
+// until the arena is reset (there is nothing to destroy).
 ssize_t
 sc_device_msg_deserialize(const uint8_t *buf, size_t len,
-                          struct sc_device_msg *msg);
-
-void
-sc_device_msg_destroy(struct sc_device_msg *msg);
+                          struct sc_arena *arena, struct sc_device_msg *msg);
 
 #endif
@@ -1,11 +1,26 @@
 #include "display.h"
 
 #include <assert.h>
+#include <string.h>
+#include <libavutil/pixdesc.h>
 
 #include "util/log.h"
 
+#ifndef SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
+static bool
+sc_display_supports_format(const SDL_RendererInfo *info, uint32_t format) {
+    for (uint32_t i = 0; i < info->num_texture_formats; ++i) {
+        if (info->texture_formats[i] == format) {
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
 bool
-sc_display_init(struct sc_display *display, SDL_Window *window, bool mipmaps) {
+sc_display_init(struct sc_display *display, SDL_Window *window, bool mipmaps,
+                enum sc_upscale_filter upscale_filter) {
     display->renderer =
         SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
     if (!display->renderer) {
@@ -19,6 +34,17 @@ sc_display_init(struct sc_display *display, SDL_Window *window, bool mipmaps) {
     LOGI("Renderer: %s", renderer_name ? renderer_name : "(unknown)");
 
     display->mipmaps = false;
+    display->mipmap_max_level = false;
+    display->use_pbo = false;
+    display->pbos_created = false;
+#ifdef SC_DISPLAY_HAS_HDR
+    display->hdr_available = false;
+    display->hdr_initialized = false;
+    display->orientation = SC_ORIENTATION_0;
+    display->upscaled = false;
+#endif
+    display->hdr_frame = false;
+    display->upscale_filter = upscale_filter;
 
     // starts with "opengl"
     bool use_opengl = renderer_name && !strncmp(renderer_name, "opengl", 6);
@@ -51,6 +77,9 @@ sc_display_init(struct sc_display *display, SDL_Window *window, bool mipmaps) {
             if (supports_mipmaps) {
                 LOGI("Trilinear filtering enabled");
                 display->mipmaps = true;
+                display->mipmap_max_level =
+                    sc_opengl_version_at_least(gl, 1, 2, /* OpenGL 1.2+ */
+                                                   3, 0  /* OpenGL ES 3.0+ */);
             } else {
                 LOGW("Trilinear filtering disabled "
                      "(OpenGL 3.0+ or ES 2.0+ required)");
@@ -58,15 +87,83 @@ sc_display_init(struct sc_display *display, SDL_Window *window, bool mipmaps) {
         } else {
             LOGI("Trilinear filtering disabled");
         }
+
+#ifndef SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
+        // The planes of the YUV texture are uploaded directly, so the YUV
+        // format must be natively supported by the (desktop) OpenGL renderer
+        if (!strcmp(renderer_name, "opengl")
+                && sc_display_supports_format(&renderer_info,
+                                              SDL_PIXELFORMAT_YV12)
+                && sc_opengl_has_pbo(gl)) {
+            gl->GenBuffers(SC_DISPLAY_PBO_COUNT, display->pbos);
+            display->pbos_created = true;
+            display->pbo_index = 0;
+            display->use_pbo = true;
+            LOGD("Asynchronous texture uploads enabled");
+        }
+#endif
+
+#ifdef SC_DISPLAY_HAS_HDR
+        // The shader is drawn directly in the context of the (desktop)
+        // OpenGL renderer
+        display->hdr_available = !strcmp(renderer_name, "opengl")
+                              && sc_opengl_has_shaders(gl);
+#endif
     } else if (mipmaps) {
         LOGD("Trilinear filtering disabled (not an OpenGL renderer)");
     }
 
+    if (upscale_filter == SC_UPSCALE_FILTER_LANCZOS) {
+#ifdef SC_DISPLAY_HAS_HDR
+        bool lanczos = display->hdr_available;
+#else
+        bool lanczos = false;
+#endif
+        if (lanczos) {
+            LOGI("Lanczos upscaling enabled");
+        } else {
+            LOGW("Lanczos upscaling disabled (OpenGL renderer with shaders "
+                 "required)");
+            display->upscale_filter = SC_UPSCALE_FILTER_LINEAR;
+        }
+    }
+
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    display->hw_download_frame = av_frame_alloc();
+    if (!display->hw_download_frame) {
+        LOG_OOM();
+        goto error_destroy_renderer;
+    }
+
+    bool allow_nv12 = false;
+#ifdef SCRCPY_SDL_HAS_UPDATE_NV_TEXTURE
+    allow_nv12 = true;
+#endif
+    if (!sc_hwframe_downloader_init(&display->downloader, allow_nv12)) {
+        av_frame_free(&display->hw_download_frame);
+        goto error_destroy_renderer;
+    }
+#endif
+
     display->texture = NULL;
+    // Software decoders produce YUV420P frames
+    display->texture_format = SDL_PIXELFORMAT_YV12;
     display->pending.flags = 0;
     display->pending.frame = NULL;
 
     return true;
+
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+error_destroy_renderer:
+    if (display->pbos_created) {
+        display->gl.DeleteBuffers(SC_DISPLAY_PBO_COUNT, display->pbos);
+    }
+#ifdef SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
+    SDL_GL_DeleteContext(display->gl_context);
+#endif
+    SDL_DestroyRenderer(display->renderer);
+    return false;
+#endif
 }
 
 void
@@ -74,6 +171,18 @@ sc_display_destroy(struct sc_display *display) {
     if (display->pending.frame) {
         av_frame_free(&display->pending.frame);
     }
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    sc_hwframe_downloader_destroy(&display->downloader);
+    av_frame_free(&display->hw_download_frame);
+#endif
+    if (display->pbos_created) {
+        display->gl.DeleteBuffers(SC_DISPLAY_PBO_COUNT, display->pbos);
+    }
+#ifdef SC_DISPLAY_HAS_HDR
+    if (display->hdr_initialized) {
+        sc_hdr_renderer_destroy(&display->hdr);
+    }
+#endif
 #ifdef SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
     SDL_GL_DeleteContext(display->gl_context);
 #endif
@@ -83,11 +192,25 @@ sc_display_destroy(struct sc_display *display) {
     SDL_DestroyRenderer(display->renderer);
 }
 
+static uint32_t
+sc_display_to_sdl_pixel_format(enum AVPixelFormat fmt) {
+    switch (fmt) {
+        case AV_PIX_FMT_YUV420P:
+            return SDL_PIXELFORMAT_YV12;
+#ifdef SCRCPY_SDL_HAS_UPDATE_NV_TEXTURE
+        case AV_PIX_FMT_NV12:
+            return SDL_PIXELFORMAT_NV12;
+#endif
+        default:
+            return SDL_PIXELFORMAT_UNKNOWN;
+    }
+}
+
 static SDL_Texture *
 sc_display_create_texture(struct sc_display *display,
                           struct sc_size size) {
     SDL_Renderer *renderer = display->renderer;
-    SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_YV12,
+    SDL_Texture *texture = SDL_CreateTexture(renderer, display->texture_format,
                                              SDL_TEXTUREACCESS_STREAMING,
                                              size.width, size.height);
     if (!texture) {
@@ -105,12 +228,94 @@ sc_display_create_texture(struct sc_display *display,
                           GL_LINEAR_MIPMAP_LINEAR);
         gl->TexParameterf(GL_TEXTURE_2D, GL_TEXTURE_LOD_BIAS, -1.f);
 
+        // The mipmaps are generated only once the frame is downscaled (see
+        // sc_display_update_mipmaps())
+        display->mipmap_levels = 0;
+        display->mipmaps_stale = true;
+        if (display->mipmap_max_level) {
+            // Complete with the base level only
+            gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+            display->mipmaps_complete = true;
+        } else {
+            display->mipmaps_complete = false;
+        }
+
         SDL_GL_UnbindTexture(texture);
     }
 
     return texture;
 }
 
+// Return the number of mipmap levels sampled when the texture is rendered to
+// a rect of the given size. With a LOD bias of -1, the level of detail is
+// log2(scale) - 1, so the mipmaps are only sampled for a downscaling factor
+// greater than 2.
+static unsigned
+sc_display_get_mipmap_levels(struct sc_size texture_size,
+                             struct sc_size rect_size) {
+    if (!rect_size.width || !rect_size.height) {
+        return 0;
+    }
+
+    uint64_t tw = texture_size.width;
+    uint64_t th = texture_size.height;
+    unsigned levels = 0;
+    // Levels up to ceil(log2(scale) - 1) are sampled
+    while (levels < 16 && (tw > (uint64_t) rect_size.width << (levels + 1)
+                        || th > (uint64_t) rect_size.height << (levels + 1))) {
+        ++levels;
+    }
+    return levels;
+}
+
+static void
+sc_display_generate_mipmaps(struct sc_display *display) {
+    SDL_GL_BindTexture(display->texture, NULL, NULL);
+    display->gl.GenerateMipmap(GL_TEXTURE_2D);
+    SDL_GL_UnbindTexture(display->texture);
+    display->mipmaps_stale = false;
+    display->mipmaps_complete = true;
+}
+
+// Adapt the mipmaps to the rendering size, before rendering the texture
+static void
+sc_display_update_mipmaps(struct sc_display *display, const SDL_Rect *geometry,
+                          enum sc_orientation orientation) {
+    int tw;
+    int th;
+    if (SDL_QueryTexture(display->texture, NULL, NULL, &tw, &th)) {
+        return;
+    }
+
+    struct sc_size texture_size = {tw, th};
+    struct sc_size rect_size = {geometry->w, geometry->h};
+    if (sc_orientation_is_swap(orientation)) {
+        rect_size.width = geometry->h;
+        rect_size.height = geometry->w;
+    }
+
+    unsigned levels = sc_display_get_mipmap_levels(texture_size, rect_size);
+    if (levels != display->mipmap_levels) {
+        if (display->mipmap_max_level) {
+            struct sc_opengl *gl = &display->gl;
+            SDL_GL_BindTexture(display->texture, NULL, NULL);
+            gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels);
+            SDL_GL_UnbindTexture(display->texture);
+        }
+
+        if (levels > display->mipmap_levels) {
+            // The additional levels have never been generated
+            display->mipmaps_stale = true;
+        }
+        display->mipmap_levels = levels;
+    }
+
+    if (levels && display->mipmaps_stale) {
+        // For example, the window has been shrunk since the last frame
+        sc_display_generate_mipmaps(display);
+    }
+}
+
 static inline void
 sc_display_set_pending_size(struct sc_display *display, struct sc_size size) {
     assert(!display->texture);
@@ -196,22 +401,234 @@ sc_display_set_texture_size(struct sc_display *display, struct sc_size size) {
     return SC_DISPLAY_RESULT_OK;
 }
 
+static void
+sc_display_copy_plane(uint8_t *dst, const uint8_t *src, int linesize,
+                      int width, int height) {
+    if (linesize == width) {
+        memcpy(dst, src, (size_t) width * height);
+        return;
+    }
+
+    for (int y = 0; y < height; ++y) {
+        memcpy(dst, src, width);
+        dst += width;
+        src += linesize;
+    }
+}
+
+// Upload a YUV420P frame through the next pixel buffer object of the ring
+//
+// The texture planes are bound by SDL_GL_BindTexture() on the texture units 0
+// (Y), 1 (U) and 2 (V). On error, the caller must fall back to
+// SDL_UpdateYUVTexture().
+static bool
+sc_display_update_texture_pbo(struct sc_display *display,
+                              const AVFrame *frame) {
+    struct sc_opengl *gl = &display->gl;
+
+    float texw;
+    float texh;
+    // It also flushes the pending SDL render commands
+    if (SDL_GL_BindTexture(display->texture, &texw, &texh)) {
+        LOGW("Could not bind texture, asynchronous uploads disabled: %s",
+             SDL_GetError());
+        display->use_pbo = false;
+        return false;
+    }
+
+    if (texw != 1.f || texh != 1.f) {
+        // Not a GL_TEXTURE_2D with the exact frame size
+        LOGW("Unexpected texture type, asynchronous uploads disabled");
+        SDL_GL_UnbindTexture(display->texture);
+        display->use_pbo = false;
+        return false;
+    }
+
+    int w = frame->width;
+    int h = frame->height;
+    int cw = (w + 1) / 2;
+    int ch = (h + 1) / 2;
+    size_t y_size = (size_t) w * h;
+    size_t c_size = (size_t) cw * ch;
+
+    GLuint pbo = display->pbos[display->pbo_index];
+    display->pbo_index = (display->pbo_index + 1) % SC_DISPLAY_PBO_COUNT;
+
+    gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    // Orphan the previous storage, so that the mapping never waits for the
+    // GPU to finish reading it
+    gl->BufferData(GL_PIXEL_UNPACK_BUFFER, y_size + 2 * c_size, NULL,
+                   GL_STREAM_DRAW);
+    uint8_t *data = gl->MapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    if (!data) {
+        LOGW("Could not map pixel buffer, asynchronous uploads disabled");
+        gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        SDL_GL_UnbindTexture(display->texture);
+        display->use_pbo = false;
+        return false;
+    }
+
+    sc_display_copy_plane(data, frame->data[0], frame->linesize[0], w, h);
+    sc_display_copy_plane(data + y_size, frame->data[1], frame->linesize[1],
+                          cw, ch);
+    sc_display_copy_plane(data + y_size + c_size, frame->data[2],
+                          frame->linesize[2], cw, ch);
+
+    if (!gl->UnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+        // The buffer content has been lost, it will be uploaded again by SDL
+        gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        SDL_GL_UnbindTexture(display->texture);
+        return false;
+    }
+
+    gl->PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    gl->PixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+    // The pixels are read from the buffer (the offsets are passed as
+    // pointers), the calls return without waiting for the copy
+    gl->ActiveTexture(GL_TEXTURE2);
+    gl->TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, cw, ch, GL_LUMINANCE,
+                      GL_UNSIGNED_BYTE, (const void *) (y_size + c_size));
+    gl->ActiveTexture(GL_TEXTURE1);
+    gl->TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, cw, ch, GL_LUMINANCE,
+                      GL_UNSIGNED_BYTE, (const void *) y_size);
+    gl->ActiveTexture(GL_TEXTURE0);
+    gl->TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_LUMINANCE,
+                      GL_UNSIGNED_BYTE, (const void *) 0);
+
+    gl->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    SDL_GL_UnbindTexture(display->texture);
+
+    return true;
+}
+
+static bool
+sc_display_update_hdr(struct sc_display *display, const AVFrame *frame) {
+#ifdef SC_DISPLAY_HAS_HDR
+    if (!display->hdr_available) {
+        LOGE("10-bit frames require the OpenGL renderer with shaders "
+             "(OpenGL 2.0+)");
+        return false;
+    }
+
+    if (!display->hdr_initialized) {
+        if (!sc_hdr_renderer_init(&display->hdr, &display->gl,
+                                  display->mipmaps, display->upscale_filter)) {
+            LOGE("Could not initialize the HDR renderer");
+            display->hdr_available = false;
+            return false;
+        }
+        display->hdr_initialized = true;
+        LOGI("Frames rendered by shader");
+    }
+
+    if (!sc_hdr_renderer_update(&display->hdr, frame)) {
+        return false;
+    }
+
+    display->hdr_frame = true;
+    return true;
+#else
+    (void) display;
+    (void) frame;
+    LOGE("10-bit frames are not supported by this build (SDL 2.0.10+ "
+         "required, not available with the OpenGL core profile)");
+    return false;
+#endif
+}
+
 static bool
 sc_display_update_texture_internal(struct sc_display *display,
                                    const AVFrame *frame) {
-    int ret = SDL_UpdateYUVTexture(display->texture, NULL,
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    if (frame->hw_frames_ctx) {
+        AVFrame *dl_frame = display->hw_download_frame;
+        bool ok = sc_hwframe_downloader_download(&display->downloader,
+                                                 dl_frame, frame);
+        if (!ok) {
+            return false;
+        }
+
+        ok = sc_display_update_texture_internal(display, dl_frame);
+        av_frame_unref(dl_frame);
+        return ok;
+    }
+#endif
+
+    if (sc_hdr_renderer_supports_format(frame->format)) {
+        return sc_display_update_hdr(display, frame);
+    }
+
+#ifdef SC_DISPLAY_HAS_HDR
+    if (display->hdr_available
+            && (display->orientation != SC_ORIENTATION_0 || display->upscaled)
+            && sc_hdr_renderer_accepts_format(frame->format)) {
+        // Rotate and flip (or upscale with the Lanczos filter) in the shader
+        // rather than by SDL_RenderCopyEx() (on failure, the HDR renderer is
+        // disabled and the frame is uploaded to the SDL texture on the next
+        // attempt)
+        return sc_display_update_hdr(display, frame);
+    }
+#endif
+
+    display->hdr_frame = false;
+
+    uint32_t format = sc_display_to_sdl_pixel_format(frame->format);
+    if (format == SDL_PIXELFORMAT_UNKNOWN) {
+        LOGE("Unsupported frame format: %s",
+             av_get_pix_fmt_name(frame->format));
+        return false;
+    }
+
+    if (format != display->texture_format) {
+        int w;
+        int h;
+        int ret = SDL_QueryTexture(display->texture, NULL, NULL, &w, &h);
+        if (ret) {
+            LOGD("Could not query texture: %s", SDL_GetError());
+            return false;
+        }
+
+        LOGI("Texture format: %s", SDL_GetPixelFormatName(format));
+        display->texture_format = format;
+
+        struct sc_size size = {w, h};
+        bool ok = sc_display_set_texture_size_internal(display, size);
+        if (!ok) {
+            sc_display_set_pending_size(display, size);
+            return false;
+        }
+    }
+
+    int ret;
+#ifdef SCRCPY_SDL_HAS_UPDATE_NV_TEXTURE
+    if (format == SDL_PIXELFORMAT_NV12) {
+        ret = SDL_UpdateNVTexture(display->texture, NULL,
+                                  frame->data[0], frame->linesize[0],
+                                  frame->data[1], frame->linesize[1]);
+    } else
+#endif
+    if (display->use_pbo && sc_display_update_texture_pbo(display, frame)) {
+        ret = 0;
+    } else {
+        ret = SDL_UpdateYUVTexture(display->texture, NULL,
                                    frame->data[0], frame->linesize[0],
                                    frame->data[1], frame->linesize[1],
                                    frame->data[2], frame->linesize[2]);
+    }
     if (ret) {
         LOGD("Could not update texture: %s", SDL_GetError());
         return false;
     }
 
     if (display->mipmaps) {
-        SDL_GL_BindTexture(display->texture, NULL, NULL);
-        display->gl.GenerateMipmap(GL_TEXTURE_2D);
-        SDL_GL_UnbindTexture(display->texture);
+        // The mipmaps are useless (never sampled) unless the frame is
+        // sufficiently downscaled
+        if (display->mipmap_levels || !display->mipmaps_complete) {
+            sc_display_generate_mipmaps(display);
+        } else {
+            display->mipmaps_stale = true;
+        }
     }
 
     return true;
@@ -233,9 +650,34 @@ sc_display_update_texture(struct sc_display *display, const AVFrame *frame) {
     return SC_DISPLAY_RESULT_OK;
 }
 
+#ifdef SC_DISPLAY_HAS_HDR
+// Tell whether the texture is rendered larger than its size
+static bool
+sc_display_is_upscaled(struct sc_display *display, const SDL_Rect *geometry,
+                       enum sc_orientation orientation) {
+    int tw;
+    int th;
+    if (!display->texture
+            || SDL_QueryTexture(display->texture, NULL, NULL, &tw, &th)) {
+        return false;
+    }
+
+    int w = geometry->w;
+    int h = geometry->h;
+    if (sc_orientation_is_swap(orientation)) {
+        w = geometry->h;
+        h = geometry->w;
+    }
+
+    return w > tw || h > th;
+}
+#endif
+
 enum sc_display_result
 sc_display_render(struct sc_display *display, const SDL_Rect *geometry,
-                  enum sc_orientation orientation) {
+                  enum sc_orientation orientation,
+                  const struct sc_input_overlay *overlay,
+                  const struct sc_perf_overlay *perf_overlay) {
     SDL_RenderClear(display->renderer);
 
     if (display->pending.flags) {
@@ -248,6 +690,32 @@ sc_display_render(struct sc_display *display, const SDL_Rect *geometry,
     SDL_Renderer *renderer = display->renderer;
     SDL_Texture *texture = display->texture;
 
+    if (display->mipmaps && !display->hdr_frame) {
+        sc_display_update_mipmaps(display, geometry, orientation);
+    }
+
+#ifdef SC_DISPLAY_HAS_HDR
+    // Applied to the next frames (the current frame is rendered wherever it
+    // has been uploaded, both paths support any orientation)
+    display->orientation = orientation;
+    if (display->upscale_filter == SC_UPSCALE_FILTER_LANCZOS) {
+        display->upscaled = sc_display_is_upscaled(display, geometry,
+                                                   orientation);
+    }
+
+    if (display->hdr_frame) {
+        int ow;
+        int oh;
+        if (SDL_GetRendererOutputSize(renderer, &ow, &oh)) {
+            LOGE("Could not get renderer output size: %s", SDL_GetError());
+            return SC_DISPLAY_RESULT_ERROR;
+        }
+
+        // Execute the pending SDL commands (the clear) before drawing directly
+        SDL_RenderFlush(renderer);
+        sc_hdr_renderer_render(&display->hdr, geometry, orientation, ow, oh);
+    } else
+#endif
     if (orientation == SC_ORIENTATION_0) {
         int ret = SDL_RenderCopy(renderer, texture, NULL, geometry);
         if (ret) {
@@ -281,6 +749,14 @@ sc_display_render(struct sc_display *display, const SDL_Rect *geometry,
         }
     }
 
+    if (overlay) {
+        sc_input_overlay_render(overlay, renderer, geometry, sc_tick_now());
+    }
+
+    if (perf_overlay) {
+        sc_perf_overlay_render(perf_overlay, renderer, geometry);
+    }
+
     SDL_RenderPresent(display->renderer);
     return SC_DISPLAY_RESULT_OK;
 }
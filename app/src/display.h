@@ -8,16 +8,31 @@
 #include <SDL2/SDL.h>
 
 #include "coords.h"
+#include "hdr_renderer.h"
+#include "hwframe.h"
+#include "input_overlay.h"
 #include "opengl.h"
 #include "options.h"
+#include "perf_overlay.h"
 
 #ifdef __APPLE__
 # define SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
 #endif
 
+// Number of pixel buffer objects used in turn to upload the frames
+#define SC_DISPLAY_PBO_COUNT 3
+
+#if defined(SCRCPY_SDL_HAS_RENDER_FLUSH) \
+        && !defined(SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE)
+// Render the 10-bit frames with a custom shader in the SDL OpenGL context
+# define SC_DISPLAY_HAS_HDR
+#endif
+
 struct sc_display {
     SDL_Renderer *renderer;
     SDL_Texture *texture;
+    // SDL pixel format of the texture, selected from the frame format
+    uint32_t texture_format;
 
     struct sc_opengl gl;
 #ifdef SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
@@ -25,6 +40,49 @@ struct sc_display {
 #endif
 
     bool mipmaps;
+    // Set if GL_TEXTURE_MAX_LEVEL is supported, so that only the mipmap levels
+    // actually sampled are generated
+    bool mipmap_max_level;
+    // Number of mipmap levels sampled for the current downscaling (0 if the
+    // frame is not downscaled enough for the mipmaps to be sampled)
+    unsigned mipmap_levels;
+    // Set if the mipmaps do not match the texture content
+    bool mipmaps_stale;
+    // Set if the texture is complete (without GL_TEXTURE_MAX_LEVEL, its
+    // mipmaps must have been generated at least once)
+    bool mipmaps_complete;
+
+    // Upload the YUV frames asynchronously through pixel buffer objects, so
+    // that the driver copies a frame while the previous one is rendered
+    bool use_pbo;
+    bool pbos_created;
+    GLuint pbos[SC_DISPLAY_PBO_COUNT];
+    unsigned pbo_index;
+
+#ifdef SC_DISPLAY_HAS_HDR
+    // 10-bit frames are not supported by SDL textures, they are rendered by
+    // the HDR renderer (initialized on the first 10-bit frame)
+    bool hdr_available;
+    bool hdr_initialized;
+    struct sc_hdr_renderer hdr;
+    // Orientation of the last render: if it is rotated or mirrored, the 8-bit
+    // frames are also uploaded to the HDR renderer, which applies the
+    // orientation in the same pass as the YUV conversion
+    enum sc_orientation orientation;
+    // Set if the last render upscaled the frame: with the Lanczos filter, the
+    // 8-bit frames are then also uploaded to the HDR renderer
+    bool upscaled;
+#endif
+    enum sc_upscale_filter upscale_filter;
+    // Set if the last frame was uploaded to the HDR renderer
+    bool hdr_frame;
+
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    // Frames stored in hardware surfaces are downloaded only when they are
+    // actually uploaded to the texture
+    struct sc_hwframe_downloader downloader;
+    AVFrame *hw_download_frame;
+#endif
 
     struct {
 #define SC_DISPLAY_PENDING_FLAG_SIZE 1
@@ -42,7 +100,8 @@ enum sc_display_result {
 };
 
 bool
-sc_display_init(struct sc_display *display, SDL_Window *window, bool mipmaps);
+sc_display_init(struct sc_display *display, SDL_Window *window, bool mipmaps,
+                enum sc_upscale_filter upscale_filter);
 
 void
 sc_display_destroy(struct sc_display *display);
@@ -55,6 +114,8 @@ sc_display_update_texture(struct sc_display *display, const AVFrame *frame);
 
 enum sc_display_result
 sc_display_render(struct sc_display *display, const SDL_Rect *geometry,
-                  enum sc_orientation orientation);
+                  enum sc_orientation orientation,
+                  const struct sc_input_overlay *overlay, // may be NULL
+                  const struct sc_perf_overlay *perf_overlay); // may be NULL
 
 #endif
@@ -7,3 +7,6 @@
 #define SC_EVENT_RECORDER_ERROR           (SDL_USEREVENT + 6)
 #define SC_EVENT_SCREEN_INIT_SIZE         (SDL_USEREVENT + 7)
 #define SC_EVENT_TIME_LIMIT_REACHED       (SDL_USEREVENT + 8)
+#define SC_EVENT_STARTUP_COMPLETED        (SDL_USEREVENT + 9)
+#define SC_EVENT_FILE_PUSHER_PROGRESS     (SDL_USEREVENT + 10)
+#define SC_EVENT_STREAM_REPLAY_FINISHED   (SDL_USEREVENT + 11)
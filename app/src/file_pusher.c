@@ -1,25 +1,45 @@
 #include "file_pusher.h"
 
 #include <assert.h>
+#include <inttypes.h>
 #include <string.h>
 
 #include "adb/adb.h"
+#include "util/file.h"
 #include "util/log.h"
-#include "util/process_intr.h"
 
 #define DEFAULT_PUSH_TARGET "/sdcard/Download/"
 
+// Files dropped together are received as separate requests: wait a bit for
+// the next ones before starting a push, so that they are transferred by the
+// same adb process
+#define SC_FILE_PUSHER_BATCH_DELAY SC_TICK_FROM_MS(100)
+
 static void
 sc_file_pusher_request_destroy(struct sc_file_pusher_request *req) {
     free(req->file);
 }
 
+static void
+sc_file_pusher_queue_destroy(struct sc_file_pusher_request_queue *queue) {
+    while (!sc_vecdeque_is_empty(queue)) {
+        struct sc_file_pusher_request *req = sc_vecdeque_popref(queue);
+        assert(req);
+        sc_file_pusher_request_destroy(req);
+    }
+    sc_vecdeque_destroy(queue);
+}
+
 bool
 sc_file_pusher_init(struct sc_file_pusher *fp, const char *serial,
-                    const char *push_target) {
+                    const char *push_target,
+                    struct sc_controller *controller,
+                    const struct sc_file_pusher_callbacks *cbs,
+                    void *cbs_userdata) {
     assert(serial);
 
-    sc_vecdeque_init(&fp->queue);
+    sc_vecdeque_init(&fp->push_queue);
+    sc_vecdeque_init(&fp->install_queue);
 
     bool ok = sc_mutex_init(&fp->mutex);
     if (!ok) {
@@ -32,17 +52,9 @@ sc_file_pusher_init(struct sc_file_pusher *fp, const char *serial,
         return false;
     }
 
-    ok = sc_intr_init(&fp->intr);
-    if (!ok) {
-        sc_cond_destroy(&fp->event_cond);
-        sc_mutex_destroy(&fp->mutex);
-        return false;
-    }
-
     fp->serial = strdup(serial);
     if (!fp->serial) {
         LOG_OOM();
-        sc_intr_destroy(&fp->intr);
         sc_cond_destroy(&fp->event_cond);
         sc_mutex_destroy(&fp->mutex);
         return false;
@@ -50,10 +62,19 @@ sc_file_pusher_init(struct sc_file_pusher *fp, const char *serial,
 
     // lazy initialization
     fp->initialized = false;
+    fp->worker_count = 0;
 
     fp->stopped = false;
+    fp->active = 0;
+    fp->controller_pending = 0;
+    fp->controller_failed = 0;
+    memset(&fp->progress, 0, sizeof(fp->progress));
 
     fp->push_target = push_target ? push_target : DEFAULT_PUSH_TARGET;
+    fp->controller = controller;
+
+    fp->cbs = cbs;
+    fp->cbs_userdata = cbs_userdata;
 
     return true;
 }
@@ -62,13 +83,27 @@ void
 sc_file_pusher_destroy(struct sc_file_pusher *fp) {
     sc_cond_destroy(&fp->event_cond);
     sc_mutex_destroy(&fp->mutex);
-    sc_intr_destroy(&fp->intr);
+    for (unsigned i = 0; i < fp->worker_count; ++i) {
+        sc_intr_destroy(&fp->workers[i].intr);
+    }
     free(fp->serial);
 
-    while (!sc_vecdeque_is_empty(&fp->queue)) {
-        struct sc_file_pusher_request *req = sc_vecdeque_popref(&fp->queue);
-        assert(req);
-        sc_file_pusher_request_destroy(req);
+    sc_file_pusher_queue_destroy(&fp->push_queue);
+    sc_file_pusher_queue_destroy(&fp->install_queue);
+}
+
+static bool
+sc_file_pusher_is_idle(struct sc_file_pusher *fp) {
+    sc_mutex_assert(&fp->mutex);
+    return sc_vecdeque_is_empty(&fp->push_queue)
+        && sc_vecdeque_is_empty(&fp->install_queue)
+        && !fp->active;
+}
+
+static void
+sc_file_pusher_notify_progress(struct sc_file_pusher *fp) {
+    if (fp->cbs && fp->cbs->on_progress) {
+        fp->cbs->on_progress(fp, fp->cbs_userdata);
     }
 }
 
@@ -86,88 +121,322 @@ sc_file_pusher_request(struct sc_file_pusher *fp,
     LOGI("Request to %s %s", action == SC_FILE_PUSHER_ACTION_INSTALL_APK
                                  ? "install" : "push",
                              file);
+
+    // Only used to report the progress
+    uint64_t size = 0;
+    if (!sc_file_get_size(file, &size)) {
+        LOGW("Could not get the size of %s", file);
+    }
+
     struct sc_file_pusher_request req = {
         .action = action,
         .file = file,
+        .size = size,
     };
 
+    struct sc_file_pusher_request_queue *queue =
+        action == SC_FILE_PUSHER_ACTION_INSTALL_APK ? &fp->install_queue
+                                                    : &fp->push_queue;
+
     sc_mutex_lock(&fp->mutex);
-    bool was_empty = sc_vecdeque_is_empty(&fp->queue);
-    bool res = sc_vecdeque_push(&fp->queue, req);
+    if (sc_file_pusher_is_idle(fp)) {
+        // Start a new progress report
+        memset(&fp->progress, 0, sizeof(fp->progress));
+        fp->progress.start = sc_tick_now();
+    }
+
+    bool res = sc_vecdeque_push(queue, req);
     if (!res) {
         LOG_OOM();
         sc_mutex_unlock(&fp->mutex);
         return false;
     }
 
-    if (was_empty) {
-        sc_cond_signal(&fp->event_cond);
-    }
+    ++fp->progress.total;
+    fp->progress.bytes_total += size;
+
+    // Wake up the idle workers (and the push worker waiting for a batch)
+    sc_cond_broadcast(&fp->event_cond);
     sc_mutex_unlock(&fp->mutex);
 
+    sc_file_pusher_notify_progress(fp);
+
     return true;
 }
 
-static int
-run_file_pusher(void *data) {
-    struct sc_file_pusher *fp = data;
-    struct sc_intr *intr = &fp->intr;
+bool
+sc_file_pusher_get_progress(struct sc_file_pusher *fp,
+                            struct sc_file_pusher_progress *progress) {
+    sc_mutex_lock(&fp->mutex);
+    *progress = fp->progress;
+    bool busy = !sc_file_pusher_is_idle(fp);
+    sc_mutex_unlock(&fp->mutex);
+
+    return busy;
+}
+
+void
+sc_file_pusher_on_file_pushed(struct sc_file_pusher *fp, bool success) {
+    sc_mutex_lock(&fp->mutex);
+    assert(fp->controller_pending);
+    --fp->controller_pending;
+    if (!success) {
+        ++fp->controller_failed;
+    }
+    sc_cond_broadcast(&fp->event_cond);
+    sc_mutex_unlock(&fp->mutex);
+}
+
+static const char *
+get_basename(const char *path) {
+    const char *name = path;
+    for (const char *p = path; *p; ++p) {
+        if (*p == '/' || *p == SC_PATH_SEPARATOR) {
+            name = p + 1;
+        }
+    }
+    return name;
+}
+
+// Push the files over the control socket, and wait for the controller to have
+// sent them all
+static bool
+sc_file_pusher_push_by_controller(struct sc_file_pusher *fp,
+                                  struct sc_file_pusher_request *reqs,
+                                  size_t count) {
+    assert(fp->controller);
+
+    size_t submitted = 0;
+    for (size_t i = 0; i < count; ++i) {
+        struct sc_control_msg msg;
+        msg.type = SC_CONTROL_MSG_TYPE_PUSH_FILE;
+        msg.push_file.target = strdup(fp->push_target);
+        msg.push_file.name = strdup(get_basename(reqs[i].file));
+        msg.push_file.local = strdup(reqs[i].file);
+        msg.push_file.size = reqs[i].size;
+        if (!msg.push_file.target || !msg.push_file.name
+                || !msg.push_file.local) {
+            LOG_OOM();
+            sc_control_msg_destroy(&msg);
+            break;
+        }
+
+        // Count it before it can be acknowledged
+        sc_mutex_lock(&fp->mutex);
+        ++fp->controller_pending;
+        sc_mutex_unlock(&fp->mutex);
+
+        if (!sc_controller_push_msg(fp->controller, &msg)) {
+            LOGE("Could not request the push of %s", reqs[i].file);
+            sc_control_msg_destroy(&msg);
+            sc_mutex_lock(&fp->mutex);
+            --fp->controller_pending;
+            sc_mutex_unlock(&fp->mutex);
+            break;
+        }
+        ++submitted;
+    }
+
+    sc_mutex_lock(&fp->mutex);
+    while (!fp->stopped && fp->controller_pending) {
+        sc_cond_wait(&fp->event_cond, &fp->mutex);
+    }
+    bool ok = !fp->stopped && !fp->controller_pending
+           && !fp->controller_failed && submitted == count;
+    fp->controller_failed = 0;
+    sc_mutex_unlock(&fp->mutex);
+
+    return ok;
+}
+
+static bool
+sc_file_pusher_process(struct sc_file_pusher *fp,
+                       struct sc_file_pusher_worker *worker,
+                       struct sc_file_pusher_request *reqs, size_t count) {
+    struct sc_intr *intr = &worker->intr;
 
     const char *serial = fp->serial;
     assert(serial);
 
+    if (reqs[0].action == SC_FILE_PUSHER_ACTION_INSTALL_APK) {
+        assert(count == 1);
+        const char *file = reqs[0].file;
+        LOGI("Installing %s...", file);
+        bool ok = sc_adb_install(intr, serial, file, 0);
+        if (ok) {
+            LOGI("%s successfully installed", file);
+        } else {
+            LOGE("Failed to install %s", file);
+        }
+        return ok;
+    }
+
     const char *push_target = fp->push_target;
     assert(push_target);
 
+    const char *files[SC_FILE_PUSHER_MAX_BATCH];
+    assert(count <= SC_FILE_PUSHER_MAX_BATCH);
+    for (size_t i = 0; i < count; ++i) {
+        assert(reqs[i].action == SC_FILE_PUSHER_ACTION_PUSH_FILE);
+        files[i] = reqs[i].file;
+    }
+
+    if (count == 1) {
+        LOGI("Pushing %s...", files[0]);
+    } else {
+        LOGI("Pushing %" SC_PRIsizet " files...", count);
+    }
+
+    if (fp->controller) {
+        // The controller logs the result of each file
+        return sc_file_pusher_push_by_controller(fp, reqs, count);
+    }
+
+    bool ok = sc_adb_push_files(intr, serial, files, count, push_target, 0);
+    if (count == 1) {
+        if (ok) {
+            LOGI("%s successfully pushed to %s", files[0], push_target);
+        } else {
+            LOGE("Failed to push %s to %s", files[0], push_target);
+        }
+    } else {
+        if (ok) {
+            LOGI("%" SC_PRIsizet " files successfully pushed to %s", count,
+                 push_target);
+        } else {
+            LOGE("Failed to push %" SC_PRIsizet " files to %s", count,
+                 push_target);
+        }
+    }
+
+    return ok;
+}
+
+static void
+sc_file_pusher_log_summary(const struct sc_file_pusher_progress *progress) {
+    sc_tick elapsed = sc_tick_now() - progress->start;
+    uint64_t ms = elapsed > 0 ? SC_TICK_TO_MS(elapsed) : 0;
+    unsigned kib_per_s =
+        ms ? (unsigned) (progress->bytes_done * 1000 / ms / 1024) : 0;
+    LOGI("File transfer completed: %u/%u files (%" PRIu64 " KiB) in %" PRIu64
+         " ms (%u KiB/s)", progress->done - progress->failed, progress->total,
+         progress->bytes_done / 1024, ms, kib_per_s);
+}
+
+static int
+run_file_pusher(void *data) {
+    struct sc_file_pusher_worker *worker = data;
+    struct sc_file_pusher *fp = worker->fp;
+
+    // The first worker handles the pushes, the others the installs
+    bool push = worker == &fp->workers[0];
+    struct sc_file_pusher_request_queue *queue =
+        push ? &fp->push_queue : &fp->install_queue;
+    size_t max_count = push ? SC_FILE_PUSHER_MAX_BATCH : 1;
+
+    struct sc_file_pusher_request reqs[SC_FILE_PUSHER_MAX_BATCH];
+
     for (;;) {
         sc_mutex_lock(&fp->mutex);
-        while (!fp->stopped && sc_vecdeque_is_empty(&fp->queue)) {
+        while (!fp->stopped && sc_vecdeque_is_empty(queue)) {
             sc_cond_wait(&fp->event_cond, &fp->mutex);
         }
+
+        if (push) {
+            sc_tick deadline = sc_tick_now() + SC_FILE_PUSHER_BATCH_DELAY;
+            bool timed_out = false;
+            while (!fp->stopped && !timed_out
+                    && sc_vecdeque_size(queue) < max_count) {
+                timed_out =
+                    !sc_cond_timedwait(&fp->event_cond, &fp->mutex, deadline);
+            }
+        }
+
         if (fp->stopped) {
             // stop immediately, do not process further events
             sc_mutex_unlock(&fp->mutex);
             break;
         }
 
-        assert(!sc_vecdeque_is_empty(&fp->queue));
-        struct sc_file_pusher_request req = sc_vecdeque_pop(&fp->queue);
+        size_t count = 0;
+        uint64_t bytes = 0;
+        while (count < max_count && !sc_vecdeque_is_empty(queue)) {
+            reqs[count] = sc_vecdeque_pop(queue);
+            bytes += reqs[count].size;
+            ++count;
+        }
+        assert(count);
+        fp->active += count;
         sc_mutex_unlock(&fp->mutex);
 
-        if (req.action == SC_FILE_PUSHER_ACTION_INSTALL_APK) {
-            LOGI("Installing %s...", req.file);
-            bool ok = sc_adb_install(intr, serial, req.file, 0);
-            if (ok) {
-                LOGI("%s successfully installed", req.file);
-            } else {
-                LOGE("Failed to install %s", req.file);
-            }
-        } else {
-            LOGI("Pushing %s...", req.file);
-            bool ok = sc_adb_push(intr, serial, req.file, push_target, 0);
-            if (ok) {
-                LOGI("%s successfully pushed to %s", req.file, push_target);
-            } else {
-                LOGE("Failed to push %s to %s", req.file, push_target);
-            }
+        bool ok = sc_file_pusher_process(fp, worker, reqs, count);
+
+        sc_mutex_lock(&fp->mutex);
+        fp->active -= count;
+        fp->progress.done += count;
+        if (!ok) {
+            fp->progress.failed += count;
+        }
+        fp->progress.bytes_done += bytes;
+        bool finished = sc_file_pusher_is_idle(fp);
+        struct sc_file_pusher_progress progress = fp->progress;
+        sc_mutex_unlock(&fp->mutex);
+
+        if (finished) {
+            sc_file_pusher_log_summary(&progress);
         }
 
-        sc_file_pusher_request_destroy(&req);
+        sc_file_pusher_notify_progress(fp);
+
+        for (size_t i = 0; i < count; ++i) {
+            sc_file_pusher_request_destroy(&reqs[i]);
+        }
     }
+
     return 0;
 }
 
 bool
 sc_file_pusher_start(struct sc_file_pusher *fp) {
-    LOGD("Starting file_pusher thread");
+    LOGD("Starting file_pusher threads");
 
-    bool ok = sc_thread_create(&fp->thread, run_file_pusher, "scrcpy-file", fp);
-    if (!ok) {
-        LOGE("Could not start file_pusher thread");
-        return false;
+    assert(!fp->worker_count);
+    for (unsigned i = 0; i < ARRAY_LEN(fp->workers); ++i) {
+        struct sc_file_pusher_worker *worker = &fp->workers[i];
+        worker->fp = fp;
+
+        bool ok = sc_intr_init(&worker->intr);
+        if (!ok) {
+            goto error;
+        }
+
+        const char *name = i ? "scrcpy-install" : "scrcpy-file";
+        ok = sc_thread_create(&worker->thread, run_file_pusher, name, worker);
+        if (!ok) {
+            LOGE("Could not start file_pusher thread");
+            sc_intr_destroy(&worker->intr);
+            goto error;
+        }
+
+        ++fp->worker_count;
     }
 
     return true;
+
+error:
+    // Stop the workers already started
+    sc_mutex_lock(&fp->mutex);
+    fp->stopped = true;
+    sc_cond_broadcast(&fp->event_cond);
+    sc_mutex_unlock(&fp->mutex);
+
+    for (unsigned i = 0; i < fp->worker_count; ++i) {
+        sc_thread_join(&fp->workers[i].thread, NULL);
+        sc_intr_destroy(&fp->workers[i].intr);
+    }
+    fp->worker_count = 0;
+
+    return false;
 }
 
 void
@@ -175,8 +444,10 @@ sc_file_pusher_stop(struct sc_file_pusher *fp) {
     if (fp->initialized) {
         sc_mutex_lock(&fp->mutex);
         fp->stopped = true;
-        sc_cond_signal(&fp->event_cond);
-        sc_intr_interrupt(&fp->intr);
+        sc_cond_broadcast(&fp->event_cond);
+        for (unsigned i = 0; i < fp->worker_count; ++i) {
+            sc_intr_interrupt(&fp->workers[i].intr);
+        }
         sc_mutex_unlock(&fp->mutex);
     }
 }
@@ -184,6 +455,8 @@ sc_file_pusher_stop(struct sc_file_pusher *fp) {
 void
 sc_file_pusher_join(struct sc_file_pusher *fp) {
     if (fp->initialized) {
-        sc_thread_join(&fp->thread, NULL);
+        for (unsigned i = 0; i < fp->worker_count; ++i) {
+            sc_thread_join(&fp->workers[i].thread, NULL);
+        }
     }
 }
@@ -4,11 +4,20 @@
 #include "common.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 
+#include "controller.h"
 #include "util/intr.h"
 #include "util/thread.h"
+#include "util/tick.h"
 #include "util/vecdeque.h"
 
+// Maximum number of "adb install" running concurrently
+#define SC_FILE_PUSHER_INSTALL_WORKERS 3
+
+// Maximum number of files transferred by a single "adb push"
+#define SC_FILE_PUSHER_MAX_BATCH 64
+
 enum sc_file_pusher_action {
     SC_FILE_PUSHER_ACTION_INSTALL_APK,
     SC_FILE_PUSHER_ACTION_PUSH_FILE,
@@ -17,26 +26,75 @@ enum sc_file_pusher_action {
 struct sc_file_pusher_request {
     enum sc_file_pusher_action action;
     char *file;
+    uint64_t size; // 0 if unknown
 };
 
 struct sc_file_pusher_request_queue SC_VECDEQUE(struct sc_file_pusher_request);
 
+/**
+ * Progress of the requests submitted since the file pusher was last idle
+ */
+struct sc_file_pusher_progress {
+    unsigned done; // processed requests (including the failed ones)
+    unsigned failed;
+    unsigned total;
+    uint64_t bytes_done;
+    uint64_t bytes_total;
+    sc_tick start; // when the first request was submitted
+};
+
+struct sc_file_pusher;
+
+struct sc_file_pusher_callbacks {
+    // Called from any thread (without lock) when the progress changes
+    void (*on_progress)(struct sc_file_pusher *fp, void *userdata);
+};
+
+struct sc_file_pusher_worker {
+    struct sc_file_pusher *fp;
+    sc_thread thread;
+    struct sc_intr intr;
+};
+
 struct sc_file_pusher {
     char *serial;
     const char *push_target;
-    sc_thread thread;
+    // If set, the files are pushed over the control socket instead of adb
+    struct sc_controller *controller;
+
+    // The first worker pushes the files (in batches), the others install the
+    // APKs (in parallel)
+    struct sc_file_pusher_worker workers[1 + SC_FILE_PUSHER_INSTALL_WORKERS];
+    unsigned worker_count; // number of started workers
+
     sc_mutex mutex;
     sc_cond event_cond;
     bool stopped;
     bool initialized;
-    struct sc_file_pusher_request_queue queue;
+    struct sc_file_pusher_request_queue push_queue;
+    struct sc_file_pusher_request_queue install_queue;
+    unsigned active; // requests being processed by the workers
+    // Files pushed by the controller, not yet acknowledged by
+    // sc_file_pusher_on_file_pushed()
+    unsigned controller_pending;
+    unsigned controller_failed;
+    struct sc_file_pusher_progress progress;
 
-    struct sc_intr intr;
+    const struct sc_file_pusher_callbacks *cbs;
+    void *cbs_userdata;
 };
 
+/**
+ * If controller is not NULL, the files are pushed over the control socket (it
+ * must be started before the first request). The APKs are always installed
+ * via adb.
+ */
 bool
 sc_file_pusher_init(struct sc_file_pusher *fp, const char *serial,
-                    const char *push_target);
+                    const char *push_target,
+                    struct sc_controller *controller,
+                    const struct sc_file_pusher_callbacks *cbs,
+                    void *cbs_userdata);
 
 void
 sc_file_pusher_destroy(struct sc_file_pusher *fp);
@@ -55,4 +113,14 @@ bool
 sc_file_pusher_request(struct sc_file_pusher *fp,
                        enum sc_file_pusher_action action, char *file);
 
+// Must be called when the controller has pushed a file requested by the file
+// pusher (see sc_controller_callbacks)
+void
+sc_file_pusher_on_file_pushed(struct sc_file_pusher *fp, bool success);
+
+// Return true if some requests are pending or in progress
+bool
+sc_file_pusher_get_progress(struct sc_file_pusher *fp,
+                            struct sc_file_pusher_progress *progress);
+
 #endif
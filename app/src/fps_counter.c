@@ -1,6 +1,8 @@
 #include "fps_counter.h"
 
 #include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
 
 #include "util/log.h"
 
@@ -42,17 +44,69 @@ set_started(struct sc_fps_counter *counter, bool started) {
     atomic_store_explicit(&counter->started, started, memory_order_release);
 }
 
+static void
+reset_durations(struct sc_fps_counter *counter) {
+    for (unsigned i = 0; i < SC_FPS_COUNTER_TIMING_COUNT; ++i) {
+        counter->durations[i].count = 0;
+        counter->durations[i].sum = 0;
+    }
+}
+
+// Format the min/avg/max of a duration (in milliseconds, with one decimal)
+static void
+format_duration(char *buf, size_t len,
+                const struct sc_fps_counter_duration *d) {
+    if (!d->count) {
+        snprintf(buf, len, "-");
+        return;
+    }
+
+#define MS_1(tick) SC_TICK_TO_MS(tick), SC_TICK_TO_US(tick) / 100 % 10
+    sc_tick avg = d->sum / d->count;
+    snprintf(buf, len, "%" PRItick ".%" PRItick "/%" PRItick ".%" PRItick
+                       "/%" PRItick ".%" PRItick,
+             MS_1(d->min), MS_1(avg), MS_1(d->max));
+#undef MS_1
+}
+
 // must be called with mutex locked
 static void
 display_fps(struct sc_fps_counter *counter) {
     unsigned rendered_per_second =
         counter->nr_rendered * SC_TICK_FREQ / SC_FPS_COUNTER_INTERVAL;
+
+    char skipped[32] = "";
     if (counter->nr_skipped) {
-        LOGI("%u fps (+%u frames skipped)", rendered_per_second,
-                                            counter->nr_skipped);
-    } else {
-        LOGI("%u fps", rendered_per_second);
+        snprintf(skipped, sizeof(skipped), " (+%u frames skipped)",
+                 counter->nr_skipped);
+    }
+
+    bool has_durations = false;
+    for (unsigned i = 0; i < SC_FPS_COUNTER_TIMING_COUNT; ++i) {
+        if (counter->durations[i].count) {
+            has_durations = true;
+            break;
+        }
+    }
+
+    if (!has_durations) {
+        LOGI("%u fps%s", rendered_per_second, skipped);
+        return;
     }
+
+    char decode[48];
+    char upload[48];
+    char present[48];
+    format_duration(decode, sizeof(decode),
+                    &counter->durations[SC_FPS_COUNTER_TIMING_DECODE]);
+    format_duration(upload, sizeof(upload),
+                    &counter->durations[SC_FPS_COUNTER_TIMING_UPLOAD]);
+    format_duration(present, sizeof(present),
+                    &counter->durations[SC_FPS_COUNTER_TIMING_PRESENT]);
+
+    // min/avg/max in milliseconds
+    LOGI("%u fps%s, decode %s, upload %s, present %s ms", rendered_per_second,
+         skipped, decode, upload, present);
 }
 
 // must be called with mutex locked
@@ -65,6 +119,7 @@ check_interval_expired(struct sc_fps_counter *counter, sc_tick now) {
     display_fps(counter);
     counter->nr_rendered = 0;
     counter->nr_skipped = 0;
+    reset_durations(counter);
     // add a multiple of the interval
     uint32_t elapsed_slices =
         (now - counter->next_timestamp) / SC_FPS_COUNTER_INTERVAL + 1;
@@ -100,6 +155,7 @@ sc_fps_counter_start(struct sc_fps_counter *counter) {
     counter->next_timestamp = sc_tick_now() + SC_FPS_COUNTER_INTERVAL;
     counter->nr_rendered = 0;
     counter->nr_skipped = 0;
+    reset_durations(counter);
     sc_mutex_unlock(&counter->mutex);
 
     set_started(counter, true);
@@ -183,3 +239,27 @@ sc_fps_counter_add_skipped_frame(struct sc_fps_counter *counter) {
     ++counter->nr_skipped;
     sc_mutex_unlock(&counter->mutex);
 }
+
+void
+sc_fps_counter_add_duration(struct sc_fps_counter *counter,
+                            enum sc_fps_counter_timing timing,
+                            sc_tick duration) {
+    assert(timing < SC_FPS_COUNTER_TIMING_COUNT);
+    if (!is_started(counter)) {
+        return;
+    }
+
+    sc_mutex_lock(&counter->mutex);
+    sc_tick now = sc_tick_now();
+    check_interval_expired(counter, now);
+    struct sc_fps_counter_duration *d = &counter->durations[timing];
+    if (!d->count || duration < d->min) {
+        d->min = duration;
+    }
+    if (!d->count || duration > d->max) {
+        d->max = duration;
+    }
+    d->sum += duration;
+    ++d->count;
+    sc_mutex_unlock(&counter->mutex);
+}
@@ -8,6 +8,24 @@
 #include <stdint.h>
 
 #include "util/thread.h"
+#include "util/tick.h"
+
+// Durations measured for each frame, to tell whether a slow session is bound by
+// the decoding (CPU), the texture upload (GPU) or the network (the frame rate
+// is low while the durations are short)
+enum sc_fps_counter_timing {
+    SC_FPS_COUNTER_TIMING_DECODE, // decoding of a packet
+    SC_FPS_COUNTER_TIMING_UPLOAD, // upload of a frame to the texture
+    SC_FPS_COUNTER_TIMING_PRESENT, // rendering and presentation
+    SC_FPS_COUNTER_TIMING_COUNT,
+};
+
+struct sc_fps_counter_duration {
+    sc_tick min;
+    sc_tick max;
+    sc_tick sum;
+    unsigned count;
+};
 
 struct sc_fps_counter {
     sc_thread thread;
@@ -24,6 +42,8 @@ struct sc_fps_counter {
     bool interrupted;
     unsigned nr_rendered;
     unsigned nr_skipped;
+    // min/avg/max over the current interval
+    struct sc_fps_counter_duration durations[SC_FPS_COUNTER_TIMING_COUNT];
     sc_tick next_timestamp;
 };
 
@@ -56,4 +76,10 @@ sc_fps_counter_add_rendered_frame(struct sc_fps_counter *counter);
 void
 sc_fps_counter_add_skipped_frame(struct sc_fps_counter *counter);
 
+// May be called from any thread
+void
+sc_fps_counter_add_duration(struct sc_fps_counter *counter,
+                            enum sc_fps_counter_timing timing,
+                            sc_tick duration);
+
 #endif
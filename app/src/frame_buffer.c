@@ -4,87 +4,108 @@
 #include <libavutil/avutil.h>
 #include <libavformat/avformat.h>
 
+#include "frame_size.h"
 #include "util/log.h"
 
 bool
-sc_frame_buffer_init(struct sc_frame_buffer *fb) {
-    fb->pending_frame = av_frame_alloc();
-    if (!fb->pending_frame) {
-        LOG_OOM();
-        return false;
+sc_frame_buffer_init(struct sc_frame_buffer *fb, struct sc_stats *stats) {
+    for (unsigned i = 0; i < ARRAY_LEN(fb->frames); ++i) {
+        fb->sizes[i] = 0;
+        fb->frames[i] = av_frame_alloc();
+        if (!fb->frames[i]) {
+            LOG_OOM();
+            while (i--) {
+                av_frame_free(&fb->frames[i]);
+            }
+            return false;
+        }
     }
 
-    fb->tmp_frame = av_frame_alloc();
-    if (!fb->tmp_frame) {
-        LOG_OOM();
-        av_frame_free(&fb->pending_frame);
-        return false;
-    }
-
-    bool ok = sc_mutex_init(&fb->mutex);
-    if (!ok) {
-        av_frame_free(&fb->pending_frame);
-        av_frame_free(&fb->tmp_frame);
-        return false;
-    }
+    fb->back = 0;
+    fb->front = 2;
 
     // there is initially no frame, so consider it has already been consumed
-    fb->pending_frame_consumed = true;
+    atomic_init(&fb->pending, 1);
+
+    fb->stats = stats;
 
     return true;
 }
 
 void
 sc_frame_buffer_destroy(struct sc_frame_buffer *fb) {
-    sc_mutex_destroy(&fb->mutex);
-    av_frame_free(&fb->pending_frame);
-    av_frame_free(&fb->tmp_frame);
-}
+    unsigned pending = atomic_load_explicit(&fb->pending, memory_order_relaxed);
+    if (pending & SC_FRAME_BUFFER_FLAG_FRESH) {
+        unsigned index = pending & SC_FRAME_BUFFER_INDEX_MASK;
+        sc_stats_add(fb->stats, SC_STAT_MEM_FRAME_BUFFER_BYTES,
+                     -(int64_t) fb->sizes[index]);
+    }
 
-static inline void
-swap_frames(AVFrame **lhs, AVFrame **rhs) {
-    AVFrame *tmp = *lhs;
-    *lhs = *rhs;
-    *rhs = tmp;
+    for (unsigned i = 0; i < ARRAY_LEN(fb->frames); ++i) {
+        av_frame_free(&fb->frames[i]);
+    }
 }
 
 bool
 sc_frame_buffer_push(struct sc_frame_buffer *fb, const AVFrame *frame,
                      bool *previous_frame_skipped) {
-    // Use a temporary frame to preserve pending_frame in case of error.
-    // tmp_frame is an empty frame, no need to call av_frame_unref() beforehand.
-    int r = av_frame_ref(fb->tmp_frame, frame);
+    // The back frame is always empty
+    AVFrame *back = fb->frames[fb->back];
+    int r = av_frame_ref(back, frame);
     if (r) {
         LOGE("Could not ref frame: %d", r);
         return false;
     }
 
-    sc_mutex_lock(&fb->mutex);
+    fb->sizes[fb->back] = sc_frame_get_size(back);
+    sc_stats_add(fb->stats, SC_STAT_MEM_FRAME_BUFFER_BYTES,
+                 fb->sizes[fb->back]);
 
-    // Now that av_frame_ref() succeeded, we can replace the previous
-    // pending_frame
-    swap_frames(&fb->pending_frame, &fb->tmp_frame);
-    av_frame_unref(fb->tmp_frame);
+    // Publish the back frame as the pending frame
+    unsigned previous = atomic_exchange_explicit(&fb->pending,
+                                                 fb->back
+                                                    | SC_FRAME_BUFFER_FLAG_FRESH,
+                                                 memory_order_acq_rel);
 
-    if (previous_frame_skipped) {
-        *previous_frame_skipped = !fb->pending_frame_consumed;
+    fb->back = previous & SC_FRAME_BUFFER_INDEX_MASK;
+
+    bool skipped = previous & SC_FRAME_BUFFER_FLAG_FRESH;
+    if (skipped) {
+        // The previous pending frame has never been consumed
+        av_frame_unref(fb->frames[fb->back]);
+        sc_stats_add(fb->stats, SC_STAT_MEM_FRAME_BUFFER_BYTES,
+                     -(int64_t) fb->sizes[fb->back]);
     }
-    fb->pending_frame_consumed = false;
 
-    sc_mutex_unlock(&fb->mutex);
+    if (previous_frame_skipped) {
+        *previous_frame_skipped = skipped;
+    }
 
     return true;
 }
 
 void
 sc_frame_buffer_consume(struct sc_frame_buffer *fb, AVFrame *dst) {
-    sc_mutex_lock(&fb->mutex);
-    assert(!fb->pending_frame_consumed);
-    fb->pending_frame_consumed = true;
+    // The front frame is always empty, give it back as the pending frame (not
+    // fresh, so that the producer knows that no frame has been skipped)
+    unsigned previous = atomic_exchange_explicit(&fb->pending, fb->front,
+                                                 memory_order_acq_rel);
+    assert(previous & SC_FRAME_BUFFER_FLAG_FRESH);
 
-    av_frame_move_ref(dst, fb->pending_frame);
+    fb->front = previous & SC_FRAME_BUFFER_INDEX_MASK;
+
+    // The consumer is responsible for the accounting of the consumed frame
+    sc_stats_add(fb->stats, SC_STAT_MEM_FRAME_BUFFER_BYTES,
+                 -(int64_t) fb->sizes[fb->front]);
+
+    av_frame_move_ref(dst, fb->frames[fb->front]);
     // av_frame_move_ref() resets its source frame, so no need to call
     // av_frame_unref()
+}
 
-    sc_mutex_unlock(&fb->mutex);
+bool
+sc_frame_buffer_has_pending(struct sc_frame_buffer *fb) {
+    // Only the consumer may reset the flag, so it remains fresh until consumed
+    unsigned pending = atomic_load_explicit(&fb->pending, memory_order_acquire);
+    return pending & SC_FRAME_BUFFER_FLAG_FRESH;
 }
@@ -3,9 +3,11 @@
 
 #include "common.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 
-#include "util/thread.h"
+#include "stats.h"
 
 // forward declarations
 typedef struct AVFrame AVFrame;
@@ -17,28 +19,58 @@ typedef struct AVFrame AVFrame;
  * If a pending frame has not been consumed when the producer pushes a new
  * frame, then it is lost. The intent is to always provide access to the very
  * last frame to minimize latency.
+ *
+ * It is lock-free, for a single producer and a single consumer (triple
+ * buffering):
+ *  - the producer owns the "back" frame, where the new frame is written;
+ *  - the consumer owns the "front" frame, where the frame is consumed from;
+ *  - the "pending" frame is exchanged atomically by the producer and the
+ *    consumer with the frame they own.
  */
 
+#define SC_FRAME_BUFFER_INDEX_MASK 0x3
+// Set if the pending frame has not been consumed yet
+#define SC_FRAME_BUFFER_FLAG_FRESH 0x4
+
 struct sc_frame_buffer {
-    AVFrame *pending_frame;
-    AVFrame *tmp_frame; // To preserve the pending frame on error
+    AVFrame *frames[3];
+    // Size of the buffers referenced by each frame (accessed by the owner of
+    // the frame)
+    size_t sizes[3];
+
+    unsigned back; // only accessed by the producer
+    unsigned front; // only accessed by the consumer
 
-    sc_mutex mutex;
+    // The index of the pending frame, with SC_FRAME_BUFFER_FLAG_FRESH
+    atomic_uint pending;
 
-    bool pending_frame_consumed;
+    // The bytes of the pending frame are reported to
+    // SC_STAT_MEM_FRAME_BUFFER_BYTES
+    struct sc_stats *stats; // may be NULL
 };
 
+// The stats may be NULL
 bool
-sc_frame_buffer_init(struct sc_frame_buffer *fb);
+sc_frame_buffer_init(struct sc_frame_buffer *fb, struct sc_stats *stats);
 
 void
 sc_frame_buffer_destroy(struct sc_frame_buffer *fb);
 
+// Must only be called from the producer thread
 bool
 sc_frame_buffer_push(struct sc_frame_buffer *fb, const AVFrame *frame,
                      bool *skipped);
 
+// Must only be called from the consumer thread, once for each push which
+// did not report the previous frame as skipped
 void
 sc_frame_buffer_consume(struct sc_frame_buffer *fb, AVFrame *dst);
 
+// Tell whether a frame has been pushed but not consumed yet
+//
+// Must only be called from the consumer thread (if it returns true, the
+// frame may be consumed).
+bool
+sc_frame_buffer_has_pending(struct sc_frame_buffer *fb);
+
 #endif
@@ -0,0 +1,108 @@
+#include "frame_hasher.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <libavutil/frame.h>
+
+#include "util/log.h"
+#include "util/luma.h"
+
+/** Downcast frame_sink to sc_frame_hasher */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_frame_hasher, frame_sink)
+
+static bool
+has_luma_plane(enum AVPixelFormat format) {
+    switch (format) {
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+        case AV_PIX_FMT_NV12:
+        case AV_PIX_FMT_NV21:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool
+sc_frame_hasher_push(struct sc_frame_hasher *hasher, const AVFrame *frame) {
+    unsigned index = hasher->index;
+    hasher->index = (index + 1) % hasher->interval;
+    if (index) {
+        // Not hashed
+        return true;
+    }
+
+    if (!has_luma_plane(frame->format)) {
+        if (!hasher->format_warned) {
+            LOGW("Frame hasher: unsupported frame format %d, frames ignored",
+                 frame->format);
+            hasher->format_warned = true;
+        }
+        return true;
+    }
+
+    uint64_t hash = sc_luma_dhash(frame->data[0], frame->linesize[0],
+                                  frame->width, frame->height);
+    if (fprintf(hasher->file, "%" PRId64 " %016" PRIx64 "\n", frame->pts,
+                hash) < 0) {
+        LOGE("Frame hasher: could not write hash");
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+sc_frame_hasher_frame_sink_open(struct sc_frame_sink *sink,
+                                const AVCodecContext *ctx) {
+    (void) ctx;
+    struct sc_frame_hasher *hasher = DOWNCAST(sink);
+    hasher->index = 0;
+    hasher->format_warned = false;
+    return true;
+}
+
+static void
+sc_frame_hasher_frame_sink_close(struct sc_frame_sink *sink) {
+    struct sc_frame_hasher *hasher = DOWNCAST(sink);
+    fflush(hasher->file);
+}
+
+static bool
+sc_frame_hasher_frame_sink_push(struct sc_frame_sink *sink,
+                                const AVFrame *frame) {
+    struct sc_frame_hasher *hasher = DOWNCAST(sink);
+    return sc_frame_hasher_push(hasher, frame);
+}
+
+bool
+sc_frame_hasher_init(struct sc_frame_hasher *hasher, const char *filename,
+                     unsigned interval) {
+    assert(interval);
+
+    hasher->file = fopen(filename, "w");
+    if (!hasher->file) {
+        LOGE("Could not open frame hash file: %s", filename);
+        return false;
+    }
+
+    // Write each line as soon as it is complete
+    setvbuf(hasher->file, NULL, _IOLBF, 0);
+
+    hasher->interval = interval;
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = sc_frame_hasher_frame_sink_open,
+        .close = sc_frame_hasher_frame_sink_close,
+        .push = sc_frame_hasher_frame_sink_push,
+    };
+
+    hasher->frame_sink.ops = &ops;
+
+    return true;
+}
+
+void
+sc_frame_hasher_destroy(struct sc_frame_hasher *hasher) {
+    fclose(hasher->file);
+}
@@ -0,0 +1,42 @@
+#ifndef SC_FRAME_HASHER_H
+#define SC_FRAME_HASHER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "trait/frame_sink.h"
+
+/**
+ * Write a perceptual hash of the decoded frames to a file, to detect visual
+ * changes and freezes without storing the video
+ *
+ * For every `interval` frame, a line "<pts> <hash>" is written, with the PTS
+ * in microseconds and the 64-bit difference hash of the luma plane (see
+ * sc_luma_dhash()) in hexadecimal. Each line is written as soon as it is
+ * complete, so that the file may be read while it is written.
+ *
+ * This must be added to a frame source with an asynchronous dispatch, so that
+ * the hashing never blocks the decoder.
+ */
+struct sc_frame_hasher {
+    struct sc_frame_sink frame_sink; // frame sink trait
+
+    FILE *file;
+    unsigned interval;
+
+    // Only used by the frame sink thread
+    unsigned index; // of the next frame, modulo interval
+    bool format_warned;
+};
+
+bool
+sc_frame_hasher_init(struct sc_frame_hasher *hasher, const char *filename,
+                     unsigned interval);
+
+void
+sc_frame_hasher_destroy(struct sc_frame_hasher *hasher);
+
+#endif
@@ -0,0 +1,256 @@
+#include "frame_pacer.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <libavutil/avutil.h>
+#include <libavformat/avformat.h>
+
+#include "util/log.h"
+
+/** Downcast frame_sink to sc_frame_pacer */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_frame_pacer, frame_sink)
+
+static bool
+sc_paced_frame_init(struct sc_paced_frame *pframe, const AVFrame *frame) {
+    pframe->frame = av_frame_alloc();
+    if (!pframe->frame) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (av_frame_ref(pframe->frame, frame)) {
+        LOG_OOM();
+        av_frame_free(&pframe->frame);
+        return false;
+    }
+
+    pframe->push_date = sc_tick_now();
+
+    return true;
+}
+
+static void
+sc_paced_frame_destroy(struct sc_paced_frame *pframe) {
+    av_frame_unref(pframe->frame);
+    av_frame_free(&pframe->frame);
+}
+
+static sc_tick
+sc_frame_pacer_get_deadline(struct sc_frame_pacer *fp,
+                            const struct sc_paced_frame *pframe) {
+    // PTS (written by the server) are expressed in microseconds
+    sc_tick pts = SC_TICK_FROM_US(pframe->frame->pts);
+    sc_tick deadline = sc_clock_to_system_time(&fp->clock, pts) + fp->latency;
+
+    if (fp->refresh_period) {
+        if (fp->origin == -1) {
+            fp->origin = deadline;
+        }
+
+        // Align to the nearest refresh
+        sc_tick period = fp->refresh_period;
+        sc_tick n = (deadline - fp->origin + period / 2) / period;
+        deadline = fp->origin + n * period;
+    }
+
+    // Never delay a frame more than the latency target
+    sc_tick max_deadline = pframe->push_date + fp->latency;
+    return MIN(deadline, max_deadline);
+}
+
+static int
+run_frame_pacer(void *data) {
+    struct sc_frame_pacer *fp = data;
+
+    for (;;) {
+        sc_mutex_lock(&fp->mutex);
+
+        while (!fp->stopped && sc_vecdeque_is_empty(&fp->queue)) {
+            sc_cond_wait(&fp->queue_cond, &fp->mutex);
+        }
+
+        if (fp->stopped) {
+            sc_mutex_unlock(&fp->mutex);
+            goto stopped;
+        }
+
+        struct sc_paced_frame pframe = sc_vecdeque_pop(&fp->queue);
+        sc_tick deadline = sc_frame_pacer_get_deadline(fp, &pframe);
+
+        if (deadline <= sc_tick_now()
+                && !sc_vecdeque_is_empty(&fp->queue)) {
+            // Late, and a more recent frame is already available
+            sc_mutex_unlock(&fp->mutex);
+            sc_paced_frame_destroy(&pframe);
+            ++fp->dropped;
+            continue;
+        }
+
+        bool timed_out = false;
+        while (!fp->stopped && !timed_out) {
+            // The wait is not interrupted on new frame
+            timed_out =
+                !sc_cond_timedwait(&fp->queue_cond, &fp->mutex, deadline);
+        }
+
+        bool stopped = fp->stopped;
+        sc_mutex_unlock(&fp->mutex);
+
+        if (stopped) {
+            sc_paced_frame_destroy(&pframe);
+            goto stopped;
+        }
+
+        bool ok = sc_frame_source_sinks_push(&fp->frame_source, pframe.frame);
+        sc_paced_frame_destroy(&pframe);
+        if (!ok) {
+            LOGE("Paced frame could not be pushed, stopping");
+            sc_mutex_lock(&fp->mutex);
+            // Prevent to push any new frame
+            fp->stopped = true;
+            sc_mutex_unlock(&fp->mutex);
+            goto stopped;
+        }
+    }
+
+stopped:
+    assert(fp->stopped);
+
+    // Flush queue
+    while (!sc_vecdeque_is_empty(&fp->queue)) {
+        struct sc_paced_frame *pframe = sc_vecdeque_popref(&fp->queue);
+        sc_paced_frame_destroy(pframe);
+    }
+
+    LOGD("Frame pacer thread ended (%" PRIu64_ " late frames dropped)",
+         fp->dropped);
+
+    return 0;
+}
+
+static bool
+sc_frame_pacer_frame_sink_open(struct sc_frame_sink *sink,
+                               const AVCodecContext *ctx) {
+    struct sc_frame_pacer *fp = DOWNCAST(sink);
+
+    bool ok = sc_mutex_init(&fp->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&fp->queue_cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    sc_clock_init(&fp->clock);
+    sc_vecdeque_init(&fp->queue);
+    fp->stopped = false;
+    fp->origin = -1;
+    fp->dropped = 0;
+
+    if (!sc_frame_source_sinks_open(&fp->frame_source, ctx)) {
+        goto error_destroy_queue_cond;
+    }
+
+    ok = sc_thread_create(&fp->thread, run_frame_pacer, "scrcpy-pacer", fp);
+    if (!ok) {
+        LOGE("Could not start frame pacer thread");
+        goto error_close_sinks;
+    }
+
+    return true;
+
+error_close_sinks:
+    sc_frame_source_sinks_close(&fp->frame_source);
+error_destroy_queue_cond:
+    sc_cond_destroy(&fp->queue_cond);
+error_destroy_mutex:
+    sc_mutex_destroy(&fp->mutex);
+
+    return false;
+}
+
+static void
+sc_frame_pacer_frame_sink_close(struct sc_frame_sink *sink) {
+    struct sc_frame_pacer *fp = DOWNCAST(sink);
+
+    sc_mutex_lock(&fp->mutex);
+    fp->stopped = true;
+    sc_cond_signal(&fp->queue_cond);
+    sc_mutex_unlock(&fp->mutex);
+
+    sc_thread_join(&fp->thread, NULL);
+
+    sc_frame_source_sinks_close(&fp->frame_source);
+
+    sc_vecdeque_destroy(&fp->queue);
+    sc_cond_destroy(&fp->queue_cond);
+    sc_mutex_destroy(&fp->mutex);
+}
+
+static bool
+sc_frame_pacer_frame_sink_push(struct sc_frame_sink *sink,
+                               const AVFrame *frame) {
+    struct sc_frame_pacer *fp = DOWNCAST(sink);
+
+    struct sc_paced_frame pframe;
+    bool ok = sc_paced_frame_init(&pframe, frame);
+    if (!ok) {
+        return false;
+    }
+
+    sc_mutex_lock(&fp->mutex);
+
+    if (fp->stopped) {
+        sc_mutex_unlock(&fp->mutex);
+        sc_paced_frame_destroy(&pframe);
+        return false;
+    }
+
+    sc_tick pts = SC_TICK_FROM_US(frame->pts);
+    sc_clock_update(&fp->clock, pframe.push_date, pts);
+
+    ok = sc_vecdeque_push(&fp->queue, pframe);
+    if (!ok) {
+        sc_mutex_unlock(&fp->mutex);
+        LOG_OOM();
+        sc_paced_frame_destroy(&pframe);
+        return false;
+    }
+
+    sc_cond_signal(&fp->queue_cond);
+
+    sc_mutex_unlock(&fp->mutex);
+
+    return true;
+}
+
+bool
+sc_frame_pacer_init(struct sc_frame_pacer *fp, sc_tick latency,
+                    int refresh_rate) {
+    assert(latency > 0);
+
+    if (!sc_frame_source_init(&fp->frame_source)) {
+        return false;
+    }
+
+    fp->latency = latency;
+    fp->refresh_period = refresh_rate > 0 ? SC_TICK_FREQ / refresh_rate : 0;
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = sc_frame_pacer_frame_sink_open,
+        .close = sc_frame_pacer_frame_sink_close,
+        .push = sc_frame_pacer_frame_sink_push,
+    };
+
+    fp->frame_sink.ops = &ops;
+
+    return true;
+}
+
+void
+sc_frame_pacer_destroy(struct sc_frame_pacer *fp) {
+    sc_frame_source_destroy(&fp->frame_source);
+}
@@ -0,0 +1,74 @@
+#ifndef SC_FRAME_PACER_H
+#define SC_FRAME_PACER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "clock.h"
+#include "trait/frame_source.h"
+#include "trait/frame_sink.h"
+#include "util/thread.h"
+#include "util/tick.h"
+#include "util/vecdeque.h"
+
+// forward declarations
+typedef struct AVFrame AVFrame;
+
+/**
+ * A frame pacer forwards frames at a regular rate, to absorb the network
+ * jitter.
+ *
+ * Each frame is scheduled at the system time estimated from its PTS (see
+ * sc_clock), plus a latency target, aligned to the display refresh period.
+ *
+ * Unlike a delay buffer, the latency added to a frame is bounded by the
+ * latency target (a frame is never delayed more than that from its
+ * reception), and late frames are dropped if a more recent frame is
+ * available.
+ */
+
+struct sc_paced_frame {
+    AVFrame *frame;
+    sc_tick push_date;
+};
+
+struct sc_paced_frame_queue SC_VECDEQUE(struct sc_paced_frame);
+
+struct sc_frame_pacer {
+    struct sc_frame_source frame_source; // frame source trait
+    struct sc_frame_sink frame_sink; // frame sink trait
+
+    sc_tick latency;
+    sc_tick refresh_period; // 0 if unknown
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond queue_cond;
+
+    struct sc_clock clock;
+    struct sc_paced_frame_queue queue;
+    bool stopped;
+
+    // The first presentation date, used as the origin of the refresh grid
+    sc_tick origin;
+    // Number of frames dropped because they were late (only accessed from
+    // the pacer thread)
+    uint64_t dropped;
+};
+
+/**
+ * Initialize a frame pacer.
+ *
+ * \param latency a (strictly) positive latency target
+ * \param refresh_rate the display refresh rate, in Hz (0 if unknown)
+ */
+bool
+sc_frame_pacer_init(struct sc_frame_pacer *fp, sc_tick latency,
+                    int refresh_rate);
+
+void
+sc_frame_pacer_destroy(struct sc_frame_pacer *fp);
+
+#endif
@@ -0,0 +1,295 @@
+#include "frame_share.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <libavutil/imgutils.h>
+
+#include "util/log.h"
+
+/** Downcast frame_sink to sc_frame_share */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_frame_share, frame_sink)
+
+// Alignment of the slots and of their data (a cache line)
+#define SC_FRAME_SHARE_ALIGN 64
+
+static inline size_t
+align(size_t size) {
+    size_t mask = SC_FRAME_SHARE_ALIGN - 1;
+    return (size + mask) & ~mask;
+}
+
+static uint32_t
+get_format(enum AVPixelFormat format) {
+    switch (format) {
+        case AV_PIX_FMT_YUV420P:
+            return SC_FRAME_SHARE_FORMAT_I420;
+        case AV_PIX_FMT_NV12:
+            return SC_FRAME_SHARE_FORMAT_NV12;
+        default:
+            return 0;
+    }
+}
+
+size_t
+sc_frame_share_get_frame_size(enum AVPixelFormat format, unsigned width,
+                              unsigned height) {
+    if (!get_format(format)) {
+        return 0;
+    }
+
+    // Both formats have a full luma plane and 2 chroma samples per 2x2 block
+    size_t chroma_width = (width + 1) / 2;
+    size_t chroma_height = (height + 1) / 2;
+    return (size_t) width * height + 2 * chroma_width * chroma_height;
+}
+
+size_t
+sc_frame_share_get_mem_size(unsigned slot_count, size_t slot_data_size) {
+    size_t slot_size = align(sizeof(struct sc_frame_share_slot))
+                     + align(slot_data_size);
+    return align(sizeof(struct sc_frame_share_header)) + slot_count * slot_size;
+}
+
+void
+sc_frame_share_layout_init(void *mem, unsigned slot_count,
+                           size_t slot_data_size) {
+    assert(slot_count);
+
+    struct sc_frame_share_header *header = mem;
+    header->magic = SC_FRAME_SHARE_MAGIC;
+    header->version = SC_FRAME_SHARE_VERSION;
+    header->header_size = sizeof(*header);
+    header->slot_count = slot_count;
+    header->slot_offset = align(sizeof(*header));
+    header->slot_size = align(sizeof(struct sc_frame_share_slot))
+                      + align(slot_data_size);
+    atomic_init(&header->closed, 0);
+    header->reserved = 0;
+    atomic_init(&header->sequence, 0);
+
+    for (unsigned i = 0; i < slot_count; ++i) {
+        struct sc_frame_share_slot *slot =
+            (void *) ((uint8_t *) mem + header->slot_offset
+                                      + i * header->slot_size);
+        atomic_init(&slot->sequence, 0);
+    }
+}
+
+void
+sc_frame_share_layout_write(void *mem, uint64_t sequence,
+                            const AVFrame *frame) {
+    assert(sequence);
+
+    struct sc_frame_share_header *header = mem;
+    size_t index = (sequence - 1) % header->slot_count;
+    uint8_t *slot_ptr = (uint8_t *) mem + header->slot_offset
+                                        + index * header->slot_size;
+    struct sc_frame_share_slot *slot = (void *) slot_ptr;
+    uint8_t *data = slot_ptr + align(sizeof(*slot));
+
+    // Invalidate the slot before overwriting its content
+    atomic_store_explicit(&slot->sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    unsigned width = frame->width;
+    unsigned height = frame->height;
+    unsigned chroma_width = (width + 1) / 2;
+    unsigned chroma_height = (height + 1) / 2;
+    bool nv12 = frame->format == AV_PIX_FMT_NV12;
+
+    unsigned plane_count = nv12 ? 2 : 3;
+    unsigned widths[3] = {width, nv12 ? 2 * chroma_width : chroma_width,
+                          chroma_width};
+    unsigned heights[3] = {height, chroma_height, chroma_height};
+
+    // The planes are tightly packed
+    uint32_t offset = 0;
+    for (unsigned i = 0; i < plane_count; ++i) {
+        av_image_copy_plane(data + offset, widths[i], frame->data[i],
+                            frame->linesize[i], widths[i], heights[i]);
+        slot->offsets[i] = offset;
+        slot->strides[i] = widths[i];
+        offset += widths[i] * heights[i];
+    }
+    for (unsigned i = plane_count; i < 4; ++i) {
+        slot->offsets[i] = 0;
+        slot->strides[i] = 0;
+    }
+
+    slot->pts = frame->pts;
+    slot->format = get_format(frame->format);
+    slot->width = width;
+    slot->height = height;
+    slot->plane_count = plane_count;
+    slot->size = offset;
+
+    // Publish the frame
+    atomic_store_explicit(&slot->sequence, sequence, memory_order_release);
+    atomic_store_explicit(&header->sequence, sequence, memory_order_release);
+}
+
+static void
+sc_frame_share_unmap(struct sc_frame_share *fs) {
+    if (!fs->mem) {
+        return;
+    }
+
+    struct sc_frame_share_header *header = fs->mem;
+    // Notify the consumers
+    atomic_store_explicit(&header->closed, 1, memory_order_release);
+
+    munmap(fs->mem, fs->mem_size);
+    close(fs->fd);
+    shm_unlink(fs->name);
+    fs->mem = NULL;
+}
+
+static bool
+sc_frame_share_map(struct sc_frame_share *fs, size_t slot_data_size) {
+    assert(!fs->mem);
+
+    fs->fd = shm_open(fs->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fs->fd == -1) {
+        if (errno == EEXIST) {
+            LOGE("Shared memory %s already exists (used by another "
+                 "instance?)", fs->name);
+        } else {
+            LOGE("Could not create shared memory %s: %s", fs->name,
+                 strerror(errno));
+        }
+        return false;
+    }
+
+    size_t mem_size = sc_frame_share_get_mem_size(SC_FRAME_SHARE_SLOT_COUNT,
+                                                  slot_data_size);
+    if (ftruncate(fs->fd, mem_size)) {
+        LOGE("Could not resize shared memory %s: %s", fs->name,
+             strerror(errno));
+        goto error_unlink;
+    }
+
+    // The new content is zeroed
+    void *mem = mmap(NULL, mem_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fs->fd, 0);
+    if (mem == MAP_FAILED) {
+        LOGE("Could not map shared memory %s: %s", fs->name, strerror(errno));
+        goto error_unlink;
+    }
+
+    sc_frame_share_layout_init(mem, SC_FRAME_SHARE_SLOT_COUNT, slot_data_size);
+
+    fs->mem = mem;
+    fs->mem_size = mem_size;
+    fs->slot_data_size = slot_data_size;
+
+    return true;
+
+error_unlink:
+    close(fs->fd);
+    shm_unlink(fs->name);
+    return false;
+}
+
+static bool
+sc_frame_share_push(struct sc_frame_share *fs, const AVFrame *frame) {
+    size_t size = sc_frame_share_get_frame_size(frame->format, frame->width,
+                                                frame->height);
+    if (!size) {
+        if (!fs->format_warned) {
+            LOGW("Frame share: unsupported frame format %d, frames ignored",
+                 frame->format);
+            fs->format_warned = true;
+        }
+        return true;
+    }
+
+    if (size > fs->slot_data_size) {
+        // The frame does not fit, replace the shared memory object (the
+        // consumers are notified and must reopen it)
+        bool replaced = fs->mem;
+        sc_frame_share_unmap(fs);
+        if (!sc_frame_share_map(fs, size)) {
+            return false;
+        }
+
+        LOGI("Frame share: %s (%ux%u)%s", fs->name, frame->width,
+             frame->height, replaced ? " replaced" : "");
+    }
+
+    sc_frame_share_layout_write(fs->mem, ++fs->sequence, frame);
+
+    return true;
+}
+
+static bool
+sc_frame_share_frame_sink_open(struct sc_frame_sink *sink,
+                               const AVCodecContext *ctx) {
+    struct sc_frame_share *fs = DOWNCAST(sink);
+
+    fs->mem = NULL;
+    fs->slot_data_size = 0;
+    fs->sequence = 0;
+    fs->format_warned = false;
+
+    if (!ctx->width || !ctx->height) {
+        // The shared memory object will be created on the first frame
+        return true;
+    }
+
+    // Create it immediately, so that the consumers may open it before the
+    // first frame (it is replaced if the frames do not fit)
+    size_t size = sc_frame_share_get_frame_size(AV_PIX_FMT_YUV420P,
+                                                ctx->width, ctx->height);
+    if (!sc_frame_share_map(fs, size)) {
+        return false;
+    }
+
+    LOGI("Frame share: %s (%ux%u)", fs->name, ctx->width, ctx->height);
+    return true;
+}
+
+static void
+sc_frame_share_frame_sink_close(struct sc_frame_sink *sink) {
+    struct sc_frame_share *fs = DOWNCAST(sink);
+    sc_frame_share_unmap(fs);
+}
+
+static bool
+sc_frame_share_frame_sink_push(struct sc_frame_sink *sink,
+                               const AVFrame *frame) {
+    struct sc_frame_share *fs = DOWNCAST(sink);
+    return sc_frame_share_push(fs, frame);
+}
+
+bool
+sc_frame_share_init(struct sc_frame_share *fs, const char *name) {
+    // POSIX shared memory object names start with '/'
+    int r = asprintf(&fs->name, "%s%s", name[0] == '/' ? "" : "/", name);
+    if (r == -1) {
+        LOG_OOM();
+        return false;
+    }
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = sc_frame_share_frame_sink_open,
+        .close = sc_frame_share_frame_sink_close,
+        .push = sc_frame_share_frame_sink_push,
+    };
+
+    fs->frame_sink.ops = &ops;
+    fs->mem = NULL;
+
+    return true;
+}
+
+void
+sc_frame_share_destroy(struct sc_frame_share *fs) {
+    assert(!fs->mem);
+    free(fs->name);
+}
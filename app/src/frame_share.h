@@ -0,0 +1,124 @@
+#ifndef SC_FRAME_SHARE_H
+#define SC_FRAME_SHARE_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+
+#include "trait/frame_sink.h"
+
+/*
+ * Layout of the shared memory object (all the values in the host byte order)
+ *
+ * The object starts with a struct sc_frame_share_header, followed by
+ * `slot_count` slots of `slot_size` bytes at `slot_offset`. Each slot starts
+ * with a struct sc_frame_share_slot, followed by the frame data (the planes at
+ * `offsets[i]` from the start of the data).
+ *
+ * The frame `sequence` (starting at 1) is written to the slot
+ * `(sequence - 1) % slot_count`. To read the latest frame, a consumer loads
+ * the header `sequence`, reads the slot, then checks that the slot `sequence`
+ * is still the same (it is 0 while the slot is written): since the producer
+ * writes the other slots first, a consumer has `slot_count - 1` frame
+ * intervals to read a frame in place.
+ *
+ * Once `closed` is set, the producer has stopped, or has replaced the object
+ * by a new one with the same name (for example if the frames became larger):
+ * the consumers must reopen it.
+ */
+
+#define SC_FRAME_SHARE_MAGIC 0x53464353 // "SCFS"
+#define SC_FRAME_SHARE_VERSION 1
+
+// Formats (FourCC)
+#define SC_FRAME_SHARE_FORMAT_I420 0x30323449 // "I420" (YUV420P)
+#define SC_FRAME_SHARE_FORMAT_NV12 0x3231564E // "NV12"
+
+#define SC_FRAME_SHARE_SLOT_COUNT 4
+
+struct sc_frame_share_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t slot_count;
+    uint64_t slot_offset;
+    uint64_t slot_size;
+    _Atomic uint32_t closed;
+    uint32_t reserved;
+    // The sequence of the last published frame (0 if none)
+    _Atomic uint64_t sequence;
+};
+
+struct sc_frame_share_slot {
+    // The sequence of the frame in the slot (0 while it is written)
+    _Atomic uint64_t sequence;
+    int64_t pts; // in microseconds
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t plane_count;
+    uint32_t offsets[4];
+    uint32_t strides[4];
+    uint64_t size; // of the frame data
+};
+
+/**
+ * Frame sink publishing the decoded frames to a POSIX shared memory object
+ *
+ * The frames are copied once (tightly packed) to the ring of slots, from
+ * which other local processes may read them in place at full rate.
+ */
+struct sc_frame_share {
+    struct sc_frame_sink frame_sink; // frame sink trait
+
+    char *name; // "/name"
+
+    int fd;
+    void *mem;
+    size_t mem_size;
+    size_t slot_data_size;
+    uint64_t sequence;
+    bool format_warned;
+};
+
+bool
+sc_frame_share_init(struct sc_frame_share *fs, const char *name);
+
+void
+sc_frame_share_destroy(struct sc_frame_share *fs);
+
+/**
+ * Return the size of the data of a frame, or 0 if its format is not supported
+ */
+size_t
+sc_frame_share_get_frame_size(enum AVPixelFormat format, unsigned width,
+                              unsigned height);
+
+/**
+ * Return the size of a mapping of `slot_count` slots of `slot_data_size`
+ * bytes of frame data
+ */
+size_t
+sc_frame_share_get_mem_size(unsigned slot_count, size_t slot_data_size);
+
+/**
+ * Initialize the header of a (zeroed) mapping
+ */
+void
+sc_frame_share_layout_init(void *mem, unsigned slot_count,
+                           size_t slot_data_size);
+
+/**
+ * Write a frame to its slot and publish it
+ *
+ * The frame must be in a supported format, and its data must fit in a slot.
+ */
+void
+sc_frame_share_layout_write(void *mem, uint64_t sequence,
+                            const AVFrame *frame);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef SC_FRAME_SIZE_H
+#define SC_FRAME_SIZE_H
+
+#include "common.h"
+
+#include <stddef.h>
+#include <libavutil/frame.h>
+
+/**
+ * Return the number of bytes of the buffers referenced by a frame
+ *
+ * The buffers may be shared with other frames (or be pooled by the decoder),
+ * so this is the memory kept alive by the frame, not necessarily allocated for
+ * it. For a hardware frame, only the (small) buffer wrapping the surface is
+ * counted.
+ */
+static inline size_t
+sc_frame_get_size(const AVFrame *frame) {
+    size_t size = 0;
+    for (unsigned i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; ++i) {
+        size += frame->buf[i]->size;
+    }
+    for (int i = 0; i < frame->nb_extended_buf; ++i) {
+        size += frame->extended_buf[i]->size;
+    }
+    return size;
+}
+
+#endif
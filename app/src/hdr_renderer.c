@@ -0,0 +1,609 @@
+#include "hdr_renderer.h"
+
+#include <assert.h>
+#include <libavutil/mastering_display_metadata.h>
+#include <libavutil/pixdesc.h>
+
+#include "util/log.h"
+
+// Nominal luminance of the SDR reference white, in nits (ITU-R BT.2408)
+#define SC_HDR_SDR_WHITE_NITS 203.f
+// Assumed peak luminance if the stream does not provide it
+#define SC_HDR_DEFAULT_PEAK_NITS 1000.f
+
+static const char *const vertex_shader_source =
+    "#version 110\n"
+    "varying vec2 tex_coord;\n"
+    "void main() {\n"
+    "    tex_coord = gl_MultiTexCoord0.xy;\n"
+    "    gl_Position = vec4(gl_Vertex.xy, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *const fragment_shader_source =
+    "#version 110\n"
+    "uniform sampler2D tex_y;\n"
+    "uniform sampler2D tex_u;\n"
+    "uniform sampler2D tex_v;\n"
+    "uniform float code_scale;\n"
+    "uniform vec3 offset;\n"
+    "uniform vec3 range;\n"
+    "uniform mat3 yuv_to_rgb;\n"
+    "uniform bool interleaved;\n"
+    "uniform int transfer;\n"
+    "uniform float peak;\n"
+    "uniform mat3 gamut;\n"
+    "uniform bool convert_gamut;\n"
+    "uniform bool lanczos;\n"
+    "uniform vec2 tex_size;\n"
+    "varying vec2 tex_coord;\n"
+    "\n"
+    "const vec3 luma = vec3(0.2627, 0.6780, 0.0593);\n"
+    "const float sdr_white = 203.0;\n"
+    "\n"
+    // SMPTE ST 2084 EOTF, relative to the SDR white
+    "vec3 pq_to_linear(vec3 e) {\n"
+    "    const float m1 = 0.1593017578125;\n"
+    "    const float m2 = 78.84375;\n"
+    "    const float c1 = 0.8359375;\n"
+    "    const float c2 = 18.8515625;\n"
+    "    const float c3 = 18.6875;\n"
+    "    vec3 p = pow(e, vec3(1.0 / m2));\n"
+    "    vec3 l = pow(max(p - c1, 0.0) / (c2 - c3 * p), vec3(1.0 / m1));\n"
+    "    return l * (10000.0 / sdr_white);\n"
+    "}\n"
+    "\n"
+    // ARIB STD-B67 inverse OETF, then the OOTF of a 1000 nits display
+    // (system gamma 1.2), relative to the SDR white
+    "vec3 hlg_to_linear(vec3 e) {\n"
+    "    const float a = 0.17883277;\n"
+    "    const float b = 0.28466892;\n"
+    "    const float c = 0.55991073;\n"
+    "    vec3 low = e * e / 3.0;\n"
+    "    vec3 high = (exp((e - c) / a) + b) / 12.0;\n"
+    "    vec3 scene = mix(low, high, step(0.5, e));\n"
+    "    float y = dot(luma, scene);\n"
+    "    return scene * pow(max(y, 1e-6), 0.2) * (1000.0 / sdr_white);\n"
+    "}\n"
+    "\n"
+    // Keep the luminance below the knee, and compress the highlights up to
+    // the peak into the remaining range (extended Reinhard), applied to the
+    // luminance to preserve the hue
+    "vec3 tone_map(vec3 rgb) {\n"
+    "    const float knee = 0.5;\n"
+    "    float l = dot(luma, rgb);\n"
+    "    if (l <= knee || peak <= 1.0) {\n"
+    "        return rgb;\n"
+    "    }\n"
+    "    float t = (l - knee) / (1.0 - knee);\n"
+    "    float t_max = (peak - knee) / (1.0 - knee);\n"
+    "    float td = t * (1.0 + t / (t_max * t_max)) / (1.0 + t);\n"
+    "    return rgb * ((knee + (1.0 - knee) * td) / l);\n"
+    "}\n"
+    "\n"
+    // Lanczos kernel with a = 2
+    "float lanczos2(float x) {\n"
+    "    x = abs(x);\n"
+    "    if (x < 1e-5) {\n"
+    "        return 1.0;\n"
+    "    }\n"
+    "    if (x >= 2.0) {\n"
+    "        return 0.0;\n"
+    "    }\n"
+    "    float px = 3.14159265 * x;\n"
+    "    return 2.0 * sin(px) * sin(px / 2.0) / (px * px);\n"
+    "}\n"
+    "\n"
+    // Interpolate the luma from the 4x4 nearest texels, and clamp the result
+    // to the range of the 2x2 nearest ones (the bilinear footprint), so that
+    // the edges are sharpened without overshoot
+    "float sample_y_lanczos(vec2 coord) {\n"
+    "    vec2 pos = coord * tex_size - 0.5;\n"
+    "    vec2 base = floor(pos);\n"
+    "    vec2 f = pos - base;\n"
+    "    float sum = 0.0;\n"
+    "    float weights = 0.0;\n"
+    "    float lo = 1.0;\n"
+    "    float hi = 0.0;\n"
+    "    for (int j = -1; j <= 2; ++j) {\n"
+    "        float wy = lanczos2(float(j) - f.y);\n"
+    "        for (int i = -1; i <= 2; ++i) {\n"
+    "            float w = lanczos2(float(i) - f.x) * wy;\n"
+    "            vec2 texel = (base + vec2(float(i), float(j)) + 0.5)\n"
+    "                       / tex_size;\n"
+    "            float v = texture2D(tex_y, texel).r;\n"
+    "            sum += v * w;\n"
+    "            weights += w;\n"
+    "            if (i >= 0 && i <= 1 && j >= 0 && j <= 1) {\n"
+    "                lo = min(lo, v);\n"
+    "                hi = max(hi, v);\n"
+    "            }\n"
+    "        }\n"
+    "    }\n"
+    "    return clamp(sum / weights, lo, hi);\n"
+    "}\n"
+    "\n"
+    "void main() {\n"
+    "    vec3 yuv;\n"
+    "    if (lanczos) {\n"
+    "        yuv.x = sample_y_lanczos(tex_coord);\n"
+    "    } else {\n"
+    "        yuv.x = texture2D(tex_y, tex_coord).r;\n"
+    "    }\n"
+    "    if (interleaved) {\n"
+    "        vec4 uv = texture2D(tex_u, tex_coord);\n"
+    "        yuv.y = uv.r;\n"
+    "        yuv.z = uv.a;\n"
+    "    } else {\n"
+    "        yuv.y = texture2D(tex_u, tex_coord).r;\n"
+    "        yuv.z = texture2D(tex_v, tex_coord).r;\n"
+    "    }\n"
+    "    yuv = (yuv * code_scale - offset) / range;\n"
+    "    vec3 rgb = clamp(yuv_to_rgb * yuv, 0.0, 1.0);\n"
+    "    if (transfer != 0) {\n"
+    "        if (transfer == 1) {\n"
+    "            rgb = pq_to_linear(rgb);\n"
+    "        } else {\n"
+    "            rgb = hlg_to_linear(rgb);\n"
+    "        }\n"
+    "        rgb = tone_map(rgb);\n"
+    "        if (convert_gamut) {\n"
+    "            rgb = gamut * rgb;\n"
+    "        }\n"
+    "        rgb = pow(clamp(rgb, 0.0, 1.0), vec3(1.0 / 2.2));\n"
+    "    }\n"
+    "    gl_FragColor = vec4(rgb, 1.0);\n"
+    "}\n";
+
+// BT.2020 to BT.709 primaries, in linear light (column-major)
+static const GLfloat bt2020_to_bt709[9] = {
+     1.6605f, -0.1246f, -0.0182f,
+    -0.5876f,  1.1329f, -0.1006f,
+    -0.0728f, -0.0083f,  1.1187f,
+};
+
+// State of the SDL renderer modified by the HDR renderer
+struct sc_hdr_gl_state {
+    GLint program;
+    GLint active_texture;
+    GLint textures[3];
+    GLint viewport[4];
+    GLint unpack_row_length;
+    GLint unpack_alignment;
+};
+
+static void
+sc_hdr_gl_state_save(struct sc_opengl *gl, struct sc_hdr_gl_state *state) {
+    gl->GetIntegerv(GL_CURRENT_PROGRAM, &state->program);
+    gl->GetIntegerv(GL_ACTIVE_TEXTURE, &state->active_texture);
+    for (int i = 0; i < 3; ++i) {
+        gl->ActiveTexture(GL_TEXTURE0 + i);
+        gl->GetIntegerv(GL_TEXTURE_BINDING_2D, &state->textures[i]);
+    }
+    gl->GetIntegerv(GL_VIEWPORT, state->viewport);
+    gl->GetIntegerv(GL_UNPACK_ROW_LENGTH, &state->unpack_row_length);
+    gl->GetIntegerv(GL_UNPACK_ALIGNMENT, &state->unpack_alignment);
+}
+
+// Restore exactly the state the SDL renderer expects (it caches it)
+static void
+sc_hdr_gl_state_restore(struct sc_opengl *gl,
+                        const struct sc_hdr_gl_state *state) {
+    gl->PixelStorei(GL_UNPACK_ALIGNMENT, state->unpack_alignment);
+    gl->PixelStorei(GL_UNPACK_ROW_LENGTH, state->unpack_row_length);
+    gl->Viewport(state->viewport[0], state->viewport[1], state->viewport[2],
+                 state->viewport[3]);
+    for (int i = 0; i < 3; ++i) {
+        gl->ActiveTexture(GL_TEXTURE0 + i);
+        gl->BindTexture(GL_TEXTURE_2D, state->textures[i]);
+    }
+    gl->ActiveTexture(state->active_texture);
+    gl->UseProgram(state->program);
+}
+
+bool
+sc_hdr_renderer_supports_format(int format) {
+    return format == AV_PIX_FMT_YUV420P10LE || format == AV_PIX_FMT_P010LE;
+}
+
+static inline bool
+sc_hdr_renderer_is_8bit(int format) {
+    return format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_NV12;
+}
+
+bool
+sc_hdr_renderer_accepts_format(int format) {
+    return sc_hdr_renderer_supports_format(format)
+        || sc_hdr_renderer_is_8bit(format);
+}
+
+static GLuint
+sc_hdr_renderer_compile(struct sc_opengl *gl, GLenum type,
+                        const char *source) {
+    GLuint shader = gl->CreateShader(type);
+    if (!shader) {
+        LOGE("Could not create shader");
+        return 0;
+    }
+
+    gl->ShaderSource(shader, 1, &source, NULL);
+    gl->CompileShader(shader);
+
+    GLint status;
+    gl->GetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status) {
+        char log[512];
+        gl->GetShaderInfoLog(shader, sizeof(log), NULL, log);
+        LOGE("Could not compile shader: %s", log);
+        gl->DeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+static GLuint
+sc_hdr_renderer_link(struct sc_opengl *gl) {
+    GLuint vs = sc_hdr_renderer_compile(gl, GL_VERTEX_SHADER,
+                                        vertex_shader_source);
+    if (!vs) {
+        return 0;
+    }
+
+    GLuint fs = sc_hdr_renderer_compile(gl, GL_FRAGMENT_SHADER,
+                                        fragment_shader_source);
+    if (!fs) {
+        gl->DeleteShader(vs);
+        return 0;
+    }
+
+    GLuint program = gl->CreateProgram();
+    if (!program) {
+        LOGE("Could not create shader program");
+        goto end;
+    }
+
+    gl->AttachShader(program, vs);
+    gl->AttachShader(program, fs);
+    gl->LinkProgram(program);
+
+    GLint status;
+    gl->GetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status) {
+        char log[512];
+        gl->GetProgramInfoLog(program, sizeof(log), NULL, log);
+        LOGE("Could not link shader program: %s", log);
+        gl->DeleteProgram(program);
+        program = 0;
+    }
+
+end:
+    // Flagged for deletion, deleted with the program
+    gl->DeleteShader(vs);
+    gl->DeleteShader(fs);
+
+    return program;
+}
+
+bool
+sc_hdr_renderer_init(struct sc_hdr_renderer *hr, struct sc_opengl *gl,
+                     bool mipmaps, enum sc_upscale_filter upscale_filter) {
+    hr->gl = gl;
+    hr->mipmaps = mipmaps;
+    hr->upscale_filter = upscale_filter;
+
+    struct sc_hdr_gl_state state;
+    sc_hdr_gl_state_save(gl, &state);
+
+    hr->program = sc_hdr_renderer_link(gl);
+    if (!hr->program) {
+        sc_hdr_gl_state_restore(gl, &state);
+        return false;
+    }
+
+    GLuint program = hr->program;
+    hr->loc_code_scale = gl->GetUniformLocation(program, "code_scale");
+    hr->loc_offset = gl->GetUniformLocation(program, "offset");
+    hr->loc_range = gl->GetUniformLocation(program, "range");
+    hr->loc_yuv_to_rgb = gl->GetUniformLocation(program, "yuv_to_rgb");
+    hr->loc_interleaved = gl->GetUniformLocation(program, "interleaved");
+    hr->loc_transfer = gl->GetUniformLocation(program, "transfer");
+    hr->loc_peak = gl->GetUniformLocation(program, "peak");
+    hr->loc_gamut = gl->GetUniformLocation(program, "gamut");
+    hr->loc_convert_gamut = gl->GetUniformLocation(program, "convert_gamut");
+    hr->loc_lanczos = gl->GetUniformLocation(program, "lanczos");
+    hr->loc_tex_size = gl->GetUniformLocation(program, "tex_size");
+
+    // Constant uniforms
+    gl->UseProgram(program);
+    gl->Uniform1i(gl->GetUniformLocation(program, "tex_y"), 0);
+    gl->Uniform1i(gl->GetUniformLocation(program, "tex_u"), 1);
+    gl->Uniform1i(gl->GetUniformLocation(program, "tex_v"), 2);
+    gl->UniformMatrix3fv(hr->loc_gamut, 1, GL_FALSE, bt2020_to_bt709);
+
+    gl->GenTextures(3, hr->textures);
+    for (int i = 0; i < 3; ++i) {
+        gl->BindTexture(GL_TEXTURE_2D, hr->textures[i]);
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                          mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    sc_hdr_gl_state_restore(gl, &state);
+
+    hr->size.width = 0;
+    hr->size.height = 0;
+    hr->format = AV_PIX_FMT_NONE;
+    hr->params_logged = false;
+
+    return true;
+}
+
+void
+sc_hdr_renderer_destroy(struct sc_hdr_renderer *hr) {
+    struct sc_opengl *gl = hr->gl;
+    gl->DeleteTextures(3, hr->textures);
+    gl->DeleteProgram(hr->program);
+}
+
+static void
+sc_hdr_renderer_set_matrix(struct sc_hdr_renderer *hr, float kr, float kb) {
+    float kg = 1.f - kr - kb;
+    float *m = hr->params.yuv_to_rgb;
+    // Column 0: Y
+    m[0] = 1.f;
+    m[1] = 1.f;
+    m[2] = 1.f;
+    // Column 1: Cb
+    m[3] = 0.f;
+    m[4] = -2.f * kb * (1.f - kb) / kg;
+    m[5] = 2.f * (1.f - kb);
+    // Column 2: Cr
+    m[6] = 2.f * (1.f - kr);
+    m[7] = -2.f * kr * (1.f - kr) / kg;
+    m[8] = 0.f;
+}
+
+static float
+sc_hdr_renderer_get_peak_nits(const AVFrame *frame) {
+    AVFrameSideData *sd =
+        av_frame_get_side_data(frame, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL);
+    if (sd) {
+        const AVContentLightMetadata *clm =
+            (const AVContentLightMetadata *) sd->data;
+        if (clm->MaxCLL) {
+            return clm->MaxCLL;
+        }
+    }
+
+    sd = av_frame_get_side_data(frame, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA);
+    if (sd) {
+        const AVMasteringDisplayMetadata *mdm =
+            (const AVMasteringDisplayMetadata *) sd->data;
+        if (mdm->has_luminance && mdm->max_luminance.num) {
+            return av_q2d(mdm->max_luminance);
+        }
+    }
+
+    return SC_HDR_DEFAULT_PEAK_NITS;
+}
+
+static void
+sc_hdr_renderer_update_params(struct sc_hdr_renderer *hr,
+                              const AVFrame *frame) {
+    bool eight_bit = sc_hdr_renderer_is_8bit(frame->format);
+    hr->params.interleaved = frame->format == AV_PIX_FMT_P010LE
+                          || frame->format == AV_PIX_FMT_NV12;
+    if (eight_bit) {
+        hr->params.code_scale = 255.f * 4;
+    } else {
+        // YUV420P10 stores the 10 bits in the LSB, P010 in the MSB
+        bool p010 = frame->format == AV_PIX_FMT_P010LE;
+        hr->params.code_scale = p010 ? 65535.f / 64 : 65535.f;
+    }
+
+    if (frame->color_range == AVCOL_RANGE_JPEG) {
+        float full = eight_bit ? 255.f * 4 : 1023.f;
+        hr->params.offset[0] = 0.f;
+        hr->params.range[0] = full;
+        hr->params.range[1] = hr->params.range[2] = full;
+    } else {
+        hr->params.offset[0] = 64.f;
+        hr->params.range[0] = 876.f;
+        hr->params.range[1] = hr->params.range[2] = 896.f;
+    }
+    hr->params.offset[1] = hr->params.offset[2] = 512.f;
+
+    bool bt2020 = frame->color_primaries == AVCOL_PRI_BT2020;
+    switch (frame->colorspace) {
+        case AVCOL_SPC_BT2020_NCL:
+            sc_hdr_renderer_set_matrix(hr, 0.2627f, 0.0593f);
+            break;
+        case AVCOL_SPC_BT709:
+            sc_hdr_renderer_set_matrix(hr, 0.2126f, 0.0722f);
+            break;
+        case AVCOL_SPC_SMPTE170M:
+        case AVCOL_SPC_BT470BG:
+            sc_hdr_renderer_set_matrix(hr, 0.299f, 0.114f);
+            break;
+        default:
+            if (bt2020) {
+                sc_hdr_renderer_set_matrix(hr, 0.2627f, 0.0593f);
+            } else {
+                sc_hdr_renderer_set_matrix(hr, 0.2126f, 0.0722f);
+            }
+            break;
+    }
+
+    if (frame->color_trc == AVCOL_TRC_SMPTE2084) {
+        hr->params.transfer = SC_HDR_TRANSFER_PQ;
+    } else if (frame->color_trc == AVCOL_TRC_ARIB_STD_B67) {
+        hr->params.transfer = SC_HDR_TRANSFER_HLG;
+    } else {
+        hr->params.transfer = SC_HDR_TRANSFER_SDR;
+    }
+
+    hr->params.convert_gamut = bt2020
+                            && hr->params.transfer != SC_HDR_TRANSFER_SDR;
+
+    float peak_nits = hr->params.transfer == SC_HDR_TRANSFER_PQ
+                    ? sc_hdr_renderer_get_peak_nits(frame)
+                    : SC_HDR_DEFAULT_PEAK_NITS;
+    hr->params.peak = peak_nits / SC_HDR_SDR_WHITE_NITS;
+
+    if (!hr->params_logged) {
+        const char *transfer =
+            hr->params.transfer == SC_HDR_TRANSFER_PQ ? "PQ"
+          : hr->params.transfer == SC_HDR_TRANSFER_HLG ? "HLG"
+          : "SDR";
+        LOGI("%s video: %s, %s, %s transfer (peak %.0f nits)",
+             eight_bit ? "8-bit" : "10-bit",
+             av_get_pix_fmt_name(frame->format),
+             av_color_space_name(frame->colorspace), transfer,
+             hr->params.transfer == SC_HDR_TRANSFER_SDR ? 0.f : peak_nits);
+        hr->params_logged = true;
+    }
+}
+
+bool
+sc_hdr_renderer_update(struct sc_hdr_renderer *hr, const AVFrame *frame) {
+    assert(sc_hdr_renderer_accepts_format(frame->format));
+    struct sc_opengl *gl = hr->gl;
+
+    bool eight_bit = sc_hdr_renderer_is_8bit(frame->format);
+    bool interleaved = frame->format == AV_PIX_FMT_P010LE
+                    || frame->format == AV_PIX_FMT_NV12;
+    GLenum type = eight_bit ? GL_UNSIGNED_BYTE : GL_UNSIGNED_SHORT;
+    int sample_size = eight_bit ? 1 : 2;
+    int chroma_width = (frame->width + 1) / 2;
+    int chroma_height = (frame->height + 1) / 2;
+
+    bool realloc = frame->width != hr->size.width
+                || frame->height != hr->size.height
+                || frame->format != hr->format;
+
+    struct sc_hdr_gl_state state;
+    sc_hdr_gl_state_save(gl, &state);
+
+    gl->ActiveTexture(GL_TEXTURE0);
+    gl->PixelStorei(GL_UNPACK_ALIGNMENT, sample_size);
+
+    unsigned planes = interleaved ? 2 : 3;
+    for (unsigned i = 0; i < planes; ++i) {
+        int w = i ? chroma_width : frame->width;
+        int h = i ? chroma_height : frame->height;
+        // The UV plane of P010 and NV12 contains 2 samples (U and V) per texel
+        bool two_channels = interleaved && i == 1;
+        GLenum format = two_channels ? GL_LUMINANCE_ALPHA : GL_LUMINANCE;
+        GLint internal;
+        if (eight_bit) {
+            internal = two_channels ? GL_LUMINANCE8_ALPHA8 : GL_LUMINANCE8;
+        } else {
+            internal = two_channels ? GL_LUMINANCE16_ALPHA16 : GL_LUMINANCE16;
+        }
+        int texel_size = two_channels ? 2 * sample_size : sample_size;
+
+        gl->BindTexture(GL_TEXTURE_2D, hr->textures[i]);
+        if (realloc) {
+            gl->TexImage2D(GL_TEXTURE_2D, 0, internal, w, h, 0, format, type,
+                           NULL);
+        }
+        gl->PixelStorei(GL_UNPACK_ROW_LENGTH,
+                        frame->linesize[i] / texel_size);
+        gl->TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, format, type,
+                          frame->data[i]);
+        if (hr->mipmaps) {
+            gl->GenerateMipmap(GL_TEXTURE_2D);
+        }
+    }
+
+    sc_hdr_gl_state_restore(gl, &state);
+
+    if (realloc) {
+        hr->size.width = frame->width;
+        hr->size.height = frame->height;
+        hr->format = frame->format;
+    }
+
+    sc_hdr_renderer_update_params(hr, frame);
+
+    return true;
+}
+
+// Tell whether the last frame is displayed larger than its size
+static bool
+sc_hdr_renderer_is_upscaled(const struct sc_hdr_renderer *hr,
+                            const SDL_Rect *geometry,
+                            enum sc_orientation orientation) {
+    int w = geometry->w;
+    int h = geometry->h;
+    if (sc_orientation_is_swap(orientation)) {
+        w = geometry->h;
+        h = geometry->w;
+    }
+
+    return w > hr->size.width || h > hr->size.height;
+}
+
+void
+sc_hdr_renderer_render(struct sc_hdr_renderer *hr, const SDL_Rect *geometry,
+                       enum sc_orientation orientation, int output_width,
+                       int output_height) {
+    struct sc_opengl *gl = hr->gl;
+
+    struct sc_hdr_gl_state state;
+    sc_hdr_gl_state_save(gl, &state);
+
+    gl->Viewport(0, 0, output_width, output_height);
+    gl->UseProgram(hr->program);
+
+    unsigned planes = hr->params.interleaved ? 2 : 3;
+    for (unsigned i = 0; i < planes; ++i) {
+        gl->ActiveTexture(GL_TEXTURE0 + i);
+        gl->BindTexture(GL_TEXTURE_2D, hr->textures[i]);
+    }
+
+    gl->Uniform1f(hr->loc_code_scale, hr->params.code_scale);
+    gl->Uniform3f(hr->loc_offset, hr->params.offset[0], hr->params.offset[1],
+                  hr->params.offset[2]);
+    gl->Uniform3f(hr->loc_range, hr->params.range[0], hr->params.range[1],
+                  hr->params.range[2]);
+    gl->UniformMatrix3fv(hr->loc_yuv_to_rgb, 1, GL_FALSE,
+                         hr->params.yuv_to_rgb);
+    gl->Uniform1i(hr->loc_interleaved, hr->params.interleaved);
+    gl->Uniform1i(hr->loc_transfer, hr->params.transfer);
+    gl->Uniform1f(hr->loc_peak, hr->params.peak);
+    gl->Uniform1i(hr->loc_convert_gamut, hr->params.convert_gamut);
+
+    bool lanczos = hr->upscale_filter == SC_UPSCALE_FILTER_LANCZOS
+                && sc_hdr_renderer_is_upscaled(hr, geometry, orientation);
+    gl->Uniform1i(hr->loc_lanczos, lanczos);
+    gl->Uniform2f(hr->loc_tex_size, hr->size.width, hr->size.height);
+
+    // Corners of the geometry (top-left, top-right, bottom-right,
+    // bottom-left) in normalized device coordinates
+    float x0 = 2.f * geometry->x / output_width - 1.f;
+    float x1 = 2.f * (geometry->x + geometry->w) / output_width - 1.f;
+    float y0 = 1.f - 2.f * geometry->y / output_height;
+    float y1 = 1.f - 2.f * (geometry->y + geometry->h) / output_height;
+    const float vertices[4][2] = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y1}};
+
+    // Same transformation as SDL_RenderCopyEx(): flip horizontally, then
+    // rotate clockwise
+    static const float tex[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+    static const float tex_mirror[4][2] = {{1, 0}, {0, 0}, {0, 1}, {1, 1}};
+    const float (*t)[2] = sc_orientation_is_mirror(orientation) ? tex_mirror
+                                                                : tex;
+    unsigned rotation = sc_orientation_get_rotation(orientation);
+
+    gl->Begin(GL_QUADS);
+    for (unsigned i = 0; i < 4; ++i) {
+        const float *tc = t[(i + 4 - rotation) % 4];
+        gl->TexCoord2f(tc[0], tc[1]);
+        gl->Vertex2f(vertices[i][0], vertices[i][1]);
+    }
+    gl->End();
+
+    sc_hdr_gl_state_restore(gl, &state);
+}
@@ -0,0 +1,108 @@
+#ifndef SC_HDR_RENDERER_H
+#define SC_HDR_RENDERER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <libavutil/frame.h>
+#include <SDL2/SDL.h>
+
+#include "coords.h"
+#include "opengl.h"
+#include "options.h"
+
+/**
+ * Renderer for 10-bit frames (YUV420P10 from the software decoder, P010 from
+ * hardware decoders)
+ *
+ * The planes are uploaded as is to 16-bit textures, and a fragment shader
+ * converts them to RGB. If the frames are HDR (PQ or HLG), it also tone maps
+ * them to SDR and converts the BT.2020 primaries to BT.709, so that no
+ * conversion is performed on the CPU.
+ *
+ * It also renders 8-bit frames (YUV420P and NV12, into 8-bit textures), so
+ * that a rotated or mirrored orientation is applied by the same quad instead
+ * of SDL_RenderCopyEx().
+ *
+ * With the Lanczos upscale filter, the luma plane of upscaled frames is
+ * interpolated by a Lanczos-2 kernel (4x4 texels), clamped to the range of the
+ * 4 nearest texels to avoid ringing around sharp edges (typically text). The
+ * chroma planes, at half resolution, are still interpolated linearly.
+ *
+ * It renders directly in the OpenGL (compatibility) context of the SDL
+ * renderer, so the SDL render commands must be flushed before.
+ */
+
+enum sc_hdr_transfer {
+    SC_HDR_TRANSFER_SDR,
+    SC_HDR_TRANSFER_PQ,
+    SC_HDR_TRANSFER_HLG,
+};
+
+struct sc_hdr_renderer {
+    struct sc_opengl *gl;
+    bool mipmaps;
+    enum sc_upscale_filter upscale_filter;
+
+    GLuint program;
+    GLuint textures[3]; // Y, U (or UV), V
+
+    GLint loc_code_scale;
+    GLint loc_offset;
+    GLint loc_range;
+    GLint loc_yuv_to_rgb;
+    GLint loc_interleaved;
+    GLint loc_transfer;
+    GLint loc_peak;
+    GLint loc_gamut;
+    GLint loc_convert_gamut;
+    GLint loc_lanczos;
+    GLint loc_tex_size;
+
+    // Properties of the textures (zero before the first frame)
+    struct sc_size size;
+    int format; // enum AVPixelFormat
+
+    // Conversion parameters of the last frame
+    struct {
+        // from a normalized texel to a 10-bit code value (8-bit code values
+        // are scaled by 4)
+        float code_scale;
+        float offset[3];
+        float range[3];
+        float yuv_to_rgb[9]; // column-major
+        bool interleaved; // the U and V samples are in the same plane
+        enum sc_hdr_transfer transfer;
+        bool convert_gamut; // BT.2020 to BT.709
+        float peak; // relative to the SDR reference white
+    } params;
+    bool params_logged;
+};
+
+// Tell whether the frame format must be rendered by this renderer (it is not
+// supported by SDL textures)
+bool
+sc_hdr_renderer_supports_format(int format);
+
+// Tell whether the frame format may be rendered by this renderer
+bool
+sc_hdr_renderer_accepts_format(int format);
+
+// The OpenGL context must be current
+bool
+sc_hdr_renderer_init(struct sc_hdr_renderer *hr, struct sc_opengl *gl,
+                     bool mipmaps, enum sc_upscale_filter upscale_filter);
+
+void
+sc_hdr_renderer_destroy(struct sc_hdr_renderer *hr);
+
+bool
+sc_hdr_renderer_update(struct sc_hdr_renderer *hr, const AVFrame *frame);
+
+// Draw the last frame into the geometry, in an output of the given size
+void
+sc_hdr_renderer_render(struct sc_hdr_renderer *hr, const SDL_Rect *geometry,
+                       enum sc_orientation orientation, int output_width,
+                       int output_height);
+
+#endif
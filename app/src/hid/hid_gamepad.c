@@ -0,0 +1,387 @@
+#include "hid_gamepad.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "util/binary.h"
+#include "util/log.h"
+
+// 2 bytes for each of the 4 sticks axes, 2 bytes for each of the 2 triggers,
+// 1 byte for the hat switch (dpad) + padding, 2 bytes for the buttons
+#define SC_HID_GAMEPAD_EVENT_SIZE 15
+
+#define SC_HID_GAMEPAD_INDEX_AXES 0
+#define SC_HID_GAMEPAD_INDEX_TRIGGERS 8
+#define SC_HID_GAMEPAD_INDEX_HAT 12
+#define SC_HID_GAMEPAD_INDEX_BUTTONS 13
+
+#define SC_HID_GAMEPAD_AXIS_CENTER 0x8000
+
+// Hat switch values, clockwise from up (0 is the null state, centered)
+#define SC_HID_GAMEPAD_HAT_CENTERED 0
+#define SC_HID_GAMEPAD_HAT_UP 1
+#define SC_HID_GAMEPAD_HAT_UP_RIGHT 2
+#define SC_HID_GAMEPAD_HAT_RIGHT 3
+#define SC_HID_GAMEPAD_HAT_DOWN_RIGHT 4
+#define SC_HID_GAMEPAD_HAT_DOWN 5
+#define SC_HID_GAMEPAD_HAT_DOWN_LEFT 6
+#define SC_HID_GAMEPAD_HAT_LEFT 7
+#define SC_HID_GAMEPAD_HAT_UP_LEFT 8
+
+#define SC_GAMEPAD_BUTTON_BIT(BUTTON) \
+    ((uint32_t) 1 << SC_GAMEPAD_BUTTON_##BUTTON)
+
+/**
+ * Gamepad descriptor, using the usages from "HID Usage Tables":
+ * <https://www.usb.org/sites/default/files/documents/hut1_12v2.pdf>
+ *  - §4 Generic Desktop Page (0x01) (p26)
+ *  - §5 Simulation Controls Page (0x02) (p37)
+ *  - §12 Button Page (0x09) (p67)
+ *
+ * The Linux kernel maps the usages to the input event codes, which are mapped
+ * by Android to the gamepad axes and buttons ("Generic.kl").
+ */
+const uint8_t SC_HID_GAMEPAD_REPORT_DESC[] = {
+    // Usage Page (Generic Desktop)
+    0x05, 0x01,
+    // Usage (Gamepad)
+    0x09, 0x05,
+
+    // Collection (Application)
+    0xA1, 0x01,
+
+    // Collection (Physical)
+    0xA1, 0x00,
+
+    // Usage (X): left stick x
+    0x09, 0x30,
+    // Usage (Y): left stick y
+    0x09, 0x31,
+    // Usage (Z): right stick x
+    0x09, 0x32,
+    // Usage (Rz): right stick y
+    0x09, 0x35,
+    // Logical Minimum (0)
+    0x15, 0x00,
+    // Logical Maximum (65535)
+    0x27, 0xFF, 0xFF, 0x00, 0x00,
+    // Report Size (16)
+    0x75, 0x10,
+    // Report Count (4)
+    0x95, 0x04,
+    // Input (Data, Variable, Absolute): 4x2 bytes (sticks axes)
+    0x81, 0x02,
+
+    // Usage Page (Simulation Controls)
+    0x05, 0x02,
+    // Usage (Brake): left trigger
+    0x09, 0xC5,
+    // Usage (Accelerator): right trigger
+    0x09, 0xC4,
+    // Logical Minimum (0)
+    0x15, 0x00,
+    // Logical Maximum (32767)
+    0x26, 0xFF, 0x7F,
+    // Report Size (16)
+    0x75, 0x10,
+    // Report Count (2)
+    0x95, 0x02,
+    // Input (Data, Variable, Absolute): 2x2 bytes (triggers)
+    0x81, 0x02,
+
+    // End Collection
+    0xC0,
+
+    // Usage Page (Generic Desktop)
+    0x05, 0x01,
+    // Usage (Hat switch): dpad
+    0x09, 0x39,
+    // Logical Minimum (1)
+    0x15, 0x01,
+    // Logical Maximum (8)
+    0x25, 0x08,
+    // Physical Minimum (0)
+    0x35, 0x00,
+    // Physical Maximum (315)
+    0x46, 0x3B, 0x01,
+    // Unit (Eng Rot: Degrees)
+    0x65, 0x14,
+    // Report Size (4)
+    0x75, 0x04,
+    // Report Count (1)
+    0x95, 0x01,
+    // Input (Data, Variable, Absolute, Null State): 4 bits (hat switch)
+    0x81, 0x42,
+    // Unit (None)
+    0x65, 0x00,
+    // Physical Maximum (0)
+    0x45, 0x00,
+    // Input (Constant): 4 bits padding
+    0x81, 0x01,
+
+    // Usage Page (Buttons)
+    0x05, 0x09,
+    // Usage Minimum (1)
+    0x19, 0x01,
+    // Usage Maximum (16)
+    0x29, 0x10,
+    // Logical Minimum (0)
+    0x15, 0x00,
+    // Logical Maximum (1)
+    0x25, 0x01,
+    // Report Size (1)
+    0x75, 0x01,
+    // Report Count (16)
+    0x95, 0x10,
+    // Input (Data, Variable, Absolute): 16 buttons bits
+    0x81, 0x02,
+
+    // End Collection
+    0xC0,
+};
+
+const size_t SC_HID_GAMEPAD_REPORT_DESC_LEN =
+    sizeof(SC_HID_GAMEPAD_REPORT_DESC);
+
+static void
+sc_hid_gamepad_slot_init(struct sc_hid_gamepad_slot *slot,
+                         uint32_t gamepad_id) {
+    slot->gamepad_id = gamepad_id;
+    slot->buttons = 0;
+    slot->axis_left_x = SC_HID_GAMEPAD_AXIS_CENTER;
+    slot->axis_left_y = SC_HID_GAMEPAD_AXIS_CENTER;
+    slot->axis_right_x = SC_HID_GAMEPAD_AXIS_CENTER;
+    slot->axis_right_y = SC_HID_GAMEPAD_AXIS_CENTER;
+    slot->axis_left_trigger = 0;
+    slot->axis_right_trigger = 0;
+    // No report generated yet
+    slot->last_event.size = 0;
+}
+
+void
+sc_hid_gamepad_init(struct sc_hid_gamepad *hid) {
+    for (unsigned i = 0; i < SC_MAX_GAMEPADS; ++i) {
+        sc_hid_gamepad_slot_init(&hid->slots[i], SC_GAMEPAD_ID_INVALID);
+    }
+}
+
+static struct sc_hid_gamepad_slot *
+sc_hid_gamepad_find(struct sc_hid_gamepad *hid, uint32_t gamepad_id,
+                    unsigned *slot) {
+    for (unsigned i = 0; i < SC_MAX_GAMEPADS; ++i) {
+        if (hid->slots[i].gamepad_id == gamepad_id) {
+            *slot = i;
+            return &hid->slots[i];
+        }
+    }
+    return NULL;
+}
+
+bool
+sc_hid_gamepad_add(struct sc_hid_gamepad *hid, uint32_t gamepad_id,
+                   unsigned *slot) {
+    assert(gamepad_id != SC_GAMEPAD_ID_INVALID);
+    struct sc_hid_gamepad_slot *s =
+        sc_hid_gamepad_find(hid, SC_GAMEPAD_ID_INVALID, slot);
+    if (!s) {
+        LOGW("No gamepad slot available for new gamepad %" PRIu32,
+             gamepad_id);
+        return false;
+    }
+
+    sc_hid_gamepad_slot_init(s, gamepad_id);
+    return true;
+}
+
+bool
+sc_hid_gamepad_remove(struct sc_hid_gamepad *hid, uint32_t gamepad_id,
+                      unsigned *slot) {
+    assert(gamepad_id != SC_GAMEPAD_ID_INVALID);
+    struct sc_hid_gamepad_slot *s = sc_hid_gamepad_find(hid, gamepad_id, slot);
+    if (!s) {
+        LOGW("Unknown gamepad removed %" PRIu32, gamepad_id);
+        return false;
+    }
+
+    sc_hid_gamepad_slot_init(s, SC_GAMEPAD_ID_INVALID);
+    return true;
+}
+
+static uint8_t
+sc_hid_gamepad_hat_from_buttons(uint32_t buttons) {
+    bool up = buttons & SC_GAMEPAD_BUTTON_BIT(DPAD_UP);
+    bool down = buttons & SC_GAMEPAD_BUTTON_BIT(DPAD_DOWN);
+    bool left = buttons & SC_GAMEPAD_BUTTON_BIT(DPAD_LEFT);
+    bool right = buttons & SC_GAMEPAD_BUTTON_BIT(DPAD_RIGHT);
+
+    // Opposite directions cancel each other
+    if (up && down) {
+        up = down = false;
+    }
+    if (left && right) {
+        left = right = false;
+    }
+
+    if (up) {
+        return right ? SC_HID_GAMEPAD_HAT_UP_RIGHT
+             : left ? SC_HID_GAMEPAD_HAT_UP_LEFT
+             : SC_HID_GAMEPAD_HAT_UP;
+    }
+    if (down) {
+        return right ? SC_HID_GAMEPAD_HAT_DOWN_RIGHT
+             : left ? SC_HID_GAMEPAD_HAT_DOWN_LEFT
+             : SC_HID_GAMEPAD_HAT_DOWN;
+    }
+    if (right) {
+        return SC_HID_GAMEPAD_HAT_RIGHT;
+    }
+    if (left) {
+        return SC_HID_GAMEPAD_HAT_LEFT;
+    }
+    return SC_HID_GAMEPAD_HAT_CENTERED;
+}
+
+static uint16_t
+sc_hid_gamepad_buttons_from_buttons(uint32_t buttons) {
+    // The Linux kernel maps the HID buttons 1 to 16 of a gamepad to BTN_A,
+    // BTN_B, BTN_C, BTN_X, BTN_Y, BTN_Z, BTN_TL, BTN_TR, BTN_TL2, BTN_TR2,
+    // BTN_SELECT, BTN_START, BTN_MODE, BTN_THUMBL and BTN_THUMBR
+    uint16_t c = 0;
+    if (buttons & SC_GAMEPAD_BUTTON_BIT(SOUTH)) {
+        c |= 1 << 0; // BTN_A
+    }
+    if (buttons & SC_GAMEPAD_BUTTON_BIT(EAST)) {
+        c |= 1 << 1; // BTN_B
+    }
+    if (buttons & SC_GAMEPAD_BUTTON_BIT(WEST)) {
+        c |= 1 << 3; // BTN_X
+    }
+    if (buttons & SC_GAMEPAD_BUTTON_BIT(NORTH)) {
+        c |= 1 << 4; // BTN_Y
+    }
+    if (buttons & SC_GAMEPAD_BUTTON_BIT(LEFT_SHOULDER)) {
+        c |= 1 << 6; // BTN_TL
+    }
+    if (buttons & SC_GAMEPAD_BUTTON_BIT(RIGHT_SHOULDER)) {
+        c |= 1 << 7; // BTN_TR
+    }
+    if (buttons & SC_GAMEPAD_BUTTON_BIT(BACK)) {
+        c |= 1 << 10; // BTN_SELECT
+    }
+    if (buttons & SC_GAMEPAD_BUTTON_BIT(START)) {
+        c |= 1 << 11; // BTN_START
+    }
+    if (buttons & SC_GAMEPAD_BUTTON_BIT(GUIDE)) {
+        c |= 1 << 12; // BTN_MODE
+    }
+    if (buttons & SC_GAMEPAD_BUTTON_BIT(LEFT_STICK)) {
+        c |= 1 << 13; // BTN_THUMBL
+    }
+    if (buttons & SC_GAMEPAD_BUTTON_BIT(RIGHT_STICK)) {
+        c |= 1 << 14; // BTN_THUMBR
+    }
+    return c;
+}
+
+// Generate the report from the slot state, return false if it is redundant
+static bool
+sc_hid_gamepad_event_from_slot(struct sc_hid_gamepad_slot *slot,
+                               struct sc_hid_event *hid_event) {
+    hid_event->size = SC_HID_GAMEPAD_EVENT_SIZE;
+
+    uint8_t *data = hid_event->data;
+    uint8_t *axes = &data[SC_HID_GAMEPAD_INDEX_AXES];
+    sc_write16le(&axes[0], slot->axis_left_x);
+    sc_write16le(&axes[2], slot->axis_left_y);
+    sc_write16le(&axes[4], slot->axis_right_x);
+    sc_write16le(&axes[6], slot->axis_right_y);
+
+    uint8_t *triggers = &data[SC_HID_GAMEPAD_INDEX_TRIGGERS];
+    sc_write16le(&triggers[0], slot->axis_left_trigger);
+    sc_write16le(&triggers[2], slot->axis_right_trigger);
+
+    data[SC_HID_GAMEPAD_INDEX_HAT] =
+        sc_hid_gamepad_hat_from_buttons(slot->buttons);
+
+    sc_write16le(&data[SC_HID_GAMEPAD_INDEX_BUTTONS],
+                 sc_hid_gamepad_buttons_from_buttons(slot->buttons));
+
+    if (slot->last_event.size == hid_event->size
+            && !memcmp(slot->last_event.data, data, hid_event->size)) {
+        // The gamepad state did not change, there is nothing to report
+        return false;
+    }
+
+    slot->last_event = *hid_event;
+    return true;
+}
+
+bool
+sc_hid_gamepad_event_from_button(struct sc_hid_gamepad *hid,
+                                 const struct sc_gamepad_button_event *event,
+                                 unsigned *slot,
+                                 struct sc_hid_event *hid_event) {
+    if (event->button == SC_GAMEPAD_BUTTON_UNKNOWN) {
+        return false;
+    }
+
+    struct sc_hid_gamepad_slot *s =
+        sc_hid_gamepad_find(hid, event->gamepad_id, slot);
+    if (!s) {
+        LOGW("Button event for unknown gamepad %" PRIu32, event->gamepad_id);
+        return false;
+    }
+
+    uint32_t bit = (uint32_t) 1 << event->button;
+    if (event->action == SC_ACTION_DOWN) {
+        s->buttons |= bit;
+    } else {
+        s->buttons &= ~bit;
+    }
+
+    return sc_hid_gamepad_event_from_slot(s, hid_event);
+}
+
+bool
+sc_hid_gamepad_event_from_axis(struct sc_hid_gamepad *hid,
+                               const struct sc_gamepad_axis_event *event,
+                               unsigned *slot,
+                               struct sc_hid_event *hid_event) {
+    struct sc_hid_gamepad_slot *s =
+        sc_hid_gamepad_find(hid, event->gamepad_id, slot);
+    if (!s) {
+        LOGW("Axis event for unknown gamepad %" PRIu32, event->gamepad_id);
+        return false;
+    }
+
+    // Map the sticks from [-32768, 32767] to [0, 65535]
+    uint16_t stick = (uint16_t) (event->value + SC_HID_GAMEPAD_AXIS_CENTER);
+    // The triggers are in [0, 32767]
+    uint16_t trigger = event->value > 0 ? event->value : 0;
+
+    switch (event->axis) {
+        case SC_GAMEPAD_AXIS_LEFTX:
+            s->axis_left_x = stick;
+            break;
+        case SC_GAMEPAD_AXIS_LEFTY:
+            s->axis_left_y = stick;
+            break;
+        case SC_GAMEPAD_AXIS_RIGHTX:
+            s->axis_right_x = stick;
+            break;
+        case SC_GAMEPAD_AXIS_RIGHTY:
+            s->axis_right_y = stick;
+            break;
+        case SC_GAMEPAD_AXIS_LEFT_TRIGGER:
+            s->axis_left_trigger = trigger;
+            break;
+        case SC_GAMEPAD_AXIS_RIGHT_TRIGGER:
+            s->axis_right_trigger = trigger;
+            break;
+        default:
+            return false;
+    }
+
+    return sc_hid_gamepad_event_from_slot(s, hid_event);
+}
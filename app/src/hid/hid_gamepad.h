@@ -0,0 +1,86 @@
+#ifndef SC_HID_GAMEPAD_H
+#define SC_HID_GAMEPAD_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hid/hid_event.h"
+#include "input_events.h"
+
+#define SC_MAX_GAMEPADS 8
+#define SC_GAMEPAD_ID_INVALID UINT32_MAX
+
+extern const uint8_t SC_HID_GAMEPAD_REPORT_DESC[];
+extern const size_t SC_HID_GAMEPAD_REPORT_DESC_LEN;
+
+struct sc_hid_gamepad_slot {
+    uint32_t gamepad_id; // SC_GAMEPAD_ID_INVALID if the slot is free
+    uint32_t buttons; // bitwise-OR of (1 << sc_gamepad_button)
+    uint16_t axis_left_x;
+    uint16_t axis_left_y;
+    uint16_t axis_right_x;
+    uint16_t axis_right_y;
+    uint16_t axis_left_trigger;
+    uint16_t axis_right_trigger;
+    // The last report generated for this gamepad, to suppress the reports
+    // which would not change the gamepad state
+    struct sc_hid_event last_event;
+};
+
+/**
+ * State of the HID gamepads
+ *
+ * Each connected gamepad is assigned a slot, which identifies its HID device
+ * on the Android side.
+ */
+struct sc_hid_gamepad {
+    struct sc_hid_gamepad_slot slots[SC_MAX_GAMEPADS];
+};
+
+void
+sc_hid_gamepad_init(struct sc_hid_gamepad *hid);
+
+/**
+ * Assign a slot to a new gamepad
+ *
+ * Return false if all the slots are used.
+ */
+bool
+sc_hid_gamepad_add(struct sc_hid_gamepad *hid, uint32_t gamepad_id,
+                   unsigned *slot);
+
+/**
+ * Release the slot of a removed gamepad
+ *
+ * Return false if the gamepad is unknown.
+ */
+bool
+sc_hid_gamepad_remove(struct sc_hid_gamepad *hid, uint32_t gamepad_id,
+                      unsigned *slot);
+
+/**
+ * Generate the report for a gamepad button event
+ *
+ * Return false if the gamepad or the button is unknown, or if the report would
+ * be the same as the previous one: in that case, nothing must be sent.
+ */
+bool
+sc_hid_gamepad_event_from_button(struct sc_hid_gamepad *hid,
+                                 const struct sc_gamepad_button_event *event,
+                                 unsigned *slot,
+                                 struct sc_hid_event *hid_event);
+
+/**
+ * Generate the report for a gamepad axis event
+ *
+ * Same semantics as sc_hid_gamepad_event_from_button().
+ */
+bool
+sc_hid_gamepad_event_from_axis(struct sc_hid_gamepad *hid,
+                               const struct sc_gamepad_axis_event *event,
+                               unsigned *slot,
+                               struct sc_hid_event *hid_event);
+
+#endif
@@ -242,6 +242,8 @@ sc_hid_mod_from_sdl_keymod(uint16_t mod) {
 void
 sc_hid_keyboard_init(struct sc_hid_keyboard *hid) {
     memset(hid->keys, false, SC_HID_KEYBOARD_KEYS);
+    // Initially, no key is pressed on the device
+    sc_hid_keyboard_event_init(&hid->last_event);
 }
 
 static inline bool
@@ -304,6 +306,15 @@ end:
          event->action == SC_ACTION_DOWN ? "down" : "up", event->scancode,
          event->scancode, mods);
 
+    if (hid->last_event.size == hid_event->size
+            && !memcmp(hid->last_event.data, hid_event->data,
+                       hid_event->size)) {
+        // The keyboard state did not change, there is nothing to report
+        LOGV("hid keyboard: redundant report suppressed");
+        return false;
+    }
+
+    hid->last_event = *hid_event;
     return true;
 }
 
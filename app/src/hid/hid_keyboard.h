@@ -31,11 +31,21 @@ extern const size_t SC_HID_KEYBOARD_REPORT_DESC_LEN;
  */
 struct sc_hid_keyboard {
     bool keys[SC_HID_KEYBOARD_KEYS];
+    // The last report generated by sc_hid_keyboard_event_from_key(), to
+    // suppress the reports which would not change the keyboard state
+    struct sc_hid_event last_event;
 };
 
 void
 sc_hid_keyboard_init(struct sc_hid_keyboard *hid);
 
+/**
+ * Generate the report for a key event
+ *
+ * Return false if the key is not supported, or if the report would be the same
+ * as the previous one (for example on a key press for a key already pressed):
+ * in that case, nothing must be sent.
+ */
 bool
 sc_hid_keyboard_event_from_key(struct sc_hid_keyboard *hid,
                                struct sc_hid_event *hid_event,
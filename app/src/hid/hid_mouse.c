@@ -1,5 +1,7 @@
 #include "hid_mouse.h"
 
+#include <assert.h>
+
 // 1 byte for buttons + padding, 1 byte for X position, 1 byte for Y position,
 // 1 byte for wheel motion
 #define HID_MOUSE_EVENT_SIZE 4
@@ -190,3 +192,70 @@ sc_hid_mouse_event_from_scroll(struct sc_hid_event *hid_event,
     data[3] = CLAMP(event->vscroll, -127, 127);
     // Horizontal scrolling ignored
 }
+
+void
+sc_hid_mouse_init(struct sc_hid_mouse *hid) {
+    // Initially, no button is pressed on the device
+    hid->buttons = 0;
+}
+
+bool
+sc_hid_mouse_accept_report(struct sc_hid_mouse *hid,
+                           const struct sc_hid_event *hid_event) {
+    assert(hid_event->size == HID_MOUSE_EVENT_SIZE);
+    const uint8_t *data = hid_event->data;
+    bool idle = !data[1] && !data[2] && !data[3];
+    if (idle && data[0] == hid->buttons) {
+        // No motion, no scroll, and no buttons change
+        return false;
+    }
+
+    hid->buttons = data[0];
+    return true;
+}
+
+void
+sc_hid_mouse_motion_init(struct sc_hid_mouse_motion *motion) {
+    motion->dx = 0;
+    motion->dy = 0;
+    motion->buttons_state = 0;
+}
+
+bool
+sc_hid_mouse_motion_is_empty(const struct sc_hid_mouse_motion *motion) {
+    return !motion->dx && !motion->dy;
+}
+
+bool
+sc_hid_mouse_motion_add(struct sc_hid_mouse_motion *motion,
+                        const struct sc_mouse_motion_event *event) {
+    if (!sc_hid_mouse_motion_is_empty(motion)
+            && motion->buttons_state != event->buttons_state) {
+        return false;
+    }
+
+    // Avoid overflows (the motion is reported at most 127 per report anyway)
+    motion->dx = CLAMP((int64_t) motion->dx + event->xrel,
+                       -0x100000, 0x100000);
+    motion->dy = CLAMP((int64_t) motion->dy + event->yrel,
+                       -0x100000, 0x100000);
+    motion->buttons_state = event->buttons_state;
+    return true;
+}
+
+void
+sc_hid_mouse_event_from_pending_motion(struct sc_hid_event *hid_event,
+                                       struct sc_hid_mouse_motion *motion) {
+    sc_hid_mouse_event_init(hid_event);
+
+    int8_t dx = CLAMP(motion->dx, -127, 127);
+    int8_t dy = CLAMP(motion->dy, -127, 127);
+    motion->dx -= dx;
+    motion->dy -= dy;
+
+    uint8_t *data = hid_event->data;
+    data[0] = sc_hid_buttons_from_buttons_state(motion->buttons_state);
+    data[1] = dx;
+    data[2] = dy;
+    data[3] = 0; // wheel coordinates only used for scrolling
+}
@@ -1,8 +1,6 @@
 #ifndef SC_HID_MOUSE_H
 #define SC_HID_MOUSE_H
 
-#endif
-
 #include "common.h"
 
 #include <stdbool.h>
@@ -24,3 +22,66 @@ sc_hid_mouse_event_from_click(struct sc_hid_event *hid_event,
 void
 sc_hid_mouse_event_from_scroll(struct sc_hid_event *hid_event,
                                const struct sc_mouse_scroll_event *event);
+
+/**
+ * State of the HID mouse, as last reported to the device
+ *
+ * A report without motion nor scroll which does not change the buttons state
+ * is redundant, it is not sent.
+ */
+struct sc_hid_mouse {
+    uint8_t buttons; // HID buttons of the last report
+};
+
+void
+sc_hid_mouse_init(struct sc_hid_mouse *hid);
+
+/**
+ * Return true if the report must be sent, false if it is redundant
+ *
+ * If it returns true, the report is assumed to be sent to the device.
+ */
+bool
+sc_hid_mouse_accept_report(struct sc_hid_mouse *hid,
+                           const struct sc_hid_event *hid_event);
+
+/**
+ * Relative motion not reported yet
+ *
+ * The motion deltas are accumulated between two reports, so that a high-rate
+ * mouse does not generate one report per event. The deltas which do not fit in
+ * a single report (from -127 to 127) are kept for the next reports instead of
+ * being clamped.
+ */
+struct sc_hid_mouse_motion {
+    int32_t dx;
+    int32_t dy;
+    uint8_t buttons_state; // bitwise-OR of sc_mouse_button values
+};
+
+void
+sc_hid_mouse_motion_init(struct sc_hid_mouse_motion *motion);
+
+bool
+sc_hid_mouse_motion_is_empty(const struct sc_hid_mouse_motion *motion);
+
+/**
+ * Accumulate a motion event
+ *
+ * Return false (without accumulating) if the buttons state changed while some
+ * motion is pending: the pending motion must be reported first.
+ */
+bool
+sc_hid_mouse_motion_add(struct sc_hid_mouse_motion *motion,
+                        const struct sc_mouse_motion_event *event);
+
+/**
+ * Generate a report from the pending motion
+ *
+ * The part which does not fit in the report remains pending.
+ */
+void
+sc_hid_mouse_event_from_pending_motion(struct sc_hid_event *hid_event,
+                                       struct sc_hid_mouse_motion *motion);
+
+#endif
@@ -0,0 +1,150 @@
+#include "hid_mouse_pacer.h"
+
+#include <assert.h>
+
+#include "util/log.h"
+
+bool
+sc_hid_mouse_pacer_init(struct sc_hid_mouse_pacer *pacer, sc_tick interval,
+                        const struct sc_hid_mouse_pacer_callbacks *cbs,
+                        void *cbs_userdata) {
+    bool ok = sc_mutex_init(&pacer->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&pacer->cond);
+    if (!ok) {
+        sc_mutex_destroy(&pacer->mutex);
+        return false;
+    }
+
+    pacer->interval = interval;
+    pacer->stopped = false;
+    sc_hid_mouse_motion_init(&pacer->motion);
+    pacer->next_report = 0;
+    sc_hid_mouse_init(&pacer->hid);
+
+    assert(cbs && cbs->on_report);
+    pacer->cbs = cbs;
+    pacer->cbs_userdata = cbs_userdata;
+
+    return true;
+}
+
+void
+sc_hid_mouse_pacer_destroy(struct sc_hid_mouse_pacer *pacer) {
+    sc_cond_destroy(&pacer->cond);
+    sc_mutex_destroy(&pacer->mutex);
+}
+
+// must be called with mutex locked
+static void
+send(struct sc_hid_mouse_pacer *pacer, const struct sc_hid_event *hid_event) {
+    if (sc_hid_mouse_accept_report(&pacer->hid, hid_event)) {
+        pacer->cbs->on_report(pacer, hid_event, pacer->cbs_userdata);
+    }
+}
+
+// must be called with mutex locked
+static void
+report(struct sc_hid_mouse_pacer *pacer, sc_tick now) {
+    struct sc_hid_event hid_event;
+    sc_hid_mouse_event_from_pending_motion(&hid_event, &pacer->motion);
+    send(pacer, &hid_event);
+    pacer->next_report = now + pacer->interval;
+}
+
+// must be called with mutex locked
+static void
+flush(struct sc_hid_mouse_pacer *pacer, sc_tick now) {
+    // A large motion may require several reports
+    while (!sc_hid_mouse_motion_is_empty(&pacer->motion)) {
+        report(pacer, now);
+    }
+}
+
+static int
+run_hid_mouse_pacer(void *data) {
+    struct sc_hid_mouse_pacer *pacer = data;
+
+    sc_mutex_lock(&pacer->mutex);
+    while (!pacer->stopped) {
+        if (sc_hid_mouse_motion_is_empty(&pacer->motion)) {
+            sc_cond_wait(&pacer->cond, &pacer->mutex);
+            continue;
+        }
+
+        bool timed_out = !sc_cond_timedwait(&pacer->cond, &pacer->mutex,
+                                            pacer->next_report);
+        if (timed_out && !pacer->stopped
+                && !sc_hid_mouse_motion_is_empty(&pacer->motion)) {
+            report(pacer, sc_tick_now());
+        }
+    }
+    sc_mutex_unlock(&pacer->mutex);
+
+    return 0;
+}
+
+bool
+sc_hid_mouse_pacer_start(struct sc_hid_mouse_pacer *pacer) {
+    LOGD("Starting HID mouse pacer thread");
+
+    bool ok = sc_thread_create(&pacer->thread, run_hid_mouse_pacer,
+                               "scrcpy-hidmouse", pacer);
+    if (!ok) {
+        LOGE("Could not start HID mouse pacer thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_hid_mouse_pacer_stop(struct sc_hid_mouse_pacer *pacer) {
+    sc_mutex_lock(&pacer->mutex);
+    pacer->stopped = true;
+    sc_cond_signal(&pacer->cond);
+    sc_mutex_unlock(&pacer->mutex);
+}
+
+void
+sc_hid_mouse_pacer_join(struct sc_hid_mouse_pacer *pacer) {
+    sc_thread_join(&pacer->thread, NULL);
+}
+
+void
+sc_hid_mouse_pacer_push_motion(struct sc_hid_mouse_pacer *pacer,
+                               const struct sc_mouse_motion_event *event) {
+    sc_mutex_lock(&pacer->mutex);
+
+    sc_tick now = sc_tick_now();
+    if (!sc_hid_mouse_motion_add(&pacer->motion, event)) {
+        // The buttons state changed, report the previous motion first
+        flush(pacer, now);
+        bool ok = sc_hid_mouse_motion_add(&pacer->motion, event);
+        assert(ok);
+        (void) ok;
+    }
+
+    if (now >= pacer->next_report) {
+        report(pacer, now);
+    }
+
+    if (!sc_hid_mouse_motion_is_empty(&pacer->motion)) {
+        // Wake up the thread to report the remaining motion later
+        sc_cond_signal(&pacer->cond);
+    }
+
+    sc_mutex_unlock(&pacer->mutex);
+}
+
+void
+sc_hid_mouse_pacer_push_report(struct sc_hid_mouse_pacer *pacer,
+                               const struct sc_hid_event *hid_event) {
+    sc_mutex_lock(&pacer->mutex);
+    flush(pacer, sc_tick_now());
+    send(pacer, hid_event);
+    sc_mutex_unlock(&pacer->mutex);
+}
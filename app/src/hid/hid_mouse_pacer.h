@@ -0,0 +1,78 @@
+#ifndef SC_HID_MOUSE_PACER_H
+#define SC_HID_MOUSE_PACER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+
+#include "hid/hid_event.h"
+#include "hid/hid_mouse.h"
+#include "input_events.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+/**
+ * Send the HID mouse motion reports at most once per report interval
+ *
+ * The motion events received meanwhile are aggregated, so that a high-rate
+ * mouse (e.g. 8 kHz) does not flood the link to the device. The first motion
+ * after an idle period is reported immediately; the remaining motion is
+ * reported by a separate thread once the interval has elapsed.
+ */
+struct sc_hid_mouse_pacer {
+    sc_tick interval; // 0 to report every motion immediately
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    bool stopped;
+
+    struct sc_hid_mouse_motion motion;
+    sc_tick next_report; // the earliest time of the next report
+
+    // Shared by all the reports, to suppress the redundant ones
+    struct sc_hid_mouse hid;
+
+    const struct sc_hid_mouse_pacer_callbacks *cbs;
+    void *cbs_userdata;
+};
+
+struct sc_hid_mouse_pacer_callbacks {
+    // Called with the pacer mutex locked, from any thread, for every report
+    // (motion, click or scroll) to send
+    void (*on_report)(struct sc_hid_mouse_pacer *pacer,
+                      const struct sc_hid_event *hid_event, void *userdata);
+};
+
+bool
+sc_hid_mouse_pacer_init(struct sc_hid_mouse_pacer *pacer, sc_tick interval,
+                        const struct sc_hid_mouse_pacer_callbacks *cbs,
+                        void *cbs_userdata);
+
+void
+sc_hid_mouse_pacer_destroy(struct sc_hid_mouse_pacer *pacer);
+
+bool
+sc_hid_mouse_pacer_start(struct sc_hid_mouse_pacer *pacer);
+
+void
+sc_hid_mouse_pacer_stop(struct sc_hid_mouse_pacer *pacer);
+
+void
+sc_hid_mouse_pacer_join(struct sc_hid_mouse_pacer *pacer);
+
+void
+sc_hid_mouse_pacer_push_motion(struct sc_hid_mouse_pacer *pacer,
+                               const struct sc_mouse_motion_event *event);
+
+/**
+ * Report a click or scroll event
+ *
+ * The pending motion is reported first, so that the reports are not
+ * reordered. The report is suppressed if it is redundant.
+ */
+void
+sc_hid_mouse_pacer_push_report(struct sc_hid_mouse_pacer *pacer,
+                               const struct sc_hid_event *hid_event);
+
+#endif
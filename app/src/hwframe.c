@@ -0,0 +1,149 @@
+#include "hwframe.h"
+
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+
+#include <assert.h>
+#include <string.h>
+#include <libavutil/hwcontext.h>
+
+#include "util/log.h"
+
+bool
+sc_hwframe_downloader_init(struct sc_hwframe_downloader *dl, bool allow_nv12) {
+    dl->tmp_frame = av_frame_alloc();
+    if (!dl->tmp_frame) {
+        LOG_OOM();
+        return false;
+    }
+
+    dl->allow_nv12 = allow_nv12;
+    dl->transfer_fmt = AV_PIX_FMT_NONE; // selected on first frame
+    return true;
+}
+
+void
+sc_hwframe_downloader_destroy(struct sc_hwframe_downloader *dl) {
+    av_frame_free(&dl->tmp_frame);
+}
+
+static bool
+sc_hwframe_downloader_select_format(struct sc_hwframe_downloader *dl,
+                                    const AVFrame *frame) {
+    enum AVPixelFormat *formats;
+    int r = av_hwframe_transfer_get_formats(frame->hw_frames_ctx,
+                                            AV_HWFRAME_TRANSFER_DIRECTION_FROM,
+                                            &formats, 0);
+    if (r < 0) {
+        LOGE("Could not get hardware transfer formats: %d", r);
+        return false;
+    }
+
+    // If NV12 is allowed, select the first supported format (the formats are
+    // ordered by preference, the native format first). Otherwise, prefer
+    // YUV420P (no conversion needed), and fallback to NV12.
+    //
+    // 10-bit surfaces (natively P010) are downloaded as is, they are rendered
+    // by a shader.
+    enum AVPixelFormat selected = AV_PIX_FMT_NONE;
+    for (enum AVPixelFormat *p = formats; *p != AV_PIX_FMT_NONE; ++p) {
+        if (*p == AV_PIX_FMT_P010LE && p == formats) {
+            selected = *p;
+            break;
+        }
+        if (*p == AV_PIX_FMT_YUV420P) {
+            selected = *p;
+            break;
+        }
+        if (*p == AV_PIX_FMT_NV12 && selected == AV_PIX_FMT_NONE) {
+            selected = *p;
+            if (dl->allow_nv12) {
+                break;
+            }
+        }
+    }
+
+    av_free(formats);
+
+    if (selected == AV_PIX_FMT_NONE) {
+        LOGE("No supported hardware transfer format");
+        return false;
+    }
+
+    dl->transfer_fmt = selected;
+    return true;
+}
+
+static bool
+sc_hwframe_nv12_to_yuv420p(AVFrame *dst, const AVFrame *src) {
+    assert(src->format == AV_PIX_FMT_NV12);
+
+    dst->format = AV_PIX_FMT_YUV420P;
+    dst->width = src->width;
+    dst->height = src->height;
+
+    int r = av_frame_get_buffer(dst, 0);
+    if (r < 0) {
+        LOG_OOM();
+        return false;
+    }
+
+    for (int y = 0; y < src->height; ++y) {
+        memcpy(dst->data[0] + y * dst->linesize[0],
+               src->data[0] + y * src->linesize[0], src->width);
+    }
+
+    int chroma_width = (src->width + 1) / 2;
+    int chroma_height = (src->height + 1) / 2;
+    for (int y = 0; y < chroma_height; ++y) {
+        const uint8_t *uv = src->data[1] + y * src->linesize[1];
+        uint8_t *u = dst->data[1] + y * dst->linesize[1];
+        uint8_t *v = dst->data[2] + y * dst->linesize[2];
+        for (int x = 0; x < chroma_width; ++x) {
+            u[x] = uv[2 * x];
+            v[x] = uv[2 * x + 1];
+        }
+    }
+
+    return true;
+}
+
+bool
+sc_hwframe_downloader_download(struct sc_hwframe_downloader *dl, AVFrame *dst,
+                               const AVFrame *src) {
+    assert(src->hw_frames_ctx);
+
+    if (dl->transfer_fmt == AV_PIX_FMT_NONE) {
+        if (!sc_hwframe_downloader_select_format(dl, src)) {
+            return false;
+        }
+    }
+
+    bool convert = dl->transfer_fmt == AV_PIX_FMT_NV12 && !dl->allow_nv12;
+    AVFrame *target = convert ? dl->tmp_frame : dst;
+    target->format = dl->transfer_fmt;
+
+    int r = av_hwframe_transfer_data(target, src, 0);
+    if (r < 0) {
+        LOGE("Could not transfer hardware frame: %d", r);
+        return false;
+    }
+
+    if (convert) {
+        bool ok = sc_hwframe_nv12_to_yuv420p(dst, target);
+        av_frame_unref(target);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    r = av_frame_copy_props(dst, src);
+    if (r < 0) {
+        av_frame_unref(dst);
+        LOG_OOM();
+        return false;
+    }
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef SC_HWFRAME_H
+#define SC_HWFRAME_H
+
+#include "common.h"
+
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+
+#include <stdbool.h>
+#include <libavutil/frame.h>
+
+/**
+ * Download frames stored in hardware surfaces to system memory
+ *
+ * The transfer format is selected on the first frame: YUV420P or NV12,
+ * whichever is supported by the hardware (the first one in its preference
+ * order). If `allow_nv12` is false, NV12 frames are converted to YUV420P.
+ */
+struct sc_hwframe_downloader {
+    bool allow_nv12;
+    enum AVPixelFormat transfer_fmt;
+    AVFrame *tmp_frame;
+};
+
+bool
+sc_hwframe_downloader_init(struct sc_hwframe_downloader *dl, bool allow_nv12);
+
+void
+sc_hwframe_downloader_destroy(struct sc_hwframe_downloader *dl);
+
+/**
+ * Download the hardware frame `src` into `dst` (which must be empty)
+ *
+ * The frame properties (pts, etc.) are copied.
+ */
+bool
+sc_hwframe_downloader_download(struct sc_hwframe_downloader *dl, AVFrame *dst,
+                               const AVFrame *src);
+
+#endif
+
+#endif
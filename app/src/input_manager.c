@@ -1,14 +1,25 @@
 #include "input_manager.h"
 
 #include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL_keycode.h>
 
 #include "input_events.h"
 #include "screen.h"
 #include "util/log.h"
+#include "util/str.h"
 
 #define SC_SDL_SHORTCUT_MODS_MASK (KMOD_CTRL | KMOD_ALT | KMOD_GUI)
 
+// Do not reduce the video size below this value
+#define SC_VIDEO_SIZE_MIN 240
+
+// Consecutive text input events received within this delay are injected by a
+// single message
+#define SC_TEXT_INPUT_COALESCE_DELAY_MS 10
+
 static inline uint16_t
 to_sdl_mod(unsigned shortcut_mod) {
     uint16_t sdl_mod = 0;
@@ -52,21 +63,27 @@ is_shortcut_mod(struct sc_input_manager *im, uint16_t sdl_mod) {
 void
 sc_input_manager_init(struct sc_input_manager *im,
                       const struct sc_input_manager_params *params) {
-    // A key/mouse processor may not be present if there is no controller
-    assert((!params->kp && !params->mp) || params->controller);
+    // A key/mouse/gamepad processor may not be present if there is no
+    // controller
+    assert((!params->kp && !params->mp && !params->gp) || params->controller);
     // A processor must have ops initialized
     assert(!params->kp || params->kp->ops);
     assert(!params->mp || params->mp->ops);
+    assert(!params->gp || params->gp->ops);
 
     im->controller = params->controller;
     im->fp = params->fp;
+    im->replay_buffer = params->replay_buffer;
     im->screen = params->screen;
     im->kp = params->kp;
     im->mp = params->mp;
+    im->gp = params->gp;
 
     im->forward_all_clicks = params->forward_all_clicks;
     im->legacy_paste = params->legacy_paste;
     im->clipboard_autosync = params->clipboard_autosync;
+    im->max_size = params->max_size;
+    im->max_fps = params->max_fps;
 
     const struct sc_shortcut_mods *shortcut_mods = params->shortcut_mods;
     assert(shortcut_mods->count);
@@ -214,9 +231,11 @@ get_device_clipboard(struct sc_input_manager *im, enum sc_copy_key copy_key) {
     return true;
 }
 
+// If sent is not NULL, the text is not sent if the device clipboard is known to
+// contain it already, and *sent tells whether it has been sent
 static bool
 set_device_clipboard(struct sc_input_manager *im, bool paste,
-                     uint64_t sequence) {
+                     uint64_t sequence, bool *sent) {
     assert(im->controller && im->kp);
 
     char *text = SDL_GetClipboardText();
@@ -225,6 +244,18 @@ set_device_clipboard(struct sc_input_manager *im, bool paste,
         return false;
     }
 
+    if (sent) {
+        uint64_t device_hash =
+            sc_controller_get_device_clipboard_hash(im->controller);
+        if (device_hash && device_hash == sc_str_hash(text)) {
+            LOGD("Device clipboard unchanged");
+            SDL_free(text);
+            *sent = false;
+            return true;
+        }
+        *sent = true;
+    }
+
     char *text_dup = strdup(text);
     SDL_free(text);
     if (!text_dup) {
@@ -290,34 +321,142 @@ clipboard_paste(struct sc_input_manager *im) {
         return;
     }
 
-    char *text_dup = strdup(text);
+    // The text may not fit in a single INJECT_TEXT message, split it (at
+    // valid UTF-8 positions)
+    const char *chunk = text;
+    while (*chunk) {
+        size_t len = sc_str_utf8_truncation_index(chunk,
+                                        SC_CONTROL_MSG_INJECT_TEXT_MAX_LENGTH);
+        assert(len);
+        char *chunk_dup = malloc(len + 1);
+        if (!chunk_dup) {
+            LOG_OOM();
+            break;
+        }
+        memcpy(chunk_dup, chunk, len);
+        chunk_dup[len] = '\0';
+
+        struct sc_control_msg msg;
+        msg.type = SC_CONTROL_MSG_TYPE_INJECT_TEXT;
+        msg.inject_text.text = chunk_dup;
+        if (!sc_controller_push_msg(im->controller, &msg)) {
+            free(chunk_dup);
+            LOGW("Could not request 'paste clipboard'");
+            break;
+        }
+
+        chunk += len;
+    }
+
     SDL_free(text);
-    if (!text_dup) {
-        LOGW("Could not strdup input text");
-        return;
+}
+
+static void
+rotate_device(struct sc_input_manager *im) {
+    assert(im->controller);
+
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_ROTATE_DEVICE;
+
+    if (!sc_controller_push_msg(im->controller, &msg)) {
+        LOGW("Could not request device rotation");
     }
+}
+
+static void
+set_video_limits(struct sc_input_manager *im, uint16_t max_size,
+                 uint16_t max_fps) {
+    assert(im->controller);
 
     struct sc_control_msg msg;
-    msg.type = SC_CONTROL_MSG_TYPE_INJECT_TEXT;
-    msg.inject_text.text = text_dup;
+    msg.type = SC_CONTROL_MSG_TYPE_SET_VIDEO_LIMITS;
+    msg.set_video_limits.max_size = max_size;
+    msg.set_video_limits.max_fps = max_fps;
+
     if (!sc_controller_push_msg(im->controller, &msg)) {
-        free(text_dup);
-        LOGW("Could not request 'paste clipboard'");
+        LOGW("Could not request video limits change");
     }
 }
 
 static void
-rotate_device(struct sc_input_manager *im) {
+reduce_video_size(struct sc_input_manager *im) {
+    struct sc_size size = im->screen->frame_size;
+    uint16_t current = MAX(size.width, size.height);
+    // The size must be a multiple of 8
+    uint16_t max_size = (current / 2) & ~7;
+    if (max_size < SC_VIDEO_SIZE_MIN) {
+        LOGW("Video size cannot be reduced further");
+        return;
+    }
+
+    LOGI("Request video size: %" PRIu16, max_size);
+    set_video_limits(im, max_size, im->max_fps);
+}
+
+static void
+restore_video_size(struct sc_input_manager *im) {
+    LOGI("Request initial video size");
+    set_video_limits(im, im->max_size, im->max_fps);
+}
+
+static void
+set_crop(struct sc_input_manager *im, struct sc_point point,
+         struct sc_size size) {
     assert(im->controller);
 
     struct sc_control_msg msg;
-    msg.type = SC_CONTROL_MSG_TYPE_ROTATE_DEVICE;
+    msg.type = SC_CONTROL_MSG_TYPE_SET_CROP;
+    msg.set_crop.position.point = point;
+    msg.set_crop.position.screen_size = im->screen->frame_size;
+    msg.set_crop.size = size;
 
     if (!sc_controller_push_msg(im->controller, &msg)) {
-        LOGW("Could not request device rotation");
+        LOGW("Could not request crop change");
     }
 }
 
+static void
+zoom_in(struct sc_input_manager *im) {
+    // mouse_x and mouse_y are expressed in pixels relative to the window
+    int mouse_x;
+    int mouse_y;
+    SDL_GetMouseState(&mouse_x, &mouse_y);
+
+    struct sc_point center =
+        sc_screen_convert_window_to_frame_coords(im->screen, mouse_x, mouse_y);
+
+    // Crop the quarter of the current frame around the cursor (the device
+    // adjusts it to keep the video size, so that the encoder is not
+    // reconfigured)
+    struct sc_size frame_size = im->screen->frame_size;
+    struct sc_size size = {
+        .width = frame_size.width / 2,
+        .height = frame_size.height / 2,
+    };
+    if (!size.width || !size.height) {
+        return;
+    }
+
+    struct sc_point point = {
+        .x = CLAMP(center.x - size.width / 2, 0,
+                   frame_size.width - size.width),
+        .y = CLAMP(center.y - size.height / 2, 0,
+                   frame_size.height - size.height),
+    };
+
+    LOGI("Request crop: %" PRIu16 "x%" PRIu16 " at %" PRIi32 ",%" PRIi32,
+         size.width, size.height, point.x, point.y);
+    set_crop(im, point, size);
+}
+
+static void
+reset_crop(struct sc_input_manager *im) {
+    LOGI("Request initial crop");
+    struct sc_point point = {0, 0};
+    struct sc_size size = {0, 0};
+    set_crop(im, point, size);
+}
+
 static void
 open_hard_keyboard_settings(struct sc_input_manager *im) {
     assert(im->controller);
@@ -339,6 +478,18 @@ apply_orientation_transform(struct sc_input_manager *im,
     sc_screen_set_orientation(screen, new_orientation);
 }
 
+static bool
+is_text_input_followed(const SDL_TextInputEvent *event) {
+    // SDL splits a long text (typically an IME composition) into several
+    // events, pushed at once
+    SDL_Event next;
+    int r = SDL_PeepEvents(&next, 1, SDL_PEEKEVENT, SDL_FIRSTEVENT,
+                           SDL_LASTEVENT);
+    return r == 1 && next.type == SDL_TEXTINPUT
+                  && next.text.timestamp - event->timestamp
+                        <= SC_TEXT_INPUT_COALESCE_DELAY_MS;
+}
+
 static void
 sc_input_manager_process_text_input(struct sc_input_manager *im,
                                     const SDL_TextInputEvent *event) {
@@ -354,6 +505,7 @@ sc_input_manager_process_text_input(struct sc_input_manager *im,
 
     struct sc_text_event evt = {
         .text = event->text,
+        .more = is_text_input_followed(event),
     };
 
     im->kp->ops->process_text(im->kp, &evt);
@@ -362,7 +514,7 @@ sc_input_manager_process_text_input(struct sc_input_manager *im,
 static bool
 simulate_virtual_finger(struct sc_input_manager *im,
                         enum android_motionevent_action action,
-                        struct sc_point point) {
+                        struct sc_point point, uint32_t timestamp) {
     bool up = action == AMOTION_EVENT_ACTION_UP;
 
     struct sc_control_msg msg;
@@ -376,6 +528,7 @@ simulate_virtual_finger(struct sc_input_manager *im,
     msg.inject_touch_event.pressure = up ? 0.0f : 1.0f;
     msg.inject_touch_event.action_button = 0;
     msg.inject_touch_event.buttons = 0;
+    msg.inject_touch_event.timestamp = timestamp;
 
     if (!sc_controller_push_msg(im->controller, &msg)) {
         LOGW("Could not request 'inject virtual finger event'");
@@ -438,7 +591,11 @@ sc_input_manager_process_key(struct sc_input_manager *im,
                 }
                 return;
             case SDLK_s:
-                if (im->kp && !shift && !repeat) {
+                if (shift) {
+                    if (!repeat && down) {
+                        sc_screen_save_screenshot(im->screen);
+                    }
+                } else if (im->kp && !repeat) {
                     action_app_switch(im, action);
                 }
                 return;
@@ -522,7 +679,8 @@ sc_input_manager_process_key(struct sc_input_manager *im,
                     } else {
                         // store the text in the device clipboard and paste,
                         // without requesting an acknowledgment
-                        set_device_clipboard(im, true, SC_SEQUENCE_INVALID);
+                        set_device_clipboard(im, true, SC_SEQUENCE_INVALID,
+                                             NULL);
                     }
                 }
                 return;
@@ -558,10 +716,33 @@ sc_input_manager_process_key(struct sc_input_manager *im,
                 }
                 return;
             case SDLK_r:
-                if (control && !shift && !repeat && down) {
+                if (shift) {
+                    if (im->replay_buffer && !repeat && down) {
+                        sc_replay_buffer_save(im->replay_buffer);
+                    }
+                } else if (control && !repeat && down) {
                     rotate_device(im);
                 }
                 return;
+            case SDLK_MINUS:
+                if (control && !shift && !repeat && down) {
+                    reduce_video_size(im);
+                }
+                return;
+            case SDLK_EQUALS:
+                if (control && !shift && !repeat && down) {
+                    restore_video_size(im);
+                }
+                return;
+            case SDLK_z:
+                if (control && !repeat && down) {
+                    if (shift) {
+                        reset_crop(im);
+                    } else {
+                        zoom_in(im);
+                    }
+                }
+                return;
             case SDLK_k:
                 if (control && !shift && !repeat && down
                         && im->kp && im->kp->hid) {
@@ -592,14 +773,16 @@ sc_input_manager_process_key(struct sc_input_manager *im,
                                                 : SC_SEQUENCE_INVALID;
 
         // Synchronize the computer clipboard to the device clipboard before
-        // sending Ctrl+v, to allow seamless copy-paste.
-        bool ok = set_device_clipboard(im, false, sequence);
+        // sending Ctrl+v, to allow seamless copy-paste (unless the device
+        // clipboard already contains the same text).
+        bool sent;
+        bool ok = set_device_clipboard(im, false, sequence, &sent);
         if (!ok) {
             LOGW("Clipboard could not be synchronized, Ctrl+v not injected");
             return;
         }
 
-        if (im->kp->async_paste) {
+        if (sent && im->kp->async_paste) {
             // The key processor must wait for this ack before injecting Ctrl+v
             ack_to_wait = sequence;
             // Increment only when the request succeeded
@@ -642,6 +825,7 @@ sc_input_manager_process_mouse_motion(struct sc_input_manager *im,
         .buttons_state =
             sc_mouse_buttons_state_from_sdl(event->state,
                                             im->forward_all_clicks),
+        .timestamp = event->timestamp,
     };
 
     assert(im->mp->ops->process_mouse_motion);
@@ -658,7 +842,8 @@ sc_input_manager_process_mouse_motion(struct sc_input_manager *im,
         struct sc_point vfinger = inverse_point(mouse, im->screen->frame_size,
                                                 im->vfinger_invert_x,
                                                 im->vfinger_invert_y);
-        simulate_virtual_finger(im, AMOTION_EVENT_ACTION_MOVE, vfinger);
+        simulate_virtual_finger(im, AMOTION_EVENT_ACTION_MOVE, vfinger,
+                                event->timestamp);
     }
 }
 
@@ -687,6 +872,7 @@ sc_input_manager_process_touch(struct sc_input_manager *im,
         .action = sc_touch_action_from_sdl(event->type),
         .pointer_id = event->fingerId,
         .pressure = event->pressure,
+        .timestamp = event->timestamp,
     };
 
     im->mp->ops->process_touch(im->mp, &evt);
@@ -767,6 +953,7 @@ sc_input_manager_process_mouse_button(struct sc_input_manager *im,
         .buttons_state =
             sc_mouse_buttons_state_from_sdl(sdl_buttons_state,
                                             im->forward_all_clicks),
+        .timestamp = event->timestamp,
     };
 
     assert(im->mp->ops->process_mouse_click);
@@ -813,7 +1000,7 @@ sc_input_manager_process_mouse_button(struct sc_input_manager *im,
         enum android_motionevent_action action = down
                                                ? AMOTION_EVENT_ACTION_DOWN
                                                : AMOTION_EVENT_ACTION_UP;
-        if (!simulate_virtual_finger(im, action, vfinger)) {
+        if (!simulate_virtual_finger(im, action, vfinger, event->timestamp)) {
             return;
         }
         im->vfinger_down = down;
@@ -853,6 +1040,92 @@ sc_input_manager_process_mouse_wheel(struct sc_input_manager *im,
     im->mp->ops->process_mouse_scroll(im->mp, &evt);
 }
 
+static void
+sc_input_manager_process_gamepad_device(struct sc_input_manager *im,
+                                const SDL_ControllerDeviceEvent *event) {
+    uint32_t gamepad_id;
+    if (event->type == SDL_CONTROLLERDEVICEADDED) {
+        // For this event, event->which is the device index
+        SDL_GameController *gc = SDL_GameControllerOpen(event->which);
+        if (!gc) {
+            LOGW("Could not open game controller");
+            return;
+        }
+
+        SDL_Joystick *joystick = SDL_GameControllerGetJoystick(gc);
+        if (!joystick) {
+            LOGW("Could not get controller joystick");
+            SDL_GameControllerClose(gc);
+            return;
+        }
+
+        gamepad_id = SDL_JoystickInstanceID(joystick);
+    } else {
+        assert(event->type == SDL_CONTROLLERDEVICEREMOVED);
+        // For this event, event->which is the instance id
+        gamepad_id = event->which;
+        SDL_GameController *gc = SDL_GameControllerFromInstanceID(gamepad_id);
+        if (gc) {
+            SDL_GameControllerClose(gc);
+        }
+    }
+
+    struct sc_gamepad_device_event evt = {
+        .type = sc_gamepad_device_event_type_from_sdl_type(event->type),
+        .gamepad_id = gamepad_id,
+    };
+    im->gp->ops->process_gamepad_device(im->gp, &evt);
+}
+
+static bool
+is_gamepad_axis_overridden(const SDL_ControllerAxisEvent *event) {
+    // The controllers generate axis events at their own rate, which may be
+    // far higher than what is useful. If the next queued event is a motion of
+    // the same axis, this one is obsolete: skip it.
+    SDL_Event next;
+    int r = SDL_PeepEvents(&next, 1, SDL_PEEKEVENT, SDL_FIRSTEVENT,
+                           SDL_LASTEVENT);
+    return r == 1 && next.type == SDL_CONTROLLERAXISMOTION
+                  && next.caxis.which == event->which
+                  && next.caxis.axis == event->axis;
+}
+
+static void
+sc_input_manager_process_gamepad_axis(struct sc_input_manager *im,
+                                      const SDL_ControllerAxisEvent *event) {
+    enum sc_gamepad_axis axis = sc_gamepad_axis_from_sdl(event->axis);
+    if (axis == SC_GAMEPAD_AXIS_UNKNOWN) {
+        return;
+    }
+
+    if (is_gamepad_axis_overridden(event)) {
+        return;
+    }
+
+    struct sc_gamepad_axis_event evt = {
+        .gamepad_id = event->which,
+        .axis = axis,
+        .value = event->value,
+    };
+    im->gp->ops->process_gamepad_axis(im->gp, &evt);
+}
+
+static void
+sc_input_manager_process_gamepad_button(struct sc_input_manager *im,
+                                const SDL_ControllerButtonEvent *event) {
+    enum sc_gamepad_button button = sc_gamepad_button_from_sdl(event->button);
+    if (button == SC_GAMEPAD_BUTTON_UNKNOWN) {
+        return;
+    }
+
+    struct sc_gamepad_button_event evt = {
+        .gamepad_id = event->which,
+        .action = sc_action_from_sdl_controllerbutton_type(event->type),
+        .button = button,
+    };
+    im->gp->ops->process_gamepad_button(im->gp, &evt);
+}
+
 static bool
 is_apk(const char *file) {
     const char *ext = strrchr(file, '.');
@@ -924,6 +1197,26 @@ sc_input_manager_handle_event(struct sc_input_manager *im,
             }
             sc_input_manager_process_touch(im, &event->tfinger);
             break;
+        case SDL_CONTROLLERDEVICEADDED:
+        case SDL_CONTROLLERDEVICEREMOVED:
+            if (!im->gp) {
+                break;
+            }
+            sc_input_manager_process_gamepad_device(im, &event->cdevice);
+            break;
+        case SDL_CONTROLLERAXISMOTION:
+            if (!im->gp) {
+                break;
+            }
+            sc_input_manager_process_gamepad_axis(im, &event->caxis);
+            break;
+        case SDL_CONTROLLERBUTTONDOWN:
+        case SDL_CONTROLLERBUTTONUP:
+            if (!im->gp) {
+                break;
+            }
+            sc_input_manager_process_gamepad_button(im, &event->cbutton);
+            break;
         case SDL_DROPFILE: {
             if (!control) {
                 break;
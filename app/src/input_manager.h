@@ -11,6 +11,8 @@
 #include "file_pusher.h"
 #include "fps_counter.h"
 #include "options.h"
+#include "replay_buffer.h"
+#include "trait/gamepad_processor.h"
 #include "trait/key_processor.h"
 #include "trait/mouse_processor.h"
 
@@ -18,14 +20,20 @@ struct sc_input_manager {
     struct sc_controller *controller;
     struct sc_file_pusher *fp;
     struct sc_screen *screen;
+    struct sc_replay_buffer *replay_buffer; // may be NULL
 
     struct sc_key_processor *kp;
     struct sc_mouse_processor *mp;
+    struct sc_gamepad_processor *gp; // may be NULL
 
     bool forward_all_clicks;
     bool legacy_paste;
     bool clipboard_autosync;
 
+    // Initial video limits (requested on the command line), to be restored
+    uint16_t max_size;
+    uint16_t max_fps;
+
     struct {
         unsigned data[SC_MAX_SHORTCUT_MODS];
         unsigned count;
@@ -49,12 +57,16 @@ struct sc_input_manager_params {
     struct sc_controller *controller;
     struct sc_file_pusher *fp;
     struct sc_screen *screen;
+    struct sc_replay_buffer *replay_buffer; // may be NULL
     struct sc_key_processor *kp;
     struct sc_mouse_processor *mp;
+    struct sc_gamepad_processor *gp; // may be NULL
 
     bool forward_all_clicks;
     bool legacy_paste;
     bool clipboard_autosync;
+    uint16_t max_size;
+    uint16_t max_fps;
     const struct sc_shortcut_mods *shortcut_mods;
 };
 
@@ -0,0 +1,154 @@
+#include "input_overlay.h"
+
+#include <assert.h>
+
+// The trail covers approximately the round-trip latency
+#define SC_INPUT_OVERLAY_TRAIL_DURATION SC_TICK_FROM_MS(150)
+#define SC_INPUT_OVERLAY_MARKER_SIZE 16
+
+void
+sc_input_overlay_init(struct sc_input_overlay *overlay) {
+    sc_input_overlay_clear(overlay);
+}
+
+void
+sc_input_overlay_clear(struct sc_input_overlay *overlay) {
+    for (unsigned i = 0; i < SC_INPUT_OVERLAY_MAX_POINTERS; ++i) {
+        overlay->pointers[i].active = false;
+    }
+}
+
+static struct sc_input_overlay_pointer *
+sc_input_overlay_find(struct sc_input_overlay *overlay, uint64_t id) {
+    for (unsigned i = 0; i < SC_INPUT_OVERLAY_MAX_POINTERS; ++i) {
+        struct sc_input_overlay_pointer *pointer = &overlay->pointers[i];
+        if (pointer->active && pointer->id == id) {
+            return pointer;
+        }
+    }
+
+    return NULL;
+}
+
+static void
+sc_input_overlay_pointer_push(struct sc_input_overlay_pointer *pointer,
+                              int32_t x, int32_t y, sc_tick now) {
+    pointer->head = (pointer->head + 1) % SC_INPUT_OVERLAY_TRAIL_LENGTH;
+    pointer->trail[pointer->head] = (struct sc_input_overlay_point) {
+        .x = x,
+        .y = y,
+        .time = now,
+    };
+    if (pointer->count < SC_INPUT_OVERLAY_TRAIL_LENGTH) {
+        ++pointer->count;
+    }
+}
+
+bool
+sc_input_overlay_press(struct sc_input_overlay *overlay, uint64_t id,
+                       int32_t x, int32_t y, sc_tick now) {
+    struct sc_input_overlay_pointer *pointer =
+        sc_input_overlay_find(overlay, id);
+    if (!pointer) {
+        for (unsigned i = 0; i < SC_INPUT_OVERLAY_MAX_POINTERS; ++i) {
+            if (!overlay->pointers[i].active) {
+                pointer = &overlay->pointers[i];
+                break;
+            }
+        }
+        if (!pointer) {
+            return false;
+        }
+
+        pointer->id = id;
+        pointer->active = true;
+        pointer->head = 0;
+        pointer->count = 0;
+    }
+
+    sc_input_overlay_pointer_push(pointer, x, y, now);
+    return true;
+}
+
+bool
+sc_input_overlay_move(struct sc_input_overlay *overlay, uint64_t id,
+                      int32_t x, int32_t y, sc_tick now) {
+    struct sc_input_overlay_pointer *pointer =
+        sc_input_overlay_find(overlay, id);
+    if (!pointer) {
+        return false;
+    }
+
+    sc_input_overlay_pointer_push(pointer, x, y, now);
+    return true;
+}
+
+bool
+sc_input_overlay_release(struct sc_input_overlay *overlay, uint64_t id) {
+    struct sc_input_overlay_pointer *pointer =
+        sc_input_overlay_find(overlay, id);
+    if (!pointer) {
+        return false;
+    }
+
+    pointer->active = false;
+    return true;
+}
+
+static void
+sc_input_overlay_render_pointer(const struct sc_input_overlay_pointer *pointer,
+                                SDL_Renderer *renderer, sc_tick now) {
+    assert(pointer->count);
+
+    // Draw the trail from the most recent position, the older segments fade
+    // out
+    const struct sc_input_overlay_point *next = &pointer->trail[pointer->head];
+    for (unsigned i = 1; i < pointer->count; ++i) {
+        unsigned index = (pointer->head + SC_INPUT_OVERLAY_TRAIL_LENGTH - i)
+                       % SC_INPUT_OVERLAY_TRAIL_LENGTH;
+        const struct sc_input_overlay_point *point = &pointer->trail[index];
+        sc_tick age = now - point->time;
+        if (age >= SC_INPUT_OVERLAY_TRAIL_DURATION) {
+            break;
+        }
+
+        uint8_t alpha = 192 - 192 * age / SC_INPUT_OVERLAY_TRAIL_DURATION;
+        SDL_SetRenderDrawColor(renderer, 0xff, 0xff, 0xff, alpha);
+        SDL_RenderDrawLine(renderer, point->x, point->y, next->x, next->y);
+        next = point;
+    }
+
+    const struct sc_input_overlay_point *last = &pointer->trail[pointer->head];
+    SDL_Rect marker = {
+        .x = last->x - SC_INPUT_OVERLAY_MARKER_SIZE / 2,
+        .y = last->y - SC_INPUT_OVERLAY_MARKER_SIZE / 2,
+        .w = SC_INPUT_OVERLAY_MARKER_SIZE,
+        .h = SC_INPUT_OVERLAY_MARKER_SIZE,
+    };
+    SDL_SetRenderDrawColor(renderer, 0xff, 0xff, 0xff, 0x80);
+    SDL_RenderFillRect(renderer, &marker);
+}
+
+void
+sc_input_overlay_render(const struct sc_input_overlay *overlay,
+                        SDL_Renderer *renderer, const SDL_Rect *clip,
+                        sc_tick now) {
+    uint8_t r, g, b, a;
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+    SDL_BlendMode blend_mode;
+    SDL_GetRenderDrawBlendMode(renderer, &blend_mode);
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_RenderSetClipRect(renderer, clip);
+
+    for (unsigned i = 0; i < SC_INPUT_OVERLAY_MAX_POINTERS; ++i) {
+        const struct sc_input_overlay_pointer *pointer = &overlay->pointers[i];
+        if (pointer->active) {
+            sc_input_overlay_render_pointer(pointer, renderer, now);
+        }
+    }
+
+    SDL_RenderSetClipRect(renderer, NULL);
+    SDL_SetRenderDrawBlendMode(renderer, blend_mode);
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+}
@@ -0,0 +1,86 @@
+#ifndef SC_INPUT_OVERLAY_H
+#define SC_INPUT_OVERLAY_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+#include "util/tick.h"
+
+#define SC_INPUT_OVERLAY_MAX_POINTERS 10
+#define SC_INPUT_OVERLAY_TRAIL_LENGTH 32
+
+/**
+ * Local feedback of the pressed pointers (mouse drag or fingers)
+ *
+ * The pointer positions and a short trail of their recent positions are drawn
+ * over the mirrored content as soon as the input events are received, so that
+ * the user gets an immediate feedback while the device is still processing
+ * the events (the round-trip latency is several frames).
+ *
+ * The positions are stored in drawable coordinates.
+ */
+struct sc_input_overlay_point {
+    int32_t x;
+    int32_t y;
+    sc_tick time;
+};
+
+struct sc_input_overlay_pointer {
+    uint64_t id;
+    bool active;
+    // ring buffer of the recent positions
+    struct sc_input_overlay_point trail[SC_INPUT_OVERLAY_TRAIL_LENGTH];
+    unsigned head; // index of the last position
+    unsigned count;
+};
+
+struct sc_input_overlay {
+    struct sc_input_overlay_pointer pointers[SC_INPUT_OVERLAY_MAX_POINTERS];
+};
+
+void
+sc_input_overlay_init(struct sc_input_overlay *overlay);
+
+/**
+ * Start tracking a pressed pointer
+ *
+ * Return false if too many pointers are already tracked.
+ */
+bool
+sc_input_overlay_press(struct sc_input_overlay *overlay, uint64_t id,
+                       int32_t x, int32_t y, sc_tick now);
+
+/**
+ * Move a tracked pointer
+ *
+ * Return false if the pointer is not tracked (nothing to redraw).
+ */
+bool
+sc_input_overlay_move(struct sc_input_overlay *overlay, uint64_t id,
+                      int32_t x, int32_t y, sc_tick now);
+
+/**
+ * Stop tracking a pointer
+ *
+ * Return false if the pointer was not tracked (nothing to redraw).
+ */
+bool
+sc_input_overlay_release(struct sc_input_overlay *overlay, uint64_t id);
+
+void
+sc_input_overlay_clear(struct sc_input_overlay *overlay);
+
+/**
+ * Draw the tracked pointers, clipped to the content rectangle
+ *
+ * The renderer draw color and blend mode are restored.
+ */
+void
+sc_input_overlay_render(const struct sc_input_overlay *overlay,
+                        SDL_Renderer *renderer, const SDL_Rect *clip,
+                        sc_tick now);
+
+#endif
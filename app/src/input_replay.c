@@ -0,0 +1,259 @@
+#include "input_replay.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "controller.h"
+#include "util/binary.h"
+#include "util/log.h"
+
+#define SC_INPUT_RECORD_MAGIC "scrcpyin"
+#define SC_INPUT_RECORD_MAGIC_LENGTH (sizeof(SC_INPUT_RECORD_MAGIC) - 1)
+#define SC_INPUT_RECORD_VERSION 1
+#define SC_INPUT_RECORD_HEADER_LENGTH (SC_INPUT_RECORD_MAGIC_LENGTH + 1)
+// time: 8 bytes; length: 4 bytes
+#define SC_INPUT_RECORD_ENTRY_HEADER_LENGTH 12
+// The largest recorded message is an INJECT_TEXT message (type: 1 byte;
+// length: 4 bytes)
+#define SC_INPUT_RECORD_MSG_MAX_SIZE \
+    (5 + SC_CONTROL_MSG_INJECT_TEXT_MAX_LENGTH)
+
+static bool
+is_recordable(const struct sc_control_msg *msg) {
+    switch (msg->type) {
+        case SC_CONTROL_MSG_TYPE_INJECT_KEYCODE:
+        case SC_CONTROL_MSG_TYPE_INJECT_TEXT:
+        case SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT:
+        case SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT:
+        case SC_CONTROL_MSG_TYPE_BACK_OR_SCREEN_ON:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool
+sc_input_recorder_init(struct sc_input_recorder *recorder,
+                       const char *filename) {
+    recorder->file = fopen(filename, "wb");
+    if (!recorder->file) {
+        LOGE("Could not open input record file: %s", filename);
+        return false;
+    }
+
+    uint8_t header[SC_INPUT_RECORD_HEADER_LENGTH];
+    memcpy(header, SC_INPUT_RECORD_MAGIC, SC_INPUT_RECORD_MAGIC_LENGTH);
+    header[SC_INPUT_RECORD_MAGIC_LENGTH] = SC_INPUT_RECORD_VERSION;
+    if (fwrite(header, sizeof(header), 1, recorder->file) != 1) {
+        LOGE("Could not write input record header: %s", filename);
+        fclose(recorder->file);
+        return false;
+    }
+
+    recorder->start = sc_tick_now();
+    recorder->failed = false;
+
+    LOGI("Recording input events to %s", filename);
+
+    return true;
+}
+
+void
+sc_input_recorder_destroy(struct sc_input_recorder *recorder) {
+    if (fclose(recorder->file)) {
+        LOGE("Could not close input record file");
+    }
+}
+
+void
+sc_input_recorder_record(struct sc_input_recorder *recorder,
+                         const struct sc_control_msg *msg) {
+    if (recorder->failed || !is_recordable(msg)) {
+        return;
+    }
+
+    uint8_t buf[SC_INPUT_RECORD_ENTRY_HEADER_LENGTH
+                + SC_INPUT_RECORD_MSG_MAX_SIZE];
+    uint8_t *payload = &buf[SC_INPUT_RECORD_ENTRY_HEADER_LENGTH];
+    size_t len = sc_control_msg_serialize(msg, payload);
+    assert(len && len <= SC_INPUT_RECORD_MSG_MAX_SIZE);
+
+    sc_tick time = sc_tick_now() - recorder->start;
+    sc_write64be(buf, SC_TICK_TO_US(time));
+    sc_write32be(&buf[8], len);
+
+    // The file is buffered, this does not block on every message
+    size_t size = SC_INPUT_RECORD_ENTRY_HEADER_LENGTH + len;
+    if (fwrite(buf, size, 1, recorder->file) != 1) {
+        LOGE("Could not write input event, input recording stopped");
+        recorder->failed = true;
+    }
+}
+
+bool
+sc_input_replayer_init(struct sc_input_replayer *replayer,
+                       const char *filename, struct sc_controller *controller) {
+    replayer->file = fopen(filename, "rb");
+    if (!replayer->file) {
+        LOGE("Could not open input replay file: %s", filename);
+        return false;
+    }
+
+    uint8_t header[SC_INPUT_RECORD_HEADER_LENGTH];
+    if (fread(header, sizeof(header), 1, replayer->file) != 1
+            || memcmp(header, SC_INPUT_RECORD_MAGIC,
+                      SC_INPUT_RECORD_MAGIC_LENGTH)) {
+        LOGE("Not an input record file: %s", filename);
+        goto error_close_file;
+    }
+
+    if (header[SC_INPUT_RECORD_MAGIC_LENGTH] != SC_INPUT_RECORD_VERSION) {
+        LOGE("Unsupported input record version: %u",
+             (unsigned) header[SC_INPUT_RECORD_MAGIC_LENGTH]);
+        goto error_close_file;
+    }
+
+    bool ok = sc_mutex_init(&replayer->mutex);
+    if (!ok) {
+        goto error_close_file;
+    }
+
+    ok = sc_cond_init(&replayer->cond);
+    if (!ok) {
+        sc_mutex_destroy(&replayer->mutex);
+        goto error_close_file;
+    }
+
+    replayer->controller = controller;
+    replayer->stopped = false;
+
+    return true;
+
+error_close_file:
+    fclose(replayer->file);
+
+    return false;
+}
+
+void
+sc_input_replayer_destroy(struct sc_input_replayer *replayer) {
+    sc_cond_destroy(&replayer->cond);
+    sc_mutex_destroy(&replayer->mutex);
+    fclose(replayer->file);
+}
+
+// Read the next message, return false on end of file or error
+static bool
+read_msg(struct sc_input_replayer *replayer, sc_tick *time,
+         struct sc_control_msg *msg) {
+    uint8_t header[SC_INPUT_RECORD_ENTRY_HEADER_LENGTH];
+    size_t r = fread(header, 1, sizeof(header), replayer->file);
+    if (r != sizeof(header)) {
+        if (r || ferror(replayer->file)) {
+            LOGE("Input replay file truncated");
+        }
+        return false;
+    }
+
+    *time = SC_TICK_FROM_US((sc_tick) sc_read64be(header));
+    uint32_t len = sc_read32be(&header[8]);
+    if (len > SC_INPUT_RECORD_MSG_MAX_SIZE) {
+        LOGE("Invalid input replay entry (length %" PRIu32 ")", len);
+        return false;
+    }
+
+    uint8_t buf[SC_INPUT_RECORD_MSG_MAX_SIZE];
+    if (fread(buf, 1, len, replayer->file) != len) {
+        LOGE("Input replay file truncated");
+        return false;
+    }
+
+    ssize_t consumed = sc_control_msg_deserialize(buf, len, msg);
+    if (consumed != (ssize_t) len) {
+        if (consumed > 0) {
+            sc_control_msg_destroy(msg);
+        }
+        LOGE("Invalid input replay message");
+        return false;
+    }
+
+    return true;
+}
+
+static int
+run_input_replayer(void *data) {
+    struct sc_input_replayer *replayer = data;
+
+    sc_tick start = sc_tick_now();
+    unsigned count = 0;
+
+    for (;;) {
+        sc_tick time;
+        struct sc_control_msg msg;
+        if (!read_msg(replayer, &time, &msg)) {
+            break;
+        }
+
+        // Wait until the time the message was recorded
+        sc_tick deadline = start + time;
+        sc_mutex_lock(&replayer->mutex);
+        bool timed_out = false;
+        while (!replayer->stopped && !timed_out) {
+            timed_out = !sc_cond_timedwait(&replayer->cond, &replayer->mutex,
+                                           deadline);
+        }
+        bool stopped = replayer->stopped;
+        sc_mutex_unlock(&replayer->mutex);
+
+        if (stopped) {
+            sc_control_msg_destroy(&msg);
+            break;
+        }
+
+        if (msg.type == SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT) {
+            // The recorded timestamps are relative to another session, let
+            // the device use the injection time
+            msg.inject_touch_event.timestamp = 0;
+        }
+
+        if (!sc_controller_push_msg(replayer->controller, &msg)) {
+            sc_control_msg_destroy(&msg);
+            LOGW("Could not replay input event");
+            continue;
+        }
+
+        ++count;
+    }
+
+    LOGI("Input replay finished (%u events)", count);
+
+    return 0;
+}
+
+bool
+sc_input_replayer_start(struct sc_input_replayer *replayer) {
+    LOGD("Starting input replayer thread");
+
+    bool ok = sc_thread_create(&replayer->thread, run_input_replayer,
+                               "scrcpy-replay", replayer);
+    if (!ok) {
+        LOGE("Could not start input replayer thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_input_replayer_stop(struct sc_input_replayer *replayer) {
+    sc_mutex_lock(&replayer->mutex);
+    replayer->stopped = true;
+    sc_cond_signal(&replayer->cond);
+    sc_mutex_unlock(&replayer->mutex);
+}
+
+void
+sc_input_replayer_join(struct sc_input_replayer *replayer) {
+    sc_thread_join(&replayer->thread, NULL);
+}
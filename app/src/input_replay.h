@@ -0,0 +1,81 @@
+#ifndef SC_INPUT_REPLAY_H
+#define SC_INPUT_REPLAY_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "control_msg.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+struct sc_controller;
+
+/**
+ * Record the input control messages to a file, with their timing, to replay
+ * them later (e.g. to run the same gestures for UI benchmarks)
+ *
+ * The file starts with a header (8-byte magic + 1-byte version), followed by
+ * one entry per message:
+ *  - the time since the start of the recording, in microseconds (8 bytes);
+ *  - the length of the serialized message (4 bytes);
+ *  - the message, serialized as it is sent to the device.
+ *
+ * Only the input events (key, text, touch, scroll and back-or-screen-on) are
+ * recorded.
+ */
+struct sc_input_recorder {
+    FILE *file;
+    sc_tick start;
+    bool failed;
+};
+
+bool
+sc_input_recorder_init(struct sc_input_recorder *recorder,
+                       const char *filename);
+
+void
+sc_input_recorder_destroy(struct sc_input_recorder *recorder);
+
+/**
+ * Record a message (ignored if it is not an input event)
+ *
+ * It must not be called concurrently (the controller calls it with its mutex
+ * locked).
+ */
+void
+sc_input_recorder_record(struct sc_input_recorder *recorder,
+                         const struct sc_control_msg *msg);
+
+/**
+ * Replay the input control messages recorded by a sc_input_recorder, with the
+ * same timing
+ */
+struct sc_input_replayer {
+    FILE *file;
+    struct sc_controller *controller;
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    bool stopped;
+};
+
+bool
+sc_input_replayer_init(struct sc_input_replayer *replayer,
+                       const char *filename, struct sc_controller *controller);
+
+void
+sc_input_replayer_destroy(struct sc_input_replayer *replayer);
+
+bool
+sc_input_replayer_start(struct sc_input_replayer *replayer);
+
+void
+sc_input_replayer_stop(struct sc_input_replayer *replayer);
+
+void
+sc_input_replayer_join(struct sc_input_replayer *replayer);
+
+#endif
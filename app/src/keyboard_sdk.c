@@ -1,6 +1,8 @@
 #include "keyboard_sdk.h"
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "android/input.h"
 #include "control_msg.h"
@@ -24,33 +26,35 @@ convert_keycode_action(enum sc_action action) {
 static bool
 convert_keycode(enum sc_keycode from, enum android_keycode *to, uint16_t mod,
                 enum sc_key_inject_mode key_inject_mode) {
+    // The tables below must be sorted by SDL keycode (they are searched by
+    // dichotomy).
+
     // Navigation keys and ENTER.
     // Used in all modes.
     static const struct sc_intmap_entry special_keys[] = {
-        {SC_KEYCODE_RETURN,    AKEYCODE_ENTER},
-        {SC_KEYCODE_KP_ENTER,  AKEYCODE_NUMPAD_ENTER},
-        {SC_KEYCODE_ESCAPE,    AKEYCODE_ESCAPE},
         {SC_KEYCODE_BACKSPACE, AKEYCODE_DEL},
         {SC_KEYCODE_TAB,       AKEYCODE_TAB},
-        {SC_KEYCODE_PAGEUP,    AKEYCODE_PAGE_UP},
+        {SC_KEYCODE_RETURN,    AKEYCODE_ENTER},
+        {SC_KEYCODE_ESCAPE,    AKEYCODE_ESCAPE},
         {SC_KEYCODE_DELETE,    AKEYCODE_FORWARD_DEL},
         {SC_KEYCODE_HOME,      AKEYCODE_MOVE_HOME},
+        {SC_KEYCODE_PAGEUP,    AKEYCODE_PAGE_UP},
         {SC_KEYCODE_END,       AKEYCODE_MOVE_END},
         {SC_KEYCODE_PAGEDOWN,  AKEYCODE_PAGE_DOWN},
         {SC_KEYCODE_RIGHT,     AKEYCODE_DPAD_RIGHT},
         {SC_KEYCODE_LEFT,      AKEYCODE_DPAD_LEFT},
         {SC_KEYCODE_DOWN,      AKEYCODE_DPAD_DOWN},
         {SC_KEYCODE_UP,        AKEYCODE_DPAD_UP},
+        {SC_KEYCODE_KP_ENTER,  AKEYCODE_NUMPAD_ENTER},
         {SC_KEYCODE_LCTRL,     AKEYCODE_CTRL_LEFT},
-        {SC_KEYCODE_RCTRL,     AKEYCODE_CTRL_RIGHT},
         {SC_KEYCODE_LSHIFT,    AKEYCODE_SHIFT_LEFT},
+        {SC_KEYCODE_RCTRL,     AKEYCODE_CTRL_RIGHT},
         {SC_KEYCODE_RSHIFT,    AKEYCODE_SHIFT_RIGHT},
     };
 
     // Numpad navigation keys.
     // Used in all modes, when NumLock and Shift are disabled.
     static const struct sc_intmap_entry kp_nav_keys[] = {
-        {SC_KEYCODE_KP_0,      AKEYCODE_INSERT},
         {SC_KEYCODE_KP_1,      AKEYCODE_MOVE_END},
         {SC_KEYCODE_KP_2,      AKEYCODE_DPAD_DOWN},
         {SC_KEYCODE_KP_3,      AKEYCODE_PAGE_DOWN},
@@ -59,12 +63,14 @@ convert_keycode(enum sc_keycode from, enum android_keycode *to, uint16_t mod,
         {SC_KEYCODE_KP_7,      AKEYCODE_MOVE_HOME},
         {SC_KEYCODE_KP_8,      AKEYCODE_DPAD_UP},
         {SC_KEYCODE_KP_9,      AKEYCODE_PAGE_UP},
+        {SC_KEYCODE_KP_0,      AKEYCODE_INSERT},
         {SC_KEYCODE_KP_PERIOD, AKEYCODE_FORWARD_DEL},
     };
 
     // Letters and space.
     // Used in non-text mode.
     static const struct sc_intmap_entry alphaspace_keys[] = {
+        {SC_KEYCODE_SPACE,     AKEYCODE_SPACE},
         {SC_KEYCODE_a,         AKEYCODE_A},
         {SC_KEYCODE_b,         AKEYCODE_B},
         {SC_KEYCODE_c,         AKEYCODE_C},
@@ -91,7 +97,6 @@ convert_keycode(enum sc_keycode from, enum android_keycode *to, uint16_t mod,
         {SC_KEYCODE_x,         AKEYCODE_X},
         {SC_KEYCODE_y,         AKEYCODE_Y},
         {SC_KEYCODE_z,         AKEYCODE_Z},
-        {SC_KEYCODE_SPACE,     AKEYCODE_SPACE},
     };
 
     // Numbers and punctuation keys.
@@ -123,6 +128,10 @@ convert_keycode(enum sc_keycode from, enum android_keycode *to, uint16_t mod,
         {SC_KEYCODE_BACKSLASH,     AKEYCODE_BACKSLASH},
         {SC_KEYCODE_RIGHTBRACKET,  AKEYCODE_RIGHT_BRACKET},
         {SC_KEYCODE_BACKQUOTE,     AKEYCODE_GRAVE},
+        {SC_KEYCODE_KP_DIVIDE,     AKEYCODE_NUMPAD_DIVIDE},
+        {SC_KEYCODE_KP_MULTIPLY,   AKEYCODE_NUMPAD_MULTIPLY},
+        {SC_KEYCODE_KP_MINUS,      AKEYCODE_NUMPAD_SUBTRACT},
+        {SC_KEYCODE_KP_PLUS,       AKEYCODE_NUMPAD_ADD},
         {SC_KEYCODE_KP_1,          AKEYCODE_NUMPAD_1},
         {SC_KEYCODE_KP_2,          AKEYCODE_NUMPAD_2},
         {SC_KEYCODE_KP_3,          AKEYCODE_NUMPAD_3},
@@ -133,10 +142,6 @@ convert_keycode(enum sc_keycode from, enum android_keycode *to, uint16_t mod,
         {SC_KEYCODE_KP_8,          AKEYCODE_NUMPAD_8},
         {SC_KEYCODE_KP_9,          AKEYCODE_NUMPAD_9},
         {SC_KEYCODE_KP_0,          AKEYCODE_NUMPAD_0},
-        {SC_KEYCODE_KP_DIVIDE,     AKEYCODE_NUMPAD_DIVIDE},
-        {SC_KEYCODE_KP_MULTIPLY,   AKEYCODE_NUMPAD_MULTIPLY},
-        {SC_KEYCODE_KP_MINUS,      AKEYCODE_NUMPAD_SUBTRACT},
-        {SC_KEYCODE_KP_PLUS,       AKEYCODE_NUMPAD_ADD},
         {SC_KEYCODE_KP_PERIOD,     AKEYCODE_NUMPAD_DOT},
         {SC_KEYCODE_KP_EQUALS,     AKEYCODE_NUMPAD_EQUALS},
         {SC_KEYCODE_KP_LEFTPAREN,  AKEYCODE_NUMPAD_LEFT_PAREN},
@@ -262,6 +267,45 @@ convert_input_key(const struct sc_key_event *event, struct sc_control_msg *msg,
     return true;
 }
 
+static void
+sc_keyboard_sdk_flush_text(struct sc_keyboard_sdk *kb) {
+    if (!kb->pending_text) {
+        return;
+    }
+
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_INJECT_TEXT;
+    msg.inject_text.text = kb->pending_text; // moved to the message
+    kb->pending_text = NULL;
+    kb->pending_text_len = 0;
+
+    if (!sc_controller_push_msg(kb->controller, &msg)) {
+        free(msg.inject_text.text);
+        LOGW("Could not request 'inject text'");
+    }
+}
+
+static bool
+sc_keyboard_sdk_append_text(struct sc_keyboard_sdk *kb, const char *text) {
+    size_t len = strlen(text);
+    if (kb->pending_text_len + len > SC_CONTROL_MSG_INJECT_TEXT_MAX_LENGTH) {
+        // The pending text would not fit in a single message
+        sc_keyboard_sdk_flush_text(kb);
+    }
+
+    char *pending = realloc(kb->pending_text, kb->pending_text_len + len + 1);
+    if (!pending) {
+        LOG_OOM();
+        return false;
+    }
+
+    memcpy(&pending[kb->pending_text_len], text, len + 1);
+    kb->pending_text = pending;
+    kb->pending_text_len += len;
+
+    return true;
+}
+
 static void
 sc_key_processor_process_key(struct sc_key_processor *kp,
                              const struct sc_key_event *event,
@@ -273,6 +317,9 @@ sc_key_processor_process_key(struct sc_key_processor *kp,
 
     struct sc_keyboard_sdk *kb = DOWNCAST(kp);
 
+    // Never reorder a key event with respect to the pending text
+    sc_keyboard_sdk_flush_text(kb);
+
     if (event->repeat) {
         if (!kb->forward_key_repeat) {
             return;
@@ -300,25 +347,24 @@ sc_key_processor_process_text(struct sc_key_processor *kp,
         return;
     }
 
+    bool skip = false;
     if (kb->key_inject_mode == SC_KEY_INJECT_MODE_MIXED) {
         char c = event->text[0];
         if (isalpha(c) || c == ' ') {
             assert(event->text[1] == '\0');
             // Letters and space are handled as raw key events
-            return;
+            skip = true;
         }
     }
 
-    struct sc_control_msg msg;
-    msg.type = SC_CONTROL_MSG_TYPE_INJECT_TEXT;
-    msg.inject_text.text = strdup(event->text);
-    if (!msg.inject_text.text) {
-        LOGW("Could not strdup input text");
-        return;
+    if (!skip) {
+        // On error, the text is lost, but the pending text is still sent
+        sc_keyboard_sdk_append_text(kb, event->text);
     }
-    if (!sc_controller_push_msg(kb->controller, &msg)) {
-        free(msg.inject_text.text);
-        LOGW("Could not request 'inject text'");
+
+    if (!event->more) {
+        // The end of the composed text (or a single text event)
+        sc_keyboard_sdk_flush_text(kb);
     }
 }
 
@@ -332,6 +378,8 @@ sc_keyboard_sdk_init(struct sc_keyboard_sdk *kb,
     kb->forward_key_repeat = forward_key_repeat;
 
     kb->repeat = 0;
+    kb->pending_text = NULL;
+    kb->pending_text_len = 0;
 
     static const struct sc_key_processor_ops ops = {
         .process_key = sc_key_processor_process_key,
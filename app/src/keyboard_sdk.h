@@ -20,6 +20,11 @@ struct sc_keyboard_sdk {
 
     enum sc_key_inject_mode key_inject_mode;
     bool forward_key_repeat;
+
+    // Consecutive text events not injected yet (NULL if none), sent as a
+    // single INJECT_TEXT message
+    char *pending_text;
+    size_t pending_text_len;
 };
 
 void
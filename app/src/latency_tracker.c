@@ -0,0 +1,131 @@
+#include "latency_tracker.h"
+
+#include <assert.h>
+#include <libavutil/avutil.h>
+
+#include "util/log.h"
+
+#define SC_LATENCY_TRACKER_REPORT_INTERVAL SC_TICK_FROM_SEC(10)
+
+static const char *const stage_names[] = {
+    [SC_LATENCY_STAGE_DECODED] = "decoded",
+    [SC_LATENCY_STAGE_CONSUMED] = "consumed",
+    [SC_LATENCY_STAGE_PRESENTED] = "presented",
+};
+
+bool
+sc_latency_tracker_init(struct sc_latency_tracker *tracker,
+                        struct sc_clock_sync *clock_sync) {
+    bool ok = sc_mutex_init(&tracker->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    for (unsigned i = 0; i < SC_LATENCY_TRACKER_INFLIGHT; ++i) {
+        tracker->inflight[i].pts = AV_NOPTS_VALUE;
+    }
+    tracker->inflight_head = 0;
+
+    for (unsigned i = 0; i < SC_LATENCY_STAGE_COUNT; ++i) {
+        sc_samples_init(&tracker->stages[i]);
+    }
+
+    tracker->clock_sync = clock_sync;
+    sc_samples_init(&tracker->capture);
+
+    tracker->next_report = sc_tick_now() + SC_LATENCY_TRACKER_REPORT_INTERVAL;
+
+    return true;
+}
+
+// must be called with mutex locked
+static void
+sc_latency_tracker_report(struct sc_latency_tracker *tracker) {
+    static const unsigned percents[] = {50, 95, 99};
+
+    for (unsigned i = 0; i < SC_LATENCY_STAGE_COUNT; ++i) {
+        struct sc_samples *samples = &tracker->stages[i];
+
+        sc_tick p[ARRAY_LEN(percents)];
+        if (!sc_samples_get_percentiles(samples, percents, p,
+                                        ARRAY_LEN(percents))) {
+            continue;
+        }
+
+        LOGI("Latency %-9s p50=%.1fms p95=%.1fms p99=%.1fms (%u frames)",
+             stage_names[i], p[0] / 1000.f, p[1] / 1000.f, p[2] / 1000.f,
+             samples->count);
+    }
+
+    sc_tick p[ARRAY_LEN(percents)];
+    sc_tick offset;
+    sc_tick error;
+    if (tracker->clock_sync
+            && sc_clock_sync_get(tracker->clock_sync, &offset, &error)
+            && sc_samples_get_percentiles(&tracker->capture, percents, p,
+                                          ARRAY_LEN(percents))) {
+        LOGI("Latency capture-to-received p50=%.1fms p95=%.1fms p99=%.1fms "
+             "(+/-%.1fms, %u frames)", p[0] / 1000.f, p[1] / 1000.f,
+             p[2] / 1000.f, error / 1000.f, tracker->capture.count);
+    }
+}
+
+void
+sc_latency_tracker_destroy(struct sc_latency_tracker *tracker) {
+    sc_latency_tracker_report(tracker);
+    sc_mutex_destroy(&tracker->mutex);
+}
+
+void
+sc_latency_tracker_on_received(struct sc_latency_tracker *tracker,
+                               int64_t pts) {
+    sc_tick now = sc_tick_now();
+
+    sc_tick offset;
+    sc_tick error;
+    bool capture = pts != AV_NOPTS_VALUE && tracker->clock_sync
+                && sc_clock_sync_get(tracker->clock_sync, &offset, &error);
+
+    sc_mutex_lock(&tracker->mutex);
+    if (capture) {
+        // The PTS is the capture date, in device time
+        sc_samples_push(&tracker->capture, now - (pts - offset));
+    }
+    unsigned head = tracker->inflight_head;
+    tracker->inflight[head].pts = pts;
+    tracker->inflight[head].received = now;
+    tracker->inflight_head = (head + 1) % SC_LATENCY_TRACKER_INFLIGHT;
+    sc_mutex_unlock(&tracker->mutex);
+}
+
+void
+sc_latency_tracker_on_stage(struct sc_latency_tracker *tracker,
+                            enum sc_latency_stage stage, int64_t pts) {
+    assert(stage < SC_LATENCY_STAGE_COUNT);
+
+    if (pts == AV_NOPTS_VALUE) {
+        return;
+    }
+
+    sc_tick now = sc_tick_now();
+
+    sc_mutex_lock(&tracker->mutex);
+
+    // Search from the most recent frame
+    for (unsigned i = 0; i < SC_LATENCY_TRACKER_INFLIGHT; ++i) {
+        unsigned index = (tracker->inflight_head + SC_LATENCY_TRACKER_INFLIGHT
+                            - 1 - i) % SC_LATENCY_TRACKER_INFLIGHT;
+        if (tracker->inflight[index].pts == pts) {
+            sc_tick latency = now - tracker->inflight[index].received;
+            sc_samples_push(&tracker->stages[stage], latency);
+            break;
+        }
+    }
+
+    if (stage == SC_LATENCY_STAGE_PRESENTED && now >= tracker->next_report) {
+        sc_latency_tracker_report(tracker);
+        tracker->next_report = now + SC_LATENCY_TRACKER_REPORT_INTERVAL;
+    }
+
+    sc_mutex_unlock(&tracker->mutex);
+}
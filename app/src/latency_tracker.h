@@ -0,0 +1,67 @@
+#ifndef SC_LATENCY_TRACKER_H
+#define SC_LATENCY_TRACKER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "clock_sync.h"
+#include "util/samples.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+// Number of frames which may be in flight between reception and present
+#define SC_LATENCY_TRACKER_INFLIGHT 16
+
+enum sc_latency_stage {
+    SC_LATENCY_STAGE_DECODED,   // frame output by the decoder
+    SC_LATENCY_STAGE_CONSUMED,  // frame consumed by the screen
+    SC_LATENCY_STAGE_PRESENTED, // frame rendered on screen
+    SC_LATENCY_STAGE_COUNT,
+};
+
+/**
+ * Measure the client-side latency of each video frame, from the reception of
+ * its packet to each pipeline stage.
+ *
+ * Frames are identified by their PTS. The percentiles are printed
+ * periodically and on destroy.
+ *
+ * If the device clock is measured (clock_sync), the latency from the capture
+ * on the device to the reception is also measured.
+ */
+struct sc_latency_tracker {
+    sc_mutex mutex;
+
+    struct {
+        int64_t pts;
+        sc_tick received;
+    } inflight[SC_LATENCY_TRACKER_INFLIGHT];
+    unsigned inflight_head; // index of the next slot to write
+
+    struct sc_samples stages[SC_LATENCY_STAGE_COUNT];
+    sc_tick next_report;
+
+    struct sc_clock_sync *clock_sync; // may be NULL
+    // From the capture on the device to the reception of the packet
+    struct sc_samples capture;
+};
+
+bool
+sc_latency_tracker_init(struct sc_latency_tracker *tracker,
+                        struct sc_clock_sync *clock_sync);
+
+// Print the final report
+void
+sc_latency_tracker_destroy(struct sc_latency_tracker *tracker);
+
+void
+sc_latency_tracker_on_received(struct sc_latency_tracker *tracker,
+                               int64_t pts);
+
+void
+sc_latency_tracker_on_stage(struct sc_latency_tracker *tracker,
+                            enum sc_latency_stage stage, int64_t pts);
+
+#endif
@@ -0,0 +1,110 @@
+#include "list_cache.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/file.h"
+#include "util/log.h"
+#include "util/rand.h"
+
+// The first line identifies the file format, the following bytes are the
+// server output, as is
+#define SC_LIST_CACHE_MAGIC "scrcpy-list-cache\n"
+#define MAGIC_LEN (sizeof(SC_LIST_CACHE_MAGIC) - 1)
+
+char *
+sc_list_cache_get_path(const char *dir, uint64_t key) {
+    char *path;
+    int r = asprintf(&path, "%s%clist-%016" PRIx64 ".txt", dir,
+                     SC_PATH_SEPARATOR, key);
+    if (r == -1) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    return path;
+}
+
+bool
+sc_list_cache_print(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        // Not an error, the result may not be cached yet
+        return false;
+    }
+
+    char chunk[4096];
+    size_t r = fread(chunk, 1, MAGIC_LEN, file);
+    if (r != MAGIC_LEN || memcmp(chunk, SC_LIST_CACHE_MAGIC, MAGIC_LEN)) {
+        LOGW("Invalid list cache: %s", path);
+        fclose(file);
+        return false;
+    }
+
+    while ((r = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        fwrite(chunk, 1, r, stdout);
+    }
+
+    bool ok = !ferror(file);
+    fclose(file);
+    fflush(stdout);
+
+    if (!ok) {
+        // The beginning of the result may have been printed already
+        LOGE("Could not read list cache: %s", path);
+        return false;
+    }
+
+    LOGD("List result read from cache: %s", path);
+    return true;
+}
+
+bool
+sc_list_cache_save(const char *path, const char *data, size_t len) {
+    // Several instances may write the cache concurrently, so the temporary
+    // file must be unique
+    struct sc_rand rand;
+    sc_rand_init(&rand);
+
+    char *tmp_path;
+    int r = asprintf(&tmp_path, "%s.%08" PRIx32 ".tmp", path,
+                     sc_rand_u32(&rand));
+    if (r == -1) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = false;
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file) {
+        LOGW("Could not open list cache: %s", tmp_path);
+        goto end;
+    }
+
+    bool written = fwrite(SC_LIST_CACHE_MAGIC, 1, MAGIC_LEN, file) == MAGIC_LEN
+                && fwrite(data, 1, len, file) == len;
+
+    if (fclose(file) || !written) {
+        LOGW("Could not write list cache: %s", tmp_path);
+        remove(tmp_path);
+        goto end;
+    }
+
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows
+    remove(path);
+#endif
+    if (rename(tmp_path, path)) {
+        LOGW("Could not rename list cache to %s", path);
+        remove(tmp_path);
+        goto end;
+    }
+
+    ok = true;
+
+end:
+    free(tmp_path);
+    return ok;
+}
@@ -0,0 +1,43 @@
+#ifndef SC_LIST_CACHE_H
+#define SC_LIST_CACHE_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Cache of the --list-* results (the server output), so that repeated queries
+ * do not start the server on the device
+ *
+ * Each result is stored in its own file in the cache directory, named by a
+ * key derived from the device build fingerprint and the server parameters
+ * (including the scrcpy version). The results remain valid until the device
+ * is updated (its build fingerprint changes).
+ */
+
+/**
+ * Return the path of the cache file for the key, to be freed by the caller
+ */
+char *
+sc_list_cache_get_path(const char *dir, uint64_t key);
+
+/**
+ * Print the cached result to stdout
+ *
+ * Return false if the file does not exist or is invalid (nothing is printed).
+ */
+bool
+sc_list_cache_print(const char *path);
+
+/**
+ * Write a result to a cache file
+ *
+ * The file is replaced atomically, so that concurrent readers never read a
+ * partial result.
+ */
+bool
+sc_list_cache_save(const char *path, const char *data, size_t len);
+
+#endif
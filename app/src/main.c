@@ -4,9 +4,6 @@
 #include <stdbool.h>
 #include <unistd.h>
 #include <libavformat/avformat.h>
-#ifdef HAVE_V4L2
-# include <libavdevice/avdevice.h>
-#endif
 #define SDL_MAIN_HANDLED // avoid link error on Linux Windows Subsystem
 #include <SDL2/SDL.h>
 
@@ -16,7 +13,10 @@
 #include "usb/scrcpy_otg.h"
 #include "util/log.h"
 #include "util/net.h"
+#include "util/thread.h"
+#include "util/trace.h"
 #include "version.h"
+#include "wall.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -55,6 +55,12 @@ main_scrcpy(int argc, char *argv[]) {
 
     sc_set_log_level(args.opts.log_level);
 
+    struct sc_thread_config thread_config = {
+        .realtime = args.opts.realtime_threads,
+        .cpu_mask = args.opts.cpu_affinity,
+    };
+    sc_thread_configure(&thread_config);
+
     if (args.help) {
         scrcpy_print_usage(argv[0]);
         ret = SCRCPY_EXIT_SUCCESS;
@@ -71,26 +77,29 @@ main_scrcpy(int argc, char *argv[]) {
     av_register_all();
 #endif
 
-#ifdef HAVE_V4L2
-    if (args.opts.v4l2_device) {
-        avdevice_register_all();
-    }
-#endif
-
     if (!net_init()) {
         ret = SCRCPY_EXIT_FAILURE;
         goto end;
     }
 
     sc_log_configure();
+    sc_trace_init();
 
+    if (args.opts.wall) {
+        ret = scrcpy_wall(&args.opts);
+    } else {
 #ifdef HAVE_USB
-    ret = args.opts.otg ? scrcpy_otg(&args.opts) : scrcpy(&args.opts);
+        ret = args.opts.otg ? scrcpy_otg(&args.opts) : scrcpy(&args.opts);
 #else
-    ret = scrcpy(&args.opts);
+        ret = scrcpy(&args.opts);
 #endif
+    }
+
+    sc_trace_destroy();
 
 end:
+    sc_log_cleanup();
+
     if (args.pause_on_exit == SC_PAUSE_ON_EXIT_TRUE ||
             (args.pause_on_exit == SC_PAUSE_ON_EXIT_IF_ERROR &&
                 ret != SCRCPY_EXIT_SUCCESS)) {
@@ -73,6 +73,7 @@ sc_mouse_processor_process_mouse_motion(struct sc_mouse_processor *mp,
             .position = event->position,
             .pressure = 1.f,
             .buttons = convert_mouse_buttons(event->buttons_state),
+            .timestamp = event->timestamp,
         },
     };
 
@@ -95,6 +96,7 @@ sc_mouse_processor_process_mouse_click(struct sc_mouse_processor *mp,
             .pressure = event->action == SC_ACTION_DOWN ? 1.f : 0.f,
             .action_button = convert_mouse_buttons(event->button),
             .buttons = convert_mouse_buttons(event->buttons_state),
+            .timestamp = event->timestamp,
         },
     };
 
@@ -136,6 +138,7 @@ sc_mouse_processor_process_touch(struct sc_mouse_processor *mp,
             .position = event->position,
             .pressure = event->pressure,
             .buttons = 0,
+            .timestamp = event->timestamp,
         },
     };
 
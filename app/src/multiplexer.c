@@ -0,0 +1,214 @@
+#include "multiplexer.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "util/binary.h"
+#include "util/log.h"
+
+#define SC_MULTIPLEXER_HEADER_LENGTH 5
+// Must match the device side
+#define SC_MULTIPLEXER_MAX_CHUNK_SIZE (1 << 16)
+
+bool
+sc_multiplexer_init(struct sc_multiplexer *mux, sc_socket socket,
+                    const bool enabled[SC_MULTIPLEXER_STREAM_COUNT]) {
+    for (unsigned i = 0; i < SC_MULTIPLEXER_STREAM_COUNT; ++i) {
+        mux->local[i] = SC_SOCKET_NONE;
+        mux->remote[i] = SC_SOCKET_NONE;
+    }
+
+    for (unsigned i = 0; i < SC_MULTIPLEXER_STREAM_COUNT; ++i) {
+        if (!enabled[i]) {
+            continue;
+        }
+
+        sc_socket pair[2];
+        if (!net_socketpair(pair)) {
+            LOGE("Could not create multiplexer socket pair");
+            goto error;
+        }
+
+        mux->local[i] = pair[0];
+        mux->remote[i] = pair[1];
+    }
+
+    mux->socket = socket;
+
+    return true;
+
+error:
+    for (unsigned i = 0; i < SC_MULTIPLEXER_STREAM_COUNT; ++i) {
+        if (mux->local[i] != SC_SOCKET_NONE) {
+            net_close(mux->local[i]);
+            net_close(mux->remote[i]);
+        }
+    }
+
+    return false;
+}
+
+void
+sc_multiplexer_destroy(struct sc_multiplexer *mux) {
+    // The remote sockets are owned by the caller
+    for (unsigned i = 0; i < SC_MULTIPLEXER_STREAM_COUNT; ++i) {
+        if (mux->local[i] != SC_SOCKET_NONE) {
+            net_close(mux->local[i]);
+        }
+    }
+
+    net_close(mux->socket);
+}
+
+sc_socket
+sc_multiplexer_get_socket(struct sc_multiplexer *mux,
+                          enum sc_multiplexer_stream stream) {
+    assert(stream < SC_MULTIPLEXER_STREAM_COUNT);
+    return mux->remote[stream];
+}
+
+static void
+sc_multiplexer_interrupt_streams(struct sc_multiplexer *mux) {
+    // Wake up the readers of the streams (they will receive EOF)
+    for (unsigned i = 0; i < SC_MULTIPLEXER_STREAM_COUNT; ++i) {
+        if (mux->local[i] != SC_SOCKET_NONE) {
+            net_interrupt(mux->local[i]);
+        }
+    }
+}
+
+static int
+run_multiplexer_recv(void *data) {
+    struct sc_multiplexer *mux = data;
+
+    sc_thread_apply_role(SC_THREAD_ROLE_DEMUXER);
+
+    uint8_t *buf = malloc(SC_MULTIPLEXER_MAX_CHUNK_SIZE);
+    if (!buf) {
+        LOG_OOM();
+        goto end;
+    }
+
+    // Many chunks are small (audio packets, device messages): read the
+    // headers through a buffer to avoid one recv() per header
+    struct sc_net_reader reader;
+    bool ok = sc_net_reader_init(&reader, mux->socket,
+                                 SC_MULTIPLEXER_MAX_CHUNK_SIZE);
+    if (!ok) {
+        free(buf);
+        goto end;
+    }
+
+    for (;;) {
+        uint8_t header[SC_MULTIPLEXER_HEADER_LENGTH];
+        ssize_t r = sc_net_reader_recv_all(&reader, header, sizeof(header));
+        if (r < (ssize_t) sizeof(header)) {
+            // End of stream
+            break;
+        }
+
+        uint8_t stream = header[0];
+        uint32_t len = sc_read32be(&header[1]);
+        if (stream >= SC_MULTIPLEXER_STREAM_COUNT
+                || mux->local[stream] == SC_SOCKET_NONE
+                || len > SC_MULTIPLEXER_MAX_CHUNK_SIZE) {
+            LOGE("Invalid multiplexed chunk (stream %" PRIu8 ", length %"
+                 PRIu32 ")", stream, len);
+            break;
+        }
+
+        r = sc_net_reader_recv_all(&reader, buf, len);
+        if (r < (ssize_t) len) {
+            break;
+        }
+
+        r = net_send_all(mux->local[stream], buf, len);
+        if (r < (ssize_t) len) {
+            // The stream is closed
+            break;
+        }
+    }
+
+    sc_net_reader_destroy(&reader);
+    free(buf);
+
+end:
+    sc_multiplexer_interrupt_streams(mux);
+    LOGD("Multiplexer receiver stopped");
+
+    return 0;
+}
+
+static int
+run_multiplexer_send(void *data) {
+    struct sc_multiplexer *mux = data;
+
+    sc_socket control_socket = mux->local[SC_MULTIPLEXER_STREAM_CONTROL];
+    assert(control_socket != SC_SOCKET_NONE);
+
+    // Control messages are small
+    uint8_t buf[SC_MULTIPLEXER_HEADER_LENGTH + 4096];
+    uint8_t *payload = &buf[SC_MULTIPLEXER_HEADER_LENGTH];
+
+    for (;;) {
+        ssize_t r = net_recv(control_socket, payload,
+                             sizeof(buf) - SC_MULTIPLEXER_HEADER_LENGTH);
+        if (r <= 0) {
+            break;
+        }
+
+        buf[0] = SC_MULTIPLEXER_STREAM_CONTROL;
+        sc_write32be(&buf[1], r);
+
+        size_t len = SC_MULTIPLEXER_HEADER_LENGTH + r;
+        if (net_send_all(mux->socket, buf, len) < (ssize_t) len) {
+            break;
+        }
+    }
+
+    // Also stop the receiver
+    net_interrupt(mux->socket);
+    LOGD("Multiplexer sender stopped");
+
+    return 0;
+}
+
+bool
+sc_multiplexer_start(struct sc_multiplexer *mux) {
+    LOGD("Starting multiplexer threads");
+
+    bool ok = sc_thread_create(&mux->recv_thread, run_multiplexer_recv,
+                               "scrcpy-mux-recv", mux);
+    if (!ok) {
+        LOGE("Could not start multiplexer receiver thread");
+        return false;
+    }
+
+    if (mux->local[SC_MULTIPLEXER_STREAM_CONTROL] != SC_SOCKET_NONE) {
+        ok = sc_thread_create(&mux->send_thread, run_multiplexer_send,
+                              "scrcpy-mux-send", mux);
+        if (!ok) {
+            LOGE("Could not start multiplexer sender thread");
+            sc_multiplexer_interrupt(mux);
+            sc_thread_join(&mux->recv_thread, NULL);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void
+sc_multiplexer_interrupt(struct sc_multiplexer *mux) {
+    net_interrupt(mux->socket);
+    sc_multiplexer_interrupt_streams(mux);
+}
+
+void
+sc_multiplexer_join(struct sc_multiplexer *mux) {
+    sc_thread_join(&mux->recv_thread, NULL);
+    if (mux->local[SC_MULTIPLEXER_STREAM_CONTROL] != SC_SOCKET_NONE) {
+        sc_thread_join(&mux->send_thread, NULL);
+    }
+}
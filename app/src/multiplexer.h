@@ -0,0 +1,79 @@
+#ifndef SC_MULTIPLEXER_H
+#define SC_MULTIPLEXER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+
+#include "util/net.h"
+#include "util/thread.h"
+
+/**
+ * Demultiplexer of the streams sent over a single socket (--multiplex)
+ *
+ * The device sends all the streams (video, audio, device messages and record
+ * video) over a single connection, each chunk being prefixed by a header:
+ *
+ *     stream id (1 byte) | length (4 bytes, big-endian) | payload
+ *
+ * The control messages are sent to the device the same way.
+ *
+ * Each stream is exposed as a separate (loopback) socket, so that the
+ * components reading or writing the streams are not aware of the
+ * multiplexing.
+ */
+
+enum sc_multiplexer_stream {
+    SC_MULTIPLEXER_STREAM_VIDEO,
+    SC_MULTIPLEXER_STREAM_AUDIO,
+    SC_MULTIPLEXER_STREAM_CONTROL,
+    SC_MULTIPLEXER_STREAM_RECORD_VIDEO,
+    SC_MULTIPLEXER_STREAM_COUNT,
+};
+
+struct sc_multiplexer {
+    sc_socket socket; // the multiplexed connection
+
+    // For each enabled stream, a pair of connected sockets: the first one is
+    // used by the multiplexer, the second one is exposed to the caller
+    sc_socket local[SC_MULTIPLEXER_STREAM_COUNT];
+    sc_socket remote[SC_MULTIPLEXER_STREAM_COUNT];
+
+    sc_thread recv_thread; // device to streams
+    sc_thread send_thread; // control stream to device
+};
+
+/**
+ * Initialize the multiplexer over `socket`
+ *
+ * `enabled` indicates, for each stream, whether it is transmitted.
+ *
+ * On success, the multiplexer owns `socket`, but the caller owns the sockets
+ * returned by sc_multiplexer_get_socket().
+ */
+bool
+sc_multiplexer_init(struct sc_multiplexer *mux, sc_socket socket,
+                    const bool enabled[SC_MULTIPLEXER_STREAM_COUNT]);
+
+void
+sc_multiplexer_destroy(struct sc_multiplexer *mux);
+
+/**
+ * Return the socket to use for the given stream (or SC_SOCKET_NONE if the
+ * stream is disabled)
+ */
+sc_socket
+sc_multiplexer_get_socket(struct sc_multiplexer *mux,
+                          enum sc_multiplexer_stream stream);
+
+bool
+sc_multiplexer_start(struct sc_multiplexer *mux);
+
+// Interrupt the multiplexed connection and the streams
+void
+sc_multiplexer_interrupt(struct sc_multiplexer *mux);
+
+void
+sc_multiplexer_join(struct sc_multiplexer *mux);
+
+#endif
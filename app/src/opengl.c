@@ -18,6 +18,48 @@ sc_opengl_init(struct sc_opengl *gl) {
     // optional
     gl->GenerateMipmap = SDL_GL_GetProcAddress("glGenerateMipmap");
 
+    // optional
+    gl->ActiveTexture = SDL_GL_GetProcAddress("glActiveTexture");
+    gl->PixelStorei = SDL_GL_GetProcAddress("glPixelStorei");
+    gl->TexSubImage2D = SDL_GL_GetProcAddress("glTexSubImage2D");
+    gl->GenBuffers = SDL_GL_GetProcAddress("glGenBuffers");
+    gl->DeleteBuffers = SDL_GL_GetProcAddress("glDeleteBuffers");
+    gl->BindBuffer = SDL_GL_GetProcAddress("glBindBuffer");
+    gl->BufferData = SDL_GL_GetProcAddress("glBufferData");
+    gl->MapBuffer = SDL_GL_GetProcAddress("glMapBuffer");
+    gl->UnmapBuffer = SDL_GL_GetProcAddress("glUnmapBuffer");
+
+    // optional
+    gl->GenTextures = SDL_GL_GetProcAddress("glGenTextures");
+    gl->DeleteTextures = SDL_GL_GetProcAddress("glDeleteTextures");
+    gl->BindTexture = SDL_GL_GetProcAddress("glBindTexture");
+    gl->TexImage2D = SDL_GL_GetProcAddress("glTexImage2D");
+    gl->GetIntegerv = SDL_GL_GetProcAddress("glGetIntegerv");
+    gl->Viewport = SDL_GL_GetProcAddress("glViewport");
+    gl->Begin = SDL_GL_GetProcAddress("glBegin");
+    gl->End = SDL_GL_GetProcAddress("glEnd");
+    gl->TexCoord2f = SDL_GL_GetProcAddress("glTexCoord2f");
+    gl->Vertex2f = SDL_GL_GetProcAddress("glVertex2f");
+    gl->CreateShader = SDL_GL_GetProcAddress("glCreateShader");
+    gl->DeleteShader = SDL_GL_GetProcAddress("glDeleteShader");
+    gl->ShaderSource = SDL_GL_GetProcAddress("glShaderSource");
+    gl->CompileShader = SDL_GL_GetProcAddress("glCompileShader");
+    gl->GetShaderiv = SDL_GL_GetProcAddress("glGetShaderiv");
+    gl->GetShaderInfoLog = SDL_GL_GetProcAddress("glGetShaderInfoLog");
+    gl->CreateProgram = SDL_GL_GetProcAddress("glCreateProgram");
+    gl->DeleteProgram = SDL_GL_GetProcAddress("glDeleteProgram");
+    gl->AttachShader = SDL_GL_GetProcAddress("glAttachShader");
+    gl->LinkProgram = SDL_GL_GetProcAddress("glLinkProgram");
+    gl->GetProgramiv = SDL_GL_GetProcAddress("glGetProgramiv");
+    gl->GetProgramInfoLog = SDL_GL_GetProcAddress("glGetProgramInfoLog");
+    gl->UseProgram = SDL_GL_GetProcAddress("glUseProgram");
+    gl->GetUniformLocation = SDL_GL_GetProcAddress("glGetUniformLocation");
+    gl->Uniform1i = SDL_GL_GetProcAddress("glUniform1i");
+    gl->Uniform1f = SDL_GL_GetProcAddress("glUniform1f");
+    gl->Uniform2f = SDL_GL_GetProcAddress("glUniform2f");
+    gl->Uniform3f = SDL_GL_GetProcAddress("glUniform3f");
+    gl->UniformMatrix3fv = SDL_GL_GetProcAddress("glUniformMatrix3fv");
+
     const char *version = (const char *) gl->GetString(GL_VERSION);
     assert(version);
     gl->version = version;
@@ -54,3 +96,34 @@ sc_opengl_version_at_least(struct sc_opengl *gl,
         || (gl->version_major == minver_major
          && gl->version_minor >= minver_minor);
 }
+
+bool
+sc_opengl_has_pbo(struct sc_opengl *gl) {
+    if (gl->is_opengles || !sc_opengl_version_at_least(gl, 2, 1, 0, 0)) {
+        // glMapBuffer() is not available in OpenGL ES
+        return false;
+    }
+
+    return gl->ActiveTexture && gl->PixelStorei && gl->TexSubImage2D
+        && gl->GenBuffers && gl->DeleteBuffers && gl->BindBuffer
+        && gl->BufferData && gl->MapBuffer && gl->UnmapBuffer;
+}
+
+bool
+sc_opengl_has_shaders(struct sc_opengl *gl) {
+    if (gl->is_opengles || !sc_opengl_version_at_least(gl, 2, 0, 0, 0)) {
+        // Immediate mode is not available in OpenGL ES
+        return false;
+    }
+
+    return gl->ActiveTexture && gl->PixelStorei && gl->TexParameteri
+        && gl->GenTextures && gl->DeleteTextures && gl->BindTexture
+        && gl->TexImage2D && gl->GetIntegerv && gl->Viewport && gl->Begin
+        && gl->End && gl->TexCoord2f && gl->Vertex2f && gl->CreateShader
+        && gl->DeleteShader && gl->ShaderSource && gl->CompileShader
+        && gl->GetShaderiv && gl->GetShaderInfoLog && gl->CreateProgram
+        && gl->DeleteProgram && gl->AttachShader && gl->LinkProgram
+        && gl->GetProgramiv && gl->GetProgramInfoLog && gl->UseProgram
+        && gl->GetUniformLocation && gl->Uniform1i && gl->Uniform1f
+        && gl->Uniform2f && gl->Uniform3f && gl->UniformMatrix3fv;
+}
@@ -23,6 +23,132 @@ struct sc_opengl {
 
     void
     (*GenerateMipmap)(GLenum target);
+
+    // Pixel buffer objects (optional, OpenGL 2.1+)
+    void
+    (*ActiveTexture)(GLenum texture);
+
+    void
+    (*PixelStorei)(GLenum pname, GLint param);
+
+    void
+    (*TexSubImage2D)(GLenum target, GLint level, GLint xoffset, GLint yoffset,
+                     GLsizei width, GLsizei height, GLenum format, GLenum type,
+                     const void *pixels);
+
+    void
+    (*GenBuffers)(GLsizei n, GLuint *buffers);
+
+    void
+    (*DeleteBuffers)(GLsizei n, const GLuint *buffers);
+
+    void
+    (*BindBuffer)(GLenum target, GLuint buffer);
+
+    void
+    (*BufferData)(GLenum target, GLsizeiptr size, const void *data,
+                  GLenum usage);
+
+    void *
+    (*MapBuffer)(GLenum target, GLenum access);
+
+    GLboolean
+    (*UnmapBuffer)(GLenum target);
+
+    // Textures and immediate mode drawing (OpenGL 1.1, used with shaders)
+    void
+    (*GenTextures)(GLsizei n, GLuint *textures);
+
+    void
+    (*DeleteTextures)(GLsizei n, const GLuint *textures);
+
+    void
+    (*BindTexture)(GLenum target, GLuint texture);
+
+    void
+    (*TexImage2D)(GLenum target, GLint level, GLint internalformat,
+                  GLsizei width, GLsizei height, GLint border, GLenum format,
+                  GLenum type, const void *pixels);
+
+    void
+    (*GetIntegerv)(GLenum pname, GLint *data);
+
+    void
+    (*Viewport)(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    void
+    (*Begin)(GLenum mode);
+
+    void
+    (*End)(void);
+
+    void
+    (*TexCoord2f)(GLfloat s, GLfloat t);
+
+    void
+    (*Vertex2f)(GLfloat x, GLfloat y);
+
+    // Shaders (optional, OpenGL 2.0+)
+    GLuint
+    (*CreateShader)(GLenum type);
+
+    void
+    (*DeleteShader)(GLuint shader);
+
+    void
+    (*ShaderSource)(GLuint shader, GLsizei count, const GLchar *const *string,
+                    const GLint *length);
+
+    void
+    (*CompileShader)(GLuint shader);
+
+    void
+    (*GetShaderiv)(GLuint shader, GLenum pname, GLint *params);
+
+    void
+    (*GetShaderInfoLog)(GLuint shader, GLsizei max_length, GLsizei *length,
+                        GLchar *info_log);
+
+    GLuint
+    (*CreateProgram)(void);
+
+    void
+    (*DeleteProgram)(GLuint program);
+
+    void
+    (*AttachShader)(GLuint program, GLuint shader);
+
+    void
+    (*LinkProgram)(GLuint program);
+
+    void
+    (*GetProgramiv)(GLuint program, GLenum pname, GLint *params);
+
+    void
+    (*GetProgramInfoLog)(GLuint program, GLsizei max_length, GLsizei *length,
+                         GLchar *info_log);
+
+    void
+    (*UseProgram)(GLuint program);
+
+    GLint
+    (*GetUniformLocation)(GLuint program, const GLchar *name);
+
+    void
+    (*Uniform1i)(GLint location, GLint v0);
+
+    void
+    (*Uniform1f)(GLint location, GLfloat v0);
+
+    void
+    (*Uniform2f)(GLint location, GLfloat v0, GLfloat v1);
+
+    void
+    (*Uniform3f)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+
+    void
+    (*UniformMatrix3fv)(GLint location, GLsizei count, GLboolean transpose,
+                        const GLfloat *value);
 };
 
 void
@@ -33,4 +159,14 @@ sc_opengl_version_at_least(struct sc_opengl *gl,
                            int minver_major, int minver_minor,
                            int minver_es_major, int minver_es_minor);
 
+// Tell whether all the functions required for pixel buffer objects are
+// available
+bool
+sc_opengl_has_pbo(struct sc_opengl *gl);
+
+// Tell whether all the functions required to render with custom shaders (in
+// a compatibility context) are available
+bool
+sc_opengl_has_shaders(struct sc_opengl *gl);
+
 #endif
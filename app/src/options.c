@@ -3,6 +3,7 @@
 const struct scrcpy_options scrcpy_options_default = {
     .serial = NULL,
     .crop = NULL,
+    .new_display = NULL,
     .record_filename = NULL,
     .window_title = NULL,
     .push_target = NULL,
@@ -10,11 +11,14 @@ const struct scrcpy_options scrcpy_options_default = {
     .video_codec_options = NULL,
     .audio_codec_options = NULL,
     .video_encoder = NULL,
+    .video_hwaccel = NULL,
     .audio_encoder = NULL,
     .camera_id = NULL,
     .camera_size = NULL,
     .camera_ar = NULL,
     .camera_fps = 0,
+    .pattern_size = NULL,
+    .pattern_fps = 0,
     .log_level = SC_LOG_LEVEL_INFO,
     .video_codec = SC_CODEC_H264,
     .audio_codec = SC_CODEC_OPUS,
@@ -23,6 +27,7 @@ const struct scrcpy_options scrcpy_options_default = {
     .record_format = SC_RECORD_FORMAT_AUTO,
     .keyboard_input_mode = SC_KEYBOARD_INPUT_MODE_AUTO,
     .mouse_input_mode = SC_MOUSE_INPUT_MODE_AUTO,
+    .gamepad_input_mode = SC_GAMEPAD_INPUT_MODE_DISABLED,
     .camera_facing = SC_CAMERA_FACING_ANY,
     .port_range = {
         .first = DEFAULT_LOCAL_PORT_RANGE_FIRST,
@@ -30,14 +35,65 @@ const struct scrcpy_options scrcpy_options_default = {
     },
     .tunnel_host = 0,
     .tunnel_port = 0,
+    .server_idle_timeout = 0,
+    .shutdown_timeout = SC_TICK_FROM_SEC(1),
+    .screen_stability_delay = 0,
+    .frame_hash_interval = 1,
+    .socket_buffer_size = 0,
+    .multiplex = false,
+    .video_reconnect = false,
+    .video_pacing = false,
+    .direct_port = 0,
+    .direct_udp = false,
+    .benchmark_startup = false,
+    .thumbnail_decoding = false,
+    .wall = NULL,
+    .wall_preview_interval = 0,
+    .wall_background_fps = 0,
     .shortcut_mods = {
         .data = {SC_SHORTCUT_MOD_LALT, SC_SHORTCUT_MOD_LSUPER},
         .count = 2,
     },
     .max_size = 0,
     .video_bit_rate = 0,
+    .adaptive_bit_rate = false,
+    .adaptive_size = false,
+    .record_video_bit_rate = 0,
+    .record_video_source = SC_VIDEO_SOURCE_DISPLAY,
+    .record_fragmented = false,
+    .record_low_latency = false,
+    .record_queue_limit = 0,
+    .record_write_buffer = 0,
+    .record_segment_duration = 0,
+    .record_segment_count = 0,
+    .record_thumbnails_filename = NULL,
+    .replay_buffer_duration = 0,
+    .replay_filename = NULL,
+    .screenshot_filename = NULL,
+    .replay_format = SC_RECORD_FORMAT_AUTO,
+    .restream_url = NULL,
+    .restream_video_encoder = NULL,
+    .record_upload_url = NULL,
+    .restream_format = SC_RESTREAM_FORMAT_MPEGTS,
     .audio_bit_rate = 0,
+    .audio_sample_rate = SC_AUDIO_SAMPLE_RATE_DEFAULT,
+    .audio_channels = SC_AUDIO_CHANNELS_DEFAULT,
+    .audio_read_size = 0,
+    .audio_volume = 100,
     .max_fps = 0,
+    .video_repeat_delay = -1,
+    .video_latency_profile = SC_VIDEO_LATENCY_PROFILE_DEFAULT,
+    .video_intra_refresh = false,
+    .video_hdr = false,
+    .square_video = false,
+    .gpu_downscale = false,
+    .video_masks = NULL,
+    .adaptive_fps = false,
+    .thermal_governor = false,
+    .realtime_threads = false,
+    .cpu_affinity = 0,
+    .video_decoder_threading = SC_VIDEO_DECODER_THREADING_SLICE,
+    .video_decoder_threads = 1,
     .lock_video_orientation = SC_LOCK_VIDEO_ORIENTATION_UNLOCKED,
     .display_orientation = SC_ORIENTATION_0,
     .record_orientation = SC_ORIENTATION_0,
@@ -47,28 +103,44 @@ const struct scrcpy_options scrcpy_options_default = {
     .window_height = 0,
     .display_id = 0,
     .display_buffer = 0,
+    .display_pacing = 0,
     .audio_buffer = -1, // depends on the audio format,
+    .audio_buffer_min = 0,
+    .audio_buffer_max = 0,
+    .audio_delay = 0,
     .audio_output_buffer = SC_TICK_FROM_MS(5),
     .time_limit = 0,
+    .mouse_report_interval = SC_TICK_FROM_MS(4),
 #ifdef HAVE_V4L2
     .v4l2_device = NULL,
     .v4l2_buffer = 0,
+    .v4l2_format = SC_V4L2_FORMAT_YUV420P,
+    .v4l2_max_size = 0,
+#endif
+#ifdef HAVE_FRAME_SHARE
+    .frame_share = NULL,
 #endif
 #ifdef HAVE_USB
     .otg = false,
+    .otg_reconnect = false,
 #endif
     .show_touches = false,
     .fullscreen = false,
     .always_on_top = false,
     .control = true,
+    .control_compression = false,
+    .control_io_loop = false,
     .video_playback = true,
     .audio_playback = true,
+    .av_sync = false,
     .turn_screen_off = false,
     .key_inject_mode = SC_KEY_INJECT_MODE_MIXED,
     .window_borderless = false,
     .mipmaps = true,
+    .upscale_filter = SC_UPSCALE_FILTER_LINEAR,
     .stay_awake = false,
     .force_adb_forward = false,
+    .persistent_tunnel = false,
     .disable_screensaver = false,
     .forward_key_repeat = true,
     .forward_all_clicks = false,
@@ -82,13 +154,29 @@ const struct scrcpy_options scrcpy_options_default = {
     .select_usb = false,
     .cleanup = true,
     .start_fps_counter = false,
+    .input_overlay = false,
+    .perf_overlay = false,
+    .print_latency = false,
+    .stats_file = NULL,
+    .frame_hash_filename = NULL,
+    .devices_cache = NULL,
+    .stats_format = SC_STATS_FORMAT_JSON,
+    .input_record_filename = NULL,
+    .input_replay_filename = NULL,
+    .control_port = 0,
+    .dump_streams_dir = NULL,
+    .replay_streams_dir = NULL,
+    .replay_streams_max_speed = false,
     .power_on = true,
     .video = true,
     .audio = true,
     .require_audio = false,
     .kill_adb_on_close = false,
     .camera_high_speed = false,
+    .camera_low_latency = false,
+    .camera_lock_ae_af = false,
     .list = 0,
+    .list_cache = NULL,
 };
 
 enum sc_orientation
@@ -40,6 +40,35 @@ sc_record_format_is_audio_only(enum sc_record_format fmt) {
         || fmt == SC_RECORD_FORMAT_WAV;
 }
 
+enum sc_restream_format {
+    SC_RESTREAM_FORMAT_MPEGTS, // srt://, udp://
+    SC_RESTREAM_FORMAT_RTSP, // rtsp:// (published to an RTSP server)
+};
+
+enum sc_stats_format {
+    SC_STATS_FORMAT_JSON, // one JSON object per line, appended
+    SC_STATS_FORMAT_PROMETHEUS, // Prometheus text format, file rewritten
+};
+
+enum sc_upscale_filter {
+    SC_UPSCALE_FILTER_LINEAR, // bilinear filtering by the renderer
+    SC_UPSCALE_FILTER_LANCZOS, // Lanczos-2 shader, with anti-ringing
+};
+
+enum sc_video_latency_profile {
+    SC_VIDEO_LATENCY_PROFILE_DEFAULT,
+    SC_VIDEO_LATENCY_PROFILE_LOW,
+};
+
+enum sc_video_decoder_threading {
+    // Split each frame between the threads (no additional latency, but only
+    // effective if the encoder produces several slices, tiles or WPP rows)
+    SC_VIDEO_DECODER_THREADING_SLICE,
+    // Decode several frames in parallel (one additional frame of latency per
+    // additional thread)
+    SC_VIDEO_DECODER_THREADING_FRAME,
+};
+
 enum sc_codec {
     SC_CODEC_H264,
     SC_CODEC_H265,
@@ -48,11 +77,13 @@ enum sc_codec {
     SC_CODEC_AAC,
     SC_CODEC_FLAC,
     SC_CODEC_RAW,
+    SC_CODEC_AUTO, // video only: selected by the server
 };
 
 enum sc_video_source {
     SC_VIDEO_SOURCE_DISPLAY,
     SC_VIDEO_SOURCE_CAMERA,
+    SC_VIDEO_SOURCE_PATTERN, // synthetic test pattern, for load testing
 };
 
 enum sc_audio_source {
@@ -61,6 +92,12 @@ enum sc_audio_source {
     SC_AUDIO_SOURCE_MIC,
 };
 
+enum sc_v4l2_format {
+    SC_V4L2_FORMAT_YUV420P,
+    SC_V4L2_FORMAT_NV12,
+    SC_V4L2_FORMAT_YUYV,
+};
+
 enum sc_camera_facing {
     SC_CAMERA_FACING_ANY,
     SC_CAMERA_FACING_FRONT,
@@ -155,6 +192,11 @@ enum sc_mouse_input_mode {
     SC_MOUSE_INPUT_MODE_AOA,
 };
 
+enum sc_gamepad_input_mode {
+    SC_GAMEPAD_INPUT_MODE_DISABLED,
+    SC_GAMEPAD_INPUT_MODE_UHID,
+};
+
 enum sc_key_inject_mode {
     // Inject special keys, letters and space as key events.
     // Inject numbers and punctuation as text events.
@@ -192,9 +234,13 @@ struct sc_port_range {
 
 #define SC_WINDOW_POSITION_UNDEFINED (-0x8000)
 
+#define SC_AUDIO_SAMPLE_RATE_DEFAULT 48000
+#define SC_AUDIO_CHANNELS_DEFAULT 2
+
 struct scrcpy_options {
     const char *serial;
     const char *crop;
+    const char *new_display; // NULL to mirror an existing display
     const char *record_filename;
     const char *window_title;
     const char *push_target;
@@ -202,11 +248,14 @@ struct scrcpy_options {
     const char *video_codec_options;
     const char *audio_codec_options;
     const char *video_encoder;
+    const char *video_hwaccel;
     const char *audio_encoder;
     const char *camera_id;
     const char *camera_size;
     const char *camera_ar;
     uint16_t camera_fps;
+    const char *pattern_size;
+    uint16_t pattern_fps;
     enum sc_log_level log_level;
     enum sc_codec video_codec;
     enum sc_codec audio_codec;
@@ -215,15 +264,70 @@ struct scrcpy_options {
     enum sc_record_format record_format;
     enum sc_keyboard_input_mode keyboard_input_mode;
     enum sc_mouse_input_mode mouse_input_mode;
+    enum sc_gamepad_input_mode gamepad_input_mode;
     enum sc_camera_facing camera_facing;
     struct sc_port_range port_range;
     uint32_t tunnel_host;
     uint16_t tunnel_port;
+    sc_tick server_idle_timeout;
+    sc_tick shutdown_timeout;
+    sc_tick screen_stability_delay; // 0 to disable the detection
+    uint32_t frame_hash_interval; // hash one frame out of n
+    uint32_t socket_buffer_size; // 0 for the system default
+    bool multiplex;
+    bool video_reconnect;
+    bool video_pacing;
+    uint16_t direct_port;
+    bool direct_udp;
+    bool benchmark_startup;
+    bool thumbnail_decoding;
+    const char *wall; // comma-separated serials, NULL if disabled
+    sc_tick wall_preview_interval; // 0 to fully decode all the devices
+    uint16_t wall_background_fps; // 0 to not limit the devices not focused
     struct sc_shortcut_mods shortcut_mods;
     uint16_t max_size;
     uint32_t video_bit_rate;
+    bool adaptive_bit_rate;
+    bool adaptive_size;
+    uint32_t record_video_bit_rate; // 0 to record the mirrored video stream
+    // Source of the separate record video stream (display or camera)
+    enum sc_video_source record_video_source;
+    bool record_fragmented;
+    bool record_low_latency;
+    uint32_t record_queue_limit; // in bytes, 0 for no limit
+    uint32_t record_write_buffer; // in bytes, 0 to write synchronously
+    sc_tick record_segment_duration; // 0 to record a single file
+    uint16_t record_segment_count; // 0 to keep all the segments
+    const char *record_thumbnails_filename;
+    sc_tick replay_buffer_duration; // 0 to disable the instant replay
+    const char *replay_filename;
+    const char *screenshot_filename;
+    enum sc_record_format replay_format;
+    const char *restream_url; // NULL to disable restreaming
+    // NULL to restream the video as encoded by the device
+    const char *restream_video_encoder;
+    const char *record_upload_url; // NULL to disable the upload
+    enum sc_restream_format restream_format;
     uint32_t audio_bit_rate;
+    uint32_t audio_sample_rate;
+    uint8_t audio_channels; // 1 (mono) or 2 (stereo)
+    uint16_t audio_read_size; // in samples, 0 for the server default
+    uint16_t audio_volume; // in percent
     uint16_t max_fps;
+    sc_tick video_repeat_delay; // -1 for the device default
+    enum sc_video_latency_profile video_latency_profile;
+    bool video_intra_refresh;
+    bool video_hdr;
+    bool square_video;
+    bool gpu_downscale;
+    const char *video_masks;
+    bool adaptive_fps;
+    bool thermal_governor;
+    bool realtime_threads;
+    uint64_t cpu_affinity; // bit i for CPU i, 0 for no restriction
+    enum sc_video_decoder_threading video_decoder_threading;
+    // 0 for auto (in --wall mode, the total for all the devices)
+    uint16_t video_decoder_threads;
     enum sc_lock_video_orientation lock_video_orientation;
     enum sc_orientation display_orientation;
     enum sc_orientation record_orientation;
@@ -233,28 +337,45 @@ struct scrcpy_options {
     uint16_t window_height;
     uint32_t display_id;
     sc_tick display_buffer;
+    sc_tick display_pacing;
     sc_tick audio_buffer;
+    // Bounds of the adaptive audio buffer (both 0 if disabled)
+    sc_tick audio_buffer_min;
+    sc_tick audio_buffer_max;
+    sc_tick audio_delay;
     sc_tick audio_output_buffer;
     sc_tick time_limit;
+    sc_tick mouse_report_interval; // 0 to report every UHID/AOA mouse motion
 #ifdef HAVE_V4L2
     const char *v4l2_device;
     sc_tick v4l2_buffer;
+    enum sc_v4l2_format v4l2_format;
+    uint16_t v4l2_max_size;
+#endif
+#ifdef HAVE_FRAME_SHARE
+    const char *frame_share; // shared memory object name, NULL to disable
 #endif
 #ifdef HAVE_USB
     bool otg;
+    bool otg_reconnect;
 #endif
     bool show_touches;
     bool fullscreen;
     bool always_on_top;
     bool control;
+    bool control_compression;
+    bool control_io_loop;
     bool video_playback;
     bool audio_playback;
+    bool av_sync;
     bool turn_screen_off;
     enum sc_key_inject_mode key_inject_mode;
     bool window_borderless;
     bool mipmaps;
+    enum sc_upscale_filter upscale_filter;
     bool stay_awake;
     bool force_adb_forward;
+    bool persistent_tunnel;
     bool disable_screensaver;
     bool forward_key_repeat;
     bool forward_all_clicks;
@@ -268,17 +389,33 @@ struct scrcpy_options {
     bool select_tcpip;
     bool cleanup;
     bool start_fps_counter;
+    bool input_overlay;
+    bool perf_overlay;
+    bool print_latency;
+    const char *stats_file;
+    const char *frame_hash_filename;
+    const char *devices_cache;
+    enum sc_stats_format stats_format;
+    const char *input_record_filename;
+    const char *input_replay_filename;
+    uint16_t control_port; // 0 to disable the control server
+    const char *dump_streams_dir;
+    const char *replay_streams_dir;
+    bool replay_streams_max_speed;
     bool power_on;
     bool video;
     bool audio;
     bool require_audio;
     bool kill_adb_on_close;
     bool camera_high_speed;
+    bool camera_low_latency;
+    bool camera_lock_ae_af;
 #define SC_OPTION_LIST_ENCODERS 0x1
 #define SC_OPTION_LIST_DISPLAYS 0x2
 #define SC_OPTION_LIST_CAMERAS 0x4
 #define SC_OPTION_LIST_CAMERA_SIZES 0x8
     uint8_t list;
+    const char *list_cache; // NULL to disable the cache of the --list-* results
 };
 
 extern const struct scrcpy_options scrcpy_options_default;
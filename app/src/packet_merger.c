@@ -3,13 +3,24 @@
 #include "util/log.h"
 
 void
-sc_packet_merger_init(struct sc_packet_merger *merger) {
+sc_packet_merger_init(struct sc_packet_merger *merger, struct sc_stats *stats) {
     merger->config = NULL;
+    merger->stats = stats;
+}
+
+static void
+sc_packet_merger_free_config(struct sc_packet_merger *merger) {
+    if (merger->config) {
+        av_free(merger->config);
+        merger->config = NULL;
+        sc_stats_add(merger->stats, SC_STAT_MEM_PACKET_MERGER_BYTES,
+                     -(int64_t) merger->config_size);
+    }
 }
 
 void
 sc_packet_merger_destroy(struct sc_packet_merger *merger) {
-    free(merger->config);
+    sc_packet_merger_free_config(merger);
 }
 
 bool
@@ -17,9 +28,9 @@ sc_packet_merger_merge(struct sc_packet_merger *merger, AVPacket *packet) {
     bool is_config = packet->pts == AV_NOPTS_VALUE;
 
     if (is_config) {
-        free(merger->config);
+        sc_packet_merger_free_config(merger);
 
-        merger->config = malloc(packet->size);
+        merger->config = av_malloc(packet->size);
         if (!merger->config) {
             LOG_OOM();
             return false;
@@ -27,22 +38,60 @@ sc_packet_merger_merge(struct sc_packet_merger *merger, AVPacket *packet) {
 
         memcpy(merger->config, packet->data, packet->size);
         merger->config_size = packet->size;
+        sc_stats_add(merger->stats, SC_STAT_MEM_PACKET_MERGER_BYTES,
+                     merger->config_size);
     } else if (merger->config) {
-        size_t config_size = merger->config_size;
-        size_t media_size = packet->size;
-
-        if (av_grow_packet(packet, config_size)) {
+        // On success, the packet takes ownership of the config data
+        int r = av_packet_add_side_data(packet, AV_PKT_DATA_NEW_EXTRADATA,
+                                        merger->config, merger->config_size);
+        if (r < 0) {
             LOG_OOM();
             return false;
         }
 
-        memmove(packet->data + config_size, packet->data, media_size);
-        memcpy(packet->data, merger->config, config_size);
-
-        free(merger->config);
         merger->config = NULL;
         // merger->size is meaningless when merger->config is NULL
+        sc_stats_add(merger->stats, SC_STAT_MEM_PACKET_MERGER_BYTES,
+                     -(int64_t) merger->config_size);
     }
 
     return true;
 }
+
+bool
+sc_packet_merger_inline_config(AVPacket *packet) {
+#ifdef SCRCPY_LAVC_HAS_SIDE_DATA_SIZE_T
+    size_t config_size;
+#else
+    int config_size;
+#endif
+    uint8_t *config =
+        av_packet_get_side_data(packet, AV_PKT_DATA_NEW_EXTRADATA,
+                                &config_size);
+    if (!config) {
+        // nothing to do
+        return true;
+    }
+
+    // The packet data may be shared with other consumers, so it must not be
+    // modified in place: allocate a new buffer
+    size_t size = config_size + packet->size;
+    AVBufferRef *buf = av_buffer_alloc(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!buf) {
+        LOG_OOM();
+        return false;
+    }
+
+    memcpy(buf->data, config, config_size);
+    memcpy(buf->data + config_size, packet->data, packet->size);
+    memset(buf->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    av_buffer_unref(&packet->buf);
+    packet->buf = buf;
+    packet->data = buf->data;
+    packet->size = size;
+
+    av_packet_free_side_data(packet);
+
+    return true;
+}
@@ -7,26 +7,38 @@
 #include <stdint.h>
 #include <libavcodec/avcodec.h>
 
+#include "stats.h"
+
 /**
  * Config packets (containing the SPS/PPS) are sent in-band. A new config
  * packet is sent whenever a new encoding session is started (on start and on
  * device orientation change).
  *
  * Every time a config packet is received, it must be sent alone (for recorder
- * extradata), then concatenated to the next media packet (for correct decoding
- * and recording).
+ * extradata), then provided along with the next media packet (for correct
+ * decoding and recording).
+ *
+ * This helper reads every input packet and attaches the config packet payload
+ * to the media packet which immediately follows a config packet, as
+ * AV_PKT_DATA_NEW_EXTRADATA side data (so that the media packet payload, which
+ * is typically a big keyframe, is never copied).
  *
- * This helper reads every input packet and modifies each media packet which
- * immediately follows a config packet to prepend the config packet payload.
+ * The decoders handle the side data directly. Consumers which require the
+ * config in-band (e.g. the recorder) may call
+ * sc_packet_merger_inline_config().
  */
 
 struct sc_packet_merger {
     uint8_t *config;
     size_t config_size;
+
+    // The pending config is reported to SC_STAT_MEM_PACKET_MERGER_BYTES
+    struct sc_stats *stats; // may be NULL
 };
 
+// The stats may be NULL
 void
-sc_packet_merger_init(struct sc_packet_merger *merger);
+sc_packet_merger_init(struct sc_packet_merger *merger, struct sc_stats *stats);
 
 void
 sc_packet_merger_destroy(struct sc_packet_merger *merger);
@@ -34,10 +46,20 @@ sc_packet_merger_destroy(struct sc_packet_merger *merger);
 /**
  * If the packet is a config packet, then keep its data for later.
  * Otherwise (if the packet is a media packet), then if a config packet is
- * pending, prepend the config packet to this packet (so the packet is
- * modified!).
+ * pending, attach the config packet to this packet as side data (so the packet
+ * is modified!).
  */
 bool
 sc_packet_merger_merge(struct sc_packet_merger *merger, AVPacket *packet);
 
+/**
+ * If the packet has AV_PKT_DATA_NEW_EXTRADATA side data, then prepend it to
+ * the packet data (and remove the side data).
+ *
+ * The packet data is not modified in place (it may be shared), a new buffer
+ * is allocated.
+ */
+bool
+sc_packet_merger_inline_config(AVPacket *packet);
+
 #endif
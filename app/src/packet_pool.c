@@ -0,0 +1,145 @@
+#include "packet_pool.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+
+// Round up the buffer sizes to avoid to recreate the pool for every small
+// increase of the packet size
+#define SC_PACKET_POOL_ALIGN 4096
+
+#ifdef SCRCPY_LAVU_HAS_BUFFER_SIZE_T
+typedef size_t sc_buffer_size_t;
+#else
+typedef int sc_buffer_size_t;
+#endif
+
+// Opaque of an AVBufferPool, which may outlive the sc_packet_pool (and be
+// replaced by a new one) while some of its buffers are still referenced
+struct sc_packet_pool_opaque {
+    // Only accessed on allocation, when the AVBufferPool is the current one
+    struct sc_packet_pool *pool;
+    struct sc_stats *stats; // may be NULL
+    // Bytes allocated by this AVBufferPool (which keeps them until it is freed)
+    size_t allocated;
+};
+
+static AVBufferRef *
+sc_packet_pool_alloc(void *opaque, sc_buffer_size_t size) {
+    struct sc_packet_pool_opaque *po = opaque;
+
+    // Only called when no buffer could be reused
+    ++po->pool->misses;
+    AVBufferRef *buf = av_buffer_alloc(size);
+    if (buf) {
+        po->allocated += size;
+        sc_stats_add(po->stats, SC_STAT_MEM_PACKET_POOL_BYTES, size);
+    }
+    return buf;
+}
+
+static void
+sc_packet_pool_free(void *opaque) {
+    struct sc_packet_pool_opaque *po = opaque;
+
+    // Called once the AVBufferPool is uninitialized and all its buffers are
+    // released (possibly by another thread)
+    sc_stats_add(po->stats, SC_STAT_MEM_PACKET_POOL_BYTES,
+                 -(int64_t) po->allocated);
+    free(po);
+}
+
+void
+sc_packet_pool_init(struct sc_packet_pool *pool, struct sc_stats *stats) {
+    pool->pool = NULL;
+    pool->buffer_size = 0;
+    pool->hits = 0;
+    pool->misses = 0;
+    pool->stats = stats;
+}
+
+void
+sc_packet_pool_destroy(struct sc_packet_pool *pool) {
+    // The pool is actually freed once all its buffers are released
+    av_buffer_pool_uninit(&pool->pool);
+}
+
+static bool
+sc_packet_pool_reserve(struct sc_packet_pool *pool, size_t buffer_size) {
+    if (buffer_size <= pool->buffer_size) {
+        // nothing to do
+        return true;
+    }
+
+    // Grow by 1.5 to avoid to recreate the pool too often
+    size_t new_size = MAX(buffer_size, pool->buffer_size * 3 / 2);
+    new_size = (new_size + SC_PACKET_POOL_ALIGN - 1)
+             & ~(size_t) (SC_PACKET_POOL_ALIGN - 1);
+    if (new_size > INT_MAX) {
+        LOGE("Packet too big: %" SC_PRIsizet, buffer_size);
+        return false;
+    }
+
+    struct sc_packet_pool_opaque *po = malloc(sizeof(*po));
+    if (!po) {
+        LOG_OOM();
+        return false;
+    }
+
+    po->pool = pool;
+    po->stats = pool->stats;
+    po->allocated = 0;
+
+    AVBufferPool *new_pool =
+        av_buffer_pool_init2(new_size, po, sc_packet_pool_alloc,
+                             sc_packet_pool_free);
+    if (!new_pool) {
+        LOG_OOM();
+        free(po);
+        return false;
+    }
+
+    av_buffer_pool_uninit(&pool->pool);
+    pool->pool = new_pool;
+    pool->buffer_size = new_size;
+
+    return true;
+}
+
+bool
+sc_packet_pool_new_packet(struct sc_packet_pool *pool, AVPacket *packet,
+                          size_t size) {
+    assert(!packet->buf);
+
+    if (size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE) {
+        LOGE("Packet too big: %" SC_PRIsizet, size);
+        return false;
+    }
+
+    if (!sc_packet_pool_reserve(pool, size + AV_INPUT_BUFFER_PADDING_SIZE)) {
+        return false;
+    }
+
+    uint64_t misses = pool->misses;
+    AVBufferRef *buf = av_buffer_pool_get(pool->pool);
+    if (!buf) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (pool->misses == misses) {
+        ++pool->hits;
+    }
+
+    // The decoders require the padding to be zeroed
+    memset(buf->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+    packet->buf = buf;
+    packet->data = buf->data;
+    packet->size = size;
+
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef SC_PACKET_POOL_H
+#define SC_PACKET_POOL_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+
+#include "stats.h"
+
+/**
+ * Pool of packet buffers, to avoid an allocation for every received packet
+ *
+ * All the buffers of the pool have the same size, which is the high-water
+ * mark of the packet sizes requested so far (plus the input padding). When a
+ * bigger packet is requested, the pool is replaced by a new one with bigger
+ * buffers (the buffers still referenced are released to the old pool, which
+ * is freed once all of them are unreferenced).
+ *
+ * It must be used from a single thread.
+ *
+ * The bytes allocated by the pools (until they are freed) are reported to
+ * SC_STAT_MEM_PACKET_POOL_BYTES.
+ */
+struct sc_packet_pool {
+    AVBufferPool *pool;
+    size_t buffer_size; // including AV_INPUT_BUFFER_PADDING_SIZE
+
+    // Number of buffers reused from the pool
+    uint64_t hits;
+    // Number of buffers allocated
+    uint64_t misses;
+
+    struct sc_stats *stats; // may be NULL
+};
+
+// The stats may be NULL
+void
+sc_packet_pool_init(struct sc_packet_pool *pool, struct sc_stats *stats);
+
+void
+sc_packet_pool_destroy(struct sc_packet_pool *pool);
+
+/**
+ * Initialize an empty packet with a (uninitialized) payload of `size` bytes
+ *
+ * The packet must be empty (freshly allocated or unreferenced).
+ *
+ * This is equivalent to av_new_packet(), except that the buffer is taken
+ * from the pool.
+ */
+bool
+sc_packet_pool_new_packet(struct sc_packet_pool *pool, AVPacket *packet,
+                          size_t size);
+
+#endif
@@ -0,0 +1,126 @@
+#include "packet_spill.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+
+#include "util/log.h"
+
+// Only read back by the same process, so the native layout is fine
+struct sc_packet_spill_header {
+    int64_t pts;
+    int64_t dts;
+    int64_t duration;
+    int32_t flags;
+    int32_t stream_index;
+    int32_t size;
+};
+
+void
+sc_packet_spill_init(struct sc_packet_spill *spill) {
+    spill->file = NULL;
+    spill->read_offset = 0;
+    spill->write_offset = 0;
+    spill->count = 0;
+}
+
+void
+sc_packet_spill_destroy(struct sc_packet_spill *spill) {
+    if (spill->file) {
+        // A temporary file is removed automatically when it is closed
+        fclose(spill->file);
+    }
+}
+
+bool
+sc_packet_spill_push(struct sc_packet_spill *spill, const AVPacket *packet) {
+    if (!spill->file) {
+        spill->file = tmpfile();
+        if (!spill->file) {
+            LOGE("Could not create temporary file to spill packets");
+            return false;
+        }
+    }
+
+    assert(packet->size >= 0);
+    long record_size = sizeof(struct sc_packet_spill_header) + packet->size;
+    if (spill->write_offset > LONG_MAX - record_size) {
+        LOGE("Packet spill file too large");
+        return false;
+    }
+
+    struct sc_packet_spill_header header = {
+        .pts = packet->pts,
+        .dts = packet->dts,
+        .duration = packet->duration,
+        .flags = packet->flags,
+        .stream_index = packet->stream_index,
+        .size = packet->size,
+    };
+
+    // Always seek, reads and writes are interleaved on the same stream
+    if (fseek(spill->file, spill->write_offset, SEEK_SET)
+            || fwrite(&header, sizeof(header), 1, spill->file) != 1
+            || (packet->size
+                && fwrite(packet->data, packet->size, 1, spill->file) != 1)) {
+        LOGE("Could not write spilled packet");
+        return false;
+    }
+
+    spill->write_offset += record_size;
+    ++spill->count;
+    return true;
+}
+
+AVPacket *
+sc_packet_spill_pop(struct sc_packet_spill *spill) {
+    assert(spill->count);
+
+    struct sc_packet_spill_header header;
+    if (fseek(spill->file, spill->read_offset, SEEK_SET)
+            || fread(&header, sizeof(header), 1, spill->file) != 1) {
+        LOGE("Could not read spilled packet");
+        return NULL;
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    if (av_new_packet(packet, header.size)) {
+        LOG_OOM();
+        av_packet_free(&packet);
+        return NULL;
+    }
+
+    if (header.size
+            && fread(packet->data, header.size, 1, spill->file) != 1) {
+        LOGE("Could not read spilled packet");
+        av_packet_free(&packet);
+        return NULL;
+    }
+
+    packet->pts = header.pts;
+    packet->dts = header.dts;
+    packet->duration = header.duration;
+    packet->flags = header.flags;
+    packet->stream_index = header.stream_index;
+
+    spill->read_offset += sizeof(header) + header.size;
+    if (!--spill->count) {
+        // Empty, reuse the file from the beginning
+        spill->read_offset = 0;
+        spill->write_offset = 0;
+    }
+
+    return packet;
+}
+
+void
+sc_packet_spill_clear(struct sc_packet_spill *spill) {
+    spill->read_offset = 0;
+    spill->write_offset = 0;
+    spill->count = 0;
+}
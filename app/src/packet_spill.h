@@ -0,0 +1,54 @@
+#ifndef SC_PACKET_SPILL_H
+#define SC_PACKET_SPILL_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <libavcodec/avcodec.h>
+
+/**
+ * FIFO of packets stored in a temporary file.
+ *
+ * It is used to bound the memory used by a packet queue when its consumer
+ * falls behind (e.g. the recorder writing to a slow disk): once the memory
+ * limit is reached, the next packets are appended to the file, and read back
+ * in order.
+ *
+ * Whenever the spill becomes empty, the file is reused from the beginning, so
+ * it only grows as much as the maximum backlog.
+ *
+ * The side data of the packets are not stored.
+ */
+struct sc_packet_spill {
+    FILE *file; // created on the first push
+    long read_offset;
+    long write_offset;
+    size_t count; // number of packets in the spill
+};
+
+void
+sc_packet_spill_init(struct sc_packet_spill *spill);
+
+void
+sc_packet_spill_destroy(struct sc_packet_spill *spill);
+
+// The packet is copied, it is not modified
+bool
+sc_packet_spill_push(struct sc_packet_spill *spill, const AVPacket *packet);
+
+// Return a new packet (to be freed by av_packet_free()), or NULL on error
+AVPacket *
+sc_packet_spill_pop(struct sc_packet_spill *spill);
+
+// Discard all the packets
+void
+sc_packet_spill_clear(struct sc_packet_spill *spill);
+
+static inline bool
+sc_packet_spill_is_empty(const struct sc_packet_spill *spill) {
+    return !spill->count;
+}
+
+#endif
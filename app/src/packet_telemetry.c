@@ -0,0 +1,84 @@
+#include "packet_telemetry.h"
+
+#include <assert.h>
+
+// The PTS are expressed in microseconds
+#define SC_PACKET_TELEMETRY_WINDOW_DURATION 1000000 // 1 second
+
+void
+sc_packet_telemetry_init(struct sc_packet_telemetry *telemetry) {
+    telemetry->head = 0;
+    telemetry->count = 0;
+    telemetry->window_bytes = 0;
+    telemetry->has_last = false;
+    telemetry->jitter16 = 0;
+}
+
+static void
+sc_packet_telemetry_pop(struct sc_packet_telemetry *telemetry) {
+    assert(telemetry->count);
+    telemetry->window_bytes -= telemetry->window[telemetry->head].size;
+    telemetry->head = (telemetry->head + 1) % SC_PACKET_TELEMETRY_WINDOW;
+    --telemetry->count;
+}
+
+void
+sc_packet_telemetry_push(struct sc_packet_telemetry *telemetry, int64_t pts,
+                         size_t size, sc_tick arrival) {
+    if (telemetry->count == SC_PACKET_TELEMETRY_WINDOW) {
+        sc_packet_telemetry_pop(telemetry);
+    }
+
+    unsigned index = (telemetry->head + telemetry->count)
+                   % SC_PACKET_TELEMETRY_WINDOW;
+    telemetry->window[index].pts = pts;
+    telemetry->window[index].size = size;
+    telemetry->window_bytes += size;
+    ++telemetry->count;
+
+    // Keep the oldest packet at (or just before) 1 second before the newest
+    // one, it delimits the window
+    while (telemetry->count > 2) {
+        unsigned next = (telemetry->head + 1) % SC_PACKET_TELEMETRY_WINDOW;
+        if (pts - telemetry->window[next].pts
+                < SC_PACKET_TELEMETRY_WINDOW_DURATION) {
+            break;
+        }
+        sc_packet_telemetry_pop(telemetry);
+    }
+
+    if (telemetry->has_last) {
+        // RFC 3550 section 6.4.1: J += (|D| - J) / 16
+        sc_tick d = (arrival - telemetry->last_arrival)
+                  - SC_TICK_FROM_US(pts - telemetry->last_pts);
+        if (d < 0) {
+            d = -d;
+        }
+        telemetry->jitter16 += d - (telemetry->jitter16 + 8) / 16;
+    }
+
+    telemetry->has_last = true;
+    telemetry->last_pts = pts;
+    telemetry->last_arrival = arrival;
+}
+
+uint64_t
+sc_packet_telemetry_get_bitrate(const struct sc_packet_telemetry *telemetry) {
+    if (telemetry->count < 2) {
+        return 0;
+    }
+
+    unsigned last = (telemetry->head + telemetry->count - 1)
+                  % SC_PACKET_TELEMETRY_WINDOW;
+    int64_t duration = telemetry->window[last].pts
+                     - telemetry->window[telemetry->head].pts;
+    if (duration <= 0) {
+        return 0;
+    }
+
+    // The oldest packet only marks the start of the window: the bytes of the
+    // next packets were produced during the duration
+    uint64_t bytes = telemetry->window_bytes
+                   - telemetry->window[telemetry->head].size;
+    return bytes * 8 * 1000000 / duration;
+}
@@ -0,0 +1,57 @@
+#ifndef SC_PACKET_TELEMETRY_H
+#define SC_PACKET_TELEMETRY_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util/tick.h"
+
+// Maximum number of packets in the bitrate window (enough for 1 second of
+// video at 240 fps)
+#define SC_PACKET_TELEMETRY_WINDOW 256
+
+/**
+ * Metrics of the media packets of a stream, computed from their PTS (the
+ * capture time on the device, in microseconds) and their arrival time:
+ *  - the encoded bitrate over the last second of media time, independent of
+ *    the transport burstiness (to compare with the requested bit rate);
+ *  - the interarrival jitter, as defined by RFC 3550: the smoothed variation
+ *    of the transit time (arrival time minus PTS) between consecutive
+ *    packets.
+ */
+struct sc_packet_telemetry {
+    struct {
+        int64_t pts;
+        uint32_t size;
+    } window[SC_PACKET_TELEMETRY_WINDOW];
+    unsigned head; // index of the oldest packet
+    unsigned count;
+    uint64_t window_bytes;
+
+    bool has_last;
+    int64_t last_pts;
+    sc_tick last_arrival;
+    sc_tick jitter16; // jitter * 16, to smooth with integers
+};
+
+void
+sc_packet_telemetry_init(struct sc_packet_telemetry *telemetry);
+
+// Push a media packet (not a config packet); the PTS must be increasing
+void
+sc_packet_telemetry_push(struct sc_packet_telemetry *telemetry, int64_t pts,
+                         size_t size, sc_tick arrival);
+
+// Return the encoded bitrate (bits/s), or 0 if unknown
+uint64_t
+sc_packet_telemetry_get_bitrate(const struct sc_packet_telemetry *telemetry);
+
+static inline sc_tick
+sc_packet_telemetry_get_jitter(const struct sc_packet_telemetry *telemetry) {
+    return telemetry->jitter16 / 16;
+}
+
+#endif
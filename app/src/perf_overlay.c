@@ -0,0 +1,310 @@
+#include "perf_overlay.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SC_PERF_OVERLAY_WINDOW SC_TICK_FROM_SEC(1)
+
+// Upper bounds of the histogram buckets, in milliseconds (the stalls of 200 ms
+// or more are counted in the last bucket)
+static const unsigned bucket_bounds_ms[SC_PERF_OVERLAY_BUCKETS - 1] = {
+    8, 16, 24, 33, 50, 100, 200,
+};
+
+static const char *const bucket_labels[SC_PERF_OVERLAY_BUCKETS] = {
+    "8", "16", "24", "33", "50", "100", "200", "+",
+};
+
+#define GLYPH_W 3
+#define GLYPH_H 5
+// including the spacing
+#define CHAR_W (GLYPH_W + 1)
+#define LINE_H (GLYPH_H + 2)
+
+// 3x5 pixels glyphs, one row per byte (the 3 lowest bits, left to right)
+static const uint8_t glyph_digits[10][GLYPH_H] = {
+    {7, 5, 5, 5, 7}, {2, 6, 2, 2, 7}, {7, 1, 7, 4, 7}, {7, 1, 7, 1, 7},
+    {5, 5, 7, 1, 1}, {7, 4, 7, 1, 7}, {7, 4, 7, 5, 7}, {7, 1, 1, 2, 2},
+    {7, 5, 7, 5, 7}, {7, 5, 7, 1, 7},
+};
+
+static const uint8_t glyph_letters[26][GLYPH_H] = {
+    {2, 5, 7, 5, 5}, {6, 5, 6, 5, 6}, {3, 4, 4, 4, 3}, {6, 5, 5, 5, 6},
+    {7, 4, 6, 4, 7}, {7, 4, 6, 4, 4}, {3, 4, 5, 5, 3}, {5, 5, 7, 5, 5},
+    {7, 2, 2, 2, 7}, {1, 1, 1, 5, 2}, {5, 5, 6, 5, 5}, {4, 4, 4, 4, 7},
+    {5, 7, 7, 5, 5}, {6, 5, 5, 5, 5}, {2, 5, 5, 5, 2}, {6, 5, 6, 4, 4},
+    {2, 5, 5, 7, 3}, {6, 5, 6, 5, 5}, {3, 4, 2, 1, 6}, {7, 2, 2, 2, 2},
+    {5, 5, 5, 5, 7}, {5, 5, 5, 5, 2}, {5, 5, 7, 7, 5}, {5, 5, 2, 5, 5},
+    {5, 5, 2, 2, 2}, {7, 1, 2, 4, 7},
+};
+
+static const uint8_t *
+get_glyph(char c) {
+    static const uint8_t dot[GLYPH_H] = {0, 0, 0, 0, 2};
+    static const uint8_t slash[GLYPH_H] = {1, 1, 2, 4, 4};
+    static const uint8_t dash[GLYPH_H] = {0, 0, 7, 0, 0};
+    static const uint8_t plus[GLYPH_H] = {0, 2, 7, 2, 0};
+
+    if (c >= '0' && c <= '9') {
+        return glyph_digits[c - '0'];
+    }
+    if (c >= 'a' && c <= 'z') {
+        c -= 'a' - 'A';
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return glyph_letters[c - 'A'];
+    }
+    switch (c) {
+        case '.':
+            return dot;
+        case '/':
+            return slash;
+        case '-':
+            return dash;
+        case '+':
+            return plus;
+        default:
+            // space and unsupported characters
+            return NULL;
+    }
+}
+
+static void
+draw_text(SDL_Renderer *renderer, int x, int y, unsigned scale,
+          const char *text) {
+    for (const char *p = text; *p; ++p, x += CHAR_W * scale) {
+        const uint8_t *glyph = get_glyph(*p);
+        if (!glyph) {
+            continue;
+        }
+
+        SDL_Rect rects[GLYPH_W * GLYPH_H];
+        int count = 0;
+        for (int row = 0; row < GLYPH_H; ++row) {
+            for (int col = 0; col < GLYPH_W; ++col) {
+                if (glyph[row] & (4 >> col)) {
+                    rects[count++] = (SDL_Rect) {
+                        .x = x + col * scale,
+                        .y = y + row * scale,
+                        .w = scale,
+                        .h = scale,
+                    };
+                }
+            }
+        }
+        SDL_RenderFillRects(renderer, rects, count);
+    }
+}
+
+static int64_t
+get_stat(const struct sc_perf_overlay *overlay, enum sc_stat stat) {
+    return overlay->stats ? sc_stats_get(overlay->stats, stat) : 0;
+}
+
+void
+sc_perf_overlay_init(struct sc_perf_overlay *overlay, struct sc_stats *stats) {
+    overlay->stats = stats;
+    overlay->window_start = sc_tick_now();
+    overlay->last_frame = 0;
+
+    for (unsigned i = 0; i < SC_PERF_OVERLAY_BUCKETS; ++i) {
+        overlay->histogram[i] = 0;
+        overlay->shown.histogram[i] = 0;
+    }
+    overlay->frames = 0;
+    overlay->max_interval = 0;
+
+    overlay->last_video_bytes = get_stat(overlay, SC_STAT_VIDEO_BYTES);
+    overlay->last_skipped = get_stat(overlay, SC_STAT_FRAMES_SKIPPED);
+    overlay->last_decode_time_us =
+        get_stat(overlay, SC_STAT_VIDEO_DECODE_TIME_US);
+    overlay->last_decoded = get_stat(overlay, SC_STAT_VIDEO_PACKETS_DECODED);
+
+    overlay->shown.fps = 0;
+    overlay->shown.max_interval = 0;
+    overlay->shown.dropped = 0;
+    overlay->shown.bitrate = 0;
+    overlay->shown.decode_avg_us = -1;
+}
+
+static void
+sc_perf_overlay_end_window(struct sc_perf_overlay *overlay, sc_tick now) {
+    sc_tick elapsed = now - overlay->window_start;
+    assert(elapsed > 0);
+
+    for (unsigned i = 0; i < SC_PERF_OVERLAY_BUCKETS; ++i) {
+        overlay->shown.histogram[i] = overlay->histogram[i];
+        overlay->histogram[i] = 0;
+    }
+    overlay->shown.fps = overlay->frames * SC_TICK_FREQ / elapsed;
+    overlay->shown.max_interval = overlay->max_interval;
+    overlay->frames = 0;
+    overlay->max_interval = 0;
+
+    int64_t video_bytes = get_stat(overlay, SC_STAT_VIDEO_BYTES);
+    int64_t skipped = get_stat(overlay, SC_STAT_FRAMES_SKIPPED);
+    int64_t decode_time_us = get_stat(overlay, SC_STAT_VIDEO_DECODE_TIME_US);
+    int64_t decoded = get_stat(overlay, SC_STAT_VIDEO_PACKETS_DECODED);
+
+    overlay->shown.bitrate = (video_bytes - overlay->last_video_bytes) * 8
+                           * SC_TICK_FREQ / elapsed;
+    overlay->shown.dropped = skipped - overlay->last_skipped;
+    if (decoded > overlay->last_decoded) {
+        overlay->shown.decode_avg_us =
+            (decode_time_us - overlay->last_decode_time_us)
+                / (decoded - overlay->last_decoded);
+    } else {
+        overlay->shown.decode_avg_us = -1;
+    }
+
+    overlay->last_video_bytes = video_bytes;
+    overlay->last_skipped = skipped;
+    overlay->last_decode_time_us = decode_time_us;
+    overlay->last_decoded = decoded;
+
+    overlay->window_start = now;
+}
+
+void
+sc_perf_overlay_on_frame(struct sc_perf_overlay *overlay, sc_tick now) {
+    if (overlay->last_frame) {
+        sc_tick interval = now - overlay->last_frame;
+        unsigned interval_ms = SC_TICK_TO_MS(interval);
+        unsigned bucket = 0;
+        while (bucket < SC_PERF_OVERLAY_BUCKETS - 1
+                && interval_ms >= bucket_bounds_ms[bucket]) {
+            ++bucket;
+        }
+        ++overlay->histogram[bucket];
+        if (interval > overlay->max_interval) {
+            overlay->max_interval = interval;
+        }
+    }
+    overlay->last_frame = now;
+    ++overlay->frames;
+
+    if (now - overlay->window_start >= SC_PERF_OVERLAY_WINDOW) {
+        sc_perf_overlay_end_window(overlay, now);
+    }
+}
+
+static void
+format_bitrate(char *buf, size_t len, uint64_t bitrate) {
+    if (bitrate >= 1000000) {
+        snprintf(buf, len, "%" PRIu64 ".%" PRIu64 " MBPS", bitrate / 1000000,
+                 bitrate / 100000 % 10);
+    } else {
+        snprintf(buf, len, "%" PRIu64 " KBPS", bitrate / 1000);
+    }
+}
+
+void
+sc_perf_overlay_render(const struct sc_perf_overlay *overlay,
+                       SDL_Renderer *renderer, const SDL_Rect *clip) {
+    // Readable on large windows, but never larger than the content
+    unsigned scale = clip->w / 320;
+    if (scale < 1) {
+        scale = 1;
+    } else if (scale > 4) {
+        scale = 4;
+    }
+
+    char lines[5][64];
+    snprintf(lines[0], sizeof(lines[0]), "FPS %u  MAX %u MS  DROP %u",
+             overlay->shown.fps,
+             (unsigned) SC_TICK_TO_MS(overlay->shown.max_interval),
+             overlay->shown.dropped);
+    if (overlay->shown.decode_avg_us >= 0) {
+        int64_t us = overlay->shown.decode_avg_us;
+        snprintf(lines[1], sizeof(lines[1]), "DECODE %" PRIi64 ".%" PRIi64
+                 " MS", us / 1000, us / 100 % 10);
+    } else {
+        snprintf(lines[1], sizeof(lines[1]), "DECODE -");
+    }
+    format_bitrate(lines[2], sizeof(lines[2]), overlay->shown.bitrate);
+    // The queue depths are gauges, read live
+    snprintf(lines[3], sizeof(lines[3]), "QUEUE DISP %" PRIi64 " REC %" PRIi64
+             " CTRL %" PRIi64,
+             get_stat(overlay, SC_STAT_DISPLAY_BUFFER_QUEUE),
+             get_stat(overlay, SC_STAT_RECORDER_VIDEO_QUEUE),
+             get_stat(overlay, SC_STAT_CONTROLLER_QUEUE));
+    snprintf(lines[4], sizeof(lines[4]), "AUDIO %" PRIi64 " MS",
+             get_stat(overlay, SC_STAT_AUDIO_LATENCY_MS));
+
+    // Each histogram bar is as wide as its longest label
+    int bar_w = 3 * CHAR_W * scale;
+    int chart_h = 10 * LINE_H * scale / 2;
+    int margin = 2 * scale;
+
+    int text_w = 0;
+    for (unsigned i = 0; i < ARRAY_LEN(lines); ++i) {
+        int w = strlen(lines[i]) * CHAR_W * scale;
+        if (w > text_w) {
+            text_w = w;
+        }
+    }
+    int chart_w = SC_PERF_OVERLAY_BUCKETS * (bar_w + scale);
+
+    SDL_Rect panel = {
+        .x = clip->x,
+        .y = clip->y,
+        .w = (text_w > chart_w ? text_w : chart_w) + 2 * margin,
+        .h = (ARRAY_LEN(lines) + 2) * LINE_H * scale + chart_h + 2 * margin,
+    };
+
+    uint8_t r, g, b, a;
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+    SDL_BlendMode blend_mode;
+    SDL_GetRenderDrawBlendMode(renderer, &blend_mode);
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_RenderSetClipRect(renderer, clip);
+
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xa0);
+    SDL_RenderFillRect(renderer, &panel);
+
+    int x = panel.x + margin;
+    int y = panel.y + margin;
+    SDL_SetRenderDrawColor(renderer, 0xff, 0xff, 0xff, 0xff);
+    for (unsigned i = 0; i < ARRAY_LEN(lines); ++i) {
+        draw_text(renderer, x, y, scale, lines[i]);
+        y += LINE_H * scale;
+    }
+
+    y += LINE_H * scale;
+    unsigned max_count = 0;
+    for (unsigned i = 0; i < SC_PERF_OVERLAY_BUCKETS; ++i) {
+        if (overlay->shown.histogram[i] > max_count) {
+            max_count = overlay->shown.histogram[i];
+        }
+    }
+
+    for (unsigned i = 0; i < SC_PERF_OVERLAY_BUCKETS; ++i) {
+        int bar_x = x + i * (bar_w + scale);
+        unsigned count = overlay->shown.histogram[i];
+        if (count) {
+            int h = chart_h * count / max_count;
+            if (!h) {
+                h = 1;
+            }
+            SDL_Rect bar = {bar_x, y + chart_h - h, bar_w, h};
+            // The intervals above 50 ms (below 20 fps) are visible stutters
+            if (i < 5) {
+                SDL_SetRenderDrawColor(renderer, 0x40, 0xc0, 0x40, 0xff);
+            } else {
+                SDL_SetRenderDrawColor(renderer, 0xe0, 0x40, 0x40, 0xff);
+            }
+            SDL_RenderFillRect(renderer, &bar);
+        }
+
+        SDL_SetRenderDrawColor(renderer, 0xff, 0xff, 0xff, 0xff);
+        draw_text(renderer, bar_x, y + chart_h + scale, scale,
+                  bucket_labels[i]);
+    }
+
+    SDL_RenderSetClipRect(renderer, NULL);
+    SDL_SetRenderDrawBlendMode(renderer, blend_mode);
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+}
@@ -0,0 +1,69 @@
+#ifndef SC_PERF_OVERLAY_H
+#define SC_PERF_OVERLAY_H
+
+#include "common.h"
+
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+#include "stats.h"
+#include "util/tick.h"
+
+// Number of buckets of the frame interval histogram
+#define SC_PERF_OVERLAY_BUCKETS 8
+
+/**
+ * Live performance summary drawn over the mirrored content
+ *
+ * It shows, for the last complete second, the histogram of the intervals
+ * between the presented frames, the frame rate, the dropped frames, the
+ * average decoding time, the video bitrate and the queue depths.
+ *
+ * The values other than the frame intervals are read from the stats.
+ */
+struct sc_perf_overlay {
+    struct sc_stats *stats;
+
+    sc_tick window_start;
+    sc_tick last_frame; // 0 if no frame has been presented yet
+
+    // Accumulated during the current window
+    unsigned histogram[SC_PERF_OVERLAY_BUCKETS];
+    unsigned frames;
+    sc_tick max_interval;
+
+    // Stats values at the start of the current window
+    int64_t last_video_bytes;
+    int64_t last_skipped;
+    int64_t last_decode_time_us;
+    int64_t last_decoded;
+
+    // Values of the last complete window, displayed
+    struct {
+        unsigned histogram[SC_PERF_OVERLAY_BUCKETS];
+        unsigned fps;
+        sc_tick max_interval;
+        unsigned dropped;
+        uint64_t bitrate; // bits per second
+        int64_t decode_avg_us; // -1 if no packet has been decoded
+    } shown;
+};
+
+// The stats must outlive the overlay
+void
+sc_perf_overlay_init(struct sc_perf_overlay *overlay, struct sc_stats *stats);
+
+// Record a presented frame (the displayed values are updated once per second)
+void
+sc_perf_overlay_on_frame(struct sc_perf_overlay *overlay, sc_tick now);
+
+/**
+ * Draw the summary in the top-left corner of the content rectangle
+ *
+ * The renderer draw color and blend mode are restored.
+ */
+void
+sc_perf_overlay_render(const struct sc_perf_overlay *overlay,
+                       SDL_Renderer *renderer, const SDL_Rect *clip);
+
+#endif
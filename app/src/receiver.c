@@ -3,45 +3,136 @@
 #include <assert.h>
 #include <inttypes.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL_clipboard.h>
 
+#ifdef HAVE_CONTROL_COMPRESSION
+# include "compression.h"
+#endif
 #include "device_msg.h"
+#include "util/binary.h"
 #include "util/log.h"
 #include "util/str.h"
+#include "util/strbuf.h"
+
+// The buffer grows if a single message exceeds its capacity
+#define SC_RECEIVER_BUFFER_MAX_SIZE (1 << 24) // 16M
+
+// Initial block size of the arena for the message payloads (it grows to fit a
+// whole batch of messages)
+#define SC_RECEIVER_ARENA_BLOCK_SIZE 4096
 
 bool
-sc_receiver_init(struct sc_receiver *receiver, sc_socket control_socket) {
+sc_receiver_init(struct sc_receiver *receiver, sc_socket control_socket,
+                 struct sc_stats *stats) {
     bool ok = sc_mutex_init(&receiver->mutex);
     if (!ok) {
         return false;
     }
 
+    receiver->buf = malloc(DEVICE_MSG_MAX_SIZE);
+    if (!receiver->buf) {
+        LOG_OOM();
+        sc_mutex_destroy(&receiver->mutex);
+        return false;
+    }
+    receiver->cap = DEVICE_MSG_MAX_SIZE;
+    receiver->start = 0;
+    receiver->end = 0;
+
+    sc_arena_init(&receiver->arena, SC_RECEIVER_ARENA_BLOCK_SIZE);
+
+    receiver->clipboard_chunks.s = NULL;
+    receiver->clipboard_chunks_dropped = false;
+    atomic_init(&receiver->device_clipboard_hash, 0);
+
     receiver->control_socket = control_socket;
     receiver->acksync = NULL;
     receiver->uhid_devices = NULL;
+    receiver->stats = stats;
+    receiver->clock_sync = NULL;
 
     return true;
 }
 
 void
 sc_receiver_destroy(struct sc_receiver *receiver) {
+    free(receiver->clipboard_chunks.s);
+    sc_arena_destroy(&receiver->arena);
+    free(receiver->buf);
     sc_mutex_destroy(&receiver->mutex);
 }
 
+static void
+append_clipboard_chunk(struct sc_receiver *receiver, const char *chunk) {
+    if (receiver->clipboard_chunks_dropped || !*chunk) {
+        return;
+    }
+
+    struct sc_strbuf *buf = &receiver->clipboard_chunks;
+    size_t len = strlen(chunk);
+    if (!buf->s) {
+        if (!sc_strbuf_init(buf, 2 * len)) {
+            receiver->clipboard_chunks_dropped = true;
+            return;
+        }
+    } else if (buf->len + len > DEVICE_MSG_CLIPBOARD_MAX_LENGTH) {
+        LOGW("Device clipboard too large, ignored");
+        receiver->clipboard_chunks_dropped = true;
+        return;
+    }
+
+    if (!sc_strbuf_append(buf, chunk, len)) {
+        receiver->clipboard_chunks_dropped = true;
+    }
+}
+
+static void
+process_clipboard(struct sc_receiver *receiver, const char *text) {
+    // The device clipboard contains this text now
+    atomic_store_explicit(&receiver->device_clipboard_hash, sc_str_hash(text),
+                          memory_order_relaxed);
+
+    char *current = SDL_GetClipboardText();
+    bool same = current && !strcmp(current, text);
+    SDL_free(current);
+    if (same) {
+        LOGD("Computer clipboard unchanged");
+        return;
+    }
+
+    LOGI("Device clipboard copied");
+    SDL_SetClipboardText(text);
+}
+
 static void
 process_msg(struct sc_receiver *receiver, struct sc_device_msg *msg) {
     switch (msg->type) {
+        case DEVICE_MSG_TYPE_CLIPBOARD_CHUNK:
+            append_clipboard_chunk(receiver, msg->clipboard_chunk.text);
+            break;
         case DEVICE_MSG_TYPE_CLIPBOARD: {
-            char *current = SDL_GetClipboardText();
-            bool same = current && !strcmp(current, msg->clipboard.text);
-            SDL_free(current);
-            if (same) {
-                LOGD("Computer clipboard unchanged");
-                return;
+            struct sc_strbuf *buf = &receiver->clipboard_chunks;
+            if (!buf->s && !receiver->clipboard_chunks_dropped) {
+                // Not chunked
+                process_clipboard(receiver, msg->clipboard.text);
+                break;
+            }
+
+            // Final part of a chunked clipboard text
+            append_clipboard_chunk(receiver, msg->clipboard.text);
+            if (!receiver->clipboard_chunks_dropped) {
+                process_clipboard(receiver, buf->s);
+            } else {
+                // The device clipboard is unknown
+                atomic_store_explicit(&receiver->device_clipboard_hash, 0,
+                                      memory_order_relaxed);
             }
 
-            LOGI("Device clipboard copied");
-            SDL_SetClipboardText(msg->clipboard.text);
+            free(buf->s);
+            buf->s = NULL;
+            receiver->clipboard_chunks_dropped = false;
             break;
         }
         case DEVICE_MSG_TYPE_ACK_CLIPBOARD:
@@ -95,7 +186,125 @@ process_msg(struct sc_receiver *receiver, struct sc_device_msg *msg) {
                 LOGW("No UHID receiver for id %" PRIu16, msg->uhid_output.id);
             }
             break;
+        case DEVICE_MSG_TYPE_VIDEO_DROPPED:
+            LOGW("Network congestion: the device dropped video frames "
+                 "(%" PRIu32 " in total)", msg->video_dropped.total);
+            break;
+        case DEVICE_MSG_TYPE_INJECTION_LATENCY:
+            LOGD("Input injection latency: p50=%" PRIu32 "us p99=%" PRIu32
+                 "us", msg->injection_latency.p50, msg->injection_latency.p99);
+            sc_stats_set(receiver->stats, SC_STAT_INJECTION_LATENCY_P50_US,
+                         msg->injection_latency.p50);
+            sc_stats_set(receiver->stats, SC_STAT_INJECTION_LATENCY_P99_US,
+                         msg->injection_latency.p99);
+            break;
+        case DEVICE_MSG_TYPE_ENCODER_STATS:
+            sc_stats_set(receiver->stats, SC_STAT_ENCODE_LATENCY_P50_US,
+                         msg->encoder_stats.encode_p50);
+            sc_stats_set(receiver->stats, SC_STAT_ENCODE_LATENCY_P99_US,
+                         msg->encoder_stats.encode_p99);
+            sc_stats_set(receiver->stats, SC_STAT_WRITE_BLOCK_P50_US,
+                         msg->encoder_stats.write_block_p50);
+            sc_stats_set(receiver->stats, SC_STAT_WRITE_BLOCK_P99_US,
+                         msg->encoder_stats.write_block_p99);
+            break;
+        case DEVICE_MSG_TYPE_CLOCK_PONG:
+            if (receiver->clock_sync) {
+                sc_tick now = sc_tick_now();
+                sc_clock_sync_push(receiver->clock_sync,
+                                   msg->clock_pong.client_time,
+                                   msg->clock_pong.device_time, now);
+                sc_tick offset;
+                sc_tick error;
+                if (sc_clock_sync_get(receiver->clock_sync, &offset, &error)) {
+                    sc_stats_set(receiver->stats, SC_STAT_CLOCK_SYNC_ERROR_US,
+                                 error);
+                }
+            }
+            break;
+        case DEVICE_MSG_TYPE_THERMAL_STATE:
+            if (msg->thermal_state.level) {
+                LOGW("Device thermal status %d (battery %d%%): video limited "
+                     "(level %" PRIu8 ")", msg->thermal_state.status,
+                     msg->thermal_state.battery_level,
+                     msg->thermal_state.level);
+            } else {
+                LOGI("Device thermal status %d (battery %d%%): video not "
+                     "limited", msg->thermal_state.status,
+                     msg->thermal_state.battery_level);
+            }
+            sc_stats_set(receiver->stats, SC_STAT_DEVICE_THERMAL_STATUS,
+                         msg->thermal_state.status);
+            sc_stats_set(receiver->stats, SC_STAT_THERMAL_LEVEL,
+                         msg->thermal_state.level);
+            break;
+        case DEVICE_MSG_TYPE_COMPRESSED:
+            // Unwrapped by deserialize_msg()
+            assert(!"unexpected compressed message");
+            break;
+    }
+}
+
+#ifdef HAVE_CONTROL_COMPRESSION
+// Deserialize a message wrapped in a compressed message
+//
+// return the number of bytes consumed (0 for no complete msg, -1 on error)
+static ssize_t
+deserialize_compressed_msg(struct sc_receiver *receiver, const uint8_t *buf,
+                           size_t len, struct sc_device_msg *msg) {
+    assert(len && buf[0] == DEVICE_MSG_TYPE_COMPRESSED);
+
+    if (len < SC_COMPRESSION_HEADER_SIZE) {
+        return 0; // no complete message
+    }
+    size_t raw_len = sc_read32be(&buf[1]);
+    size_t compressed_len = sc_read32be(&buf[5]);
+    if (raw_len > DEVICE_MSG_MAX_SIZE) {
+        LOGE("Compressed device message too large");
+        return -1;
+    }
+    if (compressed_len > len - SC_COMPRESSION_HEADER_SIZE) {
+        return 0; // no complete message
+    }
+
+    uint8_t *raw = sc_arena_alloc(&receiver->arena, raw_len);
+    if (!raw) {
+        LOG_OOM();
+        return -1;
     }
+
+    if (!sc_decompress(&buf[SC_COMPRESSION_HEADER_SIZE], compressed_len, raw,
+                       raw_len)) {
+        LOGE("Could not decompress device message");
+        return -1;
+    }
+
+    // It must contain exactly one (uncompressed) message
+    ssize_t r = sc_device_msg_deserialize(raw, raw_len, &receiver->arena, msg);
+    if (r != (ssize_t) raw_len) {
+        LOGE("Invalid compressed device message");
+        return -1;
+    }
+
+    size_t total = SC_COMPRESSION_HEADER_SIZE + compressed_len;
+    if (raw_len > total) {
+        sc_stats_add(receiver->stats, SC_STAT_CONTROL_COMPRESSION_SAVED_BYTES,
+                     raw_len - total);
+    }
+
+    return total;
+}
+#endif
+
+static ssize_t
+deserialize_msg(struct sc_receiver *receiver, const uint8_t *buf, size_t len,
+                struct sc_device_msg *msg) {
+#ifdef HAVE_CONTROL_COMPRESSION
+    if (len && buf[0] == DEVICE_MSG_TYPE_COMPRESSED) {
+        return deserialize_compressed_msg(receiver, buf, len, msg);
+    }
+#endif
+    return sc_device_msg_deserialize(buf, len, &receiver->arena, msg);
 }
 
 static ssize_t
@@ -103,7 +312,7 @@ process_msgs(struct sc_receiver *receiver, const uint8_t *buf, size_t len) {
     size_t head = 0;
     for (;;) {
         struct sc_device_msg msg;
-        ssize_t r = sc_device_msg_deserialize(&buf[head], len - head, &msg);
+        ssize_t r = deserialize_msg(receiver, &buf[head], len - head, &msg);
         if (r == -1) {
             return -1;
         }
@@ -112,7 +321,6 @@ process_msgs(struct sc_receiver *receiver, const uint8_t *buf, size_t len) {
         }
 
         process_msg(receiver, &msg);
-        sc_device_msg_destroy(&msg);
 
         head += r;
         assert(head <= len);
@@ -122,34 +330,85 @@ process_msgs(struct sc_receiver *receiver, const uint8_t *buf, size_t len) {
     }
 }
 
+// Make room at the end of the buffer, by moving the pending data to the
+// beginning (only the beginning of a single message, so it is cheap), or by
+// growing the buffer if the pending data fills it
+static bool
+make_room(struct sc_receiver *receiver) {
+    assert(receiver->end == receiver->cap);
+
+    size_t pending = receiver->end - receiver->start;
+    if (receiver->start) {
+        memmove(receiver->buf, &receiver->buf[receiver->start], pending);
+        receiver->start = 0;
+        receiver->end = pending;
+        return true;
+    }
+
+    // A single message exceeds the buffer capacity
+    if (receiver->cap >= SC_RECEIVER_BUFFER_MAX_SIZE) {
+        LOGE("Device message too large");
+        return false;
+    }
+
+    size_t cap = receiver->cap * 2;
+    uint8_t *buf = realloc(receiver->buf, cap);
+    if (!buf) {
+        LOG_OOM();
+        return false;
+    }
+
+    LOGD("Receiver buffer resized to %" SC_PRIsizet " bytes", cap);
+    receiver->buf = buf;
+    receiver->cap = cap;
+    return true;
+}
+
+bool
+sc_receiver_recv(struct sc_receiver *receiver) {
+    if (receiver->end == receiver->cap && !make_room(receiver)) {
+        return false;
+    }
+
+    assert(receiver->end < receiver->cap);
+    ssize_t r = net_recv(receiver->control_socket,
+                         &receiver->buf[receiver->end],
+                         receiver->cap - receiver->end);
+    if (r <= 0) {
+        LOGD("Receiver stopped");
+        return false;
+    }
+
+    receiver->end += r;
+    // The messages are parsed in place, the consumed data is never copied
+    ssize_t consumed = process_msgs(receiver,
+                                    &receiver->buf[receiver->start],
+                                    receiver->end - receiver->start);
+    // The payloads of the processed messages are not used anymore
+    sc_arena_reset(&receiver->arena);
+    if (consumed == -1) {
+        // an error occurred
+        return false;
+    }
+
+    receiver->start += consumed;
+    if (receiver->start == receiver->end) {
+        // Everything has been processed, restart at the beginning
+        receiver->start = 0;
+        receiver->end = 0;
+    }
+
+    return true;
+}
+
 static int
 run_receiver(void *data) {
     struct sc_receiver *receiver = data;
 
-    static uint8_t buf[DEVICE_MSG_MAX_SIZE];
-    size_t head = 0;
-
     for (;;) {
-        assert(head < DEVICE_MSG_MAX_SIZE);
-        ssize_t r = net_recv(receiver->control_socket, buf + head,
-                             DEVICE_MSG_MAX_SIZE - head);
-        if (r <= 0) {
-            LOGD("Receiver stopped");
+        if (!sc_receiver_recv(receiver)) {
             break;
         }
-
-        head += r;
-        ssize_t consumed = process_msgs(receiver, buf, head);
-        if (consumed == -1) {
-            // an error occurred
-            break;
-        }
-
-        if (consumed) {
-            head -= consumed;
-            // shift the remaining data in the buffer
-            memmove(buf, &buf[consumed], head);
-        }
     }
 
     return 0;
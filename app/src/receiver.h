@@ -3,11 +3,18 @@
 
 #include "common.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
+#include "clock_sync.h"
+#include "stats.h"
 #include "uhid/uhid_output.h"
 #include "util/acksync.h"
+#include "util/memory.h"
 #include "util/net.h"
+#include "util/strbuf.h"
 #include "util/thread.h"
 
 // receive events from the device
@@ -19,10 +26,32 @@ struct sc_receiver {
 
     struct sc_acksync *acksync;
     struct sc_uhid_devices *uhid_devices;
+    struct sc_stats *stats; // may be NULL
+    struct sc_clock_sync *clock_sync; // may be NULL
+
+    // Received data not processed yet, in buf[start..end) (only used by the
+    // receiver thread)
+    uint8_t *buf;
+    size_t cap;
+    size_t start;
+    size_t end;
+    // Payloads of the messages of the current batch (only used by the
+    // receiver thread)
+    struct sc_arena arena;
+
+    // Beginning of a clipboard text received in several chunks (s is NULL if
+    // there is none), only used by the receiver thread
+    struct sc_strbuf clipboard_chunks;
+    bool clipboard_chunks_dropped;
+
+    // Hash of the text in the device clipboard (see sc_str_hash()), 0 if
+    // unknown
+    atomic_uint_least64_t device_clipboard_hash;
 };
 
 bool
-sc_receiver_init(struct sc_receiver *receiver, sc_socket control_socket);
+sc_receiver_init(struct sc_receiver *receiver, sc_socket control_socket,
+                 struct sc_stats *stats);
 
 void
 sc_receiver_destroy(struct sc_receiver *receiver);
@@ -32,6 +61,18 @@ sc_receiver_start(struct sc_receiver *receiver);
 
 // no sc_receiver_stop(), it will automatically stop on control_socket shutdown
 
+/**
+ * Receive once from the control socket (blocking until some data is
+ * available), and process the complete device messages
+ *
+ * This allows to receive from another thread than the receiver thread (which
+ * must not be started in that case), typically once the socket is readable.
+ *
+ * Return false if the socket is closed, or on error.
+ */
+bool
+sc_receiver_recv(struct sc_receiver *receiver);
+
 void
 sc_receiver_join(struct sc_receiver *receiver);
 
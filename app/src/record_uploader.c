@@ -0,0 +1,356 @@
+#include "record_uploader.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavformat/avio.h>
+#include <libavutil/dict.h>
+#include <libavutil/hash.h>
+
+#include "util/file.h"
+#include "util/log.h"
+
+#define SC_RECORD_UPLOADER_BUFFER_SIZE (256 * 1024)
+// Hex-encoded SHA-256, with the terminating NUL
+#define SC_RECORD_UPLOADER_HASH_HEX_SIZE (2 * 32 + 1)
+
+bool
+sc_record_uploader_init(struct sc_record_uploader *ru, const char *url) {
+    size_t len = strlen(url);
+    while (len && url[len - 1] == '/') {
+        --len;
+    }
+
+    ru->url = malloc(len + 1);
+    if (!ru->url) {
+        LOG_OOM();
+        return false;
+    }
+    memcpy(ru->url, url, len);
+    ru->url[len] = '\0';
+
+    bool ok = sc_mutex_init(&ru->mutex);
+    if (!ok) {
+        goto error_free_url;
+    }
+
+    ok = sc_cond_init(&ru->cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    ru->stopped = false;
+    sc_vecdeque_init(&ru->queue);
+
+    return true;
+
+error_destroy_mutex:
+    sc_mutex_destroy(&ru->mutex);
+error_free_url:
+    free(ru->url);
+
+    return false;
+}
+
+void
+sc_record_uploader_destroy(struct sc_record_uploader *ru) {
+    while (!sc_vecdeque_is_empty(&ru->queue)) {
+        char *filename = sc_vecdeque_pop(&ru->queue);
+        free(filename);
+    }
+    sc_vecdeque_destroy(&ru->queue);
+    sc_cond_destroy(&ru->cond);
+    sc_mutex_destroy(&ru->mutex);
+    free(ru->url);
+}
+
+static const char *
+get_basename(const char *path) {
+    const char *name = path;
+    for (const char *p = path; *p; ++p) {
+        if (*p == '/' || *p == SC_PATH_SEPARATOR) {
+            name = p + 1;
+        }
+    }
+    return name;
+}
+
+static char *
+sc_record_uploader_get_url(struct sc_record_uploader *ru,
+                           const char *filename) {
+    const char *name = get_basename(filename);
+    size_t size = strlen(ru->url) + 1 + strlen(name) + 1;
+    char *url = malloc(size);
+    if (!url) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    snprintf(url, size, "%s/%s", ru->url, name);
+    return url;
+}
+
+static AVIOContext *
+sc_record_uploader_open_put(const char *url, int64_t size) {
+    char timeout[32];
+    snprintf(timeout, sizeof(timeout), "%" PRId64,
+             (int64_t) SC_TICK_TO_US(SC_RECORD_UPLOADER_TIMEOUT));
+
+    // Object storages do not accept chunked uploads: send the length
+    char headers[64];
+    snprintf(headers, sizeof(headers), "Content-Length: %" PRId64 "\r\n",
+             size);
+
+    AVDictionary *opts = NULL;
+    if (av_dict_set(&opts, "method", "PUT", 0) < 0
+            || av_dict_set(&opts, "chunked_post", "0", 0) < 0
+            || av_dict_set(&opts, "headers", headers, 0) < 0
+            || av_dict_set(&opts, "rw_timeout", timeout, 0) < 0) {
+        LOG_OOM();
+        av_dict_free(&opts);
+        return NULL;
+    }
+
+    AVIOContext *out = NULL;
+    int r = avio_open2(&out, url, AVIO_FLAG_WRITE, NULL, &opts);
+    av_dict_free(&opts);
+    if (r < 0) {
+        LOGE("Could not open %s (is the protocol supported by FFmpeg?)", url);
+        return NULL;
+    }
+
+    return out;
+}
+
+// Upload the file, and compute its checksum in the same pass if hash_hex is
+// not NULL
+static bool
+sc_record_uploader_put(struct sc_record_uploader *ru, const char *filename,
+                       char *hash_hex) {
+    char *url = sc_record_uploader_get_url(ru, filename);
+    if (!url) {
+        return false;
+    }
+
+    bool ok = false;
+
+    struct AVHashContext *hash = NULL;
+    if (hash_hex) {
+        if (av_hash_alloc(&hash, "SHA256") < 0) {
+            LOG_OOM();
+            goto free_url;
+        }
+        av_hash_init(hash);
+    }
+
+    uint8_t *buf = malloc(SC_RECORD_UPLOADER_BUFFER_SIZE);
+    if (!buf) {
+        LOG_OOM();
+        goto free_hash;
+    }
+
+    AVIOContext *in = NULL;
+    if (avio_open(&in, filename, AVIO_FLAG_READ) < 0) {
+        LOGE("Could not open %s", filename);
+        goto free_buf;
+    }
+
+    int64_t size = avio_size(in);
+    if (size < 0) {
+        LOGE("Could not get the size of %s", filename);
+        goto close_in;
+    }
+
+    AVIOContext *out = sc_record_uploader_open_put(url, size);
+    if (!out) {
+        goto close_in;
+    }
+
+    int64_t remaining = size;
+    while (remaining) {
+        int r = avio_read(in, buf, SC_RECORD_UPLOADER_BUFFER_SIZE);
+        if (r <= 0) {
+            LOGE("Could not read %s", filename);
+            break;
+        }
+
+        if (hash) {
+            av_hash_update(hash, buf, r);
+        }
+        avio_write(out, buf, r);
+        if (out->error) {
+            break;
+        }
+
+        remaining -= r;
+    }
+
+    avio_flush(out);
+    ok = !remaining && !out->error;
+    // The server response is read on close
+    if (avio_closep(&out) < 0) {
+        ok = false;
+    }
+
+    if (ok && hash) {
+        av_hash_final_hex(hash, (uint8_t *) hash_hex,
+                          SC_RECORD_UPLOADER_HASH_HEX_SIZE);
+    }
+
+    if (!ok) {
+        LOGE("Could not upload %s to %s", filename, url);
+    }
+
+close_in:
+    avio_closep(&in);
+free_buf:
+    free(buf);
+free_hash:
+    av_hash_freep(&hash);
+free_url:
+    free(url);
+
+    return ok;
+}
+
+// Write the checksum file (in the sha256sum format), and return its path
+static char *
+sc_record_uploader_write_checksum(const char *filename, const char *hash_hex) {
+    size_t size = strlen(filename) + sizeof(".sha256");
+    char *path = malloc(size);
+    if (!path) {
+        LOG_OOM();
+        return NULL;
+    }
+    snprintf(path, size, "%s.sha256", filename);
+
+    AVIOContext *out = NULL;
+    if (avio_open(&out, path, AVIO_FLAG_WRITE) < 0) {
+        LOGE("Could not open %s", path);
+        free(path);
+        return NULL;
+    }
+
+    avio_printf(out, "%s  %s\n", hash_hex, get_basename(filename));
+    if (avio_closep(&out) < 0) {
+        LOGE("Could not write %s", path);
+        free(path);
+        return NULL;
+    }
+
+    return path;
+}
+
+static void
+sc_record_uploader_upload(struct sc_record_uploader *ru, const char *filename) {
+    LOGI("Uploading %s...", filename);
+
+    char hash_hex[SC_RECORD_UPLOADER_HASH_HEX_SIZE];
+    if (!sc_record_uploader_put(ru, filename, hash_hex)) {
+        // Error already logged
+        return;
+    }
+
+    char *checksum_path = sc_record_uploader_write_checksum(filename, hash_hex);
+    if (!checksum_path) {
+        return;
+    }
+
+    bool ok = sc_record_uploader_put(ru, checksum_path, NULL);
+    free(checksum_path);
+    if (ok) {
+        LOGI("%s uploaded (sha256: %s)", filename, hash_hex);
+    }
+}
+
+static int
+run_record_uploader(void *data) {
+    struct sc_record_uploader *ru = data;
+
+    bool stop_logged = false;
+
+    for (;;) {
+        sc_mutex_lock(&ru->mutex);
+        while (!ru->stopped && sc_vecdeque_is_empty(&ru->queue)) {
+            sc_cond_wait(&ru->cond, &ru->mutex);
+        }
+
+        if (sc_vecdeque_is_empty(&ru->queue)) {
+            // Stopped, and all the files have been uploaded
+            assert(ru->stopped);
+            sc_mutex_unlock(&ru->mutex);
+            break;
+        }
+
+        char *filename = sc_vecdeque_pop(&ru->queue);
+        size_t pending = sc_vecdeque_size(&ru->queue);
+        bool stopped = ru->stopped;
+        sc_mutex_unlock(&ru->mutex);
+
+        if (stopped && !stop_logged) {
+            LOGI("Uploading the remaining recording files (%" SC_PRIsizet
+                 " pending)...", pending + 1);
+            stop_logged = true;
+        }
+
+        sc_record_uploader_upload(ru, filename);
+        free(filename);
+    }
+
+    LOGD("Record uploader thread ended");
+
+    return 0;
+}
+
+bool
+sc_record_uploader_start(struct sc_record_uploader *ru) {
+    LOGD("Starting record uploader thread");
+
+    bool ok = sc_thread_create(&ru->thread, run_record_uploader,
+                               "scrcpy-upload", ru);
+    if (!ok) {
+        LOGE("Could not start record uploader thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_record_uploader_stop(struct sc_record_uploader *ru) {
+    sc_mutex_lock(&ru->mutex);
+    ru->stopped = true;
+    sc_cond_signal(&ru->cond);
+    sc_mutex_unlock(&ru->mutex);
+}
+
+void
+sc_record_uploader_join(struct sc_record_uploader *ru) {
+    sc_thread_join(&ru->thread, NULL);
+}
+
+bool
+sc_record_uploader_push(struct sc_record_uploader *ru, const char *filename) {
+    char *copy = strdup(filename);
+    if (!copy) {
+        LOG_OOM();
+        return false;
+    }
+
+    sc_mutex_lock(&ru->mutex);
+    bool ok = sc_vecdeque_push(&ru->queue, copy);
+    if (ok) {
+        sc_cond_signal(&ru->cond);
+    }
+    sc_mutex_unlock(&ru->mutex);
+
+    if (!ok) {
+        LOG_OOM();
+        free(copy);
+        return false;
+    }
+
+    return true;
+}
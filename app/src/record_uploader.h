@@ -0,0 +1,60 @@
+#ifndef SC_RECORD_UPLOADER_H
+#define SC_RECORD_UPLOADER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+
+#include "util/thread.h"
+#include "util/tick.h"
+#include "util/vecdeque.h"
+
+// Timeout of each read or write on the upload connection
+#define SC_RECORD_UPLOADER_TIMEOUT SC_TICK_FROM_SEC(30)
+
+struct sc_record_uploader_queue SC_VECDEQUE(char *);
+
+/**
+ * Upload the completed recording files (each segment once it is finished) in
+ * the background, by HTTP PUT to <url>/<file name>
+ *
+ * The SHA-256 checksum of each file is computed in the same pass as the
+ * upload (the file is read only once, just after being written, so typically
+ * from the page cache), written to <file>.sha256 (in the sha256sum format),
+ * and uploaded along with the file.
+ *
+ * The content length is always sent (no chunked transfer), so that the files
+ * may be uploaded to S3-compatible object storage (typically via pre-signed
+ * or public-write URLs, no request signing is performed).
+ */
+struct sc_record_uploader {
+    char *url; // without trailing '/'
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    bool stopped;
+    struct sc_record_uploader_queue queue;
+};
+
+bool
+sc_record_uploader_init(struct sc_record_uploader *ru, const char *url);
+
+void
+sc_record_uploader_destroy(struct sc_record_uploader *ru);
+
+bool
+sc_record_uploader_start(struct sc_record_uploader *ru);
+
+// The files already pushed are still uploaded before the thread terminates
+void
+sc_record_uploader_stop(struct sc_record_uploader *ru);
+
+void
+sc_record_uploader_join(struct sc_record_uploader *ru);
+
+// Request the upload of a completed file (the filename is copied)
+bool
+sc_record_uploader_push(struct sc_record_uploader *ru, const char *filename);
+
+#endif
@@ -1,13 +1,20 @@
 #include "recorder.h"
 
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
 #include <libavutil/time.h>
 #include <libavutil/display.h>
 
+#include "avio_writer.h"
+#include "packet_merger.h"
+#include "util/file.h"
 #include "util/log.h"
 #include "util/str.h"
+#include "util/trace.h"
 
 /** Downcast packet sinks to recorder */
 #define DOWNCAST_VIDEO(SINK) \
@@ -17,6 +24,23 @@
 
 static const AVRational SCRCPY_TIME_BASE = {1, 1000000}; // timestamps in us
 
+// Duration of the video packets in low latency mode, until the actual frame
+// interval is known (60 fps)
+#define SC_RECORDER_DEFAULT_VIDEO_DURATION 16667 // us
+
+// must be called with mutex locked
+static void
+sc_recorder_update_stats(struct sc_recorder *recorder) {
+    sc_stats_set(recorder->stats, SC_STAT_RECORDER_VIDEO_QUEUE,
+                 recorder->video_queue.size);
+    sc_stats_set(recorder->stats, SC_STAT_RECORDER_AUDIO_QUEUE,
+                 recorder->audio_queue.size);
+    sc_stats_set(recorder->stats, SC_STAT_RECORDER_QUEUE_BYTES,
+                 recorder->queue_bytes);
+    sc_stats_set(recorder->stats, SC_STAT_RECORDER_SPILLED_PACKETS,
+                 recorder->video_spill.count + recorder->audio_spill.count);
+}
+
 static const AVOutputFormat *
 find_muxer(const char *name) {
 #ifdef SCRCPY_LAVF_HAS_NEW_MUXER_ITERATOR_API
@@ -58,6 +82,82 @@ sc_recorder_queue_clear(struct sc_recorder_queue *queue) {
     }
 }
 
+// must be called with mutex locked
+static inline bool
+sc_recorder_queue_is_empty(struct sc_recorder_queue *queue,
+                           struct sc_packet_spill *spill) {
+    return sc_vecdeque_is_empty(queue) && sc_packet_spill_is_empty(spill);
+}
+
+// must be called with mutex locked
+static inline bool
+sc_recorder_video_queue_is_empty(struct sc_recorder *recorder) {
+    return sc_recorder_queue_is_empty(&recorder->video_queue,
+                                      &recorder->video_spill);
+}
+
+// must be called with mutex locked
+static inline bool
+sc_recorder_audio_queue_is_empty(struct sc_recorder *recorder) {
+    return sc_recorder_queue_is_empty(&recorder->audio_queue,
+                                      &recorder->audio_spill);
+}
+
+// must be called with mutex locked (the packet ownership is transferred)
+static bool
+sc_recorder_enqueue(struct sc_recorder *recorder,
+                    struct sc_recorder_queue *queue,
+                    struct sc_packet_spill *spill, AVPacket *packet) {
+    size_t size = packet->size;
+
+    // Once packets are spilled, spill the next ones too, to keep the order
+    bool must_spill = !sc_packet_spill_is_empty(spill)
+        || (recorder->queue_limit
+            && recorder->queue_bytes + size > recorder->queue_limit);
+    if (must_spill) {
+        if (sc_packet_spill_is_empty(spill)) {
+            LOGD("Recorder queue limit reached, spilling packets to disk");
+        }
+
+        // The spill does not store side data, so inline the config packet
+        bool ok = sc_packet_merger_inline_config(packet)
+               && sc_packet_spill_push(spill, packet);
+        av_packet_free(&packet);
+        return ok;
+    }
+
+    bool ok = sc_vecdeque_push(queue, packet);
+    if (!ok) {
+        LOG_OOM();
+        av_packet_free(&packet);
+        return false;
+    }
+
+    recorder->queue_bytes += size;
+    if (recorder->queue_bytes > recorder->peak_queue_bytes) {
+        recorder->peak_queue_bytes = recorder->queue_bytes;
+    }
+
+    return true;
+}
+
+// must be called with mutex locked (return NULL on error)
+static AVPacket *
+sc_recorder_dequeue(struct sc_recorder *recorder,
+                    struct sc_recorder_queue *queue,
+                    struct sc_packet_spill *spill) {
+    // The packets in memory are always older than the spilled ones
+    if (!sc_vecdeque_is_empty(queue)) {
+        AVPacket *packet = sc_vecdeque_pop(queue);
+        assert(recorder->queue_bytes >= (size_t) packet->size);
+        recorder->queue_bytes -= packet->size;
+        return packet;
+    }
+
+    assert(!sc_packet_spill_is_empty(spill));
+    return sc_packet_spill_pop(spill);
+}
+
 static const char *
 sc_recorder_get_format_name(enum sc_record_format format) {
     switch (format) {
@@ -103,6 +203,16 @@ sc_recorder_rescale_packet(AVStream *stream, AVPacket *packet) {
 static bool
 sc_recorder_write_stream(struct sc_recorder *recorder,
                          struct sc_recorder_stream *st, AVPacket *packet) {
+    if (packet->pts < recorder->segment_start_pts) {
+        // The packet belongs to the previous segment (e.g. an audio packet
+        // received just after the video keyframe starting the new segment)
+        return true;
+    }
+    packet->pts -= recorder->segment_start_pts;
+    packet->dts = packet->pts;
+
+    sc_trace_begin_pts("mux", packet->pts + recorder->segment_start_pts);
+
     AVStream *stream = recorder->ctx->streams[st->index];
     sc_recorder_rescale_packet(stream, packet);
     if (st->last_pts != AV_NOPTS_VALUE && packet->pts <= st->last_pts) {
@@ -114,11 +224,18 @@ sc_recorder_write_stream(struct sc_recorder *recorder,
     } else {
         st->last_pts = packet->pts;
     }
-    return av_interleaved_write_frame(recorder->ctx, packet) >= 0;
+    bool ok = av_interleaved_write_frame(recorder->ctx, packet) >= 0;
+    sc_trace_end();
+    return ok;
 }
 
 static inline bool
 sc_recorder_write_video(struct sc_recorder *recorder, AVPacket *packet) {
+    // The config packet data must be in-band (for H.26x), so that the stream
+    // is still valid after an encoder restart (e.g. on device rotation)
+    if (!sc_packet_merger_inline_config(packet)) {
+        return false;
+    }
     return sc_recorder_write_stream(recorder, &recorder->video_stream, packet);
 }
 
@@ -128,7 +245,44 @@ sc_recorder_write_audio(struct sc_recorder *recorder, AVPacket *packet) {
 }
 
 static bool
-sc_recorder_open_output_file(struct sc_recorder *recorder) {
+sc_recorder_set_orientation(AVStream *stream, enum sc_orientation orientation) {
+    assert(!sc_orientation_is_mirror(orientation));
+
+    uint8_t *raw_data;
+#ifdef SCRCPY_LAVC_HAS_CODECPAR_CODEC_SIDEDATA
+    AVPacketSideData *sd =
+        av_packet_side_data_new(&stream->codecpar->coded_side_data,
+                                &stream->codecpar->nb_coded_side_data,
+                                AV_PKT_DATA_DISPLAYMATRIX,
+                                sizeof(int32_t) * 9, 0);
+    if (!sd) {
+        LOG_OOM();
+        return false;
+    }
+
+    raw_data = sd->data;
+#else
+    raw_data = av_stream_new_side_data(stream, AV_PKT_DATA_DISPLAYMATRIX,
+                                      sizeof(int32_t) * 9);
+    if (!raw_data) {
+        LOG_OOM();
+        return false;
+    }
+#endif
+
+    int32_t *matrix = (int32_t *) raw_data;
+
+    unsigned rotation = orientation;
+    unsigned angle = rotation * 90;
+
+    av_display_rotation_set(matrix, angle);
+
+    return true;
+}
+
+static bool
+sc_recorder_open_output_file(struct sc_recorder *recorder,
+                             const char *filename) {
     const char *format_name = sc_recorder_get_format_name(recorder->format);
     assert(format_name);
     const AVOutputFormat *format = find_muxer(format_name);
@@ -143,12 +297,23 @@ sc_recorder_open_output_file(struct sc_recorder *recorder) {
         return false;
     }
 
-    int ret = avio_open(&recorder->ctx->pb, recorder->filename,
-                        AVIO_FLAG_WRITE);
-    if (ret < 0) {
-        LOGE("Failed to open output file: %s", recorder->filename);
-        avformat_free_context(recorder->ctx);
-        return false;
+    if (recorder->write_buffer_size) {
+        struct sc_avio_writer *writer =
+            sc_avio_writer_open(filename, recorder->write_buffer_size);
+        if (!writer) {
+            avformat_free_context(recorder->ctx);
+            return false;
+        }
+        // The writer is closed explicitly (see sc_recorder_close_io())
+        recorder->ctx->pb = writer->pb;
+        recorder->ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+    } else {
+        int ret = avio_open(&recorder->ctx->pb, filename, AVIO_FLAG_WRITE);
+        if (ret < 0) {
+            LOGE("Failed to open output file: %s", filename);
+            avformat_free_context(recorder->ctx);
+            return false;
+        }
     }
 
     // contrary to the deprecated API (av_oformat_next()), av_muxer_iterate()
@@ -160,25 +325,199 @@ sc_recorder_open_output_file(struct sc_recorder *recorder) {
     av_dict_set(&recorder->ctx->metadata, "comment",
                 "Recorded by scrcpy " SCRCPY_VERSION, 0);
 
-    LOGI("Recording started to %s file: %s", format_name, recorder->filename);
+    LOGI("Recording started to %s file: %s", format_name, filename);
     return true;
 }
 
-static void
+static bool
+sc_recorder_open_segment(struct sc_recorder *recorder, unsigned index) {
+    if (!recorder->segment_duration) {
+        // Not segmented, record to the requested file
+        assert(!index);
+        return sc_recorder_open_output_file(recorder, recorder->filename);
+    }
+
+    char *filename = sc_file_get_numbered_path(recorder->filename, index);
+    if (!filename) {
+        return false;
+    }
+
+    bool ok = sc_recorder_open_output_file(recorder, filename);
+    free(filename);
+    return ok;
+}
+
+// Close the output of the given context (written by its own thread if
+// write_buffer_size is set), and return false if it could not be fully written
+static bool
+sc_recorder_close_io(struct sc_recorder *recorder, AVFormatContext *ctx) {
+    bool ok;
+    if (recorder->write_buffer_size) {
+        struct sc_avio_writer *writer = ctx->pb->opaque;
+        ok = sc_avio_writer_close(writer);
+    } else {
+        ok = avio_close(ctx->pb) >= 0;
+    }
+    ctx->pb = NULL;
+
+    if (!ok) {
+        LOGE("Could not write the recording to the output file");
+    }
+    return ok;
+}
+
+static bool
 sc_recorder_close_output_file(struct sc_recorder *recorder) {
-    avio_close(recorder->ctx->pb);
+    bool ok = sc_recorder_close_io(recorder, recorder->ctx);
     avformat_free_context(recorder->ctx);
+    return ok;
+}
+
+static void
+sc_recorder_notify_file_completed(struct sc_recorder *recorder,
+                                  unsigned index) {
+    if (!recorder->cbs->on_file_completed) {
+        return;
+    }
+
+    if (!recorder->segment_duration) {
+        recorder->cbs->on_file_completed(recorder, recorder->filename,
+                                         recorder->cbs_userdata);
+        return;
+    }
+
+    char *filename = sc_file_get_numbered_path(recorder->filename, index);
+    if (!filename) {
+        return;
+    }
+
+    recorder->cbs->on_file_completed(recorder, filename,
+                                     recorder->cbs_userdata);
+    free(filename);
+}
+
+static bool
+sc_recorder_write_header(struct sc_recorder *recorder) {
+    AVDictionary *opts = NULL;
+    if (recorder->fragmented) {
+        // Write the moov atom at the beginning and a fragment on every
+        // keyframe, so that the file is playable while it is written (even if
+        // the process is killed) and finalizing it is immediate
+        int r = av_dict_set(&opts, "movflags",
+                            "frag_keyframe+empty_moov+default_base_moof", 0);
+        if (r < 0) {
+            LOG_OOM();
+            return false;
+        }
+    }
+
+    int ret = avformat_write_header(recorder->ctx, &opts);
+    av_dict_free(&opts);
+    return ret >= 0;
+}
+
+static bool
+sc_recorder_copy_streams(struct sc_recorder *recorder,
+                         const AVFormatContext *from) {
+    for (unsigned i = 0; i < from->nb_streams; ++i) {
+        const AVStream *istream = from->streams[i];
+        AVStream *ostream = avformat_new_stream(recorder->ctx, NULL);
+        if (!ostream) {
+            LOG_OOM();
+            return false;
+        }
+
+        // Also copy the extradata (from the config packets)
+        if (avcodec_parameters_copy(ostream->codecpar, istream->codecpar) < 0) {
+            LOG_OOM();
+            return false;
+        }
+        ostream->time_base = istream->time_base;
+
+#ifndef SCRCPY_LAVC_HAS_CODECPAR_CODEC_SIDEDATA
+        // The display matrix is not part of the codec parameters
+        if ((int) i == recorder->video_stream.index
+                && recorder->orientation != SC_ORIENTATION_0) {
+            if (!sc_recorder_set_orientation(ostream, recorder->orientation)) {
+                return false;
+            }
+        }
+#endif
+    }
+
+    return true;
+}
+
+// Finish the current segment, and start a new one from the given video
+// keyframe pts (relative to the recording start)
+static bool
+sc_recorder_next_segment(struct sc_recorder *recorder, int64_t pts) {
+    if (av_write_trailer(recorder->ctx) < 0) {
+        LOGW("Failed to write trailer to the recording segment");
+    }
+
+    AVFormatContext *previous = recorder->ctx;
+
+    unsigned index = recorder->segment_index + 1;
+    if (!sc_recorder_open_segment(recorder, index)) {
+        recorder->ctx = previous;
+        return false;
+    }
+
+    if (!sc_recorder_copy_streams(recorder, previous)
+            || !sc_recorder_write_header(recorder)) {
+        LOGE("Failed to write header to the recording segment");
+        sc_recorder_close_output_file(recorder);
+        recorder->ctx = previous;
+        return false;
+    }
+
+    bool ok = sc_recorder_close_io(recorder, previous);
+    avformat_free_context(previous);
+
+    if (ok) {
+        sc_recorder_notify_file_completed(recorder, recorder->segment_index);
+    }
+
+    recorder->segment_index = index;
+    recorder->segment_start_pts = pts;
+    recorder->video_stream.last_pts = AV_NOPTS_VALUE;
+    recorder->audio_stream.last_pts = AV_NOPTS_VALUE;
+
+    if (recorder->segment_count && index >= recorder->segment_count) {
+        // Only keep the most recent segments
+        char *filename =
+            sc_file_get_numbered_path(recorder->filename,
+                                      index - recorder->segment_count);
+        if (filename) {
+            if (!sc_file_remove(filename)) {
+                LOGW("Could not remove old recording segment: %s", filename);
+            }
+            free(filename);
+        }
+    }
+
+    return true;
+}
+
+static inline bool
+sc_recorder_must_cut_segment(struct sc_recorder *recorder,
+                             const AVPacket *packet) {
+    return recorder->segment_duration
+        && (packet->flags & AV_PKT_FLAG_KEY)
+        && packet->pts - recorder->segment_start_pts
+            >= SC_TICK_TO_US(recorder->segment_duration);
 }
 
 static inline bool
 sc_recorder_must_wait_for_config_packets(struct sc_recorder *recorder) {
-    if (recorder->video && sc_vecdeque_is_empty(&recorder->video_queue)) {
+    if (recorder->video && sc_recorder_video_queue_is_empty(recorder)) {
         // The video queue is empty
         return true;
     }
 
     if (recorder->audio && recorder->audio_expects_config_packet
-            && sc_vecdeque_is_empty(&recorder->audio_queue)) {
+            && sc_recorder_audio_queue_is_empty(recorder)) {
         // The audio queue is empty (when audio is enabled)
         return true;
     }
@@ -198,7 +537,7 @@ sc_recorder_process_header(struct sc_recorder *recorder) {
         sc_cond_wait(&recorder->cond, &recorder->mutex);
     }
 
-    if (recorder->video && sc_vecdeque_is_empty(&recorder->video_queue)) {
+    if (recorder->video && sc_recorder_video_queue_is_empty(recorder)) {
         assert(recorder->stopped);
         // If the recorder is stopped, don't process anything if there are not
         // at least video packets
@@ -206,23 +545,34 @@ sc_recorder_process_header(struct sc_recorder *recorder) {
         return false;
     }
 
+    bool dequeued = true;
+
     AVPacket *video_pkt = NULL;
-    if (!sc_vecdeque_is_empty(&recorder->video_queue)) {
+    if (!sc_recorder_video_queue_is_empty(recorder)) {
         assert(recorder->video);
-        video_pkt = sc_vecdeque_pop(&recorder->video_queue);
+        video_pkt = sc_recorder_dequeue(recorder, &recorder->video_queue,
+                                        &recorder->video_spill);
+        dequeued = video_pkt;
     }
 
     AVPacket *audio_pkt = NULL;
-    if (recorder->audio_expects_config_packet &&
-            !sc_vecdeque_is_empty(&recorder->audio_queue)) {
+    if (dequeued && recorder->audio_expects_config_packet &&
+            !sc_recorder_audio_queue_is_empty(recorder)) {
         assert(recorder->audio);
-        audio_pkt = sc_vecdeque_pop(&recorder->audio_queue);
+        audio_pkt = sc_recorder_dequeue(recorder, &recorder->audio_queue,
+                                        &recorder->audio_spill);
+        dequeued = audio_pkt;
     }
 
     sc_mutex_unlock(&recorder->mutex);
 
     int ret = false;
 
+    if (!dequeued) {
+        // Error already logged
+        goto end;
+    }
+
     if (video_pkt) {
         if (video_pkt->pts != AV_NOPTS_VALUE) {
             LOGE("The first video packet is not a config packet");
@@ -253,7 +603,7 @@ sc_recorder_process_header(struct sc_recorder *recorder) {
         }
     }
 
-    bool ok = avformat_write_header(recorder->ctx, NULL) >= 0;
+    bool ok = sc_recorder_write_header(recorder);
     if (!ok) {
         LOGE("Failed to write header to %s", recorder->filename);
         goto end;
@@ -288,6 +638,11 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
     // we can set its duration (next_pts - current_pts)
     AVPacket *video_pkt_previous = NULL;
 
+    // In low latency mode, the video packets are written immediately, with
+    // the duration of the previous frame interval
+    int64_t last_video_pts = AV_NOPTS_VALUE;
+    int64_t video_duration = SC_RECORDER_DEFAULT_VIDEO_DURATION;
+
     bool error = false;
 
     for (;;) {
@@ -295,12 +650,12 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
 
         while (!recorder->stopped) {
             if (recorder->video && !video_pkt &&
-                    !sc_vecdeque_is_empty(&recorder->video_queue)) {
+                    !sc_recorder_video_queue_is_empty(recorder)) {
                 // A new packet may be assigned to video_pkt and be processed
                 break;
             }
             if (recorder->audio && !audio_pkt
-                    && !sc_vecdeque_is_empty(&recorder->audio_queue)) {
+                    && !sc_recorder_audio_queue_is_empty(recorder)) {
                 // A new packet may be assigned to audio_pkt and be processed
                 break;
             }
@@ -313,35 +668,53 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
         // If there is no video, then the video_queue will remain empty forever
         // and video_pkt will always be NULL.
         assert(recorder->video || (!video_pkt
-                && sc_vecdeque_is_empty(&recorder->video_queue)));
+                && sc_recorder_video_queue_is_empty(recorder)));
 
         // If there is no audio, then the audio_queue will remain empty forever
         // and audio_pkt will always be NULL.
         assert(recorder->audio || (!audio_pkt
-                && sc_vecdeque_is_empty(&recorder->audio_queue)));
+                && sc_recorder_audio_queue_is_empty(recorder)));
+
+        bool dequeued = true;
+
+        if (!video_pkt && !sc_recorder_video_queue_is_empty(recorder)) {
+            video_pkt = sc_recorder_dequeue(recorder, &recorder->video_queue,
+                                            &recorder->video_spill);
+            dequeued = video_pkt;
+        }
 
-        if (!video_pkt && !sc_vecdeque_is_empty(&recorder->video_queue)) {
-            video_pkt = sc_vecdeque_pop(&recorder->video_queue);
+        if (dequeued && !audio_pkt
+                && !sc_recorder_audio_queue_is_empty(recorder)) {
+            audio_pkt = sc_recorder_dequeue(recorder, &recorder->audio_queue,
+                                            &recorder->audio_spill);
+            dequeued = audio_pkt;
         }
 
-        if (!audio_pkt && !sc_vecdeque_is_empty(&recorder->audio_queue)) {
-            audio_pkt = sc_vecdeque_pop(&recorder->audio_queue);
+        if (!dequeued) {
+            // Error already logged
+            sc_mutex_unlock(&recorder->mutex);
+            if (video_pkt_previous) {
+                av_packet_free(&video_pkt_previous);
+            }
+            error = true;
+            goto end;
         }
 
         if (recorder->stopped && !video_pkt && !audio_pkt) {
-            assert(sc_vecdeque_is_empty(&recorder->video_queue));
-            assert(sc_vecdeque_is_empty(&recorder->audio_queue));
+            assert(sc_recorder_video_queue_is_empty(recorder));
+            assert(sc_recorder_audio_queue_is_empty(recorder));
             sc_mutex_unlock(&recorder->mutex);
             break;
         }
 
         assert(video_pkt || audio_pkt); // at least one
 
+        sc_recorder_update_stats(recorder);
         sc_mutex_unlock(&recorder->mutex);
 
         // Ignore further config packets (e.g. on device orientation
         // change). The next non-config packet will have the config packet
-        // data prepended.
+        // data attached (and prepended on write).
         if (video_pkt && video_pkt->pts == AV_NOPTS_VALUE) {
             av_packet_free(&video_pkt);
             video_pkt = NULL;
@@ -397,7 +770,36 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
                 }
             }
 
-            video_pkt_previous = video_pkt;
+            if (sc_recorder_must_cut_segment(recorder, video_pkt)) {
+                bool ok = sc_recorder_next_segment(recorder, video_pkt->pts);
+                if (!ok) {
+                    LOGE("Could not start a new recording segment");
+                    error = true;
+                    goto end;
+                }
+            }
+
+            if (recorder->low_latency) {
+                // Within a fragment, the muxer computes the actual duration
+                // of each sample from the next timestamp, so only the last
+                // sample of a fragment (or segment) keeps the estimation
+                if (last_video_pts != AV_NOPTS_VALUE
+                        && video_pkt->pts > last_video_pts) {
+                    video_duration = video_pkt->pts - last_video_pts;
+                }
+                last_video_pts = video_pkt->pts;
+                video_pkt->duration = video_duration;
+
+                bool ok = sc_recorder_write_video(recorder, video_pkt);
+                av_packet_free(&video_pkt);
+                if (!ok) {
+                    LOGE("Could not record video packet");
+                    error = true;
+                    goto end;
+                }
+            } else {
+                video_pkt_previous = video_pkt;
+            }
             video_pkt = NULL;
         }
 
@@ -451,13 +853,17 @@ end:
 
 static bool
 sc_recorder_record(struct sc_recorder *recorder) {
-    bool ok = sc_recorder_open_output_file(recorder);
+    bool ok = sc_recorder_open_segment(recorder, 0);
     if (!ok) {
         return false;
     }
 
     ok = sc_recorder_process_packets(recorder);
-    sc_recorder_close_output_file(recorder);
+    bool closed = sc_recorder_close_output_file(recorder);
+    ok = closed && ok;
+    if (ok) {
+        sc_recorder_notify_file_completed(recorder, recorder->segment_index);
+    }
     return ok;
 }
 
@@ -469,6 +875,8 @@ run_recorder(void *data) {
     bool ok = sc_thread_set_priority(SC_THREAD_PRIORITY_LOW);
     (void) ok; // We don't care if it worked
 
+    sc_trace_thread_name("recorder");
+
     bool success = sc_recorder_record(recorder);
 
     sc_mutex_lock(&recorder->mutex);
@@ -477,8 +885,15 @@ run_recorder(void *data) {
     // Discard pending packets
     sc_recorder_queue_clear(&recorder->video_queue);
     sc_recorder_queue_clear(&recorder->audio_queue);
+    sc_packet_spill_clear(&recorder->video_spill);
+    sc_packet_spill_clear(&recorder->audio_spill);
+    recorder->queue_bytes = 0;
+    size_t peak_queue_bytes = recorder->peak_queue_bytes;
     sc_mutex_unlock(&recorder->mutex);
 
+    LOGI("Recorder queue peak: %" SC_PRIsizet " bytes in memory",
+         peak_queue_bytes);
+
     if (success) {
         const char *format_name = sc_recorder_get_format_name(recorder->format);
         LOGI("Recording complete to %s file: %s", format_name,
@@ -494,42 +909,6 @@ run_recorder(void *data) {
     return 0;
 }
 
-static bool
-sc_recorder_set_orientation(AVStream *stream, enum sc_orientation orientation) {
-    assert(!sc_orientation_is_mirror(orientation));
-
-    uint8_t *raw_data;
-#ifdef SCRCPY_LAVC_HAS_CODECPAR_CODEC_SIDEDATA
-    AVPacketSideData *sd =
-        av_packet_side_data_new(&stream->codecpar->coded_side_data,
-                                &stream->codecpar->nb_coded_side_data,
-                                AV_PKT_DATA_DISPLAYMATRIX,
-                                sizeof(int32_t) * 9, 0);
-    if (!sd) {
-        LOG_OOM();
-        return false;
-    }
-
-    raw_data = sd->data;
-#else
-    raw_data = av_stream_new_side_data(stream, AV_PKT_DATA_DISPLAYMATRIX,
-                                      sizeof(int32_t) * 9);
-    if (!raw_data) {
-        LOG_OOM();
-        return false;
-    }
-#endif
-
-    int32_t *matrix = (int32_t *) raw_data;
-
-    unsigned rotation = orientation;
-    unsigned angle = rotation * 90;
-
-    av_display_rotation_set(matrix, angle);
-
-    return true;
-}
-
 static bool
 sc_recorder_video_packet_sink_open(struct sc_packet_sink *sink,
                                    AVCodecContext *ctx) {
@@ -574,6 +953,25 @@ sc_recorder_video_packet_sink_open(struct sc_packet_sink *sink,
     return true;
 }
 
+static void
+sc_recorder_check_keyframe(struct sc_recorder *recorder,
+                           const AVPacket *packet) {
+    if (packet->pts == AV_NOPTS_VALUE) {
+        // config packet
+        return;
+    }
+
+    if (packet->flags & AV_PKT_FLAG_KEY) {
+        recorder->next_keyframe_pts =
+            packet->pts + SC_RECORDER_KEYFRAME_INTERVAL;
+    } else if (packet->pts >= recorder->next_keyframe_pts) {
+        // Request again later if the keyframe does not come
+        recorder->next_keyframe_pts =
+            packet->pts + SC_RECORDER_KEYFRAME_INTERVAL;
+        recorder->cbs->on_keyframe_needed(recorder, recorder->cbs_userdata);
+    }
+}
+
 static void
 sc_recorder_video_packet_sink_close(struct sc_packet_sink *sink) {
     struct sc_recorder *recorder = DOWNCAST_VIDEO(sink);
@@ -594,6 +992,10 @@ sc_recorder_video_packet_sink_push(struct sc_packet_sink *sink,
     // only written from this thread, no need to lock
     assert(recorder->video_init);
 
+    if (recorder->cbs->on_keyframe_needed) {
+        sc_recorder_check_keyframe(recorder, packet);
+    }
+
     sc_mutex_lock(&recorder->mutex);
 
     if (recorder->stopped) {
@@ -611,13 +1013,15 @@ sc_recorder_video_packet_sink_push(struct sc_packet_sink *sink,
 
     rec->stream_index = recorder->video_stream.index;
 
-    bool ok = sc_vecdeque_push(&recorder->video_queue, rec);
+    bool ok = sc_recorder_enqueue(recorder, &recorder->video_queue,
+                                  &recorder->video_spill, rec);
     if (!ok) {
-        LOG_OOM();
+        // Error already logged
         sc_mutex_unlock(&recorder->mutex);
         return false;
     }
 
+    sc_recorder_update_stats(recorder);
     sc_cond_signal(&recorder->cond);
 
     sc_mutex_unlock(&recorder->mutex);
@@ -698,13 +1102,15 @@ sc_recorder_audio_packet_sink_push(struct sc_packet_sink *sink,
 
     rec->stream_index = recorder->audio_stream.index;
 
-    bool ok = sc_vecdeque_push(&recorder->audio_queue, rec);
+    bool ok = sc_recorder_enqueue(recorder, &recorder->audio_queue,
+                                  &recorder->audio_spill, rec);
     if (!ok) {
-        LOG_OOM();
+        // Error already logged
         sc_mutex_unlock(&recorder->mutex);
         return false;
     }
 
+    sc_recorder_update_stats(recorder);
     sc_cond_signal(&recorder->cond);
 
     sc_mutex_unlock(&recorder->mutex);
@@ -736,7 +1142,10 @@ sc_recorder_stream_init(struct sc_recorder_stream *stream) {
 bool
 sc_recorder_init(struct sc_recorder *recorder, const char *filename,
                  enum sc_record_format format, bool video, bool audio,
-                 enum sc_orientation orientation,
+                 enum sc_orientation orientation, bool fragmented,
+                 bool low_latency, size_t queue_limit, size_t write_buffer_size,
+                 sc_tick segment_duration, unsigned segment_count,
+                 struct sc_stats *stats,
                  const struct sc_recorder_callbacks *cbs, void *cbs_userdata) {
     assert(!sc_orientation_is_mirror(orientation));
 
@@ -761,11 +1170,26 @@ sc_recorder_init(struct sc_recorder *recorder, const char *filename,
     recorder->audio = audio;
 
     recorder->orientation = orientation;
+    recorder->fragmented = fragmented;
+    recorder->low_latency = low_latency;
 
     sc_vecdeque_init(&recorder->video_queue);
     sc_vecdeque_init(&recorder->audio_queue);
     recorder->stopped = false;
 
+    recorder->queue_limit = queue_limit;
+    recorder->queue_bytes = 0;
+    recorder->peak_queue_bytes = 0;
+    sc_packet_spill_init(&recorder->video_spill);
+    sc_packet_spill_init(&recorder->audio_spill);
+
+    recorder->write_buffer_size = write_buffer_size;
+
+    recorder->segment_duration = segment_duration;
+    recorder->segment_count = segment_count;
+    recorder->segment_index = 0;
+    recorder->segment_start_pts = 0;
+
     recorder->video_init = false;
     recorder->audio_init = false;
 
@@ -774,7 +1198,11 @@ sc_recorder_init(struct sc_recorder *recorder, const char *filename,
     sc_recorder_stream_init(&recorder->video_stream);
     sc_recorder_stream_init(&recorder->audio_stream);
 
+    // The first video packet is a keyframe
+    recorder->next_keyframe_pts = 0;
+
     recorder->format = format;
+    recorder->stats = stats;
 
     assert(cbs && cbs->on_ended);
     recorder->cbs = cbs;
@@ -838,6 +1266,8 @@ sc_recorder_join(struct sc_recorder *recorder) {
 
 void
 sc_recorder_destroy(struct sc_recorder *recorder) {
+    sc_packet_spill_destroy(&recorder->video_spill);
+    sc_packet_spill_destroy(&recorder->audio_spill);
     sc_cond_destroy(&recorder->cond);
     sc_mutex_destroy(&recorder->mutex);
     free(recorder->filename);
@@ -8,10 +8,16 @@
 
 #include "coords.h"
 #include "options.h"
+#include "packet_spill.h"
+#include "stats.h"
 #include "trait/packet_sink.h"
 #include "util/thread.h"
+#include "util/tick.h"
 #include "util/vecdeque.h"
 
+// In microseconds (the unit of the packets pts)
+#define SC_RECORDER_KEYFRAME_INTERVAL INT64_C(10000000)
+
 struct sc_recorder_queue SC_VECDEQUE(AVPacket *);
 
 struct sc_recorder_stream {
@@ -35,6 +41,11 @@ struct sc_recorder {
     bool video;
 
     enum sc_orientation orientation;
+    // Write a fragmented MP4 (only for MP4 formats)
+    bool fragmented;
+    // Write the video packets immediately, with an estimated duration, rather
+    // than waiting for the next packet to know it
+    bool low_latency;
 
     char *filename;
     enum sc_record_format format;
@@ -48,6 +59,28 @@ struct sc_recorder {
     struct sc_recorder_queue video_queue;
     struct sc_recorder_queue audio_queue;
 
+    // If not 0, once the packets queued in memory reach this size (in bytes),
+    // the next packets are spilled to temporary files until the recorder
+    // catches up (e.g. if the disk stalls)
+    size_t queue_limit;
+    size_t queue_bytes; // size of the packets queued in memory
+    size_t peak_queue_bytes;
+    struct sc_packet_spill video_spill;
+    struct sc_packet_spill audio_spill;
+
+    // If not 0, the output file is written from a separate thread, through a
+    // memory buffer of this size (in bytes), so that the muxing does not wait
+    // for the disk
+    size_t write_buffer_size;
+
+    // If not 0, the recording is split into numbered segments of (at least)
+    // this duration, cut on video keyframes
+    sc_tick segment_duration;
+    unsigned segment_count; // number of most recent segments to keep, or 0
+    // Only accessed from the recorder thread
+    unsigned segment_index;
+    int64_t segment_start_pts; // relative to the recording start
+
     // wake up the recorder thread once the video or audio codec is known
     bool video_init;
     bool audio_init;
@@ -57,6 +90,11 @@ struct sc_recorder {
     struct sc_recorder_stream video_stream;
     struct sc_recorder_stream audio_stream;
 
+    // Only accessed from the video packet sink (the demuxer thread)
+    int64_t next_keyframe_pts;
+
+    struct sc_stats *stats; // may be NULL
+
     const struct sc_recorder_callbacks *cbs;
     void *cbs_userdata;
 };
@@ -64,12 +102,25 @@ struct sc_recorder {
 struct sc_recorder_callbacks {
     void (*on_ended)(struct sc_recorder *recorder, bool success,
                      void *userdata);
+
+    // Called (from the demuxer thread) when no video keyframe has been
+    // received for SC_RECORDER_KEYFRAME_INTERVAL, for example if the encoder
+    // uses intra refresh, to keep the recording seekable (may be NULL)
+    void (*on_keyframe_needed)(struct sc_recorder *recorder, void *userdata);
+
+    // Called (from the recorder thread) when a file is complete: each segment
+    // once the next one is started, and the last file on stop (may be NULL)
+    void (*on_file_completed)(struct sc_recorder *recorder,
+                              const char *filename, void *userdata);
 };
 
 bool
 sc_recorder_init(struct sc_recorder *recorder, const char *filename,
                  enum sc_record_format format, bool video, bool audio,
-                 enum sc_orientation orientation,
+                 enum sc_orientation orientation, bool fragmented,
+                 bool low_latency, size_t queue_limit, size_t write_buffer_size,
+                 sc_tick segment_duration, unsigned segment_count,
+                 struct sc_stats *stats,
                  const struct sc_recorder_callbacks *cbs, void *cbs_userdata);
 
 bool
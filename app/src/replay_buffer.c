@@ -0,0 +1,589 @@
+#include "replay_buffer.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "recorder.h"
+#include "util/file.h"
+#include "util/log.h"
+
+/** Downcast packet sinks to replay buffer */
+#define DOWNCAST_VIDEO(SINK) \
+    container_of(SINK, struct sc_replay_buffer, video_packet_sink)
+#define DOWNCAST_AUDIO(SINK) \
+    container_of(SINK, struct sc_replay_buffer, audio_packet_sink)
+
+static void
+sc_replay_buffer_stream_init(struct sc_replay_buffer_stream *stream) {
+    stream->codec = NULL;
+    stream->params = NULL;
+    stream->config = NULL;
+    sc_vecdeque_init(&stream->queue);
+}
+
+static void
+sc_replay_buffer_stream_destroy(struct sc_replay_buffer_stream *stream) {
+    while (!sc_vecdeque_is_empty(&stream->queue)) {
+        AVPacket *packet = sc_vecdeque_pop(&stream->queue);
+        av_packet_free(&packet);
+    }
+    sc_vecdeque_destroy(&stream->queue);
+    av_packet_free(&stream->config);
+    avcodec_parameters_free(&stream->params);
+}
+
+static bool
+sc_replay_buffer_stream_open(struct sc_replay_buffer *rb,
+                             struct sc_replay_buffer_stream *stream,
+                             AVCodecContext *ctx) {
+    AVCodecParameters *params = avcodec_parameters_alloc();
+    if (!params) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (avcodec_parameters_from_context(params, ctx) < 0) {
+        LOGE("Replay buffer: could not copy the codec parameters");
+        avcodec_parameters_free(&params);
+        return false;
+    }
+
+    sc_mutex_lock(&rb->mutex);
+    stream->codec = ctx->codec;
+    stream->params = params;
+    sc_mutex_unlock(&rb->mutex);
+
+    return true;
+}
+
+static bool
+sc_replay_buffer_stream_set_config(struct sc_replay_buffer_stream *stream,
+                                   const AVPacket *packet) {
+    AVPacket *config = av_packet_clone(packet);
+    if (!config) {
+        LOG_OOM();
+        return false;
+    }
+
+    av_packet_free(&stream->config);
+    stream->config = config;
+    return true;
+}
+
+static bool
+sc_replay_buffer_stream_push(struct sc_replay_buffer_stream *stream,
+                             const AVPacket *packet) {
+    AVPacket *p = av_packet_clone(packet);
+    if (!p) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (!sc_vecdeque_push(&stream->queue, p)) {
+        LOG_OOM();
+        av_packet_free(&p);
+        return false;
+    }
+
+    return true;
+}
+
+static void
+sc_replay_buffer_stream_pop(struct sc_replay_buffer_stream *stream) {
+    AVPacket *packet = sc_vecdeque_pop(&stream->queue);
+    if (packet->pts == AV_NOPTS_VALUE) {
+        // The packets still queued depend on this config packet
+        av_packet_free(&stream->config);
+        stream->config = packet;
+    } else {
+        av_packet_free(&packet);
+    }
+}
+
+// must be called with mutex locked
+static void
+sc_replay_buffer_trim_audio(struct sc_replay_buffer *rb, int64_t min_pts) {
+    struct sc_replay_buffer_stream *audio = &rb->audio;
+
+    if (sc_vecdeque_is_empty(&rb->video.queue)) {
+        // No video to replay yet, the audio packets are useless
+        while (!sc_vecdeque_is_empty(&audio->queue)) {
+            sc_replay_buffer_stream_pop(audio);
+        }
+        return;
+    }
+
+    AVPacket *first_video = *sc_vecdeque_peek(&rb->video.queue);
+    int64_t start = MAX(first_video->pts, min_pts);
+
+    while (!sc_vecdeque_is_empty(&audio->queue)) {
+        AVPacket *packet = *sc_vecdeque_peek(&audio->queue);
+        if (packet->pts != AV_NOPTS_VALUE && packet->pts >= start) {
+            break;
+        }
+        sc_replay_buffer_stream_pop(audio);
+    }
+}
+
+// must be called with mutex locked
+static void
+sc_replay_buffer_trim_video(struct sc_replay_buffer *rb, int64_t last_pts) {
+    struct sc_replay_buffer_stream *video = &rb->video;
+    int64_t limit = last_pts - SC_TICK_TO_US(rb->duration);
+
+    // Only cut on keyframes, while the remaining packets still cover the
+    // requested duration
+    while (!sc_vecdeque_is_empty(&rb->keyframes)
+            && *sc_vecdeque_peek(&rb->keyframes) <= limit) {
+        int64_t cut = sc_vecdeque_pop(&rb->keyframes);
+        for (;;) {
+            AVPacket *packet = *sc_vecdeque_peek(&video->queue);
+            if (packet->pts == cut && (packet->flags & AV_PKT_FLAG_KEY)) {
+                break;
+            }
+            sc_replay_buffer_stream_pop(video);
+        }
+    }
+
+    sc_replay_buffer_trim_audio(rb, INT64_MIN);
+}
+
+static bool
+sc_replay_buffer_video_packet_sink_open(struct sc_packet_sink *sink,
+                                        AVCodecContext *ctx) {
+    struct sc_replay_buffer *rb = DOWNCAST_VIDEO(sink);
+    return sc_replay_buffer_stream_open(rb, &rb->video, ctx);
+}
+
+static void
+sc_replay_buffer_video_packet_sink_close(struct sc_packet_sink *sink) {
+    // Keep the packets, a replay may still be saved
+    (void) sink;
+}
+
+static bool
+sc_replay_buffer_video_packet_sink_push(struct sc_packet_sink *sink,
+                                        const AVPacket *packet) {
+    struct sc_replay_buffer *rb = DOWNCAST_VIDEO(sink);
+    struct sc_replay_buffer_stream *video = &rb->video;
+
+    bool is_config = packet->pts == AV_NOPTS_VALUE;
+    bool is_key = packet->flags & AV_PKT_FLAG_KEY;
+
+    sc_mutex_lock(&rb->mutex);
+
+    bool ok;
+    if (sc_vecdeque_is_empty(&video->queue)) {
+        if (is_config) {
+            ok = sc_replay_buffer_stream_set_config(video, packet);
+        } else if (is_key) {
+            // The queue must start on a keyframe
+            ok = sc_replay_buffer_stream_push(video, packet);
+        } else {
+            // Drop the packets until the first keyframe
+            ok = true;
+        }
+    } else {
+        ok = sc_replay_buffer_stream_push(video, packet);
+        if (ok && !is_config && is_key) {
+            ok = sc_vecdeque_push(&rb->keyframes, packet->pts);
+            if (ok) {
+                sc_replay_buffer_trim_video(rb, packet->pts);
+            } else {
+                LOG_OOM();
+            }
+        }
+    }
+
+    sc_mutex_unlock(&rb->mutex);
+
+    return ok;
+}
+
+static bool
+sc_replay_buffer_audio_packet_sink_open(struct sc_packet_sink *sink,
+                                        AVCodecContext *ctx) {
+    struct sc_replay_buffer *rb = DOWNCAST_AUDIO(sink);
+    return sc_replay_buffer_stream_open(rb, &rb->audio, ctx);
+}
+
+static void
+sc_replay_buffer_audio_packet_sink_close(struct sc_packet_sink *sink) {
+    // Keep the packets, a replay may still be saved
+    (void) sink;
+}
+
+static bool
+sc_replay_buffer_audio_packet_sink_push(struct sc_packet_sink *sink,
+                                        const AVPacket *packet) {
+    struct sc_replay_buffer *rb = DOWNCAST_AUDIO(sink);
+    struct sc_replay_buffer_stream *audio = &rb->audio;
+
+    bool is_config = packet->pts == AV_NOPTS_VALUE;
+
+    sc_mutex_lock(&rb->mutex);
+
+    bool ok;
+    if (is_config && sc_vecdeque_is_empty(&audio->queue)) {
+        ok = sc_replay_buffer_stream_set_config(audio, packet);
+    } else if (!is_config && sc_vecdeque_is_empty(&rb->video.queue)) {
+        // No video to replay yet
+        ok = true;
+    } else {
+        ok = sc_replay_buffer_stream_push(audio, packet);
+        if (ok && !is_config) {
+            // Also bound the audio if no video packets are produced (the
+            // device does not produce video frames while the screen is static)
+            int64_t limit = packet->pts - SC_TICK_TO_US(rb->duration);
+            sc_replay_buffer_trim_audio(rb, limit);
+        }
+    }
+
+    sc_mutex_unlock(&rb->mutex);
+
+    return ok;
+}
+
+bool
+sc_replay_buffer_init(struct sc_replay_buffer *rb, const char *filename,
+                      enum sc_record_format format, sc_tick duration) {
+    assert(duration > 0);
+
+    rb->filename = strdup(filename);
+    if (!rb->filename) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = sc_mutex_init(&rb->mutex);
+    if (!ok) {
+        free(rb->filename);
+        return false;
+    }
+
+    rb->format = format;
+    rb->duration = duration;
+
+    sc_replay_buffer_stream_init(&rb->video);
+    sc_replay_buffer_stream_init(&rb->audio);
+    sc_vecdeque_init(&rb->keyframes);
+
+    rb->save_index = 0;
+    rb->thread_started = false;
+    rb->saving = false;
+    rb->save_filename = NULL;
+
+    static const struct sc_packet_sink_ops video_ops = {
+        .open = sc_replay_buffer_video_packet_sink_open,
+        .close = sc_replay_buffer_video_packet_sink_close,
+        .push = sc_replay_buffer_video_packet_sink_push,
+    };
+
+    rb->video_packet_sink.ops = &video_ops;
+
+    static const struct sc_packet_sink_ops audio_ops = {
+        .open = sc_replay_buffer_audio_packet_sink_open,
+        .close = sc_replay_buffer_audio_packet_sink_close,
+        .push = sc_replay_buffer_audio_packet_sink_push,
+    };
+
+    rb->audio_packet_sink.ops = &audio_ops;
+
+    return true;
+}
+
+// must be called with mutex locked
+static bool
+sc_replay_buffer_stream_copy(struct sc_replay_buffer_stream *dst,
+                             struct sc_replay_buffer_stream *src) {
+    sc_replay_buffer_stream_init(dst);
+
+    if (!src->params) {
+        // The stream is not available
+        return true;
+    }
+
+    dst->codec = src->codec;
+    dst->params = avcodec_parameters_alloc();
+    if (!dst->params) {
+        LOG_OOM();
+        goto error;
+    }
+
+    if (avcodec_parameters_copy(dst->params, src->params) < 0) {
+        LOGE("Replay buffer: could not copy the codec parameters");
+        goto error;
+    }
+
+    if (src->config) {
+        dst->config = av_packet_clone(src->config);
+        if (!dst->config) {
+            LOG_OOM();
+            goto error;
+        }
+    }
+
+    size_t size = sc_vecdeque_size(&src->queue);
+    if (!sc_vecdeque_reserve(&dst->queue, size)) {
+        LOG_OOM();
+        goto error;
+    }
+
+    // Rotate the whole source queue to reference each packet in order (the
+    // packet data are shared, not copied)
+    bool ok = true;
+    for (size_t i = 0; i < size; ++i) {
+        AVPacket *packet = sc_vecdeque_pop(&src->queue);
+        sc_vecdeque_push_noresize(&src->queue, packet);
+
+        if (ok) {
+            AVPacket *p = av_packet_clone(packet);
+            if (p) {
+                sc_vecdeque_push_noresize(&dst->queue, p);
+            } else {
+                LOG_OOM();
+                // Continue to rotate, to keep the source queue order
+                ok = false;
+            }
+        }
+    }
+
+    if (!ok) {
+        goto error;
+    }
+
+    return true;
+
+error:
+    sc_replay_buffer_stream_destroy(dst);
+    return false;
+}
+
+static void
+sc_replay_buffer_on_recorder_ended(struct sc_recorder *recorder, bool success,
+                                   void *userdata) {
+    (void) recorder;
+
+    bool *result = userdata;
+    *result = success;
+}
+
+static AVCodecContext *
+sc_replay_buffer_create_context(const struct sc_replay_buffer_stream *stream) {
+    AVCodecContext *ctx = avcodec_alloc_context3(stream->codec);
+    if (!ctx) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    if (avcodec_parameters_to_context(ctx, stream->params) < 0) {
+        LOGE("Replay buffer: could not create the codec context");
+        avcodec_free_context(&ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+static bool
+sc_replay_buffer_push_stream(struct sc_packet_sink *sink,
+                             struct sc_replay_buffer_stream *stream) {
+    if (stream->config && !sink->ops->push(sink, stream->config)) {
+        return false;
+    }
+
+    while (!sc_vecdeque_is_empty(&stream->queue)) {
+        AVPacket *packet = sc_vecdeque_pop(&stream->queue);
+        bool ok = sink->ops->push(sink, packet);
+        av_packet_free(&packet);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool
+sc_replay_buffer_write(struct sc_replay_buffer *rb) {
+    struct sc_replay_buffer_stream *video = &rb->save_video;
+    struct sc_replay_buffer_stream *audio = &rb->save_audio;
+    bool has_audio = audio->params;
+
+    AVCodecContext *video_ctx = sc_replay_buffer_create_context(video);
+    if (!video_ctx) {
+        return false;
+    }
+
+    AVCodecContext *audio_ctx = NULL;
+    if (has_audio) {
+        audio_ctx = sc_replay_buffer_create_context(audio);
+        if (!audio_ctx) {
+            avcodec_free_context(&video_ctx);
+            return false;
+        }
+    }
+
+    static const struct sc_recorder_callbacks cbs = {
+        .on_ended = sc_replay_buffer_on_recorder_ended,
+    };
+
+    // The replay is written by a temporary recorder, fed synchronously
+    bool success = false;
+    struct sc_recorder recorder;
+    bool ok = sc_recorder_init(&recorder, rb->save_filename, rb->format, true,
+                               has_audio, SC_ORIENTATION_0, false, false, 0, 0,
+                               0, 0, NULL, &cbs, &success);
+    if (!ok) {
+        goto free_contexts;
+    }
+
+    ok = sc_recorder_start(&recorder);
+    if (!ok) {
+        goto destroy_recorder;
+    }
+
+    struct sc_packet_sink *video_sink = &recorder.video_packet_sink;
+    struct sc_packet_sink *audio_sink = &recorder.audio_packet_sink;
+
+    // Both streams must be open before the recorder writes the header
+    ok = video_sink->ops->open(video_sink, video_ctx);
+    if (!ok) {
+        sc_recorder_stop(&recorder);
+        goto join_recorder;
+    }
+
+    if (has_audio) {
+        ok = audio_sink->ops->open(audio_sink, audio_ctx);
+        if (!ok) {
+            video_sink->ops->close(video_sink);
+            goto join_recorder;
+        }
+    }
+
+    ok = sc_replay_buffer_push_stream(video_sink, video);
+    if (ok && has_audio) {
+        ok = sc_replay_buffer_push_stream(audio_sink, audio);
+    }
+
+    // Closing the sinks stops the recorder once all the packets are written
+    if (has_audio) {
+        audio_sink->ops->close(audio_sink);
+    }
+    video_sink->ops->close(video_sink);
+
+join_recorder:
+    sc_recorder_join(&recorder);
+destroy_recorder:
+    sc_recorder_destroy(&recorder);
+free_contexts:
+    avcodec_free_context(&audio_ctx);
+    avcodec_free_context(&video_ctx);
+
+    return ok && success;
+}
+
+static int
+run_replay_buffer_save(void *data) {
+    struct sc_replay_buffer *rb = data;
+
+    if (!sc_replay_buffer_write(rb)) {
+        LOGE("Could not save replay to %s", rb->save_filename);
+    }
+
+    sc_replay_buffer_stream_destroy(&rb->save_video);
+    sc_replay_buffer_stream_destroy(&rb->save_audio);
+    free(rb->save_filename);
+    rb->save_filename = NULL;
+
+    sc_mutex_lock(&rb->mutex);
+    rb->saving = false;
+    sc_mutex_unlock(&rb->mutex);
+
+    return 0;
+}
+
+bool
+sc_replay_buffer_save(struct sc_replay_buffer *rb) {
+    sc_mutex_lock(&rb->mutex);
+    bool saving = rb->saving;
+    bool empty = sc_vecdeque_is_empty(&rb->video.queue);
+    sc_mutex_unlock(&rb->mutex);
+
+    if (saving) {
+        LOGW("A replay is already being saved");
+        return false;
+    }
+
+    if (empty) {
+        LOGW("No video to replay yet");
+        return false;
+    }
+
+    // The previous saving thread, if any, has finished
+    sc_replay_buffer_join(rb);
+
+    char *filename = sc_file_get_numbered_path(rb->filename, rb->save_index);
+    if (!filename) {
+        return false;
+    }
+
+    sc_mutex_lock(&rb->mutex);
+    bool ok = sc_replay_buffer_stream_copy(&rb->save_video, &rb->video);
+    if (ok) {
+        ok = sc_replay_buffer_stream_copy(&rb->save_audio, &rb->audio);
+        if (!ok) {
+            sc_replay_buffer_stream_destroy(&rb->save_video);
+        }
+    }
+    rb->saving = ok;
+    sc_mutex_unlock(&rb->mutex);
+
+    if (!ok) {
+        free(filename);
+        return false;
+    }
+
+    rb->save_filename = filename;
+
+    ok = sc_thread_create(&rb->thread, run_replay_buffer_save,
+                          "scrcpy-replay", rb);
+    if (!ok) {
+        LOGE("Could not start replay thread");
+        sc_replay_buffer_stream_destroy(&rb->save_video);
+        sc_replay_buffer_stream_destroy(&rb->save_audio);
+        free(rb->save_filename);
+        rb->save_filename = NULL;
+
+        sc_mutex_lock(&rb->mutex);
+        rb->saving = false;
+        sc_mutex_unlock(&rb->mutex);
+        return false;
+    }
+
+    rb->thread_started = true;
+    ++rb->save_index;
+
+    return true;
+}
+
+void
+sc_replay_buffer_join(struct sc_replay_buffer *rb) {
+    if (rb->thread_started) {
+        sc_thread_join(&rb->thread, NULL);
+        rb->thread_started = false;
+    }
+}
+
+void
+sc_replay_buffer_destroy(struct sc_replay_buffer *rb) {
+    assert(!rb->thread_started);
+
+    sc_vecdeque_destroy(&rb->keyframes);
+    sc_replay_buffer_stream_destroy(&rb->audio);
+    sc_replay_buffer_stream_destroy(&rb->video);
+    sc_mutex_destroy(&rb->mutex);
+    free(rb->filename);
+}
@@ -0,0 +1,84 @@
+#ifndef SC_REPLAY_BUFFER_H
+#define SC_REPLAY_BUFFER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <libavcodec/avcodec.h>
+
+#include "options.h"
+#include "trait/packet_sink.h"
+#include "util/thread.h"
+#include "util/tick.h"
+#include "util/vecdeque.h"
+
+struct sc_replay_buffer_queue SC_VECDEQUE(AVPacket *);
+
+struct sc_replay_buffer_stream {
+    // Set on packet sink open, NULL if the stream is not (yet) available
+    const AVCodec *codec;
+    AVCodecParameters *params;
+
+    // The last config packet received before the first queued packet (may be
+    // NULL)
+    AVPacket *config;
+    struct sc_replay_buffer_queue queue;
+};
+
+/**
+ * Keep the most recent packets in memory, to save them to a file on request
+ * ("instant replay")
+ *
+ * The video queue always starts on a keyframe, so that a saved replay is
+ * decodable from its first packet.
+ */
+struct sc_replay_buffer {
+    struct sc_packet_sink video_packet_sink;
+    struct sc_packet_sink audio_packet_sink;
+
+    // The replays are saved to numbered files derived from this filename
+    char *filename;
+    enum sc_record_format format;
+    // Minimum duration of the packets to keep
+    sc_tick duration;
+
+    sc_mutex mutex;
+    struct sc_replay_buffer_stream video;
+    struct sc_replay_buffer_stream audio;
+    // pts of the queued video keyframes, except the first one (the next
+    // possible cuts)
+    struct SC_VECDEQUE(int64_t) keyframes;
+
+    // Only accessed from the caller of sc_replay_buffer_save()
+    unsigned save_index;
+    bool thread_started;
+    sc_thread thread;
+    // Set while a replay is being saved (protected by the mutex)
+    bool saving;
+
+    // Copy of the streams to write, owned by the saving thread
+    char *save_filename;
+    struct sc_replay_buffer_stream save_video;
+    struct sc_replay_buffer_stream save_audio;
+};
+
+bool
+sc_replay_buffer_init(struct sc_replay_buffer *rb, const char *filename,
+                      enum sc_record_format format, sc_tick duration);
+
+/**
+ * Save the current content of the buffer to a new file, asynchronously
+ *
+ * Return false if the saving could not be started (for example if a replay is
+ * already being saved).
+ */
+bool
+sc_replay_buffer_save(struct sc_replay_buffer *rb);
+
+void
+sc_replay_buffer_join(struct sc_replay_buffer *rb);
+
+void
+sc_replay_buffer_destroy(struct sc_replay_buffer *rb);
+
+#endif
@@ -0,0 +1,1165 @@
+#include "restreamer.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+# include <signal.h>
+#endif
+#include <libavutil/mem.h>
+
+#include "packet_merger.h"
+#include "util/log.h"
+#include "util/net_intr.h"
+#include "util/str.h"
+#include "util/trace.h"
+
+/** Downcast packet sinks to restreamer */
+#define DOWNCAST_VIDEO(SINK) \
+    container_of(SINK, struct sc_restreamer, video_packet_sink)
+#define DOWNCAST_AUDIO(SINK) \
+    container_of(SINK, struct sc_restreamer, audio_packet_sink)
+
+// Size of the buffer between the muxer and a TCP client
+#define SC_RESTREAMER_AVIO_BUFFER_SIZE (32 * 1024)
+
+static const AVRational SCRCPY_TIME_BASE = {1, 1000000}; // timestamps in us
+
+static const char *
+sc_restreamer_get_format_name(enum sc_restream_format format) {
+    switch (format) {
+        case SC_RESTREAM_FORMAT_MPEGTS:
+            return "mpegts";
+        case SC_RESTREAM_FORMAT_RTSP:
+            return "rtsp";
+        default:
+            assert(!"unexpected restream format");
+            return NULL;
+    }
+}
+
+static void
+sc_restreamer_queue_clear(struct sc_restreamer_queue *queue) {
+    while (!sc_vecdeque_is_empty(queue)) {
+        AVPacket *p = sc_vecdeque_pop(queue);
+        av_packet_free(&p);
+    }
+}
+
+// must be called with mutex locked
+// The stream_index of the queued packets is 0 for video, 1 for audio
+static bool
+sc_restreamer_queue_push(struct sc_restreamer_queue *queue, bool video,
+                         const AVPacket *packet) {
+    AVPacket *p = av_packet_clone(packet);
+    if (!p) {
+        LOG_OOM();
+        return false;
+    }
+
+    p->stream_index = video ? 0 : 1;
+
+    if (!sc_vecdeque_push(queue, p)) {
+        LOG_OOM();
+        av_packet_free(&p);
+        return false;
+    }
+
+    return true;
+}
+
+static inline bool
+sc_restreamer_stream_is_ready(struct sc_restreamer_stream *stream) {
+    return stream->params && (!stream->expects_config || stream->config);
+}
+
+// must be called with mutex locked
+static bool
+sc_restreamer_is_ready(struct sc_restreamer *restreamer) {
+    if (restreamer->video && (!restreamer->video_init
+            || !sc_restreamer_stream_is_ready(&restreamer->video_stream))) {
+        return false;
+    }
+
+    if (restreamer->audio && (!restreamer->audio_init
+            || !sc_restreamer_stream_is_ready(&restreamer->audio_stream))) {
+        return false;
+    }
+
+    return true;
+}
+
+static int
+sc_restreamer_viewer_interrupt_cb(void *opaque) {
+    struct sc_restreamer_viewer *viewer = opaque;
+    return atomic_load_explicit(&viewer->interrupted, memory_order_relaxed);
+}
+
+#ifdef SCRCPY_LAVF_HAS_AVIO_WRITE_CONST
+static int
+sc_restreamer_viewer_write_packet(void *opaque, const uint8_t *buf,
+                                  int buf_size) {
+#else
+static int
+sc_restreamer_viewer_write_packet(void *opaque, uint8_t *buf, int buf_size) {
+#endif
+    struct sc_restreamer_viewer *viewer = opaque;
+
+    ssize_t w = net_send_all(viewer->socket, buf, buf_size);
+    if (w != buf_size) {
+        // Disconnected
+        return AVERROR(EPIPE);
+    }
+
+    return buf_size;
+}
+
+// must be called with mutex locked
+static void
+sc_restreamer_viewer_stop(struct sc_restreamer_viewer *viewer) {
+    viewer->stopped = true;
+    // Unblock the pending network calls
+    atomic_store_explicit(&viewer->interrupted, true, memory_order_relaxed);
+    if (viewer->socket != SC_SOCKET_NONE) {
+        net_interrupt(viewer->socket);
+    }
+    sc_cond_signal(&viewer->cond);
+}
+
+// must be called with mutex locked
+static void
+sc_restreamer_viewer_clear(struct sc_restreamer_viewer *viewer) {
+    struct sc_restreamer *restreamer = viewer->restreamer;
+    sc_restreamer_queue_clear(&viewer->queue);
+    sc_stats_add(restreamer->stats, SC_STAT_RESTREAM_QUEUE_BYTES,
+                 -(int64_t) viewer->queue_bytes);
+    viewer->queue_bytes = 0;
+}
+
+static void
+sc_restreamer_viewer_stream_init(struct sc_restreamer_viewer_stream *stream) {
+    stream->inband_config = NULL;
+    stream->index = -1;
+    stream->last_pts = AV_NOPTS_VALUE;
+}
+
+static bool
+sc_restreamer_viewer_add_stream(struct sc_restreamer_viewer *viewer,
+                                struct sc_restreamer_stream *stream,
+                                struct sc_restreamer_viewer_stream *vstream) {
+    AVStream *ostream = avformat_new_stream(viewer->ctx, NULL);
+    if (!ostream) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (avcodec_parameters_copy(ostream->codecpar, stream->params) < 0) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (stream->config) {
+        // The current config packet is the extradata (e.g. for the RTSP SDP)
+        size_t size = stream->config->size;
+        uint8_t *extradata = av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!extradata) {
+            LOG_OOM();
+            return false;
+        }
+        memcpy(extradata, stream->config->data, size);
+
+        av_freep(&ostream->codecpar->extradata);
+        ostream->codecpar->extradata = extradata;
+        ostream->codecpar->extradata_size = size;
+    }
+
+    ostream->time_base = SCRCPY_TIME_BASE;
+    vstream->index = ostream->index;
+
+    return true;
+}
+
+// must be called with mutex locked (the streams are read)
+static bool
+sc_restreamer_viewer_create_context(struct sc_restreamer_viewer *viewer) {
+    struct sc_restreamer *restreamer = viewer->restreamer;
+
+    const char *format_name =
+        sc_restreamer_get_format_name(restreamer->format);
+    const char *url = viewer->socket == SC_SOCKET_NONE ? restreamer->url
+                                                       : NULL;
+    int r = avformat_alloc_output_context2(&viewer->ctx, NULL, format_name,
+                                           url);
+    if (r < 0) {
+        LOGE("Could not find %s muxer", format_name);
+        return false;
+    }
+
+    viewer->ctx->interrupt_callback.callback =
+        sc_restreamer_viewer_interrupt_cb;
+    viewer->ctx->interrupt_callback.opaque = viewer;
+
+    if (restreamer->video) {
+        if (!sc_restreamer_viewer_add_stream(viewer, &restreamer->video_stream,
+                                             &viewer->video_stream)) {
+            goto error;
+        }
+    }
+
+    if (restreamer->audio) {
+        if (!sc_restreamer_viewer_add_stream(viewer, &restreamer->audio_stream,
+                                             &viewer->audio_stream)) {
+            goto error;
+        }
+    }
+
+    return true;
+
+error:
+    avformat_free_context(viewer->ctx);
+    viewer->ctx = NULL;
+    return false;
+}
+
+static bool
+sc_restreamer_viewer_open_io(struct sc_restreamer_viewer *viewer) {
+    AVFormatContext *ctx = viewer->ctx;
+
+    if (viewer->socket != SC_SOCKET_NONE) {
+        uint8_t *buffer = av_malloc(SC_RESTREAMER_AVIO_BUFFER_SIZE);
+        if (!buffer) {
+            LOG_OOM();
+            return false;
+        }
+
+        viewer->avio = avio_alloc_context(buffer,
+                                          SC_RESTREAMER_AVIO_BUFFER_SIZE, 1,
+                                          viewer, NULL,
+                                          sc_restreamer_viewer_write_packet,
+                                          NULL);
+        if (!viewer->avio) {
+            LOG_OOM();
+            av_free(buffer);
+            return false;
+        }
+
+        ctx->pb = viewer->avio;
+        ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+        return true;
+    }
+
+    if (!(ctx->oformat->flags & AVFMT_NOFILE)) {
+        struct sc_restreamer *restreamer = viewer->restreamer;
+        int r = avio_open2(&ctx->pb, restreamer->url, AVIO_FLAG_WRITE,
+                           &ctx->interrupt_callback, NULL);
+        if (r < 0) {
+            LOGE("Could not open %s (is the protocol supported by FFmpeg?)",
+                 restreamer->url);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void
+sc_restreamer_viewer_close_io(struct sc_restreamer_viewer *viewer) {
+    AVFormatContext *ctx = viewer->ctx;
+
+    if (viewer->avio) {
+        av_freep(&viewer->avio->buffer);
+        avio_context_free(&viewer->avio);
+        ctx->pb = NULL;
+    } else if (!(ctx->oformat->flags & AVFMT_NOFILE)) {
+        avio_closep(&ctx->pb);
+    }
+}
+
+static bool
+sc_restreamer_viewer_open(struct sc_restreamer_viewer *viewer) {
+    if (!sc_restreamer_viewer_open_io(viewer)) {
+        return false;
+    }
+
+    AVDictionary *opts = NULL;
+    if (viewer->restreamer->format == SC_RESTREAM_FORMAT_RTSP) {
+        // Do not lose packets on the way to the RTSP server
+        if (av_dict_set(&opts, "rtsp_transport", "tcp", 0) < 0) {
+            LOG_OOM();
+            goto error_close_io;
+        }
+    }
+
+    int r = avformat_write_header(viewer->ctx, &opts);
+    av_dict_free(&opts);
+    if (r < 0) {
+        LOGE("Restreaming viewer %u: could not write header", viewer->id);
+        goto error_close_io;
+    }
+
+    return true;
+
+error_close_io:
+    sc_restreamer_viewer_close_io(viewer);
+    return false;
+}
+
+static void
+sc_restreamer_viewer_close(struct sc_restreamer_viewer *viewer, bool trailer) {
+    if (trailer) {
+        // Errors are not relevant for a live stream
+        av_write_trailer(viewer->ctx);
+    }
+    sc_restreamer_viewer_close_io(viewer);
+    avformat_free_context(viewer->ctx);
+    viewer->ctx = NULL;
+}
+
+// Prepend the current config to a video keyframe which does not contain it
+static bool
+sc_restreamer_inline_config(struct sc_restreamer_viewer_stream *vstream,
+                            AVPacket *packet) {
+    if (vstream->inband_config && (packet->flags & AV_PKT_FLAG_KEY)
+            && !av_packet_get_side_data(packet, AV_PKT_DATA_NEW_EXTRADATA,
+                                        NULL)) {
+        size_t size = vstream->inband_config->size;
+        uint8_t *config =
+            av_packet_new_side_data(packet, AV_PKT_DATA_NEW_EXTRADATA, size);
+        if (!config) {
+            LOG_OOM();
+            return false;
+        }
+        memcpy(config, vstream->inband_config->data, size);
+    }
+
+    return sc_packet_merger_inline_config(packet);
+}
+
+static bool
+sc_restreamer_viewer_write(struct sc_restreamer_viewer *viewer,
+                           AVPacket *packet) {
+    // The stream_index of the queued packets is 0 for video, 1 for audio
+    bool video = !packet->stream_index;
+    struct sc_restreamer_viewer_stream *vstream =
+        video ? &viewer->video_stream : &viewer->audio_stream;
+
+    if (packet->pts == AV_NOPTS_VALUE) {
+        // Config packet, sent in-band before the next keyframes
+        av_packet_free(&vstream->inband_config);
+        vstream->inband_config = av_packet_clone(packet);
+        if (!vstream->inband_config) {
+            LOG_OOM();
+            return false;
+        }
+        return true;
+    }
+
+    if (viewer->pts_origin == AV_NOPTS_VALUE) {
+        viewer->pts_origin = packet->pts;
+    } else if (packet->pts < viewer->pts_origin) {
+        // Received before the first packet of the other stream
+        return true;
+    }
+
+    if (video && !sc_restreamer_inline_config(vstream, packet)) {
+        return false;
+    }
+
+    packet->pts -= viewer->pts_origin;
+    packet->dts = packet->pts;
+    packet->stream_index = vstream->index;
+
+    AVStream *ostream = viewer->ctx->streams[vstream->index];
+    av_packet_rescale_ts(packet, SCRCPY_TIME_BASE, ostream->time_base);
+    if (vstream->last_pts != AV_NOPTS_VALUE
+            && packet->pts <= vstream->last_pts) {
+        packet->pts = ++vstream->last_pts;
+        packet->dts = packet->pts;
+    } else {
+        vstream->last_pts = packet->pts;
+    }
+
+    sc_trace_begin_pts("restream", packet->pts);
+    // The muxer takes ownership of the packet content
+    bool ok = av_interleaved_write_frame(viewer->ctx, packet) >= 0;
+    sc_trace_end();
+    return ok;
+}
+
+static bool
+sc_restreamer_viewer_process_packets(struct sc_restreamer_viewer *viewer) {
+    struct sc_restreamer *restreamer = viewer->restreamer;
+
+    for (;;) {
+        sc_mutex_lock(&restreamer->mutex);
+        while (!viewer->stopped && sc_vecdeque_is_empty(&viewer->queue)) {
+            sc_cond_wait(&viewer->cond, &restreamer->mutex);
+        }
+
+        if (viewer->stopped) {
+            // Live stream, the pending packets are not relevant anymore
+            sc_mutex_unlock(&restreamer->mutex);
+            return true;
+        }
+
+        AVPacket *packet = sc_vecdeque_pop(&viewer->queue);
+        viewer->queue_bytes -= packet->size;
+        sc_stats_add(restreamer->stats, SC_STAT_RESTREAM_QUEUE_BYTES,
+                     -(int64_t) packet->size);
+        sc_mutex_unlock(&restreamer->mutex);
+
+        bool ok = sc_restreamer_viewer_write(viewer, packet);
+        av_packet_free(&packet);
+        if (!ok) {
+            return false;
+        }
+    }
+}
+
+static bool
+sc_restreamer_viewer_restream(struct sc_restreamer_viewer *viewer) {
+    struct sc_restreamer *restreamer = viewer->restreamer;
+
+    sc_mutex_lock(&restreamer->mutex);
+    while (!viewer->stopped && !sc_restreamer_is_ready(restreamer)) {
+        sc_cond_wait(&restreamer->ready_cond, &restreamer->mutex);
+    }
+
+    if (viewer->stopped) {
+        sc_mutex_unlock(&restreamer->mutex);
+        return true;
+    }
+
+    bool ok = sc_restreamer_viewer_create_context(viewer);
+    sc_mutex_unlock(&restreamer->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_restreamer_viewer_open(viewer);
+    if (!ok) {
+        avformat_free_context(viewer->ctx);
+        viewer->ctx = NULL;
+        return false;
+    }
+
+    ok = sc_restreamer_viewer_process_packets(viewer);
+    sc_restreamer_viewer_close(viewer, ok);
+    return ok;
+}
+
+static int
+run_restreamer_viewer(void *data) {
+    struct sc_restreamer_viewer *viewer = data;
+    struct sc_restreamer *restreamer = viewer->restreamer;
+
+    sc_trace_thread_name("restreamer");
+
+    bool success = sc_restreamer_viewer_restream(viewer);
+
+    sc_mutex_lock(&restreamer->mutex);
+    // Ignore the next packets
+    bool interrupted = viewer->stopped;
+    viewer->stopped = true;
+    sc_restreamer_viewer_clear(viewer);
+    uint64_t dropped = viewer->dropped;
+    viewer->ended = true;
+    sc_mutex_unlock(&restreamer->mutex);
+
+    sc_stats_add(restreamer->stats, SC_STAT_RESTREAM_VIEWERS, -1);
+
+    if (dropped) {
+        LOGW("Restreaming viewer %u: %" PRIu64_ " packets dropped (network "
+             "too slow)", viewer->id, dropped);
+    }
+
+    if (viewer->socket != SC_SOCKET_NONE) {
+        LOGI("Restreaming viewer %u disconnected", viewer->id);
+    } else if (!success && !interrupted) {
+        // The mirroring continues without restreaming
+        LOGE("Restreaming to %s failed", restreamer->url);
+    }
+
+    LOGD("Restreamer viewer %u thread ended", viewer->id);
+
+    return 0;
+}
+
+// must be called with mutex locked
+static bool
+sc_restreamer_viewer_must_drop(struct sc_restreamer_viewer *viewer, bool video,
+                               const AVPacket *packet, sc_tick now) {
+    struct sc_restreamer *restreamer = viewer->restreamer;
+    bool over_limit = viewer->queue_bytes + packet->size
+                    > SC_RESTREAMER_QUEUE_LIMIT;
+
+    if (viewer->dropping) {
+        // Resume on a video keyframe (or as soon as possible if there is no
+        // video), so that the viewer can decode the stream immediately
+        bool can_resume = restreamer->video
+                        ? video && (packet->flags & AV_PKT_FLAG_KEY)
+                        : true;
+        if (!can_resume || over_limit) {
+            if (viewer->dropping_since
+                    && now - viewer->dropping_since
+                            >= SC_RESTREAMER_VIEWER_TIMEOUT) {
+                LOGW("Restreaming viewer %u too slow, disconnecting",
+                     viewer->id);
+                sc_restreamer_viewer_stop(viewer);
+            }
+            return true;
+        }
+
+        LOGD("Restreaming viewer %u resumed", viewer->id);
+        viewer->dropping = false;
+        viewer->dropping_since = 0;
+        return false;
+    }
+
+    if (over_limit) {
+        LOGW("Restreaming viewer %u: network too slow, dropping packets "
+             "until the next keyframe", viewer->id);
+        viewer->dropping = true;
+        viewer->dropping_since = now;
+        return true;
+    }
+
+    return false;
+}
+
+// must be called with mutex locked
+static void
+sc_restreamer_viewer_push(struct sc_restreamer_viewer *viewer, bool video,
+                          const AVPacket *packet, sc_tick now) {
+    struct sc_restreamer *restreamer = viewer->restreamer;
+
+    if (viewer->stopped) {
+        return;
+    }
+
+    // The config packets are never dropped, they are sent in-band
+    bool is_config = packet->pts == AV_NOPTS_VALUE;
+    if (!is_config
+            && sc_restreamer_viewer_must_drop(viewer, video, packet, now)) {
+        ++viewer->dropped;
+        sc_stats_add(restreamer->stats, SC_STAT_RESTREAM_DROPPED_PACKETS, 1);
+        return;
+    }
+
+    if (!sc_restreamer_queue_push(&viewer->queue, video, packet)) {
+        sc_restreamer_viewer_stop(viewer);
+        return;
+    }
+
+    viewer->queue_bytes += packet->size;
+    sc_stats_add(restreamer->stats, SC_STAT_RESTREAM_QUEUE_BYTES,
+                 packet->size);
+    sc_cond_signal(&viewer->cond);
+}
+
+// must be called with mutex locked
+static struct sc_restreamer_viewer *
+sc_restreamer_viewer_new(struct sc_restreamer *restreamer, sc_socket socket) {
+    struct sc_restreamer_viewer *viewer = malloc(sizeof(*viewer));
+    if (!viewer) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    if (!sc_cond_init(&viewer->cond)) {
+        free(viewer);
+        return NULL;
+    }
+
+    viewer->restreamer = restreamer;
+    viewer->id = restreamer->next_viewer_id++;
+    viewer->socket = socket;
+    viewer->stopped = false;
+    viewer->ended = false;
+    sc_vecdeque_init(&viewer->queue);
+    viewer->queue_bytes = 0;
+    viewer->dropped = 0;
+    atomic_init(&viewer->interrupted, false);
+    viewer->ctx = NULL;
+    viewer->avio = NULL;
+    viewer->pts_origin = AV_NOPTS_VALUE;
+    sc_restreamer_viewer_stream_init(&viewer->video_stream);
+    sc_restreamer_viewer_stream_init(&viewer->audio_stream);
+
+    // Start with the current config packets, then the cached group of
+    // pictures (starting on a keyframe), so that the viewer can decode the
+    // stream immediately
+    sc_tick now = sc_tick_now();
+    if (restreamer->video_stream.config) {
+        sc_restreamer_viewer_push(viewer, true, restreamer->video_stream.config,
+                                  now);
+    }
+    if (restreamer->audio_stream.config) {
+        sc_restreamer_viewer_push(viewer, false,
+                                  restreamer->audio_stream.config, now);
+    }
+
+    // Without a cached group of pictures, wait for the next keyframe (this is
+    // not a slow viewer, so there is no timeout)
+    viewer->dropping = restreamer->video
+                    && sc_vecdeque_is_empty(&restreamer->gop);
+    viewer->dropping_since = 0;
+
+    for (size_t i = 0; i < restreamer->gop.size; ++i) {
+        const AVPacket *p = restreamer->gop.data[(restreamer->gop.origin + i)
+                                                 % restreamer->gop.cap];
+        // The stream_index of the cached packets is 0 for video, 1 for audio
+        sc_restreamer_viewer_push(viewer, !p->stream_index, p, now);
+    }
+
+    if (viewer->stopped) {
+        // Out of memory
+        goto error;
+    }
+
+    if (!sc_vector_push(&restreamer->viewers, viewer)) {
+        LOG_OOM();
+        goto error;
+    }
+
+    // Decremented by the viewer thread
+    sc_stats_add(restreamer->stats, SC_STAT_RESTREAM_VIEWERS, 1);
+
+    bool ok = sc_thread_create(&viewer->thread, run_restreamer_viewer,
+                               "scrcpy-restream", viewer);
+    if (!ok) {
+        LOGE("Could not start restreamer thread");
+        sc_stats_add(restreamer->stats, SC_STAT_RESTREAM_VIEWERS, -1);
+        sc_vector_remove(&restreamer->viewers, restreamer->viewers.size - 1);
+        goto error;
+    }
+
+    return viewer;
+
+error:
+    sc_restreamer_viewer_clear(viewer);
+    sc_vecdeque_destroy(&viewer->queue);
+    sc_cond_destroy(&viewer->cond);
+    free(viewer);
+    return NULL;
+}
+
+// The viewer must be stopped
+static void
+sc_restreamer_viewer_delete(struct sc_restreamer_viewer *viewer) {
+    sc_thread_join(&viewer->thread, NULL);
+
+    assert(sc_vecdeque_is_empty(&viewer->queue));
+    sc_vecdeque_destroy(&viewer->queue);
+    av_packet_free(&viewer->video_stream.inband_config);
+    av_packet_free(&viewer->audio_stream.inband_config);
+    if (viewer->socket != SC_SOCKET_NONE) {
+        net_close(viewer->socket);
+    }
+    sc_cond_destroy(&viewer->cond);
+    free(viewer);
+}
+
+// Join and delete the viewers whose thread has ended
+static void
+sc_restreamer_reap_viewers(struct sc_restreamer *restreamer) {
+    for (;;) {
+        struct sc_restreamer_viewer *ended = NULL;
+
+        sc_mutex_lock(&restreamer->mutex);
+        for (size_t i = 0; i < restreamer->viewers.size; ++i) {
+            struct sc_restreamer_viewer *viewer = restreamer->viewers.data[i];
+            if (viewer->ended) {
+                sc_vector_remove(&restreamer->viewers, i);
+                ended = viewer;
+                break;
+            }
+        }
+        sc_mutex_unlock(&restreamer->mutex);
+
+        if (!ended) {
+            return;
+        }
+
+        sc_restreamer_viewer_delete(ended);
+    }
+}
+
+static int
+run_restreamer_server(void *data) {
+    struct sc_restreamer *restreamer = data;
+
+    for (;;) {
+        sc_socket socket = net_accept_intr(&restreamer->intr,
+                                           restreamer->server_socket);
+        if (socket == SC_SOCKET_NONE) {
+            // Interrupted (or error)
+            break;
+        }
+
+        sc_restreamer_reap_viewers(restreamer);
+
+        sc_mutex_lock(&restreamer->mutex);
+        if (restreamer->stopped) {
+            sc_mutex_unlock(&restreamer->mutex);
+            net_close(socket);
+            break;
+        }
+
+        if (restreamer->viewers.size >= SC_RESTREAMER_MAX_VIEWERS) {
+            sc_mutex_unlock(&restreamer->mutex);
+            LOGW("Restreaming: too many viewers, connection refused");
+            net_close(socket);
+            continue;
+        }
+
+        struct sc_restreamer_viewer *viewer =
+            sc_restreamer_viewer_new(restreamer, socket);
+        sc_mutex_unlock(&restreamer->mutex);
+        if (!viewer) {
+            net_close(socket);
+            continue;
+        }
+
+        LOGI("Restreaming viewer %u connected", viewer->id);
+    }
+
+    LOGD("Restreamer server thread ended");
+
+    return 0;
+}
+
+static void
+sc_restreamer_gop_clear(struct sc_restreamer *restreamer) {
+    sc_restreamer_queue_clear(&restreamer->gop);
+    sc_stats_add(restreamer->stats, SC_STAT_MEM_RESTREAM_GOP_BYTES,
+                 -(int64_t) restreamer->gop_bytes);
+    restreamer->gop_bytes = 0;
+}
+
+// must be called with mutex locked
+static void
+sc_restreamer_gop_push(struct sc_restreamer *restreamer, bool video,
+                       const AVPacket *packet) {
+    if (!restreamer->video) {
+        // No keyframe to start on
+        return;
+    }
+
+    bool keyframe = video && (packet->flags & AV_PKT_FLAG_KEY);
+    if (keyframe) {
+        // Start a new group of pictures
+        sc_restreamer_gop_clear(restreamer);
+        restreamer->gop_overflow = false;
+    } else if (restreamer->gop_overflow
+            || sc_vecdeque_is_empty(&restreamer->gop)) {
+        // Wait for the next keyframe
+        return;
+    }
+
+    if (restreamer->gop_bytes + packet->size > SC_RESTREAMER_GOP_LIMIT) {
+        // The new viewers will wait for the next keyframe
+        sc_restreamer_gop_clear(restreamer);
+        restreamer->gop_overflow = true;
+        return;
+    }
+
+    if (!sc_restreamer_queue_push(&restreamer->gop, video, packet)) {
+        sc_restreamer_gop_clear(restreamer);
+        restreamer->gop_overflow = true;
+        return;
+    }
+
+    restreamer->gop_bytes += packet->size;
+    sc_stats_add(restreamer->stats, SC_STAT_MEM_RESTREAM_GOP_BYTES,
+                 packet->size);
+}
+
+static bool
+sc_restreamer_push(struct sc_restreamer *restreamer, bool video,
+                   const AVPacket *packet) {
+    struct sc_restreamer_stream *stream = video ? &restreamer->video_stream
+                                                : &restreamer->audio_stream;
+    bool is_config = packet->pts == AV_NOPTS_VALUE;
+    sc_tick now = sc_tick_now();
+
+    sc_mutex_lock(&restreamer->mutex);
+
+    if (restreamer->stopped) {
+        sc_mutex_unlock(&restreamer->mutex);
+        return true;
+    }
+
+    if (is_config) {
+        // Keep the last config packet, for the new viewers
+        av_packet_free(&stream->config);
+        stream->config = av_packet_clone(packet);
+        if (!stream->config) {
+            // The viewers will wait for the next config packet
+            LOG_OOM();
+        }
+        sc_cond_broadcast(&restreamer->ready_cond);
+    } else {
+        sc_restreamer_gop_push(restreamer, video, packet);
+    }
+
+    for (size_t i = 0; i < restreamer->viewers.size; ++i) {
+        sc_restreamer_viewer_push(restreamer->viewers.data[i], video, packet,
+                                  now);
+    }
+
+    sc_mutex_unlock(&restreamer->mutex);
+
+    // Never prevent the mirroring
+    return true;
+}
+
+static bool
+sc_restreamer_stream_open(struct sc_restreamer *restreamer,
+                          struct sc_restreamer_stream *stream,
+                          AVCodecContext *ctx) {
+    AVCodecParameters *params = avcodec_parameters_alloc();
+    if (!params) {
+        LOG_OOM();
+        return false;
+    }
+
+    if (avcodec_parameters_from_context(params, ctx) < 0) {
+        LOG_OOM();
+        avcodec_parameters_free(&params);
+        return false;
+    }
+
+    sc_mutex_lock(&restreamer->mutex);
+    stream->params = params;
+    // A config packet is provided for all supported formats except raw audio
+    stream->expects_config = ctx->codec_id != AV_CODEC_ID_PCM_S16LE;
+    sc_mutex_unlock(&restreamer->mutex);
+
+    return true;
+}
+
+static void
+sc_restreamer_stream_destroy(struct sc_restreamer_stream *stream) {
+    avcodec_parameters_free(&stream->params);
+    av_packet_free(&stream->config);
+}
+
+static bool
+sc_restreamer_video_packet_sink_open(struct sc_packet_sink *sink,
+                                     AVCodecContext *ctx) {
+    struct sc_restreamer *restreamer = DOWNCAST_VIDEO(sink);
+    // only written from this thread, no need to lock
+    assert(!restreamer->video_init);
+
+    bool ok = sc_restreamer_stream_open(restreamer, &restreamer->video_stream,
+                                        ctx);
+    if (!ok) {
+        sc_restreamer_stop(restreamer);
+    }
+
+    sc_mutex_lock(&restreamer->mutex);
+    restreamer->video_init = true;
+    sc_cond_broadcast(&restreamer->ready_cond);
+    sc_mutex_unlock(&restreamer->mutex);
+
+    // Never prevent the mirroring
+    return true;
+}
+
+static void
+sc_restreamer_video_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_restreamer *restreamer = DOWNCAST_VIDEO(sink);
+    // EOS also stops the restreamer
+    sc_restreamer_stop(restreamer);
+}
+
+static bool
+sc_restreamer_video_packet_sink_push(struct sc_packet_sink *sink,
+                                     const AVPacket *packet) {
+    struct sc_restreamer *restreamer = DOWNCAST_VIDEO(sink);
+    return sc_restreamer_push(restreamer, true, packet);
+}
+
+static bool
+sc_restreamer_audio_packet_sink_open(struct sc_packet_sink *sink,
+                                     AVCodecContext *ctx) {
+    struct sc_restreamer *restreamer = DOWNCAST_AUDIO(sink);
+    // only written from this thread, no need to lock
+    assert(!restreamer->audio_init);
+
+    bool ok = sc_restreamer_stream_open(restreamer, &restreamer->audio_stream,
+                                        ctx);
+    if (!ok) {
+        sc_restreamer_stop(restreamer);
+    }
+
+    sc_mutex_lock(&restreamer->mutex);
+    restreamer->audio_init = true;
+    sc_cond_broadcast(&restreamer->ready_cond);
+    sc_mutex_unlock(&restreamer->mutex);
+
+    // Never prevent the mirroring
+    return true;
+}
+
+static void
+sc_restreamer_audio_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_restreamer *restreamer = DOWNCAST_AUDIO(sink);
+    // EOS also stops the restreamer
+    sc_restreamer_stop(restreamer);
+}
+
+static bool
+sc_restreamer_audio_packet_sink_push(struct sc_packet_sink *sink,
+                                     const AVPacket *packet) {
+    struct sc_restreamer *restreamer = DOWNCAST_AUDIO(sink);
+    return sc_restreamer_push(restreamer, false, packet);
+}
+
+static void
+sc_restreamer_audio_packet_sink_disable(struct sc_packet_sink *sink) {
+    struct sc_restreamer *restreamer = DOWNCAST_AUDIO(sink);
+    // only written from this thread, no need to lock
+    assert(!restreamer->audio_init);
+
+    LOGW("Audio stream restreaming disabled");
+
+    sc_mutex_lock(&restreamer->mutex);
+    restreamer->audio = false;
+    restreamer->audio_init = true;
+    sc_cond_broadcast(&restreamer->ready_cond);
+    sc_mutex_unlock(&restreamer->mutex);
+}
+
+// Parse "tcp://addr:port" (the address may be empty to listen on all the
+// interfaces)
+static bool
+sc_restreamer_parse_tcp_url(struct sc_restreamer *restreamer,
+                            const char *url) {
+    assert(!strncmp(url, "tcp://", 6));
+    const char *host = url + 6;
+    const char *colon = strrchr(host, ':');
+    if (!colon) {
+        LOGE("Missing port in restream URL: %s", url);
+        return false;
+    }
+
+    long port;
+    if (!sc_str_parse_integer(colon + 1, &port) || port <= 0
+            || port > 0xFFFF) {
+        LOGE("Invalid port in restream URL: %s", url);
+        return false;
+    }
+    restreamer->server_port = port;
+
+    if (colon == host) {
+        restreamer->server_addr = 0; // INADDR_ANY
+        return true;
+    }
+
+    char addr[sizeof("255.255.255.255")];
+    size_t len = colon - host;
+    if (len >= sizeof(addr)) {
+        LOGE("Invalid address in restream URL: %s", url);
+        return false;
+    }
+    memcpy(addr, host, len);
+    addr[len] = '\0';
+
+    return net_parse_ipv4(addr, &restreamer->server_addr);
+}
+
+bool
+sc_restreamer_init(struct sc_restreamer *restreamer, const char *url,
+                   enum sc_restream_format format, bool video, bool audio,
+                   struct sc_stats *stats) {
+    restreamer->url = strdup(url);
+    if (!restreamer->url) {
+        LOG_OOM();
+        return false;
+    }
+
+    restreamer->server = !strncmp(url, "tcp://", 6);
+    if (restreamer->server) {
+        assert(format == SC_RESTREAM_FORMAT_MPEGTS);
+        if (!sc_restreamer_parse_tcp_url(restreamer, url)) {
+            goto error_free_url;
+        }
+    }
+
+    bool ok = sc_mutex_init(&restreamer->mutex);
+    if (!ok) {
+        goto error_free_url;
+    }
+
+    ok = sc_cond_init(&restreamer->ready_cond);
+    if (!ok) {
+        goto error_mutex_destroy;
+    }
+
+    ok = sc_intr_init(&restreamer->intr);
+    if (!ok) {
+        goto error_cond_destroy;
+    }
+
+    assert(video || audio);
+    restreamer->format = format;
+    restreamer->stopped = false;
+    restreamer->video = video;
+    restreamer->audio = audio;
+    restreamer->video_init = false;
+    restreamer->audio_init = false;
+    restreamer->video_stream.params = NULL;
+    restreamer->video_stream.config = NULL;
+    restreamer->video_stream.expects_config = false;
+    restreamer->audio_stream.params = NULL;
+    restreamer->audio_stream.config = NULL;
+    restreamer->audio_stream.expects_config = false;
+    sc_vecdeque_init(&restreamer->gop);
+    restreamer->gop_bytes = 0;
+    restreamer->gop_overflow = false;
+    sc_vector_init(&restreamer->viewers);
+    restreamer->next_viewer_id = 0;
+    restreamer->server_socket = SC_SOCKET_NONE;
+    restreamer->server_thread_started = false;
+    restreamer->stats = stats;
+
+    if (video) {
+        static const struct sc_packet_sink_ops video_ops = {
+            .open = sc_restreamer_video_packet_sink_open,
+            .close = sc_restreamer_video_packet_sink_close,
+            .push = sc_restreamer_video_packet_sink_push,
+        };
+
+        restreamer->video_packet_sink.ops = &video_ops;
+    }
+
+    if (audio) {
+        static const struct sc_packet_sink_ops audio_ops = {
+            .open = sc_restreamer_audio_packet_sink_open,
+            .close = sc_restreamer_audio_packet_sink_close,
+            .push = sc_restreamer_audio_packet_sink_push,
+            .disable = sc_restreamer_audio_packet_sink_disable,
+        };
+
+        restreamer->audio_packet_sink.ops = &audio_ops;
+    }
+
+    return true;
+
+error_cond_destroy:
+    sc_cond_destroy(&restreamer->ready_cond);
+error_mutex_destroy:
+    sc_mutex_destroy(&restreamer->mutex);
+error_free_url:
+    free(restreamer->url);
+
+    return false;
+}
+
+static bool
+sc_restreamer_start_server(struct sc_restreamer *restreamer) {
+#ifndef _WIN32
+    // A viewer may disconnect while the stream is written to its socket
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    restreamer->server_socket = net_socket();
+    if (restreamer->server_socket == SC_SOCKET_NONE) {
+        LOGE("Could not create restreaming server socket");
+        return false;
+    }
+
+    bool ok = net_listen(restreamer->server_socket, restreamer->server_addr,
+                         restreamer->server_port, 4);
+    if (!ok) {
+        LOGE("Could not listen on port %" PRIu16 " for restreaming",
+             restreamer->server_port);
+        goto error_close_socket;
+    }
+
+    ok = sc_thread_create(&restreamer->server_thread, run_restreamer_server,
+                          "scrcpy-restream", restreamer);
+    if (!ok) {
+        LOGE("Could not start restreaming server thread");
+        goto error_close_socket;
+    }
+
+    restreamer->server_thread_started = true;
+    LOGI("Restreaming server listening on port %" PRIu16,
+         restreamer->server_port);
+
+    return true;
+
+error_close_socket:
+    net_close(restreamer->server_socket);
+    restreamer->server_socket = SC_SOCKET_NONE;
+    return false;
+}
+
+bool
+sc_restreamer_start(struct sc_restreamer *restreamer) {
+    if (restreamer->server) {
+        return sc_restreamer_start_server(restreamer);
+    }
+
+    // A single viewer, writing to the URL
+    sc_mutex_lock(&restreamer->mutex);
+    struct sc_restreamer_viewer *viewer =
+        sc_restreamer_viewer_new(restreamer, SC_SOCKET_NONE);
+    sc_mutex_unlock(&restreamer->mutex);
+
+    if (!viewer) {
+        return false;
+    }
+
+    LOGI("Restreaming to %s", restreamer->url);
+    return true;
+}
+
+void
+sc_restreamer_stop(struct sc_restreamer *restreamer) {
+    sc_mutex_lock(&restreamer->mutex);
+    restreamer->stopped = true;
+    for (size_t i = 0; i < restreamer->viewers.size; ++i) {
+        sc_restreamer_viewer_stop(restreamer->viewers.data[i]);
+    }
+    sc_cond_broadcast(&restreamer->ready_cond);
+    sc_mutex_unlock(&restreamer->mutex);
+
+    if (restreamer->server) {
+        sc_intr_interrupt(&restreamer->intr);
+    }
+}
+
+void
+sc_restreamer_join(struct sc_restreamer *restreamer) {
+    if (restreamer->server_thread_started) {
+        sc_thread_join(&restreamer->server_thread, NULL);
+    }
+
+    // No viewer may be added anymore
+    for (size_t i = 0; i < restreamer->viewers.size; ++i) {
+        sc_restreamer_viewer_delete(restreamer->viewers.data[i]);
+    }
+    sc_vector_clear(&restreamer->viewers);
+}
+
+void
+sc_restreamer_destroy(struct sc_restreamer *restreamer) {
+    assert(!restreamer->viewers.size);
+    sc_vector_destroy(&restreamer->viewers);
+    sc_restreamer_gop_clear(restreamer);
+    sc_vecdeque_destroy(&restreamer->gop);
+    sc_restreamer_stream_destroy(&restreamer->video_stream);
+    sc_restreamer_stream_destroy(&restreamer->audio_stream);
+    if (restreamer->server_socket != SC_SOCKET_NONE) {
+        net_close(restreamer->server_socket);
+    }
+    sc_intr_destroy(&restreamer->intr);
+    sc_cond_destroy(&restreamer->ready_cond);
+    sc_mutex_destroy(&restreamer->mutex);
+    free(restreamer->url);
+}
@@ -0,0 +1,163 @@
+#ifndef SC_RESTREAMER_H
+#define SC_RESTREAMER_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+
+#include "options.h"
+#include "stats.h"
+#include "trait/packet_sink.h"
+#include "util/intr.h"
+#include "util/net.h"
+#include "util/thread.h"
+#include "util/tick.h"
+#include "util/vecdeque.h"
+#include "util/vector.h"
+
+// Maximum size of the packets queued for a viewer (in bytes), beyond which
+// the packets are dropped until the next video keyframe
+#define SC_RESTREAMER_QUEUE_LIMIT (16 * 1024 * 1024)
+// Maximum size of the cached group of pictures (in bytes)
+#define SC_RESTREAMER_GOP_LIMIT (16 * 1024 * 1024)
+// A viewer dropping packets for longer than this delay is disconnected
+#define SC_RESTREAMER_VIEWER_TIMEOUT SC_TICK_FROM_SEC(30)
+// Maximum number of viewers connected to the TCP server
+#define SC_RESTREAMER_MAX_VIEWERS 16
+
+struct sc_restreamer_queue SC_VECDEQUE(AVPacket *);
+
+struct sc_restreamer_stream {
+    // Set on packet sink open (NULL if the stream is disabled)
+    AVCodecParameters *params;
+    // The last config packet received (NULL if none)
+    AVPacket *config;
+    bool expects_config;
+};
+
+// State of a stream for a viewer
+struct sc_restreamer_viewer_stream {
+    // The last config packet processed, sent before the next keyframes
+    AVPacket *inband_config;
+    int index; // in the output context, -1 if not created
+    int64_t last_pts;
+};
+
+struct sc_restreamer;
+
+/**
+ * A destination of the streams: the URL, or a client of the TCP server
+ *
+ * Each viewer has its own queue and thread, so that a slow viewer never
+ * blocks the demuxers nor the other viewers: if too many packets are queued,
+ * the next ones are dropped until the next video keyframe, and if it does not
+ * catch up, it is disconnected.
+ */
+struct sc_restreamer_viewer {
+    struct sc_restreamer *restreamer;
+    unsigned id;
+
+    // The socket of a TCP client, or SC_SOCKET_NONE to write to the URL
+    sc_socket socket;
+
+    sc_thread thread;
+    // Protected by the restreamer mutex
+    sc_cond cond;
+    bool stopped;
+    // Set once the thread has ended (the viewer may be joined)
+    bool ended;
+    struct sc_restreamer_queue queue;
+    size_t queue_bytes;
+    // Set once a packet has been dropped, until the next video keyframe
+    bool dropping;
+    sc_tick dropping_since;
+    uint64_t dropped;
+
+    // Interrupt the blocking network calls (read by the libav callback)
+    atomic_bool interrupted;
+
+    // Only accessed from the viewer thread
+    AVFormatContext *ctx;
+    AVIOContext *avio; // for a TCP client
+    int64_t pts_origin;
+    struct sc_restreamer_viewer_stream video_stream;
+    struct sc_restreamer_viewer_stream audio_stream;
+};
+
+/**
+ * Forward the encoded packets (as received from the device, without
+ * re-encoding) to remote viewers
+ *
+ * The streams are muxed in MPEG-TS for SRT or UDP, or published to an RTSP
+ * server (which serves them to the viewers). With a "tcp://" URL, a TCP server
+ * is opened instead, and every connected client receives the streams in
+ * MPEG-TS.
+ *
+ * The config packets are sent in-band before each video keyframe, and a new
+ * viewer starts with the packets since the last keyframe (the cached group of
+ * pictures), so that it can decode the stream immediately.
+ */
+struct sc_restreamer {
+    struct sc_packet_sink video_packet_sink;
+    struct sc_packet_sink audio_packet_sink;
+
+    char *url;
+    enum sc_restream_format format;
+
+    sc_mutex mutex;
+    sc_cond ready_cond; // signaled once all the streams are known
+    // set on sc_restreamer_stop() or packet sink close
+    bool stopped;
+
+    // Expected streams (the audio may be disabled at runtime)
+    bool video;
+    bool audio;
+    bool video_init;
+    bool audio_init;
+    struct sc_restreamer_stream video_stream;
+    struct sc_restreamer_stream audio_stream;
+
+    // Packets since the last video keyframe (included), to start the new
+    // viewers (empty if there is no video or if it is too big)
+    struct sc_restreamer_queue gop;
+    size_t gop_bytes;
+    bool gop_overflow;
+
+    struct SC_VECTOR(struct sc_restreamer_viewer *) viewers;
+    unsigned next_viewer_id;
+
+    // TCP server (if the URL is "tcp://")
+    bool server;
+    uint32_t server_addr;
+    uint16_t server_port;
+    sc_socket server_socket;
+    struct sc_intr intr;
+    sc_thread server_thread;
+    bool server_thread_started;
+
+    struct sc_stats *stats; // may be NULL
+};
+
+bool
+sc_restreamer_init(struct sc_restreamer *restreamer, const char *url,
+                   enum sc_restream_format format, bool video, bool audio,
+                   struct sc_stats *stats);
+
+bool
+sc_restreamer_start(struct sc_restreamer *restreamer);
+
+void
+sc_restreamer_stop(struct sc_restreamer *restreamer);
+
+void
+sc_restreamer_join(struct sc_restreamer *restreamer);
+
+void
+sc_restreamer_destroy(struct sc_restreamer *restreamer);
+
+#endif
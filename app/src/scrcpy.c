@@ -1,5 +1,6 @@
 #include "scrcpy.h"
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -13,18 +14,35 @@
 # include <windows.h>
 #endif
 
+#include "audio_output_sdl.h"
 #include "audio_player.h"
+#include "av_sync.h"
+#include "control_server.h"
 #include "controller.h"
 #include "decoder.h"
 #include "delay_buffer.h"
 #include "demuxer.h"
 #include "events.h"
 #include "file_pusher.h"
+#include "frame_hasher.h"
+#include "frame_pacer.h"
+#include "input_replay.h"
 #include "keyboard_sdk.h"
 #include "mouse_sdk.h"
+#include "record_uploader.h"
 #include "recorder.h"
+#include "replay_buffer.h"
+#include "restreamer.h"
 #include "screen.h"
+#include "screen_stability.h"
 #include "server.h"
+#include "startup_timeline.h"
+#include "stats.h"
+#include "stream_dump.h"
+#include "thumbnailer.h"
+#include "transcoder.h"
+#include "video_feedback.h"
+#include "uhid/gamepad_uhid.h"
 #include "uhid/keyboard_uhid.h"
 #include "uhid/mouse_uhid.h"
 #ifdef HAVE_USB
@@ -41,22 +59,57 @@
 #ifdef HAVE_V4L2
 # include "v4l2_sink.h"
 #endif
+#ifdef HAVE_FRAME_SHARE
+# include "frame_share.h"
+#endif
+
+struct scrcpy_stream_file {
+    struct sc_stream_dumper dumper;
+    struct sc_stream_replayer replayer;
+};
 
 struct scrcpy {
     struct sc_server server;
     struct sc_screen screen;
+    struct sc_audio_output_sdl audio_output;
     struct sc_audio_player audio_player;
     struct sc_demuxer video_demuxer;
     struct sc_demuxer audio_demuxer;
+    // Only used for a separate record video stream (--record-video-bit-rate)
+    struct sc_demuxer record_video_demuxer;
+    // The dump (--dump-streams) or the replay (--replay-streams) of each
+    // demuxer stream
+    struct scrcpy_stream_file video_stream_file;
+    struct scrcpy_stream_file audio_stream_file;
+    struct scrcpy_stream_file record_video_stream_file;
     struct sc_decoder video_decoder;
     struct sc_decoder audio_decoder;
     struct sc_recorder recorder;
+    struct sc_thumbnailer thumbnailer;
+    struct sc_record_uploader record_uploader;
+    struct sc_replay_buffer replay_buffer;
+    struct sc_restreamer restreamer;
+    struct sc_transcoder transcoder;
     struct sc_delay_buffer display_buffer;
+    struct sc_frame_pacer display_pacer;
+    struct sc_latency_tracker latency_tracker;
+    struct sc_clock_sync clock_sync;
+    struct sc_av_sync av_sync;
+    struct sc_stats stats;
 #ifdef HAVE_V4L2
     struct sc_v4l2_sink v4l2_sink;
     struct sc_delay_buffer v4l2_buffer;
+#endif
+#ifdef HAVE_FRAME_SHARE
+    struct sc_frame_share frame_share;
 #endif
     struct sc_controller controller;
+    struct sc_input_recorder input_recorder;
+    struct sc_input_replayer input_replayer;
+    struct sc_control_server control_server;
+    struct sc_screen_stability screen_stability;
+    struct sc_frame_hasher frame_hasher;
+    struct sc_video_feedback video_feedback;
     struct sc_file_pusher file_pusher;
 #ifdef HAVE_USB
     struct sc_usb usb;
@@ -79,6 +132,7 @@ struct scrcpy {
         struct sc_mouse_aoa mouse_aoa;
 #endif
     };
+    struct sc_gamepad_uhid gamepad_uhid;
     struct sc_timeout timeout;
 };
 
@@ -163,6 +217,32 @@ sdl_configure(bool video_playback, bool disable_screensaver) {
     }
 }
 
+static void
+update_file_pusher_status(struct scrcpy *s) {
+    struct sc_file_pusher_progress progress;
+    bool busy = sc_file_pusher_get_progress(&s->file_pusher, &progress);
+    if (!busy) {
+        sc_screen_set_title_status(&s->screen, NULL);
+        return;
+    }
+
+    sc_tick elapsed = sc_tick_now() - progress.start;
+    double seconds = elapsed > 0 ? (double) elapsed / SC_TICK_FREQ : 0;
+    double mib_done = (double) progress.bytes_done / (1 << 20);
+    double mib_total = (double) progress.bytes_total / (1 << 20);
+    double mib_per_s = seconds > 0 ? mib_done / seconds : 0;
+
+    char status[128];
+    int r = snprintf(status, sizeof(status),
+                     "Transferring %u/%u files (%.1f/%.1f MiB, %.1f MiB/s)",
+                     progress.done, progress.total, mib_done, mib_total,
+                     mib_per_s);
+    if (r < 0) {
+        return;
+    }
+    sc_screen_set_title_status(&s->screen, status);
+}
+
 static enum scrcpy_exit_code
 event_loop(struct scrcpy *s) {
     SDL_Event event;
@@ -180,6 +260,15 @@ event_loop(struct scrcpy *s) {
             case SC_EVENT_TIME_LIMIT_REACHED:
                 LOGI("Time limit reached");
                 return SCRCPY_EXIT_SUCCESS;
+            case SC_EVENT_STREAM_REPLAY_FINISHED:
+                LOGI("Stream replay finished");
+                return SCRCPY_EXIT_SUCCESS;
+            case SC_EVENT_STARTUP_COMPLETED:
+                sc_startup_timeline_print_json();
+                return SCRCPY_EXIT_SUCCESS;
+            case SC_EVENT_FILE_PUSHER_PROGRESS:
+                update_file_pusher_status(s);
+                break;
             case SDL_QUIT:
                 LOGD("User requested to quit");
                 return SCRCPY_EXIT_SUCCESS;
@@ -220,6 +309,23 @@ await_for_server(bool *connected) {
     return false;
 }
 
+static void
+sc_file_pusher_on_progress(struct sc_file_pusher *fp, void *userdata) {
+    (void) fp;
+    (void) userdata;
+
+    PUSH_EVENT(SC_EVENT_FILE_PUSHER_PROGRESS);
+}
+
+static void
+sc_controller_on_file_pushed(struct sc_controller *controller, bool success,
+                             void *userdata) {
+    (void) controller;
+    struct sc_file_pusher *fp = userdata;
+
+    sc_file_pusher_on_file_pushed(fp, success);
+}
+
 static void
 sc_recorder_on_ended(struct sc_recorder *recorder, bool success,
                      void *userdata) {
@@ -231,22 +337,86 @@ sc_recorder_on_ended(struct sc_recorder *recorder, bool success,
     }
 }
 
+static void
+sc_recorder_on_file_completed(struct sc_recorder *recorder,
+                              const char *filename, void *userdata) {
+    (void) userdata;
+
+    struct scrcpy *s = container_of(recorder, struct scrcpy, recorder);
+    if (!sc_record_uploader_push(&s->record_uploader, filename)) {
+        LOGW("Could not request the upload of %s", filename);
+    }
+}
+
+static void
+sc_screen_stability_on_frame(struct sc_screen_stability *ss, int64_t pts,
+                             float change_ratio, void *userdata) {
+    (void) ss;
+
+    struct sc_control_server *server = userdata;
+
+    char event[64];
+    snprintf(event, sizeof(event), "frame %" PRId64 " %.4f\n", pts,
+             change_ratio);
+    sc_control_server_send_event(server, event);
+}
+
+static void
+sc_screen_stability_on_stable(struct sc_screen_stability *ss, int64_t pts,
+                              void *userdata) {
+    (void) ss;
+
+    struct sc_control_server *server = userdata;
+
+    char event[64];
+    snprintf(event, sizeof(event), "stable %" PRId64 "\n", pts);
+    sc_control_server_send_event(server, event);
+}
+
+static void
+sc_recorder_on_keyframe_needed(struct sc_recorder *recorder, void *userdata) {
+    (void) recorder;
+
+    struct sc_controller *controller = userdata;
+
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_REQUEST_KEYFRAME;
+
+    if (!sc_controller_push_msg(controller, &msg)) {
+        LOGW("Could not request keyframe for recording");
+    }
+}
+
 static void
 sc_video_demuxer_on_ended(struct sc_demuxer *demuxer,
                           enum sc_demuxer_status status, void *userdata) {
     (void) demuxer;
-    (void) userdata;
+
+    const struct scrcpy_options *options = userdata;
 
     // The device may not decide to disable the video
     assert(status != SC_DEMUXER_STATUS_DISABLED);
 
     if (status == SC_DEMUXER_STATUS_EOS) {
-        PUSH_EVENT(SC_EVENT_DEVICE_DISCONNECTED);
+        if (options->replay_streams_dir) {
+            PUSH_EVENT(SC_EVENT_STREAM_REPLAY_FINISHED);
+        } else {
+            PUSH_EVENT(SC_EVENT_DEVICE_DISCONNECTED);
+        }
     } else {
         PUSH_EVENT(SC_EVENT_DEMUXER_ERROR);
     }
 }
 
+static sc_socket
+sc_video_demuxer_on_reconnect(struct sc_demuxer *demuxer, void *userdata) {
+    (void) userdata;
+
+    // Only the mirrored video stream may be reconnected
+    struct scrcpy *s = container_of(demuxer, struct scrcpy, video_demuxer);
+    return sc_server_reconnect_video(&s->server);
+}
+
 static void
 sc_audio_demuxer_on_ended(struct sc_demuxer *demuxer,
                           enum sc_demuxer_status status, void *userdata) {
@@ -257,7 +427,12 @@ sc_audio_demuxer_on_ended(struct sc_demuxer *demuxer,
     // Contrary to the video demuxer, keep mirroring if only the audio fails
     // (unless --require-audio is set).
     if (status == SC_DEMUXER_STATUS_EOS) {
-        PUSH_EVENT(SC_EVENT_DEVICE_DISCONNECTED);
+        if (!options->replay_streams_dir) {
+            PUSH_EVENT(SC_EVENT_DEVICE_DISCONNECTED);
+        } else if (!options->video) {
+            // Otherwise, the replay finishes with the video stream
+            PUSH_EVENT(SC_EVENT_STREAM_REPLAY_FINISHED);
+        }
     } else if (status == SC_DEMUXER_STATUS_ERROR
             || (status == SC_DEMUXER_STATUS_DISABLED
                 && options->require_audio)) {
@@ -265,6 +440,71 @@ sc_audio_demuxer_on_ended(struct sc_demuxer *demuxer,
     }
 }
 
+// Initialize a demuxer reading from the socket, or from a dump if
+// --replay-streams is set, and dumping its stream if --dump-streams is set
+//
+// On success, *stream_file_initialized indicates if the stream file must be
+// destroyed by destroy_stream_file().
+static bool
+init_demuxer(struct sc_demuxer *demuxer, const char *name, sc_socket socket,
+             uint32_t sample_rate, uint8_t channels, struct sc_stats *stats,
+             const struct sc_demuxer_callbacks *cbs, void *cbs_userdata,
+             const struct scrcpy_options *options,
+             struct scrcpy_stream_file *stream_file,
+             bool *stream_file_initialized) {
+    *stream_file_initialized = false;
+
+    if (options->replay_streams_dir) {
+        if (!sc_stream_replayer_init(&stream_file->replayer,
+                                     options->replay_streams_dir, name,
+                                     options->replay_streams_max_speed)) {
+            return false;
+        }
+
+        if (!sc_demuxer_init_replay(demuxer, name, &stream_file->replayer,
+                                    sample_rate, channels, stats, cbs,
+                                    cbs_userdata)) {
+            sc_stream_replayer_destroy(&stream_file->replayer);
+            return false;
+        }
+
+        *stream_file_initialized = true;
+        return true;
+    }
+
+    if (options->dump_streams_dir) {
+        if (!sc_stream_dumper_init(&stream_file->dumper,
+                                   options->dump_streams_dir, name)) {
+            return false;
+        }
+    }
+
+    if (!sc_demuxer_init(demuxer, name, socket, sample_rate, channels, stats,
+                         cbs, cbs_userdata)) {
+        if (options->dump_streams_dir) {
+            sc_stream_dumper_destroy(&stream_file->dumper);
+        }
+        return false;
+    }
+
+    if (options->dump_streams_dir) {
+        sc_demuxer_set_dumper(demuxer, &stream_file->dumper);
+        *stream_file_initialized = true;
+    }
+
+    return true;
+}
+
+static void
+destroy_stream_file(struct scrcpy_stream_file *stream_file,
+                    const struct scrcpy_options *options) {
+    if (options->replay_streams_dir) {
+        sc_stream_replayer_destroy(&stream_file->replayer);
+    } else {
+        sc_stream_dumper_destroy(&stream_file->dumper);
+    }
+}
+
 static void
 sc_server_on_connection_failed(struct sc_server *server, void *userdata) {
     (void) server;
@@ -317,6 +557,8 @@ scrcpy(struct scrcpy_options *options) {
 #endif
     struct scrcpy *s = &scrcpy;
 
+    sc_startup_timeline_init();
+
     // Minimal SDL initialization
     if (SDL_Init(SDL_INIT_EVENTS)) {
         LOGE("Could not initialize SDL: %s", SDL_GetError());
@@ -331,19 +573,57 @@ scrcpy(struct scrcpy_options *options) {
     bool file_pusher_initialized = false;
     bool recorder_initialized = false;
     bool recorder_started = false;
+    bool thumbnailer_initialized = false;
+    bool thumbnailer_started = false;
+    bool record_uploader_initialized = false;
+    bool record_uploader_started = false;
+    bool replay_buffer_initialized = false;
+    bool restreamer_initialized = false;
+    bool restreamer_started = false;
+    bool transcoder_initialized = false;
 #ifdef HAVE_V4L2
     bool v4l2_sink_initialized = false;
 #endif
+#ifdef HAVE_FRAME_SHARE
+    bool frame_share_initialized = false;
+#endif
+    bool video_demuxer_initialized = false;
     bool video_demuxer_started = false;
+    bool audio_demuxer_initialized = false;
     bool audio_demuxer_started = false;
+    bool record_video_demuxer_initialized = false;
+    bool record_video_demuxer_started = false;
+    bool video_stream_file_initialized = false;
+    bool audio_stream_file_initialized = false;
+    bool record_video_stream_file_initialized = false;
+    bool video_decoder_initialized = false;
+    bool audio_decoder_initialized = false;
+    bool display_buffer_initialized = false;
+    bool display_pacer_initialized = false;
+#ifdef HAVE_V4L2
+    bool v4l2_buffer_initialized = false;
+#endif
 #ifdef HAVE_USB
     bool aoa_hid_initialized = false;
     bool keyboard_aoa_initialized = false;
     bool mouse_aoa_initialized = false;
 #endif
     bool controller_initialized = false;
+    bool mouse_uhid_initialized = false;
     bool controller_started = false;
+    bool input_recorder_initialized = false;
+    bool input_replayer_initialized = false;
+    bool input_replayer_started = false;
+    bool control_server_initialized = false;
+    bool control_server_started = false;
+    bool screen_stability_initialized = false;
+    bool screen_stability_started = false;
+    bool frame_hasher_initialized = false;
     bool screen_initialized = false;
+    bool latency_tracker_initialized = false;
+    bool clock_sync_initialized = false;
+    bool stats_initialized = false;
+    bool stats_started = false;
     bool timeout_initialized = false;
     bool timeout_started = false;
 
@@ -352,6 +632,9 @@ scrcpy(struct scrcpy_options *options) {
 
     uint32_t scid = scrcpy_generate_scid();
 
+    // Without a device, the streams are read from the dumps
+    bool replay = !!options->replay_streams_dir;
+
     struct sc_server_params params = {
         .scid = scid,
         .req_serial = options->serial,
@@ -364,15 +647,41 @@ scrcpy(struct scrcpy_options *options) {
         .audio_source = options->audio_source,
         .camera_facing = options->camera_facing,
         .crop = options->crop,
+        .new_display = options->new_display,
         .port_range = options->port_range,
         .tunnel_host = options->tunnel_host,
         .tunnel_port = options->tunnel_port,
+        .daemon_idle_timeout = options->server_idle_timeout,
+        .devices_cache = options->devices_cache,
+        .list_cache = options->list_cache,
+        .shutdown_timeout = options->shutdown_timeout,
+        .socket_buffer_size = options->socket_buffer_size,
+        .multiplex = options->multiplex,
+        .video_reconnect = options->video_reconnect,
+        .video_pacing = options->video_pacing,
+        .direct_port = options->direct_port,
+        .direct_udp = options->direct_udp,
         .max_size = options->max_size,
         .video_bit_rate = options->video_bit_rate,
+        .record_video_bit_rate = options->record_video_bit_rate,
+        .record_video_source = options->record_video_source,
         .audio_bit_rate = options->audio_bit_rate,
+        .audio_sample_rate = options->audio_sample_rate,
+        .audio_channels = options->audio_channels,
+        .audio_read_size = options->audio_read_size,
         .max_fps = options->max_fps,
+        .video_repeat_delay = options->video_repeat_delay,
+        .video_latency_profile = options->video_latency_profile,
+        .video_intra_refresh = options->video_intra_refresh,
+        .video_hdr = options->video_hdr,
+        .square_video = options->square_video,
+        .gpu_downscale = options->gpu_downscale,
+        .video_masks = options->video_masks,
+        .adaptive_fps = options->adaptive_fps,
+        .thermal_governor = options->thermal_governor,
         .lock_video_orientation = options->lock_video_orientation,
         .control = options->control,
+        .control_compression = options->control_compression,
         .display_id = options->display_id,
         .video = options->video,
         .audio = options->audio,
@@ -386,7 +695,10 @@ scrcpy(struct scrcpy_options *options) {
         .camera_size = options->camera_size,
         .camera_ar = options->camera_ar,
         .camera_fps = options->camera_fps,
+        .pattern_size = options->pattern_size,
+        .pattern_fps = options->pattern_fps,
         .force_adb_forward = options->force_adb_forward,
+        .persistent_tunnel = options->persistent_tunnel,
         .power_off_on_close = options->power_off_on_close,
         .clipboard_autosync = options->clipboard_autosync,
         .downsize_on_error = options->downsize_on_error,
@@ -396,7 +708,11 @@ scrcpy(struct scrcpy_options *options) {
         .power_on = options->power_on,
         .kill_adb_on_close = options->kill_adb_on_close,
         .camera_high_speed = options->camera_high_speed,
+        .camera_low_latency = options->camera_low_latency,
+        .camera_lock_ae_af = options->camera_lock_ae_af,
         .list = options->list,
+        .latency_stats = options->print_latency,
+        .encoder_stats = options->stats_file != NULL,
     };
 
     static const struct sc_server_callbacks cbs = {
@@ -414,11 +730,13 @@ scrcpy(struct scrcpy_options *options) {
         sdl_set_hints(options->render_driver);
     }
 
-    if (!sc_server_start(&s->server)) {
-        goto end;
-    }
+    if (!replay) {
+        if (!sc_server_start(&s->server)) {
+            goto end;
+        }
 
-    server_started = true;
+        server_started = true;
+    }
 
     if (options->list) {
         bool ok = await_for_server(NULL);
@@ -447,6 +765,14 @@ scrcpy(struct scrcpy_options *options) {
         }
     }
 
+    if (options->gamepad_input_mode != SC_GAMEPAD_INPUT_MODE_DISABLED) {
+        if (SDL_Init(SDL_INIT_GAMECONTROLLER)) {
+            LOGE("Could not initialize SDL game controller: %s",
+                 SDL_GetError());
+            goto end;
+        }
+    }
+
     if (options->audio_playback) {
         if (SDL_Init(SDL_INIT_AUDIO)) {
             LOGE("Could not initialize SDL audio: %s", SDL_GetError());
@@ -455,34 +781,67 @@ scrcpy(struct scrcpy_options *options) {
     }
 
     sdl_configure(options->video_playback, options->disable_screensaver);
+    sc_startup_timeline_mark(SC_STARTUP_SDL_INITIALIZED);
 
-    // Await for server without blocking Ctrl+C handling
-    bool connected;
-    if (!await_for_server(&connected)) {
-        LOGE("Server connection failed");
-        goto end;
-    }
+    if (!replay) {
+        // Await for server without blocking Ctrl+C handling
+        bool connected;
+        if (!await_for_server(&connected)) {
+            LOGE("Server connection failed");
+            goto end;
+        }
 
-    if (!connected) {
-        // This is not an error, user requested to quit
-        LOGD("User requested to quit");
-        ret = SCRCPY_EXIT_SUCCESS;
-        goto end;
-    }
+        if (!connected) {
+            // This is not an error, user requested to quit
+            LOGD("User requested to quit");
+            ret = SCRCPY_EXIT_SUCCESS;
+            goto end;
+        }
 
-    LOGD("Server connected");
+        LOGD("Server connected");
+        sc_startup_timeline_mark(SC_STARTUP_SERVER_CONNECTED);
+    }
 
     // It is necessarily initialized here, since the device is connected
+    // (unless the streams are replayed)
     struct sc_server_info *info = &s->server.info;
+    const char *device_name = replay ? "replay" : info->device_name;
 
     const char *serial = s->server.serial;
-    assert(serial);
+    assert(serial || replay);
+
+    struct sc_stats *stats = NULL;
+    if (options->stats_file || options->perf_overlay) {
+        // Without a stats file, the values are only read by the overlay
+        if (!sc_stats_init(&s->stats, options->stats_file,
+                           options->stats_format)) {
+            goto end;
+        }
+
+        if (options->stats_file) {
+            if (!sc_stats_start(&s->stats)) {
+                sc_stats_destroy(&s->stats);
+                goto end;
+            }
+            stats_started = true;
+        }
+        stats = &s->stats;
+        stats_initialized = true;
+    }
 
     struct sc_file_pusher *fp = NULL;
 
     if (options->video_playback && options->control) {
+        static const struct sc_file_pusher_callbacks file_pusher_cbs = {
+            .on_progress = sc_file_pusher_on_progress,
+        };
+        // Without adb in the data path, push the files over the control
+        // socket (the controller is started before any request)
+        struct sc_controller *push_controller =
+            options->direct_port ? &s->controller : NULL;
         if (!sc_file_pusher_init(&s->file_pusher, serial,
-                                 options->push_target)) {
+                                 options->push_target, push_controller,
+                                 &file_pusher_cbs, NULL)) {
             goto end;
         }
         fp = &s->file_pusher;
@@ -493,16 +852,47 @@ scrcpy(struct scrcpy_options *options) {
         static const struct sc_demuxer_callbacks video_demuxer_cbs = {
             .on_ended = sc_video_demuxer_on_ended,
         };
-        sc_demuxer_init(&s->video_demuxer, "video", s->server.video_socket,
-                        &video_demuxer_cbs, NULL);
+        static const struct sc_demuxer_callbacks reconnect_video_demuxer_cbs = {
+            .on_ended = sc_video_demuxer_on_ended,
+            .on_reconnect = sc_video_demuxer_on_reconnect,
+        };
+        const struct sc_demuxer_callbacks *cbs =
+            options->video_reconnect ? &reconnect_video_demuxer_cbs
+                                     : &video_demuxer_cbs;
+        if (!init_demuxer(&s->video_demuxer, "video", s->server.video_socket,
+                          0, 0, stats, cbs, options, options,
+                          &s->video_stream_file,
+                          &video_stream_file_initialized)) {
+            goto end;
+        }
+        video_demuxer_initialized = true;
+
+        if (options->record_video_bit_rate) {
+            // The stats only count the mirrored video stream
+            if (!init_demuxer(&s->record_video_demuxer, "record-video",
+                              s->server.record_video_socket, 0, 0, NULL,
+                              &video_demuxer_cbs, options, options,
+                              &s->record_video_stream_file,
+                              &record_video_stream_file_initialized)) {
+                goto end;
+            }
+            record_video_demuxer_initialized = true;
+        }
     }
 
     if (options->audio) {
         static const struct sc_demuxer_callbacks audio_demuxer_cbs = {
             .on_ended = sc_audio_demuxer_on_ended,
         };
-        sc_demuxer_init(&s->audio_demuxer, "audio", s->server.audio_socket,
-                        &audio_demuxer_cbs, options);
+        if (!init_demuxer(&s->audio_demuxer, "audio", s->server.audio_socket,
+                          options->audio_sample_rate,
+                          options->audio_channels, stats,
+                          &audio_demuxer_cbs, options, options,
+                          &s->audio_stream_file,
+                          &audio_stream_file_initialized)) {
+            goto end;
+        }
+        audio_demuxer_initialized = true;
     }
 
     bool needs_video_decoder = options->video_playback;
@@ -510,25 +900,143 @@ scrcpy(struct scrcpy_options *options) {
 #ifdef HAVE_V4L2
     needs_video_decoder |= !!options->v4l2_device;
 #endif
+#ifdef HAVE_FRAME_SHARE
+    needs_video_decoder |= !!options->frame_share;
+#endif
+    // The restreamed video is re-encoded from the decoded frames
+    bool transcode = options->restream_video_encoder && options->video;
+    needs_video_decoder |= transcode;
+    needs_video_decoder |= options->screen_stability_delay
+                        && options->video;
+    needs_video_decoder |= options->frame_hash_filename && options->video;
+    if (options->print_latency && options->video_playback) {
+        // The device clock is measured over the control channel
+        if (options->control) {
+            if (!sc_clock_sync_init(&s->clock_sync)) {
+                goto end;
+            }
+            clock_sync_initialized = true;
+        }
+
+        struct sc_clock_sync *clock_sync =
+            clock_sync_initialized ? &s->clock_sync : NULL;
+        if (!sc_latency_tracker_init(&s->latency_tracker, clock_sync)) {
+            goto end;
+        }
+        latency_tracker_initialized = true;
+    }
+
+    // The A/V offset is measured whenever both are played, even if the
+    // video is not explicitly synchronized (--av-sync)
+    struct sc_av_sync *av_sync = NULL;
+    if (options->video_playback && options->audio_playback) {
+        sc_av_sync_init(&s->av_sync, stats);
+        av_sync = &s->av_sync;
+    }
+
+    if (!needs_video_decoder && !needs_audio_decoder) {
+        // For example with --no-playback --record: the packets are forwarded
+        // as is, no frame is ever decoded
+        LOGD("Packet-only pipeline (no decoder)");
+    }
+
     if (needs_video_decoder) {
-        sc_decoder_init(&s->video_decoder, "video");
-        sc_packet_source_add_sink(&s->video_demuxer.packet_source,
-                                  &s->video_decoder.packet_sink);
+        // Hardware frames may be pushed as is only if the screen and the
+        // transcoder are the only consumers: they are downloaded just before
+        // the texture upload (so that frames skipped by the screen are never
+        // downloaded), and encoded as is if the encoder accepts them
+        bool hw_frames = (options->video_playback || transcode)
+                      && !options->display_buffer
+                      && !options->display_pacing && !options->av_sync;
+#ifdef HAVE_V4L2
+        hw_frames &= !options->v4l2_device;
+#endif
+#ifdef HAVE_FRAME_SHARE
+        hw_frames &= !options->frame_share;
+#endif
+        // The screen stability is detected from the luma plane in memory
+        hw_frames &= !options->screen_stability_delay;
+        hw_frames &= !options->frame_hash_filename;
+        struct sc_decoder_params decoder_params = {
+            .hwaccel = options->video_hwaccel,
+            .hw_frames = hw_frames,
+            .latency_tracker = latency_tracker_initialized ? &s->latency_tracker
+                                                           : NULL,
+            // The controller is initialized later, but before the demuxer is
+            // started
+            .controller = options->control ? &s->controller : NULL,
+            .stats = stats,
+            // The screen is initialized later, but before the demuxer is
+            // started
+            .fps_counter = options->video_playback ? &s->screen.fps_counter
+                                                   : NULL,
+            .threading = options->video_decoder_threading,
+            .thread_count = options->video_decoder_threads,
+        };
+        if (!sc_decoder_init(&s->video_decoder, "video", &decoder_params)) {
+            goto end;
+        }
+        video_decoder_initialized = true;
+
+        if (!sc_packet_source_add_sink(&s->video_demuxer.packet_source,
+                                       &s->video_decoder.packet_sink)) {
+            goto end;
+        }
     }
     if (needs_audio_decoder) {
-        sc_decoder_init(&s->audio_decoder, "audio");
-        sc_packet_source_add_sink(&s->audio_demuxer.packet_source,
-                                  &s->audio_decoder.packet_sink);
+        if (!sc_decoder_init(&s->audio_decoder, "audio", NULL)) {
+            goto end;
+        }
+        audio_decoder_initialized = true;
+
+        if (!sc_packet_source_add_sink(&s->audio_demuxer.packet_source,
+                                       &s->audio_decoder.packet_sink)) {
+            goto end;
+        }
     }
 
     if (options->record_filename) {
-        static const struct sc_recorder_callbacks recorder_cbs = {
+        if (options->record_upload_url) {
+            if (!sc_record_uploader_init(&s->record_uploader,
+                                         options->record_upload_url)) {
+                goto end;
+            }
+            record_uploader_initialized = true;
+
+            if (!sc_record_uploader_start(&s->record_uploader)) {
+                goto end;
+            }
+            record_uploader_started = true;
+        }
+
+        // Must outlive the recorder
+        static struct sc_recorder_callbacks cbs = {
             .on_ended = sc_recorder_on_ended,
         };
+        bool intra_refresh = options->video_intra_refresh
+            || options->video_latency_profile == SC_VIDEO_LATENCY_PROFILE_LOW;
+        // The separate record video stream does not use intra refresh
+        if (intra_refresh && options->control
+                && !options->record_video_bit_rate) {
+            // With intra refresh, the device encoder produces no periodic
+            // keyframes, so request them explicitly to keep the file seekable
+            cbs.on_keyframe_needed = sc_recorder_on_keyframe_needed;
+        }
+        if (options->record_upload_url) {
+            cbs.on_file_completed = sc_recorder_on_file_completed;
+        }
+        // The controller is initialized later, but before the demuxers are
+        // started
         if (!sc_recorder_init(&s->recorder, options->record_filename,
                               options->record_format, options->video,
                               options->audio, options->record_orientation,
-                              &recorder_cbs, NULL)) {
+                              options->record_fragmented,
+                              options->record_low_latency,
+                              options->record_queue_limit,
+                              options->record_write_buffer,
+                              options->record_segment_duration,
+                              options->record_segment_count, stats, &cbs,
+                              &s->controller)) {
             goto end;
         }
         recorder_initialized = true;
@@ -538,28 +1046,171 @@ scrcpy(struct scrcpy_options *options) {
         }
         recorder_started = true;
 
-        if (options->video) {
-            sc_packet_source_add_sink(&s->video_demuxer.packet_source,
-                                      &s->recorder.video_packet_sink);
+        struct sc_packet_source *video_src = NULL;
+        if (options->record_video_bit_rate) {
+            // The separate record video stream is never decoded
+            video_src = &s->record_video_demuxer.packet_source;
+        } else if (options->video) {
+            video_src = &s->video_demuxer.packet_source;
+        }
+        if (video_src) {
+            if (!sc_packet_source_add_sink(video_src,
+                                           &s->recorder.video_packet_sink)) {
+                goto end;
+            }
+        }
+
+        if (options->record_thumbnails_filename) {
+            assert(video_src);
+            if (!sc_thumbnailer_init(&s->thumbnailer,
+                                     options->record_thumbnails_filename)) {
+                goto end;
+            }
+            thumbnailer_initialized = true;
+
+            if (!sc_thumbnailer_start(&s->thumbnailer)) {
+                goto end;
+            }
+            thumbnailer_started = true;
+
+            if (!sc_packet_source_add_sink(video_src,
+                                           &s->thumbnailer.packet_sink)) {
+                goto end;
+            }
+        }
+        if (options->audio) {
+            if (!sc_packet_source_add_sink(&s->audio_demuxer.packet_source,
+                                           &s->recorder.audio_packet_sink)) {
+                goto end;
+            }
+        }
+    }
+
+    if (options->restream_url) {
+        if (!sc_restreamer_init(&s->restreamer, options->restream_url,
+                                options->restream_format, options->video,
+                                options->audio, stats)) {
+            goto end;
+        }
+        restreamer_initialized = true;
+
+        if (!sc_restreamer_start(&s->restreamer)) {
+            goto end;
+        }
+        restreamer_started = true;
+
+        if (transcode) {
+            uint32_t bit_rate = options->video_bit_rate
+                              ? options->video_bit_rate
+                              : SC_TRANSCODER_DEFAULT_BIT_RATE;
+            if (!sc_transcoder_init(&s->transcoder,
+                                    options->restream_video_encoder,
+                                    bit_rate)) {
+                goto end;
+            }
+            transcoder_initialized = true;
+
+            if (!sc_packet_source_add_sink(&s->transcoder.packet_source,
+                                           &s->restreamer.video_packet_sink)) {
+                goto end;
+            }
+
+            // The encoding must never delay the decoder (nor the screen).
+            // Keep only the latest pending frame: queued hardware frames
+            // would hold surfaces of the (bounded) decoder pool.
+            struct sc_frame_source *src = &s->video_decoder.frame_source;
+            if (!sc_frame_source_add_async_sink(src,
+                                                &s->transcoder.frame_sink,
+                                                SC_FRAME_DISPATCH_LATEST)) {
+                goto end;
+            }
+        } else if (options->video) {
+            if (!sc_packet_source_add_sink(&s->video_demuxer.packet_source,
+                                           &s->restreamer.video_packet_sink)) {
+                goto end;
+            }
         }
         if (options->audio) {
-            sc_packet_source_add_sink(&s->audio_demuxer.packet_source,
-                                      &s->recorder.audio_packet_sink);
+            struct sc_packet_sink *sink = &s->restreamer.audio_packet_sink;
+            if (!sc_packet_source_add_sink(&s->audio_demuxer.packet_source,
+                                           sink)) {
+                goto end;
+            }
+        }
+    }
+
+    struct sc_replay_buffer *replay_buffer = NULL;
+    if (options->replay_buffer_duration) {
+        if (!sc_replay_buffer_init(&s->replay_buffer, options->replay_filename,
+                                   options->replay_format,
+                                   options->replay_buffer_duration)) {
+            goto end;
+        }
+        replay_buffer_initialized = true;
+        replay_buffer = &s->replay_buffer;
+
+        assert(options->video);
+        if (!sc_packet_source_add_sink(&s->video_demuxer.packet_source,
+                                       &s->replay_buffer.video_packet_sink)) {
+            goto end;
+        }
+        if (options->audio) {
+            struct sc_packet_sink *sink = &s->replay_buffer.audio_packet_sink;
+            if (!sc_packet_source_add_sink(&s->audio_demuxer.packet_source,
+                                           sink)) {
+                goto end;
+            }
         }
     }
 
     struct sc_controller *controller = NULL;
     struct sc_key_processor *kp = NULL;
     struct sc_mouse_processor *mp = NULL;
+    struct sc_gamepad_processor *gp = NULL;
 
     if (options->control) {
-        if (!sc_controller_init(&s->controller, s->server.control_socket)) {
+        static const struct sc_controller_callbacks controller_cbs = {
+            .on_file_pushed = sc_controller_on_file_pushed,
+        };
+        if (!sc_controller_init(&s->controller, s->server.control_socket,
+                                stats, &controller_cbs, &s->file_pusher)) {
             goto end;
         }
         controller_initialized = true;
 
         controller = &s->controller;
 
+#ifdef HAVE_CONTROL_COMPRESSION
+        if (options->control_compression
+                && !sc_controller_enable_compression(controller)) {
+            goto end;
+        }
+#endif
+
+        if (options->control_io_loop
+                && !sc_controller_enable_io_loop(controller)) {
+            goto end;
+        }
+
+        if (clock_sync_initialized) {
+            sc_controller_enable_clock_sync(controller, &s->clock_sync);
+        }
+
+        if (options->adaptive_bit_rate || options->adaptive_size) {
+            assert(options->video);
+            struct sc_video_feedback_params fb_params = {
+                .report = options->adaptive_bit_rate,
+                .adaptive_size = options->adaptive_size,
+                .max_size = options->max_size,
+                .max_fps = options->max_fps,
+            };
+            sc_video_feedback_init(&s->video_feedback, controller, &fb_params);
+            if (!sc_packet_source_add_sink(&s->video_demuxer.packet_source,
+                                           &s->video_feedback.packet_sink)) {
+                goto end;
+            }
+        }
+
 #ifdef HAVE_USB
         bool use_keyboard_aoa =
             options->keyboard_input_mode == SC_KEYBOARD_INPUT_MODE_AOA;
@@ -618,7 +1269,8 @@ scrcpy(struct scrcpy_options *options) {
             }
 
             if (use_mouse_aoa) {
-                if (sc_mouse_aoa_init(&s->mouse_aoa, &s->aoa)) {
+                if (sc_mouse_aoa_init(&s->mouse_aoa, &s->aoa,
+                                      options->mouse_report_interval)) {
                     mouse_aoa_initialized = true;
                     mp = &s->mouse_aoa.mouse_processor;
                 } else {
@@ -666,19 +1318,65 @@ scrcpy(struct scrcpy_options *options) {
             sc_mouse_sdk_init(&s->mouse_sdk, &s->controller);
             mp = &s->mouse_sdk.mouse_processor;
         } else if (options->mouse_input_mode == SC_MOUSE_INPUT_MODE_UHID) {
-            bool ok = sc_mouse_uhid_init(&s->mouse_uhid, &s->controller);
+            bool ok = sc_mouse_uhid_init(&s->mouse_uhid, &s->controller,
+                                         options->mouse_report_interval);
             if (!ok) {
                 goto end;
             }
+            mouse_uhid_initialized = true;
             mp = &s->mouse_uhid.mouse_processor;
         }
 
-        sc_controller_configure(&s->controller, acksync, uhid_devices);
+        if (options->gamepad_input_mode == SC_GAMEPAD_INPUT_MODE_UHID) {
+            sc_gamepad_uhid_init(&s->gamepad_uhid, &s->controller);
+            gp = &s->gamepad_uhid.gamepad_processor;
+        }
+
+        struct sc_input_recorder *input_recorder = NULL;
+        if (options->input_record_filename) {
+            if (!sc_input_recorder_init(&s->input_recorder,
+                                        options->input_record_filename)) {
+                goto end;
+            }
+            input_recorder_initialized = true;
+            input_recorder = &s->input_recorder;
+        }
+
+        sc_controller_configure(&s->controller, acksync, uhid_devices,
+                                input_recorder);
 
         if (!sc_controller_start(&s->controller)) {
             goto end;
         }
         controller_started = true;
+
+        if (options->input_replay_filename) {
+            if (!sc_input_replayer_init(&s->input_replayer,
+                                        options->input_replay_filename,
+                                        &s->controller)) {
+                goto end;
+            }
+            input_replayer_initialized = true;
+
+            if (!sc_input_replayer_start(&s->input_replayer)) {
+                goto end;
+            }
+            input_replayer_started = true;
+        }
+
+        if (options->control_port) {
+            if (!sc_control_server_init(&s->control_server,
+                                        options->control_port,
+                                        &s->controller)) {
+                goto end;
+            }
+            control_server_initialized = true;
+
+            if (!sc_control_server_start(&s->control_server)) {
+                goto end;
+            }
+            control_server_started = true;
+        }
     }
 
     // There is a controller if and only if control is enabled
@@ -686,17 +1384,21 @@ scrcpy(struct scrcpy_options *options) {
 
     if (options->video_playback) {
         const char *window_title =
-            options->window_title ? options->window_title : info->device_name;
+            options->window_title ? options->window_title : device_name;
 
         struct sc_screen_params screen_params = {
             .controller = controller,
             .fp = fp,
+            .replay_buffer = replay_buffer,
             .kp = kp,
             .mp = mp,
+            .gp = gp,
             .forward_all_clicks = options->forward_all_clicks,
             .legacy_paste = options->legacy_paste,
             .clipboard_autosync = options->clipboard_autosync,
             .shortcut_mods = &options->shortcut_mods,
+            .max_size = options->max_size,
+            .max_fps = options->max_fps,
             .window_title = window_title,
             .always_on_top = options->always_on_top,
             .window_x = options->window_x,
@@ -706,15 +1408,39 @@ scrcpy(struct scrcpy_options *options) {
             .window_borderless = options->window_borderless,
             .orientation = options->display_orientation,
             .mipmaps = options->mipmaps,
+            .upscale_filter = options->upscale_filter,
+            .input_overlay = options->input_overlay,
+            .perf_overlay = options->perf_overlay,
             .fullscreen = options->fullscreen,
             .start_fps_counter = options->start_fps_counter,
+            .benchmark_startup = options->benchmark_startup,
+            .thumbnail_decoder = options->thumbnail_decoding
+                               ? &s->video_decoder : NULL,
+            .latency_tracker = latency_tracker_initialized ? &s->latency_tracker
+                                                           : NULL,
+            .av_sync = av_sync,
+            .stats = stats,
+            .screenshot_filename = options->screenshot_filename,
         };
 
         struct sc_frame_source *src = &s->video_decoder.frame_source;
-        if (options->display_buffer) {
-            sc_delay_buffer_init(&s->display_buffer, options->display_buffer,
-                                 true);
-            sc_frame_source_add_sink(src, &s->display_buffer.frame_sink);
+        if (options->display_buffer || options->av_sync) {
+            sc_tick delay = options->display_buffer;
+            if (options->av_sync) {
+                // Until the actual audio latency is known, assume the
+                // configured one
+                delay = options->audio_buffer + options->audio_output_buffer;
+            }
+            if (!sc_delay_buffer_init(&s->display_buffer, delay, true,
+                                      options->av_sync ? av_sync : NULL, stats,
+                                      SC_STAT_DISPLAY_BUFFER_QUEUE)) {
+                goto end;
+            }
+            display_buffer_initialized = true;
+
+            if (!sc_frame_source_add_sink(src, &s->display_buffer.frame_sink)) {
+                goto end;
+            }
             src = &s->display_buffer.frame_source;
         }
 
@@ -722,36 +1448,150 @@ scrcpy(struct scrcpy_options *options) {
             goto end;
         }
         screen_initialized = true;
+        sc_startup_timeline_mark(SC_STARTUP_WINDOW_CREATED);
+
+        if (options->display_pacing) {
+            int refresh_rate = 0;
+            SDL_DisplayMode mode;
+            int display_index = SDL_GetWindowDisplayIndex(s->screen.window);
+            if (display_index >= 0
+                    && !SDL_GetCurrentDisplayMode(display_index, &mode)) {
+                refresh_rate = mode.refresh_rate;
+            }
+            LOGD("Display refresh rate: %d Hz", refresh_rate);
 
-        sc_frame_source_add_sink(src, &s->screen.frame_sink);
+            if (!sc_frame_pacer_init(&s->display_pacer,
+                                     options->display_pacing, refresh_rate)) {
+                goto end;
+            }
+            display_pacer_initialized = true;
+
+            if (!sc_frame_source_add_sink(src, &s->display_pacer.frame_sink)) {
+                goto end;
+            }
+            src = &s->display_pacer.frame_source;
+        }
+
+        if (!sc_frame_source_add_sink(src, &s->screen.frame_sink)) {
+            goto end;
+        }
     }
 
     if (options->audio_playback) {
-        sc_audio_player_init(&s->audio_player, options->audio_buffer,
-                             options->audio_output_buffer);
-        sc_frame_source_add_sink(&s->audio_decoder.frame_source,
-                                 &s->audio_player.frame_sink);
+        sc_audio_output_sdl_init(&s->audio_output);
+        struct sc_audio_player_params audio_player_params = {
+            .target_buffering = options->audio_buffer,
+            .min_target_buffering = options->audio_buffer_min,
+            .max_target_buffering = options->audio_buffer_max,
+            .delay = options->audio_delay,
+            .output_buffer = options->audio_output_buffer,
+            .gain = options->audio_volume / 100.f,
+            .output = &s->audio_output.audio_output,
+            .av_sync = av_sync,
+            .stats = stats,
+        };
+        sc_audio_player_init(&s->audio_player, &audio_player_params);
+        if (!sc_frame_source_add_sink(&s->audio_decoder.frame_source,
+                                      &s->audio_player.frame_sink)) {
+            goto end;
+        }
     }
 
 #ifdef HAVE_V4L2
     if (options->v4l2_device) {
-        if (!sc_v4l2_sink_init(&s->v4l2_sink, options->v4l2_device)) {
+        if (!sc_v4l2_sink_init(&s->v4l2_sink, options->v4l2_device,
+                               options->v4l2_format,
+                               options->v4l2_max_size)) {
             goto end;
         }
 
         struct sc_frame_source *src = &s->video_decoder.frame_source;
         if (options->v4l2_buffer) {
-            sc_delay_buffer_init(&s->v4l2_buffer, options->v4l2_buffer, true);
-            sc_frame_source_add_sink(src, &s->v4l2_buffer.frame_sink);
+            if (!sc_delay_buffer_init(&s->v4l2_buffer, options->v4l2_buffer,
+                                      true, NULL, stats,
+                                      SC_STAT_V4L2_BUFFER_QUEUE)) {
+                goto end;
+            }
+            v4l2_buffer_initialized = true;
+
+            if (!sc_frame_source_add_sink(src, &s->v4l2_buffer.frame_sink)) {
+                goto end;
+            }
             src = &s->v4l2_buffer.frame_source;
         }
 
-        sc_frame_source_add_sink(src, &s->v4l2_sink.frame_sink);
-
         v4l2_sink_initialized = true;
+
+        if (!sc_frame_source_add_sink(src, &s->v4l2_sink.frame_sink)) {
+            goto end;
+        }
+    }
+#endif
+
+#ifdef HAVE_FRAME_SHARE
+    if (options->frame_share) {
+        if (!sc_frame_share_init(&s->frame_share, options->frame_share)) {
+            goto end;
+        }
+        frame_share_initialized = true;
+
+        // Only the latest frame is relevant: the copy to the shared memory
+        // must never delay the decoder
+        struct sc_frame_source *src = &s->video_decoder.frame_source;
+        if (!sc_frame_source_add_async_sink(src, &s->frame_share.frame_sink,
+                                            SC_FRAME_DISPATCH_LATEST)) {
+            goto end;
+        }
     }
 #endif
 
+    if (options->screen_stability_delay && options->video) {
+        // The events are sent to the control server client
+        assert(control_server_started);
+
+        static const struct sc_screen_stability_callbacks stability_cbs = {
+            .on_frame = sc_screen_stability_on_frame,
+            .on_stable = sc_screen_stability_on_stable,
+        };
+        if (!sc_screen_stability_init(&s->screen_stability,
+                                      options->screen_stability_delay,
+                                      &stability_cbs, &s->control_server)) {
+            goto end;
+        }
+        screen_stability_initialized = true;
+
+        if (!sc_screen_stability_start(&s->screen_stability)) {
+            goto end;
+        }
+        screen_stability_started = true;
+
+        // Only the latest frame is relevant: the comparison must never delay
+        // the decoder
+        struct sc_frame_source *src = &s->video_decoder.frame_source;
+        if (!sc_frame_source_add_async_sink(src,
+                                            &s->screen_stability.frame_sink,
+                                            SC_FRAME_DISPATCH_LATEST)) {
+            goto end;
+        }
+    }
+
+    if (options->frame_hash_filename && options->video) {
+        if (!sc_frame_hasher_init(&s->frame_hasher,
+                                  options->frame_hash_filename,
+                                  options->frame_hash_interval)) {
+            goto end;
+        }
+        frame_hasher_initialized = true;
+
+        // Every frame must be hashed, but the hashing must never block the
+        // decoder
+        struct sc_frame_source *src = &s->video_decoder.frame_source;
+        if (!sc_frame_source_add_async_sink(src, &s->frame_hasher.frame_sink,
+                                            SC_FRAME_DISPATCH_FIFO)) {
+            goto end;
+        }
+    }
+
     // Now that the header values have been consumed, the socket(s) will
     // receive the stream(s). Start the demuxer(s).
 
@@ -762,6 +1602,13 @@ scrcpy(struct scrcpy_options *options) {
         video_demuxer_started = true;
     }
 
+    if (options->record_video_bit_rate) {
+        if (!sc_demuxer_start(&s->record_video_demuxer)) {
+            goto end;
+        }
+        record_video_demuxer_started = true;
+    }
+
     if (options->audio) {
         if (!sc_demuxer_start(&s->audio_demuxer)) {
             goto end;
@@ -831,6 +1678,18 @@ end:
         sc_acksync_destroy(acksync);
     }
 #endif
+    if (input_replayer_started) {
+        sc_input_replayer_stop(&s->input_replayer);
+    }
+    if (control_server_started) {
+        sc_control_server_stop(&s->control_server);
+    }
+    if (screen_stability_started) {
+        sc_screen_stability_stop(&s->screen_stability);
+    }
+    if (mouse_uhid_initialized) {
+        sc_mouse_uhid_destroy(&s->mouse_uhid);
+    }
     if (controller_started) {
         sc_controller_stop(&s->controller);
     }
@@ -840,6 +1699,12 @@ end:
     if (recorder_initialized) {
         sc_recorder_stop(&s->recorder);
     }
+    if (thumbnailer_initialized) {
+        sc_thumbnailer_stop(&s->thumbnailer);
+    }
+    if (restreamer_initialized) {
+        sc_restreamer_stop(&s->restreamer);
+    }
     if (screen_initialized) {
         sc_screen_interrupt(&s->screen);
     }
@@ -849,6 +1714,19 @@ end:
         sc_server_stop(&s->server);
     }
 
+    if (replay) {
+        // interrupt the replayed streams, like the sockets
+        if (video_stream_file_initialized) {
+            sc_stream_replayer_stop(&s->video_stream_file.replayer);
+        }
+        if (audio_stream_file_initialized) {
+            sc_stream_replayer_stop(&s->audio_stream_file.replayer);
+        }
+        if (record_video_stream_file_initialized) {
+            sc_stream_replayer_stop(&s->record_video_stream_file.replayer);
+        }
+    }
+
     if (timeout_started) {
         sc_timeout_join(&s->timeout);
     }
@@ -866,12 +1744,67 @@ end:
         sc_demuxer_join(&s->audio_demuxer);
     }
 
+    if (record_video_demuxer_started) {
+        sc_demuxer_join(&s->record_video_demuxer);
+    }
+
+    // The demuxers are joined, the sink graph is closed
+    if (video_demuxer_initialized) {
+        sc_demuxer_destroy(&s->video_demuxer);
+    }
+    if (audio_demuxer_initialized) {
+        sc_demuxer_destroy(&s->audio_demuxer);
+    }
+    if (record_video_demuxer_initialized) {
+        sc_demuxer_destroy(&s->record_video_demuxer);
+    }
+    if (video_stream_file_initialized) {
+        destroy_stream_file(&s->video_stream_file, options);
+    }
+    if (audio_stream_file_initialized) {
+        destroy_stream_file(&s->audio_stream_file, options);
+    }
+    if (record_video_stream_file_initialized) {
+        destroy_stream_file(&s->record_video_stream_file, options);
+    }
+    if (video_decoder_initialized) {
+        sc_decoder_destroy(&s->video_decoder);
+    }
+    if (audio_decoder_initialized) {
+        sc_decoder_destroy(&s->audio_decoder);
+    }
+    if (display_buffer_initialized) {
+        sc_delay_buffer_destroy(&s->display_buffer);
+    }
+    if (display_pacer_initialized) {
+        sc_frame_pacer_destroy(&s->display_pacer);
+    }
+#ifdef HAVE_V4L2
+    if (v4l2_buffer_initialized) {
+        sc_delay_buffer_destroy(&s->v4l2_buffer);
+    }
+#endif
+
 #ifdef HAVE_V4L2
     if (v4l2_sink_initialized) {
         sc_v4l2_sink_destroy(&s->v4l2_sink);
     }
 #endif
 
+#ifdef HAVE_FRAME_SHARE
+    if (frame_share_initialized) {
+        sc_frame_share_destroy(&s->frame_share);
+    }
+#endif
+
+    if (transcoder_initialized) {
+        sc_transcoder_destroy(&s->transcoder);
+    }
+
+    if (frame_hasher_initialized) {
+        sc_frame_hasher_destroy(&s->frame_hasher);
+    }
+
 #ifdef HAVE_USB
     if (aoa_hid_initialized) {
         sc_aoa_join(&s->aoa);
@@ -890,6 +1823,35 @@ end:
         sc_screen_destroy(&s->screen);
     }
 
+    // The latency tracker is used by the video decoder and the screen
+    if (latency_tracker_initialized) {
+        sc_latency_tracker_destroy(&s->latency_tracker);
+    }
+
+    // The input replayer pushes messages to the controller
+    if (input_replayer_started) {
+        sc_input_replayer_join(&s->input_replayer);
+    }
+    if (input_replayer_initialized) {
+        sc_input_replayer_destroy(&s->input_replayer);
+    }
+
+    // The screen stability sends events to the control server client
+    if (screen_stability_started) {
+        sc_screen_stability_join(&s->screen_stability);
+    }
+    if (screen_stability_initialized) {
+        sc_screen_stability_destroy(&s->screen_stability);
+    }
+
+    // The control server pushes messages to the controller
+    if (control_server_started) {
+        sc_control_server_join(&s->control_server);
+    }
+    if (control_server_initialized) {
+        sc_control_server_destroy(&s->control_server);
+    }
+
     if (controller_started) {
         sc_controller_join(&s->controller);
     }
@@ -897,6 +1859,16 @@ end:
         sc_controller_destroy(&s->controller);
     }
 
+    // The clock sync is used by the receiver and the latency tracker
+    if (clock_sync_initialized) {
+        sc_clock_sync_destroy(&s->clock_sync);
+    }
+
+    // The input recorder is used by the controller
+    if (input_recorder_initialized) {
+        sc_input_recorder_destroy(&s->input_recorder);
+    }
+
     if (recorder_started) {
         sc_recorder_join(&s->recorder);
     }
@@ -904,11 +1876,52 @@ end:
         sc_recorder_destroy(&s->recorder);
     }
 
+    if (thumbnailer_started) {
+        sc_thumbnailer_join(&s->thumbnailer);
+    }
+    if (thumbnailer_initialized) {
+        sc_thumbnailer_destroy(&s->thumbnailer);
+    }
+
+    // Stopped once the recorder has completed the last file, which is still
+    // uploaded
+    if (record_uploader_initialized) {
+        sc_record_uploader_stop(&s->record_uploader);
+    }
+    if (record_uploader_started) {
+        sc_record_uploader_join(&s->record_uploader);
+    }
+    if (record_uploader_initialized) {
+        sc_record_uploader_destroy(&s->record_uploader);
+    }
+
+    if (restreamer_started) {
+        sc_restreamer_join(&s->restreamer);
+    }
+    if (restreamer_initialized) {
+        sc_restreamer_destroy(&s->restreamer);
+    }
+
+    if (replay_buffer_initialized) {
+        // Wait for the replay being saved, if any
+        sc_replay_buffer_join(&s->replay_buffer);
+        sc_replay_buffer_destroy(&s->replay_buffer);
+    }
+
     if (file_pusher_initialized) {
         sc_file_pusher_join(&s->file_pusher);
         sc_file_pusher_destroy(&s->file_pusher);
     }
 
+    // Stop the stats last, to write the final values
+    if (stats_started) {
+        sc_stats_stop(&s->stats);
+        sc_stats_join(&s->stats);
+    }
+    if (stats_initialized) {
+        sc_stats_destroy(&s->stats);
+    }
+
     if (server_started) {
         sc_server_join(&s->server);
     }
@@ -1,13 +1,19 @@
 #include "screen.h"
 
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 #include <SDL2/SDL.h>
 
 #include "events.h"
+#include "frame_size.h"
 #include "icon.h"
 #include "options.h"
+#include "screenshot.h"
+#include "startup_timeline.h"
+#include "util/file.h"
 #include "util/log.h"
+#include "util/trace.h"
 
 #define DISPLAY_MARGINS 96
 
@@ -203,6 +209,26 @@ sc_screen_toggle_mouse_capture(struct sc_screen *screen) {
     sc_screen_set_mouse_capture(screen, new_value);
 }
 
+// Below this scale (1/ratio), the decoder skips the in-loop filters
+#define SC_SCREEN_THUMBNAIL_RATIO 3
+
+static void
+sc_screen_update_fast_decoding(struct sc_screen *screen) {
+    if (!screen->decoder) {
+        return;
+    }
+
+    struct sc_size content_size = screen->content_size;
+    bool fast = screen->rect.w * SC_SCREEN_THUMBNAIL_RATIO
+                    <= content_size.width
+             && screen->rect.h * SC_SCREEN_THUMBNAIL_RATIO
+                    <= content_size.height;
+    if (fast != screen->fast_decoding) {
+        screen->fast_decoding = fast;
+        sc_decoder_set_fast_decoding(screen->decoder, fast);
+    }
+}
+
 static void
 sc_screen_update_content_rect(struct sc_screen *screen) {
     int dw;
@@ -220,6 +246,7 @@ sc_screen_update_content_rect(struct sc_screen *screen) {
         rect->y = 0;
         rect->w = drawable_size.width;
         rect->h = drawable_size.height;
+        sc_screen_update_fast_decoding(screen);
         return;
     }
 
@@ -238,6 +265,8 @@ sc_screen_update_content_rect(struct sc_screen *screen) {
                                        / content_size.height;
         rect->x = (drawable_size.width - rect->w) / 2;
     }
+
+    sc_screen_update_fast_decoding(screen);
 }
 
 // render the texture to the renderer
@@ -246,13 +275,49 @@ sc_screen_update_content_rect(struct sc_screen *screen) {
 // changed, so that the content rectangle is recomputed
 static void
 sc_screen_render(struct sc_screen *screen, bool update_content_rect) {
-    if (update_content_rect) {
+    if (update_content_rect
+            || (screen->damage & SC_SCREEN_DAMAGE_CONTENT_RECT)) {
         sc_screen_update_content_rect(screen);
     }
+    // Any damage is repaired by this render
+    screen->damage = 0;
 
+    sc_trace_begin("render");
     enum sc_display_result res =
-        sc_display_render(&screen->display, &screen->rect, screen->orientation);
+        sc_display_render(&screen->display, &screen->rect, screen->orientation,
+                          screen->input_overlay, screen->perf_overlay);
+    sc_trace_end();
     (void) res; // any error already logged
+    screen->input_overlay_dirty = false;
+}
+
+static inline bool
+sc_screen_rect_equals(const SDL_Rect *a, const SDL_Rect *b) {
+    return a->x == b->x && a->y == b->y && a->w == b->w && a->h == b->h;
+}
+
+// Render once all the queued window events are handled, and only if the
+// content actually changed: the texture is not uploaded again in any case, an
+// expose event only presents the current texture again
+static void
+sc_screen_repair_damage(struct sc_screen *screen) {
+    if (!screen->damage || SDL_HasEvent(SDL_WINDOWEVENT)) {
+        // Nothing to do, or wait for the last event of the burst
+        return;
+    }
+
+    if (!(screen->damage & SC_SCREEN_DAMAGE_EXPOSED)) {
+        assert(screen->damage == SC_SCREEN_DAMAGE_CONTENT_RECT);
+        SDL_Rect old_rect = screen->rect;
+        sc_screen_update_content_rect(screen);
+        screen->damage = 0;
+        if (sc_screen_rect_equals(&old_rect, &screen->rect)) {
+            // The window content is still valid
+            return;
+        }
+    }
+
+    sc_screen_render(screen, false);
 }
 
 #if defined(__APPLE__) || defined(__WINDOWS__)
@@ -335,9 +400,13 @@ sc_screen_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
 
     if (previous_skipped) {
         sc_fps_counter_add_skipped_frame(&screen->fps_counter);
-        // The SC_EVENT_NEW_FRAME triggered for the previous frame will consume
-        // this new frame instead
-    } else {
+        sc_stats_add(screen->stats, SC_STAT_FRAMES_SKIPPED, 1);
+    }
+
+    // The UI thread consumes the pending frame before handling any other
+    // event, so the event is only needed to wake it up: do not post it if the
+    // previous one has not been handled yet
+    if (!atomic_exchange(&screen->new_frame_event_queued, true)) {
         static SDL_Event new_frame_event = {
             .type = SC_EVENT_NEW_FRAME,
         };
@@ -346,6 +415,7 @@ sc_screen_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
         int ret = SDL_PushEvent(&new_frame_event);
         if (ret < 0) {
             LOGW("Could not post new frame event: %s", SDL_GetError());
+            atomic_store(&screen->new_frame_event_queued, false);
             return false;
         }
     }
@@ -361,16 +431,46 @@ sc_screen_init(struct sc_screen *screen,
     screen->fullscreen = false;
     screen->maximized = false;
     screen->minimized = false;
+    screen->hidden = false;
+    screen->upload_pending = false;
     screen->mouse_capture_key_pressed = 0;
 
+    // The overlay is only meaningful if the pointer events are forwarded
+    if (params->input_overlay && params->mp) {
+        sc_input_overlay_init(&screen->input_overlay_state);
+        screen->input_overlay = &screen->input_overlay_state;
+    } else {
+        screen->input_overlay = NULL;
+    }
+    screen->input_overlay_dirty = false;
+    screen->damage = 0;
+
+    if (params->perf_overlay) {
+        assert(params->stats);
+        sc_perf_overlay_init(&screen->perf_overlay_state, params->stats);
+        screen->perf_overlay = &screen->perf_overlay_state;
+    } else {
+        screen->perf_overlay = NULL;
+    }
+
     screen->req.x = params->window_x;
     screen->req.y = params->window_y;
     screen->req.width = params->window_width;
     screen->req.height = params->window_height;
     screen->req.fullscreen = params->fullscreen;
     screen->req.start_fps_counter = params->start_fps_counter;
-
-    bool ok = sc_frame_buffer_init(&screen->fb);
+    screen->latency_tracker = params->latency_tracker;
+    screen->av_sync = params->av_sync;
+    screen->stats = params->stats;
+    screen->benchmark_startup = params->benchmark_startup;
+    screen->screenshot_filename = params->screenshot_filename;
+    screen->screenshot_index = 0;
+    screen->decoder = params->thumbnail_decoder;
+    screen->fast_decoding = false;
+
+    atomic_init(&screen->new_frame_event_queued, false);
+
+    bool ok = sc_frame_buffer_init(&screen->fb, params->stats);
     if (!ok) {
         return false;
     }
@@ -396,6 +496,7 @@ sc_screen_init(struct sc_screen *screen,
     }
 
     // The window will be positioned and sized on first video frame
+    screen->window_title = params->window_title;
     screen->window =
         SDL_CreateWindow(params->window_title, 0, 0, 0, 0, window_flags);
     if (!screen->window) {
@@ -403,7 +504,8 @@ sc_screen_init(struct sc_screen *screen,
         goto error_destroy_fps_counter;
     }
 
-    ok = sc_display_init(&screen->display, screen->window, params->mipmaps);
+    ok = sc_display_init(&screen->display, screen->window, params->mipmaps,
+                         params->upscale_filter);
     if (!ok) {
         goto error_destroy_window;
     }
@@ -426,12 +528,16 @@ sc_screen_init(struct sc_screen *screen,
         .controller = params->controller,
         .fp = params->fp,
         .screen = screen,
+        .replay_buffer = params->replay_buffer,
         .kp = params->kp,
         .mp = params->mp,
+        .gp = params->gp,
         .forward_all_clicks = params->forward_all_clicks,
         .legacy_paste = params->legacy_paste,
         .clipboard_autosync = params->clipboard_autosync,
         .shortcut_mods = params->shortcut_mods,
+        .max_size = params->max_size,
+        .max_fps = params->max_fps,
     };
 
     sc_input_manager_init(&screen->im, &im_params);
@@ -513,6 +619,8 @@ sc_screen_destroy(struct sc_screen *screen) {
     assert(!screen->open);
 #endif
     sc_display_destroy(&screen->display);
+    sc_stats_add(screen->stats, SC_STAT_MEM_FRAME_BUFFER_BYTES,
+                 -(int64_t) sc_frame_get_size(screen->frame));
     av_frame_free(&screen->frame);
     SDL_DestroyWindow(screen->window);
     sc_fps_counter_destroy(&screen->fps_counter);
@@ -559,6 +667,23 @@ apply_pending_resize(struct sc_screen *screen) {
     }
 }
 
+void
+sc_screen_set_title_status(struct sc_screen *screen, const char *status) {
+    if (!status) {
+        SDL_SetWindowTitle(screen->window, screen->window_title);
+        return;
+    }
+
+    char title[256];
+    int r = snprintf(title, sizeof(title), "%s - %s", screen->window_title,
+                     status);
+    if (r < 0) {
+        return;
+    }
+    // a truncated title is fine
+    SDL_SetWindowTitle(screen->window, title);
+}
+
 void
 sc_screen_set_orientation(struct sc_screen *screen,
                           enum sc_orientation orientation) {
@@ -615,11 +740,20 @@ prepare_for_frame(struct sc_screen *screen, struct sc_size new_frame_size) {
 
 static bool
 sc_screen_update_frame(struct sc_screen *screen) {
+    // The frame being displayed is accounted as held in the frame buffer
+    sc_stats_add(screen->stats, SC_STAT_MEM_FRAME_BUFFER_BYTES,
+                 -(int64_t) sc_frame_get_size(screen->frame));
     av_frame_unref(screen->frame);
     sc_frame_buffer_consume(&screen->fb, screen->frame);
     AVFrame *frame = screen->frame;
+    sc_stats_add(screen->stats, SC_STAT_MEM_FRAME_BUFFER_BYTES,
+                 sc_frame_get_size(frame));
 
-    sc_fps_counter_add_rendered_frame(&screen->fps_counter);
+    int64_t pts = frame->pts;
+    if (screen->latency_tracker) {
+        sc_latency_tracker_on_stage(screen->latency_tracker,
+                                    SC_LATENCY_STAGE_CONSUMED, pts);
+    }
 
     struct sc_size new_frame_size = {frame->width, frame->height};
     enum sc_display_result res = prepare_for_frame(screen, new_frame_size);
@@ -631,7 +765,24 @@ sc_screen_update_frame(struct sc_screen *screen) {
         return true;
     }
 
+    if (screen->has_frame && (screen->minimized || screen->hidden)) {
+        // Nothing is visible, keep only the reference to the last frame, it
+        // will be uploaded once the window is visible again
+        screen->upload_pending = true;
+        return true;
+    }
+    screen->upload_pending = false;
+
+    sc_fps_counter_add_rendered_frame(&screen->fps_counter);
+    sc_stats_add(screen->stats, SC_STAT_FRAMES_RENDERED, 1);
+
+    sc_tick upload_start = sc_tick_now();
+    sc_trace_begin_pts("upload", pts);
     res = sc_display_update_texture(&screen->display, frame);
+    sc_trace_end();
+    sc_fps_counter_add_duration(&screen->fps_counter,
+                                SC_FPS_COUNTER_TIMING_UPLOAD,
+                                sc_tick_now() - upload_start);
     if (res == SC_DISPLAY_RESULT_ERROR) {
         return false;
     }
@@ -640,7 +791,8 @@ sc_screen_update_frame(struct sc_screen *screen) {
         return true;
     }
 
-    if (!screen->has_frame) {
+    bool first_frame = !screen->has_frame;
+    if (first_frame) {
         screen->has_frame = true;
         // this is the very first frame, show the window
         sc_screen_show_initial_window(screen);
@@ -651,10 +803,56 @@ sc_screen_update_frame(struct sc_screen *screen) {
         }
     }
 
+    if (screen->perf_overlay) {
+        sc_perf_overlay_on_frame(screen->perf_overlay, sc_tick_now());
+    }
+
+    sc_tick present_start = sc_tick_now();
     sc_screen_render(screen, false);
+    sc_fps_counter_add_duration(&screen->fps_counter,
+                                SC_FPS_COUNTER_TIMING_PRESENT,
+                                sc_tick_now() - present_start);
+
+    if (screen->latency_tracker) {
+        sc_latency_tracker_on_stage(screen->latency_tracker,
+                                    SC_LATENCY_STAGE_PRESENTED, pts);
+    }
+
+    if (first_frame) {
+        sc_startup_timeline_mark(SC_STARTUP_FIRST_PRESENT);
+        if (screen->benchmark_startup) {
+            static SDL_Event event = {
+                .type = SC_EVENT_STARTUP_COMPLETED,
+            };
+
+            int ret = SDL_PushEvent(&event);
+            if (ret < 0) {
+                LOGW("Could not post startup completed event: %s",
+                     SDL_GetError());
+            }
+        }
+    }
+
+    if (screen->av_sync) {
+        sc_av_sync_on_video_presented(screen->av_sync, pts);
+    }
+
     return true;
 }
 
+// Upload the last frame if it has been skipped while the window was not visible
+static bool
+sc_screen_upload_pending_frame(struct sc_screen *screen) {
+    if (!screen->upload_pending) {
+        return true;
+    }
+
+    screen->upload_pending = false;
+    enum sc_display_result res =
+        sc_display_update_texture(&screen->display, screen->frame);
+    return res != SC_DISPLAY_RESULT_ERROR;
+}
+
 void
 sc_screen_switch_fullscreen(struct sc_screen *screen) {
     uint32_t new_mode = screen->fullscreen ? 0 : SDL_WINDOW_FULLSCREEN_DESKTOP;
@@ -713,15 +911,124 @@ sc_screen_resize_to_pixel_perfect(struct sc_screen *screen) {
                                             content_size.height);
 }
 
+bool
+sc_screen_save_screenshot(struct sc_screen *screen) {
+    if (!screen->screenshot_filename) {
+        LOGW("Screenshots are disabled (see --screenshot-file)");
+        return false;
+    }
+
+    if (!screen->has_frame) {
+        LOGW("No frame to save yet");
+        return false;
+    }
+
+    char *filename = sc_file_get_numbered_path(screen->screenshot_filename,
+                                               screen->screenshot_index);
+    if (!filename) {
+        return false;
+    }
+
+    // The last consumed frame is kept until the next one is consumed, so it
+    // can be saved directly, without requesting anything from the device
+    bool ok = sc_screenshot_save(screen->frame, filename);
+    if (ok) {
+        LOGI("Screenshot saved to %s", filename);
+        ++screen->screenshot_index;
+    } else {
+        LOGE("Could not save screenshot to %s", filename);
+    }
+
+    free(filename);
+    return ok;
+}
+
 static inline bool
 sc_screen_is_mouse_capture_key(SDL_Keycode key) {
     return key == SDLK_LALT || key == SDLK_LGUI || key == SDLK_RGUI;
 }
 
+static void
+sc_screen_update_input_overlay(struct sc_screen *screen,
+                               const SDL_Event *event) {
+    struct sc_input_overlay *overlay = screen->input_overlay;
+    sc_tick now = sc_tick_now();
+    bool changed = false;
+
+    switch (event->type) {
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            if (event->button.which == SDL_TOUCH_MOUSEID
+                    || event->button.button != SDL_BUTTON_LEFT) {
+                break;
+            }
+            if (event->type == SDL_MOUSEBUTTONDOWN) {
+                int32_t x = event->button.x;
+                int32_t y = event->button.y;
+                sc_screen_hidpi_scale_coords(screen, &x, &y);
+                changed = sc_input_overlay_press(overlay, POINTER_ID_MOUSE,
+                                                 x, y, now);
+            } else {
+                changed = sc_input_overlay_release(overlay, POINTER_ID_MOUSE);
+            }
+            break;
+        case SDL_MOUSEMOTION: {
+            if (event->motion.which == SDL_TOUCH_MOUSEID
+                    || !(event->motion.state & SDL_BUTTON_LMASK)) {
+                break;
+            }
+            int32_t x = event->motion.x;
+            int32_t y = event->motion.y;
+            sc_screen_hidpi_scale_coords(screen, &x, &y);
+            changed = sc_input_overlay_move(overlay, POINTER_ID_MOUSE, x, y,
+                                            now);
+            break;
+        }
+        case SDL_FINGERDOWN:
+        case SDL_FINGERMOTION:
+        case SDL_FINGERUP: {
+            uint64_t id = event->tfinger.fingerId;
+            if (event->type == SDL_FINGERUP) {
+                changed = sc_input_overlay_release(overlay, id);
+                break;
+            }
+
+            int dw;
+            int dh;
+            SDL_GL_GetDrawableSize(screen->window, &dw, &dh);
+            // SDL touch event coordinates are normalized in the range [0; 1]
+            int32_t x = event->tfinger.x * dw;
+            int32_t y = event->tfinger.y * dh;
+            if (event->type == SDL_FINGERDOWN) {
+                changed = sc_input_overlay_press(overlay, id, x, y, now);
+            } else {
+                changed = sc_input_overlay_move(overlay, id, x, y, now);
+            }
+            break;
+        }
+    }
+
+    if (changed) {
+        screen->input_overlay_dirty = true;
+    }
+}
+
 bool
 sc_screen_handle_event(struct sc_screen *screen, const SDL_Event *event) {
     bool relative_mode = sc_screen_is_relative_mode(screen);
 
+    if (screen->has_frame && event->type != SC_EVENT_NEW_FRAME
+            && sc_frame_buffer_has_pending(&screen->fb)) {
+        // Do not make a new frame wait behind the queued input and window
+        // events (the first frame is always handled by its own event, after
+        // the screen size initialization)
+        bool ok = sc_screen_update_frame(screen);
+        if (!ok) {
+            LOGE("Frame update failed\n");
+            return false;
+        }
+    }
+
     switch (event->type) {
         case SC_EVENT_SCREEN_INIT_SIZE: {
             // The initial size is passed via screen->frame_size
@@ -733,6 +1040,14 @@ sc_screen_handle_event(struct sc_screen *screen, const SDL_Event *event) {
             return true;
         }
         case SC_EVENT_NEW_FRAME: {
+            // Reset the flag before consuming, so that a frame pushed
+            // meanwhile posts a new event
+            atomic_store(&screen->new_frame_event_queued, false);
+            if (!sc_frame_buffer_has_pending(&screen->fb)) {
+                // Already consumed before another event
+                return true;
+            }
+
             bool ok = sc_screen_update_frame(screen);
             if (!ok) {
                 LOGE("Frame update failed\n");
@@ -747,10 +1062,10 @@ sc_screen_handle_event(struct sc_screen *screen, const SDL_Event *event) {
             }
             switch (event->window.event) {
                 case SDL_WINDOWEVENT_EXPOSED:
-                    sc_screen_render(screen, true);
+                    screen->damage |= SC_SCREEN_DAMAGE_EXPOSED;
                     break;
                 case SDL_WINDOWEVENT_SIZE_CHANGED:
-                    sc_screen_render(screen, true);
+                    screen->damage |= SC_SCREEN_DAMAGE_CONTENT_RECT;
                     break;
                 case SDL_WINDOWEVENT_MAXIMIZED:
                     screen->maximized = true;
@@ -758,7 +1073,23 @@ sc_screen_handle_event(struct sc_screen *screen, const SDL_Event *event) {
                 case SDL_WINDOWEVENT_MINIMIZED:
                     screen->minimized = true;
                     break;
+                case SDL_WINDOWEVENT_HIDDEN:
+                    screen->hidden = true;
+                    break;
+                case SDL_WINDOWEVENT_SHOWN:
+                    screen->hidden = false;
+                    if (!sc_screen_upload_pending_frame(screen)) {
+                        return false;
+                    }
+                    screen->damage |= SC_SCREEN_DAMAGE_CONTENT_RECT
+                                    | SC_SCREEN_DAMAGE_EXPOSED;
+                    break;
                 case SDL_WINDOWEVENT_RESTORED:
+                    // The window is visible in any case
+                    screen->minimized = false;
+                    if (!sc_screen_upload_pending_frame(screen)) {
+                        return false;
+                    }
                     if (screen->fullscreen) {
                         // On Windows, in maximized+fullscreen, disabling
                         // fullscreen mode unexpectedly triggers the "restored"
@@ -768,16 +1099,22 @@ sc_screen_handle_event(struct sc_screen *screen, const SDL_Event *event) {
                         break;
                     }
                     screen->maximized = false;
-                    screen->minimized = false;
                     apply_pending_resize(screen);
-                    sc_screen_render(screen, true);
+                    screen->damage |= SC_SCREEN_DAMAGE_CONTENT_RECT
+                                    | SC_SCREEN_DAMAGE_EXPOSED;
                     break;
                 case SDL_WINDOWEVENT_FOCUS_LOST:
                     if (relative_mode) {
                         sc_screen_set_mouse_capture(screen, false);
                     }
+                    if (screen->input_overlay) {
+                        // The release events may never be received
+                        sc_input_overlay_clear(screen->input_overlay);
+                        screen->damage |= SC_SCREEN_DAMAGE_EXPOSED;
+                    }
                     break;
             }
+            sc_screen_repair_damage(screen);
             return true;
         case SDL_KEYDOWN:
             if (relative_mode) {
@@ -837,7 +1174,20 @@ sc_screen_handle_event(struct sc_screen *screen, const SDL_Event *event) {
             break;
     }
 
+    if (screen->input_overlay) {
+        sc_screen_update_input_overlay(screen, event);
+    }
+
     sc_input_manager_handle_event(&screen->im, event);
+
+    if (screen->input_overlay_dirty && screen->has_frame
+            && !SDL_HasEvent(SDL_MOUSEMOTION)
+            && !SDL_HasEvent(SDL_FINGERMOTION)) {
+        // Render immediately rather than waiting for the next frame, but
+        // only once for a burst of motion events
+        sc_screen_render(screen, false);
+    }
+
     return true;
 }
 
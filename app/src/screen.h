@@ -3,20 +3,28 @@
 
 #include "common.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <SDL2/SDL.h>
 #include <libavformat/avformat.h>
 
 #include "controller.h"
 #include "coords.h"
+#include "decoder.h"
 #include "display.h"
 #include "fps_counter.h"
 #include "frame_buffer.h"
 #include "input_manager.h"
+#include "input_overlay.h"
+#include "av_sync.h"
+#include "latency_tracker.h"
 #include "opengl.h"
 #include "options.h"
+#include "perf_overlay.h"
+#include "stats.h"
 #include "trait/key_processor.h"
 #include "trait/frame_sink.h"
+#include "trait/gamepad_processor.h"
 #include "trait/mouse_processor.h"
 
 struct sc_screen {
@@ -29,7 +37,16 @@ struct sc_screen {
     struct sc_display display;
     struct sc_input_manager im;
     struct sc_frame_buffer fb;
+    // Set while a SC_EVENT_NEW_FRAME is in the event queue
+    atomic_bool new_frame_event_queued;
     struct sc_fps_counter fps_counter;
+    struct sc_latency_tracker *latency_tracker; // may be NULL
+    struct sc_av_sync *av_sync; // may be NULL
+    struct sc_stats *stats; // may be NULL
+    bool benchmark_startup;
+    // If set, enable fast decoding while the video is strongly downscaled
+    struct sc_decoder *decoder;
+    bool fast_decoding;
 
     // The initial requested window properties
     struct {
@@ -42,6 +59,7 @@ struct sc_screen {
     } req;
 
     SDL_Window *window;
+    const char *window_title; // without status
     struct sc_size frame_size;
     struct sc_size content_size; // rotated frame_size
 
@@ -58,24 +76,50 @@ struct sc_screen {
     bool fullscreen;
     bool maximized;
     bool minimized;
+    bool hidden;
+    // The last frame has not been uploaded, because the window was not
+    // visible
+    bool upload_pending;
 
     // To enable/disable mouse capture, a mouse capture key (LALT, LGUI or
     // RGUI) must be pressed. This variable tracks the pressed capture key.
     SDL_Keycode mouse_capture_key_pressed;
 
+    // Local feedback of the pressed pointers (NULL if disabled)
+    struct sc_input_overlay *input_overlay;
+    struct sc_input_overlay input_overlay_state;
+    bool input_overlay_dirty; // a render is needed to show the changes
+
+    // Window events to handle by the next render, deferred until the queued
+    // window events are processed (several events often come in a burst)
+#define SC_SCREEN_DAMAGE_CONTENT_RECT 1 // the window size may have changed
+#define SC_SCREEN_DAMAGE_EXPOSED 2 // the window content must be redrawn
+    uint8_t damage;
+
+    // Live performance summary (NULL if disabled)
+    struct sc_perf_overlay *perf_overlay;
+    struct sc_perf_overlay perf_overlay_state;
+
+    const char *screenshot_filename; // may be NULL
+    unsigned screenshot_index;
+
     AVFrame *frame;
 };
 
 struct sc_screen_params {
     struct sc_controller *controller;
     struct sc_file_pusher *fp;
+    struct sc_replay_buffer *replay_buffer; // may be NULL
     struct sc_key_processor *kp;
     struct sc_mouse_processor *mp;
+    struct sc_gamepad_processor *gp; // may be NULL
 
     bool forward_all_clicks;
     bool legacy_paste;
     bool clipboard_autosync;
     const struct sc_shortcut_mods *shortcut_mods;
+    uint16_t max_size; // initial video limits, to be restored
+    uint16_t max_fps;
 
     const char *window_title;
     bool always_on_top;
@@ -89,9 +133,18 @@ struct sc_screen_params {
 
     enum sc_orientation orientation;
     bool mipmaps;
+    enum sc_upscale_filter upscale_filter;
+    bool input_overlay;
+    bool perf_overlay; // requires stats
 
     bool fullscreen;
     bool start_fps_counter;
+    bool benchmark_startup; // notify when the first frame is presented
+    struct sc_decoder *thumbnail_decoder; // may be NULL
+    struct sc_latency_tracker *latency_tracker; // may be NULL
+    struct sc_av_sync *av_sync; // may be NULL
+    struct sc_stats *stats; // may be NULL
+    const char *screenshot_filename; // may be NULL
 };
 
 // initialize screen, create window, renderer and texture (window is hidden)
@@ -130,6 +183,14 @@ sc_screen_resize_to_fit(struct sc_screen *screen);
 void
 sc_screen_resize_to_pixel_perfect(struct sc_screen *screen);
 
+// save the last decoded frame to a numbered PNG file (--screenshot-file)
+bool
+sc_screen_save_screenshot(struct sc_screen *screen);
+
+// set a status displayed after the window title (NULL to remove it)
+void
+sc_screen_set_title_status(struct sc_screen *screen, const char *status);
+
 // set the display orientation
 void
 sc_screen_set_orientation(struct sc_screen *screen,
@@ -0,0 +1,202 @@
+#include "screen_stability.h"
+
+#include <assert.h>
+#include <libavutil/frame.h>
+
+#include "util/log.h"
+#include "util/luma.h"
+
+/** Downcast frame_sink to sc_screen_stability */
+#define DOWNCAST(SINK) \
+    container_of(SINK, struct sc_screen_stability, frame_sink)
+
+static bool
+has_luma_plane(enum AVPixelFormat format) {
+    switch (format) {
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+        case AV_PIX_FMT_NV12:
+        case AV_PIX_FMT_NV21:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void
+sc_screen_stability_on_change(struct sc_screen_stability *ss, int64_t pts) {
+    sc_mutex_lock(&ss->mutex);
+    ss->pending = true;
+    ss->last_change = sc_tick_now();
+    ss->last_change_pts = pts;
+    sc_cond_signal(&ss->cond);
+    sc_mutex_unlock(&ss->mutex);
+}
+
+static bool
+sc_screen_stability_push(struct sc_screen_stability *ss, const AVFrame *frame) {
+    if (!has_luma_plane(frame->format)) {
+        if (!ss->format_warned) {
+            LOGW("Screen stability: unsupported frame format %d, frames "
+                 "ignored", frame->format);
+            ss->format_warned = true;
+        }
+        return true;
+    }
+
+    unsigned index = ss->has_grid ? !ss->grid_index : 0;
+    uint8_t *grid = ss->grids[index];
+    sc_luma_downsample(frame->data[0], frame->linesize[0], frame->width,
+                       frame->height, grid, SC_SCREEN_STABILITY_GRID_WIDTH,
+                       SC_SCREEN_STABILITY_GRID_HEIGHT);
+
+    float ratio;
+    if (ss->has_grid) {
+        size_t changes =
+            sc_luma_count_changes(ss->grids[ss->grid_index], grid,
+                                  SC_SCREEN_STABILITY_GRID_SIZE,
+                                  SC_SCREEN_STABILITY_CELL_THRESHOLD);
+        ratio = (float) changes / SC_SCREEN_STABILITY_GRID_SIZE;
+    } else {
+        // The first frame is a change
+        ratio = 1;
+        ss->has_grid = true;
+    }
+    ss->grid_index = index;
+
+    if (ratio > 0) {
+        sc_screen_stability_on_change(ss, frame->pts);
+    }
+
+    if (ss->cbs->on_frame) {
+        ss->cbs->on_frame(ss, frame->pts, ratio, ss->cbs_userdata);
+    }
+
+    return true;
+}
+
+static bool
+sc_screen_stability_frame_sink_open(struct sc_frame_sink *sink,
+                                    const AVCodecContext *ctx) {
+    (void) ctx;
+    struct sc_screen_stability *ss = DOWNCAST(sink);
+    ss->grid_index = 0;
+    ss->has_grid = false;
+    ss->format_warned = false;
+    return true;
+}
+
+static void
+sc_screen_stability_frame_sink_close(struct sc_frame_sink *sink) {
+    (void) sink;
+    // Nothing to do
+}
+
+static bool
+sc_screen_stability_frame_sink_push(struct sc_frame_sink *sink,
+                                    const AVFrame *frame) {
+    struct sc_screen_stability *ss = DOWNCAST(sink);
+    return sc_screen_stability_push(ss, frame);
+}
+
+bool
+sc_screen_stability_init(struct sc_screen_stability *ss, sc_tick delay,
+                         const struct sc_screen_stability_callbacks *cbs,
+                         void *cbs_userdata) {
+    assert(delay > 0);
+    assert(cbs && cbs->on_stable);
+
+    bool ok = sc_mutex_init(&ss->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&ss->cond);
+    if (!ok) {
+        sc_mutex_destroy(&ss->mutex);
+        return false;
+    }
+
+    ss->delay = delay;
+    ss->stopped = false;
+    ss->pending = false;
+    ss->cbs = cbs;
+    ss->cbs_userdata = cbs_userdata;
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = sc_screen_stability_frame_sink_open,
+        .close = sc_screen_stability_frame_sink_close,
+        .push = sc_screen_stability_frame_sink_push,
+    };
+
+    ss->frame_sink.ops = &ops;
+
+    return true;
+}
+
+void
+sc_screen_stability_destroy(struct sc_screen_stability *ss) {
+    sc_cond_destroy(&ss->cond);
+    sc_mutex_destroy(&ss->mutex);
+}
+
+static int
+run_screen_stability(void *data) {
+    struct sc_screen_stability *ss = data;
+
+    sc_mutex_lock(&ss->mutex);
+    while (!ss->stopped) {
+        if (!ss->pending) {
+            sc_cond_wait(&ss->cond, &ss->mutex);
+            continue;
+        }
+
+        sc_tick deadline = ss->last_change + ss->delay;
+        if (sc_tick_now() < deadline) {
+            // Woken up early on a new change (or spuriously), the deadline is
+            // recomputed
+            sc_cond_timedwait(&ss->cond, &ss->mutex, deadline);
+            continue;
+        }
+
+        ss->pending = false;
+        int64_t pts = ss->last_change_pts;
+        sc_mutex_unlock(&ss->mutex);
+
+        ss->cbs->on_stable(ss, pts, ss->cbs_userdata);
+
+        sc_mutex_lock(&ss->mutex);
+    }
+    sc_mutex_unlock(&ss->mutex);
+
+    LOGD("Screen stability thread ended");
+
+    return 0;
+}
+
+bool
+sc_screen_stability_start(struct sc_screen_stability *ss) {
+    LOGD("Starting screen stability thread");
+
+    bool ok = sc_thread_create(&ss->thread, run_screen_stability,
+                               "scrcpy-stable", ss);
+    if (!ok) {
+        LOGE("Could not start screen stability thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_screen_stability_stop(struct sc_screen_stability *ss) {
+    sc_mutex_lock(&ss->mutex);
+    ss->stopped = true;
+    sc_cond_signal(&ss->cond);
+    sc_mutex_unlock(&ss->mutex);
+}
+
+void
+sc_screen_stability_join(struct sc_screen_stability *ss) {
+    sc_thread_join(&ss->thread, NULL);
+}
@@ -0,0 +1,88 @@
+#ifndef SC_SCREEN_STABILITY_H
+#define SC_SCREEN_STABILITY_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "trait/frame_sink.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+#define SC_SCREEN_STABILITY_GRID_WIDTH 32
+#define SC_SCREEN_STABILITY_GRID_HEIGHT 32
+#define SC_SCREEN_STABILITY_GRID_SIZE \
+    (SC_SCREEN_STABILITY_GRID_WIDTH * SC_SCREEN_STABILITY_GRID_HEIGHT)
+// A cell is changed if its average luma changes by more than this value (so
+// that the encoding noise is ignored)
+#define SC_SCREEN_STABILITY_CELL_THRESHOLD 2
+
+struct sc_screen_stability;
+
+struct sc_screen_stability_callbacks {
+    // Called for each frame with the ratio of the screen changed since the
+    // previous frame (in [0, 1]), from the frame sink thread
+    void (*on_frame)(struct sc_screen_stability *ss, int64_t pts,
+                     float change_ratio, void *userdata);
+
+    // Called once the screen has not changed for the stable delay, with the
+    // PTS of the last change, from the stability thread
+    void (*on_stable)(struct sc_screen_stability *ss, int64_t pts,
+                      void *userdata);
+};
+
+/**
+ * Detect when the screen content becomes stable (e.g. once the animations are
+ * finished), from the decoded frames
+ *
+ * Each frame is downsampled to a small grid of average luma values, compared
+ * to the grid of the previous frame. The device does not send any frame while
+ * the screen does not change, so the stable delay is measured by a separate
+ * thread, from the reception of the last changed frame.
+ *
+ * This must be added to a frame source with an asynchronous dispatch, so that
+ * the comparison never blocks the decoder.
+ */
+struct sc_screen_stability {
+    struct sc_frame_sink frame_sink; // frame sink trait
+
+    sc_tick delay;
+
+    // Only used by the frame sink thread
+    uint8_t grids[2][SC_SCREEN_STABILITY_GRID_SIZE];
+    unsigned grid_index; // the grid of the last frame
+    bool has_grid;
+    bool format_warned;
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    bool stopped;
+    // Set when the screen has changed, until the stability is reported
+    bool pending;
+    sc_tick last_change;
+    int64_t last_change_pts;
+
+    const struct sc_screen_stability_callbacks *cbs;
+    void *cbs_userdata;
+};
+
+bool
+sc_screen_stability_init(struct sc_screen_stability *ss, sc_tick delay,
+                         const struct sc_screen_stability_callbacks *cbs,
+                         void *cbs_userdata);
+
+void
+sc_screen_stability_destroy(struct sc_screen_stability *ss);
+
+bool
+sc_screen_stability_start(struct sc_screen_stability *ss);
+
+void
+sc_screen_stability_stop(struct sc_screen_stability *ss);
+
+void
+sc_screen_stability_join(struct sc_screen_stability *ss);
+
+#endif
@@ -0,0 +1,306 @@
+#include "screenshot.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+# include <libavutil/hwcontext.h>
+#endif
+
+#include "util/log.h"
+
+// YUV to RGB coefficients, in 16.16 fixed point
+struct sc_screenshot_coefs {
+    int32_t y;
+    int32_t rv;
+    int32_t gu;
+    int32_t gv;
+    int32_t bu;
+};
+
+static const struct sc_screenshot_coefs *
+sc_screenshot_get_coefs(bool bt709, bool full_range) {
+    static const struct sc_screenshot_coefs bt601_limited =
+        {76309, 104597, 25675, 53279, 132201};
+    static const struct sc_screenshot_coefs bt601_full =
+        {65536, 91881, 22553, 46802, 116130};
+    static const struct sc_screenshot_coefs bt709_limited =
+        {76309, 117489, 13975, 34925, 138438};
+    static const struct sc_screenshot_coefs bt709_full =
+        {65536, 103206, 12276, 30679, 121609};
+
+    if (bt709) {
+        return full_range ? &bt709_full : &bt709_limited;
+    }
+    return full_range ? &bt601_full : &bt601_limited;
+}
+
+static inline uint8_t
+sc_screenshot_clamp(int32_t v) {
+    // v is in 16.16 fixed point, round to the nearest integer
+    v = (v + (1 << 15)) >> 16;
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+void
+sc_screenshot_yuv_to_rgb24(const struct sc_screenshot_yuv *yuv, uint8_t *rgb,
+                           size_t rgb_stride) {
+    const struct sc_screenshot_coefs *c =
+        sc_screenshot_get_coefs(yuv->bt709, yuv->full_range);
+    int32_t y_offset = yuv->full_range ? 0 : 16;
+
+    for (unsigned row = 0; row < yuv->height; ++row) {
+        const uint8_t *ys = yuv->y + row * yuv->y_stride;
+        const uint8_t *us = yuv->u + (row / 2) * yuv->uv_stride;
+        const uint8_t *vs = yuv->nv12 ? us + 1
+                                      : yuv->v + (row / 2) * yuv->uv_stride;
+        unsigned chroma_step = yuv->nv12 ? 2 : 1;
+        uint8_t *out = rgb + row * rgb_stride;
+
+        for (unsigned col = 0; col < yuv->width; ++col) {
+            unsigned ci = (col / 2) * chroma_step;
+            int32_t y = (ys[col] - y_offset) * c->y;
+            int32_t u = us[ci] - 128;
+            int32_t v = vs[ci] - 128;
+
+            *out++ = sc_screenshot_clamp(y + c->rv * v);
+            *out++ = sc_screenshot_clamp(y - c->gu * u - c->gv * v);
+            *out++ = sc_screenshot_clamp(y + c->bu * u);
+        }
+    }
+}
+
+void
+sc_screenshot_yuv_to_rgb24_scaled(const struct sc_screenshot_yuv *yuv,
+                                  unsigned width, unsigned height,
+                                  uint8_t *rgb, size_t rgb_stride) {
+    assert(width && width <= yuv->width);
+    assert(height && height <= yuv->height);
+
+    const struct sc_screenshot_coefs *c =
+        sc_screenshot_get_coefs(yuv->bt709, yuv->full_range);
+    int32_t y_offset = yuv->full_range ? 0 : 16;
+    unsigned chroma_step = yuv->nv12 ? 2 : 1;
+
+    for (unsigned row = 0; row < height; ++row) {
+        // The source rows covered by this destination row
+        unsigned y0 = row * yuv->height / height;
+        unsigned y1 = (row + 1) * yuv->height / height;
+        uint8_t *out = rgb + row * rgb_stride;
+
+        for (unsigned col = 0; col < width; ++col) {
+            unsigned x0 = col * yuv->width / width;
+            unsigned x1 = (col + 1) * yuv->width / width;
+
+            uint32_t sum_y = 0;
+            for (unsigned sy = y0; sy < y1; ++sy) {
+                const uint8_t *ys = yuv->y + sy * yuv->y_stride;
+                for (unsigned sx = x0; sx < x1; ++sx) {
+                    sum_y += ys[sx];
+                }
+            }
+
+            // The chroma samples covered (at least one)
+            unsigned cy0 = y0 / 2;
+            unsigned cy1 = MAX((y1 + 1) / 2, cy0 + 1);
+            unsigned cx0 = x0 / 2;
+            unsigned cx1 = MAX((x1 + 1) / 2, cx0 + 1);
+            uint32_t sum_u = 0;
+            uint32_t sum_v = 0;
+            for (unsigned sy = cy0; sy < cy1; ++sy) {
+                const uint8_t *us = yuv->u + sy * yuv->uv_stride;
+                const uint8_t *vs = yuv->nv12 ? us + 1
+                                              : yuv->v + sy * yuv->uv_stride;
+                for (unsigned sx = cx0; sx < cx1; ++sx) {
+                    sum_u += us[sx * chroma_step];
+                    sum_v += vs[sx * chroma_step];
+                }
+            }
+
+            uint32_t count = (y1 - y0) * (x1 - x0);
+            uint32_t chroma_count = (cy1 - cy0) * (cx1 - cx0);
+            int32_t y = ((int32_t) ((sum_y + count / 2) / count) - y_offset)
+                      * c->y;
+            int32_t u = (int32_t) ((sum_u + chroma_count / 2) / chroma_count)
+                      - 128;
+            int32_t v = (int32_t) ((sum_v + chroma_count / 2) / chroma_count)
+                      - 128;
+
+            *out++ = sc_screenshot_clamp(y + c->rv * v);
+            *out++ = sc_screenshot_clamp(y - c->gu * u - c->gv * v);
+            *out++ = sc_screenshot_clamp(y + c->bu * u);
+        }
+    }
+}
+
+bool
+sc_screenshot_get_yuv(const AVFrame *frame, struct sc_screenshot_yuv *yuv) {
+    bool nv12;
+    bool full_range;
+    switch (frame->format) {
+        case AV_PIX_FMT_YUV420P:
+            nv12 = false;
+            full_range = frame->color_range == AVCOL_RANGE_JPEG;
+            break;
+        case AV_PIX_FMT_YUVJ420P:
+            nv12 = false;
+            full_range = true;
+            break;
+        case AV_PIX_FMT_NV12:
+            nv12 = true;
+            full_range = frame->color_range == AVCOL_RANGE_JPEG;
+            break;
+        default:
+            return false;
+    }
+
+    // Android encoders tag their streams as BT.601 by default; use BT.709
+    // only if requested by the stream
+    bool bt709 = frame->colorspace == AVCOL_SPC_BT709;
+
+    yuv->width = frame->width;
+    yuv->height = frame->height;
+    yuv->y = frame->data[0];
+    yuv->u = frame->data[1];
+    yuv->v = nv12 ? NULL : frame->data[2];
+    yuv->y_stride = frame->linesize[0];
+    yuv->uv_stride = frame->linesize[1];
+    yuv->nv12 = nv12;
+    yuv->bt709 = bt709;
+    yuv->full_range = full_range;
+    return true;
+}
+
+static bool
+sc_screenshot_to_rgb24(const AVFrame *frame, AVFrame *rgb) {
+    struct sc_screenshot_yuv yuv;
+    if (!sc_screenshot_get_yuv(frame, &yuv)) {
+        LOGE("Screenshot: unsupported frame format: %s",
+             av_get_pix_fmt_name(frame->format));
+        return false;
+    }
+
+    rgb->format = AV_PIX_FMT_RGB24;
+    rgb->width = frame->width;
+    rgb->height = frame->height;
+    if (av_frame_get_buffer(rgb, 0)) {
+        LOG_OOM();
+        return false;
+    }
+
+    sc_screenshot_yuv_to_rgb24(&yuv, rgb->data[0], rgb->linesize[0]);
+    return true;
+}
+
+static bool
+sc_screenshot_encode_png(const AVFrame *rgb, AVPacket *packet) {
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_PNG);
+    if (!codec) {
+        LOGE("Screenshot: PNG encoder not found");
+        return false;
+    }
+
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    ctx->width = rgb->width;
+    ctx->height = rgb->height;
+    ctx->pix_fmt = AV_PIX_FMT_RGB24;
+    ctx->time_base = (AVRational) {1, 1};
+
+    bool ok = false;
+
+    if (avcodec_open2(ctx, codec, NULL) < 0) {
+        LOGE("Screenshot: could not open PNG encoder");
+        goto end;
+    }
+
+    if (avcodec_send_frame(ctx, rgb) < 0) {
+        LOGE("Screenshot: could not encode frame");
+        goto end;
+    }
+
+    if (avcodec_receive_packet(ctx, packet) < 0) {
+        LOGE("Screenshot: could not receive encoded frame");
+        goto end;
+    }
+
+    ok = true;
+
+end:
+    avcodec_free_context(&ctx);
+    return ok;
+}
+
+bool
+sc_screenshot_save(const AVFrame *frame, const char *filename) {
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    if (frame->hw_frames_ctx) {
+        AVFrame *sw_frame = av_frame_alloc();
+        if (!sw_frame) {
+            LOG_OOM();
+            return false;
+        }
+
+        if (av_hwframe_transfer_data(sw_frame, frame, 0) < 0
+                || av_frame_copy_props(sw_frame, frame) < 0) {
+            LOGE("Screenshot: could not download the hardware frame");
+            av_frame_free(&sw_frame);
+            return false;
+        }
+
+        bool ok = sc_screenshot_save(sw_frame, filename);
+        av_frame_free(&sw_frame);
+        return ok;
+    }
+#endif
+
+    AVFrame *rgb = av_frame_alloc();
+    if (!rgb) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = sc_screenshot_to_rgb24(frame, rgb)
+           && sc_screenshot_write_png(rgb, filename);
+
+    av_frame_free(&rgb);
+    return ok;
+}
+
+bool
+sc_screenshot_write_png(const AVFrame *rgb, const char *filename) {
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = false;
+
+    if (!sc_screenshot_encode_png(rgb, packet)) {
+        goto end;
+    }
+
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        LOGE("Screenshot: could not open %s", filename);
+        goto end;
+    }
+
+    size_t w = fwrite(packet->data, 1, packet->size, file);
+    if (fclose(file) || w != (size_t) packet->size) {
+        LOGE("Screenshot: could not write %s", filename);
+        goto end;
+    }
+
+    ok = true;
+
+end:
+    av_packet_free(&packet);
+    return ok;
+}
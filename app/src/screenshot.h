@@ -0,0 +1,72 @@
+#ifndef SC_SCREENSHOT_H
+#define SC_SCREENSHOT_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavutil/frame.h>
+
+/**
+ * 8-bit YUV 4:2:0 image, either planar (YUV420P) or semi-planar (NV12)
+ */
+struct sc_screenshot_yuv {
+    unsigned width;
+    unsigned height;
+    const uint8_t *y;
+    const uint8_t *u; // the interleaved UV plane if nv12
+    const uint8_t *v; // unused if nv12
+    size_t y_stride;
+    size_t uv_stride;
+    bool nv12;
+    bool bt709; // BT.601 otherwise
+    bool full_range; // limited range otherwise
+};
+
+/**
+ * Convert a YUV 4:2:0 image to packed RGB24
+ *
+ * The destination must contain at least `height` rows of `rgb_stride` bytes
+ * (`rgb_stride >= 3 * width`).
+ */
+void
+sc_screenshot_yuv_to_rgb24(const struct sc_screenshot_yuv *yuv, uint8_t *rgb,
+                           size_t rgb_stride);
+
+/**
+ * Convert a YUV 4:2:0 image to packed RGB24, downscaled to `width`x`height`
+ *
+ * Each destination pixel is the average of the source pixels it covers, so
+ * the destination size must not exceed the source size.
+ */
+void
+sc_screenshot_yuv_to_rgb24_scaled(const struct sc_screenshot_yuv *yuv,
+                                  unsigned width, unsigned height,
+                                  uint8_t *rgb, size_t rgb_stride);
+
+/**
+ * Describe the planes of a software frame
+ *
+ * Return false if the format is not 8-bit YUV 4:2:0 (YUV420P or NV12).
+ */
+bool
+sc_screenshot_get_yuv(const AVFrame *frame, struct sc_screenshot_yuv *yuv);
+
+/**
+ * Encode a RGB24 frame to a PNG file
+ */
+bool
+sc_screenshot_write_png(const AVFrame *rgb, const char *filename);
+
+/**
+ * Save a decoded video frame to a PNG file
+ *
+ * The frame is saved at its full resolution, without any additional
+ * compression loss. Only 8-bit YUV 4:2:0 frames (YUV420P and NV12, possibly
+ * in hardware surfaces) are supported.
+ */
+bool
+sc_screenshot_save(const AVFrame *frame, const char *filename);
+
+#endif
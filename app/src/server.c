@@ -4,21 +4,32 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 #include <SDL2/SDL_timer.h>
 #include <SDL2/SDL_platform.h>
 
 #include "adb/adb.h"
+#include "list_cache.h"
+#include "startup_timeline.h"
 #include "util/binary.h"
 #include "util/file.h"
 #include "util/log.h"
 #include "util/net_intr.h"
 #include "util/process_intr.h"
+#include "util/rand.h"
 #include "util/str.h"
+#include "util/strbuf.h"
 
 #define SC_SERVER_FILENAME "scrcpy-server"
 
 #define SC_SERVER_PATH_DEFAULT PREFIX "/share/scrcpy/" SC_SERVER_FILENAME
 #define SC_DEVICE_SERVER_PATH "/data/local/tmp/scrcpy-server.jar"
+// Hash of the server content, written after a successful push
+#define SC_DEVICE_SERVER_HASH_PATH SC_DEVICE_SERVER_PATH ".hash"
+// ART loads the ahead-of-time compiled code of a jar from "oat/<isa>/" in the
+// same directory
+#define SC_DEVICE_SERVER_OAT_DIR "/data/local/tmp/oat"
+#define SC_DEVICE_SERVER_DAEMON_LOG_PATH "/data/local/tmp/scrcpy-server.log"
 
 #define SC_ADB_PORT_DEFAULT 5555
 #define SC_SOCKET_NAME_PREFIX "scrcpy_"
@@ -71,6 +82,8 @@ sc_server_params_destroy(struct sc_server_params *params) {
     // The server stores a copy of the params provided by the user
     free((char *) params->req_serial);
     free((char *) params->crop);
+    free((char *) params->video_masks);
+    free((char *) params->new_display);
     free((char *) params->video_codec_options);
     free((char *) params->audio_codec_options);
     free((char *) params->video_encoder);
@@ -100,6 +113,8 @@ sc_server_params_copy(struct sc_server_params *dst,
 
     COPY(req_serial);
     COPY(crop);
+    COPY(video_masks);
+    COPY(new_display);
     COPY(video_codec_options);
     COPY(audio_codec_options);
     COPY(video_encoder);
@@ -116,6 +131,66 @@ error:
     return false;
 }
 
+static bool
+is_server_up_to_date(struct sc_intr *intr, const char *serial,
+                     const char *hash, uint64_t size) {
+    // Read the hash written on the last push and the actual size of the
+    // server in a single adb command: the server may have been replaced since
+    // (e.g. by another version of scrcpy)
+    char *output = sc_adb_shell(intr, serial,
+                                "cat " SC_DEVICE_SERVER_HASH_PATH
+                                " 2>/dev/null; stat -c %s "
+                                SC_DEVICE_SERVER_PATH " 2>/dev/null",
+                                SC_ADB_SILENT);
+    if (!output) {
+        return false;
+    }
+
+    // The line separators may be "\r\n" on old devices
+    char device_hash[32];
+    uint64_t device_size;
+    int r = sscanf(output, "%31s %" SCNu64, device_hash, &device_size);
+    free(output);
+
+    return r == 2 && !strcmp(device_hash, hash) && device_size == size;
+}
+
+static void
+precompile_server(struct sc_intr *intr, const char *serial) {
+    // Compile the whole server ahead of time, so that its classes are neither
+    // verified nor interpreted (then JIT-compiled) on each start. It is only
+    // done once per pushed version. A stale or rejected (e.g. after a system
+    // update) result is ignored by ART, which then just runs the jar.
+    const char *cmd =
+        "case $(getprop ro.product.cpu.abi) in"
+        " arm64*) i=arm64;; armeabi*) i=arm;; x86_64) i=x86_64;; x86) i=x86;;"
+        " *) exit;; esac;"
+        " for d in /apex/com.android.art/bin/dex2oat64"
+        " /apex/com.android.art/bin/dex2oat32"
+        " /apex/com.android.runtime/bin/dex2oat /system/bin/dex2oat; do"
+        " [ -x $d ] && break; done;"
+        " o=" SC_DEVICE_SERVER_OAT_DIR "/$i;"
+        " rm -f $o/scrcpy-server.*; mkdir -p $o"
+        " && $d --dex-file=" SC_DEVICE_SERVER_PATH
+        " --dex-location=" SC_DEVICE_SERVER_PATH
+        " --oat-file=$o/scrcpy-server.odex --instruction-set=$i"
+        " --compiler-filter=speed --class-loader-context=PCL[]"
+        " >/dev/null 2>&1 && echo ok";
+
+    sc_tick start = sc_tick_now();
+    char *output = sc_adb_shell(intr, serial, cmd, SC_ADB_SILENT);
+    bool ok = output && !strncmp(output, "ok", 2);
+    free(output);
+
+    if (ok) {
+        LOGD("Server precompiled in %" PRItick "ms",
+             SC_TICK_TO_MS(sc_tick_now() - start));
+    } else {
+        // Not an error, the server is just not precompiled
+        LOGD("Could not precompile the server on the device");
+    }
+}
+
 static bool
 push_server(struct sc_intr *intr, const char *serial) {
     char *server_path = get_server_path();
@@ -127,9 +202,46 @@ push_server(struct sc_intr *intr, const char *serial) {
         free(server_path);
         return false;
     }
+
+    // Skip the push if the same server is already on the device
+    uint64_t hash;
+    uint64_t size;
+    bool hashed = sc_file_hash(server_path, &hash, &size);
+    char hash_str[17];
+    if (hashed) {
+        snprintf(hash_str, sizeof(hash_str), "%016" PRIx64, hash);
+        if (is_server_up_to_date(intr, serial, hash_str, size)) {
+            LOGD("Server already up-to-date on the device, not pushed");
+            free(server_path);
+            return true;
+        }
+    }
+
     bool ok = sc_adb_push(intr, serial, server_path, SC_DEVICE_SERVER_PATH, 0);
     free(server_path);
-    return ok;
+    if (!ok) {
+        return false;
+    }
+
+    if (hashed) {
+        char *cmd;
+        int r = asprintf(&cmd, "echo %s > " SC_DEVICE_SERVER_HASH_PATH,
+                         hash_str);
+        if (r == -1) {
+            LOG_OOM();
+            // The server is pushed anyway
+            return true;
+        }
+
+        // Ignore errors, the server will just be pushed again next time
+        char *output = sc_adb_shell(intr, serial, cmd, SC_ADB_SILENT);
+        free(output);
+        free(cmd);
+    }
+
+    precompile_server(intr, serial);
+
+    return true;
 }
 
 static const char *
@@ -182,6 +294,8 @@ sc_server_get_codec_name(enum sc_codec codec) {
             return "flac";
         case SC_CODEC_RAW:
             return "raw";
+        case SC_CODEC_AUTO:
+            return "auto";
         default:
             return NULL;
     }
@@ -201,21 +315,37 @@ sc_server_get_camera_facing_name(enum sc_camera_facing camera_facing) {
     }
 }
 
-static sc_pid
-execute_server(struct sc_server *server,
-               const struct sc_server_params *params) {
-    sc_pid pid = SC_PROCESS_NONE;
+struct sc_server_cmd {
+    const char *argv[128];
+    unsigned count; // including the final NULL
+    unsigned dyn_idx; // from there, the strings are allocated
+};
 
-    const char *serial = server->serial;
+static void
+sc_server_cmd_destroy(struct sc_server_cmd *server_cmd) {
+    for (unsigned i = server_cmd->dyn_idx; i < server_cmd->count; ++i) {
+        free((char *) server_cmd->argv[i]);
+    }
+}
+
+static bool
+sc_server_cmd_build(struct sc_server_cmd *server_cmd, const char *serial,
+                    const struct sc_server_params *params,
+                    bool tunnel_forward) {
     assert(serial);
 
-    const char *cmd[128];
+    const char **cmd = server_cmd->argv;
     unsigned count = 0;
     cmd[count++] = sc_adb_get_executable();
     cmd[count++] = "-s";
     cmd[count++] = serial;
     cmd[count++] = "shell";
     cmd[count++] = "CLASSPATH=" SC_DEVICE_SERVER_PATH;
+    if (params->daemon_idle_timeout) {
+        // The server must survive the termination of the "adb shell" process
+        // (and must not write to its closed output)
+        cmd[count++] = "nohup";
+    }
     cmd[count++] = "app_process";
 
 #ifdef SERVER_DEBUGGER
@@ -235,15 +365,16 @@ execute_server(struct sc_server *server,
     cmd[count++] = "com.genymobile.scrcpy.Server";
     cmd[count++] = SCRCPY_VERSION;
 
-    unsigned dyn_idx = count; // from there, the strings are allocated
+    server_cmd->dyn_idx = count;
 #define ADD_PARAM(fmt, ...) do { \
         char *p; \
         if (asprintf(&p, fmt, ## __VA_ARGS__) == -1) { \
-            goto end; \
+            goto error; \
         } \
         cmd[count++] = p; \
     } while(0)
 
+    // The scid must be the first dynamic parameter (see get_daemon_scid())
     ADD_PARAM("scid=%08x", params->scid);
     ADD_PARAM("log_level=%s", log_level_to_server_string(params->log_level));
 
@@ -256,9 +387,25 @@ execute_server(struct sc_server *server,
     if (!params->audio) {
         ADD_PARAM("audio=false");
     }
+    if (params->record_video_bit_rate) {
+        ADD_PARAM("record_video_bit_rate=%" PRIu32,
+                  params->record_video_bit_rate);
+        if (params->record_video_source == SC_VIDEO_SOURCE_CAMERA) {
+            ADD_PARAM("record_video_source=camera");
+        }
+    }
     if (params->audio_bit_rate) {
         ADD_PARAM("audio_bit_rate=%" PRIu32, params->audio_bit_rate);
     }
+    if (params->audio_sample_rate != SC_AUDIO_SAMPLE_RATE_DEFAULT) {
+        ADD_PARAM("audio_sample_rate=%" PRIu32, params->audio_sample_rate);
+    }
+    if (params->audio_channels != SC_AUDIO_CHANNELS_DEFAULT) {
+        ADD_PARAM("audio_channels=%u", (unsigned) params->audio_channels);
+    }
+    if (params->audio_read_size) {
+        ADD_PARAM("audio_read_size=%" PRIu16, params->audio_read_size);
+    }
     if (params->video_codec != SC_CODEC_H264) {
         ADD_PARAM("video_codec=%s",
                   sc_server_get_codec_name(params->video_codec));
@@ -267,9 +414,10 @@ execute_server(struct sc_server *server,
         ADD_PARAM("audio_codec=%s",
             sc_server_get_codec_name(params->audio_codec));
     }
-    if (params->video_source != SC_VIDEO_SOURCE_DISPLAY) {
-        assert(params->video_source == SC_VIDEO_SOURCE_CAMERA);
+    if (params->video_source == SC_VIDEO_SOURCE_CAMERA) {
         ADD_PARAM("video_source=camera");
+    } else if (params->video_source == SC_VIDEO_SOURCE_PATTERN) {
+        ADD_PARAM("video_source=pattern");
     }
     if (params->audio_source == SC_AUDIO_SOURCE_MIC) {
         ADD_PARAM("audio_source=mic");
@@ -280,20 +428,62 @@ execute_server(struct sc_server *server,
     if (params->max_fps) {
         ADD_PARAM("max_fps=%" PRIu16, params->max_fps);
     }
+    if (params->video_latency_profile == SC_VIDEO_LATENCY_PROFILE_LOW) {
+        ADD_PARAM("video_latency_profile=low");
+    }
+    if (params->video_intra_refresh) {
+        ADD_PARAM("video_intra_refresh=true");
+    }
+    if (params->video_hdr) {
+        ADD_PARAM("video_hdr=true");
+    }
+    if (params->square_video) {
+        ADD_PARAM("square_video=true");
+    }
+    if (params->gpu_downscale) {
+        ADD_PARAM("gpu_downscale=true");
+    }
+    if (params->video_masks) {
+        ADD_PARAM("video_masks=%s", params->video_masks);
+    }
+    if (params->adaptive_fps) {
+        ADD_PARAM("adaptive_fps=true");
+    }
+    if (params->thermal_governor) {
+        ADD_PARAM("thermal_governor=true");
+    }
+    if (params->video_repeat_delay != -1) {
+        ADD_PARAM("video_repeat_delay=%" PRIu32,
+                  (uint32_t) SC_TICK_TO_MS(params->video_repeat_delay));
+    }
     if (params->lock_video_orientation != SC_LOCK_VIDEO_ORIENTATION_UNLOCKED) {
         ADD_PARAM("lock_video_orientation=%" PRIi8,
                   params->lock_video_orientation);
     }
-    if (server->tunnel.forward) {
+    if (params->direct_port) {
+        ADD_PARAM("direct_port=%" PRIu16, params->direct_port);
+        ADD_PARAM("direct_token=%016" PRIx64 "%016" PRIx64,
+                  params->direct_token[0], params->direct_token[1]);
+        if (params->direct_udp) {
+            ADD_PARAM("direct_udp=true");
+        }
+    }
+    if (tunnel_forward) {
         ADD_PARAM("tunnel_forward=true");
     }
     if (params->crop) {
         ADD_PARAM("crop=%s", params->crop);
     }
+    if (params->new_display) {
+        ADD_PARAM("new_display=%s", params->new_display);
+    }
     if (!params->control) {
         // By default, control is true
         ADD_PARAM("control=false");
     }
+    if (params->control_compression) {
+        ADD_PARAM("control_compression=true");
+    }
     if (params->display_id) {
         ADD_PARAM("display_id=%" PRIu32, params->display_id);
     }
@@ -316,6 +506,18 @@ execute_server(struct sc_server *server,
     if (params->camera_high_speed) {
         ADD_PARAM("camera_high_speed=true");
     }
+    if (params->camera_low_latency) {
+        ADD_PARAM("camera_low_latency=true");
+    }
+    if (params->camera_lock_ae_af) {
+        ADD_PARAM("camera_lock_ae_af=true");
+    }
+    if (params->pattern_size) {
+        ADD_PARAM("pattern_size=%s", params->pattern_size);
+    }
+    if (params->pattern_fps) {
+        ADD_PARAM("pattern_fps=%" PRIu16, params->pattern_fps);
+    }
     if (params->show_touches) {
         ADD_PARAM("show_touches=true");
     }
@@ -353,6 +555,24 @@ execute_server(struct sc_server *server,
         // By default, power_on is true
         ADD_PARAM("power_on=false");
     }
+    if (params->multiplex) {
+        ADD_PARAM("multiplex=true");
+    }
+    if (params->video_reconnect) {
+        ADD_PARAM("video_reconnect=true");
+    }
+    if (params->video_pacing) {
+        ADD_PARAM("video_pacing=true");
+    }
+    if (params->socket_buffer_size) {
+        ADD_PARAM("socket_buffer_size=%" PRIu32, params->socket_buffer_size);
+    }
+    if (params->latency_stats) {
+        ADD_PARAM("latency_stats=true");
+    }
+    if (params->encoder_stats) {
+        ADD_PARAM("encoder_stats=true");
+    }
     if (params->list & SC_OPTION_LIST_ENCODERS) {
         ADD_PARAM("list_encoders=true");
     }
@@ -365,10 +585,40 @@ execute_server(struct sc_server *server,
     if (params->list & SC_OPTION_LIST_CAMERA_SIZES) {
         ADD_PARAM("list_camera_sizes=true");
     }
+    if (params->daemon_idle_timeout) {
+        ADD_PARAM("daemon_idle_timeout=%" PRIu32,
+                  (uint32_t) SC_TICK_TO_MS(params->daemon_idle_timeout));
+        // Keep the server logs in a file, the first client does not stay
+        // connected to the server output
+        cmd[count++] = ">";
+        cmd[count++] = SC_DEVICE_SERVER_DAEMON_LOG_PATH;
+        cmd[count++] = "2>&1";
+    }
 
 #undef ADD_PARAM
 
     cmd[count++] = NULL;
+    server_cmd->count = count;
+
+    return true;
+
+error:
+    server_cmd->count = count;
+    sc_server_cmd_destroy(server_cmd);
+    return false;
+}
+
+// If pout is not NULL, the server stdout is redirected to it
+static sc_pid
+execute_server(struct sc_server *server,
+               const struct sc_server_params *params, sc_pipe *pout) {
+    struct sc_server_cmd cmd;
+    bool ok = sc_server_cmd_build(&cmd, server->serial, params,
+                                  server->tunnel.forward);
+    if (!ok) {
+        LOG_OOM();
+        return SC_PROCESS_NONE;
+    }
 
 #ifdef SERVER_DEBUGGER
     LOGI("Server debugger waiting for a client on device port "
@@ -382,24 +632,210 @@ execute_server(struct sc_server *server,
     // Then click on "Debug"
 #endif
     // Inherit both stdout and stderr (all server logs are printed to stdout)
-    pid = sc_adb_execute(cmd, 0);
+    sc_pid pid = sc_adb_execute_p(cmd.argv, 0, pout);
+
+    sc_server_cmd_destroy(&cmd);
+
+    return pid;
+}
+
+// In daemon mode, the scid (and thus the device socket name) is derived from
+// the server parameters, so that a client may only reuse a server running with
+// the same parameters
+static bool
+get_daemon_scid(struct sc_server *server, uint32_t *scid) {
+    struct sc_server_cmd cmd;
+    // The daemon mode requires a forward tunnel
+    bool ok = sc_server_cmd_build(&cmd, server->serial, &server->params, true);
+    if (!ok) {
+        LOG_OOM();
+        return false;
+    }
+
+    // FNV-1a of all the arguments except the scid itself
+    uint32_t hash = UINT32_C(0x811c9dc5);
+    for (unsigned i = 0; i < cmd.count - 1; ++i) {
+        if (i == cmd.dyn_idx) {
+            continue;
+        }
+        const char *arg = cmd.argv[i];
+        do {
+            hash ^= (uint8_t) *arg;
+            hash *= UINT32_C(0x01000193);
+        } while (*arg++);
+    }
+
+    sc_server_cmd_destroy(&cmd);
+
+    // The scid is a 31-bit value
+    *scid = hash & 0x7FFFFFFF;
+    return true;
+}
+
+static uint64_t
+hash_str(uint64_t hash, const char *s) {
+    // FNV-1a, including the terminating NUL (so that the concatenation of
+    // several strings is not ambiguous)
+    do {
+        hash ^= (uint8_t) *s;
+        hash *= UINT64_C(0x100000001b3);
+    } while (*s++);
+    return hash;
+}
+
+// The --list-* results are cached by device build (rather than by device), so
+// the key is derived from the build fingerprint and all the server arguments
+// except the serial and the scid
+static bool
+get_list_cache_key(struct sc_server *server, uint64_t *key) {
+    char *fingerprint = sc_adb_getprop(&server->intr, server->serial,
+                                       "ro.build.fingerprint", SC_ADB_SILENT);
+    if (!fingerprint || !*fingerprint) {
+        LOGW("Could not read the device build fingerprint, list cache "
+             "disabled");
+        free(fingerprint);
+        return false;
+    }
+
+    struct sc_server_cmd cmd;
+    bool ok = sc_server_cmd_build(&cmd, server->serial, &server->params,
+                                  server->tunnel.forward);
+    if (!ok) {
+        LOG_OOM();
+        free(fingerprint);
+        return false;
+    }
+
+    uint64_t hash = hash_str(UINT64_C(0xcbf29ce484222325), fingerprint);
+    free(fingerprint);
+
+    for (unsigned i = 0; i < cmd.count - 1; ++i) {
+        const char *arg = cmd.argv[i];
+        if (arg == server->serial || i == cmd.dyn_idx) {
+            continue;
+        }
+        hash = hash_str(hash, arg);
+    }
+
+    sc_server_cmd_destroy(&cmd);
+
+    *key = hash;
+    return true;
+}
+
+// Execute the server, and copy its output (printed as it is received) to the
+// cache if it succeeds
+static bool
+execute_server_list_cached(struct sc_server *server, const char *cache_path) {
+    sc_pipe pout;
+    sc_pid pid = execute_server(server, &server->params, &pout);
+    if (pid == SC_PROCESS_NONE) {
+        return false;
+    }
+
+    struct sc_strbuf buf;
+    bool ok = sc_strbuf_init(&buf, 4096);
+    if (!ok) {
+        LOG_OOM();
+    }
+
+    char chunk[4096];
+    ssize_t r;
+    while ((r = sc_pipe_read_intr(&server->intr, pid, pout, chunk,
+                                  sizeof(chunk))) > 0) {
+        fwrite(chunk, 1, r, stdout);
+        if (ok && !sc_strbuf_append(&buf, chunk, r)) {
+            LOG_OOM();
+            ok = false;
+        }
+    }
+    fflush(stdout);
+    sc_pipe_close(pout);
+
+    sc_exit_code exit_code = sc_process_wait(pid, true);
+
+    // Only cache a complete result
+    if (ok && r == 0 && exit_code == 0) {
+        sc_list_cache_save(cache_path, buf.s, buf.len);
+    }
+
+    if (ok) {
+        free(buf.s);
+    }
+
+    return true;
+}
+
+static bool
+run_server_list(struct sc_server *server) {
+    const struct sc_server_params *params = &server->params;
+
+    char *cache_path = NULL;
+    if (params->list_cache) {
+        uint64_t key;
+        if (get_list_cache_key(server, &key)) {
+            cache_path = sc_list_cache_get_path(params->list_cache, key);
+            if (cache_path && sc_list_cache_print(cache_path)) {
+                // The server is not even pushed
+                free(cache_path);
+                return true;
+            }
+        }
+    }
+
+    bool ok = push_server(&server->intr, server->serial);
+    if (!ok) {
+        goto end;
+    }
+
+    if (cache_path) {
+        ok = execute_server_list_cached(server, cache_path);
+    } else {
+        sc_pid pid = execute_server(server, params, NULL);
+        if (pid == SC_PROCESS_NONE) {
+            ok = false;
+            goto end;
+        }
+        sc_process_wait(pid, NULL); // ignore exit code
+        sc_process_close(pid);
+    }
 
 end:
-    for (unsigned i = dyn_idx; i < count; ++i) {
-        free((char *) cmd[i]);
+    free(cache_path);
+    return ok;
+}
+
+#define SC_DIRECT_TOKEN_LENGTH 16
+
+// In direct mode, the device only accepts the connections which start with
+// the token
+static bool
+send_direct_token(struct sc_server *server, sc_socket socket) {
+    if (!server->params.direct_port) {
+        return true;
     }
 
-    return pid;
+    uint8_t token[SC_DIRECT_TOKEN_LENGTH];
+    sc_write64be(token, server->params.direct_token[0]);
+    sc_write64be(&token[8], server->params.direct_token[1]);
+
+    ssize_t w = net_send_all_intr(&server->intr, socket, token, sizeof(token));
+    return w == sizeof(token);
 }
 
 static bool
-connect_and_read_byte(struct sc_intr *intr, sc_socket socket,
+connect_and_read_byte(struct sc_server *server, sc_socket socket,
                       uint32_t tunnel_host, uint16_t tunnel_port) {
+    struct sc_intr *intr = &server->intr;
     bool ok = net_connect_intr(intr, socket, tunnel_host, tunnel_port);
     if (!ok) {
         return false;
     }
 
+    if (!send_direct_token(server, socket)) {
+        return false;
+    }
+
     char byte;
     // the connection may succeed even if the server behind the "adb tunnel"
     // is not listening, so read one byte to detect a working connection
@@ -411,14 +847,22 @@ connect_and_read_byte(struct sc_intr *intr, sc_socket socket,
     return true;
 }
 
+// Retry with an increasing delay: the server is often ready within a few tens
+// of milliseconds, so polling at a fixed large interval would uselessly delay
+// the connection
 static sc_socket
-connect_to_server(struct sc_server *server, unsigned attempts, sc_tick delay,
-                  uint32_t host, uint16_t port) {
-    do {
-        LOGD("Remaining connection attempts: %u", attempts);
+connect_to_server(struct sc_server *server, sc_tick timeout, uint32_t host,
+                  uint16_t port) {
+    sc_tick delay = SC_TICK_FROM_MS(5);
+    sc_tick max_delay = SC_TICK_FROM_MS(100);
+    sc_tick deadline = sc_tick_now() + timeout;
+    unsigned attempt = 0;
+
+    for (;;) {
+        LOGD("Connection attempt %u", ++attempt);
         sc_socket socket = net_socket();
         if (socket != SC_SOCKET_NONE) {
-            bool ok = connect_and_read_byte(&server->intr, socket, host, port);
+            bool ok = connect_and_read_byte(server, socket, host, port);
             if (ok) {
                 // it worked!
                 return socket;
@@ -432,15 +876,28 @@ connect_to_server(struct sc_server *server, unsigned attempts, sc_tick delay,
             break;
         }
 
-        if (attempts) {
-            sc_tick deadline = sc_tick_now() + delay;
-            bool ok = sc_server_sleep(server, deadline);
-            if (!ok) {
-                LOGI("Connection attempt stopped");
-                break;
-            }
+        sc_tick now = sc_tick_now();
+        if (now >= deadline) {
+            LOGE("Could not connect to the server (timeout)");
+            break;
         }
-    } while (--attempts);
+
+        sc_tick next = now + delay;
+        if (next > deadline) {
+            next = deadline;
+        }
+        bool ok = sc_server_sleep(server, next);
+        if (!ok) {
+            LOGI("Connection attempt stopped");
+            break;
+        }
+
+        delay *= 2;
+        if (delay > max_delay) {
+            delay = max_delay;
+        }
+    }
+
     return SC_SOCKET_NONE;
 }
 
@@ -474,6 +931,15 @@ sc_server_init(struct sc_server *server, const struct sc_server_params *params,
         return false;
     }
 
+    ok = sc_intr_init(&server->push_intr);
+    if (!ok) {
+        sc_intr_destroy(&server->intr);
+        sc_cond_destroy(&server->cond_stopped);
+        sc_mutex_destroy(&server->mutex);
+        sc_server_params_destroy(&server->params);
+        return false;
+    }
+
     server->serial = NULL;
     server->device_socket_name = NULL;
     server->stopped = false;
@@ -481,6 +947,9 @@ sc_server_init(struct sc_server *server, const struct sc_server_params *params,
     server->video_socket = SC_SOCKET_NONE;
     server->audio_socket = SC_SOCKET_NONE;
     server->control_socket = SC_SOCKET_NONE;
+    server->record_video_socket = SC_SOCKET_NONE;
+    server->multiplexed = false;
+    server->udp_video_started = false;
 
     sc_adb_tunnel_init(&server->tunnel);
 
@@ -511,11 +980,78 @@ device_read_info(struct sc_intr *intr, sc_socket device_socket,
     return true;
 }
 
+static void
+sc_server_get_tunnel_address(struct sc_server *server, uint32_t *host,
+                             uint16_t *port) {
+    if (server->params.direct_port) {
+        // No adb tunnel, connect to the device directly
+        *host = server->direct_host;
+        *port = server->params.direct_port;
+        return;
+    }
+
+    *host = server->params.tunnel_host;
+    if (!*host) {
+        *host = IPV4_LOCALHOST;
+    }
+
+    *port = server->params.tunnel_port;
+    if (!*port) {
+        *port = server->tunnel.local_port;
+    }
+}
+
+// Try to connect to a server kept running on the device (daemon mode)
+static sc_socket
+connect_to_daemon(struct sc_server *server) {
+    uint32_t host;
+    uint16_t port;
+    sc_server_get_tunnel_address(server, &host, &port);
+
+    sc_socket socket = net_socket();
+    if (socket == SC_SOCKET_NONE) {
+        return SC_SOCKET_NONE;
+    }
+
+    if (!connect_and_read_byte(server, socket, host, port)) {
+        net_close(socket);
+        return SC_SOCKET_NONE;
+    }
+
+    return socket;
+}
+
+// Connect a socket other than the first one (in forward tunnel or direct mode)
+static sc_socket
+connect_stream(struct sc_server *server, uint32_t host, uint16_t port) {
+    sc_socket socket = net_socket();
+    if (socket == SC_SOCKET_NONE) {
+        return SC_SOCKET_NONE;
+    }
+
+    bool ok = net_connect_intr(&server->intr, socket, host, port)
+           && send_direct_token(server, socket);
+    if (!ok) {
+        net_close(socket);
+        return SC_SOCKET_NONE;
+    }
+
+    return socket;
+}
+
+// If daemon_socket is set, it is the first socket, already connected to a
+// running server (in forward tunnel mode)
 static bool
-sc_server_connect_to(struct sc_server *server, struct sc_server_info *info) {
+sc_server_connect_to(struct sc_server *server, struct sc_server_info *info,
+                     sc_socket daemon_socket) {
     struct sc_adb_tunnel *tunnel = &server->tunnel;
 
-    assert(tunnel->enabled);
+    // In direct mode, the client connects to the device without adb tunnel
+    bool direct = server->params.direct_port;
+    assert(tunnel->enabled != direct);
+    assert(daemon_socket == SC_SOCKET_NONE || tunnel->forward);
+    // The device side only supports the multiplexing over a local socket
+    assert(!direct || !server->params.multiplex);
 
     const char *serial = server->serial;
     assert(serial);
@@ -523,11 +1059,40 @@ sc_server_connect_to(struct sc_server *server, struct sc_server_info *info) {
     bool video = server->params.video;
     bool audio = server->params.audio;
     bool control = server->params.control;
+    // The record video stream is always the last one (so it is never the
+    // first socket)
+    bool record_video = server->params.record_video_bit_rate;
+    assert(!record_video || video);
 
     sc_socket video_socket = SC_SOCKET_NONE;
     sc_socket audio_socket = SC_SOCKET_NONE;
     sc_socket control_socket = SC_SOCKET_NONE;
-    if (!tunnel->forward) {
+    sc_socket record_video_socket = SC_SOCKET_NONE;
+    // Only if the video packets are received over UDP
+    sc_socket udp_socket = SC_SOCKET_NONE;
+    bool udp_video_started = false;
+    // Only if multiplexed
+    sc_socket mux_socket = SC_SOCKET_NONE;
+    bool mux_started = false;
+    if (server->params.multiplex) {
+        // All the streams are transmitted over a single connection
+        if (!tunnel->forward) {
+            mux_socket = net_accept_intr(&server->intr, tunnel->server_socket);
+        } else if (daemon_socket != SC_SOCKET_NONE) {
+            mux_socket = daemon_socket;
+        } else {
+            uint32_t tunnel_host;
+            uint16_t tunnel_port;
+            sc_server_get_tunnel_address(server, &tunnel_host, &tunnel_port);
+
+            sc_tick timeout = SC_TICK_FROM_SEC(10);
+            mux_socket = connect_to_server(server, timeout, tunnel_host,
+                                           tunnel_port);
+        }
+        if (mux_socket == SC_SOCKET_NONE) {
+            goto fail;
+        }
+    } else if (!direct && !tunnel->forward) {
         if (video) {
             video_socket =
                 net_accept_intr(&server->intr, tunnel->server_socket);
@@ -551,23 +1116,27 @@ sc_server_connect_to(struct sc_server *server, struct sc_server_info *info) {
                 goto fail;
             }
         }
-    } else {
-        uint32_t tunnel_host = server->params.tunnel_host;
-        if (!tunnel_host) {
-            tunnel_host = IPV4_LOCALHOST;
-        }
 
-        uint16_t tunnel_port = server->params.tunnel_port;
-        if (!tunnel_port) {
-            tunnel_port = tunnel->local_port;
+        if (record_video) {
+            record_video_socket =
+                net_accept_intr(&server->intr, tunnel->server_socket);
+            if (record_video_socket == SC_SOCKET_NONE) {
+                goto fail;
+            }
         }
+    } else {
+        uint32_t tunnel_host;
+        uint16_t tunnel_port;
+        sc_server_get_tunnel_address(server, &tunnel_host, &tunnel_port);
 
-        unsigned attempts = 100;
-        sc_tick delay = SC_TICK_FROM_MS(100);
-        sc_socket first_socket = connect_to_server(server, attempts, delay,
-                                                   tunnel_host, tunnel_port);
+        sc_socket first_socket = daemon_socket;
         if (first_socket == SC_SOCKET_NONE) {
-            goto fail;
+            sc_tick timeout = SC_TICK_FROM_SEC(10);
+            first_socket = connect_to_server(server, timeout, tunnel_host,
+                                             tunnel_port);
+            if (first_socket == SC_SOCKET_NONE) {
+                goto fail;
+            }
         }
 
         if (video) {
@@ -578,15 +1147,11 @@ sc_server_connect_to(struct sc_server *server, struct sc_server_info *info) {
             if (!video) {
                 audio_socket = first_socket;
             } else {
-                audio_socket = net_socket();
+                audio_socket = connect_stream(server, tunnel_host,
+                                              tunnel_port);
                 if (audio_socket == SC_SOCKET_NONE) {
                     goto fail;
                 }
-                bool ok = net_connect_intr(&server->intr, audio_socket,
-                                           tunnel_host, tunnel_port);
-                if (!ok) {
-                    goto fail;
-                }
             }
         }
 
@@ -594,23 +1159,100 @@ sc_server_connect_to(struct sc_server *server, struct sc_server_info *info) {
             if (!video && !audio) {
                 control_socket = first_socket;
             } else {
-                control_socket = net_socket();
+                control_socket = connect_stream(server, tunnel_host,
+                                                tunnel_port);
                 if (control_socket == SC_SOCKET_NONE) {
                     goto fail;
                 }
-                bool ok = net_connect_intr(&server->intr, control_socket,
-                                           tunnel_host, tunnel_port);
-                if (!ok) {
-                    goto fail;
-                }
+            }
+        }
+
+        if (record_video) {
+            record_video_socket = connect_stream(server, tunnel_host,
+                                                 tunnel_port);
+            if (record_video_socket == SC_SOCKET_NONE) {
+                goto fail;
             }
         }
     }
 
-    // we don't need the adb tunnel anymore
-    sc_adb_tunnel_close(tunnel, &server->intr, serial,
-                        server->device_socket_name);
+    if (!direct) {
+        // we don't need the adb tunnel anymore
+        sc_adb_tunnel_close(tunnel, &server->intr, serial,
+                            server->device_socket_name);
+    }
+
+    if (mux_socket != SC_SOCKET_NONE) {
+        bool enabled[SC_MULTIPLEXER_STREAM_COUNT] = {
+            [SC_MULTIPLEXER_STREAM_VIDEO] = video,
+            [SC_MULTIPLEXER_STREAM_AUDIO] = audio,
+            [SC_MULTIPLEXER_STREAM_CONTROL] = control,
+            [SC_MULTIPLEXER_STREAM_RECORD_VIDEO] = record_video,
+        };
+
+        struct sc_multiplexer *mux = &server->multiplexer;
+        bool ok = sc_multiplexer_init(mux, mux_socket, enabled);
+        if (!ok) {
+            goto fail;
+        }
+
+        // The multiplexer now owns the socket
+        sc_socket socket = mux_socket;
+        mux_socket = SC_SOCKET_NONE;
+
+        video_socket =
+            sc_multiplexer_get_socket(mux, SC_MULTIPLEXER_STREAM_VIDEO);
+        audio_socket =
+            sc_multiplexer_get_socket(mux, SC_MULTIPLEXER_STREAM_AUDIO);
+        control_socket =
+            sc_multiplexer_get_socket(mux, SC_MULTIPLEXER_STREAM_CONTROL);
+        record_video_socket =
+            sc_multiplexer_get_socket(mux, SC_MULTIPLEXER_STREAM_RECORD_VIDEO);
+
+        if (server->params.socket_buffer_size) {
+            net_set_recv_buffer_size(socket,
+                                     server->params.socket_buffer_size);
+        }
+
+        ok = sc_multiplexer_start(mux);
+        if (!ok) {
+            sc_multiplexer_destroy(mux);
+            goto fail;
+        }
+
+        mux_started = true;
+    }
+
+    uint32_t socket_buffer_size = server->params.socket_buffer_size;
+    if (socket_buffer_size && !mux_started) {
+        // Failures are not fatal, the system default is used
+        if (video_socket != SC_SOCKET_NONE) {
+            net_set_recv_buffer_size(video_socket, socket_buffer_size);
+        }
+        if (record_video_socket != SC_SOCKET_NONE) {
+            net_set_recv_buffer_size(record_video_socket, socket_buffer_size);
+        }
+    }
+
+    if (direct && server->params.direct_udp && video) {
+        // The device waits for the UDP client before sending the device meta
+        uint8_t token[SC_DIRECT_TOKEN_LENGTH];
+        sc_write64be(token, server->params.direct_token[0]);
+        sc_write64be(&token[8], server->params.direct_token[1]);
 
+        udp_socket = sc_udp_video_connect(&server->intr, server->direct_host,
+                                          server->params.direct_port, token,
+                                          sizeof(token));
+        if (udp_socket == SC_SOCKET_NONE) {
+            goto fail;
+        }
+
+        if (socket_buffer_size) {
+            net_set_recv_buffer_size(udp_socket, socket_buffer_size);
+        }
+    }
+
+    // The device meta is always received over TCP
     sc_socket first_socket = video ? video_socket
                            : audio ? audio_socket
                                    : control_socket;
@@ -621,17 +1263,58 @@ sc_server_connect_to(struct sc_server *server, struct sc_server_info *info) {
         goto fail;
     }
 
+    if (udp_socket != SC_SOCKET_NONE) {
+        struct sc_udp_video *uv = &server->udp_video;
+        ok = sc_udp_video_init(uv, video_socket, udp_socket);
+        if (!ok) {
+            goto fail;
+        }
+
+        // The UDP video receiver now owns both sockets, the video stream is
+        // read from its socket
+        udp_socket = SC_SOCKET_NONE;
+        video_socket = sc_udp_video_get_socket(uv);
+
+        ok = sc_udp_video_start(uv);
+        if (!ok) {
+            sc_udp_video_destroy(uv);
+            goto fail;
+        }
+
+        udp_video_started = true;
+    }
+
     assert(!video || video_socket != SC_SOCKET_NONE);
     assert(!audio || audio_socket != SC_SOCKET_NONE);
     assert(!control || control_socket != SC_SOCKET_NONE);
+    assert(!record_video || record_video_socket != SC_SOCKET_NONE);
 
     server->video_socket = video_socket;
     server->audio_socket = audio_socket;
     server->control_socket = control_socket;
+    server->record_video_socket = record_video_socket;
+    server->multiplexed = mux_started;
+    server->udp_video_started = udp_video_started;
 
     return true;
 
 fail:
+    if (udp_socket != SC_SOCKET_NONE) {
+        net_close(udp_socket);
+    }
+
+    if (mux_started) {
+        sc_multiplexer_interrupt(&server->multiplexer);
+        sc_multiplexer_join(&server->multiplexer);
+        sc_multiplexer_destroy(&server->multiplexer);
+    }
+
+    if (mux_socket != SC_SOCKET_NONE) {
+        if (!net_close(mux_socket)) {
+            LOGW("Could not close multiplexed socket");
+        }
+    }
+
     if (video_socket != SC_SOCKET_NONE) {
         if (!net_close(video_socket)) {
             LOGW("Could not close video socket");
@@ -650,6 +1333,12 @@ fail:
         }
     }
 
+    if (record_video_socket != SC_SOCKET_NONE) {
+        if (!net_close(record_video_socket)) {
+            LOGW("Could not close record video socket");
+        }
+    }
+
     if (tunnel->enabled) {
         // Always leave this function with tunnel disabled
         sc_adb_tunnel_close(tunnel, &server->intr, serial,
@@ -852,6 +1541,62 @@ sc_server_kill_adb_if_requested(struct sc_server *server) {
     }
 }
 
+static void
+sc_server_close_tunnel(struct sc_server *server) {
+    // There is no tunnel in direct mode
+    if (server->tunnel.enabled) {
+        sc_adb_tunnel_close(&server->tunnel, &server->intr, server->serial,
+                            server->device_socket_name);
+    }
+}
+
+static bool
+sc_server_prepare_direct(struct sc_server *server) {
+    // The device must be connected over TCP/IP: its serial is "ip:port"
+    const char *serial = server->serial;
+    const char *colon = strrchr(serial, ':');
+    size_t len = colon ? (size_t) (colon - serial) : strlen(serial);
+
+    char ip[16]; // "xxx.xxx.xxx.xxx"
+    bool ok = len < sizeof(ip);
+    if (ok) {
+        memcpy(ip, serial, len);
+        ip[len] = '\0';
+        ok = net_parse_ipv4(ip, &server->direct_host);
+    }
+    if (!ok) {
+        LOGE("--direct-port requires a device connected via TCP/IP "
+             "(serial: %s)", serial);
+        return false;
+    }
+
+    uint8_t token[SC_DIRECT_TOKEN_LENGTH];
+    if (!sc_rand_secure(token, sizeof(token))) {
+        return false;
+    }
+    server->params.direct_token[0] = sc_read64be(token);
+    server->params.direct_token[1] = sc_read64be(&token[8]);
+
+    LOGI("Connecting directly to the device at %s:%" PRIu16, ip,
+         server->params.direct_port);
+    return true;
+}
+
+static int
+run_push_server(void *data) {
+    struct sc_server *server = data;
+
+    // It has its own interruptor, since it runs in parallel with the
+    // commands of the server thread
+    bool ok = push_server(&server->push_intr, server->serial);
+    if (!ok) {
+        return -1;
+    }
+
+    sc_startup_timeline_mark(SC_STARTUP_SERVER_PUSHED);
+    return 0;
+}
+
 static int
 run_server(void *data) {
     struct sc_server *server = data;
@@ -867,6 +1612,8 @@ run_server(void *data) {
         goto error_connection_failed;
     }
 
+    sc_startup_timeline_mark(SC_STARTUP_ADB_SERVER_STARTED);
+
     // params->tcpip_dst implies params->tcpip
     assert(!params->tcpip_dst || params->tcpip);
 
@@ -905,7 +1652,8 @@ run_server(void *data) {
             }
         }
         struct sc_adb_device device;
-        ok = sc_adb_select_device(&server->intr, &selector, 0, &device);
+        ok = sc_adb_select_device(&server->intr, &selector,
+                                  params->devices_cache, 0, &device);
         if (!ok) {
             goto error_connection_failed;
         }
@@ -936,70 +1684,163 @@ run_server(void *data) {
     const char *serial = server->serial;
     assert(serial);
     LOGD("Device serial: %s", serial);
+    sc_startup_timeline_mark(SC_STARTUP_DEVICE_SELECTED);
 
-    ok = push_server(&server->intr, serial);
-    if (!ok) {
-        goto error_connection_failed;
-    }
+    // In daemon mode, the server may already be running on the device
+    bool daemon = params->daemon_idle_timeout && !params->list;
 
     // If --list-* is passed, then the server just prints the requested data
     // then exits.
     if (params->list) {
-        sc_pid pid = execute_server(server, params);
-        if (pid == SC_PROCESS_NONE) {
+        ok = run_server_list(server);
+        if (!ok) {
             goto error_connection_failed;
         }
-        sc_process_wait(pid, NULL); // ignore exit code
-        sc_process_close(pid);
+
         // Wake up await_for_server()
         server->cbs->on_connected(server, server->cbs_userdata);
         return 0;
     }
 
+    if (daemon) {
+        // The daemon mode is only supported in forward tunnel mode (forced by
+        // the command line parsing)
+        assert(params->force_adb_forward);
+        ok = get_daemon_scid(server, &server->params.scid);
+        if (!ok) {
+            goto error_connection_failed;
+        }
+    }
+
+    bool persistent_tunnel = false;
+    if (params->persistent_tunnel) {
+        assert(!params->force_adb_forward && !params->direct_port);
+        // The scid is derived from the port of the tunnel, it must be known
+        // before executing the server
+        persistent_tunnel =
+            sc_adb_tunnel_open_persistent(&server->tunnel, &server->intr,
+                                          serial, SC_SOCKET_NAME_PREFIX,
+                                          params->port_range,
+                                          &server->params.scid);
+        if (!persistent_tunnel) {
+            if (sc_intr_is_interrupted(&server->intr)) {
+                goto error_connection_failed;
+            }
+            LOGW("Could not open a persistent tunnel, fallback to a "
+                 "temporary one");
+        }
+    }
+
     int r = asprintf(&server->device_socket_name, SC_SOCKET_NAME_PREFIX "%08x",
                      params->scid);
     if (r == -1) {
         LOG_OOM();
+        sc_server_close_tunnel(server);
         goto error_connection_failed;
     }
     assert(r == sizeof(SC_SOCKET_NAME_PREFIX) - 1 + 8);
     assert(server->device_socket_name);
 
-    ok = sc_adb_tunnel_open(&server->tunnel, &server->intr, serial,
-                            server->device_socket_name, params->port_range,
-                            params->force_adb_forward);
+    // The push and the tunnel are independent: push the server while the
+    // tunnel is opened (the daemon may not need any push)
+    sc_thread push_thread;
+    bool pushing = false;
+    if (!daemon) {
+        pushing = sc_thread_create(&push_thread, run_push_server,
+                                   "scrcpy-push", server);
+        if (!pushing) {
+            LOGW("Could not start push thread, pushing sequentially");
+            ok = push_server(&server->intr, serial);
+            if (!ok) {
+                goto error_connection_failed;
+            }
+            sc_startup_timeline_mark(SC_STARTUP_SERVER_PUSHED);
+        }
+    }
+
+    if (params->direct_port) {
+        // The streams are not transmitted through adb
+        ok = sc_server_prepare_direct(server);
+    } else if (persistent_tunnel) {
+        // Already open
+        ok = true;
+    } else {
+        ok = sc_adb_tunnel_open(&server->tunnel, &server->intr, serial,
+                                server->device_socket_name, params->port_range,
+                                params->force_adb_forward);
+    }
+
+    if (ok) {
+        sc_startup_timeline_mark(SC_STARTUP_TUNNEL_OPENED);
+    } else if (pushing) {
+        // Do not wait for the end of the push
+        sc_intr_interrupt(&server->push_intr);
+    }
+
+    if (pushing) {
+        int status;
+        sc_thread_join(&push_thread, &status);
+        if (ok && status) {
+            // The push failed
+            sc_server_close_tunnel(server);
+            ok = false;
+        }
+    }
+
     if (!ok) {
         goto error_connection_failed;
     }
 
-    // server will connect to our server socket
-    sc_pid pid = execute_server(server, params);
-    if (pid == SC_PROCESS_NONE) {
-        sc_adb_tunnel_close(&server->tunnel, &server->intr, serial,
-                            server->device_socket_name);
-        goto error_connection_failed;
+    sc_socket daemon_socket = SC_SOCKET_NONE;
+    if (daemon) {
+        daemon_socket = connect_to_daemon(server);
+        if (daemon_socket != SC_SOCKET_NONE) {
+            LOGI("Connected to the server already running on the device");
+        } else {
+            ok = push_server(&server->intr, serial);
+            if (!ok) {
+                sc_adb_tunnel_close(&server->tunnel, &server->intr, serial,
+                                    server->device_socket_name);
+                goto error_connection_failed;
+            }
+        }
     }
 
-    static const struct sc_process_listener listener = {
-        .on_terminated = sc_server_on_terminated,
-    };
+    // No server process if the server is already running on the device
+    sc_pid pid = SC_PROCESS_NONE;
     struct sc_process_observer observer;
-    ok = sc_process_observer_init(&observer, pid, &listener, server);
-    if (!ok) {
-        sc_process_terminate(pid);
-        sc_process_wait(pid, true); // ignore exit code
-        sc_adb_tunnel_close(&server->tunnel, &server->intr, serial,
-                            server->device_socket_name);
-        goto error_connection_failed;
+
+    if (daemon_socket == SC_SOCKET_NONE) {
+        // server will connect to our server socket
+        pid = execute_server(server, params, NULL);
+        if (pid == SC_PROCESS_NONE) {
+            sc_server_close_tunnel(server);
+            goto error_connection_failed;
+        }
+
+        sc_startup_timeline_mark(SC_STARTUP_SERVER_EXECUTED);
+
+        static const struct sc_process_listener listener = {
+            .on_terminated = sc_server_on_terminated,
+        };
+        ok = sc_process_observer_init(&observer, pid, &listener, server);
+        if (!ok) {
+            sc_process_terminate(pid);
+            sc_process_wait(pid, true); // ignore exit code
+            sc_server_close_tunnel(server);
+            goto error_connection_failed;
+        }
     }
 
-    ok = sc_server_connect_to(server, &server->info);
+    ok = sc_server_connect_to(server, &server->info, daemon_socket);
     // The tunnel is always closed by server_connect_to()
     if (!ok) {
-        sc_process_terminate(pid);
-        sc_process_wait(pid, true); // ignore exit code
-        sc_process_observer_join(&observer);
-        sc_process_observer_destroy(&observer);
+        if (pid != SC_PROCESS_NONE) {
+            sc_process_terminate(pid);
+            sc_process_wait(pid, true); // ignore exit code
+            sc_process_observer_join(&observer);
+            sc_process_observer_destroy(&observer);
+        }
         goto error_connection_failed;
     }
 
@@ -1013,12 +1854,19 @@ run_server(void *data) {
     }
     sc_mutex_unlock(&server->mutex);
 
+    // The shutdown delay starts now: the server terminates (on the device)
+    // while the local streams are stopped
+    sc_tick deadline = sc_tick_now() + params->shutdown_timeout;
+
     // Interrupt sockets to wake up socket blocking calls on the server
 
+    // The video socket may be replaced concurrently on reconnection
+    sc_mutex_lock(&server->mutex);
     if (server->video_socket != SC_SOCKET_NONE) {
         // There is no video_socket if --no-video is set
         net_interrupt(server->video_socket);
     }
+    sc_mutex_unlock(&server->mutex);
 
     if (server->audio_socket != SC_SOCKET_NONE) {
         // There is no audio_socket if --no-audio is set
@@ -1030,26 +1878,52 @@ run_server(void *data) {
         net_interrupt(server->control_socket);
     }
 
-    // Give some delay for the server to terminate properly
-#define WATCHDOG_DELAY SC_TICK_FROM_SEC(1)
-    sc_tick deadline = sc_tick_now() + WATCHDOG_DELAY;
-    bool terminated = sc_process_observer_timedwait(&observer, deadline);
+    if (server->record_video_socket != SC_SOCKET_NONE) {
+        // Only if --record-video-bit-rate is set
+        net_interrupt(server->record_video_socket);
+    }
 
-    // After this delay, kill the server if it's not dead already.
-    // On some devices, closing the sockets is not sufficient to wake up the
-    // blocking calls while the device is asleep.
-    if (!terminated) {
-        // The process may have terminated since the check, but it is not
-        // reaped (closed) yet, so its PID is still valid, and it is ok to call
-        // sc_process_terminate() even in that case.
-        LOGW("Killing the server...");
-        sc_process_terminate(pid);
+    if (server->multiplexed) {
+        // Only if --multiplex is set
+        sc_multiplexer_interrupt(&server->multiplexer);
+        sc_multiplexer_join(&server->multiplexer);
+        sc_multiplexer_destroy(&server->multiplexer);
     }
 
-    sc_process_observer_join(&observer);
-    sc_process_observer_destroy(&observer);
+    if (server->udp_video_started) {
+        // Only if --direct-udp is set
+        sc_udp_video_interrupt(&server->udp_video);
+        sc_udp_video_join(&server->udp_video);
+        sc_udp_video_destroy(&server->udp_video);
+    }
 
-    sc_process_close(pid);
+    if (pid != SC_PROCESS_NONE) {
+        if (daemon) {
+            // The server keeps running on the device for the next clients,
+            // only the local "adb shell" process is terminated
+            sc_process_terminate(pid);
+        } else {
+            // Give some delay for the server to terminate properly
+            bool terminated = params->shutdown_timeout
+                && sc_process_observer_timedwait(&observer, deadline);
+
+            // After this delay, kill the server if it's not dead already.
+            // On some devices, closing the sockets is not sufficient to wake
+            // up the blocking calls while the device is asleep.
+            if (!terminated) {
+                // The process may have terminated since the check, but it is
+                // not reaped (closed) yet, so its PID is still valid, and it
+                // is ok to call sc_process_terminate() even in that case.
+                LOGW("Killing the server...");
+                sc_process_terminate(pid);
+            }
+        }
+
+        sc_process_observer_join(&observer);
+        sc_process_observer_destroy(&observer);
+
+        sc_process_close(pid);
+    }
 
     sc_server_kill_adb_if_requested(server);
 
@@ -1079,6 +1953,7 @@ sc_server_stop(struct sc_server *server) {
     server->stopped = true;
     sc_cond_signal(&server->cond_stopped);
     sc_intr_interrupt(&server->intr);
+    sc_intr_interrupt(&server->push_intr);
     sc_mutex_unlock(&server->mutex);
 }
 
@@ -1087,6 +1962,87 @@ sc_server_join(struct sc_server *server) {
     sc_thread_join(&server->thread, NULL);
 }
 
+sc_socket
+sc_server_reconnect_video(struct sc_server *server) {
+    assert(server->params.video_reconnect);
+    // Not supported with multiplexing, UDP video or a direct connection
+    assert(!server->multiplexed && !server->udp_video_started);
+    assert(!server->params.direct_port);
+
+    const struct sc_server_params *params = &server->params;
+    struct sc_adb_tunnel *tunnel = &server->tunnel;
+    // The tunnel is always closed once connected
+    assert(!tunnel->enabled);
+
+    // The device expects the same tunnel direction as on start
+    bool forward = tunnel->forward;
+    bool ok;
+    if (tunnel->persistent) {
+        // The device socket name is bound to the port of the tunnel
+        struct sc_port_range port_range = {
+            .first = tunnel->local_port,
+            .last = tunnel->local_port,
+        };
+        uint32_t scid;
+        ok = sc_adb_tunnel_open_persistent(tunnel, &server->intr,
+                                           server->serial,
+                                           SC_SOCKET_NAME_PREFIX, port_range,
+                                           &scid);
+        assert(!ok || scid == params->scid);
+    } else {
+        ok = sc_adb_tunnel_open(tunnel, &server->intr, server->serial,
+                                server->device_socket_name, params->port_range,
+                                forward);
+    }
+    if (!ok) {
+        LOGE("Could not reopen the adb tunnel");
+        return SC_SOCKET_NONE;
+    }
+
+    sc_socket socket = SC_SOCKET_NONE;
+    if (tunnel->forward != forward) {
+        LOGE("Could not reopen the adb reverse tunnel");
+    } else if (forward) {
+        uint32_t tunnel_host;
+        uint16_t tunnel_port;
+        sc_server_get_tunnel_address(server, &tunnel_host, &tunnel_port);
+
+        sc_tick timeout = SC_TICK_FROM_SEC(10);
+        socket = connect_to_server(server, timeout, tunnel_host, tunnel_port);
+    } else {
+        // The server connects again to the video stream
+        socket = net_accept_intr(&server->intr, tunnel->server_socket);
+    }
+
+    sc_adb_tunnel_close(tunnel, &server->intr, server->serial,
+                        server->device_socket_name);
+
+    if (socket == SC_SOCKET_NONE) {
+        return SC_SOCKET_NONE;
+    }
+
+    if (params->socket_buffer_size) {
+        // Failures are not fatal, the system default is used
+        net_set_recv_buffer_size(socket, params->socket_buffer_size);
+    }
+
+    sc_mutex_lock(&server->mutex);
+    if (server->stopped) {
+        sc_mutex_unlock(&server->mutex);
+        net_close(socket);
+        return SC_SOCKET_NONE;
+    }
+    sc_socket old_socket = server->video_socket;
+    server->video_socket = socket;
+    sc_mutex_unlock(&server->mutex);
+
+    if (old_socket != SC_SOCKET_NONE) {
+        net_close(old_socket);
+    }
+
+    return socket;
+}
+
 void
 sc_server_destroy(struct sc_server *server) {
     if (server->video_socket != SC_SOCKET_NONE) {
@@ -1098,10 +2054,14 @@ sc_server_destroy(struct sc_server *server) {
     if (server->control_socket != SC_SOCKET_NONE) {
         net_close(server->control_socket);
     }
+    if (server->record_video_socket != SC_SOCKET_NONE) {
+        net_close(server->record_video_socket);
+    }
 
     free(server->serial);
     free(server->device_socket_name);
     sc_server_params_destroy(&server->params);
+    sc_intr_destroy(&server->push_intr);
     sc_intr_destroy(&server->intr);
     sc_cond_destroy(&server->cond_stopped);
     sc_mutex_destroy(&server->mutex);
@@ -9,7 +9,9 @@
 
 #include "adb/adb_tunnel.h"
 #include "coords.h"
+#include "multiplexer.h"
 #include "options.h"
+#include "udp_video.h"
 #include "util/intr.h"
 #include "util/log.h"
 #include "util/net.h"
@@ -30,6 +32,7 @@ struct sc_server_params {
     enum sc_audio_source audio_source;
     enum sc_camera_facing camera_facing;
     const char *crop;
+    const char *new_display;
     const char *video_codec_options;
     const char *audio_codec_options;
     const char *video_encoder;
@@ -38,21 +41,39 @@ struct sc_server_params {
     const char *camera_size;
     const char *camera_ar;
     uint16_t camera_fps;
+    const char *pattern_size;
+    uint16_t pattern_fps;
     struct sc_port_range port_range;
     uint32_t tunnel_host;
     uint16_t tunnel_port;
     uint16_t max_size;
     uint32_t video_bit_rate;
+    uint32_t record_video_bit_rate; // 0 if no separate record video stream
+    enum sc_video_source record_video_source;
     uint32_t audio_bit_rate;
+    uint32_t audio_sample_rate;
+    uint8_t audio_channels;
+    uint16_t audio_read_size; // 0 for the default
     uint16_t max_fps;
+    sc_tick video_repeat_delay; // -1 for the default
+    enum sc_video_latency_profile video_latency_profile;
+    bool video_intra_refresh;
+    bool video_hdr;
+    bool square_video;
+    bool gpu_downscale;
+    const char *video_masks;
+    bool adaptive_fps;
+    bool thermal_governor;
     int8_t lock_video_orientation;
     bool control;
+    bool control_compression;
     uint32_t display_id;
     bool video;
     bool audio;
     bool show_touches;
     bool stay_awake;
     bool force_adb_forward;
+    bool persistent_tunnel;
     bool power_off_on_close;
     bool clipboard_autosync;
     bool downsize_on_error;
@@ -64,7 +85,26 @@ struct sc_server_params {
     bool power_on;
     bool kill_adb_on_close;
     bool camera_high_speed;
+    bool camera_low_latency;
+    bool camera_lock_ae_af;
     uint8_t list;
+    bool latency_stats;
+    bool encoder_stats;
+    sc_tick daemon_idle_timeout; // 0 to stop the server with the client
+    const char *devices_cache; // may be NULL
+    const char *list_cache; // may be NULL
+    // Delay for the server to terminate on its own before it is killed
+    sc_tick shutdown_timeout;
+    uint32_t socket_buffer_size; // 0 for the system default
+    bool multiplex;
+    // Reconnect the video socket (through a new adb tunnel) if it is lost
+    bool video_reconnect;
+    bool video_pacing;
+    uint16_t direct_port; // 0 to transmit the streams through adb
+    // Only if direct_port is set: the secret the client sends on each
+    // connection (generated on start)
+    uint64_t direct_token[2];
+    bool direct_udp; // only if direct_port is set
 };
 
 struct sc_server {
@@ -81,11 +121,26 @@ struct sc_server {
     bool stopped;
 
     struct sc_intr intr;
+    struct sc_intr push_intr; // the server is pushed in parallel
     struct sc_adb_tunnel tunnel;
 
     sc_socket video_socket;
     sc_socket audio_socket;
     sc_socket control_socket;
+    sc_socket record_video_socket; // for a separate record video stream
+
+    // Only if params.multiplex is set: the sockets above are provided by the
+    // multiplexer
+    struct sc_multiplexer multiplexer;
+    bool multiplexed;
+
+    // Only if params.direct_port is set
+    uint32_t direct_host;
+
+    // Only if params.direct_udp is set: the video socket is provided by the
+    // UDP video receiver
+    struct sc_udp_video udp_video;
+    bool udp_video_started;
 
     const struct sc_server_callbacks *cbs;
     void *cbs_userdata;
@@ -132,4 +187,12 @@ sc_server_join(struct sc_server *server);
 void
 sc_server_destroy(struct sc_server *server);
 
+// Reconnect the video socket once it is lost (only if params.video_reconnect
+// is set), and return the new one (or SC_SOCKET_NONE on error)
+//
+// It must be called from the video demuxer thread (the previous socket is
+// closed). It is interrupted by sc_server_stop().
+sc_socket
+sc_server_reconnect_video(struct sc_server *server);
+
 #endif
@@ -0,0 +1,74 @@
+#include "startup_timeline.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "util/log.h"
+
+struct sc_startup_event_desc {
+    const char *name; // for the logs
+    const char *key; // for the JSON output
+};
+
+static const struct sc_startup_event_desc sc_startup_events[] = {
+    [SC_STARTUP_ADB_SERVER_STARTED] = {"adb server started", "adb_start_server"},
+    [SC_STARTUP_DEVICE_SELECTED] = {"device selected", "device_selection"},
+    [SC_STARTUP_SERVER_PUSHED] = {"server pushed", "server_push"},
+    [SC_STARTUP_TUNNEL_OPENED] = {"tunnel opened", "tunnel"},
+    [SC_STARTUP_SERVER_EXECUTED] = {"server executed", "server_start"},
+    [SC_STARTUP_SDL_INITIALIZED] = {"SDL initialized", "sdl_init"},
+    [SC_STARTUP_SERVER_CONNECTED] = {"server connected", "server_connection"},
+    [SC_STARTUP_WINDOW_CREATED] = {"window created", "window_creation"},
+    [SC_STARTUP_FIRST_CONFIG_PACKET] = {"first config packet",
+                                        "first_config_packet"},
+    [SC_STARTUP_FIRST_DECODED_FRAME] = {"first decoded frame",
+                                        "first_decoded_frame"},
+    [SC_STARTUP_FIRST_PRESENT] = {"first present", "first_present"},
+};
+
+static sc_tick sc_startup_origin;
+// Time since the origin, or -1 if the event has not been recorded yet
+static _Atomic sc_tick sc_startup_ticks[SC_STARTUP_EVENT_COUNT];
+
+void
+sc_startup_timeline_init(void) {
+    sc_startup_origin = sc_tick_now();
+    for (unsigned i = 0; i < SC_STARTUP_EVENT_COUNT; ++i) {
+        atomic_init(&sc_startup_ticks[i], -1);
+    }
+}
+
+void
+sc_startup_timeline_mark(enum sc_startup_event event) {
+    assert(event < SC_STARTUP_EVENT_COUNT);
+
+    sc_tick t = sc_tick_now() - sc_startup_origin;
+    sc_tick expected = -1;
+    if (!atomic_compare_exchange_strong(&sc_startup_ticks[event], &expected,
+                                        t)) {
+        // Already recorded
+        return;
+    }
+
+    LOGD("Startup: %s at +%" PRItick "ms", sc_startup_events[event].name,
+         SC_TICK_TO_MS(t));
+}
+
+void
+sc_startup_timeline_print_json(void) {
+    printf("{");
+    for (unsigned i = 0; i < SC_STARTUP_EVENT_COUNT; ++i) {
+        const char *sep = i ? ", " : "";
+        sc_tick t = atomic_load(&sc_startup_ticks[i]);
+        if (t < 0) {
+            printf("%s\"%s\": null", sep, sc_startup_events[i].key);
+        } else {
+            printf("%s\"%s\": %" PRItick, sep, sc_startup_events[i].key,
+                   SC_TICK_TO_MS(t));
+        }
+    }
+    printf("}\n");
+    fflush(stdout);
+}
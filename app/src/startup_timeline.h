@@ -0,0 +1,56 @@
+#ifndef SC_STARTUP_TIMELINE_H
+#define SC_STARTUP_TIMELINE_H
+
+#include "common.h"
+
+#include "util/tick.h"
+
+/**
+ * Timestamps of the startup steps, to measure the time to the first frame
+ *
+ * The steps run on several threads (the server thread, the main thread and
+ * the stream threads), some of them in parallel. Each step is logged (at
+ * debug level) with its time since sc_startup_timeline_init().
+ *
+ * With --benchmark-startup, the whole timeline is printed as JSON once the
+ * first frame is presented.
+ */
+
+enum sc_startup_event {
+    SC_STARTUP_ADB_SERVER_STARTED,
+    SC_STARTUP_DEVICE_SELECTED,
+    SC_STARTUP_SERVER_PUSHED,
+    SC_STARTUP_TUNNEL_OPENED,
+    SC_STARTUP_SERVER_EXECUTED,
+    SC_STARTUP_SDL_INITIALIZED,
+    SC_STARTUP_SERVER_CONNECTED,
+    SC_STARTUP_WINDOW_CREATED,
+    SC_STARTUP_FIRST_CONFIG_PACKET,
+    SC_STARTUP_FIRST_DECODED_FRAME,
+    SC_STARTUP_FIRST_PRESENT,
+    SC_STARTUP_EVENT_COUNT,
+};
+
+// Set the origin of the timeline
+void
+sc_startup_timeline_init(void);
+
+/**
+ * Record an event (only its first occurrence)
+ *
+ * It may be called from any thread.
+ */
+void
+sc_startup_timeline_mark(enum sc_startup_event event);
+
+/**
+ * Print the timeline as a JSON object to stdout
+ *
+ * Each event is associated to its time in milliseconds since the origin, or
+ * null if it did not happen (for example, the push is skipped if the server
+ * is already running on the device).
+ */
+void
+sc_startup_timeline_print_json(void);
+
+#endif
@@ -0,0 +1,607 @@
+#include "stats.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <signal.h>
+# include <sys/resource.h>
+#endif
+
+#include "util/log.h"
+#include "util/strbuf.h"
+
+#define SC_STATS_INTERVAL SC_TICK_FROM_SEC(1)
+
+struct sc_stat_desc {
+    const char *name;
+    bool counter; // false for a gauge
+    const char *help;
+};
+
+static const struct sc_stat_desc stat_descs[] = {
+    [SC_STAT_VIDEO_PACKETS] = {
+        "video_packets", true, "Video packets received",
+    },
+    [SC_STAT_VIDEO_BYTES] = {
+        "video_bytes", true, "Video bytes received",
+    },
+    [SC_STAT_AUDIO_PACKETS] = {
+        "audio_packets", true, "Audio packets received",
+    },
+    [SC_STAT_AUDIO_BYTES] = {
+        "audio_bytes", true, "Audio bytes received",
+    },
+    [SC_STAT_VIDEO_CONFIG_PACKETS] = {
+        "video_config_packets", true,
+        "Video config packets received (one per encoding session)",
+    },
+    [SC_STAT_AUDIO_CONFIG_PACKETS] = {
+        "audio_config_packets", true, "Audio config packets received",
+    },
+    [SC_STAT_VIDEO_KEYFRAMES] = {
+        "video_keyframes", true, "Video keyframes received",
+    },
+    [SC_STAT_VIDEO_KEYFRAME_BYTES] = {
+        "video_keyframe_bytes", true, "Video keyframes bytes received",
+    },
+    [SC_STAT_VIDEO_RECONNECTIONS] = {
+        "video_reconnections", true,
+        "Video stream reconnections after a connection loss",
+    },
+    [SC_STAT_FRAMES_RENDERED] = {
+        "frames_rendered", true, "Video frames rendered",
+    },
+    [SC_STAT_FRAMES_SKIPPED] = {
+        "frames_skipped", true, "Video frames skipped before rendering",
+    },
+    [SC_STAT_VIDEO_PACKETS_DECODED] = {
+        "video_packets_decoded", true, "Video packets decoded",
+    },
+    [SC_STAT_VIDEO_DECODE_TIME_US] = {
+        "video_decode_time_us", true,
+        "Time spent decoding the video packets, in microseconds",
+    },
+    [SC_STAT_DECODE_ERRORS] = {
+        "decode_errors", true,
+        "Decoding errors recovered without stopping the stream",
+    },
+    [SC_STAT_VIDEO_PACKETS_DROPPED] = {
+        "video_packets_dropped", true,
+        "Video packets dropped until a keyframe after a decoding error",
+    },
+    [SC_STAT_AUDIO_UNDERFLOW_SAMPLES] = {
+        "audio_underflow_samples", true,
+        "Silence samples inserted on audio buffer underflow",
+    },
+    [SC_STAT_AUDIO_DROPPED_SAMPLES] = {
+        "audio_dropped_samples", true,
+        "Audio samples dropped on buffer overflow",
+    },
+    [SC_STAT_CONTROL_MSGS_COALESCED] = {
+        "control_msgs_coalesced", true,
+        "Control messages merged into a queued message",
+    },
+    [SC_STAT_CONTROL_COMPRESSION_SAVED_BYTES] = {
+        "control_compression_saved_bytes", true,
+        "Bytes saved by the compression of the control and device messages",
+    },
+    [SC_STAT_RESTREAM_DROPPED_PACKETS] = {
+        "restream_dropped_packets", true,
+        "Packets not restreamed because the network was too slow",
+    },
+    [SC_STAT_CPU_TIME_MS] = {
+        "cpu_time_ms", true, "CPU time (user and system) used by scrcpy",
+    },
+    [SC_STAT_VIDEO_KEYFRAME_LAST_BYTES] = {
+        "video_keyframe_last_bytes", false, "Size of the last video keyframe",
+    },
+    [SC_STAT_VIDEO_KEYFRAME_MAX_BYTES] = {
+        "video_keyframe_max_bytes", false, "Size of the largest video keyframe",
+    },
+    [SC_STAT_VIDEO_ENCODED_BITRATE] = {
+        "video_encoded_bitrate", false,
+        "Video bitrate over the last second of capture time (bits/s)",
+    },
+    [SC_STAT_AUDIO_ENCODED_BITRATE] = {
+        "audio_encoded_bitrate", false,
+        "Audio bitrate over the last second of capture time (bits/s)",
+    },
+    [SC_STAT_VIDEO_JITTER_US] = {
+        "video_jitter_us", false,
+        "Video packets interarrival jitter (RFC 3550), in microseconds",
+    },
+    [SC_STAT_AUDIO_JITTER_US] = {
+        "audio_jitter_us", false,
+        "Audio packets interarrival jitter (RFC 3550), in microseconds",
+    },
+    [SC_STAT_AUDIO_BUFFERING_SAMPLES] = {
+        "audio_buffering_samples", false, "Average audio buffering",
+    },
+    [SC_STAT_AUDIO_TARGET_BUFFERING_SAMPLES] = {
+        "audio_target_buffering_samples", false, "Target audio buffering",
+    },
+    [SC_STAT_AUDIO_COMPENSATION] = {
+        "audio_compensation", false,
+        "Audio clock compensation (samples per second)",
+    },
+    [SC_STAT_RECORDER_VIDEO_QUEUE] = {
+        "recorder_video_queue", false, "Video packets queued for recording",
+    },
+    [SC_STAT_RECORDER_AUDIO_QUEUE] = {
+        "recorder_audio_queue", false, "Audio packets queued for recording",
+    },
+    [SC_STAT_RECORDER_QUEUE_BYTES] = {
+        "recorder_queue_bytes", false,
+        "Bytes of the packets queued in memory for recording",
+    },
+    [SC_STAT_RECORDER_SPILLED_PACKETS] = {
+        "recorder_spilled_packets", false,
+        "Packets spilled to disk for recording",
+    },
+    [SC_STAT_CONTROLLER_QUEUE] = {
+        "controller_queue", false, "Control messages queued",
+    },
+    [SC_STAT_DISPLAY_BUFFER_QUEUE] = {
+        "display_buffer_queue", false,
+        "Video frames queued in the display buffer",
+    },
+    [SC_STAT_V4L2_BUFFER_QUEUE] = {
+        "v4l2_buffer_queue", false, "Video frames queued in the V4L2 buffer",
+    },
+    [SC_STAT_AUDIO_LATENCY_MS] = {
+        "audio_latency_ms", false,
+        "Estimated delay between the reception and the playback of audio",
+    },
+    [SC_STAT_AV_OFFSET_MS] = {
+        "av_offset_ms", false,
+        "Offset of the presented video relative to the played audio "
+        "(positive if the video is ahead)",
+    },
+    [SC_STAT_MEM_PACKET_POOL_BYTES] = {
+        "mem_packet_pool_bytes", false,
+        "Bytes allocated by the packet pools of the demuxers",
+    },
+    [SC_STAT_MEM_PACKET_MERGER_BYTES] = {
+        "mem_packet_merger_bytes", false,
+        "Bytes of the config packets waiting to be merged",
+    },
+    [SC_STAT_MEM_DELAY_BUFFER_BYTES] = {
+        "mem_delay_buffer_bytes", false,
+        "Bytes of the video frames queued in the delay buffers",
+    },
+    [SC_STAT_MEM_FRAME_BUFFER_BYTES] = {
+        "mem_frame_buffer_bytes", false,
+        "Bytes of the video frames held for rendering",
+    },
+    [SC_STAT_MEM_SWR_BYTES] = {
+        "mem_swr_bytes", false, "Bytes of the audio resampling buffer",
+    },
+    [SC_STAT_RESTREAM_QUEUE_BYTES] = {
+        "restream_queue_bytes", false,
+        "Bytes of the packets queued for restreaming",
+    },
+    [SC_STAT_MEM_RESTREAM_GOP_BYTES] = {
+        "mem_restream_gop_bytes", false,
+        "Bytes of the packets since the last keyframe, kept for new viewers",
+    },
+    [SC_STAT_RESTREAM_VIEWERS] = {
+        "restream_viewers", false, "Number of connected restreaming viewers",
+    },
+    [SC_STAT_INJECTION_LATENCY_P50_US] = {
+        "injection_latency_p50_us", false,
+        "Median delay to inject an input event on the device",
+    },
+    [SC_STAT_INJECTION_LATENCY_P99_US] = {
+        "injection_latency_p99_us", false,
+        "99th percentile of the delay to inject an input event on the device",
+    },
+    [SC_STAT_ENCODE_LATENCY_P50_US] = {
+        "encode_latency_p50_us", false,
+        "Median delay between the capture and the encoding of a video frame "
+        "on the device",
+    },
+    [SC_STAT_ENCODE_LATENCY_P99_US] = {
+        "encode_latency_p99_us", false,
+        "99th percentile of the delay between the capture and the encoding of "
+        "a video frame on the device",
+    },
+    [SC_STAT_WRITE_BLOCK_P50_US] = {
+        "write_block_p50_us", false,
+        "Median time the device is blocked writing a video packet to the socket",
+    },
+    [SC_STAT_WRITE_BLOCK_P99_US] = {
+        "write_block_p99_us", false,
+        "99th percentile of the time the device is blocked writing a video "
+        "packet to the socket",
+    },
+    [SC_STAT_CLOCK_SYNC_ERROR_US] = {
+        "clock_sync_error_us", false,
+        "Error bound of the device clock estimation (half the round-trip time "
+        "of the best recent clock sync exchange)",
+    },
+    [SC_STAT_DEVICE_THERMAL_STATUS] = {
+        "device_thermal_status", false,
+        "Thermal status of the device (android.os.PowerManager "
+        "THERMAL_STATUS_*, -1 if unknown)",
+    },
+    [SC_STAT_THERMAL_LEVEL] = {
+        "thermal_level", false,
+        "Level of the video limits applied by the thermal governor (0 for no "
+        "limit)",
+    },
+};
+
+static_assert(ARRAY_LEN(stat_descs) == SC_STAT_COUNT, "missing stat desc");
+
+#ifndef _WIN32
+// Set by the SIGUSR1 handler, reset by the stats thread
+static volatile sig_atomic_t sc_stats_memory_dump_requested;
+
+static void
+sc_stats_on_sigusr1(int signum) {
+    (void) signum;
+    sc_stats_memory_dump_requested = 1;
+}
+#endif
+
+bool
+sc_stats_init(struct sc_stats *stats, const char *filename,
+              enum sc_stats_format format) {
+    for (unsigned i = 0; i < SC_STAT_COUNT; ++i) {
+        atomic_init(&stats->values[i], 0);
+    }
+
+    stats->filename = filename;
+    stats->format = format;
+    stats->file = NULL;
+
+    if (filename && format == SC_STATS_FORMAT_JSON) {
+        stats->file = fopen(filename, "a");
+        if (!stats->file) {
+            LOGE("Could not open stats file: %s", filename);
+            return false;
+        }
+    }
+
+    bool ok = sc_mutex_init(&stats->mutex);
+    if (!ok) {
+        goto error_close_file;
+    }
+
+    ok = sc_cond_init(&stats->cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    stats->stopped = false;
+
+    return true;
+
+error_destroy_mutex:
+    sc_mutex_destroy(&stats->mutex);
+error_close_file:
+    if (stats->file) {
+        fclose(stats->file);
+    }
+
+    return false;
+}
+
+void
+sc_stats_destroy(struct sc_stats *stats) {
+    sc_cond_destroy(&stats->cond);
+    sc_mutex_destroy(&stats->mutex);
+    if (stats->file) {
+        fclose(stats->file);
+    }
+}
+
+// Return the CPU time (user and system) used by the process, in
+// milliseconds, or -1 on error
+static int64_t
+sc_stats_get_cpu_time_ms(void) {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel,
+                         &user)) {
+        return -1;
+    }
+
+    // FILETIME values are expressed in 100-nanosecond intervals
+    uint64_t k = ((uint64_t) kernel.dwHighDateTime << 32)
+               | kernel.dwLowDateTime;
+    uint64_t u = ((uint64_t) user.dwHighDateTime << 32) | user.dwLowDateTime;
+    return (k + u) / 10000;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage)) {
+        return -1;
+    }
+
+    return (int64_t) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000
+         + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+#endif
+}
+
+static bool
+sc_stats_format_json(struct sc_stats *stats, struct sc_strbuf *buf,
+                     const int64_t *values, sc_tick now,
+                     uint64_t video_bitrate, uint64_t audio_bitrate) {
+    char tmp[64];
+    sc_tick time_ms = SC_TICK_TO_MS(now - stats->start);
+    int len = snprintf(tmp, sizeof(tmp), "{\"time_ms\":%" PRId64, time_ms);
+    assert(len > 0 && (size_t) len < sizeof(tmp));
+    if (!sc_strbuf_append(buf, tmp, len)) {
+        return false;
+    }
+
+    for (unsigned i = 0; i < SC_STAT_COUNT; ++i) {
+        len = snprintf(tmp, sizeof(tmp), ",\"%s\":%" PRId64,
+                       stat_descs[i].name, values[i]);
+        assert(len > 0 && (size_t) len < sizeof(tmp));
+        if (!sc_strbuf_append(buf, tmp, len)) {
+            return false;
+        }
+    }
+
+    len = snprintf(tmp, sizeof(tmp), ",\"video_bitrate\":%" PRIu64_
+                   ",\"audio_bitrate\":%" PRIu64_ "}\n",
+                   video_bitrate, audio_bitrate);
+    assert(len > 0 && (size_t) len < sizeof(tmp));
+    return sc_strbuf_append(buf, tmp, len);
+}
+
+static bool
+sc_stats_append_prometheus(struct sc_strbuf *buf, const char *name,
+                           bool counter, const char *help, int64_t value) {
+    const char *suffix = counter ? "_total" : "";
+    const char *type = counter ? "counter" : "gauge";
+
+    char tmp[256];
+    int len = snprintf(tmp, sizeof(tmp),
+                       "# HELP scrcpy_%s%s %s\n"
+                       "# TYPE scrcpy_%s%s %s\n"
+                       "scrcpy_%s%s %" PRId64 "\n",
+                       name, suffix, help, name, suffix, type, name, suffix,
+                       value);
+    assert(len > 0 && (size_t) len < sizeof(tmp));
+    return sc_strbuf_append(buf, tmp, len);
+}
+
+static bool
+sc_stats_format_prometheus(struct sc_strbuf *buf, const int64_t *values,
+                           uint64_t video_bitrate, uint64_t audio_bitrate) {
+    for (unsigned i = 0; i < SC_STAT_COUNT; ++i) {
+        const struct sc_stat_desc *desc = &stat_descs[i];
+        if (!sc_stats_append_prometheus(buf, desc->name, desc->counter,
+                                        desc->help, values[i])) {
+            return false;
+        }
+    }
+
+    return sc_stats_append_prometheus(buf, "video_bitrate", false,
+                                      "Received video bitrate (bits/s)",
+                                      video_bitrate)
+        && sc_stats_append_prometheus(buf, "audio_bitrate", false,
+                                      "Received audio bitrate (bits/s)",
+                                      audio_bitrate);
+}
+
+static bool
+sc_stats_write_prometheus(struct sc_stats *stats, const char *data,
+                          size_t len) {
+    // Write to a temporary file then rename, so that a scraper never reads a
+    // partial file
+    size_t filename_len = strlen(stats->filename);
+    char *tmp_filename = malloc(filename_len + sizeof(".tmp"));
+    if (!tmp_filename) {
+        LOG_OOM();
+        return false;
+    }
+    memcpy(tmp_filename, stats->filename, filename_len);
+    memcpy(tmp_filename + filename_len, ".tmp", sizeof(".tmp"));
+
+    bool ok = false;
+    FILE *file = fopen(tmp_filename, "w");
+    if (!file) {
+        LOGE("Could not open stats file: %s", tmp_filename);
+        goto end;
+    }
+
+    size_t w = fwrite(data, 1, len, file);
+    fclose(file);
+    if (w != len) {
+        LOGE("Could not write stats file: %s", tmp_filename);
+        goto end;
+    }
+
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows
+    remove(stats->filename);
+#endif
+    if (rename(tmp_filename, stats->filename)) {
+        LOGE("Could not rename stats file to %s", stats->filename);
+        goto end;
+    }
+
+    ok = true;
+
+end:
+    free(tmp_filename);
+    return ok;
+}
+
+static bool
+sc_stats_write(struct sc_stats *stats, sc_tick now) {
+    int64_t cpu_time = sc_stats_get_cpu_time_ms();
+    if (cpu_time >= 0) {
+        sc_stats_set(stats, SC_STAT_CPU_TIME_MS, cpu_time);
+    }
+
+    int64_t values[SC_STAT_COUNT];
+    for (unsigned i = 0; i < SC_STAT_COUNT; ++i) {
+        values[i] = sc_stats_get(stats, i);
+    }
+
+    uint64_t video_bitrate = 0;
+    uint64_t audio_bitrate = 0;
+    sc_tick elapsed = now - stats->last_date;
+    if (elapsed > 0) {
+        int64_t video_bytes = values[SC_STAT_VIDEO_BYTES];
+        int64_t audio_bytes = values[SC_STAT_AUDIO_BYTES];
+        video_bitrate = (video_bytes - stats->last_video_bytes) * 8
+                      * SC_TICK_FREQ / elapsed;
+        audio_bitrate = (audio_bytes - stats->last_audio_bytes) * 8
+                      * SC_TICK_FREQ / elapsed;
+        stats->last_video_bytes = video_bytes;
+        stats->last_audio_bytes = audio_bytes;
+        stats->last_date = now;
+    }
+
+    struct sc_strbuf buf;
+    if (!sc_strbuf_init(&buf, 1024)) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok;
+    if (stats->format == SC_STATS_FORMAT_JSON) {
+        ok = sc_stats_format_json(stats, &buf, values, now, video_bitrate,
+                                  audio_bitrate);
+        if (ok) {
+            ok = fwrite(buf.s, 1, buf.len, stats->file) == buf.len
+              && !fflush(stats->file);
+            if (!ok) {
+                LOGE("Could not write stats file: %s", stats->filename);
+            }
+        } else {
+            LOG_OOM();
+        }
+    } else {
+        assert(stats->format == SC_STATS_FORMAT_PROMETHEUS);
+        ok = sc_stats_format_prometheus(&buf, values, video_bitrate,
+                                        audio_bitrate);
+        if (ok) {
+            ok = sc_stats_write_prometheus(stats, buf.s, buf.len);
+        } else {
+            LOG_OOM();
+        }
+    }
+
+    free(buf.s);
+    return ok;
+}
+
+static void
+sc_stats_log_memory(struct sc_stats *stats) {
+    static const enum sc_stat mem_stats[] = {
+        SC_STAT_MEM_PACKET_POOL_BYTES,
+        SC_STAT_MEM_PACKET_MERGER_BYTES,
+        SC_STAT_RECORDER_QUEUE_BYTES,
+        SC_STAT_RESTREAM_QUEUE_BYTES,
+        SC_STAT_MEM_RESTREAM_GOP_BYTES,
+        SC_STAT_MEM_DELAY_BUFFER_BYTES,
+        SC_STAT_MEM_FRAME_BUFFER_BYTES,
+        SC_STAT_MEM_SWR_BYTES,
+    };
+
+    int64_t total = 0;
+    LOGI("Memory held by the pipeline:");
+    for (unsigned i = 0; i < ARRAY_LEN(mem_stats); ++i) {
+        const char *name = stat_descs[mem_stats[i]].name;
+        int64_t value = sc_stats_get(stats, mem_stats[i]);
+        LOGI("    %-24s %10" PRId64 " bytes", name, value);
+        total += value;
+    }
+    LOGI("    %-24s %10" PRId64 " bytes", "total", total);
+}
+
+static int
+run_stats(void *data) {
+    struct sc_stats *stats = data;
+
+    sc_tick next = stats->start + SC_STATS_INTERVAL;
+
+    sc_mutex_lock(&stats->mutex);
+    for (;;) {
+        while (!stats->stopped
+                && sc_cond_timedwait(&stats->cond, &stats->mutex, next)) {
+            // spurious wake-up or signaled
+        }
+
+        bool stopped = stats->stopped;
+        sc_mutex_unlock(&stats->mutex);
+
+        sc_tick now = sc_tick_now();
+        // Do not stop on error, stats are not critical
+        sc_stats_write(stats, now);
+
+#ifndef _WIN32
+        if (sc_stats_memory_dump_requested) {
+            sc_stats_memory_dump_requested = 0;
+            sc_stats_log_memory(stats);
+        }
+#endif
+
+        if (stopped) {
+            break;
+        }
+
+        // add a multiple of the interval
+        while (next <= now) {
+            next += SC_STATS_INTERVAL;
+        }
+
+        sc_mutex_lock(&stats->mutex);
+    }
+
+    return 0;
+}
+
+bool
+sc_stats_start(struct sc_stats *stats) {
+    stats->start = sc_tick_now();
+    stats->last_date = stats->start;
+    stats->last_video_bytes = 0;
+    stats->last_audio_bytes = 0;
+
+#ifndef _WIN32
+    // Dump the memory accounting on SIGUSR1 (on the next tick of the stats
+    // thread, not from the signal handler)
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sc_stats_on_sigusr1;
+    sigemptyset(&sa.sa_mask);
+    // Do not interrupt the blocking calls of the other threads
+    sa.sa_flags = SA_RESTART;
+    if (sigaction(SIGUSR1, &sa, NULL)) {
+        LOGW("Could not install the SIGUSR1 handler");
+    }
+#endif
+
+    bool ok = sc_thread_create(&stats->thread, run_stats, "scrcpy-stats",
+                               stats);
+    if (!ok) {
+        LOGE("Could not start stats thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_stats_stop(struct sc_stats *stats) {
+    sc_mutex_lock(&stats->mutex);
+    stats->stopped = true;
+    sc_cond_signal(&stats->cond);
+    sc_mutex_unlock(&stats->mutex);
+}
+
+void
+sc_stats_join(struct sc_stats *stats) {
+    sc_thread_join(&stats->thread, NULL);
+}
@@ -0,0 +1,148 @@
+#ifndef SC_STATS_H
+#define SC_STATS_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "options.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+enum sc_stat {
+    // counters
+    SC_STAT_VIDEO_PACKETS,
+    SC_STAT_VIDEO_BYTES,
+    SC_STAT_AUDIO_PACKETS,
+    SC_STAT_AUDIO_BYTES,
+    SC_STAT_VIDEO_CONFIG_PACKETS,
+    SC_STAT_AUDIO_CONFIG_PACKETS,
+    SC_STAT_VIDEO_KEYFRAMES,
+    SC_STAT_VIDEO_KEYFRAME_BYTES,
+    SC_STAT_VIDEO_RECONNECTIONS,
+    SC_STAT_FRAMES_RENDERED,
+    SC_STAT_FRAMES_SKIPPED,
+    SC_STAT_VIDEO_PACKETS_DECODED,
+    SC_STAT_VIDEO_DECODE_TIME_US,
+    SC_STAT_DECODE_ERRORS,
+    SC_STAT_VIDEO_PACKETS_DROPPED,
+    SC_STAT_AUDIO_UNDERFLOW_SAMPLES,
+    SC_STAT_AUDIO_DROPPED_SAMPLES,
+    SC_STAT_CONTROL_MSGS_COALESCED,
+    SC_STAT_CONTROL_COMPRESSION_SAVED_BYTES,
+    SC_STAT_RESTREAM_DROPPED_PACKETS,
+    SC_STAT_CPU_TIME_MS, // sampled by the stats thread
+    // gauges
+    SC_STAT_VIDEO_KEYFRAME_LAST_BYTES,
+    SC_STAT_VIDEO_KEYFRAME_MAX_BYTES,
+    SC_STAT_VIDEO_ENCODED_BITRATE,
+    SC_STAT_AUDIO_ENCODED_BITRATE,
+    SC_STAT_VIDEO_JITTER_US,
+    SC_STAT_AUDIO_JITTER_US,
+    SC_STAT_AUDIO_BUFFERING_SAMPLES,
+    SC_STAT_AUDIO_TARGET_BUFFERING_SAMPLES,
+    SC_STAT_AUDIO_COMPENSATION,
+    SC_STAT_RECORDER_VIDEO_QUEUE,
+    SC_STAT_RECORDER_AUDIO_QUEUE,
+    SC_STAT_RECORDER_QUEUE_BYTES,
+    SC_STAT_RECORDER_SPILLED_PACKETS,
+    SC_STAT_CONTROLLER_QUEUE,
+    SC_STAT_DISPLAY_BUFFER_QUEUE,
+    SC_STAT_V4L2_BUFFER_QUEUE,
+    SC_STAT_AUDIO_LATENCY_MS,
+    SC_STAT_AV_OFFSET_MS,
+    // memory held by the pipeline, in bytes (updated by deltas, so that the
+    // instances of a component add up)
+    SC_STAT_MEM_PACKET_POOL_BYTES,
+    SC_STAT_MEM_PACKET_MERGER_BYTES,
+    SC_STAT_MEM_DELAY_BUFFER_BYTES,
+    SC_STAT_MEM_FRAME_BUFFER_BYTES,
+    SC_STAT_MEM_SWR_BYTES,
+    SC_STAT_RESTREAM_QUEUE_BYTES,
+    SC_STAT_MEM_RESTREAM_GOP_BYTES,
+    SC_STAT_RESTREAM_VIEWERS,
+    SC_STAT_INJECTION_LATENCY_P50_US, // reported by the device
+    SC_STAT_INJECTION_LATENCY_P99_US, // reported by the device
+    SC_STAT_ENCODE_LATENCY_P50_US, // reported by the device
+    SC_STAT_ENCODE_LATENCY_P99_US, // reported by the device
+    SC_STAT_WRITE_BLOCK_P50_US, // reported by the device
+    SC_STAT_WRITE_BLOCK_P99_US, // reported by the device
+    SC_STAT_CLOCK_SYNC_ERROR_US,
+    SC_STAT_DEVICE_THERMAL_STATUS, // reported by the device
+    SC_STAT_THERMAL_LEVEL, // reported by the device
+
+    SC_STAT_COUNT,
+};
+
+/**
+ * Collect the metrics of all the pipeline stages, and periodically write them
+ * to a file.
+ *
+ * The components update the values via lock-free atomic operations (the
+ * stats pointer may be NULL if stats are disabled). A separate thread samples
+ * and writes them.
+ */
+struct sc_stats {
+    atomic_int_least64_t values[SC_STAT_COUNT];
+
+    const char *filename;
+    enum sc_stats_format format;
+    FILE *file; // only used for SC_STATS_FORMAT_JSON
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    bool stopped;
+
+    // Only used by the stats thread
+    sc_tick start;
+    int64_t last_video_bytes;
+    int64_t last_audio_bytes;
+    sc_tick last_date;
+};
+
+// The filename must outlive the stats
+//
+// If the filename is NULL, the values are only kept in memory (to be read by
+// sc_stats_get()), and the stats thread must not be started.
+bool
+sc_stats_init(struct sc_stats *stats, const char *filename,
+              enum sc_stats_format format);
+
+void
+sc_stats_destroy(struct sc_stats *stats);
+
+bool
+sc_stats_start(struct sc_stats *stats);
+
+void
+sc_stats_stop(struct sc_stats *stats);
+
+void
+sc_stats_join(struct sc_stats *stats);
+
+static inline void
+sc_stats_add(struct sc_stats *stats, enum sc_stat stat, int64_t value) {
+    if (stats) {
+        atomic_fetch_add_explicit(&stats->values[stat], value,
+                                  memory_order_relaxed);
+    }
+}
+
+static inline int64_t
+sc_stats_get(struct sc_stats *stats, enum sc_stat stat) {
+    return atomic_load_explicit(&stats->values[stat], memory_order_relaxed);
+}
+
+static inline void
+sc_stats_set(struct sc_stats *stats, enum sc_stat stat, int64_t value) {
+    if (stats) {
+        atomic_store_explicit(&stats->values[stat], value,
+                              memory_order_relaxed);
+    }
+}
+
+#endif
@@ -0,0 +1,231 @@
+#include "stream_dump.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/binary.h"
+#include "util/file.h"
+#include "util/log.h"
+
+#define SC_STREAM_DUMP_MAGIC "scrcpyst"
+#define SC_STREAM_DUMP_MAGIC_LENGTH (sizeof(SC_STREAM_DUMP_MAGIC) - 1)
+#define SC_STREAM_DUMP_VERSION 1
+#define SC_STREAM_DUMP_HEADER_LENGTH (SC_STREAM_DUMP_MAGIC_LENGTH + 1)
+// time: 8 bytes; length: 4 bytes
+#define SC_STREAM_DUMP_ENTRY_HEADER_LENGTH 12
+
+static char *
+get_stream_path(const char *dir, const char *name) {
+    // separator + ".stream" + '\0'
+    size_t len = strlen(dir) + strlen(name) + 9;
+    char *path = malloc(len);
+    if (!path) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    snprintf(path, len, "%s%c%s.stream", dir, SC_PATH_SEPARATOR, name);
+    return path;
+}
+
+static FILE *
+open_stream_file(const char *dir, const char *name, const char *mode) {
+    char *path = get_stream_path(dir, name);
+    if (!path) {
+        return NULL;
+    }
+
+    FILE *file = fopen(path, mode);
+    if (!file) {
+        LOGE("Could not open stream dump file: %s", path);
+    }
+
+    free(path);
+    return file;
+}
+
+bool
+sc_stream_dumper_init(struct sc_stream_dumper *dumper, const char *dir,
+                      const char *name) {
+    dumper->file = open_stream_file(dir, name, "wb");
+    if (!dumper->file) {
+        return false;
+    }
+
+    uint8_t header[SC_STREAM_DUMP_HEADER_LENGTH];
+    memcpy(header, SC_STREAM_DUMP_MAGIC, SC_STREAM_DUMP_MAGIC_LENGTH);
+    header[SC_STREAM_DUMP_MAGIC_LENGTH] = SC_STREAM_DUMP_VERSION;
+    if (fwrite(header, sizeof(header), 1, dumper->file) != 1) {
+        LOGE("Could not write stream dump header");
+        fclose(dumper->file);
+        return false;
+    }
+
+    dumper->start = sc_tick_now();
+    dumper->failed = false;
+
+    LOGI("Dumping stream '%s' to %s", name, dir);
+
+    return true;
+}
+
+void
+sc_stream_dumper_destroy(struct sc_stream_dumper *dumper) {
+    if (fclose(dumper->file)) {
+        LOGE("Could not close stream dump file");
+    }
+}
+
+void
+sc_stream_dumper_write(struct sc_stream_dumper *dumper, const void *data,
+                       size_t len) {
+    if (dumper->failed) {
+        return;
+    }
+
+    assert(len <= UINT32_MAX);
+
+    uint8_t header[SC_STREAM_DUMP_ENTRY_HEADER_LENGTH];
+    sc_tick time = sc_tick_now() - dumper->start;
+    sc_write64be(header, SC_TICK_TO_US(time));
+    sc_write32be(&header[8], len);
+
+    // The file is buffered, this does not block on every packet
+    if (fwrite(header, sizeof(header), 1, dumper->file) != 1
+            || fwrite(data, len, 1, dumper->file) != 1) {
+        LOGE("Could not write stream dump, dump stopped");
+        dumper->failed = true;
+    }
+}
+
+bool
+sc_stream_replayer_init(struct sc_stream_replayer *replayer, const char *dir,
+                        const char *name, bool max_speed) {
+    replayer->file = open_stream_file(dir, name, "rb");
+    if (!replayer->file) {
+        return false;
+    }
+
+    uint8_t header[SC_STREAM_DUMP_HEADER_LENGTH];
+    if (fread(header, sizeof(header), 1, replayer->file) != 1
+            || memcmp(header, SC_STREAM_DUMP_MAGIC,
+                      SC_STREAM_DUMP_MAGIC_LENGTH)) {
+        LOGE("Not a stream dump file: '%s' in %s", name, dir);
+        goto error_close_file;
+    }
+
+    if (header[SC_STREAM_DUMP_MAGIC_LENGTH] != SC_STREAM_DUMP_VERSION) {
+        LOGE("Unsupported stream dump version: %u",
+             (unsigned) header[SC_STREAM_DUMP_MAGIC_LENGTH]);
+        goto error_close_file;
+    }
+
+    bool ok = sc_mutex_init(&replayer->mutex);
+    if (!ok) {
+        goto error_close_file;
+    }
+
+    ok = sc_cond_init(&replayer->cond);
+    if (!ok) {
+        sc_mutex_destroy(&replayer->mutex);
+        goto error_close_file;
+    }
+
+    replayer->max_speed = max_speed;
+    replayer->remaining = 0;
+    replayer->stopped = false;
+    // All the streams are replayed relative to the same origin (they are
+    // initialized together)
+    replayer->start = sc_tick_now();
+
+    return true;
+
+error_close_file:
+    fclose(replayer->file);
+
+    return false;
+}
+
+void
+sc_stream_replayer_destroy(struct sc_stream_replayer *replayer) {
+    sc_cond_destroy(&replayer->cond);
+    sc_mutex_destroy(&replayer->mutex);
+    fclose(replayer->file);
+}
+
+// Wait until the deadline, return false if the replayer is stopped
+static bool
+wait_until(struct sc_stream_replayer *replayer, sc_tick deadline) {
+    sc_mutex_lock(&replayer->mutex);
+    bool timed_out = replayer->max_speed;
+    while (!replayer->stopped && !timed_out) {
+        timed_out = !sc_cond_timedwait(&replayer->cond, &replayer->mutex,
+                                       deadline);
+    }
+    bool stopped = replayer->stopped;
+    sc_mutex_unlock(&replayer->mutex);
+
+    return !stopped;
+}
+
+// Read the next entry header and wait for its time, return false on end of
+// file, error or stop
+static bool
+next_entry(struct sc_stream_replayer *replayer) {
+    uint8_t header[SC_STREAM_DUMP_ENTRY_HEADER_LENGTH];
+    size_t r = fread(header, 1, sizeof(header), replayer->file);
+    if (r != sizeof(header)) {
+        if (r || ferror(replayer->file)) {
+            LOGE("Stream dump file truncated");
+        }
+        return false;
+    }
+
+    sc_tick time = SC_TICK_FROM_US((sc_tick) sc_read64be(header));
+    replayer->remaining = sc_read32be(&header[8]);
+
+    return wait_until(replayer, replayer->start + time);
+}
+
+ssize_t
+sc_stream_replayer_read_all(struct sc_stream_replayer *replayer, void *buf,
+                            size_t len) {
+    uint8_t *data = buf;
+    size_t done = 0;
+    while (done < len) {
+        if (!replayer->remaining) {
+            if (!next_entry(replayer)) {
+                sc_mutex_lock(&replayer->mutex);
+                bool stopped = replayer->stopped;
+                sc_mutex_unlock(&replayer->mutex);
+                return stopped ? -1 : (ssize_t) done;
+            }
+            continue;
+        }
+
+        size_t chunk = len - done;
+        if (chunk > replayer->remaining) {
+            chunk = replayer->remaining;
+        }
+
+        if (fread(data + done, 1, chunk, replayer->file) != chunk) {
+            LOGE("Stream dump file truncated");
+            return done;
+        }
+
+        done += chunk;
+        replayer->remaining -= chunk;
+    }
+
+    return done;
+}
+
+void
+sc_stream_replayer_stop(struct sc_stream_replayer *replayer) {
+    sc_mutex_lock(&replayer->mutex);
+    replayer->stopped = true;
+    sc_cond_signal(&replayer->cond);
+    sc_mutex_unlock(&replayer->mutex);
+}
@@ -0,0 +1,90 @@
+#ifndef SC_STREAM_DUMP_H
+#define SC_STREAM_DUMP_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "util/thread.h"
+#include "util/tick.h"
+
+/**
+ * Dump the raw bytes received on a stream socket (video or audio) to a file,
+ * with their arrival time, to replay them later without a device (e.g. to
+ * benchmark the decoding, the rendering or the recording).
+ *
+ * The file "<dir>/<name>.stream" starts with a header (8-byte magic + 1-byte
+ * version), followed by one entry per read:
+ *  - the time since the start of the dump, in microseconds (8 bytes);
+ *  - the length of the data (4 bytes);
+ *  - the data, exactly as received (codec id, video size, packet headers and
+ *    payloads).
+ */
+struct sc_stream_dumper {
+    FILE *file;
+    sc_tick start;
+    bool failed;
+};
+
+bool
+sc_stream_dumper_init(struct sc_stream_dumper *dumper, const char *dir,
+                      const char *name);
+
+void
+sc_stream_dumper_destroy(struct sc_stream_dumper *dumper);
+
+/**
+ * Append data received from the socket
+ *
+ * It must not be called concurrently (it is called from the demuxer thread).
+ */
+void
+sc_stream_dumper_write(struct sc_stream_dumper *dumper, const void *data,
+                       size_t len);
+
+/**
+ * Read a stream dumped by a sc_stream_dumper, in place of the socket
+ *
+ * The data are delivered at the time they were received (or as fast as
+ * possible if max_speed is set).
+ */
+struct sc_stream_replayer {
+    FILE *file;
+    bool max_speed;
+    sc_tick start;
+
+    // Number of bytes of the current entry not read yet
+    uint32_t remaining;
+
+    sc_mutex mutex;
+    sc_cond cond;
+    bool stopped;
+};
+
+bool
+sc_stream_replayer_init(struct sc_stream_replayer *replayer, const char *dir,
+                        const char *name, bool max_speed);
+
+void
+sc_stream_replayer_destroy(struct sc_stream_replayer *replayer);
+
+/**
+ * Wait until len bytes have been read, like net_recv_all()
+ *
+ * Return the number of bytes read (less than len on end of stream), or -1 on
+ * error or if the replayer is stopped.
+ */
+ssize_t
+sc_stream_replayer_read_all(struct sc_stream_replayer *replayer, void *buf,
+                            size_t len);
+
+/**
+ * Interrupt any pending read (like shutting down a socket)
+ */
+void
+sc_stream_replayer_stop(struct sc_stream_replayer *replayer);
+
+#endif
@@ -0,0 +1,545 @@
+#include "thumbnailer.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "screenshot.h"
+#include "util/file.h"
+#include "util/log.h"
+
+/** Downcast packet_sink to sc_thumbnailer */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_thumbnailer, packet_sink)
+
+static const char *
+get_basename(const char *path) {
+    const char *name = path;
+    for (const char *p = path; *p; ++p) {
+        if (*p == '/' || *p == SC_PATH_SEPARATOR) {
+            name = p + 1;
+        }
+    }
+    return name;
+}
+
+// "file.vtt" with index 1 gives "file-0001.png"
+static char *
+sc_thumbnailer_get_sheet_path(struct sc_thumbnailer *tn, unsigned index) {
+    const char *filename = tn->filename;
+    const char *basename = get_basename(filename);
+    const char *dot = strrchr(basename, '.');
+    size_t len = dot ? (size_t) (dot - filename) : strlen(filename);
+
+    // "-NNNN.png" (the index may use more digits)
+    size_t size = len + 16;
+    char *path = malloc(size);
+    if (!path) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    int r = snprintf(path, size, "%.*s-%04u.png", (int) len, filename, index);
+    assert(r >= 0 && (size_t) r < size);
+    (void) r;
+
+    return path;
+}
+
+static bool
+sc_thumbnailer_write_cue(struct sc_thumbnailer *tn, int64_t end_pts) {
+    assert(tn->cue_pts != AV_NOPTS_VALUE);
+
+    char *sheet_path =
+        sc_thumbnailer_get_sheet_path(tn, tn->cue_sheet_index);
+    if (!sheet_path) {
+        return false;
+    }
+
+    unsigned x = (tn->cue_position % SC_THUMBNAILER_COLUMNS) * tn->width;
+    unsigned y = (tn->cue_position / SC_THUMBNAILER_COLUMNS) * tn->height;
+
+    // The times are in milliseconds
+    int64_t start = tn->cue_pts / 1000;
+    int64_t end = MAX(end_pts / 1000, start + 1);
+
+    int r = fprintf(tn->file,
+                    "%02" PRId64 ":%02d:%02d.%03d --> "
+                    "%02" PRId64 ":%02d:%02d.%03d\n"
+                    "%s#xywh=%u,%u,%u,%u\n\n",
+                    start / 3600000, (int) (start / 60000 % 60),
+                    (int) (start / 1000 % 60), (int) (start % 1000),
+                    end / 3600000, (int) (end / 60000 % 60),
+                    (int) (end / 1000 % 60), (int) (end % 1000),
+                    get_basename(sheet_path), x, y, tn->width, tn->height);
+    free(sheet_path);
+
+    if (r < 0 || fflush(tn->file)) {
+        LOGE("Thumbnailer: could not write %s", tn->filename);
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+sc_thumbnailer_write_sheet(struct sc_thumbnailer *tn) {
+    char *sheet_path = sc_thumbnailer_get_sheet_path(tn, tn->sheet_index);
+    if (!sheet_path) {
+        return false;
+    }
+
+    // Only write the rows used so far
+    AVFrame *view = av_frame_clone(tn->sheet);
+    if (!view) {
+        LOG_OOM();
+        free(sheet_path);
+        return false;
+    }
+    unsigned rows = (tn->thumbnail_count + SC_THUMBNAILER_COLUMNS - 1)
+                  / SC_THUMBNAILER_COLUMNS;
+    view->height = rows * tn->height;
+
+    bool ok = sc_screenshot_write_png(view, sheet_path);
+    av_frame_free(&view);
+    free(sheet_path);
+    return ok;
+}
+
+static bool
+sc_thumbnailer_new_sheet(struct sc_thumbnailer *tn) {
+    av_frame_unref(tn->sheet);
+    tn->sheet->format = AV_PIX_FMT_RGB24;
+    tn->sheet->width = SC_THUMBNAILER_COLUMNS * tn->width;
+    tn->sheet->height = SC_THUMBNAILER_ROWS * tn->height;
+    if (av_frame_get_buffer(tn->sheet, 0)) {
+        LOG_OOM();
+        return false;
+    }
+
+    // Black borders around the thumbnails which do not fill their area
+    for (int row = 0; row < tn->sheet->height; ++row) {
+        memset(tn->sheet->data[0] + row * tn->sheet->linesize[0], 0,
+               3 * tn->sheet->width);
+    }
+
+    tn->thumbnail_count = 0;
+    return true;
+}
+
+// Fit a w x h frame into the thumbnail area, preserving the aspect ratio
+static void
+sc_thumbnailer_fit(struct sc_thumbnailer *tn, unsigned w, unsigned h,
+                   unsigned *out_w, unsigned *out_h) {
+    unsigned fw;
+    unsigned fh;
+    if ((uint64_t) w * tn->height > (uint64_t) h * tn->width) {
+        fw = tn->width;
+        fh = MAX((uint64_t) tn->width * h / w, 1);
+    } else {
+        fh = tn->height;
+        fw = MAX((uint64_t) tn->height * w / h, 1);
+    }
+
+    // Never upscale
+    *out_w = MIN(fw, w);
+    *out_h = MIN(fh, h);
+}
+
+static bool
+sc_thumbnailer_add(struct sc_thumbnailer *tn, const AVFrame *frame,
+                   int64_t pts) {
+    struct sc_screenshot_yuv yuv;
+    if (!sc_screenshot_get_yuv(frame, &yuv)) {
+        if (!tn->format_warned) {
+            LOGW("Thumbnailer: unsupported frame format %d, frames ignored",
+                 frame->format);
+            tn->format_warned = true;
+        }
+        return true;
+    }
+
+    if (!tn->width) {
+        // The thumbnail size is defined by the first frame
+        if (frame->width >= frame->height) {
+            tn->width = SC_THUMBNAILER_SIZE;
+            tn->height = MAX(SC_THUMBNAILER_SIZE * frame->height
+                                 / frame->width, 1);
+        } else {
+            tn->height = SC_THUMBNAILER_SIZE;
+            tn->width = MAX(SC_THUMBNAILER_SIZE * frame->width
+                                / frame->height, 1);
+        }
+
+        if (!sc_thumbnailer_new_sheet(tn)) {
+            return false;
+        }
+    }
+
+    if (tn->cue_pts != AV_NOPTS_VALUE) {
+        // The previous cue ends where this one starts
+        if (!sc_thumbnailer_write_cue(tn, pts)) {
+            return false;
+        }
+    }
+
+    if (tn->thumbnail_count == SC_THUMBNAILER_COLUMNS * SC_THUMBNAILER_ROWS) {
+        ++tn->sheet_index;
+        if (!sc_thumbnailer_new_sheet(tn)) {
+            return false;
+        }
+    }
+
+    unsigned position = tn->thumbnail_count;
+    unsigned w;
+    unsigned h;
+    sc_thumbnailer_fit(tn, frame->width, frame->height, &w, &h);
+    unsigned x = (position % SC_THUMBNAILER_COLUMNS) * tn->width
+               + (tn->width - w) / 2;
+    unsigned y = (position / SC_THUMBNAILER_COLUMNS) * tn->height
+               + (tn->height - h) / 2;
+
+    AVFrame *sheet = tn->sheet;
+    uint8_t *dst = sheet->data[0] + y * sheet->linesize[0] + x * 3;
+    sc_screenshot_yuv_to_rgb24_scaled(&yuv, w, h, dst, sheet->linesize[0]);
+    ++tn->thumbnail_count;
+
+    tn->cue_pts = pts;
+    tn->cue_sheet_index = tn->sheet_index;
+    tn->cue_position = position;
+
+    // Rewrite the current sheet, so that it is always up to date
+    return sc_thumbnailer_write_sheet(tn);
+}
+
+static bool
+sc_thumbnailer_open_decoder(struct sc_thumbnailer *tn, const AVCodec *codec) {
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    // Only keyframes are pushed, but let the decoder skip anything else anyway
+    ctx->skip_frame = AVDISCARD_NONKEY;
+    ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    // A keyframe every few seconds does not need more
+    ctx->thread_count = 1;
+
+    if (avcodec_open2(ctx, codec, NULL) < 0) {
+        LOGE("Thumbnailer: could not open codec");
+        avcodec_free_context(&ctx);
+        return false;
+    }
+
+    tn->ctx = ctx;
+    return true;
+}
+
+static bool
+sc_thumbnailer_process(struct sc_thumbnailer *tn, const AVPacket *packet,
+                       int64_t pts_origin) {
+    // The packet may carry the config as side data
+    int ret = avcodec_send_packet(tn->ctx, packet);
+    if (ret < 0 && ret != AVERROR(EAGAIN)) {
+        LOGW("Thumbnailer: could not decode keyframe: %d", ret);
+        return true;
+    }
+
+    for (;;) {
+        ret = avcodec_receive_frame(tn->ctx, tn->frame);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return true;
+        }
+        if (ret < 0) {
+            LOGW("Thumbnailer: could not receive frame: %d", ret);
+            return true;
+        }
+
+        int64_t pts = tn->frame->pts - pts_origin;
+        bool ok = true;
+        if (tn->cue_pts == AV_NOPTS_VALUE
+                || pts - tn->cue_pts >= SC_THUMBNAILER_MIN_INTERVAL) {
+            ok = sc_thumbnailer_add(tn, tn->frame, pts);
+        }
+        av_frame_unref(tn->frame);
+        if (!ok) {
+            return false;
+        }
+    }
+}
+
+static bool
+sc_thumbnailer_run(struct sc_thumbnailer *tn) {
+    for (;;) {
+        sc_mutex_lock(&tn->mutex);
+        while (!tn->stopped && sc_vecdeque_is_empty(&tn->queue)) {
+            sc_cond_wait(&tn->cond, &tn->mutex);
+        }
+
+        if (sc_vecdeque_is_empty(&tn->queue)) {
+            // Stopped, and all the keyframes have been processed
+            assert(tn->stopped);
+            int64_t pts_origin = tn->pts_origin;
+            int64_t last_pts = tn->last_pts;
+            sc_mutex_unlock(&tn->mutex);
+
+            if (tn->cue_pts != AV_NOPTS_VALUE) {
+                // The last cue ends with the recording
+                return sc_thumbnailer_write_cue(tn, last_pts - pts_origin);
+            }
+            return true;
+        }
+
+        AVPacket *packet = sc_vecdeque_pop(&tn->queue);
+        const AVCodec *codec = tn->codec;
+        int64_t pts_origin = tn->pts_origin;
+        sc_mutex_unlock(&tn->mutex);
+
+        bool ok = tn->ctx || sc_thumbnailer_open_decoder(tn, codec);
+        if (ok) {
+            ok = sc_thumbnailer_process(tn, packet, pts_origin);
+        }
+        av_packet_free(&packet);
+        if (!ok) {
+            return false;
+        }
+    }
+}
+
+static void
+sc_thumbnailer_queue_clear(struct sc_thumbnailer_queue *queue) {
+    while (!sc_vecdeque_is_empty(queue)) {
+        AVPacket *p = sc_vecdeque_pop(queue);
+        av_packet_free(&p);
+    }
+}
+
+static int
+run_thumbnailer(void *data) {
+    struct sc_thumbnailer *tn = data;
+
+    // Thumbnails are a background task
+    bool ok = sc_thread_set_priority(SC_THREAD_PRIORITY_LOW);
+    (void) ok; // We don't care if it worked
+
+    bool success = sc_thumbnailer_run(tn);
+
+    sc_mutex_lock(&tn->mutex);
+    // Prevent the producer to push any new packet
+    tn->stopped = true;
+    sc_thumbnailer_queue_clear(&tn->queue);
+    sc_mutex_unlock(&tn->mutex);
+
+    if (success) {
+        LOGI("Thumbnails complete: %s", tn->filename);
+    } else {
+        LOGE("Thumbnails failed: %s", tn->filename);
+    }
+
+    LOGD("Thumbnailer thread ended");
+
+    return 0;
+}
+
+static bool
+sc_thumbnailer_packet_sink_open(struct sc_packet_sink *sink,
+                                AVCodecContext *ctx) {
+    struct sc_thumbnailer *tn = DOWNCAST(sink);
+    assert(ctx->codec);
+
+    sc_mutex_lock(&tn->mutex);
+    tn->codec = ctx->codec;
+    sc_mutex_unlock(&tn->mutex);
+
+    return true;
+}
+
+static void
+sc_thumbnailer_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_thumbnailer *tn = DOWNCAST(sink);
+
+    sc_mutex_lock(&tn->mutex);
+    tn->stopped = true;
+    sc_cond_signal(&tn->cond);
+    sc_mutex_unlock(&tn->mutex);
+}
+
+static bool
+sc_thumbnailer_packet_sink_push(struct sc_packet_sink *sink,
+                                const AVPacket *packet) {
+    struct sc_thumbnailer *tn = DOWNCAST(sink);
+
+    if (packet->pts == AV_NOPTS_VALUE) {
+        // A config packet, also attached to the next media packet
+        return true;
+    }
+
+    sc_mutex_lock(&tn->mutex);
+
+    if (tn->stopped) {
+        // The thumbnails are optional, never stop the stream
+        sc_mutex_unlock(&tn->mutex);
+        return true;
+    }
+
+    if (tn->pts_origin == AV_NOPTS_VALUE) {
+        tn->pts_origin = packet->pts;
+    }
+    tn->last_pts = packet->pts;
+
+    if (!(packet->flags & AV_PKT_FLAG_KEY)) {
+        // Never decoded
+        sc_mutex_unlock(&tn->mutex);
+        return true;
+    }
+
+    if (sc_vecdeque_size(&tn->queue) >= SC_THUMBNAILER_QUEUE_MAX) {
+        sc_mutex_unlock(&tn->mutex);
+        LOGW("Thumbnailer: too many pending keyframes, keyframe dropped");
+        return true;
+    }
+
+    AVPacket *copy = av_packet_alloc();
+    if (!copy || av_packet_ref(copy, packet)) {
+        sc_mutex_unlock(&tn->mutex);
+        LOG_OOM();
+        av_packet_free(&copy);
+        return true;
+    }
+
+    bool ok = sc_vecdeque_push(&tn->queue, copy);
+    if (!ok) {
+        sc_mutex_unlock(&tn->mutex);
+        LOG_OOM();
+        av_packet_free(&copy);
+        return true;
+    }
+
+    sc_cond_signal(&tn->cond);
+    sc_mutex_unlock(&tn->mutex);
+
+    return true;
+}
+
+bool
+sc_thumbnailer_init(struct sc_thumbnailer *tn, const char *filename) {
+    tn->filename = strdup(filename);
+    if (!tn->filename) {
+        LOG_OOM();
+        return false;
+    }
+
+    tn->frame = av_frame_alloc();
+    if (!tn->frame) {
+        LOG_OOM();
+        goto error_free_filename;
+    }
+
+    tn->sheet = av_frame_alloc();
+    if (!tn->sheet) {
+        LOG_OOM();
+        goto error_free_frame;
+    }
+
+    bool ok = sc_mutex_init(&tn->mutex);
+    if (!ok) {
+        goto error_free_sheet;
+    }
+
+    ok = sc_cond_init(&tn->cond);
+    if (!ok) {
+        goto error_mutex_destroy;
+    }
+
+    tn->file = fopen(filename, "w");
+    if (!tn->file) {
+        LOGE("Could not open thumbnails index file: %s", filename);
+        goto error_cond_destroy;
+    }
+
+    if (fputs("WEBVTT\n\n", tn->file) < 0 || fflush(tn->file)) {
+        LOGE("Could not write thumbnails index file: %s", filename);
+        goto error_close_file;
+    }
+
+    tn->stopped = false;
+    sc_vecdeque_init(&tn->queue);
+    tn->codec = NULL;
+    tn->pts_origin = AV_NOPTS_VALUE;
+    tn->last_pts = AV_NOPTS_VALUE;
+
+    tn->ctx = NULL;
+    tn->sheet_index = 0;
+    tn->thumbnail_count = 0;
+    tn->width = 0;
+    tn->height = 0;
+    tn->cue_pts = AV_NOPTS_VALUE;
+    tn->cue_sheet_index = 0;
+    tn->cue_position = 0;
+    tn->format_warned = false;
+
+    static const struct sc_packet_sink_ops ops = {
+        .open = sc_thumbnailer_packet_sink_open,
+        .close = sc_thumbnailer_packet_sink_close,
+        .push = sc_thumbnailer_packet_sink_push,
+    };
+
+    tn->packet_sink.ops = &ops;
+
+    return true;
+
+error_close_file:
+    fclose(tn->file);
+error_cond_destroy:
+    sc_cond_destroy(&tn->cond);
+error_mutex_destroy:
+    sc_mutex_destroy(&tn->mutex);
+error_free_sheet:
+    av_frame_free(&tn->sheet);
+error_free_frame:
+    av_frame_free(&tn->frame);
+error_free_filename:
+    free(tn->filename);
+
+    return false;
+}
+
+bool
+sc_thumbnailer_start(struct sc_thumbnailer *tn) {
+    LOGD("Starting thumbnailer thread");
+
+    bool ok = sc_thread_create(&tn->thread, run_thumbnailer,
+                               "scrcpy-thumbs", tn);
+    if (!ok) {
+        LOGE("Could not start thumbnailer thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_thumbnailer_stop(struct sc_thumbnailer *tn) {
+    sc_mutex_lock(&tn->mutex);
+    tn->stopped = true;
+    sc_cond_signal(&tn->cond);
+    sc_mutex_unlock(&tn->mutex);
+}
+
+void
+sc_thumbnailer_join(struct sc_thumbnailer *tn) {
+    sc_thread_join(&tn->thread, NULL);
+}
+
+void
+sc_thumbnailer_destroy(struct sc_thumbnailer *tn) {
+    avcodec_free_context(&tn->ctx);
+    fclose(tn->file);
+    sc_vecdeque_destroy(&tn->queue);
+    sc_cond_destroy(&tn->cond);
+    sc_mutex_destroy(&tn->mutex);
+    av_frame_free(&tn->sheet);
+    av_frame_free(&tn->frame);
+    free(tn->filename);
+}
@@ -0,0 +1,92 @@
+#ifndef SC_THUMBNAILER_H
+#define SC_THUMBNAILER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <libavcodec/avcodec.h>
+
+#include "trait/packet_sink.h"
+#include "util/thread.h"
+#include "util/vecdeque.h"
+
+// Size of the largest side of the thumbnails (for the first video frame, the
+// next ones are fitted into the same size)
+#define SC_THUMBNAILER_SIZE 160
+// The thumbnails are packed into sprite sheets of this number of columns and
+// rows
+#define SC_THUMBNAILER_COLUMNS 10
+#define SC_THUMBNAILER_ROWS 10
+// Keyframes closer than this delay (in microseconds) to the previous
+// thumbnail are ignored (for example on keyframe requests)
+#define SC_THUMBNAILER_MIN_INTERVAL INT64_C(2000000)
+// Keyframes waiting to be decoded, beyond which the next ones are dropped
+#define SC_THUMBNAILER_QUEUE_MAX 8
+
+struct sc_thumbnailer_queue SC_VECDEQUE(AVPacket *);
+
+/**
+ * Generate thumbnails of the recorded video, to seek visually in the
+ * recording without decoding it
+ *
+ * Only the video keyframes are decoded, by a separate software decoder (on
+ * its own thread), so that it costs almost nothing whatever the recording
+ * length. The thumbnails are packed into PNG sprite sheets next to the index
+ * file (for example "file.vtt" gives "file-0000.png", "file-0001.png"…).
+ *
+ * The index is a WebVTT file, as supported by most web video players: each
+ * cue maps a time range of the recording (relative to the first keyframe) to
+ * the area of its thumbnail in a sprite sheet ("file-0000.png#xywh=x,y,w,h").
+ *
+ * The current sprite sheet is rewritten and each cue is written as soon as it
+ * is complete, so that the thumbnails may be read during the recording.
+ */
+struct sc_thumbnailer {
+    struct sc_packet_sink packet_sink; // packet sink trait
+
+    char *filename; // of the index
+    FILE *file;
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    // set on sc_thumbnailer_stop() or packet sink close
+    bool stopped;
+    struct sc_thumbnailer_queue queue; // keyframes to decode
+    const AVCodec *codec; // set on packet sink open
+    int64_t pts_origin; // of the first packet received
+    int64_t last_pts; // of the last packet received
+
+    // Only accessed from the thumbnailer thread
+    AVCodecContext *ctx;
+    AVFrame *frame;
+    AVFrame *sheet; // RGB24
+    unsigned sheet_index;
+    unsigned thumbnail_count; // in the current sheet
+    unsigned width; // of each thumbnail, 0 until the first one
+    unsigned height;
+    // The pending cue (written once the next thumbnail is known)
+    int64_t cue_pts; // relative to pts_origin, AV_NOPTS_VALUE if none
+    unsigned cue_sheet_index;
+    unsigned cue_position; // in the sprite sheet
+    bool format_warned;
+};
+
+bool
+sc_thumbnailer_init(struct sc_thumbnailer *tn, const char *filename);
+
+bool
+sc_thumbnailer_start(struct sc_thumbnailer *tn);
+
+void
+sc_thumbnailer_stop(struct sc_thumbnailer *tn);
+
+void
+sc_thumbnailer_join(struct sc_thumbnailer *tn);
+
+void
+sc_thumbnailer_destroy(struct sc_thumbnailer *tn);
+
+#endif
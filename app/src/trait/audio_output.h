@@ -0,0 +1,62 @@
+#ifndef SC_AUDIO_OUTPUT_H
+#define SC_AUDIO_OUTPUT_H
+
+#include "common.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Audio output trait.
+ *
+ * Component able to play audio samples on the computer (an audio API backend)
+ * should implement this trait.
+ *
+ * The samples are always interleaved 32-bit floats. They are pulled by the
+ * implementation, from its own real-time thread, via the fill callback.
+ */
+struct sc_audio_output {
+    const struct sc_audio_output_ops *ops;
+};
+
+/**
+ * Fill the stream with len bytes of samples
+ *
+ * It is called from the audio output thread: it must never block.
+ */
+typedef void sc_audio_output_fill_fn(void *userdata, uint8_t *stream,
+                                     size_t len);
+
+struct sc_audio_output_spec {
+    unsigned sample_rate;
+    unsigned nb_channels;
+    // Requested size of the output buffer, in samples
+    uint16_t buffer_samples;
+};
+
+struct sc_audio_output_ops {
+    /**
+     * Open the audio output
+     *
+     * The fill callback must not be called before start().
+     */
+    bool (*open)(struct sc_audio_output *output,
+                 const struct sc_audio_output_spec *spec,
+                 sc_audio_output_fill_fn *fill, void *userdata);
+
+    /**
+     * Start pulling samples
+     */
+    void (*start)(struct sc_audio_output *output);
+
+    /**
+     * Stop and close the audio output
+     *
+     * The fill callback must not be called once this function returns.
+     */
+    void (*close)(struct sc_audio_output *output);
+};
+
+#endif
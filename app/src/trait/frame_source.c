@@ -1,59 +1,363 @@
 #include "frame_source.h"
 
-void
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "util/log.h"
+#include "util/vecdeque.h"
+
+struct sc_frame_sink_worker {
+    struct sc_frame_sink *sink;
+    // Maximum number of pending frames
+    size_t capacity;
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond queue_cond;
+    struct SC_VECDEQUE(AVFrame *) queue;
+    bool stopped;
+    // Set if the sink failed to consume a frame
+    bool failed;
+    // Number of pending frames dropped because the sink was too slow
+    uint64_t dropped;
+};
+
+static int
+run_frame_sink_worker(void *data) {
+    struct sc_frame_sink_worker *worker = data;
+
+    for (;;) {
+        sc_mutex_lock(&worker->mutex);
+
+        while (!worker->stopped && sc_vecdeque_is_empty(&worker->queue)) {
+            sc_cond_wait(&worker->queue_cond, &worker->mutex);
+        }
+
+        if (sc_vecdeque_is_empty(&worker->queue)) {
+            // Stopped, and all the pending frames have been flushed
+            assert(worker->stopped);
+            sc_mutex_unlock(&worker->mutex);
+            break;
+        }
+
+        AVFrame *frame = sc_vecdeque_pop(&worker->queue);
+        sc_mutex_unlock(&worker->mutex);
+
+        bool ok = worker->sink->ops->push(worker->sink, frame);
+        av_frame_free(&frame);
+        if (!ok) {
+            LOGE("Frame could not be pushed to an asynchronous sink");
+            sc_mutex_lock(&worker->mutex);
+            // Make the next pushes to the source fail
+            worker->failed = true;
+            sc_mutex_unlock(&worker->mutex);
+            break;
+        }
+    }
+
+    LOGD("Frame sink worker thread ended");
+
+    return 0;
+}
+
+static struct sc_frame_sink_worker *
+sc_frame_sink_worker_new(struct sc_frame_sink *sink,
+                         enum sc_frame_dispatch dispatch) {
+    assert(dispatch != SC_FRAME_DISPATCH_SYNC);
+
+    struct sc_frame_sink_worker *worker = malloc(sizeof(*worker));
+    if (!worker) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    worker->sink = sink;
+    worker->capacity = dispatch == SC_FRAME_DISPATCH_LATEST
+                     ? 1 : SC_FRAME_DISPATCH_FIFO_CAPACITY;
+    worker->stopped = false;
+    worker->failed = false;
+    worker->dropped = 0;
+
+    sc_vecdeque_init(&worker->queue);
+    // Reserve the whole capacity, so that pushing never allocates
+    if (!sc_vecdeque_reserve(&worker->queue, worker->capacity)) {
+        LOG_OOM();
+        goto error_free_worker;
+    }
+
+    bool ok = sc_mutex_init(&worker->mutex);
+    if (!ok) {
+        goto error_destroy_queue;
+    }
+
+    ok = sc_cond_init(&worker->queue_cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    ok = sc_thread_create(&worker->thread, run_frame_sink_worker,
+                          "scrcpy-fsink", worker);
+    if (!ok) {
+        LOGE("Could not start frame sink worker thread");
+        goto error_destroy_cond;
+    }
+
+    return worker;
+
+error_destroy_cond:
+    sc_cond_destroy(&worker->queue_cond);
+error_destroy_mutex:
+    sc_mutex_destroy(&worker->mutex);
+error_destroy_queue:
+    sc_vecdeque_destroy(&worker->queue);
+error_free_worker:
+    free(worker);
+
+    return NULL;
+}
+
+static void
+sc_frame_sink_worker_delete(struct sc_frame_sink_worker *worker) {
+    sc_mutex_lock(&worker->mutex);
+    worker->stopped = true;
+    sc_cond_signal(&worker->queue_cond);
+    sc_mutex_unlock(&worker->mutex);
+
+    sc_thread_join(&worker->thread, NULL);
+
+    if (worker->dropped) {
+        LOGD("Frame sink worker: %" PRIu64 " frames dropped", worker->dropped);
+    }
+
+    // Non-empty only if the sink failed
+    while (!sc_vecdeque_is_empty(&worker->queue)) {
+        AVFrame *frame = sc_vecdeque_pop(&worker->queue);
+        av_frame_free(&frame);
+    }
+
+    sc_cond_destroy(&worker->queue_cond);
+    sc_mutex_destroy(&worker->mutex);
+    sc_vecdeque_destroy(&worker->queue);
+    free(worker);
+}
+
+static bool
+sc_frame_sink_worker_push(struct sc_frame_sink_worker *worker,
+                          const AVFrame *frame) {
+    AVFrame *clone = av_frame_clone(frame);
+    if (!clone) {
+        LOG_OOM();
+        return false;
+    }
+
+    sc_mutex_lock(&worker->mutex);
+
+    if (worker->failed) {
+        sc_mutex_unlock(&worker->mutex);
+        av_frame_free(&clone);
+        return false;
+    }
+
+    if (worker->queue.size == worker->capacity) {
+        // The sink is too slow, drop the oldest pending frame
+        AVFrame *old = sc_vecdeque_pop(&worker->queue);
+        av_frame_free(&old);
+        ++worker->dropped;
+    }
+
+    sc_vecdeque_push_noresize(&worker->queue, clone);
+    sc_cond_signal(&worker->queue_cond);
+
+    sc_mutex_unlock(&worker->mutex);
+
+    return true;
+}
+
+bool
 sc_frame_source_init(struct sc_frame_source *source) {
-    source->sink_count = 0;
+    bool ok = sc_mutex_init(&source->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    sc_vector_init(&source->sinks);
+    source->ctx = NULL;
+
+    return true;
 }
 
 void
-sc_frame_source_add_sink(struct sc_frame_source *source,
-                         struct sc_frame_sink *sink) {
-    assert(source->sink_count < SC_FRAME_SOURCE_MAX_SINKS);
+sc_frame_source_destroy(struct sc_frame_source *source) {
+    // The sinks must be closed
+    assert(!source->ctx);
+
+    sc_vector_destroy(&source->sinks);
+    sc_mutex_destroy(&source->mutex);
+}
+
+static bool
+sc_frame_source_open_sink(struct sc_frame_source_entry *entry,
+                          const AVCodecContext *ctx) {
+    assert(!entry->worker);
+
+    struct sc_frame_sink *sink = entry->sink;
+    if (!sink->ops->open(sink, ctx)) {
+        return false;
+    }
+
+    if (entry->dispatch != SC_FRAME_DISPATCH_SYNC) {
+        entry->worker = sc_frame_sink_worker_new(sink, entry->dispatch);
+        if (!entry->worker) {
+            sink->ops->close(sink);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void
+sc_frame_source_close_sink(struct sc_frame_source_entry *entry) {
+    if (entry->worker) {
+        // Flush the pending frames before closing the sink
+        sc_frame_sink_worker_delete(entry->worker);
+        entry->worker = NULL;
+    }
+
+    entry->sink->ops->close(entry->sink);
+}
+
+static bool
+sc_frame_source_add_entry(struct sc_frame_source *source,
+                          struct sc_frame_sink *sink,
+                          enum sc_frame_dispatch dispatch) {
     assert(sink);
     assert(sink->ops);
-    source->sinks[source->sink_count++] = sink;
+
+    struct sc_frame_source_entry entry = {
+        .sink = sink,
+        .dispatch = dispatch,
+        .worker = NULL,
+    };
+
+    sc_mutex_lock(&source->mutex);
+
+    bool ok = sc_vector_push(&source->sinks, entry);
+    if (!ok) {
+        sc_mutex_unlock(&source->mutex);
+        LOG_OOM();
+        return false;
+    }
+
+    if (source->ctx) {
+        // Added while the frames are flowing
+        size_t index = source->sinks.size - 1;
+        ok = sc_frame_source_open_sink(&source->sinks.data[index],
+                                       source->ctx);
+        if (!ok) {
+            sc_vector_remove(&source->sinks, index);
+        }
+    }
+
+    sc_mutex_unlock(&source->mutex);
+
+    return ok;
+}
+
+bool
+sc_frame_source_add_sink(struct sc_frame_source *source,
+                         struct sc_frame_sink *sink) {
+    return sc_frame_source_add_entry(source, sink, SC_FRAME_DISPATCH_SYNC);
+}
+
+bool
+sc_frame_source_add_async_sink(struct sc_frame_source *source,
+                               struct sc_frame_sink *sink,
+                               enum sc_frame_dispatch dispatch) {
+    assert(dispatch != SC_FRAME_DISPATCH_SYNC);
+    return sc_frame_source_add_entry(source, sink, dispatch);
+}
+
+void
+sc_frame_source_remove_sink(struct sc_frame_source *source,
+                            struct sc_frame_sink *sink) {
+    sc_mutex_lock(&source->mutex);
+
+    for (size_t i = 0; i < source->sinks.size; ++i) {
+        struct sc_frame_source_entry *entry = &source->sinks.data[i];
+        if (entry->sink == sink) {
+            if (source->ctx) {
+                sc_frame_source_close_sink(entry);
+            }
+            sc_vector_remove(&source->sinks, i);
+            break;
+        }
+    }
+
+    sc_mutex_unlock(&source->mutex);
 }
 
+// must be called with mutex locked
 static void
 sc_frame_source_sinks_close_firsts(struct sc_frame_source *source,
-                                    unsigned count) {
+                                   size_t count) {
     while (count) {
-        struct sc_frame_sink *sink = source->sinks[--count];
-        sink->ops->close(sink);
+        sc_frame_source_close_sink(&source->sinks.data[--count]);
     }
 }
 
 bool
 sc_frame_source_sinks_open(struct sc_frame_source *source,
                            const AVCodecContext *ctx) {
-    assert(source->sink_count);
-    for (unsigned i = 0; i < source->sink_count; ++i) {
-        struct sc_frame_sink *sink = source->sinks[i];
-        if (!sink->ops->open(sink, ctx)) {
+    assert(ctx);
+
+    sc_mutex_lock(&source->mutex);
+    assert(!source->ctx);
+
+    for (size_t i = 0; i < source->sinks.size; ++i) {
+        if (!sc_frame_source_open_sink(&source->sinks.data[i], ctx)) {
             sc_frame_source_sinks_close_firsts(source, i);
+            sc_mutex_unlock(&source->mutex);
             return false;
         }
     }
 
+    source->ctx = ctx;
+
+    sc_mutex_unlock(&source->mutex);
+
     return true;
 }
 
 void
 sc_frame_source_sinks_close(struct sc_frame_source *source) {
-    assert(source->sink_count);
-    sc_frame_source_sinks_close_firsts(source, source->sink_count);
+    sc_mutex_lock(&source->mutex);
+    assert(source->ctx);
+
+    sc_frame_source_sinks_close_firsts(source, source->sinks.size);
+    source->ctx = NULL;
+
+    sc_mutex_unlock(&source->mutex);
 }
 
 bool
 sc_frame_source_sinks_push(struct sc_frame_source *source,
-                            const AVFrame *frame) {
-    assert(source->sink_count);
-    for (unsigned i = 0; i < source->sink_count; ++i) {
-        struct sc_frame_sink *sink = source->sinks[i];
-        if (!sink->ops->push(sink, frame)) {
+                           const AVFrame *frame) {
+    sc_mutex_lock(&source->mutex);
+    assert(source->ctx);
+
+    for (size_t i = 0; i < source->sinks.size; ++i) {
+        struct sc_frame_source_entry *entry = &source->sinks.data[i];
+        bool ok = entry->worker
+                ? sc_frame_sink_worker_push(entry->worker, frame)
+                : entry->sink->ops->push(entry->sink, frame);
+        if (!ok) {
+            sc_mutex_unlock(&source->mutex);
             return false;
         }
     }
 
+    sc_mutex_unlock(&source->mutex);
+
     return true;
 }
@@ -3,27 +3,94 @@
 
 #include "common.h"
 
+#include <stdbool.h>
+#include <libavcodec/avcodec.h>
+
 #include "frame_sink.h"
+#include "util/thread.h"
+#include "util/vector.h"
+
+// Maximum number of pending frames for SC_FRAME_DISPATCH_FIFO
+#define SC_FRAME_DISPATCH_FIFO_CAPACITY 8
+
+enum sc_frame_dispatch {
+    // Frames are pushed to the sink from the thread pushing to the source
+    SC_FRAME_DISPATCH_SYNC,
+    // Frames are pushed to the sink from a separate thread, only the latest
+    // pending frame is kept
+    SC_FRAME_DISPATCH_LATEST,
+    // Frames are pushed to the sink from a separate thread, through a bounded
+    // queue (the oldest pending frame is dropped when it is full)
+    SC_FRAME_DISPATCH_FIFO,
+};
 
-#define SC_FRAME_SOURCE_MAX_SINKS 2
+// forward declarations
+struct sc_frame_sink_worker;
+
+struct sc_frame_source_entry {
+    struct sc_frame_sink *sink;
+    enum sc_frame_dispatch dispatch;
+    // Only set while the sink is open (and never for SC_FRAME_DISPATCH_SYNC)
+    struct sc_frame_sink_worker *worker;
+};
 
 /**
  * Frame source trait
  *
  * Component able to send AVFrames should implement this trait.
+ *
+ * Sinks may be added or removed at any time, even while frames are pushed from
+ * another thread.
+ *
+ * A sink may be added with an asynchronous dispatch, so that a slow sink never
+ * blocks the thread pushing the frames (typically the decoder).
  */
 struct sc_frame_source {
-    struct sc_frame_sink *sinks[SC_FRAME_SOURCE_MAX_SINKS];
-    unsigned sink_count;
+    sc_mutex mutex;
+    struct SC_VECTOR(struct sc_frame_source_entry) sinks;
+
+    // The codec context while the sinks are open (NULL otherwise), to open
+    // the sinks added later
+    const AVCodecContext *ctx;
 };
 
-void
+bool
 sc_frame_source_init(struct sc_frame_source *source);
 
 void
+sc_frame_source_destroy(struct sc_frame_source *source);
+
+/**
+ * Add a sink
+ *
+ * If the sinks are already open, the sink is opened immediately.
+ */
+bool
 sc_frame_source_add_sink(struct sc_frame_source *source,
                          struct sc_frame_sink *sink);
 
+/**
+ * Add a sink receiving the frames from its own thread
+ *
+ * Pushing a frame to the source only enqueues it for this sink, according to
+ * the dispatch policy, so the time spent by the source per frame does not
+ * depend on this sink. The pending frames are flushed to the sink on close.
+ */
+bool
+sc_frame_source_add_async_sink(struct sc_frame_source *source,
+                               struct sc_frame_sink *sink,
+                               enum sc_frame_dispatch dispatch);
+
+/**
+ * Remove a sink
+ *
+ * If the sinks are open, the sink is closed. No frames will be pushed to it
+ * once this function returns.
+ */
+void
+sc_frame_source_remove_sink(struct sc_frame_source *source,
+                            struct sc_frame_sink *sink);
+
 bool
 sc_frame_source_sinks_open(struct sc_frame_source *source,
                            const AVCodecContext *ctx);
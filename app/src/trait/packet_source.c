@@ -1,24 +1,109 @@
 #include "packet_source.h"
 
-void
+#include "util/log.h"
+
+bool
 sc_packet_source_init(struct sc_packet_source *source) {
-    source->sink_count = 0;
+    bool ok = sc_mutex_init(&source->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    sc_vector_init(&source->sinks);
+    source->ctx = NULL;
+    source->config = NULL;
+    source->disabled = false;
+
+    return true;
 }
 
 void
+sc_packet_source_destroy(struct sc_packet_source *source) {
+    // The sinks must be closed
+    assert(!source->ctx);
+    assert(!source->config);
+
+    sc_vector_destroy(&source->sinks);
+    sc_mutex_destroy(&source->mutex);
+}
+
+// must be called with mutex locked
+static bool
+sc_packet_source_open_sink(struct sc_packet_source *source,
+                           struct sc_packet_sink *sink) {
+    assert(source->ctx);
+
+    if (!sink->ops->open(sink, source->ctx)) {
+        return false;
+    }
+
+    if (source->config && !sink->ops->push(sink, source->config)) {
+        sink->ops->close(sink);
+        return false;
+    }
+
+    return true;
+}
+
+bool
 sc_packet_source_add_sink(struct sc_packet_source *source,
                           struct sc_packet_sink *sink) {
-    assert(source->sink_count < SC_PACKET_SOURCE_MAX_SINKS);
     assert(sink);
     assert(sink->ops);
-    source->sinks[source->sink_count++] = sink;
+
+    sc_mutex_lock(&source->mutex);
+
+    if (source->disabled) {
+        // The sink will never receive any packet
+        if (sink->ops->disable) {
+            sink->ops->disable(sink);
+        }
+        sc_mutex_unlock(&source->mutex);
+        return true;
+    }
+
+    bool ok = sc_vector_push(&source->sinks, sink);
+    if (!ok) {
+        sc_mutex_unlock(&source->mutex);
+        LOG_OOM();
+        return false;
+    }
+
+    if (source->ctx) {
+        // Added while the packets are flowing
+        ok = sc_packet_source_open_sink(source, sink);
+        if (!ok) {
+            sc_vector_remove(&source->sinks, source->sinks.size - 1);
+        }
+    }
+
+    sc_mutex_unlock(&source->mutex);
+
+    return ok;
+}
+
+void
+sc_packet_source_remove_sink(struct sc_packet_source *source,
+                             struct sc_packet_sink *sink) {
+    sc_mutex_lock(&source->mutex);
+
+    ssize_t index = sc_vector_index_of(&source->sinks, sink);
+    if (index != -1) {
+        if (source->ctx) {
+            sink->ops->close(sink);
+        }
+        sc_vector_remove(&source->sinks, index);
+    }
+
+    sc_mutex_unlock(&source->mutex);
 }
 
+// must be called with mutex locked
 static void
 sc_packet_source_sinks_close_firsts(struct sc_packet_source *source,
-                                    unsigned count) {
+                                    size_t count) {
     while (count) {
-        struct sc_packet_sink *sink = source->sinks[--count];
+        struct sc_packet_sink *sink = source->sinks.data[--count];
         sink->ops->close(sink);
     }
 }
@@ -26,45 +111,83 @@ sc_packet_source_sinks_close_firsts(struct sc_packet_source *source,
 bool
 sc_packet_source_sinks_open(struct sc_packet_source *source,
                             AVCodecContext *ctx) {
-    assert(source->sink_count);
-    for (unsigned i = 0; i < source->sink_count; ++i) {
-        struct sc_packet_sink *sink = source->sinks[i];
+    assert(ctx);
+
+    sc_mutex_lock(&source->mutex);
+    assert(!source->ctx);
+
+    for (size_t i = 0; i < source->sinks.size; ++i) {
+        struct sc_packet_sink *sink = source->sinks.data[i];
         if (!sink->ops->open(sink, ctx)) {
             sc_packet_source_sinks_close_firsts(source, i);
+            sc_mutex_unlock(&source->mutex);
             return false;
         }
     }
 
+    source->ctx = ctx;
+
+    sc_mutex_unlock(&source->mutex);
+
     return true;
 }
 
 void
 sc_packet_source_sinks_close(struct sc_packet_source *source) {
-    assert(source->sink_count);
-    sc_packet_source_sinks_close_firsts(source, source->sink_count);
+    sc_mutex_lock(&source->mutex);
+    assert(source->ctx);
+
+    sc_packet_source_sinks_close_firsts(source, source->sinks.size);
+    source->ctx = NULL;
+    av_packet_free(&source->config);
+
+    sc_mutex_unlock(&source->mutex);
 }
 
 bool
 sc_packet_source_sinks_push(struct sc_packet_source *source,
                             const AVPacket *packet) {
-    assert(source->sink_count);
-    for (unsigned i = 0; i < source->sink_count; ++i) {
-        struct sc_packet_sink *sink = source->sinks[i];
+    sc_mutex_lock(&source->mutex);
+    assert(source->ctx);
+
+    if (packet->pts == AV_NOPTS_VALUE) {
+        // Keep the config packet for the sinks added later
+        AVPacket *config = av_packet_clone(packet);
+        if (!config) {
+            sc_mutex_unlock(&source->mutex);
+            LOG_OOM();
+            return false;
+        }
+
+        av_packet_free(&source->config);
+        source->config = config;
+    }
+
+    for (size_t i = 0; i < source->sinks.size; ++i) {
+        struct sc_packet_sink *sink = source->sinks.data[i];
         if (!sink->ops->push(sink, packet)) {
+            sc_mutex_unlock(&source->mutex);
             return false;
         }
     }
 
+    sc_mutex_unlock(&source->mutex);
+
     return true;
 }
 
 void
 sc_packet_source_sinks_disable(struct sc_packet_source *source) {
-    assert(source->sink_count);
-    for (unsigned i = 0; i < source->sink_count; ++i) {
-        struct sc_packet_sink *sink = source->sinks[i];
+    sc_mutex_lock(&source->mutex);
+
+    source->disabled = true;
+
+    for (size_t i = 0; i < source->sinks.size; ++i) {
+        struct sc_packet_sink *sink = source->sinks.data[i];
         if (sink->ops->disable) {
             sink->ops->disable(sink);
         }
     }
+
+    sc_mutex_unlock(&source->mutex);
 }
@@ -3,27 +3,61 @@
 
 #include "common.h"
 
-#include "packet_sink.h"
+#include <stdbool.h>
+#include <libavcodec/avcodec.h>
 
-#define SC_PACKET_SOURCE_MAX_SINKS 2
+#include "packet_sink.h"
+#include "util/thread.h"
+#include "util/vector.h"
 
 /**
  * Packet source trait
  *
  * Component able to send AVPackets should implement this trait.
+ *
+ * Sinks may be added or removed at any time, even while packets are pushed
+ * from another thread (for example to start recording during a session).
  */
 struct sc_packet_source {
-    struct sc_packet_sink *sinks[SC_PACKET_SOURCE_MAX_SINKS];
-    unsigned sink_count;
+    sc_mutex mutex;
+    struct SC_VECTOR(struct sc_packet_sink *) sinks;
+
+    // The codec context while the sinks are open (NULL otherwise), to open
+    // the sinks added later
+    AVCodecContext *ctx;
+    // The last config packet pushed (NULL if none), to initialize the sinks
+    // added later
+    AVPacket *config;
+    // Set if sc_packet_source_sinks_disable() has been called
+    bool disabled;
 };
 
-void
+bool
 sc_packet_source_init(struct sc_packet_source *source);
 
 void
+sc_packet_source_destroy(struct sc_packet_source *source);
+
+/**
+ * Add a sink
+ *
+ * If the sinks are already open, the sink is opened immediately, and receives
+ * the last config packet (the next packets may not start on a keyframe).
+ */
+bool
 sc_packet_source_add_sink(struct sc_packet_source *source,
                           struct sc_packet_sink *sink);
 
+/**
+ * Remove a sink
+ *
+ * If the sinks are open, the sink is closed. No packets will be pushed to it
+ * once this function returns.
+ */
+void
+sc_packet_source_remove_sink(struct sc_packet_source *source,
+                             struct sc_packet_sink *sink);
+
 bool
 sc_packet_source_sinks_open(struct sc_packet_source *source,
                             AVCodecContext *ctx);
@@ -0,0 +1,348 @@
+#include "transcoder.h"
+
+#include <assert.h>
+#include <string.h>
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+# include <libavutil/hwcontext.h>
+#endif
+
+#include "util/log.h"
+
+/** Downcast frame_sink to sc_transcoder */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_transcoder, frame_sink)
+
+static const AVRational SCRCPY_TIME_BASE = {1, 1000000}; // timestamps in us
+
+static AVCodecContext *
+sc_transcoder_create_encoder(struct sc_transcoder *transcoder,
+                             const AVFrame *frame) {
+    AVCodecContext *ctx = avcodec_alloc_context3(transcoder->codec);
+    if (!ctx) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    ctx->width = frame->width;
+    ctx->height = frame->height;
+    ctx->time_base = SCRCPY_TIME_BASE;
+    ctx->bit_rate = transcoder->bit_rate;
+    ctx->gop_size = SC_TRANSCODER_GOP_SIZE;
+    // Every packet is output as soon as its frame is encoded
+    ctx->max_b_frames = 0;
+    // The stream config is pushed as a separate config packet
+    ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    ctx->color_range = frame->color_range;
+    ctx->colorspace = frame->colorspace;
+    ctx->color_primaries = frame->color_primaries;
+    ctx->color_trc = frame->color_trc;
+
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    if (frame->hw_frames_ctx) {
+        // Encode the hardware surfaces directly
+        const AVHWFramesContext *frames_ctx =
+            (const AVHWFramesContext *) frame->hw_frames_ctx->data;
+        ctx->pix_fmt = frames_ctx->format;
+        ctx->sw_pix_fmt = frames_ctx->sw_format;
+        ctx->hw_frames_ctx = av_buffer_ref(frame->hw_frames_ctx);
+        if (!ctx->hw_frames_ctx) {
+            LOG_OOM();
+            avcodec_free_context(&ctx);
+            return NULL;
+        }
+    } else
+#endif
+    {
+        ctx->pix_fmt = frame->format;
+    }
+
+    if (avcodec_open2(ctx, transcoder->codec, NULL) < 0) {
+        avcodec_free_context(&ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+static bool
+sc_transcoder_drain(struct sc_transcoder *transcoder) {
+    AVPacket *packet = transcoder->packet;
+    for (;;) {
+        int ret = avcodec_receive_packet(transcoder->ctx, packet);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return true;
+        }
+        if (ret < 0) {
+            LOGE("Transcoder: could not receive packet: %d", ret);
+            return false;
+        }
+
+        // No B-frames
+        packet->dts = packet->pts;
+
+        bool ok = sc_packet_source_sinks_push(&transcoder->packet_source,
+                                              packet);
+        av_packet_unref(packet);
+        if (!ok) {
+            return false;
+        }
+    }
+}
+
+static bool
+sc_transcoder_flush(struct sc_transcoder *transcoder) {
+    int ret = avcodec_send_frame(transcoder->ctx, NULL);
+    if (ret < 0 && ret != AVERROR_EOF) {
+        LOGE("Transcoder: could not flush encoder: %d", ret);
+        return false;
+    }
+
+    return sc_transcoder_drain(transcoder);
+}
+
+static bool
+sc_transcoder_push_config(struct sc_transcoder *transcoder) {
+    AVCodecContext *ctx = transcoder->ctx;
+    if (!ctx->extradata_size) {
+        // The config is in-band
+        return true;
+    }
+
+    AVPacket *packet = transcoder->packet;
+    if (av_new_packet(packet, ctx->extradata_size) < 0) {
+        LOG_OOM();
+        return false;
+    }
+
+    memcpy(packet->data, ctx->extradata, ctx->extradata_size);
+    packet->pts = AV_NOPTS_VALUE;
+    packet->dts = AV_NOPTS_VALUE;
+
+    bool ok = sc_packet_source_sinks_push(&transcoder->packet_source, packet);
+    av_packet_unref(packet);
+    return ok;
+}
+
+static bool
+sc_transcoder_must_open_encoder(struct sc_transcoder *transcoder,
+                                const AVFrame *frame) {
+    AVCodecContext *ctx = transcoder->ctx;
+    if (!ctx) {
+        return true;
+    }
+
+    if (ctx->width != frame->width || ctx->height != frame->height) {
+        return true;
+    }
+
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    if (!frame->hw_frames_ctx != !ctx->hw_frames_ctx) {
+        // Switched between hardware and downloaded frames
+        return true;
+    }
+
+    if (frame->hw_frames_ctx) {
+        // The decoder may have recreated its hardware frames pool
+        return ctx->hw_frames_ctx->data != frame->hw_frames_ctx->data;
+    }
+#endif
+
+    return false;
+}
+
+static bool
+sc_transcoder_open_encoder(struct sc_transcoder *transcoder,
+                           const AVFrame *frame) {
+    AVCodecContext *ctx = sc_transcoder_create_encoder(transcoder, frame);
+    if (!ctx) {
+        return false;
+    }
+
+    if (transcoder->ctx) {
+        // Push the packets of the last frames before switching encoders
+        // (failing to do so only loses these frames)
+        sc_transcoder_flush(transcoder);
+        if (transcoder->ctx != transcoder->sinks_ctx) {
+            avcodec_free_context(&transcoder->ctx);
+        }
+    }
+
+    transcoder->ctx = ctx;
+
+    LOGI("Transcoder: %s %dx%d%s", transcoder->codec->name, ctx->width,
+         ctx->height, ctx->hw_frames_ctx ? " (hardware frames)" : "");
+
+    if (!transcoder->sinks_ctx) {
+        if (!sc_packet_source_sinks_open(&transcoder->packet_source, ctx)) {
+            avcodec_free_context(&transcoder->ctx);
+            return false;
+        }
+        transcoder->sinks_ctx = ctx;
+    }
+
+    return sc_transcoder_push_config(transcoder);
+}
+
+static bool
+sc_transcoder_open(struct sc_transcoder *transcoder,
+                   const AVCodecContext *ctx) {
+    (void) ctx;
+
+    transcoder->packet = av_packet_alloc();
+    if (!transcoder->packet) {
+        LOG_OOM();
+        return false;
+    }
+
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    transcoder->sw_frame = av_frame_alloc();
+    if (!transcoder->sw_frame) {
+        LOG_OOM();
+        av_packet_free(&transcoder->packet);
+        return false;
+    }
+
+    if (!sc_hwframe_downloader_init(&transcoder->downloader, true)) {
+        av_frame_free(&transcoder->sw_frame);
+        av_packet_free(&transcoder->packet);
+        return false;
+    }
+
+    transcoder->download = false;
+#endif
+
+    transcoder->ctx = NULL;
+    transcoder->sinks_ctx = NULL;
+
+    return true;
+}
+
+static void
+sc_transcoder_close(struct sc_transcoder *transcoder) {
+    if (transcoder->ctx) {
+        sc_transcoder_flush(transcoder);
+    }
+
+    if (transcoder->sinks_ctx) {
+        sc_packet_source_sinks_close(&transcoder->packet_source);
+    }
+
+    if (transcoder->ctx != transcoder->sinks_ctx) {
+        avcodec_free_context(&transcoder->ctx);
+    }
+    avcodec_free_context(&transcoder->sinks_ctx);
+
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    sc_hwframe_downloader_destroy(&transcoder->downloader);
+    av_frame_free(&transcoder->sw_frame);
+#endif
+    av_packet_free(&transcoder->packet);
+}
+
+static bool
+sc_transcoder_push(struct sc_transcoder *transcoder, const AVFrame *frame) {
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    if (frame->hw_frames_ctx && !transcoder->download
+            && sc_transcoder_must_open_encoder(transcoder, frame)) {
+        if (!sc_transcoder_open_encoder(transcoder, frame)) {
+            // For example, the frames are decoded on another device than the
+            // one of the encoder
+            LOGW("Transcoder: %s does not accept the decoded hardware "
+                 "frames, downloading them", transcoder->codec->name);
+            transcoder->download = true;
+        }
+    }
+
+    if (frame->hw_frames_ctx && transcoder->download) {
+        AVFrame *sw_frame = transcoder->sw_frame;
+        if (!sc_hwframe_downloader_download(&transcoder->downloader, sw_frame,
+                                            frame)) {
+            LOGE("Transcoder: could not download hardware frame");
+            return false;
+        }
+        frame = sw_frame;
+    }
+#endif
+
+    bool ok = false;
+
+    if (sc_transcoder_must_open_encoder(transcoder, frame)) {
+        if (!sc_transcoder_open_encoder(transcoder, frame)) {
+            LOGE("Transcoder: could not open encoder %s",
+                 transcoder->codec->name);
+            goto end;
+        }
+    }
+
+    int ret = avcodec_send_frame(transcoder->ctx, frame);
+    if (ret < 0) {
+        LOGE("Transcoder: could not send frame: %d", ret);
+        goto end;
+    }
+
+    ok = sc_transcoder_drain(transcoder);
+
+end:
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    av_frame_unref(transcoder->sw_frame);
+#endif
+    return ok;
+}
+
+static bool
+sc_transcoder_frame_sink_open(struct sc_frame_sink *sink,
+                              const AVCodecContext *ctx) {
+    struct sc_transcoder *transcoder = DOWNCAST(sink);
+    return sc_transcoder_open(transcoder, ctx);
+}
+
+static void
+sc_transcoder_frame_sink_close(struct sc_frame_sink *sink) {
+    struct sc_transcoder *transcoder = DOWNCAST(sink);
+    sc_transcoder_close(transcoder);
+}
+
+static bool
+sc_transcoder_frame_sink_push(struct sc_frame_sink *sink,
+                              const AVFrame *frame) {
+    struct sc_transcoder *transcoder = DOWNCAST(sink);
+    return sc_transcoder_push(transcoder, frame);
+}
+
+bool
+sc_transcoder_init(struct sc_transcoder *transcoder, const char *encoder_name,
+                   uint32_t bit_rate) {
+    const AVCodec *codec = avcodec_find_encoder_by_name(encoder_name);
+    if (!codec) {
+        LOGE("Video encoder '%s' not found (is it supported by FFmpeg?)",
+             encoder_name);
+        return false;
+    }
+
+    if (codec->id != AV_CODEC_ID_H264 && codec->id != AV_CODEC_ID_HEVC) {
+        LOGE("Video encoder '%s' must encode H.264 or H.265", encoder_name);
+        return false;
+    }
+
+    if (!sc_packet_source_init(&transcoder->packet_source)) {
+        return false;
+    }
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = sc_transcoder_frame_sink_open,
+        .close = sc_transcoder_frame_sink_close,
+        .push = sc_transcoder_frame_sink_push,
+    };
+
+    transcoder->frame_sink.ops = &ops;
+
+    transcoder->encoder_name = encoder_name;
+    transcoder->codec = codec;
+    transcoder->bit_rate = bit_rate;
+
+    return true;
+}
+
+void
+sc_transcoder_destroy(struct sc_transcoder *transcoder) {
+    sc_packet_source_destroy(&transcoder->packet_source);
+}
@@ -0,0 +1,63 @@
+#ifndef SC_TRANSCODER_H
+#define SC_TRANSCODER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+
+#include "hwframe.h"
+#include "trait/frame_sink.h"
+#include "trait/packet_source.h"
+
+#define SC_TRANSCODER_DEFAULT_BIT_RATE 8000000
+// About 2 seconds at 60 fps, so that new viewers start quickly
+#define SC_TRANSCODER_GOP_SIZE 120
+
+/**
+ * Re-encode the decoded video frames with a libavcodec encoder selected by
+ * name (typically a hardware one: h264_vaapi, h264_nvenc, h264_qsv…)
+ *
+ * If the decoder outputs hardware frames and the encoder accepts them as is
+ * (same hardware device), the frames are never downloaded to system memory:
+ * the decoded surfaces are passed directly to the encoder. Otherwise, they
+ * are downloaded before encoding.
+ *
+ * The encoder is opened on the first frame, and reopened if the frame size
+ * changes (the new stream config is pushed as a config packet, like on device
+ * rotation).
+ *
+ * This must be added to a frame source with an asynchronous dispatch, so that
+ * the encoding never blocks the decoder.
+ */
+struct sc_transcoder {
+    struct sc_frame_sink frame_sink; // frame sink trait
+    struct sc_packet_source packet_source; // packet source trait
+
+    const char *encoder_name;
+    uint32_t bit_rate;
+
+    const AVCodec *codec;
+    AVCodecContext *ctx; // the current encoder
+    // The context the packet sinks have been opened with (the first encoder,
+    // kept until the sinks are closed)
+    AVCodecContext *sinks_ctx;
+    AVPacket *packet;
+
+#ifdef SCRCPY_LAVC_HAS_HWACCEL
+    // Set if the hardware frames are not accepted by the encoder
+    bool download;
+    struct sc_hwframe_downloader downloader;
+    AVFrame *sw_frame;
+#endif
+};
+
+bool
+sc_transcoder_init(struct sc_transcoder *transcoder, const char *encoder_name,
+                   uint32_t bit_rate);
+
+void
+sc_transcoder_destroy(struct sc_transcoder *transcoder);
+
+#endif
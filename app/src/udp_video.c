@@ -0,0 +1,748 @@
+#include "udp_video.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/binary.h"
+#include "util/log.h"
+#include "util/net_intr.h"
+
+// Must match the device side
+#define SC_UDP_VIDEO_TYPE_DATA 0
+#define SC_UDP_VIDEO_TYPE_PARITY 1
+#define SC_UDP_VIDEO_TYPE_HELLO 2
+#define SC_UDP_VIDEO_TYPE_NACK 3
+#define SC_UDP_VIDEO_TYPE_REQUEST_KEYFRAME 4
+
+#define SC_UDP_VIDEO_FLAG_CONFIG 1
+#define SC_UDP_VIDEO_FLAG_KEY_FRAME 2
+
+#define SC_UDP_VIDEO_HEADER_LENGTH 14
+#define SC_UDP_VIDEO_FRAGMENT_SIZE 1200
+#define SC_UDP_VIDEO_FEC_GROUP_SIZE 8
+#define SC_UDP_VIDEO_MAX_DATAGRAM_SIZE \
+    (SC_UDP_VIDEO_HEADER_LENGTH + SC_UDP_VIDEO_FRAGMENT_SIZE)
+
+// The codec id and the video size
+#define SC_UDP_VIDEO_STREAM_HEADER_LENGTH 12
+
+// Keep a NACK within a single fragment
+#define SC_UDP_VIDEO_MAX_NACK_INDEXES 512
+
+#define SC_UDP_VIDEO_HELLO_ATTEMPTS 50
+#define SC_UDP_VIDEO_HELLO_INTERVAL SC_TICK_FROM_MS(100)
+// The datagrams are lost if the receive buffer is full
+#define SC_UDP_VIDEO_RECV_BUFFER_SIZE (4 << 20)
+
+#define SC_UDP_VIDEO_POLL_INTERVAL SC_TICK_FROM_MS(5)
+// Delay without progress before requesting the missing fragments (tolerate
+// some reordering)
+#define SC_UDP_VIDEO_NACK_DELAY SC_TICK_FROM_MS(10)
+#define SC_UDP_VIDEO_NACK_INTERVAL SC_TICK_FROM_MS(30)
+// Delay without progress before skipping a packet
+#define SC_UDP_VIDEO_MAX_DELAY SC_TICK_FROM_MS(120)
+// The stream cannot be decoded without its configuration packet
+#define SC_UDP_VIDEO_CONFIG_MAX_DELAY SC_TICK_FROM_SEC(2)
+#define SC_UDP_VIDEO_KEYFRAME_REQUEST_INTERVAL SC_TICK_FROM_MS(500)
+
+sc_socket
+sc_udp_video_connect(struct sc_intr *intr, uint32_t host, uint16_t port,
+                     const uint8_t *token, size_t token_len) {
+    sc_socket socket = net_udp_socket();
+    if (socket == SC_SOCKET_NONE) {
+        return SC_SOCKET_NONE;
+    }
+
+    uint8_t hello[1 + 64];
+    assert(token_len < sizeof(hello));
+    hello[0] = SC_UDP_VIDEO_TYPE_HELLO;
+    memcpy(&hello[1], token, token_len);
+
+    bool ok = net_connect_intr(intr, socket, host, port)
+           && net_set_recv_timeout(socket, SC_UDP_VIDEO_HELLO_INTERVAL);
+    if (!ok) {
+        goto error;
+    }
+
+    // Failures are not fatal, the system default is used
+    net_set_recv_buffer_size(socket, SC_UDP_VIDEO_RECV_BUFFER_SIZE);
+
+    for (unsigned i = 0; i < SC_UDP_VIDEO_HELLO_ATTEMPTS; ++i) {
+        // The datagrams may be lost, send the token until the device replies
+        ssize_t w = net_send_intr(intr, socket, hello, 1 + token_len);
+        if (w < 0 && sc_intr_is_interrupted(intr)) {
+            goto error;
+        }
+
+        uint8_t reply[SC_UDP_VIDEO_MAX_DATAGRAM_SIZE];
+        ssize_t r = net_recv_intr(intr, socket, reply, sizeof(reply));
+        if (r == 1 && reply[0] == SC_UDP_VIDEO_TYPE_HELLO) {
+            if (!net_set_recv_timeout(socket, SC_UDP_VIDEO_POLL_INTERVAL)) {
+                goto error;
+            }
+            return socket;
+        }
+
+        if (sc_intr_is_interrupted(intr)) {
+            goto error;
+        }
+    }
+
+    LOGE("The device did not reply over UDP");
+
+error:
+    net_close(socket);
+    return SC_SOCKET_NONE;
+}
+
+bool
+sc_udp_video_init(struct sc_udp_video *uv, sc_socket tcp_socket,
+                  sc_socket udp_socket) {
+    bool ok = sc_mutex_init(&uv->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&uv->header_cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    sc_socket pair[2];
+    if (!net_socketpair(pair)) {
+        LOGE("Could not create UDP video socket pair");
+        goto error_destroy_cond;
+    }
+
+    uv->local = pair[0];
+    uv->remote = pair[1];
+    uv->tcp_socket = tcp_socket;
+    uv->udp_socket = udp_socket;
+    uv->header_forwarded = false;
+    atomic_init(&uv->stopped, false);
+
+    for (unsigned i = 0; i < SC_UDP_VIDEO_WINDOW; ++i) {
+        uv->window[i].used = false;
+    }
+    uv->next_sequence = 0;
+    uv->end_sequence = 0;
+    uv->last_nack = 0;
+    uv->wait_keyframe = false;
+    uv->last_keyframe_request = 0;
+    uv->recovered = 0;
+    uv->dropped = 0;
+
+    return true;
+
+error_destroy_cond:
+    sc_cond_destroy(&uv->header_cond);
+error_destroy_mutex:
+    sc_mutex_destroy(&uv->mutex);
+
+    return false;
+}
+
+static void
+sc_udp_video_packet_release(struct sc_udp_video_packet *packet) {
+    assert(packet->used);
+    free(packet->data);
+    packet->used = false;
+}
+
+void
+sc_udp_video_destroy(struct sc_udp_video *uv) {
+    for (unsigned i = 0; i < SC_UDP_VIDEO_WINDOW; ++i) {
+        if (uv->window[i].used) {
+            sc_udp_video_packet_release(&uv->window[i]);
+        }
+    }
+
+    // The remote socket is owned by the caller
+    net_close(uv->local);
+    net_close(uv->udp_socket);
+    net_close(uv->tcp_socket);
+    sc_cond_destroy(&uv->header_cond);
+    sc_mutex_destroy(&uv->mutex);
+}
+
+sc_socket
+sc_udp_video_get_socket(struct sc_udp_video *uv) {
+    return uv->remote;
+}
+
+static inline unsigned
+sc_udp_video_group_count(uint16_t count) {
+    return (count + SC_UDP_VIDEO_FEC_GROUP_SIZE - 1)
+         / SC_UDP_VIDEO_FEC_GROUP_SIZE;
+}
+
+static inline size_t
+sc_udp_video_fragment_length(const struct sc_udp_video_packet *packet,
+                             unsigned index) {
+    assert(index < packet->count);
+    if (index < packet->count - 1u) {
+        return SC_UDP_VIDEO_FRAGMENT_SIZE;
+    }
+    return packet->length - (size_t) index * SC_UDP_VIDEO_FRAGMENT_SIZE;
+}
+
+static inline struct sc_udp_video_packet *
+sc_udp_video_get_packet(struct sc_udp_video *uv, uint32_t sequence) {
+    return &uv->window[sequence % SC_UDP_VIDEO_WINDOW];
+}
+
+static bool
+sc_udp_video_packet_init(struct sc_udp_video_packet *packet,
+                         uint32_t sequence, uint8_t flags, uint32_t length,
+                         uint16_t count, sc_tick now) {
+    assert(!packet->used);
+
+    size_t groups = sc_udp_video_group_count(count);
+    size_t fragments_size = ((size_t) count + groups)
+                          * SC_UDP_VIDEO_FRAGMENT_SIZE;
+    // Zero-initialized: the padding is part of the parity
+    uint8_t *buf = calloc(1, fragments_size + count + groups);
+    if (!buf) {
+        LOG_OOM();
+        return false;
+    }
+
+    packet->data = buf;
+    packet->parity = &buf[(size_t) count * SC_UDP_VIDEO_FRAGMENT_SIZE];
+    packet->has_fragment = &buf[fragments_size];
+    packet->has_parity = &packet->has_fragment[count];
+
+    packet->used = true;
+    packet->sequence = sequence;
+    packet->flags = flags;
+    packet->length = length;
+    packet->count = count;
+    packet->received = 0;
+    packet->max_index = 0;
+    packet->first_time = now;
+    packet->last_time = now;
+
+    return true;
+}
+
+// Rebuild the missing fragment of the group from the parity, if it is the
+// only one missing
+static void
+sc_udp_video_recover(struct sc_udp_video *uv,
+                     struct sc_udp_video_packet *packet, unsigned group) {
+    if (!packet->has_parity[group]) {
+        return;
+    }
+
+    unsigned first = group * SC_UDP_VIDEO_FEC_GROUP_SIZE;
+    unsigned end = MIN(first + SC_UDP_VIDEO_FEC_GROUP_SIZE, packet->count);
+
+    int missing = -1;
+    for (unsigned i = first; i < end; ++i) {
+        if (!packet->has_fragment[i]) {
+            if (missing != -1) {
+                // Several fragments are missing
+                return;
+            }
+            missing = i;
+        }
+    }
+
+    if (missing == -1) {
+        return;
+    }
+
+    uint8_t *dst = &packet->data[missing * SC_UDP_VIDEO_FRAGMENT_SIZE];
+    memcpy(dst, &packet->parity[group * SC_UDP_VIDEO_FRAGMENT_SIZE],
+           SC_UDP_VIDEO_FRAGMENT_SIZE);
+    for (unsigned i = first; i < end; ++i) {
+        if ((int) i != missing) {
+            const uint8_t *src = &packet->data[i * SC_UDP_VIDEO_FRAGMENT_SIZE];
+            for (size_t j = 0; j < SC_UDP_VIDEO_FRAGMENT_SIZE; ++j) {
+                dst[j] ^= src[j];
+            }
+        }
+    }
+
+    // Keep the padding of the last fragment zeroed
+    size_t len = sc_udp_video_fragment_length(packet, missing);
+    memset(&dst[len], 0, SC_UDP_VIDEO_FRAGMENT_SIZE - len);
+
+    packet->has_fragment[missing] = 1;
+    ++packet->received;
+    ++uv->recovered;
+}
+
+static void
+sc_udp_video_request_keyframe(struct sc_udp_video *uv, sc_tick now) {
+    uint8_t msg = SC_UDP_VIDEO_TYPE_REQUEST_KEYFRAME;
+    if (net_send(uv->udp_socket, &msg, 1) != 1) {
+        LOGW("Could not request a keyframe");
+    }
+    uv->last_keyframe_request = now;
+}
+
+// Write the next packet, which is complete
+static bool
+sc_udp_video_write_next(struct sc_udp_video *uv) {
+    struct sc_udp_video_packet *packet =
+        sc_udp_video_get_packet(uv, uv->next_sequence);
+    assert(packet->used && packet->received == packet->count);
+
+    bool ok = true;
+    uint8_t flags = packet->flags;
+    if (uv->wait_keyframe && !(flags & (SC_UDP_VIDEO_FLAG_CONFIG
+                                      | SC_UDP_VIDEO_FLAG_KEY_FRAME))) {
+        // It depends on a lost packet
+        ++uv->dropped;
+    } else {
+        if (flags & SC_UDP_VIDEO_FLAG_KEY_FRAME) {
+            uv->wait_keyframe = false;
+        }
+        ssize_t w = net_send_all(uv->local, packet->data, packet->length);
+        // The demuxer is closed otherwise
+        ok = w == (ssize_t) packet->length;
+    }
+
+    sc_udp_video_packet_release(packet);
+    ++uv->next_sequence;
+    return ok;
+}
+
+// Skip the next packet, which is incomplete
+static bool
+sc_udp_video_skip_next(struct sc_udp_video *uv, sc_tick now) {
+    struct sc_udp_video_packet *packet =
+        sc_udp_video_get_packet(uv, uv->next_sequence);
+    if (packet->used) {
+        if (packet->flags & SC_UDP_VIDEO_FLAG_CONFIG) {
+            LOGE("UDP video: codec configuration packet lost");
+            return false;
+        }
+        sc_udp_video_packet_release(packet);
+    }
+
+    ++uv->dropped;
+    ++uv->next_sequence;
+
+    if (!uv->wait_keyframe) {
+        LOGD("UDP video: packet %" PRIu32 " lost, waiting for a keyframe",
+             uv->next_sequence - 1);
+        uv->wait_keyframe = true;
+        sc_udp_video_request_keyframe(uv, now);
+    }
+
+    return true;
+}
+
+// Make sure that the window starts at `sequence`, whether the packets until
+// there are complete or not
+static bool
+sc_udp_video_advance(struct sc_udp_video *uv, uint32_t sequence, sc_tick now) {
+    while ((int32_t) (sequence - uv->next_sequence) > 0) {
+        struct sc_udp_video_packet *packet =
+            sc_udp_video_get_packet(uv, uv->next_sequence);
+        bool ok;
+        if (packet->used && packet->received == packet->count) {
+            ok = sc_udp_video_write_next(uv);
+        } else {
+            ok = sc_udp_video_skip_next(uv, now);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+
+    if ((int32_t) (uv->end_sequence - sequence) < 0) {
+        uv->end_sequence = sequence;
+    }
+
+    return true;
+}
+
+static bool
+sc_udp_video_process_datagram(struct sc_udp_video *uv, const uint8_t *buf,
+                              size_t len, sc_tick now) {
+    if (len < SC_UDP_VIDEO_HEADER_LENGTH) {
+        return true;
+    }
+
+    uint8_t type = buf[0];
+    if (type != SC_UDP_VIDEO_TYPE_DATA && type != SC_UDP_VIDEO_TYPE_PARITY) {
+        // Typically a duplicated reply to the handshake
+        return true;
+    }
+
+    uint8_t flags = buf[1];
+    uint32_t sequence = sc_read32be(&buf[2]);
+    uint16_t index = sc_read16be(&buf[6]);
+    uint16_t count = sc_read16be(&buf[8]);
+    uint32_t length = sc_read32be(&buf[10]);
+    const uint8_t *payload = &buf[SC_UDP_VIDEO_HEADER_LENGTH];
+    size_t payload_len = len - SC_UDP_VIDEO_HEADER_LENGTH;
+
+    if (!count
+            || length <= (uint64_t) (count - 1) * SC_UDP_VIDEO_FRAGMENT_SIZE
+            || length > (uint64_t) count * SC_UDP_VIDEO_FRAGMENT_SIZE) {
+        LOGW("UDP video: invalid datagram");
+        return true;
+    }
+
+    if ((int32_t) (sequence - uv->next_sequence) < 0) {
+        // Too late, the packet has already been written or skipped
+        return true;
+    }
+
+    if ((int32_t) (sequence - uv->next_sequence) >= SC_UDP_VIDEO_WINDOW) {
+        // Give up the oldest packets
+        uint32_t start = sequence - SC_UDP_VIDEO_WINDOW + 1;
+        if (!sc_udp_video_advance(uv, start, now)) {
+            return false;
+        }
+    }
+
+    struct sc_udp_video_packet *packet =
+        sc_udp_video_get_packet(uv, sequence);
+    if (!packet->used) {
+        if (!sc_udp_video_packet_init(packet, sequence, flags, length, count,
+                                      now)) {
+            return false;
+        }
+    } else if (packet->count != count || packet->length != length) {
+        LOGW("UDP video: inconsistent datagram");
+        return true;
+    }
+
+    assert(packet->sequence == sequence);
+    packet->last_time = now;
+
+    if ((int32_t) (sequence - uv->end_sequence) >= 0) {
+        uv->end_sequence = sequence + 1;
+    }
+
+    if (type == SC_UDP_VIDEO_TYPE_DATA) {
+        if (index >= count
+                || payload_len != sc_udp_video_fragment_length(packet, index)) {
+            LOGW("UDP video: invalid fragment");
+            return true;
+        }
+
+        if (index >= packet->max_index) {
+            packet->max_index = index + 1;
+        }
+
+        if (packet->has_fragment[index]) {
+            // Duplicated (retransmitted)
+            return true;
+        }
+
+        memcpy(&packet->data[index * SC_UDP_VIDEO_FRAGMENT_SIZE], payload,
+               payload_len);
+        packet->has_fragment[index] = 1;
+        ++packet->received;
+        sc_udp_video_recover(uv, packet, index / SC_UDP_VIDEO_FEC_GROUP_SIZE);
+    } else {
+        if (index >= sc_udp_video_group_count(count)
+                || payload_len > SC_UDP_VIDEO_FRAGMENT_SIZE) {
+            LOGW("UDP video: invalid parity");
+            return true;
+        }
+
+        if (packet->has_parity[index]) {
+            return true;
+        }
+
+        memcpy(&packet->parity[index * SC_UDP_VIDEO_FRAGMENT_SIZE], payload,
+               payload_len);
+        packet->has_parity[index] = 1;
+        sc_udp_video_recover(uv, packet, index);
+    }
+
+    return true;
+}
+
+// Request the missing fragments of the packet (or the whole packet if
+// packet is NULL)
+static void
+sc_udp_video_send_nack(struct sc_udp_video *uv, uint32_t sequence,
+                       const struct sc_udp_video_packet *packet,
+                       bool later_received) {
+    uint8_t buf[7 + 2 * SC_UDP_VIDEO_MAX_NACK_INDEXES];
+    buf[0] = SC_UDP_VIDEO_TYPE_NACK;
+    sc_write32be(&buf[1], sequence);
+
+    unsigned n = 0;
+    if (packet) {
+        // Without a later packet, the fragments after the last one received
+        // may not have been sent yet
+        unsigned end = later_received ? packet->count : packet->max_index;
+        for (unsigned i = 0; i < end && n < SC_UDP_VIDEO_MAX_NACK_INDEXES;
+                ++i) {
+            if (!packet->has_fragment[i]) {
+                sc_write16be(&buf[7 + 2 * n], i);
+                ++n;
+            }
+        }
+        if (!n) {
+            return;
+        }
+    }
+    // n == 0 requests the whole packet
+    sc_write16be(&buf[5], n);
+
+    size_t len = 7 + 2 * n;
+    if (net_send(uv->udp_socket, buf, len) != (ssize_t) len) {
+        LOGD("UDP video: could not send NACK");
+    }
+}
+
+static void
+sc_udp_video_send_nacks(struct sc_udp_video *uv) {
+    bool later_received = false;
+    // From the most recent to the oldest, to know if a later packet exists
+    for (uint32_t seq = uv->end_sequence; seq != uv->next_sequence;) {
+        --seq;
+        const struct sc_udp_video_packet *packet =
+            sc_udp_video_get_packet(uv, seq);
+        if (!packet->used) {
+            // Necessarily before a received packet
+            assert(later_received);
+            sc_udp_video_send_nack(uv, seq, NULL, true);
+            continue;
+        }
+
+        if (packet->received != packet->count) {
+            sc_udp_video_send_nack(uv, seq, packet, later_received);
+        }
+        later_received = true;
+    }
+}
+
+// Return the time of the last progress for the next packet: when it last
+// received a fragment, or when a later packet was received (the datagrams are
+// sent in order)
+static sc_tick
+sc_udp_video_next_progress(struct sc_udp_video *uv) {
+    struct sc_udp_video_packet *next =
+        sc_udp_video_get_packet(uv, uv->next_sequence);
+    sc_tick progress = next->used ? next->last_time : 0;
+
+    for (uint32_t seq = uv->next_sequence + 1; seq != uv->end_sequence;
+            ++seq) {
+        struct sc_udp_video_packet *packet = sc_udp_video_get_packet(uv, seq);
+        if (packet->used) {
+            progress = MAX(progress, packet->first_time);
+            break;
+        }
+    }
+
+    return progress;
+}
+
+static bool
+sc_udp_video_has_keyframe_pending(struct sc_udp_video *uv) {
+    for (uint32_t seq = uv->next_sequence; seq != uv->end_sequence; ++seq) {
+        struct sc_udp_video_packet *packet = sc_udp_video_get_packet(uv, seq);
+        if (packet->used && (packet->flags & SC_UDP_VIDEO_FLAG_KEY_FRAME)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Write the packets in order, skip the ones which are definitely lost
+static bool
+sc_udp_video_process_window(struct sc_udp_video *uv, sc_tick now) {
+    while (uv->next_sequence != uv->end_sequence) {
+        struct sc_udp_video_packet *packet =
+            sc_udp_video_get_packet(uv, uv->next_sequence);
+        if (packet->used && packet->received == packet->count) {
+            if (!sc_udp_video_write_next(uv)) {
+                return false;
+            }
+            continue;
+        }
+
+        bool config = packet->used
+                   && (packet->flags & SC_UDP_VIDEO_FLAG_CONFIG);
+        bool key = packet->used
+                && (packet->flags & SC_UDP_VIDEO_FLAG_KEY_FRAME);
+        if (uv->wait_keyframe && packet->used && !config && !key) {
+            // It could not be decoded anyway
+            if (!sc_udp_video_skip_next(uv, now)) {
+                return false;
+            }
+            continue;
+        }
+
+        sc_tick delay = now - sc_udp_video_next_progress(uv);
+        sc_tick max_delay = config ? SC_UDP_VIDEO_CONFIG_MAX_DELAY
+                                   : SC_UDP_VIDEO_MAX_DELAY;
+        if (delay >= max_delay) {
+            if (!sc_udp_video_skip_next(uv, now)) {
+                return false;
+            }
+            continue;
+        }
+
+        if (delay >= SC_UDP_VIDEO_NACK_DELAY
+                && now - uv->last_nack >= SC_UDP_VIDEO_NACK_INTERVAL) {
+            sc_udp_video_send_nacks(uv);
+            uv->last_nack = now;
+        }
+
+        // Wait for the missing fragments
+        break;
+    }
+
+    if (uv->wait_keyframe
+            && now - uv->last_keyframe_request
+                    >= SC_UDP_VIDEO_KEYFRAME_REQUEST_INTERVAL
+            && !sc_udp_video_has_keyframe_pending(uv)) {
+        // The request or the keyframe may have been lost
+        sc_udp_video_request_keyframe(uv, now);
+    }
+
+    return true;
+}
+
+static bool
+sc_udp_video_wait_header(struct sc_udp_video *uv) {
+    sc_mutex_lock(&uv->mutex);
+    while (!uv->header_forwarded && !atomic_load(&uv->stopped)) {
+        sc_cond_wait(&uv->header_cond, &uv->mutex);
+    }
+    bool ok = uv->header_forwarded;
+    sc_mutex_unlock(&uv->mutex);
+    return ok;
+}
+
+static int
+run_udp_video(void *data) {
+    struct sc_udp_video *uv = data;
+
+    sc_thread_apply_role(SC_THREAD_ROLE_DEMUXER);
+
+    // The packets must be written after the stream header
+    if (!sc_udp_video_wait_header(uv)) {
+        goto end;
+    }
+
+    uint8_t buf[SC_UDP_VIDEO_MAX_DATAGRAM_SIZE];
+    while (!atomic_load(&uv->stopped)) {
+        // Fails on timeout (SC_UDP_VIDEO_POLL_INTERVAL)
+        ssize_t r = net_recv(uv->udp_socket, buf, sizeof(buf));
+        sc_tick now = sc_tick_now();
+        if (r > 0 && !sc_udp_video_process_datagram(uv, buf, r, now)) {
+            break;
+        }
+
+        if (!sc_udp_video_process_window(uv, now)) {
+            break;
+        }
+    }
+
+end:
+    // The demuxer will receive EOF
+    net_interrupt(uv->local);
+    net_interrupt(uv->tcp_socket);
+    LOGD("UDP video receiver stopped (%" PRIu64 " fragments recovered, %"
+         PRIu64 " packets dropped)", uv->recovered, uv->dropped);
+
+    return 0;
+}
+
+static bool
+sc_udp_video_forward_header(struct sc_udp_video *uv) {
+    uint8_t header[SC_UDP_VIDEO_STREAM_HEADER_LENGTH];
+    ssize_t r = net_recv_all(uv->tcp_socket, header, 4);
+    if (r < 4) {
+        return false;
+    }
+
+    uint32_t codec_id = sc_read32be(header);
+    if (codec_id <= 1) {
+        // The device disabled the stream (there is no video size)
+        net_send_all(uv->local, header, 4);
+        return false;
+    }
+
+    size_t len = SC_UDP_VIDEO_STREAM_HEADER_LENGTH;
+    r = net_recv_all(uv->tcp_socket, &header[4], len - 4);
+    if (r < (ssize_t) (len - 4)) {
+        return false;
+    }
+
+    return net_send_all(uv->local, header, len) == (ssize_t) len;
+}
+
+static int
+run_udp_video_tcp(void *data) {
+    struct sc_udp_video *uv = data;
+
+    // The stream header is sent over TCP
+    if (!sc_udp_video_forward_header(uv)) {
+        goto end;
+    }
+
+    sc_mutex_lock(&uv->mutex);
+    uv->header_forwarded = true;
+    sc_cond_signal(&uv->header_cond);
+    sc_mutex_unlock(&uv->mutex);
+
+    // Nothing else is sent over TCP, wait for the end of the connection
+    uint8_t byte;
+    while (net_recv(uv->tcp_socket, &byte, 1) > 0) {
+        // ignore
+    }
+
+end:
+    // Also stop the receiver
+    sc_udp_video_interrupt(uv);
+    LOGD("UDP video connection closed");
+
+    return 0;
+}
+
+bool
+sc_udp_video_start(struct sc_udp_video *uv) {
+    LOGD("Starting UDP video receiver");
+
+    bool ok = sc_thread_create(&uv->tcp_thread, run_udp_video_tcp,
+                               "scrcpy-udp-tcp", uv);
+    if (!ok) {
+        LOGE("Could not start UDP video connection thread");
+        return false;
+    }
+
+    ok = sc_thread_create(&uv->thread, run_udp_video, "scrcpy-udp-video", uv);
+    if (!ok) {
+        LOGE("Could not start UDP video receiver thread");
+        sc_udp_video_interrupt(uv);
+        sc_thread_join(&uv->tcp_thread, NULL);
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_udp_video_interrupt(struct sc_udp_video *uv) {
+    sc_mutex_lock(&uv->mutex);
+    atomic_store(&uv->stopped, true);
+    sc_cond_signal(&uv->header_cond);
+    sc_mutex_unlock(&uv->mutex);
+
+    // The receiver also checks the stopped flag on each poll interval
+    net_interrupt(uv->udp_socket);
+    net_interrupt(uv->tcp_socket);
+    net_interrupt(uv->local);
+}
+
+void
+sc_udp_video_join(struct sc_udp_video *uv) {
+    sc_thread_join(&uv->thread, NULL);
+    sc_thread_join(&uv->tcp_thread, NULL);
+}
@@ -0,0 +1,122 @@
+#ifndef SC_UDP_VIDEO_H
+#define SC_UDP_VIDEO_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util/intr.h"
+#include "util/net.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+// Number of packets which may be received before the oldest incomplete one
+// is given up
+#define SC_UDP_VIDEO_WINDOW 32
+
+/**
+ * Receiver of the video packets sent over UDP (--direct-udp)
+ *
+ * The device sends the stream header (codec id and video size) over the TCP
+ * video connection, then each packet is split into datagrams:
+ *
+ *     type (1) | flags (1) | sequence (4) | index (2) | count (2)
+ *              | length (4) | payload
+ *
+ * A parity datagram (the XOR of the fragments) is sent after each group of
+ * fragments, so that one lost fragment per group can be rebuilt immediately.
+ * Otherwise, the missing fragments are requested again (NACK). If a packet is
+ * still incomplete after a short delay, it is skipped, the following packets
+ * are dropped until the next keyframe, and a keyframe is requested, instead
+ * of stalling the stream like a TCP retransmission would.
+ *
+ * The packets are written, in order, to a (loopback) socket, so that the
+ * demuxer reads the same stream as over TCP.
+ */
+
+struct sc_udp_video_packet {
+    bool used;
+    uint32_t sequence;
+    uint8_t flags;
+    uint32_t length;
+    uint16_t count; // number of data fragments
+    uint16_t received; // number of data fragments received
+    uint16_t max_index; // past the highest data fragment received
+    sc_tick first_time; // when the first datagram was received
+    sc_tick last_time; // when the last datagram was received
+    uint8_t *data; // count fragments, the last one padded with zeros
+    uint8_t *parity; // one (padded) parity fragment per group
+    uint8_t *has_fragment; // count flags
+    uint8_t *has_parity; // one flag per group
+};
+
+struct sc_udp_video {
+    sc_socket tcp_socket; // the video connection
+    sc_socket udp_socket; // connected to the device
+
+    // Pair of connected sockets: the first one is written by the receiver,
+    // the second one is exposed to the caller
+    sc_socket local;
+    sc_socket remote;
+
+    sc_thread thread; // receive the datagrams
+    sc_thread tcp_thread; // forward the stream header, detect the end
+
+    sc_mutex mutex;
+    sc_cond header_cond;
+    bool header_forwarded;
+    atomic_bool stopped;
+
+    // Accessed only from the receiver thread
+    struct sc_udp_video_packet window[SC_UDP_VIDEO_WINDOW];
+    uint32_t next_sequence; // the next packet to write
+    uint32_t end_sequence; // past the last packet received
+    sc_tick blocked_since; // 0 if the next packet is not waited for
+    sc_tick last_nack;
+    bool wait_keyframe;
+    sc_tick last_keyframe_request;
+
+    uint64_t recovered; // fragments rebuilt from the parity
+    uint64_t dropped; // packets skipped
+};
+
+/**
+ * Connect a UDP socket to the device, and send the token until the device
+ * replies
+ */
+sc_socket
+sc_udp_video_connect(struct sc_intr *intr, uint32_t host, uint16_t port,
+                     const uint8_t *token, size_t token_len);
+
+/**
+ * Initialize the receiver
+ *
+ * On success, it owns `tcp_socket` and `udp_socket`, but the caller owns the
+ * socket returned by sc_udp_video_get_socket().
+ */
+bool
+sc_udp_video_init(struct sc_udp_video *uv, sc_socket tcp_socket,
+                  sc_socket udp_socket);
+
+void
+sc_udp_video_destroy(struct sc_udp_video *uv);
+
+/**
+ * Return the socket from which the video stream must be read
+ */
+sc_socket
+sc_udp_video_get_socket(struct sc_udp_video *uv);
+
+bool
+sc_udp_video_start(struct sc_udp_video *uv);
+
+void
+sc_udp_video_interrupt(struct sc_udp_video *uv);
+
+void
+sc_udp_video_join(struct sc_udp_video *uv);
+
+#endif
@@ -0,0 +1,108 @@
+#include "gamepad_uhid.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "hid/hid_event.h"
+#include "hid/hid_gamepad.h"
+#include "input_events.h"
+#include "util/log.h"
+
+/** Downcast gamepad processor to gamepad_uhid */
+#define DOWNCAST(GP) container_of(GP, struct sc_gamepad_uhid, gamepad_processor)
+
+// The UHID ids 1 and 2 are used by the keyboard and the mouse
+#define UHID_GAMEPAD_ID_FIRST 3
+
+static void
+sc_gamepad_uhid_send_input(struct sc_gamepad_uhid *gamepad, unsigned slot,
+                           const struct sc_hid_event *event) {
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_UHID_INPUT;
+    msg.uhid_input.id = UHID_GAMEPAD_ID_FIRST + slot;
+
+    assert(event->size <= SC_HID_MAX_SIZE);
+    memcpy(msg.uhid_input.data, event->data, event->size);
+    msg.uhid_input.size = event->size;
+
+    if (!sc_controller_push_msg(gamepad->controller, &msg)) {
+        LOGE("Could not send UHID_INPUT message (gamepad)");
+    }
+}
+
+static void
+sc_gamepad_processor_process_gamepad_device(struct sc_gamepad_processor *gp,
+                                const struct sc_gamepad_device_event *event) {
+    struct sc_gamepad_uhid *gamepad = DOWNCAST(gp);
+
+    unsigned slot;
+    struct sc_control_msg msg;
+    if (event->type == SC_GAMEPAD_DEVICE_ADDED) {
+        if (!sc_hid_gamepad_add(&gamepad->hid, event->gamepad_id, &slot)) {
+            return;
+        }
+
+        msg.type = SC_CONTROL_MSG_TYPE_UHID_CREATE;
+        msg.uhid_create.id = UHID_GAMEPAD_ID_FIRST + slot;
+        msg.uhid_create.report_desc = SC_HID_GAMEPAD_REPORT_DESC;
+        msg.uhid_create.report_desc_size = SC_HID_GAMEPAD_REPORT_DESC_LEN;
+        LOGI("Gamepad added: %" PRIu32 " (slot %u)", event->gamepad_id, slot);
+    } else {
+        assert(event->type == SC_GAMEPAD_DEVICE_REMOVED);
+        if (!sc_hid_gamepad_remove(&gamepad->hid, event->gamepad_id, &slot)) {
+            return;
+        }
+
+        msg.type = SC_CONTROL_MSG_TYPE_UHID_DESTROY;
+        msg.uhid_destroy.id = UHID_GAMEPAD_ID_FIRST + slot;
+        LOGI("Gamepad removed: %" PRIu32 " (slot %u)", event->gamepad_id,
+             slot);
+    }
+
+    if (!sc_controller_push_msg(gamepad->controller, &msg)) {
+        LOGE("Could not send UHID message (gamepad device)");
+    }
+}
+
+static void
+sc_gamepad_processor_process_gamepad_axis(struct sc_gamepad_processor *gp,
+                                const struct sc_gamepad_axis_event *event) {
+    struct sc_gamepad_uhid *gamepad = DOWNCAST(gp);
+
+    unsigned slot;
+    struct sc_hid_event hid_event;
+    if (sc_hid_gamepad_event_from_axis(&gamepad->hid, event, &slot,
+                                       &hid_event)) {
+        sc_gamepad_uhid_send_input(gamepad, slot, &hid_event);
+    }
+}
+
+static void
+sc_gamepad_processor_process_gamepad_button(struct sc_gamepad_processor *gp,
+                                const struct sc_gamepad_button_event *event) {
+    struct sc_gamepad_uhid *gamepad = DOWNCAST(gp);
+
+    unsigned slot;
+    struct sc_hid_event hid_event;
+    if (sc_hid_gamepad_event_from_button(&gamepad->hid, event, &slot,
+                                         &hid_event)) {
+        sc_gamepad_uhid_send_input(gamepad, slot, &hid_event);
+    }
+}
+
+void
+sc_gamepad_uhid_init(struct sc_gamepad_uhid *gamepad,
+                     struct sc_controller *controller) {
+    sc_hid_gamepad_init(&gamepad->hid);
+
+    gamepad->controller = controller;
+
+    static const struct sc_gamepad_processor_ops ops = {
+        .process_gamepad_device = sc_gamepad_processor_process_gamepad_device,
+        .process_gamepad_axis = sc_gamepad_processor_process_gamepad_axis,
+        .process_gamepad_button = sc_gamepad_processor_process_gamepad_button,
+    };
+
+    gamepad->gamepad_processor.ops = &ops;
+}
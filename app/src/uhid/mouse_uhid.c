@@ -25,15 +25,21 @@ sc_mouse_uhid_send_input(struct sc_mouse_uhid *mouse,
     }
 }
 
+static void
+sc_mouse_uhid_on_report(struct sc_hid_mouse_pacer *pacer,
+                        const struct sc_hid_event *hid_event, void *userdata) {
+    (void) pacer;
+    struct sc_mouse_uhid *mouse = userdata;
+    sc_mouse_uhid_send_input(mouse, hid_event, "mouse");
+}
+
 static void
 sc_mouse_processor_process_mouse_motion(struct sc_mouse_processor *mp,
                                     const struct sc_mouse_motion_event *event) {
     struct sc_mouse_uhid *mouse = DOWNCAST(mp);
 
-    struct sc_hid_event hid_event;
-    sc_hid_mouse_event_from_motion(&hid_event, event);
-
-    sc_mouse_uhid_send_input(mouse, &hid_event, "mouse motion");
+    // Reported by the pacer
+    sc_hid_mouse_pacer_push_motion(&mouse->pacer, event);
 }
 
 static void
@@ -44,7 +50,8 @@ sc_mouse_processor_process_mouse_click(struct sc_mouse_processor *mp,
     struct sc_hid_event hid_event;
     sc_hid_mouse_event_from_click(&hid_event, event);
 
-    sc_mouse_uhid_send_input(mouse, &hid_event, "mouse click");
+    // Reported by the pacer (after the pending motion)
+    sc_hid_mouse_pacer_push_report(&mouse->pacer, &hid_event);
 }
 
 static void
@@ -55,14 +62,25 @@ sc_mouse_processor_process_mouse_scroll(struct sc_mouse_processor *mp,
     struct sc_hid_event hid_event;
     sc_hid_mouse_event_from_scroll(&hid_event, event);
 
-    sc_mouse_uhid_send_input(mouse, &hid_event, "mouse scroll");
+    // Reported by the pacer (after the pending motion)
+    sc_hid_mouse_pacer_push_report(&mouse->pacer, &hid_event);
 }
 
 bool
 sc_mouse_uhid_init(struct sc_mouse_uhid *mouse,
-                   struct sc_controller *controller) {
+                   struct sc_controller *controller, sc_tick report_interval) {
     mouse->controller = controller;
 
+    static const struct sc_hid_mouse_pacer_callbacks pacer_cbs = {
+        .on_report = sc_mouse_uhid_on_report,
+    };
+
+    bool ok = sc_hid_mouse_pacer_init(&mouse->pacer, report_interval,
+                                      &pacer_cbs, mouse);
+    if (!ok) {
+        return false;
+    }
+
     static const struct sc_mouse_processor_ops ops = {
         .process_mouse_motion = sc_mouse_processor_process_mouse_motion,
         .process_mouse_click = sc_mouse_processor_process_mouse_click,
@@ -82,8 +100,22 @@ sc_mouse_uhid_init(struct sc_mouse_uhid *mouse,
     msg.uhid_create.report_desc_size = SC_HID_MOUSE_REPORT_DESC_LEN;
     if (!sc_controller_push_msg(controller, &msg)) {
         LOGE("Could not send UHID_CREATE message (mouse)");
+        sc_hid_mouse_pacer_destroy(&mouse->pacer);
+        return false;
+    }
+
+    ok = sc_hid_mouse_pacer_start(&mouse->pacer);
+    if (!ok) {
+        sc_hid_mouse_pacer_destroy(&mouse->pacer);
         return false;
     }
 
     return true;
 }
+
+void
+sc_mouse_uhid_destroy(struct sc_mouse_uhid *mouse) {
+    sc_hid_mouse_pacer_stop(&mouse->pacer);
+    sc_hid_mouse_pacer_join(&mouse->pacer);
+    sc_hid_mouse_pacer_destroy(&mouse->pacer);
+}
@@ -4,16 +4,22 @@
 #include <stdbool.h>
 
 #include "controller.h"
+#include "hid/hid_mouse_pacer.h"
 #include "trait/mouse_processor.h"
+#include "util/tick.h"
 
 struct sc_mouse_uhid {
     struct sc_mouse_processor mouse_processor; // mouse processor trait
 
     struct sc_controller *controller;
+    struct sc_hid_mouse_pacer pacer;
 };
 
 bool
 sc_mouse_uhid_init(struct sc_mouse_uhid *mouse,
-                   struct sc_controller *controller);
+                   struct sc_controller *controller, sc_tick report_interval);
+
+void
+sc_mouse_uhid_destroy(struct sc_mouse_uhid *mouse);
 
 #endif
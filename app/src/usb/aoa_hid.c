@@ -2,6 +2,8 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "aoa_hid.h"
 #include "util/log.h"
@@ -15,8 +17,6 @@
 
 #define DEFAULT_TIMEOUT 1000
 
-#define SC_AOA_EVENT_QUEUE_MAX 64
-
 static void
 sc_hid_event_log(uint16_t accessory_id, const struct sc_hid_event *event) {
     // HID Event: [00] FF FF FF FF...
@@ -29,17 +29,20 @@ sc_hid_event_log(uint16_t accessory_id, const struct sc_hid_event *event) {
     free(hex);
 }
 
+static void
+sc_aoa_free_transfers(struct sc_aoa *aoa, unsigned count) {
+    for (unsigned i = 0; i < count; ++i) {
+        assert(!atomic_load(&aoa->transfers[i].busy));
+        libusb_free_transfer(aoa->transfers[i].transfer);
+    }
+}
+
 bool
 sc_aoa_init(struct sc_aoa *aoa, struct sc_usb *usb,
             struct sc_acksync *acksync) {
-    sc_vecdeque_init(&aoa->queue);
-
-    if (!sc_vecdeque_reserve(&aoa->queue, SC_AOA_EVENT_QUEUE_MAX)) {
-        return false;
-    }
+    sc_vecdeque_init_inline(&aoa->queue);
 
     if (!sc_mutex_init(&aoa->mutex)) {
-        sc_vecdeque_destroy(&aoa->queue);
         return false;
     }
 
@@ -49,6 +52,21 @@ sc_aoa_init(struct sc_aoa *aoa, struct sc_usb *usb,
         return false;
     }
 
+    for (unsigned i = 0; i < SC_AOA_MAX_IN_FLIGHT; ++i) {
+        struct sc_aoa_transfer *t = &aoa->transfers[i];
+        t->transfer = libusb_alloc_transfer(0);
+        if (!t->transfer) {
+            LOG_OOM();
+            sc_aoa_free_transfers(aoa, i);
+            sc_cond_destroy(&aoa->event_cond);
+            sc_mutex_destroy(&aoa->mutex);
+            sc_vecdeque_destroy(&aoa->queue);
+            return false;
+        }
+        t->aoa = aoa;
+        atomic_init(&t->busy, false);
+    }
+
     aoa->stopped = false;
     aoa->acksync = acksync;
     aoa->usb = usb;
@@ -58,6 +76,7 @@ sc_aoa_init(struct sc_aoa *aoa, struct sc_usb *usb,
 
 void
 sc_aoa_destroy(struct sc_aoa *aoa) {
+    sc_aoa_free_transfers(aoa, SC_AOA_MAX_IN_FLIGHT);
     sc_vecdeque_destroy(&aoa->queue);
 
     sc_cond_destroy(&aoa->event_cond);
@@ -145,9 +164,71 @@ sc_aoa_setup_hid(struct sc_aoa *aoa, uint16_t accessory_id,
     return true;
 }
 
+static void LIBUSB_CALL
+sc_aoa_on_transfer_completed(struct libusb_transfer *transfer) {
+    struct sc_aoa_transfer *t = transfer->user_data;
+
+    switch (transfer->status) {
+        case LIBUSB_TRANSFER_COMPLETED:
+        case LIBUSB_TRANSFER_CANCELLED:
+            break;
+        case LIBUSB_TRANSFER_NO_DEVICE:
+            LOGE("SEND_HID_EVENT: device disconnected");
+            sc_usb_check_disconnected(t->aoa->usb, LIBUSB_ERROR_NO_DEVICE);
+            break;
+        default:
+            LOGE("SEND_HID_EVENT: libusb transfer error: %d",
+                 (int) transfer->status);
+            break;
+    }
+
+    atomic_store(&t->busy, false);
+}
+
+static bool
+sc_aoa_is_stopped(struct sc_aoa *aoa) {
+    sc_mutex_lock(&aoa->mutex);
+    bool stopped = aoa->stopped;
+    sc_mutex_unlock(&aoa->mutex);
+    return stopped;
+}
+
+// Return a transfer not in flight, waiting for a completion if necessary
+static struct sc_aoa_transfer *
+sc_aoa_get_transfer(struct sc_aoa *aoa) {
+    for (;;) {
+        for (unsigned i = 0; i < SC_AOA_MAX_IN_FLIGHT; ++i) {
+            struct sc_aoa_transfer *t = &aoa->transfers[i];
+            if (!atomic_load(&t->busy)) {
+                return t;
+            }
+        }
+
+        if (sc_aoa_is_stopped(aoa)) {
+            return NULL;
+        }
+
+        // All the transfers are in flight. The completion callbacks are called
+        // from here (or from the libusb event thread, if any).
+        struct timeval tv = {0, 100000}; // 100ms
+        int result =
+            libusb_handle_events_timeout_completed(aoa->usb->context, &tv,
+                                                   NULL);
+        if (result < 0) {
+            LOGE("SEND_HID_EVENT: libusb error: %s", libusb_strerror(result));
+            return NULL;
+        }
+    }
+}
+
 static bool
 sc_aoa_send_hid_event(struct sc_aoa *aoa, uint16_t accessory_id,
                       const struct sc_hid_event *event) {
+    struct sc_aoa_transfer *t = sc_aoa_get_transfer(aoa);
+    if (!t) {
+        return false;
+    }
+
     uint8_t request_type = LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR;
     uint8_t request = ACCESSORY_SEND_HID_EVENT;
     // <https://source.android.com/devices/accessories/aoa2.html#hid-support>
@@ -155,12 +236,22 @@ sc_aoa_send_hid_event(struct sc_aoa *aoa, uint16_t accessory_id,
     // index (arg1): 0 (unused)
     uint16_t value = accessory_id;
     uint16_t index = 0;
-    unsigned char *data = (uint8_t *) event->data; // discard const
     uint16_t length = event->size;
-    int result = libusb_control_transfer(aoa->usb->handle, request_type,
-                                         request, value, index, data, length,
-                                         DEFAULT_TIMEOUT);
+    assert(length <= SC_HID_MAX_SIZE);
+
+    // The event is copied, it must live until the transfer completes
+    libusb_fill_control_setup(t->buffer, request_type, request, value, index,
+                              length);
+    memcpy(&t->buffer[LIBUSB_CONTROL_SETUP_SIZE], event->data, length);
+    libusb_fill_control_transfer(t->transfer, aoa->usb->handle, t->buffer,
+                                 sc_aoa_on_transfer_completed, t,
+                                 DEFAULT_TIMEOUT);
+
+    // The USB device processes the control transfers in order
+    atomic_store(&t->busy, true);
+    int result = libusb_submit_transfer(t->transfer);
     if (result < 0) {
+        atomic_store(&t->busy, false);
         LOGE("SEND_HID_EVENT: libusb error: %s", libusb_strerror(result));
         sc_usb_check_disconnected(aoa->usb, result);
         return false;
@@ -169,6 +260,41 @@ sc_aoa_send_hid_event(struct sc_aoa *aoa, uint16_t accessory_id,
     return true;
 }
 
+// Cancel the transfers in flight, and wait for their completion
+static void
+sc_aoa_cancel_transfers(struct sc_aoa *aoa) {
+    bool in_flight = false;
+    for (unsigned i = 0; i < SC_AOA_MAX_IN_FLIGHT; ++i) {
+        struct sc_aoa_transfer *t = &aoa->transfers[i];
+        if (atomic_load(&t->busy)) {
+            // It may fail if the transfer is already completed
+            libusb_cancel_transfer(t->transfer);
+            in_flight = true;
+        }
+    }
+
+    while (in_flight) {
+        struct timeval tv = {0, 100000}; // 100ms
+        int result =
+            libusb_handle_events_timeout_completed(aoa->usb->context, &tv,
+                                                   NULL);
+        if (result < 0) {
+            // The transfers may not be freed safely
+            LOGE("Could not cancel HID transfers: %s",
+                 libusb_strerror(result));
+            abort();
+        }
+
+        in_flight = false;
+        for (unsigned i = 0; i < SC_AOA_MAX_IN_FLIGHT; ++i) {
+            if (atomic_load(&aoa->transfers[i].busy)) {
+                in_flight = true;
+                break;
+            }
+        }
+    }
+}
+
 bool
 sc_aoa_unregister_hid(struct sc_aoa *aoa, uint16_t accessory_id) {
     uint8_t request_type = LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_VENDOR;
@@ -270,6 +396,8 @@ run_aoa_thread(void *data) {
             LOGW("Could not send HID event to USB device");
         }
     }
+
+    sc_aoa_cancel_transfers(aoa);
     return 0;
 }
 
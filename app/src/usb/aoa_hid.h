@@ -1,6 +1,7 @@
 #ifndef SC_AOA_HID_H
 #define SC_AOA_HID_H
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -13,15 +14,30 @@
 #include "util/tick.h"
 #include "util/vecdeque.h"
 
-#define SC_HID_MAX_SIZE 8
-
 struct sc_aoa_event {
     struct sc_hid_event hid;
     uint16_t accessory_id;
     uint64_t ack_to_wait;
 };
 
-struct sc_aoa_event_queue SC_VECDEQUE(struct sc_aoa_event);
+#define SC_AOA_EVENT_QUEUE_MAX 64
+
+struct sc_aoa_event_queue
+    SC_VECDEQUE_INLINE(struct sc_aoa_event, SC_AOA_EVENT_QUEUE_MAX);
+
+// Maximum number of HID events sent but not acknowledged by the USB device
+#define SC_AOA_MAX_IN_FLIGHT 4
+
+struct sc_aoa;
+
+struct sc_aoa_transfer {
+    struct sc_aoa *aoa;
+    struct libusb_transfer *transfer;
+    // Set by the AOA thread on submission, reset on completion (possibly from
+    // the libusb event thread)
+    atomic_bool busy;
+    uint8_t buffer[LIBUSB_CONTROL_SETUP_SIZE + SC_HID_MAX_SIZE];
+};
 
 struct sc_aoa {
     struct sc_usb *usb;
@@ -31,6 +47,11 @@ struct sc_aoa {
     bool stopped;
     struct sc_aoa_event_queue queue;
 
+    // The HID events are sent asynchronously, so that the next events do not
+    // wait for the completion of the previous ones (only used by the AOA
+    // thread)
+    struct sc_aoa_transfer transfers[SC_AOA_MAX_IN_FLIGHT];
+
     struct sc_acksync *acksync;
 };
 
@@ -11,18 +11,25 @@
 
 #define HID_MOUSE_ACCESSORY_ID 2
 
+static void
+sc_mouse_aoa_on_report(struct sc_hid_mouse_pacer *pacer,
+                       const struct sc_hid_event *hid_event, void *userdata) {
+    (void) pacer;
+    struct sc_mouse_aoa *mouse = userdata;
+
+    if (!sc_aoa_push_hid_event(mouse->aoa, HID_MOUSE_ACCESSORY_ID,
+                               hid_event)) {
+        LOGW("Could not request HID event (mouse)");
+    }
+}
+
 static void
 sc_mouse_processor_process_mouse_motion(struct sc_mouse_processor *mp,
                                     const struct sc_mouse_motion_event *event) {
     struct sc_mouse_aoa *mouse = DOWNCAST(mp);
 
-    struct sc_hid_event hid_event;
-    sc_hid_mouse_event_from_motion(&hid_event, event);
-
-    if (!sc_aoa_push_hid_event(mouse->aoa, HID_MOUSE_ACCESSORY_ID,
-                               &hid_event)) {
-        LOGW("Could not request HID event (mouse motion)");
-    }
+    // Reported by the pacer
+    sc_hid_mouse_pacer_push_motion(&mouse->pacer, event);
 }
 
 static void
@@ -33,10 +40,8 @@ sc_mouse_processor_process_mouse_click(struct sc_mouse_processor *mp,
     struct sc_hid_event hid_event;
     sc_hid_mouse_event_from_click(&hid_event, event);
 
-    if (!sc_aoa_push_hid_event(mouse->aoa, HID_MOUSE_ACCESSORY_ID,
-                               &hid_event)) {
-        LOGW("Could not request HID event (mouse click)");
-    }
+    // Reported by the pacer (after the pending motion)
+    sc_hid_mouse_pacer_push_report(&mouse->pacer, &hid_event);
 }
 
 static void
@@ -47,21 +52,38 @@ sc_mouse_processor_process_mouse_scroll(struct sc_mouse_processor *mp,
     struct sc_hid_event hid_event;
     sc_hid_mouse_event_from_scroll(&hid_event, event);
 
-    if (!sc_aoa_push_hid_event(mouse->aoa, HID_MOUSE_ACCESSORY_ID,
-                               &hid_event)) {
-        LOGW("Could not request HID event (mouse scroll)");
-    }
+    // Reported by the pacer (after the pending motion)
+    sc_hid_mouse_pacer_push_report(&mouse->pacer, &hid_event);
 }
 
 bool
-sc_mouse_aoa_init(struct sc_mouse_aoa *mouse, struct sc_aoa *aoa) {
+sc_mouse_aoa_init(struct sc_mouse_aoa *mouse, struct sc_aoa *aoa,
+                  sc_tick report_interval) {
     mouse->aoa = aoa;
 
-    bool ok = sc_aoa_setup_hid(aoa, HID_MOUSE_ACCESSORY_ID,
-                               SC_HID_MOUSE_REPORT_DESC,
-                               SC_HID_MOUSE_REPORT_DESC_LEN);
+    static const struct sc_hid_mouse_pacer_callbacks pacer_cbs = {
+        .on_report = sc_mouse_aoa_on_report,
+    };
+
+    bool ok = sc_hid_mouse_pacer_init(&mouse->pacer, report_interval,
+                                      &pacer_cbs, mouse);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_aoa_setup_hid(aoa, HID_MOUSE_ACCESSORY_ID,
+                          SC_HID_MOUSE_REPORT_DESC,
+                          SC_HID_MOUSE_REPORT_DESC_LEN);
     if (!ok) {
         LOGW("Register HID mouse failed");
+        sc_hid_mouse_pacer_destroy(&mouse->pacer);
+        return false;
+    }
+
+    ok = sc_hid_mouse_pacer_start(&mouse->pacer);
+    if (!ok) {
+        sc_aoa_unregister_hid(aoa, HID_MOUSE_ACCESSORY_ID);
+        sc_hid_mouse_pacer_destroy(&mouse->pacer);
         return false;
     }
 
@@ -82,6 +104,10 @@ sc_mouse_aoa_init(struct sc_mouse_aoa *mouse, struct sc_aoa *aoa) {
 
 void
 sc_mouse_aoa_destroy(struct sc_mouse_aoa *mouse) {
+    sc_hid_mouse_pacer_stop(&mouse->pacer);
+    sc_hid_mouse_pacer_join(&mouse->pacer);
+    sc_hid_mouse_pacer_destroy(&mouse->pacer);
+
     bool ok = sc_aoa_unregister_hid(mouse->aoa, HID_MOUSE_ACCESSORY_ID);
     if (!ok) {
         LOGW("Could not unregister HID mouse");
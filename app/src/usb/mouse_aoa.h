@@ -6,16 +6,20 @@
 #include <stdbool.h>
 
 #include "aoa_hid.h"
+#include "hid/hid_mouse_pacer.h"
 #include "trait/mouse_processor.h"
+#include "util/tick.h"
 
 struct sc_mouse_aoa {
     struct sc_mouse_processor mouse_processor; // mouse processor trait
 
     struct sc_aoa *aoa;
+    struct sc_hid_mouse_pacer pacer;
 };
 
 bool
-sc_mouse_aoa_init(struct sc_mouse_aoa *mouse, struct sc_aoa *aoa);
+sc_mouse_aoa_init(struct sc_mouse_aoa *mouse, struct sc_aoa *aoa,
+                  sc_tick report_interval);
 
 void
 sc_mouse_aoa_destroy(struct sc_mouse_aoa *mouse);
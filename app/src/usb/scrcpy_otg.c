@@ -1,5 +1,8 @@
 #include "scrcpy_otg.h"
 
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL.h>
 
 #include "adb/adb.h"
@@ -7,6 +10,9 @@
 #include "screen_otg.h"
 #include "util/log.h"
 
+// Interval between two attempts to find the device while it is disconnected
+#define SC_OTG_RECONNECT_POLL_MS 1000
+
 struct scrcpy_otg {
     struct sc_usb usb;
     struct sc_aoa aoa;
@@ -14,6 +20,13 @@ struct scrcpy_otg {
     struct sc_mouse_aoa mouse;
 
     struct sc_screen_otg screen_otg;
+
+    bool enable_keyboard;
+    bool enable_mouse;
+    sc_tick mouse_report_interval;
+
+    // The USB device is connected and HID over AOA is started
+    bool connected;
 };
 
 static void
@@ -29,14 +42,127 @@ sc_usb_on_disconnected(struct sc_usb *usb, void *userdata) {
     }
 }
 
+// Connect to the USB device, and start HID over AOA
+static bool
+otg_connect(struct scrcpy_otg *s, libusb_device *device) {
+    static const struct sc_usb_callbacks cbs = {
+        .on_disconnected = sc_usb_on_disconnected,
+    };
+    bool ok = sc_usb_connect(&s->usb, device, &cbs, NULL);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_aoa_init(&s->aoa, &s->usb, NULL);
+    if (!ok) {
+        goto error_usb_disconnect;
+    }
+
+    if (s->enable_keyboard) {
+        ok = sc_keyboard_aoa_init(&s->keyboard, &s->aoa);
+        if (!ok) {
+            goto error_aoa_destroy;
+        }
+    }
+
+    if (s->enable_mouse) {
+        ok = sc_mouse_aoa_init(&s->mouse, &s->aoa, s->mouse_report_interval);
+        if (!ok) {
+            goto error_keyboard_destroy;
+        }
+    }
+
+    ok = sc_aoa_start(&s->aoa);
+    if (!ok) {
+        goto error_mouse_destroy;
+    }
+
+    s->connected = true;
+    return true;
+
+error_mouse_destroy:
+    if (s->enable_mouse) {
+        sc_mouse_aoa_destroy(&s->mouse);
+    }
+error_keyboard_destroy:
+    if (s->enable_keyboard) {
+        sc_keyboard_aoa_destroy(&s->keyboard);
+    }
+error_aoa_destroy:
+    sc_aoa_destroy(&s->aoa);
+error_usb_disconnect:
+    sc_usb_stop(&s->usb);
+    sc_usb_join(&s->usb);
+    sc_usb_disconnect(&s->usb);
+    return false;
+}
+
+static void
+otg_disconnect(struct scrcpy_otg *s) {
+    assert(s->connected);
+
+    sc_aoa_stop(&s->aoa);
+    sc_usb_stop(&s->usb);
+
+    if (s->enable_mouse) {
+        sc_mouse_aoa_destroy(&s->mouse);
+    }
+    if (s->enable_keyboard) {
+        sc_keyboard_aoa_destroy(&s->keyboard);
+    }
+
+    sc_aoa_join(&s->aoa);
+    sc_aoa_destroy(&s->aoa);
+
+    sc_usb_join(&s->usb);
+    sc_usb_disconnect(&s->usb);
+
+    s->connected = false;
+}
+
+static void
+otg_try_reconnect(struct scrcpy_otg *s, const char *serial) {
+    struct sc_usb_device usb_device;
+    if (!sc_usb_find_device(&s->usb, serial, &usb_device)) {
+        // Not connected yet
+        return;
+    }
+
+    LOGI("Device %s connected", serial);
+    if (otg_connect(s, usb_device.device)) {
+        sc_screen_otg_set_input_enabled(&s->screen_otg, true);
+    } else {
+        LOGW("Could not resume the session, retrying...");
+    }
+
+    sc_usb_device_destroy(&usb_device);
+}
+
 static enum scrcpy_exit_code
-event_loop(struct scrcpy_otg *s) {
+event_loop(struct scrcpy_otg *s, bool reconnect, const char *serial) {
     SDL_Event event;
-    while (SDL_WaitEvent(&event)) {
+    for (;;) {
+        if (s->connected) {
+            if (!SDL_WaitEvent(&event)) {
+                break;
+            }
+        } else if (!SDL_WaitEventTimeout(&event, SC_OTG_RECONNECT_POLL_MS)) {
+            // Timeout (or error): look for the device again
+            otg_try_reconnect(s, serial);
+            continue;
+        }
+
         switch (event.type) {
             case SC_EVENT_USB_DEVICE_DISCONNECTED:
                 LOGW("Device disconnected");
-                return SCRCPY_EXIT_DISCONNECTED;
+                if (!reconnect) {
+                    return SCRCPY_EXIT_DISCONNECTED;
+                }
+                otg_disconnect(s);
+                sc_screen_otg_set_input_enabled(&s->screen_otg, false);
+                LOGI("Waiting for device %s to be connected again...",
+                     serial);
+                break;
             case SDL_QUIT:
                 LOGD("User requested to quit");
                 return SCRCPY_EXIT_SUCCESS;
@@ -73,12 +199,9 @@ scrcpy_otg(struct scrcpy_options *options) {
 
     enum scrcpy_exit_code ret = SCRCPY_EXIT_FAILURE;
 
-    struct sc_keyboard_aoa *keyboard = NULL;
-    struct sc_mouse_aoa *mouse = NULL;
     bool usb_device_initialized = false;
-    bool usb_connected = false;
-    bool aoa_started = false;
-    bool aoa_initialized = false;
+    char *device_serial = NULL;
+    s->connected = false;
 
 #ifdef _WIN32
     // On Windows, only one process could open a USB device
@@ -89,9 +212,6 @@ scrcpy_otg(struct scrcpy_options *options) {
     sc_adb_kill_server(NULL, flags);
 #endif
 
-    static const struct sc_usb_callbacks cbs = {
-        .on_disconnected = sc_usb_on_disconnected,
-    };
     bool ok = sc_usb_init(&s->usb);
     if (!ok) {
         return SCRCPY_EXIT_FAILURE;
@@ -105,58 +225,41 @@ scrcpy_otg(struct scrcpy_options *options) {
 
     usb_device_initialized = true;
 
-    ok = sc_usb_connect(&s->usb, usb_device.device, &cbs, NULL);
-    if (!ok) {
-        goto end;
-    }
-    usb_connected = true;
-
-    ok = sc_aoa_init(&s->aoa, &s->usb, NULL);
-    if (!ok) {
-        goto end;
-    }
-    aoa_initialized = true;
-
     assert(options->keyboard_input_mode == SC_KEYBOARD_INPUT_MODE_AOA
         || options->keyboard_input_mode == SC_KEYBOARD_INPUT_MODE_DISABLED);
     assert(options->mouse_input_mode == SC_MOUSE_INPUT_MODE_AOA
         || options->mouse_input_mode == SC_MOUSE_INPUT_MODE_DISABLED);
 
-    bool enable_keyboard =
+    s->enable_keyboard =
         options->keyboard_input_mode == SC_KEYBOARD_INPUT_MODE_AOA;
-    bool enable_mouse =
+    s->enable_mouse =
         options->mouse_input_mode == SC_MOUSE_INPUT_MODE_AOA;
+    s->mouse_report_interval = options->mouse_report_interval;
 
-    if (enable_keyboard) {
-        ok = sc_keyboard_aoa_init(&s->keyboard, &s->aoa);
-        if (!ok) {
-            goto end;
-        }
-        keyboard = &s->keyboard;
-    }
-
-    if (enable_mouse) {
-        ok = sc_mouse_aoa_init(&s->mouse, &s->aoa);
-        if (!ok) {
+    if (options->otg_reconnect) {
+        // The serial to find the device again once disconnected
+        device_serial = strdup(usb_device.serial);
+        if (!device_serial) {
+            LOG_OOM();
             goto end;
         }
-        mouse = &s->mouse;
     }
 
-    ok = sc_aoa_start(&s->aoa);
+    ok = otg_connect(s, usb_device.device);
     if (!ok) {
         goto end;
     }
-    aoa_started = true;
 
     const char *window_title = options->window_title;
     if (!window_title) {
         window_title = usb_device.product ? usb_device.product : "scrcpy";
     }
 
+    // The keyboard and mouse are re-initialized at the same addresses on
+    // reconnection, so the screen may keep them
     struct sc_screen_otg_params params = {
-        .keyboard = keyboard,
-        .mouse = mouse,
+        .keyboard = s->enable_keyboard ? &s->keyboard : NULL,
+        .mouse = s->enable_mouse ? &s->mouse : NULL,
         .window_title = window_title,
         .always_on_top = options->always_on_top,
         .window_x = options->window_x,
@@ -175,37 +278,20 @@ scrcpy_otg(struct scrcpy_options *options) {
     sc_usb_device_destroy(&usb_device);
     usb_device_initialized = false;
 
-    ret = event_loop(s);
+    ret = event_loop(s, options->otg_reconnect, device_serial);
     LOGD("quit...");
 
 end:
-    if (aoa_started) {
-        sc_aoa_stop(&s->aoa);
-    }
-    sc_usb_stop(&s->usb);
-
-    if (mouse) {
-        sc_mouse_aoa_destroy(&s->mouse);
-    }
-    if (keyboard) {
-        sc_keyboard_aoa_destroy(&s->keyboard);
-    }
-
-    if (aoa_initialized) {
-        sc_aoa_join(&s->aoa);
-        sc_aoa_destroy(&s->aoa);
-    }
-
-    sc_usb_join(&s->usb);
-
-    if (usb_connected) {
-        sc_usb_disconnect(&s->usb);
+    if (s->connected) {
+        otg_disconnect(s);
     }
 
     if (usb_device_initialized) {
         sc_usb_device_destroy(&usb_device);
     }
 
+    free(device_serial);
+
     sc_usb_destroy(&s->usb);
 
     return ret;
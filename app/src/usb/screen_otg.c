@@ -61,6 +61,7 @@ sc_screen_otg_init(struct sc_screen_otg *screen,
     screen->mouse = params->mouse;
 
     screen->mouse_capture_key_pressed = 0;
+    screen->input_enabled = true;
 
     const char *title = params->window_title;
     assert(title);
@@ -216,6 +217,20 @@ sc_screen_otg_process_mouse_wheel(struct sc_screen_otg *screen,
     mp->ops->process_mouse_scroll(mp, &evt);
 }
 
+void
+sc_screen_otg_set_input_enabled(struct sc_screen_otg *screen, bool enabled) {
+    if (screen->input_enabled == enabled) {
+        return;
+    }
+
+    screen->input_enabled = enabled;
+    screen->mouse_capture_key_pressed = 0;
+    if (screen->mouse) {
+        // Give the mouse back to the computer while the input is disabled
+        sc_screen_otg_set_mouse_capture(screen, enabled);
+    }
+}
+
 void
 sc_screen_otg_handle_event(struct sc_screen_otg *screen, SDL_Event *event) {
     switch (event->type) {
@@ -231,6 +246,13 @@ sc_screen_otg_handle_event(struct sc_screen_otg *screen, SDL_Event *event) {
                     break;
             }
             return;
+    }
+
+    if (!screen->input_enabled) {
+        return;
+    }
+
+    switch (event->type) {
         case SDL_KEYDOWN:
             if (screen->mouse) {
                 SDL_Keycode key = event->key.keysym.sym;
@@ -19,6 +19,10 @@ struct sc_screen_otg {
 
     // See equivalent mechanism in screen.h
     SDL_Keycode mouse_capture_key_pressed;
+
+    // If false, the input events are not forwarded (the keyboard and mouse
+    // must not be used)
+    bool input_enabled;
 };
 
 struct sc_screen_otg_params {
@@ -41,6 +45,14 @@ sc_screen_otg_init(struct sc_screen_otg *screen,
 void
 sc_screen_otg_destroy(struct sc_screen_otg *screen);
 
+/**
+ * Enable or disable the input (for example while the device is disconnected)
+ *
+ * The mouse is captured again once the input is re-enabled.
+ */
+void
+sc_screen_otg_set_input_enabled(struct sc_screen_otg *screen, bool enabled);
+
 void
 sc_screen_otg_handle_event(struct sc_screen_otg *screen, SDL_Event *event);
 
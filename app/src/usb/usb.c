@@ -222,6 +222,29 @@ sc_usb_select_device(struct sc_usb *usb, const char *serial,
     return true;
 }
 
+bool
+sc_usb_find_device(struct sc_usb *usb, const char *serial,
+                   struct sc_usb_device *out_device) {
+    assert(serial);
+
+    struct sc_vec_usb_devices vec = SC_VECTOR_INITIALIZER;
+    bool ok = sc_usb_list_devices(usb, &vec);
+    if (!ok) {
+        return false;
+    }
+
+    size_t sel_idx; // index of the single matching device if sel_count == 1
+    size_t sel_count =
+        sc_usb_devices_select(vec.data, vec.size, serial, &sel_idx);
+    if (sel_count == 1) {
+        // Move device into out_device (do not destroy device)
+        sc_usb_device_move(out_device, &vec.data[sel_idx]);
+    }
+
+    sc_usb_devices_destroy(&vec);
+    return sel_count == 1;
+}
+
 bool
 sc_usb_init(struct sc_usb *usb) {
     usb->handle = NULL;
@@ -67,6 +67,15 @@ bool
 sc_usb_select_device(struct sc_usb *usb, const char *serial,
                      struct sc_usb_device *out_device);
 
+/**
+ * Find the device having the given serial, without logging if it is not found
+ *
+ * Useful to wait for a known device to be (re)connected.
+ */
+bool
+sc_usb_find_device(struct sc_usb *usb, const char *serial,
+                   struct sc_usb_device *out_device);
+
 bool
 sc_usb_connect(struct sc_usb *usb, libusb_device *device,
                const struct sc_usb_callbacks *cbs, void *cbs_userdata);
@@ -23,6 +23,7 @@ sc_audiobuf_init(struct sc_audiobuf *buf, size_t sample_size,
     buf->sample_size = sample_size;
     atomic_init(&buf->head, 0);
     atomic_init(&buf->tail, 0);
+    atomic_init(&buf->skip, 0);
 
     return true;
 }
@@ -46,6 +47,23 @@ sc_audiobuf_read(struct sc_audiobuf *buf, void *to_, uint32_t samples_count) {
     uint32_t head = atomic_load_explicit(&buf->head, memory_order_acquire);
 
     uint32_t can_read = (buf->alloc_size + head - tail) % buf->alloc_size;
+
+    uint32_t skip = atomic_load_explicit(&buf->skip, memory_order_acquire);
+    if (skip) {
+        // Drop the oldest samples, as requested by the writer
+        uint32_t skipped = skip < can_read ? skip : can_read;
+        tail = (tail + skipped) % buf->alloc_size;
+        can_read -= skipped;
+
+        // The tail cursor must be updated before the skip counter, so that
+        // sc_audiobuf_can_read() never observes the old tail with the new skip
+        // counter
+        atomic_store_explicit(&buf->tail, tail, memory_order_release);
+        // If there were fewer samples than requested, the remaining skip
+        // request is obsolete
+        atomic_fetch_sub_explicit(&buf->skip, skip, memory_order_release);
+    }
+
     if (samples_count > can_read) {
         samples_count = can_read;
     }
@@ -22,6 +22,11 @@ struct sc_audiobuf {
     atomic_uint_least32_t tail; // reader cursor, in samples
     // empty: tail == head
     // full: ((tail + 1) % alloc_size) == head
+
+    // Number of old samples to drop, requested by the writer and applied by
+    // the reader on its next read (so that the writer never needs to
+    // synchronize with the reader)
+    atomic_uint_least32_t skip;
 };
 
 static inline uint32_t
@@ -49,6 +54,17 @@ uint32_t
 sc_audiobuf_write(struct sc_audiobuf *buf, const void *from,
                   uint32_t samples_count);
 
+/**
+ * Request to drop the oldest samples (called from the writer thread)
+ *
+ * The samples are dropped by the reader on its next read. They are not
+ * counted by sc_audiobuf_can_read() anymore.
+ */
+static inline void
+sc_audiobuf_skip(struct sc_audiobuf *buf, uint32_t samples_count) {
+    atomic_fetch_add_explicit(&buf->skip, samples_count, memory_order_release);
+}
+
 static inline uint32_t
 sc_audiobuf_capacity(struct sc_audiobuf *buf) {
     assert(buf->alloc_size);
@@ -57,9 +73,14 @@ sc_audiobuf_capacity(struct sc_audiobuf *buf) {
 
 static inline uint32_t
 sc_audiobuf_can_read(struct sc_audiobuf *buf) {
+    // The skip counter must be loaded before the tail cursor (the reader
+    // updates them in the reverse order), so that skipped samples are never
+    // counted twice
+    uint32_t skip = atomic_load_explicit(&buf->skip, memory_order_acquire);
     uint32_t head = atomic_load_explicit(&buf->head, memory_order_acquire);
     uint32_t tail = atomic_load_explicit(&buf->tail, memory_order_acquire);
-    return (buf->alloc_size + head - tail) % buf->alloc_size;
+    uint32_t can_read = (buf->alloc_size + head - tail) % buf->alloc_size;
+    return can_read > skip ? can_read - skip : 0;
 }
 
 #endif
@@ -27,6 +27,12 @@ sc_write64be(uint8_t *buf, uint64_t value) {
     sc_write32be(&buf[4], (uint32_t) value);
 }
 
+static inline void
+sc_write16le(uint8_t *buf, uint16_t value) {
+    buf[0] = value;
+    buf[1] = value >> 8;
+}
+
 static inline uint16_t
 sc_read16be(const uint8_t *buf) {
     return (buf[0] << 8) | buf[1];
@@ -73,4 +79,26 @@ sc_float_to_i16fp(float f) {
     return (int16_t) i;
 }
 
+/**
+ * Convert an unsigned 16-bit fixed-point value to a float between 0 and 1
+ *
+ * This is the inverse of sc_float_to_u16fp().
+ */
+static inline float
+sc_u16fp_to_float(uint16_t u) {
+    // 0xffff is the representation of 1.0f
+    return u == 0xffff ? 1.0f : u * 0x1p-16f;
+}
+
+/**
+ * Convert a signed 16-bit fixed-point value to a float between -1 and 1
+ *
+ * This is the inverse of sc_float_to_i16fp().
+ */
+static inline float
+sc_i16fp_to_float(int16_t i) {
+    // 0x7fff is the representation of 1.0f
+    return i == 0x7fff ? 1.0f : i * 0x1p-15f;
+}
+
 #endif
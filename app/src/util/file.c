@@ -1,5 +1,6 @@
 #include "file.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -46,3 +47,81 @@ sc_file_get_local_path(const char *name) {
     return file_path;
 }
 
+
+char *
+sc_file_get_numbered_path(const char *path, unsigned index) {
+    const char *ext = strrchr(path, '.');
+    const char *sep = strrchr(path, SC_PATH_SEPARATOR);
+    if (!ext || (sep && ext < sep)) {
+        // No extension
+        ext = path + strlen(path);
+    }
+
+    size_t stem_len = ext - path;
+    // '-' + up to 10 digits + '\0'
+    size_t len = stem_len + strlen(ext) + 12;
+    char *result = malloc(len);
+    if (!result) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    snprintf(result, len, "%.*s-%04u%s", (int) stem_len, path, index, ext);
+    return result;
+}
+
+char *
+sc_file_get_suffixed_path(const char *path, const char *suffix) {
+    const char *ext = strrchr(path, '.');
+    const char *sep = strrchr(path, SC_PATH_SEPARATOR);
+    if (!ext || (sep && ext < sep)) {
+        // No extension
+        ext = path + strlen(path);
+    }
+
+    size_t stem_len = ext - path;
+    // '-' + suffix + '\0'
+    size_t len = stem_len + strlen(suffix) + strlen(ext) + 2;
+    char *result = malloc(len);
+    if (!result) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    snprintf(result, len, "%.*s-%s%s", (int) stem_len, path, suffix, ext);
+    return result;
+}
+
+bool
+sc_file_hash(const char *path, uint64_t *hash, uint64_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        LOGD("Could not open file: %s", path);
+        return false;
+    }
+
+    // FNV-1a
+    uint64_t h = UINT64_C(0xcbf29ce484222325);
+    uint64_t total = 0;
+
+    unsigned char buf[4096];
+    size_t r;
+    while ((r = fread(buf, 1, sizeof(buf), file)) > 0) {
+        for (size_t i = 0; i < r; ++i) {
+            h ^= buf[i];
+            h *= UINT64_C(0x100000001b3);
+        }
+        total += r;
+    }
+
+    bool error = ferror(file);
+    fclose(file);
+    if (error) {
+        LOGD("Could not read file: %s", path);
+        return false;
+    }
+
+    *hash = h;
+    *size = total;
+    return true;
+}
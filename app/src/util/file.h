@@ -4,6 +4,7 @@
 #include "common.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef _WIN32
 # define SC_PATH_SEPARATOR '\\'
@@ -40,10 +41,54 @@ sc_file_get_executable_path(void);
 char *
 sc_file_get_local_path(const char *name);
 
+/**
+ * Return the path with an index inserted before the extension
+ *
+ * For example, "file.mp4" with index 1 gives "file-0001.mp4".
+ *
+ * The result must be freed by the caller using free(). It may return NULL on
+ * error.
+ */
+char *
+sc_file_get_numbered_path(const char *path, unsigned index);
+
+/**
+ * Return the path with a suffix inserted before the extension
+ *
+ * For example, "file.mp4" with suffix "abc" gives "file-abc.mp4".
+ *
+ * The result must be freed by the caller using free(). It may return NULL on
+ * error.
+ */
+char *
+sc_file_get_suffixed_path(const char *path, const char *suffix);
+
 /**
  * Indicate if the file exists and is not a directory
  */
 bool
 sc_file_is_regular(const char *path);
 
+/**
+ * Get the size of a file, in bytes
+ *
+ * Return false on error.
+ */
+bool
+sc_file_get_size(const char *path, uint64_t *size);
+
+/**
+ * Compute a (non-cryptographic) 64-bit hash of the file content, and its size
+ *
+ * Return false on error.
+ */
+bool
+sc_file_hash(const char *path, uint64_t *hash, uint64_t *size);
+
+/**
+ * Remove a file
+ */
+bool
+sc_file_remove(const char *path);
+
 #endif
@@ -0,0 +1,80 @@
+#include "gain.h"
+
+#include <assert.h>
+#include <string.h>
+
+void
+sc_gain_apply(float *restrict samples, size_t count, float gain) {
+    for (size_t i = 0; i < count; ++i) {
+        samples[i] *= gain;
+    }
+}
+
+void
+sc_gain_mix(float *restrict dst, const float *restrict src, size_t count,
+            float gain) {
+    for (size_t i = 0; i < count; ++i) {
+        dst[i] += gain * src[i];
+    }
+}
+
+float
+sc_gain_apply_fade_in(float *restrict samples, uint32_t frames,
+                      unsigned channels, float gain, float fade, float step) {
+    assert(channels);
+    assert(step > 0);
+
+    if (fade >= 1) {
+        sc_gain_apply(samples, (size_t) frames * channels, gain);
+        return 1;
+    }
+
+    // Number of frames before the fade-in is complete
+    float remaining = (1 - fade) / step;
+    uint32_t ramp_frames = remaining < frames ? (uint32_t) remaining : frames;
+
+    for (uint32_t i = 0; i < ramp_frames; ++i) {
+        // Computed from the index (not accumulated), so that the iterations
+        // are independent
+        float factor = gain * (fade + i * step);
+        for (unsigned c = 0; c < channels; ++c) {
+            samples[i * channels + c] *= factor;
+        }
+    }
+
+    sc_gain_apply(samples + (size_t) ramp_frames * channels,
+                  (size_t) (frames - ramp_frames) * channels, gain);
+
+    if (ramp_frames == frames) {
+        fade += frames * step;
+        return fade < 1 ? fade : 1;
+    }
+
+    return 1;
+}
+
+uint32_t
+sc_gain_conceal(float *restrict dst, uint32_t frames, unsigned channels,
+                const float *restrict history, uint32_t history_frames,
+                uint32_t offset) {
+    assert(channels);
+    assert(offset <= history_frames);
+
+    uint32_t remaining = history_frames - offset;
+    uint32_t conceal_frames = remaining < frames ? remaining : frames;
+
+    for (uint32_t i = 0; i < conceal_frames; ++i) {
+        uint32_t pos = offset + i;
+        float factor = 1 - (float) (pos + 1) / history_frames;
+        const float *src = &history[(size_t) (history_frames - 1 - pos)
+                                                                  * channels];
+        for (unsigned c = 0; c < channels; ++c) {
+            dst[i * channels + c] = factor * src[c];
+        }
+    }
+
+    memset(dst + (size_t) conceal_frames * channels, 0,
+           (size_t) (frames - conceal_frames) * channels * sizeof(float));
+
+    return offset + conceal_frames;
+}
@@ -0,0 +1,57 @@
+#ifndef SC_GAIN_H
+#define SC_GAIN_H
+
+#include "common.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Gain kernels for interleaved float audio samples
+ *
+ * They are written as simple loops over contiguous samples without aliasing,
+ * so that the compiler vectorizes them.
+ */
+
+/**
+ * Multiply `count` samples by `gain`
+ */
+void
+sc_gain_apply(float *restrict samples, size_t count, float gain);
+
+/**
+ * Add `count` samples from `src`, multiplied by `gain`, to `dst`
+ */
+void
+sc_gain_mix(float *restrict dst, const float *restrict src, size_t count,
+            float gain);
+
+/**
+ * Multiply `frames` frames of `channels` interleaved samples by `gain` and by
+ * a fade-in factor, starting at `fade` and increasing by `step` per frame up
+ * to 1
+ *
+ * Return the fade-in factor after the last frame (1 once the fade-in is
+ * complete).
+ */
+float
+sc_gain_apply_fade_in(float *restrict samples, uint32_t frames,
+                      unsigned channels, float gain, float fade, float step);
+
+/**
+ * Write `frames` frames of `channels` interleaved samples to `dst` to conceal
+ * missing samples
+ *
+ * The `history_frames` last frames played are played backwards (so that the
+ * signal continues from the last sample played), fading out from 1 to 0 over
+ * the history, then followed by silence. The concealment starts at `offset`
+ * frames in the history (0 on a new underflow).
+ *
+ * Return the new offset (`history_frames` once the fade-out is complete).
+ */
+uint32_t
+sc_gain_conceal(float *restrict dst, uint32_t frames, unsigned channels,
+                const float *restrict history, uint32_t history_frames,
+                uint32_t offset);
+
+#endif
@@ -3,6 +3,8 @@
 
 #include "common.h"
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 struct sc_intmap_entry {
@@ -10,13 +12,21 @@ struct sc_intmap_entry {
     int32_t value;
 };
 
+/**
+ * Find the entry for the key, in O(log(len))
+ *
+ * The entries must be sorted by key (without duplicates).
+ */
 const struct sc_intmap_entry *
 sc_intmap_find_entry(const struct sc_intmap_entry entries[], size_t len,
                      int32_t key);
 
+bool
+sc_intmap_is_sorted(const struct sc_intmap_entry entries[], size_t len);
+
 /**
- * MAP is expected to be a static array of sc_intmap_entry, so that
- * ARRAY_LEN(MAP) can be computed statically.
+ * MAP is expected to be a static array of sc_intmap_entry, sorted by key, so
+ * that ARRAY_LEN(MAP) can be computed statically.
  */
 #define SC_INTMAP_FIND_ENTRY(MAP, KEY) \
     sc_intmap_find_entry(MAP, ARRAY_LEN(MAP), KEY)
@@ -4,8 +4,54 @@
 # include <windows.h>
 #endif
 #include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <libavformat/avformat.h>
 
+#include "thread.h"
+#include "tick.h"
+
+// Number of messages the log queue may hold (must be a power of 2)
+#define SC_LOG_QUEUE_SIZE 1024
+// Most messages are stored in the slot, the longer ones are allocated
+#define SC_LOG_SLOT_MESSAGE_SIZE 256
+// The printer thread is woken up on each message, but a wakeup may be missed
+// (the producers do not lock the mutex), so it also polls the queue
+#define SC_LOG_POLL_INTERVAL SC_TICK_FROM_MS(100)
+
+/**
+ * The log messages are printed by a separate thread, so that the threads
+ * which log (typically with a verbose log level) are not blocked on the I/O.
+ *
+ * The messages are pushed to a bounded lock-free multi-producer
+ * single-consumer queue: each slot has a sequence number, telling if it is
+ * free for the producer at the position or ready for the consumer. If the
+ * queue is full (or if the printer thread is not running), the message is
+ * printed synchronously, so that it is never lost.
+ */
+struct sc_log_slot {
+    atomic_size_t seq;
+    SDL_LogPriority priority;
+    char *message; // points to buf or to an allocated string
+    char buf[SC_LOG_SLOT_MESSAGE_SIZE];
+};
+
+static struct {
+    struct sc_log_slot slots[SC_LOG_QUEUE_SIZE];
+    atomic_size_t enqueue_pos;
+    size_t dequeue_pos; // only accessed by the printer thread
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    atomic_bool running;
+    atomic_bool stopped;
+    atomic_bool sleeping;
+} sc_log_queue;
+
 static SDL_LogPriority
 log_level_sc_to_sdl(enum sc_log_level level) {
     switch (level) {
@@ -134,21 +180,198 @@ static const char *const sc_sdl_log_priority_names[SDL_NUM_LOG_PRIORITIES] = {
     [SDL_LOG_PRIORITY_CRITICAL] = "CRITICAL",
 };
 
+static void
+sc_log_print(SDL_LogPriority priority, const char *message) {
+    FILE *out = priority < SDL_LOG_PRIORITY_WARN ? stdout : stderr;
+    assert(priority < SDL_NUM_LOG_PRIORITIES);
+    const char *prio_name = sc_sdl_log_priority_names[priority];
+    fprintf(out, "%s: %s\n", prio_name, message);
+}
+
+// Called from any thread
+static bool
+sc_log_queue_push(SDL_LogPriority priority, const char *message) {
+    size_t pos = atomic_load_explicit(&sc_log_queue.enqueue_pos,
+                                      memory_order_relaxed);
+    struct sc_log_slot *slot;
+    for (;;) {
+        slot = &sc_log_queue.slots[pos & (SC_LOG_QUEUE_SIZE - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if (!diff) {
+            // The slot is free, reserve it
+            if (atomic_compare_exchange_weak_explicit(
+                        &sc_log_queue.enqueue_pos, &pos, pos + 1,
+                        memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+            // pos has been updated, retry
+        } else if (diff < 0) {
+            // The slot has not been consumed yet: the queue is full
+            return false;
+        } else {
+            // Another producer has reserved the slot
+            pos = atomic_load_explicit(&sc_log_queue.enqueue_pos,
+                                       memory_order_relaxed);
+        }
+    }
+
+    size_t len = strlen(message);
+    if (len < sizeof(slot->buf)) {
+        memcpy(slot->buf, message, len + 1);
+        slot->message = slot->buf;
+    } else {
+        slot->message = strdup(message);
+        if (!slot->message) {
+            // Keep the beginning of the message
+            memcpy(slot->buf, message, sizeof(slot->buf) - 1);
+            slot->buf[sizeof(slot->buf) - 1] = '\0';
+            slot->message = slot->buf;
+        }
+    }
+    slot->priority = priority;
+
+    // Publish the message to the consumer
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    if (atomic_load(&sc_log_queue.sleeping)) {
+        sc_cond_signal(&sc_log_queue.cond);
+    }
+
+    return true;
+}
+
+// Print the next message, return false if the queue is empty
+static bool
+sc_log_queue_print_next(void) {
+    size_t pos = sc_log_queue.dequeue_pos;
+    struct sc_log_slot *slot =
+        &sc_log_queue.slots[pos & (SC_LOG_QUEUE_SIZE - 1)];
+    size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (seq != pos + 1) {
+        // Not published yet
+        return false;
+    }
+
+    sc_log_print(slot->priority, slot->message);
+    if (slot->message != slot->buf) {
+        free(slot->message);
+    }
+
+    // Release the slot for the producers of the next round
+    atomic_store_explicit(&slot->seq, pos + SC_LOG_QUEUE_SIZE,
+                          memory_order_release);
+    sc_log_queue.dequeue_pos = pos + 1;
+    return true;
+}
+
+static int
+run_log_printer(void *data) {
+    (void) data;
+
+    for (;;) {
+        while (sc_log_queue_print_next()) {
+            // print all the pending messages
+        }
+
+        if (atomic_load(&sc_log_queue.stopped)) {
+            break;
+        }
+
+        sc_mutex_lock(&sc_log_queue.mutex);
+        atomic_store(&sc_log_queue.sleeping, true);
+        if (!atomic_load(&sc_log_queue.stopped)) {
+            sc_tick deadline = sc_tick_now() + SC_LOG_POLL_INTERVAL;
+            sc_cond_timedwait(&sc_log_queue.cond, &sc_log_queue.mutex,
+                              deadline);
+        }
+        atomic_store(&sc_log_queue.sleeping, false);
+        sc_mutex_unlock(&sc_log_queue.mutex);
+    }
+
+    return 0;
+}
+
+static bool
+sc_log_queue_start(void) {
+    for (size_t i = 0; i < SC_LOG_QUEUE_SIZE; ++i) {
+        atomic_init(&sc_log_queue.slots[i].seq, i);
+    }
+    atomic_init(&sc_log_queue.enqueue_pos, 0);
+    sc_log_queue.dequeue_pos = 0;
+    atomic_init(&sc_log_queue.running, false);
+    atomic_init(&sc_log_queue.stopped, false);
+    atomic_init(&sc_log_queue.sleeping, false);
+
+    bool ok = sc_mutex_init(&sc_log_queue.mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&sc_log_queue.cond);
+    if (!ok) {
+        sc_mutex_destroy(&sc_log_queue.mutex);
+        return false;
+    }
+
+    ok = sc_thread_create(&sc_log_queue.thread, run_log_printer, "scrcpy-log",
+                          NULL);
+    if (!ok) {
+        sc_cond_destroy(&sc_log_queue.cond);
+        sc_mutex_destroy(&sc_log_queue.mutex);
+        return false;
+    }
+
+    atomic_store(&sc_log_queue.running, true);
+    return true;
+}
+
 static void SDLCALL
 sc_sdl_log_print(void *userdata, int category, SDL_LogPriority priority,
                  const char *message) {
     (void) userdata;
     (void) category;
 
-    FILE *out = priority < SDL_LOG_PRIORITY_WARN ? stdout : stderr;
-    assert(priority < SDL_NUM_LOG_PRIORITIES);
-    const char *prio_name = sc_sdl_log_priority_names[priority];
-    fprintf(out, "%s: %s\n", prio_name, message);
+    if (!atomic_load_explicit(&sc_log_queue.running, memory_order_acquire)
+            || !sc_log_queue_push(priority, message)) {
+        sc_log_print(priority, message);
+    }
 }
 
 void
 sc_log_configure(void) {
+    if (!sc_log_queue_start()) {
+        // Not fatal, the messages are printed synchronously
+        fprintf(stderr, "WARN: Could not start the log thread\n");
+    }
+
     SDL_LogSetOutputFunction(sc_sdl_log_print, NULL);
     // Redirect FFmpeg logs to SDL logs
     av_log_set_callback(sc_av_log_callback);
 }
+
+void
+sc_log_cleanup(void) {
+    if (!atomic_load(&sc_log_queue.running)) {
+        return;
+    }
+
+    // The messages logged from now on are printed synchronously
+    atomic_store(&sc_log_queue.running, false);
+
+    sc_mutex_lock(&sc_log_queue.mutex);
+    atomic_store(&sc_log_queue.stopped, true);
+    sc_cond_signal(&sc_log_queue.cond);
+    sc_mutex_unlock(&sc_log_queue.mutex);
+
+    // The printer thread prints the pending messages before exiting
+    sc_thread_join(&sc_log_queue.thread, NULL);
+
+    // A message may have been pushed meanwhile by another thread
+    while (sc_log_queue_print_next()) {
+        // print all the remaining messages
+    }
+
+    sc_cond_destroy(&sc_log_queue.cond);
+    sc_mutex_destroy(&sc_log_queue.mutex);
+}
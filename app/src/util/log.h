@@ -35,7 +35,13 @@ bool
 sc_log_windows_error(const char *prefix, int error);
 #endif
 
+// Start the thread printing the logs (the messages are printed
+// asynchronously until sc_log_cleanup() is called)
 void
 sc_log_configure(void);
 
+// Print the pending messages and stop the log thread
+void
+sc_log_cleanup(void);
+
 #endif
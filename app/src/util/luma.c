@@ -0,0 +1,87 @@
+#include "luma.h"
+
+#include <assert.h>
+
+// Get the range [start, end) of the source pixels of the cell `index`
+static inline void
+get_block(unsigned index, unsigned size, unsigned count, unsigned *start,
+          unsigned *end) {
+    *start = (uint64_t) index * size / count;
+    *end = (uint64_t) (index + 1) * size / count;
+    if (*end == *start) {
+        // The grid is larger than the plane
+        *end = *start + 1;
+    }
+}
+
+void
+sc_luma_downsample(const uint8_t *restrict src, size_t stride, unsigned width,
+                   unsigned height, uint8_t *restrict grid,
+                   unsigned grid_width, unsigned grid_height) {
+    assert(width && height);
+    assert(grid_width && grid_width <= SC_LUMA_GRID_MAX_WIDTH);
+    assert(grid_height);
+
+    unsigned x_start[SC_LUMA_GRID_MAX_WIDTH];
+    unsigned x_end[SC_LUMA_GRID_MAX_WIDTH];
+    for (unsigned cx = 0; cx < grid_width; ++cx) {
+        get_block(cx, width, grid_width, &x_start[cx], &x_end[cx]);
+    }
+
+    uint32_t sums[SC_LUMA_GRID_MAX_WIDTH];
+    for (unsigned cy = 0; cy < grid_height; ++cy) {
+        unsigned y_start;
+        unsigned y_end;
+        get_block(cy, height, grid_height, &y_start, &y_end);
+
+        for (unsigned cx = 0; cx < grid_width; ++cx) {
+            sums[cx] = 0;
+        }
+
+        for (unsigned y = y_start; y < y_end; ++y) {
+            const uint8_t *row = &src[y * stride];
+            for (unsigned cx = 0; cx < grid_width; ++cx) {
+                // The sum of a contiguous range of bytes (vectorized)
+                uint32_t sum = 0;
+                for (unsigned x = x_start[cx]; x < x_end[cx]; ++x) {
+                    sum += row[x];
+                }
+                sums[cx] += sum;
+            }
+        }
+
+        uint8_t *out = &grid[cy * grid_width];
+        unsigned rows = y_end - y_start;
+        for (unsigned cx = 0; cx < grid_width; ++cx) {
+            uint32_t count = rows * (x_end[cx] - x_start[cx]);
+            out[cx] = (sums[cx] + count / 2) / count;
+        }
+    }
+}
+
+uint64_t
+sc_luma_dhash(const uint8_t *restrict src, size_t stride, unsigned width,
+              unsigned height) {
+    uint8_t grid[9 * 8];
+    sc_luma_downsample(src, stride, width, height, grid, 9, 8);
+
+    uint64_t hash = 0;
+    for (unsigned y = 0; y < 8; ++y) {
+        const uint8_t *row = &grid[y * 9];
+        for (unsigned x = 0; x < 8; ++x) {
+            hash = (hash << 1) | (row[x] > row[x + 1]);
+        }
+    }
+    return hash;
+}
+
+size_t
+sc_luma_count_changes(const uint8_t *restrict a, const uint8_t *restrict b,
+                      size_t len, uint8_t threshold) {
+    size_t count = 0;
+    for (size_t i = 0; i < len; ++i) {
+        int diff = (int) a[i] - (int) b[i];
+        count += diff > threshold || diff < -threshold;
+    }
+    return count;
+}
@@ -0,0 +1,51 @@
+#ifndef SC_LUMA_H
+#define SC_LUMA_H
+
+#include "common.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Kernels on 8-bit luma planes, to compare frames cheaply
+ *
+ * They are written as simple loops over contiguous bytes without aliasing,
+ * so that the compiler vectorizes them.
+ */
+
+// Maximum width of a downsampled grid
+#define SC_LUMA_GRID_MAX_WIDTH 64
+
+/**
+ * Downsample the `width`x`height` luma plane `src` to the
+ * `grid_width`x`grid_height` grid `grid` (without padding), each cell being
+ * the average of the pixels of its block
+ *
+ * The grid may be larger than the plane (some pixels are then used by
+ * several cells).
+ */
+void
+sc_luma_downsample(const uint8_t *restrict src, size_t stride, unsigned width,
+                   unsigned height, uint8_t *restrict grid,
+                   unsigned grid_width, unsigned grid_height);
+
+/**
+ * Return the number of values which differ by more than `threshold` between
+ * `a` and `b`
+ */
+size_t
+sc_luma_count_changes(const uint8_t *restrict a, const uint8_t *restrict b,
+                      size_t len, uint8_t threshold);
+
+/**
+ * Compute the difference hash (dHash) of a luma plane
+ *
+ * The plane is downsampled to a 9x8 grid, and each bit is set if a cell is
+ * brighter than its right neighbor (row by row, starting from the most
+ * significant bit). Similar images have hashes with a small Hamming distance.
+ */
+uint64_t
+sc_luma_dhash(const uint8_t *restrict src, size_t stride, unsigned width,
+              unsigned height);
+
+#endif
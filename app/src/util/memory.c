@@ -1,5 +1,8 @@
 #include "memory.h"
 
+#include <assert.h>
+#include <stdalign.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <errno.h>
 
@@ -12,3 +15,98 @@ sc_allocarray(size_t nmemb, size_t size) {
     }
     return malloc(bytes);
 }
+
+struct sc_arena_block {
+    struct sc_arena_block *prev;
+    size_t cap;
+    size_t used;
+    max_align_t data[];
+};
+
+static struct sc_arena_block *
+sc_arena_block_new(size_t cap, struct sc_arena_block *prev) {
+    if (cap > SIZE_MAX - sizeof(struct sc_arena_block)) {
+        return NULL;
+    }
+
+    struct sc_arena_block *block =
+        malloc(sizeof(struct sc_arena_block) + cap);
+    if (!block) {
+        return NULL;
+    }
+
+    block->prev = prev;
+    block->cap = cap;
+    block->used = 0;
+    return block;
+}
+
+void
+sc_arena_init(struct sc_arena *arena, size_t block_size) {
+    assert(block_size);
+    // The first block is allocated lazily
+    arena->block = NULL;
+    arena->block_size = block_size;
+}
+
+static void
+sc_arena_free_blocks(struct sc_arena_block *block) {
+    while (block) {
+        struct sc_arena_block *prev = block->prev;
+        free(block);
+        block = prev;
+    }
+}
+
+void
+sc_arena_destroy(struct sc_arena *arena) {
+    sc_arena_free_blocks(arena->block);
+}
+
+void *
+sc_arena_alloc(struct sc_arena *arena, size_t size) {
+    // Keep the next allocation aligned
+    size_t align = alignof(max_align_t);
+    if (size > SIZE_MAX - align) {
+        return NULL;
+    }
+    size = (size + align - 1) & ~(align - 1);
+
+    struct sc_arena_block *block = arena->block;
+    if (!block || block->cap - block->used < size) {
+        size_t cap = size > arena->block_size ? size : arena->block_size;
+        block = sc_arena_block_new(cap, block);
+        if (!block) {
+            return NULL;
+        }
+        arena->block = block;
+    }
+
+    void *ptr = (uint8_t *) block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+void
+sc_arena_reset(struct sc_arena *arena) {
+    struct sc_arena_block *block = arena->block;
+    if (!block) {
+        return;
+    }
+
+    if (!block->prev) {
+        // Single block, just reuse it
+        block->used = 0;
+        return;
+    }
+
+    // Replace all the blocks by a single one large enough for all of them
+    size_t cap = 0;
+    for (struct sc_arena_block *b = block; b; b = b->prev) {
+        cap += b->cap;
+    }
+
+    sc_arena_free_blocks(block);
+    // On allocation failure, the block will be allocated lazily
+    arena->block = sc_arena_block_new(cap, NULL);
+}
@@ -1,6 +1,7 @@
 #ifndef SC_MEMORY_H
 #define SC_MEMORY_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /**
@@ -12,4 +13,46 @@
 void *
 sc_allocarray(size_t nmemb, size_t size);
 
+struct sc_arena_block;
+
+/**
+ * Arena allocator
+ *
+ * The allocations are never freed individually: they are all released at once
+ * by sc_arena_reset(), which keeps the memory for the next allocations.
+ *
+ * It is not thread-safe.
+ */
+struct sc_arena {
+    // Current block, linked to the previous (full) ones
+    struct sc_arena_block *block;
+    size_t block_size;
+};
+
+void
+sc_arena_init(struct sc_arena *arena, size_t block_size);
+
+void
+sc_arena_destroy(struct sc_arena *arena);
+
+/**
+ * Allocate `size` bytes (suitably aligned for any type)
+ *
+ * The memory is valid until the next call to sc_arena_reset() or
+ * sc_arena_destroy().
+ *
+ * Return NULL on allocation failure.
+ */
+void *
+sc_arena_alloc(struct sc_arena *arena, size_t size);
+
+/**
+ * Release all the allocations
+ *
+ * If the allocations did not fit in a single block, the blocks are merged, so
+ * that the same amount of allocations will not allocate anymore.
+ */
+void
+sc_arena_reset(struct sc_arena *arena);
+
 #endif
@@ -2,7 +2,10 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "log.h"
 
@@ -14,10 +17,13 @@
 #else
 # include <sys/types.h>
 # include <sys/socket.h>
+# include <sys/time.h>
 # include <netinet/in.h>
+# include <netinet/tcp.h>
 # include <arpa/inet.h>
 # include <unistd.h>
 # include <fcntl.h>
+# include <poll.h>
 # define SOCKET_ERROR -1
   typedef struct sockaddr_in SOCKADDR_IN;
   typedef struct sockaddr SOCKADDR;
@@ -122,12 +128,12 @@ net_perror(const char *s) {
 #endif
 }
 
-sc_socket
-net_socket(void) {
+static sc_socket
+net_create_socket(int type) {
 #ifdef HAVE_SOCK_CLOEXEC
-    sc_raw_socket raw_sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sc_raw_socket raw_sock = socket(AF_INET, type | SOCK_CLOEXEC, 0);
 #else
-    sc_raw_socket raw_sock = socket(AF_INET, SOCK_STREAM, 0);
+    sc_raw_socket raw_sock = socket(AF_INET, type, 0);
     if (raw_sock != SC_RAW_SOCKET_NONE && !set_cloexec_flag(raw_sock)) {
         sc_raw_socket_close(raw_sock);
         return SC_SOCKET_NONE;
@@ -141,6 +147,16 @@ net_socket(void) {
     return sock;
 }
 
+sc_socket
+net_socket(void) {
+    return net_create_socket(SOCK_STREAM);
+}
+
+sc_socket
+net_udp_socket(void) {
+    return net_create_socket(SOCK_DGRAM);
+}
+
 bool
 net_connect(sc_socket socket, uint32_t addr, uint16_t port) {
     sc_raw_socket raw_sock = unwrap(socket);
@@ -208,6 +224,92 @@ net_accept(sc_socket server_socket) {
     return wrap(raw_sock);
 }
 
+static bool
+net_get_local_port(sc_raw_socket raw_sock, uint16_t *port) {
+    SOCKADDR_IN sin;
+    socklen_t len = sizeof(sin);
+    if (getsockname(raw_sock, (SOCKADDR *) &sin, &len) == SOCKET_ERROR) {
+        net_perror("getsockname");
+        return false;
+    }
+
+    *port = ntohs(sin.sin_port);
+    return true;
+}
+
+static bool
+net_get_peer_port(sc_raw_socket raw_sock, uint16_t *port) {
+    SOCKADDR_IN sin;
+    socklen_t len = sizeof(sin);
+    if (getpeername(raw_sock, (SOCKADDR *) &sin, &len) == SOCKET_ERROR) {
+        net_perror("getpeername");
+        return false;
+    }
+
+    *port = ntohs(sin.sin_port);
+    return true;
+}
+
+bool
+net_socketpair(sc_socket socks[2]) {
+    sc_socket server_socket = net_socket();
+    if (server_socket == SC_SOCKET_NONE) {
+        return false;
+    }
+
+    sc_socket first = SC_SOCKET_NONE;
+    sc_socket second = SC_SOCKET_NONE;
+
+    // Listen on a port chosen by the system
+    uint16_t port;
+    bool ok = net_listen(server_socket, IPV4_LOCALHOST, 0, 1)
+           && net_get_local_port(unwrap(server_socket), &port);
+    if (!ok) {
+        goto error;
+    }
+
+    first = net_socket();
+    if (first == SC_SOCKET_NONE) {
+        goto error;
+    }
+
+    if (!net_connect(first, IPV4_LOCALHOST, port)) {
+        goto error;
+    }
+
+    second = net_accept(server_socket);
+    if (second == SC_SOCKET_NONE) {
+        goto error;
+    }
+
+    // Make sure that the accepted connection is the expected one (another
+    // local process could have connected to the port in the meantime)
+    uint16_t first_port;
+    uint16_t peer_port;
+    ok = net_get_local_port(unwrap(first), &first_port)
+      && net_get_peer_port(unwrap(second), &peer_port);
+    if (!ok || first_port != peer_port) {
+        LOGE("Unexpected socket pair connection");
+        goto error;
+    }
+
+    net_close(server_socket);
+
+    socks[0] = first;
+    socks[1] = second;
+    return true;
+
+error:
+    if (second != SC_SOCKET_NONE) {
+        net_close(second);
+    }
+    if (first != SC_SOCKET_NONE) {
+        net_close(first);
+    }
+    net_close(server_socket);
+    return false;
+}
+
 ssize_t
 net_recv(sc_socket socket, void *buf, size_t len) {
     sc_raw_socket raw_sock = unwrap(socket);
@@ -241,6 +343,176 @@ net_send_all(sc_socket socket, const void *buf, size_t len) {
     return copied;
 }
 
+bool
+sc_net_reader_init(struct sc_net_reader *reader, sc_socket socket,
+                   size_t cap) {
+    assert(cap);
+
+    reader->buf = malloc(cap);
+    if (!reader->buf) {
+        LOG_OOM();
+        return false;
+    }
+
+    reader->socket = socket;
+    reader->cap = cap;
+    reader->head = 0;
+    reader->tail = 0;
+
+    return true;
+}
+
+void
+sc_net_reader_destroy(struct sc_net_reader *reader) {
+    free(reader->buf);
+}
+
+void
+sc_net_reader_reset(struct sc_net_reader *reader, sc_socket socket) {
+    reader->socket = socket;
+    reader->head = 0;
+    reader->tail = 0;
+}
+
+ssize_t
+sc_net_reader_recv_all(struct sc_net_reader *reader, void *buf, size_t len) {
+    uint8_t *out = buf;
+    size_t copied = 0;
+
+    while (copied < len) {
+        assert(reader->head <= reader->tail);
+        size_t available = reader->tail - reader->head;
+        if (available) {
+            size_t n = MIN(available, len - copied);
+            memcpy(out + copied, reader->buf + reader->head, n);
+            reader->head += n;
+            copied += n;
+            continue;
+        }
+
+        // The buffer is empty
+        reader->head = 0;
+        reader->tail = 0;
+
+        size_t remaining = len - copied;
+        if (remaining >= reader->cap) {
+            // Read directly into the destination
+            ssize_t r = net_recv_all(reader->socket, out + copied, remaining);
+            if (r <= 0) {
+                return copied ? (ssize_t) copied : r;
+            }
+            copied += r;
+            if ((size_t) r < remaining) {
+                // Partial read, the connection is closed
+                return copied;
+            }
+            continue;
+        }
+
+        ssize_t r = net_recv(reader->socket, reader->buf, reader->cap);
+        if (r <= 0) {
+            return copied ? (ssize_t) copied : r;
+        }
+        reader->tail = r;
+    }
+
+    return copied;
+}
+
+bool
+net_set_tcp_nodelay(sc_socket socket, bool tcp_nodelay) {
+    sc_raw_socket raw_sock = unwrap(socket);
+
+    int value = tcp_nodelay ? 1 : 0;
+    if (setsockopt(raw_sock, IPPROTO_TCP, TCP_NODELAY, (const void *) &value,
+                   sizeof(value)) == SOCKET_ERROR) {
+        net_perror("setsockopt(TCP_NODELAY)");
+        return false;
+    }
+
+    return true;
+}
+
+bool
+net_set_recv_buffer_size(sc_socket socket, int size) {
+    sc_raw_socket raw_sock = unwrap(socket);
+
+    if (setsockopt(raw_sock, SOL_SOCKET, SO_RCVBUF, (const void *) &size,
+                   sizeof(size)) == SOCKET_ERROR) {
+        net_perror("setsockopt(SO_RCVBUF)");
+        return false;
+    }
+
+    return true;
+}
+
+bool
+net_set_recv_timeout(sc_socket socket, sc_tick timeout) {
+    sc_raw_socket raw_sock = unwrap(socket);
+
+#ifdef _WIN32
+    DWORD value = SC_TICK_TO_MS(timeout);
+#else
+    struct timeval value = {
+        .tv_sec = timeout / SC_TICK_FREQ,
+        .tv_usec = SC_TICK_TO_US(timeout % SC_TICK_FREQ),
+    };
+#endif
+    if (setsockopt(raw_sock, SOL_SOCKET, SO_RCVTIMEO, (const void *) &value,
+                   sizeof(value)) == SOCKET_ERROR) {
+        net_perror("setsockopt(SO_RCVTIMEO)");
+        return false;
+    }
+
+    return true;
+}
+
+int
+net_poll_readable(const sc_socket *sockets, bool *readable, unsigned count,
+                  sc_tick timeout) {
+    assert(count <= SC_NET_POLL_MAX);
+
+#ifdef _WIN32
+    WSAPOLLFD fds[SC_NET_POLL_MAX];
+#else
+    struct pollfd fds[SC_NET_POLL_MAX];
+#endif
+    for (unsigned i = 0; i < count; ++i) {
+        fds[i].fd = unwrap(sockets[i]);
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+
+    int ms;
+    if (timeout < 0) {
+        ms = -1;
+    } else {
+        // Round up, so that the timeout never expires early
+        sc_tick value = SC_TICK_TO_MS(timeout + SC_TICK_FROM_MS(1) - 1);
+        ms = MIN(value, INT_MAX);
+    }
+
+#ifdef _WIN32
+    int r = WSAPoll(fds, count, ms);
+#else
+    int r;
+    do {
+        r = poll(fds, count, ms);
+    } while (r == -1 && errno == EINTR);
+#endif
+    if (r == SOCKET_ERROR) {
+        net_perror("poll");
+        return -1;
+    }
+
+    for (unsigned i = 0; i < count; ++i) {
+        // On error or hang up, recv() returns immediately
+        readable[i] = fds[i].revents != 0;
+    }
+
+    return r;
+}
+
 bool
 net_interrupt(sc_socket socket) {
     assert(socket != SC_SOCKET_NONE);
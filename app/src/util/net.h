@@ -6,6 +6,8 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "tick.h"
+
 #ifdef _WIN32
 
 # include <winsock2.h>
@@ -35,6 +37,11 @@ net_cleanup(void);
 sc_socket
 net_socket(void);
 
+// Create a UDP socket (once connected, net_send() and net_recv() send and
+// receive datagrams)
+sc_socket
+net_udp_socket(void);
+
 bool
 net_connect(sc_socket socket, uint32_t addr, uint16_t port);
 
@@ -44,6 +51,11 @@ net_listen(sc_socket server_socket, uint32_t addr, uint16_t port, int backlog);
 sc_socket
 net_accept(sc_socket server_socket);
 
+// Create a pair of connected sockets (over the loopback interface, since
+// socketpair() is not available on Windows)
+bool
+net_socketpair(sc_socket socks[2]);
+
 // the _all versions wait/retry until len bytes have been written/read
 ssize_t
 net_recv(sc_socket socket, void *buf, size_t len);
@@ -57,6 +69,37 @@ net_send(sc_socket socket, const void *buf, size_t len);
 ssize_t
 net_send_all(sc_socket socket, const void *buf, size_t len);
 
+// Enable or disable Nagle's algorithm (TCP_NODELAY), so that small writes are
+// sent immediately
+bool
+net_set_tcp_nodelay(sc_socket socket, bool tcp_nodelay);
+
+// Set the size of the kernel receive buffer (SO_RCVBUF), so that the peer may
+// send a large burst of data before the application reads it
+bool
+net_set_recv_buffer_size(sc_socket socket, int size);
+
+// Make recv() fail (instead of blocking) if no data is received within the
+// timeout (SO_RCVTIMEO)
+bool
+net_set_recv_timeout(sc_socket socket, sc_tick timeout);
+
+#define SC_NET_POLL_MAX 4
+
+/**
+ * Wait until at least one of the sockets is readable (data is available, or
+ * the socket is closed), or the timeout expires (a negative timeout waits
+ * indefinitely)
+ *
+ * On return, `readable[i]` tells whether net_recv() would not block on
+ * `sockets[i]`.
+ *
+ * Return the number of readable sockets, 0 on timeout, or -1 on error.
+ */
+int
+net_poll_readable(const sc_socket *sockets, bool *readable, unsigned count,
+                  sc_tick timeout);
+
 // Shutdown the socket (or close on Windows) so that any blocking send() or
 // recv() are interrupted.
 bool
@@ -67,6 +110,39 @@ net_interrupt(sc_socket socket);
 bool
 net_close(sc_socket socket);
 
+/**
+ * Buffered reader over a socket
+ *
+ * It reads as much data as available (up to its capacity) on each recv()
+ * call, to reduce the number of syscalls when reading many small chunks
+ * (typically packet headers and small packets).
+ *
+ * Reads larger than the capacity are performed directly into the
+ * destination buffer, without intermediate copy.
+ */
+struct sc_net_reader {
+    sc_socket socket;
+    uint8_t *buf;
+    size_t cap;
+    size_t head; // index of the first unread byte
+    size_t tail; // index past the last received byte
+};
+
+bool
+sc_net_reader_init(struct sc_net_reader *reader, sc_socket socket,
+                   size_t cap);
+
+void
+sc_net_reader_destroy(struct sc_net_reader *reader);
+
+// Read from another socket (the unread bytes are dropped)
+void
+sc_net_reader_reset(struct sc_net_reader *reader, sc_socket socket);
+
+// Wait until len bytes have been read, like net_recv_all()
+ssize_t
+sc_net_reader_recv_all(struct sc_net_reader *reader, void *buf, size_t len);
+
 /**
  * Parse `ip` "xxx.xxx.xxx.xxx" to an IPv4 host representation
  */
@@ -1,7 +1,15 @@
+#ifdef _WIN32
+// Must be defined before the first inclusion of stdlib.h to expose rand_s()
+# define _CRT_RAND_S
+#endif
+
 #include "rand.h"
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "log.h"
 #include "tick.h"
 
 void sc_rand_init(struct sc_rand *rand) {
@@ -22,3 +30,34 @@ uint64_t sc_rand_u64(struct sc_rand *rand) {
     uint32_t lsb = sc_rand_u32(rand);
     return ((uint64_t) msb << 32) | lsb;
 }
+
+bool sc_rand_secure(void *buf, size_t len) {
+    unsigned char *out = buf;
+#ifdef _WIN32
+    while (len) {
+        unsigned int value;
+        if (rand_s(&value)) {
+            LOGE("Could not generate random bytes");
+            return false;
+        }
+        size_t n = MIN(len, sizeof(value));
+        memcpy(out, &value, n);
+        out += n;
+        len -= n;
+    }
+    return true;
+#else
+    FILE *file = fopen("/dev/urandom", "rb");
+    if (!file) {
+        LOGE("Could not open /dev/urandom");
+        return false;
+    }
+
+    bool ok = fread(out, 1, len, file) == len;
+    fclose(file);
+    if (!ok) {
+        LOGE("Could not read random bytes");
+    }
+    return ok;
+#endif
+}
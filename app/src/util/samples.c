@@ -0,0 +1,53 @@
+#include "samples.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+void
+sc_samples_init(struct sc_samples *samples) {
+    samples->head = 0;
+    samples->count = 0;
+}
+
+void
+sc_samples_push(struct sc_samples *samples, sc_tick value) {
+    samples->values[samples->head] = value;
+    samples->head = (samples->head + 1) % SC_SAMPLES_CAPACITY;
+    if (samples->count < SC_SAMPLES_CAPACITY) {
+        ++samples->count;
+    }
+}
+
+static int
+sc_samples_compare(const void *lhs, const void *rhs) {
+    sc_tick a = *(const sc_tick *) lhs;
+    sc_tick b = *(const sc_tick *) rhs;
+    return (a > b) - (a < b);
+}
+
+bool
+sc_samples_get_percentiles(const struct sc_samples *samples,
+                           const unsigned *percents, sc_tick *out,
+                           unsigned n) {
+    unsigned count = samples->count;
+    if (!count) {
+        return false;
+    }
+
+    // The order of the values in the window does not matter
+    sc_tick sorted[SC_SAMPLES_CAPACITY];
+    memcpy(sorted, samples->values, count * sizeof(*sorted));
+    qsort(sorted, count, sizeof(*sorted), sc_samples_compare);
+
+    for (unsigned i = 0; i < n; ++i) {
+        unsigned percent = percents[i];
+        assert(percent <= 100);
+
+        // nearest-rank: ceil(percent / 100 * count), 1-based
+        unsigned rank = (percent * count + 99) / 100;
+        out[i] = sorted[rank ? rank - 1 : 0];
+    }
+
+    return true;
+}
@@ -0,0 +1,41 @@
+#ifndef SC_SAMPLES_H
+#define SC_SAMPLES_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util/tick.h"
+
+#define SC_SAMPLES_CAPACITY 1024
+
+/**
+ * Rolling window of the last SC_SAMPLES_CAPACITY values, to compute
+ * percentiles
+ */
+struct sc_samples {
+    sc_tick values[SC_SAMPLES_CAPACITY];
+    unsigned head; // index of the next value to write
+    unsigned count;
+};
+
+void
+sc_samples_init(struct sc_samples *samples);
+
+void
+sc_samples_push(struct sc_samples *samples, sc_tick value);
+
+/**
+ * Compute the percentile (between 0 and 100) of the current samples
+ *
+ * The percentiles are computed for `n` values at once (to sort only once),
+ * using the nearest-rank method.
+ *
+ * Return false if there are no samples.
+ */
+bool
+sc_samples_get_percentiles(const struct sc_samples *samples,
+                           const unsigned *percents, sc_tick *out, unsigned n);
+
+#endif
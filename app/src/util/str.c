@@ -167,13 +167,14 @@ sc_str_list_contains(const char *list, char sep, const char *s) {
 
 size_t
 sc_str_utf8_truncation_index(const char *utf8, size_t max_len) {
-    size_t len = strlen(utf8);
+    // Do not scan the whole string if it is longer than max_len
+    size_t len = strnlen(utf8, max_len + 1);
     if (len <= max_len) {
         return len;
     }
     len = max_len;
     // see UTF-8 encoding <https://en.wikipedia.org/wiki/UTF-8#Description>
-    while ((utf8[len] & 0x80) != 0 && (utf8[len] & 0xc0) != 0xc0) {
+    while (len && (utf8[len] & 0x80) != 0 && (utf8[len] & 0xc0) != 0xc0) {
         // the next byte is not the start of a new UTF-8 codepoint
         // so if we would cut there, the character would be truncated
         len--;
@@ -353,3 +354,13 @@ sc_str_to_hex_string(const uint8_t *data, size_t size) {
 
     return buffer;
 }
+
+uint64_t
+sc_str_hash(const char *s) {
+    uint64_t hash = UINT64_C(0xcbf29ce484222325); // FNV offset basis
+    for (; *s; ++s) {
+        hash ^= (uint8_t) *s;
+        hash *= UINT64_C(0x100000001b3); // FNV prime
+    }
+    return hash ? hash : 1;
+}
@@ -5,6 +5,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /* Stringify a numeric value  */
 #define SC_STR(s) SC_XSTR(s)
@@ -144,4 +145,13 @@ sc_str_remove_trailing_cr(char *s, size_t len);
 char *
 sc_str_to_hex_string(const uint8_t *data, size_t len);
 
+/**
+ * Compute a 64-bit hash of a string (FNV-1a)
+ *
+ * It is not a cryptographic hash. It never returns 0, so that 0 may be used as
+ * an "unknown" value.
+ */
+uint64_t
+sc_str_hash(const char *s);
+
 #endif
@@ -2,10 +2,21 @@
 
 #include <assert.h>
 #include <string.h>
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <pthread.h>
+# include <sched.h>
+# ifdef __APPLE__
+#  include <pthread/qos.h>
+# endif
+#endif
 #include <SDL2/SDL_thread.h>
 
 #include "log.h"
 
+static struct sc_thread_config sc_thread_config;
+
 bool
 sc_thread_create(sc_thread *thread, sc_thread_fn fn, const char *name,
                  void *userdata) {
@@ -56,6 +67,134 @@ sc_thread_set_priority(enum sc_thread_priority priority) {
     return true;
 }
 
+void
+sc_thread_configure(const struct sc_thread_config *config) {
+    sc_thread_config = *config;
+}
+
+#ifdef _WIN32
+typedef HANDLE (WINAPI *sc_av_set_mm_thread_characteristics_fn)(LPCWSTR,
+                                                                 LPDWORD);
+
+static sc_av_set_mm_thread_characteristics_fn
+get_av_set_mm_thread_characteristics(void) {
+    // Loaded at runtime, MMCSS is not available on all Windows editions
+    HMODULE avrt = LoadLibraryW(L"avrt.dll");
+    if (!avrt) {
+        return NULL;
+    }
+    return (sc_av_set_mm_thread_characteristics_fn)
+        (void (*)(void)) GetProcAddress(avrt, "AvSetMmThreadCharacteristicsW");
+}
+#endif
+
+static bool
+set_realtime(enum sc_thread_role role) {
+#ifdef _WIN32
+    sc_av_set_mm_thread_characteristics_fn set_characteristics =
+        get_av_set_mm_thread_characteristics();
+    if (!set_characteristics) {
+        LOGW("MMCSS is not available");
+        return false;
+    }
+
+    // The thread keeps its MMCSS task until it exits
+    const wchar_t *task = role == SC_THREAD_ROLE_AUDIO_OUTPUT ? L"Pro Audio"
+                                                              : L"Playback";
+    DWORD task_index = 0;
+    HANDLE handle = set_characteristics(task, &task_index);
+    if (!handle) {
+        sc_log_windows_error("Could not register the thread to MMCSS",
+                             GetLastError());
+        return false;
+    }
+    return true;
+#elif defined(__APPLE__)
+    (void) role;
+    int r = pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+    if (r) {
+        LOGW("Could not set the thread QoS class: %s", strerror(r));
+        return false;
+    }
+    return true;
+#else
+    // The audio output must never wait for the other threads, and the input
+    // events must not wait for the decoding
+    int offset;
+    switch (role) {
+        case SC_THREAD_ROLE_AUDIO_OUTPUT:
+            offset = 2;
+            break;
+        case SC_THREAD_ROLE_CONTROLLER:
+            offset = 1;
+            break;
+        default:
+            offset = 0;
+            break;
+    }
+
+    struct sched_param param = {
+        .sched_priority = sched_get_priority_min(SCHED_RR) + offset,
+    };
+    int r = pthread_setschedparam(pthread_self(), SCHED_RR, &param);
+    if (r) {
+        LOGW("Could not set the real-time scheduling policy: %s (it requires "
+             "CAP_SYS_NICE or a non-zero RLIMIT_RTPRIO)", strerror(r));
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool
+sc_thread_set_affinity(uint64_t cpu_mask) {
+    assert(cpu_mask);
+#ifdef _WIN32
+    DWORD_PTR mask = (DWORD_PTR) cpu_mask;
+    if (!mask || !SetThreadAffinityMask(GetCurrentThread(), mask)) {
+        LOGW("Could not set the thread CPU affinity");
+        return false;
+    }
+    return true;
+#elif defined(__APPLE__)
+    // There is no API to pin a thread to CPUs
+    (void) cpu_mask;
+    LOGW("CPU affinity is not supported on this platform");
+    return false;
+#else
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned i = 0; i < 64; ++i) {
+        if (cpu_mask & (UINT64_C(1) << i)) {
+            CPU_SET(i, &set);
+        }
+    }
+    int r = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (r) {
+        LOGW("Could not set the thread CPU affinity: %s", strerror(r));
+        return false;
+    }
+    return true;
+#endif
+}
+
+void
+sc_thread_apply_role(enum sc_thread_role role) {
+    if (sc_thread_config.realtime && !set_realtime(role)) {
+        // Fallback on the (coarse) SDL priorities
+        enum sc_thread_priority priority =
+            role == SC_THREAD_ROLE_AUDIO_OUTPUT
+                ? SC_THREAD_PRIORITY_TIME_CRITICAL : SC_THREAD_PRIORITY_HIGH;
+        bool ok = sc_thread_set_priority(priority);
+        (void) ok; // We don't care if it worked, at least we tried
+    }
+
+    if (sc_thread_config.cpu_mask) {
+        bool ok = sc_thread_set_affinity(sc_thread_config.cpu_mask);
+        (void) ok; // not fatal
+    }
+}
+
 void
 sc_thread_join(sc_thread *thread, int *status) {
     SDL_WaitThread(thread->thread, status);
@@ -5,6 +5,7 @@
 
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "tick.h"
 
@@ -28,6 +29,23 @@ enum sc_thread_priority {
     SC_THREAD_PRIORITY_TIME_CRITICAL,
 };
 
+// The threads of the streaming pipeline, to which a scheduling policy may be
+// applied (see sc_thread_configure())
+enum sc_thread_role {
+    SC_THREAD_ROLE_DEMUXER, // receives (and decodes) a stream
+    SC_THREAD_ROLE_CONTROLLER,
+    SC_THREAD_ROLE_AUDIO_OUTPUT, // the thread calling the audio callback
+};
+
+struct sc_thread_config {
+    // Use the real-time scheduling of the platform for the pipeline threads
+    // (SCHED_RR on Linux, MMCSS on Windows, QoS classes on macOS)
+    bool realtime;
+    // Run the pipeline threads only on these CPUs (bit i for CPU i), 0 for
+    // no restriction
+    uint64_t cpu_mask;
+};
+
 typedef struct sc_mutex {
     SDL_mutex *mutex;
 #ifndef NDEBUG
@@ -49,6 +67,20 @@ sc_thread_join(sc_thread *thread, int *status);
 bool
 sc_thread_set_priority(enum sc_thread_priority priority);
 
+// Set the config applied by sc_thread_apply_role()
+// Must be called before any pipeline thread is started.
+void
+sc_thread_configure(const struct sc_thread_config *config);
+
+// Apply the configured scheduling policy and CPU affinity to the current
+// thread (does nothing if not configured)
+void
+sc_thread_apply_role(enum sc_thread_role role);
+
+// Restrict the current thread to the CPUs of the mask (bit i for CPU i)
+bool
+sc_thread_set_affinity(uint64_t cpu_mask);
+
 bool
 sc_mutex_init(sc_mutex *mutex);
 
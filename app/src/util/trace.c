@@ -0,0 +1,198 @@
+#include "trace.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util/log.h"
+#include "util/thread.h"
+#include "util/tick.h"
+#include "util/vector.h"
+
+// Stop recording once this number of events is reached (~100 MB)
+#define SC_TRACE_MAX_EVENTS (1 << 22)
+
+struct sc_trace_event {
+    const char *name; // NULL for the end of a zone
+    sc_tick time;
+    int64_t pts; // -1 if none
+    sc_thread_id tid;
+    char phase; // 'B' (begin), 'E' (end) or 'i' (instant)
+};
+
+struct sc_trace_thread {
+    sc_thread_id tid;
+    const char *name;
+};
+
+static struct {
+    // Immutable between sc_trace_init() and sc_trace_destroy()
+    const char *path; // NULL if tracing is disabled
+
+    sc_mutex mutex;
+    struct SC_VECTOR(struct sc_trace_event) events;
+    struct SC_VECTOR(struct sc_trace_thread) threads;
+    bool full;
+} sc_trace;
+
+void
+sc_trace_init(void) {
+    sc_trace.path = NULL;
+
+    const char *path = getenv("SCRCPY_TRACE_FILE");
+    if (!path || !*path) {
+        return;
+    }
+
+    if (!sc_mutex_init(&sc_trace.mutex)) {
+        LOGE("Could not initialize tracing");
+        return;
+    }
+
+    sc_vector_init(&sc_trace.events);
+    sc_vector_init(&sc_trace.threads);
+    sc_trace.full = false;
+    sc_trace.path = path;
+
+    LOGI("Tracing to %s", path);
+}
+
+static void
+sc_trace_push(const char *name, char phase, int64_t pts) {
+    if (!sc_trace.path) {
+        return;
+    }
+
+    struct sc_trace_event event = {
+        .name = name,
+        .time = sc_tick_now(),
+        .pts = pts,
+        .tid = sc_thread_get_id(),
+        .phase = phase,
+    };
+
+    sc_mutex_lock(&sc_trace.mutex);
+    if (!sc_trace.full) {
+        if (sc_trace.events.size >= SC_TRACE_MAX_EVENTS
+                || !sc_vector_push(&sc_trace.events, event)) {
+            // Logged on destroy, not to disturb the traced threads
+            sc_trace.full = true;
+        }
+    }
+    sc_mutex_unlock(&sc_trace.mutex);
+}
+
+void
+sc_trace_thread_name(const char *name) {
+    if (!sc_trace.path) {
+        return;
+    }
+
+    sc_thread_id tid = sc_thread_get_id();
+
+    sc_mutex_lock(&sc_trace.mutex);
+    bool found = false;
+    for (size_t i = 0; i < sc_trace.threads.size; ++i) {
+        if (sc_trace.threads.data[i].tid == tid) {
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        struct sc_trace_thread thread = {tid, name};
+        bool ok = sc_vector_push(&sc_trace.threads, thread);
+        (void) ok; // the thread is just not named
+    }
+    sc_mutex_unlock(&sc_trace.mutex);
+}
+
+void
+sc_trace_begin(const char *name) {
+    sc_trace_push(name, 'B', -1);
+}
+
+void
+sc_trace_begin_pts(const char *name, int64_t pts) {
+    // Config packets have no pts (AV_NOPTS_VALUE is negative)
+    sc_trace_push(name, 'B', pts >= 0 ? pts : -1);
+}
+
+void
+sc_trace_end(void) {
+    sc_trace_push(NULL, 'E', -1);
+}
+
+void
+sc_trace_mark(const char *name) {
+    sc_trace_push(name, 'i', -1);
+}
+
+static bool
+sc_trace_write(FILE *file) {
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    bool first = true;
+    for (size_t i = 0; i < sc_trace.threads.size; ++i) {
+        struct sc_trace_thread *thread = &sc_trace.threads.data[i];
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                      "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", thread->tid, thread->name);
+        first = false;
+    }
+
+    for (size_t i = 0; i < sc_trace.events.size; ++i) {
+        struct sc_trace_event *event = &sc_trace.events.data[i];
+        fprintf(file, "%s{\"ph\":\"%c\",\"ts\":%" PRItick ",\"pid\":1,"
+                      "\"tid\":%u",
+                first ? "" : ",\n", event->phase, SC_TICK_TO_US(event->time),
+                event->tid);
+        first = false;
+
+        if (event->name) {
+            fprintf(file, ",\"name\":\"%s\"", event->name);
+        }
+        if (event->phase == 'i') {
+            // Thread-scoped instant event
+            fprintf(file, ",\"s\":\"t\"");
+        }
+        if (event->pts >= 0) {
+            fprintf(file, ",\"args\":{\"pts\":%" PRIi64 "}", event->pts);
+        }
+        fprintf(file, "}");
+    }
+
+    fprintf(file, "\n]}\n");
+    return !ferror(file);
+}
+
+void
+sc_trace_destroy(void) {
+    if (!sc_trace.path) {
+        return;
+    }
+
+    if (sc_trace.full) {
+        LOGW("Trace truncated to %" SC_PRIsizet " events",
+             sc_trace.events.size);
+    }
+
+    FILE *file = fopen(sc_trace.path, "w");
+    if (file) {
+        bool ok = sc_trace_write(file);
+        if (fclose(file) || !ok) {
+            LOGE("Could not write trace file: %s", sc_trace.path);
+        } else {
+            LOGI("Trace written to %s (%" SC_PRIsizet " events)",
+                 sc_trace.path, sc_trace.events.size);
+        }
+    } else {
+        LOGE("Could not open trace file: %s", sc_trace.path);
+    }
+
+    sc_vector_destroy(&sc_trace.threads);
+    sc_vector_destroy(&sc_trace.events);
+    sc_mutex_destroy(&sc_trace.mutex);
+    sc_trace.path = NULL;
+}
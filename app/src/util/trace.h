@@ -0,0 +1,67 @@
+#ifndef SC_TRACE_H
+#define SC_TRACE_H
+
+#include "common.h"
+
+#include <stdint.h>
+
+/**
+ * Tracing of the client threads (only built with -Dtracing=true)
+ *
+ * If the environment variable SCRCPY_TRACE_FILE is set, the zones and markers
+ * are recorded in memory, then written to this file on exit, in the Chrome
+ * trace event format (it can be opened by ui.perfetto.dev or
+ * chrome://tracing).
+ *
+ * The zones related to a packet or a frame have a "pts" argument, the same as
+ * the "scrcpy:*" sections traced by the server (android.os.Trace), to
+ * correlate the client trace with a device trace.
+ *
+ * The names must be statically allocated (e.g. string literals). The zones of
+ * a thread must be properly nested.
+ */
+
+#ifdef TRACING
+
+void
+sc_trace_init(void);
+
+// Write the trace file, must be called once all the traced threads are joined
+void
+sc_trace_destroy(void);
+
+// Name the current thread in the trace (only the first call per thread is
+// recorded)
+void
+sc_trace_thread_name(const char *name);
+
+void
+sc_trace_begin(const char *name);
+
+void
+sc_trace_begin_pts(const char *name, int64_t pts);
+
+void
+sc_trace_end(void);
+
+// Instant event
+void
+sc_trace_mark(const char *name);
+
+#else
+
+static inline void sc_trace_init(void) {}
+static inline void sc_trace_destroy(void) {}
+static inline void sc_trace_thread_name(const char *name) { (void) name; }
+static inline void sc_trace_begin(const char *name) { (void) name; }
+static inline void
+sc_trace_begin_pts(const char *name, int64_t pts) {
+    (void) name;
+    (void) pts;
+}
+static inline void sc_trace_end(void) {}
+static inline void sc_trace_mark(const char *name) { (void) name; }
+
+#endif
+
+#endif
@@ -40,12 +40,40 @@
     size_t origin; \
     size_t size; \
     type *data; \
+    /* inline storage (NULL if none), see SC_VECDEQUE_INLINE() */ \
+    type *inline_data_; \
+    size_t inline_cap_; \
 }
 
 /**
- * Static initializer for a VecDeque
+ * VecDeque struct body with inline storage
+ *
+ * The first `n` items are stored in the struct itself, so that a VecDeque
+ * having a predictable maximum size never allocates. If it exceeds `n` items,
+ * the content is moved to a heap-allocated array, as usual.
+ *
+ * It must be initialized by sc_vecdeque_init_inline(), then it is managed by
+ * the same sc_vecdeque_* helpers:
+ *
+ *     struct vecdeque_int SC_VECDEQUE_INLINE(int, 16);
+ *
+ * Since its data may point to the struct itself, an initialized VecDeque with
+ * inline storage must not be moved (copied to another address).
  */
-#define SC_VECDEQUE_INITIALIZER { 0, 0, 0, NULL }
+#define SC_VECDEQUE_INLINE(type, n) { \
+    size_t cap; \
+    size_t origin; \
+    size_t size; \
+    type *data; \
+    type *inline_data_; \
+    size_t inline_cap_; \
+    type inline_storage_[n]; \
+}
+
+/**
+ * Static initializer for a VecDeque (without inline storage)
+ */
+#define SC_VECDEQUE_INITIALIZER { 0, 0, 0, NULL, NULL, 0 }
 
 /**
  * Initialize an empty VecDeque
@@ -56,23 +84,45 @@
     (pv)->origin = 0; \
     (pv)->size = 0; \
     (pv)->data = NULL; \
+    (pv)->inline_data_ = NULL; \
+    (pv)->inline_cap_ = 0; \
+})
+
+/**
+ * Initialize an empty VecDeque with inline storage (see SC_VECDEQUE_INLINE())
+ */
+#define sc_vecdeque_init_inline(pv) \
+({ \
+    (pv)->inline_data_ = (pv)->inline_storage_; \
+    (pv)->inline_cap_ = ARRAY_LEN((pv)->inline_storage_); \
+    (pv)->cap = (pv)->inline_cap_; \
+    (pv)->origin = 0; \
+    (pv)->size = 0; \
+    (pv)->data = (pv)->inline_data_; \
 })
 
 /**
  * Destroy a VecDeque
  */
 #define sc_vecdeque_destroy(pv) \
-    free((pv)->data)
+(void) ({ \
+    if ((pv)->data != (pv)->inline_data_) { \
+        free((pv)->data); \
+    } \
+})
 
 /**
  * Clear a VecDeque
  *
- * Remove all items.
+ * Remove all items (and release the heap-allocated array, if any).
  */
 #define sc_vecdeque_clear(pv) \
 (void) ({ \
     sc_vecdeque_destroy(pv); \
-    sc_vecdeque_init(pv); \
+    (pv)->cap = (pv)->inline_cap_; \
+    (pv)->origin = 0; \
+    (pv)->size = 0; \
+    (pv)->data = (pv)->inline_data_; \
 })
 
 /**
@@ -130,19 +180,24 @@
  * \param pcap a pointer to the `cap` field of the SC_VECDEQUE [IN/OUT]
  * \param porigin a pointer to pv->origin [IN/OUT]
  * \param size the `size` field of the SC_VECDEQUE
+ * \param inline_data the inline storage of the SC_VECDEQUE (may be NULL), which
+ *                    must never be reallocated nor freed
  * \return the new array to assign to the `data` field of the SC_VECDEQUE (if
  *         not NULL)
  */
 static inline void *
 sc_vecdeque_reallocdata_(void *ptr, size_t newcap, size_t item_size,
-                         size_t *pcap, size_t *porigin, size_t size) {
+                         size_t *pcap, size_t *porigin, size_t size,
+                         const void *inline_data) {
 
     size_t oldcap = *pcap;
     size_t oldorigin = *porigin;
 
     assert(newcap > oldcap); // Could only grow
 
-    if (oldorigin + size <= oldcap) {
+    bool is_inline = ptr && ptr == inline_data;
+
+    if (!is_inline && oldorigin + size <= oldcap) {
         // The current content will stay in place, just realloc
         //
         // As an example, here is the content of a ring-buffer (oldcap=10)
@@ -181,23 +236,30 @@ sc_vecdeque_reallocdata_(void *ptr, size_t newcap, size_t item_size,
     //     0 1 2 3 4 5 6 7 _ _ _ _ _ _ _
     //     ^
     //     origin
+    //
+    // The content of the inline storage is always copied this way.
 
-    assert(size);
+    assert(size || is_inline);
     void *newptr = sc_allocarray(newcap, item_size);
     if (!newptr) {
         return NULL;
     }
 
-    size_t right_len = MIN(size, oldcap - oldorigin);
-    assert(right_len);
-    memcpy(newptr, (char *) ptr + (oldorigin * item_size), right_len * item_size);
+    if (size) {
+        size_t right_len = MIN(size, oldcap - oldorigin);
+        assert(right_len);
+        memcpy(newptr, (char *) ptr + (oldorigin * item_size),
+               right_len * item_size);
 
-    if (size > right_len) {
-        memcpy((char *) newptr + (right_len * item_size), ptr,
-               (size - right_len) * item_size);
+        if (size > right_len) {
+            memcpy((char *) newptr + (right_len * item_size), ptr,
+                   (size - right_len) * item_size);
+        }
     }
 
-    free(ptr);
+    if (!is_inline) {
+        free(ptr);
+    }
 
     *pcap = newcap;
     *porigin = 0;
@@ -216,7 +278,8 @@ sc_vecdeque_reallocdata_(void *ptr, size_t newcap, size_t item_size,
 ({ \
     void *p = sc_vecdeque_reallocdata_((pv)->data, newcap, \
                                        sizeof(*(pv)->data), &(pv)->cap, \
-                                       &(pv)->origin, (pv)->size); \
+                                       &(pv)->origin, (pv)->size, \
+                                       (pv)->inline_data_); \
     if (p) { \
         (pv)->data = p; \
     } \
@@ -351,6 +414,28 @@ sc_vecdeque_growsize_(size_t value)
     ok; \
 })
 
+/**
+ * Return a pointer to the item at the front, without removing it
+ *
+ * It is an error to call this function if the VecDeque is empty.
+ */
+#define sc_vecdeque_peek(pv) \
+({ \
+    assert(!sc_vecdeque_is_empty(pv)); \
+    &(pv)->data[(pv)->origin]; \
+})
+
+/**
+ * Return a pointer to the item at the given index, counted from the front
+ *
+ * It is an error to call this function with an index out of bounds.
+ */
+#define sc_vecdeque_get(pv, index) \
+({ \
+    assert((index) < (pv)->size); \
+    &(pv)->data[((pv)->origin + (index)) % (pv)->cap]; \
+})
+
 /**
  * Pop an item and return a pointer to it (still in the VecDeque)
  *
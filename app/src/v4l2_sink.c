@@ -1,109 +1,262 @@
 #include "v4l2_sink.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <linux/videodev2.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
 
 #include "util/log.h"
-#include "util/str.h"
 
 /** Downcast frame_sink to sc_v4l2_sink */
 #define DOWNCAST(SINK) container_of(SINK, struct sc_v4l2_sink, frame_sink)
 
-static const AVRational SCRCPY_TIME_BASE = {1, 1000000}; // timestamps in us
-
-static const AVOutputFormat *
-find_muxer(const char *name) {
-#ifdef SCRCPY_LAVF_HAS_NEW_MUXER_ITERATOR_API
-    void *opaque = NULL;
-#endif
-    const AVOutputFormat *oformat = NULL;
-    do {
-#ifdef SCRCPY_LAVF_HAS_NEW_MUXER_ITERATOR_API
-        oformat = av_muxer_iterate(&opaque);
-#else
-        oformat = av_oformat_next(oformat);
-#endif
-        // until null or containing the requested name
-    } while (oformat && !sc_str_list_contains(oformat->name, ',', name));
-    return oformat;
+static uint32_t
+get_v4l2_pixelformat(enum sc_v4l2_format format) {
+    switch (format) {
+        case SC_V4L2_FORMAT_YUV420P:
+            return V4L2_PIX_FMT_YUV420;
+        case SC_V4L2_FORMAT_NV12:
+            return V4L2_PIX_FMT_NV12;
+        case SC_V4L2_FORMAT_YUYV:
+            return V4L2_PIX_FMT_YUYV;
+        default:
+            assert(!"unexpected format");
+            return 0;
+    }
 }
 
-static bool
-write_header(struct sc_v4l2_sink *vs, const AVPacket *packet) {
-    AVStream *ostream = vs->format_ctx->streams[0];
-
-    uint8_t *extradata = av_malloc(packet->size * sizeof(uint8_t));
-    if (!extradata) {
-        LOG_OOM();
-        return false;
+static enum AVPixelFormat
+get_av_pix_fmt(enum sc_v4l2_format format) {
+    switch (format) {
+        case SC_V4L2_FORMAT_YUV420P:
+            return AV_PIX_FMT_YUV420P;
+        case SC_V4L2_FORMAT_NV12:
+            return AV_PIX_FMT_NV12;
+        case SC_V4L2_FORMAT_YUYV:
+            return AV_PIX_FMT_YUYV422;
+        default:
+            assert(!"unexpected format");
+            return AV_PIX_FMT_NONE;
     }
+}
 
-    // copy the first packet to the extra data
-    memcpy(extradata, packet->data, packet->size);
+static const char *
+get_format_name(enum sc_v4l2_format format) {
+    switch (format) {
+        case SC_V4L2_FORMAT_YUV420P:
+            return "yuv420p";
+        case SC_V4L2_FORMAT_NV12:
+            return "nv12";
+        case SC_V4L2_FORMAT_YUYV:
+            return "yuyv";
+        default:
+            assert(!"unexpected format");
+            return NULL;
+    }
+}
 
-    ostream->codecpar->extradata = extradata;
-    ostream->codecpar->extradata_size = packet->size;
+static struct sc_size
+get_output_size(struct sc_size size, uint16_t max_size) {
+    unsigned w = size.width;
+    unsigned h = size.height;
+    if (!max_size || (w <= max_size && h <= max_size)) {
+        return size;
+    }
 
-    int ret = avformat_write_header(vs->format_ctx, NULL);
-    if (ret < 0) {
-        LOGE("Failed to write header to %s", vs->device_name);
-        return false;
+    // Preserve the aspect ratio, with even dimensions (for chroma
+    // subsampling)
+    if (w > h) {
+        h = (uint64_t) h * max_size / w;
+        w = max_size;
+    } else {
+        w = (uint64_t) w * max_size / h;
+        h = max_size;
     }
 
-    return true;
+    return (struct sc_size) {
+        .width = w & ~1,
+        .height = MAX(h & ~1, 2),
+    };
 }
 
 static void
-rescale_packet(struct sc_v4l2_sink *vs, AVPacket *packet) {
-    AVStream *ostream = vs->format_ctx->streams[0];
-    av_packet_rescale_ts(packet, SCRCPY_TIME_BASE, ostream->time_base);
+sc_v4l2_sink_set_plane(struct sc_v4l2_sink *vs, unsigned i, unsigned width,
+                       unsigned height, unsigned stride) {
+    assert(i < ARRAY_LEN(vs->planes));
+    vs->planes[i].width = width;
+    vs->planes[i].height = height;
+    vs->planes[i].stride = stride;
 }
 
 static bool
-write_packet(struct sc_v4l2_sink *vs, AVPacket *packet) {
-    if (!vs->header_written) {
-        bool ok = write_header(vs, packet);
-        if (!ok) {
+sc_v4l2_sink_set_format(struct sc_v4l2_sink *vs, const AVCodecContext *ctx) {
+    struct sc_size input_size = {ctx->width, ctx->height};
+    struct sc_size size = get_output_size(input_size, vs->max_size);
+    unsigned bytes_per_pixel = vs->format == SC_V4L2_FORMAT_YUYV ? 2 : 1;
+    uint32_t pixelformat = get_v4l2_pixelformat(vs->format);
+
+    struct v4l2_format fmt;
+    memset(&fmt, 0, sizeof(fmt));
+    fmt.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+    fmt.fmt.pix.width = size.width;
+    fmt.fmt.pix.height = size.height;
+    fmt.fmt.pix.pixelformat = pixelformat;
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    fmt.fmt.pix.bytesperline = size.width * bytes_per_pixel;
+
+    if (ioctl(vs->fd, VIDIOC_S_FMT, &fmt) < 0) {
+        LOGE("Could not set format of %s: %s", vs->device_name,
+             strerror(errno));
+        return false;
+    }
+
+    // The driver may adjust the requested format
+    if (fmt.fmt.pix.pixelformat != pixelformat
+            || fmt.fmt.pix.width != size.width
+            || fmt.fmt.pix.height != size.height) {
+        LOGE("Format %ux%u %s not supported by %s", size.width, size.height,
+             get_format_name(vs->format), vs->device_name);
+        return false;
+    }
+
+    unsigned stride = fmt.fmt.pix.bytesperline;
+    if (stride < size.width * bytes_per_pixel) {
+        stride = size.width * bytes_per_pixel;
+    }
+
+    unsigned chroma_width = (size.width + 1) / 2;
+    unsigned chroma_height = (size.height + 1) / 2;
+
+    switch (vs->format) {
+        case SC_V4L2_FORMAT_YUV420P:
+            // The chroma planes are contiguous to the luma plane, with half
+            // the luma stride
+            vs->plane_count = 3;
+            sc_v4l2_sink_set_plane(vs, 0, size.width, size.height, stride);
+            sc_v4l2_sink_set_plane(vs, 1, chroma_width, chroma_height,
+                                   stride / 2);
+            sc_v4l2_sink_set_plane(vs, 2, chroma_width, chroma_height,
+                                   stride / 2);
+            break;
+        case SC_V4L2_FORMAT_NV12:
+            // The interleaved chroma plane has the same stride as the luma
+            // plane
+            vs->plane_count = 2;
+            sc_v4l2_sink_set_plane(vs, 0, size.width, size.height, stride);
+            sc_v4l2_sink_set_plane(vs, 1, chroma_width * 2, chroma_height,
+                                   stride);
+            break;
+        case SC_V4L2_FORMAT_YUYV:
+            vs->plane_count = 1;
+            sc_v4l2_sink_set_plane(vs, 0, size.width * 2, size.height,
+                                   stride);
+            break;
+        default:
+            assert(!"unexpected format");
             return false;
-        }
-        vs->header_written = true;
-        return true;
     }
 
-    rescale_packet(vs, packet);
+    vs->image_size = 0;
+    for (unsigned i = 0; i < vs->plane_count; ++i) {
+        vs->image_size += (size_t) vs->planes[i].stride * vs->planes[i].height;
+    }
 
-    bool ok = av_write_frame(vs->format_ctx, packet) >= 0;
+    vs->size = size;
+    // The frames are converted if they do not match the device format
+    vs->convert = vs->format != SC_V4L2_FORMAT_YUV420P
+               || size.width != input_size.width
+               || size.height != input_size.height;
 
-    // Failing to write the last frame is not very serious, no future frame may
-    // depend on it, so the resulting file will still be valid
-    (void) ok;
+    if (vs->convert) {
+        LOGI("v4l2 output: %ux%u %s (converted from %ux%u)", size.width,
+             size.height, get_format_name(vs->format), input_size.width,
+             input_size.height);
+    }
 
     return true;
 }
 
 static bool
-encode_and_write_frame(struct sc_v4l2_sink *vs, const AVFrame *frame) {
-    int ret = avcodec_send_frame(vs->encoder_ctx, frame);
-    if (ret < 0 && ret != AVERROR(EAGAIN)) {
-        LOGE("Could not send v4l2 video frame: %d", ret);
+convert_frame(struct sc_v4l2_sink *vs, const AVFrame *frame) {
+    // The conversion context is only recreated if the input changes
+    vs->sws_ctx = sws_getCachedContext(vs->sws_ctx, frame->width,
+                                       frame->height, frame->format,
+                                       vs->size.width, vs->size.height,
+                                       get_av_pix_fmt(vs->format),
+                                       SWS_BILINEAR, NULL, NULL, NULL);
+    if (!vs->sws_ctx) {
+        LOGE("Could not create v4l2 conversion context");
         return false;
     }
 
-    AVPacket *packet = vs->packet;
-    ret = avcodec_receive_packet(vs->encoder_ctx, packet);
-    if (ret == 0) {
-        // A packet was received
+    // Convert directly into the device image layout
+    uint8_t *dst[4] = {0};
+    int dst_stride[4] = {0};
+    uint8_t *ptr = vs->buffer;
+    for (unsigned i = 0; i < vs->plane_count; ++i) {
+        dst[i] = ptr;
+        dst_stride[i] = vs->planes[i].stride;
+        ptr += (size_t) vs->planes[i].stride * vs->planes[i].height;
+    }
+
+    sws_scale(vs->sws_ctx, (const uint8_t *const *) frame->data,
+              frame->linesize, 0, frame->height, dst, dst_stride);
 
-        bool ok = write_packet(vs, packet);
-        av_packet_unref(packet);
-        if (!ok) {
-            LOGW("Could not send packet to v4l2 sink");
+    return true;
+}
+
+static bool
+write_frame(struct sc_v4l2_sink *vs, const AVFrame *frame) {
+    ssize_t w;
+    if (vs->convert) {
+        if (!convert_frame(vs, frame)) {
             return false;
         }
-    } else if (ret != AVERROR(EAGAIN)) {
-        LOGE("Could not receive v4l2 video packet: %d", ret);
-        return false;
+        w = write(vs->fd, vs->buffer, vs->image_size);
+    } else {
+        // If the frame planes have exactly the device layout, write them
+        // directly, without any copy in user space
+        bool packed = true;
+        for (unsigned i = 0; i < vs->plane_count; ++i) {
+            if (frame->linesize[i] != (int) vs->planes[i].stride) {
+                packed = false;
+                break;
+            }
+        }
+
+        if (packed) {
+            struct iovec iov[3];
+            for (unsigned i = 0; i < vs->plane_count; ++i) {
+                iov[i].iov_base = frame->data[i];
+                iov[i].iov_len = (size_t) vs->planes[i].stride
+                               * vs->planes[i].height;
+            }
+            w = writev(vs->fd, iov, vs->plane_count);
+        } else {
+            // Copy the planes to the (preallocated) image buffer, so that the
+            // whole frame is written by a single call
+            uint8_t *dst = vs->buffer;
+            for (unsigned i = 0; i < vs->plane_count; ++i) {
+                struct sc_v4l2_sink_plane *plane = &vs->planes[i];
+                av_image_copy_plane(dst, plane->stride, frame->data[i],
+                                    frame->linesize[i], plane->width,
+                                    plane->height);
+                dst += (size_t) plane->stride * plane->height;
+            }
+            w = write(vs->fd, vs->buffer, vs->image_size);
+        }
     }
 
+    // Failing to write a frame is not very serious, no future frame depends on
+    // it
+    (void) w;
+
     return true;
 }
 
@@ -128,7 +281,7 @@ run_v4l2_sink(void *data) {
 
         sc_frame_buffer_consume(&vs->fb, vs->frame);
 
-        bool ok = encode_and_write_frame(vs, vs->frame);
+        bool ok = write_frame(vs, vs->frame);
         av_frame_unref(vs->frame);
         if (!ok) {
             LOGE("Could not send frame to v4l2 sink");
@@ -144,9 +297,8 @@ run_v4l2_sink(void *data) {
 static bool
 sc_v4l2_sink_open(struct sc_v4l2_sink *vs, const AVCodecContext *ctx) {
     assert(ctx->pix_fmt == AV_PIX_FMT_YUV420P);
-    (void) ctx;
 
-    bool ok = sc_frame_buffer_init(&vs->fb);
+    bool ok = sc_frame_buffer_init(&vs->fb, NULL);
     if (!ok) {
         return false;
     }
@@ -161,121 +313,51 @@ sc_v4l2_sink_open(struct sc_v4l2_sink *vs, const AVCodecContext *ctx) {
         goto error_mutex_destroy;
     }
 
-    const AVOutputFormat *format = find_muxer("v4l2");
-    if (!format) {
-        // Alternative name
-        format = find_muxer("video4linux2");
-    }
-    if (!format) {
-        LOGE("Could not find v4l2 muxer");
+    vs->fd = open(vs->device_name, O_RDWR | O_CLOEXEC);
+    if (vs->fd < 0) {
+        LOGE("Failed to open output device %s: %s", vs->device_name,
+             strerror(errno));
         goto error_cond_destroy;
     }
 
-    const AVCodec *encoder = avcodec_find_encoder(AV_CODEC_ID_RAWVIDEO);
-    if (!encoder) {
-        LOGE("Raw video encoder not found");
-        return false;
-    }
-
-    vs->format_ctx = avformat_alloc_context();
-    if (!vs->format_ctx) {
-        LOG_OOM();
-        return false;
-    }
-
-    // contrary to the deprecated API (av_oformat_next()), av_muxer_iterate()
-    // returns (on purpose) a pointer-to-const, but AVFormatContext.oformat
-    // still expects a pointer-to-non-const (it has not be updated accordingly)
-    // <https://github.com/FFmpeg/FFmpeg/commit/0694d8702421e7aff1340038559c438b61bb30dd>
-    vs->format_ctx->oformat = (AVOutputFormat *) format;
-#ifdef SCRCPY_LAVF_HAS_AVFORMATCONTEXT_URL
-    vs->format_ctx->url = strdup(vs->device_name);
-    if (!vs->format_ctx->url) {
-        LOG_OOM();
-        goto error_avformat_free_context;
-    }
-#else
-    strncpy(vs->format_ctx->filename, vs->device_name,
-            sizeof(vs->format_ctx->filename));
-#endif
-
-    AVStream *ostream = avformat_new_stream(vs->format_ctx, encoder);
-    if (!ostream) {
-        LOG_OOM();
-        goto error_avformat_free_context;
-    }
-
-    int r = avcodec_parameters_from_context(ostream->codecpar, ctx);
-    if (r < 0) {
-        goto error_avformat_free_context;
-    }
-
-    // The codec is from the v4l2 encoder, not from the decoder
-    ostream->codecpar->codec_id = encoder->id;
-
-    int ret = avio_open(&vs->format_ctx->pb, vs->device_name, AVIO_FLAG_WRITE);
-    if (ret < 0) {
-        LOGE("Failed to open output device: %s", vs->device_name);
-        // ostream will be cleaned up during context cleaning
-        goto error_avformat_free_context;
+    if (!sc_v4l2_sink_set_format(vs, ctx)) {
+        goto error_close_fd;
     }
 
-    vs->encoder_ctx = avcodec_alloc_context3(encoder);
-    if (!vs->encoder_ctx) {
+    vs->buffer = malloc(vs->image_size);
+    if (!vs->buffer) {
         LOG_OOM();
-        goto error_avio_close;
+        goto error_close_fd;
     }
 
-    vs->encoder_ctx->width = ctx->width;
-    vs->encoder_ctx->height = ctx->height;
-    vs->encoder_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
-    vs->encoder_ctx->time_base.num = 1;
-    vs->encoder_ctx->time_base.den = 1;
-
-    if (avcodec_open2(vs->encoder_ctx, encoder, NULL) < 0) {
-        LOGE("Could not open codec for v4l2");
-        goto error_avcodec_free_context;
-    }
+    vs->sws_ctx = NULL;
 
     vs->frame = av_frame_alloc();
     if (!vs->frame) {
         LOG_OOM();
-        goto error_avcodec_close;
-    }
-
-    vs->packet = av_packet_alloc();
-    if (!vs->packet) {
-        LOG_OOM();
-        goto error_av_frame_free;
+        goto error_free_buffer;
     }
 
     vs->has_frame = false;
-    vs->header_written = false;
     vs->stopped = false;
 
     LOGD("Starting v4l2 thread");
     ok = sc_thread_create(&vs->thread, run_v4l2_sink, "scrcpy-v4l2", vs);
     if (!ok) {
         LOGE("Could not start v4l2 thread");
-        goto error_av_packet_free;
+        goto error_av_frame_free;
     }
 
     LOGI("v4l2 sink started to device: %s", vs->device_name);
 
     return true;
 
-error_av_packet_free:
-    av_packet_free(&vs->packet);
 error_av_frame_free:
     av_frame_free(&vs->frame);
-error_avcodec_close:
-    avcodec_close(vs->encoder_ctx);
-error_avcodec_free_context:
-    avcodec_free_context(&vs->encoder_ctx);
-error_avio_close:
-    avio_close(vs->format_ctx->pb);
-error_avformat_free_context:
-    avformat_free_context(vs->format_ctx);
+error_free_buffer:
+    free(vs->buffer);
+error_close_fd:
+    close(vs->fd);
 error_cond_destroy:
     sc_cond_destroy(&vs->cond);
 error_mutex_destroy:
@@ -295,12 +377,10 @@ sc_v4l2_sink_close(struct sc_v4l2_sink *vs) {
 
     sc_thread_join(&vs->thread, NULL);
 
-    av_packet_free(&vs->packet);
+    sws_freeContext(vs->sws_ctx);
     av_frame_free(&vs->frame);
-    avcodec_close(vs->encoder_ctx);
-    avcodec_free_context(&vs->encoder_ctx);
-    avio_close(vs->format_ctx->pb);
-    avformat_free_context(vs->format_ctx);
+    free(vs->buffer);
+    close(vs->fd);
     sc_cond_destroy(&vs->cond);
     sc_mutex_destroy(&vs->mutex);
     sc_frame_buffer_destroy(&vs->fb);
@@ -343,7 +423,8 @@ sc_v4l2_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
 }
 
 bool
-sc_v4l2_sink_init(struct sc_v4l2_sink *vs, const char *device_name) {
+sc_v4l2_sink_init(struct sc_v4l2_sink *vs, const char *device_name,
+                  enum sc_v4l2_format format, uint16_t max_size) {
     vs->device_name = strdup(device_name);
     if (!vs->device_name) {
         LOGE("Could not strdup v4l2 device name");
@@ -358,6 +439,9 @@ sc_v4l2_sink_init(struct sc_v4l2_sink *vs, const char *device_name) {
 
     vs->frame_sink.ops = &ops;
 
+    vs->format = format;
+    vs->max_size = max_size;
+
     return true;
 }
 
@@ -3,36 +3,57 @@
 
 #include "common.h"
 
+#include <stddef.h>
 #include <libavcodec/avcodec.h>
-#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
 
 #include "coords.h"
 #include "trait/frame_sink.h"
 #include "frame_buffer.h"
+#include "options.h"
+#include "util/thread.h"
 #include "util/tick.h"
 
+struct sc_v4l2_sink_plane {
+    unsigned width; // in bytes
+    unsigned height;
+    unsigned stride; // in the device image
+};
+
 struct sc_v4l2_sink {
     struct sc_frame_sink frame_sink; // frame sink trait
 
     struct sc_frame_buffer fb;
-    AVFormatContext *format_ctx;
-    AVCodecContext *encoder_ctx;
 
     char *device_name;
+    enum sc_v4l2_format format;
+    uint16_t max_size;
+    int fd;
+
+    // Size and layout of an image expected by the device
+    struct sc_size size;
+    struct sc_v4l2_sink_plane planes[3];
+    unsigned plane_count;
+    size_t image_size;
+    // Used to pack or convert the frames not laid out as expected
+    uint8_t *buffer;
+
+    // Set if the frames must be scaled or converted to another pixel format
+    bool convert;
+    struct SwsContext *sws_ctx;
 
     sc_thread thread;
     sc_mutex mutex;
     sc_cond cond;
     bool has_frame;
     bool stopped;
-    bool header_written;
 
     AVFrame *frame;
-    AVPacket *packet;
 };
 
 bool
-sc_v4l2_sink_init(struct sc_v4l2_sink *vs, const char *device_name);
+sc_v4l2_sink_init(struct sc_v4l2_sink *vs, const char *device_name,
+                  enum sc_v4l2_format format, uint16_t max_size);
 
 void
 sc_v4l2_sink_destroy(struct sc_v4l2_sink *vs);
@@ -4,7 +4,7 @@
 #include <libavformat/avformat.h>
 #include <libavutil/avutil.h>
 #ifdef HAVE_V4L2
-# include <libavdevice/avdevice.h>
+# include <libswscale/swscale.h>
 #endif
 #ifdef HAVE_USB
 # include <libusb-1.0/libusb.h>
@@ -48,14 +48,14 @@ scrcpy_print_version(void) {
            AV_VERSION_MICRO(avutil));
 
 #ifdef HAVE_V4L2
-    unsigned avdevice = avdevice_version();
-    printf(" - libavdevice: %u.%u.%u / %u.%u.%u\n",
-           LIBAVDEVICE_VERSION_MAJOR,
-           LIBAVDEVICE_VERSION_MINOR,
-           LIBAVDEVICE_VERSION_MICRO,
-           AV_VERSION_MAJOR(avdevice),
-           AV_VERSION_MINOR(avdevice),
-           AV_VERSION_MICRO(avdevice));
+    unsigned swscale = swscale_version();
+    printf(" - libswscale: %u.%u.%u / %u.%u.%u\n",
+           LIBSWSCALE_VERSION_MAJOR,
+           LIBSWSCALE_VERSION_MINOR,
+           LIBSWSCALE_VERSION_MICRO,
+           AV_VERSION_MAJOR(swscale),
+           AV_VERSION_MINOR(swscale),
+           AV_VERSION_MICRO(swscale));
 #endif
 
 #ifdef HAVE_USB
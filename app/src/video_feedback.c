@@ -0,0 +1,170 @@
+#include "video_feedback.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "util/log.h"
+
+/** Downcast packet_sink to video_feedback */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_video_feedback, packet_sink)
+
+// The baseline is the minimum over the current and previous windows, so it
+// adapts to clock drift in less than 2 windows
+#define SC_VIDEO_FEEDBACK_WINDOW SC_TICK_FROM_SEC(5)
+#define SC_VIDEO_FEEDBACK_REPORT_INTERVAL SC_TICK_FROM_MS(500)
+
+static bool
+sc_video_feedback_packet_sink_open(struct sc_packet_sink *sink,
+                                   AVCodecContext *ctx) {
+    struct sc_video_feedback *fb = DOWNCAST(sink);
+
+    fb->min_offset[0] = INT64_MAX;
+    fb->min_offset[1] = INT64_MAX;
+    fb->window_start = sc_tick_now();
+    fb->has_last = false;
+    fb->jitter = 0;
+    fb->delay_sum = 0;
+    fb->delay_count = 0;
+    fb->next_report = fb->window_start + SC_VIDEO_FEEDBACK_REPORT_INTERVAL;
+
+    if (fb->adaptive_size) {
+        uint16_t video_size = MIN(MAX(ctx->width, ctx->height), UINT16_MAX);
+        sc_video_ladder_init(&fb->ladder, fb->window_start, video_size,
+                             fb->max_size, fb->max_fps);
+    }
+
+    return true;
+}
+
+static void
+sc_video_feedback_packet_sink_close(struct sc_packet_sink *sink) {
+    (void) sink;
+    // Nothing to do
+}
+
+static void
+sc_video_feedback_report(struct sc_video_feedback *fb, int64_t avg) {
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_VIDEO_FEEDBACK;
+    msg.video_feedback.queuing_delay = MIN(avg, UINT32_MAX);
+    msg.video_feedback.jitter = MIN(fb->jitter, UINT32_MAX);
+
+    if (!sc_controller_push_msg(fb->controller, &msg)) {
+        // Not fatal, the next report will be sent
+        LOGW("Could not request 'video feedback'");
+    }
+}
+
+static void
+sc_video_feedback_update_ladder(struct sc_video_feedback *fb, sc_tick now,
+                                int64_t avg) {
+    unsigned previous = fb->ladder.index;
+    if (!sc_video_ladder_update(&fb->ladder, now, avg)) {
+        return;
+    }
+
+    const struct sc_video_ladder_rung *rung =
+        sc_video_ladder_get_rung(&fb->ladder);
+
+    if (!fb->ladder.index) {
+        LOGI("Adaptive size: restore initial video limits");
+    } else {
+        const char *dir = fb->ladder.index > previous ? "lower" : "raise";
+        if (rung->max_fps) {
+            LOGI("Adaptive size: %s video limits to %" PRIu16 " at %" PRIu16
+                 " fps (queuing delay: %" PRItick " ms)", dir,
+                 rung->max_size, rung->max_fps, SC_TICK_TO_MS(avg));
+        } else {
+            LOGI("Adaptive size: %s video size to %" PRIu16
+                 " (queuing delay: %" PRItick " ms)", dir, rung->max_size,
+                 SC_TICK_TO_MS(avg));
+        }
+    }
+
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_SET_VIDEO_LIMITS;
+    msg.set_video_limits.max_size = rung->max_size;
+    msg.set_video_limits.max_fps = rung->max_fps;
+
+    if (!sc_controller_push_msg(fb->controller, &msg)) {
+        LOGW("Could not request video limits change");
+    }
+}
+
+static bool
+sc_video_feedback_packet_sink_push(struct sc_packet_sink *sink,
+                                   const AVPacket *packet) {
+    struct sc_video_feedback *fb = DOWNCAST(sink);
+
+    if (packet->pts == AV_NOPTS_VALUE) {
+        // Config packet
+        return true;
+    }
+
+    sc_tick now = sc_tick_now();
+
+    // The clocks of the device and the computer are unrelated, only the
+    // variations of this offset are meaningful
+    int64_t offset = now - packet->pts;
+
+    if (now - fb->window_start >= SC_VIDEO_FEEDBACK_WINDOW) {
+        fb->min_offset[1] = fb->min_offset[0];
+        fb->min_offset[0] = INT64_MAX;
+        fb->window_start = now;
+    }
+
+    if (offset < fb->min_offset[0]) {
+        fb->min_offset[0] = offset;
+    }
+
+    int64_t baseline = MIN(fb->min_offset[0], fb->min_offset[1]);
+    fb->delay_sum += offset - baseline;
+    ++fb->delay_count;
+
+    if (fb->has_last) {
+        // Inter-arrival jitter, as defined in RFC 3550 (section 6.4.1)
+        int64_t d = (now - fb->last_date) - (packet->pts - fb->last_pts);
+        fb->jitter += (llabs(d) - fb->jitter) / 16;
+    }
+    fb->last_date = now;
+    fb->last_pts = packet->pts;
+    fb->has_last = true;
+
+    if (now >= fb->next_report) {
+        assert(fb->delay_count);
+        int64_t avg = fb->delay_sum / fb->delay_count;
+        if (fb->report) {
+            sc_video_feedback_report(fb, avg);
+        }
+        if (fb->adaptive_size) {
+            sc_video_feedback_update_ladder(fb, now, avg);
+        }
+        fb->delay_sum = 0;
+        fb->delay_count = 0;
+        fb->next_report = now + SC_VIDEO_FEEDBACK_REPORT_INTERVAL;
+    }
+
+    return true;
+}
+
+void
+sc_video_feedback_init(struct sc_video_feedback *fb,
+                       struct sc_controller *controller,
+                       const struct sc_video_feedback_params *params) {
+    assert(controller);
+    assert(params->report || params->adaptive_size);
+    fb->controller = controller;
+    fb->report = params->report;
+    fb->adaptive_size = params->adaptive_size;
+    fb->max_size = params->max_size;
+    fb->max_fps = params->max_fps;
+
+    static const struct sc_packet_sink_ops ops = {
+        .open = sc_video_feedback_packet_sink_open,
+        .close = sc_video_feedback_packet_sink_close,
+        .push = sc_video_feedback_packet_sink_push,
+    };
+
+    fb->packet_sink.ops = &ops;
+}
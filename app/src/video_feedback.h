@@ -0,0 +1,64 @@
+#ifndef SC_VIDEO_FEEDBACK_H
+#define SC_VIDEO_FEEDBACK_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "controller.h"
+#include "trait/packet_sink.h"
+#include "util/tick.h"
+#include "video_ladder.h"
+
+/**
+ * Video packet sink measuring the network conditions, and periodically
+ * reporting them to the device, so that the encoder may adapt its bitrate,
+ * and/or stepping through a ladder of video limits (size and frame rate).
+ *
+ * The queuing delay is estimated from the variation of the difference between
+ * the reception date and the PTS (capture date on the device): the minimal
+ * value over a recent window is considered as the delay without congestion.
+ */
+struct sc_video_feedback {
+    struct sc_packet_sink packet_sink; // packet sink trait
+
+    struct sc_controller *controller;
+    bool report;
+    bool adaptive_size;
+    uint16_t max_size;
+    uint16_t max_fps;
+
+    // The following fields are only accessed from the demuxer thread
+
+    // Minimal (reception date - PTS) of the current and previous windows
+    int64_t min_offset[2];
+    sc_tick window_start;
+
+    bool has_last;
+    sc_tick last_date;
+    int64_t last_pts;
+    float jitter; // in microseconds
+
+    int64_t delay_sum;
+    unsigned delay_count;
+    sc_tick next_report;
+
+    struct sc_video_ladder ladder;
+};
+
+struct sc_video_feedback_params {
+    // Report the measurements to the device (for the bit rate)
+    bool report;
+    // Adapt the video size and frame rate, from the initial limits
+    bool adaptive_size;
+    uint16_t max_size;
+    uint16_t max_fps;
+};
+
+void
+sc_video_feedback_init(struct sc_video_feedback *fb,
+                       struct sc_controller *controller,
+                       const struct sc_video_feedback_params *params);
+
+#endif
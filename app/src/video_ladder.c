@@ -0,0 +1,106 @@
+#include "video_ladder.h"
+
+#include <assert.h>
+
+// Ignore the measurements just after a change (the encoder restarts with a
+// key frame, which is larger than the following ones)
+#define SC_VIDEO_LADDER_SETTLE_DELAY SC_TICK_FROM_SEC(3)
+// Step down after 2 consecutive congested measurements (1 second)
+#define SC_VIDEO_LADDER_CONGESTED_DELAY SC_TICK_FROM_MS(150)
+#define SC_VIDEO_LADDER_CONGESTED_COUNT 2
+// Step up once the delay stayed low for a while
+#define SC_VIDEO_LADDER_CLEAR_DELAY SC_TICK_FROM_MS(30)
+#define SC_VIDEO_LADDER_UP_WAIT SC_TICK_FROM_SEC(20)
+#define SC_VIDEO_LADDER_UP_WAIT_MAX SC_TICK_FROM_SEC(160)
+// A step down shortly after a step up doubles the wait for the next step up
+#define SC_VIDEO_LADDER_UP_FAILURE_DELAY SC_TICK_FROM_SEC(30)
+
+static const struct sc_video_ladder_rung sc_video_ladder_steps[] = {
+    {1920, 0},
+    {1600, 0},
+    {1280, 0},
+    {1024, 30},
+    {800, 30},
+    {640, 24},
+};
+
+void
+sc_video_ladder_init(struct sc_video_ladder *ladder, sc_tick now,
+                     uint16_t video_size, uint16_t max_size, uint16_t max_fps) {
+    // The first rung restores the initial limits
+    ladder->rungs[0].max_size = max_size;
+    ladder->rungs[0].max_fps = max_fps;
+    ladder->count = 1;
+
+    for (size_t i = 0; i < ARRAY_LEN(sc_video_ladder_steps); ++i) {
+        const struct sc_video_ladder_rung *step = &sc_video_ladder_steps[i];
+        if (video_size && step->max_size >= video_size) {
+            continue;
+        }
+
+        uint16_t fps = step->max_fps;
+        if (!fps || (max_fps && max_fps < fps)) {
+            fps = max_fps;
+        }
+
+        assert(ladder->count < SC_VIDEO_LADDER_MAX_RUNGS);
+        ladder->rungs[ladder->count].max_size = step->max_size;
+        ladder->rungs[ladder->count].max_fps = fps;
+        ++ladder->count;
+    }
+
+    ladder->index = 0;
+    ladder->last_change = now;
+    ladder->has_stepped_up = false;
+    ladder->last_up = 0;
+    ladder->congested = 0;
+    ladder->clear_since = now + SC_VIDEO_LADDER_SETTLE_DELAY;
+    ladder->up_wait = SC_VIDEO_LADDER_UP_WAIT;
+}
+
+bool
+sc_video_ladder_update(struct sc_video_ladder *ladder, sc_tick now,
+                       sc_tick delay) {
+    if (now - ladder->last_change < SC_VIDEO_LADDER_SETTLE_DELAY) {
+        ladder->congested = 0;
+        return false;
+    }
+
+    if (delay >= SC_VIDEO_LADDER_CONGESTED_DELAY) {
+        ladder->clear_since = now;
+        if (++ladder->congested < SC_VIDEO_LADDER_CONGESTED_COUNT
+                || ladder->index + 1 == ladder->count) {
+            return false;
+        }
+
+        if (ladder->has_stepped_up
+                && now - ladder->last_up < SC_VIDEO_LADDER_UP_FAILURE_DELAY) {
+            ladder->up_wait = MIN(ladder->up_wait * 2,
+                                  SC_VIDEO_LADDER_UP_WAIT_MAX);
+        }
+
+        ++ladder->index;
+        ladder->last_change = now;
+        ladder->congested = 0;
+        ladder->clear_since = now + SC_VIDEO_LADDER_SETTLE_DELAY;
+        return true;
+    }
+
+    ladder->congested = 0;
+
+    if (delay > SC_VIDEO_LADDER_CLEAR_DELAY) {
+        ladder->clear_since = now;
+        return false;
+    }
+
+    if (!ladder->index || now - ladder->clear_since < ladder->up_wait) {
+        return false;
+    }
+
+    --ladder->index;
+    ladder->last_change = now;
+    ladder->has_stepped_up = true;
+    ladder->last_up = now;
+    ladder->clear_since = now + SC_VIDEO_LADDER_SETTLE_DELAY;
+    return true;
+}
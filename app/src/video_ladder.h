@@ -0,0 +1,64 @@
+#ifndef SC_VIDEO_LADDER_H
+#define SC_VIDEO_LADDER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util/tick.h"
+
+#define SC_VIDEO_LADDER_MAX_RUNGS 8
+
+struct sc_video_ladder_rung {
+    uint16_t max_size; // 0 for no limit
+    uint16_t max_fps; // 0 for no limit
+};
+
+/**
+ * Ladder of video limits, from the initial limits (the first rung) to the
+ * smallest size and frame rate, selected from the measured queuing delay
+ *
+ * On sustained congestion, the ladder steps down immediately; it steps back up
+ * only once the network has been clear for a while (longer if the previous
+ * step up had to be reverted quickly), so that the encoder is not restarted
+ * back and forth.
+ */
+struct sc_video_ladder {
+    struct sc_video_ladder_rung rungs[SC_VIDEO_LADDER_MAX_RUNGS];
+    unsigned count;
+    unsigned index; // current rung
+
+    sc_tick last_change;
+    bool has_stepped_up;
+    sc_tick last_up;
+    unsigned congested; // consecutive congested measurements
+    sc_tick clear_since;
+    sc_tick up_wait;
+};
+
+/**
+ * Initialize the ladder
+ *
+ * The video_size is the initial size of the largest video dimension (0 if
+ * unknown): the predefined rungs which are not smaller are skipped.
+ */
+void
+sc_video_ladder_init(struct sc_video_ladder *ladder, sc_tick now,
+                     uint16_t video_size, uint16_t max_size, uint16_t max_fps);
+
+/**
+ * Account for a new measurement of the queuing delay
+ *
+ * Return true if the current rung changed.
+ */
+bool
+sc_video_ladder_update(struct sc_video_ladder *ladder, sc_tick now,
+                       sc_tick delay);
+
+static inline const struct sc_video_ladder_rung *
+sc_video_ladder_get_rung(const struct sc_video_ladder *ladder) {
+    return &ladder->rungs[ladder->index];
+}
+
+#endif
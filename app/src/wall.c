@@ -0,0 +1,1137 @@
+#include "wall.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL.h>
+#include <libavutil/pixdesc.h>
+
+#include "controller.h"
+#include "decoder.h"
+#include "demuxer.h"
+#include "events.h"
+#include "frame_buffer.h"
+#include "recorder.h"
+#include "server.h"
+#include "trait/frame_sink.h"
+#include "util/file.h"
+#include "util/log.h"
+#include "util/rand.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+#define SC_WALL_MAX_TILES 32
+#define SC_WALL_DEFAULT_WIDTH 1280
+#define SC_WALL_DEFAULT_HEIGHT 720
+
+#define DOWNCAST(SINK) container_of(SINK, struct sc_wall_tile, frame_sink)
+
+struct sc_wall;
+
+struct sc_wall_tile {
+    struct sc_frame_sink frame_sink; // frame sink trait
+
+    struct sc_wall *wall;
+    char *serial;
+
+    struct sc_server server;
+    struct sc_controller controller;
+    struct sc_demuxer demuxer;
+    struct sc_decoder decoder;
+    struct sc_frame_buffer fb;
+    struct sc_recorder recorder;
+
+    bool server_initialized;
+    bool server_started;
+    bool controller_initialized;
+    bool controller_started;
+    bool demuxer_initialized;
+    bool demuxer_started;
+    bool decoder_initialized;
+    bool recorder_initialized;
+    bool recorder_started;
+
+    // Only accessed from the main thread
+    AVFrame *frame;
+    // Set if the device currently encodes at the background frame rate
+    bool background_limits;
+    SDL_Texture *texture;
+    struct sc_size texture_size;
+    bool unsupported_format_logged;
+    bool ended;
+
+    // Requested for the decoder thread of the focused tile
+    atomic_bool high_priority;
+    bool high_priority_applied; // only accessed from the decoder thread
+};
+
+struct sc_wall {
+    // If false, the devices are only recorded (headless), there is no window
+    bool playback;
+
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+
+    struct sc_wall_tile tiles[SC_WALL_MAX_TILES];
+    unsigned count;
+    unsigned ended_count;
+
+    // The decoder threads budget is shared between all the tiles
+    enum sc_video_decoder_threading decoder_threading;
+    unsigned decoder_threads; // per tile
+
+    // Set if the tiles are scheduled according to the focus (control is then
+    // enabled, only to request keyframes and video limits)
+    bool focus_enabled;
+    // If not 0, only the keyframes of the tiles which are not focused are
+    // decoded, and a keyframe is requested from each of them at this interval
+    sc_tick preview_interval;
+    sc_tick next_preview_request;
+    // If not 0, the devices which are not focused are limited to this frame
+    // rate (live, without restarting the servers)
+    uint16_t background_fps;
+    // The initial video limits, restored for the focused tile
+    uint16_t max_size;
+    uint16_t max_fps;
+    // The tile with the full frame rate and decoding, may be NULL (only used
+    // if focus_enabled, only accessed from the main thread)
+    struct sc_wall_tile *focused;
+
+    // Set while a SC_EVENT_NEW_FRAME is in the event queue (shared by all the
+    // tiles)
+    atomic_bool new_frame_event_queued;
+};
+
+static void
+sc_wall_push_event(uint32_t type, struct sc_wall_tile *tile) {
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = type;
+    event.user.data1 = tile;
+    int ret = SDL_PushEvent(&event);
+    if (ret < 0) {
+        LOGE("Could not post event: %s", SDL_GetError());
+    }
+}
+
+static void
+sc_wall_on_connection_failed(struct sc_server *server, void *userdata) {
+    (void) server;
+    sc_wall_push_event(SC_EVENT_SERVER_CONNECTION_FAILED, userdata);
+}
+
+static void
+sc_wall_on_connected(struct sc_server *server, void *userdata) {
+    (void) server;
+    sc_wall_push_event(SC_EVENT_SERVER_CONNECTED, userdata);
+}
+
+static void
+sc_wall_on_disconnected(struct sc_server *server, void *userdata) {
+    (void) server;
+    (void) userdata;
+    // Do nothing, the disconnection will be handled by the demuxer
+}
+
+static void
+sc_wall_on_demuxer_ended(struct sc_demuxer *demuxer,
+                         enum sc_demuxer_status status, void *userdata) {
+    (void) demuxer;
+
+    if (status == SC_DEMUXER_STATUS_EOS) {
+        sc_wall_push_event(SC_EVENT_DEVICE_DISCONNECTED, userdata);
+    } else {
+        sc_wall_push_event(SC_EVENT_DEMUXER_ERROR, userdata);
+    }
+}
+
+static void
+sc_wall_on_recorder_ended(struct sc_recorder *recorder, bool success,
+                          void *userdata) {
+    (void) recorder;
+
+    if (!success) {
+        sc_wall_push_event(SC_EVENT_RECORDER_ERROR, userdata);
+    }
+}
+
+static bool
+sc_wall_tile_frame_sink_open(struct sc_frame_sink *sink,
+                             const AVCodecContext *ctx) {
+    (void) sink;
+    (void) ctx;
+    return true;
+}
+
+static void
+sc_wall_tile_frame_sink_close(struct sc_frame_sink *sink) {
+    (void) sink;
+}
+
+static bool
+sc_wall_tile_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
+    struct sc_wall_tile *tile = DOWNCAST(sink);
+    struct sc_wall *wall = tile->wall;
+
+    bool high_priority = atomic_load_explicit(&tile->high_priority,
+                                              memory_order_relaxed);
+    if (high_priority != tile->high_priority_applied) {
+        // The frame sink is called from the decoder thread (the demuxer
+        // thread), so this is the thread to prioritize
+        bool ok = sc_thread_set_priority(high_priority
+                                            ? SC_THREAD_PRIORITY_HIGH
+                                            : SC_THREAD_PRIORITY_NORMAL);
+        (void) ok; // We don't care if it worked, at least we tried
+        tile->high_priority_applied = high_priority;
+    }
+
+    bool ok = sc_frame_buffer_push(&tile->fb, frame, NULL);
+    if (!ok) {
+        return false;
+    }
+
+    // A single event wakes up the main thread for the frames of all the tiles
+    if (!atomic_exchange(&wall->new_frame_event_queued, true)) {
+        static SDL_Event new_frame_event = {
+            .type = SC_EVENT_NEW_FRAME,
+        };
+
+        int ret = SDL_PushEvent(&new_frame_event);
+        if (ret < 0) {
+            LOGW("Could not post new frame event: %s", SDL_GetError());
+            atomic_store(&wall->new_frame_event_queued, false);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void
+sc_wall_tile_end(struct sc_wall *wall, struct sc_wall_tile *tile) {
+    if (!tile->ended) {
+        tile->ended = true;
+        ++wall->ended_count;
+    }
+}
+
+static void
+sc_wall_tile_set_video_limits(struct sc_wall_tile *tile, bool background) {
+    struct sc_wall *wall = tile->wall;
+    if (!wall->background_fps || background == tile->background_limits) {
+        return;
+    }
+
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_SET_VIDEO_LIMITS;
+    msg.set_video_limits.max_size = wall->max_size;
+    msg.set_video_limits.max_fps = background ? wall->background_fps
+                                              : wall->max_fps;
+    if (!sc_controller_push_msg(&tile->controller, &msg)) {
+        LOGW("Device %s: could not request video limits change",
+             tile->serial);
+        return;
+    }
+
+    tile->background_limits = background;
+}
+
+// Apply the QoS of a focused (or not focused) tile, once its stream is started
+static void
+sc_wall_tile_apply_focus(struct sc_wall_tile *tile, bool focused) {
+    struct sc_wall *wall = tile->wall;
+    assert(wall->focus_enabled);
+
+    if (tile->decoder_initialized) {
+        if (wall->preview_interval) {
+            // On disabling, the decoder requests a keyframe itself
+            sc_decoder_set_keyframes_only(&tile->decoder, !focused);
+        }
+        if (wall->background_fps) {
+            // The tiles which are not focused are small and not watched
+            sc_decoder_set_fast_decoding(&tile->decoder, !focused);
+        }
+    }
+
+    atomic_store_explicit(&tile->high_priority, focused,
+                          memory_order_relaxed);
+
+    if (tile->controller_started) {
+        sc_wall_tile_set_video_limits(tile, !focused);
+    }
+}
+
+static bool
+sc_wall_tile_start_stream(struct sc_wall_tile *tile) {
+    static const struct sc_demuxer_callbacks demuxer_cbs = {
+        .on_ended = sc_wall_on_demuxer_ended,
+    };
+    if (!sc_demuxer_init(&tile->demuxer, "video", tile->server.video_socket,
+                         0, 0, NULL, &demuxer_cbs, tile)) {
+        return false;
+    }
+    tile->demuxer_initialized = true;
+
+    struct sc_wall *wall = tile->wall;
+
+    if (wall->focus_enabled) {
+        // Only used to request keyframes and video limits
+        if (!sc_controller_init(&tile->controller, tile->server.control_socket,
+                                NULL, NULL, NULL)) {
+            return false;
+        }
+        tile->controller_initialized = true;
+
+        // A single thread per device for both directions of the socket
+        if (!sc_controller_enable_io_loop(&tile->controller)) {
+            return false;
+        }
+
+        if (!sc_controller_start(&tile->controller)) {
+            return false;
+        }
+        tile->controller_started = true;
+    }
+
+    if (wall->playback) {
+        // Software decoding, the frames are uploaded from the main thread
+        struct sc_decoder_params decoder_params = {
+            .controller = tile->controller_initialized ? &tile->controller
+                                                        : NULL,
+            .threading = wall->decoder_threading,
+            .thread_count = wall->decoder_threads,
+        };
+        if (!sc_decoder_init(&tile->decoder, "video", &decoder_params)) {
+            return false;
+        }
+        tile->decoder_initialized = true;
+
+        if (!sc_packet_source_add_sink(&tile->demuxer.packet_source,
+                                       &tile->decoder.packet_sink)) {
+            return false;
+        }
+
+        if (!sc_frame_source_add_sink(&tile->decoder.frame_source,
+                                      &tile->frame_sink)) {
+            return false;
+        }
+    }
+
+    if (tile->recorder_started) {
+        if (!sc_packet_source_add_sink(&tile->demuxer.packet_source,
+                                       &tile->recorder.video_packet_sink)) {
+            return false;
+        }
+    }
+
+    if (wall->focus_enabled) {
+        sc_wall_tile_apply_focus(tile, tile == wall->focused);
+    }
+
+    if (!sc_demuxer_start(&tile->demuxer)) {
+        return false;
+    }
+    tile->demuxer_started = true;
+
+    return true;
+}
+
+static bool
+sc_wall_tile_update_frame(struct sc_wall *wall, struct sc_wall_tile *tile) {
+    av_frame_unref(tile->frame);
+    sc_frame_buffer_consume(&tile->fb, tile->frame);
+    AVFrame *frame = tile->frame;
+
+    if (frame->format != AV_PIX_FMT_YUV420P) {
+        if (!tile->unsupported_format_logged) {
+            LOGW("Device %s: unsupported frame format: %s", tile->serial,
+                 av_get_pix_fmt_name(frame->format));
+            tile->unsupported_format_logged = true;
+        }
+        return true;
+    }
+
+    struct sc_size size = {frame->width, frame->height};
+    if (!tile->texture || size.width != tile->texture_size.width
+                       || size.height != tile->texture_size.height) {
+        if (tile->texture) {
+            SDL_DestroyTexture(tile->texture);
+        }
+
+        tile->texture = SDL_CreateTexture(wall->renderer,
+                                          SDL_PIXELFORMAT_YV12,
+                                          SDL_TEXTUREACCESS_STREAMING,
+                                          size.width, size.height);
+        if (!tile->texture) {
+            LOGE("Could not create texture: %s", SDL_GetError());
+            return false;
+        }
+
+        tile->texture_size = size;
+        LOGI("Device %s: texture %" PRIu16 "x%" PRIu16, tile->serial,
+             size.width, size.height);
+    }
+
+    int ret = SDL_UpdateYUVTexture(tile->texture, NULL,
+                                   frame->data[0], frame->linesize[0],
+                                   frame->data[1], frame->linesize[1],
+                                   frame->data[2], frame->linesize[2]);
+    if (ret) {
+        LOGE("Could not update texture: %s", SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+// Fit the content into the cell, preserving the aspect ratio
+static SDL_Rect
+sc_wall_fit(SDL_Rect cell, struct sc_size content) {
+    SDL_Rect rect;
+    if ((int64_t) content.width * cell.h > (int64_t) content.height * cell.w) {
+        rect.w = cell.w;
+        rect.h = (int64_t) cell.w * content.height / content.width;
+    } else {
+        rect.h = cell.h;
+        rect.w = (int64_t) cell.h * content.width / content.height;
+    }
+    rect.x = cell.x + (cell.w - rect.w) / 2;
+    rect.y = cell.y + (cell.h - rect.h) / 2;
+    return rect;
+}
+
+// The smallest square grid containing all the tiles, without empty rows
+static void
+sc_wall_get_grid(const struct sc_wall *wall, unsigned *cols, unsigned *rows) {
+    unsigned c = 1;
+    while (c * c < wall->count) {
+        ++c;
+    }
+    *cols = c;
+    *rows = (wall->count + c - 1) / c;
+}
+
+static void
+sc_wall_render(struct sc_wall *wall) {
+    SDL_RenderClear(wall->renderer);
+
+    int dw;
+    int dh;
+    if (SDL_GetRendererOutputSize(wall->renderer, &dw, &dh)) {
+        LOGW("Could not get renderer output size: %s", SDL_GetError());
+        return;
+    }
+
+    unsigned cols;
+    unsigned rows;
+    sc_wall_get_grid(wall, &cols, &rows);
+
+    for (unsigned i = 0; i < wall->count; ++i) {
+        struct sc_wall_tile *tile = &wall->tiles[i];
+        if (!tile->texture) {
+            continue;
+        }
+
+        unsigned col = i % cols;
+        unsigned row = i / cols;
+
+        SDL_Rect cell;
+        cell.x = col * dw / cols;
+        cell.y = row * dh / rows;
+        cell.w = (col + 1) * dw / cols - cell.x;
+        cell.h = (row + 1) * dh / rows - cell.y;
+
+        SDL_Rect rect = sc_wall_fit(cell, tile->texture_size);
+        if (SDL_RenderCopy(wall->renderer, tile->texture, NULL, &rect)) {
+            LOGW("Could not render texture: %s", SDL_GetError());
+        }
+
+        if (tile == wall->focused) {
+            SDL_SetRenderDrawColor(wall->renderer, 0xff, 0xff, 0xff, 0xff);
+            SDL_RenderDrawRect(wall->renderer, &rect);
+            // Restore the color used by SDL_RenderClear()
+            SDL_SetRenderDrawColor(wall->renderer, 0, 0, 0, 0xff);
+        }
+    }
+
+    SDL_RenderPresent(wall->renderer);
+}
+
+static bool
+sc_wall_update_frames(struct sc_wall *wall) {
+    // Reset the flag before consuming, so that a frame pushed meanwhile posts
+    // a new event
+    atomic_store(&wall->new_frame_event_queued, false);
+
+    bool updated = false;
+
+    // Upload the frame of the focused tile first, so that its latency does
+    // not depend on the number of tiles
+    struct sc_wall_tile *focused = wall->focused;
+    if (focused && sc_frame_buffer_has_pending(&focused->fb)) {
+        if (!sc_wall_tile_update_frame(wall, focused)) {
+            return false;
+        }
+        updated = true;
+    }
+
+    for (unsigned i = 0; i < wall->count; ++i) {
+        struct sc_wall_tile *tile = &wall->tiles[i];
+        if (tile != focused && sc_frame_buffer_has_pending(&tile->fb)) {
+            if (!sc_wall_tile_update_frame(wall, tile)) {
+                return false;
+            }
+            updated = true;
+        }
+    }
+
+    if (updated) {
+        // Render all the tiles at once
+        sc_wall_render(wall);
+    }
+
+    return true;
+}
+
+// Return the tile at the given window position, or NULL if there is none
+static struct sc_wall_tile *
+sc_wall_get_tile_at(struct sc_wall *wall, int x, int y) {
+    int ww;
+    int wh;
+    SDL_GetWindowSize(wall->window, &ww, &wh);
+    if (x < 0 || y < 0 || x >= ww || y >= wh) {
+        return NULL;
+    }
+
+    // The grid cells only depend on the relative position (the renderer
+    // output size may differ from the window size in HiDPI)
+    unsigned cols;
+    unsigned rows;
+    sc_wall_get_grid(wall, &cols, &rows);
+
+    unsigned col = (int64_t) x * cols / ww;
+    unsigned row = (int64_t) y * rows / wh;
+    unsigned i = row * cols + col;
+    if (i >= wall->count) {
+        return NULL;
+    }
+
+    return &wall->tiles[i];
+}
+
+static void
+sc_wall_set_focus(struct sc_wall *wall, struct sc_wall_tile *tile) {
+    struct sc_wall_tile *old = wall->focused;
+    if (tile == old) {
+        return;
+    }
+
+    // The tiles not started yet apply their focus on start
+    if (old && old->demuxer_started) {
+        sc_wall_tile_apply_focus(old, false);
+    }
+    if (tile && tile->demuxer_started) {
+        sc_wall_tile_apply_focus(tile, true);
+    }
+
+    wall->focused = tile;
+    if (tile) {
+        LOGI("Device %s: focused", tile->serial);
+    }
+
+    sc_wall_render(wall);
+}
+
+static void
+sc_wall_handle_click(struct sc_wall *wall, const SDL_MouseButtonEvent *event) {
+    if (event->button != SDL_BUTTON_LEFT) {
+        return;
+    }
+
+    struct sc_wall_tile *tile = sc_wall_get_tile_at(wall, event->x, event->y);
+    if (!tile) {
+        return;
+    }
+
+    // Clicking on the focused tile again removes the focus
+    sc_wall_set_focus(wall, tile == wall->focused ? NULL : tile);
+}
+
+// Request a keyframe from each tile which is not focused, to refresh its
+// preview
+static void
+sc_wall_request_previews(struct sc_wall *wall) {
+    for (unsigned i = 0; i < wall->count; ++i) {
+        struct sc_wall_tile *tile = &wall->tiles[i];
+        if (tile == wall->focused || !tile->controller_started
+                || tile->ended) {
+            continue;
+        }
+
+        struct sc_control_msg msg;
+        msg.type = SC_CONTROL_MSG_TYPE_REQUEST_KEYFRAME;
+        if (!sc_controller_push_msg(&tile->controller, &msg)) {
+            LOGW("Device %s: could not request keyframe", tile->serial);
+        }
+    }
+}
+
+static enum scrcpy_exit_code
+sc_wall_event_loop(struct sc_wall *wall) {
+    SDL_Event event;
+    for (;;) {
+        if (wall->preview_interval) {
+            sc_tick now = sc_tick_now();
+            if (now >= wall->next_preview_request) {
+                sc_wall_request_previews(wall);
+                wall->next_preview_request = now + wall->preview_interval;
+            }
+
+            // Rounded up, so that the deadline is reached on wake up
+            int timeout = SC_TICK_TO_MS(wall->next_preview_request - now
+                                        + SC_TICK_FROM_MS(1) - 1);
+            if (!SDL_WaitEventTimeout(&event, timeout)) {
+                // Timeout (or error): request the next previews
+                continue;
+            }
+        } else if (!SDL_WaitEvent(&event)) {
+            break;
+        }
+
+        struct sc_wall_tile *tile = event.user.data1;
+        switch (event.type) {
+            case SDL_QUIT:
+                LOGD("User requested to quit");
+                return SCRCPY_EXIT_SUCCESS;
+            case SC_EVENT_NEW_FRAME:
+                if (!sc_wall_update_frames(wall)) {
+                    return SCRCPY_EXIT_FAILURE;
+                }
+                break;
+            case SC_EVENT_SERVER_CONNECTED:
+                LOGI("Device %s: connected (%s)", tile->serial,
+                     tile->server.info.device_name);
+                if (!sc_wall_tile_start_stream(tile)) {
+                    LOGE("Device %s: could not start the video stream",
+                         tile->serial);
+                    sc_wall_tile_end(wall, tile);
+                }
+                break;
+            case SC_EVENT_SERVER_CONNECTION_FAILED:
+                LOGE("Device %s: server connection failed", tile->serial);
+                sc_wall_tile_end(wall, tile);
+                break;
+            case SC_EVENT_DEVICE_DISCONNECTED:
+                LOGW("Device %s: disconnected", tile->serial);
+                sc_wall_tile_end(wall, tile);
+                break;
+            case SC_EVENT_DEMUXER_ERROR:
+                LOGE("Device %s: demuxer error", tile->serial);
+                sc_wall_tile_end(wall, tile);
+                break;
+            case SC_EVENT_RECORDER_ERROR:
+                LOGE("Device %s: recorder error", tile->serial);
+                sc_wall_tile_end(wall, tile);
+                break;
+            case SDL_WINDOWEVENT:
+                if (event.window.event == SDL_WINDOWEVENT_EXPOSED
+                        || event.window.event
+                            == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                    sc_wall_render(wall);
+                }
+                break;
+            case SDL_MOUSEBUTTONDOWN:
+                if (wall->focus_enabled) {
+                    sc_wall_handle_click(wall, &event.button);
+                }
+                break;
+            default:
+                break;
+        }
+
+        if (wall->ended_count == wall->count) {
+            LOGW("All the devices are disconnected");
+            return SCRCPY_EXIT_DISCONNECTED;
+        }
+    }
+
+    LOGE("SDL_WaitEvent() error: %s", SDL_GetError());
+    return SCRCPY_EXIT_FAILURE;
+}
+
+static bool
+sc_wall_add_serial(struct sc_wall *wall, const char *s, size_t len) {
+    assert(len);
+
+    if (wall->count == SC_WALL_MAX_TILES) {
+        LOGE("Too many devices in --wall (max %d)", SC_WALL_MAX_TILES);
+        return false;
+    }
+
+    char *serial = malloc(len + 1);
+    if (!serial) {
+        LOG_OOM();
+        return false;
+    }
+    memcpy(serial, s, len);
+    serial[len] = '\0';
+
+    struct sc_wall_tile *tile = &wall->tiles[wall->count++];
+    memset(tile, 0, sizeof(*tile));
+    tile->wall = wall;
+    tile->serial = serial;
+
+    return true;
+}
+
+// Read the serials from a file, one per line (empty lines and lines starting
+// with '#' are ignored)
+static bool
+sc_wall_read_serials(struct sc_wall *wall, const char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        LOGE("Could not open %s", filename);
+        return false;
+    }
+
+    bool ok = true;
+    char line[256];
+    while (ok && fgets(line, sizeof(line), file)) {
+        const char *s = line + strspn(line, " \t");
+        size_t len = strcspn(s, " \t\r\n");
+        if (len && s[0] != '#') {
+            ok = sc_wall_add_serial(wall, s, len);
+        }
+    }
+
+    if (ok && ferror(file)) {
+        LOGE("Could not read %s", filename);
+        ok = false;
+    }
+    fclose(file);
+
+    if (ok && !wall->count) {
+        LOGE("No serial in %s", filename);
+        ok = false;
+    }
+
+    return ok;
+}
+
+static bool
+sc_wall_parse_serials(struct sc_wall *wall, const char *list) {
+    wall->count = 0;
+
+    if (list[0] == '@') {
+        return sc_wall_read_serials(wall, &list[1]);
+    }
+
+    const char *s = list;
+    for (;;) {
+        size_t len = strcspn(s, ",");
+        if (!len) {
+            LOGE("Empty serial in --wall: %s", list);
+            return false;
+        }
+
+        if (!sc_wall_add_serial(wall, s, len)) {
+            return false;
+        }
+
+        if (s[len] == '\0') {
+            break;
+        }
+        s += len + 1;
+    }
+
+    return true;
+}
+
+// Insert the serial before the extension of the record filename, for example
+// "file.mkv" gives "file-192.168.1.1_5555.mkv"
+static char *
+sc_wall_get_record_filename(const char *filename, const char *serial) {
+    char *suffix = strdup(serial);
+    if (!suffix) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    // Replace the characters which are invalid in filenames (on Windows)
+    for (char *c = suffix; *c; ++c) {
+        if (strchr(":/\\", *c)) {
+            *c = '_';
+        }
+    }
+
+    char *result = sc_file_get_suffixed_path(filename, suffix);
+    free(suffix);
+    return result;
+}
+
+static bool
+sc_wall_tile_init_recorder(struct sc_wall_tile *tile,
+                           const struct scrcpy_options *options) {
+    char *filename = sc_wall_get_record_filename(options->record_filename,
+                                                 tile->serial);
+    if (!filename) {
+        return false;
+    }
+
+    static const struct sc_recorder_callbacks cbs = {
+        .on_ended = sc_wall_on_recorder_ended,
+    };
+    // There is no control, so no keyframe can be requested: the recorder
+    // does not need on_keyframe_needed
+    bool ok = sc_recorder_init(&tile->recorder, filename,
+                               options->record_format, true, false,
+                               options->record_orientation,
+                               options->record_fragmented,
+                               options->record_low_latency,
+                               options->record_queue_limit,
+                               options->record_write_buffer,
+                               options->record_segment_duration,
+                               options->record_segment_count, NULL, &cbs,
+                               tile);
+    free(filename);
+    if (!ok) {
+        return false;
+    }
+    tile->recorder_initialized = true;
+
+    if (!sc_recorder_start(&tile->recorder)) {
+        return false;
+    }
+    tile->recorder_started = true;
+
+    return true;
+}
+
+// The background frame rate never exceeds the one requested by --max-fps
+static uint16_t
+sc_wall_get_background_fps(const struct scrcpy_options *options) {
+    uint16_t fps = options->wall_background_fps;
+    if (options->max_fps && options->max_fps < fps) {
+        fps = options->max_fps;
+    }
+    return fps;
+}
+
+static bool
+sc_wall_tile_init(struct sc_wall_tile *tile,
+                  const struct scrcpy_options *options, uint32_t scid) {
+    if (!sc_frame_buffer_init(&tile->fb, NULL)) {
+        return false;
+    }
+
+    tile->frame = av_frame_alloc();
+    if (!tile->frame) {
+        LOG_OOM();
+        sc_frame_buffer_destroy(&tile->fb);
+        return false;
+    }
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = sc_wall_tile_frame_sink_open,
+        .close = sc_wall_tile_frame_sink_close,
+        .push = sc_wall_tile_frame_sink_push,
+    };
+    tile->frame_sink.ops = &ops;
+
+    tile->background_limits = options->wall_background_fps != 0;
+    atomic_init(&tile->high_priority, false);
+    tile->high_priority_applied = false;
+
+    // The devices start in the background (no tile is focused initially)
+    uint16_t max_fps = options->wall_background_fps
+                     ? sc_wall_get_background_fps(options)
+                     : options->max_fps;
+
+    // Video only, with control only to request keyframes and video limits
+    struct sc_server_params params = {
+        .scid = scid,
+        .req_serial = tile->serial,
+        .log_level = options->log_level,
+        .video_codec = options->video_codec,
+        .audio_codec = options->audio_codec,
+        .video_source = options->video_source,
+        .audio_source = options->audio_source,
+        .camera_facing = options->camera_facing,
+        .crop = options->crop,
+        .new_display = options->new_display,
+        .port_range = options->port_range,
+        .tunnel_host = options->tunnel_host,
+        .tunnel_port = options->tunnel_port,
+        .socket_buffer_size = options->socket_buffer_size,
+        .shutdown_timeout = options->shutdown_timeout,
+        .devices_cache = options->devices_cache,
+        .max_size = options->max_size,
+        .video_bit_rate = options->video_bit_rate,
+        // Unused (no audio), but passed as is to the server
+        .audio_sample_rate = options->audio_sample_rate,
+        .audio_channels = options->audio_channels,
+        .max_fps = max_fps,
+        .video_repeat_delay = options->video_repeat_delay,
+        .video_latency_profile = options->video_latency_profile,
+        .video_intra_refresh = options->video_intra_refresh,
+        .video_hdr = options->video_hdr,
+        .square_video = options->square_video,
+        .gpu_downscale = options->gpu_downscale,
+        .video_masks = options->video_masks,
+        .adaptive_fps = options->adaptive_fps,
+        .thermal_governor = options->thermal_governor,
+        .lock_video_orientation = options->lock_video_orientation,
+        .control = options->wall_preview_interval
+                || options->wall_background_fps,
+        .display_id = options->display_id,
+        .video = true,
+        .audio = false,
+        .show_touches = options->show_touches,
+        .stay_awake = options->stay_awake,
+        .video_codec_options = options->video_codec_options,
+        .video_encoder = options->video_encoder,
+        .camera_id = options->camera_id,
+        .camera_size = options->camera_size,
+        .camera_ar = options->camera_ar,
+        .camera_fps = options->camera_fps,
+        .pattern_size = options->pattern_size,
+        .pattern_fps = options->pattern_fps,
+        .force_adb_forward = options->force_adb_forward,
+        .persistent_tunnel = options->persistent_tunnel,
+        .power_off_on_close = options->power_off_on_close,
+        .downsize_on_error = options->downsize_on_error,
+        .cleanup = options->cleanup,
+        .power_on = options->power_on,
+        .camera_high_speed = options->camera_high_speed,
+        .camera_low_latency = options->camera_low_latency,
+        .camera_lock_ae_af = options->camera_lock_ae_af,
+    };
+
+    static const struct sc_server_callbacks cbs = {
+        .on_connection_failed = sc_wall_on_connection_failed,
+        .on_connected = sc_wall_on_connected,
+        .on_disconnected = sc_wall_on_disconnected,
+    };
+    if (!sc_server_init(&tile->server, &params, &cbs, tile)) {
+        av_frame_free(&tile->frame);
+        sc_frame_buffer_destroy(&tile->fb);
+        return false;
+    }
+    tile->server_initialized = true;
+
+    if (options->record_filename) {
+        // The recorder is started before the server connects, it is fed once
+        // the video stream is started
+        if (!sc_wall_tile_init_recorder(tile, options)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void
+sc_wall_tile_destroy(struct sc_wall_tile *tile) {
+    if (tile->server_initialized) {
+        if (tile->demuxer_started) {
+            sc_demuxer_join(&tile->demuxer);
+        }
+        if (tile->demuxer_initialized) {
+            sc_demuxer_destroy(&tile->demuxer);
+        }
+        if (tile->decoder_initialized) {
+            sc_decoder_destroy(&tile->decoder);
+        }
+        // The controller is used by the decoder, from the demuxer thread
+        if (tile->controller_started) {
+            sc_controller_join(&tile->controller);
+        }
+        if (tile->controller_initialized) {
+            sc_controller_destroy(&tile->controller);
+        }
+        if (tile->recorder_started) {
+            sc_recorder_join(&tile->recorder);
+        }
+        if (tile->recorder_initialized) {
+            sc_recorder_destroy(&tile->recorder);
+        }
+        if (tile->server_started) {
+            sc_server_join(&tile->server);
+        }
+        sc_server_destroy(&tile->server);
+
+        if (tile->texture) {
+            SDL_DestroyTexture(tile->texture);
+        }
+        av_frame_free(&tile->frame);
+        sc_frame_buffer_destroy(&tile->fb);
+    }
+
+    free(tile->serial);
+}
+
+enum scrcpy_exit_code
+scrcpy_wall(struct scrcpy_options *options) {
+    static struct sc_wall wall;
+    struct sc_wall *w = &wall;
+
+    assert(options->wall);
+
+    if (SDL_Init(SDL_INIT_EVENTS)) {
+        LOGE("Could not initialize SDL: %s", SDL_GetError());
+        return SCRCPY_EXIT_FAILURE;
+    }
+
+    atexit(SDL_Quit);
+
+    enum scrcpy_exit_code ret = SCRCPY_EXIT_FAILURE;
+
+    w->playback = options->video_playback;
+    w->window = NULL;
+    w->renderer = NULL;
+    w->ended_count = 0;
+    w->focus_enabled = options->wall_preview_interval
+                    || options->wall_background_fps;
+    w->preview_interval = options->wall_preview_interval;
+    w->next_preview_request = 0;
+    w->background_fps = options->wall_background_fps
+                      ? sc_wall_get_background_fps(options) : 0;
+    w->max_size = options->max_size;
+    w->max_fps = options->max_fps;
+    w->focused = NULL;
+    atomic_init(&w->new_frame_event_queued, false);
+
+    if (!sc_wall_parse_serials(w, options->wall)) {
+        goto end;
+    }
+
+    unsigned threads = options->video_decoder_threads;
+    if (!threads) {
+        threads = SDL_GetCPUCount();
+    }
+    // At least one thread per device
+    w->decoder_threads = threads > w->count ? threads / w->count : 1;
+    w->decoder_threading = options->video_decoder_threading;
+    LOGD("Wall: %u decoder thread(s) per device", w->decoder_threads);
+
+    if (options->render_driver
+            && !SDL_SetHint(SDL_HINT_RENDER_DRIVER, options->render_driver)) {
+        LOGW("Could not set render driver");
+    }
+
+    // Linear filtering
+    if (!SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1")) {
+        LOGW("Could not enable linear filtering");
+    }
+
+    struct sc_rand rand;
+    sc_rand_init(&rand);
+
+    // Start all the servers in parallel
+    for (unsigned i = 0; i < w->count; ++i) {
+        struct sc_wall_tile *tile = &w->tiles[i];
+        // Only use 31 bits to avoid issues with signed values on the Java-side
+        uint32_t scid = sc_rand_u32(&rand) & 0x7FFFFFFF;
+        if (!sc_wall_tile_init(tile, options, scid)) {
+            goto end;
+        }
+
+        if (!sc_server_start(&tile->server)) {
+            goto end;
+        }
+        tile->server_started = true;
+    }
+
+    if (!w->playback) {
+        // Headless: only record the devices, until interrupted (Ctrl+c) or
+        // until all the devices are disconnected
+        ret = sc_wall_event_loop(w);
+        LOGD("quit...");
+        goto end;
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO)) {
+        LOGE("Could not initialize SDL video: %s", SDL_GetError());
+        goto end;
+    }
+
+    if (options->disable_screensaver) {
+        SDL_DisableScreenSaver();
+    } else {
+        SDL_EnableScreenSaver();
+    }
+
+    int width = options->window_width ? options->window_width
+                                      : SC_WALL_DEFAULT_WIDTH;
+    int height = options->window_height ? options->window_height
+                                        : SC_WALL_DEFAULT_HEIGHT;
+    const char *title = options->window_title ? options->window_title
+                                              : "scrcpy wall";
+    uint32_t window_flags = SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI;
+    if (options->always_on_top) {
+        window_flags |= SDL_WINDOW_ALWAYS_ON_TOP;
+    }
+    if (options->window_borderless) {
+        window_flags |= SDL_WINDOW_BORDERLESS;
+    }
+    if (options->fullscreen) {
+        window_flags |= SDL_WINDOW_FULLSCREEN_DESKTOP;
+    }
+
+    int x = options->window_x != SC_WINDOW_POSITION_UNDEFINED
+          ? options->window_x : (int) SDL_WINDOWPOS_UNDEFINED;
+    int y = options->window_y != SC_WINDOW_POSITION_UNDEFINED
+          ? options->window_y : (int) SDL_WINDOWPOS_UNDEFINED;
+
+    w->window = SDL_CreateWindow(title, x, y, width, height, window_flags);
+    if (!w->window) {
+        LOGE("Could not create window: %s", SDL_GetError());
+        goto end;
+    }
+
+    // A single renderer (and GL context) for all the devices
+    w->renderer = SDL_CreateRenderer(w->window, -1, SDL_RENDERER_ACCELERATED);
+    if (!w->renderer) {
+        LOGE("Could not create renderer: %s", SDL_GetError());
+        goto end;
+    }
+
+    SDL_RenderClear(w->renderer);
+    SDL_RenderPresent(w->renderer);
+
+    ret = sc_wall_event_loop(w);
+    LOGD("quit...");
+
+    SDL_HideWindow(w->window);
+
+end:
+    // Shutdown the sockets and kill the servers first, so that all the
+    // demuxers (and recorders) stop in parallel
+    for (unsigned i = 0; i < w->count; ++i) {
+        struct sc_wall_tile *tile = &w->tiles[i];
+        if (tile->recorder_started) {
+            sc_recorder_stop(&tile->recorder);
+        }
+        if (tile->controller_started) {
+            sc_controller_stop(&tile->controller);
+        }
+        if (tile->server_started) {
+            sc_server_stop(&tile->server);
+        }
+    }
+
+    for (unsigned i = 0; i < w->count; ++i) {
+        sc_wall_tile_destroy(&w->tiles[i]);
+    }
+
+    if (w->renderer) {
+        SDL_DestroyRenderer(w->renderer);
+    }
+    if (w->window) {
+        SDL_DestroyWindow(w->window);
+    }
+
+    return ret;
+}
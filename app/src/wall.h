@@ -0,0 +1,23 @@
+#ifndef SC_WALL_H
+#define SC_WALL_H
+
+#include "common.h"
+
+#include "options.h"
+#include "scrcpy.h"
+
+/**
+ * Mirror several devices (--wall) in a grid, in a single window
+ *
+ * Each device has its own server, video demuxer and decoder, but all the
+ * videos are rendered by the same renderer (and GL context), from a single
+ * event loop. There is no audio, and control is only used to request the
+ * keyframes of the previews (see --wall-preview-interval).
+ *
+ * With --record, each device is also recorded to its own file. Without video
+ * playback, the devices are only recorded (no window, no decoding).
+ */
+enum scrcpy_exit_code
+scrcpy_wall(struct scrcpy_options *options);
+
+#endif
@@ -0,0 +1,78 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "adb/adb_devices_cache.h"
+
+#define CACHE_FILE "test_adb_devices_cache.txt"
+
+static void test_save_load(void) {
+    struct sc_adb_device devices[] = {
+        {
+            .serial = "0123456789abcdef",
+            .state = "device",
+            .model = "MyModel",
+        },
+        {
+            .serial = "192.168.1.1:5555",
+            .state = "offline",
+            .model = NULL,
+        },
+    };
+
+    bool ok = sc_adb_devices_cache_save(CACHE_FILE, devices, 2);
+    assert(ok);
+
+    struct sc_vec_adb_devices vec = SC_VECTOR_INITIALIZER;
+    ok = sc_adb_devices_cache_load(CACHE_FILE, SC_TICK_FROM_SEC(60), &vec);
+    assert(ok);
+    assert(vec.size == 2);
+
+    assert(!strcmp("0123456789abcdef", vec.data[0].serial));
+    assert(!strcmp("device", vec.data[0].state));
+    assert(!strcmp("MyModel", vec.data[0].model));
+
+    assert(!strcmp("192.168.1.1:5555", vec.data[1].serial));
+    assert(!strcmp("offline", vec.data[1].state));
+    assert(!vec.data[1].model);
+
+    sc_adb_devices_destroy(&vec);
+
+    // Expired
+    vec = (struct sc_vec_adb_devices) SC_VECTOR_INITIALIZER;
+    ok = sc_adb_devices_cache_load(CACHE_FILE, 0, &vec);
+    assert(!ok);
+    assert(vec.size == 0);
+
+    remove(CACHE_FILE);
+}
+
+static void test_load_invalid(void) {
+    FILE *file = fopen(CACHE_FILE, "wb");
+    assert(file);
+    fputs("List of devices attached\n0123456789abcdef\tdevice\n", file);
+    fclose(file);
+
+    struct sc_vec_adb_devices vec = SC_VECTOR_INITIALIZER;
+    bool ok = sc_adb_devices_cache_load(CACHE_FILE, SC_TICK_FROM_SEC(60), &vec);
+    assert(!ok);
+    assert(vec.size == 0);
+
+    remove(CACHE_FILE);
+
+    // Missing file
+    ok = sc_adb_devices_cache_load(CACHE_FILE, SC_TICK_FROM_SEC(60), &vec);
+    assert(!ok);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_save_load();
+    test_load_invalid();
+
+    return 0;
+}
@@ -163,6 +163,85 @@ static void test_adb_devices_spaces(void) {
     sc_adb_devices_destroy(&vec);
 }
 
+static void test_adb_devices_streaming(void) {
+    const char *output =
+        "* daemon not running; starting now at tcp:5037\n"
+        "List of devices attached\r\n"
+        "0123456789abcdef	device usb:2-1 product:MyProduct model:MyModel "
+            "device:MyDevice transport_id:1\r\n"
+        "192.168.1.1:5555	device product:MyWifiProduct model:MyWifiModel "
+            "device:MyWifiDevice trandport_id:2";
+    size_t len = strlen(output);
+
+    // Split the output at every possible position
+    for (size_t chunk_size = 1; chunk_size <= len; ++chunk_size) {
+        struct sc_vec_adb_devices vec = SC_VECTOR_INITIALIZER;
+        struct sc_adb_devices_parser parser;
+        sc_adb_devices_parser_init(&parser, &vec);
+
+        for (size_t i = 0; i < len; i += chunk_size) {
+            size_t n = len - i < chunk_size ? len - i : chunk_size;
+            sc_adb_devices_parser_push(&parser, &output[i], n);
+        }
+
+        bool ok = sc_adb_devices_parser_finish(&parser);
+        assert(ok);
+        assert(vec.size == 2);
+
+        struct sc_adb_device *device = &vec.data[0];
+        assert(!strcmp("0123456789abcdef", device->serial));
+        assert(!strcmp("device", device->state));
+        assert(!strcmp("MyModel", device->model));
+
+        device = &vec.data[1];
+        assert(!strcmp("192.168.1.1:5555", device->serial));
+        assert(!strcmp("device", device->state));
+        assert(!strcmp("MyWifiModel", device->model));
+
+        sc_adb_devices_destroy(&vec);
+    }
+}
+
+static void test_adb_devices_streaming_long_line(void) {
+    struct sc_vec_adb_devices vec = SC_VECTOR_INITIALIZER;
+    struct sc_adb_devices_parser parser;
+    sc_adb_devices_parser_init(&parser, &vec);
+
+    const char *header = "List of devices attached\n";
+    sc_adb_devices_parser_push(&parser, header, strlen(header));
+
+    // A line larger than the parser buffer is ignored
+    char garbage[SC_ADB_DEVICES_PARSER_LINE_MAX];
+    memset(garbage, 'x', sizeof(garbage));
+    sc_adb_devices_parser_push(&parser, garbage, sizeof(garbage));
+    sc_adb_devices_parser_push(&parser, garbage, sizeof(garbage));
+
+    const char *lines = "	device\n"
+                        "0123456789abcdef	device model:MyModel\n";
+    sc_adb_devices_parser_push(&parser, lines, strlen(lines));
+
+    bool ok = sc_adb_devices_parser_finish(&parser);
+    assert(ok);
+    assert(vec.size == 1);
+    assert(!strcmp("0123456789abcdef", vec.data[0].serial));
+    assert(!strcmp("MyModel", vec.data[0].model));
+
+    sc_adb_devices_destroy(&vec);
+}
+
+static void test_adb_devices_streaming_without_header(void) {
+    struct sc_vec_adb_devices vec = SC_VECTOR_INITIALIZER;
+    struct sc_adb_devices_parser parser;
+    sc_adb_devices_parser_init(&parser, &vec);
+
+    const char *output = "0123456789abcdef	device model:MyModel\n";
+    sc_adb_devices_parser_push(&parser, output, strlen(output));
+
+    bool ok = sc_adb_devices_parser_finish(&parser);
+    assert(!ok);
+    assert(vec.size == 0);
+}
+
 static void test_get_ip_single_line(void) {
     char ip_route[] = "192.168.1.0/24 dev wlan0  proto kernel  scope link  src "
                       "192.168.12.34\r\r\n";
@@ -253,6 +332,40 @@ static void test_get_ip_truncated(void) {
     assert(!ip);
 }
 
+static void test_has_tunnel(void) {
+    const char *list = "UsbFfs localabstract:scrcpy_12345678 tcp:27183\n"
+                       "UsbFfs localabstract:scrcpy_7ffe6a1f tcp:27183\n";
+
+    assert(sc_adb_parse_has_tunnel(list, "localabstract:scrcpy_7ffe6a1f",
+                                   "tcp:27183"));
+    assert(sc_adb_parse_has_tunnel(list, "localabstract:scrcpy_12345678",
+                                   "tcp:27183"));
+    // The whole fields must match
+    assert(!sc_adb_parse_has_tunnel(list, "localabstract:scrcpy_7ffe6a1f",
+                                    "tcp:2718"));
+    assert(!sc_adb_parse_has_tunnel(list, "localabstract:scrcpy_7ffe6a1",
+                                    "tcp:27183"));
+    assert(!sc_adb_parse_has_tunnel(list, "localabstract:scrcpy_7ffe6a1f",
+                                    "tcp:27184"));
+}
+
+static void test_has_tunnel_cr_without_eol(void) {
+    const char *list = "host-19 localabstract:scrcpy_7ffe6a1f tcp:27183\r\n"
+                       "host-19 localabstract:other tcp:1234";
+
+    assert(sc_adb_parse_has_tunnel(list, "localabstract:scrcpy_7ffe6a1f",
+                                   "tcp:27183"));
+    assert(sc_adb_parse_has_tunnel(list, "localabstract:other", "tcp:1234"));
+    assert(!sc_adb_parse_has_tunnel(list, "localabstract:other", "tcp:123"));
+}
+
+static void test_has_tunnel_empty(void) {
+    assert(!sc_adb_parse_has_tunnel("", "localabstract:scrcpy_7ffe6a1f",
+                                    "tcp:27183"));
+    assert(!sc_adb_parse_has_tunnel("\n", "localabstract:scrcpy_7ffe6a1f",
+                                    "tcp:27183"));
+}
+
 int main(int argc, char *argv[]) {
     (void) argc;
     (void) argv;
@@ -265,6 +378,9 @@ int main(int argc, char *argv[]) {
     test_adb_devices_without_header();
     test_adb_devices_corrupted();
     test_adb_devices_spaces();
+    test_adb_devices_streaming();
+    test_adb_devices_streaming_long_line();
+    test_adb_devices_streaming_without_header();
 
     test_get_ip_single_line();
     test_get_ip_single_line_without_eol();
@@ -276,5 +392,9 @@ int main(int argc, char *argv[]) {
     test_get_ip_no_wlan_without_eol();
     test_get_ip_truncated();
 
+    test_has_tunnel();
+    test_has_tunnel_cr_without_eol();
+    test_has_tunnel_empty();
+
     return 0;
 }
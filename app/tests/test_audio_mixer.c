@@ -0,0 +1,174 @@
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "audio_mixer.h"
+
+struct test_output {
+    struct sc_audio_output audio_output;
+    sc_audio_output_fill_fn *fill;
+    void *userdata;
+    unsigned opened;
+    bool started;
+};
+
+#define DOWNCAST(OUTPUT) \
+    container_of(OUTPUT, struct test_output, audio_output)
+
+static bool
+test_output_open(struct sc_audio_output *output,
+                 const struct sc_audio_output_spec *spec,
+                 sc_audio_output_fill_fn *fill, void *userdata) {
+    (void) spec;
+    struct test_output *to = DOWNCAST(output);
+    to->fill = fill;
+    to->userdata = userdata;
+    ++to->opened;
+    return true;
+}
+
+static void
+test_output_start(struct sc_audio_output *output) {
+    struct test_output *to = DOWNCAST(output);
+    to->started = true;
+}
+
+static void
+test_output_close(struct sc_audio_output *output) {
+    struct test_output *to = DOWNCAST(output);
+    to->started = false;
+}
+
+static void
+test_output_init(struct test_output *to) {
+    static const struct sc_audio_output_ops ops = {
+        .open = test_output_open,
+        .start = test_output_start,
+        .close = test_output_close,
+    };
+
+    to->audio_output.ops = &ops;
+    to->fill = NULL;
+    to->userdata = NULL;
+    to->opened = 0;
+    to->started = false;
+}
+
+struct test_source {
+    float value;
+    size_t pulled; // number of samples pulled
+};
+
+static void
+test_source_fill(void *userdata, uint8_t *stream, size_t len) {
+    struct test_source *source = userdata;
+    float *samples = (float *) stream;
+    size_t count = len / sizeof(float);
+    for (size_t i = 0; i < count; ++i) {
+        samples[i] = source->value;
+    }
+    source->pulled += count;
+}
+
+static void
+pull(struct test_output *to, float *out, size_t count) {
+    to->fill(to->userdata, (uint8_t *) out, count * sizeof(float));
+}
+
+static void test_audio_mixer(void) {
+    struct test_output to;
+    test_output_init(&to);
+
+    struct sc_audio_mixer mixer;
+    bool ok = sc_audio_mixer_init(&mixer, &to.audio_output);
+    assert(ok);
+
+    struct sc_audio_mixer_input a;
+    struct sc_audio_mixer_input b;
+    sc_audio_mixer_input_init(&a, &mixer);
+    sc_audio_mixer_input_init(&b, &mixer);
+
+    struct test_source sa = {.value = 0.25f};
+    struct test_source sb = {.value = 0.5f};
+
+    struct sc_audio_output_spec spec = {
+        .sample_rate = 48000,
+        .nb_channels = 2,
+        .buffer_samples = 4,
+    };
+
+    ok = a.audio_output.ops->open(&a.audio_output, &spec, test_source_fill,
+                                  &sa);
+    assert(ok);
+    ok = b.audio_output.ops->open(&b.audio_output, &spec, test_source_fill,
+                                  &sb);
+    assert(ok);
+    // A single output for all the inputs
+    assert(to.opened == 1);
+
+    // An input with another format is rejected
+    struct sc_audio_mixer_input c;
+    sc_audio_mixer_input_init(&c, &mixer);
+    struct sc_audio_output_spec spec_mono = spec;
+    spec_mono.nb_channels = 1;
+    ok = c.audio_output.ops->open(&c.audio_output, &spec_mono,
+                                  test_source_fill, &sa);
+    assert(!ok);
+
+    a.audio_output.ops->start(&a.audio_output);
+    assert(to.started);
+
+    // Only the started inputs are pulled
+    float out[64];
+    pull(&to, out, 8);
+    assert(out[0] == 0.25f);
+    assert(sb.pulled == 0);
+
+    b.audio_output.ops->start(&b.audio_output);
+
+    // More samples than the scratch buffer (4 * 2 * 4 = 32 samples)
+    pull(&to, out, 64);
+    for (unsigned i = 0; i < 64; ++i) {
+        assert(out[i] == 0.75f);
+    }
+    assert(sb.pulled == 64);
+
+    sc_audio_mixer_input_set_gain(&b, 0.5f);
+    pull(&to, out, 8);
+    assert(out[0] == 0.5f);
+
+    // A muted input is still pulled, but not heard
+    sc_audio_mixer_input_set_muted(&a, true);
+    size_t pulled = sa.pulled;
+    pull(&to, out, 8);
+    assert(out[0] == 0.25f);
+    assert(sa.pulled == pulled + 8);
+    sc_audio_mixer_input_set_muted(&a, false);
+
+    // Only the solo inputs are heard
+    sc_audio_mixer_input_set_solo(&a, true);
+    pull(&to, out, 8);
+    assert(out[0] == 0.25f);
+    sc_audio_mixer_input_set_solo(&a, false);
+
+    b.audio_output.ops->close(&b.audio_output);
+    pull(&to, out, 8);
+    assert(out[0] == 0.25f);
+
+    a.audio_output.ops->close(&a.audio_output);
+    pull(&to, out, 8);
+    assert(out[0] == 0);
+
+    sc_audio_mixer_destroy(&mixer);
+    assert(!to.started);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_audio_mixer();
+
+    return 0;
+}
@@ -116,6 +116,47 @@ static void test_audiobuf_partial_read_write(void) {
     sc_audiobuf_destroy(&buf);
 }
 
+static void test_audiobuf_skip(void) {
+    struct sc_audiobuf buf;
+    uint32_t data[10];
+
+    bool ok = sc_audiobuf_init(&buf, 4, 10);
+    assert(ok);
+
+    uint32_t samples[] = {1, 2, 3, 4, 5, 6};
+    uint32_t w = sc_audiobuf_write(&buf, samples, 6);
+    assert(w == 6);
+
+    // The skipped samples are not readable anymore
+    sc_audiobuf_skip(&buf, 2);
+    assert(sc_audiobuf_can_read(&buf) == 4);
+
+    // They are dropped by the reader on its next read
+    uint32_t r = sc_audiobuf_read(&buf, data, 3);
+    assert(r == 3);
+    uint32_t expected[] = {3, 4, 5};
+    assert(!memcmp(data, expected, 12));
+    assert(sc_audiobuf_can_read(&buf) == 1);
+
+    // Skipping more samples than available drops all of them
+    sc_audiobuf_skip(&buf, 5);
+    assert(sc_audiobuf_can_read(&buf) == 0);
+
+    r = sc_audiobuf_read(&buf, data, 3);
+    assert(r == 0);
+
+    // The obsolete skip request does not apply to new samples
+    w = sc_audiobuf_write(&buf, samples, 2);
+    assert(w == 2);
+    assert(sc_audiobuf_can_read(&buf) == 2);
+
+    r = sc_audiobuf_read(&buf, data, 3);
+    assert(r == 2);
+    assert(!memcmp(data, samples, 8));
+
+    sc_audiobuf_destroy(&buf);
+}
+
 int main(int argc, char *argv[]) {
     (void) argc;
     (void) argv;
@@ -123,6 +164,7 @@ int main(int argc, char *argv[]) {
     test_audiobuf_simple();
     test_audiobuf_boundaries();
     test_audiobuf_partial_read_write();
+    test_audiobuf_skip();
 
     return 0;
 }
@@ -42,6 +42,16 @@ static void test_write64be(void) {
     assert(buf[7] == 0xEF);
 }
 
+static void test_write16le(void) {
+    uint16_t val = 0xABCD;
+    uint8_t buf[2];
+
+    sc_write16le(buf, val);
+
+    assert(buf[0] == 0xCD);
+    assert(buf[1] == 0xAB);
+}
+
 static void test_read16be(void) {
     uint8_t buf[2] = {0xAB, 0xCD};
 
@@ -97,6 +107,23 @@ static void test_float_to_i16fp(void) {
     assert(sc_float_to_i16fp(-1.0f) == -0x8000);
 }
 
+static void test_fp_to_float(void) {
+    assert(sc_u16fp_to_float(0) == 0.0f);
+    assert(sc_u16fp_to_float(0x4000) == 0.25f);
+    assert(sc_u16fp_to_float(0xc000) == 0.75f);
+    assert(sc_u16fp_to_float(0xffff) == 1.0f);
+
+    assert(sc_i16fp_to_float(0) == 0.0f);
+    assert(sc_i16fp_to_float(0x2000) == 0.25f);
+    assert(sc_i16fp_to_float(0x7fff) == 1.0f);
+    assert(sc_i16fp_to_float(-0x4000) == -0.5f);
+    assert(sc_i16fp_to_float(-0x8000) == -1.0f);
+
+    // round-trip
+    assert(sc_u16fp_to_float(sc_float_to_u16fp(0.5f)) == 0.5f);
+    assert(sc_i16fp_to_float(sc_float_to_i16fp(-0.75f)) == -0.75f);
+}
+
 int main(int argc, char *argv[]) {
     (void) argc;
     (void) argv;
@@ -104,11 +131,13 @@ int main(int argc, char *argv[]) {
     test_write16be();
     test_write32be();
     test_write64be();
+    test_write16le();
     test_read16be();
     test_read32be();
     test_read64be();
 
     test_float_to_u16fp();
     test_float_to_i16fp();
+    test_fp_to_float();
     return 0;
 }
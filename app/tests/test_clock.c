@@ -0,0 +1,104 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "clock.h"
+
+// Deterministic pseudo-random jitter in [0, max[
+static sc_tick
+next_jitter(uint32_t *state, sc_tick max) {
+    *state = *state * 1103515245 + 12345;
+    return (*state >> 8) % max;
+}
+
+static sc_tick
+abs_tick(sc_tick value) {
+    return value < 0 ? -value : value;
+}
+
+static void test_constant_offset(void) {
+    struct sc_clock clock;
+    sc_clock_init(&clock);
+
+    for (sc_tick stream = 0; stream < SC_TICK_FROM_SEC(2);
+            stream += SC_TICK_FROM_MS(16)) {
+        sc_clock_update(&clock, stream + 1000000, stream);
+    }
+
+    assert(sc_clock_to_system_time(&clock, 5000000) == 6000000);
+    assert(sc_clock_get_skew_ppm(&clock) == 0);
+}
+
+static void test_jitter(void) {
+    struct sc_clock clock;
+    sc_clock_init(&clock);
+
+    uint32_t state = 42;
+    sc_tick stream;
+    for (stream = 0; stream < SC_TICK_FROM_SEC(30);
+            stream += SC_TICK_FROM_MS(16)) {
+        // The transmission delay is between 2ms and 12ms
+        sc_tick delay = SC_TICK_FROM_MS(2) + next_jitter(&state, 10000);
+        sc_clock_update(&clock, stream + 500000 + delay, stream);
+    }
+
+    // No drift
+    double skew = sc_clock_get_skew_ppm(&clock);
+    assert(skew > -20 && skew < 20);
+
+    // The estimation is relative to the typical delay (about 7ms)
+    sc_tick expected = stream + 500000 + SC_TICK_FROM_MS(7);
+    sc_tick estimated = sc_clock_to_system_time(&clock, stream);
+    assert(abs_tick(estimated - expected) < SC_TICK_FROM_MS(2));
+}
+
+static void test_drift(void) {
+    struct sc_clock clock;
+    sc_clock_init(&clock);
+
+    // The device clock is 100 ppm slower
+    uint32_t state = 1234;
+    sc_tick stream;
+    for (stream = 0; stream < SC_TICK_FROM_SEC(120);
+            stream += SC_TICK_FROM_MS(16)) {
+        sc_tick delay = SC_TICK_FROM_MS(2) + next_jitter(&state, 10000);
+        sc_tick system = stream + stream / 10000 + delay;
+        sc_clock_update(&clock, system, stream);
+    }
+
+    double skew = sc_clock_get_skew_ppm(&clock);
+    assert(skew > 80 && skew < 120);
+
+    // The minimum-delay points are up to 1 minute old, the estimation is only
+    // correct if the skew is applied
+    sc_tick expected = stream + stream / 10000 + SC_TICK_FROM_MS(7);
+    sc_tick estimated = sc_clock_to_system_time(&clock, stream);
+    assert(abs_tick(estimated - expected) < SC_TICK_FROM_MS(2));
+}
+
+static void test_max_skew(void) {
+    struct sc_clock clock;
+    sc_clock_init(&clock);
+
+    // An unrealistic drift (1%) is bounded
+    for (sc_tick stream = 0; stream < SC_TICK_FROM_SEC(20);
+            stream += SC_TICK_FROM_MS(16)) {
+        sc_clock_update(&clock, stream + stream / 100, stream);
+    }
+
+    double skew = sc_clock_get_skew_ppm(&clock);
+    assert(skew > 999 && skew < 1001);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_constant_offset();
+    test_jitter();
+    test_drift();
+    test_max_skew();
+
+    return 0;
+}
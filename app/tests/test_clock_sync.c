@@ -0,0 +1,80 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "clock_sync.h"
+
+static void test_no_exchange(void) {
+    struct sc_clock_sync sync;
+    bool ok = sc_clock_sync_init(&sync);
+    assert(ok);
+
+    sc_tick offset;
+    sc_tick error;
+    assert(!sc_clock_sync_get(&sync, &offset, &error));
+
+    sc_clock_sync_destroy(&sync);
+}
+
+static void test_symmetric(void) {
+    struct sc_clock_sync sync;
+    bool ok = sc_clock_sync_init(&sync);
+    assert(ok);
+
+    // The device clock is 5s ahead, 2ms in each direction
+    sc_clock_sync_push(&sync, 1000000, 6002000, 1004000);
+
+    sc_tick offset;
+    sc_tick error;
+    ok = sc_clock_sync_get(&sync, &offset, &error);
+    assert(ok);
+    assert(offset == 5000000);
+    assert(error == 2000);
+
+    sc_clock_sync_destroy(&sync);
+}
+
+static void test_best_exchange(void) {
+    struct sc_clock_sync sync;
+    bool ok = sc_clock_sync_init(&sync);
+    assert(ok);
+
+    // Asymmetric exchange with a large round-trip time (10ms, then 20ms)
+    sc_clock_sync_push(&sync, 1000000, 6001000, 1020000);
+    // Fast exchange
+    sc_clock_sync_push(&sync, 3000000, 8000500, 3001000);
+    // Slow exchange again
+    sc_clock_sync_push(&sync, 5000000, 10015000, 5030000);
+
+    sc_tick offset;
+    sc_tick error;
+    ok = sc_clock_sync_get(&sync, &offset, &error);
+    assert(ok);
+    // The fastest exchange is kept
+    assert(offset == 5000000);
+    assert(error == 500);
+
+    // Once it is too old, it is replaced
+    for (unsigned i = 0; i < SC_CLOCK_SYNC_SAMPLES; ++i) {
+        sc_tick t = 10000000 + i * 2000000;
+        sc_clock_sync_push(&sync, t, t + 5001000, t + 4000);
+    }
+
+    ok = sc_clock_sync_get(&sync, &offset, &error);
+    assert(ok);
+    assert(offset == 4999000);
+    assert(error == 2000);
+
+    sc_clock_sync_destroy(&sync);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_no_exchange();
+    test_symmetric();
+    test_best_exchange();
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "compression.h"
+
+static void test_round_trip(void) {
+    uint8_t in[4096];
+    for (size_t i = 0; i < sizeof(in); ++i) {
+        in[i] = "clipboard text "[i % 15];
+    }
+
+    uint8_t compressed[4096];
+    size_t len = sc_compress(in, sizeof(in), compressed, sizeof(compressed));
+    assert(len);
+    assert(len < sizeof(in) / 10);
+
+    uint8_t out[4096];
+    bool ok = sc_decompress(compressed, len, out, sizeof(out));
+    assert(ok);
+    assert(!memcmp(in, out, sizeof(in)));
+
+    // The announced size must match
+    ok = sc_decompress(compressed, len, out, sizeof(out) - 1);
+    assert(!ok);
+
+    // Truncated data
+    ok = sc_decompress(compressed, len - 1, out, sizeof(out));
+    assert(!ok);
+    (void) ok;
+}
+
+static void test_not_worth(void) {
+    // Pseudo-random data does not compress
+    uint8_t in[1024];
+    uint32_t x = 42;
+    for (size_t i = 0; i < sizeof(in); ++i) {
+        x = x * 1103515245 + 12345;
+        in[i] = x >> 24;
+    }
+
+    uint8_t compressed[1024];
+    size_t len = sc_compress(in, sizeof(in), compressed,
+                             sizeof(in) - SC_COMPRESSION_HEADER_SIZE - 1);
+    assert(!len);
+    (void) len;
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_round_trip();
+    test_not_worth();
+
+    return 0;
+}
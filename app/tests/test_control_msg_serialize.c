@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "control_msg.h"
+#include "util/binary.h"
 
 static void test_serialize_inject_keycode(void) {
     struct sc_control_msg msg = {
@@ -67,8 +68,8 @@ static void test_serialize_inject_text_long(void) {
     expected[0] = SC_CONTROL_MSG_TYPE_INJECT_TEXT;
     expected[1] = 0x00;
     expected[2] = 0x00;
-    expected[3] = 0x01;
-    expected[4] = 0x2c; // text length (32 bits)
+    expected[3] = 0x10;
+    expected[4] = 0x00; // text length (32 bits)
     memset(&expected[5], 'a', SC_CONTROL_MSG_INJECT_TEXT_MAX_LENGTH);
 
     assert(!memcmp(buf, expected, sizeof(expected)));
@@ -93,12 +94,13 @@ static void test_serialize_inject_touch_event(void) {
             .pressure = 1.0f,
             .action_button = AMOTION_EVENT_BUTTON_PRIMARY,
             .buttons = AMOTION_EVENT_BUTTON_PRIMARY,
+            .timestamp = 0x01020304,
         },
     };
 
     uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
     size_t size = sc_control_msg_serialize(&msg, buf);
-    assert(size == 32);
+    assert(size == 36);
 
     const uint8_t expected[] = {
         SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT,
@@ -109,6 +111,66 @@ static void test_serialize_inject_touch_event(void) {
         0xff, 0xff, // pressure
         0x00, 0x00, 0x00, 0x01, // AMOTION_EVENT_BUTTON_PRIMARY (action button)
         0x00, 0x00, 0x00, 0x01, // AMOTION_EVENT_BUTTON_PRIMARY (buttons)
+        0x01, 0x02, 0x03, 0x04, // timestamp
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_inject_multi_touch_event(void) {
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_INJECT_MULTI_TOUCH_EVENT,
+        .inject_multi_touch_event = {
+            .pointer_count = 2,
+            .timestamp = 0x01020304,
+            .pointers = {
+                {
+                    .pointer_id = POINTER_ID_GENERIC_FINGER,
+                    .position = {
+                        .point = {
+                            .x = 100,
+                            .y = 200,
+                        },
+                        .screen_size = {
+                            .width = 1080,
+                            .height = 1920,
+                        },
+                    },
+                    .pressure = 1.0f,
+                },
+                {
+                    .pointer_id = POINTER_ID_VIRTUAL_FINGER,
+                    .position = {
+                        .point = {
+                            .x = 980,
+                            .y = 1720,
+                        },
+                        .screen_size = {
+                            .width = 1080,
+                            .height = 1920,
+                        },
+                    },
+                    .pressure = 0.0f,
+                },
+            },
+        },
+    };
+
+    uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+    size_t size = sc_control_msg_serialize(&msg, buf);
+    assert(size == 50);
+
+    const uint8_t expected[] = {
+        SC_CONTROL_MSG_TYPE_INJECT_MULTI_TOUCH_EVENT,
+        0x02, // pointer count
+        0x01, 0x02, 0x03, 0x04, // timestamp
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe, // generic finger
+        0x00, 0x00, 0x00, 0x64, 0x00, 0x00, 0x00, 0xc8, // 100 200
+        0x04, 0x38, 0x07, 0x80, // 1080 1920
+        0xff, 0xff, // pressure
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfc, // virtual finger
+        0x00, 0x00, 0x03, 0xd4, 0x00, 0x00, 0x06, 0xb8, // 980 1720
+        0x04, 0x38, 0x07, 0x80, // 1080 1920
+        0x00, 0x00, // pressure
     };
     assert(!memcmp(buf, expected, sizeof(expected)));
 }
@@ -289,6 +351,31 @@ static void test_serialize_set_clipboard_long(void) {
     assert(!memcmp(buf, expected, sizeof(expected)));
 }
 
+static void test_serialize_set_clipboard_chunk(void) {
+    char text[SC_CONTROL_MSG_CLIPBOARD_CHUNK_MAX_LENGTH + 2];
+    // The last character (2 bytes) does not fit in the chunk
+    memset(text, 'a', SC_CONTROL_MSG_CLIPBOARD_CHUNK_MAX_LENGTH - 1);
+    text[SC_CONTROL_MSG_CLIPBOARD_CHUNK_MAX_LENGTH - 1] = (char) 0xc3;
+    text[SC_CONTROL_MSG_CLIPBOARD_CHUNK_MAX_LENGTH] = (char) 0xa9; // 'é'
+    text[SC_CONTROL_MSG_CLIPBOARD_CHUNK_MAX_LENGTH + 1] = '\0';
+
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_SET_CLIPBOARD_CHUNK,
+        .set_clipboard_chunk = {
+            .text = text,
+        },
+    };
+
+    uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+    size_t size = sc_control_msg_serialize(&msg, buf);
+    size_t len = SC_CONTROL_MSG_CLIPBOARD_CHUNK_MAX_LENGTH - 1;
+    assert(size == 5 + len);
+
+    assert(buf[0] == SC_CONTROL_MSG_TYPE_SET_CLIPBOARD_CHUNK);
+    assert(sc_read32be(&buf[1]) == len);
+    assert(!memcmp(&buf[5], text, len));
+}
+
 static void test_serialize_set_screen_power_mode(void) {
     struct sc_control_msg msg = {
         .type = SC_CONTROL_MSG_TYPE_SET_SCREEN_POWER_MODE,
@@ -370,6 +457,35 @@ static void test_serialize_uhid_input(void) {
     assert(!memcmp(buf, expected, sizeof(expected)));
 }
 
+static void test_serialize_uhid_input_batch(void) {
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_UHID_INPUT_BATCH,
+        .uhid_input_batch = {
+            .id = 42,
+            .count = 2,
+            .reports = {
+                {.size = 3, .data = {1, 2, 3}},
+                {.size = 2, .data = {4, 5}},
+            },
+        },
+    };
+
+    uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+    size_t size = sc_control_msg_serialize(&msg, buf);
+    assert(size == 13);
+
+    const uint8_t expected[] = {
+        SC_CONTROL_MSG_TYPE_UHID_INPUT_BATCH,
+        0, 42, // id
+        2, // count
+        0, 3, // size
+        1, 2, 3,
+        0, 2, // size
+        4, 5,
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
 static void test_serialize_open_hard_keyboard(void) {
     struct sc_control_msg msg = {
         .type = SC_CONTROL_MSG_TYPE_OPEN_HARD_KEYBOARD_SETTINGS,
@@ -385,6 +501,400 @@ static void test_serialize_open_hard_keyboard(void) {
     assert(!memcmp(buf, expected, sizeof(expected)));
 }
 
+static void test_serialize_video_feedback(void) {
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_VIDEO_FEEDBACK,
+        .video_feedback = {
+            .queuing_delay = 0x12345,
+            .jitter = 0x678,
+        },
+    };
+
+    uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+    size_t size = sc_control_msg_serialize(&msg, buf);
+    assert(size == 9);
+
+    const uint8_t expected[] = {
+        SC_CONTROL_MSG_TYPE_VIDEO_FEEDBACK,
+        0x00, 0x01, 0x23, 0x45, // queuing delay
+        0x00, 0x00, 0x06, 0x78, // jitter
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_request_keyframe(void) {
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_REQUEST_KEYFRAME,
+    };
+
+    uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+    size_t size = sc_control_msg_serialize(&msg, buf);
+    assert(size == 1);
+
+    const uint8_t expected[] = {
+        SC_CONTROL_MSG_TYPE_REQUEST_KEYFRAME,
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_set_video_limits(void) {
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_SET_VIDEO_LIMITS,
+        .set_video_limits = {
+            .max_size = 1024,
+            .max_fps = 30,
+        },
+    };
+
+    uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+    size_t size = sc_control_msg_serialize(&msg, buf);
+    assert(size == 5);
+
+    const uint8_t expected[] = {
+        SC_CONTROL_MSG_TYPE_SET_VIDEO_LIMITS,
+        0x04, 0x00, // max size
+        0x00, 0x1e, // max fps
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_set_crop(void) {
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_SET_CROP,
+        .set_crop = {
+            .position = {
+                .point = {
+                    .x = 260,
+                    .y = 1026,
+                },
+                .screen_size = {
+                    .width = 1080,
+                    .height = 1920,
+                },
+            },
+            .size = {
+                .width = 540,
+                .height = 960,
+            },
+        },
+    };
+
+    uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+    size_t size = sc_control_msg_serialize(&msg, buf);
+    assert(size == 17);
+
+    const uint8_t expected[] = {
+        SC_CONTROL_MSG_TYPE_SET_CROP,
+        0x00, 0x00, 0x01, 0x04, 0x00, 0x00, 0x04, 0x02, // 260 1026
+        0x04, 0x38, 0x07, 0x80, // 1080 1920
+        0x02, 0x1c, 0x03, 0xc0, // 540 960
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_push_file(void) {
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_PUSH_FILE,
+        .push_file = {
+            .target = "/sdcard/",
+            .name = "a.txt",
+            .size = 0x10203,
+            .local = "/tmp/a.txt",
+        },
+    };
+
+    uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+    size_t size = sc_control_msg_serialize(&msg, buf);
+    assert(size == 30);
+
+    const uint8_t expected[] = {
+        SC_CONTROL_MSG_TYPE_PUSH_FILE,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, // size
+        0x00, 0x00, 0x00, 0x08, // target length
+        '/', 's', 'd', 'c', 'a', 'r', 'd', '/',
+        0x00, 0x00, 0x00, 0x05, // name length
+        'a', '.', 't', 'x', 't',
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_push_file_chunk(void) {
+    const uint8_t data[] = {0x01, 0x02, 0x03};
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_PUSH_FILE_CHUNK,
+        .push_file_chunk = {
+            .data = data,
+            .length = sizeof(data),
+        },
+    };
+
+    uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+    size_t size = sc_control_msg_serialize(&msg, buf);
+    assert(size == 6);
+
+    const uint8_t expected[] = {
+        SC_CONTROL_MSG_TYPE_PUSH_FILE_CHUNK,
+        0x00, 0x03, // length
+        0x01, 0x02, 0x03,
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_uhid_destroy(void) {
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_UHID_DESTROY,
+        .uhid_destroy = {
+            .id = 42,
+        },
+    };
+
+    uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+    size_t size = sc_control_msg_serialize(&msg, buf);
+    assert(size == 3);
+
+    const uint8_t expected[] = {
+        SC_CONTROL_MSG_TYPE_UHID_DESTROY,
+        0, 42, // id
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_clock_ping(void) {
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_CLOCK_PING,
+        .clock_ping = {
+            .client_time = UINT64_C(0x0102030405060708),
+        },
+    };
+
+    uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+    size_t size = sc_control_msg_serialize(&msg, buf);
+    assert(size == 9);
+
+    const uint8_t expected[] = {
+        SC_CONTROL_MSG_TYPE_CLOCK_PING,
+        0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, // client time
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_deserialize_inject_events(void) {
+    struct sc_control_msg msgs[] = {
+        {
+            .type = SC_CONTROL_MSG_TYPE_INJECT_KEYCODE,
+            .inject_keycode = {
+                .action = AKEY_EVENT_ACTION_UP,
+                .keycode = AKEYCODE_ENTER,
+                .repeat = 5,
+                .metastate = AMETA_SHIFT_ON | AMETA_SHIFT_LEFT_ON,
+            },
+        },
+        {
+            .type = SC_CONTROL_MSG_TYPE_INJECT_TEXT,
+            .inject_text = {
+                .text = "hello, world!",
+            },
+        },
+        {
+            .type = SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT,
+            .inject_touch_event = {
+                .action = AMOTION_EVENT_ACTION_MOVE,
+                .pointer_id = POINTER_ID_GENERIC_FINGER,
+                .position = {
+                    .point = {
+                        .x = -10,
+                        .y = 200,
+                    },
+                    .screen_size = {
+                        .width = 1080,
+                        .height = 1920,
+                    },
+                },
+                .pressure = 0.5f,
+                .buttons = AMOTION_EVENT_BUTTON_PRIMARY,
+                .timestamp = 1234,
+            },
+        },
+        {
+            .type = SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT,
+            .inject_scroll_event = {
+                .position = {
+                    .point = {
+                        .x = 260,
+                        .y = 1026,
+                    },
+                    .screen_size = {
+                        .width = 1080,
+                        .height = 1920,
+                    },
+                },
+                .hscroll = 1.0f,
+                .vscroll = -0.5f,
+            },
+        },
+    };
+
+    // Serialize all the messages in a single buffer
+    uint8_t buf[1024];
+    size_t len = 0;
+    for (size_t i = 0; i < ARRAY_LEN(msgs); ++i) {
+        len += sc_control_msg_serialize(&msgs[i], &buf[len]);
+    }
+
+    // An incomplete message is not consumed
+    struct sc_control_msg msg;
+    ssize_t r = sc_control_msg_deserialize(buf, 13, &msg);
+    assert(r == 0);
+
+    size_t head = 0;
+    r = sc_control_msg_deserialize(&buf[head], len - head, &msg);
+    assert(r == 14);
+    assert(msg.type == SC_CONTROL_MSG_TYPE_INJECT_KEYCODE);
+    assert(msg.inject_keycode.action == AKEY_EVENT_ACTION_UP);
+    assert(msg.inject_keycode.keycode == AKEYCODE_ENTER);
+    assert(msg.inject_keycode.repeat == 5);
+    assert(msg.inject_keycode.metastate
+            == (AMETA_SHIFT_ON | AMETA_SHIFT_LEFT_ON));
+    head += r;
+
+    r = sc_control_msg_deserialize(&buf[head], len - head, &msg);
+    assert(r == 18);
+    assert(msg.type == SC_CONTROL_MSG_TYPE_INJECT_TEXT);
+    assert(!strcmp(msg.inject_text.text, "hello, world!"));
+    sc_control_msg_destroy(&msg);
+    head += r;
+
+    r = sc_control_msg_deserialize(&buf[head], len - head, &msg);
+    assert(r == 36);
+    assert(msg.type == SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT);
+    assert(msg.inject_touch_event.action == AMOTION_EVENT_ACTION_MOVE);
+    assert(msg.inject_touch_event.pointer_id == POINTER_ID_GENERIC_FINGER);
+    assert(msg.inject_touch_event.position.point.x == -10);
+    assert(msg.inject_touch_event.position.point.y == 200);
+    assert(msg.inject_touch_event.position.screen_size.width == 1080);
+    assert(msg.inject_touch_event.position.screen_size.height == 1920);
+    assert(msg.inject_touch_event.pressure == 0.5f);
+    assert(msg.inject_touch_event.buttons == AMOTION_EVENT_BUTTON_PRIMARY);
+    assert(msg.inject_touch_event.timestamp == 1234);
+    head += r;
+
+    r = sc_control_msg_deserialize(&buf[head], len - head, &msg);
+    assert(r == 21);
+    assert(msg.type == SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT);
+    assert(msg.inject_scroll_event.position.point.x == 260);
+    assert(msg.inject_scroll_event.position.point.y == 1026);
+    assert(msg.inject_scroll_event.hscroll == 1.0f);
+    assert(msg.inject_scroll_event.vscroll == -0.5f);
+    head += r;
+
+    assert(head == len);
+}
+
+static void test_deserialize_commands(void) {
+    struct sc_control_msg msgs[] = {
+        {
+            .type = SC_CONTROL_MSG_TYPE_INJECT_MULTI_TOUCH_EVENT,
+            .inject_multi_touch_event = {
+                .pointer_count = 2,
+                .timestamp = 42,
+                .pointers = {
+                    {
+                        .pointer_id = 1,
+                        .position = {
+                            .point = {100, 200},
+                            .screen_size = {1080, 1920},
+                        },
+                        .pressure = 1.0f,
+                    },
+                    {
+                        .pointer_id = 2,
+                        .position = {
+                            .point = {300, 400},
+                            .screen_size = {1080, 1920},
+                        },
+                        .pressure = 0.5f,
+                    },
+                },
+            },
+        },
+        {
+            .type = SC_CONTROL_MSG_TYPE_SET_CLIPBOARD,
+            .set_clipboard = {
+                .sequence = 0,
+                .text = "hello",
+                .paste = true,
+            },
+        },
+        {
+            .type = SC_CONTROL_MSG_TYPE_GET_CLIPBOARD,
+            .get_clipboard = {
+                .copy_key = SC_COPY_KEY_CUT,
+            },
+        },
+        {
+            .type = SC_CONTROL_MSG_TYPE_ROTATE_DEVICE,
+        },
+        {
+            .type = SC_CONTROL_MSG_TYPE_REQUEST_KEYFRAME,
+        },
+    };
+
+    uint8_t buf[1024];
+    size_t len = 0;
+    for (size_t i = 0; i < ARRAY_LEN(msgs); ++i) {
+        len += sc_control_msg_serialize(&msgs[i], &buf[len]);
+    }
+
+    struct sc_control_msg msg;
+    // An incomplete multi-touch event is not consumed
+    ssize_t r = sc_control_msg_deserialize(buf, 49, &msg);
+    assert(r == 0);
+
+    size_t head = 0;
+    r = sc_control_msg_deserialize(&buf[head], len - head, &msg);
+    assert(r == 50);
+    assert(msg.type == SC_CONTROL_MSG_TYPE_INJECT_MULTI_TOUCH_EVENT);
+    assert(msg.inject_multi_touch_event.pointer_count == 2);
+    assert(msg.inject_multi_touch_event.timestamp == 42);
+    assert(msg.inject_multi_touch_event.pointers[1].pointer_id == 2);
+    assert(msg.inject_multi_touch_event.pointers[1].position.point.x == 300);
+    assert(msg.inject_multi_touch_event.pointers[1].position.point.y == 400);
+    assert(msg.inject_multi_touch_event.pointers[1].pressure == 0.5f);
+    head += r;
+
+    r = sc_control_msg_deserialize(&buf[head], len - head, &msg);
+    assert(r == 19);
+    assert(msg.type == SC_CONTROL_MSG_TYPE_SET_CLIPBOARD);
+    assert(!msg.set_clipboard.sequence);
+    assert(msg.set_clipboard.paste);
+    assert(!strcmp(msg.set_clipboard.text, "hello"));
+    sc_control_msg_destroy(&msg);
+    head += r;
+
+    r = sc_control_msg_deserialize(&buf[head], len - head, &msg);
+    assert(r == 2);
+    assert(msg.type == SC_CONTROL_MSG_TYPE_GET_CLIPBOARD);
+    assert(msg.get_clipboard.copy_key == SC_COPY_KEY_CUT);
+    head += r;
+
+    r = sc_control_msg_deserialize(&buf[head], len - head, &msg);
+    assert(r == 1);
+    assert(msg.type == SC_CONTROL_MSG_TYPE_ROTATE_DEVICE);
+    head += r;
+
+    r = sc_control_msg_deserialize(&buf[head], len - head, &msg);
+    assert(r == 1);
+    assert(msg.type == SC_CONTROL_MSG_TYPE_REQUEST_KEYFRAME);
+    head += r;
+
+    assert(head == len);
+
+    // The messages generated by scrcpy itself are rejected
+    const uint8_t uhid[] = {SC_CONTROL_MSG_TYPE_UHID_DESTROY, 0, 42};
+    r = sc_control_msg_deserialize(uhid, sizeof(uhid), &msg);
+    assert(r == -1);
+}
+
 int main(int argc, char *argv[]) {
     (void) argc;
     (void) argv;
@@ -393,6 +903,7 @@ int main(int argc, char *argv[]) {
     test_serialize_inject_text();
     test_serialize_inject_text_long();
     test_serialize_inject_touch_event();
+    test_serialize_inject_multi_touch_event();
     test_serialize_inject_scroll_event();
     test_serialize_back_or_screen_on();
     test_serialize_expand_notification_panel();
@@ -401,10 +912,22 @@ int main(int argc, char *argv[]) {
     test_serialize_get_clipboard();
     test_serialize_set_clipboard();
     test_serialize_set_clipboard_long();
+    test_serialize_set_clipboard_chunk();
     test_serialize_set_screen_power_mode();
     test_serialize_rotate_device();
     test_serialize_uhid_create();
     test_serialize_uhid_input();
+    test_serialize_uhid_input_batch();
     test_serialize_open_hard_keyboard();
+    test_serialize_video_feedback();
+    test_serialize_request_keyframe();
+    test_serialize_set_video_limits();
+    test_serialize_set_crop();
+    test_serialize_push_file();
+    test_serialize_push_file_chunk();
+    test_serialize_uhid_destroy();
+    test_serialize_clock_ping();
+    test_deserialize_inject_events();
+    test_deserialize_commands();
     return 0;
 }
@@ -7,6 +7,9 @@
 
 #include "device_msg.h"
 
+// The payloads of the deserialized messages are allocated from this arena
+static struct sc_arena arena;
+
 static void test_deserialize_clipboard(void) {
     const uint8_t input[] = {
         DEVICE_MSG_TYPE_CLIPBOARD,
@@ -15,14 +18,14 @@ static void test_deserialize_clipboard(void) {
     };
 
     struct sc_device_msg msg;
-    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &msg);
+    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &arena, &msg);
     assert(r == 8);
 
     assert(msg.type == DEVICE_MSG_TYPE_CLIPBOARD);
     assert(msg.clipboard.text);
     assert(!strcmp("ABC", msg.clipboard.text));
 
-    sc_device_msg_destroy(&msg);
+    sc_arena_reset(&arena);
 }
 
 static void test_deserialize_clipboard_big(void) {
@@ -36,7 +39,7 @@ static void test_deserialize_clipboard_big(void) {
     memset(input + 5, 'a', DEVICE_MSG_TEXT_MAX_LENGTH);
 
     struct sc_device_msg msg;
-    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &msg);
+    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &arena, &msg);
     assert(r == DEVICE_MSG_MAX_SIZE);
 
     assert(msg.type == DEVICE_MSG_TYPE_CLIPBOARD);
@@ -44,7 +47,25 @@ static void test_deserialize_clipboard_big(void) {
     assert(strlen(msg.clipboard.text) == DEVICE_MSG_TEXT_MAX_LENGTH);
     assert(msg.clipboard.text[0] == 'a');
 
-    sc_device_msg_destroy(&msg);
+    sc_arena_reset(&arena);
+}
+
+static void test_deserialize_clipboard_chunk(void) {
+    const uint8_t input[] = {
+        DEVICE_MSG_TYPE_CLIPBOARD_CHUNK,
+        0x00, 0x00, 0x00, 0x02, // text length
+        0x41, 0xc3, // "A" + the first byte of "é"
+    };
+
+    struct sc_device_msg msg;
+    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &arena, &msg);
+    assert(r == 7);
+
+    assert(msg.type == DEVICE_MSG_TYPE_CLIPBOARD_CHUNK);
+    assert(msg.clipboard_chunk.text);
+    assert(!strcmp("A\xc3", msg.clipboard_chunk.text));
+
+    sc_arena_reset(&arena);
 }
 
 static void test_deserialize_ack_set_clipboard(void) {
@@ -54,7 +75,7 @@ static void test_deserialize_ack_set_clipboard(void) {
     };
 
     struct sc_device_msg msg;
-    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &msg);
+    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &arena, &msg);
     assert(r == 9);
 
     assert(msg.type == DEVICE_MSG_TYPE_ACK_CLIPBOARD);
@@ -70,7 +91,7 @@ static void test_deserialize_uhid_output(void) {
     };
 
     struct sc_device_msg msg;
-    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &msg);
+    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &arena, &msg);
     assert(r == 10);
 
     assert(msg.type == DEVICE_MSG_TYPE_UHID_OUTPUT);
@@ -80,16 +101,136 @@ static void test_deserialize_uhid_output(void) {
     uint8_t expected[] = {1, 2, 3, 4, 5};
     assert(!memcmp(msg.uhid_output.data, expected, sizeof(expected)));
 
-    sc_device_msg_destroy(&msg);
+    sc_arena_reset(&arena);
+}
+
+static void test_deserialize_uhid_output_incomplete(void) {
+    const uint8_t input[] = {
+        DEVICE_MSG_TYPE_UHID_OUTPUT,
+        0, 42, // id
+        0, 5, // size
+        1, 2, 3, // data (truncated)
+    };
+
+    struct sc_device_msg msg;
+    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &arena, &msg);
+    assert(r == 0); // no complete message
+}
+
+static void test_deserialize_video_dropped(void) {
+    const uint8_t input[] = {
+        DEVICE_MSG_TYPE_VIDEO_DROPPED,
+        0x00, 0x01, 0x02, 0x03, // total
+    };
+
+    struct sc_device_msg msg;
+    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &arena, &msg);
+    assert(r == 5);
+
+    assert(msg.type == DEVICE_MSG_TYPE_VIDEO_DROPPED);
+    assert(msg.video_dropped.total == 0x00010203);
+}
+
+static void test_deserialize_injection_latency(void) {
+    const uint8_t input[] = {
+        DEVICE_MSG_TYPE_INJECTION_LATENCY,
+        0x00, 0x00, 0x03, 0xe8, // p50
+        0x00, 0x01, 0x86, 0xa0, // p99
+    };
+
+    struct sc_device_msg msg;
+    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &arena, &msg);
+    assert(r == 9);
+
+    assert(msg.type == DEVICE_MSG_TYPE_INJECTION_LATENCY);
+    assert(msg.injection_latency.p50 == 1000);
+    assert(msg.injection_latency.p99 == 100000);
+}
+
+static void test_deserialize_encoder_stats(void) {
+    const uint8_t input[] = {
+        DEVICE_MSG_TYPE_ENCODER_STATS,
+        0x00, 0x00, 0x1f, 0x40, // encode p50
+        0x00, 0x00, 0x61, 0xa8, // encode p99
+        0x00, 0x00, 0x00, 0xc8, // write block p50
+        0x00, 0x00, 0x9c, 0x40, // write block p99
+    };
+
+    struct sc_device_msg msg;
+    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &arena, &msg);
+    assert(r == 17);
+
+    assert(msg.type == DEVICE_MSG_TYPE_ENCODER_STATS);
+    assert(msg.encoder_stats.encode_p50 == 8000);
+    assert(msg.encoder_stats.encode_p99 == 25000);
+    assert(msg.encoder_stats.write_block_p50 == 200);
+    assert(msg.encoder_stats.write_block_p99 == 40000);
+
+    // incomplete
+    r = sc_device_msg_deserialize(input, sizeof(input) - 1, &arena, &msg);
+    assert(r == 0);
+}
+
+static void test_deserialize_clock_pong(void) {
+    const uint8_t input[] = {
+        DEVICE_MSG_TYPE_CLOCK_PONG,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0xe2, 0x40, // client time
+        0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, // device time
+    };
+
+    struct sc_device_msg msg;
+    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &arena, &msg);
+    assert(r == 17);
+
+    assert(msg.type == DEVICE_MSG_TYPE_CLOCK_PONG);
+    assert(msg.clock_pong.client_time == 123456);
+    assert(msg.clock_pong.device_time == UINT64_C(0x100000000));
+
+    // incomplete
+    r = sc_device_msg_deserialize(input, sizeof(input) - 1, &arena, &msg);
+    assert(r == 0);
+}
+
+static void test_deserialize_thermal_state(void) {
+    const uint8_t input[] = {
+        DEVICE_MSG_TYPE_THERMAL_STATE,
+        0x02, // moderate
+        0xff, // unknown battery level
+        0x02,
+    };
+
+    struct sc_device_msg msg;
+    ssize_t r = sc_device_msg_deserialize(input, sizeof(input), &arena, &msg);
+    assert(r == 4);
+
+    assert(msg.type == DEVICE_MSG_TYPE_THERMAL_STATE);
+    assert(msg.thermal_state.status == 2);
+    assert(msg.thermal_state.battery_level == -1);
+    assert(msg.thermal_state.level == 2);
+
+    // incomplete
+    r = sc_device_msg_deserialize(input, sizeof(input) - 1, &arena, &msg);
+    assert(r == 0);
 }
 
 int main(int argc, char *argv[]) {
     (void) argc;
     (void) argv;
 
+    sc_arena_init(&arena, 64);
+
     test_deserialize_clipboard();
     test_deserialize_clipboard_big();
+    test_deserialize_clipboard_chunk();
     test_deserialize_ack_set_clipboard();
     test_deserialize_uhid_output();
+    test_deserialize_uhid_output_incomplete();
+    test_deserialize_video_dropped();
+    test_deserialize_injection_latency();
+    test_deserialize_encoder_stats();
+    test_deserialize_clock_pong();
+    test_deserialize_thermal_state();
+
+    sc_arena_destroy(&arena);
     return 0;
 }
@@ -0,0 +1,143 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libavutil/frame.h>
+
+#include "frame_share.h"
+
+static AVFrame *
+create_frame(enum AVPixelFormat format, int width, int height, uint8_t value,
+             int64_t pts) {
+    AVFrame *frame = av_frame_alloc();
+    assert(frame);
+    frame->format = format;
+    frame->width = width;
+    frame->height = height;
+    // Padded lines, to check that the planes are packed
+    int ret = av_frame_get_buffer(frame, 64);
+    assert(!ret);
+    (void) ret;
+
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->data[i]; ++i) {
+        int lines = i ? (height + 1) / 2 : height;
+        memset(frame->data[i], value + i, (size_t) frame->linesize[i] * lines);
+    }
+
+    frame->pts = pts;
+    return frame;
+}
+
+static const struct sc_frame_share_slot *
+get_slot(const void *mem, unsigned index, const uint8_t **data) {
+    const struct sc_frame_share_header *header = mem;
+    const uint8_t *ptr = (const uint8_t *) mem + header->slot_offset
+                                               + index * header->slot_size;
+    const struct sc_frame_share_slot *slot = (const void *) ptr;
+    *data = ptr + 128; // align(sizeof(struct sc_frame_share_slot))
+    return slot;
+}
+
+static void test_frame_size(void) {
+    assert(sc_frame_share_get_frame_size(AV_PIX_FMT_YUV420P, 4, 2) == 12);
+    assert(sc_frame_share_get_frame_size(AV_PIX_FMT_NV12, 4, 2) == 12);
+    // Odd dimensions
+    assert(sc_frame_share_get_frame_size(AV_PIX_FMT_YUV420P, 3, 3) == 17);
+    assert(!sc_frame_share_get_frame_size(AV_PIX_FMT_RGB24, 4, 2));
+}
+
+static void test_layout(void) {
+    size_t data_size = sc_frame_share_get_frame_size(AV_PIX_FMT_YUV420P, 6, 4);
+    size_t size = sc_frame_share_get_mem_size(3, data_size);
+    void *mem = calloc(1, size);
+    assert(mem);
+
+    sc_frame_share_layout_init(mem, 3, data_size);
+
+    struct sc_frame_share_header *header = mem;
+    assert(header->magic == SC_FRAME_SHARE_MAGIC);
+    assert(header->version == SC_FRAME_SHARE_VERSION);
+    assert(header->slot_count == 3);
+    assert(header->slot_offset % 64 == 0);
+    assert(header->slot_size % 64 == 0);
+    assert(header->slot_offset + 3 * header->slot_size == size);
+    assert(!atomic_load(&header->sequence));
+    assert(sizeof(struct sc_frame_share_slot) <= 128);
+
+    free(mem);
+}
+
+static void test_write(void) {
+    size_t data_size = sc_frame_share_get_frame_size(AV_PIX_FMT_YUV420P, 6, 4);
+    size_t size = sc_frame_share_get_mem_size(2, data_size);
+    void *mem = calloc(1, size);
+    assert(mem);
+
+    sc_frame_share_layout_init(mem, 2, data_size);
+    struct sc_frame_share_header *header = mem;
+
+    AVFrame *frame = create_frame(AV_PIX_FMT_YUV420P, 6, 4, 10, 1234);
+    sc_frame_share_layout_write(mem, 1, frame);
+    av_frame_free(&frame);
+
+    assert(atomic_load(&header->sequence) == 1);
+
+    const uint8_t *data;
+    const struct sc_frame_share_slot *slot = get_slot(mem, 0, &data);
+    assert(atomic_load(&slot->sequence) == 1);
+    assert(slot->pts == 1234);
+    assert(slot->format == SC_FRAME_SHARE_FORMAT_I420);
+    assert(slot->width == 6);
+    assert(slot->height == 4);
+    assert(slot->plane_count == 3);
+    assert(slot->size == data_size);
+    assert(slot->offsets[0] == 0 && slot->strides[0] == 6);
+    assert(slot->offsets[1] == 24 && slot->strides[1] == 3);
+    assert(slot->offsets[2] == 30 && slot->strides[2] == 3);
+    for (size_t i = 0; i < 24; ++i) {
+        assert(data[i] == 10);
+    }
+    for (size_t i = 24; i < 30; ++i) {
+        assert(data[i] == 11);
+    }
+    for (size_t i = 30; i < 36; ++i) {
+        assert(data[i] == 12);
+    }
+
+    // The next frames are written to the next slots, in a ring
+    frame = create_frame(AV_PIX_FMT_NV12, 6, 4, 20, 5678);
+    sc_frame_share_layout_write(mem, 2, frame);
+    av_frame_free(&frame);
+
+    slot = get_slot(mem, 1, &data);
+    assert(atomic_load(&header->sequence) == 2);
+    assert(atomic_load(&slot->sequence) == 2);
+    assert(slot->format == SC_FRAME_SHARE_FORMAT_NV12);
+    assert(slot->plane_count == 2);
+    assert(slot->offsets[1] == 24 && slot->strides[1] == 6);
+    assert(data[24] == 21 && data[35] == 21);
+
+    frame = create_frame(AV_PIX_FMT_YUV420P, 6, 4, 30, 9012);
+    sc_frame_share_layout_write(mem, 3, frame);
+    av_frame_free(&frame);
+
+    slot = get_slot(mem, 0, &data);
+    assert(atomic_load(&header->sequence) == 3);
+    assert(atomic_load(&slot->sequence) == 3);
+    assert(slot->pts == 9012);
+    assert(data[0] == 30);
+
+    free(mem);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_frame_size();
+    test_layout();
+    test_write();
+
+    return 0;
+}
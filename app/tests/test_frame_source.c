@@ -0,0 +1,212 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "trait/frame_source.h"
+
+#define MAX_RECEIVED 16
+
+struct test_sink {
+    struct sc_frame_sink frame_sink;
+    bool open;
+
+    sc_mutex mutex;
+    sc_cond cond;
+    // If set, push() blocks until released
+    bool blocked;
+
+    int64_t received[MAX_RECEIVED];
+    unsigned count;
+};
+
+#define DOWNCAST(SINK) container_of(SINK, struct test_sink, frame_sink)
+
+static bool
+test_sink_open(struct sc_frame_sink *sink, const AVCodecContext *ctx) {
+    (void) ctx;
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(!ts->open);
+    ts->open = true;
+    return true;
+}
+
+static void
+test_sink_close(struct sc_frame_sink *sink) {
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(ts->open);
+    ts->open = false;
+}
+
+static bool
+test_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(ts->open);
+
+    sc_mutex_lock(&ts->mutex);
+    while (ts->blocked) {
+        sc_cond_wait(&ts->cond, &ts->mutex);
+    }
+    assert(ts->count < MAX_RECEIVED);
+    ts->received[ts->count++] = frame->pts;
+    sc_mutex_unlock(&ts->mutex);
+
+    return true;
+}
+
+static void
+test_sink_init(struct test_sink *ts, bool blocked) {
+    static const struct sc_frame_sink_ops ops = {
+        .open = test_sink_open,
+        .close = test_sink_close,
+        .push = test_sink_push,
+    };
+
+    ts->frame_sink.ops = &ops;
+    ts->open = false;
+    ts->blocked = blocked;
+    ts->count = 0;
+
+    bool ok = sc_mutex_init(&ts->mutex);
+    assert(ok);
+    ok = sc_cond_init(&ts->cond);
+    assert(ok);
+}
+
+static void
+test_sink_release(struct test_sink *ts) {
+    sc_mutex_lock(&ts->mutex);
+    ts->blocked = false;
+    sc_cond_signal(&ts->cond);
+    sc_mutex_unlock(&ts->mutex);
+}
+
+static void
+test_sink_destroy(struct test_sink *ts) {
+    sc_cond_destroy(&ts->cond);
+    sc_mutex_destroy(&ts->mutex);
+}
+
+static void
+push_frame(struct sc_frame_source *source, int64_t pts) {
+    AVFrame *frame = av_frame_alloc();
+    assert(frame);
+    frame->pts = pts;
+
+    bool ok = sc_frame_source_sinks_push(source, frame);
+    assert(ok);
+
+    av_frame_free(&frame);
+}
+
+static void test_frame_source_async(enum sc_frame_dispatch dispatch) {
+    AVCodecContext *ctx = avcodec_alloc_context3(NULL);
+    assert(ctx);
+
+    struct sc_frame_source source;
+    bool ok = sc_frame_source_init(&source);
+    assert(ok);
+
+    struct test_sink sync;
+    struct test_sink async;
+    test_sink_init(&sync, false);
+    // The asynchronous sink blocks, it must not block the source
+    test_sink_init(&async, true);
+
+    ok = sc_frame_source_add_sink(&source, &sync.frame_sink);
+    assert(ok);
+    ok = sc_frame_source_add_async_sink(&source, &async.frame_sink, dispatch);
+    assert(ok);
+
+    ok = sc_frame_source_sinks_open(&source, ctx);
+    assert(ok);
+    assert(sync.open);
+    assert(async.open);
+
+    for (int64_t pts = 0; pts < 4; ++pts) {
+        push_frame(&source, pts);
+    }
+
+    assert(sync.count == 4);
+
+    test_sink_release(&async);
+
+    // The pending frames are flushed on close
+    sc_frame_source_sinks_close(&source);
+    assert(!sync.open);
+    assert(!async.open);
+
+    if (dispatch == SC_FRAME_DISPATCH_FIFO) {
+        assert(async.count == 4);
+        for (unsigned i = 0; i < 4; ++i) {
+            assert(async.received[i] == i);
+        }
+    } else {
+        assert(dispatch == SC_FRAME_DISPATCH_LATEST);
+        // The first frame may have been popped before the sink blocked, the
+        // intermediate frames are dropped
+        assert(async.count == 1 || async.count == 2);
+        assert(async.received[async.count - 1] == 3);
+    }
+
+    sc_frame_source_destroy(&source);
+    test_sink_destroy(&sync);
+    test_sink_destroy(&async);
+    avcodec_free_context(&ctx);
+}
+
+static void test_frame_source_async_latest(void) {
+    test_frame_source_async(SC_FRAME_DISPATCH_LATEST);
+}
+
+static void test_frame_source_async_fifo(void) {
+    test_frame_source_async(SC_FRAME_DISPATCH_FIFO);
+}
+
+static void test_frame_source_add_remove_async(void) {
+    AVCodecContext *ctx = avcodec_alloc_context3(NULL);
+    assert(ctx);
+
+    struct sc_frame_source source;
+    bool ok = sc_frame_source_init(&source);
+    assert(ok);
+
+    struct test_sink a;
+    test_sink_init(&a, false);
+
+    ok = sc_frame_source_sinks_open(&source, ctx);
+    assert(ok);
+
+    // Add an asynchronous sink at runtime
+    ok = sc_frame_source_add_async_sink(&source, &a.frame_sink,
+                                        SC_FRAME_DISPATCH_FIFO);
+    assert(ok);
+    assert(a.open);
+
+    push_frame(&source, 0);
+    push_frame(&source, 1);
+
+    // Pending frames are flushed on removal
+    sc_frame_source_remove_sink(&source, &a.frame_sink);
+    assert(!a.open);
+    assert(a.count == 2);
+
+    push_frame(&source, 2);
+    assert(a.count == 2);
+
+    sc_frame_source_sinks_close(&source);
+
+    sc_frame_source_destroy(&source);
+    test_sink_destroy(&a);
+    avcodec_free_context(&ctx);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_frame_source_async_latest();
+    test_frame_source_async_fifo();
+    test_frame_source_add_remove_async();
+
+    return 0;
+}
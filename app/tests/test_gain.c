@@ -0,0 +1,151 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/gain.h"
+#include "util/tick.h"
+
+static bool
+near(float a, float b) {
+    float diff = a - b;
+    return diff < 1e-5f && diff > -1e-5f;
+}
+
+static void test_gain_apply(void) {
+    float samples[] = {1, -2, 0.5f, 0};
+    sc_gain_apply(samples, 4, 0.5f);
+    assert(near(samples[0], 0.5f));
+    assert(near(samples[1], -1));
+    assert(near(samples[2], 0.25f));
+    assert(near(samples[3], 0));
+}
+
+static void test_gain_fade_in(void) {
+    // 4 stereo frames
+    float samples[8];
+    for (unsigned i = 0; i < 8; ++i) {
+        samples[i] = 1;
+    }
+
+    // Fade-in over 2 frames, with a gain of 2
+    float fade = sc_gain_apply_fade_in(samples, 4, 2, 2, 0, 0.5f);
+    assert(fade == 1);
+    // Both channels of a frame share the same factor
+    assert(near(samples[0], 0));
+    assert(near(samples[1], 0));
+    assert(near(samples[2], 1));
+    assert(near(samples[3], 1));
+    for (unsigned i = 4; i < 8; ++i) {
+        assert(near(samples[i], 2));
+    }
+}
+
+static void test_gain_fade_in_partial(void) {
+    float samples[4] = {1, 1, 1, 1};
+
+    // Mono, fade-in over 10 frames: only 4 frames are processed
+    float fade = sc_gain_apply_fade_in(samples, 4, 1, 1, 0, 0.1f);
+    assert(near(fade, 0.4f));
+    assert(near(samples[0], 0));
+    assert(near(samples[3], 0.3f));
+
+    // Continue the fade-in on the next call
+    float samples2[8] = {1, 1, 1, 1, 1, 1, 1, 1};
+    fade = sc_gain_apply_fade_in(samples2, 8, 1, 1, fade, 0.1f);
+    assert(fade == 1);
+    assert(near(samples2[0], 0.4f));
+    assert(near(samples2[5], 0.9f));
+    assert(near(samples2[7], 1));
+}
+
+static void test_gain_fade_in_complete(void) {
+    float samples[2] = {1, -1};
+
+    // Once complete, only the gain is applied
+    float fade = sc_gain_apply_fade_in(samples, 1, 2, 0.5f, 1, 0.1f);
+    assert(fade == 1);
+    assert(near(samples[0], 0.5f));
+    assert(near(samples[1], -0.5f));
+}
+
+static void test_gain_conceal(void) {
+    // 4 stereo frames of history
+    float history[8] = {1, -1, 2, -2, 3, -3, 4, -4};
+    float samples[6 * 2];
+    memset(samples, 0xff, sizeof(samples));
+
+    // Start the concealment with 3 frames: the history is played backwards
+    uint32_t offset = sc_gain_conceal(samples, 3, 2, history, 4, 0);
+    assert(offset == 3);
+    assert(near(samples[0], 3)); // 4 * 0.75
+    assert(near(samples[1], -3));
+    assert(near(samples[2], 1.5f)); // 3 * 0.5
+    assert(near(samples[4], 0.5f)); // 2 * 0.25
+    assert(near(samples[5], -0.5f));
+
+    // Continue on the next call: the fade-out completes, then silence
+    offset = sc_gain_conceal(samples, 6, 2, history, 4, offset);
+    assert(offset == 4);
+    for (unsigned i = 0; i < 12; ++i) {
+        assert(samples[i] == 0);
+    }
+}
+
+static void test_gain_conceal_no_history(void) {
+    float samples[4] = {1, 1, 1, 1};
+    uint32_t offset = sc_gain_conceal(samples, 4, 1, NULL, 0, 0);
+    assert(!offset);
+    for (unsigned i = 0; i < 4; ++i) {
+        assert(samples[i] == 0);
+    }
+}
+
+static void bench_gain(void) {
+    // 5ms of 48kHz stereo audio, the typical audio output callback size
+    static float input[240 * 2];
+    static float samples[240 * 2];
+    for (unsigned i = 0; i < ARRAY_LEN(input); ++i) {
+        input[i] = 0.5f;
+    }
+
+    // The samples are reset on each iteration (as the callback does with the
+    // samples read from the audio buffer), to avoid denormal values
+    unsigned iterations = 100000;
+    sc_tick start = sc_tick_now();
+    for (unsigned i = 0; i < iterations; ++i) {
+        memcpy(samples, input, sizeof(samples));
+        sc_gain_apply(samples, ARRAY_LEN(samples), 0.5f);
+    }
+    sc_tick gain_time = sc_tick_now() - start;
+
+    start = sc_tick_now();
+    for (unsigned i = 0; i < iterations; ++i) {
+        memcpy(samples, input, sizeof(samples));
+        sc_gain_apply_fade_in(samples, 240, 2, 0.5f, 0, 1.f / 240);
+    }
+    sc_tick fade_time = sc_tick_now() - start;
+
+    printf("gain: %f ns/sample\n",
+           (double) SC_TICK_TO_NS(gain_time) / iterations / ARRAY_LEN(samples));
+    printf("fade-in: %f ns/sample\n",
+           (double) SC_TICK_TO_NS(fade_time) / iterations / ARRAY_LEN(samples));
+}
+
+int main(int argc, char *argv[]) {
+    test_gain_apply();
+    test_gain_fade_in();
+    test_gain_fade_in_partial();
+    test_gain_fade_in_complete();
+    test_gain_conceal();
+    test_gain_conceal_no_history();
+
+    // Micro-benchmark, only on explicit request: test_gain --bench
+    if (argc > 1 && !strcmp(argv[1], "--bench")) {
+        bench_gain();
+    }
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "hid/hid_gamepad.h"
+
+static void test_slots(void) {
+    struct sc_hid_gamepad hid;
+    sc_hid_gamepad_init(&hid);
+
+    unsigned slot;
+    bool ok = sc_hid_gamepad_add(&hid, 42, &slot);
+    assert(ok);
+    assert(slot == 0);
+
+    ok = sc_hid_gamepad_add(&hid, 43, &slot);
+    assert(ok);
+    assert(slot == 1);
+
+    ok = sc_hid_gamepad_remove(&hid, 42, &slot);
+    assert(ok);
+    assert(slot == 0);
+
+    // The released slot is reused
+    ok = sc_hid_gamepad_add(&hid, 44, &slot);
+    assert(ok);
+    assert(slot == 0);
+
+    ok = sc_hid_gamepad_remove(&hid, 42, &slot);
+    assert(!ok);
+
+    for (unsigned i = 2; i < SC_MAX_GAMEPADS; ++i) {
+        ok = sc_hid_gamepad_add(&hid, 100 + i, &slot);
+        assert(ok);
+        assert(slot == i);
+    }
+
+    // All the slots are used
+    ok = sc_hid_gamepad_add(&hid, 45, &slot);
+    assert(!ok);
+}
+
+static void test_button(void) {
+    struct sc_hid_gamepad hid;
+    sc_hid_gamepad_init(&hid);
+
+    unsigned slot;
+    bool ok = sc_hid_gamepad_add(&hid, 42, &slot);
+    assert(ok);
+
+    struct sc_gamepad_button_event event = {
+        .gamepad_id = 42,
+        .action = SC_ACTION_DOWN,
+        .button = SC_GAMEPAD_BUTTON_EAST,
+    };
+
+    struct sc_hid_event hid_event;
+    ok = sc_hid_gamepad_event_from_button(&hid, &event, &slot, &hid_event);
+    assert(ok);
+    assert(slot == 0);
+    assert(hid_event.size == 15);
+    // The sticks are centered
+    assert(hid_event.data[0] == 0x00 && hid_event.data[1] == 0x80);
+    assert(hid_event.data[12] == 0); // hat centered
+    assert(hid_event.data[13] == 0x02); // second button
+    assert(hid_event.data[14] == 0x00);
+
+    event.button = SC_GAMEPAD_BUTTON_DPAD_UP;
+    ok = sc_hid_gamepad_event_from_button(&hid, &event, &slot, &hid_event);
+    assert(ok);
+    assert(hid_event.data[12] == 1); // hat up
+    assert(hid_event.data[13] == 0x02);
+
+    event.button = SC_GAMEPAD_BUTTON_DPAD_RIGHT;
+    ok = sc_hid_gamepad_event_from_button(&hid, &event, &slot, &hid_event);
+    assert(ok);
+    assert(hid_event.data[12] == 2); // hat up-right
+
+    // Pressing an already pressed button does not change the state
+    ok = sc_hid_gamepad_event_from_button(&hid, &event, &slot, &hid_event);
+    assert(!ok);
+
+    event.gamepad_id = 43; // unknown gamepad
+    ok = sc_hid_gamepad_event_from_button(&hid, &event, &slot, &hid_event);
+    assert(!ok);
+}
+
+static void test_axis(void) {
+    struct sc_hid_gamepad hid;
+    sc_hid_gamepad_init(&hid);
+
+    unsigned slot;
+    bool ok = sc_hid_gamepad_add(&hid, 42, &slot);
+    assert(ok);
+
+    struct sc_gamepad_axis_event event = {
+        .gamepad_id = 42,
+        .axis = SC_GAMEPAD_AXIS_LEFTY,
+        .value = -32768,
+    };
+
+    struct sc_hid_event hid_event;
+    ok = sc_hid_gamepad_event_from_axis(&hid, &event, &slot, &hid_event);
+    assert(ok);
+    assert(hid_event.data[2] == 0x00 && hid_event.data[3] == 0x00);
+
+    // Same value
+    ok = sc_hid_gamepad_event_from_axis(&hid, &event, &slot, &hid_event);
+    assert(!ok);
+
+    event.value = 32767;
+    ok = sc_hid_gamepad_event_from_axis(&hid, &event, &slot, &hid_event);
+    assert(ok);
+    assert(hid_event.data[2] == 0xFF && hid_event.data[3] == 0xFF);
+
+    event.axis = SC_GAMEPAD_AXIS_RIGHT_TRIGGER;
+    event.value = 0x1234;
+    ok = sc_hid_gamepad_event_from_axis(&hid, &event, &slot, &hid_event);
+    assert(ok);
+    assert(hid_event.data[10] == 0x34 && hid_event.data[11] == 0x12);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_slots();
+    test_button();
+    test_axis();
+
+    return 0;
+}
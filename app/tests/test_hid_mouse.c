@@ -0,0 +1,151 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "hid/hid_mouse.h"
+
+static void
+push_motion(struct sc_hid_mouse_motion *motion, int32_t xrel, int32_t yrel,
+            uint8_t buttons_state) {
+    struct sc_mouse_motion_event event = {
+        .xrel = xrel,
+        .yrel = yrel,
+        .buttons_state = buttons_state,
+    };
+    bool ok = sc_hid_mouse_motion_add(motion, &event);
+    assert(ok);
+}
+
+static void test_aggregate_motion(void) {
+    struct sc_hid_mouse_motion motion;
+    sc_hid_mouse_motion_init(&motion);
+    assert(sc_hid_mouse_motion_is_empty(&motion));
+
+    push_motion(&motion, 1, -2, 0);
+    push_motion(&motion, 3, -4, 0);
+    push_motion(&motion, 5, 1, 0);
+    assert(!sc_hid_mouse_motion_is_empty(&motion));
+
+    struct sc_hid_event hid_event;
+    sc_hid_mouse_event_from_pending_motion(&hid_event, &motion);
+    assert(hid_event.size == 4);
+    assert(hid_event.data[0] == 0);
+    assert((int8_t) hid_event.data[1] == 9);
+    assert((int8_t) hid_event.data[2] == -5);
+    assert(hid_event.data[3] == 0);
+
+    assert(sc_hid_mouse_motion_is_empty(&motion));
+}
+
+static void test_large_motion_not_clamped(void) {
+    struct sc_hid_mouse_motion motion;
+    sc_hid_mouse_motion_init(&motion);
+
+    push_motion(&motion, 300, -130, SC_MOUSE_BUTTON_LEFT);
+
+    struct sc_hid_event hid_event;
+    sc_hid_mouse_event_from_pending_motion(&hid_event, &motion);
+    assert(hid_event.data[0] == 1); // left button
+    assert((int8_t) hid_event.data[1] == 127);
+    assert((int8_t) hid_event.data[2] == -127);
+    assert(!sc_hid_mouse_motion_is_empty(&motion));
+
+    sc_hid_mouse_event_from_pending_motion(&hid_event, &motion);
+    assert((int8_t) hid_event.data[1] == 127);
+    assert((int8_t) hid_event.data[2] == -3);
+    assert(!sc_hid_mouse_motion_is_empty(&motion));
+
+    sc_hid_mouse_event_from_pending_motion(&hid_event, &motion);
+    assert((int8_t) hid_event.data[1] == 46);
+    assert((int8_t) hid_event.data[2] == 0);
+    assert(sc_hid_mouse_motion_is_empty(&motion));
+}
+
+static void test_buttons_change(void) {
+    struct sc_hid_mouse_motion motion;
+    sc_hid_mouse_motion_init(&motion);
+
+    push_motion(&motion, 1, 1, 0);
+
+    // The pending motion must be reported before a motion with other buttons
+    struct sc_mouse_motion_event event = {
+        .xrel = 2,
+        .yrel = 2,
+        .buttons_state = SC_MOUSE_BUTTON_RIGHT,
+    };
+    bool ok = sc_hid_mouse_motion_add(&motion, &event);
+    assert(!ok);
+
+    struct sc_hid_event hid_event;
+    sc_hid_mouse_event_from_pending_motion(&hid_event, &motion);
+    assert(hid_event.data[0] == 0);
+    assert((int8_t) hid_event.data[1] == 1);
+
+    ok = sc_hid_mouse_motion_add(&motion, &event);
+    assert(ok);
+
+    sc_hid_mouse_event_from_pending_motion(&hid_event, &motion);
+    assert(hid_event.data[0] == 2); // right button
+    assert((int8_t) hid_event.data[1] == 2);
+}
+
+static void test_redundant_reports(void) {
+    struct sc_hid_mouse hid;
+    sc_hid_mouse_init(&hid);
+
+    struct sc_hid_event hid_event;
+
+    // No motion, no button pressed
+    struct sc_mouse_motion_event motion = {
+        .xrel = 0,
+        .yrel = 0,
+        .buttons_state = 0,
+    };
+    sc_hid_mouse_event_from_motion(&hid_event, &motion);
+    assert(!sc_hid_mouse_accept_report(&hid, &hid_event));
+
+    motion.xrel = 1;
+    sc_hid_mouse_event_from_motion(&hid_event, &motion);
+    assert(sc_hid_mouse_accept_report(&hid, &hid_event));
+    // A relative motion is never redundant
+    assert(sc_hid_mouse_accept_report(&hid, &hid_event));
+
+    struct sc_mouse_click_event click = {
+        .action = SC_ACTION_DOWN,
+        .button = SC_MOUSE_BUTTON_LEFT,
+        .buttons_state = SC_MOUSE_BUTTON_LEFT,
+    };
+    sc_hid_mouse_event_from_click(&hid_event, &click);
+    assert(sc_hid_mouse_accept_report(&hid, &hid_event));
+    // Same buttons state
+    assert(!sc_hid_mouse_accept_report(&hid, &hid_event));
+
+    click.action = SC_ACTION_UP;
+    click.buttons_state = 0;
+    sc_hid_mouse_event_from_click(&hid_event, &click);
+    assert(sc_hid_mouse_accept_report(&hid, &hid_event));
+
+    struct sc_mouse_scroll_event scroll = {
+        .vscroll = 0,
+        .hscroll = 1,
+    };
+    // Horizontal scrolling is not reported
+    sc_hid_mouse_event_from_scroll(&hid_event, &scroll);
+    assert(!sc_hid_mouse_accept_report(&hid, &hid_event));
+
+    scroll.vscroll = -1;
+    sc_hid_mouse_event_from_scroll(&hid_event, &scroll);
+    assert(sc_hid_mouse_accept_report(&hid, &hid_event));
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_aggregate_motion();
+    test_large_motion_not_clamped();
+    test_buttons_change();
+    test_redundant_reports();
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "util/intmap.h"
+
+static const struct sc_intmap_entry entries[] = {
+    {-5, 50},
+    {1, 10},
+    {2, 20},
+    {8, 80},
+    {42, 420},
+    {1 << 30, 1},
+};
+
+static void test_intmap_find(void) {
+    const struct sc_intmap_entry *entry;
+
+    entry = SC_INTMAP_FIND_ENTRY(entries, -5);
+    assert(entry);
+    assert(entry->value == 50);
+
+    entry = SC_INTMAP_FIND_ENTRY(entries, 8);
+    assert(entry);
+    assert(entry->value == 80);
+
+    entry = SC_INTMAP_FIND_ENTRY(entries, 1 << 30);
+    assert(entry);
+    assert(entry->value == 1);
+
+    for (size_t i = 0; i < ARRAY_LEN(entries); ++i) {
+        entry = SC_INTMAP_FIND_ENTRY(entries, entries[i].key);
+        assert(entry == &entries[i]);
+    }
+}
+
+static void test_intmap_find_missing(void) {
+    assert(!SC_INTMAP_FIND_ENTRY(entries, -6));
+    assert(!SC_INTMAP_FIND_ENTRY(entries, 0));
+    assert(!SC_INTMAP_FIND_ENTRY(entries, 3));
+    assert(!SC_INTMAP_FIND_ENTRY(entries, 43));
+    assert(!SC_INTMAP_FIND_ENTRY(entries, (1 << 30) + 1));
+
+    assert(!sc_intmap_find_entry(entries, 0, 1));
+}
+
+static void test_intmap_is_sorted(void) {
+    assert(sc_intmap_is_sorted(entries, ARRAY_LEN(entries)));
+    assert(sc_intmap_is_sorted(entries, 0));
+
+    static const struct sc_intmap_entry unsorted[] = {
+        {1, 10},
+        {3, 30},
+        {2, 20},
+    };
+    assert(!sc_intmap_is_sorted(unsorted, ARRAY_LEN(unsorted)));
+
+    static const struct sc_intmap_entry duplicates[] = {
+        {1, 10},
+        {1, 20},
+    };
+    assert(!sc_intmap_is_sorted(duplicates, ARRAY_LEN(duplicates)));
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_intmap_find();
+    test_intmap_find_missing();
+    test_intmap_is_sorted();
+    return 0;
+}
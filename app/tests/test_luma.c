@@ -0,0 +1,83 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "util/luma.h"
+
+static void test_downsample(void) {
+    // 4x2 plane with a padding of 2 bytes, to a 2x1 grid
+    uint8_t src[] = {
+        10, 20, 100, 100, 0xFF, 0xFF,
+        30, 40, 200, 201, 0xFF, 0xFF,
+    };
+    uint8_t grid[2];
+    sc_luma_downsample(src, 6, 4, 2, grid, 2, 1);
+    assert(grid[0] == 25);
+    assert(grid[1] == 150); // 150.25, rounded
+}
+
+static void test_downsample_uneven(void) {
+    // 5x1 plane to a 2x1 grid: the cells are 2 and 3 pixels wide
+    uint8_t src[] = {0, 2, 9, 9, 9};
+    uint8_t grid[2];
+    sc_luma_downsample(src, 5, 5, 1, grid, 2, 1);
+    assert(grid[0] == 1);
+    assert(grid[1] == 9);
+}
+
+static void test_downsample_larger_grid(void) {
+    // 1x1 plane to a 2x2 grid: the pixel is used by all the cells
+    uint8_t src[] = {42};
+    uint8_t grid[4];
+    sc_luma_downsample(src, 1, 1, 1, grid, 2, 2);
+    for (int i = 0; i < 4; ++i) {
+        assert(grid[i] == 42);
+    }
+}
+
+static void test_count_changes(void) {
+    uint8_t a[] = {10, 10, 10, 10, 250};
+    uint8_t b[] = {10, 12, 13, 7, 0};
+    assert(sc_luma_count_changes(a, a, 5, 0) == 0);
+    // Differences: 0, 2, 3, 3, 250
+    assert(sc_luma_count_changes(a, b, 5, 0) == 4);
+    assert(sc_luma_count_changes(a, b, 5, 2) == 3);
+    assert(sc_luma_count_changes(a, b, 5, 3) == 1);
+}
+
+static void test_dhash(void) {
+    // Horizontal gradient, brighter on the left: every cell is brighter than
+    // its right neighbor
+    uint8_t src[18 * 8];
+    for (unsigned y = 0; y < 8; ++y) {
+        for (unsigned x = 0; x < 18; ++x) {
+            src[y * 18 + x] = 255 - x * 10;
+        }
+    }
+    assert(sc_luma_dhash(src, 18, 18, 8) == UINT64_MAX);
+
+    // Flat image
+    memset(src, 128, sizeof(src));
+    assert(sc_luma_dhash(src, 18, 18, 8) == 0);
+
+    // Only the first row is a gradient
+    for (unsigned x = 0; x < 18; ++x) {
+        src[x] = 255 - x * 10;
+    }
+    assert(sc_luma_dhash(src, 18, 18, 8) == 0xFF00000000000000);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_downsample();
+    test_downsample_uneven();
+    test_downsample_larger_grid();
+    test_count_changes();
+    test_dhash();
+
+    return 0;
+}
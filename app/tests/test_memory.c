@@ -0,0 +1,110 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "util/memory.h"
+
+static void test_arena_alloc(void) {
+    struct sc_arena arena;
+    sc_arena_init(&arena, 64);
+
+    char *a = sc_arena_alloc(&arena, 10);
+    assert(a);
+    memset(a, 'a', 10);
+
+    char *b = sc_arena_alloc(&arena, 20);
+    assert(b);
+    memset(b, 'b', 20);
+
+    // allocations are aligned
+    size_t align = alignof(max_align_t);
+    assert(!((uintptr_t) a % align));
+    assert(!((uintptr_t) b % align));
+
+    // the allocations do not overlap
+    assert(b >= a + 10 || b + 20 <= a);
+    for (int i = 0; i < 10; ++i) {
+        assert(a[i] == 'a');
+    }
+
+    sc_arena_destroy(&arena);
+}
+
+static void test_arena_alloc_large(void) {
+    struct sc_arena arena;
+    sc_arena_init(&arena, 64);
+
+    char *a = sc_arena_alloc(&arena, 16);
+    assert(a);
+    memset(a, 'a', 16);
+
+    // larger than the block size
+    char *b = sc_arena_alloc(&arena, 1000);
+    assert(b);
+    memset(b, 'b', 1000);
+
+    char *c = sc_arena_alloc(&arena, 48);
+    assert(c);
+    memset(c, 'c', 48);
+
+    // the previous allocations are still valid
+    for (int i = 0; i < 16; ++i) {
+        assert(a[i] == 'a');
+    }
+    for (int i = 0; i < 1000; ++i) {
+        assert(b[i] == 'b');
+    }
+
+    sc_arena_destroy(&arena);
+}
+
+static void test_arena_reset(void) {
+    struct sc_arena arena;
+    sc_arena_init(&arena, 64);
+
+    char *a = sc_arena_alloc(&arena, 32);
+    assert(a);
+
+    sc_arena_reset(&arena);
+
+    // the memory is reused
+    char *b = sc_arena_alloc(&arena, 32);
+    assert(b == a);
+
+    sc_arena_destroy(&arena);
+}
+
+static void test_arena_reset_merge(void) {
+    struct sc_arena arena;
+    sc_arena_init(&arena, 64);
+
+    assert(sc_arena_alloc(&arena, 48));
+    assert(sc_arena_alloc(&arena, 48));
+    assert(sc_arena_alloc(&arena, 200));
+
+    sc_arena_reset(&arena);
+
+    // the same allocations now fit in a single block
+    char *a = sc_arena_alloc(&arena, 48);
+    char *b = sc_arena_alloc(&arena, 48);
+    char *c = sc_arena_alloc(&arena, 200);
+    assert(a && b && c);
+    assert(b == a + 48);
+    assert(c == b + 48);
+
+    sc_arena_destroy(&arena);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_arena_alloc();
+    test_arena_alloc_large();
+    test_arena_reset();
+    test_arena_reset_merge();
+    return 0;
+}
@@ -0,0 +1,169 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "trait/packet_source.h"
+
+struct test_sink {
+    struct sc_packet_sink packet_sink;
+    bool open;
+    unsigned packets;
+    unsigned config_packets;
+    bool disabled;
+};
+
+#define DOWNCAST(SINK) container_of(SINK, struct test_sink, packet_sink)
+
+static bool
+test_sink_open(struct sc_packet_sink *sink, AVCodecContext *ctx) {
+    (void) ctx;
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(!ts->open);
+    ts->open = true;
+    return true;
+}
+
+static void
+test_sink_close(struct sc_packet_sink *sink) {
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(ts->open);
+    ts->open = false;
+}
+
+static bool
+test_sink_push(struct sc_packet_sink *sink, const AVPacket *packet) {
+    struct test_sink *ts = DOWNCAST(sink);
+    assert(ts->open);
+    if (packet->pts == AV_NOPTS_VALUE) {
+        ++ts->config_packets;
+    } else {
+        ++ts->packets;
+    }
+    return true;
+}
+
+static void
+test_sink_disable(struct sc_packet_sink *sink) {
+    struct test_sink *ts = DOWNCAST(sink);
+    ts->disabled = true;
+}
+
+static void
+test_sink_init(struct test_sink *ts) {
+    static const struct sc_packet_sink_ops ops = {
+        .open = test_sink_open,
+        .close = test_sink_close,
+        .push = test_sink_push,
+        .disable = test_sink_disable,
+    };
+
+    ts->packet_sink.ops = &ops;
+    ts->open = false;
+    ts->packets = 0;
+    ts->config_packets = 0;
+    ts->disabled = false;
+}
+
+static void
+push_packet(struct sc_packet_source *source, int64_t pts) {
+    AVPacket *packet = av_packet_alloc();
+    assert(packet);
+    int r = av_new_packet(packet, 4);
+    assert(!r);
+    packet->pts = pts;
+
+    bool ok = sc_packet_source_sinks_push(source, packet);
+    assert(ok);
+
+    av_packet_free(&packet);
+}
+
+static void test_packet_source_add_remove(void) {
+    AVCodecContext *ctx = avcodec_alloc_context3(NULL);
+    assert(ctx);
+
+    struct sc_packet_source source;
+    bool ok = sc_packet_source_init(&source);
+    assert(ok);
+
+    struct test_sink a;
+    struct test_sink b;
+    struct test_sink c;
+    test_sink_init(&a);
+    test_sink_init(&b);
+    test_sink_init(&c);
+
+    ok = sc_packet_source_add_sink(&source, &a.packet_sink);
+    assert(ok);
+
+    ok = sc_packet_source_sinks_open(&source, ctx);
+    assert(ok);
+    assert(a.open);
+
+    push_packet(&source, AV_NOPTS_VALUE);
+    push_packet(&source, 0);
+    assert(a.config_packets == 1);
+    assert(a.packets == 1);
+
+    // Add a sink at runtime: it is opened and receives the config packet
+    ok = sc_packet_source_add_sink(&source, &b.packet_sink);
+    assert(ok);
+    assert(b.open);
+    assert(b.config_packets == 1);
+    assert(b.packets == 0);
+
+    push_packet(&source, 1);
+    assert(a.packets == 2);
+    assert(b.packets == 1);
+
+    // Remove a sink at runtime: it is closed and receives no more packets
+    sc_packet_source_remove_sink(&source, &a.packet_sink);
+    assert(!a.open);
+
+    push_packet(&source, 2);
+    assert(a.packets == 2);
+    assert(b.packets == 2);
+
+    // Removing a sink not added has no effect
+    sc_packet_source_remove_sink(&source, &c.packet_sink);
+
+    sc_packet_source_sinks_close(&source);
+    assert(!b.open);
+
+    sc_packet_source_destroy(&source);
+    avcodec_free_context(&ctx);
+}
+
+static void test_packet_source_disable(void) {
+    struct sc_packet_source source;
+    bool ok = sc_packet_source_init(&source);
+    assert(ok);
+
+    struct test_sink a;
+    struct test_sink b;
+    test_sink_init(&a);
+    test_sink_init(&b);
+
+    ok = sc_packet_source_add_sink(&source, &a.packet_sink);
+    assert(ok);
+
+    sc_packet_source_sinks_disable(&source);
+    assert(a.disabled);
+
+    // A sink added later is disabled immediately
+    ok = sc_packet_source_add_sink(&source, &b.packet_sink);
+    assert(ok);
+    assert(b.disabled);
+
+    sc_packet_source_destroy(&source);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_packet_source_add_remove();
+    test_packet_source_disable();
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "packet_spill.h"
+
+static AVPacket *
+create_packet(int64_t pts, const char *data) {
+    AVPacket *packet = av_packet_alloc();
+    assert(packet);
+
+    int size = strlen(data);
+    int r = av_new_packet(packet, size);
+    assert(!r);
+    memcpy(packet->data, data, size);
+
+    packet->pts = pts;
+    packet->dts = pts;
+    packet->flags = pts == 0 ? AV_PKT_FLAG_KEY : 0;
+    packet->stream_index = 1;
+    return packet;
+}
+
+static void
+assert_packet(AVPacket *packet, int64_t pts, const char *data) {
+    assert(packet);
+    assert(packet->pts == pts);
+    assert(packet->dts == pts);
+    assert(packet->flags == (pts == 0 ? AV_PKT_FLAG_KEY : 0));
+    assert(packet->stream_index == 1);
+    assert(packet->size == (int) strlen(data));
+    assert(!memcmp(packet->data, data, packet->size));
+}
+
+static void test_packet_spill_push_pop(void) {
+    struct sc_packet_spill spill;
+    sc_packet_spill_init(&spill);
+
+    assert(sc_packet_spill_is_empty(&spill));
+
+    AVPacket *packet = create_packet(0, "abc");
+    bool ok = sc_packet_spill_push(&spill, packet);
+    assert(ok);
+    av_packet_free(&packet);
+
+    packet = create_packet(AV_NOPTS_VALUE, "");
+    ok = sc_packet_spill_push(&spill, packet);
+    assert(ok);
+    av_packet_free(&packet);
+
+    packet = create_packet(42, "defgh");
+    ok = sc_packet_spill_push(&spill, packet);
+    assert(ok);
+    av_packet_free(&packet);
+
+    assert(!sc_packet_spill_is_empty(&spill));
+
+    packet = sc_packet_spill_pop(&spill);
+    assert_packet(packet, 0, "abc");
+    av_packet_free(&packet);
+
+    // push while not empty
+    packet = create_packet(50, "ij");
+    ok = sc_packet_spill_push(&spill, packet);
+    assert(ok);
+    av_packet_free(&packet);
+
+    packet = sc_packet_spill_pop(&spill);
+    assert_packet(packet, AV_NOPTS_VALUE, "");
+    av_packet_free(&packet);
+
+    packet = sc_packet_spill_pop(&spill);
+    assert_packet(packet, 42, "defgh");
+    av_packet_free(&packet);
+
+    packet = sc_packet_spill_pop(&spill);
+    assert_packet(packet, 50, "ij");
+    av_packet_free(&packet);
+
+    assert(sc_packet_spill_is_empty(&spill));
+    // the file is reused from the beginning
+    assert(!spill.write_offset);
+
+    packet = create_packet(60, "klm");
+    ok = sc_packet_spill_push(&spill, packet);
+    assert(ok);
+    av_packet_free(&packet);
+
+    packet = sc_packet_spill_pop(&spill);
+    assert_packet(packet, 60, "klm");
+    av_packet_free(&packet);
+
+    sc_packet_spill_destroy(&spill);
+}
+
+static void test_packet_spill_clear(void) {
+    struct sc_packet_spill spill;
+    sc_packet_spill_init(&spill);
+
+    AVPacket *packet = create_packet(0, "abc");
+    bool ok = sc_packet_spill_push(&spill, packet);
+    assert(ok);
+    av_packet_free(&packet);
+
+    sc_packet_spill_clear(&spill);
+    assert(sc_packet_spill_is_empty(&spill));
+
+    sc_packet_spill_destroy(&spill);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_packet_spill_push_pop();
+    test_packet_spill_clear();
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "packet_telemetry.h"
+
+static void test_bitrate_unknown(void) {
+    struct sc_packet_telemetry telemetry;
+    sc_packet_telemetry_init(&telemetry);
+
+    assert(sc_packet_telemetry_get_bitrate(&telemetry) == 0);
+
+    sc_packet_telemetry_push(&telemetry, 0, 1000, 0);
+    // A single packet does not delimit any duration
+    assert(sc_packet_telemetry_get_bitrate(&telemetry) == 0);
+}
+
+static void test_bitrate(void) {
+    struct sc_packet_telemetry telemetry;
+    sc_packet_telemetry_init(&telemetry);
+
+    // 10000 bytes every 10 ms: 8 Mbps
+    for (int i = 0; i < 500; ++i) {
+        int64_t pts = i * 10000;
+        sc_packet_telemetry_push(&telemetry, pts, 10000, pts);
+    }
+    assert(sc_packet_telemetry_get_bitrate(&telemetry) == 8000000);
+
+    // The bitrate decreases as soon as the packets are smaller
+    for (int i = 500; i < 600; ++i) {
+        int64_t pts = i * 10000;
+        sc_packet_telemetry_push(&telemetry, pts, 5000, pts);
+    }
+    assert(sc_packet_telemetry_get_bitrate(&telemetry) == 4000000);
+}
+
+static void test_bitrate_window_full(void) {
+    struct sc_packet_telemetry telemetry;
+    sc_packet_telemetry_init(&telemetry);
+
+    // 1000 bytes every 1 ms: the window does not cover 1 second
+    for (int i = 0; i < 1000; ++i) {
+        int64_t pts = i * 1000;
+        sc_packet_telemetry_push(&telemetry, pts, 1000, pts);
+    }
+    assert(telemetry.count == SC_PACKET_TELEMETRY_WINDOW);
+    assert(sc_packet_telemetry_get_bitrate(&telemetry) == 8000000);
+}
+
+static void test_jitter(void) {
+    struct sc_packet_telemetry telemetry;
+    sc_packet_telemetry_init(&telemetry);
+
+    // Constant transit time: no jitter
+    for (int i = 0; i < 100; ++i) {
+        int64_t pts = i * 16000;
+        sc_packet_telemetry_push(&telemetry, pts, 100, pts + 5000);
+    }
+    assert(sc_packet_telemetry_get_jitter(&telemetry) == 0);
+
+    // The packets arrive alternately 2 ms early and 2 ms late: the variation
+    // of the transit time between consecutive packets is 4 ms
+    for (int i = 100; i < 1000; ++i) {
+        int64_t pts = i * 16000;
+        int64_t delay = i % 2 ? 7000 : 3000;
+        sc_packet_telemetry_push(&telemetry, pts, 100, pts + delay);
+    }
+    sc_tick jitter = sc_packet_telemetry_get_jitter(&telemetry);
+    assert(jitter >= 3900 && jitter <= 4000);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_bitrate_unknown();
+    test_bitrate();
+    test_bitrate_window_full();
+    test_jitter();
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "util/samples.h"
+
+static void test_samples_empty(void) {
+    struct sc_samples samples;
+    sc_samples_init(&samples);
+
+    unsigned percents[] = {50};
+    sc_tick out[1];
+    bool ok = sc_samples_get_percentiles(&samples, percents, out, 1);
+    assert(!ok);
+}
+
+static void test_samples_percentiles(void) {
+    struct sc_samples samples;
+    sc_samples_init(&samples);
+
+    // push in reverse order, the result must not depend on the order
+    for (int i = 100; i > 0; --i) {
+        sc_samples_push(&samples, i);
+    }
+
+    unsigned percents[] = {0, 1, 50, 95, 99, 100};
+    sc_tick out[ARRAY_LEN(percents)];
+    bool ok = sc_samples_get_percentiles(&samples, percents, out,
+                                         ARRAY_LEN(percents));
+    assert(ok);
+    assert(out[0] == 1);
+    assert(out[1] == 1);
+    assert(out[2] == 50);
+    assert(out[3] == 95);
+    assert(out[4] == 99);
+    assert(out[5] == 100);
+}
+
+static void test_samples_rolling_window(void) {
+    struct sc_samples samples;
+    sc_samples_init(&samples);
+
+    for (int i = 0; i < SC_SAMPLES_CAPACITY; ++i) {
+        sc_samples_push(&samples, 1000);
+    }
+
+    // overwrite the whole window
+    for (int i = 0; i < SC_SAMPLES_CAPACITY; ++i) {
+        sc_samples_push(&samples, 1);
+    }
+
+    assert(samples.count == SC_SAMPLES_CAPACITY);
+
+    unsigned percents[] = {100};
+    sc_tick out[1];
+    bool ok = sc_samples_get_percentiles(&samples, percents, out, 1);
+    assert(ok);
+    assert(out[0] == 1);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_samples_empty();
+    test_samples_percentiles();
+    test_samples_rolling_window();
+
+    return 0;
+}
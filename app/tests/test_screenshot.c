@@ -0,0 +1,187 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "screenshot.h"
+
+static bool
+near(uint8_t a, uint8_t b) {
+    return abs((int) a - (int) b) <= 1;
+}
+
+static void
+convert_pixel(uint8_t y, uint8_t u, uint8_t v, bool bt709, bool full_range,
+              uint8_t rgb[3]) {
+    // 2x2 image, with a single chroma sample
+    uint8_t ys[] = {y, y, y, y};
+    struct sc_screenshot_yuv yuv = {
+        .width = 2,
+        .height = 2,
+        .y = ys,
+        .u = &u,
+        .v = &v,
+        .y_stride = 2,
+        .uv_stride = 1,
+        .nv12 = false,
+        .bt709 = bt709,
+        .full_range = full_range,
+    };
+
+    uint8_t out[12];
+    sc_screenshot_yuv_to_rgb24(&yuv, out, 6);
+    for (int i = 0; i < 4; ++i) {
+        assert(out[3 * i] == out[0]);
+        assert(out[3 * i + 1] == out[1]);
+        assert(out[3 * i + 2] == out[2]);
+    }
+
+    rgb[0] = out[0];
+    rgb[1] = out[1];
+    rgb[2] = out[2];
+}
+
+static void test_limited_range(void) {
+    uint8_t rgb[3];
+
+    convert_pixel(16, 128, 128, false, false, rgb);
+    assert(rgb[0] == 0 && rgb[1] == 0 && rgb[2] == 0);
+
+    convert_pixel(235, 128, 128, false, false, rgb);
+    assert(rgb[0] == 255 && rgb[1] == 255 && rgb[2] == 255);
+
+    // BT.601 red
+    convert_pixel(81, 90, 240, false, false, rgb);
+    assert(near(rgb[0], 255) && near(rgb[1], 0) && near(rgb[2], 0));
+
+    // BT.709 green
+    convert_pixel(173, 42, 26, true, false, rgb);
+    assert(near(rgb[0], 0) && near(rgb[1], 255) && near(rgb[2], 0));
+}
+
+static void test_full_range(void) {
+    uint8_t rgb[3];
+
+    convert_pixel(0, 128, 128, false, true, rgb);
+    assert(rgb[0] == 0 && rgb[1] == 0 && rgb[2] == 0);
+
+    convert_pixel(255, 128, 128, true, true, rgb);
+    assert(rgb[0] == 255 && rgb[1] == 255 && rgb[2] == 255);
+
+    // BT.601 blue, clamped
+    convert_pixel(29, 255, 107, false, true, rgb);
+    assert(near(rgb[0], 0) && near(rgb[1], 0) && near(rgb[2], 255));
+}
+
+static void test_nv12(void) {
+    // 4x2 image: two chroma samples, interleaved
+    uint8_t ys[] = {
+        81, 81, 235, 235,
+        81, 81, 235, 235,
+    };
+    uint8_t uv[] = {90, 240, 128, 128};
+
+    struct sc_screenshot_yuv yuv = {
+        .width = 4,
+        .height = 2,
+        .y = ys,
+        .u = uv,
+        .y_stride = 4,
+        .uv_stride = 4,
+        .nv12 = true,
+        .bt709 = false,
+        .full_range = false,
+    };
+
+    uint8_t out[24];
+    sc_screenshot_yuv_to_rgb24(&yuv, out, 12);
+
+    for (int row = 0; row < 2; ++row) {
+        uint8_t *p = &out[row * 12];
+        // red
+        assert(near(p[0], 255) && near(p[1], 0) && near(p[2], 0));
+        assert(near(p[3], 255) && near(p[4], 0) && near(p[5], 0));
+        // white
+        assert(p[6] == 255 && p[7] == 255 && p[8] == 255);
+        assert(p[9] == 255 && p[10] == 255 && p[11] == 255);
+    }
+}
+
+static void test_scaled(void) {
+    // 8x4 image: a red left half and a white right half, downscaled to 2x1
+    uint8_t ys[32];
+    for (int i = 0; i < 32; ++i) {
+        ys[i] = i % 8 < 4 ? 81 : 235;
+    }
+    uint8_t us[] = {90, 90, 128, 128, 90, 90, 128, 128};
+    uint8_t vs[] = {240, 240, 128, 128, 240, 240, 128, 128};
+
+    struct sc_screenshot_yuv yuv = {
+        .width = 8,
+        .height = 4,
+        .y = ys,
+        .u = us,
+        .v = vs,
+        .y_stride = 8,
+        .uv_stride = 4,
+        .nv12 = false,
+        .bt709 = false,
+        .full_range = false,
+    };
+
+    uint8_t out[6];
+    sc_screenshot_yuv_to_rgb24_scaled(&yuv, 2, 1, out, 6);
+    // red
+    assert(near(out[0], 255) && near(out[1], 0) && near(out[2], 0));
+    // white
+    assert(out[3] == 255 && out[4] == 255 && out[5] == 255);
+
+    // Averaged over the whole image
+    uint8_t avg[3];
+    sc_screenshot_yuv_to_rgb24_scaled(&yuv, 1, 1, avg, 3);
+    assert(avg[0] > 200 && avg[1] > 100 && avg[1] < 160);
+}
+
+static void test_scaled_same_size(void) {
+    // Without downscaling, the result is the same as the plain conversion
+    uint8_t ys[] = {
+        81, 81, 235, 235,
+        81, 81, 235, 235,
+    };
+    uint8_t uv[] = {90, 240, 128, 128};
+
+    struct sc_screenshot_yuv yuv = {
+        .width = 4,
+        .height = 2,
+        .y = ys,
+        .u = uv,
+        .y_stride = 4,
+        .uv_stride = 4,
+        .nv12 = true,
+        .bt709 = false,
+        .full_range = false,
+    };
+
+    uint8_t expected[24];
+    sc_screenshot_yuv_to_rgb24(&yuv, expected, 12);
+
+    uint8_t out[24];
+    sc_screenshot_yuv_to_rgb24_scaled(&yuv, 4, 2, out, 12);
+
+    for (int i = 0; i < 24; ++i) {
+        assert(out[i] == expected[i]);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_limited_range();
+    test_full_range();
+    test_nv12();
+    test_scaled();
+    test_scaled_same_size();
+
+    return 0;
+}
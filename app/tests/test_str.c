@@ -170,6 +170,10 @@ static void test_utf8_truncate(void) {
 
     count = sc_str_utf8_truncation_index(s, 8);
     assert(count == 7); // no more chars
+
+    // only continuation bytes
+    count = sc_str_utf8_truncation_index("\x80\x80\x80\x80", 2);
+    assert(count == 0);
 }
 
 static void test_parse_integer(void) {
@@ -376,6 +380,16 @@ static void test_remove_trailing_cr(void) {
     assert(!strcmp(s3, "adb\rdef"));
 }
 
+static void test_hash(void) {
+    // FNV-1a reference values
+    assert(sc_str_hash("") == UINT64_C(0xcbf29ce484222325));
+    assert(sc_str_hash("a") == UINT64_C(0xaf63dc4c8601ec8c));
+    assert(sc_str_hash("foobar") == UINT64_C(0x85944171f73967e8));
+
+    assert(sc_str_hash("abc") == sc_str_hash("abc"));
+    assert(sc_str_hash("abc") != sc_str_hash("abd"));
+}
+
 int main(int argc, char *argv[]) {
     (void) argc;
     (void) argv;
@@ -397,5 +411,6 @@ int main(int argc, char *argv[]) {
     test_wrap_lines();
     test_index_of_column();
     test_remove_trailing_cr();
+    test_hash();
     return 0;
 }
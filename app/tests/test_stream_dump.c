@@ -0,0 +1,83 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "stream_dump.h"
+
+#define DIR "."
+#define NAME "test-stream-dump"
+
+static void test_stream_dump_replay(void) {
+    struct sc_stream_dumper dumper;
+    bool ok = sc_stream_dumper_init(&dumper, DIR, NAME);
+    assert(ok);
+
+    // Like a video stream: codec id, video size, packet header and payload
+    sc_stream_dumper_write(&dumper, "h264", 4);
+    sc_stream_dumper_write(&dumper, "12345678", 8);
+    sc_stream_dumper_write(&dumper, "abcdefghijkl", 12);
+    sc_stream_dumper_write(&dumper, "xyz", 3);
+    assert(!dumper.failed);
+    sc_stream_dumper_destroy(&dumper);
+
+    struct sc_stream_replayer replayer;
+    ok = sc_stream_replayer_init(&replayer, DIR, NAME, true);
+    assert(ok);
+
+    char buf[16];
+    ssize_t r = sc_stream_replayer_read_all(&replayer, buf, 4);
+    assert(r == 4);
+    assert(!memcmp(buf, "h264", 4));
+
+    // The reads do not need to match the dumped entries
+    r = sc_stream_replayer_read_all(&replayer, buf, 10);
+    assert(r == 10);
+    assert(!memcmp(buf, "12345678ab", 10));
+
+    r = sc_stream_replayer_read_all(&replayer, buf, 10);
+    assert(r == 10);
+    assert(!memcmp(buf, "cdefghijkl", 10));
+
+    // End of stream
+    r = sc_stream_replayer_read_all(&replayer, buf, 5);
+    assert(r == 3);
+    assert(!memcmp(buf, "xyz", 3));
+
+    r = sc_stream_replayer_read_all(&replayer, buf, 1);
+    assert(r == 0);
+
+    sc_stream_replayer_destroy(&replayer);
+}
+
+static void test_stream_replay_stopped(void) {
+    struct sc_stream_dumper dumper;
+    bool ok = sc_stream_dumper_init(&dumper, DIR, NAME);
+    assert(ok);
+    sc_stream_dumper_write(&dumper, "abc", 3);
+    sc_stream_dumper_destroy(&dumper);
+
+    struct sc_stream_replayer replayer;
+    ok = sc_stream_replayer_init(&replayer, DIR, NAME, false);
+    assert(ok);
+
+    sc_stream_replayer_stop(&replayer);
+
+    char buf[3];
+    ssize_t r = sc_stream_replayer_read_all(&replayer, buf, 3);
+    assert(r == -1);
+
+    sc_stream_replayer_destroy(&replayer);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_stream_dump_replay();
+    test_stream_replay_stopped();
+
+    remove(DIR "/" NAME ".stream");
+    return 0;
+}
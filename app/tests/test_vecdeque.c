@@ -1,7 +1,10 @@
 #include "common.h"
 
 #include <assert.h>
+#include <stdio.h>
+#include <string.h>
 
+#include "util/tick.h"
 #include "util/vecdeque.h"
 
 #define pr(pv) \
@@ -184,14 +187,167 @@ static void test_vecdeque_push_hole(void) {
     sc_vecdeque_destroy(&vdq);
 }
 
-int main(int argc, char *argv[]) {
-    (void) argc;
-    (void) argv;
+static void test_vecdeque_peek(void) {
+    struct SC_VECDEQUE(int) vdq = SC_VECDEQUE_INITIALIZER;
+
+    bool ok = sc_vecdeque_push(&vdq, 3);
+    assert(ok);
+    ok = sc_vecdeque_push(&vdq, 4);
+    assert(ok);
+
+    int *p = sc_vecdeque_peek(&vdq);
+    assert(*p == 3);
+    assert(sc_vecdeque_size(&vdq) == 2);
+
+    int v = sc_vecdeque_pop(&vdq);
+    assert(v == 3);
+
+    p = sc_vecdeque_peek(&vdq);
+    assert(*p == 4);
+    assert(sc_vecdeque_size(&vdq) == 1);
+
+    sc_vecdeque_destroy(&vdq);
+}
+
+static void test_vecdeque_get(void) {
+    struct SC_VECDEQUE(int) vdq = SC_VECDEQUE_INITIALIZER;
+
+    bool ok = sc_vecdeque_reserve(&vdq, 3);
+    assert(ok);
+
+    // fill the VecDeque, then wrap around the end of the ring buffer
+    for (size_t i = 0; i < vdq.cap; ++i) {
+        sc_vecdeque_push_noresize(&vdq, (int) i);
+    }
+    (void) sc_vecdeque_pop(&vdq);
+    sc_vecdeque_push_noresize(&vdq, -1);
+
+    size_t size = sc_vecdeque_size(&vdq);
+    for (size_t i = 0; i < size - 1; ++i) {
+        assert(*sc_vecdeque_get(&vdq, i) == (int) i + 1);
+    }
+    assert(*sc_vecdeque_get(&vdq, size - 1) == -1);
+
+    *sc_vecdeque_get(&vdq, 0) = 42;
+    int v = sc_vecdeque_pop(&vdq);
+    assert(v == 42);
+
+    sc_vecdeque_destroy(&vdq);
+}
+
+static void test_vecdeque_inline(void) {
+    struct SC_VECDEQUE_INLINE(int, 4) vdq;
+    sc_vecdeque_init_inline(&vdq);
+
+    assert(vdq.cap == 4);
+    assert(vdq.data == vdq.inline_storage_);
+    assert(sc_vecdeque_is_empty(&vdq));
+
+    // wrap around the end of the inline storage
+    for (int i = 0; i < 4; ++i) {
+        sc_vecdeque_push_noresize(&vdq, i);
+    }
+    assert(sc_vecdeque_is_full(&vdq));
+    assert(sc_vecdeque_pop(&vdq) == 0);
+    assert(sc_vecdeque_pop(&vdq) == 1);
+    sc_vecdeque_push_noresize(&vdq, 4);
+    sc_vecdeque_push_noresize(&vdq, 5);
+    assert(vdq.data == vdq.inline_storage_);
+
+    // exceed the inline capacity
+    bool ok = sc_vecdeque_push(&vdq, 6);
+    assert(ok);
+    assert(vdq.data != vdq.inline_storage_);
+    assert(vdq.cap > 4);
+    assert(sc_vecdeque_size(&vdq) == 5);
+
+    for (int i = 2; i <= 6; ++i) {
+        int v = sc_vecdeque_pop(&vdq);
+        assert(v == i);
+    }
+    assert(sc_vecdeque_is_empty(&vdq));
+
+    // back to the inline storage
+    sc_vecdeque_clear(&vdq);
+    assert(vdq.cap == 4);
+    assert(vdq.data == vdq.inline_storage_);
+
+    sc_vecdeque_destroy(&vdq);
+}
+
+static void test_vecdeque_inline_reserve_empty(void) {
+    struct SC_VECDEQUE_INLINE(int, 4) vdq;
+    sc_vecdeque_init_inline(&vdq);
+
+    bool ok = sc_vecdeque_reserve(&vdq, 20);
+    assert(ok);
+    assert(vdq.cap == 20);
+    assert(vdq.data != vdq.inline_storage_);
 
+    ok = sc_vecdeque_push(&vdq, 42);
+    assert(ok);
+    assert(sc_vecdeque_pop(&vdq) == 42);
+
+    sc_vecdeque_destroy(&vdq);
+}
+
+#define BENCH_QUEUE_SIZE 64
+
+static void bench_vecdeque(void) {
+    // Simulate the controller queue: a burst of pushes, then pop them all
+    unsigned iterations = 1000000;
+
+    sc_tick start = sc_tick_now();
+    for (unsigned i = 0; i < iterations; ++i) {
+        struct SC_VECDEQUE(int) vdq;
+        sc_vecdeque_init(&vdq);
+        bool ok = sc_vecdeque_reserve(&vdq, BENCH_QUEUE_SIZE);
+        assert(ok);
+        (void) ok;
+        for (int j = 0; j < 16; ++j) {
+            sc_vecdeque_push_noresize(&vdq, j);
+        }
+        while (!sc_vecdeque_is_empty(&vdq)) {
+            (void) sc_vecdeque_pop(&vdq);
+        }
+        sc_vecdeque_destroy(&vdq);
+    }
+    sc_tick heap_time = sc_tick_now() - start;
+
+    start = sc_tick_now();
+    for (unsigned i = 0; i < iterations; ++i) {
+        struct SC_VECDEQUE_INLINE(int, BENCH_QUEUE_SIZE) vdq;
+        sc_vecdeque_init_inline(&vdq);
+        for (int j = 0; j < 16; ++j) {
+            sc_vecdeque_push_noresize(&vdq, j);
+        }
+        while (!sc_vecdeque_is_empty(&vdq)) {
+            (void) sc_vecdeque_pop(&vdq);
+        }
+        sc_vecdeque_destroy(&vdq);
+    }
+    sc_tick inline_time = sc_tick_now() - start;
+
+    printf("heap: %f ns/iteration\n",
+           (double) SC_TICK_TO_NS(heap_time) / iterations);
+    printf("inline: %f ns/iteration\n",
+           (double) SC_TICK_TO_NS(inline_time) / iterations);
+}
+
+int main(int argc, char *argv[]) {
     test_vecdeque_push_pop();
     test_vecdeque_reserve();
     test_vecdeque_grow();
     test_vecdeque_push_hole();
+    test_vecdeque_peek();
+    test_vecdeque_get();
+    test_vecdeque_inline();
+    test_vecdeque_inline_reserve_empty();
+
+    // Micro-benchmark, only on explicit request: test_vecdeque --bench
+    if (argc > 1 && !strcmp(argv[1], "--bench")) {
+        bench_vecdeque();
+    }
 
     return 0;
 }
@@ -0,0 +1,116 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "video_ladder.h"
+
+#define MS(x) SC_TICK_FROM_MS(x)
+#define SEC(x) SC_TICK_FROM_SEC(x)
+
+static void test_rungs(void) {
+    struct sc_video_ladder ladder;
+    sc_video_ladder_init(&ladder, 0, 1440, 0, 0);
+
+    // 1920 and 1600 are skipped
+    assert(ladder.count == 5);
+    assert(ladder.index == 0);
+    assert(ladder.rungs[0].max_size == 0);
+    assert(ladder.rungs[0].max_fps == 0);
+    assert(ladder.rungs[1].max_size == 1280);
+    assert(ladder.rungs[1].max_fps == 0);
+    assert(ladder.rungs[2].max_size == 1024);
+    assert(ladder.rungs[2].max_fps == 30);
+    assert(ladder.rungs[4].max_size == 640);
+    assert(ladder.rungs[4].max_fps == 24);
+
+    // The initial frame rate limit is never exceeded
+    sc_video_ladder_init(&ladder, 0, 1024, 1024, 25);
+    assert(ladder.count == 3);
+    assert(ladder.rungs[0].max_size == 1024);
+    assert(ladder.rungs[0].max_fps == 25);
+    assert(ladder.rungs[1].max_size == 800);
+    assert(ladder.rungs[1].max_fps == 25);
+    assert(ladder.rungs[2].max_size == 640);
+    assert(ladder.rungs[2].max_fps == 24);
+}
+
+static void test_step_down(void) {
+    struct sc_video_ladder ladder;
+    sc_video_ladder_init(&ladder, 0, 1080, 0, 0);
+    assert(ladder.count == 4);
+
+    // Ignored just after the start
+    assert(!sc_video_ladder_update(&ladder, MS(500), MS(500)));
+    assert(!sc_video_ladder_update(&ladder, MS(1000), MS(500)));
+
+    // A single congested measurement is not sufficient
+    assert(!sc_video_ladder_update(&ladder, MS(3000), MS(500)));
+    assert(!sc_video_ladder_update(&ladder, MS(3500), MS(10)));
+    assert(!sc_video_ladder_update(&ladder, MS(4000), MS(500)));
+    assert(sc_video_ladder_update(&ladder, MS(4500), MS(500)));
+    assert(ladder.index == 1);
+    assert(sc_video_ladder_get_rung(&ladder)->max_size == 1024);
+
+    // Settling after the change
+    assert(!sc_video_ladder_update(&ladder, MS(5000), MS(500)));
+    assert(!sc_video_ladder_update(&ladder, MS(5500), MS(500)));
+
+    assert(!sc_video_ladder_update(&ladder, MS(7500), MS(500)));
+    assert(sc_video_ladder_update(&ladder, MS(8000), MS(500)));
+    assert(ladder.index == 2);
+
+    assert(!sc_video_ladder_update(&ladder, MS(11000), MS(500)));
+    assert(sc_video_ladder_update(&ladder, MS(11500), MS(500)));
+    assert(ladder.index == 3);
+
+    // Already at the lowest rung
+    assert(!sc_video_ladder_update(&ladder, MS(15000), MS(500)));
+    assert(!sc_video_ladder_update(&ladder, MS(15500), MS(500)));
+    assert(ladder.index == 3);
+}
+
+static void test_step_up(void) {
+    struct sc_video_ladder ladder;
+    sc_video_ladder_init(&ladder, 0, 1080, 0, 0);
+
+    assert(!sc_video_ladder_update(&ladder, SEC(3), MS(500)));
+    assert(sc_video_ladder_update(&ladder, SEC(4), MS(500)));
+    assert(ladder.index == 1);
+
+    // The network must stay clear for 20 seconds (after settling)
+    sc_tick t = SEC(5);
+    for (; t < SEC(27); t += MS(500)) {
+        assert(!sc_video_ladder_update(&ladder, t, MS(10)));
+    }
+    assert(sc_video_ladder_update(&ladder, t, MS(10)));
+    assert(ladder.index == 0);
+    sc_tick up = t;
+
+    // A moderate delay resets the clear period, without stepping down
+    assert(!sc_video_ladder_update(&ladder, up + SEC(4), MS(100)));
+    assert(ladder.index == 0);
+
+    // Congestion shortly after the step up
+    assert(!sc_video_ladder_update(&ladder, up + SEC(5), MS(500)));
+    assert(sc_video_ladder_update(&ladder, up + SEC(6), MS(500)));
+    assert(ladder.index == 1);
+    sc_tick down = up + SEC(6);
+
+    // The next step up waits twice as long
+    for (t = down + SEC(3); t < down + SEC(43); t += MS(500)) {
+        assert(!sc_video_ladder_update(&ladder, t, MS(10)));
+    }
+    assert(sc_video_ladder_update(&ladder, t, MS(10)));
+    assert(ladder.index == 0);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_rungs();
+    test_step_down();
+    test_step_up();
+
+    return 0;
+}
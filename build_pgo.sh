@@ -0,0 +1,56 @@
+#!/usr/bin/env bash
+# Build the client with link-time and profile-guided optimizations.
+#
+# The profile is collected by replaying (as fast as possible) streams dumped
+# from a real session by --dump-streams, so the hot paths (demuxing, decoding,
+# rendering, audio resampling) are exercised without a device:
+#
+#     scrcpy --dump-streams=dump
+#     ./build_pgo.sh dump [<training scrcpy options>...]
+#
+# The training options must match the dump (e.g. --no-audio if the audio was
+# not captured). Additional meson options may be passed in MESON_ARGS (e.g.
+# MESON_ARGS=-Dprebuilt_server=/path/to/scrcpy-server).
+set -e
+
+BUILDDIR=build-pgo
+
+if [[ $# -lt 1 ]]
+then
+    echo "Usage: $0 <stream dump dir> [<training scrcpy options>...]" >&2
+    exit 1
+fi
+
+DUMP_DIR="$(realpath "$1")"
+shift
+
+echo "[scrcpy] Building instrumented client..."
+rm -rf "$BUILDDIR"
+# shellcheck disable=SC2086
+meson setup "$BUILDDIR" --buildtype=release --strip -Db_lto=true \
+    -Db_pgo=generate $MESON_ARGS
+ninja -C "$BUILDDIR"
+
+echo "[scrcpy] Training..."
+# The window is rendered offscreen, so that the training may run on a build
+# machine without a display (it exits at the end of the replay)
+SDL_VIDEODRIVER=offscreen \
+LLVM_PROFILE_FILE="$PWD/$BUILDDIR/default-%p.profraw" \
+    "$BUILDDIR/app/scrcpy" --replay-streams="$DUMP_DIR" \
+                           --replay-streams-max-speed \
+                           --render-driver=software \
+                           "$@"
+
+if compgen -G "$BUILDDIR/*.profraw" > /dev/null
+then
+    # clang writes raw profiles, which must be merged (gcc writes .gcda files
+    # next to the object files, used as is)
+    llvm-profdata merge -output="$BUILDDIR/default.profdata" \
+        "$BUILDDIR"/*.profraw
+fi
+
+echo "[scrcpy] Building optimized client..."
+meson configure "$BUILDDIR" -Db_pgo=use
+ninja -C "$BUILDDIR"
+
+echo "[scrcpy] Optimized client built in $BUILDDIR/"
@@ -17,21 +17,24 @@ import java.nio.ByteBuffer;
 
 public final class AudioCapture {
 
-    public static final int SAMPLE_RATE = 48000;
-    public static final int CHANNEL_CONFIG = AudioFormat.CHANNEL_IN_STEREO;
-    public static final int CHANNELS = 2;
-    public static final int CHANNEL_MASK = AudioFormat.CHANNEL_IN_LEFT | AudioFormat.CHANNEL_IN_RIGHT;
+    public static final int DEFAULT_SAMPLE_RATE = 48000;
+    public static final int DEFAULT_CHANNELS = 2;
     public static final int ENCODING = AudioFormat.ENCODING_PCM_16BIT;
     public static final int BYTES_PER_SAMPLE = 2;
 
-    // Never read more than 1024 samples, even if the buffer is bigger (that would increase latency).
-    // A lower value is useless, since the system captures audio samples by blocks of 1024 (so for example if we read by blocks of 256 samples, we
-    // receive 4 successive blocks without waiting, then we wait for the 4 next ones).
-    public static final int MAX_READ_SIZE = 1024 * CHANNELS * BYTES_PER_SAMPLE;
-
-    private static final long ONE_SAMPLE_US = (1000000 + SAMPLE_RATE - 1) / SAMPLE_RATE; // 1 sample in microseconds (used for fixing PTS)
+    // Never read more than 1024 samples by default, even if the buffer is bigger (that would increase latency).
+    // On most devices, a lower value is useless, since the system captures audio samples by blocks of 1024 (so for example if we read by blocks of
+    // 256 samples, we receive 4 successive blocks without waiting, then we wait for the 4 next ones). On devices capturing smaller blocks, a
+    // smaller read size (for example 480 or 240 samples, matching the Opus 10ms and 5ms frame sizes at 48kHz) reduces the capture latency.
+    public static final int DEFAULT_READ_SIZE = 1024; // in samples
 
     private final int audioSource;
+    private final int sampleRate;
+    private final int channels;
+    private final int channelConfig;
+    private final int channelMask;
+    private final int maxReadSize; // in bytes
+    private final long oneSampleUs; // 1 sample in microseconds (used for fixing PTS)
 
     private AudioRecord recorder;
 
@@ -40,29 +43,54 @@ public final class AudioCapture {
     private long previousPts = 0;
     private long nextPts = 0;
 
-    public AudioCapture(AudioSource audioSource) {
+    public AudioCapture(AudioSource audioSource, int sampleRate, int channels, int readSize) {
+        assert channels == 1 || channels == 2;
         this.audioSource = audioSource.value();
+        this.sampleRate = sampleRate;
+        this.channels = channels;
+        if (channels == 1) {
+            // The system downmixes the captured audio
+            channelConfig = AudioFormat.CHANNEL_IN_MONO;
+            channelMask = AudioFormat.CHANNEL_IN_FRONT;
+        } else {
+            channelConfig = AudioFormat.CHANNEL_IN_STEREO;
+            channelMask = AudioFormat.CHANNEL_IN_LEFT | AudioFormat.CHANNEL_IN_RIGHT;
+        }
+        this.maxReadSize = readSize * channels * BYTES_PER_SAMPLE;
+        this.oneSampleUs = (1000000 + sampleRate - 1) / sampleRate;
+    }
+
+    public int getSampleRate() {
+        return sampleRate;
     }
 
-    private static AudioFormat createAudioFormat() {
+    public int getChannels() {
+        return channels;
+    }
+
+    public int getMaxReadSize() {
+        return maxReadSize;
+    }
+
+    private static AudioFormat createAudioFormat(int sampleRate, int channelConfig) {
         AudioFormat.Builder builder = new AudioFormat.Builder();
         builder.setEncoding(ENCODING);
-        builder.setSampleRate(SAMPLE_RATE);
-        builder.setChannelMask(CHANNEL_CONFIG);
+        builder.setSampleRate(sampleRate);
+        builder.setChannelMask(channelConfig);
         return builder.build();
     }
 
     @TargetApi(Build.VERSION_CODES.M)
     @SuppressLint({"WrongConstant", "MissingPermission"})
-    private static AudioRecord createAudioRecord(int audioSource) {
+    private static AudioRecord createAudioRecord(int audioSource, int sampleRate, int channelConfig) {
         AudioRecord.Builder builder = new AudioRecord.Builder();
         if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.S) {
             // On older APIs, Workarounds.fillAppInfo() must be called beforehand
             builder.setContext(FakeContext.get());
         }
         builder.setAudioSource(audioSource);
-        builder.setAudioFormat(createAudioFormat());
-        int minBufferSize = AudioRecord.getMinBufferSize(SAMPLE_RATE, CHANNEL_CONFIG, ENCODING);
+        builder.setAudioFormat(createAudioFormat(sampleRate, channelConfig));
+        int minBufferSize = AudioRecord.getMinBufferSize(sampleRate, channelConfig, ENCODING);
         // This buffer size does not impact latency
         builder.setBufferSizeInBytes(8 * minBufferSize);
         return builder.build();
@@ -108,17 +136,20 @@ public final class AudioCapture {
 
     private void startRecording() {
         try {
-            recorder = createAudioRecord(audioSource);
+            recorder = createAudioRecord(audioSource, sampleRate, channelConfig);
         } catch (NullPointerException e) {
             // Creating an AudioRecord using an AudioRecord.Builder does not work on Vivo phones:
             // - <https://github.com/Genymobile/scrcpy/issues/3805>
             // - <https://github.com/Genymobile/scrcpy/pull/3862>
-            recorder = Workarounds.createAudioRecord(audioSource, SAMPLE_RATE, CHANNEL_CONFIG, CHANNELS, CHANNEL_MASK, ENCODING);
+            recorder = Workarounds.createAudioRecord(audioSource, sampleRate, channelConfig, channels, channelMask, ENCODING);
         }
         recorder.startRecording();
     }
 
     public void start() throws AudioCaptureForegroundException {
+        // Called from the audio thread, concurrently with the video encoder setup
+        Workarounds.applyForAudio();
+
         if (Build.VERSION.SDK_INT == Build.VERSION_CODES.R) {
             startWorkaroundAndroid11();
             try {
@@ -140,7 +171,7 @@ public final class AudioCapture {
 
     @TargetApi(Build.VERSION_CODES.N)
     public int read(ByteBuffer directBuffer, MediaCodec.BufferInfo outBufferInfo) {
-        int r = recorder.read(directBuffer, MAX_READ_SIZE);
+        int r = recorder.read(directBuffer, maxReadSize);
         if (r <= 0) {
             return r;
         }
@@ -160,16 +191,16 @@ public final class AudioCapture {
             pts = nextPts;
         }
 
-        long durationUs = r * 1000000L / (CHANNELS * BYTES_PER_SAMPLE * SAMPLE_RATE);
+        long durationUs = r * 1000000L / (channels * BYTES_PER_SAMPLE * sampleRate);
         nextPts = pts + durationUs;
 
-        if (previousPts != 0 && pts < previousPts + ONE_SAMPLE_US) {
+        if (previousPts != 0 && pts < previousPts + oneSampleUs) {
             // Audio PTS may come from two sources:
             //  - recorder.getTimestamp() if the call works;
             //  - an estimation from the previous PTS and the packet size as a fallback.
             //
             // Therefore, the property that PTS are monotonically increasing is no guaranteed in corner cases, so enforce it.
-            pts = previousPts + ONE_SAMPLE_US;
+            pts = previousPts + oneSampleUs;
         }
         previousPts = pts;
 
@@ -11,32 +11,68 @@ import android.os.Looper;
 import java.io.IOException;
 import java.nio.ByteBuffer;
 import java.util.List;
-import java.util.concurrent.ArrayBlockingQueue;
-import java.util.concurrent.BlockingQueue;
 
 public final class AudioEncoder implements AsyncProcessor {
 
-    private static class InputTask {
-        private final int index;
+    /**
+     * Blocking FIFO of MediaCodec buffer indexes (with the buffer info for output buffers).
+     * <p>
+     * The slots are preallocated, so that no object is allocated per buffer.
+     */
+    private static final class BufferQueue {
+        private final int[] indexes;
+        private final int[] offsets;
+        private final int[] sizes;
+        private final long[] presentationTimesUs;
+        private final int[] flags;
+
+        private int head;
+        private int count;
+
+        BufferQueue(int capacity) {
+            indexes = new int[capacity];
+            offsets = new int[capacity];
+            sizes = new int[capacity];
+            presentationTimesUs = new long[capacity];
+            flags = new int[capacity];
+        }
+
+        synchronized void put(int index, MediaCodec.BufferInfo bufferInfo) throws InterruptedException {
+            while (count == indexes.length) {
+                wait();
+            }
 
-        InputTask(int index) {
-            this.index = index;
+            int slot = (head + count) % indexes.length;
+            indexes[slot] = index;
+            if (bufferInfo != null) {
+                offsets[slot] = bufferInfo.offset;
+                sizes[slot] = bufferInfo.size;
+                presentationTimesUs[slot] = bufferInfo.presentationTimeUs;
+                flags[slot] = bufferInfo.flags;
+            }
+            ++count;
+            notifyAll();
         }
-    }
 
-    private static class OutputTask {
-        private final int index;
-        private final MediaCodec.BufferInfo bufferInfo;
+        /**
+         * Take the next buffer index, and copy its buffer info to {@code outBufferInfo} (if not {@code null}).
+         */
+        synchronized int take(MediaCodec.BufferInfo outBufferInfo) throws InterruptedException {
+            while (count == 0) {
+                wait();
+            }
 
-        OutputTask(int index, MediaCodec.BufferInfo bufferInfo) {
-            this.index = index;
-            this.bufferInfo = bufferInfo;
+            int slot = head;
+            if (outBufferInfo != null) {
+                outBufferInfo.set(offsets[slot], sizes[slot], presentationTimesUs[slot], flags[slot]);
+            }
+            head = (head + 1) % indexes.length;
+            --count;
+            notifyAll();
+            return indexes[slot];
         }
     }
 
-    private static final int SAMPLE_RATE = AudioCapture.SAMPLE_RATE;
-    private static final int CHANNELS = AudioCapture.CHANNELS;
-
     private final AudioCapture capture;
     private final Streamer streamer;
     private final int bitRate;
@@ -45,8 +81,8 @@ public final class AudioEncoder implements AsyncProcessor {
 
     // Capacity of 64 is in practice "infinite" (it is limited by the number of available MediaCodec buffers, typically 4).
     // So many pending tasks would lead to an unacceptable delay anyway.
-    private final BlockingQueue<InputTask> inputTasks = new ArrayBlockingQueue<>(64);
-    private final BlockingQueue<OutputTask> outputTasks = new ArrayBlockingQueue<>(64);
+    private final BufferQueue inputTasks = new BufferQueue(64);
+    private final BufferQueue outputTasks = new BufferQueue(64);
 
     private Thread thread;
     private HandlerThread mediaCodecThread;
@@ -64,12 +100,29 @@ public final class AudioEncoder implements AsyncProcessor {
         this.encoderName = encoderName;
     }
 
-    private static MediaFormat createFormat(String mimeType, int bitRate, List<CodecOption> codecOptions) {
+    private static void checkOpusCodecOptions(List<CodecOption> codecOptions) throws ConfigurationException {
+        if (codecOptions == null) {
+            return;
+        }
+
+        for (CodecOption option : codecOptions) {
+            if (MediaFormat.KEY_COMPLEXITY.equals(option.getKey())) {
+                // The Opus encoder complexity ranges from 0 (fastest) to 10 (best quality)
+                Object value = option.getValue();
+                if (!(value instanceof Integer) || (int) value < 0 || (int) value > 10) {
+                    Ln.e("Invalid Opus complexity (expected an integer between 0 and 10): " + value);
+                    throw new ConfigurationException("Invalid Opus complexity");
+                }
+            }
+        }
+    }
+
+    private static MediaFormat createFormat(String mimeType, int bitRate, int sampleRate, int channels, List<CodecOption> codecOptions) {
         MediaFormat format = new MediaFormat();
         format.setString(MediaFormat.KEY_MIME, mimeType);
         format.setInteger(MediaFormat.KEY_BIT_RATE, bitRate);
-        format.setInteger(MediaFormat.KEY_CHANNEL_COUNT, CHANNELS);
-        format.setInteger(MediaFormat.KEY_SAMPLE_RATE, SAMPLE_RATE);
+        format.setInteger(MediaFormat.KEY_CHANNEL_COUNT, channels);
+        format.setInteger(MediaFormat.KEY_SAMPLE_RATE, sampleRate);
 
         if (codecOptions != null) {
             for (CodecOption option : codecOptions) {
@@ -88,27 +141,30 @@ public final class AudioEncoder implements AsyncProcessor {
         final MediaCodec.BufferInfo bufferInfo = new MediaCodec.BufferInfo();
 
         while (!Thread.currentThread().isInterrupted()) {
-            InputTask task = inputTasks.take();
-            ByteBuffer buffer = mediaCodec.getInputBuffer(task.index);
+            int index = inputTasks.take(null);
+            // AudioRecord writes directly into the codec input buffer
+            ByteBuffer buffer = mediaCodec.getInputBuffer(index);
             int r = capture.read(buffer, bufferInfo);
             if (r <= 0) {
                 throw new IOException("Could not read audio: " + r);
             }
 
-            mediaCodec.queueInputBuffer(task.index, bufferInfo.offset, bufferInfo.size, bufferInfo.presentationTimeUs, bufferInfo.flags);
+            mediaCodec.queueInputBuffer(index, bufferInfo.offset, bufferInfo.size, bufferInfo.presentationTimeUs, bufferInfo.flags);
         }
     }
 
     private void outputThread(MediaCodec mediaCodec) throws IOException, InterruptedException {
         streamer.writeAudioHeader();
 
+        final MediaCodec.BufferInfo bufferInfo = new MediaCodec.BufferInfo();
+
         while (!Thread.currentThread().isInterrupted()) {
-            OutputTask task = outputTasks.take();
-            ByteBuffer buffer = mediaCodec.getOutputBuffer(task.index);
+            int index = outputTasks.take(bufferInfo);
+            ByteBuffer buffer = mediaCodec.getOutputBuffer(index);
             try {
-                streamer.writePacket(buffer, task.bufferInfo);
+                streamer.writePacket(buffer, bufferInfo);
             } finally {
-                mediaCodec.releaseOutputBuffer(task.index, false);
+                mediaCodec.releaseOutputBuffer(index, false);
             }
         }
     }
@@ -178,12 +234,15 @@ public final class AudioEncoder implements AsyncProcessor {
         boolean mediaCodecStarted = false;
         try {
             Codec codec = streamer.getCodec();
+            if (codec == AudioCodec.OPUS) {
+                checkOpusCodecOptions(codecOptions);
+            }
             mediaCodec = createMediaCodec(codec, encoderName);
 
             mediaCodecThread = new HandlerThread("media-codec");
             mediaCodecThread.start();
 
-            MediaFormat format = createFormat(codec.getMimeType(), bitRate, codecOptions);
+            MediaFormat format = createFormat(codec.getMimeType(), bitRate, capture.getSampleRate(), capture.getChannels(), codecOptions);
             mediaCodec.setCallback(new EncoderCallback(), new Handler(mediaCodecThread.getLooper()));
             mediaCodec.configure(format, null, null, MediaCodec.CONFIGURE_FLAG_ENCODE);
 
@@ -300,7 +359,7 @@ public final class AudioEncoder implements AsyncProcessor {
         @Override
         public void onInputBufferAvailable(MediaCodec codec, int index) {
             try {
-                inputTasks.put(new InputTask(index));
+                inputTasks.put(index, null);
             } catch (InterruptedException e) {
                 end();
             }
@@ -309,7 +368,7 @@ public final class AudioEncoder implements AsyncProcessor {
         @Override
         public void onOutputBufferAvailable(MediaCodec codec, int index, MediaCodec.BufferInfo bufferInfo) {
             try {
-                outputTasks.put(new OutputTask(index, bufferInfo));
+                outputTasks.put(index, bufferInfo);
             } catch (InterruptedException e) {
                 end();
             }
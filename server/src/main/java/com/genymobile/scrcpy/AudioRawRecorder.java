@@ -8,24 +8,85 @@ import java.nio.ByteBuffer;
 
 public final class AudioRawRecorder implements AsyncProcessor {
 
+    // Maximum number of successive reads coalesced into a single packet while the socket is slow
+    private static final int MAX_COALESCED_READS = 8;
+
     private final AudioCapture capture;
     private final Streamer streamer;
 
     private Thread thread;
+    private Thread writerThread;
+
+    // The capture thread fills one buffer while the writer thread writes the other one. While a buffer is being written (the socket may be
+    // slow), the next reads are appended to the buffer being filled, so that they are written at once as a single packet.
+    private final Object lock = new Object();
+    private ByteBuffer spare; // the buffer not used by any thread (null while it is being written)
+    private ByteBuffer toWrite; // the buffer to be written by the writer thread (null if none)
+    private long toWritePts;
+    private boolean writerFailed;
 
     public AudioRawRecorder(AudioCapture capture, Streamer streamer) {
         this.capture = capture;
         this.streamer = streamer;
     }
 
-    private void record() throws IOException, AudioCaptureForegroundException {
+    private void write() throws IOException, InterruptedException {
+        while (true) {
+            ByteBuffer buffer;
+            long pts;
+            synchronized (lock) {
+                while (toWrite == null) {
+                    lock.wait();
+                }
+                buffer = toWrite;
+                pts = toWritePts;
+                toWrite = null;
+            }
+
+            buffer.flip();
+            streamer.writePacket(buffer, pts, false, false);
+
+            synchronized (lock) {
+                buffer.clear();
+                spare = buffer;
+                lock.notify();
+            }
+        }
+    }
+
+    private void startWriter() {
+        writerThread = new Thread(() -> {
+            try {
+                write();
+            } catch (InterruptedException e) {
+                // this is expected on close
+            } catch (IOException e) {
+                // Broken pipe is expected on close, because the socket is closed by the client
+                if (!IO.isBrokenPipe(e)) {
+                    Ln.e("Audio writing error", e);
+                }
+            } finally {
+                synchronized (lock) {
+                    writerFailed = true;
+                    lock.notify();
+                }
+            }
+        }, "audio-raw-writer");
+        writerThread.start();
+    }
+
+    private void record() throws IOException, AudioCaptureForegroundException, InterruptedException {
         if (Build.VERSION.SDK_INT < Build.VERSION_CODES.R) {
             Ln.w("Audio disabled: it is not supported before Android 11");
             streamer.writeDisableStream(false);
             return;
         }
 
-        final ByteBuffer buffer = ByteBuffer.allocateDirect(AudioCapture.MAX_READ_SIZE);
+        final int maxReadSize = capture.getMaxReadSize();
+        // Allocated once, reused for all the packets
+        ByteBuffer filling = ByteBuffer.allocateDirect(MAX_COALESCED_READS * maxReadSize);
+        spare = ByteBuffer.allocateDirect(MAX_COALESCED_READS * maxReadSize);
+        long fillingPts = 0;
         final MediaCodec.BufferInfo bufferInfo = new MediaCodec.BufferInfo();
 
         try {
@@ -38,22 +99,44 @@ public final class AudioRawRecorder implements AsyncProcessor {
             }
 
             streamer.writeAudioHeader();
+            startWriter();
+
             while (!Thread.currentThread().isInterrupted()) {
-                buffer.position(0);
-                int r = capture.read(buffer, bufferInfo);
+                // The samples are read at the current position
+                int r = capture.read(filling, bufferInfo);
                 if (r < 0) {
                     throw new IOException("Could not read audio: " + r);
                 }
-                buffer.limit(r);
+                if (filling.position() == 0) {
+                    // The packet PTS is the PTS of its first sample
+                    fillingPts = bufferInfo.presentationTimeUs;
+                }
+                filling.position(filling.position() + r);
 
-                streamer.writePacket(buffer, bufferInfo);
-            }
-        } catch (IOException e) {
-            // Broken pipe is expected on close, because the socket is closed by the client
-            if (!IO.isBrokenPipe(e)) {
-                Ln.e("Audio capture error", e);
+                synchronized (lock) {
+                    boolean full = filling.remaining() < maxReadSize;
+                    while (full && spare == null && !writerFailed) {
+                        // Both buffers are full, wait for the socket
+                        lock.wait();
+                    }
+                    if (writerFailed) {
+                        return;
+                    }
+                    if (spare != null) {
+                        // The writer is idle, pass it the buffer
+                        toWrite = filling;
+                        toWritePts = fillingPts;
+                        filling = spare;
+                        spare = null;
+                        lock.notify();
+                    }
+                }
             }
         } finally {
+            if (writerThread != null) {
+                writerThread.interrupt();
+                writerThread.join();
+            }
             capture.stop();
         }
     }
@@ -66,6 +149,13 @@ public final class AudioRawRecorder implements AsyncProcessor {
                 record();
             } catch (AudioCaptureForegroundException e) {
                 // Do not print stack trace, a user-friendly error-message has already been logged
+            } catch (InterruptedException e) {
+                // this is expected on close
+            } catch (IOException e) {
+                // Broken pipe is expected on close, because the socket is closed by the client
+                if (!IO.isBrokenPipe(e)) {
+                    Ln.e("Audio capture error", e);
+                }
             } catch (Throwable t) {
                 Ln.e("Audio recording error", t);
                 fatalError = true;
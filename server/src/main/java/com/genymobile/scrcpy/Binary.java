@@ -13,6 +13,10 @@ public final class Binary {
         return value & 0xff;
     }
 
+    public static long toUnsigned(int value) {
+        return value & 0xffff_ffffL;
+    }
+
     /**
      * Convert unsigned 16-bit fixed-point to a float between 0 and 1
      *
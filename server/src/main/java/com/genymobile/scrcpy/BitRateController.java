@@ -0,0 +1,99 @@
+package com.genymobile.scrcpy;
+
+/**
+ * Adapt the video bit rate from the network feedback reported by the client (AIMD).
+ * <p>
+ * On congestion (high queuing delay), the bit rate is decreased multiplicatively, then held for some time to let the queue drain. Once the
+ * network is stable (low queuing delay), the bit rate is increased additively, up to the requested bit rate.
+ * <p>
+ * The bit rate may also be capped below the requested bit rate (for example by the thermal governor).
+ */
+public final class BitRateController {
+
+    static final int HIGH_QUEUING_DELAY_US = 100_000;
+    static final int LOW_QUEUING_DELAY_US = 20_000;
+    private static final int DECREASE_PERCENT = 70;
+    private static final int INCREASE_STEPS = 20; // from min to max bit rate
+    private static final long HOLD_AFTER_DECREASE_MS = 1000;
+    private static final long STABLE_BEFORE_INCREASE_MS = 1000;
+    private static final int MIN_BIT_RATE = 250_000;
+
+    private final int maxBitRate;
+    private final int minBitRate;
+    private final int increaseStep;
+
+    private int limit; // the current maximum, at most maxBitRate
+    private int bitRate;
+    private long holdUntil;
+    private long stableSince = -1;
+
+    public BitRateController(int maxBitRate) {
+        this.maxBitRate = maxBitRate;
+        this.minBitRate = Math.min(maxBitRate, Math.max(maxBitRate / 10, MIN_BIT_RATE));
+        this.increaseStep = Math.max(1, (maxBitRate - minBitRate) / INCREASE_STEPS);
+        this.limit = maxBitRate;
+        this.bitRate = maxBitRate;
+    }
+
+    public int getBitRate() {
+        return bitRate;
+    }
+
+    /**
+     * Handle a network feedback.
+     *
+     * @param queuingDelayUs the estimated queuing delay (µs)
+     * @param nowMs the current time (ms)
+     * @return the new bit rate if it changed, or 0 otherwise
+     */
+    public int onFeedback(int queuingDelayUs, long nowMs) {
+        if (queuingDelayUs >= HIGH_QUEUING_DELAY_US) {
+            stableSince = -1;
+            int lowest = Math.min(minBitRate, limit);
+            if (nowMs < holdUntil || bitRate == lowest) {
+                return 0;
+            }
+            bitRate = Math.max(lowest, (int) ((long) bitRate * DECREASE_PERCENT / 100));
+            holdUntil = nowMs + HOLD_AFTER_DECREASE_MS;
+            return bitRate;
+        }
+
+        if (queuingDelayUs >= LOW_QUEUING_DELAY_US) {
+            // Neither congested nor stable
+            stableSince = -1;
+            return 0;
+        }
+
+        if (stableSince == -1) {
+            stableSince = nowMs;
+        }
+
+        if (nowMs < holdUntil || nowMs - stableSince < STABLE_BEFORE_INCREASE_MS || bitRate >= limit) {
+            return 0;
+        }
+
+        bitRate = Math.min(limit, bitRate + increaseStep);
+        // Wait for a new stable period before the next increase
+        stableSince = nowMs;
+        return bitRate;
+    }
+
+    /**
+     * Cap the bit rate.
+     * <p>
+     * If the bit rate was at the previous limit (the network is not congested), it follows the new limit. Otherwise, it is only lowered if
+     * necessary (it is increased on the next stable feedbacks).
+     *
+     * @param newLimit the maximum bit rate (capped to the requested bit rate)
+     * @return the new bit rate if it changed, or 0 otherwise
+     */
+    public int setLimit(int newLimit) {
+        boolean atLimit = bitRate == limit;
+        limit = Math.max(1, Math.min(maxBitRate, newLimit));
+        if (bitRate > limit || (atLimit && bitRate != limit)) {
+            bitRate = limit;
+            return bitRate;
+        }
+        return 0;
+    }
+}
@@ -13,6 +13,9 @@ import android.hardware.camera2.CameraDevice;
 import android.hardware.camera2.CameraManager;
 import android.hardware.camera2.CaptureFailure;
 import android.hardware.camera2.CaptureRequest;
+import android.hardware.camera2.CaptureResult;
+import android.hardware.camera2.TotalCaptureResult;
+import android.hardware.camera2.params.DynamicRangeProfiles;
 import android.hardware.camera2.params.OutputConfiguration;
 import android.hardware.camera2.params.SessionConfiguration;
 import android.hardware.camera2.params.StreamConfigurationMap;
@@ -35,6 +38,9 @@ import java.util.stream.Stream;
 
 public class CameraCapture extends SurfaceCapture {
 
+    // Lock AE/AF anyway after this number of frames if they did not report convergence
+    private static final int MAX_CONVERGENCE_FRAMES = 60;
+
     private final String explicitCameraId;
     private final CameraFacing cameraFacing;
     private final Size explicitSize;
@@ -42,9 +48,15 @@ public class CameraCapture extends SurfaceCapture {
     private final CameraAspectRatio aspectRatio;
     private final int fps;
     private final boolean highSpeed;
+    private final boolean hdr;
+    private final boolean lowLatency;
+    private final boolean lockAeAf;
 
     private String cameraId;
     private Size size;
+    private boolean hdr10;
+    private boolean realtimeTimestamps;
+    private int[] noiseReductionModes;
 
     private HandlerThread cameraThread;
     private Handler cameraHandler;
@@ -53,8 +65,12 @@ public class CameraCapture extends SurfaceCapture {
 
     private final AtomicBoolean disconnected = new AtomicBoolean();
 
+    // Only accessed from the camera thread
+    private boolean aeAfLocked;
+    private int convergenceFrames;
+
     public CameraCapture(String explicitCameraId, CameraFacing cameraFacing, Size explicitSize, int maxSize, CameraAspectRatio aspectRatio, int fps,
-            boolean highSpeed) {
+            boolean highSpeed, boolean hdr, boolean lowLatency, boolean lockAeAf) {
         this.explicitCameraId = explicitCameraId;
         this.cameraFacing = cameraFacing;
         this.explicitSize = explicitSize;
@@ -62,6 +78,9 @@ public class CameraCapture extends SurfaceCapture {
         this.aspectRatio = aspectRatio;
         this.fps = fps;
         this.highSpeed = highSpeed;
+        this.hdr = hdr;
+        this.lowLatency = lowLatency;
+        this.lockAeAf = lockAeAf;
     }
 
     @Override
@@ -77,11 +96,28 @@ public class CameraCapture extends SurfaceCapture {
                 throw new IOException("No matching camera found");
             }
 
-            size = selectSize(cameraId, explicitSize, maxSize, aspectRatio, highSpeed);
+            size = selectSize(cameraId, explicitSize, maxSize, aspectRatio, fps, highSpeed);
             if (size == null) {
                 throw new IOException("Could not select camera size");
             }
 
+            if (highSpeed && fps > 0 && !isHighSpeedSupported(cameraId, size, fps)) {
+                throw new IOException("Unsupported high speed camera size and frame rate: " + size + " at " + fps + " fps (see --list-camera-sizes)");
+            }
+
+            if (hdr) {
+                hdr10 = isHdr10Supported(cameraId);
+                if (!hdr10) {
+                    Ln.w("HDR10 capture not supported by the camera (Android 13+ required), capturing in SDR");
+                }
+            }
+
+            CameraCharacteristics characteristics = ServiceManager.getCameraManager().getCameraCharacteristics(cameraId);
+            Integer timestampSource = characteristics.get(CameraCharacteristics.SENSOR_INFO_TIMESTAMP_SOURCE);
+            // The frames are timestamped by the sensor (start of exposure), in the realtime clock base if the source is REALTIME
+            realtimeTimestamps = timestampSource != null && timestampSource == CameraCharacteristics.SENSOR_INFO_TIMESTAMP_SOURCE_REALTIME;
+            noiseReductionModes = characteristics.get(CameraCharacteristics.NOISE_REDUCTION_AVAILABLE_NOISE_REDUCTION_MODES);
+
             Ln.i("Using camera '" + cameraId + "'");
             cameraDevice = openCamera(cameraId);
         } catch (CameraAccessException | InterruptedException e) {
@@ -89,6 +125,17 @@ public class CameraCapture extends SurfaceCapture {
         }
     }
 
+    private static boolean isHdr10Supported(String cameraId) throws CameraAccessException {
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.TIRAMISU) {
+            return false;
+        }
+
+        CameraManager cameraManager = ServiceManager.getCameraManager();
+        CameraCharacteristics characteristics = cameraManager.getCameraCharacteristics(cameraId);
+        DynamicRangeProfiles profiles = characteristics.get(CameraCharacteristics.REQUEST_AVAILABLE_DYNAMIC_RANGE_PROFILES);
+        return profiles != null && profiles.getSupportedProfiles().contains(DynamicRangeProfiles.HDR10);
+    }
+
     private static String selectCamera(String explicitCameraId, CameraFacing cameraFacing) throws CameraAccessException {
         if (explicitCameraId != null) {
             return explicitCameraId;
@@ -116,7 +163,7 @@ public class CameraCapture extends SurfaceCapture {
     }
 
     @TargetApi(Build.VERSION_CODES.N)
-    private static Size selectSize(String cameraId, Size explicitSize, int maxSize, CameraAspectRatio aspectRatio, boolean highSpeed)
+    private static Size selectSize(String cameraId, Size explicitSize, int maxSize, CameraAspectRatio aspectRatio, int fps, boolean highSpeed)
             throws CameraAccessException {
         if (explicitSize != null) {
             return explicitSize;
@@ -132,6 +179,11 @@ public class CameraCapture extends SurfaceCapture {
             stream = stream.filter(it -> it.getWidth() <= maxSize && it.getHeight() <= maxSize);
         }
 
+        if (highSpeed && fps > 0) {
+            // In a constrained high speed session, the frame rates depend on the size
+            stream = stream.filter(it -> isHighSpeedFpsSupported(configs, it, fps));
+        }
+
         Float targetAspectRatio = resolveAspectRatio(aspectRatio, characteristics);
         if (targetAspectRatio != null) {
             stream = stream.filter(it -> {
@@ -179,6 +231,28 @@ public class CameraCapture extends SurfaceCapture {
         return null;
     }
 
+    private static boolean isHighSpeedFpsSupported(StreamConfigurationMap configs, android.util.Size size, int fps) {
+        for (Range<Integer> range : configs.getHighSpeedVideoFpsRangesFor(size)) {
+            if (range.getUpper() == fps) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    private static boolean isHighSpeedSupported(String cameraId, Size size, int fps) throws CameraAccessException {
+        CameraManager cameraManager = ServiceManager.getCameraManager();
+        CameraCharacteristics characteristics = cameraManager.getCameraCharacteristics(cameraId);
+        StreamConfigurationMap configs = characteristics.get(CameraCharacteristics.SCALER_STREAM_CONFIGURATION_MAP);
+
+        for (android.util.Size highSpeedSize : configs.getHighSpeedVideoSizes()) {
+            if (highSpeedSize.getWidth() == size.getWidth() && highSpeedSize.getHeight() == size.getHeight()) {
+                return isHighSpeedFpsSupported(configs, highSpeedSize, fps);
+            }
+        }
+        return false;
+    }
+
     private static Float resolveAspectRatio(CameraAspectRatio ratio, CameraCharacteristics characteristics) {
         if (ratio == null) {
             return null;
@@ -196,8 +270,8 @@ public class CameraCapture extends SurfaceCapture {
     public void start(Surface surface) throws IOException {
         try {
             CameraCaptureSession session = createCaptureSession(cameraDevice, surface);
-            CaptureRequest request = createCaptureRequest(surface);
-            setRepeatingRequest(session, request);
+            CaptureRequest.Builder requestBuilder = createCaptureRequest(surface);
+            setRepeatingRequest(session, requestBuilder);
         } catch (CameraAccessException | InterruptedException e) {
             throw new IOException(e);
         }
@@ -226,7 +300,7 @@ public class CameraCapture extends SurfaceCapture {
 
         this.maxSize = maxSize;
         try {
-            size = selectSize(cameraId, null, maxSize, aspectRatio, highSpeed);
+            size = selectSize(cameraId, null, maxSize, aspectRatio, fps, highSpeed);
             return size != null;
         } catch (CameraAccessException e) {
             Ln.w("Could not select camera size", e);
@@ -286,6 +360,9 @@ public class CameraCapture extends SurfaceCapture {
     private CameraCaptureSession createCaptureSession(CameraDevice camera, Surface surface) throws CameraAccessException, InterruptedException {
         CompletableFuture<CameraCaptureSession> future = new CompletableFuture<>();
         OutputConfiguration outputConfig = new OutputConfiguration(surface);
+        if (hdr10) {
+            setHdr10Profile(outputConfig);
+        }
         List<OutputConfiguration> outputs = Arrays.asList(outputConfig);
 
         int sessionType = highSpeed ? SessionConfiguration.SESSION_HIGH_SPEED : SessionConfiguration.SESSION_REGULAR;
@@ -310,25 +387,96 @@ public class CameraCapture extends SurfaceCapture {
         }
     }
 
-    private CaptureRequest createCaptureRequest(Surface surface) throws CameraAccessException {
-        CaptureRequest.Builder requestBuilder = cameraDevice.createCaptureRequest(CameraDevice.TEMPLATE_RECORD);
+    @TargetApi(Build.VERSION_CODES.TIRAMISU)
+    private static void setHdr10Profile(OutputConfiguration outputConfig) {
+        outputConfig.setDynamicRangeProfile(DynamicRangeProfiles.HDR10);
+    }
+
+    private CaptureRequest.Builder createCaptureRequest(Surface surface) throws CameraAccessException {
+        // The record template favors a stable image, the preview template favors latency
+        int template = lowLatency ? CameraDevice.TEMPLATE_PREVIEW : CameraDevice.TEMPLATE_RECORD;
+        CaptureRequest.Builder requestBuilder = cameraDevice.createCaptureRequest(template);
         requestBuilder.addTarget(surface);
 
         if (fps > 0) {
             requestBuilder.set(CaptureRequest.CONTROL_AE_TARGET_FPS_RANGE, new Range<>(fps, fps));
         }
 
-        return requestBuilder.build();
+        if (lowLatency) {
+            // Video stabilization and high quality noise reduction need future frames, so they delay the output
+            requestBuilder.set(CaptureRequest.CONTROL_VIDEO_STABILIZATION_MODE, CaptureRequest.CONTROL_VIDEO_STABILIZATION_MODE_OFF);
+            requestBuilder.set(CaptureRequest.NOISE_REDUCTION_MODE, selectFastestNoiseReductionMode(noiseReductionModes));
+        }
+
+        return requestBuilder;
+    }
+
+    private static int selectFastestNoiseReductionMode(int[] availableModes) {
+        if (availableModes != null) {
+            for (int mode : availableModes) {
+                if (mode == CaptureRequest.NOISE_REDUCTION_MODE_OFF) {
+                    return mode;
+                }
+            }
+        }
+        // FAST must not slow down the capture
+        return CaptureRequest.NOISE_REDUCTION_MODE_FAST;
+    }
+
+    private boolean isAeAfConverged(TotalCaptureResult result) {
+        Integer aeState = result.get(CaptureResult.CONTROL_AE_STATE);
+        Integer afState = result.get(CaptureResult.CONTROL_AF_STATE);
+        // null if the camera does not report the state (e.g. fixed focus)
+        boolean aeConverged = aeState == null || aeState == CaptureResult.CONTROL_AE_STATE_CONVERGED
+                || aeState == CaptureResult.CONTROL_AE_STATE_FLASH_REQUIRED;
+        boolean afConverged = afState == null || afState == CaptureResult.CONTROL_AF_STATE_INACTIVE
+                || afState == CaptureResult.CONTROL_AF_STATE_PASSIVE_FOCUSED || afState == CaptureResult.CONTROL_AF_STATE_FOCUSED_LOCKED;
+        return aeConverged && afConverged;
+    }
+
+    /**
+     * Replace the repeating request by one with the current exposure and focus locked.
+     */
+    private void lockAeAf(CameraCaptureSession session, CaptureRequest.Builder requestBuilder, TotalCaptureResult result,
+            CameraCaptureSession.CaptureCallback callback) {
+        aeAfLocked = true;
+
+        requestBuilder.set(CaptureRequest.CONTROL_AE_LOCK, true);
+        Float focusDistance = result.get(CaptureResult.LENS_FOCUS_DISTANCE);
+        if (focusDistance != null) {
+            // Keep the current focus distance, with the auto-focus disabled
+            requestBuilder.set(CaptureRequest.CONTROL_AF_MODE, CaptureRequest.CONTROL_AF_MODE_OFF);
+            requestBuilder.set(CaptureRequest.LENS_FOCUS_DISTANCE, focusDistance);
+        }
+
+        try {
+            session.setRepeatingRequest(requestBuilder.build(), callback, cameraHandler);
+            Ln.i("Camera exposure and focus locked" + (convergenceFrames >= MAX_CONVERGENCE_FRAMES ? " (not converged)" : ""));
+        } catch (CameraAccessException | IllegalStateException e) {
+            Ln.w("Could not lock the camera exposure and focus", e);
+        }
     }
 
     @TargetApi(Build.VERSION_CODES.S)
-    private void setRepeatingRequest(CameraCaptureSession session, CaptureRequest request) throws CameraAccessException, InterruptedException {
+    private void setRepeatingRequest(CameraCaptureSession session, CaptureRequest.Builder requestBuilder)
+            throws CameraAccessException, InterruptedException {
+        aeAfLocked = false;
+        convergenceFrames = 0;
+        CaptureRequest request = requestBuilder.build();
+
         CameraCaptureSession.CaptureCallback callback = new CameraCaptureSession.CaptureCallback() {
             @Override
             public void onCaptureStarted(CameraCaptureSession session, CaptureRequest request, long timestamp, long frameNumber) {
                 // Called for each frame captured, do nothing
             }
 
+            @Override
+            public void onCaptureCompleted(CameraCaptureSession session, CaptureRequest request, TotalCaptureResult result) {
+                if (lockAeAf && !aeAfLocked && (isAeAfConverged(result) || ++convergenceFrames >= MAX_CONVERGENCE_FRAMES)) {
+                    lockAeAf(session, requestBuilder, result, this);
+                }
+            }
+
             @Override
             public void onCaptureFailed(CameraCaptureSession session, CaptureRequest request, CaptureFailure failure) {
                 Ln.w("Camera capture failed: frame " + failure.getFrameNumber());
@@ -344,6 +492,16 @@ public class CameraCapture extends SurfaceCapture {
         }
     }
 
+    @Override
+    public boolean isHdr10() {
+        return hdr10;
+    }
+
+    @Override
+    public boolean hasRealtimeTimestamps() {
+        return realtimeTimestamps;
+    }
+
     @Override
     public boolean isClosed() {
         return disconnected.get();
@@ -8,6 +8,9 @@ import java.io.OutputStream;
  * Handle the cleanup of scrcpy, even if the main process is killed.
  * <p>
  * This is useful to restore some state when scrcpy is closed, even on device disconnection (which kills the scrcpy process).
+ * <p>
+ * The cleanup process (a separate {@code app_process}) is only started once there is something to clean up, so that it does not slow down
+ * the sessions which do not change any state. Until it is started, the server file is kept (the cleanup process removes it on start).
  */
 public final class CleanUp {
 
@@ -19,23 +22,50 @@ public final class CleanUp {
 
     private static final int MSG_PARAM_SHIFT = 2;
 
-    private final OutputStream out;
+    private final int displayId;
+
+    private OutputStream out; // null until the cleanup process is started
+    private boolean finished;
+
+    private CleanUp(int displayId) {
+        this.displayId = displayId;
+    }
 
-    public CleanUp(OutputStream out) {
-        this.out = out;
+    public static CleanUp configure(int displayId) {
+        return new CleanUp(displayId);
     }
 
-    public static CleanUp configure(int displayId) throws IOException {
+    private void start() throws IOException {
         String[] cmd = {"app_process", "/", CleanUp.class.getName(), String.valueOf(displayId)};
 
         ProcessBuilder builder = new ProcessBuilder(cmd);
         builder.environment().put("CLASSPATH", Server.SERVER_PATH);
         Process process = builder.start();
-        return new CleanUp(process.getOutputStream());
+        out = process.getOutputStream();
     }
 
-    private boolean sendMessage(int type, int param) {
+    // If required is false, the message does not request any cleanup action (the cleanup process is not started just for it)
+    private synchronized boolean sendMessage(int type, int param, boolean required) {
         assert (type & ~MSG_TYPE_MASK) == 0;
+        if (out == null) {
+            if (!required) {
+                // Nothing to clean up yet
+                return true;
+            }
+
+            if (finished) {
+                Ln.w("Could not configure cleanup after the server terminated (type=" + type + ", param=" + param + ")");
+                return false;
+            }
+
+            try {
+                start();
+            } catch (IOException e) {
+                Ln.w("Could not start cleanup process", e);
+                return false;
+            }
+        }
+
         int msg = type | param << MSG_PARAM_SHIFT;
         try {
             out.write(msg);
@@ -51,19 +81,31 @@ public final class CleanUp {
         // Restore the value (between 0 and 7), -1 to not restore
         // <https://developer.android.com/reference/android/provider/Settings.Global#STAY_ON_WHILE_PLUGGED_IN>
         assert restoreValue >= -1 && restoreValue <= 7;
-        return sendMessage(MSG_TYPE_RESTORE_STAY_ON, restoreValue & 0b1111);
+        return sendMessage(MSG_TYPE_RESTORE_STAY_ON, restoreValue & 0b1111, restoreValue != -1);
     }
 
     public boolean setDisableShowTouches(boolean disableOnExit) {
-        return sendMessage(MSG_TYPE_DISABLE_SHOW_TOUCHES, disableOnExit ? 1 : 0);
+        return sendMessage(MSG_TYPE_DISABLE_SHOW_TOUCHES, disableOnExit ? 1 : 0, disableOnExit);
     }
 
     public boolean setRestoreNormalPowerMode(boolean restoreOnExit) {
-        return sendMessage(MSG_TYPE_RESTORE_NORMAL_POWER_MODE, restoreOnExit ? 1 : 0);
+        return sendMessage(MSG_TYPE_RESTORE_NORMAL_POWER_MODE, restoreOnExit ? 1 : 0, restoreOnExit);
     }
 
     public boolean setPowerOffScreen(boolean powerOffScreenOnExit) {
-        return sendMessage(MSG_TYPE_POWER_OFF_SCREEN, powerOffScreenOnExit ? 1 : 0);
+        return sendMessage(MSG_TYPE_POWER_OFF_SCREEN, powerOffScreenOnExit ? 1 : 0, powerOffScreenOnExit);
+    }
+
+    /**
+     * Called when the server terminates normally.
+     * <p>
+     * If the cleanup process has never been started, there is nothing to clean up, but the server file must still be removed.
+     */
+    public synchronized void finish() {
+        finished = true;
+        if (out == null) {
+            unlinkSelf();
+        }
     }
 
     public static void unlinkSelf() {
@@ -132,6 +174,8 @@ public final class CleanUp {
             }
         }
 
+        Settings.release();
+
         if (Device.isScreenOn()) {
             if (powerOffScreen) {
                 Ln.i("Power off screen");
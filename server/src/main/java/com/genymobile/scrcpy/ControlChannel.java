@@ -2,9 +2,13 @@ package com.genymobile.scrcpy;
 
 import android.net.LocalSocket;
 
+import java.io.FileDescriptor;
+import java.io.FileInputStream;
+import java.io.FileOutputStream;
 import java.io.IOException;
 import java.io.InputStream;
 import java.io.OutputStream;
+import java.util.List;
 
 public final class ControlChannel {
     private final InputStream inputStream;
@@ -18,6 +22,18 @@ public final class ControlChannel {
         this.outputStream = controlSocket.getOutputStream();
     }
 
+    public ControlChannel(FileDescriptor controlFd) {
+        this.inputStream = new FileInputStream(controlFd);
+        this.outputStream = new FileOutputStream(controlFd);
+    }
+
+    /**
+     * Compress the large device messages (the client decompresses them, and compresses its own large messages).
+     */
+    public void enableCompression() {
+        writer.enableCompression();
+    }
+
     public ControlMessage recv() throws IOException {
         ControlMessage msg = reader.next();
         while (msg == null) {
@@ -30,4 +46,8 @@ public final class ControlChannel {
     public void send(DeviceMessage msg) throws IOException {
         writer.writeTo(msg, outputStream);
     }
+
+    public void send(List<DeviceMessage> msgs) throws IOException {
+        writer.writeTo(msgs, outputStream);
+    }
 }
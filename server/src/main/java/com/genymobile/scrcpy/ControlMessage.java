@@ -20,6 +20,19 @@ public final class ControlMessage {
     public static final int TYPE_UHID_CREATE = 12;
     public static final int TYPE_UHID_INPUT = 13;
     public static final int TYPE_OPEN_HARD_KEYBOARD_SETTINGS = 14;
+    public static final int TYPE_VIDEO_FEEDBACK = 15;
+    public static final int TYPE_REQUEST_KEYFRAME = 16;
+    public static final int TYPE_SET_VIDEO_LIMITS = 17;
+    public static final int TYPE_INJECT_MULTI_TOUCH_EVENT = 18;
+    public static final int TYPE_SET_CLIPBOARD_CHUNK = 19;
+    public static final int TYPE_SET_CROP = 20;
+    public static final int TYPE_PUSH_FILE = 21;
+    public static final int TYPE_PUSH_FILE_CHUNK = 22;
+    public static final int TYPE_UHID_DESTROY = 23;
+    // A large message compressed by the client (unwrapped by ControlMessageReader, never returned)
+    public static final int TYPE_COMPRESSED = 24;
+    public static final int TYPE_CLOCK_PING = 25;
+    public static final int TYPE_UHID_INPUT_BATCH = 26;
 
     public static final long SEQUENCE_INVALID = 0;
 
@@ -37,6 +50,10 @@ public final class ControlMessage {
     private long pointerId;
     private float pressure;
     private Position position;
+    private long[] pointerIds; // for TYPE_INJECT_MULTI_TOUCH_EVENT
+    private Position[] positions;
+    private float[] pressures;
+    private long timestamp; // client event time in milliseconds, 0 if unknown
     private float hScroll;
     private float vScroll;
     private int copyKey;
@@ -45,6 +62,16 @@ public final class ControlMessage {
     private long sequence;
     private int id;
     private byte[] data;
+    private byte[][] reports; // for TYPE_UHID_INPUT_BATCH
+    private int queuingDelay; // µs
+    private int jitter; // µs
+    private int maxSize;
+    private int maxFps;
+    private int cropWidth; // for TYPE_SET_CROP, 0 to restore the initial crop
+    private int cropHeight;
+    private String fileName; // for TYPE_PUSH_FILE, the target is in text
+    private long fileSize;
+    private long clientTime; // for TYPE_CLOCK_PING, in µs
 
     private ControlMessage() {
     }
@@ -67,9 +94,10 @@ public final class ControlMessage {
     }
 
     public static ControlMessage createInjectTouchEvent(int action, long pointerId, Position position, float pressure, int actionButton,
-            int buttons) {
+            int buttons, long timestamp) {
         ControlMessage msg = new ControlMessage();
         msg.type = TYPE_INJECT_TOUCH_EVENT;
+        msg.timestamp = timestamp;
         msg.action = action;
         msg.pointerId = pointerId;
         msg.pressure = pressure;
@@ -79,6 +107,30 @@ public final class ControlMessage {
         return msg;
     }
 
+    /**
+     * Reinitialize a message returned by {@link #createEmpty(int)}, to reuse it for another touch event.
+     */
+    void setInjectTouchEvent(int action, long pointerId, Position position, float pressure, int actionButton, int buttons, long timestamp) {
+        assert type == TYPE_INJECT_TOUCH_EVENT;
+        this.timestamp = timestamp;
+        this.action = action;
+        this.pointerId = pointerId;
+        this.pressure = pressure;
+        this.position = position;
+        this.actionButton = actionButton;
+        this.buttons = buttons;
+    }
+
+    public static ControlMessage createInjectMultiTouchEvent(long[] pointerIds, Position[] positions, float[] pressures, long timestamp) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_INJECT_MULTI_TOUCH_EVENT;
+        msg.timestamp = timestamp;
+        msg.pointerIds = pointerIds;
+        msg.positions = positions;
+        msg.pressures = pressures;
+        return msg;
+    }
+
     public static ControlMessage createInjectScrollEvent(Position position, float hScroll, float vScroll, int buttons) {
         ControlMessage msg = new ControlMessage();
         msg.type = TYPE_INJECT_SCROLL_EVENT;
@@ -89,6 +141,17 @@ public final class ControlMessage {
         return msg;
     }
 
+    /**
+     * Reinitialize a message returned by {@link #createEmpty(int)}, to reuse it for another scroll event.
+     */
+    void setInjectScrollEvent(Position position, float hScroll, float vScroll, int buttons) {
+        assert type == TYPE_INJECT_SCROLL_EVENT;
+        this.position = position;
+        this.hScroll = hScroll;
+        this.vScroll = vScroll;
+        this.buttons = buttons;
+    }
+
     public static ControlMessage createBackOrScreenOn(int action) {
         ControlMessage msg = new ControlMessage();
         msg.type = TYPE_BACK_OR_SCREEN_ON;
@@ -112,6 +175,13 @@ public final class ControlMessage {
         return msg;
     }
 
+    public static ControlMessage createSetClipboardChunk(String text) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_SET_CLIPBOARD_CHUNK;
+        msg.text = text;
+        return msg;
+    }
+
     /**
      * @param mode one of the {@code Device.SCREEN_POWER_MODE_*} constants
      */
@@ -144,6 +214,78 @@ public final class ControlMessage {
         return msg;
     }
 
+    public static ControlMessage createUhidInputBatch(int id, byte[][] reports) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_UHID_INPUT_BATCH;
+        msg.id = id;
+        msg.reports = reports;
+        return msg;
+    }
+
+    public static ControlMessage createUhidDestroy(int id) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_UHID_DESTROY;
+        msg.id = id;
+        return msg;
+    }
+
+    public static ControlMessage createClockPing(long clientTime) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_CLOCK_PING;
+        msg.clientTime = clientTime;
+        return msg;
+    }
+
+    /**
+     * Reinitialize a message returned by {@link #createEmpty(int)}, to reuse it for another UHID input.
+     */
+    void setUhidInput(int id, byte[] data) {
+        assert type == TYPE_UHID_INPUT;
+        this.id = id;
+        this.data = data;
+    }
+
+    public static ControlMessage createVideoFeedback(int queuingDelay, int jitter) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_VIDEO_FEEDBACK;
+        msg.queuingDelay = queuingDelay;
+        msg.jitter = jitter;
+        return msg;
+    }
+
+    public static ControlMessage createSetVideoLimits(int maxSize, int maxFps) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_SET_VIDEO_LIMITS;
+        msg.maxSize = maxSize;
+        msg.maxFps = maxFps;
+        return msg;
+    }
+
+    public static ControlMessage createSetCrop(Position position, int width, int height) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_SET_CROP;
+        msg.position = position;
+        msg.cropWidth = width;
+        msg.cropHeight = height;
+        return msg;
+    }
+
+    public static ControlMessage createPushFile(String target, String name, long size) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_PUSH_FILE;
+        msg.text = target;
+        msg.fileName = name;
+        msg.fileSize = size;
+        return msg;
+    }
+
+    public static ControlMessage createPushFileChunk(byte[] data) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_PUSH_FILE_CHUNK;
+        msg.data = data;
+        return msg;
+    }
+
     public int getType() {
         return type;
     }
@@ -184,6 +326,22 @@ public final class ControlMessage {
         return position;
     }
 
+    public long[] getPointerIds() {
+        return pointerIds;
+    }
+
+    public Position[] getPositions() {
+        return positions;
+    }
+
+    public float[] getPressures() {
+        return pressures;
+    }
+
+    public long getTimestamp() {
+        return timestamp;
+    }
+
     public float getHScroll() {
         return hScroll;
     }
@@ -215,4 +373,44 @@ public final class ControlMessage {
     public byte[] getData() {
         return data;
     }
+
+    public byte[][] getReports() {
+        return reports;
+    }
+
+    public int getQueuingDelay() {
+        return queuingDelay;
+    }
+
+    public int getJitter() {
+        return jitter;
+    }
+
+    public int getMaxSize() {
+        return maxSize;
+    }
+
+    public int getMaxFps() {
+        return maxFps;
+    }
+
+    public int getCropWidth() {
+        return cropWidth;
+    }
+
+    public int getCropHeight() {
+        return cropHeight;
+    }
+
+    public String getFileName() {
+        return fileName;
+    }
+
+    public long getFileSize() {
+        return fileSize;
+    }
+
+    public long getClientTime() {
+        return clientTime;
+    }
 }
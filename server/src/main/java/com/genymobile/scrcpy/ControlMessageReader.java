@@ -5,11 +5,15 @@ import java.io.IOException;
 import java.io.InputStream;
 import java.nio.ByteBuffer;
 import java.nio.charset.StandardCharsets;
+import java.util.zip.DataFormatException;
+import java.util.zip.Inflater;
 
 public class ControlMessageReader {
 
     static final int INJECT_KEYCODE_PAYLOAD_LENGTH = 13;
-    static final int INJECT_TOUCH_EVENT_PAYLOAD_LENGTH = 31;
+    static final int INJECT_TOUCH_EVENT_PAYLOAD_LENGTH = 35;
+    static final int INJECT_MULTI_TOUCH_EVENT_FIXED_PAYLOAD_LENGTH = 5;
+    static final int INJECT_MULTI_TOUCH_EVENT_POINTER_LENGTH = 22;
     static final int INJECT_SCROLL_EVENT_PAYLOAD_LENGTH = 20;
     static final int BACK_OR_SCREEN_ON_LENGTH = 1;
     static final int SET_SCREEN_POWER_MODE_PAYLOAD_LENGTH = 1;
@@ -17,15 +21,36 @@ public class ControlMessageReader {
     static final int SET_CLIPBOARD_FIXED_PAYLOAD_LENGTH = 9;
     static final int UHID_CREATE_FIXED_PAYLOAD_LENGTH = 4;
     static final int UHID_INPUT_FIXED_PAYLOAD_LENGTH = 4;
+    static final int UHID_INPUT_BATCH_FIXED_PAYLOAD_LENGTH = 3;
+    static final int UHID_DESTROY_PAYLOAD_LENGTH = 2;
+    static final int VIDEO_FEEDBACK_PAYLOAD_LENGTH = 8;
+    static final int SET_VIDEO_LIMITS_PAYLOAD_LENGTH = 4;
+    static final int SET_CROP_PAYLOAD_LENGTH = 16;
+    static final int PUSH_FILE_FIXED_PAYLOAD_LENGTH = 8;
+    static final int PUSH_FILE_CHUNK_FIXED_PAYLOAD_LENGTH = 2;
+    static final int COMPRESSED_FIXED_PAYLOAD_LENGTH = 8;
+    static final int CLOCK_PING_PAYLOAD_LENGTH = 8;
 
     private static final int MESSAGE_MAX_SIZE = 1 << 18; // 256k
 
     public static final int CLIPBOARD_TEXT_MAX_LENGTH = MESSAGE_MAX_SIZE - 14; // type: 1 byte; sequence: 8 bytes; paste flag: 1 byte; length: 4 bytes
-    public static final int INJECT_TEXT_MAX_LENGTH = 300;
+    public static final int INJECT_TEXT_MAX_LENGTH = 4096;
 
     private final byte[] rawBuffer = new byte[MESSAGE_MAX_SIZE];
     private final ByteBuffer buffer = ByteBuffer.wrap(rawBuffer);
 
+    // The hot messages (sent continuously during a drag or while typing on a UHID keyboard) are parsed into reusable instances, so that
+    // nothing is allocated per message in steady state
+    private final ControlMessage touchEvent = ControlMessage.createEmpty(ControlMessage.TYPE_INJECT_TOUCH_EVENT);
+    private final ControlMessage scrollEvent = ControlMessage.createEmpty(ControlMessage.TYPE_INJECT_SCROLL_EVENT);
+    private final ControlMessage uhidInput = ControlMessage.createEmpty(ControlMessage.TYPE_UHID_INPUT);
+    private byte[] uhidInputData;
+    private Position lastPosition;
+
+    // Created on the first compressed message
+    private Inflater inflater;
+    private ControlMessageReader inflatedReader;
+
     public ControlMessageReader() {
         // invariant: the buffer is always in "get" mode
         buffer.limit(0);
@@ -49,7 +74,16 @@ public class ControlMessageReader {
         buffer.flip();
     }
 
-    public ControlMessage next() {
+    /**
+     * Parse the next message from the buffer.
+     * <p>
+     * The touch, scroll and UHID input messages are reused: the returned instance (including its data array for UHID input) is only valid
+     * until the next call. The caller must read the values it needs before calling {@code next()} again.
+     *
+     * @return the next message, or {@code null} if the buffer does not contain a complete message
+     * @throws IOException if a compressed message is invalid
+     */
+    public ControlMessage next() throws IOException {
         if (!buffer.hasRemaining()) {
             return null;
         }
@@ -67,6 +101,9 @@ public class ControlMessageReader {
             case ControlMessage.TYPE_INJECT_TOUCH_EVENT:
                 msg = parseInjectTouchEvent();
                 break;
+            case ControlMessage.TYPE_INJECT_MULTI_TOUCH_EVENT:
+                msg = parseInjectMultiTouchEvent();
+                break;
             case ControlMessage.TYPE_INJECT_SCROLL_EVENT:
                 msg = parseInjectScrollEvent();
                 break;
@@ -79,6 +116,9 @@ public class ControlMessageReader {
             case ControlMessage.TYPE_SET_CLIPBOARD:
                 msg = parseSetClipboard();
                 break;
+            case ControlMessage.TYPE_SET_CLIPBOARD_CHUNK:
+                msg = parseSetClipboardChunk();
+                break;
             case ControlMessage.TYPE_SET_SCREEN_POWER_MODE:
                 msg = parseSetScreenPowerMode();
                 break;
@@ -87,6 +127,7 @@ public class ControlMessageReader {
             case ControlMessage.TYPE_COLLAPSE_PANELS:
             case ControlMessage.TYPE_ROTATE_DEVICE:
             case ControlMessage.TYPE_OPEN_HARD_KEYBOARD_SETTINGS:
+            case ControlMessage.TYPE_REQUEST_KEYFRAME:
                 msg = ControlMessage.createEmpty(type);
                 break;
             case ControlMessage.TYPE_UHID_CREATE:
@@ -95,6 +136,33 @@ public class ControlMessageReader {
             case ControlMessage.TYPE_UHID_INPUT:
                 msg = parseUhidInput();
                 break;
+            case ControlMessage.TYPE_UHID_INPUT_BATCH:
+                msg = parseUhidInputBatch();
+                break;
+            case ControlMessage.TYPE_UHID_DESTROY:
+                msg = parseUhidDestroy();
+                break;
+            case ControlMessage.TYPE_VIDEO_FEEDBACK:
+                msg = parseVideoFeedback();
+                break;
+            case ControlMessage.TYPE_SET_VIDEO_LIMITS:
+                msg = parseSetVideoLimits();
+                break;
+            case ControlMessage.TYPE_SET_CROP:
+                msg = parseSetCrop();
+                break;
+            case ControlMessage.TYPE_PUSH_FILE:
+                msg = parsePushFile();
+                break;
+            case ControlMessage.TYPE_PUSH_FILE_CHUNK:
+                msg = parsePushFileChunk();
+                break;
+            case ControlMessage.TYPE_COMPRESSED:
+                msg = parseCompressed();
+                break;
+            case ControlMessage.TYPE_CLOCK_PING:
+                msg = parseClockPing();
+                break;
             default:
                 Ln.w("Unknown event type: " + type);
                 msg = null;
@@ -170,7 +238,29 @@ public class ControlMessageReader {
         float pressure = Binary.u16FixedPointToFloat(buffer.getShort());
         int actionButton = buffer.getInt();
         int buttons = buffer.getInt();
-        return ControlMessage.createInjectTouchEvent(action, pointerId, position, pressure, actionButton, buttons);
+        long timestamp = Binary.toUnsigned(buffer.getInt());
+        touchEvent.setInjectTouchEvent(action, pointerId, position, pressure, actionButton, buttons, timestamp);
+        return touchEvent;
+    }
+
+    private ControlMessage parseInjectMultiTouchEvent() {
+        if (buffer.remaining() < INJECT_MULTI_TOUCH_EVENT_FIXED_PAYLOAD_LENGTH) {
+            return null;
+        }
+        int count = Binary.toUnsigned(buffer.get());
+        long timestamp = Binary.toUnsigned(buffer.getInt());
+        if (buffer.remaining() < count * INJECT_MULTI_TOUCH_EVENT_POINTER_LENGTH) {
+            return null;
+        }
+        long[] pointerIds = new long[count];
+        Position[] positions = new Position[count];
+        float[] pressures = new float[count];
+        for (int i = 0; i < count; ++i) {
+            pointerIds[i] = buffer.getLong();
+            positions[i] = readPosition(buffer);
+            pressures[i] = Binary.u16FixedPointToFloat(buffer.getShort());
+        }
+        return ControlMessage.createInjectMultiTouchEvent(pointerIds, positions, pressures, timestamp);
     }
 
     private ControlMessage parseInjectScrollEvent() {
@@ -181,7 +271,8 @@ public class ControlMessageReader {
         float hScroll = Binary.i16FixedPointToFloat(buffer.getShort());
         float vScroll = Binary.i16FixedPointToFloat(buffer.getShort());
         int buttons = buffer.getInt();
-        return ControlMessage.createInjectScrollEvent(position, hScroll, vScroll, buttons);
+        scrollEvent.setInjectScrollEvent(position, hScroll, vScroll, buttons);
+        return scrollEvent;
     }
 
     private ControlMessage parseBackOrScreenOnEvent() {
@@ -213,6 +304,14 @@ public class ControlMessageReader {
         return ControlMessage.createSetClipboard(sequence, text, paste);
     }
 
+    private ControlMessage parseSetClipboardChunk() {
+        String text = parseString();
+        if (text == null) {
+            return null;
+        }
+        return ControlMessage.createSetClipboardChunk(text);
+    }
+
     private ControlMessage parseSetScreenPowerMode() {
         if (buffer.remaining() < SET_SCREEN_POWER_MODE_PAYLOAD_LENGTH) {
             return null;
@@ -238,18 +337,174 @@ public class ControlMessageReader {
             return null;
         }
         int id = buffer.getShort();
+        int len = parseBufferLength(2);
+        if (len == -1 || buffer.remaining() < len) {
+            return null;
+        }
+        // The input reports of a device usually have a fixed size, so the array is reused in steady state
+        if (uhidInputData == null || uhidInputData.length != len) {
+            uhidInputData = new byte[len];
+        }
+        buffer.get(uhidInputData);
+        uhidInput.setUhidInput(id, uhidInputData);
+        return uhidInput;
+    }
+
+    private ControlMessage parseUhidInputBatch() {
+        if (buffer.remaining() < UHID_INPUT_BATCH_FIXED_PAYLOAD_LENGTH) {
+            return null;
+        }
+        int id = buffer.getShort();
+        int count = buffer.get() & 0xFF;
+        byte[][] reports = new byte[count][];
+        for (int i = 0; i < count; ++i) {
+            reports[i] = parseByteArray(2);
+            if (reports[i] == null) {
+                return null;
+            }
+        }
+        return ControlMessage.createUhidInputBatch(id, reports);
+    }
+
+    private ControlMessage parseUhidDestroy() {
+        if (buffer.remaining() < UHID_DESTROY_PAYLOAD_LENGTH) {
+            return null;
+        }
+        int id = buffer.getShort();
+        return ControlMessage.createUhidDestroy(id);
+    }
+
+    private ControlMessage parseVideoFeedback() {
+        if (buffer.remaining() < VIDEO_FEEDBACK_PAYLOAD_LENGTH) {
+            return null;
+        }
+        // The values are unsigned 32-bit, clamp them to keep them positive
+        int queuingDelay = (int) Math.min(Binary.toUnsigned(buffer.getInt()), Integer.MAX_VALUE);
+        int jitter = (int) Math.min(Binary.toUnsigned(buffer.getInt()), Integer.MAX_VALUE);
+        return ControlMessage.createVideoFeedback(queuingDelay, jitter);
+    }
+
+    private ControlMessage parseSetVideoLimits() {
+        if (buffer.remaining() < SET_VIDEO_LIMITS_PAYLOAD_LENGTH) {
+            return null;
+        }
+        int maxSize = Binary.toUnsigned(buffer.getShort());
+        int maxFps = Binary.toUnsigned(buffer.getShort());
+        return ControlMessage.createSetVideoLimits(maxSize, maxFps);
+    }
+
+    private ControlMessage parseSetCrop() {
+        if (buffer.remaining() < SET_CROP_PAYLOAD_LENGTH) {
+            return null;
+        }
+        Position position = readPosition(buffer);
+        int width = Binary.toUnsigned(buffer.getShort());
+        int height = Binary.toUnsigned(buffer.getShort());
+        return ControlMessage.createSetCrop(position, width, height);
+    }
+
+    private ControlMessage parsePushFile() {
+        if (buffer.remaining() < PUSH_FILE_FIXED_PAYLOAD_LENGTH) {
+            return null;
+        }
+        long size = buffer.getLong();
+        String target = parseString();
+        if (target == null) {
+            return null;
+        }
+        String name = parseString();
+        if (name == null) {
+            return null;
+        }
+        return ControlMessage.createPushFile(target, name, size);
+    }
+
+    private ControlMessage parsePushFileChunk() {
+        if (buffer.remaining() < PUSH_FILE_CHUNK_FIXED_PAYLOAD_LENGTH) {
+            return null;
+        }
         byte[] data = parseByteArray(2);
         if (data == null) {
             return null;
         }
-        return ControlMessage.createUhidInput(id, data);
+        return ControlMessage.createPushFileChunk(data);
     }
 
-    private static Position readPosition(ByteBuffer buffer) {
+    private ControlMessage parseClockPing() {
+        if (buffer.remaining() < CLOCK_PING_PAYLOAD_LENGTH) {
+            return null;
+        }
+        long clientTime = buffer.getLong();
+        return ControlMessage.createClockPing(clientTime);
+    }
+
+    private ControlMessage parseCompressed() throws IOException {
+        if (buffer.remaining() < COMPRESSED_FIXED_PAYLOAD_LENGTH) {
+            return null;
+        }
+        int rawLength = buffer.getInt();
+        int length = buffer.getInt();
+        if (rawLength <= 0 || rawLength > MESSAGE_MAX_SIZE || length < 0) {
+            throw new IOException("Invalid compressed control message");
+        }
+        if (buffer.remaining() < length) {
+            return null;
+        }
+
+        if (inflater == null) {
+            inflater = new Inflater();
+            inflatedReader = new ControlMessageReader();
+        }
+
+        int position = buffer.position();
+        buffer.position(position + length);
+
+        byte[] raw = inflatedReader.rawBuffer;
+        inflater.reset();
+        inflater.setInput(rawBuffer, position, length);
+        try {
+            int r = inflater.inflate(raw, 0, rawLength);
+            if (r != rawLength || !inflater.finished()) {
+                throw new IOException("Invalid compressed control message length");
+            }
+        } catch (DataFormatException e) {
+            throw new IOException("Could not decompress control message", e);
+        }
+
+        // It must contain exactly one (uncompressed) message
+        if (raw[0] == ControlMessage.TYPE_COMPRESSED) {
+            throw new IOException("Nested compressed control message");
+        }
+        inflatedReader.buffer.position(0);
+        inflatedReader.buffer.limit(rawLength);
+        ControlMessage msg = inflatedReader.next();
+        if (msg == null || inflatedReader.buffer.hasRemaining()) {
+            throw new IOException("Invalid compressed control message content");
+        }
+        return msg;
+    }
+
+    private Position readPosition(ByteBuffer buffer) {
         int x = buffer.getInt();
         int y = buffer.getInt();
         int screenWidth = Binary.toUnsigned(buffer.getShort());
         int screenHeight = Binary.toUnsigned(buffer.getShort());
-        return new Position(x, y, screenWidth, screenHeight);
+
+        // Position is immutable (it is passed to the injection thread), but consecutive events often share the same values, or at least
+        // the same screen size
+        Position last = lastPosition;
+        if (last != null) {
+            Point lastPoint = last.getPoint();
+            Size lastScreenSize = last.getScreenSize();
+            if (lastScreenSize.getWidth() == screenWidth && lastScreenSize.getHeight() == screenHeight) {
+                if (lastPoint.getX() != x || lastPoint.getY() != y) {
+                    lastPosition = new Position(new Point(x, y), lastScreenSize);
+                }
+                return lastPosition;
+            }
+        }
+
+        lastPosition = new Position(x, y, screenWidth, screenHeight);
+        return lastPosition;
     }
 }
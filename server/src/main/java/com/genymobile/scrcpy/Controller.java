@@ -4,14 +4,19 @@ import com.genymobile.scrcpy.wrappers.InputManager;
 import com.genymobile.scrcpy.wrappers.ServiceManager;
 
 import android.content.Intent;
+import android.graphics.Rect;
 import android.os.Build;
 import android.os.SystemClock;
+import android.os.Trace;
 import android.view.InputDevice;
 import android.view.KeyCharacterMap;
 import android.view.KeyEvent;
 import android.view.MotionEvent;
 
 import java.io.IOException;
+import java.util.HashMap;
+import java.util.Map;
+import java.util.concurrent.ExecutorService;
 import java.util.concurrent.Executors;
 import java.util.concurrent.ScheduledExecutorService;
 import java.util.concurrent.TimeUnit;
@@ -26,6 +31,16 @@ public class Controller implements AsyncProcessor {
 
     private static final ScheduledExecutorService EXECUTOR = Executors.newSingleThreadScheduledExecutor();
 
+    private static final int CHAR_EVENTS_CACHE_MAX_SIZE = 1024;
+
+    private static final long INJECTION_LATENCY_REPORT_INTERVAL_NS = TimeUnit.SECONDS.toNanos(1);
+
+    // Input events are injected on a separate thread, in order, so that a slow injection does not delay the other messages (e.g. clipboard)
+    private final ExecutorService injectionExecutor = Executors.newSingleThreadExecutor(r -> new Thread(r, "control-inject"));
+    // Only accessed from the injection thread
+    private final LatencyStats injectionLatency = new LatencyStats("inject");
+    private long lastInjectionLatencyReport;
+
     private Thread thread;
 
     private UhidManager uhidManager;
@@ -38,13 +53,29 @@ public class Controller implements AsyncProcessor {
     private final boolean powerOn;
 
     private final KeyCharacterMap charMap = KeyCharacterMap.load(KeyCharacterMap.VIRTUAL_KEYBOARD);
+    // Key events generated by charMap for each char (an empty array if the char could not be mapped), only accessed from the injection thread
+    private final Map<Character, KeyEvent[]> charEventsCache = new HashMap<>();
 
     private long lastTouchDown;
+    // Only accessed from the control-recv thread
+    private final EventTimeMapper eventTimeMapper = new EventTimeMapper();
+
+    // Beginning of a clipboard text sent in several chunks, completed by the next TYPE_SET_CLIPBOARD message
+    private final StringBuilder clipboardChunks = new StringBuilder();
+    // Only accessed from the control-recv thread
+    private final FileReceiver fileReceiver = new FileReceiver();
     private final PointersState pointersState = new PointersState();
     private final MotionEvent.PointerProperties[] pointerProperties = new MotionEvent.PointerProperties[PointersState.MAX_POINTERS];
     private final MotionEvent.PointerCoords[] pointerCoords = new MotionEvent.PointerCoords[PointersState.MAX_POINTERS];
+    // Number of motion events obtained from the pool and recycled, to detect leaks (only accessed from the injection thread)
+    private int obtainedMotionEvents;
+    private int recycledMotionEvents;
+
+    // Written by the control-recv thread, read by the injection thread
+    private volatile boolean keepPowerModeOff;
 
-    private boolean keepPowerModeOff;
+    // May be null (if there is no video)
+    private SurfaceEncoder surfaceEncoder;
 
     public Controller(Device device, ControlChannel controlChannel, CleanUp cleanUp, boolean clipboardAutosync, boolean powerOn) {
         this.device = device;
@@ -102,10 +133,14 @@ public class Controller implements AsyncProcessor {
     public void start(TerminationListener listener) {
         thread = new Thread(() -> {
             try {
+                // Resolve the injection methods now, rather than on the first event
+                ServiceManager.getInputManager();
                 control();
             } catch (IOException e) {
                 Ln.e("Controller error", e);
             } finally {
+                injectionExecutor.shutdownNow();
+                fileReceiver.abort();
                 Ln.d("Controller stopped");
                 if (uhidManager != null) {
                     uhidManager.closeAll();
@@ -133,6 +168,15 @@ public class Controller implements AsyncProcessor {
         sender.join();
     }
 
+    /**
+     * Set the video encoder controlled by the client messages.
+     * <p>
+     * It must be called before {@link #start(TerminationListener)}.
+     */
+    public void setSurfaceEncoder(SurfaceEncoder surfaceEncoder) {
+        this.surfaceEncoder = surfaceEncoder;
+    }
+
     public DeviceMessageSender getSender() {
         return sender;
     }
@@ -149,27 +193,46 @@ public class Controller implements AsyncProcessor {
         switch (msg.getType()) {
             case ControlMessage.TYPE_INJECT_KEYCODE:
                 if (device.supportsInputEvents()) {
-                    injectKeycode(msg.getAction(), msg.getKeycode(), msg.getRepeat(), msg.getMetaState());
+                    submitInjection(() -> injectKeycode(msg.getAction(), msg.getKeycode(), msg.getRepeat(), msg.getMetaState()));
                 }
                 break;
             case ControlMessage.TYPE_INJECT_TEXT:
                 if (device.supportsInputEvents()) {
-                    injectText(msg.getText());
+                    submitInjection(() -> injectText(msg.getText()));
                 }
                 break;
             case ControlMessage.TYPE_INJECT_TOUCH_EVENT:
                 if (device.supportsInputEvents()) {
-                    injectTouch(msg.getAction(), msg.getPointerId(), msg.getPosition(), msg.getPressure(), msg.getActionButton(), msg.getButtons());
+                    long eventTime = eventTimeMapper.map(msg.getTimestamp(), SystemClock.uptimeMillis());
+                    // The message is reused by the reader, read its values before submitting the injection
+                    int action = msg.getAction();
+                    long pointerId = msg.getPointerId();
+                    Position position = msg.getPosition();
+                    float pressure = msg.getPressure();
+                    int actionButton = msg.getActionButton();
+                    int buttons = msg.getButtons();
+                    submitInjection(() -> injectTouch(action, pointerId, position, pressure, actionButton, buttons, eventTime));
+                }
+                break;
+            case ControlMessage.TYPE_INJECT_MULTI_TOUCH_EVENT:
+                if (device.supportsInputEvents()) {
+                    long eventTime = eventTimeMapper.map(msg.getTimestamp(), SystemClock.uptimeMillis());
+                    submitInjection(() -> injectMultiTouch(msg.getPointerIds(), msg.getPositions(), msg.getPressures(), eventTime));
                 }
                 break;
             case ControlMessage.TYPE_INJECT_SCROLL_EVENT:
                 if (device.supportsInputEvents()) {
-                    injectScroll(msg.getPosition(), msg.getHScroll(), msg.getVScroll(), msg.getButtons());
+                    // The message is reused by the reader, read its values before submitting the injection
+                    Position position = msg.getPosition();
+                    float hScroll = msg.getHScroll();
+                    float vScroll = msg.getVScroll();
+                    int buttons = msg.getButtons();
+                    submitInjection(() -> injectScroll(position, hScroll, vScroll, buttons));
                 }
                 break;
             case ControlMessage.TYPE_BACK_OR_SCREEN_ON:
                 if (device.supportsInputEvents()) {
-                    pressBackOrTurnScreenOn(msg.getAction());
+                    submitInjection(() -> pressBackOrTurnScreenOn(msg.getAction()));
                 }
                 break;
             case ControlMessage.TYPE_EXPAND_NOTIFICATION_PANEL:
@@ -182,10 +245,23 @@ public class Controller implements AsyncProcessor {
                 Device.collapsePanels();
                 break;
             case ControlMessage.TYPE_GET_CLIPBOARD:
-                getClipboard(msg.getCopyKey());
+                if (msg.getCopyKey() != ControlMessage.COPY_KEY_NONE) {
+                    // The COPY or CUT key must be injected after the pending input events
+                    submitInjection(() -> getClipboard(msg.getCopyKey()));
+                } else {
+                    getClipboard(msg.getCopyKey());
+                }
+                break;
+            case ControlMessage.TYPE_SET_CLIPBOARD_CHUNK:
+                clipboardChunks.append(msg.getText());
                 break;
             case ControlMessage.TYPE_SET_CLIPBOARD:
-                setClipboard(msg.getText(), msg.getPaste(), msg.getSequence());
+                String text = msg.getText();
+                if (clipboardChunks.length() > 0) {
+                    text = clipboardChunks.append(text).toString();
+                    clipboardChunks.setLength(0);
+                }
+                setClipboard(text, msg.getPaste(), msg.getSequence());
                 break;
             case ControlMessage.TYPE_SET_SCREEN_POWER_MODE:
                 if (device.supportsInputEvents()) {
@@ -210,9 +286,44 @@ public class Controller implements AsyncProcessor {
             case ControlMessage.TYPE_UHID_INPUT:
                 getUhidManager().writeInput(msg.getId(), msg.getData());
                 break;
+            case ControlMessage.TYPE_UHID_INPUT_BATCH:
+                getUhidManager().writeInputs(msg.getId(), msg.getReports());
+                break;
+            case ControlMessage.TYPE_UHID_DESTROY:
+                getUhidManager().close(msg.getId());
+                break;
             case ControlMessage.TYPE_OPEN_HARD_KEYBOARD_SETTINGS:
                 openHardKeyboardSettings();
                 break;
+            case ControlMessage.TYPE_VIDEO_FEEDBACK:
+                if (surfaceEncoder != null) {
+                    surfaceEncoder.onVideoFeedback(msg.getQueuingDelay());
+                }
+                break;
+            case ControlMessage.TYPE_REQUEST_KEYFRAME:
+                if (surfaceEncoder != null) {
+                    surfaceEncoder.requestKeyFrame();
+                }
+                break;
+            case ControlMessage.TYPE_CLOCK_PING:
+                replyClockPing(msg.getClientTime());
+                break;
+            case ControlMessage.TYPE_SET_VIDEO_LIMITS:
+                if (surfaceEncoder != null) {
+                    surfaceEncoder.setVideoLimits(msg.getMaxSize(), msg.getMaxFps());
+                }
+                break;
+            case ControlMessage.TYPE_SET_CROP:
+                if (surfaceEncoder != null) {
+                    setCrop(msg.getPosition(), msg.getCropWidth(), msg.getCropHeight());
+                }
+                break;
+            case ControlMessage.TYPE_PUSH_FILE:
+                fileReceiver.start(msg.getText(), msg.getFileName(), msg.getFileSize());
+                break;
+            case ControlMessage.TYPE_PUSH_FILE_CHUNK:
+                fileReceiver.write(msg.getData());
+                break;
             default:
                 // do nothing
         }
@@ -220,6 +331,46 @@ public class Controller implements AsyncProcessor {
         return true;
     }
 
+    private void setCrop(Position position, int width, int height) {
+        Rect region = null; // restore the initial crop
+        if (width != 0 && height != 0) {
+            region = device.getPhysicalRect(position, width, height);
+            if (region == null) {
+                Ln.w("Ignore crop request for an outdated video size");
+                return;
+            }
+        }
+        if (!surfaceEncoder.setCrop(region)) {
+            Ln.w("Could not change the crop");
+        }
+    }
+
+    private void submitInjection(Runnable injection) {
+        long receivedNs = System.nanoTime();
+        injectionExecutor.execute(() -> {
+            Trace.beginSection("scrcpy:inject");
+            try {
+                injection.run();
+            } finally {
+                Trace.endSection();
+            }
+
+            // All the motion events obtained for an injection must have been recycled
+            if (obtainedMotionEvents != recycledMotionEvents) {
+                Ln.w("Motion events not recycled: " + (obtainedMotionEvents - recycledMotionEvents));
+                recycledMotionEvents = obtainedMotionEvents;
+            }
+
+            long now = System.nanoTime();
+            injectionLatency.add((now - receivedNs) / 1000);
+            if (now - lastInjectionLatencyReport >= INJECTION_LATENCY_REPORT_INTERVAL_NS) {
+                lastInjectionLatencyReport = now;
+                long[] p = injectionLatency.getPercentiles(50, 99);
+                sender.send(DeviceMessage.createInjectionLatency((int) Math.min(p[0], Integer.MAX_VALUE), (int) Math.min(p[1], Integer.MAX_VALUE)));
+            }
+        });
+    }
+
     private boolean injectKeycode(int action, int keycode, int repeat, int metaState) {
         if (keepPowerModeOff && action == KeyEvent.ACTION_UP && (keycode == KeyEvent.KEYCODE_POWER || keycode == KeyEvent.KEYCODE_WAKEUP)) {
             schedulePowerModeOff();
@@ -227,14 +378,33 @@ public class Controller implements AsyncProcessor {
         return device.injectKeyEvent(action, keycode, repeat, metaState, Device.INJECT_MODE_ASYNC);
     }
 
-    private boolean injectChar(char c) {
-        String decomposed = KeyComposition.decompose(c);
-        char[] chars = decomposed != null ? decomposed.toCharArray() : new char[]{c};
-        KeyEvent[] events = charMap.getEvents(chars);
+    private KeyEvent[] getCharEvents(char c) {
+        KeyEvent[] events = charEventsCache.get(c);
         if (events == null) {
+            String decomposed = KeyComposition.decompose(c);
+            char[] chars = decomposed != null ? decomposed.toCharArray() : new char[]{c};
+            events = charMap.getEvents(chars);
+            if (events == null) {
+                events = new KeyEvent[0];
+            }
+            if (charEventsCache.size() >= CHAR_EVENTS_CACHE_MAX_SIZE) {
+                charEventsCache.clear();
+            }
+            charEventsCache.put(c, events);
+        }
+        return events;
+    }
+
+    private boolean injectChar(char c) {
+        KeyEvent[] events = getCharEvents(c);
+        if (events.length == 0) {
             return false;
         }
-        for (KeyEvent event : events) {
+        // The cached events must not be injected as is, their timestamps would be stale
+        long now = SystemClock.uptimeMillis();
+        for (KeyEvent e : events) {
+            KeyEvent event = new KeyEvent(now, now, e.getAction(), e.getKeyCode(), e.getRepeatCount(), e.getMetaState(), e.getDeviceId(),
+                    e.getScanCode(), e.getFlags(), e.getSource());
             if (!device.injectEvent(event, Device.INJECT_MODE_ASYNC)) {
                 return false;
             }
@@ -254,8 +424,7 @@ public class Controller implements AsyncProcessor {
         return successCount;
     }
 
-    private boolean injectTouch(int action, long pointerId, Position position, float pressure, int actionButton, int buttons) {
-        long now = SystemClock.uptimeMillis();
+    private boolean injectTouch(int action, long pointerId, Position position, float pressure, int actionButton, int buttons, long now) {
 
         Point point = device.getPhysicalPoint(position);
         if (point == null) {
@@ -313,20 +482,19 @@ public class Controller implements AsyncProcessor {
             if (action == MotionEvent.ACTION_DOWN) {
                 if (actionButton == buttons) {
                     // First button pressed: ACTION_DOWN
-                    MotionEvent downEvent = MotionEvent.obtain(lastTouchDown, now, MotionEvent.ACTION_DOWN, pointerCount, pointerProperties,
-                            pointerCoords, 0, buttons, 1f, 1f, DEFAULT_DEVICE_ID, 0, source, 0);
-                    if (!device.injectEvent(downEvent, Device.INJECT_MODE_ASYNC)) {
+                    MotionEvent downEvent = obtainMotionEvent(now, MotionEvent.ACTION_DOWN, pointerCount, buttons, source);
+                    if (!injectMotionEvent(downEvent)) {
                         return false;
                     }
                 }
 
                 // Any button pressed: ACTION_BUTTON_PRESS
-                MotionEvent pressEvent = MotionEvent.obtain(lastTouchDown, now, MotionEvent.ACTION_BUTTON_PRESS, pointerCount, pointerProperties,
-                        pointerCoords, 0, buttons, 1f, 1f, DEFAULT_DEVICE_ID, 0, source, 0);
+                MotionEvent pressEvent = obtainMotionEvent(now, MotionEvent.ACTION_BUTTON_PRESS, pointerCount, buttons, source);
                 if (!InputManager.setActionButton(pressEvent, actionButton)) {
+                    recycleMotionEvent(pressEvent);
                     return false;
                 }
-                if (!device.injectEvent(pressEvent, Device.INJECT_MODE_ASYNC)) {
+                if (!injectMotionEvent(pressEvent)) {
                     return false;
                 }
 
@@ -335,20 +503,19 @@ public class Controller implements AsyncProcessor {
 
             if (action == MotionEvent.ACTION_UP) {
                 // Any button released: ACTION_BUTTON_RELEASE
-                MotionEvent releaseEvent = MotionEvent.obtain(lastTouchDown, now, MotionEvent.ACTION_BUTTON_RELEASE, pointerCount, pointerProperties,
-                        pointerCoords, 0, buttons, 1f, 1f, DEFAULT_DEVICE_ID, 0, source, 0);
+                MotionEvent releaseEvent = obtainMotionEvent(now, MotionEvent.ACTION_BUTTON_RELEASE, pointerCount, buttons, source);
                 if (!InputManager.setActionButton(releaseEvent, actionButton)) {
+                    recycleMotionEvent(releaseEvent);
                     return false;
                 }
-                if (!device.injectEvent(releaseEvent, Device.INJECT_MODE_ASYNC)) {
+                if (!injectMotionEvent(releaseEvent)) {
                     return false;
                 }
 
                 if (buttons == 0) {
                     // Last button released: ACTION_UP
-                    MotionEvent upEvent = MotionEvent.obtain(lastTouchDown, now, MotionEvent.ACTION_UP, pointerCount, pointerProperties,
-                            pointerCoords, 0, buttons, 1f, 1f, DEFAULT_DEVICE_ID, 0, source, 0);
-                    if (!device.injectEvent(upEvent, Device.INJECT_MODE_ASYNC)) {
+                    MotionEvent upEvent = obtainMotionEvent(now, MotionEvent.ACTION_UP, pointerCount, buttons, source);
+                    if (!injectMotionEvent(upEvent)) {
                         return false;
                     }
                 }
@@ -357,9 +524,68 @@ public class Controller implements AsyncProcessor {
             }
         }
 
-        MotionEvent event = MotionEvent.obtain(lastTouchDown, now, action, pointerCount, pointerProperties, pointerCoords, 0, buttons, 1f, 1f,
-                DEFAULT_DEVICE_ID, 0, source, 0);
-        return device.injectEvent(event, Device.INJECT_MODE_ASYNC);
+        MotionEvent event = obtainMotionEvent(now, action, pointerCount, buttons, source);
+        return injectMotionEvent(event);
+    }
+
+    /**
+     * Obtain a motion event from the pool, for the pointers currently stored in {@link #pointerProperties} and {@link #pointerCoords}.
+     * <p>
+     * The event must be released by {@link #injectMotionEvent(MotionEvent)} or {@link #recycleMotionEvent(MotionEvent)}.
+     */
+    private MotionEvent obtainMotionEvent(long now, int action, int pointerCount, int buttons, int source) {
+        ++obtainedMotionEvents;
+        return MotionEvent.obtain(lastTouchDown, now, action, pointerCount, pointerProperties, pointerCoords, 0, buttons, 1f, 1f, DEFAULT_DEVICE_ID,
+                0, source, 0);
+    }
+
+    private void recycleMotionEvent(MotionEvent event) {
+        event.recycle();
+        ++recycledMotionEvents;
+    }
+
+    /**
+     * Inject a motion event, then return it to the pool.
+     * <p>
+     * The event is copied (parceled) by the injection call, even asynchronous, so it can be reused immediately.
+     */
+    private boolean injectMotionEvent(MotionEvent event) {
+        boolean ok = device.injectEvent(event, Device.INJECT_MODE_ASYNC);
+        recycleMotionEvent(event);
+        return ok;
+    }
+
+    /**
+     * Move several touch pointers at once, in a single ACTION_MOVE event.
+     */
+    private boolean injectMultiTouch(long[] pointerIds, Position[] positions, float[] pressures, long now) {
+
+        // Check all the pointers before updating any of them
+        Point[] points = new Point[positions.length];
+        for (int i = 0; i < positions.length; ++i) {
+            points[i] = device.getPhysicalPoint(positions[i]);
+            if (points[i] == null) {
+                Ln.w("Ignore multi-touch event, it was generated for a different device size");
+                return false;
+            }
+        }
+
+        for (int i = 0; i < pointerIds.length; ++i) {
+            int pointerIndex = pointersState.getPointerIndex(pointerIds[i]);
+            if (pointerIndex == -1) {
+                Ln.w("Too many pointers for multi-touch event");
+                return false;
+            }
+            Pointer pointer = pointersState.get(pointerIndex);
+            pointer.setPoint(points[i]);
+            pointer.setPressure(pressures[i]);
+            pointer.setUp(false);
+            pointerProperties[pointerIndex].toolType = MotionEvent.TOOL_TYPE_FINGER;
+        }
+
+        int pointerCount = pointersState.update(pointerProperties, pointerCoords);
+        MotionEvent event = obtainMotionEvent(now, MotionEvent.ACTION_MOVE, pointerCount, 0, InputDevice.SOURCE_TOUCHSCREEN);
+        return injectMotionEvent(event);
     }
 
     private boolean injectScroll(Position position, float hScroll, float vScroll, int buttons) {
@@ -379,9 +605,8 @@ public class Controller implements AsyncProcessor {
         coords.setAxisValue(MotionEvent.AXIS_HSCROLL, hScroll);
         coords.setAxisValue(MotionEvent.AXIS_VSCROLL, vScroll);
 
-        MotionEvent event = MotionEvent.obtain(lastTouchDown, now, MotionEvent.ACTION_SCROLL, 1, pointerProperties, pointerCoords, 0, buttons, 1f, 1f,
-                DEFAULT_DEVICE_ID, 0, InputDevice.SOURCE_MOUSE, 0);
-        return device.injectEvent(event, Device.INJECT_MODE_ASYNC);
+        MotionEvent event = obtainMotionEvent(now, MotionEvent.ACTION_SCROLL, 1, buttons, InputDevice.SOURCE_MOUSE);
+        return injectMotionEvent(event);
     }
 
     /**
@@ -440,7 +665,8 @@ public class Controller implements AsyncProcessor {
 
         // On Android >= 7, also press the PASTE key if requested
         if (paste && Build.VERSION.SDK_INT >= Build.VERSION_CODES.N && device.supportsInputEvents()) {
-            device.pressReleaseKeycode(KeyEvent.KEYCODE_PASTE, Device.INJECT_MODE_ASYNC);
+            // After the pending input events
+            submitInjection(() -> device.pressReleaseKeycode(KeyEvent.KEYCODE_PASTE, Device.INJECT_MODE_ASYNC));
         }
 
         if (sequence != ControlMessage.SEQUENCE_INVALID) {
@@ -452,6 +678,12 @@ public class Controller implements AsyncProcessor {
         return ok;
     }
 
+    private void replyClockPing(long clientTime) {
+        // Measured on reception, in the clock of the video PTS, so that the client can map the PTS to its own clock
+        long deviceTime = surfaceEncoder != null ? surfaceEncoder.captureClockUs() : System.nanoTime() / 1000;
+        sender.send(DeviceMessage.createClockPong(clientTime, deviceTime));
+    }
+
     private void openHardKeyboardSettings() {
         Intent intent = new Intent("android.settings.HARD_KEYBOARD_SETTINGS");
         ServiceManager.getActivityManager().startActivity(intent);
@@ -3,11 +3,22 @@ package com.genymobile.scrcpy;
 import android.net.LocalServerSocket;
 import android.net.LocalSocket;
 import android.net.LocalSocketAddress;
+import android.os.ParcelFileDescriptor;
+import android.os.SystemClock;
+import android.system.ErrnoException;
+import android.system.Os;
+import android.system.OsConstants;
 
 import java.io.Closeable;
+import java.io.DataInputStream;
 import java.io.FileDescriptor;
 import java.io.IOException;
+import java.net.DatagramSocket;
+import java.net.ServerSocket;
+import java.net.Socket;
+import java.net.SocketTimeoutException;
 import java.nio.charset.StandardCharsets;
+import java.security.MessageDigest;
 
 public final class DesktopConnection implements Closeable {
 
@@ -15,8 +26,16 @@ public final class DesktopConnection implements Closeable {
 
     private static final String SOCKET_NAME_PREFIX = "scrcpy";
 
-    private final LocalSocket videoSocket;
-    private final FileDescriptor videoFd;
+    // Delay for a direct connection to send its token
+    private static final int DIRECT_TOKEN_TIMEOUT_MS = 5000;
+
+    // Delay for the client to reopen the tunnel on video reconnection (in reverse tunnel mode)
+    private static final int VIDEO_RECONNECT_TIMEOUT_MS = 10000;
+    private static final int VIDEO_RECONNECT_RETRY_DELAY_MS = 100;
+
+    // Replaced on video reconnection
+    private LocalSocket videoSocket;
+    private FileDescriptor videoFd;
 
     private final LocalSocket audioSocket;
     private final FileDescriptor audioFd;
@@ -24,14 +43,88 @@ public final class DesktopConnection implements Closeable {
     private final LocalSocket controlSocket;
     private final ControlChannel controlChannel;
 
-    private DesktopConnection(LocalSocket videoSocket, LocalSocket audioSocket, LocalSocket controlSocket) throws IOException {
+    // Separate video stream for recording (always the last socket)
+    private final LocalSocket recordVideoSocket;
+    private final FileDescriptor recordVideoFd;
+
+    // The stream on which the device meta is sent
+    private final FileDescriptor firstFd;
+
+    // Only if all the streams are transmitted over a single socket (the sockets above are null)
+    private final Multiplexer multiplexer;
+
+    // Only in direct mode, indexed by stream (the local sockets above are null)
+    private final Socket[] directSockets;
+    private final ParcelFileDescriptor[] directFds;
+    // Only in direct mode if the video packets are sent over UDP
+    private final UdpVideoChannel udpVideoChannel;
+
+    // Only if the video stream may be reconnected, see reconnectVideo()
+    private LocalServerSocket videoServerSocket; // in forward tunnel mode
+    private String videoSocketName; // in reverse tunnel mode
+    private boolean videoSendDummyByte;
+    private int videoSendBufferSize;
+    private volatile boolean shutdown;
+
+    private DesktopConnection(LocalSocket videoSocket, LocalSocket audioSocket, LocalSocket controlSocket, LocalSocket recordVideoSocket)
+            throws IOException {
         this.videoSocket = videoSocket;
         this.audioSocket = audioSocket;
         this.controlSocket = controlSocket;
+        this.recordVideoSocket = recordVideoSocket;
+        this.multiplexer = null;
+        this.directSockets = null;
+        this.directFds = null;
+        this.udpVideoChannel = null;
 
         videoFd = videoSocket != null ? videoSocket.getFileDescriptor() : null;
         audioFd = audioSocket != null ? audioSocket.getFileDescriptor() : null;
         controlChannel = controlSocket != null ? new ControlChannel(controlSocket) : null;
+        recordVideoFd = recordVideoSocket != null ? recordVideoSocket.getFileDescriptor() : null;
+        firstFd = getFirstSocket().getFileDescriptor();
+    }
+
+    private DesktopConnection(Multiplexer multiplexer) throws IOException {
+        this.videoSocket = null;
+        this.audioSocket = null;
+        this.controlSocket = null;
+        this.recordVideoSocket = null;
+        this.multiplexer = multiplexer;
+        this.directSockets = null;
+        this.directFds = null;
+        this.udpVideoChannel = null;
+
+        videoFd = multiplexer.getFd(Multiplexer.STREAM_VIDEO);
+        audioFd = multiplexer.getFd(Multiplexer.STREAM_AUDIO);
+        FileDescriptor controlFd = multiplexer.getFd(Multiplexer.STREAM_CONTROL);
+        controlChannel = controlFd != null ? new ControlChannel(controlFd) : null;
+        recordVideoFd = multiplexer.getFd(Multiplexer.STREAM_RECORD_VIDEO);
+        firstFd = videoFd != null ? videoFd : audioFd != null ? audioFd : controlFd;
+    }
+
+    private DesktopConnection(Socket[] directSockets, ParcelFileDescriptor[] directFds, UdpVideoChannel udpVideoChannel) {
+        this.videoSocket = null;
+        this.audioSocket = null;
+        this.controlSocket = null;
+        this.recordVideoSocket = null;
+        this.multiplexer = null;
+        this.directSockets = directSockets;
+        this.directFds = directFds;
+        this.udpVideoChannel = udpVideoChannel;
+
+        // The device meta is always sent over TCP
+        FileDescriptor directVideoFd = getDirectFd(directFds, Multiplexer.STREAM_VIDEO);
+        videoFd = udpVideoChannel != null ? udpVideoChannel.getFd() : directVideoFd;
+        audioFd = getDirectFd(directFds, Multiplexer.STREAM_AUDIO);
+        FileDescriptor controlFd = getDirectFd(directFds, Multiplexer.STREAM_CONTROL);
+        controlChannel = controlFd != null ? new ControlChannel(controlFd) : null;
+        recordVideoFd = getDirectFd(directFds, Multiplexer.STREAM_RECORD_VIDEO);
+        firstFd = directVideoFd != null ? directVideoFd : audioFd != null ? audioFd : controlFd;
+    }
+
+    private static FileDescriptor getDirectFd(ParcelFileDescriptor[] directFds, int stream) {
+        ParcelFileDescriptor pfd = directFds[stream];
+        return pfd != null ? pfd.getFileDescriptor() : null;
     }
 
     private static LocalSocket connect(String abstractName) throws IOException {
@@ -49,66 +142,353 @@ public final class DesktopConnection implements Closeable {
         return SOCKET_NAME_PREFIX + String.format("_%08x", scid);
     }
 
-    public static DesktopConnection open(int scid, boolean tunnelForward, boolean video, boolean audio, boolean control, boolean sendDummyByte)
-            throws IOException {
+    /**
+     * Open the connection through the adb tunnel.
+     * <p>
+     * If {@code videoReconnect} is set, the client may reconnect the video stream once it is lost (see {@link #reconnectVideo()}). It requires
+     * separate sockets.
+     */
+    public static DesktopConnection open(int scid, boolean tunnelForward, boolean video, boolean audio, boolean control, boolean recordVideo,
+            boolean sendDummyByte, boolean multiplex, boolean videoReconnect) throws IOException {
+        // The record video stream is never the first one
+        assert !recordVideo || video;
+        assert !videoReconnect || (video && !multiplex);
+
+        if (tunnelForward) {
+            if (videoReconnect) {
+                // Keep the server socket open to accept the video reconnections
+                LocalServerSocket localServerSocket = createServerSocket(scid);
+                DesktopConnection connection;
+                try {
+                    connection = accept(localServerSocket, video, audio, control, recordVideo, sendDummyByte, false);
+                } catch (IOException | RuntimeException e) {
+                    localServerSocket.close();
+                    throw e;
+                }
+                connection.videoServerSocket = localServerSocket;
+                connection.videoSendDummyByte = sendDummyByte;
+                return connection;
+            }
+
+            try (LocalServerSocket localServerSocket = createServerSocket(scid)) {
+                return accept(localServerSocket, video, audio, control, recordVideo, sendDummyByte, multiplex);
+            }
+        }
+
         String socketName = getSocketName(scid);
 
+        if (multiplex) {
+            return createMultiplexed(connect(socketName), video, audio, control, recordVideo);
+        }
+
         LocalSocket videoSocket = null;
         LocalSocket audioSocket = null;
         LocalSocket controlSocket = null;
+        LocalSocket recordVideoSocket = null;
         try {
-            if (tunnelForward) {
-                try (LocalServerSocket localServerSocket = new LocalServerSocket(socketName)) {
-                    if (video) {
-                        videoSocket = localServerSocket.accept();
-                        if (sendDummyByte) {
-                            // send one byte so the client may read() to detect a connection error
-                            videoSocket.getOutputStream().write(0);
-                            sendDummyByte = false;
-                        }
-                    }
-                    if (audio) {
-                        audioSocket = localServerSocket.accept();
-                        if (sendDummyByte) {
-                            // send one byte so the client may read() to detect a connection error
-                            audioSocket.getOutputStream().write(0);
-                            sendDummyByte = false;
-                        }
-                    }
-                    if (control) {
-                        controlSocket = localServerSocket.accept();
-                        if (sendDummyByte) {
-                            // send one byte so the client may read() to detect a connection error
-                            controlSocket.getOutputStream().write(0);
-                            sendDummyByte = false;
-                        }
-                    }
+            if (video) {
+                videoSocket = connect(socketName);
+            }
+            if (audio) {
+                audioSocket = connect(socketName);
+            }
+            if (control) {
+                controlSocket = connect(socketName);
+            }
+            if (recordVideo) {
+                recordVideoSocket = connect(socketName);
+            }
+        } catch (IOException | RuntimeException e) {
+            closeAll(videoSocket, audioSocket, controlSocket, recordVideoSocket);
+            throw e;
+        }
+
+        DesktopConnection connection = new DesktopConnection(videoSocket, audioSocket, controlSocket, recordVideoSocket);
+        if (videoReconnect) {
+            connection.videoSocketName = socketName;
+        }
+        return connection;
+    }
+
+    /**
+     * Create the socket the client connects to in forward tunnel mode.
+     * <p>
+     * It may be kept open to accept several successive connections (see {@link #accept(LocalServerSocket, boolean, boolean, boolean, boolean,
+     * boolean, boolean)}).
+     */
+    public static LocalServerSocket createServerSocket(int scid) throws IOException {
+        return new LocalServerSocket(getSocketName(scid));
+    }
+
+    public static DesktopConnection accept(LocalServerSocket localServerSocket, boolean video, boolean audio, boolean control, boolean recordVideo,
+            boolean sendDummyByte, boolean multiplex) throws IOException {
+        if (multiplex) {
+            LocalSocket socket = localServerSocket.accept();
+            try {
+                if (sendDummyByte) {
+                    // send one byte so the client may read() to detect a connection error
+                    socket.getOutputStream().write(0);
                 }
-            } else {
-                if (video) {
-                    videoSocket = connect(socketName);
+            } catch (IOException | RuntimeException e) {
+                socket.close();
+                throw e;
+            }
+            return createMultiplexed(socket, video, audio, control, recordVideo);
+        }
+
+        LocalSocket videoSocket = null;
+        LocalSocket audioSocket = null;
+        LocalSocket controlSocket = null;
+        LocalSocket recordVideoSocket = null;
+        try {
+            if (video) {
+                videoSocket = localServerSocket.accept();
+                if (sendDummyByte) {
+                    // send one byte so the client may read() to detect a connection error
+                    videoSocket.getOutputStream().write(0);
+                    sendDummyByte = false;
                 }
-                if (audio) {
-                    audioSocket = connect(socketName);
+            }
+            if (audio) {
+                audioSocket = localServerSocket.accept();
+                if (sendDummyByte) {
+                    // send one byte so the client may read() to detect a connection error
+                    audioSocket.getOutputStream().write(0);
+                    sendDummyByte = false;
                 }
-                if (control) {
-                    controlSocket = connect(socketName);
+            }
+            if (control) {
+                controlSocket = localServerSocket.accept();
+                if (sendDummyByte) {
+                    // send one byte so the client may read() to detect a connection error
+                    controlSocket.getOutputStream().write(0);
+                    sendDummyByte = false;
                 }
             }
+            if (recordVideo) {
+                recordVideoSocket = localServerSocket.accept();
+            }
         } catch (IOException | RuntimeException e) {
-            if (videoSocket != null) {
-                videoSocket.close();
+            closeAll(videoSocket, audioSocket, controlSocket, recordVideoSocket);
+            throw e;
+        }
+
+        return new DesktopConnection(videoSocket, audioSocket, controlSocket, recordVideoSocket);
+    }
+
+    /**
+     * Listen on a TCP port of the device, and accept the connections of the client directly (without adb).
+     * <p>
+     * Each connection must start with the token received on start, the other connections are rejected.
+     * <p>
+     * If {@code udpVideo} is set, the video packets are sent over UDP (from the same port number), see {@link UdpVideoChannel}.
+     */
+    public static DesktopConnection openDirect(int port, byte[] token, boolean udpVideo, boolean video, boolean audio, boolean control,
+            boolean recordVideo) throws IOException {
+        boolean[] enabled = {video, audio, control, recordVideo};
+        Socket[] sockets = new Socket[enabled.length];
+        ParcelFileDescriptor[] fds = new ParcelFileDescriptor[enabled.length];
+        DatagramSocket udpSocket = null;
+        UdpVideoChannel udpVideoChannel = null;
+        try (ServerSocket serverSocket = new ServerSocket(port)) {
+            if (udpVideo && video) {
+                // Bind before accepting the TCP connections, so that the first datagrams of the client are not lost
+                udpSocket = new DatagramSocket(port);
+            }
+
+            boolean first = true;
+            for (int i = 0; i < enabled.length; ++i) {
+                if (enabled[i]) {
+                    sockets[i] = acceptDirect(serverSocket, token);
+                    if (first) {
+                        // send one byte so the client knows that the token is accepted
+                        sockets[i].getOutputStream().write(0);
+                        first = false;
+                    }
+                    // The streamers write to a FileDescriptor: use a dup of the socket file descriptor
+                    fds[i] = ParcelFileDescriptor.fromSocket(sockets[i]);
+                }
+            }
+
+            if (udpSocket != null) {
+                UdpVideoChannel.acceptClient(udpSocket, token, DIRECT_TOKEN_TIMEOUT_MS);
+                udpVideoChannel = new UdpVideoChannel(udpSocket, fds[Multiplexer.STREAM_VIDEO].getFileDescriptor());
+            }
+        } catch (IOException | RuntimeException e) {
+            if (udpSocket != null) {
+                udpSocket.close();
+            }
+            closeDirect(sockets, fds);
+            throw e;
+        }
+
+        DesktopConnection connection = new DesktopConnection(sockets, fds, udpVideoChannel);
+        if (udpVideoChannel != null) {
+            udpVideoChannel.start();
+        }
+        return connection;
+    }
+
+    private static Socket acceptDirect(ServerSocket serverSocket, byte[] token) throws IOException {
+        while (true) {
+            Socket socket = serverSocket.accept();
+            try {
+                socket.setTcpNoDelay(true);
+                socket.setSoTimeout(DIRECT_TOKEN_TIMEOUT_MS);
+                byte[] received = new byte[token.length];
+                new DataInputStream(socket.getInputStream()).readFully(received);
+                socket.setSoTimeout(0);
+                // Constant-time comparison
+                if (MessageDigest.isEqual(token, received)) {
+                    return socket;
+                }
+                Ln.w("Direct connection rejected (invalid token) from " + socket.getInetAddress());
+            } catch (SocketTimeoutException e) {
+                Ln.w("Direct connection rejected (no token) from " + socket.getInetAddress());
+            } catch (IOException e) {
+                Ln.w("Direct connection failed: " + e.getMessage());
+            }
+            socket.close();
+        }
+    }
+
+    private static void closeDirect(Socket[] sockets, ParcelFileDescriptor[] fds) throws IOException {
+        for (ParcelFileDescriptor fd : fds) {
+            if (fd != null) {
+                fd.close();
+            }
+        }
+        for (Socket socket : sockets) {
+            if (socket != null) {
+                socket.close();
+            }
+        }
+    }
+
+    private static DesktopConnection createMultiplexed(LocalSocket socket, boolean video, boolean audio, boolean control, boolean recordVideo)
+            throws IOException {
+        Multiplexer multiplexer;
+        try {
+            multiplexer = new Multiplexer(socket, video, audio, control, recordVideo);
+        } catch (IOException | RuntimeException e) {
+            socket.close();
+            throw e;
+        }
+
+        DesktopConnection connection;
+        try {
+            connection = new DesktopConnection(multiplexer);
+        } catch (IOException | RuntimeException e) {
+            multiplexer.close();
+            throw e;
+        }
+
+        multiplexer.start();
+        return connection;
+    }
+
+    private static void closeAll(LocalSocket... sockets) throws IOException {
+        for (LocalSocket socket : sockets) {
+            if (socket != null) {
+                socket.close();
             }
-            if (audioSocket != null) {
-                audioSocket.close();
+        }
+    }
+
+    /**
+     * Set the send buffer size of the video sockets, so that a burst of video packets (typically a keyframe) does not block the encoder.
+     */
+    public void setVideoSendBufferSize(int size) throws IOException {
+        if (udpVideoChannel != null) {
+            udpVideoChannel.setSendBufferSize(size);
+        }
+        if (directSockets != null) {
+            for (int stream : new int[] {Multiplexer.STREAM_VIDEO, Multiplexer.STREAM_RECORD_VIDEO}) {
+                if (directSockets[stream] != null) {
+                    directSockets[stream].setSendBufferSize(size);
+                }
             }
-            if (controlSocket != null) {
-                controlSocket.close();
+        }
+        if (multiplexer != null) {
+            multiplexer.setSendBufferSize(size);
+        }
+        if (videoSocket != null) {
+            videoSocket.setSendBufferSize(size);
+            // Also applied to the reconnected video sockets
+            videoSendBufferSize = size;
+        }
+        if (recordVideoSocket != null) {
+            recordVideoSocket.setSendBufferSize(size);
+        }
+    }
+
+    /**
+     * Wait for the client to reconnect the video stream, once the previous video socket is broken.
+     * <p>
+     * This method is called from the video encoding thread. It is interrupted by {@link #shutdown()}.
+     *
+     * @return the new video file descriptor
+     */
+    public FileDescriptor reconnectVideo() throws IOException {
+        if (videoServerSocket == null && videoSocketName == null) {
+            throw new IOException("Video reconnection not enabled");
+        }
+
+        LocalSocket socket = videoServerSocket != null ? acceptVideo() : connectVideo();
+        try {
+            if (videoSendBufferSize > 0) {
+                socket.setSendBufferSize(videoSendBufferSize);
             }
+        } catch (IOException | RuntimeException e) {
+            socket.close();
             throw e;
         }
 
-        return new DesktopConnection(videoSocket, audioSocket, controlSocket);
+        LocalSocket oldSocket;
+        synchronized (this) {
+            if (shutdown) {
+                socket.close();
+                throw new IOException("Connection shutdown");
+            }
+            oldSocket = videoSocket;
+            videoSocket = socket;
+            videoFd = socket.getFileDescriptor();
+        }
+        oldSocket.close();
+
+        return videoFd;
+    }
+
+    private LocalSocket acceptVideo() throws IOException {
+        LocalSocket socket = videoServerSocket.accept();
+        if (videoSendDummyByte) {
+            try {
+                // send one byte so the client may read() to detect a connection error
+                socket.getOutputStream().write(0);
+            } catch (IOException | RuntimeException e) {
+                socket.close();
+                throw e;
+            }
+        }
+        return socket;
+    }
+
+    private LocalSocket connectVideo() throws IOException {
+        // The client reopens the "adb reverse" tunnel once it detects the disconnection
+        long deadline = SystemClock.uptimeMillis() + VIDEO_RECONNECT_TIMEOUT_MS;
+        while (true) {
+            if (shutdown) {
+                throw new IOException("Connection shutdown");
+            }
+            try {
+                return connect(videoSocketName);
+            } catch (IOException e) {
+                if (SystemClock.uptimeMillis() >= deadline) {
+                    throw e;
+                }
+            }
+            SystemClock.sleep(VIDEO_RECONNECT_RETRY_DELAY_MS);
+        }
     }
 
     private LocalSocket getFirstSocket() {
@@ -122,9 +502,38 @@ public final class DesktopConnection implements Closeable {
     }
 
     public void shutdown() throws IOException {
-        if (videoSocket != null) {
-            videoSocket.shutdownInput();
-            videoSocket.shutdownOutput();
+        shutdown = true;
+        if (videoServerSocket != null) {
+            try {
+                // Wake up a pending video reconnection
+                Os.shutdown(videoServerSocket.getFileDescriptor(), OsConstants.SHUT_RDWR);
+            } catch (ErrnoException e) {
+                // ignore
+            }
+        }
+        if (udpVideoChannel != null) {
+            udpVideoChannel.shutdown();
+        }
+        if (directFds != null) {
+            for (ParcelFileDescriptor fd : directFds) {
+                if (fd != null) {
+                    try {
+                        // Also interrupt the writers and readers of the dup file descriptor
+                        Os.shutdown(fd.getFileDescriptor(), OsConstants.SHUT_RDWR);
+                    } catch (ErrnoException e) {
+                        // ignore
+                    }
+                }
+            }
+        }
+        if (multiplexer != null) {
+            multiplexer.shutdown();
+        }
+        synchronized (this) {
+            if (videoSocket != null) {
+                videoSocket.shutdownInput();
+                videoSocket.shutdownOutput();
+            }
         }
         if (audioSocket != null) {
             audioSocket.shutdownInput();
@@ -134,9 +543,35 @@ public final class DesktopConnection implements Closeable {
             controlSocket.shutdownInput();
             controlSocket.shutdownOutput();
         }
+        if (recordVideoSocket != null) {
+            recordVideoSocket.shutdownInput();
+            recordVideoSocket.shutdownOutput();
+        }
     }
 
     public void close() throws IOException {
+        if (udpVideoChannel != null) {
+            try {
+                udpVideoChannel.join();
+            } catch (InterruptedException e) {
+                // ignore
+            }
+            udpVideoChannel.close();
+        }
+        if (directSockets != null) {
+            closeDirect(directSockets, directFds);
+        }
+        if (multiplexer != null) {
+            try {
+                multiplexer.join();
+            } catch (InterruptedException e) {
+                // ignore
+            }
+            multiplexer.close();
+        }
+        if (videoServerSocket != null) {
+            videoServerSocket.close();
+        }
         if (videoSocket != null) {
             videoSocket.close();
         }
@@ -146,6 +581,9 @@ public final class DesktopConnection implements Closeable {
         if (controlSocket != null) {
             controlSocket.close();
         }
+        if (recordVideoSocket != null) {
+            recordVideoSocket.close();
+        }
     }
 
     public void sendDeviceMeta(String deviceName) throws IOException {
@@ -156,8 +594,7 @@ public final class DesktopConnection implements Closeable {
         System.arraycopy(deviceNameBytes, 0, buffer, 0, len);
         // byte[] are always 0-initialized in java, no need to set '\0' explicitly
 
-        FileDescriptor fd = getFirstSocket().getFileDescriptor();
-        IO.writeFully(fd, buffer, 0, buffer.length);
+        IO.writeFully(firstFd, buffer, 0, buffer.length);
     }
 
     public FileDescriptor getVideoFd() {
@@ -168,7 +605,15 @@ public final class DesktopConnection implements Closeable {
         return audioFd;
     }
 
+    public FileDescriptor getRecordVideoFd() {
+        return recordVideoFd;
+    }
+
     public ControlChannel getControlChannel() {
         return controlChannel;
     }
+
+    public UdpVideoChannel getUdpVideoChannel() {
+        return udpVideoChannel;
+    }
 }
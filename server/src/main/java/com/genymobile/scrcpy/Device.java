@@ -19,6 +19,8 @@ import android.view.InputEvent;
 import android.view.KeyCharacterMap;
 import android.view.KeyEvent;
 
+import java.util.ArrayList;
+import java.util.List;
 import java.util.concurrent.atomic.AtomicBoolean;
 
 public final class Device {
@@ -45,14 +47,17 @@ public final class Device {
         void onClipboardTextChanged(String text);
     }
 
-    private final Rect crop;
+    private final Rect initialCrop;
+    private Rect crop;
     private int maxSize;
     private final int lockVideoOrientation;
+    private final boolean squareVideo;
 
     private Size deviceSize;
     private ScreenInfo screenInfo;
-    private RotationListener rotationListener;
-    private FoldListener foldListener;
+    // Several captures may listen to the same device (if a separate record video stream is enabled)
+    private final List<RotationListener> rotationListeners = new ArrayList<>();
+    private final List<FoldListener> foldListeners = new ArrayList<>();
     private ClipboardListener clipboardListener;
     private final AtomicBoolean isSettingClipboard = new AtomicBoolean();
 
@@ -69,7 +74,11 @@ public final class Device {
     private final boolean supportsInputEvents;
 
     public Device(Options options) throws ConfigurationException {
-        displayId = options.getDisplayId();
+        this(options, options.getDisplayId());
+    }
+
+    public Device(Options options, int displayId) throws ConfigurationException {
+        this.displayId = displayId;
         DisplayInfo displayInfo = ServiceManager.getDisplayManager().getDisplayInfo(displayId);
         if (displayInfo == null) {
             Ln.e("Display " + displayId + " not found\n" + LogUtils.buildDisplayListMessage());
@@ -79,11 +88,14 @@ public final class Device {
         int displayInfoFlags = displayInfo.getFlags();
 
         deviceSize = displayInfo.getSize();
-        crop = options.getCrop();
+        initialCrop = options.getCrop();
+        crop = initialCrop;
         maxSize = options.getMaxSize();
         lockVideoOrientation = options.getLockVideoOrientation();
+        // a new display is not rotated by the device, its size is managed by NewDisplayCapture
+        squareVideo = options.getSquareVideo() && options.getNewDisplay() == null;
 
-        screenInfo = ScreenInfo.computeScreenInfo(displayInfo.getRotation(), deviceSize, crop, maxSize, lockVideoOrientation);
+        screenInfo = ScreenInfo.computeScreenInfo(displayInfo.getRotation(), deviceSize, crop, maxSize, lockVideoOrientation, squareVideo);
         layerStack = displayInfo.getLayerStack();
 
         ServiceManager.getWindowManager().registerRotationWatcher(new IRotationWatcher.Stub() {
@@ -93,7 +105,7 @@ public final class Device {
                     screenInfo = screenInfo.withDeviceRotation(rotation);
 
                     // notify
-                    if (rotationListener != null) {
+                    for (RotationListener rotationListener : rotationListeners) {
                         rotationListener.onRotationChanged(rotation);
                     }
                 }
@@ -117,9 +129,9 @@ public final class Device {
                         }
 
                         deviceSize = displayInfo.getSize();
-                        screenInfo = ScreenInfo.computeScreenInfo(displayInfo.getRotation(), deviceSize, crop, maxSize, lockVideoOrientation);
+                        screenInfo = ScreenInfo.computeScreenInfo(displayInfo.getRotation(), deviceSize, crop, maxSize, lockVideoOrientation, squareVideo);
                         // notify
-                        if (foldListener != null) {
+                        for (FoldListener foldListener : foldListeners) {
                             foldListener.onFoldChanged(displayId, folded);
                         }
                     }
@@ -170,7 +182,32 @@ public final class Device {
 
     public synchronized void setMaxSize(int newMaxSize) {
         maxSize = newMaxSize;
-        screenInfo = ScreenInfo.computeScreenInfo(screenInfo.getReverseVideoRotation(), deviceSize, crop, newMaxSize, lockVideoOrientation);
+        screenInfo = ScreenInfo.computeScreenInfo(screenInfo.getReverseVideoRotation(), deviceSize, crop, newMaxSize, lockVideoOrientation, squareVideo);
+    }
+
+    /**
+     * Change the captured region of the screen, without changing the video size.
+     *
+     * @param region the region, in the current device orientation, or {@code null} to restore the initial crop
+     * @return the new screen info, or {@code null} if the region is invalid
+     */
+    public synchronized ScreenInfo setCrop(Rect region) {
+        boolean flipped = screenInfo.getDeviceRotation() % 2 != 0;
+        if (region == null && initialCrop != null) {
+            // the initial crop is expressed in the natural orientation
+            region = flipped ? ScreenInfo.flipRect(initialCrop) : initialCrop;
+        }
+
+        ScreenInfo newScreenInfo = screenInfo.withContentRegion(region, deviceSize);
+        if (newScreenInfo == null) {
+            return null;
+        }
+
+        screenInfo = newScreenInfo;
+        // keep the new region if the screen info is recomputed (on fold or video limits change)
+        Rect contentRect = newScreenInfo.getContentRect();
+        crop = flipped ? ScreenInfo.flipRect(contentRect) : contentRect;
+        return newScreenInfo;
     }
 
     public synchronized ScreenInfo getScreenInfo() {
@@ -194,18 +231,43 @@ public final class Device {
         Position devicePosition = position.rotate(reverseVideoRotation);
 
         Size clientVideoSize = devicePosition.getScreenSize();
-        if (!unlockedVideoSize.equals(clientVideoSize)) {
+        if (!screenInfo.getUnlockedCanvasSize().equals(clientVideoSize)) {
             // The client sends a click relative to a video with wrong dimensions,
             // the device may have been rotated since the event was generated, so ignore the event
             return null;
         }
         Rect contentRect = screenInfo.getContentRect();
+        // the video content may be letterboxed in the canvas
+        Rect contentVideoRect = screenInfo.getUnlockedContentVideoRect();
         Point point = devicePosition.getPoint();
-        int convertedX = contentRect.left + point.getX() * contentRect.width() / unlockedVideoSize.getWidth();
-        int convertedY = contentRect.top + point.getY() * contentRect.height() / unlockedVideoSize.getHeight();
+        int x = point.getX() - contentVideoRect.left;
+        int y = point.getY() - contentVideoRect.top;
+        int convertedX = contentRect.left + x * contentRect.width() / unlockedVideoSize.getWidth();
+        int convertedY = contentRect.top + y * contentRect.height() / unlockedVideoSize.getHeight();
         return new Point(convertedX, convertedY);
     }
 
+    /**
+     * Convert a rectangle relative to the video into device coordinates (like {@link #getPhysicalPoint(Position)}).
+     *
+     * @param position the top-left corner, with the video size
+     * @param width the width of the rectangle in the video
+     * @param height the height of the rectangle in the video
+     * @return the rectangle, in the current device orientation, or {@code null} if the video size is outdated
+     */
+    public Rect getPhysicalRect(Position position, int width, int height) {
+        Point point = position.getPoint();
+        Position opposite = new Position(point.getX() + width, point.getY() + height, position.getScreenSize().getWidth(),
+                position.getScreenSize().getHeight());
+        Point a = getPhysicalPoint(position);
+        Point b = getPhysicalPoint(opposite);
+        if (a == null || b == null) {
+            return null;
+        }
+        // the video rotation may swap the corners
+        return new Rect(Math.min(a.getX(), b.getX()), Math.min(a.getY(), b.getY()), Math.max(a.getX(), b.getX()), Math.max(a.getY(), b.getY()));
+    }
+
     public static String getDeviceName() {
         return Build.MODEL;
     }
@@ -258,12 +320,20 @@ public final class Device {
         return ServiceManager.getPowerManager().isScreenOn();
     }
 
-    public synchronized void setRotationListener(RotationListener rotationListener) {
-        this.rotationListener = rotationListener;
+    public synchronized void addRotationListener(RotationListener rotationListener) {
+        rotationListeners.add(rotationListener);
+    }
+
+    public synchronized void removeRotationListener(RotationListener rotationListener) {
+        rotationListeners.remove(rotationListener);
+    }
+
+    public synchronized void addFoldListener(FoldListener foldListener) {
+        foldListeners.add(foldListener);
     }
 
-    public synchronized void setFoldListener(FoldListener foldlistener) {
-        this.foldListener = foldlistener;
+    public synchronized void removeFoldListener(FoldListener foldListener) {
+        foldListeners.remove(foldListener);
     }
 
     public synchronized void setClipboardListener(ClipboardListener clipboardListener) {
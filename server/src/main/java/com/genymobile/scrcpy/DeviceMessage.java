@@ -5,12 +5,31 @@ public final class DeviceMessage {
     public static final int TYPE_CLIPBOARD = 0;
     public static final int TYPE_ACK_CLIPBOARD = 1;
     public static final int TYPE_UHID_OUTPUT = 2;
+    public static final int TYPE_VIDEO_DROPPED = 3;
+    public static final int TYPE_INJECTION_LATENCY = 4;
+    // Beginning of a clipboard text too large for a single message (only generated by DeviceMessageWriter)
+    public static final int TYPE_CLIPBOARD_CHUNK = 5;
+    public static final int TYPE_ENCODER_STATS = 6;
+    // A large message compressed (only generated by DeviceMessageWriter)
+    public static final int TYPE_COMPRESSED = 7;
+    public static final int TYPE_CLOCK_PONG = 8;
+    public static final int TYPE_THERMAL_STATE = 9;
 
     private int type;
     private String text;
     private long sequence;
     private int id;
     private byte[] data;
+    private int droppedFrames;
+    private int latencyP50; // µs
+    private int latencyP99; // µs
+    private int writeBlockP50; // µs
+    private int writeBlockP99; // µs
+    private long clientTime; // µs, in the client clock
+    private long deviceTime; // µs, in the clock of the video PTS
+    private int thermalStatus; // -1 if unknown
+    private int batteryLevel; // percent, -1 if unknown
+    private int thermalLevel; // level of the thermal governor
 
     private DeviceMessage() {
     }
@@ -37,6 +56,48 @@ public final class DeviceMessage {
         return event;
     }
 
+    public static DeviceMessage createVideoDropped(int droppedFrames) {
+        DeviceMessage event = new DeviceMessage();
+        event.type = TYPE_VIDEO_DROPPED;
+        event.droppedFrames = droppedFrames;
+        return event;
+    }
+
+    public static DeviceMessage createInjectionLatency(int latencyP50, int latencyP99) {
+        DeviceMessage event = new DeviceMessage();
+        event.type = TYPE_INJECTION_LATENCY;
+        event.latencyP50 = latencyP50;
+        event.latencyP99 = latencyP99;
+        return event;
+    }
+
+    public static DeviceMessage createEncoderStats(int encodeP50, int encodeP99, int writeBlockP50, int writeBlockP99) {
+        DeviceMessage event = new DeviceMessage();
+        event.type = TYPE_ENCODER_STATS;
+        event.latencyP50 = encodeP50;
+        event.latencyP99 = encodeP99;
+        event.writeBlockP50 = writeBlockP50;
+        event.writeBlockP99 = writeBlockP99;
+        return event;
+    }
+
+    public static DeviceMessage createClockPong(long clientTime, long deviceTime) {
+        DeviceMessage event = new DeviceMessage();
+        event.type = TYPE_CLOCK_PONG;
+        event.clientTime = clientTime;
+        event.deviceTime = deviceTime;
+        return event;
+    }
+
+    public static DeviceMessage createThermalState(int thermalStatus, int batteryLevel, int thermalLevel) {
+        DeviceMessage event = new DeviceMessage();
+        event.type = TYPE_THERMAL_STATE;
+        event.thermalStatus = thermalStatus;
+        event.batteryLevel = batteryLevel;
+        event.thermalLevel = thermalLevel;
+        return event;
+    }
+
     public int getType() {
         return type;
     }
@@ -56,4 +117,44 @@ public final class DeviceMessage {
     public byte[] getData() {
         return data;
     }
+
+    public int getDroppedFrames() {
+        return droppedFrames;
+    }
+
+    public int getLatencyP50() {
+        return latencyP50;
+    }
+
+    public int getLatencyP99() {
+        return latencyP99;
+    }
+
+    public int getWriteBlockP50() {
+        return writeBlockP50;
+    }
+
+    public int getWriteBlockP99() {
+        return writeBlockP99;
+    }
+
+    public long getClientTime() {
+        return clientTime;
+    }
+
+    public long getDeviceTime() {
+        return deviceTime;
+    }
+
+    public int getThermalStatus() {
+        return thermalStatus;
+    }
+
+    public int getBatteryLevel() {
+        return batteryLevel;
+    }
+
+    public int getThermalLevel() {
+        return thermalLevel;
+    }
 }
@@ -1,30 +1,61 @@
 package com.genymobile.scrcpy;
 
 import java.io.IOException;
+import java.util.ArrayList;
+import java.util.Iterator;
+import java.util.List;
 import java.util.concurrent.ArrayBlockingQueue;
 import java.util.concurrent.BlockingQueue;
+import java.util.concurrent.atomic.AtomicInteger;
 
 public final class DeviceMessageSender {
 
+    private static final int QUEUE_CAPACITY = 16;
+
     private final ControlChannel controlChannel;
 
     private Thread thread;
-    private final BlockingQueue<DeviceMessage> queue = new ArrayBlockingQueue<>(16);
+    private final BlockingQueue<DeviceMessage> queue = new ArrayBlockingQueue<>(QUEUE_CAPACITY);
+    private final AtomicInteger droppedCount = new AtomicInteger();
 
     public DeviceMessageSender(ControlChannel controlChannel) {
         this.controlChannel = controlChannel;
     }
 
+    /**
+     * Queue a message to send, without blocking (the message is dropped if the queue is full).
+     * <p>
+     * A clipboard text replaces the one still pending, if any (only the last one is relevant).
+     */
     public void send(DeviceMessage msg) {
+        if (msg.getType() == DeviceMessage.TYPE_CLIPBOARD) {
+            removePendingClipboard();
+        }
+
         if (!queue.offer(msg)) {
-            Ln.w("Device message dropped: " + msg.getType());
+            int dropped = droppedCount.incrementAndGet();
+            Ln.w("Device message dropped: " + msg.getType() + " (" + dropped + " dropped so far)");
+        }
+    }
+
+    private void removePendingClipboard() {
+        // The iterator of ArrayBlockingQueue is weakly consistent: the consumer may take the message concurrently
+        Iterator<DeviceMessage> it = queue.iterator();
+        while (it.hasNext()) {
+            if (it.next().getType() == DeviceMessage.TYPE_CLIPBOARD) {
+                it.remove();
+            }
         }
     }
 
     private void loop() throws IOException, InterruptedException {
+        List<DeviceMessage> msgs = new ArrayList<>(QUEUE_CAPACITY);
         while (!Thread.currentThread().isInterrupted()) {
-            DeviceMessage msg = queue.take();
-            controlChannel.send(msg);
+            msgs.add(queue.take());
+            // Send all the pending messages at once
+            queue.drainTo(msgs);
+            controlChannel.send(msgs);
+            msgs.clear();
         }
     }
 
@@ -35,6 +66,10 @@ public final class DeviceMessageSender {
             } catch (IOException | InterruptedException e) {
                 // this is expected on close
             } finally {
+                int dropped = droppedCount.get();
+                if (dropped > 0) {
+                    Ln.w(dropped + " device messages dropped");
+                }
                 Ln.d("Device message sender stopped");
             }
         }, "control-send");
@@ -4,41 +4,160 @@ import java.io.IOException;
 import java.io.OutputStream;
 import java.nio.ByteBuffer;
 import java.nio.charset.StandardCharsets;
+import java.util.List;
+import java.util.zip.Deflater;
 
 public class DeviceMessageWriter {
 
     private static final int MESSAGE_MAX_SIZE = 1 << 18; // 256k
-    public static final int CLIPBOARD_TEXT_MAX_LENGTH = MESSAGE_MAX_SIZE - 5; // type: 1 byte; length: 4 bytes
+    // A larger clipboard text is sent as TYPE_CLIPBOARD_CHUNK messages followed by a final TYPE_CLIPBOARD message
+    public static final int CLIPBOARD_CHUNK_MAX_LENGTH = MESSAGE_MAX_SIZE - 5; // type: 1 byte; length: 4 bytes
+    public static final int CLIPBOARD_TEXT_MAX_LENGTH = 1 << 24; // 16M
+
+    // Smaller messages are never compressed
+    public static final int COMPRESSION_THRESHOLD = 512;
+    private static final int COMPRESSED_HEADER_LENGTH = 9; // type: 1 byte; uncompressed length: 4 bytes; length: 4 bytes
 
     private final byte[] rawBuffer = new byte[MESSAGE_MAX_SIZE];
     private final ByteBuffer buffer = ByteBuffer.wrap(rawBuffer);
 
+    // The serialized messages not written yet, so that several messages are written at once
+    private final byte[] batchBuffer = new byte[MESSAGE_MAX_SIZE];
+    private int batchLength;
+
+    // Only allocated if compression is enabled
+    private Deflater deflater;
+    private byte[] compressionBuffer;
+
+    public void enableCompression() {
+        // Favor speed, the clipboard may be large
+        deflater = new Deflater(Deflater.BEST_SPEED);
+        compressionBuffer = new byte[MESSAGE_MAX_SIZE];
+    }
+
     public void writeTo(DeviceMessage msg, OutputStream output) throws IOException {
+        append(msg, output);
+        flush(output);
+    }
+
+    /**
+     * Write several messages, with as few writes as possible.
+     */
+    public void writeTo(List<DeviceMessage> msgs, OutputStream output) throws IOException {
+        for (DeviceMessage msg : msgs) {
+            append(msg, output);
+        }
+        flush(output);
+    }
+
+    private void append(DeviceMessage msg, OutputStream output) throws IOException {
+        if (msg.getType() == DeviceMessage.TYPE_CLIPBOARD) {
+            // May be written as several messages
+            writeClipboard(msg.getText(), output);
+            return;
+        }
+
         buffer.clear();
         buffer.put((byte) msg.getType());
         switch (msg.getType()) {
-            case DeviceMessage.TYPE_CLIPBOARD:
-                String text = msg.getText();
-                byte[] raw = text.getBytes(StandardCharsets.UTF_8);
-                int len = StringUtils.getUtf8TruncationIndex(raw, CLIPBOARD_TEXT_MAX_LENGTH);
-                buffer.putInt(len);
-                buffer.put(raw, 0, len);
-                output.write(rawBuffer, 0, buffer.position());
-                break;
             case DeviceMessage.TYPE_ACK_CLIPBOARD:
                 buffer.putLong(msg.getSequence());
-                output.write(rawBuffer, 0, buffer.position());
+                write(output);
                 break;
             case DeviceMessage.TYPE_UHID_OUTPUT:
                 buffer.putShort((short) msg.getId());
                 byte[] data = msg.getData();
                 buffer.putShort((short) data.length);
                 buffer.put(data);
-                output.write(rawBuffer, 0, buffer.position());
+                write(output);
+                break;
+            case DeviceMessage.TYPE_VIDEO_DROPPED:
+                buffer.putInt(msg.getDroppedFrames());
+                write(output);
+                break;
+            case DeviceMessage.TYPE_INJECTION_LATENCY:
+                buffer.putInt(msg.getLatencyP50());
+                buffer.putInt(msg.getLatencyP99());
+                write(output);
+                break;
+            case DeviceMessage.TYPE_ENCODER_STATS:
+                buffer.putInt(msg.getLatencyP50());
+                buffer.putInt(msg.getLatencyP99());
+                buffer.putInt(msg.getWriteBlockP50());
+                buffer.putInt(msg.getWriteBlockP99());
+                write(output);
+                break;
+            case DeviceMessage.TYPE_CLOCK_PONG:
+                buffer.putLong(msg.getClientTime());
+                buffer.putLong(msg.getDeviceTime());
+                write(output);
+                break;
+            case DeviceMessage.TYPE_THERMAL_STATE:
+                buffer.put((byte) msg.getThermalStatus());
+                buffer.put((byte) msg.getBatteryLevel());
+                buffer.put((byte) msg.getThermalLevel());
+                write(output);
                 break;
             default:
                 Ln.w("Unknown device message: " + msg.getType());
                 break;
         }
     }
+
+    private void writeClipboard(String text, OutputStream output) throws IOException {
+        byte[] raw = text.getBytes(StandardCharsets.UTF_8);
+        int len = StringUtils.getUtf8TruncationIndex(raw, CLIPBOARD_TEXT_MAX_LENGTH);
+        int offset = 0;
+        // The client concatenates the chunks as raw bytes, so they may split a UTF-8 sequence
+        while (len - offset > CLIPBOARD_CHUNK_MAX_LENGTH) {
+            writeClipboardMessage(DeviceMessage.TYPE_CLIPBOARD_CHUNK, raw, offset, CLIPBOARD_CHUNK_MAX_LENGTH, output);
+            offset += CLIPBOARD_CHUNK_MAX_LENGTH;
+        }
+        writeClipboardMessage(DeviceMessage.TYPE_CLIPBOARD, raw, offset, len - offset, output);
+    }
+
+    private void writeClipboardMessage(int type, byte[] raw, int offset, int len, OutputStream output) throws IOException {
+        buffer.clear();
+        buffer.put((byte) type);
+        buffer.putInt(len);
+        buffer.put(raw, offset, len);
+        write(output);
+    }
+
+    // Append the message serialized in the buffer to the batch (the pending messages are written first if it does not
+    // fit), compressed if it is large (and compression is enabled)
+    private void write(OutputStream output) throws IOException {
+        int len = buffer.position();
+        if (deflater != null && len >= COMPRESSION_THRESHOLD) {
+            deflater.reset();
+            deflater.setInput(rawBuffer, 0, len);
+            deflater.finish();
+            // Only compress if it saves at least 1 byte, including the header
+            int max = len - COMPRESSED_HEADER_LENGTH - 1;
+            int compressedLength = deflater.deflate(compressionBuffer, 0, max);
+            if (deflater.finished()) {
+                buffer.clear();
+                buffer.put((byte) DeviceMessage.TYPE_COMPRESSED);
+                buffer.putInt(len);
+                buffer.putInt(compressedLength);
+                buffer.put(compressionBuffer, 0, compressedLength);
+                len = buffer.position();
+            }
+        }
+
+        if (batchLength + len > batchBuffer.length) {
+            flush(output);
+        }
+        System.arraycopy(rawBuffer, 0, batchBuffer, batchLength, len);
+        batchLength += len;
+    }
+
+    private void flush(OutputStream output) throws IOException {
+        if (batchLength > 0) {
+            // Reset before writing, so that the pending messages are discarded on error
+            int len = batchLength;
+            batchLength = 0;
+            output.write(batchBuffer, 0, len);
+        }
+    }
 }
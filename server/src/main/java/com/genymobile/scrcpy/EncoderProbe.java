@@ -0,0 +1,207 @@
+package com.genymobile.scrcpy;
+
+import android.annotation.TargetApi;
+import android.media.MediaCodecInfo;
+import android.os.Build;
+import android.util.Range;
+
+import java.io.BufferedReader;
+import java.io.File;
+import java.io.FileReader;
+import java.io.FileWriter;
+import java.io.IOException;
+import java.io.Writer;
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * Select the fastest hardware video encoder able to encode a given size ({@code --video-codec=auto}).
+ * <p>
+ * The encoders are ranked by the frame rate they can achieve at the requested size. The rate comes from the performance points measured by the
+ * device vendor (available since Android 6), or from the advertised capabilities otherwise. No encoding session is needed.
+ * <p>
+ * Listing the codecs may take a significant time on some devices, so the result is cached on the device. The cache is keyed by the build
+ * fingerprint (so it is invalidated by a system update) and the video size.
+ */
+public final class EncoderProbe {
+
+    public static final Size DEFAULT_SIZE = new Size(1920, 1080);
+
+    private static final String CACHE_FILE = "/data/local/tmp/scrcpy-encoder-probe";
+    private static final char SEPARATOR = '\t';
+
+    public static final class Result {
+        private final VideoCodec codec;
+        private final String encoderName;
+        private final double fps;
+
+        Result(VideoCodec codec, String encoderName, double fps) {
+            this.codec = codec;
+            this.encoderName = encoderName;
+            this.fps = fps;
+        }
+
+        public VideoCodec getCodec() {
+            return codec;
+        }
+
+        public String getEncoderName() {
+            return encoderName;
+        }
+
+        public double getFps() {
+            return fps;
+        }
+    }
+
+    private EncoderProbe() {
+        // not instantiable
+    }
+
+    /**
+     * Return the best hardware encoder for the given size, from the cache if available.
+     *
+     * @param size the video size
+     * @return the selected encoder, or {@code null} if no hardware encoder supports the size
+     */
+    public static Result probe(Size size) {
+        String key = Build.FINGERPRINT + SEPARATOR + size.getWidth() + "x" + size.getHeight();
+
+        List<String> lines = readCache();
+        for (String line : lines) {
+            Result result = parseCacheLine(line, key);
+            if (result != null) {
+                Ln.d("Encoder probe: cached result for " + size.getWidth() + "x" + size.getHeight());
+                return result;
+            }
+        }
+
+        Result result = select(size);
+        if (result != null) {
+            writeCache(lines, key, result);
+        }
+        return result;
+    }
+
+    private static Result select(Size size) {
+        int width = size.getWidth();
+        int height = size.getHeight();
+
+        Result best = null;
+        // VideoCodec.values() order: on equal performance, prefer the most compatible codec
+        for (CodecUtils.DeviceEncoder encoder : CodecUtils.listVideoEncoders()) {
+            MediaCodecInfo info = encoder.getInfo();
+            if (!isHardware(info)) {
+                continue;
+            }
+
+            VideoCodec codec = (VideoCodec) encoder.getCodec();
+            double fps = getAchievableFps(info, codec.getMimeType(), width, height);
+            Ln.d("Encoder probe: " + info.getName() + " (" + codec.getName() + "): " + (fps > 0 ? fps + " fps" : "unsupported size"));
+            if (fps > 0 && (best == null || fps > best.getFps())) {
+                best = new Result(codec, info.getName(), fps);
+            }
+        }
+
+        return best;
+    }
+
+    private static boolean isHardware(MediaCodecInfo info) {
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.Q) {
+            return info.isHardwareAccelerated();
+        }
+        // The software encoders provided by the platform
+        String name = info.getName();
+        return !name.startsWith("OMX.google.") && !name.startsWith("c2.android.");
+    }
+
+    private static double getAchievableFps(MediaCodecInfo info, String mimeType, int width, int height) {
+        MediaCodecInfo.VideoCapabilities caps;
+        try {
+            caps = info.getCapabilitiesForType(mimeType).getVideoCapabilities();
+        } catch (IllegalArgumentException e) {
+            return 0;
+        }
+
+        if (caps == null || !caps.isSizeSupported(width, height)) {
+            return 0;
+        }
+
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.M) {
+            Range<Double> measured = getMeasuredFrameRates(caps, width, height);
+            if (measured != null) {
+                return measured.getUpper();
+            }
+        }
+
+        try {
+            return caps.getSupportedFrameRatesFor(width, height).getUpper();
+        } catch (IllegalArgumentException e) {
+            return 0;
+        }
+    }
+
+    @TargetApi(Build.VERSION_CODES.M)
+    private static Range<Double> getMeasuredFrameRates(MediaCodecInfo.VideoCapabilities caps, int width, int height) {
+        try {
+            // null if the vendor did not publish any measurement
+            return caps.getAchievableFrameRatesFor(width, height);
+        } catch (IllegalArgumentException e) {
+            return null;
+        }
+    }
+
+    private static Result parseCacheLine(String line, String key) {
+        if (!line.startsWith(key + SEPARATOR)) {
+            return null;
+        }
+
+        String[] fields = line.substring(key.length() + 1).split(String.valueOf(SEPARATOR));
+        if (fields.length != 3) {
+            return null;
+        }
+
+        VideoCodec codec = VideoCodec.findByName(fields[0]);
+        if (codec == null) {
+            return null;
+        }
+
+        try {
+            return new Result(codec, fields[1], Double.parseDouble(fields[2]));
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static List<String> readCache() {
+        List<String> lines = new ArrayList<>();
+        File file = new File(CACHE_FILE);
+        if (!file.exists()) {
+            return lines;
+        }
+
+        try (BufferedReader reader = new BufferedReader(new FileReader(file))) {
+            String line;
+            while ((line = reader.readLine()) != null) {
+                // entries for other builds are obsolete
+                if (line.startsWith(Build.FINGERPRINT + SEPARATOR)) {
+                    lines.add(line);
+                }
+            }
+        } catch (IOException e) {
+            Ln.w("Could not read encoder probe cache: " + e.getMessage());
+        }
+        return lines;
+    }
+
+    private static void writeCache(List<String> lines, String key, Result result) {
+        try (Writer writer = new FileWriter(CACHE_FILE)) {
+            for (String line : lines) {
+                writer.write(line + "\n");
+            }
+            writer.write(key + SEPARATOR + result.getCodec().getName() + SEPARATOR + result.getEncoderName() + SEPARATOR + result.getFps() + "\n");
+        } catch (IOException e) {
+            Ln.w("Could not write encoder probe cache: " + e.getMessage());
+        }
+    }
+}
@@ -0,0 +1,40 @@
+package com.genymobile.scrcpy;
+
+/**
+ * Map the client event timestamps onto the device uptime.
+ * <p>
+ * The offset between both clocks is estimated from the event which reached the device with the lowest latency, so that the delays between
+ * events are preserved (and a gesture keeps its velocity) regardless of the transport jitter. The mapped times are never in the future.
+ */
+public final class EventTimeMapper {
+
+    // A sudden increase of the latency by more than this value is considered a clock change (e.g. the client clock is reset)
+    private static final long MAX_LATENCY_INCREASE_MS = 1000;
+
+    private boolean initialized;
+    private long offset;
+    private long lastClientTime;
+
+    /**
+     * Map a client event time onto the device uptime.
+     *
+     * @param clientTime the client event time, in milliseconds (0 if unknown)
+     * @param now        the current device uptime, in milliseconds
+     * @return the device event time, in milliseconds
+     */
+    public long map(long clientTime, long now) {
+        if (clientTime == 0) {
+            // unknown
+            return now;
+        }
+
+        long currentOffset = now - clientTime;
+        if (!initialized || currentOffset < offset || clientTime < lastClientTime || currentOffset - offset > MAX_LATENCY_INCREASE_MS) {
+            offset = currentOffset;
+            initialized = true;
+        }
+        lastClientTime = clientTime;
+
+        return clientTime + offset;
+    }
+}
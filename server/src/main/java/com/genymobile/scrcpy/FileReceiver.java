@@ -0,0 +1,120 @@
+package com.genymobile.scrcpy;
+
+import java.io.File;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.io.OutputStream;
+
+/**
+ * Write the files received over the control socket (sent in chunks by the client, between the other control messages).
+ * <p>
+ * Only one file is received at a time. It must only be accessed from the control-recv thread.
+ */
+public final class FileReceiver {
+
+    private File file;
+    private OutputStream output;
+    private long remaining;
+
+    private static File resolve(String target, String name) {
+        File file = new File(target);
+        if (target.endsWith("/") || file.isDirectory()) {
+            // Like "adb push", write the file into the target directory
+            return new File(file, name);
+        }
+        return file;
+    }
+
+    public void start(String target, String name, long size) {
+        if (output != null) {
+            Ln.w("Incomplete file transfer: " + file);
+            abort();
+        }
+
+        if (name.isEmpty() || name.contains("/") || name.equals("..")) {
+            Ln.e("Invalid file name: " + name);
+            return;
+        }
+
+        file = resolve(target, name);
+        try {
+            output = new FileOutputStream(file);
+        } catch (IOException e) {
+            Ln.e("Could not create " + file, e);
+            return;
+        }
+
+        remaining = size;
+        Ln.i("Receiving " + file + " (" + size + " bytes)");
+        if (remaining == 0) {
+            finish();
+        }
+    }
+
+    public void write(byte[] data) {
+        if (output == null) {
+            // The transfer has failed, ignore its remaining chunks
+            return;
+        }
+
+        if (data.length == 0) {
+            Ln.e("File transfer aborted by the client: " + file);
+            abort();
+            return;
+        }
+
+        if (data.length > remaining) {
+            Ln.e("Unexpected data for " + file);
+            abort();
+            return;
+        }
+
+        try {
+            output.write(data);
+        } catch (IOException e) {
+            Ln.e("Could not write " + file, e);
+            abort();
+            return;
+        }
+
+        remaining -= data.length;
+        if (remaining == 0) {
+            finish();
+        }
+    }
+
+    private void finish() {
+        try {
+            output.close();
+            Ln.i("File received: " + file);
+        } catch (IOException e) {
+            Ln.e("Could not write " + file, e);
+            // The file may be truncated
+            deleteFile();
+        }
+        output = null;
+    }
+
+    /**
+     * Abort the current transfer (if any), and remove its partial file.
+     */
+    public void abort() {
+        if (output == null) {
+            return;
+        }
+
+        try {
+            output.close();
+        } catch (IOException e) {
+            // ignore
+        }
+        output = null;
+        deleteFile();
+    }
+
+    private void deleteFile() {
+        if (!file.delete()) {
+            Ln.w("Could not delete " + file);
+        }
+    }
+}
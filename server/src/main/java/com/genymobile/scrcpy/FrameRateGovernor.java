@@ -0,0 +1,135 @@
+package com.genymobile.scrcpy;
+
+import android.opengl.GLES20;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+/**
+ * Decide whether a captured frame is worth encoding, by comparing a downsampled copy with the last encoded frame ({@code --adaptive-fps}).
+ * <p>
+ * The frames are rendered to a small offscreen texture (so the comparison costs a tiny readback, not a full frame copy). A frame is skipped if
+ * no block changed noticeably since the last encoded frame: static content (or imperceptible animations) are encoded at a low rate, while
+ * motion goes through at the full rate.
+ * <p>
+ * Since the comparison is against the last encoded frame (not the previous one), slow changes accumulate until they are encoded. The caller
+ * must still encode the last skipped frame after {@link #IDLE_INTERVAL_NS}, in case a small change (smaller than a block) was missed.
+ */
+public final class FrameRateGovernor {
+
+    // Frames which are skipped are still encoded at least at this interval (so 10 fps)
+    public static final long IDLE_INTERVAL_NS = 100_000_000;
+
+    private static final int DIFF_SIZE = 64;
+    // Minimal difference of a color component of a block to consider that the content changed
+    private static final int THRESHOLD = 12;
+
+    private final Size diffSize = new Size(DIFF_SIZE, DIFF_SIZE);
+    private final ByteBuffer current = ByteBuffer.allocateDirect(DIFF_SIZE * DIFF_SIZE * 4).order(ByteOrder.nativeOrder());
+    private final ByteBuffer reference = ByteBuffer.allocateDirect(DIFF_SIZE * DIFF_SIZE * 4).order(ByteOrder.nativeOrder());
+    private boolean hasReference;
+
+    private int framebuffer;
+    private int texture;
+
+    private int skippedFrames;
+    private int encodedFrames;
+
+    /**
+     * Create the offscreen target (must be called with the OpenGL context current).
+     */
+    public void init() throws IOException {
+        int[] ids = new int[1];
+        GLES20.glGenTextures(1, ids, 0);
+        texture = ids[0];
+        GLES20.glBindTexture(GLES20.GL_TEXTURE_2D, texture);
+        GLES20.glTexImage2D(GLES20.GL_TEXTURE_2D, 0, GLES20.GL_RGBA, DIFF_SIZE, DIFF_SIZE, 0, GLES20.GL_RGBA, GLES20.GL_UNSIGNED_BYTE, null);
+        GLES20.glTexParameteri(GLES20.GL_TEXTURE_2D, GLES20.GL_TEXTURE_MIN_FILTER, GLES20.GL_NEAREST);
+        GLES20.glTexParameteri(GLES20.GL_TEXTURE_2D, GLES20.GL_TEXTURE_MAG_FILTER, GLES20.GL_NEAREST);
+
+        GLES20.glGenFramebuffers(1, ids, 0);
+        framebuffer = ids[0];
+        GLES20.glBindFramebuffer(GLES20.GL_FRAMEBUFFER, framebuffer);
+        GLES20.glFramebufferTexture2D(GLES20.GL_FRAMEBUFFER, GLES20.GL_COLOR_ATTACHMENT0, GLES20.GL_TEXTURE_2D, texture, 0);
+        int status = GLES20.glCheckFramebufferStatus(GLES20.GL_FRAMEBUFFER);
+        GLES20.glBindFramebuffer(GLES20.GL_FRAMEBUFFER, 0);
+        if (status != GLES20.GL_FRAMEBUFFER_COMPLETE) {
+            throw new IOException("Could not create the frame comparison target: 0x" + Integer.toHexString(status));
+        }
+
+        hasReference = false;
+        skippedFrames = 0;
+        encodedFrames = 0;
+    }
+
+    /**
+     * Indicate if the current frame must be encoded.
+     * <p>
+     * If it returns {@code true}, the frame becomes the new reference.
+     *
+     * @param filter the filter to render the frame (so that the masked regions are ignored)
+     * @param textureId the external texture containing the frame
+     * @param texMatrix the transform matrix of the texture
+     * @param inputSize the size of the frame
+     * @return {@code true} if the content changed since the last encoded frame
+     */
+    public boolean hasChanged(VideoFilter filter, int textureId, float[] texMatrix, Size inputSize) {
+        GLES20.glBindFramebuffer(GLES20.GL_FRAMEBUFFER, framebuffer);
+        filter.draw(textureId, texMatrix, inputSize, diffSize);
+        current.clear();
+        GLES20.glReadPixels(0, 0, DIFF_SIZE, DIFF_SIZE, GLES20.GL_RGBA, GLES20.GL_UNSIGNED_BYTE, current);
+        GLES20.glBindFramebuffer(GLES20.GL_FRAMEBUFFER, 0);
+
+        if (hasReference && !differs(current, reference)) {
+            ++skippedFrames;
+            return false;
+        }
+
+        // The current frame becomes the reference
+        reference.clear();
+        current.clear();
+        reference.put(current);
+        hasReference = true;
+        ++encodedFrames;
+        return true;
+    }
+
+    /**
+     * Mark that the last skipped frame has been encoded anyway (after {@link #IDLE_INTERVAL_NS}).
+     */
+    public void onIdleFrameEncoded() {
+        // It is close to the reference anyway
+        --skippedFrames;
+        ++encodedFrames;
+    }
+
+    private static boolean differs(ByteBuffer a, ByteBuffer b) {
+        int size = DIFF_SIZE * DIFF_SIZE * 4;
+        for (int i = 0; i < size; ++i) {
+            // alpha is always 255
+            int diff = (a.get(i) & 0xff) - (b.get(i) & 0xff);
+            if (diff > THRESHOLD || diff < -THRESHOLD) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Release the offscreen target (must be called with the OpenGL context current).
+     */
+    public void release() {
+        if (skippedFrames > 0 || encodedFrames > 0) {
+            Ln.d("Adaptive frame rate: " + encodedFrames + " frames encoded, " + skippedFrames + " skipped");
+        }
+        if (framebuffer != 0) {
+            GLES20.glDeleteFramebuffers(1, new int[] {framebuffer}, 0);
+            framebuffer = 0;
+        }
+        if (texture != 0) {
+            GLES20.glDeleteTextures(1, new int[] {texture}, 0);
+            texture = 0;
+        }
+    }
+}
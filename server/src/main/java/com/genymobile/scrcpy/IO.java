@@ -40,6 +40,75 @@ public final class IO {
         writeFully(fd, ByteBuffer.wrap(buffer, offset, len));
     }
 
+    /**
+     * Write the remaining bytes of all the buffers, using a single gathering write system call whenever possible.
+     * <p>
+     * The positions of the buffers are updated.
+     */
+    public static void writeFully(FileDescriptor fd, ByteBuffer... buffers) throws IOException {
+        int count = buffers.length;
+        writeFully(fd, buffers, new Object[count], new int[count], new int[count]);
+    }
+
+    /**
+     * Same as {@link #writeFully(FileDescriptor, ByteBuffer...)}, using the given arrays (at least as large as {@code buffers}) as scratch space, so
+     * that a caller writing on every packet does not allocate anything.
+     */
+    public static void writeFully(FileDescriptor fd, ByteBuffer[] buffers, Object[] vectors, int[] offsets, int[] byteCounts) throws IOException {
+        int count = buffers.length;
+        for (int i = 0; i < count; ++i) {
+            ByteBuffer buffer = buffers[i];
+            if (buffer.isDirect()) {
+                // For a direct buffer, the offset is relative to its address
+                vectors[i] = buffer;
+                offsets[i] = buffer.position();
+            } else if (buffer.hasArray()) {
+                // Os.writev() only accepts direct ByteBuffers, pass the backing array instead
+                vectors[i] = buffer.array();
+                offsets[i] = buffer.arrayOffset() + buffer.position();
+            } else {
+                // Cannot be written in a single system call
+                for (ByteBuffer b : buffers) {
+                    writeFully(fd, b);
+                }
+                return;
+            }
+            byteCounts[i] = buffer.remaining();
+        }
+
+        int first = 0; // the first buffer having remaining bytes
+        while (true) {
+            while (first < count && byteCounts[first] == 0) {
+                ++first;
+            }
+            if (first == count) {
+                return;
+            }
+
+            try {
+                // Os.writev() does not update the positions of the ByteBuffers
+                int w = Os.writev(fd, vectors, offsets, byteCounts);
+                if (BuildConfig.DEBUG && w < 0) {
+                    // w should not be negative, since an exception is thrown on error
+                    throw new AssertionError("Os.writev() returned a negative value (" + w + ")");
+                }
+
+                // Skip the bytes written (a write may be partial)
+                for (int i = first; i < count && w > 0; ++i) {
+                    int consumed = Math.min(w, byteCounts[i]);
+                    offsets[i] += consumed;
+                    byteCounts[i] -= consumed;
+                    buffers[i].position(buffers[i].position() + consumed);
+                    w -= consumed;
+                }
+            } catch (ErrnoException e) {
+                if (e.errno != OsConstants.EINTR) {
+                    throw new IOException(e);
+                }
+            }
+        }
+    }
+
     public static String toString(InputStream inputStream) {
         StringBuilder builder = new StringBuilder();
         Scanner scanner = new Scanner(inputStream);
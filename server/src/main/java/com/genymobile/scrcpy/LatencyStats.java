@@ -0,0 +1,75 @@
+package com.genymobile.scrcpy;
+
+import java.util.Arrays;
+import java.util.Locale;
+
+/**
+ * Rolling window of latency samples (in microseconds), to compute percentiles.
+ * <p>
+ * The latency is measured from the capture timestamp (the PTS of the frame), which is based on {@link System#nanoTime()} for display capture.
+ * Samples which could not be measured (e.g. a negative value due to a capture timestamp expressed in another time base) are ignored.
+ */
+public final class LatencyStats {
+
+    private static final int CAPACITY = 1024;
+
+    private final String name;
+    private final long[] values = new long[CAPACITY];
+    private int head; // index of the next value to write
+    private int count;
+
+    public LatencyStats(String name) {
+        this.name = name;
+    }
+
+    public void add(long valueUs) {
+        if (valueUs < 0) {
+            return;
+        }
+        values[head] = valueUs;
+        head = (head + 1) % CAPACITY;
+        if (count < CAPACITY) {
+            ++count;
+        }
+    }
+
+    public int getCount() {
+        return count;
+    }
+
+    /**
+     * Compute the percentiles (nearest-rank method) of the current samples.
+     *
+     * @param percents the percentiles to compute, between 0 and 100
+     * @return the values, or {@code null} if there are no samples
+     */
+    public long[] getPercentiles(int... percents) {
+        if (count == 0) {
+            return null;
+        }
+
+        // The order of the values in the window does not matter
+        long[] sorted = Arrays.copyOf(values, count);
+        Arrays.sort(sorted);
+
+        long[] result = new long[percents.length];
+        for (int i = 0; i < percents.length; ++i) {
+            int rank = (percents[i] * count + 99) / 100;
+            result[i] = sorted[rank > 0 ? rank - 1 : 0];
+        }
+        return result;
+    }
+
+    /**
+     * Format the p50, p95 and p99 values.
+     *
+     * @return the formatted string, or {@code null} if there are no samples
+     */
+    public String format() {
+        long[] p = getPercentiles(50, 95, 99);
+        if (p == null) {
+            return null;
+        }
+        return String.format(Locale.US, "%s p50=%.1fms p95=%.1fms p99=%.1fms (%d frames)", name, p[0] / 1000f, p[1] / 1000f, p[2] / 1000f, count);
+    }
+}
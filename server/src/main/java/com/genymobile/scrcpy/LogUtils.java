@@ -126,7 +126,8 @@ public final class LogUtils {
                         if (highSpeedSizes.length > 0) {
                             builder.append("\n      High speed capture (--camera-high-speed):");
                             for (android.util.Size size : highSpeedSizes) {
-                                Range<Integer>[] highFpsRanges = configs.getHighSpeedVideoFpsRanges();
+                                // The available frame rates depend on the size
+                                Range<Integer>[] highFpsRanges = configs.getHighSpeedVideoFpsRangesFor(size);
                                 SortedSet<Integer> uniqueHighFps = getUniqueSet(highFpsRanges);
                                 builder.append("\n        - ").append(size.getWidth()).append("x").append(size.getHeight());
                                 builder.append(" (fps=").append(uniqueHighFps).append(')');
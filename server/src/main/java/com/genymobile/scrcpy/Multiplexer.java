@@ -0,0 +1,273 @@
+package com.genymobile.scrcpy;
+
+import android.net.LocalSocket;
+import android.system.ErrnoException;
+import android.system.Os;
+import android.system.OsConstants;
+
+import java.io.DataInputStream;
+import java.io.FileDescriptor;
+import java.io.IOException;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.concurrent.PriorityBlockingQueue;
+import java.util.concurrent.Semaphore;
+import java.util.concurrent.atomic.AtomicLong;
+
+/**
+ * Transmit all the streams (video, audio, control and record video) over a single socket.
+ * <p>
+ * Each stream is exposed as a local socket pair, so that the streamers and the control channel are not aware of the multiplexing. On the
+ * wire, each chunk is prefixed by a 5-byte header: the stream id (1 byte) and the payload length (4 bytes, big-endian).
+ * <p>
+ * When several streams have pending data, the control chunks are sent first, then audio, then video. Since a chunk is always written entirely,
+ * the video is split into smaller chunks if other streams are transmitted, so that an audio or control chunk never waits for a large video
+ * chunk to be written.
+ */
+public final class Multiplexer {
+
+    public static final int STREAM_VIDEO = 0;
+    public static final int STREAM_AUDIO = 1;
+    public static final int STREAM_CONTROL = 2;
+    public static final int STREAM_RECORD_VIDEO = 3;
+    private static final int STREAM_COUNT = 4;
+
+    // Indexed by stream id, the lower the value, the higher the priority
+    private static final int[] PRIORITIES = {2, 1, 0, 3};
+
+    private static final int HEADER_LENGTH = 5;
+    // Must match the client
+    private static final int MAX_CHUNK_SIZE = 1 << 16;
+    // Maximum size of the video chunks if other streams are transmitted
+    private static final int PREEMPTIBLE_CHUNK_SIZE = 1 << 13;
+    // Maximum number of bytes of a single stream waiting to be sent
+    private static final int MAX_PENDING_BYTES = 4 * MAX_CHUNK_SIZE;
+
+    private static final class Chunk implements Comparable<Chunk> {
+        private final int stream;
+        private final long sequence;
+        private final byte[] data; // including the header
+        private final int length;
+
+        Chunk(int stream, long sequence, byte[] data, int length) {
+            this.stream = stream;
+            this.sequence = sequence;
+            this.data = data;
+            this.length = length;
+        }
+
+        @Override
+        public int compareTo(Chunk other) {
+            int cmp = Integer.compare(PRIORITIES[stream], PRIORITIES[other.stream]);
+            if (cmp != 0) {
+                return cmp;
+            }
+            // Never reorder the chunks of the same stream
+            return Long.compare(sequence, other.sequence);
+        }
+    }
+
+    private final LocalSocket socket;
+    private final FileDescriptor fd;
+
+    // For each enabled stream, the multiplexer side and the stream side of the socket pair
+    private final FileDescriptor[] localFds = new FileDescriptor[STREAM_COUNT];
+    private final FileDescriptor[] streamFds = new FileDescriptor[STREAM_COUNT];
+    private final Semaphore[] pendingChunks = new Semaphore[STREAM_COUNT];
+    private final int[] chunkSizes = new int[STREAM_COUNT];
+
+    private final PriorityBlockingQueue<Chunk> queue = new PriorityBlockingQueue<>();
+    private final AtomicLong sequence = new AtomicLong();
+
+    private final List<Thread> threads = new ArrayList<>();
+    private Thread sendThread;
+
+    public Multiplexer(LocalSocket socket, boolean video, boolean audio, boolean control, boolean recordVideo) throws IOException {
+        this.socket = socket;
+        this.fd = socket.getFileDescriptor();
+
+        boolean[] enabled = {video, audio, control, recordVideo};
+        // The video streams have the lowest priorities
+        boolean preemptible = audio || control;
+        try {
+            for (int i = 0; i < STREAM_COUNT; ++i) {
+                if (enabled[i]) {
+                    FileDescriptor localFd = new FileDescriptor();
+                    FileDescriptor streamFd = new FileDescriptor();
+                    Os.socketpair(OsConstants.AF_UNIX, OsConstants.SOCK_STREAM, 0, localFd, streamFd);
+                    localFds[i] = localFd;
+                    streamFds[i] = streamFd;
+                    boolean isVideo = i == STREAM_VIDEO || i == STREAM_RECORD_VIDEO;
+                    chunkSizes[i] = isVideo && preemptible ? PREEMPTIBLE_CHUNK_SIZE : MAX_CHUNK_SIZE;
+                    pendingChunks[i] = new Semaphore(MAX_PENDING_BYTES / chunkSizes[i]);
+                }
+            }
+        } catch (ErrnoException e) {
+            closeFds();
+            throw new IOException(e);
+        }
+    }
+
+    /**
+     * Return the file descriptor to read or write the given stream ({@code null} if the stream is disabled).
+     */
+    public FileDescriptor getFd(int stream) {
+        return streamFds[stream];
+    }
+
+    public void setSendBufferSize(int size) throws IOException {
+        socket.setSendBufferSize(size);
+    }
+
+    public void start() {
+        for (int i = 0; i < STREAM_COUNT; ++i) {
+            if (localFds[i] != null) {
+                final int stream = i;
+                threads.add(new Thread(() -> runStreamReader(stream), "mux-read-" + stream));
+            }
+        }
+
+        if (localFds[STREAM_CONTROL] != null) {
+            threads.add(new Thread(this::runReceiver, "mux-recv"));
+        }
+
+        sendThread = new Thread(this::runSender, "mux-send");
+        threads.add(sendThread);
+
+        for (Thread thread : threads) {
+            thread.start();
+        }
+    }
+
+    private void runStreamReader(int stream) {
+        FileDescriptor localFd = localFds[stream];
+        Semaphore pending = pendingChunks[stream];
+        int chunkSize = chunkSizes[stream];
+        try {
+            while (true) {
+                pending.acquire();
+
+                byte[] data = new byte[HEADER_LENGTH + chunkSize];
+                int r = read(localFd, data, HEADER_LENGTH, chunkSize);
+                if (r <= 0) {
+                    // End of stream
+                    break;
+                }
+
+                data[0] = (byte) stream;
+                data[1] = (byte) (r >> 24);
+                data[2] = (byte) (r >> 16);
+                data[3] = (byte) (r >> 8);
+                data[4] = (byte) r;
+                queue.put(new Chunk(stream, sequence.getAndIncrement(), data, HEADER_LENGTH + r));
+            }
+        } catch (IOException | InterruptedException e) {
+            // this is expected on close
+        } finally {
+            shutdown();
+        }
+    }
+
+    private void runSender() {
+        try {
+            while (!Thread.currentThread().isInterrupted()) {
+                Chunk chunk = queue.take();
+                IO.writeFully(fd, chunk.data, 0, chunk.length);
+                pendingChunks[chunk.stream].release();
+            }
+        } catch (IOException | InterruptedException e) {
+            // this is expected on close
+        } finally {
+            shutdown();
+        }
+    }
+
+    private void runReceiver() {
+        FileDescriptor controlFd = localFds[STREAM_CONTROL];
+        byte[] buffer = new byte[MAX_CHUNK_SIZE];
+        try {
+            DataInputStream input = new DataInputStream(socket.getInputStream());
+            while (true) {
+                int stream = input.readUnsignedByte();
+                int length = input.readInt();
+                if (stream != STREAM_CONTROL || length < 0 || length > MAX_CHUNK_SIZE) {
+                    Ln.e("Invalid multiplexed chunk (stream " + stream + ", length " + length + ")");
+                    break;
+                }
+
+                input.readFully(buffer, 0, length);
+                IO.writeFully(controlFd, buffer, 0, length);
+            }
+        } catch (IOException e) {
+            // this is expected on close (EOFException when the client disconnects)
+        } finally {
+            shutdown();
+        }
+    }
+
+    private static int read(FileDescriptor fd, byte[] buffer, int offset, int length) throws IOException {
+        while (true) {
+            try {
+                return Os.read(fd, buffer, offset, length);
+            } catch (ErrnoException e) {
+                if (e.errno != OsConstants.EINTR) {
+                    throw new IOException(e);
+                }
+            }
+        }
+    }
+
+    /**
+     * Interrupt the multiplexed socket and the streams (the stream writers will get a broken pipe, and the stream readers the end of stream).
+     */
+    public synchronized void shutdown() {
+        for (FileDescriptor localFd : localFds) {
+            if (localFd != null) {
+                try {
+                    Os.shutdown(localFd, OsConstants.SHUT_RDWR);
+                } catch (ErrnoException e) {
+                    // ignore
+                }
+            }
+        }
+
+        try {
+            socket.shutdownInput();
+            socket.shutdownOutput();
+        } catch (IOException e) {
+            // ignore
+        }
+
+        if (sendThread != null) {
+            sendThread.interrupt();
+        }
+    }
+
+    public void join() throws InterruptedException {
+        for (Thread thread : threads) {
+            thread.join();
+        }
+    }
+
+    public void close() throws IOException {
+        closeFds();
+        socket.close();
+    }
+
+    private void closeFds() {
+        for (int i = 0; i < STREAM_COUNT; ++i) {
+            closeFd(localFds[i]);
+            closeFd(streamFds[i]);
+        }
+    }
+
+    private static void closeFd(FileDescriptor fd) {
+        if (fd != null && fd.valid()) {
+            try {
+                Os.close(fd);
+            } catch (ErrnoException e) {
+                // ignore
+            }
+        }
+    }
+}
@@ -0,0 +1,56 @@
+package com.genymobile.scrcpy;
+
+/**
+ * Properties of a virtual display created by the server (--new-display).
+ */
+public final class NewDisplay {
+    private final Size size; // null for the main display size
+    private final int dpi; // 0 for the main display density
+
+    public NewDisplay(Size size, int dpi) {
+        this.size = size;
+        this.dpi = dpi;
+    }
+
+    public Size getSize() {
+        return size;
+    }
+
+    public int getDpi() {
+        return dpi;
+    }
+
+    /**
+     * Parse the new display properties.
+     *
+     * @param value the value, in the format "[<width>x<height>][/<dpi>]" (possibly empty)
+     * @return the new display
+     */
+    public static NewDisplay parse(String value) {
+        Size size = null;
+        int dpi = 0;
+
+        int index = value.indexOf('/');
+        String sizeString = index == -1 ? value : value.substring(0, index);
+        if (!sizeString.isEmpty()) {
+            String[] tokens = sizeString.split("x");
+            if (tokens.length != 2) {
+                throw new IllegalArgumentException("Invalid new display size (expected <width>x<height>): \"" + sizeString + "\"");
+            }
+            int width = Integer.parseInt(tokens[0]);
+            int height = Integer.parseInt(tokens[1]);
+            if (width <= 0 || height <= 0) {
+                throw new IllegalArgumentException("Invalid new display size: \"" + sizeString + "\"");
+            }
+            size = new Size(width, height);
+        }
+        if (index != -1) {
+            dpi = Integer.parseInt(value.substring(index + 1));
+            if (dpi <= 0) {
+                throw new IllegalArgumentException("Invalid new display dpi: " + dpi);
+            }
+        }
+
+        return new NewDisplay(size, dpi);
+    }
+}
@@ -0,0 +1,124 @@
+package com.genymobile.scrcpy;
+
+import com.genymobile.scrcpy.wrappers.ServiceManager;
+
+import android.hardware.display.VirtualDisplay;
+import android.os.Build;
+import android.util.DisplayMetrics;
+import android.view.Surface;
+
+/**
+ * Capture of a virtual display created by the server (--new-display).
+ * <p>
+ * The virtual display renders directly to the encoder surface: the content is composed once, and the pixels of the main display are not
+ * captured at all.
+ */
+public class NewDisplayCapture extends SurfaceCapture implements Device.RotationListener {
+
+    // Flags from android.hardware.display.DisplayManager (some of them are hidden)
+    private static final int VIRTUAL_DISPLAY_FLAG_PUBLIC = 1;
+    private static final int VIRTUAL_DISPLAY_FLAG_OWN_CONTENT_ONLY = 1 << 3;
+    private static final int VIRTUAL_DISPLAY_FLAG_SUPPORTS_TOUCH = 1 << 6;
+    private static final int VIRTUAL_DISPLAY_FLAG_ROTATES_WITH_CONTENT = 1 << 7;
+    private static final int VIRTUAL_DISPLAY_FLAG_DESTROY_CONTENT_ON_REMOVAL = 1 << 8;
+    private static final int VIRTUAL_DISPLAY_FLAG_TRUSTED = 1 << 10;
+    private static final int VIRTUAL_DISPLAY_FLAG_OWN_DISPLAY_GROUP = 1 << 11;
+    private static final int VIRTUAL_DISPLAY_FLAG_ALWAYS_UNLOCKED = 1 << 12;
+
+    private final VirtualDisplay virtualDisplay;
+    private final Device device;
+
+    public NewDisplayCapture(VirtualDisplay virtualDisplay, Device device) {
+        this.virtualDisplay = virtualDisplay;
+        this.device = device;
+    }
+
+    /**
+     * Create the virtual display, without surface (it is set when the capture starts).
+     * <p>
+     * The display size is limited by {@code maxSize}, so that the display content is never scaled.
+     *
+     * @param newDisplay the requested properties
+     * @param maxSize the maximum video size (0 for no limit)
+     * @return the virtual display
+     */
+    public static VirtualDisplay createDisplay(NewDisplay newDisplay, int maxSize) throws ConfigurationException {
+        Size size = newDisplay.getSize();
+        if (size == null) {
+            DisplayInfo mainDisplayInfo = ServiceManager.getDisplayManager().getDisplayInfo(0);
+            if (mainDisplayInfo == null) {
+                throw new ConfigurationException("Could not get the main display size");
+            }
+            size = mainDisplayInfo.getSize();
+        }
+        int dpi = newDisplay.getDpi();
+        if (dpi == 0) {
+            // The system context uses the configuration of the main display
+            dpi = FakeContext.get().getResources().getDisplayMetrics().densityDpi;
+            if (dpi == 0) {
+                dpi = DisplayMetrics.DENSITY_DEFAULT;
+            }
+        }
+
+        int width = size.getWidth();
+        int height = size.getHeight();
+        if (maxSize > 0 && Math.max(width, height) > maxSize) {
+            boolean portrait = height > width;
+            int minor = (portrait ? width : height) * maxSize / Math.max(width, height);
+            width = portrait ? minor : maxSize;
+            height = portrait ? maxSize : minor;
+        }
+        // The encoder requires multiples of 8
+        width &= ~7;
+        height &= ~7;
+
+        int flags = VIRTUAL_DISPLAY_FLAG_PUBLIC | VIRTUAL_DISPLAY_FLAG_OWN_CONTENT_ONLY | VIRTUAL_DISPLAY_FLAG_SUPPORTS_TOUCH
+                | VIRTUAL_DISPLAY_FLAG_ROTATES_WITH_CONTENT | VIRTUAL_DISPLAY_FLAG_DESTROY_CONTENT_ON_REMOVAL;
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.TIRAMISU) {
+            flags |= VIRTUAL_DISPLAY_FLAG_TRUSTED | VIRTUAL_DISPLAY_FLAG_OWN_DISPLAY_GROUP | VIRTUAL_DISPLAY_FLAG_ALWAYS_UNLOCKED;
+        }
+
+        try {
+            VirtualDisplay virtualDisplay = ServiceManager.getDisplayManager().createNewVirtualDisplay("scrcpy", width, height, dpi, null, flags);
+            int displayId = virtualDisplay.getDisplay().getDisplayId();
+            Ln.i("New display: " + width + "x" + height + "/" + dpi + " (id=" + displayId + ")");
+            return virtualDisplay;
+        } catch (Exception e) {
+            Ln.e("Could not create the new display", e);
+            throw new ConfigurationException("Could not create the new display");
+        }
+    }
+
+    @Override
+    public void init() {
+        device.addRotationListener(this);
+    }
+
+    @Override
+    public void start(Surface surface) {
+        virtualDisplay.setSurface(surface);
+    }
+
+    @Override
+    public void release() {
+        device.removeRotationListener(this);
+        // The virtual display itself is released by the server, it may be reused by the next session (--daemon)
+        virtualDisplay.setSurface(null);
+    }
+
+    @Override
+    public Size getSize() {
+        return device.getScreenInfo().getVideoSize();
+    }
+
+    @Override
+    public boolean setMaxSize(int maxSize) {
+        // The display content would be scaled, the size is fixed on creation
+        return false;
+    }
+
+    @Override
+    public void onRotationChanged(int rotation) {
+        requestReset();
+    }
+}
@@ -0,0 +1,278 @@
+package com.genymobile.scrcpy;
+
+import android.graphics.SurfaceTexture;
+import android.opengl.EGL14;
+import android.opengl.EGLConfig;
+import android.opengl.EGLContext;
+import android.opengl.EGLDisplay;
+import android.opengl.EGLExt;
+import android.opengl.EGLSurface;
+import android.opengl.GLES11Ext;
+import android.opengl.GLES20;
+import android.os.Handler;
+import android.os.HandlerThread;
+import android.view.Surface;
+
+import java.io.IOException;
+import java.util.concurrent.Callable;
+import java.util.concurrent.ExecutionException;
+import java.util.concurrent.FutureTask;
+
+/**
+ * OpenGL stage between the capture and the encoder.
+ * <p>
+ * The capture renders to a {@link SurfaceTexture}; on each frame, the {@link VideoFilter} draws it to the encoder input surface, keeping the
+ * original timestamp. Everything runs on a dedicated thread owning the OpenGL context, and the frame never leaves the GPU.
+ * <p>
+ * With a {@link FrameRateGovernor}, the frames which do not change the content noticeably are not drawn (so not encoded).
+ */
+public final class OpenGLRunner {
+
+    // EGL_RECORDABLE_ANDROID, for a surface consumed by a video encoder
+    private static final int EGL_RECORDABLE_ANDROID = 0x3142;
+
+    private final VideoFilter filter;
+    // null to draw all the frames
+    private final FrameRateGovernor governor;
+
+    private HandlerThread thread;
+    private Handler handler;
+
+    // Only accessed from the OpenGL thread
+    private EGLDisplay eglDisplay = EGL14.EGL_NO_DISPLAY;
+    private EGLContext eglContext = EGL14.EGL_NO_CONTEXT;
+    private EGLSurface eglSurface = EGL14.EGL_NO_SURFACE;
+    private int textureId;
+    private SurfaceTexture surfaceTexture;
+    private Surface inputSurface;
+    private final float[] texMatrix = new float[16];
+    private Size inputSize;
+    private Size outputSize;
+    // true if the texture contains a frame which has been skipped by the governor
+    private boolean pendingFrame;
+    private long lastDrawNs;
+    private final Runnable drawPendingFrame = this::drawPendingFrame;
+
+    public OpenGLRunner(VideoFilter filter, FrameRateGovernor governor) {
+        this.filter = filter;
+        this.governor = governor;
+    }
+
+    /**
+     * Start the OpenGL stage.
+     *
+     * @param inputSize the size of the frames rendered by the capture
+     * @param outputSize the size of the output surface
+     * @param outputSurface the encoder input surface
+     * @return the surface to render the capture to
+     */
+    public Surface start(Size inputSize, Size outputSize, Surface outputSurface) throws IOException {
+        thread = new HandlerThread("video-opengl");
+        thread.start();
+        handler = new Handler(thread.getLooper());
+
+        try {
+            return runOnThread(() -> {
+                init(inputSize, outputSize, outputSurface);
+                return inputSurface;
+            });
+        } catch (IOException | RuntimeException e) {
+            stop();
+            throw e;
+        }
+    }
+
+    /**
+     * Stop the OpenGL stage and release its resources.
+     */
+    public void stop() {
+        if (thread == null) {
+            return;
+        }
+
+        try {
+            runOnThread(() -> {
+                release();
+                return null;
+            });
+        } catch (IOException e) {
+            // release() does not throw
+            throw new AssertionError(e);
+        }
+
+        thread.quitSafely();
+        try {
+            thread.join();
+        } catch (InterruptedException e) {
+            Thread.currentThread().interrupt();
+        }
+        thread = null;
+        handler = null;
+    }
+
+    private <T> T runOnThread(Callable<T> callable) throws IOException {
+        FutureTask<T> task = new FutureTask<>(callable);
+        handler.post(task);
+        try {
+            return task.get();
+        } catch (InterruptedException e) {
+            Thread.currentThread().interrupt();
+            throw new IOException("Interrupted", e);
+        } catch (ExecutionException e) {
+            Throwable cause = e.getCause();
+            if (cause instanceof IOException) {
+                throw (IOException) cause;
+            }
+            if (cause instanceof RuntimeException) {
+                throw (RuntimeException) cause;
+            }
+            throw new AssertionError(cause);
+        }
+    }
+
+    private void init(Size inputSize, Size outputSize, Surface outputSurface) throws IOException {
+        this.inputSize = inputSize;
+        this.outputSize = outputSize;
+
+        eglDisplay = EGL14.eglGetDisplay(EGL14.EGL_DEFAULT_DISPLAY);
+        if (eglDisplay == EGL14.EGL_NO_DISPLAY) {
+            throw new IOException("Could not get the OpenGL display");
+        }
+
+        int[] version = new int[2];
+        if (!EGL14.eglInitialize(eglDisplay, version, 0, version, 1)) {
+            throw new IOException("Could not initialize OpenGL");
+        }
+
+        int[] attribList = {
+                EGL14.EGL_RED_SIZE, 8,
+                EGL14.EGL_GREEN_SIZE, 8,
+                EGL14.EGL_BLUE_SIZE, 8,
+                EGL14.EGL_RENDERABLE_TYPE, EGL14.EGL_OPENGL_ES2_BIT,
+                EGL_RECORDABLE_ANDROID, 1,
+                EGL14.EGL_NONE,
+        };
+        EGLConfig[] configs = new EGLConfig[1];
+        int[] numConfigs = new int[1];
+        if (!EGL14.eglChooseConfig(eglDisplay, attribList, 0, configs, 0, 1, numConfigs, 0) || numConfigs[0] == 0) {
+            throw new IOException("No OpenGL config available for video encoding");
+        }
+
+        int[] contextAttribs = {EGL14.EGL_CONTEXT_CLIENT_VERSION, 2, EGL14.EGL_NONE};
+        eglContext = EGL14.eglCreateContext(eglDisplay, configs[0], EGL14.EGL_NO_CONTEXT, contextAttribs, 0);
+        if (eglContext == EGL14.EGL_NO_CONTEXT) {
+            throw new IOException("Could not create the OpenGL context");
+        }
+
+        int[] surfaceAttribs = {EGL14.EGL_NONE};
+        eglSurface = EGL14.eglCreateWindowSurface(eglDisplay, configs[0], outputSurface, surfaceAttribs, 0);
+        if (eglSurface == EGL14.EGL_NO_SURFACE) {
+            throw new IOException("Could not create the OpenGL surface");
+        }
+
+        if (!EGL14.eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext)) {
+            throw new IOException("Could not make the OpenGL context current");
+        }
+
+        int[] textures = new int[1];
+        GLES20.glGenTextures(1, textures, 0);
+        textureId = textures[0];
+        GLES20.glBindTexture(GLES11Ext.GL_TEXTURE_EXTERNAL_OES, textureId);
+        GLES20.glTexParameteri(GLES11Ext.GL_TEXTURE_EXTERNAL_OES, GLES20.GL_TEXTURE_MIN_FILTER, GLES20.GL_LINEAR);
+        GLES20.glTexParameteri(GLES11Ext.GL_TEXTURE_EXTERNAL_OES, GLES20.GL_TEXTURE_MAG_FILTER, GLES20.GL_LINEAR);
+        GLES20.glTexParameteri(GLES11Ext.GL_TEXTURE_EXTERNAL_OES, GLES20.GL_TEXTURE_WRAP_S, GLES20.GL_CLAMP_TO_EDGE);
+        GLES20.glTexParameteri(GLES11Ext.GL_TEXTURE_EXTERNAL_OES, GLES20.GL_TEXTURE_WRAP_T, GLES20.GL_CLAMP_TO_EDGE);
+
+        filter.init();
+        if (governor != null) {
+            governor.init();
+        }
+
+        surfaceTexture = new SurfaceTexture(textureId);
+        surfaceTexture.setDefaultBufferSize(inputSize.getWidth(), inputSize.getHeight());
+        // Called on the OpenGL thread
+        surfaceTexture.setOnFrameAvailableListener(st -> render(), handler);
+        inputSurface = new Surface(surfaceTexture);
+    }
+
+    private void render() {
+        if (surfaceTexture == null) {
+            // already released
+            return;
+        }
+
+        surfaceTexture.updateTexImage();
+        surfaceTexture.getTransformMatrix(texMatrix);
+
+        if (governor != null && !governor.hasChanged(filter, textureId, texMatrix, inputSize)) {
+            if (!pendingFrame) {
+                pendingFrame = true;
+                // Draw it anyway later if no other frame replaces it, so that the last state is eventually encoded
+                long delayNs = Math.max(0, lastDrawNs + FrameRateGovernor.IDLE_INTERVAL_NS - System.nanoTime());
+                handler.postDelayed(drawPendingFrame, delayNs / 1_000_000);
+            }
+            return;
+        }
+
+        draw();
+    }
+
+    private void drawPendingFrame() {
+        if (surfaceTexture == null || !pendingFrame) {
+            return;
+        }
+        governor.onIdleFrameEncoded();
+        draw();
+    }
+
+    private void draw() {
+        if (pendingFrame) {
+            pendingFrame = false;
+            handler.removeCallbacks(drawPendingFrame);
+        }
+        lastDrawNs = System.nanoTime();
+
+        filter.draw(textureId, texMatrix, inputSize, outputSize);
+
+        // Keep the capture timestamp, for the encoder and the latency measurements
+        EGLExt.eglPresentationTimeANDROID(eglDisplay, eglSurface, surfaceTexture.getTimestamp());
+        if (!EGL14.eglSwapBuffers(eglDisplay, eglSurface)) {
+            // The encoder surface may be released before the OpenGL stage is stopped, on reset
+            Ln.v("OpenGL: could not swap buffers: 0x" + Integer.toHexString(EGL14.eglGetError()));
+        }
+    }
+
+    private void release() {
+        handler.removeCallbacks(drawPendingFrame);
+        pendingFrame = false;
+        if (surfaceTexture != null) {
+            surfaceTexture.setOnFrameAvailableListener(null);
+            inputSurface.release();
+            surfaceTexture.release();
+            surfaceTexture = null;
+            inputSurface = null;
+        }
+
+        if (eglDisplay != EGL14.EGL_NO_DISPLAY) {
+            if (eglContext != EGL14.EGL_NO_CONTEXT && eglSurface != EGL14.EGL_NO_SURFACE) {
+                if (governor != null) {
+                    governor.release();
+                }
+                filter.release();
+                GLES20.glDeleteTextures(1, new int[] {textureId}, 0);
+            }
+            EGL14.eglMakeCurrent(eglDisplay, EGL14.EGL_NO_SURFACE, EGL14.EGL_NO_SURFACE, EGL14.EGL_NO_CONTEXT);
+            if (eglSurface != EGL14.EGL_NO_SURFACE) {
+                EGL14.eglDestroySurface(eglDisplay, eglSurface);
+            }
+            if (eglContext != EGL14.EGL_NO_CONTEXT) {
+                EGL14.eglDestroyContext(eglDisplay, eglContext);
+            }
+            EGL14.eglTerminate(eglDisplay);
+        }
+
+        eglDisplay = EGL14.EGL_NO_DISPLAY;
+        eglContext = EGL14.EGL_NO_CONTEXT;
+        eglSurface = EGL14.EGL_NO_SURFACE;
+    }
+}
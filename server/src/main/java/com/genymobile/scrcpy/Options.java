@@ -2,6 +2,8 @@ package com.genymobile.scrcpy;
 
 import android.graphics.Rect;
 
+import java.util.ArrayList;
+import java.util.Collections;
 import java.util.List;
 import java.util.Locale;
 
@@ -13,23 +15,41 @@ public class Options {
     private boolean audio = true;
     private int maxSize;
     private VideoCodec videoCodec = VideoCodec.H264;
+    private boolean videoCodecAuto; // select the codec and the encoder on the device
     private AudioCodec audioCodec = AudioCodec.OPUS;
     private VideoSource videoSource = VideoSource.DISPLAY;
     private AudioSource audioSource = AudioSource.OUTPUT;
     private int videoBitRate = 8000000;
+    private int recordVideoBitRate; // 0 if there is no separate record video stream
+    private VideoSource recordVideoSource = VideoSource.DISPLAY;
     private int audioBitRate = 128000;
+    private int audioSampleRate = AudioCapture.DEFAULT_SAMPLE_RATE;
+    private int audioChannels = AudioCapture.DEFAULT_CHANNELS;
+    private int audioReadSize = AudioCapture.DEFAULT_READ_SIZE; // in samples
     private int maxFps;
+    private int videoRepeatDelay = 100; // ms, 0 to never repeat frames
     private int lockVideoOrientation = -1;
+    private boolean squareVideo;
+    private boolean gpuDownscale;
+    private boolean adaptiveFps;
+    private boolean thermalGovernor;
+    private List<Rect> videoMasks = Collections.emptyList(); // in percent of the video frame
     private boolean tunnelForward;
     private Rect crop;
     private boolean control = true;
+    private boolean controlCompression;
     private int displayId;
+    private NewDisplay newDisplay; // null to mirror an existing display
     private String cameraId;
     private Size cameraSize;
     private CameraFacing cameraFacing;
     private CameraAspectRatio cameraAspectRatio;
     private int cameraFps;
+    private Size patternSize;
+    private int patternFps;
     private boolean cameraHighSpeed;
+    private boolean cameraLowLatency;
+    private boolean cameraLockAeAf;
     private boolean showTouches;
     private boolean stayAwake;
     private List<CodecOption> videoCodecOptions;
@@ -40,8 +60,21 @@ public class Options {
     private boolean powerOffScreenOnClose;
     private boolean clipboardAutosync = true;
     private boolean downsizeOnError = true;
+    private boolean lowLatencyProfile;
+    private boolean videoIntraRefresh;
+    private boolean videoHdr;
     private boolean cleanup = true;
     private boolean powerOn = true;
+    private boolean latencyStats;
+    private boolean encoderStats;
+    private int daemonIdleTimeout; // in milliseconds, 0 to exit after the first session
+    private int socketBufferSize; // in bytes, 0 for the system default
+    private boolean videoPacing;
+    private boolean multiplex;
+    private boolean videoReconnect;
+    private int directPort; // 0 to use the adb tunnel
+    private byte[] directToken;
+    private boolean directUdp;
 
     private boolean listEncoders;
     private boolean listDisplays;
@@ -78,6 +111,18 @@ public class Options {
         return videoCodec;
     }
 
+    public boolean getVideoCodecAuto() {
+        return videoCodecAuto;
+    }
+
+    /**
+     * Apply the codec and the encoder selected on the device (if {@link #getVideoCodecAuto()}).
+     */
+    public void setSelectedVideoEncoder(VideoCodec codec, String encoderName) {
+        videoCodec = codec;
+        videoEncoder = encoderName;
+    }
+
     public AudioCodec getAudioCodec() {
         return audioCodec;
     }
@@ -94,18 +139,62 @@ public class Options {
         return videoBitRate;
     }
 
+    public int getRecordVideoBitRate() {
+        return recordVideoBitRate;
+    }
+
+    public VideoSource getRecordVideoSource() {
+        return recordVideoSource;
+    }
+
     public int getAudioBitRate() {
         return audioBitRate;
     }
 
+    public int getAudioSampleRate() {
+        return audioSampleRate;
+    }
+
+    public int getAudioChannels() {
+        return audioChannels;
+    }
+
+    public int getAudioReadSize() {
+        return audioReadSize;
+    }
+
     public int getMaxFps() {
         return maxFps;
     }
 
+    public int getVideoRepeatDelay() {
+        return videoRepeatDelay;
+    }
+
     public int getLockVideoOrientation() {
         return lockVideoOrientation;
     }
 
+    public boolean getSquareVideo() {
+        return squareVideo;
+    }
+
+    public boolean getGpuDownscale() {
+        return gpuDownscale;
+    }
+
+    public List<Rect> getVideoMasks() {
+        return videoMasks;
+    }
+
+    public boolean getAdaptiveFps() {
+        return adaptiveFps;
+    }
+
+    public boolean getThermalGovernor() {
+        return thermalGovernor;
+    }
+
     public boolean isTunnelForward() {
         return tunnelForward;
     }
@@ -118,10 +207,18 @@ public class Options {
         return control;
     }
 
+    public boolean getControlCompression() {
+        return controlCompression;
+    }
+
     public int getDisplayId() {
         return displayId;
     }
 
+    public NewDisplay getNewDisplay() {
+        return newDisplay;
+    }
+
     public String getCameraId() {
         return cameraId;
     }
@@ -142,10 +239,26 @@ public class Options {
         return cameraFps;
     }
 
+    public Size getPatternSize() {
+        return patternSize;
+    }
+
+    public int getPatternFps() {
+        return patternFps;
+    }
+
     public boolean getCameraHighSpeed() {
         return cameraHighSpeed;
     }
 
+    public boolean getCameraLowLatency() {
+        return cameraLowLatency;
+    }
+
+    public boolean getCameraLockAeAf() {
+        return cameraLockAeAf;
+    }
+
     public boolean getShowTouches() {
         return showTouches;
     }
@@ -182,6 +295,19 @@ public class Options {
         return downsizeOnError;
     }
 
+    public boolean getLowLatencyProfile() {
+        return lowLatencyProfile;
+    }
+
+    public boolean getVideoIntraRefresh() {
+        // The low latency profile implies intra refresh
+        return videoIntraRefresh || lowLatencyProfile;
+    }
+
+    public boolean getVideoHdr() {
+        return videoHdr;
+    }
+
     public boolean getCleanup() {
         return cleanup;
     }
@@ -190,6 +316,46 @@ public class Options {
         return powerOn;
     }
 
+    public boolean getLatencyStats() {
+        return latencyStats;
+    }
+
+    public boolean getEncoderStats() {
+        return encoderStats;
+    }
+
+    public int getDaemonIdleTimeout() {
+        return daemonIdleTimeout;
+    }
+
+    public int getSocketBufferSize() {
+        return socketBufferSize;
+    }
+
+    public boolean getMultiplex() {
+        return multiplex;
+    }
+
+    public boolean getVideoPacing() {
+        return videoPacing;
+    }
+
+    public boolean getVideoReconnect() {
+        return videoReconnect;
+    }
+
+    public int getDirectPort() {
+        return directPort;
+    }
+
+    public byte[] getDirectToken() {
+        return directToken;
+    }
+
+    public boolean getDirectUdp() {
+        return directUdp;
+    }
+
     public boolean getList() {
         return listEncoders || listDisplays || listCameras || listCameraSizes;
     }
@@ -266,6 +432,10 @@ public class Options {
                     options.audio = Boolean.parseBoolean(value);
                     break;
                 case "video_codec":
+                    if ("auto".equals(value)) {
+                        options.videoCodecAuto = true;
+                        break;
+                    }
                     VideoCodec videoCodec = VideoCodec.findByName(value);
                     if (videoCodec == null) {
                         throw new IllegalArgumentException("Video codec " + value + " not supported");
@@ -299,15 +469,79 @@ public class Options {
                 case "video_bit_rate":
                     options.videoBitRate = Integer.parseInt(value);
                     break;
+                case "record_video_bit_rate":
+                    options.recordVideoBitRate = Integer.parseInt(value);
+                    break;
+                case "record_video_source":
+                    VideoSource recordVideoSource = VideoSource.findByName(value);
+                    if (recordVideoSource == null || recordVideoSource == VideoSource.PATTERN) {
+                        throw new IllegalArgumentException("Record video source " + value + " not supported");
+                    }
+                    options.recordVideoSource = recordVideoSource;
+                    break;
                 case "audio_bit_rate":
                     options.audioBitRate = Integer.parseInt(value);
                     break;
+                case "audio_sample_rate":
+                    int audioSampleRate = Integer.parseInt(value);
+                    if (audioSampleRate <= 0) {
+                        throw new IllegalArgumentException("Invalid audio sample rate: " + audioSampleRate);
+                    }
+                    options.audioSampleRate = audioSampleRate;
+                    break;
+                case "audio_channels":
+                    int audioChannels = Integer.parseInt(value);
+                    if (audioChannels != 1 && audioChannels != 2) {
+                        throw new IllegalArgumentException("Invalid audio channels: " + audioChannels);
+                    }
+                    options.audioChannels = audioChannels;
+                    break;
+                case "audio_read_size":
+                    int audioReadSize = Integer.parseInt(value);
+                    if (audioReadSize <= 0) {
+                        throw new IllegalArgumentException("Invalid audio read size: " + audioReadSize);
+                    }
+                    options.audioReadSize = audioReadSize;
+                    break;
                 case "max_fps":
                     options.maxFps = Integer.parseInt(value);
                     break;
+                case "video_latency_profile":
+                    if ("low".equals(value)) {
+                        options.lowLatencyProfile = true;
+                    } else if (!"default".equals(value)) {
+                        throw new IllegalArgumentException("Video latency profile " + value + " not supported");
+                    }
+                    break;
+                case "video_intra_refresh":
+                    options.videoIntraRefresh = Boolean.parseBoolean(value);
+                    break;
+                case "video_hdr":
+                    options.videoHdr = Boolean.parseBoolean(value);
+                    break;
+                case "video_repeat_delay":
+                    options.videoRepeatDelay = Integer.parseInt(value);
+                    break;
                 case "lock_video_orientation":
                     options.lockVideoOrientation = Integer.parseInt(value);
                     break;
+                case "square_video":
+                    options.squareVideo = Boolean.parseBoolean(value);
+                    break;
+                case "gpu_downscale":
+                    options.gpuDownscale = Boolean.parseBoolean(value);
+                    break;
+                case "adaptive_fps":
+                    options.adaptiveFps = Boolean.parseBoolean(value);
+                    break;
+                case "thermal_governor":
+                    options.thermalGovernor = Boolean.parseBoolean(value);
+                    break;
+                case "video_masks":
+                    if (!value.isEmpty()) {
+                        options.videoMasks = parseVideoMasks(value);
+                    }
+                    break;
                 case "tunnel_forward":
                     options.tunnelForward = Boolean.parseBoolean(value);
                     break;
@@ -319,6 +553,12 @@ public class Options {
                 case "control":
                     options.control = Boolean.parseBoolean(value);
                     break;
+                case "control_compression":
+                    options.controlCompression = Boolean.parseBoolean(value);
+                    break;
+                case "new_display":
+                    options.newDisplay = NewDisplay.parse(value);
+                    break;
                 case "display_id":
                     options.displayId = Integer.parseInt(value);
                     break;
@@ -358,6 +598,48 @@ public class Options {
                 case "power_on":
                     options.powerOn = Boolean.parseBoolean(value);
                     break;
+                case "latency_stats":
+                    options.latencyStats = Boolean.parseBoolean(value);
+                    break;
+                case "encoder_stats":
+                    options.encoderStats = Boolean.parseBoolean(value);
+                    break;
+                case "daemon_idle_timeout":
+                    int daemonIdleTimeout = Integer.parseInt(value);
+                    if (daemonIdleTimeout < 0) {
+                        throw new IllegalArgumentException("daemon_idle_timeout may not be negative: " + daemonIdleTimeout);
+                    }
+                    options.daemonIdleTimeout = daemonIdleTimeout;
+                    break;
+                case "multiplex":
+                    options.multiplex = Boolean.parseBoolean(value);
+                    break;
+                case "video_pacing":
+                    options.videoPacing = Boolean.parseBoolean(value);
+                    break;
+                case "video_reconnect":
+                    options.videoReconnect = Boolean.parseBoolean(value);
+                    break;
+                case "direct_port":
+                    int directPort = Integer.parseInt(value);
+                    if (directPort <= 0 || directPort > 0xFFFF) {
+                        throw new IllegalArgumentException("Invalid direct port: " + directPort);
+                    }
+                    options.directPort = directPort;
+                    break;
+                case "direct_token":
+                    options.directToken = parseHex(value);
+                    break;
+                case "direct_udp":
+                    options.directUdp = Boolean.parseBoolean(value);
+                    break;
+                case "socket_buffer_size":
+                    int socketBufferSize = Integer.parseInt(value);
+                    if (socketBufferSize <= 0) {
+                        throw new IllegalArgumentException("Invalid socket buffer size: " + socketBufferSize);
+                    }
+                    options.socketBufferSize = socketBufferSize;
+                    break;
                 case "list_encoders":
                     options.listEncoders = Boolean.parseBoolean(value);
                     break;
@@ -397,9 +679,23 @@ public class Options {
                 case "camera_fps":
                     options.cameraFps = Integer.parseInt(value);
                     break;
+                case "pattern_size":
+                    if (!value.isEmpty()) {
+                        options.patternSize = parseSize(value);
+                    }
+                    break;
+                case "pattern_fps":
+                    options.patternFps = Integer.parseInt(value);
+                    break;
                 case "camera_high_speed":
                     options.cameraHighSpeed = Boolean.parseBoolean(value);
                     break;
+                case "camera_low_latency":
+                    options.cameraLowLatency = Boolean.parseBoolean(value);
+                    break;
+                case "camera_lock_ae_af":
+                    options.cameraLockAeAf = Boolean.parseBoolean(value);
+                    break;
                 case "send_device_meta":
                     options.sendDeviceMeta = Boolean.parseBoolean(value);
                     break;
@@ -443,6 +739,23 @@ public class Options {
         return new Rect(x, y, x + width, y + height);
     }
 
+    private static List<Rect> parseVideoMasks(String masks) {
+        // input format: "width:height:x:y[,...]", in percent of the video frame
+        String[] tokens = masks.split(",");
+        if (tokens.length > VideoFilter.MAX_MASKS) {
+            throw new IllegalArgumentException("At most " + VideoFilter.MAX_MASKS + " video masks are supported: \"" + masks + "\"");
+        }
+        List<Rect> result = new ArrayList<>(tokens.length);
+        for (String token : tokens) {
+            Rect mask = parseCrop(token);
+            if (mask.left < 0 || mask.top < 0 || mask.right > 100 || mask.bottom > 100 || mask.isEmpty()) {
+                throw new IllegalArgumentException("Invalid video mask (expected percents of the video frame): \"" + token + "\"");
+            }
+            result.add(mask);
+        }
+        return result;
+    }
+
     private static Size parseSize(String size) {
         // input format: "<width>x<height>"
         String[] tokens = size.split("x");
@@ -469,4 +782,16 @@ public class Options {
         float floatAr = Float.parseFloat(tokens[0]);
         return CameraAspectRatio.fromFloat(floatAr);
     }
+
+    private static byte[] parseHex(String hex) {
+        if (hex.isEmpty() || hex.length() % 2 != 0) {
+            throw new IllegalArgumentException("Invalid hexadecimal value: " + hex);
+        }
+
+        byte[] bytes = new byte[hex.length() / 2];
+        for (int i = 0; i < bytes.length; ++i) {
+            bytes[i] = (byte) Integer.parseInt(hex.substring(2 * i, 2 * i + 2), 0x10);
+        }
+        return bytes;
+    }
 }
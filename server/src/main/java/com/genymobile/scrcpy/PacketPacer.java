@@ -0,0 +1,54 @@
+package com.genymobile.scrcpy;
+
+/**
+ * Pace the write of large video packets (typically keyframes), so that they are not written to the socket in a single burst.
+ * <p>
+ * A large packet is split into chunks, written at a rate proportional to the current video bit rate: the network queues (e.g. Wi-Fi) are not
+ * overflowed, and the packets of the other streams (audio) are sent between the chunks.
+ */
+public final class PacketPacer {
+
+    static final int CHUNK_SIZE = 16 * 1024;
+    // Write the chunks faster than the average video bit rate, so that the pacing only spreads the bursts
+    static final int RATE_FACTOR = 4;
+
+    private long bytesPerSecond;
+
+    public PacketPacer(int bitRate) {
+        setBitRate(bitRate);
+    }
+
+    /**
+     * Set the video bit rate (it may change while streaming).
+     * <p>
+     * This method is called from the video encoding thread.
+     *
+     * @param bitRate the video bit rate (bits per second)
+     */
+    public void setBitRate(int bitRate) {
+        if (bitRate <= 0) {
+            throw new IllegalArgumentException("Invalid bit rate: " + bitRate);
+        }
+        bytesPerSecond = (long) bitRate * RATE_FACTOR / 8;
+    }
+
+    /**
+     * Indicate whether a packet must be paced (a packet which fits in a single chunk is written at once).
+     *
+     * @param size the packet size
+     * @return {@code true} if the packet must be split into chunks
+     */
+    public static boolean mustPace(int size) {
+        return size > CHUNK_SIZE;
+    }
+
+    /**
+     * Return the delay, since the start of the packet write, before writing the chunk starting at {@code offset}.
+     *
+     * @param offset the offset of the chunk in the packet
+     * @return the delay (µs)
+     */
+    public long getChunkDelayUs(int offset) {
+        return offset * 1_000_000L / bytesPerSecond;
+    }
+}
@@ -0,0 +1,155 @@
+package com.genymobile.scrcpy;
+
+import android.annotation.TargetApi;
+import android.graphics.Canvas;
+import android.graphics.Color;
+import android.graphics.Paint;
+import android.os.Build;
+import android.os.SystemClock;
+import android.view.Surface;
+
+import java.io.IOException;
+
+/**
+ * Synthetic video source rendering a moving test pattern ({@code --video-source=pattern}).
+ * <p>
+ * It drives the whole pipeline (encoder, socket, client decoding and rendering) at a configurable resolution and frame rate, independently of
+ * the device screen, to load-test the client (many sessions may run on the same device).
+ * <p>
+ * Every frame changes (a moving box and a frame counter over color bars), so that the encoder cannot skip any of them.
+ */
+public class PatternCapture extends SurfaceCapture {
+
+    public static final Size DEFAULT_SIZE = new Size(1920, 1080);
+    public static final int DEFAULT_FPS = 60;
+
+    private static final int[] BAR_COLORS = {Color.WHITE, Color.YELLOW, Color.CYAN, Color.GREEN, Color.MAGENTA, Color.RED, Color.BLUE};
+
+    private final Size requestedSize;
+    private final int fps;
+    private final int maxSize;
+    private Size size;
+
+    private final Paint paint = new Paint();
+    private Thread thread;
+
+    public PatternCapture(Size size, int fps, int maxSize) {
+        this.requestedSize = size != null ? size : DEFAULT_SIZE;
+        this.fps = fps > 0 ? fps : DEFAULT_FPS;
+        this.maxSize = maxSize;
+    }
+
+    @Override
+    public void init() throws IOException {
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.M) {
+            // The encoder surface may only be drawn by a hardware canvas
+            throw new IOException("The pattern video source requires Android 6+");
+        }
+        // The encoder requires multiples of 8
+        size = new Size(requestedSize.getWidth() & ~7, requestedSize.getHeight() & ~7);
+        if (maxSize > 0) {
+            setMaxSize(maxSize);
+        }
+        paint.setAntiAlias(false);
+    }
+
+    @Override
+    public void start(Surface surface) {
+        stopThread();
+        thread = new Thread(() -> render(surface), "pattern");
+        thread.start();
+    }
+
+    @Override
+    public void release() {
+        stopThread();
+    }
+
+    private void stopThread() {
+        if (thread != null) {
+            thread.interrupt();
+            try {
+                thread.join();
+            } catch (InterruptedException e) {
+                Thread.currentThread().interrupt();
+            }
+            thread = null;
+        }
+    }
+
+    @Override
+    public Size getSize() {
+        return size;
+    }
+
+    @Override
+    public boolean setMaxSize(int maxSize) {
+        int width = size.getWidth();
+        int height = size.getHeight();
+        if (Math.max(width, height) <= maxSize) {
+            return false;
+        }
+
+        boolean portrait = height > width;
+        int minor = (portrait ? width : height) * maxSize / Math.max(width, height);
+        // The encoder requires multiples of 8
+        width = (portrait ? minor : maxSize) & ~7;
+        height = (portrait ? maxSize : minor) & ~7;
+        size = new Size(width, height);
+        return true;
+    }
+
+    private void render(Surface surface) {
+        long frameIntervalNs = 1_000_000_000L / fps;
+        long next = SystemClock.elapsedRealtimeNanos();
+        long frame = 0;
+        try {
+            while (!Thread.currentThread().isInterrupted()) {
+                drawFrame(surface, frame++);
+
+                next += frameIntervalNs;
+                long delayNs = next - SystemClock.elapsedRealtimeNanos();
+                if (delayNs > 0) {
+                    Thread.sleep(delayNs / 1_000_000, (int) (delayNs % 1_000_000));
+                } else {
+                    // Too slow, do not try to catch up
+                    next = SystemClock.elapsedRealtimeNanos();
+                }
+            }
+        } catch (InterruptedException e) {
+            // stopped
+        } catch (IllegalStateException | IllegalArgumentException e) {
+            // The surface has been released (the encoder is restarting or stopping)
+            Ln.d("Pattern rendering stopped: " + e.getMessage());
+        }
+    }
+
+    @TargetApi(Build.VERSION_CODES.M)
+    private void drawFrame(Surface surface, long frame) {
+        int width = size.getWidth();
+        int height = size.getHeight();
+
+        Canvas canvas = surface.lockHardwareCanvas();
+        try {
+            int barWidth = (width + BAR_COLORS.length - 1) / BAR_COLORS.length;
+            for (int i = 0; i < BAR_COLORS.length; ++i) {
+                paint.setColor(BAR_COLORS[i]);
+                canvas.drawRect(i * barWidth, 0, (i + 1) * barWidth, height, paint);
+            }
+
+            // A box moving horizontally, one revolution every 2 seconds
+            int boxSize = Math.min(width, height) / 4;
+            long period = 2L * fps;
+            int x = (int) ((width - boxSize) * (frame % period) / period);
+            int y = (height - boxSize) / 2;
+            paint.setColor(Color.BLACK);
+            canvas.drawRect(x, y, x + boxSize, y + boxSize, paint);
+
+            paint.setColor(Color.WHITE);
+            paint.setTextSize(boxSize / 4f);
+            canvas.drawText(Long.toString(frame), x + boxSize / 10f, y + boxSize / 2f, paint);
+        } finally {
+            surface.unlockCanvasAndPost(canvas);
+        }
+    }
+}
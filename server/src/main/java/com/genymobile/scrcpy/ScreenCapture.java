@@ -9,31 +9,49 @@ import android.os.Build;
 import android.os.IBinder;
 import android.view.Surface;
 
+import java.io.IOException;
+
 public class ScreenCapture extends SurfaceCapture implements Device.RotationListener, Device.FoldListener {
 
     private final Device device;
-    private IBinder display;
+    // read from the rotation listener, without the capture lock
+    private volatile IBinder display;
     private VirtualDisplay virtualDisplay;
+    // the size of the current encoding session
+    private volatile Size canvasSize;
+
+    // null to render the display directly to the encoder surface
+    private final VideoFilter filter;
+    // null to encode all the frames
+    private final FrameRateGovernor governor;
+    private OpenGLRunner glRunner;
+    // ratio between the size of the display rendering and the video size (greater than 1 if the frames are downscaled on the GPU)
+    private volatile float renderScale = 1;
 
     public ScreenCapture(Device device) {
+        this(device, null, false);
+    }
+
+    public ScreenCapture(Device device, VideoFilter filter, boolean adaptiveFps) {
         this.device = device;
+        this.filter = filter;
+        this.governor = filter != null && adaptiveFps ? new FrameRateGovernor() : null;
     }
 
     @Override
     public void init() {
-        device.setRotationListener(this);
-        device.setFoldListener(this);
+        device.addRotationListener(this);
+        device.addFoldListener(this);
     }
 
     @Override
-    public void start(Surface surface) {
+    public synchronized void start(Surface surface) throws IOException {
         ScreenInfo screenInfo = device.getScreenInfo();
         Rect contentRect = screenInfo.getContentRect();
 
-        // does not include the locked video orientation
-        Rect unlockedVideoRect = screenInfo.getUnlockedVideoSize().toRect();
         int videoRotation = screenInfo.getVideoRotation();
         int layerStack = device.getLayerStack();
+        canvasSize = screenInfo.getCanvasSize();
 
         if (display != null) {
             SurfaceControl.destroyDisplay(display);
@@ -43,16 +61,32 @@ public class ScreenCapture extends SurfaceCapture implements Device.RotationList
             virtualDisplay.release();
             virtualDisplay = null;
         }
+        stopOpenGL();
+
+        float scale = filter != null && filter.isDownscale() ? computeRenderScale(screenInfo) : 1;
+        Size renderSize = scaleSize(canvasSize, scale);
+        if (filter != null && (scale > 1 || filter.hasMasks() || governor != null)) {
+            glRunner = new OpenGLRunner(filter, governor);
+            surface = glRunner.start(renderSize, canvasSize, surface);
+            Ln.d("Display: rendering at " + renderSize.getWidth() + "x" + renderSize.getHeight() + " through OpenGL");
+        } else {
+            // nothing to do on the GPU for this session
+            scale = 1;
+            renderSize = canvasSize;
+        }
+        renderScale = scale;
+
+        // does not include the locked video orientation
+        Rect unlockedVideoRect = scaleRect(screenInfo.getUnlockedContentVideoRect(), scale);
 
         try {
             display = createDisplay();
             setDisplaySurface(display, surface, videoRotation, contentRect, unlockedVideoRect, layerStack);
             Ln.d("Display: using SurfaceControl API");
         } catch (Exception surfaceControlException) {
-            Rect videoRect = screenInfo.getVideoSize().toRect();
             try {
                 virtualDisplay = ServiceManager.getDisplayManager()
-                        .createVirtualDisplay("scrcpy", videoRect.width(), videoRect.height(), device.getDisplayId(), surface);
+                        .createVirtualDisplay("scrcpy", renderSize.getWidth(), renderSize.getHeight(), device.getDisplayId(), surface);
                 Ln.d("Display: using DisplayManager API");
             } catch (Exception displayManagerException) {
                 Ln.e("Could not create display using SurfaceControl", surfaceControlException);
@@ -64,16 +98,61 @@ public class ScreenCapture extends SurfaceCapture implements Device.RotationList
 
     @Override
     public void release() {
-        device.setRotationListener(null);
-        device.setFoldListener(null);
+        device.removeRotationListener(this);
+        device.removeFoldListener(this);
         if (display != null) {
             SurfaceControl.destroyDisplay(display);
         }
+        stopOpenGL();
+    }
+
+    private void stopOpenGL() {
+        if (glRunner != null) {
+            glRunner.stop();
+            glRunner = null;
+        }
+    }
+
+    /**
+     * Return the scale to render the display at, so that the GPU downscales it to the video size.
+     * <p>
+     * Rendering at twice the video size is enough for the 4-tap filter to take all the pixels into account, and never above the device size
+     * (SurfaceFlinger would upscale it).
+     */
+    private static float computeRenderScale(ScreenInfo screenInfo) {
+        Rect contentRect = screenInfo.getContentRect();
+        Size videoSize = screenInfo.getUnlockedVideoSize();
+        int contentMajor = Math.max(contentRect.width(), contentRect.height());
+        int videoMajor = Math.max(videoSize.getWidth(), videoSize.getHeight());
+        if (videoMajor == 0) {
+            return 1;
+        }
+        float scale = Math.min(2f, (float) contentMajor / videoMajor);
+        // below that, the GPU stage would only add a resampling
+        return scale >= 1.25f ? scale : 1;
+    }
+
+    private static Size scaleSize(Size size, float scale) {
+        if (scale == 1) {
+            return size;
+        }
+        // keep even dimensions
+        int w = Math.round(size.getWidth() * scale / 2) * 2;
+        int h = Math.round(size.getHeight() * scale / 2) * 2;
+        return new Size(w, h);
+    }
+
+    private static Rect scaleRect(Rect rect, float scale) {
+        if (scale == 1) {
+            return rect;
+        }
+        return new Rect(Math.round(rect.left * scale), Math.round(rect.top * scale), Math.round(rect.right * scale),
+                Math.round(rect.bottom * scale));
     }
 
     @Override
     public Size getSize() {
-        return device.getScreenInfo().getVideoSize();
+        return device.getScreenInfo().getCanvasSize();
     }
 
     @Override
@@ -82,6 +161,24 @@ public class ScreenCapture extends SurfaceCapture implements Device.RotationList
         return true;
     }
 
+    @Override
+    public synchronized boolean setCrop(Rect region) {
+        if (display == null) {
+            // the DisplayManager API mirrors the whole display
+            Ln.w("The crop cannot be changed using the DisplayManager API");
+            return false;
+        }
+
+        ScreenInfo screenInfo = device.setCrop(region);
+        if (screenInfo == null) {
+            return false;
+        }
+
+        // The video size is the same, so only the projection changes, the display and the encoder are kept
+        setDisplayProjection(display, screenInfo);
+        return true;
+    }
+
     @Override
     public void onFoldChanged(int displayId, boolean folded) {
         requestReset();
@@ -89,6 +186,17 @@ public class ScreenCapture extends SurfaceCapture implements Device.RotationList
 
     @Override
     public void onRotationChanged(int rotation) {
+        // Called with the device lock held, do not take the capture lock (setCrop() takes both locks in the reverse order)
+        IBinder currentDisplay = display;
+        ScreenInfo screenInfo = device.getScreenInfo();
+        if (currentDisplay != null && screenInfo.getCanvasSize().equals(canvasSize)) {
+            // The encoded size does not change (180° rotation, or square canvas), so only update the projection, without restarting the
+            // encoder (which would cause a visible freeze)
+            setDisplayProjection(currentDisplay, screenInfo);
+            Ln.d("Rotation applied without reset");
+            return;
+        }
+
         requestReset();
     }
 
@@ -100,6 +208,17 @@ public class ScreenCapture extends SurfaceCapture implements Device.RotationList
         return SurfaceControl.createDisplay("scrcpy", secure);
     }
 
+    private void setDisplayProjection(IBinder display, ScreenInfo screenInfo) {
+        // The canvas size is unchanged, so the render scale too
+        Rect unlockedVideoRect = scaleRect(screenInfo.getUnlockedContentVideoRect(), renderScale);
+        SurfaceControl.openTransaction();
+        try {
+            SurfaceControl.setDisplayProjection(display, screenInfo.getVideoRotation(), screenInfo.getContentRect(), unlockedVideoRect);
+        } finally {
+            SurfaceControl.closeTransaction();
+        }
+    }
+
     private static void setDisplaySurface(IBinder display, Surface surface, int orientation, Rect deviceRect, Rect displayRect, int layerStack) {
         SurfaceControl.openTransaction();
         try {
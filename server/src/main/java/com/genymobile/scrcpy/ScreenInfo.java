@@ -25,11 +25,17 @@ public final class ScreenInfo {
      */
     private final int lockedVideoOrientation;
 
-    public ScreenInfo(Rect contentRect, Size unlockedVideoSize, int deviceRotation, int lockedVideoOrientation) {
+    /**
+     * Letterbox the video content in a square canvas, so that the encoded size does not change on device rotation
+     */
+    private final boolean squareCanvas;
+
+    public ScreenInfo(Rect contentRect, Size unlockedVideoSize, int deviceRotation, int lockedVideoOrientation, boolean squareCanvas) {
         this.contentRect = contentRect;
         this.unlockedVideoSize = unlockedVideoSize;
         this.deviceRotation = deviceRotation;
         this.lockedVideoOrientation = lockedVideoOrientation;
+        this.squareCanvas = squareCanvas;
     }
 
     public Rect getContentRect() {
@@ -58,6 +64,46 @@ public final class ScreenInfo {
         return unlockedVideoSize.rotate();
     }
 
+    /**
+     * Return the size of the encoded video, as if locked video orientation was not set.
+     * <p>
+     * It is the video size, unless the content is letterboxed in a square canvas.
+     *
+     * @return the unlocked canvas size
+     */
+    public Size getUnlockedCanvasSize() {
+        if (!squareCanvas) {
+            return unlockedVideoSize;
+        }
+        int side = Math.max(unlockedVideoSize.getWidth(), unlockedVideoSize.getHeight());
+        return new Size(side, side);
+    }
+
+    /**
+     * Return the actual size of the encoded video.
+     *
+     * @return the canvas size
+     */
+    public Size getCanvasSize() {
+        if (!squareCanvas) {
+            return getVideoSize();
+        }
+        // a square is not changed by the locked video orientation
+        return getUnlockedCanvasSize();
+    }
+
+    /**
+     * Return the location of the video content in the unlocked canvas (centered).
+     *
+     * @return the content rectangle, in unlocked canvas coordinates
+     */
+    public Rect getUnlockedContentVideoRect() {
+        Size canvasSize = getUnlockedCanvasSize();
+        int left = (canvasSize.getWidth() - unlockedVideoSize.getWidth()) / 2;
+        int top = (canvasSize.getHeight() - unlockedVideoSize.getHeight()) / 2;
+        return new Rect(left, top, left + unlockedVideoSize.getWidth(), top + unlockedVideoSize.getHeight());
+    }
+
     public int getDeviceRotation() {
         return deviceRotation;
     }
@@ -77,10 +123,57 @@ public final class ScreenInfo {
             newContentRect = contentRect;
             newUnlockedVideoSize = unlockedVideoSize;
         }
-        return new ScreenInfo(newContentRect, newUnlockedVideoSize, newDeviceRotation, lockedVideoOrientation);
+        return new ScreenInfo(newContentRect, newUnlockedVideoSize, newDeviceRotation, lockedVideoOrientation, squareCanvas);
+    }
+
+    /**
+     * Return a screen info capturing another region of the device screen in the same video size, so that it can be applied by changing the
+     * display projection, without reconfiguring the encoder.
+     * <p>
+     * The region is enlarged around its center to the aspect ratio of the video (or shrunk if it would exceed the device screen).
+     *
+     * @param region the region to capture, in the current device orientation, or {@code null} for the whole screen
+     * @param deviceSize the device size, in the current device orientation
+     * @return the new screen info, or {@code null} if the region does not intersect the device screen
+     */
+    public ScreenInfo withContentRegion(Rect region, Size deviceSize) {
+        int deviceWidth = deviceSize.getWidth();
+        int deviceHeight = deviceSize.getHeight();
+        int videoWidth = unlockedVideoSize.getWidth();
+        int videoHeight = unlockedVideoSize.getHeight();
+
+        Rect rect = new Rect(0, 0, deviceWidth, deviceHeight);
+        if (region != null && !rect.intersect(region)) {
+            return null;
+        }
+        if (rect.isEmpty() || videoWidth == 0 || videoHeight == 0) {
+            return null;
+        }
+
+        long w = rect.width();
+        long h = rect.height();
+        if (w * videoHeight > h * videoWidth) {
+            h = w * videoHeight / videoWidth;
+        } else {
+            w = h * videoWidth / videoHeight;
+        }
+        if (w > deviceWidth) {
+            h = h * deviceWidth / w;
+            w = deviceWidth;
+        }
+        if (h > deviceHeight) {
+            w = w * deviceHeight / h;
+            h = deviceHeight;
+        }
+
+        int left = (int) Math.max(0, Math.min(rect.centerX() - w / 2, deviceWidth - w));
+        int top = (int) Math.max(0, Math.min(rect.centerY() - h / 2, deviceHeight - h));
+        Rect newContentRect = new Rect(left, top, left + (int) w, top + (int) h);
+        return new ScreenInfo(newContentRect, unlockedVideoSize, deviceRotation, lockedVideoOrientation, squareCanvas);
     }
 
-    public static ScreenInfo computeScreenInfo(int rotation, Size deviceSize, Rect crop, int maxSize, int lockedVideoOrientation) {
+    public static ScreenInfo computeScreenInfo(int rotation, Size deviceSize, Rect crop, int maxSize, int lockedVideoOrientation,
+            boolean squareCanvas) {
         if (lockedVideoOrientation == Device.LOCK_VIDEO_ORIENTATION_INITIAL) {
             // The user requested to lock the video orientation to the current orientation
             lockedVideoOrientation = rotation;
@@ -100,7 +193,7 @@ public final class ScreenInfo {
         }
 
         Size videoSize = computeVideoSize(contentRect.width(), contentRect.height(), maxSize);
-        return new ScreenInfo(contentRect, videoSize, rotation, lockedVideoOrientation);
+        return new ScreenInfo(contentRect, videoSize, rotation, lockedVideoOrientation, squareCanvas);
     }
 
     private static String formatCrop(Rect rect) {
@@ -134,7 +227,7 @@ public final class ScreenInfo {
         return new Size(w, h);
     }
 
-    private static Rect flipRect(Rect crop) {
+    static Rect flipRect(Rect crop) {
         return new Rect(crop.top, crop.left, crop.bottom, crop.right);
     }
 
@@ -1,5 +1,7 @@
 package com.genymobile.scrcpy;
 
+import android.hardware.display.VirtualDisplay;
+import android.net.LocalServerSocket;
 import android.os.BatteryManager;
 import android.os.Build;
 
@@ -94,14 +96,39 @@ public final class Server {
                 Ln.e("Could not power off screen on exit");
             }
         }
+
+        // The settings are not accessed anymore by the server (the clean up process uses its own ContentProvider)
+        Settings.release();
     }
 
     private static void scrcpy(Options options) throws IOException, ConfigurationException {
-        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.S && options.getVideoSource() == VideoSource.CAMERA) {
+        boolean cameraRecord = options.getRecordVideoBitRate() > 0 && options.getRecordVideoSource() == VideoSource.CAMERA;
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.S && (options.getVideoSource() == VideoSource.CAMERA || cameraRecord)) {
             Ln.e("Camera mirroring is not supported before Android 12");
             throw new ConfigurationException("Camera mirroring is not supported");
         }
 
+        boolean daemon = options.getDaemonIdleTimeout() > 0;
+        if (daemon && !options.isTunnelForward()) {
+            Ln.e("The server may only stay alive between sessions in forward tunnel mode");
+            throw new ConfigurationException("Daemon mode requires tunnel forward");
+        }
+
+        boolean direct = options.getDirectPort() != 0;
+        if (direct && options.getDirectToken() == null) {
+            throw new ConfigurationException("A direct connection requires a token");
+        }
+        if (direct && options.getMultiplex()) {
+            throw new ConfigurationException("Multiplexing is not supported over a direct connection");
+        }
+        if (options.getDirectUdp() && (!direct || !options.getSendCodecMeta() || !options.getSendFrameMeta())) {
+            throw new ConfigurationException("UDP video requires a direct connection with codec and frame meta");
+        }
+        boolean videoReconnect = options.getVideoReconnect();
+        if (videoReconnect && (!options.getVideo() || direct || daemon || options.getMultiplex() || options.getRecordVideoBitRate() > 0)) {
+            throw new ConfigurationException("Video reconnection requires a single video stream over separate adb sockets");
+        }
+
         CleanUp cleanUp = null;
         Thread initThread = null;
 
@@ -116,33 +143,131 @@ public final class Server {
         boolean video = options.getVideo();
         boolean audio = options.getAudio();
         boolean sendDummyByte = options.getSendDummyByte();
+        boolean multiplex = options.getMultiplex();
         boolean camera = video && options.getVideoSource() == VideoSource.CAMERA;
+        boolean pattern = video && options.getVideoSource() == VideoSource.PATTERN;
+        if (pattern && control) {
+            throw new ConfigurationException("The pattern video source does not support control");
+        }
+
+        NewDisplay newDisplay = options.getNewDisplay();
+        if (newDisplay != null && (!video || options.getVideoSource() != VideoSource.DISPLAY)) {
+            throw new ConfigurationException("A new display requires a display video source");
+        }
+
+        // The virtual display lives as long as the server (it is kept between sessions in daemon mode)
+        VirtualDisplay virtualDisplay = newDisplay != null ? NewDisplayCapture.createDisplay(newDisplay, options.getMaxSize()) : null;
+        int displayId = virtualDisplay != null ? virtualDisplay.getDisplay().getDisplayId() : options.getDisplayId();
+
+        // The synthetic pattern does not depend on the device screen
+        final Device device = camera || pattern ? null : new Device(options, displayId);
+
+        // The audio and camera workarounds are applied lazily, once they are needed
+        Workarounds.apply();
+
+        boolean recordVideo = video && options.getRecordVideoBitRate() > 0;
+        if (recordVideo && options.getVideoSource() != VideoSource.DISPLAY) {
+            throw new ConfigurationException("A separate record video stream requires a display video source");
+        }
+
+        if (video && options.getVideoCodecAuto()) {
+            // The camera size is not known before opening the camera
+            Size probeSize = device != null ? device.getScreenInfo().getCanvasSize() : EncoderProbe.DEFAULT_SIZE;
+            String sizeString = probeSize.getWidth() + "x" + probeSize.getHeight();
+            EncoderProbe.Result result = EncoderProbe.probe(probeSize);
+            if (result != null) {
+                Ln.i("Selected video encoder: --video-codec=" + result.getCodec().getName() + " --video-encoder='" + result.getEncoderName()
+                        + "' (" + Math.round(result.getFps()) + " fps at " + sizeString + ")");
+                options.setSelectedVideoEncoder(result.getCodec(), result.getEncoderName());
+            } else {
+                Ln.w("No hardware video encoder supports " + sizeString + ", using the default " + options.getVideoCodec().getName() + " encoder");
+            }
+        }
 
-        final Device device = camera ? null : new Device(options);
+        try {
+            if (daemon) {
+                // Keep the process (and everything initialized once and for all) alive to accept the next clients
+                try (LocalServerSocket serverSocket = DesktopConnection.createServerSocket(scid)) {
+                    while (true) {
+                        Thread watchdog = startIdleWatchdog(options.getDaemonIdleTimeout());
+                        DesktopConnection connection = DesktopConnection.accept(serverSocket, video, audio, control, recordVideo, sendDummyByte,
+                                multiplex);
+                        watchdog.interrupt();
+                        try {
+                            runSession(options, device, virtualDisplay, cleanUp, connection);
+                        } catch (IOException e) {
+                            Ln.e("Session failed", e);
+                        }
+                        Ln.i("Session ended, waiting for a new client");
+                    }
+                }
+            }
+
+            DesktopConnection connection;
+            if (direct) {
+                connection = DesktopConnection.openDirect(options.getDirectPort(), options.getDirectToken(), options.getDirectUdp(), video, audio,
+                        control, recordVideo);
+            } else {
+                connection = DesktopConnection.open(scid, tunnelForward, video, audio, control, recordVideo, sendDummyByte, multiplex,
+                        videoReconnect);
+            }
+            runSession(options, device, virtualDisplay, cleanUp, connection);
+        } finally {
+            if (virtualDisplay != null) {
+                virtualDisplay.release();
+            }
+            if (initThread != null) {
+                initThread.interrupt();
+                try {
+                    initThread.join();
+                } catch (InterruptedException e) {
+                    // ignore
+                }
+            }
+            if (cleanUp != null) {
+                cleanUp.finish();
+            }
+        }
+    }
 
-        Workarounds.apply(audio, camera);
+    private static void runSession(Options options, Device device, VirtualDisplay virtualDisplay, CleanUp cleanUp, DesktopConnection connection)
+            throws IOException, ConfigurationException {
+        boolean control = options.getControl();
+        boolean video = options.getVideo();
+        boolean audio = options.getAudio();
+        boolean recordVideo = video && options.getRecordVideoBitRate() > 0;
 
         List<AsyncProcessor> asyncProcessors = new ArrayList<>();
 
-        DesktopConnection connection = DesktopConnection.open(scid, tunnelForward, video, audio, control, sendDummyByte);
         try {
+            int socketBufferSize = options.getSocketBufferSize();
+            if (socketBufferSize > 0) {
+                connection.setVideoSendBufferSize(socketBufferSize);
+            }
+
             if (options.getSendDeviceMeta()) {
                 connection.sendDeviceMeta(Device.getDeviceName());
             }
 
+            Controller controller = null;
             if (control) {
                 ControlChannel controlChannel = connection.getControlChannel();
-                Controller controller = new Controller(device, controlChannel, cleanUp, options.getClipboardAutosync(), options.getPowerOn());
+                if (options.getControlCompression()) {
+                    controlChannel.enableCompression();
+                }
+                controller = new Controller(device, controlChannel, cleanUp, options.getClipboardAutosync(), options.getPowerOn());
+                Controller finalController = controller;
                 device.setClipboardListener(text -> {
                     DeviceMessage msg = DeviceMessage.createClipboard(text);
-                    controller.getSender().send(msg);
+                    finalController.getSender().send(msg);
                 });
                 asyncProcessors.add(controller);
             }
 
             if (audio) {
                 AudioCodec audioCodec = options.getAudioCodec();
-                AudioCapture audioCapture = new AudioCapture(options.getAudioSource());
+                AudioCapture audioCapture = new AudioCapture(options.getAudioSource(), options.getAudioSampleRate(), options.getAudioChannels(),
+                        options.getAudioReadSize());
                 Streamer audioStreamer = new Streamer(connection.getAudioFd(), audioCodec, options.getSendCodecMeta(), options.getSendFrameMeta());
                 AsyncProcessor audioRecorder;
                 if (audioCodec == AudioCodec.RAW) {
@@ -157,16 +282,64 @@ public final class Server {
             if (video) {
                 Streamer videoStreamer = new Streamer(connection.getVideoFd(), options.getVideoCodec(), options.getSendCodecMeta(),
                         options.getSendFrameMeta());
+                if (options.getVideoPacing()) {
+                    videoStreamer.enablePacing(options.getVideoBitRate());
+                }
                 SurfaceCapture surfaceCapture;
-                if (options.getVideoSource() == VideoSource.DISPLAY) {
-                    surfaceCapture = new ScreenCapture(device);
+                if (virtualDisplay != null) {
+                    surfaceCapture = new NewDisplayCapture(virtualDisplay, device);
+                } else if (options.getVideoSource() == VideoSource.DISPLAY) {
+                    surfaceCapture = new ScreenCapture(device, createVideoFilter(options), options.getAdaptiveFps());
+                } else if (options.getVideoSource() == VideoSource.PATTERN) {
+                    surfaceCapture = new PatternCapture(options.getPatternSize(), options.getPatternFps(), options.getMaxSize());
                 } else {
                     surfaceCapture = new CameraCapture(options.getCameraId(), options.getCameraFacing(), options.getCameraSize(),
-                            options.getMaxSize(), options.getCameraAspectRatio(), options.getCameraFps(), options.getCameraHighSpeed());
+                            options.getMaxSize(), options.getCameraAspectRatio(), options.getCameraFps(), options.getCameraHighSpeed(),
+                            options.getVideoHdr(), options.getCameraLowLatency(), options.getCameraLockAeAf());
                 }
                 SurfaceEncoder surfaceEncoder = new SurfaceEncoder(surfaceCapture, videoStreamer, options.getVideoBitRate(), options.getMaxFps(),
-                        options.getVideoCodecOptions(), options.getVideoEncoder(), options.getDownsizeOnError());
+                        options.getVideoRepeatDelay(), options.getLowLatencyProfile(), options.getVideoIntraRefresh(), options.getVideoCodecOptions(),
+                        options.getVideoEncoder(), options.getDownsizeOnError(), options.getVideoHdr(), options.getLatencyStats(),
+                        options.getEncoderStats());
+                if (controller != null) {
+                    controller.setSurfaceEncoder(surfaceEncoder);
+                    surfaceEncoder.setDeviceMessageSender(controller.getSender());
+                }
+                if (options.getVideoReconnect()) {
+                    surfaceEncoder.setVideoReconnector(connection::reconnectVideo);
+                }
+                UdpVideoChannel udpVideoChannel = connection.getUdpVideoChannel();
+                if (udpVideoChannel != null) {
+                    // The client requests a keyframe (over UDP) when a packet is lost
+                    udpVideoChannel.setKeyFrameRequestListener(surfaceEncoder::requestKeyFrame);
+                }
                 asyncProcessors.add(surfaceEncoder);
+
+                if (options.getThermalGovernor()) {
+                    DeviceMessageSender sender = controller != null ? controller.getSender() : null;
+                    asyncProcessors.add(new ThermalMonitor(surfaceEncoder, sender));
+                }
+
+                if (recordVideo) {
+                    // A second virtual display on the same layer stack (or the camera), encoded independently (the recording favors quality
+                    // over latency). With a new display, it mirrors the new display.
+                    Streamer recordVideoStreamer = new Streamer(connection.getRecordVideoFd(), options.getVideoCodec(),
+                            options.getSendCodecMeta(), options.getSendFrameMeta());
+                    SurfaceCapture recordCapture;
+                    if (options.getRecordVideoSource() == VideoSource.CAMERA) {
+                        // The camera is captured by the same server as the display, so they share the process and the encoders
+                        recordCapture = new CameraCapture(options.getCameraId(), options.getCameraFacing(), options.getCameraSize(),
+                                options.getMaxSize(), options.getCameraAspectRatio(), options.getCameraFps(), options.getCameraHighSpeed(), false,
+                                options.getCameraLowLatency(), options.getCameraLockAeAf());
+                    } else {
+                        // The masks also apply to the recording (but all the frames are recorded)
+                        recordCapture = new ScreenCapture(device, createVideoFilter(options), false);
+                    }
+                    SurfaceEncoder recordEncoder = new SurfaceEncoder(recordCapture, recordVideoStreamer, options.getRecordVideoBitRate(),
+                            options.getMaxFps(), options.getVideoRepeatDelay(), false, false, options.getVideoCodecOptions(),
+                            options.getVideoEncoder(), options.getDownsizeOnError(), false, false, false);
+                    asyncProcessors.add(recordEncoder);
+                }
             }
 
             Completion completion = new Completion(asyncProcessors.size());
@@ -178,9 +351,6 @@ public final class Server {
 
             completion.await();
         } finally {
-            if (initThread != null) {
-                initThread.interrupt();
-            }
             for (AsyncProcessor asyncProcessor : asyncProcessors) {
                 asyncProcessor.stop();
             }
@@ -188,9 +358,6 @@ public final class Server {
             connection.shutdown();
 
             try {
-                if (initThread != null) {
-                    initThread.join();
-                }
                 for (AsyncProcessor asyncProcessor : asyncProcessors) {
                     asyncProcessor.join();
                 }
@@ -202,6 +369,30 @@ public final class Server {
         }
     }
 
+    private static VideoFilter createVideoFilter(Options options) {
+        if (!options.getGpuDownscale() && options.getVideoMasks().isEmpty() && !options.getAdaptiveFps()) {
+            // The display is rendered directly to the encoder surface
+            return null;
+        }
+        return new VideoFilter(options.getGpuDownscale(), options.getVideoMasks());
+    }
+
+    private static Thread startIdleWatchdog(int timeout) {
+        Thread thread = new Thread(() -> {
+            try {
+                Thread.sleep(timeout);
+                Ln.i("No client connected for " + timeout + " ms, exiting");
+                // The clean up process detects the termination and restores the device state
+                System.exit(0);
+            } catch (InterruptedException e) {
+                // A client is connected
+            }
+        }, "idle-watchdog");
+        thread.setDaemon(true);
+        thread.start();
+        return thread;
+    }
+
     private static Thread startInitThread(final Options options, final CleanUp cleanUp) {
         Thread thread = new Thread(() -> initAndCleanUp(options, cleanUp), "init-cleanup");
         thread.start();
@@ -248,7 +439,6 @@ public final class Server {
                 Ln.i(LogUtils.buildDisplayListMessage());
             }
             if (options.getListCameras() || options.getListCameraSizes()) {
-                Workarounds.apply(false, true);
                 Ln.i(LogUtils.buildCameraListMessage(options.getListCameraSizes()));
             }
             // Just print the requested data, do not mirror
@@ -3,8 +3,6 @@ package com.genymobile.scrcpy;
 import com.genymobile.scrcpy.wrappers.ContentProvider;
 import com.genymobile.scrcpy.wrappers.ServiceManager;
 
-import android.os.Build;
-
 import java.io.IOException;
 
 public final class Settings {
@@ -13,6 +11,11 @@ public final class Settings {
     public static final String TABLE_SECURE = ContentProvider.TABLE_SECURE;
     public static final String TABLE_GLOBAL = ContentProvider.TABLE_GLOBAL;
 
+    // Created on the first access, and reused until release()
+    private static ContentProvider provider;
+    // Set if the ContentProvider does not work, so that it is not retried on every access
+    private static boolean providerUnavailable;
+
     private Settings() {
         /* not instantiable */
     }
@@ -33,13 +36,43 @@ public final class Settings {
         }
     }
 
+    private static synchronized ContentProvider getProvider() {
+        if (provider == null && !providerUnavailable) {
+            provider = ServiceManager.getActivityManager().createSettingsProvider();
+            if (provider == null) {
+                providerUnavailable = true;
+            }
+        }
+        return provider;
+    }
+
+    // On some devices (typically Android >= 12), the ContentProvider calls always fail:
+    // <https://github.com/Genymobile/scrcpy/issues/2788>
+    private static synchronized void disableProvider(SettingsException e) {
+        Ln.w("Could not access settings via ContentProvider, fallback to settings process", e);
+        providerUnavailable = true;
+        release();
+    }
+
+    /**
+     * Release the ContentProvider shared by all the settings accesses.
+     * <p>
+     * It is created again if necessary.
+     */
+    public static synchronized void release() {
+        if (provider != null) {
+            provider.close();
+            provider = null;
+        }
+    }
+
     public static String getValue(String table, String key) throws SettingsException {
-        if (Build.VERSION.SDK_INT <= Build.VERSION_CODES.R) {
-            // on Android >= 12, it always fails: <https://github.com/Genymobile/scrcpy/issues/2788>
-            try (ContentProvider provider = ServiceManager.getActivityManager().createSettingsProvider()) {
+        ContentProvider provider = getProvider();
+        if (provider != null) {
+            try {
                 return provider.getValue(table, key);
             } catch (SettingsException e) {
-                Ln.w("Could not get settings value via ContentProvider, fallback to settings process", e);
+                disableProvider(e);
             }
         }
 
@@ -47,12 +80,13 @@ public final class Settings {
     }
 
     public static void putValue(String table, String key, String value) throws SettingsException {
-        if (Build.VERSION.SDK_INT <= Build.VERSION_CODES.R) {
-            // on Android >= 12, it always fails: <https://github.com/Genymobile/scrcpy/issues/2788>
-            try (ContentProvider provider = ServiceManager.getActivityManager().createSettingsProvider()) {
+        ContentProvider provider = getProvider();
+        if (provider != null) {
+            try {
                 provider.putValue(table, key, value);
+                return;
             } catch (SettingsException e) {
-                Ln.w("Could not put settings value via ContentProvider, fallback to settings process", e);
+                disableProvider(e);
             }
         }
 
@@ -60,19 +94,6 @@ public final class Settings {
     }
 
     public static String getAndPutValue(String table, String key, String value) throws SettingsException {
-        if (Build.VERSION.SDK_INT <= Build.VERSION_CODES.R) {
-            // on Android >= 12, it always fails: <https://github.com/Genymobile/scrcpy/issues/2788>
-            try (ContentProvider provider = ServiceManager.getActivityManager().createSettingsProvider()) {
-                String oldValue = provider.getValue(table, key);
-                if (!value.equals(oldValue)) {
-                    provider.putValue(table, key, value);
-                }
-                return oldValue;
-            } catch (SettingsException e) {
-                Ln.w("Could not get and put settings value via ContentProvider, fallback to settings process", e);
-            }
-        }
-
         String oldValue = getValue(table, key);
         if (!value.equals(oldValue)) {
             putValue(table, key, value);
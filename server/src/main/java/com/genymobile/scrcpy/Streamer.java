@@ -6,19 +6,31 @@ import java.io.FileDescriptor;
 import java.io.IOException;
 import java.nio.ByteBuffer;
 import java.nio.ByteOrder;
-import java.util.Arrays;
 
 public final class Streamer {
 
     private static final long PACKET_FLAG_CONFIG = 1L << 63;
     private static final long PACKET_FLAG_KEY_FRAME = 1L << 62;
 
-    private final FileDescriptor fd;
+    private static final byte[] OPUS_HEADER_ID = {'A', 'O', 'P', 'U', 'S', 'H', 'D', 'R'};
+    private static final byte[] FLAC_HEADER_ID = {'f', 'L', 'a', 'C'};
+
+    private FileDescriptor fd; // replaced on video reconnection
     private final Codec codec;
     private final boolean sendCodecMeta;
     private final boolean sendFrameMeta;
 
-    private final ByteBuffer headerBuffer = ByteBuffer.allocate(12);
+    // Direct, so that it is passed as is to Os.write() and Os.writev()
+    private final ByteBuffer headerBuffer = ByteBuffer.allocateDirect(12);
+
+    // Reused on every packet to write the header and the payload at once, without allocation
+    private final ByteBuffer[] packetBuffers = new ByteBuffer[2];
+    private final Object[] packetVectors = new Object[2];
+    private final int[] packetOffsets = new int[2];
+    private final int[] packetByteCounts = new int[2];
+
+    // Only if the large packets are paced
+    private PacketPacer pacer;
 
     public Streamer(FileDescriptor fd, Codec codec, boolean sendCodecMeta, boolean sendFrameMeta) {
         this.fd = fd;
@@ -31,23 +43,48 @@ public final class Streamer {
         return codec;
     }
 
+    /**
+     * Split the large packets into chunks written at a rate derived from the bit rate, see {@link PacketPacer}.
+     * <p>
+     * This method must be called before streaming.
+     */
+    public void enablePacing(int bitRate) {
+        pacer = new PacketPacer(bitRate);
+    }
+
+    /**
+     * Update the pacing rate on bit rate change (if pacing is enabled).
+     */
+    public void setPacingBitRate(int bitRate) {
+        if (pacer != null) {
+            pacer.setBitRate(bitRate);
+        }
+    }
+
+    /**
+     * Write the next packets to another file descriptor (when the connection is restored).
+     */
+    public void setFd(FileDescriptor fd) {
+        this.fd = fd;
+    }
+
     public void writeAudioHeader() throws IOException {
         if (sendCodecMeta) {
-            ByteBuffer buffer = ByteBuffer.allocate(4);
-            buffer.putInt(codec.getId());
-            buffer.flip();
-            IO.writeFully(fd, buffer);
+            headerBuffer.clear();
+            headerBuffer.putInt(codec.getId());
+            headerBuffer.flip();
+            IO.writeFully(fd, headerBuffer);
         }
     }
 
     public void writeVideoHeader(Size videoSize) throws IOException {
         if (sendCodecMeta) {
-            ByteBuffer buffer = ByteBuffer.allocate(12);
-            buffer.putInt(codec.getId());
-            buffer.putInt(videoSize.getWidth());
-            buffer.putInt(videoSize.getHeight());
-            buffer.flip();
-            IO.writeFully(fd, buffer);
+            headerBuffer.clear();
+            headerBuffer.putInt(codec.getId());
+            headerBuffer.putInt(videoSize.getWidth());
+            headerBuffer.putInt(videoSize.getHeight());
+            headerBuffer.flip();
+            IO.writeFully(fd, headerBuffer);
         }
     }
 
@@ -72,10 +109,63 @@ public final class Streamer {
         }
 
         if (sendFrameMeta) {
-            writeFrameMeta(fd, buffer.remaining(), pts, config, keyFrame);
+            prepareFrameMeta(buffer.remaining(), pts, config, keyFrame);
         }
 
-        IO.writeFully(fd, buffer);
+        if (pacer != null && PacketPacer.mustPace(buffer.remaining())) {
+            writePaced(buffer);
+        } else if (sendFrameMeta) {
+            // Write the header and the payload at once (one system call instead of two)
+            writeHeaderAndPayload(buffer);
+        } else {
+            IO.writeFully(fd, buffer);
+        }
+    }
+
+    private void writePaced(ByteBuffer buffer) throws IOException {
+        long startUs = System.nanoTime() / 1000;
+        int start = buffer.position();
+        int limit = buffer.limit();
+        int size = limit - start;
+        boolean paced = true;
+
+        try {
+            for (int offset = 0; offset < size; offset += PacketPacer.CHUNK_SIZE) {
+                long delayUs = startUs + pacer.getChunkDelayUs(offset) - System.nanoTime() / 1000;
+                if (paced && delayUs > 0) {
+                    try {
+                        Thread.sleep(delayUs / 1000, (int) (delayUs % 1000) * 1000);
+                    } catch (InterruptedException e) {
+                        // Write the remaining chunks immediately
+                        Thread.currentThread().interrupt();
+                        paced = false;
+                    }
+                }
+
+                // Set the position explicitly, it is not always updated by IO.writeFully()
+                buffer.limit(start + Math.min(size, offset + PacketPacer.CHUNK_SIZE));
+                buffer.position(start + offset);
+                if (offset == 0 && sendFrameMeta) {
+                    writeHeaderAndPayload(buffer);
+                } else {
+                    IO.writeFully(fd, buffer);
+                }
+            }
+        } finally {
+            buffer.limit(limit);
+        }
+    }
+
+    private void writeHeaderAndPayload(ByteBuffer payload) throws IOException {
+        packetBuffers[0] = headerBuffer;
+        packetBuffers[1] = payload;
+        try {
+            IO.writeFully(fd, packetBuffers, packetVectors, packetOffsets, packetByteCounts);
+        } finally {
+            // Do not retain the payload (typically a codec buffer) after the write
+            packetBuffers[1] = null;
+            packetVectors[1] = null;
+        }
     }
 
     public void writePacket(ByteBuffer codecBuffer, MediaCodec.BufferInfo bufferInfo) throws IOException {
@@ -85,7 +175,7 @@ public final class Streamer {
         writePacket(codecBuffer, pts, config, keyFrame);
     }
 
-    private void writeFrameMeta(FileDescriptor fd, int packetSize, long pts, boolean config, boolean keyFrame) throws IOException {
+    private void prepareFrameMeta(int packetSize, long pts, boolean config, boolean keyFrame) {
         headerBuffer.clear();
 
         long ptsAndFlags;
@@ -101,7 +191,20 @@ public final class Streamer {
         headerBuffer.putLong(ptsAndFlags);
         headerBuffer.putInt(packetSize);
         headerBuffer.flip();
-        IO.writeFully(fd, headerBuffer);
+    }
+
+    /**
+     * Compare the next bytes of the buffer with the given id (without copying them), and skip them if they match.
+     */
+    private static boolean skipHeaderId(ByteBuffer buffer, byte[] id) {
+        int position = buffer.position();
+        for (int i = 0; i < id.length; ++i) {
+            if (buffer.get(position + i) != id[i]) {
+                return false;
+            }
+        }
+        buffer.position(position + id.length);
+        return true;
     }
 
     private static void fixOpusConfigPacket(ByteBuffer buffer) throws IOException {
@@ -125,10 +228,7 @@ public final class Streamer {
             throw new IOException("Not enough data in OPUS config packet");
         }
 
-        final byte[] opusHeaderId = {'A', 'O', 'P', 'U', 'S', 'H', 'D', 'R'};
-        byte[] idBuffer = new byte[8];
-        buffer.get(idBuffer);
-        if (!Arrays.equals(idBuffer, opusHeaderId)) {
+        if (!skipHeaderId(buffer, OPUS_HEADER_ID)) {
             throw new IOException("OPUS header not found");
         }
 
@@ -165,10 +265,7 @@ public final class Streamer {
             throw new IOException("Not enough data in FLAC config packet");
         }
 
-        final byte[] flacHeaderId = {'f', 'L', 'a', 'C'};
-        byte[] idBuffer = new byte[4];
-        buffer.get(idBuffer);
-        if (!Arrays.equals(idBuffer, flacHeaderId)) {
+        if (!skipHeaderId(buffer, FLAC_HEADER_ID)) {
             throw new IOException("FLAC header not found");
         }
 
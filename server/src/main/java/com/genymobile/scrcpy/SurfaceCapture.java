@@ -1,5 +1,6 @@
 package com.genymobile.scrcpy;
 
+import android.graphics.Rect;
 import android.view.Surface;
 
 import java.io.IOException;
@@ -14,9 +15,9 @@ public abstract class SurfaceCapture {
 
     /**
      * Request the encoding session to be restarted, for example if the capture implementation detects that the video source size has changed (on
-     * device rotation for example).
+     * device rotation for example), or if the client changed the video limits.
      */
-    protected void requestReset() {
+    public void requestReset() {
         resetCapture.set(true);
     }
 
@@ -60,6 +61,39 @@ public abstract class SurfaceCapture {
      */
     public abstract boolean setMaxSize(int maxSize);
 
+    /**
+     * Change the captured region while capturing, without restarting the capture nor changing the video size.
+     * <p>
+     * This method is called from the controller thread.
+     *
+     * @param region the region, in the current device orientation, or {@code null} to restore the initial crop
+     * @return {@code true} if the region has been applied, {@code false} if it is not supported.
+     */
+    public boolean setCrop(Rect region) {
+        return false;
+    }
+
+    /**
+     * Indicate if the capture produces HDR10 content (BT.2020 primaries, PQ transfer), to be signaled to the encoder.
+     *
+     * @return {@code true} if the content is HDR10, {@code false} otherwise.
+     */
+    public boolean isHdr10() {
+        return false;
+    }
+
+    /**
+     * Indicate if the frame timestamps are based on {@link android.os.SystemClock#elapsedRealtimeNanos()} rather than
+     * {@link System#nanoTime()}, so that the latencies are measured against the same clock.
+     * <p>
+     * This method is called after {@link #init()}.
+     *
+     * @return {@code true} if the timestamps are in the realtime clock base, {@code false} otherwise.
+     */
+    public boolean hasRealtimeTimestamps() {
+        return false;
+    }
+
     /**
      * Indicate if the capture has been closed internally.
      *
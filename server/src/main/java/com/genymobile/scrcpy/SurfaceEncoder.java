@@ -1,58 +1,178 @@
 package com.genymobile.scrcpy;
 
+import android.annotation.TargetApi;
+import android.graphics.Rect;
 import android.media.MediaCodec;
 import android.media.MediaCodecInfo;
 import android.media.MediaFormat;
+import android.os.Build;
+import android.os.Bundle;
+import android.os.Handler;
+import android.os.HandlerThread;
 import android.os.Looper;
 import android.os.SystemClock;
+import android.os.Trace;
 import android.view.Surface;
 
+import java.io.FileDescriptor;
 import java.io.IOException;
 import java.nio.ByteBuffer;
+import java.util.ArrayList;
 import java.util.List;
+import java.util.concurrent.ArrayBlockingQueue;
+import java.util.concurrent.BlockingQueue;
+import java.util.concurrent.TimeUnit;
 import java.util.concurrent.atomic.AtomicBoolean;
+import java.util.concurrent.atomic.AtomicInteger;
+import java.util.concurrent.atomic.AtomicReference;
 
 public class SurfaceEncoder implements AsyncProcessor {
 
+    public interface VideoReconnector {
+        /**
+         * Wait for the client to reconnect the video stream.
+         *
+         * @return the new file descriptor to write the stream to
+         */
+        FileDescriptor reconnect() throws IOException;
+    }
+
+    private static class OutputTask {
+        private final int index;
+        private final MediaCodec.BufferInfo bufferInfo;
+
+        OutputTask(int index, MediaCodec.BufferInfo bufferInfo) {
+            this.index = index;
+            this.bufferInfo = bufferInfo;
+        }
+    }
+
     private static final int DEFAULT_I_FRAME_INTERVAL = 10; // seconds
-    private static final int REPEAT_FRAME_DELAY_US = 100_000; // repeat after 100ms
     private static final String KEY_MAX_FPS_TO_ENCODER = "max-fps-to-encoder";
+    // Used for the low latency and intra refresh configuration if there is no max fps
+    private static final int DEFAULT_NOMINAL_FRAME_RATE = 60;
 
     // Keep the values in descending order
     private static final int[] MAX_SIZE_FALLBACK = {2560, 1920, 1600, 1280, 1024, 800};
     private static final int MAX_CONSECUTIVE_ERRORS = 3;
+    private static final long LATENCY_REPORT_INTERVAL_US = 10_000_000;
+    private static final long ENCODER_STATS_INTERVAL_US = 1_000_000;
+    // Number of encoded packets which may wait to be written, before dropping frames until the next keyframe
+    private static final int OUTPUT_QUEUE_CAPACITY = 8;
+    // Maximum delay to handle a stop, a reset or a pending change when no frames are produced
+    private static final long OUTPUT_POLL_TIMEOUT_MS = 100;
 
     private final SurfaceCapture capture;
     private final Streamer streamer;
     private final String encoderName;
     private final List<CodecOption> codecOptions;
     private final int videoBitRate;
-    private final int maxFps;
+    // Only accessed from the encoder thread (may be changed by the client)
+    private int maxFps;
     private final boolean downsizeOnError;
+    private final long repeatFrameDelayUs; // 0 to never repeat frames
+    private final boolean lowLatency;
+    private final boolean intraRefresh;
+    private boolean acceptedKeysReported;
+    // Request a 10-bit H.265 stream (Main10, or Main10 HDR10 if the capture is HDR10)
+    private final boolean hdr;
+    private boolean hdrReported;
+
+    // null if both latency statistics and encoder statistics are disabled
+    private final LatencyStats encodeLatency;
+    private final LatencyStats writeLatency;
+    // Time spent in the socket write, i.e. blocked on the network
+    private final LatencyStats writeBlockLatency;
+    private final boolean latencyStats; // log the percentiles periodically
+    private final boolean encoderStats; // send the percentiles to the client periodically
+    private long nextLatencyReport;
+    // The clock base of the frame timestamps, to measure the latencies from the capture
+    private boolean realtimeTimestamps;
+    private long nextEncoderStats;
+
+    // Guarded by itself (accessed from the controller and thermal monitor threads)
+    private final BitRateController bitRateController;
+    // New bit rate to apply to the running encoder (0 if none)
+    private final AtomicInteger pendingBitRate = new AtomicInteger();
+    // Only accessed from the encoder thread
+    private int currentBitRate;
+    // Video limits requested by the client, not yet applied (guarded by this)
+    private boolean videoLimitsChanged;
+    private int pendingMaxSize;
+    private int pendingMaxFps;
+    // Thermal limits not yet applied (guarded by this)
+    private boolean thermalLimitsChanged;
+    private int pendingThermalMaxFps;
+    private int pendingThermalSizePercent = 100;
+    // Only accessed from the encoder thread
+    private int thermalMaxFps; // 0 for no limit
+    private int thermalSizePercent = 100;
+    private int unthrottledMaxSize; // the video size before the thermal reduction (0 if not reduced)
+    // Set when the client requested a keyframe, not yet forwarded to the encoder
+    private final AtomicBoolean pendingKeyFrame = new AtomicBoolean();
 
     private boolean firstFrameSent;
     private int consecutiveErrors;
 
+    // Asynchronous mode (since Android 6): the packets are produced from the codec thread and written from the encoder thread
+    private HandlerThread mediaCodecThread;
+    private Handler mediaCodecHandler;
+    private final EncoderCallback encoderCallback = new EncoderCallback();
+    private final BlockingQueue<OutputTask> outputTasks = new ArrayBlockingQueue<>(OUTPUT_QUEUE_CAPACITY);
+    private final AtomicReference<MediaCodec.CodecException> codecError = new AtomicReference<>();
+    // Only accessed from the codec thread
+    private boolean dropUntilKeyFrame;
+    private int droppedFrames;
+    // May be null (if control is disabled), used to report the dropped frames to the client
+    private DeviceMessageSender sender;
+    // May be null (the streaming stops if the connection is lost)
+    private VideoReconnector reconnector;
+
     private Thread thread;
     private final AtomicBoolean stopped = new AtomicBoolean();
 
-    public SurfaceEncoder(SurfaceCapture capture, Streamer streamer, int videoBitRate, int maxFps, List<CodecOption> codecOptions, String encoderName,
-            boolean downsizeOnError) {
+    public SurfaceEncoder(SurfaceCapture capture, Streamer streamer, int videoBitRate, int maxFps, int repeatFrameDelayMs, boolean lowLatency,
+            boolean intraRefresh, List<CodecOption> codecOptions, String encoderName, boolean downsizeOnError, boolean hdr, boolean latencyStats,
+            boolean encoderStats) {
         this.capture = capture;
         this.streamer = streamer;
         this.videoBitRate = videoBitRate;
+        this.bitRateController = new BitRateController(videoBitRate);
+        this.currentBitRate = videoBitRate;
         this.maxFps = maxFps;
+        this.repeatFrameDelayUs = repeatFrameDelayMs * 1000L;
+        this.lowLatency = lowLatency;
+        this.intraRefresh = intraRefresh;
         this.codecOptions = codecOptions;
         this.encoderName = encoderName;
         this.downsizeOnError = downsizeOnError;
+        this.hdr = hdr;
+        this.latencyStats = latencyStats;
+        this.encoderStats = encoderStats;
+        if (latencyStats || encoderStats) {
+            encodeLatency = new LatencyStats("encode");
+            writeLatency = new LatencyStats("write");
+            writeBlockLatency = new LatencyStats("block");
+        } else {
+            encodeLatency = null;
+            writeLatency = null;
+            writeBlockLatency = null;
+        }
     }
 
     private void streamScreen() throws IOException, ConfigurationException {
         Codec codec = streamer.getCodec();
         MediaCodec mediaCodec = createMediaCodec(codec, encoderName);
-        MediaFormat format = createFormat(codec.getMimeType(), videoBitRate, maxFps, codecOptions);
+        MediaFormat format = createFormat(codec.getMimeType(), videoBitRate, maxFps, repeatFrameDelayUs, lowLatency, intraRefresh, codecOptions);
 
         capture.init();
+        realtimeTimestamps = capture.hasRealtimeTimestamps();
+
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.M) {
+            mediaCodecThread = new HandlerThread("video-codec");
+            mediaCodecThread.start();
+            mediaCodecHandler = new Handler(mediaCodecThread.getLooper());
+        }
 
         try {
             streamer.writeVideoHeader(capture.getSize());
@@ -60,20 +180,45 @@ public class SurfaceEncoder implements AsyncProcessor {
             boolean alive;
 
             do {
+                boolean limitsChanged = applyPendingVideoLimits();
+                limitsChanged |= applyPendingThermalLimits();
+                if (limitsChanged) {
+                    format = createFormat(codec.getMimeType(), videoBitRate, getEffectiveMaxFps(), repeatFrameDelayUs, lowLatency, intraRefresh,
+                            codecOptions);
+                }
                 Size size = capture.getSize();
+                applyPendingBitRate(null);
+                // A new encoding session always starts with a keyframe
+                pendingKeyFrame.set(false);
+                format.setInteger(MediaFormat.KEY_BIT_RATE, currentBitRate);
                 format.setInteger(MediaFormat.KEY_WIDTH, size.getWidth());
                 format.setInteger(MediaFormat.KEY_HEIGHT, size.getHeight());
+                if (hdr) {
+                    setHdrKeys(format, mediaCodec, codec);
+                }
 
                 Surface surface = null;
                 try {
+                    if (mediaCodecHandler != null) {
+                        // The callback must be set before configure()
+                        setEncoderCallback(mediaCodec);
+                    }
                     mediaCodec.configure(format, null, null, MediaCodec.CONFIGURE_FLAG_ENCODE);
+                    if ((lowLatency || intraRefresh) && !acceptedKeysReported) {
+                        reportAcceptedKeys(mediaCodec);
+                        acceptedKeysReported = true;
+                    }
                     surface = mediaCodec.createInputSurface();
 
                     capture.start(surface);
 
+                    // The pending packets and errors of the previous session, if any, refer to invalid buffers
+                    outputTasks.clear();
+                    codecError.set(null);
+
                     mediaCodec.start();
 
-                    alive = encode(mediaCodec, streamer);
+                    alive = mediaCodecHandler != null ? encodeAsync(mediaCodec, streamer) : encode(mediaCodec, streamer);
                     // do not call stop() on exception, it would trigger an IllegalStateException
                     mediaCodec.stop();
                 } catch (IllegalStateException | IllegalArgumentException e) {
@@ -83,6 +228,15 @@ public class SurfaceEncoder implements AsyncProcessor {
                     }
                     Ln.i("Retrying...");
                     alive = true;
+                } catch (IOException e) {
+                    if (reconnector == null || stopped.get()) {
+                        throw e;
+                    }
+                    Ln.w("Video connection lost (" + e.getMessage() + "), waiting for the client to reconnect...");
+                    // The stream header is not sent again: the new encoding session starts with a config packet and a keyframe
+                    streamer.setFd(reconnector.reconnect());
+                    Ln.i("Video connection restored");
+                    alive = true;
                 } finally {
                     mediaCodec.reset();
                     if (surface != null) {
@@ -93,6 +247,18 @@ public class SurfaceEncoder implements AsyncProcessor {
         } finally {
             mediaCodec.release();
             capture.release();
+            if (mediaCodecThread != null) {
+                mediaCodecThread.quitSafely();
+                try {
+                    mediaCodecThread.join();
+                } catch (InterruptedException e) {
+                    // Should never happen
+                    throw new AssertionError(e);
+                }
+            }
+            if (latencyStats) {
+                reportLatency();
+            }
         }
     }
 
@@ -154,31 +320,68 @@ public class SurfaceEncoder implements AsyncProcessor {
                 alive = false;
                 break;
             }
+            applyPendingBitRate(codec);
+            applyPendingKeyFrame(codec);
             int outputBufferId = codec.dequeueOutputBuffer(bufferInfo, -1);
-            try {
-                if (capture.consumeReset()) {
-                    // must restart encoding with new size
-                    break;
+            if (capture.consumeReset()) {
+                // must restart encoding with new size
+                if (outputBufferId >= 0) {
+                    codec.releaseOutputBuffer(outputBufferId, false);
                 }
+                break;
+            }
 
-                eof = (bufferInfo.flags & MediaCodec.BUFFER_FLAG_END_OF_STREAM) != 0;
-                if (outputBufferId >= 0) {
-                    ByteBuffer codecBuffer = codec.getOutputBuffer(outputBufferId);
+            eof = (bufferInfo.flags & MediaCodec.BUFFER_FLAG_END_OF_STREAM) != 0;
+            if (outputBufferId >= 0) {
+                writeOutputBuffer(codec, outputBufferId, bufferInfo, streamer);
+            }
+        }
 
-                    boolean isConfig = (bufferInfo.flags & MediaCodec.BUFFER_FLAG_CODEC_CONFIG) != 0;
-                    if (!isConfig) {
-                        // If this is not a config packet, then it contains a frame
-                        firstFrameSent = true;
-                        consecutiveErrors = 0;
-                    }
+        if (capture.isClosed()) {
+            // The capture might have been closed internally (for example if the camera is disconnected)
+            alive = false;
+        }
 
-                    streamer.writePacket(codecBuffer, bufferInfo);
-                }
-            } finally {
-                if (outputBufferId >= 0) {
-                    codec.releaseOutputBuffer(outputBufferId, false);
-                }
+        return !eof && alive;
+    }
+
+    private boolean encodeAsync(MediaCodec codec, Streamer streamer) throws IOException {
+        boolean eof = false;
+        boolean alive = true;
+
+        while (!capture.consumeReset() && !eof) {
+            if (stopped.get()) {
+                alive = false;
+                break;
+            }
+            MediaCodec.CodecException error = codecError.getAndSet(null);
+            if (error != null) {
+                // Handled like the errors of the synchronous mode (it is an IllegalStateException)
+                throw error;
             }
+            applyPendingBitRate(codec);
+            applyPendingKeyFrame(codec);
+
+            OutputTask task;
+            try {
+                // Do not wait indefinitely, the content may be static (if frames are not repeated)
+                task = outputTasks.poll(OUTPUT_POLL_TIMEOUT_MS, TimeUnit.MILLISECONDS);
+            } catch (InterruptedException e) {
+                alive = false;
+                break;
+            }
+            if (task == null) {
+                continue;
+            }
+
+            if (capture.consumeReset()) {
+                // must restart encoding with new size
+                codec.releaseOutputBuffer(task.index, false);
+                break;
+            }
+
+            eof = (task.bufferInfo.flags & MediaCodec.BUFFER_FLAG_END_OF_STREAM) != 0;
+            writeOutputBuffer(codec, task.index, task.bufferInfo, streamer);
         }
 
         if (capture.isClosed()) {
@@ -189,6 +392,299 @@ public class SurfaceEncoder implements AsyncProcessor {
         return !eof && alive;
     }
 
+    @TargetApi(Build.VERSION_CODES.M)
+    private void setEncoderCallback(MediaCodec codec) {
+        codec.setCallback(encoderCallback, mediaCodecHandler);
+    }
+
+    /**
+     * Return the current time in the clock of the video PTS (in µs).
+     */
+    public long captureClockUs() {
+        long nowNs = realtimeTimestamps ? SystemClock.elapsedRealtimeNanos() : System.nanoTime();
+        return nowNs / 1000;
+    }
+
+    private static void beginTraceSection(String name, long pts) {
+        // The client traces the same pts, to correlate both traces (only build the name if a trace is being recorded)
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.Q && Trace.isEnabled()) {
+            Trace.beginSection(name + " pts=" + pts);
+        } else {
+            Trace.beginSection(name);
+        }
+    }
+
+    private void writeOutputBuffer(MediaCodec codec, int index, MediaCodec.BufferInfo bufferInfo, Streamer streamer) throws IOException {
+        try {
+            ByteBuffer codecBuffer = codec.getOutputBuffer(index);
+
+            boolean isConfig = (bufferInfo.flags & MediaCodec.BUFFER_FLAG_CODEC_CONFIG) != 0;
+            if (!isConfig) {
+                // If this is not a config packet, then it contains a frame
+                firstFrameSent = true;
+                consecutiveErrors = 0;
+            }
+
+            boolean measureLatency = encodeLatency != null && !isConfig;
+            long encodedUs = 0;
+            if (measureLatency) {
+                encodedUs = captureClockUs();
+                encodeLatency.add(encodedUs - bufferInfo.presentationTimeUs);
+            }
+
+            beginTraceSection("scrcpy:write", bufferInfo.presentationTimeUs);
+            try {
+                streamer.writePacket(codecBuffer, bufferInfo);
+            } finally {
+                Trace.endSection();
+            }
+
+            if (measureLatency) {
+                long nowUs = captureClockUs();
+                writeLatency.add(nowUs - bufferInfo.presentationTimeUs);
+                writeBlockLatency.add(nowUs - encodedUs);
+                if (latencyStats && nowUs >= nextLatencyReport) {
+                    if (nextLatencyReport != 0) {
+                        reportLatency();
+                    }
+                    nextLatencyReport = nowUs + LATENCY_REPORT_INTERVAL_US;
+                }
+                if (encoderStats && nowUs >= nextEncoderStats) {
+                    nextEncoderStats = nowUs + ENCODER_STATS_INTERVAL_US;
+                    sendEncoderStats();
+                }
+            }
+        } finally {
+            codec.releaseOutputBuffer(index, false);
+        }
+    }
+
+    /**
+     * Set the sender used to notify the client when frames are dropped due to congestion.
+     * <p>
+     * This method must be called before {@link #start(TerminationListener)}.
+     *
+     * @param sender the device message sender
+     */
+    public void setDeviceMessageSender(DeviceMessageSender sender) {
+        this.sender = sender;
+    }
+
+    /**
+     * Set the reconnector used to resume the stream if the video connection is lost.
+     * <p>
+     * This method must be called before {@link #start(TerminationListener)}.
+     *
+     * @param reconnector the video reconnector
+     */
+    public void setVideoReconnector(VideoReconnector reconnector) {
+        this.reconnector = reconnector;
+    }
+
+    /**
+     * Handle a network feedback from the client, to adapt the bit rate.
+     * <p>
+     * This method is called from the controller thread.
+     *
+     * @param queuingDelayUs the queuing delay estimated by the client
+     */
+    public void onVideoFeedback(int queuingDelayUs) {
+        synchronized (bitRateController) {
+            int newBitRate = bitRateController.onFeedback(queuingDelayUs, SystemClock.uptimeMillis());
+            if (newBitRate != 0) {
+                Ln.d("Video bit rate: " + newBitRate + " (queuing delay: " + queuingDelayUs / 1000 + "ms)");
+                pendingBitRate.set(newBitRate);
+            }
+        }
+    }
+
+    /**
+     * Limit the video encoding to reduce the device heat (or the battery drain).
+     * <p>
+     * The bit rate is changed without restarting the encoder. If the frame rate or the size limit changes, the encoding session is restarted.
+     * <p>
+     * This method is called from the thermal monitor thread.
+     *
+     * @param bitRatePercent the maximum bit rate, relative to the requested bit rate
+     * @param maxFps the maximum frame rate (0 for no limit, the limit requested by the client still applies)
+     * @param sizePercent the video size, relative to the size before the thermal reduction
+     */
+    public void setThermalLimits(int bitRatePercent, int maxFps, int sizePercent) {
+        synchronized (bitRateController) {
+            int newBitRate = bitRateController.setLimit((int) ((long) videoBitRate * bitRatePercent / 100));
+            if (newBitRate != 0) {
+                pendingBitRate.set(newBitRate);
+            }
+        }
+
+        synchronized (this) {
+            if (maxFps == pendingThermalMaxFps && sizePercent == pendingThermalSizePercent) {
+                return;
+            }
+            pendingThermalMaxFps = maxFps;
+            pendingThermalSizePercent = sizePercent;
+            thermalLimitsChanged = true;
+        }
+        // Restart the encoding, like on rotation
+        capture.requestReset();
+    }
+
+    /**
+     * Change the maximum video size and frame rate, by restarting the encoding session (but not the whole capture).
+     * <p>
+     * This method is called from the controller thread.
+     *
+     * @param maxSize the new maximum size (0 for no limit)
+     * @param maxFps the new maximum frame rate (0 for no limit)
+     */
+    public void setVideoLimits(int maxSize, int maxFps) {
+        synchronized (this) {
+            pendingMaxSize = maxSize & ~7; // multiple of 8
+            pendingMaxFps = maxFps;
+            videoLimitsChanged = true;
+        }
+        // Restart the encoding, like on rotation
+        capture.requestReset();
+    }
+
+    private boolean applyPendingVideoLimits() {
+        int newMaxSize;
+        int newMaxFps;
+        synchronized (this) {
+            if (!videoLimitsChanged) {
+                return false;
+            }
+            videoLimitsChanged = false;
+            newMaxSize = pendingMaxSize;
+            newMaxFps = pendingMaxFps;
+        }
+
+        if (!capture.setMaxSize(newMaxSize)) {
+            Ln.w("Could not change the video size to " + newMaxSize);
+        }
+        maxFps = newMaxFps;
+        // The size requested by the client replaces the thermal reduction (it is reduced again on the next thermal change)
+        unthrottledMaxSize = 0;
+        thermalSizePercent = 100;
+        Ln.i("Video limits: max size " + newMaxSize + ", max fps " + newMaxFps);
+        return true;
+    }
+
+    private boolean applyPendingThermalLimits() {
+        int newMaxFps;
+        int newSizePercent;
+        synchronized (this) {
+            if (!thermalLimitsChanged) {
+                return false;
+            }
+            thermalLimitsChanged = false;
+            newMaxFps = pendingThermalMaxFps;
+            newSizePercent = pendingThermalSizePercent;
+        }
+
+        thermalMaxFps = newMaxFps;
+        if (newSizePercent != thermalSizePercent) {
+            if (unthrottledMaxSize == 0) {
+                Size size = capture.getSize();
+                unthrottledMaxSize = Math.max(size.getWidth(), size.getHeight());
+            }
+            int maxSize = (unthrottledMaxSize * newSizePercent / 100) & ~7; // multiple of 8
+            if (!capture.setMaxSize(maxSize)) {
+                Ln.w("Could not change the video size to " + maxSize);
+            }
+            thermalSizePercent = newSizePercent;
+            if (newSizePercent == 100) {
+                unthrottledMaxSize = 0;
+            }
+        }
+        return true;
+    }
+
+    private int getEffectiveMaxFps() {
+        if (thermalMaxFps == 0) {
+            return maxFps;
+        }
+        return maxFps == 0 ? thermalMaxFps : Math.min(maxFps, thermalMaxFps);
+    }
+
+    /**
+     * Change the captured region, by changing the projection of the capture (the encoding session is not restarted).
+     * <p>
+     * This method is called from the controller thread.
+     *
+     * @param region the region, in the current device orientation, or {@code null} to restore the initial crop
+     * @return {@code true} on success
+     */
+    public boolean setCrop(Rect region) {
+        if (!capture.setCrop(region)) {
+            return false;
+        }
+        Ln.i("Crop: " + (region != null ? region.toShortString() : "initial"));
+        return true;
+    }
+
+    /**
+     * Request the encoder to produce a keyframe as soon as possible (to recover from a decoding error on the client side).
+     * <p>
+     * This method is called from the controller thread.
+     */
+    public void requestKeyFrame() {
+        pendingKeyFrame.set(true);
+    }
+
+    private void applyPendingKeyFrame(MediaCodec codec) {
+        if (pendingKeyFrame.getAndSet(false)) {
+            Ln.d("Keyframe requested");
+            requestSyncFrame(codec);
+        }
+    }
+
+    private static void requestSyncFrame(MediaCodec codec) {
+        Bundle bundle = new Bundle();
+        bundle.putInt(MediaCodec.PARAMETER_KEY_REQUEST_SYNC_FRAME, 0);
+        codec.setParameters(bundle);
+    }
+
+    private void applyPendingBitRate(MediaCodec codec) {
+        int bitRate = pendingBitRate.getAndSet(0);
+        if (bitRate == 0) {
+            return;
+        }
+
+        currentBitRate = bitRate;
+        streamer.setPacingBitRate(bitRate);
+        if (codec != null) {
+            // Change the bit rate without restarting the encoder
+            Bundle bundle = new Bundle();
+            bundle.putInt(MediaCodec.PARAMETER_KEY_VIDEO_BITRATE, bitRate);
+            codec.setParameters(bundle);
+        }
+    }
+
+    private void reportLatency() {
+        String encode = encodeLatency.format();
+        if (encode != null) {
+            Ln.i("Latency " + encode + " | " + writeLatency.format() + " | " + writeBlockLatency.format());
+        }
+    }
+
+    private void sendEncoderStats() {
+        if (sender == null) {
+            // The device messages require the control channel
+            return;
+        }
+        long[] encode = encodeLatency.getPercentiles(50, 99);
+        long[] writeBlock = writeBlockLatency.getPercentiles(50, 99);
+        if (encode != null && writeBlock != null) {
+            sender.send(DeviceMessage.createEncoderStats(clampToInt(encode[0]), clampToInt(encode[1]), clampToInt(writeBlock[0]),
+                    clampToInt(writeBlock[1])));
+        }
+    }
+
+    private static int clampToInt(long value) {
+        return (int) Math.min(value, Integer.MAX_VALUE);
+    }
+
     private static MediaCodec createMediaCodec(Codec codec, String encoderName) throws IOException, ConfigurationException {
         if (encoderName != null) {
             Ln.d("Creating encoder by name: '" + encoderName + "'");
@@ -213,16 +709,117 @@ public class SurfaceEncoder implements AsyncProcessor {
         }
     }
 
-    private static MediaFormat createFormat(String videoMimeType, int bitRate, int maxFps, List<CodecOption> codecOptions) {
+    private static int getNominalFrameRate(int maxFps) {
+        return maxFps > 0 ? maxFps : DEFAULT_NOMINAL_FRAME_RATE;
+    }
+
+    private static void setLowLatencyKeys(MediaFormat format, int maxFps) {
+        // 0 is realtime priority
+        format.setInteger(MediaFormat.KEY_PRIORITY, 0);
+        format.setInteger(MediaFormat.KEY_OPERATING_RATE, getNominalFrameRate(maxFps));
+        format.setInteger(MediaFormat.KEY_LOW_LATENCY, 1);
+        format.setInteger(MediaFormat.KEY_MAX_B_FRAMES, 0);
+    }
+
+    private static void setIntraRefreshKeys(MediaFormat format, int maxFps) {
+        // Refresh the whole picture progressively (over about 1 second) rather than with periodic keyframes, which cause bit rate spikes
+        format.setInteger(MediaFormat.KEY_INTRA_REFRESH_PERIOD, getNominalFrameRate(maxFps));
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.N_MR1) {
+            // Negative: only the first frame is a keyframe (new keyframes may still be requested explicitly, e.g. by the recorder)
+            format.setInteger(MediaFormat.KEY_I_FRAME_INTERVAL, -1);
+        } else {
+            format.setInteger(MediaFormat.KEY_I_FRAME_INTERVAL, DEFAULT_I_FRAME_INTERVAL);
+        }
+    }
+
+    private void setHdrKeys(MediaFormat format, MediaCodec mediaCodec, Codec codec) {
+        if (codec != VideoCodec.H265 || Build.VERSION.SDK_INT < Build.VERSION_CODES.N) {
+            if (!hdrReported) {
+                Ln.w("10-bit encoding requires H.265 and Android 7+, encoding in 8-bit");
+                hdrReported = true;
+            }
+            return;
+        }
+
+        boolean hdr10 = capture.isHdr10();
+        int profile = hdr10 ? MediaCodecInfo.CodecProfileLevel.HEVCProfileMain10HDR10 : MediaCodecInfo.CodecProfileLevel.HEVCProfileMain10;
+        if (!isProfileSupported(mediaCodec, codec.getMimeType(), profile)) {
+            if (!hdrReported) {
+                Ln.w("The encoder '" + mediaCodec.getName() + "' does not support the 10-bit profile, encoding in 8-bit");
+                hdrReported = true;
+            }
+            return;
+        }
+
+        format.setInteger(MediaFormat.KEY_PROFILE, profile);
+        if (hdr10) {
+            format.setInteger(MediaFormat.KEY_COLOR_STANDARD, MediaFormat.COLOR_STANDARD_BT2020);
+            format.setInteger(MediaFormat.KEY_COLOR_TRANSFER, MediaFormat.COLOR_TRANSFER_ST2084);
+            format.setInteger(MediaFormat.KEY_COLOR_RANGE, MediaFormat.COLOR_RANGE_LIMITED);
+        }
+
+        if (!hdrReported) {
+            Ln.i("Video encoding: 10-bit H.265 (" + (hdr10 ? "Main10 HDR10" : "Main10") + ")");
+            hdrReported = true;
+        }
+    }
+
+    private static boolean isProfileSupported(MediaCodec mediaCodec, String mimeType, int profile) {
+        MediaCodecInfo.CodecProfileLevel[] profileLevels = mediaCodec.getCodecInfo().getCapabilitiesForType(mimeType).profileLevels;
+        for (MediaCodecInfo.CodecProfileLevel profileLevel : profileLevels) {
+            if (profileLevel.profile == profile) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    private void reportAcceptedKeys(MediaCodec codec) {
+        List<String> keys = new ArrayList<>();
+        if (lowLatency) {
+            keys.add(MediaFormat.KEY_PRIORITY);
+            keys.add(MediaFormat.KEY_OPERATING_RATE);
+            keys.add(MediaFormat.KEY_LOW_LATENCY);
+            keys.add(MediaFormat.KEY_MAX_B_FRAMES);
+        }
+        if (intraRefresh) {
+            keys.add(MediaFormat.KEY_INTRA_REFRESH_PERIOD);
+        }
+        // The output format contains the configuration accepted by the codec
+        MediaFormat accepted = codec.getOutputFormat();
+        StringBuilder honored = new StringBuilder();
+        StringBuilder ignored = new StringBuilder();
+        for (String key : keys) {
+            StringBuilder builder = accepted.containsKey(key) ? honored : ignored;
+            if (builder.length() > 0) {
+                builder.append(", ");
+            }
+            builder.append(key);
+        }
+        Ln.i("Video encoder configuration: honored keys: [" + honored + "], ignored keys: [" + ignored + "]");
+    }
+
+    private static MediaFormat createFormat(String videoMimeType, int bitRate, int maxFps, long repeatFrameDelayUs, boolean lowLatency,
+            boolean intraRefresh, List<CodecOption> codecOptions) {
         MediaFormat format = new MediaFormat();
         format.setString(MediaFormat.KEY_MIME, videoMimeType);
         format.setInteger(MediaFormat.KEY_BIT_RATE, bitRate);
         // must be present to configure the encoder, but does not impact the actual frame rate, which is variable
         format.setInteger(MediaFormat.KEY_FRAME_RATE, 60);
         format.setInteger(MediaFormat.KEY_COLOR_FORMAT, MediaCodecInfo.CodecCapabilities.COLOR_FormatSurface);
-        format.setInteger(MediaFormat.KEY_I_FRAME_INTERVAL, DEFAULT_I_FRAME_INTERVAL);
-        // display the very first frame, and recover from bad quality when no new frames
-        format.setLong(MediaFormat.KEY_REPEAT_PREVIOUS_FRAME_AFTER, REPEAT_FRAME_DELAY_US); // µs
+        if (intraRefresh) {
+            setIntraRefreshKeys(format, maxFps);
+        } else {
+            format.setInteger(MediaFormat.KEY_I_FRAME_INTERVAL, DEFAULT_I_FRAME_INTERVAL);
+        }
+        if (lowLatency) {
+            setLowLatencyKeys(format, maxFps);
+        }
+        if (repeatFrameDelayUs > 0) {
+            // display the very first frame, and recover from bad quality when no new frames
+            format.setLong(MediaFormat.KEY_REPEAT_PREVIOUS_FRAME_AFTER, repeatFrameDelayUs); // µs
+        }
+        // otherwise, nothing is encoded while the content is static
         if (maxFps > 0) {
             // The key existed privately before Android 10:
             // <https://android.googlesource.com/platform/frameworks/base/+/625f0aad9f7a259b6881006ad8710adce57d1384%5E%21/>
@@ -279,4 +876,65 @@ public class SurfaceEncoder implements AsyncProcessor {
             thread.join();
         }
     }
+
+    private final class EncoderCallback extends MediaCodec.Callback {
+        @Override
+        public void onInputBufferAvailable(MediaCodec codec, int index) {
+            // ignore, the input is a Surface
+        }
+
+        @Override
+        public void onOutputBufferAvailable(MediaCodec codec, int index, MediaCodec.BufferInfo bufferInfo) {
+            boolean isConfig = (bufferInfo.flags & MediaCodec.BUFFER_FLAG_CODEC_CONFIG) != 0;
+            boolean isKeyFrame = (bufferInfo.flags & MediaCodec.BUFFER_FLAG_KEY_FRAME) != 0;
+            if (isKeyFrame && dropUntilKeyFrame) {
+                dropUntilKeyFrame = false;
+                Ln.d("Video congestion: " + droppedFrames + " frames dropped in total");
+                if (sender != null) {
+                    sender.send(DeviceMessage.createVideoDropped(droppedFrames));
+                }
+            }
+
+            if (dropUntilKeyFrame && !isConfig) {
+                // The following frames could not be decoded without the dropped ones
+                codec.releaseOutputBuffer(index, false);
+                ++droppedFrames;
+                return;
+            }
+
+            if (!outputTasks.offer(new OutputTask(index, bufferInfo))) {
+                // The writer does not keep up (the socket is congested): never block the codec, skip to the latest content instead
+                Ln.d("Video output queue full, dropping frames until the next keyframe");
+                codec.releaseOutputBuffer(index, false);
+                ++droppedFrames;
+                dropQueuedFrames(codec);
+                dropUntilKeyFrame = true;
+                // Do not wait for the writer (it is blocked), request the keyframe immediately
+                requestSyncFrame(codec);
+            }
+        }
+
+        private void dropQueuedFrames(MediaCodec codec) {
+            List<OutputTask> tasks = new ArrayList<>();
+            outputTasks.drainTo(tasks);
+            for (OutputTask task : tasks) {
+                boolean isConfig = (task.bufferInfo.flags & MediaCodec.BUFFER_FLAG_CODEC_CONFIG) != 0;
+                // Only the writer removes tasks, so there is room to keep the config packets
+                if (!isConfig || !outputTasks.offer(task)) {
+                    codec.releaseOutputBuffer(task.index, false);
+                    ++droppedFrames;
+                }
+            }
+        }
+
+        @Override
+        public void onError(MediaCodec codec, MediaCodec.CodecException e) {
+            codecError.set(e);
+        }
+
+        @Override
+        public void onOutputFormatChanged(MediaCodec codec, MediaFormat format) {
+            // ignore
+        }
+    }
 }
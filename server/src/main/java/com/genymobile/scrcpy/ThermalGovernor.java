@@ -0,0 +1,127 @@
+package com.genymobile.scrcpy;
+
+/**
+ * Decide how much to limit the video encoding from the thermal status and the battery level of the device ({@code --thermal-governor}).
+ * <p>
+ * The state of the device is mapped to a level, each level reducing further the bit rate, the frame rate and the resolution. The thermal headroom
+ * forecast (if available) raises the level before the device actually throttles, so that the encoder never misses its deadlines.
+ * <p>
+ * A higher level is applied immediately, but a lower level only once the device has cooled down for {@link #RECOVERY_DELAY_MS}, to avoid
+ * oscillating around a thermal threshold.
+ */
+public final class ThermalGovernor {
+
+    // Values of android.os.PowerManager.THERMAL_STATUS_*
+    public static final int THERMAL_STATUS_NONE = 0;
+    public static final int THERMAL_STATUS_LIGHT = 1;
+    public static final int THERMAL_STATUS_MODERATE = 2;
+    public static final int THERMAL_STATUS_SEVERE = 3;
+
+    // The device reaches THERMAL_STATUS_SEVERE at a headroom of 1
+    static final float HIGH_HEADROOM = 0.85f;
+    static final float SEVERE_HEADROOM = 1f;
+    static final int LOW_BATTERY_LEVEL = 15; // percent
+    static final long RECOVERY_DELAY_MS = 30_000;
+
+    public static final class Limits {
+        private final int bitRatePercent;
+        private final int maxFps; // 0 for no limit
+        private final int sizePercent;
+
+        private Limits(int bitRatePercent, int maxFps, int sizePercent) {
+            this.bitRatePercent = bitRatePercent;
+            this.maxFps = maxFps;
+            this.sizePercent = sizePercent;
+        }
+
+        public int getBitRatePercent() {
+            return bitRatePercent;
+        }
+
+        public int getMaxFps() {
+            return maxFps;
+        }
+
+        public int getSizePercent() {
+            return sizePercent;
+        }
+    }
+
+    private static final Limits[] LEVELS = {
+            new Limits(100, 0, 100),
+            new Limits(75, 0, 100),
+            new Limits(50, 30, 100),
+            new Limits(35, 30, 75),
+    };
+
+    public static final int MAX_LEVEL = LEVELS.length - 1;
+
+    private int level;
+    // Highest level requested since the device started to cool down (-1 if it is not cooling down)
+    private int recoveryLevel = -1;
+    private long recoverySince;
+
+    public static Limits getLimits(int level) {
+        return LEVELS[level];
+    }
+
+    /**
+     * Compute the level required by the current state of the device.
+     *
+     * @param thermalStatus the thermal status (a {@code THERMAL_STATUS_*} value), or -1 if unknown
+     * @param headroom the forecast thermal headroom, or {@code NaN} if unknown
+     * @param batteryLevel the battery level (percent), or -1 if unknown
+     * @param charging {@code true} if the battery is charging
+     * @return the level
+     */
+    public static int computeLevel(int thermalStatus, float headroom, int batteryLevel, boolean charging) {
+        int target = Math.max(0, Math.min(thermalStatus, MAX_LEVEL));
+        // Comparisons with NaN are always false
+        if (headroom >= SEVERE_HEADROOM) {
+            target = Math.max(target, 2);
+        } else if (headroom >= HIGH_HEADROOM) {
+            target = Math.max(target, 1);
+        }
+        if (batteryLevel >= 0 && batteryLevel <= LOW_BATTERY_LEVEL && !charging) {
+            target = Math.max(target, 1);
+        }
+        return target;
+    }
+
+    public int getLevel() {
+        return level;
+    }
+
+    /**
+     * Update the level.
+     *
+     * @param target the level required by the current state of the device (see {@link #computeLevel(int, float, int, boolean)})
+     * @param nowMs the current time (ms)
+     * @return the new level if it changed, or -1 otherwise
+     */
+    public int update(int target, long nowMs) {
+        if (target >= level) {
+            recoveryLevel = -1;
+            if (target == level) {
+                return -1;
+            }
+            level = target;
+            return level;
+        }
+
+        if (recoveryLevel == -1) {
+            recoveryLevel = target;
+            recoverySince = nowMs;
+            return -1;
+        }
+
+        recoveryLevel = Math.max(recoveryLevel, target);
+        if (nowMs - recoverySince < RECOVERY_DELAY_MS) {
+            return -1;
+        }
+
+        level = recoveryLevel;
+        recoveryLevel = -1;
+        return level;
+    }
+}
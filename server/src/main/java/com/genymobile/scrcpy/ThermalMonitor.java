@@ -0,0 +1,164 @@
+package com.genymobile.scrcpy;
+
+import com.genymobile.scrcpy.wrappers.ServiceManager;
+import com.genymobile.scrcpy.wrappers.ThermalService;
+
+import android.os.Build;
+import android.os.SystemClock;
+
+import java.io.BufferedReader;
+import java.io.FileReader;
+import java.io.IOException;
+
+/**
+ * Poll the thermal status and the battery level of the device, and limit the video encoding accordingly ({@code --thermal-governor}).
+ * <p>
+ * The client is notified of each change by a device message (if the control channel is enabled).
+ */
+public final class ThermalMonitor implements AsyncProcessor {
+
+    private static final long POLL_INTERVAL_MS = 2000;
+    private static final int HEADROOM_FORECAST_SECONDS = 10;
+    private static final String BATTERY_DIR = "/sys/class/power_supply/battery/";
+
+    private final SurfaceEncoder surfaceEncoder;
+    private final DeviceMessageSender sender; // may be null
+    private final ThermalGovernor governor = new ThermalGovernor();
+
+    // Only accessed from the monitor thread
+    private ThermalService thermalService;
+    private boolean headroomAvailable;
+    private boolean batteryAvailable = true;
+
+    private Thread thread;
+
+    public ThermalMonitor(SurfaceEncoder surfaceEncoder, DeviceMessageSender sender) {
+        this.surfaceEncoder = surfaceEncoder;
+        this.sender = sender;
+    }
+
+    private void monitor() throws InterruptedException {
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.Q) {
+            thermalService = ServiceManager.getThermalService();
+        }
+        if (thermalService == null) {
+            Ln.w("Thermal status not available (Android 10+ required), only the battery level is monitored");
+        }
+        headroomAvailable = thermalService != null && Build.VERSION.SDK_INT >= Build.VERSION_CODES.R;
+
+        while (!Thread.currentThread().isInterrupted()) {
+            int thermalStatus = getThermalStatus();
+            float headroom = getHeadroom();
+            int batteryLevel = getBatteryLevel();
+            boolean charging = batteryLevel != -1 && isCharging();
+
+            int target = ThermalGovernor.computeLevel(thermalStatus, headroom, batteryLevel, charging);
+            int level = governor.update(target, SystemClock.uptimeMillis());
+            if (level != -1) {
+                apply(level, thermalStatus, batteryLevel);
+            }
+
+            Thread.sleep(POLL_INTERVAL_MS);
+        }
+    }
+
+    private void apply(int level, int thermalStatus, int batteryLevel) {
+        ThermalGovernor.Limits limits = ThermalGovernor.getLimits(level);
+        Ln.i("Thermal governor level " + level + "/" + ThermalGovernor.MAX_LEVEL + " (thermal status " + thermalStatus + ", battery "
+                + batteryLevel + "%): bit rate " + limits.getBitRatePercent() + "%, max fps " + limits.getMaxFps() + ", size "
+                + limits.getSizePercent() + "%");
+        surfaceEncoder.setThermalLimits(limits.getBitRatePercent(), limits.getMaxFps(), limits.getSizePercent());
+        if (sender != null) {
+            sender.send(DeviceMessage.createThermalState(thermalStatus, batteryLevel, level));
+        }
+    }
+
+    private int getThermalStatus() {
+        if (thermalService == null) {
+            return -1;
+        }
+        try {
+            return thermalService.getCurrentThermalStatus();
+        } catch (ReflectiveOperationException e) {
+            Ln.w("Could not get the thermal status, only the battery level is monitored", e);
+            thermalService = null;
+            headroomAvailable = false;
+            return -1;
+        }
+    }
+
+    private float getHeadroom() {
+        if (!headroomAvailable) {
+            return Float.NaN;
+        }
+        try {
+            return thermalService.getThermalHeadroom(HEADROOM_FORECAST_SECONDS);
+        } catch (ReflectiveOperationException e) {
+            Ln.w("Could not get the thermal headroom", e);
+            headroomAvailable = false;
+            return Float.NaN;
+        }
+    }
+
+    private int getBatteryLevel() {
+        if (!batteryAvailable) {
+            return -1;
+        }
+        try {
+            return Integer.parseInt(readBatteryProperty("capacity"));
+        } catch (IOException | NumberFormatException e) {
+            Ln.w("Could not read the battery level: " + e.getMessage());
+            batteryAvailable = false;
+            return -1;
+        }
+    }
+
+    private static boolean isCharging() {
+        try {
+            String status = readBatteryProperty("status");
+            return "Charging".equals(status) || "Full".equals(status);
+        } catch (IOException e) {
+            // Never throttle on a battery level which could not be read
+            return true;
+        }
+    }
+
+    private static String readBatteryProperty(String name) throws IOException {
+        try (BufferedReader reader = new BufferedReader(new FileReader(BATTERY_DIR + name))) {
+            String line = reader.readLine();
+            if (line == null) {
+                throw new IOException("Empty " + BATTERY_DIR + name);
+            }
+            return line.trim();
+        }
+    }
+
+    @Override
+    public void start(TerminationListener listener) {
+        thread = new Thread(() -> {
+            try {
+                monitor();
+            } catch (InterruptedException e) {
+                // stopped
+            } finally {
+                Ln.d("Thermal monitor stopped");
+                listener.onTerminated(false);
+            }
+        }, "thermal-monitor");
+        thread.start();
+    }
+
+    @Override
+    public void stop() {
+        if (thread != null) {
+            thread.interrupt();
+        }
+    }
+
+    @Override
+    public void join() throws InterruptedException {
+        if (thread != null) {
+            thread.join();
+        }
+    }
+}
@@ -0,0 +1,376 @@
+package com.genymobile.scrcpy;
+
+import android.system.ErrnoException;
+import android.system.Os;
+import android.system.OsConstants;
+
+import java.io.FileDescriptor;
+import java.io.IOException;
+import java.net.DatagramPacket;
+import java.net.DatagramSocket;
+import java.nio.ByteBuffer;
+import java.security.MessageDigest;
+import java.util.Arrays;
+
+/**
+ * Transmit the video packets over UDP (in direct mode), so that a lost datagram does not block the following frames.
+ * <p>
+ * The video streamer writes to a local socket pair, as usual. The stream header (codec id and video size) is forwarded over the TCP video
+ * connection, then each packet (its 12-byte header and its payload) is split into datagrams:
+ *
+ * <pre>
+ *     type (1) | flags (1) | sequence (4) | index (2) | count (2) | length (4) | payload
+ * </pre>
+ * <p>
+ * After each group of {@link #FEC_GROUP_SIZE} data fragments, a parity datagram (the XOR of the fragments of the group) is sent, so that the
+ * client may rebuild one lost fragment per group without a round-trip. The client may also request the retransmission of the missing
+ * fragments of the recent packets, or request a new keyframe if a packet is definitely lost.
+ */
+public final class UdpVideoChannel {
+
+    // Must match the client
+    public static final int TYPE_DATA = 0;
+    public static final int TYPE_PARITY = 1;
+    public static final int TYPE_HELLO = 2;
+    public static final int TYPE_NACK = 3;
+    public static final int TYPE_REQUEST_KEYFRAME = 4;
+
+    public static final int FLAG_CONFIG = 1;
+    public static final int FLAG_KEY_FRAME = 2;
+
+    private static final int HEADER_LENGTH = 14;
+    private static final int FRAGMENT_SIZE = 1200;
+    private static final int FEC_GROUP_SIZE = 8;
+    private static final int MAX_FEEDBACK_LENGTH = 2048;
+
+    // Number of recent packets kept for retransmission (a power of 2)
+    private static final int HISTORY_SIZE = 64;
+
+    private static final int PACKET_HEADER_LENGTH = 12;
+    private static final long PACKET_FLAG_CONFIG = 1L << 63;
+    private static final long PACKET_FLAG_KEY_FRAME = 1L << 62;
+
+    private final DatagramSocket socket;
+    private final FileDescriptor tcpFd;
+
+    // The streamer writes to streamFd, the sender reads from localFd
+    private final FileDescriptor localFd = new FileDescriptor();
+    private final FileDescriptor streamFd = new FileDescriptor();
+
+    private final byte[][] historyData = new byte[HISTORY_SIZE][];
+    private final int[] historySequence = new int[HISTORY_SIZE];
+    private final int[] historyFlags = new int[HISTORY_SIZE];
+
+    private volatile Runnable keyFrameRequestListener;
+
+    private Thread sendThread;
+    private Thread feedbackThread;
+
+    /**
+     * Create the channel over a UDP socket connected to the client (see {@link #acceptClient(DatagramSocket, byte[], int)}).
+     *
+     * @param tcpFd the TCP video connection
+     */
+    public UdpVideoChannel(DatagramSocket socket, FileDescriptor tcpFd) throws IOException {
+        this.socket = socket;
+        this.tcpFd = tcpFd;
+        try {
+            Os.socketpair(OsConstants.AF_UNIX, OsConstants.SOCK_STREAM, 0, localFd, streamFd);
+        } catch (ErrnoException e) {
+            throw new IOException(e);
+        }
+    }
+
+    /**
+     * Wait for the first datagram of the client, which must contain the token, and connect the socket to its address.
+     */
+    public static void acceptClient(DatagramSocket socket, byte[] token, int timeoutMs) throws IOException {
+        byte[] buffer = new byte[1 + token.length];
+        DatagramPacket packet = new DatagramPacket(buffer, buffer.length);
+
+        socket.setSoTimeout(timeoutMs);
+        while (true) {
+            // throws a SocketTimeoutException if the client does not send its token in time
+            packet.setLength(buffer.length);
+            socket.receive(packet);
+            if (packet.getLength() == buffer.length && buffer[0] == TYPE_HELLO
+                    && MessageDigest.isEqual(token, Arrays.copyOfRange(buffer, 1, buffer.length))) {
+                break;
+            }
+            Ln.w("UDP datagram rejected from " + packet.getAddress());
+        }
+        socket.setSoTimeout(0);
+
+        // Ignore the datagrams from any other address
+        socket.connect(packet.getSocketAddress());
+        socket.send(new DatagramPacket(new byte[] {TYPE_HELLO}, 1));
+    }
+
+    /**
+     * Return the file descriptor the video streamer must write to.
+     */
+    public FileDescriptor getFd() {
+        return streamFd;
+    }
+
+    public void setKeyFrameRequestListener(Runnable listener) {
+        keyFrameRequestListener = listener;
+    }
+
+    public void setSendBufferSize(int size) throws IOException {
+        socket.setSendBufferSize(size);
+    }
+
+    public void start() {
+        sendThread = new Thread(this::runSender, "udp-video-send");
+        feedbackThread = new Thread(this::runFeedback, "udp-video-feedback");
+        sendThread.start();
+        feedbackThread.start();
+    }
+
+    private void runSender() {
+        try {
+            // The stream header is sent over TCP
+            byte[] codecId = new byte[4];
+            if (!readFully(localFd, codecId, 0, codecId.length)) {
+                return;
+            }
+            IO.writeFully(tcpFd, codecId, 0, codecId.length);
+
+            int id = ByteBuffer.wrap(codecId).getInt();
+            if (id == 0 || id == 1) {
+                // The stream is disabled (see Streamer.writeDisableStream())
+                return;
+            }
+
+            byte[] videoSize = new byte[8];
+            if (!readFully(localFd, videoSize, 0, videoSize.length)) {
+                return;
+            }
+            IO.writeFully(tcpFd, videoSize, 0, videoSize.length);
+
+            byte[] header = new byte[PACKET_HEADER_LENGTH];
+            int sequence = 0;
+            while (readFully(localFd, header, 0, header.length)) {
+                ByteBuffer headerBuffer = ByteBuffer.wrap(header);
+                long ptsAndFlags = headerBuffer.getLong();
+                int size = headerBuffer.getInt();
+                if (size < 0) {
+                    throw new IOException("Invalid packet size: " + size);
+                }
+
+                byte[] data = new byte[PACKET_HEADER_LENGTH + size];
+                System.arraycopy(header, 0, data, 0, header.length);
+                if (!readFully(localFd, data, PACKET_HEADER_LENGTH, size)) {
+                    break;
+                }
+
+                int flags = 0;
+                if ((ptsAndFlags & PACKET_FLAG_CONFIG) != 0) {
+                    flags |= FLAG_CONFIG;
+                }
+                if ((ptsAndFlags & PACKET_FLAG_KEY_FRAME) != 0) {
+                    flags |= FLAG_KEY_FRAME;
+                }
+
+                sendPacket(sequence++, flags, data);
+            }
+        } catch (IOException e) {
+            // this is expected on close
+        } finally {
+            // Notify the client on the TCP connection (the end of a datagram stream is not reliable)
+            shutdownFd(tcpFd);
+            shutdownFd(localFd);
+        }
+    }
+
+    private void sendPacket(int sequence, int flags, byte[] data) throws IOException {
+        int count = (data.length + FRAGMENT_SIZE - 1) / FRAGMENT_SIZE;
+        if (count > 0xFFFF) {
+            throw new IOException("Video packet too large: " + data.length);
+        }
+
+        synchronized (this) {
+            int slot = sequence & (HISTORY_SIZE - 1);
+            historyData[slot] = data;
+            historySequence[slot] = sequence;
+            historyFlags[slot] = flags;
+        }
+
+        byte[] datagram = new byte[HEADER_LENGTH + FRAGMENT_SIZE];
+        byte[] parity = new byte[HEADER_LENGTH + FRAGMENT_SIZE];
+        int parityLength = 0;
+        for (int index = 0; index < count; ++index) {
+            int offset = index * FRAGMENT_SIZE;
+            int length = Math.min(FRAGMENT_SIZE, data.length - offset);
+            sendFragment(datagram, TYPE_DATA, flags, sequence, index, count, data.length, data, offset, length);
+
+            for (int i = 0; i < length; ++i) {
+                parity[HEADER_LENGTH + i] ^= data[offset + i];
+            }
+            parityLength = Math.max(parityLength, length);
+
+            boolean lastOfGroup = (index + 1) % FEC_GROUP_SIZE == 0 || index == count - 1;
+            // A group of a single fragment would not be protected more by its parity than by a retransmission
+            if (lastOfGroup && index % FEC_GROUP_SIZE != 0) {
+                int group = index / FEC_GROUP_SIZE;
+                sendFragment(parity, TYPE_PARITY, flags, sequence, group, count, data.length, null, 0, parityLength);
+            }
+            if (lastOfGroup) {
+                Arrays.fill(parity, (byte) 0);
+                parityLength = 0;
+            }
+        }
+    }
+
+    // If data is null, the payload is already in the datagram buffer
+    private void sendFragment(byte[] datagram, int type, int flags, int sequence, int index, int count, int totalLength, byte[] data, int offset,
+            int length) throws IOException {
+        ByteBuffer buffer = ByteBuffer.wrap(datagram);
+        buffer.put((byte) type);
+        buffer.put((byte) flags);
+        buffer.putInt(sequence);
+        buffer.putShort((short) index);
+        buffer.putShort((short) count);
+        buffer.putInt(totalLength);
+        if (data != null) {
+            System.arraycopy(data, offset, datagram, HEADER_LENGTH, length);
+        }
+        socket.send(new DatagramPacket(datagram, HEADER_LENGTH + length));
+    }
+
+    private void runFeedback() {
+        byte[] buffer = new byte[MAX_FEEDBACK_LENGTH];
+        DatagramPacket packet = new DatagramPacket(buffer, buffer.length);
+        try {
+            while (true) {
+                packet.setLength(buffer.length);
+                socket.receive(packet);
+                int length = packet.getLength();
+                if (length == 0) {
+                    continue;
+                }
+
+                switch (buffer[0]) {
+                    case TYPE_HELLO:
+                        // The reply to the handshake has been lost, the client retries
+                        socket.send(new DatagramPacket(new byte[] {TYPE_HELLO}, 1));
+                        break;
+                    case TYPE_NACK:
+                        if (length >= 7) {
+                            handleNack(ByteBuffer.wrap(buffer, 1, length - 1));
+                        }
+                        break;
+                    case TYPE_REQUEST_KEYFRAME:
+                        Runnable listener = keyFrameRequestListener;
+                        if (listener != null) {
+                            listener.run();
+                        }
+                        break;
+                    default:
+                        Ln.w("Unknown UDP video feedback: " + buffer[0]);
+                        break;
+                }
+            }
+        } catch (IOException e) {
+            // this is expected on close
+        }
+    }
+
+    private void handleNack(ByteBuffer buffer) throws IOException {
+        int sequence = buffer.getInt();
+        int n = buffer.getShort() & 0xFFFF;
+
+        byte[] data;
+        int flags;
+        synchronized (this) {
+            int slot = sequence & (HISTORY_SIZE - 1);
+            if (historyData[slot] == null || historySequence[slot] != sequence) {
+                // Too old, the client will request a keyframe
+                return;
+            }
+            data = historyData[slot];
+            flags = historyFlags[slot];
+        }
+
+        int count = (data.length + FRAGMENT_SIZE - 1) / FRAGMENT_SIZE;
+        byte[] datagram = new byte[HEADER_LENGTH + FRAGMENT_SIZE];
+        if (n == 0) {
+            // The whole packet is missing
+            for (int index = 0; index < count; ++index) {
+                sendDataFragment(datagram, flags, sequence, index, count, data);
+            }
+            return;
+        }
+
+        for (int i = 0; i < n && buffer.remaining() >= 2; ++i) {
+            int index = buffer.getShort() & 0xFFFF;
+            if (index < count) {
+                sendDataFragment(datagram, flags, sequence, index, count, data);
+            }
+        }
+    }
+
+    private void sendDataFragment(byte[] datagram, int flags, int sequence, int index, int count, byte[] data) throws IOException {
+        int offset = index * FRAGMENT_SIZE;
+        int length = Math.min(FRAGMENT_SIZE, data.length - offset);
+        sendFragment(datagram, TYPE_DATA, flags, sequence, index, count, data.length, data, offset, length);
+    }
+
+    private static boolean readFully(FileDescriptor fd, byte[] buffer, int offset, int length) throws IOException {
+        while (length > 0) {
+            int r;
+            try {
+                r = Os.read(fd, buffer, offset, length);
+            } catch (ErrnoException e) {
+                if (e.errno == OsConstants.EINTR) {
+                    continue;
+                }
+                throw new IOException(e);
+            }
+            if (r <= 0) {
+                // End of stream
+                return false;
+            }
+            offset += r;
+            length -= r;
+        }
+        return true;
+    }
+
+    private static void shutdownFd(FileDescriptor fd) {
+        try {
+            Os.shutdown(fd, OsConstants.SHUT_RDWR);
+        } catch (ErrnoException e) {
+            // ignore
+        }
+    }
+
+    public void shutdown() {
+        shutdownFd(localFd);
+        // Wake up the feedback thread
+        socket.close();
+    }
+
+    public void join() throws InterruptedException {
+        if (sendThread != null) {
+            sendThread.join();
+        }
+        if (feedbackThread != null) {
+            feedbackThread.join();
+        }
+    }
+
+    public void close() {
+        socket.close();
+        for (FileDescriptor fd : new FileDescriptor[] {localFd, streamFd}) {
+            if (fd.valid()) {
+                try {
+                    Os.close(fd);
+                } catch (ErrnoException e) {
+                    // ignore
+                }
+            }
+        }
+    }
+}
@@ -26,9 +26,14 @@ public final class UhidManager {
     private static final short BUS_VIRTUAL = 0x06;
 
     private static final int SIZE_OF_UHID_EVENT = 4380; // sizeof(struct uhid_event)
+    private static final int UHID_DATA_MAX = 4096;
+    private static final int UHID_INPUT2_REQ_HEADER_SIZE = 6; // type (4 bytes) + size (2 bytes)
 
     private final ArrayMap<Integer, FileDescriptor> fds = new ArrayMap<>();
     private final ByteBuffer buffer = ByteBuffer.allocate(SIZE_OF_UHID_EVENT).order(ByteOrder.nativeOrder());
+    private final ByteBuffer inputBuffer = ByteBuffer.allocate(SIZE_OF_UHID_EVENT).order(ByteOrder.nativeOrder());
+    // Grown on demand for the batches of input reports
+    private ByteBuffer inputBatchBuffer = inputBuffer;
 
     private final DeviceMessageSender sender;
     private final HandlerThread thread = new HandlerThread("UHidManager");
@@ -51,6 +56,7 @@ public final class UhidManager {
                 FileDescriptor old = fds.put(id, fd);
                 if (old != null) {
                     Ln.w("Duplicate UHID id: " + id);
+                    unregisterUhidListener(old);
                     close(old);
                 }
 
@@ -93,6 +99,12 @@ public final class UhidManager {
         }
     }
 
+    private void unregisterUhidListener(FileDescriptor fd) {
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.M) {
+            queue.removeOnFileDescriptorEventListener(fd);
+        }
+    }
+
     private static byte[] extractHidOutputData(ByteBuffer buffer) {
         /*
          * #define UHID_DATA_MAX 4096
@@ -130,9 +142,59 @@ public final class UhidManager {
             return;
         }
 
+        if (data.length > UHID_DATA_MAX) {
+            Ln.w("UHID input too large: " + data.length);
+            return;
+        }
+
+        try {
+            ByteBuffer req = buildUhidInput2Req(data);
+            Os.write(fd, req.array(), 0, req.position());
+        } catch (ErrnoException e) {
+            throw new IOException(e);
+        }
+    }
+
+    public void writeInputs(int id, byte[][] reports) throws IOException {
+        FileDescriptor fd = fds.get(id);
+        if (fd == null) {
+            Ln.w("Unknown UHID id: " + id);
+            return;
+        }
+
+        // uhid handles a single event per write(), but a writev() processes each buffer as a separate write(): all the reports are written
+        // with a single syscall
+        int size = 0;
+        for (byte[] data : reports) {
+            if (data.length > UHID_DATA_MAX) {
+                Ln.w("UHID input too large: " + data.length);
+                return;
+            }
+            size += UHID_INPUT2_REQ_HEADER_SIZE + data.length;
+        }
+
+        // Only called from the controller thread, the buffer is reused for all the batches
+        if (inputBatchBuffer.capacity() < size) {
+            inputBatchBuffer = ByteBuffer.allocate(size).order(ByteOrder.nativeOrder());
+        }
+        ByteBuffer buf = inputBatchBuffer;
+        buf.clear();
+
+        Object[] buffers = new Object[reports.length];
+        int[] offsets = new int[reports.length];
+        int[] byteCounts = new int[reports.length];
+        for (int i = 0; i < reports.length; ++i) {
+            buffers[i] = buf.array();
+            offsets[i] = buf.position();
+            byteCounts[i] = UHID_INPUT2_REQ_HEADER_SIZE + reports[i].length;
+            putUhidInput2Req(buf, reports[i]);
+        }
+
         try {
-            byte[] req = buildUhidInput2Req(data);
-            Os.write(fd, req, 0, req.length);
+            int w = Os.writev(fd, buffers, offsets, byteCounts);
+            if (w != size) {
+                Ln.w("UHID input batch partially written: " + w + "/" + size + " bytes");
+            }
         } catch (ErrnoException e) {
             throw new IOException(e);
         }
@@ -175,7 +237,7 @@ public final class UhidManager {
         return buf.array();
     }
 
-    private static byte[] buildUhidInput2Req(byte[] data) {
+    private ByteBuffer buildUhidInput2Req(byte[] data) {
         /*
          * struct uhid_event {
          *     uint32_t type;
@@ -189,16 +251,29 @@ public final class UhidManager {
          * } __attribute__((__packed__));
          */
 
-        ByteBuffer buf = ByteBuffer.allocate(6 + data.length).order(ByteOrder.nativeOrder());
+        // Only called from the controller thread, the buffer is reused for all input reports
+        ByteBuffer buf = inputBuffer;
+        buf.clear();
+        putUhidInput2Req(buf, data);
+        return buf;
+    }
+
+    private static void putUhidInput2Req(ByteBuffer buf, byte[] data) {
+        // The trailing bytes of the struct are not written, the kernel only reads the reported size
         buf.putInt(UHID_INPUT2);
         buf.putShort((short) data.length);
         buf.put(data);
-        return buf.array();
     }
 
     public void close(int id) {
-        FileDescriptor fd = fds.get(id);
-        assert fd != null;
+        // Closing the file descriptor destroys the UHID device
+        FileDescriptor fd = fds.remove(id);
+        if (fd == null) {
+            Ln.w("Unknown UHID id: " + id);
+            return;
+        }
+
+        unregisterUhidListener(fd);
         close(fd);
     }
 
@@ -0,0 +1,222 @@
+package com.genymobile.scrcpy;
+
+import android.graphics.Rect;
+import android.opengl.GLES11Ext;
+import android.opengl.GLES20;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.FloatBuffer;
+import java.util.List;
+
+/**
+ * Single pass shader drawing the captured frame (an external texture) to the encoder surface.
+ * <p>
+ * When the frame is downscaled, each output pixel averages 4 bilinear samples spread over its footprint (so a box filter over 4x4 input pixels
+ * for a 2x downscaling), instead of a single bilinear sample (which skips input pixels and causes aliasing on text).
+ * <p>
+ * The masked regions are filled with black.
+ */
+public final class VideoFilter {
+
+    public static final int MAX_MASKS = 8;
+
+    private static final String VERTEX_SHADER = ""
+            + "attribute vec4 vPosition;\n"
+            + "attribute vec4 vTexCoord;\n"
+            + "uniform mat4 texMatrix;\n"
+            + "uniform vec2 tapOffset;\n"
+            + "varying vec2 texCoord;\n"
+            + "varying vec2 tapX;\n"
+            + "varying vec2 tapY;\n"
+            + "varying vec2 outCoord;\n"
+            + "void main() {\n"
+            + "    gl_Position = vPosition;\n"
+            + "    texCoord = (texMatrix * vTexCoord).xy;\n"
+            // the offsets between the taps, in the (possibly flipped or rotated) texture space
+            + "    tapX = (texMatrix * vec4(tapOffset.x, 0.0, 0.0, 0.0)).xy;\n"
+            + "    tapY = (texMatrix * vec4(0.0, tapOffset.y, 0.0, 0.0)).xy;\n"
+            // top-left origin, to match the mask coordinates
+            + "    outCoord = vec2(vTexCoord.x, 1.0 - vTexCoord.y);\n"
+            + "}\n";
+
+    private static final String FRAGMENT_SHADER = ""
+            + "#extension GL_OES_EGL_image_external : require\n"
+            + "precision mediump float;\n"
+            + "uniform samplerExternalOES tex;\n"
+            + "uniform bool downscale;\n"
+            + "uniform int maskCount;\n"
+            + "uniform vec4 masks[" + MAX_MASKS + "];\n"
+            + "varying vec2 texCoord;\n"
+            + "varying vec2 tapX;\n"
+            + "varying vec2 tapY;\n"
+            + "varying vec2 outCoord;\n"
+            + "void main() {\n"
+            + "    for (int i = 0; i < " + MAX_MASKS + "; ++i) {\n"
+            + "        if (i >= maskCount) {\n"
+            + "            break;\n"
+            + "        }\n"
+            + "        vec4 m = masks[i];\n"
+            + "        if (outCoord.x >= m.x && outCoord.x < m.z && outCoord.y >= m.y && outCoord.y < m.w) {\n"
+            + "            gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);\n"
+            + "            return;\n"
+            + "        }\n"
+            + "    }\n"
+            + "    if (downscale) {\n"
+            + "        gl_FragColor = 0.25 * (texture2D(tex, texCoord - tapX - tapY)\n"
+            + "                             + texture2D(tex, texCoord + tapX - tapY)\n"
+            + "                             + texture2D(tex, texCoord - tapX + tapY)\n"
+            + "                             + texture2D(tex, texCoord + tapX + tapY));\n"
+            + "    } else {\n"
+            + "        gl_FragColor = texture2D(tex, texCoord);\n"
+            + "    }\n"
+            + "}\n";
+
+    // Full-screen quad, as a triangle strip: x, y (position), u, v (texture coordinates)
+    private static final float[] VERTICES = {
+            -1, -1, 0, 0,
+            1, -1, 1, 0,
+            -1, 1, 0, 1,
+            1, 1, 1, 1,
+    };
+
+    private final boolean downscale;
+    private final FloatBuffer vertexBuffer;
+    private final float[] maskValues = new float[4 * MAX_MASKS];
+    private final int maskCount;
+
+    private int program;
+    private int vPositionLoc;
+    private int vTexCoordLoc;
+    private int texMatrixLoc;
+    private int tapOffsetLoc;
+    private int downscaleLoc;
+
+    /**
+     * Create a filter.
+     *
+     * @param downscale {@code true} to capture at a higher resolution and downscale on the GPU
+     * @param masks the masked regions, in percent of the video frame (left, top, right, bottom), at most {@link #MAX_MASKS}
+     */
+    public VideoFilter(boolean downscale, List<Rect> masks) {
+        this.downscale = downscale;
+        if (masks.size() > MAX_MASKS) {
+            throw new IllegalArgumentException("Too many masks: " + masks.size());
+        }
+        maskCount = masks.size();
+        for (int i = 0; i < maskCount; ++i) {
+            Rect mask = masks.get(i);
+            maskValues[4 * i] = mask.left / 100f;
+            maskValues[4 * i + 1] = mask.top / 100f;
+            maskValues[4 * i + 2] = mask.right / 100f;
+            maskValues[4 * i + 3] = mask.bottom / 100f;
+        }
+
+        vertexBuffer = ByteBuffer.allocateDirect(VERTICES.length * 4).order(ByteOrder.nativeOrder()).asFloatBuffer();
+        vertexBuffer.put(VERTICES).position(0);
+    }
+
+    public boolean isDownscale() {
+        return downscale;
+    }
+
+    public boolean hasMasks() {
+        return maskCount > 0;
+    }
+
+    /**
+     * Compile the shaders (must be called with the OpenGL context current).
+     */
+    public void init() throws IOException {
+        int vertexShader = compileShader(GLES20.GL_VERTEX_SHADER, VERTEX_SHADER);
+        int fragmentShader = compileShader(GLES20.GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+
+        program = GLES20.glCreateProgram();
+        GLES20.glAttachShader(program, vertexShader);
+        GLES20.glAttachShader(program, fragmentShader);
+        GLES20.glLinkProgram(program);
+        // the shaders are kept alive by the program
+        GLES20.glDeleteShader(vertexShader);
+        GLES20.glDeleteShader(fragmentShader);
+
+        int[] linked = new int[1];
+        GLES20.glGetProgramiv(program, GLES20.GL_LINK_STATUS, linked, 0);
+        if (linked[0] == 0) {
+            String log = GLES20.glGetProgramInfoLog(program);
+            GLES20.glDeleteProgram(program);
+            program = 0;
+            throw new IOException("Could not link the video filter program: " + log);
+        }
+
+        vPositionLoc = GLES20.glGetAttribLocation(program, "vPosition");
+        vTexCoordLoc = GLES20.glGetAttribLocation(program, "vTexCoord");
+        texMatrixLoc = GLES20.glGetUniformLocation(program, "texMatrix");
+        tapOffsetLoc = GLES20.glGetUniformLocation(program, "tapOffset");
+        downscaleLoc = GLES20.glGetUniformLocation(program, "downscale");
+
+        // The masks and the texture unit never change
+        GLES20.glUseProgram(program);
+        GLES20.glUniform1i(GLES20.glGetUniformLocation(program, "tex"), 0);
+        GLES20.glUniform1i(GLES20.glGetUniformLocation(program, "maskCount"), maskCount);
+        if (maskCount > 0) {
+            GLES20.glUniform4fv(GLES20.glGetUniformLocation(program, "masks"), maskCount, maskValues, 0);
+        }
+    }
+
+    /**
+     * Draw the frame.
+     *
+     * @param textureId the external texture containing the frame
+     * @param texMatrix the transform matrix of the texture (from the SurfaceTexture)
+     * @param inputSize the size of the frame
+     * @param outputSize the size of the output surface
+     */
+    public void draw(int textureId, float[] texMatrix, Size inputSize, Size outputSize) {
+        GLES20.glViewport(0, 0, outputSize.getWidth(), outputSize.getHeight());
+        GLES20.glUseProgram(program);
+
+        boolean downscaled = inputSize.getWidth() > outputSize.getWidth() || inputSize.getHeight() > outputSize.getHeight();
+        GLES20.glUniform1i(downscaleLoc, downscaled ? 1 : 0);
+        // A quarter of an output pixel, so that the 4 taps are centered in the 4 quadrants of its footprint
+        GLES20.glUniform2f(tapOffsetLoc, 0.25f / outputSize.getWidth(), 0.25f / outputSize.getHeight());
+        GLES20.glUniformMatrix4fv(texMatrixLoc, 1, false, texMatrix, 0);
+
+        GLES20.glActiveTexture(GLES20.GL_TEXTURE0);
+        GLES20.glBindTexture(GLES11Ext.GL_TEXTURE_EXTERNAL_OES, textureId);
+
+        vertexBuffer.position(0);
+        GLES20.glVertexAttribPointer(vPositionLoc, 2, GLES20.GL_FLOAT, false, 16, vertexBuffer);
+        GLES20.glEnableVertexAttribArray(vPositionLoc);
+        vertexBuffer.position(2);
+        GLES20.glVertexAttribPointer(vTexCoordLoc, 2, GLES20.GL_FLOAT, false, 16, vertexBuffer);
+        GLES20.glEnableVertexAttribArray(vTexCoordLoc);
+
+        GLES20.glDrawArrays(GLES20.GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    /**
+     * Release the program (must be called with the OpenGL context current).
+     */
+    public void release() {
+        if (program != 0) {
+            GLES20.glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    private static int compileShader(int type, String source) throws IOException {
+        int shader = GLES20.glCreateShader(type);
+        GLES20.glShaderSource(shader, source);
+        GLES20.glCompileShader(shader);
+
+        int[] compiled = new int[1];
+        GLES20.glGetShaderiv(shader, GLES20.GL_COMPILE_STATUS, compiled, 0);
+        if (compiled[0] == 0) {
+            String log = GLES20.glGetShaderInfoLog(shader);
+            GLES20.glDeleteShader(shader);
+            throw new IOException("Could not compile the video filter shader: " + log);
+        }
+        return shader;
+    }
+}
@@ -2,7 +2,8 @@ package com.genymobile.scrcpy;
 
 public enum VideoSource {
     DISPLAY("display"),
-    CAMERA("camera");
+    CAMERA("camera"),
+    PATTERN("pattern");
 
     private final String name;
 
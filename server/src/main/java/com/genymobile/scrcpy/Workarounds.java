@@ -13,6 +13,7 @@ import android.media.AudioRecord;
 import android.os.Build;
 import android.os.Looper;
 import android.os.Parcel;
+import android.os.SystemClock;
 
 import java.lang.ref.WeakReference;
 import java.lang.reflect.Constructor;
@@ -44,14 +45,31 @@ public final class Workarounds {
         }
     }
 
+    // The workarounds already applied (each one is applied at most once)
+    private static boolean commonApplied;
+    private static boolean configurationControllerFilled;
+    private static boolean appInfoFilled;
+    private static boolean appContextFilled;
+
     private Workarounds() {
         // not instantiable
     }
 
-    public static void apply(boolean audio, boolean camera) {
-        boolean mustFillConfigurationController = false;
-        boolean mustFillAppInfo = false;
-        boolean mustFillAppContext = false;
+    /**
+     * Apply the workarounds required whatever is captured.
+     * <p>
+     * The workarounds specific to audio or camera capture are applied lazily, only once they are needed (see {@link #applyForAudio()} and
+     * {@link #applyForCamera()}), so that they do not delay the video stream start.
+     */
+    public static synchronized void apply() {
+        if (commonApplied) {
+            return;
+        }
+        commonApplied = true;
+
+        long start = SystemClock.uptimeMillis();
+
+        fillConfigurationControllerIfNeeded();
 
         if (Build.BRAND.equalsIgnoreCase("meizu")) {
             // Workarounds must be applied for Meizu phones:
@@ -62,7 +80,7 @@ public final class Workarounds {
             // But only apply when strictly necessary, since workarounds can cause other issues:
             //  - <https://github.com/Genymobile/scrcpy/issues/940>
             //  - <https://github.com/Genymobile/scrcpy/issues/994>
-            mustFillAppInfo = true;
+            fillAppInfo();
         } else if (Build.BRAND.equalsIgnoreCase("honor")) {
             // More workarounds must be applied for Honor devices:
             //  - <https://github.com/Genymobile/scrcpy/issues/4015>
@@ -70,40 +88,51 @@ public final class Workarounds {
             // The system context must not be set for all devices, because it would cause other problems:
             //  - <https://github.com/Genymobile/scrcpy/issues/4015#issuecomment-1595382142>
             //  - <https://github.com/Genymobile/scrcpy/issues/3805#issuecomment-1596148031>
-            mustFillAppInfo = true;
-            mustFillAppContext = true;
+            fillAppInfo();
+            fillAppContext();
         }
 
-        if (audio && Build.VERSION.SDK_INT == Build.VERSION_CODES.R) {
+        Ln.d("Workarounds applied in " + (SystemClock.uptimeMillis() - start) + " ms");
+    }
+
+    /**
+     * Apply the workarounds required for audio capture (may be called from any thread, before creating the AudioRecord).
+     */
+    public static synchronized void applyForAudio() {
+        apply();
+
+        if (Build.VERSION.SDK_INT == Build.VERSION_CODES.R) {
             // Before Android 11, audio is not supported.
             // Since Android 12, we can properly set a context on the AudioRecord.
             // Only on Android 11 we must fill the application context for the AudioRecord to work.
-            mustFillAppContext = true;
+            long start = SystemClock.uptimeMillis();
+            fillAppContext();
+            Ln.d("Audio workarounds applied in " + (SystemClock.uptimeMillis() - start) + " ms");
         }
+    }
 
-        if (camera) {
-            mustFillAppInfo = true;
-            mustFillAppContext = true;
-        }
+    /**
+     * Apply the workarounds required to access the cameras.
+     */
+    public static synchronized void applyForCamera() {
+        apply();
+
+        long start = SystemClock.uptimeMillis();
+        fillAppInfo();
+        fillAppContext();
+        Ln.d("Camera workarounds applied in " + (SystemClock.uptimeMillis() - start) + " ms");
+    }
 
+    private static void fillConfigurationControllerIfNeeded() {
         if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.S) {
             // On some Samsung devices, DisplayManagerGlobal.getDisplayInfoLocked() calls ActivityThread.currentActivityThread().getConfiguration(),
             // which requires a non-null ConfigurationController.
             // ConfigurationController was introduced in Android 12, so do not attempt to set it on lower versions.
             // <https://github.com/Genymobile/scrcpy/issues/4467>
-            mustFillConfigurationController = true;
-        }
-
-        if (mustFillConfigurationController) {
-            // Must be call before fillAppContext() because it is necessary to get a valid system context
+            //
+            // Must be called before fillAppContext() because it is necessary to get a valid system context
             fillConfigurationController();
         }
-        if (mustFillAppInfo) {
-            fillAppInfo();
-        }
-        if (mustFillAppContext) {
-            fillAppContext();
-        }
     }
 
     @SuppressWarnings("deprecation")
@@ -120,6 +149,11 @@ public final class Workarounds {
     }
 
     private static void fillAppInfo() {
+        if (appInfoFilled) {
+            return;
+        }
+        appInfoFilled = true;
+
         try {
             // ActivityThread.AppBindData appBindData = new ActivityThread.AppBindData();
             Class<?> appBindDataClass = Class.forName("android.app.ActivityThread$AppBindData");
@@ -146,6 +180,11 @@ public final class Workarounds {
     }
 
     private static void fillAppContext() {
+        if (appContextFilled) {
+            return;
+        }
+        appContextFilled = true;
+
         try {
             Application app = new Application();
             Field baseField = ContextWrapper.class.getDeclaredField("mBase");
@@ -163,6 +202,11 @@ public final class Workarounds {
     }
 
     private static void fillConfigurationController() {
+        if (configurationControllerFilled) {
+            return;
+        }
+        configurationControllerFilled = true;
+
         try {
             Class<?> configurationControllerClass = Class.forName("android.app.ConfigurationController");
             Class<?> activityThreadInternalClass = Class.forName("android.app.ActivityThreadInternal");
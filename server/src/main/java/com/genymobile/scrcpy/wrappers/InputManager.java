@@ -16,22 +16,33 @@ public final class InputManager {
     public static final int INJECT_INPUT_EVENT_MODE_WAIT_FOR_FINISH = 2;
 
     private final Object manager;
-    private Method injectInputEventMethod;
+    // Resolved once on creation, it is called for every injected event
+    private final Method injectInputEventMethod;
 
-    private static Method setDisplayIdMethod;
-    private static Method setActionButtonMethod;
+    // Resolved once, null if not available on the device
+    private static final Method SET_DISPLAY_ID_METHOD = findMethod(InputEvent.class, "setDisplayId", int.class);
+    private static final Method SET_ACTION_BUTTON_METHOD = findMethod(MotionEvent.class, "setActionButton", int.class);
 
     static InputManager create() {
         try {
             Class<?> inputManagerClass = getInputManagerClass();
             Method getInstanceMethod = inputManagerClass.getDeclaredMethod("getInstance");
             Object im = getInstanceMethod.invoke(null);
-            return new InputManager(im);
+            Method injectInputEventMethod = im.getClass().getMethod("injectInputEvent", InputEvent.class, int.class);
+            return new InputManager(im, injectInputEventMethod);
         } catch (ReflectiveOperationException e) {
             throw new AssertionError(e);
         }
     }
 
+    private static Method findMethod(Class<?> cls, String name, Class<?>... parameterTypes) {
+        try {
+            return cls.getMethod(name, parameterTypes);
+        } catch (NoSuchMethodException e) {
+            return null;
+        }
+    }
+
     private static Class<?> getInputManagerClass() {
         try {
             // Parts of the InputManager class have been moved to a new InputManagerGlobal class in Android 14 preview
@@ -41,38 +52,27 @@ public final class InputManager {
         }
     }
 
-    private InputManager(Object manager) {
+    private InputManager(Object manager, Method injectInputEventMethod) {
         this.manager = manager;
-    }
-
-    private Method getInjectInputEventMethod() throws NoSuchMethodException {
-        if (injectInputEventMethod == null) {
-            injectInputEventMethod = manager.getClass().getMethod("injectInputEvent", InputEvent.class, int.class);
-        }
-        return injectInputEventMethod;
+        this.injectInputEventMethod = injectInputEventMethod;
     }
 
     public boolean injectInputEvent(InputEvent inputEvent, int mode) {
         try {
-            Method method = getInjectInputEventMethod();
-            return (boolean) method.invoke(manager, inputEvent, mode);
+            return (boolean) injectInputEventMethod.invoke(manager, inputEvent, mode);
         } catch (ReflectiveOperationException e) {
             Ln.e("Could not invoke method", e);
             return false;
         }
     }
 
-    private static Method getSetDisplayIdMethod() throws NoSuchMethodException {
-        if (setDisplayIdMethod == null) {
-            setDisplayIdMethod = InputEvent.class.getMethod("setDisplayId", int.class);
-        }
-        return setDisplayIdMethod;
-    }
-
     public static boolean setDisplayId(InputEvent inputEvent, int displayId) {
+        if (SET_DISPLAY_ID_METHOD == null) {
+            Ln.e("Cannot associate a display id to the input event: method not available");
+            return false;
+        }
         try {
-            Method method = getSetDisplayIdMethod();
-            method.invoke(inputEvent, displayId);
+            SET_DISPLAY_ID_METHOD.invoke(inputEvent, displayId);
             return true;
         } catch (ReflectiveOperationException e) {
             Ln.e("Cannot associate a display id to the input event", e);
@@ -80,17 +80,13 @@ public final class InputManager {
         }
     }
 
-    private static Method getSetActionButtonMethod() throws NoSuchMethodException {
-        if (setActionButtonMethod == null) {
-            setActionButtonMethod = MotionEvent.class.getMethod("setActionButton", int.class);
-        }
-        return setActionButtonMethod;
-    }
-
     public static boolean setActionButton(MotionEvent motionEvent, int actionButton) {
+        if (SET_ACTION_BUTTON_METHOD == null) {
+            Ln.e("Cannot set action button on MotionEvent: method not available");
+            return false;
+        }
         try {
-            Method method = getSetActionButtonMethod();
-            method.invoke(motionEvent, actionButton);
+            SET_ACTION_BUTTON_METHOD.invoke(motionEvent, actionButton);
             return true;
         } catch (ReflectiveOperationException e) {
             Ln.e("Cannot set action button on MotionEvent", e);
@@ -1,6 +1,7 @@
 package com.genymobile.scrcpy.wrappers;
 
 import com.genymobile.scrcpy.FakeContext;
+import com.genymobile.scrcpy.Workarounds;
 
 import android.annotation.SuppressLint;
 import android.content.Context;
@@ -32,6 +33,7 @@ public final class ServiceManager {
     private static ClipboardManager clipboardManager;
     private static ActivityManager activityManager;
     private static CameraManager cameraManager;
+    private static ThermalService thermalService;
 
     private ServiceManager() {
         /* not instantiable */
@@ -97,8 +99,18 @@ public final class ServiceManager {
         return activityManager;
     }
 
+    public static ThermalService getThermalService() {
+        if (thermalService == null) {
+            // May be null, the service is not available before Android 10
+            thermalService = ThermalService.create();
+        }
+        return thermalService;
+    }
+
     public static CameraManager getCameraManager() {
         if (cameraManager == null) {
+            // The camera workarounds are applied only if the cameras are accessed
+            Workarounds.applyForCamera();
             try {
                 Constructor<CameraManager> ctor = CameraManager.class.getDeclaredConstructor(Context.class);
                 cameraManager = ctor.newInstance(FakeContext.get());
@@ -27,6 +27,13 @@ public final class SurfaceControl {
         }
     }
 
+    // Called on every transaction (e.g. on rotation or crop change), so resolved only once
+    private static Method openTransactionMethod;
+    private static Method closeTransactionMethod;
+    private static Method setDisplayProjectionMethod;
+    private static Method setDisplayLayerStackMethod;
+    private static Method setDisplaySurfaceMethod;
+
     private static Method getBuiltInDisplayMethod;
     private static Method setDisplayPowerModeMethod;
     private static Method getPhysicalDisplayTokenMethod;
@@ -38,7 +45,10 @@ public final class SurfaceControl {
 
     public static void openTransaction() {
         try {
-            CLASS.getMethod("openTransaction").invoke(null);
+            if (openTransactionMethod == null) {
+                openTransactionMethod = CLASS.getMethod("openTransaction");
+            }
+            openTransactionMethod.invoke(null);
         } catch (Exception e) {
             throw new AssertionError(e);
         }
@@ -46,7 +56,10 @@ public final class SurfaceControl {
 
     public static void closeTransaction() {
         try {
-            CLASS.getMethod("closeTransaction").invoke(null);
+            if (closeTransactionMethod == null) {
+                closeTransactionMethod = CLASS.getMethod("closeTransaction");
+            }
+            closeTransactionMethod.invoke(null);
         } catch (Exception e) {
             throw new AssertionError(e);
         }
@@ -54,8 +67,10 @@ public final class SurfaceControl {
 
     public static void setDisplayProjection(IBinder displayToken, int orientation, Rect layerStackRect, Rect displayRect) {
         try {
-            CLASS.getMethod("setDisplayProjection", IBinder.class, int.class, Rect.class, Rect.class)
-                    .invoke(null, displayToken, orientation, layerStackRect, displayRect);
+            if (setDisplayProjectionMethod == null) {
+                setDisplayProjectionMethod = CLASS.getMethod("setDisplayProjection", IBinder.class, int.class, Rect.class, Rect.class);
+            }
+            setDisplayProjectionMethod.invoke(null, displayToken, orientation, layerStackRect, displayRect);
         } catch (Exception e) {
             throw new AssertionError(e);
         }
@@ -63,7 +78,10 @@ public final class SurfaceControl {
 
     public static void setDisplayLayerStack(IBinder displayToken, int layerStack) {
         try {
-            CLASS.getMethod("setDisplayLayerStack", IBinder.class, int.class).invoke(null, displayToken, layerStack);
+            if (setDisplayLayerStackMethod == null) {
+                setDisplayLayerStackMethod = CLASS.getMethod("setDisplayLayerStack", IBinder.class, int.class);
+            }
+            setDisplayLayerStackMethod.invoke(null, displayToken, layerStack);
         } catch (Exception e) {
             throw new AssertionError(e);
         }
@@ -71,7 +89,10 @@ public final class SurfaceControl {
 
     public static void setDisplaySurface(IBinder displayToken, Surface surface) {
         try {
-            CLASS.getMethod("setDisplaySurface", IBinder.class, Surface.class).invoke(null, displayToken, surface);
+            if (setDisplaySurfaceMethod == null) {
+                setDisplaySurfaceMethod = CLASS.getMethod("setDisplaySurface", IBinder.class, Surface.class);
+            }
+            setDisplaySurfaceMethod.invoke(null, displayToken, surface);
         } catch (Exception e) {
             throw new AssertionError(e);
         }
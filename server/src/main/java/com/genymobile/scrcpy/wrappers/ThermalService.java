@@ -0,0 +1,61 @@
+package com.genymobile.scrcpy.wrappers;
+
+import android.os.IInterface;
+
+import java.lang.reflect.Method;
+
+/**
+ * The service behind {@code android.os.PowerManager.getCurrentThermalStatus()} and {@code getThermalHeadroom()} (Android 10+).
+ */
+public final class ThermalService {
+    private final IInterface manager;
+    private Method getCurrentThermalStatusMethod;
+    private Method getThermalHeadroomMethod;
+
+    static ThermalService create() {
+        IInterface manager = ServiceManager.getService("thermalservice", "android.os.IThermalService");
+        if (manager == null) {
+            // Not available before Android 10
+            return null;
+        }
+        return new ThermalService(manager);
+    }
+
+    private ThermalService(IInterface manager) {
+        this.manager = manager;
+    }
+
+    private Method getGetCurrentThermalStatusMethod() throws NoSuchMethodException {
+        if (getCurrentThermalStatusMethod == null) {
+            getCurrentThermalStatusMethod = manager.getClass().getMethod("getCurrentThermalStatus");
+        }
+        return getCurrentThermalStatusMethod;
+    }
+
+    private Method getGetThermalHeadroomMethod() throws NoSuchMethodException {
+        if (getThermalHeadroomMethod == null) {
+            getThermalHeadroomMethod = manager.getClass().getMethod("getThermalHeadroom", int.class);
+        }
+        return getThermalHeadroomMethod;
+    }
+
+    /**
+     * Return the current thermal status (an {@code android.os.PowerManager.THERMAL_STATUS_*} value).
+     */
+    public int getCurrentThermalStatus() throws ReflectiveOperationException {
+        Method method = getGetCurrentThermalStatusMethod();
+        return (int) method.invoke(manager);
+    }
+
+    /**
+     * Return the forecast thermal headroom (1 corresponds to {@code THERMAL_STATUS_SEVERE}), or {@code NaN} if it is not available yet.
+     * <p>
+     * It is only available since Android 11.
+     *
+     * @param forecastSeconds the number of seconds in the future
+     */
+    public float getThermalHeadroom(int forecastSeconds) throws ReflectiveOperationException {
+        Method method = getGetThermalHeadroomMethod();
+        return (float) method.invoke(manager, forecastSeconds);
+    }
+}
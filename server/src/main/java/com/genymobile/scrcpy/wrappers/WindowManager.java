@@ -11,7 +11,8 @@ import java.lang.reflect.Method;
 
 public final class WindowManager {
     private final IInterface manager;
-    private Method getRotationMethod;
+    // Resolved once on creation, it may be called on every rotation change
+    private final Method getRotationMethod;
     private Method freezeRotationMethod;
     private Method freezeDisplayRotationMethod;
     private Method isRotationFrozenMethod;
@@ -21,26 +22,27 @@ public final class WindowManager {
 
     static WindowManager create() {
         IInterface manager = ServiceManager.getService("window", "android.view.IWindowManager");
-        return new WindowManager(manager);
+        return new WindowManager(manager, findGetRotationMethod(manager.getClass()));
     }
 
-    private WindowManager(IInterface manager) {
+    private WindowManager(IInterface manager, Method getRotationMethod) {
         this.manager = manager;
+        this.getRotationMethod = getRotationMethod;
     }
 
-    private Method getGetRotationMethod() throws NoSuchMethodException {
-        if (getRotationMethod == null) {
-            Class<?> cls = manager.getClass();
+    private static Method findGetRotationMethod(Class<?> cls) {
+        try {
+            // method changed since this commit:
+            // https://android.googlesource.com/platform/frameworks/base/+/8ee7285128c3843401d4c4d0412cd66e86ba49e3%5E%21/#F2
+            return cls.getMethod("getDefaultDisplayRotation");
+        } catch (NoSuchMethodException e) {
             try {
-                // method changed since this commit:
-                // https://android.googlesource.com/platform/frameworks/base/+/8ee7285128c3843401d4c4d0412cd66e86ba49e3%5E%21/#F2
-                getRotationMethod = cls.getMethod("getDefaultDisplayRotation");
-            } catch (NoSuchMethodException e) {
                 // old version
-                getRotationMethod = cls.getMethod("getRotation");
+                return cls.getMethod("getRotation");
+            } catch (NoSuchMethodException e2) {
+                return null;
             }
         }
-        return getRotationMethod;
     }
 
     private Method getFreezeRotationMethod() throws NoSuchMethodException {
@@ -92,9 +94,12 @@ public final class WindowManager {
     }
 
     public int getRotation() {
+        if (getRotationMethod == null) {
+            Ln.e("Could not get the rotation: method not available");
+            return 0;
+        }
         try {
-            Method method = getGetRotationMethod();
-            return (int) method.invoke(manager);
+            return (int) getRotationMethod.invoke(manager);
         } catch (ReflectiveOperationException e) {
             Ln.e("Could not invoke method", e);
             return 0;
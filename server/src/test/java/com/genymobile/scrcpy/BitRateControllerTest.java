@@ -0,0 +1,95 @@
+package com.genymobile.scrcpy;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+public class BitRateControllerTest {
+
+    private static final int CONGESTED = BitRateController.HIGH_QUEUING_DELAY_US;
+    private static final int STABLE = 0;
+    private static final int UNSTABLE = BitRateController.LOW_QUEUING_DELAY_US;
+
+    @Test
+    public void testDecreaseOnCongestion() {
+        BitRateController controller = new BitRateController(8_000_000);
+        Assert.assertEquals(8_000_000, controller.getBitRate());
+
+        int bitRate = controller.onFeedback(CONGESTED, 0);
+        Assert.assertEquals(5_600_000, bitRate);
+
+        // hold after decrease
+        Assert.assertEquals(0, controller.onFeedback(CONGESTED, 500));
+
+        bitRate = controller.onFeedback(CONGESTED, 1000);
+        Assert.assertEquals(3_920_000, bitRate);
+    }
+
+    @Test
+    public void testMinBitRate() {
+        BitRateController controller = new BitRateController(8_000_000);
+        for (int i = 0; i < 100; ++i) {
+            controller.onFeedback(CONGESTED, i * 1000);
+        }
+        Assert.assertEquals(800_000, controller.getBitRate());
+        Assert.assertEquals(0, controller.onFeedback(CONGESTED, 200_000));
+    }
+
+    @Test
+    public void testIncreaseWhenStable() {
+        BitRateController controller = new BitRateController(8_000_000);
+        controller.onFeedback(CONGESTED, 0);
+        Assert.assertEquals(5_600_000, controller.getBitRate());
+
+        // still in the hold period
+        Assert.assertEquals(0, controller.onFeedback(STABLE, 500));
+        // not stable for long enough
+        Assert.assertEquals(0, controller.onFeedback(STABLE, 1000));
+
+        int bitRate = controller.onFeedback(STABLE, 1500);
+        Assert.assertEquals(5_960_000, bitRate); // + (8M - 800K) / 20
+
+        // an unstable feedback resets the stable period
+        Assert.assertEquals(0, controller.onFeedback(UNSTABLE, 2000));
+        Assert.assertEquals(0, controller.onFeedback(STABLE, 2500));
+        Assert.assertEquals(0, controller.onFeedback(STABLE, 3000));
+        Assert.assertEquals(6_320_000, controller.onFeedback(STABLE, 3500));
+    }
+
+    @Test
+    public void testMaxBitRate() {
+        BitRateController controller = new BitRateController(8_000_000);
+        for (int i = 0; i < 10; ++i) {
+            Assert.assertEquals(0, controller.onFeedback(STABLE, i * 1000));
+        }
+        Assert.assertEquals(8_000_000, controller.getBitRate());
+    }
+
+    @Test
+    public void testLimit() {
+        BitRateController controller = new BitRateController(8_000_000);
+        Assert.assertEquals(4_000_000, controller.setLimit(4_000_000));
+        Assert.assertEquals(4_000_000, controller.getBitRate());
+
+        // never increased above the limit
+        for (int i = 0; i < 10; ++i) {
+            Assert.assertEquals(0, controller.onFeedback(STABLE, i * 1000));
+        }
+
+        // restored
+        Assert.assertEquals(8_000_000, controller.setLimit(10_000_000));
+    }
+
+    @Test
+    public void testLimitWhileCongested() {
+        BitRateController controller = new BitRateController(8_000_000);
+        controller.onFeedback(CONGESTED, 0);
+        Assert.assertEquals(5_600_000, controller.getBitRate());
+
+        // already below the limit
+        Assert.assertEquals(0, controller.setLimit(6_000_000));
+        Assert.assertEquals(0, controller.setLimit(8_000_000));
+        Assert.assertEquals(5_600_000, controller.getBitRate());
+
+        Assert.assertEquals(2_000_000, controller.setLimit(2_000_000));
+    }
+}
@@ -11,6 +11,7 @@ import java.io.DataOutputStream;
 import java.io.IOException;
 import java.nio.charset.StandardCharsets;
 import java.util.Arrays;
+import java.util.zip.Deflater;
 
 public class ControlMessageReaderTest {
 
@@ -95,6 +96,7 @@ public class ControlMessageReaderTest {
         dos.writeShort(0xffff); // pressure
         dos.writeInt(MotionEvent.BUTTON_PRIMARY); // action button
         dos.writeInt(MotionEvent.BUTTON_PRIMARY); // buttons
+        dos.writeInt(0xfedcba98); // timestamp
 
         byte[] packet = bos.toByteArray();
 
@@ -114,6 +116,89 @@ public class ControlMessageReaderTest {
         Assert.assertEquals(1f, event.getPressure(), 0f); // must be exact
         Assert.assertEquals(MotionEvent.BUTTON_PRIMARY, event.getActionButton());
         Assert.assertEquals(MotionEvent.BUTTON_PRIMARY, event.getButtons());
+        Assert.assertEquals(0xfedcba98L, event.getTimestamp());
+    }
+
+    @Test
+    public void testReuseTouchEvent() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        for (int i = 0; i < 2; ++i) {
+            dos.writeByte(ControlMessage.TYPE_INJECT_TOUCH_EVENT);
+            dos.writeByte(MotionEvent.ACTION_MOVE);
+            dos.writeLong(-42); // pointerId
+            dos.writeInt(100 + i);
+            dos.writeInt(200);
+            dos.writeShort(1080);
+            dos.writeShort(1920);
+            dos.writeShort(0xffff); // pressure
+            dos.writeInt(0); // action button
+            dos.writeInt(0); // buttons
+            dos.writeInt(1000 + i); // timestamp
+        }
+
+        byte[] packet = bos.toByteArray();
+        reader.readFrom(new ByteArrayInputStream(packet));
+
+        ControlMessage event = reader.next();
+        Position position = event.getPosition();
+        Assert.assertEquals(100, position.getPoint().getX());
+        Assert.assertEquals(1000, event.getTimestamp());
+
+        ControlMessage event2 = reader.next();
+        Assert.assertSame(event, event2);
+        Assert.assertEquals(101, event2.getPosition().getPoint().getX());
+        Assert.assertEquals(1001, event2.getTimestamp());
+        // the screen size is shared, but the previous position is not modified
+        Assert.assertSame(position.getScreenSize(), event2.getPosition().getScreenSize());
+        Assert.assertEquals(100, position.getPoint().getX());
+    }
+
+    @Test
+    public void testParseMultiTouchEvent() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_INJECT_MULTI_TOUCH_EVENT);
+        dos.writeByte(2); // pointer count
+        dos.writeInt(1234); // timestamp
+        dos.writeLong(-2); // pointerId
+        dos.writeInt(100);
+        dos.writeInt(200);
+        dos.writeShort(1080);
+        dos.writeShort(1920);
+        dos.writeShort(0xffff); // pressure
+        dos.writeLong(-4); // pointerId
+        dos.writeInt(980);
+        dos.writeInt(1720);
+        dos.writeShort(1080);
+        dos.writeShort(1920);
+        dos.writeShort(0); // pressure
+
+        byte[] packet = bos.toByteArray();
+
+        // The message type (1 byte) does not count
+        Assert.assertEquals(ControlMessageReader.INJECT_MULTI_TOUCH_EVENT_FIXED_PAYLOAD_LENGTH
+                + 2 * ControlMessageReader.INJECT_MULTI_TOUCH_EVENT_POINTER_LENGTH, packet.length - 1);
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_INJECT_MULTI_TOUCH_EVENT, event.getType());
+        Assert.assertArrayEquals(new long[]{-2, -4}, event.getPointerIds());
+        Position[] positions = event.getPositions();
+        Assert.assertEquals(2, positions.length);
+        Assert.assertEquals(100, positions[0].getPoint().getX());
+        Assert.assertEquals(200, positions[0].getPoint().getY());
+        Assert.assertEquals(980, positions[1].getPoint().getX());
+        Assert.assertEquals(1720, positions[1].getPoint().getY());
+        Assert.assertEquals(1080, positions[1].getScreenSize().getWidth());
+        Assert.assertEquals(1920, positions[1].getScreenSize().getHeight());
+        Assert.assertArrayEquals(new float[]{1f, 0f}, event.getPressures(), 0f); // must be exact
+        Assert.assertEquals(1234, event.getTimestamp());
     }
 
     @Test
@@ -257,6 +342,26 @@ public class ControlMessageReaderTest {
         Assert.assertTrue(event.getPaste());
     }
 
+    @Test
+    public void testParseSetClipboardChunk() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_SET_CLIPBOARD_CHUNK);
+        byte[] text = "testé".getBytes(StandardCharsets.UTF_8);
+        dos.writeInt(text.length);
+        dos.write(text);
+
+        byte[] packet = bos.toByteArray();
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_SET_CLIPBOARD_CHUNK, event.getType());
+        Assert.assertEquals("testé", event.getText());
+    }
+
     @Test
     public void testParseBigSetClipboardEvent() throws IOException {
         ControlMessageReader reader = new ControlMessageReader();
@@ -366,6 +471,106 @@ public class ControlMessageReaderTest {
         Assert.assertArrayEquals(data, event.getData());
     }
 
+    @Test
+    public void testParseUhidInputBatch() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_UHID_INPUT_BATCH);
+        dos.writeShort(42); // id
+        byte[][] reports = {{1, 2, 3}, {4, 5}};
+        dos.writeByte(reports.length); // count
+        for (byte[] report : reports) {
+            dos.writeShort(report.length); // size
+            dos.write(report);
+        }
+
+        byte[] packet = bos.toByteArray();
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_UHID_INPUT_BATCH, event.getType());
+        Assert.assertEquals(42, event.getId());
+        Assert.assertEquals(2, event.getReports().length);
+        Assert.assertArrayEquals(reports[0], event.getReports()[0]);
+        Assert.assertArrayEquals(reports[1], event.getReports()[1]);
+    }
+
+    @Test
+    public void testParseUhidDestroy() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_UHID_DESTROY);
+        dos.writeShort(42); // id
+
+        byte[] packet = bos.toByteArray();
+
+        // The message type (1 byte) does not count
+        Assert.assertEquals(ControlMessageReader.UHID_DESTROY_PAYLOAD_LENGTH, packet.length - 1);
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_UHID_DESTROY, event.getType());
+        Assert.assertEquals(42, event.getId());
+    }
+
+    @Test
+    public void testParseClockPing() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_CLOCK_PING);
+        dos.writeLong(123456789012L); // client time
+
+        byte[] packet = bos.toByteArray();
+
+        // The message type (1 byte) does not count
+        Assert.assertEquals(ControlMessageReader.CLOCK_PING_PAYLOAD_LENGTH, packet.length - 1);
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_CLOCK_PING, event.getType());
+        Assert.assertEquals(123456789012L, event.getClientTime());
+    }
+
+    @Test
+    public void testReuseUhidInput() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        byte[][] reports = {{1, 2, 3}, {4, 5, 6}, {7, 8}};
+        for (byte[] report : reports) {
+            dos.writeByte(ControlMessage.TYPE_UHID_INPUT);
+            dos.writeShort(42); // id
+            dos.writeShort(report.length); // size
+            dos.write(report);
+        }
+
+        byte[] packet = bos.toByteArray();
+        reader.readFrom(new ByteArrayInputStream(packet));
+
+        ControlMessage event = reader.next();
+        byte[] data = event.getData();
+        Assert.assertArrayEquals(reports[0], data);
+
+        // same size, the array is reused
+        event = reader.next();
+        Assert.assertSame(data, event.getData());
+        Assert.assertArrayEquals(reports[1], event.getData());
+
+        // different size
+        event = reader.next();
+        Assert.assertArrayEquals(reports[2], event.getData());
+    }
+
     @Test
     public void testParseOpenHardKeyboardSettings() throws IOException {
         ControlMessageReader reader = new ControlMessageReader();
@@ -382,6 +587,139 @@ public class ControlMessageReaderTest {
         Assert.assertEquals(ControlMessage.TYPE_OPEN_HARD_KEYBOARD_SETTINGS, event.getType());
     }
 
+    @Test
+    public void testParseVideoFeedback() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_VIDEO_FEEDBACK);
+        dos.writeInt(42000); // queuing delay
+        dos.writeInt(1500); // jitter
+
+        byte[] packet = bos.toByteArray();
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_VIDEO_FEEDBACK, event.getType());
+        Assert.assertEquals(42000, event.getQueuingDelay());
+        Assert.assertEquals(1500, event.getJitter());
+    }
+
+    @Test
+    public void testParseRequestKeyFrame() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_REQUEST_KEYFRAME);
+
+        byte[] packet = bos.toByteArray();
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_REQUEST_KEYFRAME, event.getType());
+    }
+
+    @Test
+    public void testParseSetVideoLimits() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_SET_VIDEO_LIMITS);
+        dos.writeShort(1024); // max size
+        dos.writeShort(30); // max fps
+
+        byte[] packet = bos.toByteArray();
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_SET_VIDEO_LIMITS, event.getType());
+        Assert.assertEquals(1024, event.getMaxSize());
+        Assert.assertEquals(30, event.getMaxFps());
+    }
+
+    @Test
+    public void testParseSetCrop() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_SET_CROP);
+        dos.writeInt(260);
+        dos.writeInt(1026);
+        dos.writeShort(1080);
+        dos.writeShort(1920);
+        dos.writeShort(540); // width
+        dos.writeShort(960); // height
+
+        byte[] packet = bos.toByteArray();
+
+        // The message type (1 byte) does not count
+        Assert.assertEquals(ControlMessageReader.SET_CROP_PAYLOAD_LENGTH, packet.length - 1);
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_SET_CROP, event.getType());
+        Assert.assertEquals(260, event.getPosition().getPoint().getX());
+        Assert.assertEquals(1026, event.getPosition().getPoint().getY());
+        Assert.assertEquals(1080, event.getPosition().getScreenSize().getWidth());
+        Assert.assertEquals(1920, event.getPosition().getScreenSize().getHeight());
+        Assert.assertEquals(540, event.getCropWidth());
+        Assert.assertEquals(960, event.getCropHeight());
+    }
+
+    @Test
+    public void testParsePushFile() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_PUSH_FILE);
+        dos.writeLong(0x10203);
+        byte[] target = "/sdcard/Download/".getBytes(StandardCharsets.UTF_8);
+        dos.writeInt(target.length);
+        dos.write(target);
+        byte[] name = "a.txt".getBytes(StandardCharsets.UTF_8);
+        dos.writeInt(name.length);
+        dos.write(name);
+
+        byte[] packet = bos.toByteArray();
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_PUSH_FILE, event.getType());
+        Assert.assertEquals("/sdcard/Download/", event.getText());
+        Assert.assertEquals("a.txt", event.getFileName());
+        Assert.assertEquals(0x10203, event.getFileSize());
+    }
+
+    @Test
+    public void testParsePushFileChunk() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_PUSH_FILE_CHUNK);
+        byte[] data = {1, 2, 3};
+        dos.writeShort(data.length);
+        dos.write(data);
+
+        byte[] packet = bos.toByteArray();
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_PUSH_FILE_CHUNK, event.getType());
+        Assert.assertArrayEquals(data, event.getData());
+    }
+
     @Test
     public void testMultiEvents() throws IOException {
         ControlMessageReader reader = new ControlMessageReader();
@@ -463,4 +801,61 @@ public class ControlMessageReaderTest {
         Assert.assertEquals(5, event.getRepeat());
         Assert.assertEquals(KeyEvent.META_CTRL_ON, event.getMetaState());
     }
+
+    @Test
+    public void testParseCompressedTextEvent() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        byte[] text = new byte[ControlMessageReader.INJECT_TEXT_MAX_LENGTH];
+        Arrays.fill(text, (byte) 'a');
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_INJECT_TEXT);
+        dos.writeInt(text.length);
+        dos.write(text);
+        byte[] raw = bos.toByteArray();
+
+        Deflater deflater = new Deflater();
+        deflater.setInput(raw);
+        deflater.finish();
+        byte[] compressed = new byte[raw.length];
+        int length = deflater.deflate(compressed);
+        Assert.assertTrue(deflater.finished());
+
+        bos = new ByteArrayOutputStream();
+        dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_COMPRESSED);
+        dos.writeInt(raw.length);
+        dos.writeInt(length);
+        dos.write(compressed, 0, length);
+        // followed by an uncompressed message
+        dos.writeByte(ControlMessage.TYPE_ROTATE_DEVICE);
+        byte[] packet = bos.toByteArray();
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlMessage event = reader.next();
+
+        Assert.assertEquals(ControlMessage.TYPE_INJECT_TEXT, event.getType());
+        Assert.assertEquals(new String(text, StandardCharsets.UTF_8), event.getText());
+
+        event = reader.next();
+        Assert.assertEquals(ControlMessage.TYPE_ROTATE_DEVICE, event.getType());
+    }
+
+    @Test(expected = IOException.class)
+    public void testParseInvalidCompressedMessage() throws IOException {
+        ControlMessageReader reader = new ControlMessageReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlMessage.TYPE_COMPRESSED);
+        dos.writeInt(100);
+        dos.writeInt(4);
+        dos.writeInt(0x12345678); // not zlib data
+        byte[] packet = bos.toByteArray();
+
+        reader.readFrom(new ByteArrayInputStream(packet));
+        reader.next();
+    }
 }
@@ -6,7 +6,12 @@ import org.junit.Test;
 import java.io.ByteArrayOutputStream;
 import java.io.DataOutputStream;
 import java.io.IOException;
+import java.nio.ByteBuffer;
 import java.nio.charset.StandardCharsets;
+import java.util.Arrays;
+import java.util.List;
+import java.util.zip.DataFormatException;
+import java.util.zip.Inflater;
 
 public class DeviceMessageWriterTest {
 
@@ -33,6 +38,38 @@ public class DeviceMessageWriterTest {
         Assert.assertArrayEquals(expected, actual);
     }
 
+    @Test
+    public void testSerializeClipboardChunks() throws IOException {
+        DeviceMessageWriter writer = new DeviceMessageWriter();
+
+        int chunkLength = DeviceMessageWriter.CLIPBOARD_CHUNK_MAX_LENGTH;
+        byte[] data = new byte[2 * chunkLength + 42];
+        Arrays.fill(data, (byte) 'a');
+        String text = new String(data, StandardCharsets.UTF_8);
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(DeviceMessage.TYPE_CLIPBOARD_CHUNK);
+        dos.writeInt(chunkLength);
+        dos.write(data, 0, chunkLength);
+        dos.writeByte(DeviceMessage.TYPE_CLIPBOARD_CHUNK);
+        dos.writeInt(chunkLength);
+        dos.write(data, chunkLength, chunkLength);
+        dos.writeByte(DeviceMessage.TYPE_CLIPBOARD);
+        dos.writeInt(42);
+        dos.write(data, 2 * chunkLength, 42);
+
+        byte[] expected = bos.toByteArray();
+
+        DeviceMessage msg = DeviceMessage.createClipboard(text);
+        bos = new ByteArrayOutputStream();
+        writer.writeTo(msg, bos);
+
+        byte[] actual = bos.toByteArray();
+
+        Assert.assertArrayEquals(expected, actual);
+    }
+
     @Test
     public void testSerializeAckSetClipboard() throws IOException {
         DeviceMessageWriter writer = new DeviceMessageWriter();
@@ -53,6 +90,45 @@ public class DeviceMessageWriterTest {
         Assert.assertArrayEquals(expected, actual);
     }
 
+    @Test
+    public void testSerializeBatch() throws IOException {
+        DeviceMessageWriter writer = new DeviceMessageWriter();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(DeviceMessage.TYPE_ACK_CLIPBOARD);
+        dos.writeLong(42);
+        dos.writeByte(DeviceMessage.TYPE_UHID_OUTPUT);
+        dos.writeShort(1); // id
+        dos.writeShort(2);
+        dos.write(new byte[] {3, 4});
+        dos.writeByte(DeviceMessage.TYPE_VIDEO_DROPPED);
+        dos.writeInt(5);
+
+        byte[] expected = bos.toByteArray();
+
+        List<DeviceMessage> msgs = Arrays.asList(
+                DeviceMessage.createAckClipboard(42),
+                DeviceMessage.createUhidOutput(1, new byte[] {3, 4}),
+                DeviceMessage.createVideoDropped(5));
+
+        int[] writes = new int[1];
+        bos = new ByteArrayOutputStream() {
+            @Override
+            public synchronized void write(byte[] b, int off, int len) {
+                ++writes[0];
+                super.write(b, off, len);
+            }
+        };
+        writer.writeTo(msgs, bos);
+
+        byte[] actual = bos.toByteArray();
+
+        Assert.assertArrayEquals(expected, actual);
+        // All the messages are written at once
+        Assert.assertEquals(1, writes[0]);
+    }
+
     @Test
     public void testSerializeUhidOutput() throws IOException {
         DeviceMessageWriter writer = new DeviceMessageWriter();
@@ -75,4 +151,156 @@ public class DeviceMessageWriterTest {
 
         Assert.assertArrayEquals(expected, actual);
     }
+
+    @Test
+    public void testSerializeVideoDropped() throws IOException {
+        DeviceMessageWriter writer = new DeviceMessageWriter();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(DeviceMessage.TYPE_VIDEO_DROPPED);
+        dos.writeInt(0x01020304);
+
+        byte[] expected = bos.toByteArray();
+
+        DeviceMessage msg = DeviceMessage.createVideoDropped(0x01020304);
+        bos = new ByteArrayOutputStream();
+        writer.writeTo(msg, bos);
+
+        byte[] actual = bos.toByteArray();
+
+        Assert.assertArrayEquals(expected, actual);
+    }
+
+    @Test
+    public void testSerializeInjectionLatency() throws IOException {
+        DeviceMessageWriter writer = new DeviceMessageWriter();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(DeviceMessage.TYPE_INJECTION_LATENCY);
+        dos.writeInt(1000);
+        dos.writeInt(100000);
+
+        byte[] expected = bos.toByteArray();
+
+        DeviceMessage msg = DeviceMessage.createInjectionLatency(1000, 100000);
+        bos = new ByteArrayOutputStream();
+        writer.writeTo(msg, bos);
+
+        byte[] actual = bos.toByteArray();
+
+        Assert.assertArrayEquals(expected, actual);
+    }
+
+    @Test
+    public void testSerializeClockPong() throws IOException {
+        DeviceMessageWriter writer = new DeviceMessageWriter();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(DeviceMessage.TYPE_CLOCK_PONG);
+        dos.writeLong(123456789012L);
+        dos.writeLong(987654321098L);
+
+        byte[] expected = bos.toByteArray();
+
+        DeviceMessage msg = DeviceMessage.createClockPong(123456789012L, 987654321098L);
+        bos = new ByteArrayOutputStream();
+        writer.writeTo(msg, bos);
+
+        byte[] actual = bos.toByteArray();
+
+        Assert.assertArrayEquals(expected, actual);
+    }
+
+    @Test
+    public void testSerializeThermalState() throws IOException {
+        DeviceMessageWriter writer = new DeviceMessageWriter();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(DeviceMessage.TYPE_THERMAL_STATE);
+        dos.writeByte(2);
+        dos.writeByte(-1); // unknown battery level
+        dos.writeByte(2);
+
+        byte[] expected = bos.toByteArray();
+
+        DeviceMessage msg = DeviceMessage.createThermalState(2, -1, 2);
+        bos = new ByteArrayOutputStream();
+        writer.writeTo(msg, bos);
+
+        byte[] actual = bos.toByteArray();
+
+        Assert.assertArrayEquals(expected, actual);
+    }
+
+    @Test
+    public void testSerializeEncoderStats() throws IOException {
+        DeviceMessageWriter writer = new DeviceMessageWriter();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(DeviceMessage.TYPE_ENCODER_STATS);
+        dos.writeInt(8000);
+        dos.writeInt(25000);
+        dos.writeInt(200);
+        dos.writeInt(40000);
+
+        byte[] expected = bos.toByteArray();
+
+        DeviceMessage msg = DeviceMessage.createEncoderStats(8000, 25000, 200, 40000);
+        bos = new ByteArrayOutputStream();
+        writer.writeTo(msg, bos);
+
+        byte[] actual = bos.toByteArray();
+
+        Assert.assertArrayEquals(expected, actual);
+    }
+
+    @Test
+    public void testSerializeCompressedClipboard() throws IOException, DataFormatException {
+        DeviceMessageWriter writer = new DeviceMessageWriter();
+        writer.enableCompression();
+
+        byte[] data = new byte[4096];
+        Arrays.fill(data, (byte) 'a');
+        String text = new String(data, StandardCharsets.UTF_8);
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        writer.writeTo(DeviceMessage.createClipboard(text), bos);
+        ByteBuffer actual = ByteBuffer.wrap(bos.toByteArray());
+
+        Assert.assertEquals(DeviceMessage.TYPE_COMPRESSED, actual.get());
+        int rawLength = actual.getInt();
+        int length = actual.getInt();
+        Assert.assertEquals(5 + data.length, rawLength);
+        Assert.assertEquals(length, actual.remaining());
+        Assert.assertTrue(length < data.length / 10);
+
+        Inflater inflater = new Inflater();
+        inflater.setInput(actual.array(), actual.position(), length);
+        byte[] raw = new byte[rawLength];
+        Assert.assertEquals(rawLength, inflater.inflate(raw));
+        Assert.assertTrue(inflater.finished());
+
+        ByteBuffer inner = ByteBuffer.wrap(raw);
+        Assert.assertEquals(DeviceMessage.TYPE_CLIPBOARD, inner.get());
+        Assert.assertEquals(data.length, inner.getInt());
+        Assert.assertEquals(text, new String(raw, 5, data.length, StandardCharsets.UTF_8));
+    }
+
+    @Test
+    public void testSerializeSmallMessageUncompressed() throws IOException {
+        DeviceMessageWriter writer = new DeviceMessageWriter();
+        writer.enableCompression();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        writer.writeTo(DeviceMessage.createClipboard("aaaaaaaaaaaaaaaa"), bos);
+        byte[] actual = bos.toByteArray();
+
+        Assert.assertEquals(DeviceMessage.TYPE_CLIPBOARD, actual[0]);
+        Assert.assertEquals(5 + 16, actual.length);
+    }
 }
@@ -0,0 +1,48 @@
+package com.genymobile.scrcpy;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+public class EventTimeMapperTest {
+
+    @Test
+    public void testUnknown() {
+        EventTimeMapper mapper = new EventTimeMapper();
+        Assert.assertEquals(5000, mapper.map(0, 5000));
+    }
+
+    @Test
+    public void testJitterDoesNotChangeDelays() {
+        EventTimeMapper mapper = new EventTimeMapper();
+        Assert.assertEquals(5000, mapper.map(100, 5000));
+        // received 30ms later than the previous event relative to the client clock
+        Assert.assertEquals(5016, mapper.map(116, 5046));
+        Assert.assertEquals(5032, mapper.map(132, 5040));
+    }
+
+    @Test
+    public void testLowerLatency() {
+        EventTimeMapper mapper = new EventTimeMapper();
+        Assert.assertEquals(5000, mapper.map(100, 5000));
+        // this event reached the device faster, the offset is adjusted
+        Assert.assertEquals(5010, mapper.map(116, 5010));
+        Assert.assertEquals(5026, mapper.map(132, 5030));
+    }
+
+    @Test
+    public void testNeverInTheFuture() {
+        EventTimeMapper mapper = new EventTimeMapper();
+        for (int i = 0; i < 100; ++i) {
+            long now = 5000 + i * 16 + (i * 7) % 13;
+            Assert.assertTrue(mapper.map(100 + i * 16, now) <= now);
+        }
+    }
+
+    @Test
+    public void testClientClockReset() {
+        EventTimeMapper mapper = new EventTimeMapper();
+        Assert.assertEquals(5000, mapper.map(100000, 5000));
+        Assert.assertEquals(6000, mapper.map(10, 6000));
+        Assert.assertEquals(6016, mapper.map(26, 6020));
+    }
+}
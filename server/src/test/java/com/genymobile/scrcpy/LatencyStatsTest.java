@@ -0,0 +1,40 @@
+package com.genymobile.scrcpy;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+public class LatencyStatsTest {
+
+    @Test
+    public void testEmpty() {
+        LatencyStats stats = new LatencyStats("test");
+        Assert.assertNull(stats.getPercentiles(50));
+        Assert.assertNull(stats.format());
+    }
+
+    @Test
+    public void testPercentiles() {
+        LatencyStats stats = new LatencyStats("test");
+        // add in reverse order, the result must not depend on the order
+        for (int i = 100; i > 0; --i) {
+            stats.add(i);
+        }
+
+        long[] p = stats.getPercentiles(0, 50, 95, 99, 100);
+        Assert.assertArrayEquals(new long[]{1, 50, 95, 99, 100}, p);
+    }
+
+    @Test
+    public void testNegativeValuesIgnored() {
+        LatencyStats stats = new LatencyStats("test");
+        stats.add(-1);
+        Assert.assertEquals(0, stats.getCount());
+    }
+
+    @Test
+    public void testFormat() {
+        LatencyStats stats = new LatencyStats("encode");
+        stats.add(1500);
+        Assert.assertEquals("encode p50=1.5ms p95=1.5ms p99=1.5ms (1 frames)", stats.format());
+    }
+}
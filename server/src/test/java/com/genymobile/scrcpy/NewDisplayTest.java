@@ -0,0 +1,42 @@
+package com.genymobile.scrcpy;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+public class NewDisplayTest {
+
+    @Test
+    public void testParseDefault() {
+        NewDisplay newDisplay = NewDisplay.parse("");
+        Assert.assertNull(newDisplay.getSize());
+        Assert.assertEquals(0, newDisplay.getDpi());
+    }
+
+    @Test
+    public void testParseSizeAndDpi() {
+        NewDisplay newDisplay = NewDisplay.parse("1920x1080/420");
+        Assert.assertEquals(1920, newDisplay.getSize().getWidth());
+        Assert.assertEquals(1080, newDisplay.getSize().getHeight());
+        Assert.assertEquals(420, newDisplay.getDpi());
+    }
+
+    @Test
+    public void testParseSizeOnly() {
+        NewDisplay newDisplay = NewDisplay.parse("1280x720");
+        Assert.assertEquals(1280, newDisplay.getSize().getWidth());
+        Assert.assertEquals(720, newDisplay.getSize().getHeight());
+        Assert.assertEquals(0, newDisplay.getDpi());
+    }
+
+    @Test
+    public void testParseDpiOnly() {
+        NewDisplay newDisplay = NewDisplay.parse("/240");
+        Assert.assertNull(newDisplay.getSize());
+        Assert.assertEquals(240, newDisplay.getDpi());
+    }
+
+    @Test(expected = IllegalArgumentException.class)
+    public void testParseInvalidSize() {
+        NewDisplay.parse("1920/420");
+    }
+}
@@ -0,0 +1,36 @@
+package com.genymobile.scrcpy;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+public class PacketPacerTest {
+
+    @Test
+    public void testMustPace() {
+        Assert.assertFalse(PacketPacer.mustPace(1000));
+        Assert.assertFalse(PacketPacer.mustPace(PacketPacer.CHUNK_SIZE));
+        Assert.assertTrue(PacketPacer.mustPace(PacketPacer.CHUNK_SIZE + 1));
+    }
+
+    @Test
+    public void testChunkDelay() {
+        // 8 Mbps, written at 32 Mbps (4 MB/s)
+        PacketPacer pacer = new PacketPacer(8_000_000);
+        Assert.assertEquals(0, pacer.getChunkDelayUs(0));
+        Assert.assertEquals(4096, pacer.getChunkDelayUs(PacketPacer.CHUNK_SIZE));
+        Assert.assertEquals(50_000, pacer.getChunkDelayUs(200_000));
+    }
+
+    @Test
+    public void testBitRateChange() {
+        PacketPacer pacer = new PacketPacer(8_000_000);
+        pacer.setBitRate(2_000_000);
+        // 4 times slower
+        Assert.assertEquals(200_000, pacer.getChunkDelayUs(200_000));
+    }
+
+    @Test(expected = IllegalArgumentException.class)
+    public void testInvalidBitRate() {
+        new PacketPacer(0);
+    }
+}
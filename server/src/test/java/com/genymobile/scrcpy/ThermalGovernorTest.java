@@ -0,0 +1,88 @@
+package com.genymobile.scrcpy;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+public class ThermalGovernorTest {
+
+    @Test
+    public void testComputeLevel() {
+        Assert.assertEquals(0, ThermalGovernor.computeLevel(ThermalGovernor.THERMAL_STATUS_NONE, Float.NaN, 80, false));
+        Assert.assertEquals(1, ThermalGovernor.computeLevel(ThermalGovernor.THERMAL_STATUS_LIGHT, Float.NaN, 80, false));
+        Assert.assertEquals(2, ThermalGovernor.computeLevel(ThermalGovernor.THERMAL_STATUS_MODERATE, Float.NaN, 80, false));
+        Assert.assertEquals(3, ThermalGovernor.computeLevel(ThermalGovernor.THERMAL_STATUS_SEVERE, Float.NaN, 80, false));
+        // critical, emergency, shutdown
+        Assert.assertEquals(3, ThermalGovernor.computeLevel(6, Float.NaN, 80, false));
+        // unknown
+        Assert.assertEquals(0, ThermalGovernor.computeLevel(-1, Float.NaN, -1, false));
+    }
+
+    @Test
+    public void testComputeLevelFromHeadroom() {
+        // anticipate the throttling
+        Assert.assertEquals(0, ThermalGovernor.computeLevel(ThermalGovernor.THERMAL_STATUS_NONE, 0.5f, 80, false));
+        Assert.assertEquals(1, ThermalGovernor.computeLevel(ThermalGovernor.THERMAL_STATUS_NONE, 0.9f, 80, false));
+        Assert.assertEquals(2, ThermalGovernor.computeLevel(ThermalGovernor.THERMAL_STATUS_NONE, 1.1f, 80, false));
+        // the thermal status still applies
+        Assert.assertEquals(3, ThermalGovernor.computeLevel(ThermalGovernor.THERMAL_STATUS_SEVERE, 0.5f, 80, false));
+    }
+
+    @Test
+    public void testComputeLevelFromBattery() {
+        Assert.assertEquals(1, ThermalGovernor.computeLevel(ThermalGovernor.THERMAL_STATUS_NONE, Float.NaN, 10, false));
+        // not while charging
+        Assert.assertEquals(0, ThermalGovernor.computeLevel(ThermalGovernor.THERMAL_STATUS_NONE, Float.NaN, 10, true));
+        Assert.assertEquals(2, ThermalGovernor.computeLevel(ThermalGovernor.THERMAL_STATUS_MODERATE, Float.NaN, 10, false));
+    }
+
+    @Test
+    public void testIncreaseImmediately() {
+        ThermalGovernor governor = new ThermalGovernor();
+        Assert.assertEquals(-1, governor.update(0, 0));
+        Assert.assertEquals(2, governor.update(2, 1000));
+        Assert.assertEquals(3, governor.update(3, 2000));
+        Assert.assertEquals(-1, governor.update(3, 3000));
+    }
+
+    @Test
+    public void testDecreaseAfterRecovery() {
+        long delay = ThermalGovernor.RECOVERY_DELAY_MS;
+        ThermalGovernor governor = new ThermalGovernor();
+        Assert.assertEquals(3, governor.update(3, 0));
+
+        Assert.assertEquals(-1, governor.update(0, 1000));
+        Assert.assertEquals(-1, governor.update(1, 2000));
+        // the highest level requested during the recovery
+        Assert.assertEquals(1, governor.update(0, 1000 + delay));
+        Assert.assertEquals(1, governor.getLevel());
+    }
+
+    @Test
+    public void testRecoveryInterrupted() {
+        long delay = ThermalGovernor.RECOVERY_DELAY_MS;
+        ThermalGovernor governor = new ThermalGovernor();
+        Assert.assertEquals(2, governor.update(2, 0));
+
+        Assert.assertEquals(-1, governor.update(0, 1000));
+        // heating again restarts the recovery period
+        Assert.assertEquals(-1, governor.update(2, 2000));
+        Assert.assertEquals(-1, governor.update(0, 3000));
+        Assert.assertEquals(-1, governor.update(0, 1000 + delay));
+        Assert.assertEquals(0, governor.update(0, 3000 + delay));
+    }
+
+    @Test
+    public void testLimits() {
+        ThermalGovernor.Limits none = ThermalGovernor.getLimits(0);
+        Assert.assertEquals(100, none.getBitRatePercent());
+        Assert.assertEquals(0, none.getMaxFps());
+        Assert.assertEquals(100, none.getSizePercent());
+
+        for (int level = 1; level <= ThermalGovernor.MAX_LEVEL; ++level) {
+            ThermalGovernor.Limits previous = ThermalGovernor.getLimits(level - 1);
+            ThermalGovernor.Limits limits = ThermalGovernor.getLimits(level);
+            Assert.assertTrue(limits.getBitRatePercent() < previous.getBitRatePercent());
+            Assert.assertTrue(limits.getSizePercent() <= previous.getSizePercent());
+        }
+    }
+}